@@ -17,6 +17,7 @@
 #include "Config.h"
 #include "SimpleEvaluator.h"
 #include "SimpleOutputWriter.h"
+#include "EmbeddingExporter.h"
 #include "BestGpu.h"
 #include "ScriptableObjects.h"
 #include "BrainScriptEvaluator.h"
@@ -269,7 +270,8 @@ void DoWriteOutput(const ConfigParameters& config)
                 string type = formatConfig(L"type");
                 if      (type == "real")     formattingOptions.isCategoryLabel = false;
                 else if (type == "category") formattingOptions.isCategoryLabel = true;
-                else                         InvalidArgument("write: type must be 'real' or 'category'");
+                else if (type == "binary")   formattingOptions.isBinary        = true;
+                else                         InvalidArgument("write: type must be 'real', 'category' or 'binary'");
                 if (formattingOptions.isCategoryLabel)
                     formattingOptions.labelMappingFile = (wstring)formatConfig(L"labelMappingFile", L"");
             }
@@ -283,6 +285,7 @@ void DoWriteOutput(const ConfigParameters& config)
             formattingOptions.sampleSeparator   = formatConfig(L"sampleSeparator",   formattingOptions.sampleSeparator);
             formattingOptions.precisionFormat   = formatConfig(L"precisionFormat",   formattingOptions.precisionFormat);
         }
+        formattingOptions.writeQueueSize = config(L"writeQueueSize", formattingOptions.writeQueueSize);
 
         writer.WriteOutput(testDataReader, mbSize[0], outputPath, outputNodeNamesVector, formattingOptions, epochSize);
     }
@@ -292,3 +295,44 @@ void DoWriteOutput(const ConfigParameters& config)
 
 template void DoWriteOutput<float>(const ConfigParameters& config);
 template void DoWriteOutput<double>(const ConfigParameters& config);
+
+// ===========================================================================
+// DoExportEmbeddings() - implements CNTK "exportEmbeddings" command
+// ===========================================================================
+
+template <typename ElemType>
+void DoExportEmbeddings(const ConfigParameters& config)
+{
+    ConfigParameters readerConfig(config(L"reader"));
+    readerConfig.Insert("traceLevel", config(L"traceLevel", "0"));
+    readerConfig.Insert("randomize", "None"); // the rows must be in the order of the data
+
+    DEVICEID_TYPE deviceId = DeviceFromConfig(config);
+    ConfigArray minibatchSize = config(L"minibatchSize", "4096");
+    intargvector mbSize = minibatchSize;
+    wstring modelPath = config(L"modelPath");
+    wstring embeddingNodeName = config(L"embeddingNodeName");
+    wstring outputPath = config(L"outputPath");
+    string precision = config(L"precision", "float16");
+    size_t writeQueueSize = config(L"writeQueueSize", (size_t) 4);
+
+    size_t epochSize = config(L"epochSize", "0");
+    if (epochSize == 0)
+        epochSize = requestDataSize;
+
+    auto exportPrecision = EmbeddingExporter<ElemType>::ParsePrecision(precision);
+
+    auto net = make_shared<ComputationNetwork>(deviceId);
+    net->Read<ElemType>(modelPath);
+    auto root = EmbeddingExporter<ElemType>::PruneNetwork(net, embeddingNodeName);
+    net->CompileNetwork();
+
+    // create the reader after pruning, so that it knows which inputs are left
+    DataReader dataReader(readerConfig);
+
+    EmbeddingExporter<ElemType> exporter(net);
+    exporter.Export(dataReader, mbSize[0], root, outputPath, exportPrecision, writeQueueSize, epochSize);
+}
+
+template void DoExportEmbeddings<float>(const ConfigParameters& config);
+template void DoExportEmbeddings<double>(const ConfigParameters& config);
@@ -15,6 +15,9 @@
 #include "Config.h"
 #include "ScriptableObjects.h"
 #include "BrainScriptEvaluator.h"
+#include "ChunkedBinaryWriter.h"
+#include "../Readers/HTKMLFReader/basetypes.h" // for msra_mgram.h
+#include "../Readers/HTKMLFReader/msra_mgram.h"
 
 #include <string>
 #include <chrono>
@@ -110,6 +113,286 @@ void DoCreateLabelMap(const ConfigParameters& config)
 template void DoCreateLabelMap<float>(const ConfigParameters& config);
 template void DoCreateLabelMap<double>(const ConfigParameters& config);
 
+// ===========================================================================
+// DoConvertToChunkedBinary() - implements CNTK "convertToChunkedBinary" command
+// Reads the complete data of a reader once and writes it into a chunked binary corpus file
+// (see ChunkedBinaryFormat.h), which the ChunkedBinaryReader reads without parsing.
+//  reader       -- configuration of the reader to convert from
+//  outputPath   -- the corpus file to write
+//  sparseInputs -- inputs to store as sparse (default: none)
+//  chunkSizeInBytes, minibatchSize -- optional
+//  streaming    -- write the streaming variant of the format instead, "-" writes to stdout
+//  numberOfOutputs -- with streaming, split the data into this many streams "<outputPath>.<i>" (default 1)
+//  sweeps       -- with streaming, read the data this many times, e.g. for several training epochs (default 1)
+// Sequences are taken from the reader's minibatch layout; sequences that span several minibatches are joined.
+// With several outputs, e.g. named pipes, one process reads and randomizes the data for all worker processes
+// on a machine, and each worker reads its share with the "stream" option of the ChunkedBinaryReader;
+// every sequence goes to the output that has received the fewest samples so far.
+// ===========================================================================
+
+// Holds the samples of a sequence until it is complete.
+template <typename ElemType>
+struct PendingSequence
+{
+    PendingSequence() : m_numberOfSamples(0) { }
+
+    vector<vector<ElemType>> m_streams; // column-major samples per stream
+    size_t m_numberOfSamples;
+};
+
+template <typename ElemType>
+static vector<SequenceDataPtr> GetChunkedBinarySequence(const vector<StreamDescriptionPtr>& streams, PendingSequence<ElemType>& sequence)
+{
+    vector<SequenceDataPtr> data;
+    for (size_t i = 0; i < streams.size(); i++)
+    {
+        size_t dimension = streams[i]->m_sampleLayout->GetNumElements();
+        vector<ElemType>& values = sequence.m_streams[i];
+        if (streams[i]->m_storageType == StorageType::dense)
+        {
+            auto dense = make_shared<DenseSequenceData>();
+            dense->m_numberOfSamples = sequence.m_numberOfSamples;
+            dense->m_sampleLayout = streams[i]->m_sampleLayout;
+            dense->m_data = values.data();
+            data.push_back(dense);
+        }
+        else
+        {
+            // compact the non-zero values in place, they never overtake the dense position they are read from
+            auto sparse = make_shared<SparseSequenceData>();
+            sparse->m_indices.resize(sequence.m_numberOfSamples);
+            size_t nonZeroCount = 0;
+            for (size_t t = 0; t < sequence.m_numberOfSamples; t++)
+            {
+                for (size_t row = 0; row < dimension; row++)
+                {
+                    ElemType value = values[t * dimension + row];
+                    if (value != 0)
+                    {
+                        sparse->m_indices[t].push_back(row);
+                        values[nonZeroCount++] = value;
+                    }
+                }
+            }
+            sparse->m_data = values.data();
+            data.push_back(sparse);
+        }
+    }
+    return data;
+}
+
+template <typename ElemType>
+void DoConvertToChunkedBinary(const ConfigParameters& config)
+{
+    ConfigParameters readerConfig(config(L"reader"));
+    wstring outputPath = config(L"outputPath");
+    size_t minibatchSize = config(L"minibatchSize", "2048");
+    size_t chunkSizeInBytes = config(L"chunkSizeInBytes", "33554432"); // 32 MB
+    bool streaming = config(L"streaming", false);
+    size_t numberOfOutputs = config(L"numberOfOutputs", (size_t) 1);
+    size_t sweeps = config(L"sweeps", (size_t) 1);
+    int traceLevel = config(L"traceLevel", "0");
+
+    if (numberOfOutputs == 0 || sweeps == 0)
+        InvalidArgument("ConvertToChunkedBinary: numberOfOutputs and sweeps must be positive.");
+    if (!streaming && (numberOfOutputs > 1 || sweeps > 1))
+        InvalidArgument("ConvertToChunkedBinary: numberOfOutputs and sweeps require streaming=true.");
+
+    ConfigArray sparseInputsArray = config(L"sparseInputs", "");
+    set<wstring> sparseInputs;
+    for (int i = 0; i < sparseInputsArray.size(); i++)
+    {
+        sparseInputs.insert(sparseInputsArray[i]);
+    }
+
+    vector<wstring> inputNames;
+    vector<wstring> labelNames;
+    GetFileConfigNames(readerConfig, inputNames, labelNames);
+    inputNames.insert(inputNames.end(), labelNames.begin(), labelNames.end());
+    if (inputNames.empty())
+        InvalidArgument("ConvertToChunkedBinary: the reader configuration does not define any inputs.");
+
+    StreamMinibatchInputs matrices;
+    for (const auto& name : inputNames)
+        matrices.AddInputMatrix(name, make_shared<Matrix<ElemType>>(CPUDEVICE));
+
+    fprintf(stderr, "ConvertToChunkedBinary: writing %d inputs to '%ls'\n", (int) inputNames.size(), outputPath.c_str());
+    auto start = std::chrono::system_clock::now();
+
+    DataReader dataReader(readerConfig);
+
+    // The writers are created with the first minibatch, which gives the dimensions of the inputs.
+    unique_ptr<ChunkedBinaryWriter> writer;
+    vector<unique_ptr<ChunkedBinaryStreamWriter>> streamWriters;
+    vector<FILE*> streamFiles;
+    vector<size_t> streamSamples(numberOfOutputs, 0);
+    size_t numberOfSequences = 0;
+    vector<StreamDescriptionPtr> streams;
+    map<UniqueSequenceId, PendingSequence<ElemType>> pendingSequences;
+    auto layout = make_shared<MBLayout>();
+    size_t numberOfSamples = 0;
+    for (size_t sweep = 0; sweep < sweeps; sweep++)
+    {
+        dataReader.StartMinibatchLoop(minibatchSize, sweep, requestDataSize);
+        while (dataReader.GetMinibatch(matrices))
+        {
+            vector<Matrix<ElemType>*> inputs;
+            for (const auto& name : inputNames)
+            {
+                Matrix<ElemType>& input = matrices.GetInputMatrix<ElemType>(name);
+                if (input.GetMatrixType() == MatrixType::SPARSE)
+                    input.SwitchToMatrixType(MatrixType::DENSE, MatrixFormat::matrixFormatDense, true);
+                inputs.push_back(&input);
+            }
+
+            if (!writer && streamWriters.empty())
+            {
+                for (size_t i = 0; i < inputNames.size(); i++)
+                {
+                    auto stream = make_shared<StreamDescription>();
+                    stream->m_id = i;
+                    stream->m_name = inputNames[i];
+                    stream->m_storageType = sparseInputs.find(inputNames[i]) != sparseInputs.end() ? StorageType::sparse_csc : StorageType::dense;
+                    stream->m_elementType = sizeof(ElemType) == sizeof(float) ? ElementType::tfloat : ElementType::tdouble;
+                    stream->m_sampleLayout = make_shared<TensorShape>(inputs[i]->GetNumRows());
+                    streams.push_back(stream);
+                }
+                if (streaming)
+                {
+                    for (size_t i = 0; i < numberOfOutputs; i++)
+                    {
+                        wstring path = numberOfOutputs == 1 ? outputPath : outputPath + L"." + std::to_wstring(i);
+                        streamFiles.push_back(fopenOrDie(path, L"wb"));
+                        streamWriters.push_back(unique_ptr<ChunkedBinaryStreamWriter>(new ChunkedBinaryStreamWriter(streamFiles.back(), streams)));
+                    }
+                }
+                else
+                {
+                    writer.reset(new ChunkedBinaryWriter(outputPath, streams, chunkSizeInBytes));
+                }
+            }
+
+            // readers without a sequence layout deliver one sample per column
+            size_t numCols = inputs[0]->GetNumCols();
+            dataReader.CopyMBLayoutTo(layout);
+            if (layout->GetNumCols() != numCols)
+                layout->InitAsFrameMode(numCols);
+
+            for (const auto& info : layout->GetAllSequences())
+            {
+                if (info.seqId == GAP_SEQUENCE_ID)
+                    continue;
+
+                auto& sequence = pendingSequences[info.seqId];
+                sequence.m_streams.resize(streams.size());
+                size_t tBegin = (size_t) max(info.tBegin, (ptrdiff_t) 0);
+                size_t tEnd = min(info.tEnd, layout->GetNumTimeSteps());
+                for (size_t i = 0; i < streams.size(); i++)
+                {
+                    if (inputs[i]->GetNumCols() != numCols)
+                        RuntimeError("ConvertToChunkedBinary: input '%ls' has %d columns, expected %d.", inputNames[i].c_str(), (int) inputs[i]->GetNumCols(), (int) numCols);
+
+                    size_t dimension = inputs[i]->GetNumRows();
+                    const ElemType* data = inputs[i]->BufferPointer();
+                    for (size_t t = tBegin; t < tEnd; t++)
+                    {
+                        const ElemType* column = data + (t * layout->GetNumParallelSequences() + info.s) * dimension;
+                        sequence.m_streams[i].insert(sequence.m_streams[i].end(), column, column + dimension);
+                    }
+                }
+                sequence.m_numberOfSamples += tEnd - tBegin;
+                numberOfSamples += tEnd - tBegin;
+
+                // the rest of the sequence follows in the next minibatch
+                if (info.tEnd > layout->GetNumTimeSteps())
+                    continue;
+
+                auto data = GetChunkedBinarySequence(streams, sequence);
+                if (!streamWriters.empty())
+                {
+                    size_t output = min_element(streamSamples.begin(), streamSamples.end()) - streamSamples.begin();
+                    streamWriters[output]->AddSequence(data);
+                    streamSamples[output] += sequence.m_numberOfSamples;
+                }
+                else
+                    writer->AddSequence(data);
+                numberOfSequences++;
+                pendingSequences.erase(info.seqId);
+            }
+
+            if (traceLevel > 1)
+                fprintf(stderr, "."); // progress meter
+        }
+
+        if (!pendingSequences.empty())
+            fprintf(stderr, "ConvertToChunkedBinary: WARNING: %d incomplete sequences at the end of the data were dropped.\n", (int) pendingSequences.size());
+        pendingSequences.clear();
+    }
+
+    if (!writer && streamWriters.empty())
+        RuntimeError("ConvertToChunkedBinary: the reader did not return any data.");
+
+    size_t numberOfChunks = 0;
+    if (!streamWriters.empty())
+    {
+        for (size_t i = 0; i < streamWriters.size(); i++)
+        {
+            streamWriters[i]->Close();
+            if (streamFiles[i] != stdout)
+                fcloseOrDie(streamFiles[i]);
+        }
+    }
+    else
+    {
+        writer->Close();
+        numberOfChunks = writer->GetNumberOfChunks();
+    }
+
+    auto elapsed = std::chrono::system_clock::now() - start;
+    fprintf(stderr, "\nConvertToChunkedBinary: wrote %d samples in %d sequences and %d chunks to '%ls' in %.2f seconds\n",
+            (int) numberOfSamples, (int) numberOfSequences, (int) numberOfChunks, outputPath.c_str(),
+            (float) std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count() / 1000);
+}
+
+template void DoConvertToChunkedBinary<float>(const ConfigParameters& config);
+template void DoConvertToChunkedBinary<double>(const ConfigParameters& config);
+
+// ===========================================================================
+// DoConvertToBinaryLM() - implements CNTK "convertToBinaryLM" command
+// Reads an ARPA language model once and writes it as a binary image (see CMGramLMImage in msra_mgram.h),
+// which the readers map in place instead of parsing, e.g. the unigram of sequence training.
+//  inputPath  -- the ARPA file
+//  outputPath -- the image to write
+//  maxM       -- optional, to truncate the model to its lower orders
+// ===========================================================================
+
+namespace msra { namespace lm {
+/*static*/ const mgram_map::index_t mgram_map::nindex = (mgram_map::index_t) -1; // invalid index
+} }
+
+template <typename ElemType>
+void DoConvertToBinaryLM(const ConfigParameters& config)
+{
+    wstring inputPath = config(L"inputPath");
+    wstring outputPath = config(L"outputPath");
+    int maxM = config(L"maxM", INT_MAX);
+
+    auto start = std::chrono::system_clock::now();
+
+    msra::lm::CSymbolSet symbols;
+    msra::lm::CMGramLM lm;
+    lm.read(inputPath, symbols, false /*filterVocabulary--keep all*/, maxM);
+    msra::lm::CMGramLMImage::write(lm, outputPath);
+
+    auto elapsed = std::chrono::system_clock::now() - start;
+    fprintf(stderr, "ConvertToBinaryLM: wrote the %d-gram LM '%ls' to '%ls' in %.2f seconds\n",
+            lm.order(), inputPath.c_str(), outputPath.c_str(),
+            (float) std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count() / 1000);
+}
+
+template void DoConvertToBinaryLM<float>(const ConfigParameters& config);
+template void DoConvertToBinaryLM<double>(const ConfigParameters& config);
+
 // ===========================================================================
 // DoParameterSVD() - implements CNTK "SVD" command
 // ===========================================================================
@@ -201,6 +484,39 @@ void DoParameterSVD(const ConfigParameters& config)
 template void DoParameterSVD<float>(const ConfigParameters& config);
 template void DoParameterSVD<double>(const ConfigParameters& config);
 
+// ===========================================================================
+// DoParameterPruning() - implements CNTK "prune" command
+// Sets the blocks of smallest magnitude of the matrix parameters to 0, see ComputationNetwork::PruneParameters().
+// The pruned model is then fine-tuned with SGD's maskPrunedWeights=true, and evaluated with the sparseWeights option of the eval DLL.
+// ===========================================================================
+
+template <typename ElemType>
+void DoParameterPruning(const ConfigParameters& config)
+{
+    DEVICEID_TYPE deviceID = -1; // use CPU for pruning
+    wstring modelPath = config(L"modelPath");
+    wstring outputModelPath = config(L"outputModelPath");
+    wstring nodeNameRegex = config(L"NodeNameRegex", L"");
+    double sparsity = config(L"sparsity", "0.8");
+    size_t blockRows = config(L"blockRows", "1");
+    size_t blockCols = config(L"blockCols", "1");
+
+    if (modelPath.empty())
+        InvalidArgument("DoParameterPruning: modelPath must be specified.");
+    if (outputModelPath.empty())
+        InvalidArgument("DoParameterPruning: outputModelPath must be specified.");
+
+    ComputationNetwork net(deviceID);
+    net.Load<ElemType>(modelPath);
+
+    size_t numPruned = net.PruneParameters<ElemType>(nodeNameRegex, sparsity, blockRows, blockCols);
+    fprintf(stderr, "DoParameterPruning: %d parameters were pruned.\n", (int) numPruned);
+    net.Save(outputModelPath);
+}
+
+template void DoParameterPruning<float>(const ConfigParameters& config);
+template void DoParameterPruning<double>(const ConfigParameters& config);
+
 // ===========================================================================
 // DoWriteWordAndClassInfo() - implements CNTK "writeWordAndClass" command
 // ===========================================================================
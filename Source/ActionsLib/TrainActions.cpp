@@ -19,6 +19,8 @@
 #include "SynchronousExecutionEngine.h"
 #include "ModelEditLanguage.h"
 #include "SGD.h"
+#include "SyntheticDataReader.h"
+#include "TrainingBenchmark.h"
 #include "Config.h"
 #include "SimpleEvaluator.h"
 #include "SimpleOutputWriter.h"
@@ -93,14 +95,21 @@ shared_ptr<C> CreateObject(const ConfigParameters& config, const wchar_t* id)
     return make_shared<C>(readerConfig);                           // old CNTK config specifies a dictionary which then must be explicitly instantiated
 }
 
-template <class ConfigRecordType, typename ElemType>
-void DoTrain(const ConfigRecordType& config)
+// the reader configuration as text, which identifies the data for the cache of precomputed statistics
+static wstring ReaderConfigKey(const ConfigParameters& config)
 {
-    bool makeMode = config(L"makeMode", true);
-    DEVICEID_TYPE deviceId = DeviceFromConfig(config);
+    return config.Exists(L"reader") ? (wstring) config(L"reader") : wstring();
+}
+static wstring ReaderConfigKey(const ScriptableObjects::IConfigRecord&)
+{
+    return wstring(); // BrainScript records cannot be printed; the cache is not used
+}
 
-    // determine the network-creation function
-    // We have several ways to create that network.
+// determine the network-creation function of the "train" and "benchmark" commands
+// We have several ways to create that network.
+template <class ConfigRecordType, typename ElemType>
+static function<ComputationNetworkPtr(DEVICEID_TYPE)> GetNetworkFactory(const ConfigRecordType& config, DEVICEID_TYPE deviceId)
+{
     function<ComputationNetworkPtr(DEVICEID_TYPE)> createNetworkFn;
 
     if (config.Exists(L"createNetwork"))
@@ -154,6 +163,16 @@ void DoTrain(const ConfigRecordType& config)
     {
         RuntimeError("No network builder found in the config file. NDLNetworkBuilder or SimpleNetworkBuilde must be specified");
     }
+    return createNetworkFn;
+}
+
+template <class ConfigRecordType, typename ElemType>
+void DoTrain(const ConfigRecordType& config)
+{
+    bool makeMode = config(L"makeMode", true);
+    DEVICEID_TYPE deviceId = DeviceFromConfig(config);
+
+    function<ComputationNetworkPtr(DEVICEID_TYPE)> createNetworkFn = GetNetworkFactory<ConfigRecordType, ElemType>(config, deviceId);
 
     auto dataReader = CreateObject<DataReader>(config, L"reader");
 
@@ -172,6 +191,7 @@ void DoTrain(const ConfigRecordType& config)
         optimizer = make_shared<SGD<ElemType>>(configSGD);
     }
 
+    optimizer->SetPreComputeCacheKey(ReaderConfigKey(config));
     optimizer->Train(createNetworkFn, deviceId, dataReader.get(), cvDataReader.get(), makeMode);
 }
 
@@ -210,6 +230,42 @@ template void DoTrain<ScriptableObjects::IConfigRecord, double>(const Scriptable
 template void DoTrain<ConfigParameters, float>(const ConfigParameters& config);
 template void DoTrain<ConfigParameters, double>(const ConfigParameters& config);
 
+// ===========================================================================
+// DoBenchmark() - implements CNTK "benchmark" command
+// Trains the network of a "train" command for warmupMinibatches + minibatches minibatches, and reports the
+// throughput of the latter, where their time went, and the peak memory. With syntheticData, the reader only
+// delivers the first syntheticMinibatches minibatches, which are then replayed from host memory.
+// ===========================================================================
+
+template <typename ElemType>
+void DoBenchmark(const ConfigParameters& config)
+{
+    DEVICEID_TYPE deviceId = DeviceFromConfig(config);
+    size_t numWarmupMBs = config(L"warmupMinibatches", (size_t) 10);
+    size_t numMeasuredMBs = config(L"minibatches", (size_t) 100);
+    bool isSyntheticData = config(L"syntheticData", false);
+    size_t numSyntheticMBs = config(L"syntheticMinibatches", (size_t) 16);
+    bool synchronizePhases = config(L"synchronizePhases", true);
+
+    function<ComputationNetworkPtr(DEVICEID_TYPE)> createNetworkFn = GetNetworkFactory<ConfigParameters, ElemType>(config, deviceId);
+
+    auto dataReader = CreateObject<DataReader>(config, L"reader");
+    // a loop of the synthetic reader lasts the whole benchmark, i.e. the benchmark stays within one epoch
+    unique_ptr<SyntheticDataReader<ElemType>> syntheticReader;
+    if (isSyntheticData)
+        syntheticReader.reset(new SyntheticDataReader<ElemType>(dataReader.get(), numSyntheticMBs, numWarmupMBs + numMeasuredMBs));
+
+    ConfigParameters configSGD(config(L"SGD"));
+    SGD<ElemType> sgd(configSGD);
+
+    TrainingBenchmark benchmark(numWarmupMBs, numMeasuredMBs, synchronizePhases, isSyntheticData);
+    sgd.Benchmark(createNetworkFn, deviceId, syntheticReader ? (IDataReader*) syntheticReader.get() : dataReader.get(), benchmark);
+    benchmark.PrintReport();
+}
+
+template void DoBenchmark<float>(const ConfigParameters& config);
+template void DoBenchmark<double>(const ConfigParameters& config);
+
 // ===========================================================================
 // DoAdapt() - implements CNTK "adapt" command
 // ===========================================================================
@@ -406,6 +406,23 @@ static map<wstring, InfixOps> infixOps =
 // thunked (delayed) evaluation
 // -----------------------------------------------------------------------
 
+// append a resolved number, string, or boolean to the memoization key of a function application
+// Returns false for anything else (unresolved values, records, nodes, ...), which makes the application not memoizable.
+static bool AppendPrimitiveToKey(const ConfigValuePtr &value, wstring &key)
+{
+    if (!value.IsResolved())
+        return false;
+    if (let d = dynamic_cast<const Double *>(value.get()))
+        key.append(wstrprintf(L"d%.17g;", (double) *d));
+    else if (let b = dynamic_cast<const Bool *>(value.get()))
+        key.append((bool) *b ? L"b1;" : L"b0;");
+    else if (let s = dynamic_cast<const String *>(value.get()))
+        key.append(wstrprintf(L"s%d:", (int) s->size())).append(*s).append(L";");
+    else
+        return false;
+    return true;
+}
+
 // create a lambda that calls Evaluate() on an expr to get or realize its value
 // Unresolved ConfigValuePtrs (i.e. containing a Thunk) may only be moved, not copied.
 static ConfigValuePtr MakeEvaluateThunkPtr(const ExpressionPtr &expr, const IConfigRecordPtr &scope, const wstring &exprPath, const wstring &exprId)
@@ -420,6 +437,22 @@ static ConfigValuePtr MakeEvaluateThunkPtr(const ExpressionPtr &expr, const ICon
     return ConfigValuePtr::MakeThunk(f, MakeFailFn(expr->location), exprPath);
 }
 
+// create the value of a function argument
+// Literals and references to variables that have already been resolved are passed as resolved values, since evaluating
+// them now or later makes no difference; this is what lets the lambda memoize pure applications. All others are thunked.
+static ConfigValuePtr MakeArgumentValuePtr(const ExpressionPtr &expr, const IConfigRecordPtr &scope, const wstring &exprPath, const wstring &exprId)
+{
+    if (expr->op == L"d" || expr->op == L"s" || expr->op == L"b")
+        return Evaluate(expr, scope, exprPath, exprId);
+    if (expr->op == L"id")
+    {
+        let p = scope->Find(expr->id);
+        if (p && p->IsResolved())
+            return *p;
+    }
+    return MakeEvaluateThunkPtr(expr, scope, exprPath, exprId);
+}
+
 // -----------------------------------------------------------------------
 // main evaluator function (highly recursive)
 // -----------------------------------------------------------------------
@@ -487,7 +520,11 @@ static ConfigValuePtr Evaluate(const ExpressionPtr &e, const IConfigRecordPtr &s
             if (argListExpr->op != L"()")
                 LogicError("parameter list expected");
             let &fnExpr = e->args[1]; // [1] = expression of the function itself
-            let f = [argListExpr, fnExpr, scope, exprPath](vector<ConfigValuePtr> &&args, ConfigLambda::NamedParams &&namedArgs, const wstring &callerExprPath) -> ConfigValuePtr
+            // Applications of this lambda whose arguments are all numbers, strings, or booleans, and whose result is one as well,
+            // are pure (nothing in the result can depend on side effects), so we remember their results. This avoids re-evaluating
+            // e.g. dimension computations inside a layer macro once for every instance of the layer.
+            let memo = make_shared<map<wstring, ConfigValuePtr>>();
+            let f = [argListExpr, fnExpr, scope, exprPath, memo](vector<ConfigValuePtr> &&args, ConfigLambda::NamedParams &&namedArgs, const wstring &callerExprPath) -> ConfigValuePtr
             {
                 // TODO: document namedArgs--does it have a parent scope? Or is it just a dictionary? Should we just use a shared_ptr<map,ConfigValuPtr>> instead for clarity?
                 // on exprName
@@ -496,6 +533,18 @@ static ConfigValuePtr Evaluate(const ExpressionPtr &e, const IConfigRecordPtr &s
                 let &argList = argListExpr->args;
                 if (args.size() != argList.size())
                     LogicError("function application with mismatching number of arguments");
+                wstring memoKey;
+                bool memoizable = true;
+                for (size_t i = 0; i < args.size() && memoizable; i++)
+                    memoizable = AppendPrimitiveToKey(args[i], memoKey);
+                for (auto namedArg = namedArgs.begin(); namedArg != namedArgs.end() && memoizable; namedArg++)
+                    memoizable = AppendPrimitiveToKey(namedArg->second, memoKey.append(namedArg->first).append(L"="));
+                if (memoizable)
+                {
+                    let cached = memo->find(memoKey);
+                    if (cached != memo->end())
+                        return ConfigValuePtr(cached->second, cached->second.GetFailFn(), callerExprPath);
+                }
                 // To execute a function body with passed arguments, we
                 //  - create a new scope that contains all positional and named args
                 //  - then evaluate the expression with that scope
@@ -531,7 +580,11 @@ static ConfigValuePtr Evaluate(const ExpressionPtr &e, const IConfigRecordPtr &s
                 if (pos != wstring::npos)
                     macroId.erase(0, pos + 1);
                 // now evaluate the function
-                return Evaluate(fnExpr, argScope, callerExprPath, L"" /*L"[" + macroId + L"]"*/); // bring args into scope; keep lex scope of '=>' as upwards chain
+                let value = Evaluate(fnExpr, argScope, callerExprPath, L"" /*L"[" + macroId + L"]"*/); // bring args into scope; keep lex scope of '=>' as upwards chain
+                wstring valueKey;
+                if (memoizable && AppendPrimitiveToKey(value, valueKey))
+                    memo->insert(make_pair(memoKey, value));
+                return value;
             };
             // positional args
             vector<wstring> paramNames;
@@ -574,7 +627,7 @@ static ConfigValuePtr Evaluate(const ExpressionPtr &e, const IConfigRecordPtr &s
             {
                 let argValExpr = args[i]; // expression to evaluate arg [i]
                 let argName = lambda->GetParamNames()[i];
-                argVals[i] = move(MakeEvaluateThunkPtr(argValExpr, scope, exprPath /*TODO??*/, /*onlyOneArg ? L"" :*/ argName));
+                argVals[i] = move(MakeArgumentValuePtr(argValExpr, scope, exprPath /*TODO??*/, /*onlyOneArg ? L"" :*/ argName));
                 // Make it a thunked value and pass by rvalue ref since unresolved ConfigValuePtrs may not be copied.
                 /*this wstrprintf should be gone, this is now the exprName*/
                 // Note on scope: macro arguments form a scope (ConfigRecord), the expression for an arg does not have access to that scope.
@@ -593,7 +646,7 @@ static ConfigValuePtr Evaluate(const ExpressionPtr &e, const IConfigRecordPtr &s
                 let id = namedArg.first;              // id of passed in named argument
                 let location = namedArg.second.first; // location of expression
                 let expr = namedArg.second.second;    // expression of named argument
-                namedArgVals[id] = move(MakeEvaluateThunkPtr(expr, scope, exprPath /*TODO??*/, id));
+                namedArgVals[id] = move(MakeArgumentValuePtr(expr, scope, exprPath /*TODO??*/, id));
                 // the thunk is evaluated when/if the passed actual value is ever used the first time
                 // This array owns the Thunk, and passes it by styd::move() to Apply, since it is not allowed to copy unresolved ConfigValuePtrs.
                 // Note on scope: same as above.
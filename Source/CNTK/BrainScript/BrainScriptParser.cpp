@@ -10,6 +10,7 @@
 #include <vector>
 #include <deque>
 #include <set>
+#include <map>
 #include <stdexcept>
 #include <algorithm>
 
@@ -936,9 +937,21 @@ static ExpressionPtr Parse(SourceFile&& sourceFile, vector<wstring>&& includePat
 {
     return Parser(move(sourceFile), move(includePaths)).ParseRecordMembersToDict();
 }
+// Parse trees are immutable, so parsing the same source again (e.g. the standard macros that are prepended to
+// every BrainScriptNetworkBuilder section, once per command) returns the earlier tree. This also keeps the text
+// from being added to the source-file map a second time.
 ExpressionPtr ParseConfigDictFromString(wstring text, vector<wstring>&& includePaths)
 {
-    return Parse(SourceFile(L"(command line)", text), move(includePaths));
+    static map<wstring, ExpressionPtr> parsed;
+    wstring key = text;
+    for (let& includePath : includePaths)
+        key.append(1, L'\0').append(includePath);
+    let cached = parsed.find(key);
+    if (cached != parsed.end())
+        return cached->second;
+    let expr = Parse(SourceFile(L"(command line)", text), move(includePaths));
+    parsed[key] = expr;
+    return expr;
 }
 ExpressionPtr ParseConfigDictFromFile(wstring path, vector<wstring>&& includePaths)
 {
@@ -50,6 +50,7 @@ L"ParameterTensor(dims, learningRateMultiplier = 1.0, init = 'uniform'/*|fixedVa
     L"RowSlice(startIndex, numRows, input, tag='') = new ComputationNode [ operation = 'RowSlice' ; inputs = input /*plus the function args*/ ]\n"
     L"RowRepeat(input, numRepeats, tag='') = new ComputationNode [ operation = 'RowRepeat' ; inputs = input /*plus the function args*/ ]\n"
     L"RowStack(inputs, tag='') = new ComputationNode [ operation = 'RowStack' /*plus the function args*/ ]\n"
+    L"StackFrames(input, numFrames, tag='') = new ComputationNode [ operation = 'StackFrames' ; inputs = input /*plus the function args*/ ]\n"
     L"Reshape(input, numRows, imageWidth = 0, imageHeight = 0, imageChannels = 0, tag='') = new ComputationNode [ operation = 'LegacyReshape' ; inputs = input /*plus the function args*/ ]\n"
     L"NewReshape(input, dims, beginDim=0, endDim=0, tag='') = new ComputationNode [ operation = 'Reshape' ; inputs = input ; shape = new TensorShape [ /*dims*/ ] /*plus the function args*/ ]\n"
     L"ReshapeDimension(x, dim, tensorShape) = NewReshape(x, tensorShape, beginDim=dim, endDim=dim + 1) \n"
@@ -62,9 +63,17 @@ L"ParameterTensor(dims, learningRateMultiplier = 1.0, init = 'uniform'/*|fixedVa
     L"Logistic(label, probability, tag='') = new ComputationNode [ operation = 'Logistic' ; inputs = (label : probability) /*plus the function args*/ ]\n"
     L"WeightedLogistic(label, probability, instanceWeight, tag='') = new ComputationNode [ operation = 'Logistic' ; inputs = (label : probability : instanceWeight) /*plus the function args*/ ]\n"
     L"ReconcileMBLayout(dataInput, layoutInput, tag='') = new ComputationNode [ operation = 'ReconcileMBLayout' ; inputs = (dataInput : layoutInput) /*plus the function args*/ ]\n"
-    L"Convolution(weightNode, inputValueNode, kernelWidth, kernelHeight, outputChannels, horizontalSubsample, verticalSubsample, zeroPadding = false, maxTempMemSizeInSamples = 0, imageLayout='CHW', tag='') = new ComputationNode [ operation = 'Convolution' ; inputs = (weightNode : inputValueNode) /*plus the function args*/ ]\n"
+    L"Convolution(weightNode, inputValueNode, kernelWidth, kernelHeight, outputChannels, horizontalSubsample, verticalSubsample, zeroPadding = false, maxTempMemSizeInSamples = 0, groups = 1, imageLayout='CHW', tag='') = new ComputationNode [ operation = 'Convolution' ; inputs = (weightNode : inputValueNode) /*plus the function args*/ ]\n"
     L"MaxPooling(input, windowWidth, windowHeight, horizontalSubsample, verticalSubsample, imageLayout='CHW', tag='') = new ComputationNode [ operation = 'MaxPooling' ; inputs = input /*plus the function args*/ ]\n"
     L"AveragePooling(input, windowWidth, windowHeight, horizontalSubsample, verticalSubsample, imageLayout='CHW', tag='') = new ComputationNode [ operation = 'AveragePooling' ; inputs = input /*plus the function args*/ ]\n"
+    L"SampledCrossEntropyWithSoftmax(labels, hidden, weights, bias, numSamples = 1024, tag='') = new ComputationNode [ operation = 'SampledCrossEntropyWithSoftmax' ; inputs = (labels : hidden : weights : bias) /*plus the function args*/ ]\n"
+    L"SampledCrossEntropyWithSoftmaxFromCounts(labels, hidden, weights, bias, classCounts, numSamples = 1024, tag='') = new ComputationNode [ operation = 'SampledCrossEntropyWithSoftmax' ; inputs = (labels : hidden : weights : bias : classCounts) /*plus the function args*/ ]\n"
+    L"NoiseContrastiveEstimation(labels, hidden, weights, bias, numNoiseSamples = 100, tag='') = new ComputationNode [ operation = 'NCEBasedCrossEntropyWithSoftmax' ; inputs = (labels : hidden : weights : bias) /*plus the function args*/ ]\n"
+    L"NoiseContrastiveEstimationFromCounts(labels, hidden, weights, bias, noiseCounts, numNoiseSamples = 100, tag='') = new ComputationNode [ operation = 'NCEBasedCrossEntropyWithSoftmax' ; inputs = (labels : hidden : weights : bias : noiseCounts) /*plus the function args*/ ]\n"
+    L"CTCWithSoftmax(labels, z, blankTokenId = 0, tag='') = new ComputationNode [ operation = 'CTCWithSoftmax' ; inputs = (labels : z) /*plus the function args*/ ]\n"
+    L"LatticeFreeMMI(labels, logLikelihoods, denominatorGraph, tag='') = new ComputationNode [ operation = 'LatticeFreeMMI' ; inputs = (labels : logLikelihoods) /*plus the function args*/ ]\n"
+    L"TemporalConvolution(weightNode, inputValueNode, kernelWidth, outputDim, dilation = 1, tag='') = new ComputationNode [ operation = 'TemporalConvolution' ; inputs = (weightNode : inputValueNode) /*plus the function args*/ ]\n"
+    L"OptimizedRNNStack(weights, input, hiddenDims, numLayers = 1, bidirectional = false, recurrentOp='lstm', engine='auto', tag='') = new ComputationNode [ operation = 'OptimizedRNNStack' ; inputs = (weights : input) /*plus the function args*/ ]\n"
     // TODO: define DelayedValue, with negative delay for future; cannot do this yet, need to be able to say something like delay = -(^.delay)
     // aliases
     L"ColumnwiseCrossProduct = KhatriRaoProduct // deprecated \n" // TODO: should it be deprecated? It is described as easier to understand in the CNTKBook.
@@ -113,6 +122,7 @@ L"ParameterTensor(dims, learningRateMultiplier = 1.0, init = 'uniform'/*|fixedVa
     UnaryStandardNode(RectifiedLinear, z)
     //BinaryStandardNode(RowElementTimesNode)
     BinaryStandardNode(Scale, scalarScalingFactor, matrix)
+    TernaryStandardNode(ScaledDotProductAttention, query, key, value)
 #ifdef COMING_SOON
     //BinaryStandardNode(SequenceDecoderNode)
 #endif
@@ -20,6 +20,10 @@
 #include "ModelEditLanguage.h"
 #include "CPUMatrix.h" // used for SetNumThreads()
 #include "CommonMatrix.h"
+#include "CUDACachingMemAllocator.h"
+#include "HostCachingMemAllocator.h"
+#include "TaskScheduler.h"
+#include "HostMemoryPlacement.h"
 #include "SGD.h"
 #include "MPIWrapper.h"
 #include "Config.h"
@@ -160,8 +164,9 @@ void DoCommands(const ConfigParameters& config)
 {
     ConfigArray command = config(L"command", "train");
 
+    // the cores not needed by the reader prefetch and aggregation tasks go to OpenMP and BLAS
     int numCPUThreads = config(L"numCPUThreads", "0");
-    numCPUThreads = CPUMatrix<ElemType>::SetNumThreads(numCPUThreads);
+    numCPUThreads = TaskScheduler::SetBudgets(numCPUThreads, config(L"numAggregationThreads", "1"), config(L"numPrefetchThreads", "2"));
 
     if (numCPUThreads > 0)
     {
@@ -242,6 +247,10 @@ void DoCommands(const ConfigParameters& config)
             {
                 DoAdapt<ElemType>(commandParams);
             }
+            else if (thisAction == "benchmark")
+            {
+                DoBenchmark<ElemType>(commandParams);
+            }
             else if (thisAction == "test" || thisAction == "eval")
             {
                 DoEval<ElemType>(commandParams);
@@ -258,6 +267,10 @@ void DoCommands(const ConfigParameters& config)
             {
                 DoWriteOutput<ElemType>(commandParams);
             }
+            else if (thisAction == "exportEmbeddings")
+            {
+                DoExportEmbeddings<ElemType>(commandParams);
+            }
             else if (thisAction == "devtest")
             {
                 TestCn<ElemType>(config); // for "devtest" action pass the root config instead
@@ -278,6 +291,14 @@ void DoCommands(const ConfigParameters& config)
             {
                 DoCreateLabelMap<ElemType>(commandParams);
             }
+            else if (thisAction == "convertToChunkedBinary")
+            {
+                DoConvertToChunkedBinary<ElemType>(commandParams);
+            }
+            else if (thisAction == "convertToBinaryLM")
+            {
+                DoConvertToBinaryLM<ElemType>(commandParams);
+            }
             else if (thisAction == "writeWordAndClass")
             {
                 DoWriteWordAndClassInfo<ElemType>(commandParams);
@@ -290,6 +311,10 @@ void DoCommands(const ConfigParameters& config)
             {
                 DoParameterSVD<ElemType>(commandParams);
             }
+            else if (thisAction == "prune")
+            {
+                DoParameterPruning<ElemType>(commandParams);
+            }
             else
             {
                 RuntimeError("unknown action: %s  in command set: %s", thisAction.c_str(), command[i].c_str());
@@ -465,6 +490,15 @@ int wmainWithBS(int argc, wchar_t* argv[]) // called from wmain which is a wrapp
     g_shareNodeValueMatrices = config(L"shareNodeValueMatrices", false);
 
     TracingGPUMemoryAllocator::SetTraceLevel(config(L"traceGPUMemoryAllocations", 0));
+    CUDACachingMemAllocator::SetEnabled(config(L"cacheGPUMemoryAllocations", true));
+    HostCachingMemAllocator::SetEnabled(config(L"cacheCPUMemoryAllocations", true));
+    HostCachingMemAllocator::SetHugePages(config(L"hugePages", L"none"));
+    GPUMathOptions::SetUseHalfPrecisionGemm(config(L"halfPrecisionGemm", false));
+    GPUMathOptions::SetConvolutionAlgoCacheFile(config(L"convolutionAlgoCacheFile", L""));
+    GPUMathOptions::SetLogImplicitDeviceSyncs(config(L"logImplicitDeviceSyncs", false));
+    GPUMathOptions::SetJitTensorKernels(config(L"jitTensorKernels", false));
+    GPUMathOptions::SetJitKernelCacheDir(config(L"jitKernelCacheDir", L""));
+    HostMemoryPlacement::SetMode(config(L"numaNode", L"none"));
 
     // logging
     wstring logpath = config(L"stderr", L"");
@@ -485,8 +519,9 @@ int wmainWithBS(int argc, wchar_t* argv[]) // called from wmain which is a wrapp
 
     // execute the actions
     // std::string type = config(L"precision", "float");
+    // the cores not needed by the reader prefetch and aggregation tasks go to OpenMP and BLAS
     int numCPUThreads = config(L"numCPUThreads", 0);
-    numCPUThreads = CPUMatrix<float /*any will do*/>::SetNumThreads(numCPUThreads);
+    numCPUThreads = TaskScheduler::SetBudgets(numCPUThreads, config(L"numAggregationThreads", (size_t) 1), config(L"numPrefetchThreads", (size_t) 2));
     if (numCPUThreads > 0)
         fprintf(stderr, "Using %d CPU threads.\n", numCPUThreads);
 
@@ -521,6 +556,11 @@ int wmainWithBS(int argc, wchar_t* argv[]) // called from wmain which is a wrapp
         fprintf(fp, "successfully finished at %s on %s\n", TimeDateStamp().c_str(), GetHostName().c_str());
         fcloseOrDie(fp);
     }
+    if (CUDACachingMemAllocator::IsEnabled())
+        CUDACachingMemAllocator::PrintStatisticsForAllDevices();
+    if (HostCachingMemAllocator::IsEnabled() && HostCachingMemAllocator::Instance().GetStatistics().m_numMallocs > 0)
+        HostCachingMemAllocator::Instance().PrintStatistics();
+
     fprintf(stderr, "COMPLETED\n"), fflush(stderr);
 
     delete g_mpi;
@@ -554,6 +594,15 @@ int wmainOldCNTKConfig(int argc, wchar_t* argv[]) // called from wmain which is
     g_shareNodeValueMatrices = config(L"shareNodeValueMatrices", false);
 
     TracingGPUMemoryAllocator::SetTraceLevel(config(L"traceGPUMemoryAllocations", 0));
+    CUDACachingMemAllocator::SetEnabled(config(L"cacheGPUMemoryAllocations", true));
+    HostCachingMemAllocator::SetEnabled(config(L"cacheCPUMemoryAllocations", true));
+    HostCachingMemAllocator::SetHugePages(config(L"hugePages", L"none"));
+    GPUMathOptions::SetUseHalfPrecisionGemm(config(L"halfPrecisionGemm", false));
+    GPUMathOptions::SetConvolutionAlgoCacheFile(config(L"convolutionAlgoCacheFile", L""));
+    GPUMathOptions::SetLogImplicitDeviceSyncs(config(L"logImplicitDeviceSyncs", false));
+    GPUMathOptions::SetJitTensorKernels(config(L"jitTensorKernels", false));
+    GPUMathOptions::SetJitKernelCacheDir(config(L"jitKernelCacheDir", L""));
+    HostMemoryPlacement::SetMode(config(L"numaNode", L"none"));
 
     if (logpath != L"")
     {
@@ -627,6 +676,11 @@ int wmainOldCNTKConfig(int argc, wchar_t* argv[]) // called from wmain which is
         fprintf(fp, "successfully finished at %s on %s\n", TimeDateStamp().c_str(), GetHostName().c_str());
         fcloseOrDie(fp);
     }
+    if (CUDACachingMemAllocator::IsEnabled())
+        CUDACachingMemAllocator::PrintStatisticsForAllDevices();
+    if (HostCachingMemAllocator::IsEnabled() && HostCachingMemAllocator::Instance().GetStatistics().m_numMallocs > 0)
+        HostCachingMemAllocator::Instance().PrintStatistics();
+
     fprintf(stderr, "COMPLETED\n"), fflush(stderr);
 
     delete g_mpi;
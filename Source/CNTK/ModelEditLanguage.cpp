@@ -59,7 +59,8 @@ enum MELProperty
     melPropEvaluation,
     melPropOutput,
     melPropRecurrent,
-    melPropBatchNormMode
+    melPropBatchNormMode,
+    melPropDeviceId
 };
 
 // SetProperty - Set the Property on the passed node
@@ -186,11 +187,13 @@ void MELScript<ElemType>::CallFunction(const std::string& p_name, const ConfigPa
     }
     else if (EqualInsensitive(name, "SaveDefaultModel"))
     {
-        size_t numFixedParams = 1, numOptionalParams = 1;
+        size_t numFixedParams = 1, numOptionalParams = 3;
         if (params.size() > numFixedParams + numOptionalParams || params.size() < numFixedParams)
-            RuntimeError("Invalid number of parameters. Valid parameters: SaveDefaultModel(modelFileName, [format=cntk]).");
+            RuntimeError("Invalid number of parameters. Valid parameters: SaveDefaultModel(modelFileName, [format=cntk], [compiledPlan=false], [alignParameters=false]).");
 
         std::wstring modelFormat = GetOptionalModelFormat(params, numFixedParams);
+        bool compiledPlan = GetOptionalFlag(params, numFixedParams, "compiledPlan");
+        bool alignParameters = GetOptionalFlag(params, numFixedParams, "alignParameters");
 
         std::wstring fileName = params[0];
 
@@ -200,15 +203,19 @@ void MELScript<ElemType>::CallFunction(const std::string& p_name, const ConfigPa
 
         // validate the network before we save it out
         ProcessNDLScript(m_netNdlDefault, ndlPassAll, true);
+        cn->SetSaveCompiledPlan(compiledPlan);
+        cn->SetSaveAlignedParameters(alignParameters);
         cn->SaveEdited(fileName);
     }
     else if (EqualInsensitive(name, "SaveModel"))
     {
-        size_t numFixedParams = 2, numOptionalParams = 1;
+        size_t numFixedParams = 2, numOptionalParams = 3;
         if (params.size() > numFixedParams + numOptionalParams || params.size() < numFixedParams)
-            RuntimeError("Invalid number of parameters. Valid parameters: SaveModel(modelName, modelFileName, [format=cntk]).");
+            RuntimeError("Invalid number of parameters. Valid parameters: SaveModel(modelName, modelFileName, [format=cntk], [compiledPlan=false], [alignParameters=false]).");
 
         std::wstring modelFormat = GetOptionalModelFormat(params, numFixedParams);
+        bool compiledPlan = GetOptionalFlag(params, numFixedParams, "compiledPlan");
+        bool alignParameters = GetOptionalFlag(params, numFixedParams, "alignParameters");
 
         std::string modelName = params[0];
         std::wstring fileName = params[1];
@@ -219,6 +226,8 @@ void MELScript<ElemType>::CallFunction(const std::string& p_name, const ConfigPa
 
         // validate and finish the second pass through NDL if any in-line NDL was defined
         ProcessNDLScript(netNdl, ndlPassAll, true);
+        netNdl->cn->SetSaveCompiledPlan(compiledPlan);
+        netNdl->cn->SetSaveAlignedParameters(alignParameters);
         netNdl->cn->SaveEdited(fileName);
     }
     else if (EqualInsensitive(name, "SetDefaultModel"))
@@ -448,6 +457,10 @@ void MELScript<ElemType>::CallFunction(const std::string& p_name, const ConfigPa
         {
             prop = melPropRecurrent;
         }
+        else if (EqualInsensitive(propName, "deviceId"))
+        {
+            prop = melPropDeviceId;
+        }
         else
         {
             RuntimeError("Invalid property, %s, is not supported", propName.c_str());
@@ -510,6 +523,11 @@ void MELScript<ElemType>::CallFunction(const std::string& p_name, const ConfigPa
                 // what to do here?
                 break;
             }
+            case melPropDeviceId:
+            {
+                cn->SetNodeDevice(node, (int) params[2]);
+                break;
+            }
             case melPropBatchNormMode:
             {
                 if (node->OperationName() != OperationNameOf(BatchNormalizationNode))
@@ -565,6 +583,10 @@ void MELScript<ElemType>::CallFunction(const std::string& p_name, const ConfigPa
         {
             prop = melPropBatchNormMode;
         }
+        else if (EqualInsensitive(propName, "deviceId"))
+        {
+            prop = melPropDeviceId;
+        }
         else
         {
             RuntimeError("Invalid property, %s, is not supported", propName.c_str());
@@ -599,6 +621,14 @@ void MELScript<ElemType>::CallFunction(const std::string& p_name, const ConfigPa
                 netNdl->cn->SetBatchNormalizationNodesBelowEvalMode(evalMode, node);
                 break;
             }
+            case melPropDeviceId:
+            {
+                // places the whole subgraph, e.g. one layer per GPU
+                DEVICEID_TYPE deviceId = (int) params[2];
+                for (auto& subTreeNode : node->EnumerateNodes())
+                    netNdl->cn->SetNodeDevice(subTreeNode, deviceId);
+                break;
+            }
             default:
             {
                 RuntimeError("Invalid property, %s, is not supported", propName.c_str());
@@ -657,6 +687,63 @@ void MELScript<ElemType>::CallFunction(const std::string& p_name, const ConfigPa
             netNdlFrom->cn->RenameNode(node, nodeName.second);
         }
     }
+    else if (EqualInsensitive(name, "FoldNormalization"))
+    {
+        size_t numFixedParams = 1, numOptionalParams = 0;
+        if (params.size() > numFixedParams + numOptionalParams || params.size() < numFixedParams)
+            RuntimeError("Invalid number of parameters. Valid parameters: FoldNormalization(modelName).");
+
+        std::string modelName = params[0];
+
+        NetNdl<ElemType>* netNdl = &m_mapNameToNetNdl[modelName];
+        if (netNdl->cn == NULL)
+            RuntimeError("FoldNormalization can only be called after a network has been setup, no active model named %s.", modelName.c_str());
+
+        ProcessNDLScript(netNdl, ndlPassAll, true);
+        netNdl->cn->CompileNetwork();
+        netNdl->cn->template FoldNormalizationIntoWeights<ElemType>();
+    }
+    else if (EqualInsensitive(name, "MergeEnsemble"))
+    {
+        // MergeEnsemble(newModelName, modelName1, modelName2, ..., [outputs=average|all]); the members are unloaded
+        bool averageOutputs = true;
+        vector<string> memberNames;
+        for (size_t i = 1; i < params.size(); i++)
+        {
+            std::string propName, value;
+            if (!OptionalParameter(params[i], propName, value))
+                memberNames.push_back(params[i]);
+            else if (EqualInsensitive(propName, "outputs") && (EqualInsensitive(value, "average") || EqualInsensitive(value, "all")))
+                averageOutputs = EqualInsensitive(value, "average");
+            else
+                RuntimeError("Invalid optional parameter %s, valid optional parameters: outputs=(average|all)", params[i].c_str());
+        }
+        if (memberNames.size() < 2)
+            RuntimeError("Invalid number of parameters. Valid parameters: MergeEnsemble(newModelName, modelName1, modelName2, ..., [outputs=average|all]).");
+
+        vector<ComputationNetworkPtr> members;
+        for (auto& modelName : memberNames)
+        {
+            auto found = m_mapNameToNetNdl.find(modelName);
+            if (found == m_mapNameToNetNdl.end() || found->second.cn == NULL)
+                RuntimeError("MergeEnsemble: No active model named %s.", modelName.c_str());
+            ProcessNDLScript(&found->second, ndlPassAll, true);
+            found->second.cn->CompileNetwork();
+            members.push_back(found->second.cn);
+        }
+
+        auto cn = make_shared<ComputationNetwork>(members[0]->GetDeviceId());
+        cn->template MergeEnsemble<ElemType>(members, averageOutputs);
+        for (auto& modelName : memberNames)
+        {
+            auto found = m_mapNameToNetNdl.find(modelName);
+            found->second.Clear();
+            if (&(found->second) == m_netNdlDefault)
+                m_netNdlDefault = nullptr;
+            m_mapNameToNetNdl.erase(found);
+        }
+        OverrideModelNameAndSetDefaultModel(cn, params[0]);
+    }
     else if (EqualInsensitive(name, "ReviseParameter"))
     {
         typedef LearnableParameter<ElemType> LearnableParameterNode;
@@ -461,9 +461,9 @@ public:
                         RuntimeError("Invalid optional parameter value %s, valid values are: format=(cntk)", value.c_str());
                     }
                 }
-                else
+                else if (!EqualInsensitive(propName, "compiledPlan") && !EqualInsensitive(propName, "alignParameters")) // see GetOptionalFlag()
                 {
-                    RuntimeError("Invalid optional parameter %s, valid optional parameters: format=(cntk)", propName.c_str());
+                    RuntimeError("Invalid optional parameter %s, valid optional parameters: format=(cntk), compiledPlan=(false|true), alignParameters=(false|true)", propName.c_str());
                 }
             }
         }
@@ -471,6 +471,21 @@ public:
         return modelFormat;
     }
 
+    // the optional flags of SaveModel, e.g. whether it writes the compiled plan (see ComputationNetwork::SaveCompiledPlan())
+    bool GetOptionalFlag(const ConfigParamList& params, const size_t numFixedParams, const char* flagName)
+    {
+        bool flag = false;
+        for (size_t paramNumber = params.size(); paramNumber > numFixedParams; paramNumber--)
+        {
+            // process optional parameter if it exists
+            std::string propName, value;
+            if (OptionalParameter(params[paramNumber - 1], propName, value) && EqualInsensitive(propName, flagName))
+                flag = ConfigValue(value);
+        }
+
+        return flag;
+    }
+
     std::string GetOptionalSnippetSection(const ConfigParamList& params, const size_t numFixedParams)
     {
         // process optional parameter if it exists
@@ -14,6 +14,7 @@
 #include "ConvolutionalNodes.h"
 #include "NonlinearityNodes.h"
 #include "ReshapingNodes.h"
+#include "SpecialPurposeNodes.h"
 #include "TensorShape.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
@@ -220,6 +221,23 @@ void SynchronousNodeEvaluator<ElemType>::Evaluate(NDLNode<ElemType>* node, const
             nodePtr = builder.RowRepeat(NULL, num_repeat, name);
         }
     }
+    else if (cnNodeType == OperationNameOf(StackFramesNode))
+    {
+        if (parameter.size() != 2)
+            RuntimeError("StackFrames should have two parameters. Usage: StackFrames(origNodeName, numFrames).");
+
+        nodeParamCount = 1;
+        nodeParamStart = 0;
+
+        if (pass == ndlPassInitial)
+        {
+            // evaluate only scalar parameters
+            vector<void*> params = EvaluateParameters(node, baseName, 0, parameter.size(), pass);
+            size_t numFrames = ((NDLNode<ElemType>*) params[1])->GetScalar();
+
+            nodePtr = builder.StackFrames(NULL, numFrames, name);
+        }
+    }
     else if (cnNodeType == OperationNameOf(DiagonalNode))
     {
         if (parameter.size() != 1)
@@ -290,7 +308,7 @@ void SynchronousNodeEvaluator<ElemType>::Evaluate(NDLNode<ElemType>* node, const
     else if (cnNodeType == OperationNameOf(ConvolutionNode))
     {
         if (parameter.size() != 7)
-            RuntimeError("%ls should have 7 fixed parameters[weightNodeName, inputValueNodeName, kernelWidth, kernelHeight, outputChannels,horizontalSubsample, verticalSubsample] and two optional parameters [zeroPadding = [false|yourvalue], maxTempMemSizeInSamples = [0|yourvalue], imageLayout = \"HWC\"|\"cudnn\"].", cnNodeType.c_str());
+            RuntimeError("%ls should have 7 fixed parameters[weightNodeName, inputValueNodeName, kernelWidth, kernelHeight, outputChannels,horizontalSubsample, verticalSubsample] and optional parameters [zeroPadding = [false|yourvalue], maxTempMemSizeInSamples = [0|yourvalue], imageLayout = \"HWC\"|\"cudnn\", groups = [1|yourvalue]].", cnNodeType.c_str());
 
         // setup the parameter position of children so we can hook them up later
         nodeParamCount = 2;
@@ -314,9 +332,110 @@ void SynchronousNodeEvaluator<ElemType>::Evaluate(NDLNode<ElemType>* node, const
             ImageLayoutKind imageLayoutKind = ImageLayoutKindFrom(node->GetOptionalParameter("imageLayout", "HWC"));
             bool zeroPadding = node->GetOptionalParameter("zeroPadding", "false");
             size_t maxTempMemSizeInSamples = node->GetOptionalParameter("maxTempMemSizeInSamples", "0");
+            size_t groups = node->GetOptionalParameter("groups", "1");
 
             nodePtr = builder.Convolution(NULL, NULL, kernelWidth, kernelHeight, outputChannels,
-                                          horizontalSubsample, verticalSubsample, imageLayoutKind, zeroPadding, maxTempMemSizeInSamples, name);
+                                          horizontalSubsample, verticalSubsample, imageLayoutKind, zeroPadding, maxTempMemSizeInSamples, groups, name);
+        }
+    }
+    else if (cnNodeType == OperationNameOf(TemporalConvolutionNode))
+    {
+        if (parameter.size() != 4)
+            RuntimeError("%ls should have 4 fixed parameters [weightNodeName, inputValueNodeName, kernelWidth, outputDim] and optional parameters [dilation = [1|yourvalue]].", cnNodeType.c_str());
+
+        // setup the parameter position of children so we can hook them up later
+        nodeParamCount = 2;
+        nodeParamStart = 0;
+
+        if (pass == ndlPassInitial)
+        {
+            int id = 2; // skip weightNode and inputValueNode
+
+            // evaluate only scalar parameters
+            vector<void*> params = EvaluateParameters(node, baseName, id, parameter.size() - id, pass);
+            id = 0; // reset counter because the params array starts at zero
+            size_t kernelWidth = ((NDLNode<ElemType>*) params[id++])->GetScalar();
+            size_t outputDim = ((NDLNode<ElemType>*) params[id++])->GetScalar();
+            assert(id == 2);
+
+            // optional
+            size_t dilation = node->GetOptionalParameter("dilation", "1");
+
+            nodePtr = builder.TemporalConvolution(NULL, NULL, kernelWidth, outputDim, dilation, name);
+        }
+    }
+    else if (cnNodeType == OperationNameOf(OptimizedRNNStackNode))
+    {
+        if (parameter.size() != 3)
+            RuntimeError("%ls should have 3 fixed parameters [weightNodeName, inputValueNodeName, hiddenDims] and optional parameters [numLayers = 1, bidirectional = false, recurrentOp = \"lstm\"|\"gru\"|\"rnnTanh\"|\"rnnReLU\", engine = \"auto\"|\"cudnn\"|\"cntk\"].", cnNodeType.c_str());
+
+        // setup the parameter position of children so we can hook them up later
+        nodeParamCount = 2;
+        nodeParamStart = 0;
+
+        if (pass == ndlPassInitial)
+        {
+            int id = 2; // skip weightNode and inputValueNode
+
+            // evaluate only scalar parameters
+            vector<void*> params = EvaluateParameters(node, baseName, id, parameter.size() - id, pass);
+            id = 0; // reset counter because the params array starts at zero
+            size_t hiddenDims = ((NDLNode<ElemType>*) params[id++])->GetScalar();
+            assert(id == 1);
+
+            // optional
+            size_t numLayers = node->GetOptionalParameter("numLayers", "1");
+            bool bidirectional = node->GetOptionalParameter("bidirectional", "false");
+            std::wstring recurrentOp = node->GetOptionalParameter("recurrentOp", "lstm");
+            std::wstring engine = node->GetOptionalParameter("engine", "auto");
+
+            nodePtr = builder.OptimizedRNNStack(NULL, NULL, hiddenDims, numLayers, bidirectional, RNNCellKindFrom(recurrentOp),
+                                                OptimizedRNNStackNode<ElemType>::RNNEngineKindFrom(engine), name);
+        }
+    }
+    else if (cnNodeType == OperationNameOf(SampledCrossEntropyWithSoftmaxNode))
+    {
+        if (parameter.size() != 4 && parameter.size() != 5)
+            RuntimeError("%ls should have 4 or 5 parameters [labels, hidden, weights, bias, optional classCounts] and the optional parameter [numSamples = 1024].", cnNodeType.c_str());
+
+        // all parameters are nodes
+        nodeParamCount = parameter.size();
+        nodeParamStart = 0;
+
+        if (pass == ndlPassInitial)
+        {
+            size_t numSamples = node->GetOptionalParameter("numSamples", "1024");
+            nodePtr = builder.SampledCrossEntropyWithSoftmax(NULL, NULL, NULL, NULL, NULL, numSamples, name);
+        }
+    }
+    else if (cnNodeType == OperationNameOf(CTCWithSoftmaxNode))
+    {
+        if (parameter.size() != 2)
+            RuntimeError("%ls should have 2 parameters [labels, z] and the parameter [blankTokenId = row of the blank in z].", cnNodeType.c_str());
+
+        // all parameters are nodes
+        nodeParamCount = parameter.size();
+        nodeParamStart = 0;
+
+        if (pass == ndlPassInitial)
+        {
+            size_t blankTokenId = node->GetOptionalParameter("blankTokenId", "0");
+            nodePtr = builder.CTCWithSoftmax(NULL, NULL, blankTokenId, name);
+        }
+    }
+    else if (cnNodeType == OperationNameOf(LatticeFreeMMINode))
+    {
+        if (parameter.size() != 2)
+            RuntimeError("%ls should have 2 parameters [labels, logLikelihoods] and the parameter [denominatorGraph = path of the graph in the text format of fstprint].", cnNodeType.c_str());
+
+        // all parameters are nodes
+        nodeParamCount = parameter.size();
+        nodeParamStart = 0;
+
+        if (pass == ndlPassInitial)
+        {
+            std::wstring denominatorGraph = node->GetOptionalParameter("denominatorGraph", "");
+            nodePtr = builder.LatticeFreeMMI(NULL, NULL, denominatorGraph, name);
         }
     }
     else if (cnNodeType == OperationNameOf(MaxPoolingNode))
@@ -470,7 +589,7 @@ void SynchronousNodeEvaluator<ElemType>::Evaluate(NDLNode<ElemType>* node, const
                 break;
             }
         }
-        // process common optional parameters (currently only "tag");
+        // process common optional parameters (currently "tag" and "deviceId");
         ProcessOptionalParameters(node);
         break;
     }
@@ -269,7 +269,14 @@ public:
         // loop through all the optional parameters processing them as necessary
         for (NDLNode<ElemType>* param : params)
         {
-            // we only process the "tag" optional parameter for now
+            // deviceId=N places the node on another device than the network (model parallelism)
+            if (EqualCI(param->GetName(), "deviceId"))
+            {
+                m_net->SetNodeDevice(compNode, (int) param->GetValue());
+                continue;
+            }
+
+            // otherwise we only process the "tag" optional parameter for now
             if (!EqualCI(param->GetName(), "tag"))
                 continue;
 
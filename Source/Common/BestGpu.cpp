@@ -47,7 +47,10 @@ int bestGPUDummy = 42; // put something into this CPP, as to avoid a linker warn
 #include <algorithm>
 
 #include <memory>
+#include <map>
 #include "CrossProcessMutex.h"
+#include "HostMemoryPlacement.h"
+#include "MPIWrapper.h"
 
 // ---------------------------------------------------------------------------
 // BestGpu class
@@ -65,6 +68,8 @@ struct ProcessorData
     size_t cudaTotalMem;
     bool cntkFound;
     int deviceId; // the deviceId (cuda side) for this processor
+    nvmlDevice_t nvmlDevice; // valid if nvmlDeviceFound
+    bool nvmlDeviceFound;
 };
 
 enum BestGpuFlags
@@ -91,11 +96,15 @@ private:
     BestGpuFlags m_lastFlags; // flag state at last query
     int m_lastCount;          // count of devices (with filtering of allowed Devices)
     std::vector<ProcessorData*> m_procData;
+    std::vector<double> m_linkScores; // [a * m_deviceCount + b] how well device a can copy to device b, see QueryTopology()
     int m_allowedDevices; // bitfield of allowed devices
     bool m_disallowCPUDevice;
     void GetCudaProperties();
     void GetNvmlData();
     void QueryNvmlData();
+    void QueryTopology();
+    double LinkScore(int deviceA, int deviceB) const;
+    std::vector<int> ChooseConnectedDevices(const std::vector<int>& candidates, const std::map<int, double>& scores, size_t number) const;
 
 public:
     BestGpu()
@@ -122,10 +131,46 @@ public:
     static const int AllDevices = -1;                                                         // can be used to specify all GPUs in GetDevices() call
     static const int RequeryDevices = -2;                                                     // Requery refreshing statistics and picking the same number as last query
     std::vector<int> GetDevices(int number = AllDevices, BestGpuFlags flags = bestGpuNormal); // get multiple devices
+    bool AllPeers(const std::vector<int>& devices) const;                                     // can all of these GPUs copy to each other directly?
 private:
     bool LockDevice(int deviceId, bool trial = true);
 };
 
+static LocalDeviceTopology s_localDeviceTopology;
+
+const LocalDeviceTopology& GetLocalDeviceTopology()
+{
+    return s_localDeviceTopology;
+}
+
+// SelectLocalDevices - With several MPI processes on a machine, the machine leader picks the devices of all of them at once,
+// so that they form a well connected set, and sends every process its device. Processes that do not get a GPU of their own share one.
+static DEVICEID_TYPE SelectLocalDevices(BestGpu& bestGpu, BestGpuFlags flags)
+{
+    int numLocalNodes = (int) g_mpi->NumLocalNodes();
+    std::vector<int> devices(numLocalNodes, CPUDEVICE);
+    if (g_mpi->IsMachineLeader())
+    {
+        std::vector<int> selected = bestGpu.GetDevices(numLocalNodes, flags);
+        if (selected.empty())
+            RuntimeError("Device selection: No eligible device found.");
+        for (int i = 0; i < numLocalNodes; i++)
+            devices[i] = selected[i % selected.size()];
+    }
+    MPI_Bcast(devices.data(), numLocalNodes, MPI_INT, 0, g_mpi->MachineCommunicator()) || MpiFail("SelectDevice: MPI_Bcast");
+
+    s_localDeviceTopology.m_devices.assign(devices.begin(), devices.end());
+    s_localDeviceTopology.m_allPeers = bestGpu.AllPeers(devices);
+    if (g_mpi->IsMachineLeader())
+    {
+        fprintf(stderr, "SelectDevice: devices of the %d processes on this machine:", numLocalNodes);
+        for (int device : devices)
+            fprintf(stderr, " %d", device);
+        fprintf(stderr, "%s\n", s_localDeviceTopology.m_allPeers ? " (all peers)" : "");
+    }
+    return devices[g_mpi->LocalNodeRank()];
+}
+
 // DeviceFromConfig - Parse 'deviceId' config parameter to determine what type of behavior is desired
 //Symbol - Meaning
 // 'auto' - automatically pick a single GPU based on ?BestGpu? score
@@ -158,13 +203,28 @@ static DEVICEID_TYPE SelectDevice(DEVICEID_TYPE deviceId, bool bLockGPU, const i
                 }
             }
 
-            bestDeviceId = (DEVICEID_TYPE)g_bestGpu->GetDevice(BestGpuFlags(bLockGPU ? (bestGpuAvoidSharing | bestGpuExclusiveLock) : bestGpuAvoidSharing));
+            BestGpuFlags flags = BestGpuFlags(bLockGPU ? (bestGpuAvoidSharing | bestGpuExclusiveLock) : bestGpuAvoidSharing);
+            if (g_mpi != nullptr && g_mpi->NumLocalNodes() > 1)
+                bestDeviceId = SelectLocalDevices(*g_bestGpu, flags);
+            else
+                bestDeviceId = (DEVICEID_TYPE)g_bestGpu->GetDevice(flags);
             // TODO: Do we need to hold this pointer at all? We will only query it once. Or is it used to hold lock to a GPU?
         }
         // already chosen
         deviceId = bestDeviceId;
     }
 
+    // the table of P2P-capable pairs, for copying matrices between GPUs
+    static bool peersDetected = false;
+    if (deviceId >= 0 && !peersDetected)
+    {
+        PeerAccess::DetectPeers();
+        peersDetected = true;
+    }
+
+    // with numaNode=auto, host memory and threads go to the GPU's NUMA node
+    HostMemoryPlacement::OnDeviceSelected(deviceId);
+
     return deviceId;
 }
 //#ifdef MATH_EXPORTS
@@ -292,6 +352,7 @@ void BestGpu::Init()
     {
         GetCudaProperties();
         GetNvmlData();
+        QueryTopology();
     }
     m_initialized = true;
 }
@@ -437,6 +498,7 @@ std::vector<int> BestGpu::GetDevices(int number, BestGpuFlags p_bestFlags)
         speedW *= 2;
     }
 
+    std::map<int, double> deviceScores;
     for (ProcessorData* pd : m_procData)
     {
         double score = 0.0;
@@ -454,6 +516,7 @@ std::vector<int> BestGpu::GetDevices(int number, BestGpuFlags p_bestFlags)
             mem = pd->cudaFreeMem / (double) pd->cudaTotalMem;
         score += mem * freeMemW;
         score += (pd->cntkFound ? 0 : 1) * mlAppRunningW;
+        deviceScores[pd->deviceId] = score;
         for (int i = 0; i < best.size(); i++)
         {
             // look for a better score
@@ -504,7 +567,11 @@ std::vector<int> BestGpu::GetDevices(int number, BestGpuFlags p_bestFlags)
         best = bestAndAvaialbe;
         if (best.size() > number)
         {
-            best.resize(number);
+            // for several devices, the links between them count as well
+            if (number > 1)
+                best = ChooseConnectedDevices(best, deviceScores, number);
+            else
+                best.resize(number);
         }
     }
 
@@ -564,6 +631,8 @@ void BestGpu::QueryNvmlData()
 
         if (curPd == NULL)
             continue;
+        curPd->nvmlDevice = device;
+        curPd->nvmlDeviceFound = true;
 
         // Get the memory usage, will only work for TCC drivers
         result = nvmlDeviceGetMemoryInfo(device, &memory);
@@ -626,6 +695,114 @@ void BestGpu::QueryNvmlData()
     return;
 }
 
+// QueryTopology - Rate how well every pair of GPUs is connected, from 1 (on the same board or behind the same PCIe switch)
+// down to 0 (no direct copies). The levels come from NVML where it reports the topology (Linux), otherwise all peers get 0.5.
+void BestGpu::QueryTopology()
+{
+    m_linkScores.assign(m_deviceCount * m_deviceCount, 0.0);
+    for (ProcessorData* a : m_procData)
+    {
+        for (ProcessorData* b : m_procData)
+        {
+            int canAccessPeer = 0;
+            if (a == b || cudaDeviceCanAccessPeer(&canAccessPeer, a->deviceId, b->deviceId) != cudaSuccess || !canAccessPeer)
+            {
+                cudaGetLastError(); // clear the error, if any
+                continue;
+            }
+
+            double score = 0.5;
+            nvmlGpuTopologyLevel_t level;
+            if (m_nvmlData && a->nvmlDeviceFound && b->nvmlDeviceFound &&
+                nvmlDeviceGetTopologyCommonAncestor(a->nvmlDevice, b->nvmlDevice, &level) == NVML_SUCCESS)
+            {
+                switch (level)
+                {
+                case NVML_TOPOLOGY_INTERNAL:
+                case NVML_TOPOLOGY_SINGLE:
+                    score = 1.0;
+                    break;
+                case NVML_TOPOLOGY_MULTIPLE:
+                    score = 0.75;
+                    break;
+                case NVML_TOPOLOGY_HOSTBRIDGE:
+                    score = 0.5;
+                    break;
+                default: // through the CPU, or across sockets
+                    score = 0.25;
+                    break;
+                }
+            }
+            m_linkScores[a->deviceId * m_deviceCount + b->deviceId] = score;
+        }
+    }
+}
+
+double BestGpu::LinkScore(int deviceA, int deviceB) const
+{
+    if (deviceA < 0 || deviceB < 0 || deviceA >= m_deviceCount || deviceB >= m_deviceCount)
+        return 0;
+    return std::min(m_linkScores[deviceA * m_deviceCount + deviceB], m_linkScores[deviceB * m_deviceCount + deviceA]);
+}
+
+// AllPeers - returns: true if every two different devices of the list can copy to each other directly
+bool BestGpu::AllPeers(const std::vector<int>& devices) const
+{
+    for (int a : devices)
+    {
+        for (int b : devices)
+        {
+            if (a != b && LinkScore(a, b) == 0)
+                return false;
+        }
+    }
+    return true;
+}
+
+// ChooseConnectedDevices - Pick 'number' of the candidates, trading their own scores against the links between them.
+// Each candidate is tried as the first device, the others are added greedily. The devices are returned in the order
+// they were added, so that neighbors in the list tend to be well connected.
+std::vector<int> BestGpu::ChooseConnectedDevices(const std::vector<int>& candidates, const std::map<int, double>& scores, size_t number) const
+{
+    assert(number > 1 && candidates.size() >= number);
+    const double topologyW = 0.5; // weight of the average link score of a device to the others in the set
+
+    std::vector<int> bestSet;
+    double bestValue = 0;
+    for (int first : candidates)
+    {
+        std::vector<int> set(1, first);
+        double value = scores.at(first);
+        while (set.size() < number)
+        {
+            int next = -1;
+            double nextGain = 0;
+            for (int device : candidates)
+            {
+                if (std::find(set.begin(), set.end(), device) != set.end())
+                    continue;
+                double links = 0;
+                for (int member : set)
+                    links += LinkScore(member, device);
+                double gain = scores.at(device) + topologyW * 2 * links / (number - 1);
+                if (next == -1 || gain > nextGain)
+                {
+                    next = device;
+                    nextGain = gain;
+                }
+            }
+            set.push_back(next);
+            value += nextGain;
+        }
+        if (bestSet.empty() || value > bestValue)
+        {
+            bestSet = set;
+            bestValue = value;
+        }
+    }
+    return bestSet;
+}
+
 bool BestGpu::LockDevice(int deviceId, bool trial)
 {
     if (deviceId < 0) // don't lock CPU, always return true
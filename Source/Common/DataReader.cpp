@@ -310,6 +310,14 @@ bool DataReader::DataEnd()
     return bRet;
 }
 
+bool DataReader::TakeStatistics(ReaderStatistics& statistics)
+{
+    bool bRet = false;
+    for (size_t i = 0; i < m_ioNames.size(); i++)
+        bRet |= m_dataReaders[m_ioNames[i]]->TakeStatistics(statistics);
+    return bRet;
+}
+
 // register SGD<> with the ScriptableObject system
 ScriptableObjects::ConfigurableRuntimeTypeRegister::Add<DataReader> registerDataReaderPlugin(L"DataReaderPlugin");
 
@@ -136,6 +136,90 @@ void Eval<ElemType>::ResetState()
     m_eval->ResetState();
 }
 
+// EvaluateConcurrent - Evaluate one independent sequence, batched with concurrent calls from other threads
+// inputs - map from node name to input vector
+// outputs - map from node name to output vector, resized to the number of frames of the inputs
+template <class ElemType>
+void Eval<ElemType>::EvaluateConcurrent(std::map<std::wstring, std::vector<ElemType>*>& inputs, std::map<std::wstring, std::vector<ElemType>*>& outputs)
+{
+    m_eval->EvaluateConcurrent(inputs, outputs);
+}
+
+// BindInput - Bind a caller-owned buffer to an input node, see EvaluateBound()
+// deviceId - -1 for host memory, otherwise the GPU of the model
+template <class ElemType>
+void Eval<ElemType>::BindInput(const std::wstring& nodeName, ElemType* buffer, size_t capacity, int deviceId)
+{
+    m_eval->BindInput(nodeName, buffer, capacity, deviceId);
+}
+
+// BindOutput - Bind a caller-owned buffer to an output node, see EvaluateBound()
+// deviceId - -1 for host memory, otherwise the GPU of the model
+template <class ElemType>
+void Eval<ElemType>::BindOutput(const std::wstring& nodeName, ElemType* buffer, size_t capacity, int deviceId)
+{
+    m_eval->BindOutput(nodeName, buffer, capacity, deviceId);
+}
+
+// EvaluateBound - Evaluate using the bound buffers
+// numSamples - number of samples in the input buffers
+template <class ElemType>
+void Eval<ElemType>::EvaluateBound(size_t numSamples)
+{
+    m_eval->EvaluateBound(numSamples);
+}
+
+// CreateStream - Create a handle for the recurrent state of one stream, see EvaluateStream()
+template <class ElemType>
+size_t Eval<ElemType>::CreateStream()
+{
+    return m_eval->CreateStream();
+}
+
+// DestroyStream - Release a stream and its recurrent state
+template <class ElemType>
+void Eval<ElemType>::DestroyStream(size_t stream)
+{
+    m_eval->DestroyStream(stream);
+}
+
+// EvaluateStream - Evaluate the next chunk of frames of a stream, batched with concurrent calls for other streams
+// inputs - map from node name to input vector
+// outputs - map from node name to output vector, resized to the number of frames of the inputs
+template <class ElemType>
+void Eval<ElemType>::EvaluateStream(size_t stream, std::map<std::wstring, std::vector<ElemType>*>& inputs, std::map<std::wstring, std::vector<ElemType>*>& outputs)
+{
+    m_eval->EvaluateStream(stream, inputs, outputs);
+}
+
+// EndStream - Evaluate the frames a latency-controlled stream holds back as right context, and start the stream over
+template <class ElemType>
+void Eval<ElemType>::EndStream(size_t stream, std::map<std::wstring, std::vector<ElemType>*>& outputs)
+{
+    m_eval->EndStream(stream, outputs);
+}
+
+// Warmup - Evaluate zeros in the largest expected shape once, see Eval.h
+template <class ElemType>
+void Eval<ElemType>::Warmup(size_t maxNumSequences, size_t maxSequenceLength)
+{
+    m_eval->Warmup(maxNumSequences, maxSequenceLength);
+}
+
+// EvaluateShortlist - Evaluate only the given rows of an output, see Eval.h
+template <class ElemType>
+void Eval<ElemType>::EvaluateShortlist(std::map<std::wstring, std::vector<ElemType>*>& inputs, const std::wstring& outputNodeName, const std::vector<size_t>& shortlist, std::vector<ElemType>& scores)
+{
+    m_eval->EvaluateShortlist(inputs, outputNodeName, shortlist, scores);
+}
+
+// EvaluateTopK - Evaluate an output, and return only its k largest values of each frame
+template <class ElemType>
+void Eval<ElemType>::EvaluateTopK(std::map<std::wstring, std::vector<ElemType>*>& inputs, const std::wstring& outputNodeName, size_t k, std::vector<size_t>& indices, std::vector<ElemType>& scores)
+{
+    m_eval->EvaluateTopK(inputs, outputNodeName, k, indices, scores);
+}
+
 //The explicit instantiation
 template class Eval<double>;
 template class Eval<float>;
@@ -14,12 +14,21 @@
 #include <string>
 #include <stdint.h>
 #include <locale>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <exception>
 #ifdef _WIN32
 #define NOMINMAX
 #include "Windows.h"
 #endif
 #ifdef __unix__
 #include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #endif
 
 namespace Microsoft { namespace MSR { namespace CNTK {
@@ -78,6 +87,8 @@ void File::Init(const wchar_t* filename, int fileOptions)
 {
     m_filename = filename;
     m_options = fileOptions;
+    m_mappedData = nullptr;
+    m_mappedSize = 0;
     if (m_filename.empty())
         RuntimeError("File: filename is empty");
     const auto outputPipe = (m_filename.front() == '|');
@@ -166,6 +177,9 @@ bool File::IsTextBased()
 // Note: this does not check for errors when the File corresponds to pipe stream. In this case, use Flush() before closing a file you are writing.
 File::~File(void)
 {
+    // blocks of a file being written that nobody flushed
+    if (!m_pendingBlocks.empty() && (m_options & fileOptionsWrite) && !std::uncaught_exception())
+        FinishAlignedBlocks();
     if (m_pcloseNeeded)
     {
         // TODO: Check for error code and throw if !std::uncaught_exception()     
@@ -181,9 +195,17 @@ File::~File(void)
 
 void File::Flush()
 {
+    FinishAlignedBlocks();
     fflushOrDie(m_file);
 }
 
+void File::Sync()
+{
+    FinishAlignedBlocks();
+    fflushOrDie(m_file);
+    fsyncOrDie(m_file);
+}
+
 // read a line
 // End of line is denoted by one of these, i.e. we don't support the old Mac OS convention of CR
 //  - LF
@@ -739,6 +761,208 @@ void File::SetPosition(uint64_t pos)
     fsetpos(m_file, pos);
 }
 
+// write an aligned block (see s_blockAlignment)
+void File::PutAlignedBlock(const void* data, size_t bytes)
+{
+    if (!WritesAlignedBlocks())
+        LogicError("File: PutAlignedBlock() requires a binary file opened with fileOptionsAlignedBlocks.");
+    uint64_t pos = GetPosition() + sizeof(uint64_t);
+    uint64_t offset = (pos + s_blockAlignment - 1) / s_blockAlignment * s_blockAlignment;
+    *this << offset;
+    vector<char> padding((size_t) (offset - pos), 0);
+    if (!padding.empty())
+        fwriteOrDie(padding.data(), 1, padding.size(), m_file);
+    fwriteOrDie(data, 1, bytes, m_file);
+}
+
+// read an aligned block into memory
+void File::GetAlignedBlock(void* data, size_t bytes)
+{
+    uint64_t offset;
+    *this >> offset;
+    SetPosition(offset);
+    freadOrDie(data, 1, bytes, m_file);
+}
+
+// write an aligned block that 'fill' puts into a buffer
+void File::PutAlignedBlock(size_t bytes, const function<void(void* buffer)>& fill)
+{
+    if (!WritesAlignedBlocks())
+        LogicError("File: PutAlignedBlock() requires a binary file opened with fileOptionsAlignedBlocks.");
+    if (!TransfersBlocksInParallel())
+    {
+        vector<char> buffer(bytes);
+        fill(buffer.data());
+        PutAlignedBlock(buffer.data(), bytes);
+        return;
+    }
+
+    // same layout as above, but the padding and the data are left as a hole for FinishAlignedBlocks() to fill
+    uint64_t pos = GetPosition() + sizeof(uint64_t);
+    uint64_t offset = (pos + s_blockAlignment - 1) / s_blockAlignment * s_blockAlignment;
+    *this << offset;
+    SetPosition(offset + bytes);
+    m_pendingBlocks.push_back(PendingAlignedBlock{ offset, bytes, fill });
+}
+
+// read an aligned block and pass it to 'take'
+void File::GetAlignedBlock(size_t bytes, const function<void(void* buffer)>& take)
+{
+    if (!TransfersBlocksInParallel())
+    {
+        vector<char> buffer(bytes);
+        GetAlignedBlock(buffer.data(), bytes);
+        take(buffer.data());
+        return;
+    }
+
+    uint64_t offset;
+    *this >> offset;
+    if (offset % s_blockAlignment != 0)
+        RuntimeError("File: invalid aligned block at offset %llu in '%ls'.", (unsigned long long) offset, m_filename.c_str());
+    SetPosition(offset + bytes);
+    m_pendingBlocks.push_back(PendingAlignedBlock{ offset, bytes, take });
+}
+
+void File::FinishAlignedBlocks()
+{
+    if (m_pendingBlocks.empty())
+        return;
+    vector<PendingAlignedBlock> blocks;
+    blocks.swap(m_pendingBlocks);
+
+    // the holes of the blocks must exist in the file before other handles write into them
+    const bool writing = !!(m_options & fileOptionsWrite);
+    if (writing)
+        fflushOrDie(m_file);
+
+    // largest first, so that no thread is left with a large block at the end
+    sort(blocks.begin(), blocks.end(), [](const PendingAlignedBlock& a, const PendingAlignedBlock& b)
+         {
+             return a.m_bytes > b.m_bytes;
+         });
+
+    atomic<size_t> nextBlock(0);
+    mutex errorMutex;
+    exception_ptr error;
+    auto transferBlocks = [&]()
+    {
+        try
+        {
+            unique_ptr<FILE, int (*)(FILE*)> f(fopenOrDie(m_filename, writing ? L"r+b" : L"rb"), fclose);
+            vector<char> buffer;
+            for (size_t i = nextBlock++; i < blocks.size(); i = nextBlock++)
+            {
+                const auto& block = blocks[i];
+                buffer.resize(block.m_bytes);
+                fsetpos(f.get(), block.m_offset);
+                if (writing)
+                {
+                    block.m_transfer(buffer.data());
+                    fwriteOrDie(buffer.data(), 1, block.m_bytes, f.get());
+                }
+                else
+                {
+                    freadOrDie(buffer.data(), 1, block.m_bytes, f.get());
+                    block.m_transfer(buffer.data());
+                }
+            }
+            if (writing)
+                fflushOrDie(f.get());
+        }
+        catch (...)
+        {
+            lock_guard<mutex> lock(errorMutex);
+            if (!error)
+                error = current_exception();
+            nextBlock = blocks.size(); // let the other threads stop early
+        }
+    };
+
+    const size_t numThreads = min(blocks.size(), (size_t) max(1u, min(thread::hardware_concurrency(), 8u)));
+    vector<thread> threads;
+    for (size_t i = 1; i < numThreads; i++)
+        threads.push_back(thread(transferBlocks));
+    transferBlocks();
+    for (auto& t : threads)
+        t.join();
+    if (error)
+        rethrow_exception(error);
+}
+
+// a copy-on-write mapping of a whole file
+// The mappings are never released, since matrices that do not own their buffer point into them.
+class FileMapping
+{
+public:
+    FileMapping(const wstring& path)
+        : m_data(nullptr), m_size(0)
+    {
+#ifdef _WIN32
+        HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+            RuntimeError("File: cannot open '%ls' for mapping (error %d).", path.c_str(), (int) GetLastError());
+        LARGE_INTEGER size;
+        HANDLE mapping = nullptr;
+        if (GetFileSizeEx(file, &size) && size.QuadPart > 0)
+        {
+            m_size = (size_t) size.QuadPart;
+            mapping = CreateFileMappingW(file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+            if (mapping)
+                m_data = (const char*) MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+        }
+        int error = (int) GetLastError();
+        if (mapping)
+            CloseHandle(mapping); // the view keeps the mapping open
+        CloseHandle(file);
+        if (!m_data)
+            RuntimeError("File: cannot map '%ls' (error %d).", path.c_str(), error);
+#else
+        int fileDescriptor = open(msra::strfun::utf8(path).c_str(), O_RDONLY);
+        if (fileDescriptor == -1)
+            RuntimeError("File: cannot open '%ls' for mapping: %s", path.c_str(), strerror(errno));
+        struct stat sb;
+        void* data = MAP_FAILED;
+        if (fstat(fileDescriptor, &sb) == 0 && sb.st_size > 0)
+        {
+            m_size = (size_t) sb.st_size;
+            data = mmap(nullptr, m_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fileDescriptor, 0);
+        }
+        int error = errno;
+        close(fileDescriptor); // the mapping keeps the file open
+        if (data == MAP_FAILED)
+            RuntimeError("File: cannot map '%ls': %s", path.c_str(), strerror(error));
+        m_data = (const char*) data;
+#endif
+    }
+
+    const char* m_data;
+    size_t m_size;
+};
+
+// map an aligned block (see s_blockAlignment)
+const void* File::MapAlignedBlock(size_t bytes)
+{
+    if (!MapsAlignedBlocks())
+        LogicError("File: MapAlignedBlock() requires a binary file opened with fileOptionsMapBlocks.");
+    if (!m_mappedData)
+    {
+        static mutex mappingsMutex;
+        static vector<unique_ptr<FileMapping>> mappings;
+        lock_guard<mutex> lock(mappingsMutex);
+        mappings.push_back(unique_ptr<FileMapping>(new FileMapping(m_filename)));
+        m_mappedData = mappings.back()->m_data;
+        m_mappedSize = mappings.back()->m_size;
+    }
+
+    uint64_t offset;
+    *this >> offset;
+    if (offset % s_blockAlignment != 0 || offset > m_mappedSize || bytes > m_mappedSize - offset)
+        RuntimeError("File: invalid aligned block at offset %llu in '%ls'.", (unsigned long long) offset, m_filename.c_str());
+    SetPosition(offset + bytes);
+    return m_mappedData + offset;
+}
+
 // Load matrix from file. The file is a simple text file consisting of one line per matrix row, where each line contains the elements of the row separated by white space.
 template <class ElemType>
 /*static*/ vector<ElemType> File::LoadMatrixFromTextFile(const std::wstring& filePath, size_t& /*out*/ numRows, size_t& /*out*/ numCols)
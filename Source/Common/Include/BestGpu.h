@@ -7,22 +7,39 @@
 
 // #define CPUONLY      // #define this to build without GPU support nor needing the SDK installed
 #include "CommonMatrix.h"
+#include <vector>
 
 // define IConfigRecord and ConfigParameters as incomplete types, in order to avoid having to include "ScriptableObjects.h" and "Config.h", as that confuses some .CU code
 namespace Microsoft { namespace MSR { namespace ScriptableObjects { struct IConfigRecord; }}}
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
+// The GPUs that the processes on this machine selected together with deviceId=auto, indexed by their local MPI rank.
+// The machine leader picks the set with the best interconnect (see BestGpu::GetDevices()); m_allPeers tells
+// whether all of them can copy to each other directly, which makes reductions within the machine cheap.
+// m_devices is empty if the device was not selected jointly.
+struct LocalDeviceTopology
+{
+    std::vector<DEVICEID_TYPE> m_devices;
+    bool m_allPeers = false;
+};
+
 #ifndef CPUONLY
 class ConfigParameters;
 DEVICEID_TYPE DeviceFromConfig(const ConfigParameters& config);
 DEVICEID_TYPE DeviceFromConfig(const ScriptableObjects::IConfigRecord& config);
+const LocalDeviceTopology& GetLocalDeviceTopology();
 #else
 template <class ConfigRecordType>
 static inline DEVICEID_TYPE DeviceFromConfig(const ConfigRecordType& /*config*/)
 {
     return -1 /*CPUDEVICE*/;
 } // tells runtime system to not try to use GPUs
+static inline const LocalDeviceTopology& GetLocalDeviceTopology()
+{
+    static LocalDeviceTopology none;
+    return none;
+}
 // TODO: find a way to use CPUDEVICE without a huge include overhead; OK so far since CPUONLY mode is sorta special...
 #endif
 
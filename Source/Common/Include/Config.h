@@ -978,9 +978,10 @@ public:
     {
         // find the value
         // TODO: unify with the Find() function below
+        const std::string key(name, name + wcslen(name));
         for (auto* dict = this; dict; dict = dict->m_parent)
         {
-            auto iter = dict->find(string(name, name + wcslen(name)));
+            auto iter = dict->find(key);
             if (iter != dict->end())
             {
                 if (iter->second == "default")
@@ -1124,6 +1125,11 @@ public:
     // returns: A copy of 'configString' with all the variables resolved.
     std::string ResolveVariables(const std::string& configString) const
     {
+        // most values hold neither variables nor comments nor line breaks; these come back unchanged,
+        // so skip splitting and copying them, which every Find() would otherwise pay for
+        if (configString.find_first_of("$#\n") == std::string::npos && (configString.empty() || configString.find_first_not_of(" \t") != std::string::npos))
+            return configString;
+
         std::string newConfigString;
         if (configString.find_first_of("\n") != std::string::npos)
         {
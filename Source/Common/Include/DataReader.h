@@ -90,6 +90,40 @@ public:
     void insert(std::pair<wstring, shared_ptr<MatrixBase>> pair) { matrices.insert(pair); }
 };
 
+// Counters of a reader pipeline, accumulated since they were last taken (IDataReader::TakeStatistics()).
+// Times are summed over the threads of the pipeline, so they can exceed the wall-clock time.
+struct ReaderStatistics
+{
+    double m_waitSeconds = 0;       // time GetMinibatch() was blocked on the next minibatch
+    size_t m_minibatches = 0;       // minibatches returned by GetMinibatch()
+    size_t m_readyMinibatches = 0;  // ... of which had already been prefetched when they were asked for
+    double m_chunkLoadSeconds = 0;  // time the deserializers took to load (page in) chunks
+    size_t m_chunks = 0;            // chunks the randomizers took
+    size_t m_readyChunks = 0;       // ... of which had already been loaded by the chunk prefetcher
+    size_t m_bytesRead = 0;         // bytes the deserializers read from files
+    double m_decodeSeconds = 0;     // time spent decoding sequences, e.g. compressed images
+    double m_transformSeconds = 0;  // time spent in the transformers
+    double m_packSeconds = 0;       // time the packers took to copy the sequences into minibatches
+    size_t m_packedColumns = 0;     // columns (parallel sequences x time steps) of the minibatches of the sequence packers
+    size_t m_gapColumns = 0;        // ... of which are gaps
+
+    void Add(const ReaderStatistics& other)
+    {
+        m_waitSeconds += other.m_waitSeconds;
+        m_minibatches += other.m_minibatches;
+        m_readyMinibatches += other.m_readyMinibatches;
+        m_chunkLoadSeconds += other.m_chunkLoadSeconds;
+        m_chunks += other.m_chunks;
+        m_readyChunks += other.m_readyChunks;
+        m_bytesRead += other.m_bytesRead;
+        m_decodeSeconds += other.m_decodeSeconds;
+        m_transformSeconds += other.m_transformSeconds;
+        m_packSeconds += other.m_packSeconds;
+        m_packedColumns += other.m_packedColumns;
+        m_gapColumns += other.m_gapColumns;
+    }
+};
+
 // Data Reader interface
 // implemented by DataReader and underlying classes
 class DATAREADER_API IDataReader
@@ -176,6 +210,13 @@ public:
         return false;
     }
 
+    // Adds the counters of the reader pipeline since the last call to 'statistics', and resets them.
+    // Returns false if the reader is not instrumented.
+    virtual bool TakeStatistics(ReaderStatistics& /*statistics*/)
+    {
+        return false;
+    }
+
     bool GetFrame(StreamMinibatchInputs& /*matrices*/, const size_t /*tidx*/, vector<size_t>& /*history*/)
     {
         NOT_IMPLEMENTED;
@@ -312,6 +353,10 @@ public:
     virtual bool GetData(const std::wstring& sectionName, size_t numRecords, void* data, size_t& dataBufferSize, size_t recordStart = 0);
 
     virtual bool DataEnd();
+
+    // Sums the statistics of the readers that are instrumented; returns false if none is.
+    virtual bool TakeStatistics(ReaderStatistics& statistics) override;
+
     // TODO: The return value if this is never used except in loops where we do an &=. It is not clear whether that is a bug or intentionally prevents DataEnd() from being called.
     //       Once this is understood, we can change the return value to void.
 
@@ -48,6 +48,17 @@ public:
     virtual void StartEvaluateMinibatchLoop(const std::wstring& outputNodeName) = 0;
     virtual void Evaluate(std::map<std::wstring, std::vector<ElemType>*>& inputs, std::map<std::wstring, std::vector<ElemType>*>& outputs) = 0;
     virtual void ResetState() = 0;
+    virtual void EvaluateConcurrent(std::map<std::wstring, std::vector<ElemType>*>& inputs, std::map<std::wstring, std::vector<ElemType>*>& outputs) = 0;
+    virtual void BindInput(const std::wstring& nodeName, ElemType* buffer, size_t capacity, int deviceId) = 0;
+    virtual void BindOutput(const std::wstring& nodeName, ElemType* buffer, size_t capacity, int deviceId) = 0;
+    virtual void EvaluateBound(size_t numSamples) = 0;
+    virtual size_t CreateStream() = 0;
+    virtual void DestroyStream(size_t stream) = 0;
+    virtual void EvaluateStream(size_t stream, std::map<std::wstring, std::vector<ElemType>*>& inputs, std::map<std::wstring, std::vector<ElemType>*>& outputs) = 0;
+    virtual void EndStream(size_t stream, std::map<std::wstring, std::vector<ElemType>*>& outputs) = 0;
+    virtual void Warmup(size_t maxNumSequences, size_t maxSequenceLength) = 0;
+    virtual void EvaluateShortlist(std::map<std::wstring, std::vector<ElemType>*>& inputs, const std::wstring& outputNodeName, const std::vector<size_t>& shortlist, std::vector<ElemType>& scores) = 0;
+    virtual void EvaluateTopK(std::map<std::wstring, std::vector<ElemType>*>& inputs, const std::wstring& outputNodeName, size_t k, std::vector<size_t>& indices, std::vector<ElemType>& scores) = 0;
 };
 
 // GetEval - get a evaluator type from the DLL
@@ -79,6 +90,9 @@ public:
     // deviceId=auto ( can be [0,all,cpu,0:2:3,auto] define accellerators (GPUs) to use, or the CPU
     // modelPath=c:\models\model.dnn (model path, if not specified, must call LoadModel() method before Evaluate()
     // minibatchSize=1024 (minibatch size used during evaluation if < passed data size)
+    // batchingMaxLatencyMs=2 (how long EvaluateConcurrent() waits for more requests to batch with)
+    // batchingMaxRequests=64 (maximum number of EvaluateConcurrent() requests per minibatch)
+    // streamRightContext=N (frames of right context of each chunk of latency-controlled streams, see EvaluateStream())
     Eval(const std::string& config);
     virtual ~Eval();
 
@@ -101,5 +115,65 @@ public:
     virtual void Evaluate(std::map<std::wstring, std::vector<ElemType>*>& inputs, std::map<std::wstring, std::vector<ElemType>*>& outputs);
     virtual void Init(const std::string& config);
     virtual void ResetState();
+
+    // EvaluateConcurrent - Evaluate one independent sequence; unlike Evaluate(), this may be called from many threads at once
+    // Concurrent calls are evaluated together in one minibatch, one parallel sequence per call. There is no state carried over between calls.
+    // inputs - map from node name to input vector
+    // outputs - map from node name to output vector, resized to the number of frames of the inputs
+    virtual void EvaluateConcurrent(std::map<std::wstring, std::vector<ElemType>*>& inputs, std::map<std::wstring, std::vector<ElemType>*>& outputs);
+
+    // BindInput, BindOutput - Bind a caller-owned buffer to a node once, for use by all following EvaluateBound() calls
+    // Binding the same node again replaces its buffer. The buffer must stay valid until it is rebound or the model is destroyed.
+    // buffer - column-major samples of the node's dimension; may be page-locked host memory
+    // capacity - number of elements the buffer can hold
+    // deviceId - -1 for host memory, otherwise the GPU of the model (then 'buffer' is device memory)
+    virtual void BindInput(const std::wstring& nodeName, ElemType* buffer, size_t capacity, int deviceId);
+    virtual void BindOutput(const std::wstring& nodeName, ElemType* buffer, size_t capacity, int deviceId);
+
+    // EvaluateBound - Evaluate the bound outputs from 'numSamples' samples in the bound input buffers, as one new sequence
+    // Inputs on the model's device are used in place; the outputs are copied straight into their buffers.
+    virtual void EvaluateBound(size_t numSamples);
+
+    // CreateStream - Create a handle for the recurrent state of one stream, e.g. a speech session that arrives in chunks
+    // DestroyStream - Release the handle and its state
+    virtual size_t CreateStream();
+    virtual void DestroyStream(size_t stream);
+
+    // EvaluateStream - Evaluate the next chunk of frames of a stream; PastValue nodes continue from the end of its previous chunk
+    // May be called from many threads at once; chunks of different streams are evaluated together in one minibatch.
+    // The chunks of one stream must be evaluated one after the other. Models with FutureValue nodes, e.g. BLSTMs, can only be
+    // streamed latency-controlled: with streamRightContext=N in the config, the last N frames of the frames given so far are only
+    // the right context of the chunk. Their outputs are returned with the next chunk, or by EndStream(). FutureValue nodes see
+    // each chunk and its right context as a whole sequence, while PastValue nodes continue from the end of the previous chunk.
+    // inputs - map from node name to input vector
+    // outputs - map from node name to output vector, resized to the number of frames of the inputs
+    //           (latency-controlled: to the number of frames of the chunk, which may be 0 for the first calls)
+    virtual void EvaluateStream(size_t stream, std::map<std::wstring, std::vector<ElemType>*>& inputs, std::map<std::wstring, std::vector<ElemType>*>& outputs);
+
+    // EndStream - Evaluate the frames of a latency-controlled stream that were held back as right context, and start the stream over
+    // outputs - map from node name to output vector, resized to the number of these frames (0 if not latency-controlled)
+    virtual void EndStream(size_t stream, std::map<std::wstring, std::vector<ElemType>*>& outputs);
+
+    // Warmup - Evaluate zeros in the largest expected shape once, before the first request
+    // This allocates the matrices at their largest size (they only grow, so smaller requests do not reallocate them)
+    // and selects the cuDNN algorithms, which otherwise makes the first requests many times slower.
+    // maxNumSequences - the largest number of sequences in one minibatch, e.g. batchingMaxRequests for EvaluateConcurrent()
+    // maxSequenceLength - the largest number of frames of a sequence
+    virtual void Warmup(size_t maxNumSequences, size_t maxSequenceLength);
+
+    // EvaluateShortlist - Evaluate only the given rows of an output whose last layer is a product with a weight parameter
+    // (Times or TransposeTimes, optionally plus a bias parameter, optionally followed by Softmax or LogSoftmax), e.g. the
+    // candidate words of a large vocabulary. Only the weights of the shortlist are multiplied.
+    // The scores are those of the layer before Softmax or LogSoftmax, i.e. unnormalized logits.
+    // inputs - map from node name to input vector
+    // outputNodeName - the output to score
+    // shortlist - the rows of the output to score, in any order
+    // scores - resized to [shortlist.size() x number of frames], column-major, in the order of the shortlist
+    virtual void EvaluateShortlist(std::map<std::wstring, std::vector<ElemType>*>& inputs, const std::wstring& outputNodeName, const std::vector<size_t>& shortlist, std::vector<ElemType>& scores);
+
+    // EvaluateTopK - Evaluate an output, and return only its k largest values of each frame
+    // The values are selected on the device of the model, so only these are copied back.
+    // indices, scores - resized to [k x number of frames], column-major, with the largest value of each frame first
+    virtual void EvaluateTopK(std::map<std::wstring, std::vector<ElemType>*>& inputs, const std::wstring& outputNodeName, size_t k, std::vector<size_t>& indices, std::vector<ElemType>& scores);
 };
 } } }
@@ -9,6 +9,7 @@
 #include <string>
 #include <vector>
 #include <stdint.h>
+#include <functional>
 #ifdef _WIN32
 #define NOMINMAX
 #include "Windows.h"
@@ -35,6 +36,10 @@ enum FileOptions
     fileOptionsWrite = 16,                                      // open in write mode
     fileOptionsSequential = 32,                                 // optimize for sequential reads (allocates big buffer)
     fileOptionsReadWrite = fileOptionsRead | fileOptionsWrite,  // read/write mode
+    fileOptionsAlignedBlocks = 64,                              // (binary, write) matrices are written as blocks aligned for memory mapping, see PutAlignedBlock()
+    fileOptionsMapBlocks = 128,                                 // (binary, read) aligned blocks are mapped copy-on-write instead of read, see MapAlignedBlock()
+    fileOptionsParallelBlocks = 256,                            // (binary) aligned blocks are written or read by several threads in FinishAlignedBlocks()
+    fileOptionsHalfMatrices = 512,                              // (binary, write) dense matrices are written in half precision, which halves their size but rounds them
 };
 
 // markers used for text files
@@ -99,6 +104,16 @@ private:
     bool m_pcloseNeeded; // was opened with popen(), use pclose() when destructing
     bool m_seekable;     // this stream is seekable
     int m_options;       // FileOptions ored togther
+    const char* m_mappedData; // mapping of the whole file, created by the first MapAlignedBlock()
+    size_t m_mappedSize;
+    // aligned blocks left for FinishAlignedBlocks(), with the function that fills (writing) or takes (reading) their data
+    struct PendingAlignedBlock
+    {
+        uint64_t m_offset;
+        size_t m_bytes;
+        std::function<void(void*)> m_transfer;
+    };
+    std::vector<PendingAlignedBlock> m_pendingBlocks;
     void Init(const wchar_t* filename, int fileOptions);
 
 public:
@@ -108,6 +123,7 @@ public:
     ~File();
 
     void Flush();
+    void Sync(); // flush, and wait until the data is on the disk
 
     bool CanSeek() const { return m_seekable; }
     size_t Size();
@@ -186,6 +202,55 @@ public:
         return *this;
     }
 
+    // put/get arrays of basic types, e.g. the elements of a matrix
+    // Binary files read and write them in one go, text files element by element.
+    template <typename T>
+    void PutArray(const T* data, size_t count)
+    {
+        if (IsTextBased())
+        {
+            for (size_t i = 0; i < count; i++)
+                *this << data[i];
+        }
+        else
+            fwriteOrDie(data, sizeof(T), count, m_file);
+    }
+    template <typename T>
+    void GetArray(T* data, size_t count)
+    {
+        if (IsTextBased())
+        {
+            for (size_t i = 0; i < count; i++)
+                *this >> data[i];
+        }
+        else
+            freadOrDie(data, sizeof(T), count, m_file);
+    }
+
+    // Aligned blocks are raw data at a file offset that is a multiple of s_blockAlignment, which is a multiple
+    // of the page size and of the Windows allocation granularity. So a reader can map them into memory instead of reading them.
+    // A block is stored as its offset, padding up to the offset, and the data.
+    static const size_t s_blockAlignment = 65536;
+    bool WritesAlignedBlocks() { return (m_options & fileOptionsAlignedBlocks) && !IsTextBased(); }
+    bool MapsAlignedBlocks() { return (m_options & fileOptionsMapBlocks) && !IsTextBased(); }
+    bool WritesHalfMatrices() { return (m_options & fileOptionsHalfMatrices) && !IsTextBased(); }
+    bool TransfersBlocksInParallel() { return (m_options & fileOptionsParallelBlocks) && !IsTextBased() && CanSeek(); }
+    void PutAlignedBlock(const void* data, size_t bytes);
+    void GetAlignedBlock(void* data, size_t bytes);
+    // variants that leave the transfer of the data to a function: 'fill' puts the block into a buffer, and 'take' gets it from one
+    // With fileOptionsParallelBlocks, only the offset is written or read here, and the functions are called by FinishAlignedBlocks(),
+    // so whatever they refer to must stay valid until then.
+    void PutAlignedBlock(size_t bytes, const std::function<void(void* buffer)>& fill);
+    void GetAlignedBlock(size_t bytes, const std::function<void(void* buffer)>& take);
+    // transfers the pending blocks, each through its own buffer, on several threads with their own handles of the file
+    // Copies from the GPU thus overlap with the disk accesses of the other blocks. Flush() and Sync() call this for files being written;
+    // readers must call it before they use what the blocks are read into.
+    void FinishAlignedBlocks();
+    // returns a pointer to the block in a copy-on-write mapping of the file, which stays valid for the lifetime of the process
+    // Pages are loaded on first access, and are shared through the page cache with other processes that map the same file,
+    // until they are written to.
+    const void* MapAlignedBlock(size_t bytes);
+
     void WriteString(const char* str, int size = 0);                   // zero terminated strings use size=0
     void ReadString(char* str, int size);                              // read up to size bytes, or a zero terminator (or space in text mode)
     void WriteString(const wchar_t* str, int size = 0);                // zero terminated strings use size=0
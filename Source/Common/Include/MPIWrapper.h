@@ -10,6 +10,8 @@
 #include <string>
 #include <array>
 #include <vector>
+#include <algorithm>
+#include <climits>
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -58,6 +60,14 @@ class MPIWrapper
     // MPI communicator that reflects the current subset selection
     MPI_Comm m_currentComm;
 
+    // Sub-communicators of m_currentComm for two-level collectives:
+    // the nodes on the same machine, and one leader per machine (MPI_COMM_NULL on the other nodes)
+    MPI_Comm m_machineComm;
+    MPI_Comm m_crossMachineComm;
+    size_t m_localNodeRank;
+    size_t m_numLocalNodes;
+    size_t m_numMachines;
+
     // MPI_Init() with delay-loading the msmpi.dll (possibly causing a failure if missing; we want to catch that)
     int MPI_Init_DL()
     {
@@ -106,7 +116,7 @@ class MPIWrapper
 
 public:
     MPIWrapper()
-        : m_currentComm(MPI_COMM_WORLD)
+        : m_currentComm(MPI_COMM_WORLD), m_machineComm(MPI_COMM_NULL), m_crossMachineComm(MPI_COMM_NULL), m_localNodeRank(0), m_numLocalNodes(1), m_numMachines(1)
     {
         static bool initialized = false;
         if (initialized)
@@ -180,6 +190,7 @@ public:
     void RequestNodes(const char *msg, size_t requestednodes = SIZE_MAX /*default: all*/)
     {
         Ping("requestnodes (before change)");
+        FreeMachineCommunicators();
 
 // undo current split
 #ifdef USE2NDCOMM
@@ -215,9 +226,126 @@ public:
                 msg, (int) m_numNodesInUse, (int) m_numMPINodes, (int) requestednodes,
                 (int) CurrentNodeRank(), IsIdle() ? "out (idle)" : "in (participating)");
         fflush(stderr);
+        CreateMachineCommunicators();
         Ping("requestnodes (after change)");
     }
 
+private:
+    // Splits the current communicator by the machines the nodes run on (the nodes that can share memory).
+    void CreateMachineCommunicators()
+    {
+        m_localNodeRank = 0;
+        m_numLocalNodes = 1;
+        m_numMachines = 1;
+        if (m_currentComm == MPI_COMM_NULL)
+            return;
+
+        int rank = 0;
+        MPI_Comm_rank(m_currentComm, &rank) || MpiFail("requestnodes: MPI_Comm_rank");
+        MPI_Comm_split_type(m_currentComm, MPI_COMM_TYPE_SHARED, rank, MPI_INFO_NULL, &m_machineComm) || MpiFail("requestnodes: MPI_Comm_split_type");
+
+        int localRank = 0;
+        int numLocalNodes = 1;
+        MPI_Comm_rank(m_machineComm, &localRank) || MpiFail("requestnodes: MPI_Comm_rank");
+        MPI_Comm_size(m_machineComm, &numLocalNodes) || MpiFail("requestnodes: MPI_Comm_size");
+        m_localNodeRank = localRank;
+        m_numLocalNodes = numLocalNodes;
+
+        MPI_Comm_split(m_currentComm, IsMachineLeader() ? 0 : MPI_UNDEFINED, rank, &m_crossMachineComm) || MpiFail("requestnodes: MPI_Comm_split");
+
+        // only the leaders know the number of machines, tell the others
+        int numMachines = 1;
+        if (IsMachineLeader())
+            MPI_Comm_size(m_crossMachineComm, &numMachines) || MpiFail("requestnodes: MPI_Comm_size");
+        MPI_Bcast(&numMachines, 1, MPI_INT, 0, m_machineComm) || MpiFail("requestnodes: MPI_Bcast");
+        m_numMachines = numMachines;
+
+        fprintf(stderr, "requestnodes: %d machines, we (%d) are node %d out of %d on our machine\n",
+                (int) m_numMachines, (int) CurrentNodeRank(), (int) m_localNodeRank, (int) m_numLocalNodes);
+        fflush(stderr);
+    }
+
+    void FreeMachineCommunicators()
+    {
+        if (m_crossMachineComm != MPI_COMM_NULL)
+            MPI_Comm_free(&m_crossMachineComm) || MpiFail("requestnodes: MPI_Comm_free");
+        if (m_machineComm != MPI_COMM_NULL)
+            MPI_Comm_free(&m_machineComm) || MpiFail("requestnodes: MPI_Comm_free");
+    }
+
+    // Replaces the current communicator by 'comm' (MPI_COMM_NULL on nodes that left). The communicators of a changed membership
+    // are disconnected rather than freed, so that nodes that left are no longer connected to the others and can finalize on their own.
+    void ReplaceCommunicator(MPI_Comm comm, const char *msg)
+    {
+        if (m_crossMachineComm != MPI_COMM_NULL)
+            MPI_Comm_disconnect(&m_crossMachineComm) || MpiFail("replacecommunicator: MPI_Comm_disconnect");
+        if (m_machineComm != MPI_COMM_NULL)
+            MPI_Comm_disconnect(&m_machineComm) || MpiFail("replacecommunicator: MPI_Comm_disconnect");
+        if (m_currentComm != MPI_COMM_WORLD)
+            MPI_Comm_disconnect(&m_currentComm) || MpiFail("replacecommunicator: MPI_Comm_disconnect");
+
+        m_currentComm = comm;
+        if (m_currentComm == MPI_COMM_NULL)
+        {
+            m_numNodesInUse = 0;
+            fprintf(stderr, "%s: we (%d) left the job\n", msg, (int) m_myRank);
+            fflush(stderr);
+            return;
+        }
+
+        MPI_Comm_rank(m_currentComm, &m_myRank) || MpiFail("replacecommunicator: MPI_Comm_rank");
+        MPI_Comm_size(m_currentComm, &m_numMPINodes) || MpiFail("replacecommunicator: MPI_Comm_size");
+        m_numNodesInUse = m_numMPINodes;
+        fprintf(stderr, "%s: we are now cog %d in a gearbox of %d\n", msg, (int) m_myRank, (int) m_numMPINodes);
+        fflush(stderr);
+        CreateMachineCommunicators();
+    }
+
+public:
+    // -----------------------------------------------------------------------
+    // elastic membership: nodes join the current ones through an MPI port, or leave them
+    // All nodes that share a communicator with a leaving one have to be in the calls, and only nodes
+    // of a changed membership may leave, which is why the nodes of elastic jobs are started as MPI singletons.
+    // -----------------------------------------------------------------------
+
+    // Adds the node that connects to 'port' (see ConnectToNodes()), collective over the current nodes.
+    // The new node gets the next rank, the ranks of the current nodes are kept.
+    void AcceptNode(const char *port)
+    {
+        MPI_Comm intercomm, merged;
+        MPI_Comm_accept(port, MPI_INFO_NULL, 0, m_currentComm, &intercomm) || MpiFail("acceptnode: MPI_Comm_accept");
+        MPI_Intercomm_merge(intercomm, 0 /*low*/, &merged) || MpiFail("acceptnode: MPI_Intercomm_merge");
+        MPI_Comm_disconnect(&intercomm) || MpiFail("acceptnode: MPI_Comm_disconnect");
+        ReplaceCommunicator(merged, "acceptnode");
+    }
+
+    // Joins the nodes that accept on 'port' (see AcceptNode()). Only for a node that is on its own.
+    void ConnectToNodes(const char *port)
+    {
+        if (m_numMPINodes != 1)
+            LogicError("ConnectToNodes: only a single node can join other nodes.");
+
+        MPI_Comm intercomm, merged;
+        MPI_Comm_connect(port, MPI_INFO_NULL, 0, MPI_COMM_SELF, &intercomm) || MpiFail("connecttonodes: MPI_Comm_connect");
+        MPI_Intercomm_merge(intercomm, 1 /*high*/, &merged) || MpiFail("connecttonodes: MPI_Intercomm_merge");
+        MPI_Comm_disconnect(&intercomm) || MpiFail("connecttonodes: MPI_Comm_disconnect");
+        ReplaceCommunicator(merged, "connecttonodes");
+    }
+
+    // Removes the nodes that do not stay, collective over the current nodes. Returns false on the nodes that left,
+    // which then have no communicator anymore. The remaining nodes keep their order.
+    bool RemoveNodes(bool stay)
+    {
+        if (m_currentComm == MPI_COMM_WORLD)
+            LogicError("RemoveNodes: nodes of the initial MPI job cannot leave it.");
+
+        MPI_Comm comm;
+        MPI_Comm_split(m_currentComm, stay ? 0 : MPI_UNDEFINED, m_myRank, &comm) || MpiFail("removenodes: MPI_Comm_split");
+        ReplaceCommunicator(comm, "removenodes");
+        return stay;
+    }
+
+
     MPI_Comm Communicator() const
     {
         return m_currentComm;
@@ -247,6 +375,33 @@ public:
         return 0;
     }
 
+    // nodes on the same machine as this one, including this one
+    MPI_Comm MachineCommunicator() const
+    {
+        return m_machineComm;
+    }
+    // one node per machine, the machine leaders; MPI_COMM_NULL on all other nodes
+    MPI_Comm CrossMachineCommunicator() const
+    {
+        return m_crossMachineComm;
+    }
+    size_t LocalNodeRank() const
+    {
+        return m_localNodeRank;
+    }
+    size_t NumLocalNodes() const
+    {
+        return m_numLocalNodes;
+    }
+    size_t NumMachines() const
+    {
+        return m_numMachines;
+    }
+    bool IsMachineLeader() const
+    {
+        return m_localNodeRank == 0;
+    } // the node that takes part in the collectives across machines
+
     // -----------------------------------------------------------------------
     // data-exchange functions (wrappers around MPI functions)
     // -----------------------------------------------------------------------
@@ -297,18 +452,60 @@ public:
         }
     }
 
+    // allreduce in two levels: reduce onto the leader of each machine, allreduce across the leaders, broadcast within each machine.
+    // Only the leaders send data across machines, which is what limits the collectives of flat allreduces with many nodes per machine.
+    template <class ElemType>
+    void HierarchicalAllReduce(ElemType *pData, size_t nData)
+    {
+        if ((NumNodesInUse() <= 1) || (Communicator() == MPI_COMM_NULL))
+            return;
+
+        // (the choice has to be the same on all nodes)
+        if ((m_numMachines == 1) || (m_numMachines == NumNodesInUse()))
+        {
+            AllReduce(pData, nData);
+            return;
+        }
+
+        MPI_Reduce(IsMachineLeader() ? MPI_IN_PLACE : pData, pData, (int) nData, GetDataType(pData), MPI_SUM, 0, m_machineComm) || MpiFail("HierarchicalAllReduce: MPI_Reduce");
+        if (IsMachineLeader())
+            MPI_Allreduce(MPI_IN_PLACE, pData, (int) nData, GetDataType(pData), MPI_SUM, m_crossMachineComm) || MpiFail("HierarchicalAllReduce: MPI_Allreduce");
+        MPI_Bcast(pData, (int) nData, GetDataType(pData), 0, m_machineComm) || MpiFail("HierarchicalAllReduce: MPI_Bcast");
+    }
+
     template <class ElemType>
     void Bcast(ElemType *pData, size_t nData, size_t srcRank)
     {
         if ((NumNodesInUse() > 1) && (Communicator() != MPI_COMM_NULL))
         {
-            MPI_Bcast(pData, (int) nData, GetDataType(pData), (int) srcRank, Communicator()) || MpiFail("Bcast: MPI_Bcast");
+            // MPI counts are ints, larger buffers (e.g. model files) are broadcast in pieces
+            for (size_t offset = 0; offset < nData; offset += INT_MAX)
+                MPI_Bcast(pData + offset, (int) std::min(nData - offset, (size_t) INT_MAX), GetDataType(pData), (int) srcRank, Communicator()) || MpiFail("Bcast: MPI_Bcast");
         }
     }
 
+    // point-to-point, for state that only one node holds
+    template <class ElemType>
+    void Send(ElemType *pData, size_t nData, size_t destRank, int tag = 0)
+    {
+        for (size_t offset = 0; offset < nData; offset += INT_MAX)
+            MPI_Send(pData + offset, (int) std::min(nData - offset, (size_t) INT_MAX), GetDataType(pData), (int) destRank, tag, Communicator()) || MpiFail("Send: MPI_Send");
+    }
+
+    template <class ElemType>
+    void Recv(ElemType *pData, size_t nData, size_t srcRank, int tag = 0)
+    {
+        for (size_t offset = 0; offset < nData; offset += INT_MAX)
+            MPI_Recv(pData + offset, (int) std::min(nData - offset, (size_t) INT_MAX), GetDataType(pData), (int) srcRank, tag, Communicator(), MPI_STATUS_IGNORE) || MpiFail("Recv: MPI_Recv");
+    }
+
     // wait for all ranks to reach here
     void WaitAll()
     {
+        // (nothing to wait for on nodes that left, see RemoveNodes())
+        if (m_currentComm == MPI_COMM_NULL)
+            return;
+
         MPI_Barrier(m_currentComm) || MpiFail("waitall: MPI_Barrier");
     }
 };
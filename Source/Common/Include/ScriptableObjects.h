@@ -425,6 +425,10 @@ public:
         }
         return *this; // return ourselves so we can access a value as p_resolved = p->ResolveValue()
     }
+    bool IsResolved() const
+    {
+        return !GetThunk();
+    }
     void EnsureIsResolved() const
     {
         if (GetThunk())
@@ -708,7 +712,9 @@ public:
         {
             const auto &id = namedParam.first;      // id of expected named parameter
             const auto valuei = namedArgs.find(id); // was such parameter passed?
-            if (valuei == namedArgs.end())          // named parameter not passed
+            if (valuei == namedArgs.end() && namedParam.second.IsResolved()) // default already computed by an earlier call: pass it as is
+                actualNamedArgs[id] = namedParam.second;
+            else if (valuei == namedArgs.end())     // named parameter not passed
             {                                       // if not given then fall back to default
                 auto f = [&namedParam]()            // we pass a lambda that resolves it upon first use, in our original location
                 {
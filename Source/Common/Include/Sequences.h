@@ -98,7 +98,7 @@ struct MBLayout
     // -------------------------------------------------------------------
 
     MBLayout(size_t numParallelSequences, size_t numTimeSteps)
-        : m_distanceToStart(CPUDEVICE), m_distanceToEnd(CPUDEVICE), m_columnsValidityMask(CPUDEVICE)
+        : m_columnsValidityMask(CPUDEVICE), m_pastBoundaryMask(CPUDEVICE), m_futureBoundaryMask(CPUDEVICE)
     {
         Init(numParallelSequences, numTimeSteps);
     }
@@ -127,12 +127,15 @@ public:
         // remember the dimensions
         m_numParallelSequences = numParallelSequences;
         m_numTimeSteps = numTimeSteps;
-        m_distanceToStart.Resize(m_numParallelSequences, m_numTimeSteps);
-        m_distanceToEnd.Resize(m_numParallelSequences, m_numTimeSteps);
+        m_distanceToStart.assign(GetNumCols(), 0);
+        m_distanceToEnd.assign(GetNumCols(), 0);
         m_distanceToNearestStart.assign(m_numTimeSteps, PTRDIFF_MAX);
         m_distanceToNearestEnd.assign(m_numTimeSteps, PTRDIFF_MAX);
         m_timeStepHasGap.assign(m_numTimeSteps, false);
         m_columnsValidityMask.Resize(0, 0); // invalidate
+        m_pastBoundaryMask.Resize(0, 0);
+        m_futureBoundaryMask.Resize(0, 0);
+        m_pastBoundaryMaskOffset = m_futureBoundaryMaskOffset = 0;
         // reset state
         m_numFramesDeclared = 0;
         m_numGapFrames = 0;
@@ -170,6 +173,7 @@ public:
     size_t GetActualNumSamples() const;
 
     const Matrix<char>& GetColumnsValidityMask(DEVICEID_TYPE deviceId) const;
+    const Matrix<char>& GetColumnsBoundaryMask(ptrdiff_t timeOffset, DEVICEID_TYPE deviceId) const;
 
     // compare whether two layouts are the same
     bool operator==(const MBLayout &other) const
@@ -234,7 +238,7 @@ public:
             for (size_t t = b; t < e; t++)
             {
                 m_timeStepHasGap[t] = true;
-                m_distanceToStart(s, t) = -1; // start flags also encode gaps
+                m_distanceToStart[Index(s, t)] = -1; // start flags also encode gaps
             }
         }
         else
@@ -244,8 +248,8 @@ public:
                 // If 0, then we are on a boundary. If not 0, we can still test in presence of FrameRange.m_timeOffset.
                 ptrdiff_t distanceToStart = (ptrdiff_t) t - beginTime;
                 ptrdiff_t distanceToEnd = (ptrdiff_t)(endTime - 1 - t);
-                m_distanceToStart(s, t) = (float) distanceToStart;
-                m_distanceToEnd(s, t) = (float) distanceToEnd;
+                m_distanceToStart[Index(s, t)] = distanceToStart;
+                m_distanceToEnd[Index(s, t)] = distanceToEnd;
                 // and the aggregate
                 if (m_distanceToNearestStart[t] > distanceToStart)
                     m_distanceToNearestStart[t] = distanceToStart;
@@ -276,8 +280,7 @@ public:
         m_numFramesDeclared = numSamples;
 
         // create all the cached fast-lookup information
-        m_distanceToStart.SetValue(0);
-        m_distanceToEnd.SetValue(0);
+        // (m_distanceToStart[] and m_distanceToEnd[] are already 0 from Init())
         m_distanceToNearestStart[0] = 0;
         m_distanceToNearestEnd[0] = 0;
 
@@ -346,6 +349,20 @@ private:
             LogicError("Modification attempted on a MBLayout that is no longer writable.");
     }
 
+    // index of (s,t) in the lookup tables, in the column order of the MB matrix
+    size_t Index(size_t s, size_t t) const
+    {
+        return t * m_numParallelSequences + s;
+    }
+
+    // upload a mask formed on the CPU, reusing the mask matrix's memory if it is already on that device
+    static void UploadColumnsMask(Matrix<char>& mask, vector<char>& values, DEVICEID_TYPE deviceId)
+    {
+        if (deviceId != mask.GetDeviceId())
+            mask = Matrix<char>(deviceId);
+        mask.SetValue(1, values.size(), deviceId, values.data());
+    }
+
     // Freeze the MBLayout disallowing further modifications through set operations
     void Lock() const
     {
@@ -388,7 +405,8 @@ private:
     //                              2  1  0  .  . ]          // (last two time steps undefined)
     // m_distanceToNearestStart = [ 0  1  2  3  4 ]
     // m_distanceToNearestEnd   = [ 2  1  0  1  0 ]
-    Matrix<float> m_distanceToStart, m_distanceToEnd;                   // (s,t); value<0 stands for gap
+    // The (s,t) tables are plain CPU arrays, stored column by column like the MB matrix, since they are queried per frame.
+    vector<ptrdiff_t> m_distanceToStart, m_distanceToEnd;               // [Index(s,t)]; value<0 stands for gap
     vector<ptrdiff_t> m_distanceToNearestStart, m_distanceToNearestEnd; // [t]    (does not store info about gaps; consult m_timeStepHasGap[] vector instead)
 
     vector<bool> m_timeStepHasGap; // [t] true if at least one gap in time step t
@@ -399,6 +417,13 @@ private:
     // and 0 indicates invalid (aka MinibatchPackingFlags::NoInput)
     mutable Matrix<char> m_columnsValidityMask;
 
+    // Cached masks indicating for each column whether it is a valid frame whose neighbor at a given time offset is
+    // still inside the same sequence (1), or a gap or a frame whose offset crosses a sequence boundary (0).
+    // Recurrent nodes use these to handle boundaries of all parallel sequences of a time step in one go.
+    // One mask is kept for a negative (past) and one for a positive (future) offset; both are built on first use and uploaded once.
+    mutable Matrix<char> m_pastBoundaryMask, m_futureBoundaryMask;
+    mutable ptrdiff_t m_pastBoundaryMaskOffset, m_futureBoundaryMaskOffset;
+
     // A boolean flag indicating whether the MBLayout can be further modified
     // When it's value is false, no set operations are allowed on the MBLayout.
     // Meant to guard in lazy creation of m_columnsValidityMask.
@@ -409,7 +434,7 @@ public:
     // special accessor for sequence training  --TODO: must be replaced by a different mechanism
     bool IsEnd(size_t s, size_t t) const
     {
-        auto distanceToStart = (ptrdiff_t) m_distanceToStart(s, t);
+        auto distanceToStart = m_distanceToStart[Index(s, t)];
 #if 1 // I don't exactly know what this does, so try assert() first
         assert(distanceToStart != -1);
         distanceToStart;
@@ -417,7 +442,7 @@ public:
         if (distanceToStart == -1) // indicates a gap
             return false;
 #endif
-        auto distanceToEnd = (size_t) m_distanceToEnd(s, t);
+        auto distanceToEnd = (size_t) m_distanceToEnd[Index(s, t)];
         return distanceToEnd == 0;
     }
 };
@@ -615,7 +640,7 @@ inline bool MBLayout::IsGap(const FrameRange &fr) const
         return m_timeStepHasGap[t];
 
     // determine flags from matrices
-    return m_distanceToStart(s, t) < 0; // value is -1 for gaps, non-negative otherwise
+    return m_distanceToStart[Index(s, t)] < 0; // value is -1 for gaps, non-negative otherwise
 }
 
 // test whether frame is exceeding the sentence boundaries
@@ -643,7 +668,7 @@ inline bool MBLayout::IsBeyondStartOrEnd(const FrameRange &fr) const
     }
 
     // determine flags from matrices
-    auto distanceToStart = (ptrdiff_t) m_distanceToStart(s, t);
+    auto distanceToStart = m_distanceToStart[Index(s, t)];
     if (distanceToStart == -1) // indicates a gap
     {
         assert(m_timeStepHasGap[t]);
@@ -653,7 +678,7 @@ inline bool MBLayout::IsBeyondStartOrEnd(const FrameRange &fr) const
     {
         if (distanceToStart < -fr.m_timeOffset)
             return true;
-        auto distanceToEnd = (ptrdiff_t) m_distanceToEnd(s, t);
+        auto distanceToEnd = m_distanceToEnd[Index(s, t)];
         if (distanceToEnd < fr.m_timeOffset)
             return true;
     }
@@ -665,48 +690,65 @@ inline size_t MBLayout::GetActualNumSamples() const { return m_numFramesDeclared
 
 // return m_columnsValidityMask(,), which is lazily created here upon first call
 // only called from MaskMissingColumnsTo()
-// TODO: Can probably be faster by using the sequence array directly.
-// TODO: Or should we just blast m_distanceToStart to GPU, and maks based on that? It is small compared to features.
 inline const Matrix<char> &MBLayout::GetColumnsValidityMask(DEVICEID_TYPE deviceId) const
 {
     CheckIsValid();
     // lazily compute the validity mask
-    if (m_columnsValidityMask.IsEmpty())
+    if (m_columnsValidityMask.IsEmpty() || m_columnsValidityMask.GetDeviceId() != deviceId)
     {
         assert(HasGaps()); // must only be called if there are gaps
         Lock();
 
-        // Determine indices of all invalid columns in the minibatch
-        // TODO: This can be done more efficiently by using m_sequences[].
+        // Determine indices of all invalid columns in the minibatch directly from the gap entries
         size_t nT = GetNumTimeSteps();
         size_t nS = GetNumParallelSequences();
 
         std::vector<char> columnsValidityMask(nT * nS, 1); // form the mask in a CPU-side STL vector first
         size_t gapsFound = 0;
-        for (size_t t = 0; t < nT; t++)
+        for (const auto &seq : m_sequences)
         {
-            FrameRange fr(nullptr, t);
-            if (IsGap(fr))
+            if (seq.seqId != GAP_SEQUENCE_ID)
+                continue;
+            for (size_t t = (size_t) max(seq.tBegin, (ptrdiff_t) 0); t < min(seq.tEnd, nT); t++)
             {
-                for (size_t s = 0; s < nS; s++)
-                {
-                    if (IsGap(fr.Sequence(s)))
-                    {
-                        columnsValidityMask[(t * nS) + s] = 0;
-                        gapsFound++;
-                    }
-                }
+                columnsValidityMask[Index(seq.s, t)] = 0;
+                gapsFound++;
             }
         }
         assert(gapsFound == m_numGapFrames); // sanity check
+        gapsFound;
 
-        if (deviceId != m_columnsValidityMask.GetDeviceId())
-            m_columnsValidityMask = Matrix<char>(deviceId);
-        m_columnsValidityMask.SetValue(1, nS * nT, deviceId, columnsValidityMask.data());
+        UploadColumnsMask(m_columnsValidityMask, columnsValidityMask, deviceId);
     }
     return m_columnsValidityMask;
 }
 
+// return a mask that is 1 for every frame (s,t) that is not a gap and for which (s,t + timeOffset) is inside the same sequence,
+// i.e. for which IsBeyondStartOrEnd() with that offset is false; lazily created here upon first call
+// Used by recurrent nodes to process a time step with sequence boundaries for all parallel sequences at once.
+inline const Matrix<char> &MBLayout::GetColumnsBoundaryMask(ptrdiff_t timeOffset, DEVICEID_TYPE deviceId) const
+{
+    CheckIsValid();
+    if (timeOffset == 0)
+        LogicError("GetColumnsBoundaryMask: A time offset of 0 never crosses a boundary.");
+    auto &mask = timeOffset < 0 ? m_pastBoundaryMask : m_futureBoundaryMask;
+    auto &maskOffset = timeOffset < 0 ? m_pastBoundaryMaskOffset : m_futureBoundaryMaskOffset;
+    if (mask.IsEmpty() || maskOffset != timeOffset || mask.GetDeviceId() != deviceId)
+    {
+        Lock();
+
+        std::vector<char> boundaryMask(GetNumCols());
+        for (size_t i = 0; i < boundaryMask.size(); i++)
+        {
+            auto distanceToStart = m_distanceToStart[i];
+            boundaryMask[i] = distanceToStart >= 0 && distanceToStart >= -timeOffset && m_distanceToEnd[i] >= timeOffset;
+        }
+        UploadColumnsMask(mask, boundaryMask, deviceId);
+        maskOffset = timeOffset;
+    }
+    return mask;
+}
+
 // class for defining an iteration over a sequence, forward and backward
 // One day, we may also have nested structures. For those, FrameRangeIterations will be able to be instantiated from FrameRange objects to loop over their nested dimension.
 class FrameRangeIteration
@@ -133,6 +133,12 @@ void fprintfOrDie(FILE* f, const char* format, ...);
 
 void fflushOrDie(FILE* f);
 
+// ----------------------------------------------------------------------------
+// fsyncOrDie(): like fsync() but terminate with err msg in case of error
+// ----------------------------------------------------------------------------
+
+void fsyncOrDie(FILE* f);
+
 // ----------------------------------------------------------------------------
 // filesize(): determine size of the file in bytes
 // ----------------------------------------------------------------------------
@@ -156,6 +162,16 @@ long fseekOrDie(FILE* f, long offset, int mode = SEEK_SET);
 uint64_t fgetpos(FILE* f);
 void fsetpos(FILE* f, uint64_t pos);
 
+// ----------------------------------------------------------------------------
+// freadBlocksOrDie(): read 'size' bytes at 'offset' of a file, bypassing stdio
+// The range is split into large blocks that are all read concurrently (pread() from
+// several threads on Linux, overlapped ReadFile() on Windows), so that a whole chunk
+// of a corpus is requested from the device at once. With 'direct', the OS file cache
+// is bypassed (O_DIRECT, FILE_FLAG_NO_BUFFERING) where the file system supports it.
+// ----------------------------------------------------------------------------
+
+void freadBlocksOrDie(const std::wstring& pathname, uint64_t offset, size_t size, void* buffer, bool direct = false);
+
 // ----------------------------------------------------------------------------
 // unlinkOrDie(): unlink() with error handling
 // ----------------------------------------------------------------------------
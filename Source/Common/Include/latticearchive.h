@@ -24,6 +24,9 @@
 #include <algorithm> // for find()
 #include "simplesenonehmm.h"
 #include "Matrix.h"
+#include "MemoryMappedFile.h"
+#include <memory>
+#include <string.h>
 
 namespace msra { namespace math {
 
@@ -37,7 +40,7 @@ class ssematrixstriperef;
 
 namespace msra { namespace lm {
 
-class CMGramLM;
+class ILM;
 class CSymbolSet;
 };
 }; // for numer-lattice building
@@ -86,6 +89,7 @@ class lattice
         }
     };
     header_v1_v2 info;                           // information about the lattice
+    static_assert(sizeof(header_v1_v2) == 32, "unexpected size of header_v1_v2"); // V3 records keep their arrays 8-byte aligned
     static const unsigned int NOEDGE = 0xffffff; // 24 bits
     // static_assert (sizeof (nodeinfo) == 8, "unexpected size of nodeeinfo"); // note: int64_t required to allow going across 32-bit boundary
     // ensure type size as these are expected to be of this size in the files we read
@@ -718,6 +722,9 @@ private:
                            const msra::math::ssematrixbase& logLLs, msra::math::ssematrixbase& gammas,
                            size_t edgeindex, const bool returnsenoneids, array_ref<unsigned short> thisedgealignments);
 
+    static void aligntoreference(const msra::asr::simplesenonehmm& hset, const msra::math::ssematrixbase& logLLs,
+                                 array_ref<size_t>& uids, const_array_ref<size_t> bounds);
+
     const_array_ref<aligninfo> getaligninfo(size_t j) const
     {
         size_t begin = (size_t) edges[j].firstalign;
@@ -767,7 +774,7 @@ public:
 
     // construct from an MLF file (numerator lattice)
     void frommlf(const std::wstring& key, const std::unordered_map<std::string, size_t>& unitmap, const msra::asr::htkmlfreader<msra::asr::htkmlfentry, lattice::htkmlfwordsequence>& labels,
-                 const msra::lm::CMGramLM& lm, const msra::lm::CSymbolSet& unigramsymbols);
+                 const msra::lm::ILM& lm, const msra::lm::CSymbolSet& unigramsymbols);
 
     // check consistency
     //  - only one end node
@@ -938,6 +945,32 @@ public:
 #endif
     }
 
+    // write in the compacted format
+    // V3 stores nodes[], edges[] and align[] as they are used by forward-backward (i.e. as after rebuildedges()), so that
+    // reading is a copy and nothing needs to be rebuilt. Each array is padded to 8 bytes, as is the record, so that a
+    // memory-mapped archive can be read in place (see archive::getlattice()).
+    void fwritecompacted(FILE* f)
+    {
+        const size_t version = 3; // format version
+        fwritetag(f, "LAT ", version);
+        fwriteOrDie(&info, sizeof(info), 1, f);
+        fwritealignedvector(f, "NODE", nodes);
+        fwritealignedvector(f, "EDGE", edges);
+        fwritealignedvector(f, "ALIG", align);
+        fputTag(f, "END ");
+        fputint(f, 0); // padding
+    }
+
+    template <class VECTOR>
+    void fwritealignedvector(FILE* f, const char* tag, const VECTOR& v)
+    {
+        static const char zeros[8] = {0};
+        fwritevector(f, tag, v);
+        const size_t bytes = v.size() * sizeof(v[0]);
+        if (bytes % 8 != 0)
+            fwriteOrDie(zeros, 1, 8 - bytes % 8, f);
+    }
+
     // empty constructor, e.g. for use in minibatch source
     lattice()
     {
@@ -958,6 +991,75 @@ public:
         freadOrDie(v, sz, f);
     }
 
+    template <class VECTOR>
+    void freadalignedvector(FILE* f, const char* tag, VECTOR& v, size_t expectedsize = SIZE_MAX)
+    {
+        char padding[8];
+        freadvector(f, tag, v, expectedsize);
+        const size_t bytes = v.size() * sizeof(v[0]);
+        if (bytes % 8 != 0)
+            freadOrDie(padding, 1, 8 - bytes % 8, f);
+    }
+
+    // same as freadalignedvector() for a record in memory; returns the position after the vector
+    template <class VECTOR>
+    static const char* getalignedvector(const char* p, const char* end, const char* tag, VECTOR& v, size_t expectedsize = SIZE_MAX)
+    {
+        if (end - p < 8 || memcmp(p, tag, 4) != 0)
+            RuntimeError("getalignedvector: malformed record, tag %s expected", tag);
+        const size_t sz = (unsigned int) *(const int*) (p + 4);
+        if (expectedsize != SIZE_MAX && sz != expectedsize)
+            RuntimeError("getalignedvector: malformed record, number of vector elements differs from head, for tag %s", tag);
+        p += 8;
+        const size_t bytes = sz * sizeof(v[0]);
+        const size_t paddedbytes = (bytes + 7) & ~(size_t) 7;
+        if ((size_t) (end - p) < paddedbytes)
+            RuntimeError("getalignedvector: record ends within the vector for tag %s", tag);
+        typedef typename VECTOR::value_type T;
+        v.assign((const T*) p, (const T*) p + sz);
+        return p + paddedbytes;
+    }
+
+    // whether unit ids of the archive must be mapped to the user's symbol table
+    template <class IDMAP>
+    static bool needsidmapping(const IDMAP& idmap, size_t spunit)
+    {
+        // This is critical--we have a buggy lattice set that requires no mapping where mapping would fail
+        foreach_index (k, idmap)
+        {
+            if (idmap[k] != (size_t) k
+#if 1
+                && (k != (int) idmap.size() - 1 || idmap[k] != spunit) // that HACK that we add one more /sp/ entry at the end...
+#endif
+                )
+                return true;
+        }
+        return false;
+    }
+
+    // map the units of a V3 lattice that was just read; it needs nothing else, the arrays are in their final form
+    template <class IDMAP>
+    void finishcompacted(const IDMAP& idmap, size_t spunit)
+    {
+        if (nodes.empty() || nodes.back().t != info.numframes)
+            RuntimeError("fread: mismatch between info.numframes and last node's time");
+        if (info.impliedspunitid != SIZE_MAX && info.impliedspunitid != INT_MAX && info.impliedspunitid >= idmap.size())
+            RuntimeError("fread: out of bounds spunitid");
+        if (needsidmapping(idmap, spunit))
+        {
+            if (info.impliedspunitid != SIZE_MAX && info.impliedspunitid != INT_MAX)
+                info.impliedspunitid = idmap[info.impliedspunitid];
+            foreach_index (k, align)
+            {
+                if (align[k].unit >= idmap.size())
+                    RuntimeError("fread: unit id out of range of the archive's symbol list");
+                align[k].updateunit(idmap); // updates itself
+            }
+        }
+        edges2.clear();
+        uniquededgedatatokens.clear();
+    }
+
     // read from a stream
     // This can be used on an existing structure and will replace its content. May be useful to avoid memory allocations (resize() will not shrink memory).
     // For efficiency, we will not check the inner consistency of the file here, but rather when we further process it.
@@ -999,20 +1101,7 @@ public:
                 RuntimeError("fread: out of bounds spunitid");
             }
 #endif
-            // This is critical--we have a buggy lattice set that requires no mapping where mapping would fail
-            bool needsmapping = false;
-            foreach_index (k, idmap)
-            {
-                if (idmap[k] != (size_t) k
-#if 1
-                    && (k != (int) idmap.size() - 1 || idmap[k] != spunit) // that HACK that we add one more /sp/ entry at the end...
-#endif
-                    )
-                {
-                    needsmapping = true;
-                    break;
-                }
-            }
+            const bool needsmapping = needsidmapping(idmap, spunit);
             // map align ids to user's symmap  --the lattice gets updated in place here
             if (needsmapping)
             {
@@ -1060,10 +1149,44 @@ public:
             // reconstruct old lattice format from this   --TODO: remove once we change to new data representation
             rebuildedges(info.impliedspunitid != spunit /*to be able to read somewhat broken V2 lattice archives*/);
         }
+        else if (version == 3)
+        {
+            freadOrDie(&info, sizeof(info), 1, f);
+            freadalignedvector(f, "NODE", nodes, info.numnodes);
+            freadalignedvector(f, "EDGE", edges, info.numedges);
+            freadalignedvector(f, "ALIG", align);
+            fcheckTag(f, "END ");
+            fgetint(f); // padding
+            finishcompacted(idmap, spunit);
+        }
         else
             RuntimeError("fread: unsupported lattice format version");
     }
 
+    // read a V3 record in memory, e.g. from a memory-mapped archive; otherwise like fread()
+    // 'end' limits the read, e.g. the end of the mapping.
+    static bool iscompactedrecord(const char* p, const char* end)
+    {
+        return end - p >= 8 && memcmp(p, "LAT ", 4) == 0 && *(const int*) (p + 4) == 3;
+    }
+    template <class IDMAP>
+    void readcompacted(const char* p, const char* end, const IDMAP& idmap, size_t spunit)
+    {
+        if (!iscompactedrecord(p, end))
+            RuntimeError("readcompacted: not a V3 lattice record");
+        p += 8;
+        if ((size_t) (end - p) < sizeof(info))
+            RuntimeError("readcompacted: record ends within the header");
+        memcpy(&info, p, sizeof(info));
+        p += sizeof(info);
+        p = getalignedvector(p, end, "NODE", nodes, info.numnodes);
+        p = getalignedvector(p, end, "EDGE", edges, info.numedges);
+        p = getalignedvector(p, end, "ALIG", align);
+        if (end - p < 4 || memcmp(p, "END ", 4) != 0)
+            RuntimeError("readcompacted: malformed record, tag END expected");
+        finishcompacted(idmap, spunit);
+    }
+
     // parallel versions (defined in parallelforwardbackward.cpp)
     class parallelstate
     {
@@ -1094,6 +1217,7 @@ public:
         // to work with CNTK's GPU memory
         void setdevice(size_t DeviceId);
         size_t getdevice();
+        void setlatticecachesize(size_t bytes); // device memory for keeping lattices across minibatches; 0 disables it
         void release(bool cpumode);
         void setloglls(const Microsoft::MSR::CNTK::Matrix<float>& loglls);
         void setloglls(const Microsoft::MSR::CNTK::Matrix<double>& loglls);
@@ -1108,6 +1232,20 @@ public:
                            const float lmf, const float wp, const float amf, const float boostingfactor, const bool sMBRmode, array_ref<size_t> uids, const_array_ref<size_t> bounds = const_array_ref<size_t>(),
                            const_array_ref<htkmlfwordsequence::word> transcript = const_array_ref<htkmlfwordsequence::word>(), const std::vector<float>& transcriptunigrams = std::vector<float>()) const;
 
+    // forward-backward over all lattices of a minibatch at once, GPU only
+    // The utterances are concatenated: logLLs (host copy, also set as the GPU logLLs with parallelstate.setloglls()),
+    // uids and bounds have the frames of all lattices in order. The gammas of all frames are left on the GPU, to be
+    // read with parallelstate.getgamma(). Returns the forwardbackward() value of each lattice.
+    // With keepedges, (*keepedges)[i][j] is set to whether edge j of lattice i has a log posterior of at least -prunebeam.
+    static std::vector<double> forwardbackwardbatch(parallelstate& parallelstate, const std::vector<const lattice*>& lattices,
+                                                    const class msra::math::ssematrixbase& logLLs, const class msra::asr::simplesenonehmm& hmms,
+                                                    const float lmf, const float wp, const float amf, const float boostingfactor, const bool sMBRmode,
+                                                    array_ref<size_t> uids, const_array_ref<size_t> bounds = const_array_ref<size_t>(),
+                                                    const double prunebeam = 0, std::vector<std::vector<unsigned short>>* keepedges = nullptr);
+
+    // copy with only the flagged edges that are on a complete path, e.g. keepedges[i] of forwardbackwardbatch(); nullptr if none is left
+    std::shared_ptr<lattice> prune(const std::vector<unsigned short>& keepedges) const;
+
     std::wstring key; // (keep our own name (key) so we can identify ourselves for diagnostics messages)
     const wchar_t* getkey() const
     {
@@ -1213,6 +1351,25 @@ class archive
 
     mutable size_t currentarchiveindex;               // which archive is open
     mutable auto_file_ptr f;                          // cached archive file handle of currentarchiveindex
+    // archives of V3 lattices are memory-mapped, and their lattices read in place instead of through 'f'
+    mutable std::vector<int> archivemapstate;         // [archiveindex] -1: not checked yet; 0: read through stdio; 1: mapped
+    mutable std::vector<std::shared_ptr<Microsoft::MSR::CNTK::MemoryMappedFile>> mappedarchives; // [archiveindex]
+
+    // map an archive if it holds V3 lattices, judged by its first record; returns null if it is to be read through stdio
+    const Microsoft::MSR::CNTK::MemoryMappedFile* getmappedarchive(size_t archiveindex) const
+    {
+        if (archivemapstate[archiveindex] < 0)
+        {
+            auto mapping = std::make_shared<Microsoft::MSR::CNTK::MemoryMappedFile>(archivepaths[archiveindex]);
+            const bool iscompacted = lattice::iscompactedrecord(mapping->GetData(), mapping->GetData() + mapping->GetSize());
+            if (iscompacted)
+                mappedarchives[archiveindex] = mapping;
+            archivemapstate[archiveindex] = iscompacted ? 1 : 0;
+            if (verbosity > 0)
+                fprintf(stderr, "getmappedarchive: %s '%S'\n", iscompacted ? "mapped compacted archive" : "reading archive", archivepaths[archiveindex].c_str());
+        }
+        return mappedarchives[archiveindex].get();
+    }
     std::unordered_map<std::wstring, latticeref> toc; // [key] -> (file, offset)  --table of content (.toc file)
 public:
     // construct = open the archive
@@ -1294,6 +1451,8 @@ public:
 
         // initialize symmaps  --alloc the array, but actually read the symmap on demand
         symmaps.resize(archivepaths.size());
+        archivemapstate.resize(archivepaths.size(), -1);
+        mappedarchives.resize(archivepaths.size());
     }
 
     // check if a lattice for a given key is available  --do this during initial check ideally
@@ -1336,18 +1495,28 @@ public:
         if (spunit2 != spunit)
             LogicError("getlattice: huh? same lookup of /sp/ gives different result?");
 #endif
-        // open archive file in case it is not the current one
-        if (archiveindex != currentarchiveindex)
+        // open archive file in case it is not the current one; V3 archives are mapped instead
+        const auto* mapping = getmappedarchive(archiveindex);
+        if (!mapping && archiveindex != currentarchiveindex)
         {
             f = fopenOrDie(archivepaths[archiveindex], L"rbS"); // or throw (will close old 'f' iff succeeded)
             currentarchiveindex = archiveindex;
         }
         try // (for read operation)
         {
-            // seek to start
-            fsetpos(f, offset);
-            // get it
-            L.fread(f, idmap, spunit);
+            if (mapping)
+            {
+                if (offset >= mapping->GetSize())
+                    RuntimeError("getlattice: TOC offset beyond the end of the archive for lattice '%S'", key.c_str());
+                L.readcompacted(mapping->GetData() + offset, mapping->GetData() + mapping->GetSize(), idmap, spunit);
+            }
+            else
+            {
+                // seek to start
+                fsetpos(f, offset);
+                // get it
+                L.fread(f, idmap, spunit);
+            }
             L.setverbosity(verbosity);
 #ifdef HACK_IN_SILENCE // hack to simulate DEL in the lattice
             const size_t silunit = getid(modelsymmap, "sil");
@@ -1372,15 +1541,16 @@ public:
     static void build(const std::vector<std::wstring>& infiles, const std::wstring& outpath,
                       const std::unordered_map<std::string, size_t>& modelsymmap,
                       const msra::asr::htkmlfreader<msra::asr::htkmlfentry, msra::lattices::lattice::htkmlfwordsequence>& labels,
-                      const msra::lm::CMGramLM& lm, const msra::lm::CSymbolSet& unigramsymbols);
+                      const msra::lm::ILM& lm, const msra::lm::CSymbolSet& unigramsymbols);
 
     // static method for converting an archive to a new format
     // Extended features:
     //  - check consistency (don't write out)
     //  - dump to stdout
     //  - merge two lattices (for merging numer into denom lattices)
+    //  - write the compacted V3 format, which is read without rebuilding the lattices, from a memory mapping
     static void convert(const std::wstring& intocpath, const std::wstring& intocpath2, const std::wstring& outpath,
-                        const msra::asr::simplesenonehmm& hset);
+                        const msra::asr::simplesenonehmm& hset, const bool compacted = false);
 };
 };
 };
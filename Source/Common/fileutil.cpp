@@ -23,6 +23,7 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <unistd.h>
+#include <fcntl.h>
 #include <glob.h>
 #endif
 #include <stdio.h>
@@ -37,6 +38,7 @@
 #include <algorithm> // for std::find
 #include <limits.h>
 #include <memory>
+#include <thread>
 #include <cwctype>
 #ifndef UNDER_CE // some headers don't exist under winCE - the appropriate definitions seem to be in stdlib.h
 #if defined(_WIN32) || defined(__CYGWIN__)
@@ -576,6 +578,140 @@ void fsetpos(FILE* f, uint64_t reqpos)
         RuntimeError("error setting file position: %s", strerror(errno));
 }
 
+// ----------------------------------------------------------------------------
+// freadBlocksOrDie(): read a range of a file with large concurrent block reads
+// ----------------------------------------------------------------------------
+
+static const size_t freadBlockSize = 4 * 1024 * 1024; // size of the reads issued concurrently
+static const size_t freadDirectAlignment = 4096;      // offsets, sizes and buffers of unbuffered reads must be multiples of the sector size
+
+void freadBlocksOrDie(const std::wstring& pathname, uint64_t offset, size_t size, void* buffer, bool direct)
+{
+    if (size == 0)
+        return;
+
+    // Unbuffered reads go to an aligned buffer that covers the requested range.
+    uint64_t readOffset = offset;
+    size_t readSize = size;
+    char* readBuffer = (char*) buffer;
+    std::unique_ptr<char[]> alignedStorage;
+    if (direct)
+    {
+        readOffset = offset / freadDirectAlignment * freadDirectAlignment;
+        readSize = (size_t)((offset + size - readOffset + freadDirectAlignment - 1) / freadDirectAlignment * freadDirectAlignment);
+        alignedStorage.reset(new char[readSize + freadDirectAlignment]);
+        readBuffer = (char*)(((uintptr_t) alignedStorage.get() + freadDirectAlignment - 1) / freadDirectAlignment * freadDirectAlignment);
+    }
+
+    const size_t numBlocks = (readSize + freadBlockSize - 1) / freadBlockSize;
+    // Bytes read per block; with unbuffered reads the last block may end early at the end of the file.
+    std::vector<size_t> blockBytesRead(numBlocks, 0);
+
+#ifdef _WIN32
+    HANDLE f = CreateFileW(pathname.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                           FILE_FLAG_OVERLAPPED | (direct ? FILE_FLAG_NO_BUFFERING : FILE_FLAG_SEQUENTIAL_SCAN), nullptr);
+    if (f == INVALID_HANDLE_VALUE)
+        RuntimeError("error opening file '%ls': error %d", pathname.c_str(), (int) GetLastError());
+
+    // Issue all block reads, then wait for them.
+    std::vector<OVERLAPPED> requests(numBlocks);
+    DWORD error = ERROR_SUCCESS;
+    size_t numIssued = 0;
+    for (; numIssued < numBlocks; numIssued++)
+    {
+        size_t blockBegin = numIssued * freadBlockSize;
+        uint64_t position = readOffset + blockBegin;
+        OVERLAPPED& request = requests[numIssued];
+        memset(&request, 0, sizeof(request));
+        request.Offset = (DWORD) position;
+        request.OffsetHigh = (DWORD)(position >> 32);
+        request.hEvent = CreateEvent(nullptr, TRUE, FALSE, nullptr);
+        if (request.hEvent == nullptr ||
+            (!ReadFile(f, readBuffer + blockBegin, (DWORD) min(freadBlockSize, readSize - blockBegin), nullptr, &request) && GetLastError() != ERROR_IO_PENDING))
+        {
+            error = GetLastError();
+            if (request.hEvent != nullptr)
+                CloseHandle(request.hEvent);
+            break;
+        }
+    }
+    for (size_t i = 0; i < numIssued; i++)
+    {
+        DWORD n = 0;
+        if (!GetOverlappedResult(f, &requests[i], &n, TRUE) && GetLastError() != ERROR_HANDLE_EOF && error == ERROR_SUCCESS)
+            error = GetLastError();
+        blockBytesRead[i] = n;
+        CloseHandle(requests[i].hEvent);
+    }
+    CloseHandle(f);
+    if (error != ERROR_SUCCESS)
+        RuntimeError("error reading from file '%ls': error %d", pathname.c_str(), (int) error);
+#else
+    int flags = O_RDONLY;
+#ifdef O_DIRECT
+    if (direct)
+        flags |= O_DIRECT;
+#endif
+    const std::string path = msra::strfun::utf8(pathname);
+    int fd = open(path.c_str(), flags);
+    if (fd == -1 && direct && errno == EINVAL) // file system without O_DIRECT, e.g. tmpfs
+        fd = open(path.c_str(), O_RDONLY);
+    if (fd == -1)
+        RuntimeError("error opening file '%ls': %s", pathname.c_str(), strerror(errno));
+#ifdef POSIX_FADV_WILLNEED
+    if (!direct) // start the read-ahead of the whole range right away
+        posix_fadvise(fd, (off_t) readOffset, (off_t) readSize, POSIX_FADV_WILLNEED);
+#endif
+
+    // Every thread reads every numThreads-th block.
+    std::vector<int> errors(min(numBlocks, (size_t) 8), 0);
+    auto readBlocks = [&](size_t thread)
+    {
+        for (size_t block = thread; block < numBlocks && errors[thread] == 0; block += errors.size())
+        {
+            size_t blockBegin = block * freadBlockSize;
+            size_t blockSize = min(freadBlockSize, readSize - blockBegin);
+            while (blockBytesRead[block] < blockSize)
+            {
+                ssize_t n = pread(fd, readBuffer + blockBegin + blockBytesRead[block], blockSize - blockBytesRead[block],
+                                  (off_t)(readOffset + blockBegin + blockBytesRead[block]));
+                if (n < 0 && errno == EINTR)
+                    continue;
+                if (n < 0)
+                    errors[thread] = errno;
+                if (n <= 0)
+                    break;
+                blockBytesRead[block] += n;
+            }
+        }
+    };
+    std::vector<std::thread> threads;
+    for (size_t thread = 1; thread < errors.size(); thread++)
+        threads.push_back(std::thread(readBlocks, thread));
+    readBlocks(0);
+    for (auto& thread : threads)
+        thread.join();
+    close(fd);
+    for (int error : errors)
+    {
+        if (error != 0)
+            RuntimeError("error reading from file '%ls': %s", pathname.c_str(), strerror(error));
+    }
+#endif
+
+    // The blocks must be complete up to the end of the requested range.
+    size_t requiredEnd = (size_t)(offset + size - readOffset);
+    for (size_t block = 0; block < numBlocks; block++)
+    {
+        size_t blockBegin = block * freadBlockSize;
+        if (blockBegin < requiredEnd && blockBegin + blockBytesRead[block] < min(requiredEnd, blockBegin + freadBlockSize))
+            RuntimeError("error reading from file '%ls': end of file reached", pathname.c_str());
+    }
+
+    if (direct)
+        memcpy(buffer, readBuffer + (offset - readOffset), size);
+}
+
 // ----------------------------------------------------------------------------
 // unlinkOrDie(): unlink() with error handling
 // ----------------------------------------------------------------------------
@@ -34,15 +34,15 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 // -----------------------------------------------------------------------
 
 template <>
-vector<shared_ptr<Matrix<float>>>& MatrixPool::GetReleasedMatrices<float>()
+vector<MatrixPool::MemRequestInfo<float>>& MatrixPool::GetMemRequestInfoVec<float>()
 {
-    return m_releasedFloatMatrices;
+    return m_memRequestInfoFloatVec;
 }
 
 template <>
-vector<shared_ptr<Matrix<double>>>& MatrixPool::GetReleasedMatrices<double>()
+vector<MatrixPool::MemRequestInfo<double>>& MatrixPool::GetMemRequestInfoVec<double>()
 {
-    return m_releasedDoubleMatrices;
+    return m_memRequestInfoDoubleVec;
 }
 
 // -----------------------------------------------------------------------
@@ -67,6 +67,8 @@ void ComputationNetwork::ClearNetwork()
         iter.second->DetachInputs();
 
     m_nameToNodeMap.clear();
+    m_validatedNodeStates.clear();
+    m_hasDimsFromCompiledPlan = false;
 
     m_pMBLayout->Init(1, 0);
 }
@@ -83,7 +85,7 @@ void ComputationNetwork::SaveEdited(const wstring& fileName, const FileOptions f
     Save(fileName, fileFormat);
 }
 
-void ComputationNetwork::Save(const wstring& fileName, const FileOptions fileFormat) const
+void ComputationNetwork::Save(const wstring& fileName, const FileOptions fileFormat, bool syncToDisk) const
 {
     VerifyIsCompiled("Save");
     // In case of parallel training only the main node should we saving the model to prevent
@@ -94,15 +96,16 @@ void ComputationNetwork::Save(const wstring& fileName, const FileOptions fileFor
         // Saving into temporary file and then renaming it to the requested fileName
         // This is a standard trick to avoid havign corrupted model files if process dies during writing
         wstring tmpFileName = fileName + L".tmp";
-        SaveToFileImpl(tmpFileName, fileFormat);
+        SaveToFileImpl(tmpFileName, fileFormat, syncToDisk);
         renameOrDie(tmpFileName, fileName);
     }
 }
 
 // TODO: how does the file distinguish float vs double nodes?
-void ComputationNetwork::SaveToFileImpl(const wstring& fileName, const FileOptions fileFormat) const
+void ComputationNetwork::SaveToFileImpl(const wstring& fileName, const FileOptions fileFormat, bool syncToDisk) const
 {
-    File fstream(fileName, fileFormat | FileOptions::fileOptionsWrite);
+    // aligned parameters are copied from the devices and written by several threads when the file is flushed at the end
+    File fstream(fileName, fileFormat | FileOptions::fileOptionsWrite | (m_saveAlignedParameters ? FileOptions::fileOptionsAlignedBlocks | FileOptions::fileOptionsParallelBlocks : 0));
     fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BCN");
 
     // model version
@@ -174,9 +177,150 @@ void ComputationNetwork::SaveToFileImpl(const wstring& fileName, const FileOptio
 
     fstream.PutMarker(FileMarker::fileMarkerEndSection, L"ERootNodes");
 
+    // devices of the nodes that are placed elsewhere than the network (model parallelism), only written if there are any
+    vector<ComputationNodeBasePtr> placedNodes;
+    for (auto nodeIter = m_nameToNodeMap.begin(); nodeIter != m_nameToNodeMap.end(); nodeIter++)
+    {
+        if (nodeIter->second->GetDeviceId() != m_deviceId)
+            placedNodes.push_back(nodeIter->second);
+    }
+    if (!placedNodes.empty())
+    {
+        fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BDevicePlacement");
+        fstream << placedNodes.size();
+        for (size_t i = 0; i < placedNodes.size(); i++)
+            fstream << placedNodes[i]->NodeName() << (int) placedNodes[i]->GetDeviceId();
+        fstream.PutMarker(FileMarker::fileMarkerEndSection, L"EDevicePlacement");
+    }
+
+    if (m_saveCompiledPlan)
+        SaveCompiledPlan(fstream);
+
     fstream.PutMarker(FileMarker::fileMarkerEndSection, L"ECN");
 
-    fstream.Flush();
+    if (syncToDisk)
+        fstream.Sync();
+    else
+        fstream.Flush();
+}
+
+// hash of what determines the dimensions that validation infers: the nodes, their connections, and the dimensions of the leaves
+// The other node attributes that enter validation (e.g. kernel sizes) are saved with the nodes, so they cannot differ from a plan in the same file.
+size_t ComputationNetwork::GetStructureFingerprint() const
+{
+    uint64_t hash = 14695981039346656037ull; // FNV-1a
+    auto add = [&hash](const wstring& s)
+    {
+        for (wchar_t c : s)
+        {
+            hash ^= (uint64_t) c;
+            hash *= 1099511628211ull;
+        }
+        hash ^= 0xffff; // separator
+        hash *= 1099511628211ull;
+    };
+    for (const auto& iter : m_nameToNodeMap)
+    {
+        const auto& node = iter.second;
+        add(node->OperationName());
+        add(node->NodeName());
+        for (const auto& input : node->GetInputs())
+            add(input ? input->NodeName() : L"");
+        if (node->IsLeaf())
+            add(msra::strfun::utf16(string(node->GetSampleLayout())));
+    }
+    return (size_t) hash;
+}
+
+// write the dimensions inferred by validation, to be used by the next Load() instead of iterating validation to convergence
+// Format: plan version, structure fingerprint, number of nodes, and for each node in evaluation order its name, [sample layout], and its MBLayout.
+// The MBLayout is identified by an index: -1 for none, 0 for the one of the network's inputs, and 1, 2, ... for those that nodes such as
+// a ReshapeNode with a time factor create, numbered in the order of their first use.
+// The rest of CompileNetwork() (evaluation order, loop analysis) is a linear traversal and is redone on load, as is the planning of
+// the matrix memory, which depends on the outputs that are asked for.
+void ComputationNetwork::SaveCompiledPlan(File& fstream) const
+{
+    const auto& nodes = GetEvalOrder(nullptr);
+    vector<MBLayoutPtr> layouts(1, m_pMBLayout); // index -> MBLayout
+    fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BCompiledPlan");
+    fstream << (size_t) 2 /*plan version*/ << GetStructureFingerprint() << nodes.size();
+    for (const auto& node : nodes)
+    {
+        int layoutIndex = -1;
+        if (node->HasMBLayout())
+        {
+            layoutIndex = (int) (find(layouts.begin(), layouts.end(), node->GetMBLayout()) - layouts.begin());
+            if (layoutIndex == (int) layouts.size())
+                layouts.push_back(node->GetMBLayout());
+        }
+        fstream << node->NodeName();
+        node->GetSampleLayout().Save(fstream);
+        fstream << layoutIndex;
+    }
+    fstream.PutMarker(FileMarker::fileMarkerEndSection, L"ECompiledPlan");
+}
+
+// read what SaveCompiledPlan() wrote, and set the dimensions of all non-leaf nodes from it if it matches the network
+void ComputationNetwork::ReadCompiledPlan(File& fstream)
+{
+    size_t planVersion, fingerprint, numNodes;
+    fstream >> planVersion >> fingerprint >> numNodes;
+    if (planVersion > 2)
+        InvalidArgument("ReadCompiledPlan: The model file has a compiled plan of a newer version (%d) than this CNTK version can handle.", (int) planVersion);
+
+    // version 1 only knew whether a node is minibatch data, not which MBLayout it has, so its plan is read but not used
+    vector<tuple<ComputationNodeBasePtr, TensorShape, int>> nodeDims;
+    bool matches = (fingerprint == GetStructureFingerprint());
+    int numLayouts = 1; // the network's
+    for (size_t i = 0; i < numNodes; i++)
+    {
+        wstring nodeName;
+        TensorShape sampleLayout;
+        int layoutIndex;
+        fstream >> nodeName;
+        sampleLayout.Load(fstream);
+        if (planVersion == 1)
+        {
+            bool isMinibatch;
+            fstream >> isMinibatch;
+            layoutIndex = isMinibatch ? 0 : -1;
+        }
+        else
+            fstream >> layoutIndex;
+        if (layoutIndex < -1 || layoutIndex > numLayouts) // layouts are numbered in the order of their first use
+            matches = false;
+        else if (layoutIndex == numLayouts)
+            numLayouts++;
+        auto iter = m_nameToNodeMap.find(nodeName);
+        if (iter == m_nameToNodeMap.end())
+            matches = false;
+        else if (!iter->second->IsLeaf())
+            nodeDims.push_back(make_tuple(iter->second, sampleLayout, layoutIndex));
+    }
+    fstream.GetMarker(FileMarker::fileMarkerEndSection, L"ECompiledPlan");
+
+    if (planVersion == 1)
+    {
+        fprintf(stderr, "ReadCompiledPlan: The compiled plan was written by an older CNTK version without the MBLayouts of the nodes, ignoring it.\n");
+        return;
+    }
+    if (!matches)
+    {
+        fprintf(stderr, "ReadCompiledPlan: The compiled plan does not match the network, ignoring it.\n");
+        return;
+    }
+    // A layout other than the network's is created by the first node that uses it, as its Validate() would, and shared by the nodes after it.
+    vector<MBLayoutPtr> layouts(1, m_pMBLayout);
+    for (const auto& dims : nodeDims)
+    {
+        const auto& node = get<0>(dims);
+        const int layoutIndex = get<2>(dims);
+        while (layoutIndex >= (int) layouts.size())
+            layouts.push_back(make_shared<MBLayout>());
+        node->LinkToMBLayout(layoutIndex >= 0 ? layouts[layoutIndex] : nullptr);
+        node->SetDims(get<1>(dims), layoutIndex >= 0);
+    }
+    m_hasDimsFromCompiledPlan = true;
 }
 
 // load the section of nodes that contain persistable parameters
@@ -231,9 +375,11 @@ void ComputationNetwork::Read(const wstring& fileName)
 {
     ClearNetwork();
 
-    File fstream(fileName, FileOptions::fileOptionsBinary | FileOptions::fileOptionsRead);
+    // parameters in aligned blocks are either mapped, or read by several threads once all nodes are loaded
+    File fstream(fileName, FileOptions::fileOptionsBinary | FileOptions::fileOptionsRead | (m_mapModelParameters ? FileOptions::fileOptionsMapBlocks : FileOptions::fileOptionsParallelBlocks));
 
     ReadPersistableParameters<ElemType>(fstream, true);
+    fstream.FinishAlignedBlocks();
 
     size_t numNodes = m_nameToNodeMap.size();
 
@@ -351,6 +497,25 @@ void ComputationNetwork::Read(const wstring& fileName)
     }
     fstream.GetMarker(FileMarker::fileMarkerEndSection, L"ERootNodes");
 
+    if (fstream.TryGetMarker(FileMarker::fileMarkerBeginSection, L"BDevicePlacement"))
+    {
+        size_t num;
+        fstream >> num;
+        for (size_t i = 0; i < num; i++)
+        {
+            wstring nodeName;
+            int deviceId;
+            fstream >> nodeName >> deviceId;
+            // a model that was placed on multiple GPUs is loaded entirely on the CPU if that is asked for
+            if (m_deviceId != CPUDEVICE)
+                GetNodeFromName(nodeName)->MoveToDevice(deviceId);
+        }
+        fstream.GetMarker(FileMarker::fileMarkerEndSection, L"EDevicePlacement");
+    }
+
+    if (fstream.TryGetMarker(FileMarker::fileMarkerBeginSection, L"BCompiledPlan"))
+        ReadCompiledPlan(fstream);
+
     fstream.GetMarker(FileMarker::fileMarkerEndSection, L"ECN");
 }
 
@@ -374,6 +539,8 @@ bool ComputationNetwork::IsTypicalCriterionNode(ComputationNodeBasePtr nodePtr)
         nodePtr->OperationName() == OperationNameOf(LogisticNode) ||
         nodePtr->OperationName() == OperationNameOf(CrossEntropyWithSoftmaxNode) ||
         nodePtr->OperationName() == OperationNameOf(SequenceWithSoftmaxNode) ||
+        nodePtr->OperationName() == OperationNameOf(LatticeFreeMMINode) ||
+        nodePtr->OperationName() == OperationNameOf(CTCWithSoftmaxNode) ||
         nodePtr->OperationName() == OperationNameOf(CrossEntropyNode) ||
         nodePtr->OperationName() == OperationNameOf(ClassBasedCrossEntropyWithSoftmaxNode) ||
         nodePtr->OperationName() == OperationNameOf(ErrorPredictionNode) ||
@@ -478,6 +645,18 @@ template <class ElemType>
     }
 }
 
+// dropout masks are regenerated by the kernels instead of being stored (call before AllocateAllMatrices())
+template <class ElemType>
+/*static*/ void ComputationNetwork::SetDropoutCounterBasedRNG(ComputationNetworkPtr net, const ComputationNodeBasePtr& criterionNode, const bool counterBasedRNG)
+{
+    list<ComputationNodeBasePtr> dropoutNodes = net->GetNodesWithType(OperationNameOf(DropoutNode), criterionNode);
+    for (auto nodeIter = dropoutNodes.begin(); nodeIter != dropoutNodes.end(); nodeIter++)
+    {
+        auto node = dynamic_pointer_cast<DropoutNode<ElemType>>(*nodeIter);
+        node->SetCounterBasedRNG(counterBasedRNG);
+    }
+}
+
 //set sequence training parameters, e.g. smoothing weight, frame drop threshhold
 template <class ElemType>
 void ComputationNetwork::SetSeqParam(ComputationNetworkPtr net,
@@ -489,12 +668,14 @@ void ComputationNetwork::SetSeqParam(ComputationNetworkPtr net,
                                      const double& lmf /*= 14.0f*/,
                                      const double& wp /*= 0.0f*/,
                                      const double& bMMIfactor /*= 0.0f*/,
-                                     const bool& sMBR /*= false*/
+                                     const bool& sMBR /*= false*/,
+                                     const size_t& latticeCacheSizeMB /*= 0*/,
+                                     const double& latticePruneBeam /*= 0*/
                                      )
 {
     fprintf(stderr, "Setting Hsmoothing weight to %.8g and frame-dropping threshhold to %.8g\n", hsmoothingWeight, frameDropThresh);
-    fprintf(stderr, "Setting SeqGammar-related parameters: amf=%.2f, lmf=%.2f, wp=%.2f, bMMIFactor=%.2f, usesMBR=%s\n",
-            amf, lmf, wp, bMMIfactor, sMBR ? "true" : "false");
+    fprintf(stderr, "Setting SeqGammar-related parameters: amf=%.2f, lmf=%.2f, wp=%.2f, bMMIFactor=%.2f, usesMBR=%s, latticeCacheSizeMB=%d, latticePruneBeam=%.2f\n",
+            amf, lmf, wp, bMMIfactor, sMBR ? "true" : "false", (int) latticeCacheSizeMB, latticePruneBeam);
     list<ComputationNodeBasePtr> seqNodes = net->GetNodesWithType(OperationNameOf(SequenceWithSoftmaxNode), criterionNode);
     if (seqNodes.size() == 0)
     {
@@ -508,7 +689,7 @@ void ComputationNetwork::SetSeqParam(ComputationNetworkPtr net,
             node->SetSmoothWeight(hsmoothingWeight);
             node->SetFrameDropThresh(frameDropThresh);
             node->SetReferenceAlign(doreferencealign);
-            node->SetGammarCalculationParam(amf, lmf, wp, bMMIfactor, sMBR);
+            node->SetGammarCalculationParam(amf, lmf, wp, bMMIfactor, sMBR, latticeCacheSizeMB, latticePruneBeam);
         }
     }
 }
@@ -1006,6 +1187,617 @@ void ComputationNetwork::PerformSVDecomposition(const map<wstring, float>& SVDCo
     CompileNetwork();
 }
 
+// Switches all nodes that implement IInt8QuantizableNode to int8 weights (see Int8QuantizedMatrix).
+// The float value of a weight is freed if the quantized nodes were its only consumers.
+// This is for inference only: the network can no longer be trained or saved afterwards.
+template <class ElemType>
+size_t ComputationNetwork::QuantizeWeightsToInt8()
+{
+    return SwitchToWeightCopies<ElemType>("QuantizeWeightsToInt8", "int8", [](const ComputationNodeBasePtr& node) -> ComputationNodeBasePtr
+    {
+        auto quantizableNode = dynamic_pointer_cast<IInt8QuantizableNode>(node);
+        return quantizableNode ? quantizableNode->QuantizeWeightsToInt8() : nullptr;
+    });
+}
+
+// Switches the Times nodes whose weights have at least 'minSparsity' zero blocks to block-sparse weights (see BlockSparseMatrix),
+// e.g. after PruneParameters(). As above, the float weights are freed where possible, and the network is for inference only.
+// Call this before QuantizeWeightsToInt8(), which does not quantize these nodes.
+template <class ElemType>
+size_t ComputationNetwork::UseBlockSparseWeights(size_t blockRows, size_t blockCols, double minSparsity)
+{
+    return SwitchToWeightCopies<ElemType>("UseBlockSparseWeights", "block-sparse", [=](const ComputationNodeBasePtr& node) -> ComputationNodeBasePtr
+    {
+        auto sparseNode = dynamic_pointer_cast<IBlockSparseWeightsNode>(node);
+        return sparseNode ? sparseNode->UseBlockSparseWeights(blockRows, blockCols, minSparsity) : nullptr;
+    });
+}
+
+// Switches the Times nodes that still read their weights from a parameter to weights packed once in the layout of the GEMM
+// kernel (see PackedWeightMatrix), which saves the packing inside each BLAS call. As above, the float weights are freed where
+// possible, and the network is for inference only. Call this last: nodes with int8 or block-sparse weights are left alone.
+template <class ElemType>
+size_t ComputationNetwork::PackWeights()
+{
+    return SwitchToWeightCopies<ElemType>("PackWeights", "packed", [](const ComputationNodeBasePtr& node) -> ComputationNodeBasePtr
+    {
+        auto packableNode = dynamic_pointer_cast<IPackedWeightsNode>(node);
+        return packableNode ? packableNode->PackWeights() : nullptr;
+    });
+}
+
+// 'switchNode' switches a node to a copy of its weights, and returns the weight input it no longer reads (or nullptr).
+template <class ElemType>
+size_t ComputationNetwork::SwitchToWeightCopies(const char* where, const char* copyKind, const function<ComputationNodeBasePtr(const ComputationNodeBasePtr&)>& switchNode)
+{
+    VerifyIsCompiled(where);
+
+    // count the consumers of each node, and how many of them now read from a copy
+    map<ComputationNodeBasePtr, size_t> numParents;
+    map<ComputationNodeBasePtr, size_t> numSwitchedParents;
+    size_t numSwitchedNodes = 0;
+    for (auto& iter : m_nameToNodeMap)
+    {
+        auto node = iter.second;
+        for (auto& input : node->GetInputs())
+            numParents[input]++;
+        auto weights = switchNode(node);
+        if (!weights)
+            continue;
+        numSwitchedParents[weights]++;
+        numSwitchedNodes++;
+    }
+
+    size_t floatBytes = 0, freedBytes = 0;
+    for (auto& iter : numSwitchedParents)
+    {
+        auto weights = dynamic_pointer_cast<ComputationNode<ElemType>>(iter.first);
+        if (!weights)
+            LogicError("%s: Node %ls has an unexpected element type.", where, iter.first->NodeName().c_str());
+        size_t bytes = weights->Value().GetNumElements() * sizeof(ElemType);
+        floatBytes += bytes;
+        if (iter.second == numParents[weights] && find(m_outputNodes.begin(), m_outputNodes.end(), weights) == m_outputNodes.end())
+        {
+            weights->Value().Resize(0, 0, 0, /*growOnly=*/false);
+            freedBytes += bytes;
+        }
+    }
+    if (numSwitchedNodes > 0)
+        fprintf(stderr, "%s: %d nodes now use %s weights; %.1f of %.1f MB of their float weights were freed.\n",
+                where, (int) numSwitchedNodes, copyKind, freedBytes / 1048576.0, floatBytes / 1048576.0);
+    return numSwitchedNodes;
+}
+
+// Magnitude pruning: each matrix parameter whose name matches 'nodeNameRegex' (all if empty) is tiled into blocks of
+// [blockRows x blockCols] elements, and the fraction 'sparsity' of the blocks with the smallest L2 norm is set to 0.
+// 1 x 1 blocks prune single weights; larger blocks leave a structure that BlockSparseMatrix multiplies faster.
+// The pruned weights are exactly 0, which lets SGD keep them at 0 while fine-tuning (see SGD's maskPrunedWeights).
+template <class ElemType>
+size_t ComputationNetwork::PruneParameters(const wstring& nodeNameRegex, double sparsity, size_t blockRows, size_t blockCols)
+{
+    if (sparsity < 0 || sparsity >= 1)
+        InvalidArgument("PruneParameters: The sparsity (%f) must be in [0, 1).", sparsity);
+    if (blockRows == 0 || blockCols == 0)
+        InvalidArgument("PruneParameters: The block dimensions must not be 0.");
+
+    wregex nameFilter(nodeNameRegex);
+    size_t numPrunedParameters = 0;
+    for (auto& iter : m_nameToNodeMap)
+    {
+        if (!nodeNameRegex.empty() && !regex_match(iter.first, nameFilter))
+            continue;
+        auto parameter = dynamic_pointer_cast<LearnableParameter<ElemType>>(iter.second);
+        if (!parameter)
+            continue;
+        Matrix<ElemType>& value = parameter->Value();
+        const size_t numRows = value.GetNumRows(), numCols = value.GetNumCols();
+        if (numRows <= 1 || numCols <= 1) // biases and other vectors are not pruned
+            continue;
+
+        // squared L2 norm of each block
+        const size_t numBlockRows = (numRows + blockRows - 1) / blockRows;
+        const size_t numBlockCols = (numCols + blockCols - 1) / blockCols;
+        std::unique_ptr<ElemType[]> values(value.CopyToArray());
+        vector<double> norms(numBlockRows * numBlockCols, 0);
+        for (size_t k = 0; k < numCols; k++)
+            for (size_t i = 0; i < numRows; i++)
+                norms[(k / blockCols) * numBlockRows + i / blockRows] += (double) values[k * numRows + i] * values[k * numRows + i];
+
+        // zero all blocks up to the norm of the last block to be pruned (ties may prune a few more)
+        const size_t numPrunedBlocks = (size_t) (sparsity * norms.size());
+        if (numPrunedBlocks == 0)
+            continue;
+        vector<double> sortedNorms = norms;
+        nth_element(sortedNorms.begin(), sortedNorms.begin() + (numPrunedBlocks - 1), sortedNorms.end());
+        const double threshold = sortedNorms[numPrunedBlocks - 1];
+        size_t numZeroBlocks = 0;
+        for (size_t b = 0; b < norms.size(); b++)
+            numZeroBlocks += norms[b] <= threshold;
+        for (size_t k = 0; k < numCols; k++)
+            for (size_t i = 0; i < numRows; i++)
+                if (norms[(k / blockCols) * numBlockRows + i / blockRows] <= threshold)
+                    values[k * numRows + i] = 0;
+        value.SetValue(numRows, numCols, value.GetDeviceId(), values.get(), matrixFlagNormal);
+
+        fprintf(stderr, "PruneParameters: %ls [%d x %d]: %d of %d blocks of [%d x %d] are now 0 (%.1f%%).\n",
+                iter.first.c_str(), (int) numRows, (int) numCols, (int) numZeroBlocks, (int) norms.size(), (int) blockRows, (int) blockCols, 100.0 * numZeroBlocks / norms.size());
+        numPrunedParameters++;
+    }
+    return numPrunedParameters;
+}
+
+// Folds normalizations that are constant at inference time into the weights and bias of the adjacent Times or Convolution node,
+// and removes them, which saves a pass over the activations per layer. The patterns are, with an optional bias Plus:
+//  - BatchNormalization in eval mode of Times(W, x) + b or Convolution(W, x) + b, with k = scale .* runInvStdDev:
+//        (W x + b - runMean) .* k + bias  =  (W .* k) x + (b - runMean) .* k + bias        (k scales the rows of W)
+//  - Times(W, PerDimMeanVarNormalization(x, mean, invStdDev)) + b, with W' = W diag(invStdDev):
+//        W ((x - mean) .* invStdDev) + b  =  W' x + b - W' mean
+//    Not after a Convolution, whose zero padding would no longer be applied to normalized values.
+// Nothing is folded unless W, b and the nodes in between are used nowhere else. The node that computes the result takes over
+// the name of the node it replaces, so that outputs keep their names. Call this before QuantizeWeightsToInt8().
+template <class ElemType>
+size_t ComputationNetwork::FoldNormalizationIntoWeights()
+{
+    VerifyIsCompiled("FoldNormalizationIntoWeights");
+
+    map<ComputationNodeBasePtr, size_t> numConsumers;
+    auto countConsumers = [&]()
+    {
+        numConsumers.clear();
+        for (auto& iter : m_nameToNodeMap)
+            for (auto& input : iter.second->GetInputs())
+                numConsumers[input]++;
+    };
+    auto isInNodeGroup = [&](const ComputationNodeBasePtr& node)
+    {
+        for (auto group : GetAllNodeGroups())
+            if (find(group->begin(), group->end(), node) != group->end())
+                return true;
+        return false;
+    };
+    // whether a node can be changed without changing anything but its single consumer
+    auto isPrivate = [&](const ComputationNodeBasePtr& node)
+    {
+        return numConsumers[node] == 1 && !isInNodeGroup(node);
+    };
+    auto consumerOf = [&](const ComputationNodeBasePtr& node) -> ComputationNodeBasePtr
+    {
+        for (auto& iter : m_nameToNodeMap)
+            for (auto& input : iter.second->GetInputs())
+                if (input == node)
+                    return iter.second;
+        return nullptr;
+    };
+    // a parameter with 'dim' elements, which we may change if 'isPrivate' holds
+    auto asParameter = [&](const ComputationNodeBasePtr& node, size_t dim) -> shared_ptr<ComputationNode<ElemType>>
+    {
+        auto parameter = dynamic_pointer_cast<ComputationNode<ElemType>>(node);
+        if (!parameter || parameter->OperationName() != OperationNameOf(LearnableParameter) || parameter->Value().GetNumElements() != dim)
+            return nullptr;
+        return parameter;
+    };
+    // a value that is fixed at inference time
+    auto asConstant = [&](const ComputationNodeBasePtr& node, size_t dim) -> shared_ptr<ComputationNode<ElemType>>
+    {
+        auto preComputeNode = dynamic_pointer_cast<IPreComputeNode>(node);
+        if (preComputeNode && preComputeNode->HasComputed())
+        {
+            auto constant = dynamic_pointer_cast<ComputationNode<ElemType>>(node);
+            return constant && constant->Value().GetNumElements() == dim ? constant : nullptr;
+        }
+        return asParameter(node, dim);
+    };
+    auto columnOnDevice = [](const Matrix<ElemType>& value, DEVICEID_TYPE deviceId, size_t dim)
+    {
+        Matrix<ElemType> column(value, deviceId);
+        column.Reshape(dim, 1);
+        return column;
+    };
+    // makes the consumers and node groups of 'from' use 'to' instead
+    auto redirect = [&](const ComputationNodeBasePtr& from, const ComputationNodeBasePtr& to)
+    {
+        for (auto& iter : m_nameToNodeMap)
+        {
+            auto node = iter.second;
+            if (node == to)
+                continue;
+            for (size_t i = 0; i < node->GetNumInputs(); i++)
+                if (node->GetInputs()[i] == from)
+                    node->SetInput(i, to);
+        }
+        for (auto group : GetAllNodeGroups())
+            replace(group->begin(), group->end(), from, to);
+    };
+    // deletes a node together with those of its parameters and precomputed inputs that are no longer used
+    auto deleteWithUnusedInputs = [&](const ComputationNodeBasePtr& node)
+    {
+        auto inputs = node->GetInputs();
+        DeleteNode(node->NodeName());
+        countConsumers();
+        for (auto& input : inputs)
+        {
+            if (!input || numConsumers[input] > 0 || isInNodeGroup(input) || m_nameToNodeMap.find(input->NodeName()) == m_nameToNodeMap.end())
+                continue;
+            if (input->OperationName() == OperationNameOf(LearnableParameter) || dynamic_pointer_cast<IPreComputeNode>(input))
+                DeleteNode(input->NodeName());
+        }
+    };
+    // the bias of a new Plus node after 'linear', for when there was none
+    auto addBias = [&](const ComputationNodeBasePtr& linear, const TensorShape& shape, const wstring& plusName)
+    {
+        auto bias = AddNodeToNetWithElemType(New<LearnableParameter<ElemType>>(linear->GetDeviceId(), linear->NodeName() + L"-foldedBias", shape));
+        AddNodeToNetAndAttachInputs(New<PlusNode<ElemType>>(linear->GetDeviceId(), plusName), linear, bias);
+        return bias;
+    };
+
+    // collect the candidates first, folding edits m_nameToNodeMap
+    vector<ComputationNodeBasePtr> normalizationNodes;
+    for (auto& iter : m_nameToNodeMap)
+    {
+        if (iter.second->OperationName() == OperationNameOf(BatchNormalizationNode) ||
+            iter.second->OperationName() == OperationNameOf(PerDimMeanVarNormalizationNode))
+            normalizationNodes.push_back(iter.second);
+    }
+
+    size_t numFolded = 0;
+    for (auto& normalizationNode : normalizationNodes)
+    {
+        countConsumers();
+        wstring name = normalizationNode->NodeName();
+
+        if (normalizationNode->OperationName() == OperationNameOf(BatchNormalizationNode))
+        {
+            auto bn = dynamic_pointer_cast<BatchNormalizationNode<ElemType>>(normalizationNode);
+            if (!bn || !bn->IsEvalMode())
+                continue;
+
+            // the input is [Plus](Times|Convolution(W, .), [b])
+            auto isLinear = [](const ComputationNodeBasePtr& node)
+            {
+                return node->OperationName() == OperationNameOf(TimesNode) || node->OperationName() == OperationNameOf(ConvolutionNode);
+            };
+            ComputationNodeBasePtr linear = normalizationNode->Input(0), plus, bias;
+            if (linear->OperationName() == OperationNameOf(PlusNode))
+            {
+                plus = linear;
+                size_t linearIndex = isLinear(plus->Input(0)) ? 0 : 1;
+                linear = plus->Input(linearIndex);
+                bias = plus->Input(1 - linearIndex);
+            }
+            if (!isLinear(linear) || !isPrivate(linear) || (plus && !isPrivate(plus)))
+                continue;
+
+            // one scale per output channel of a convolution, or per output element of a product
+            bool isConvolution = linear->OperationName() == OperationNameOf(ConvolutionNode);
+            size_t dim;
+            if (isConvolution)
+            {
+                auto convolution = dynamic_pointer_cast<ConvolutionNode<ElemType>>(linear);
+                if (!convolution || !bn->IsSpatial() || convolution->GetImageLayoutKind() != ImageLayoutKind::CHW)
+                    continue;
+                dim = convolution->GetNumOutputChannels();
+            }
+            else
+            {
+                if (bn->IsSpatial())
+                    continue;
+                dim = linear->GetSampleLayout().GetNumElements();
+            }
+            TensorShape biasShape = isConvolution ? TensorShape(1, 1, dim) : linear->GetSampleLayout();
+
+            auto weights = dynamic_pointer_cast<ComputationNode<ElemType>>(linear->Input(0));
+            if (!weights || weights->OperationName() != OperationNameOf(LearnableParameter) || weights->Value().GetNumRows() != dim || !isPrivate(weights))
+                continue;
+            shared_ptr<ComputationNode<ElemType>> oldBias;
+            if (plus)
+            {
+                oldBias = asParameter(bias, dim);
+                if (!oldBias || !isPrivate(oldBias) || oldBias->HasMBLayout() || (isConvolution && oldBias->GetSampleLayout() != biasShape))
+                    continue;
+            }
+            auto scale = asConstant(normalizationNode->Input(1), dim);
+            auto bnBias = asConstant(normalizationNode->Input(2), dim);
+            auto runMean = asConstant(normalizationNode->Input(3), dim);
+            auto runInvStdDev = asConstant(normalizationNode->Input(4), dim);
+            if (!scale || !bnBias || !runMean || !runInvStdDev)
+                continue;
+
+            DEVICEID_TYPE deviceId = weights->Value().GetDeviceId();
+            Matrix<ElemType> k = columnOnDevice(scale->Value(), deviceId, dim);
+            k.ElementMultiplyWith(columnOnDevice(runInvStdDev->Value(), deviceId, dim));
+            Matrix<ElemType> newBias = oldBias ? columnOnDevice(oldBias->Value(), deviceId, dim) : Matrix<ElemType>::Zeros(dim, 1, deviceId);
+            newBias -= columnOnDevice(runMean->Value(), deviceId, dim);
+            newBias.ElementMultiplyWith(k);
+            newBias += columnOnDevice(bnBias->Value(), deviceId, dim);
+            weights->Value().ColumnElementMultiplyWith(k);
+
+            if (!plus)
+            {
+                oldBias = addBias(linear, biasShape, name + L"-folded");
+                plus = GetNodeFromName(name + L"-folded");
+            }
+            newBias.Reshape(oldBias->Value().GetNumRows(), oldBias->Value().GetNumCols());
+            oldBias->Value().SetValueFromOtherDevice(newBias);
+
+            redirect(bn, plus);
+            deleteWithUnusedInputs(bn);
+            RenameNode(plus, name);
+        }
+        else
+        {
+            // the single consumer is Times(W, .), optionally followed by Plus(., b)
+            if (!isPrivate(normalizationNode))
+                continue;
+            auto times = consumerOf(normalizationNode);
+            if (times->OperationName() != OperationNameOf(TimesNode) || times->Input(1) != normalizationNode)
+                continue;
+            size_t inputDim = normalizationNode->GetSampleLayout().GetNumElements();
+            size_t outputDim = times->GetSampleLayout().GetNumElements();
+            auto weights = asParameter(times->Input(0), outputDim * inputDim);
+            if (!weights || weights->Value().GetNumCols() != inputDim || !isPrivate(weights))
+                continue;
+            auto mean = asConstant(normalizationNode->Input(1), inputDim);
+            auto invStdDev = asConstant(normalizationNode->Input(2), inputDim);
+            if (!mean || !invStdDev)
+                continue;
+
+            ComputationNodeBasePtr plus;
+            shared_ptr<ComputationNode<ElemType>> oldBias;
+            auto timesConsumer = isPrivate(times) ? consumerOf(times) : nullptr;
+            if (timesConsumer && timesConsumer->OperationName() == OperationNameOf(PlusNode))
+            {
+                auto bias = timesConsumer->Input(timesConsumer->Input(0) == times ? 1 : 0);
+                oldBias = asParameter(bias, outputDim);
+                if (oldBias && isPrivate(oldBias) && !oldBias->HasMBLayout())
+                    plus = timesConsumer;
+                else
+                    oldBias = nullptr;
+            }
+
+            DEVICEID_TYPE deviceId = weights->Value().GetDeviceId();
+            Matrix<ElemType> invStdDevRow = columnOnDevice(invStdDev->Value(), deviceId, inputDim);
+            invStdDevRow.Reshape(1, inputDim);
+            weights->Value().RowElementMultiplyWith(invStdDevRow);
+            Matrix<ElemType> newBias = oldBias ? columnOnDevice(oldBias->Value(), deviceId, outputDim) : Matrix<ElemType>::Zeros(outputDim, 1, deviceId);
+            Matrix<ElemType>::MultiplyAndWeightedAdd(-1, weights->Value(), false, columnOnDevice(mean->Value(), deviceId, inputDim), false, 1, newBias);
+
+            times->SetInput(1, normalizationNode->Input(0));
+            if (!plus)
+            {
+                wstring timesName = times->NodeName();
+                oldBias = addBias(times, times->GetSampleLayout(), name + L"-folded");
+                plus = GetNodeFromName(name + L"-folded");
+                redirect(times, plus);
+                RenameNode(times, timesName + L"-folded");
+                RenameNode(plus, timesName);
+            }
+            newBias.Reshape(oldBias->Value().GetNumRows(), oldBias->Value().GetNumCols());
+            oldBias->Value().SetValueFromOtherDevice(newBias);
+
+            deleteWithUnusedInputs(normalizationNode);
+        }
+        numFolded++;
+    }
+
+    if (numFolded > 0)
+    {
+        CompileNetwork();
+        fprintf(stderr, "FoldNormalizationIntoWeights: %d normalization nodes were folded into the weights of the node before or after them.\n", (int) numFolded);
+    }
+    return numFolded;
+}
+
+// Merges the ensemble 'members' into this (empty) network, for evaluating them in one forward pass.
+// The input nodes are shared by name, and so are nodes that compute the same function of the same inputs:
+// parameters and precomputed nodes (e.g. the mean and inverse standard deviation of the features) with
+// identical values, and nodes of operations without further attributes whose inputs are shared, e.g. the
+// PerDimMeanVarNormalization of a shared input. All other nodes keep their names, prefixed with 'member<i>_'.
+// With 'averageOutputs', each output that all members have is replaced by the average over the members,
+// under the original name; otherwise the outputs of all members are outputs. The members are left empty.
+// Returns the number of nodes that are shared.
+template <class ElemType>
+size_t ComputationNetwork::MergeEnsemble(const vector<ComputationNetworkPtr>& members, bool averageOutputs)
+{
+    if (!m_nameToNodeMap.empty())
+        LogicError("MergeEnsemble: The network to merge into must be empty.");
+    if (members.size() < 2)
+        InvalidArgument("MergeEnsemble: An ensemble needs at least two members.");
+    for (auto& member : members)
+    {
+        member->VerifyIsCompiled("MergeEnsemble");
+        if (member->GetDeviceId() != members[0]->GetDeviceId())
+            InvalidArgument("MergeEnsemble: All members must be on the same device.");
+    }
+    SetDeviceId(members[0]->GetDeviceId());
+
+    // only these operations compute a function of nothing but their inputs
+    static const set<wstring> dedupableOperations =
+    {
+        OperationNameOf(MeanNode), OperationNameOf(InvStdDevNode),
+        OperationNameOf(PerDimMeanVarNormalizationNode), OperationNameOf(PerDimMeanVarDeNormalizationNode),
+        OperationNameOf(PlusNode), OperationNameOf(MinusNode), OperationNameOf(ElementTimesNode), OperationNameOf(TimesNode),
+        OperationNameOf(NegateNode), OperationNameOf(RowStackNode),
+        OperationNameOf(SigmoidNode), OperationNameOf(TanhNode), OperationNameOf(RectifiedLinearNode),
+        OperationNameOf(ExpNode), OperationNameOf(LogNode), OperationNameOf(SoftmaxNode), OperationNameOf(LogSoftmaxNode)
+    };
+
+    auto valuesOf = [](const ComputationNodeBasePtr& node) -> vector<ElemType>
+    {
+        auto& value = dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Value();
+        vector<ElemType> values(value.GetNumElements());
+        if (!values.empty())
+        {
+            ElemType* p = values.data();
+            size_t size = values.size();
+            value.CopyToArray(p, size);
+        }
+        return values;
+    };
+    // a node is compared by its values if they were learned or precomputed, and by its inputs otherwise
+    auto hasFixedValues = [](const ComputationNodeBasePtr& node)
+    {
+        if (node->OperationName() == OperationNameOf(LearnableParameter))
+            return true;
+        auto precompute = dynamic_pointer_cast<IPreComputeNode>(node);
+        return precompute && precompute->HasComputed();
+    };
+
+    map<ComputationNodeBasePtr, ComputationNodeBasePtr> replacements; // [member node] -> node of the merged network
+    map<wstring, vector<ComputationNodeBasePtr>> candidates;         // [operation, inputs, shape, values hash] -> nodes of earlier members
+    map<wstring, ComputationNodeBasePtr> sharedInputs;
+    vector<vector<ComputationNodeBasePtr>> memberOutputs;
+    set<ComputationNodeBasePtr> sharedNodes;
+    vector<ComputationNodeBasePtr> deferredNodes; // nodes with inputs further down (loops), which are rewired at the end
+    for (size_t i = 0; i < members.size(); i++)
+    {
+        auto& member = members[i];
+        const wstring prefix = L"member" + to_wstring(i) + L"_";
+        for (auto& node : ComputationNodeBase::EnumerateNodes(member->OutputNodes()))
+        {
+            if (dynamic_pointer_cast<InputValueBase<ElemType>>(node))
+            {
+                auto iter = sharedInputs.find(node->NodeName());
+                if (iter == sharedInputs.end())
+                {
+                    sharedInputs[node->NodeName()] = AddNodeToNet(node);
+                    replacements[node] = node;
+                }
+                else if (iter->second->GetSampleLayout() != node->GetSampleLayout() || iter->second->OperationName() != node->OperationName())
+                    InvalidArgument("MergeEnsemble: The input %ls differs between the members: %s vs. %s.",
+                                    node->NodeName().c_str(), string(iter->second->GetSampleLayout()).c_str(), string(node->GetSampleLayout()).c_str());
+                else
+                {
+                    replacements[node] = iter->second;
+                    sharedNodes.insert(iter->second);
+                }
+                continue;
+            }
+
+            // rewire the inputs to the merged network
+            bool isDeferred = false;
+            for (size_t j = 0; j < node->GetNumInputs(); j++)
+            {
+                auto iter = replacements.find(node->Input(j));
+                if (iter == replacements.end())
+                    isDeferred = true;
+                else
+                    node->SetInput(j, iter->second);
+            }
+
+            // look for an identical node of an earlier member
+            ComputationNodeBasePtr identicalNode;
+            wstring key;
+            if (!isDeferred && (hasFixedValues(node) || dedupableOperations.find(node->OperationName()) != dedupableOperations.end()))
+            {
+                vector<ElemType> values;
+                key = node->OperationName() + L"|" + msra::strfun::utf16(string(node->GetSampleLayout())) + (node->HasMBLayout() ? L"|mb" : L"|");
+                for (auto& input : node->GetInputs())
+                    key += msra::strfun::wstrprintf(L"|%p", input.get());
+                if (hasFixedValues(node))
+                {
+                    values = valuesOf(node);
+                    key += L"|" + to_wstring(hash<string>()(string((const char*) values.data(), values.size() * sizeof(ElemType))));
+                }
+                for (auto& candidate : candidates[key])
+                {
+                    if (hasFixedValues(node) && valuesOf(candidate) != values)
+                        continue;
+                    identicalNode = candidate;
+                    break;
+                }
+            }
+            if (identicalNode)
+            {
+                node->DetachInputs();
+                replacements[node] = identicalNode;
+                sharedNodes.insert(identicalNode);
+                continue;
+            }
+
+            node->SetName(prefix + node->NodeName());
+            AddNodeToNet(node);
+            replacements[node] = node;
+            if (isDeferred)
+                deferredNodes.push_back(node);
+            else if (!key.empty())
+                candidates[key].push_back(node);
+        }
+
+        memberOutputs.push_back(vector<ComputationNodeBasePtr>());
+        for (auto& output : member->OutputNodes())
+            memberOutputs.back().push_back(replacements[output]);
+    }
+    for (auto& node : deferredNodes)
+    {
+        for (size_t j = 0; j < node->GetNumInputs(); j++)
+        {
+            auto iter = replacements.find(node->Input(j));
+            if (iter != replacements.end())
+                node->SetInput(j, iter->second);
+        }
+    }
+
+    // the members no longer own their nodes (their destructors would detach them); those not merged, e.g. criteria, are dropped
+    for (auto& member : members)
+    {
+        for (auto& iter : member->m_nameToNodeMap)
+        {
+            if (replacements.find(iter.second) == replacements.end())
+                iter.second->DetachInputs();
+        }
+        for (auto group : member->GetAllNodeGroups())
+            group->clear();
+        member->m_nameToNodeMap.clear();
+    }
+
+    for (auto& iter : sharedInputs)
+        m_features.push_back(iter.second);
+    if (averageOutputs)
+    {
+        // average over the members, as ElementTimes(Plus(...), 1/N)
+        const wstring prefix0 = L"member0_";
+        for (auto& output : memberOutputs[0])
+        {
+            if (output->NodeName().compare(0, prefix0.size(), prefix0) != 0)
+                continue; // an input node
+            const wstring name = output->NodeName().substr(prefix0.size());
+            vector<ComputationNodeBasePtr> outputs(1, output);
+            for (size_t i = 1; i < members.size(); i++)
+            {
+                auto iter = find_if(memberOutputs[i].begin(), memberOutputs[i].end(), [&](const ComputationNodeBasePtr& node)
+                {
+                    return node->NodeName() == L"member" + to_wstring(i) + L"_" + name;
+                });
+                if (iter != memberOutputs[i].end())
+                    outputs.push_back(*iter);
+            }
+            if (outputs.size() != members.size())
+            {
+                fprintf(stderr, "MergeEnsemble: Output %ls is not averaged, since not all members have it.\n", name.c_str());
+                m_outputNodes.insert(m_outputNodes.end(), outputs.begin(), outputs.end());
+                continue;
+            }
+            ComputationNodeBasePtr sum = outputs[0];
+            for (size_t i = 1; i < outputs.size(); i++)
+                sum = AddNodeToNetAndAttachInputs(New<PlusNode<ElemType>>(m_deviceId, name + L"_sum" + to_wstring(i)), sum, outputs[i]);
+            auto scale = AddNodeToNetWithElemType(New<LearnableParameter<ElemType>>(m_deviceId, name + L"_scale", 1, 1));
+            scale->Value().SetValue((ElemType) 1 / members.size());
+            static_pointer_cast<ComputationNodeBase>(scale)->SetLearningRateMultiplier(0);
+            m_outputNodes.push_back(AddNodeToNetAndAttachInputs(New<ElementTimesNode<ElemType>>(m_deviceId, name), sum, scale));
+        }
+    }
+    else
+    {
+        for (auto& outputs : memberOutputs)
+            m_outputNodes.insert(m_outputNodes.end(), outputs.begin(), outputs.end());
+    }
+
+    CompileNetwork();
+    fprintf(stderr, "MergeEnsemble: %d members merged into %d nodes; %d nodes are shared (%d inputs).\n",
+            (int) members.size(), (int) m_nameToNodeMap.size(), (int) sharedNodes.size(), (int) sharedInputs.size());
+    return sharedNodes.size();
+}
+
 // save network to legacy DBN.exe format
 class DbnLayer
 {
@@ -1330,18 +2122,34 @@ template void ComputationNetwork::InitLearnableParameters<float>(const Computati
 template void ComputationNetwork::Read<float>(const wstring& fileName);
 template void ComputationNetwork::ReadPersistableParameters<float>(File& fstream, bool create);
 template void ComputationNetwork::PerformSVDecomposition<float>(const map<wstring, float>& SVDConfig, size_t alignedsize);
+template size_t ComputationNetwork::QuantizeWeightsToInt8<float>();
+template size_t ComputationNetwork::PruneParameters<float>(const wstring& nodeNameRegex, double sparsity, size_t blockRows, size_t blockCols);
+template size_t ComputationNetwork::UseBlockSparseWeights<float>(size_t blockRows, size_t blockCols, double minSparsity);
+template size_t ComputationNetwork::PackWeights<float>();
+template size_t ComputationNetwork::FoldNormalizationIntoWeights<float>();
+template size_t ComputationNetwork::MergeEnsemble<float>(const vector<ComputationNetworkPtr>& members, bool averageOutputs);
 template /*static*/ void ComputationNetwork::SetDropoutRate<float>(ComputationNetworkPtr net, const ComputationNodeBasePtr& criterionNode, const double dropoutRate, double& prevDropoutRate, unsigned long& dropOutSeed);
+template /*static*/ void ComputationNetwork::SetDropoutCounterBasedRNG<float>(ComputationNetworkPtr net, const ComputationNodeBasePtr& criterionNode, const bool counterBasedRNG);
 template void ComputationNetwork::SetSeqParam<float>(ComputationNetworkPtr net, const ComputationNodeBasePtr criterionNode, const double& hsmoothingWeight, const double& frameDropThresh, const bool& doreferencealign,
-                                                     const double& amf, const double& lmf, const double& wp, const double& bMMIfactor, const bool& sMBR);
+                                                     const double& amf, const double& lmf, const double& wp, const double& bMMIfactor, const bool& sMBR,
+                                                     const size_t& latticeCacheSizeMB, const double& latticePruneBeam);
 template void ComputationNetwork::SaveToDbnFile<float>(ComputationNetworkPtr net, const std::wstring& fileName) const;
 
 template void ComputationNetwork::InitLearnableParameters<double>(const ComputationNodeBasePtr& node, const bool uniformInit, const unsigned long randomSeed, const double initValueScale, bool initOnCPUOnly);
 template void ComputationNetwork::Read<double>(const wstring& fileName);
 template void ComputationNetwork::ReadPersistableParameters<double>(File& fstream, bool create);
 template void ComputationNetwork::PerformSVDecomposition<double>(const map<wstring, float>& SVDConfig, size_t alignedsize);
+template size_t ComputationNetwork::QuantizeWeightsToInt8<double>();
+template size_t ComputationNetwork::PruneParameters<double>(const wstring& nodeNameRegex, double sparsity, size_t blockRows, size_t blockCols);
+template size_t ComputationNetwork::UseBlockSparseWeights<double>(size_t blockRows, size_t blockCols, double minSparsity);
+template size_t ComputationNetwork::PackWeights<double>();
+template size_t ComputationNetwork::FoldNormalizationIntoWeights<double>();
+template size_t ComputationNetwork::MergeEnsemble<double>(const vector<ComputationNetworkPtr>& members, bool averageOutputs);
 template /*static*/ void ComputationNetwork::SetDropoutRate<double>(ComputationNetworkPtr net, const ComputationNodeBasePtr& criterionNode, const double dropoutRate, double& prevDropoutRate, unsigned long& dropOutSeed);
+template /*static*/ void ComputationNetwork::SetDropoutCounterBasedRNG<double>(ComputationNetworkPtr net, const ComputationNodeBasePtr& criterionNode, const bool counterBasedRNG);
 template void ComputationNetwork::SetSeqParam<double>(ComputationNetworkPtr net, const ComputationNodeBasePtr criterionNode, const double& hsmoothingWeight, const double& frameDropThresh, const bool& doreferencealign,
-                                                      const double& amf, const double& lmf, const double& wp, const double& bMMIfactor, const bool& sMBR);
+                                                      const double& amf, const double& lmf, const double& wp, const double& bMMIfactor, const bool& sMBR,
+                                                      const size_t& latticeCacheSizeMB, const double& latticePruneBeam);
 template void ComputationNetwork::SaveToDbnFile<double>(ComputationNetworkPtr net, const std::wstring& fileName) const;
 
 // register ComputationNetwork with the ScriptableObject system
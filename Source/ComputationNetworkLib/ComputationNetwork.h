@@ -8,6 +8,9 @@
 #include "Basics.h"
 #include "File.h"
 #include "Matrix.h"
+#include "ComputeStreamPool.h"
+#include "ComputeGraph.h"
+#include "NodeProfiler.h"
 #include "Config.h"
 
 #include "ComputationNode.h"
@@ -27,6 +30,7 @@
 #include <chrono>
 #include <unordered_map>
 #include <set>
+#include <functional>
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -46,6 +50,12 @@ public:
     ComputationNetwork()
         : m_randomSeedOffset(0),
           m_isCompiled(false),
+          m_areElementWiseNodesFused(false),
+          m_numComputeStreams(1),
+          m_saveCompiledPlan(false),
+          m_hasDimsFromCompiledPlan(false),
+          m_saveAlignedParameters(false),
+          m_mapModelParameters(false),
           m_pMBLayout(make_shared<MBLayout>())
     {
     }
@@ -71,6 +81,26 @@ public:
 
     DEVICEID_TYPE GetDeviceId() const { return m_deviceId; }
 
+    // number of CUDA streams on which independent nodes are computed concurrently, takes effect with AllocateAllMatrices()
+    void SetNumComputeStreams(size_t numComputeStreams) { m_numComputeStreams = max(numComputeStreams, (size_t) 1); }
+
+    // capture forward and backward passes into CUDA graphs, and replay them for later minibatches of the same shape (see ComputeGraphCache)
+    void SetUseComputeGraphs(bool useComputeGraphs);
+
+    // nodes whose values are recomputed in backprop rather than kept from forward prop, or {L"auto"}; takes effect with AllocateAllMatrices()
+    void SetRecomputedNodes(const std::vector<std::wstring>& nodeNames) { m_recomputedNodeNames = nodeNames; }
+
+    // nodes whose values are kept in host memory between forward prop and backprop; takes effect with AllocateAllMatrices()
+    void SetOffloadedNodes(const std::vector<std::wstring>& nodeNames) { m_offloadedNodeNames = nodeNames; }
+
+    // profile the time, allocations and estimated FLOPs of each node (see NodeProfiler); the trace is only written if a file name is given
+    void EnableNodeProfiling(const std::wstring& traceFileName);
+    const shared_ptr<NodeProfiler>& GetNodeProfiler() const { return m_nodeProfiler; }
+
+    // if set, called for every top-level node right before its forward prop, on the stream it runs on
+    // (e.g. to make it wait for an update of its parameters that runs concurrently, see SGD); a recurrent loop is one node
+    void SetNodeForwardPropBegin(const std::function<void(const ComputationNodeBasePtr&)>& nodeForwardPropBegin);
+
     // -----------------------------------------------------------------------
     // (de-)serialization
     // -----------------------------------------------------------------------
@@ -105,7 +135,16 @@ public:
         return net;
     }
 
-    void Save(const std::wstring& fileName, const FileOptions fileFormat = FileOptions::fileOptionsBinary) const;
+    // If 'syncToDisk', this returns after the file is on the disk, e.g. for checkpoints that are written in the background.
+    void Save(const std::wstring& fileName, const FileOptions fileFormat = FileOptions::fileOptionsBinary, bool syncToDisk = false) const;
+
+    // whether Save() also writes the compiled plan, so that Load() can skip the iterative validation (see SaveCompiledPlan())
+    void SetSaveCompiledPlan(bool saveCompiledPlan) { m_saveCompiledPlan = saveCompiledPlan; }
+    // whether Save() writes the parameter matrices as aligned blocks (File::fileOptionsAlignedBlocks), which Read() can map into memory
+    void SetSaveAlignedParameters(bool saveAlignedParameters) { m_saveAlignedParameters = saveAlignedParameters; }
+    // whether Read() maps aligned parameter matrices copy-on-write (File::fileOptionsMapBlocks), instead of reading them
+    // On the CPU, the parameters then use the pages of the file, which processes that map the same model share.
+    void SetMapModelParameters(bool mapModelParameters) { m_mapModelParameters = mapModelParameters; }
     void SaveEdited(const std::wstring& fileName, const FileOptions fileFormat = FileOptions::fileOptionsBinary);
 
     template <class ElemType>
@@ -113,7 +152,10 @@ public:
 
 private:
 
-    void SaveToFileImpl(const std::wstring& fileName, const FileOptions fileFormat) const;
+    void SaveToFileImpl(const std::wstring& fileName, const FileOptions fileFormat, bool syncToDisk) const;
+    void SaveCompiledPlan(File& fstream) const;
+    void ReadCompiledPlan(File& fstream);
+    size_t GetStructureFingerprint() const;
 
 public:
 
@@ -125,7 +167,13 @@ public:
     void ForwardProp(const ComputationNodeBasePtr rootNode);
 
     // main entry point for backprop
-    void Backprop(const ComputationNodeBasePtr rootNode);
+    // The root gradient is normally 1; loss scaling passes a larger value, see SGD.
+    // If given, 'nodeBackpropDone' is called for every top-level node right after its backprop, in reverse evaluation order.
+    // Once it is called for a leaf (e.g. a LearnableParameter), the gradient of that leaf is complete.
+    // With accumulateParameterGradients, the gradients of the parameters are added to those of the previous backprop.
+    void Backprop(const ComputationNodeBasePtr rootNode, double rootGradient = 1.0,
+                  const std::function<void(const ComputationNodeBasePtr&)>& nodeBackpropDone = nullptr,
+                  bool accumulateParameterGradients = false);
 
     template <class NODESET> // version that takes multiple nodes
     void ForwardProp(const NODESET& nodes)
@@ -163,7 +211,9 @@ public:
     void CompileNetwork(); // call this after creation, Load(), and any modification
 
 private:
+    void InsertDeviceTransferNodes();
     void ValidateNetwork();
+    list<ComputationNodeBasePtr> DetermineNodesToValidate(const list<ComputationNodeBasePtr>& nodes) const;
     void ValidateNodes(list<ComputationNodeBasePtr> nodes, bool isFinalValidationPass, size_t& todo);
     void MarkValueNonSharableNodes();
 
@@ -175,9 +225,25 @@ private:
     void VerifyIsCompiled(const char* where) const;
 public:
     void AllocateAllMatrices(const std::vector<ComputationNodeBasePtr>& evalRootNodes, const std::vector<ComputationNodeBasePtr>& outValueRootNodes, ComputationNodeBasePtr trainRootNode);
+    // bytes of the matrices planned by the last AllocateAllMatrices() on a device, for a number of samples per minibatch (linear in it)
+    size_t GetPlannedMemoryInBytes(DEVICEID_TYPE deviceId, size_t mbSize) const { return m_matrixPool.GetPlannedPeakMemoryInBytes(deviceId, mbSize); }
 
 private:
+    void FuseActivations(const std::vector<ComputationNodeBasePtr>& forwardPropRoots);
+    void FuseElementWiseNodes(const std::vector<ComputationNodeBasePtr>& forwardPropRoots, bool performingBackPropagation);
+    void AssignComputeStreams();
+    void PlanValueOffload(const ComputationNodeBasePtr& trainRootNode,
+                          const std::unordered_map<ComputationNodeBasePtr, std::unordered_set<ComputationNodeBasePtr>>& parentsMap,
+                          const std::unordered_map<ComputationNodeBasePtr, bool>& outputValueNeededDuringBackProp,
+                          std::map<ComputationNodeBasePtr, std::vector<ComputationNodeBasePtr>>& prefetchedBefore);
+    void PlanRecomputation(const ComputationNodeBasePtr& trainRootNode,
+                           const std::unordered_map<ComputationNodeBasePtr, std::unordered_set<ComputationNodeBasePtr>>& parentsMap,
+                           std::unordered_map<ComputationNodeBasePtr, bool>& outputValueNeededDuringBackProp,
+                           std::map<ComputationNodeBasePtr, std::vector<ComputationNodeBasePtr>>& recomputedBefore);
     void ReleaseMatricesAfterEvalForChildren(ComputationNodeBasePtr n, std::unordered_map<ComputationNodeBasePtr, int>& parentCount);
+    bool IsValueComputedInPlace(const ComputationNodeBasePtr& node, const std::vector<ComputationNodeBasePtr>& forwardPropRoots,
+                                const std::unordered_map<ComputationNodeBasePtr, int>& parentCount,
+                                const std::unordered_map<ComputationNodeBasePtr, bool>& outputValueNeededDuringBackProp) const;
     void AllocateGradientMatricesForInputs(ComputationNodeBasePtr parentNode);
 
 public:
@@ -239,6 +305,15 @@ public:
         return m_evalOrders[rootNode];
     }
 
+    const std::list<ComputationNodeBasePtr>& GetEvalOrder(const ComputationNodeBasePtr& rootNode) const
+    {
+        auto iter = m_evalOrders.find(rootNode);
+        if (iter == m_evalOrders.end())
+            LogicError("GetEvalOrder: Called without prior call to FormEvalOrder() for %ls %ls operation", rootNode->NodeName().c_str(), rootNode->OperationName().c_str());
+
+        return iter->second;
+    }
+
 protected:
     class SEQTraversalFlowControlNode;
 
@@ -332,6 +407,10 @@ public:
     void SetLearnableNodesBelowLearningRateMultiplier(const float learningRateMultiplier, const ComputationNodeBasePtr& rootNode = nullptr);
     void SetBatchNormalizationNodesBelowEvalMode(const bool evalMode, const ComputationNodeBasePtr& rootNode = nullptr);
 
+    // device placement of nodes, for model parallelism
+    void SetNodeDevice(const ComputationNodeBasePtr& node, DEVICEID_TYPE deviceId);
+    size_t SetNodesDevice(const std::wstring& nodeNamePattern, DEVICEID_TYPE deviceId); // pattern as for GetNodesFromName(), returns the number of nodes
+
     // -----------------------------------------------------------------------
     // node access
     // -----------------------------------------------------------------------
@@ -388,6 +467,9 @@ public:
     template <class ElemType>
     static void SetDropoutRate(ComputationNetworkPtr net, const ComputationNodeBasePtr& criterionNode, const double dropoutRate, double& prevDropoutRate, unsigned long& dropOutSeed);
 
+    template <class ElemType>
+    static void SetDropoutCounterBasedRNG(ComputationNetworkPtr net, const ComputationNodeBasePtr& criterionNode, const bool counterBasedRNG);
+
     template <class ElemType>
     static void SetSeqParam(ComputationNetworkPtr net,
                             const ComputationNodeBasePtr criterionNode,
@@ -398,7 +480,9 @@ public:
                             const double& lmf = 14.0f,
                             const double& wp = 0.0f,
                             const double& bMMIfactor = 0.0f,
-                            const bool& sMBR = false);
+                            const bool& sMBR = false,
+                            const size_t& latticeCacheSizeMB = 0,
+                            const double& latticePruneBeam = 0);
     static void SetMaxTempMemSizeForCNN(ComputationNetworkPtr net, const ComputationNodeBasePtr& criterionNode, const size_t maxTempMemSizeInSamples);
 
     // -----------------------------------------------------------------------
@@ -531,6 +615,37 @@ public:
     template <class ElemType>
     void PerformSVDecomposition(const map<wstring, float>& SVDConfig, size_t AlignedSize);
 
+    // replaces the weights of all quantizable nodes by int8 copies, for inference on the CPU; returns the number of nodes
+    template <class ElemType>
+    size_t QuantizeWeightsToInt8();
+
+    // zeroes the blocks of smallest L2 norm in the matrix parameters whose names match; returns the number of pruned parameters
+    template <class ElemType>
+    size_t PruneParameters(const wstring& nodeNameRegex, double sparsity, size_t blockRows, size_t blockCols);
+
+    // replaces the pruned weights of Times nodes by block-sparse copies, for inference on the CPU; returns the number of nodes
+    template <class ElemType>
+    size_t UseBlockSparseWeights(size_t blockRows, size_t blockCols, double minSparsity);
+
+    // replaces the remaining constant weights of Times nodes by copies packed for GEMM, for inference on the CPU; returns the number of nodes
+    template <class ElemType>
+    size_t PackWeights();
+
+    // folds BatchNormalization and PerDimMeanVarNormalization into the weights of Times and Convolution nodes; returns the number of folded nodes
+    template <class ElemType>
+    size_t FoldNormalizationIntoWeights();
+
+    // merges the networks of an ensemble into this empty network, sharing inputs and identical nodes; returns the number of shared nodes
+    template <class ElemType>
+    size_t MergeEnsemble(const vector<ComputationNetworkPtr>& members, bool averageOutputs);
+
+private:
+    // common part of QuantizeWeightsToInt8(), UseBlockSparseWeights() and PackWeights()
+    template <class ElemType>
+    size_t SwitchToWeightCopies(const char* where, const char* copyKind, const function<ComputationNodeBasePtr(const ComputationNodeBasePtr&)>& switchNode);
+
+public:
+
     // -----------------------------------------------------------------------
     // construction
     // -----------------------------------------------------------------------
@@ -596,10 +711,21 @@ public:
     // zeroes out all gradients except the root itself
     // TODO: why not the root?
     // (Note that inside the nodes this only really sets a flag to do it later when needed, but that's not our concern.)
-    void ZeroGradients(const ComputationNodeBasePtr& rootNode)
+    // With keepParameterGradients, the learnable parameters whose gradients the last backprop computed keep them,
+    // and the next backprop adds to them, e.g. to accumulate the gradients of the sub-minibatches of a minibatch.
+    void ZeroGradients(const ComputationNodeBasePtr& rootNode, bool keepParameterGradients = false)
     {
+        std::vector<ComputationNodeBasePtr> keptGradients;
+        if (keepParameterGradients)
+        {
+            for (auto& node : LearnableParameterNodes(rootNode))
+                if (node->IsGradientInitialized())
+                    keptGradients.push_back(node);
+        }
         for (auto& node : GetEvalOrder(rootNode)) // note: any order will do
             node->ZeroGradientsOfInputs();
+        for (auto& node : keptGradients)
+            node->KeepGradient();
     }
 
 private:
@@ -788,6 +914,33 @@ protected:
     // The outermost network level is also represented by this node for execution.
     // -----------------------------------------------------------------------
 
+    // -----------------------------------------------------------------------
+    // ComputeGraphCache -- CUDA graphs of the passes of the nested networks (see SetUseComputeGraphs())
+    //
+    // A pass is identified by its signature: the nested network and direction, the minibatch dimensions, the nodes that
+    // run, the buffers of their values and gradients, and which gradients are initialized already. The first pass with a
+    // signature runs eagerly, the second one is captured into a graph, and later ones launch that graph instead of calling
+    // the nodes. A pass that cannot be captured (e.g. one that reads values back to the host) runs eagerly. An eager pass
+    // may reallocate any buffer and change state that nodes keep between passes, so it invalidates all graphs; a signature
+    // whose graph is invalidated before it was ever replayed is run eagerly from then on.
+    // -----------------------------------------------------------------------
+
+    struct ComputeGraphCache
+    {
+        struct Entry
+        {
+            size_t m_numEagerRuns = 0;
+            size_t m_numLaunches = 0;
+            size_t m_numWastedGraphs = 0;
+            bool m_eagerOnly = false;
+            unique_ptr<ComputeGraph> m_graph;
+            std::vector<bool> m_gradientInitialized; // [i] state of nested node i after the pass
+        };
+        std::map<std::vector<size_t>, Entry> m_entries; // [signature]
+
+        void InvalidateGraphs();
+    };
+
     class PARTraversalFlowControlNode : public FlowControlNode
     {
         typedef FlowControlNode Base;
@@ -827,6 +980,48 @@ protected:
         // There is currently no other constructor for inner nested PAR-traversed sub-networks, but there will be.
         PARTraversalFlowControlNode(const std::vector<shared_ptr<SEQTraversalFlowControlNode>>& recurrentInfo, const std::list<ComputationNodeBasePtr>& allNodes);
         // Base::m_nestedNodes contains all top-level nodes, in evaluation order
+
+        // if set, called after the backprop of each nested node (see ComputationNetwork::Backprop())
+        std::function<void(const ComputationNodeBasePtr&)> m_nodeBackpropDone;
+
+        // if set, called before the forward prop of each nested node (see ComputationNetwork::SetNodeForwardPropBegin())
+        std::function<void(const ComputationNodeBasePtr&)> m_nodeForwardPropBegin;
+
+        // run the nested nodes on the streams of this pool (see ComputationNetwork::AssignComputeStreams()), or on the current stream if null
+        void SetComputeStreamPool(const shared_ptr<ComputeStreamPool>& computeStreamPool);
+
+        // if set, the nested nodes are profiled
+        shared_ptr<NodeProfiler> m_nodeProfiler;
+
+        const std::vector<ComputationNodeBasePtr>& GetNestedNodes() const { return m_nestedNodes; }
+
+        // recompute these nodes before the backprop of the given nested nodes (see ComputationNetwork::PlanRecomputation())
+        void SetRecomputation(const std::map<ComputationNodeBasePtr, std::vector<ComputationNodeBasePtr>>& recomputedBefore);
+
+        // copy these offloaded values back before the backprop of the given nested nodes, and wait for them before that of others
+        // (see ComputationNetwork::PlanValueOffload())
+        void SetValuePrefetch(const std::map<ComputationNodeBasePtr, std::vector<ComputationNodeBasePtr>>& prefetchedBefore,
+                              const std::map<ComputationNodeBasePtr, std::vector<ComputationNodeBasePtr>>& prefetchAwaitedBefore);
+
+        // if set, passes are run from CUDA graphs where possible
+        shared_ptr<ComputeGraphCache> m_computeGraphs;
+
+    private:
+        void ForwardPropNodes(const FrameRange& fr);
+        void BackpropNodes(const FrameRange& fr);
+        bool RunComputeGraph(const FrameRange& fr, bool isBackprop);
+        bool GetComputeGraphSignature(bool isBackprop, const std::vector<bool>& runs, std::vector<size_t>& signature) const;
+
+        void UseStreamOf(size_t i);
+        void WaitFor(size_t i, size_t j); // makes node i wait for the last work recorded for node j, if that is on another stream
+
+        shared_ptr<ComputeStreamPool> m_computeStreamPool;
+        std::vector<std::vector<size_t>> m_nestedInputs; // [i] positions of the nested nodes whose values m_nestedNodes[i] reads
+        std::vector<bool> m_isRecorded;                  // [i] work of node i was recorded in the current pass
+        std::vector<size_t> m_lastGradientWriter;        // [i] node that last added to the gradient of node i in the current pass
+        std::vector<std::vector<ComputationNodeBasePtr>> m_recomputedBefore; // [i] nodes to recompute before the backprop of node i, in eval order; empty if none
+        std::vector<std::vector<ComputationNodeBasePtr>> m_prefetchedBefore;     // [i] offloaded values to copy back before the backprop of node i; empty if none
+        std::vector<std::vector<ComputationNodeBasePtr>> m_prefetchAwaitedBefore; // [i] those the backprop of node i reads first
     };
 
 public:
@@ -881,11 +1076,36 @@ private:
 
     // cache for evaluation ordering:
     bool m_isCompiled; // CompileNetwork has been called
+    bool m_areElementWiseNodesFused; // FuseElementWiseNodes() has been called since CompileNetwork(); later calls may only undo fusions
+
+    size_t m_numComputeStreams;
+    shared_ptr<ComputeStreamPool> m_computeStreamPool; // null unless the nodes run on several streams
+    std::vector<std::wstring> m_recomputedNodeNames;
+    std::vector<std::wstring> m_offloadedNodeNames;
+    shared_ptr<NodeProfiler> m_nodeProfiler; // null unless EnableNodeProfiling()
+    shared_ptr<ComputeGraphCache> m_computeGraphs; // null unless SetUseComputeGraphs()
+    std::function<void(const ComputationNodeBasePtr&)> m_nodeForwardPropBegin; // for all nested networks
+
+    bool m_saveCompiledPlan;
+    bool m_hasDimsFromCompiledPlan; // the node dimensions were set by ReadCompiledPlan(), and are only verified by the next ValidateNetwork()
+    bool m_saveAlignedParameters;
+    bool m_mapModelParameters;
 
     // cached network iterations
     std::map<const ComputationNodeBasePtr, std::list<ComputationNodeBasePtr>> m_evalOrders; // [out node] flat depth-first traversal starting from out node
     std::map<const ComputationNodeBasePtr, ComputationNodeBasePtr> m_nestedNetworks;        // [out node] network rewritten as recursive traveral, potentially optimized; execution plan
 
+    // state of each node at the end of the last ValidateNetwork(), so that the next one only re-validates nodes that changed since,
+    // and the nodes that depend on them. Cleared when validation starts, so an aborted validation leads to a full one.
+    struct ValidatedNodeState
+    {
+        std::vector<ComputationNodeBasePtr> m_inputs;
+        TensorShape m_sampleLayout;
+        bool m_hasMBLayout;
+        bool m_isParameterUpdateRequired;
+    };
+    std::map<ComputationNodeBasePtr, ValidatedNodeState> m_validatedNodeStates;
+
     // cached quick-access list for inputs and parameters
     std::map<const ComputationNodeBasePtr, std::list<ComputationNodeBasePtr>> m_inputValues;         // [out node] -> all input nodes feeding into out node
     std::map<const ComputationNodeBasePtr, std::list<ComputationNodeBasePtr>> m_learnableParameters; // [out node] -> all parameter nodes feeding into out node
@@ -149,9 +149,21 @@ void ComputationNetwork::FormRecurrentLoops(const ComputationNodeBasePtr& rootNo
     }
 
     // log the loops
+    // A loop is a strongly connected component, so it only contains nodes that depend on the recurrence. Everything else
+    // feeding into it, such as the input projection W*x(t) of an LSTM, is outside and computed once for the whole minibatch
+    // in PAR mode, as are the gradients into it (see SEQTraversalFlowControlNode::EndBackprop()). Those are logged as hoisted.
     for (auto& iter : m_allSEQNodes)
     {
-        fprintf(stderr, "\nLoop[%d] --> %ls -> %d nodes\n", (int) iter->m_loopId, iter->NodeName().c_str(), (int) iter->m_nestedNodes.size());
+        set<ComputationNodeBasePtr> hoistedInputs;
+        for (const auto& node : iter->m_nestedNodes)
+        {
+            for (const auto& input : node->GetInputs())
+            {
+                if (!input->IsLeaf() && input->m_loopId != iter->m_loopId)
+                    hoistedInputs.insert(input);
+            }
+        }
+        fprintf(stderr, "\nLoop[%d] --> %ls -> %d nodes, %d hoisted inputs\n", (int) iter->m_loopId, iter->NodeName().c_str(), (int) iter->m_nestedNodes.size(), (int) hoistedInputs.size());
         size_t n = 0;
         for (auto itr = iter->m_nestedNodes.begin(); itr != iter->m_nestedNodes.end(); itr++)
         {
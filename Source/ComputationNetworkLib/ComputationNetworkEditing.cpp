@@ -10,6 +10,7 @@
 #include "ComputationNetwork.h"
 #include "InputAndParamNodes.h"
 #include "TrainingNodes.h"
+#include "SpecialPurposeNodes.h"
 #include <string>
 #include <vector>
 #include <list>
@@ -360,4 +361,67 @@ void ComputationNetwork::SetBatchNormalizationNodesBelowEvalMode(const bool eval
         }
     }
 }
+// -----------------------------------------------------------------------
+// device placement (model parallelism)
+// -----------------------------------------------------------------------
+
+// place a node on another device than the network
+// The edges to nodes on other devices are taken care of by InsertDeviceTransferNodes() in CompileNetwork().
+void ComputationNetwork::SetNodeDevice(const ComputationNodeBasePtr& node, DEVICEID_TYPE deviceId)
+{
+    InvalidateCompiledNetwork();
+    node->MoveToDevice(deviceId);
+}
+
+size_t ComputationNetwork::SetNodesDevice(const std::wstring& nodeNamePattern, DEVICEID_TYPE deviceId)
+{
+    auto nodes = GetNodesFromName(nodeNamePattern);
+    for (auto& node : nodes)
+        SetNodeDevice(node, deviceId);
+    return nodes.size();
+}
+
+// insert a DeviceTransfer node into each edge from a node to a consumer on another device
+// Without these, the operations of the consumer would move the matrices of their inputs back and forth.
+// There is one transfer node per node and device, which is reused if the network is compiled again.
+void ComputationNetwork::InsertDeviceTransferNodes()
+{
+    list<ComputationNodeBasePtr> nodes;
+    for (auto& iter : m_nameToNodeMap)
+        nodes.push_back(iter.second);
+
+    size_t numInserted = 0;
+    for (auto& node : nodes)
+    {
+        if (node->OperationName() == OperationNameOf(DeviceTransferNode))
+            continue;
+
+        for (size_t i = 0; i < node->GetNumInputs(); i++)
+        {
+            ComputationNodeBasePtr input = node->Input(i);
+            DEVICEID_TYPE deviceId = node->GetDeviceId();
+            if (!input || input->GetDeviceId() == deviceId)
+                continue;
+
+            wstring transferName = input->NodeName() + (deviceId == CPUDEVICE ? wstring(L".onCPU") : L".onGPU" + std::to_wstring(deviceId));
+            ComputationNodeBasePtr transfer;
+            if (NodeNameExists(transferName))
+                transfer = GetNodeFromName(transferName);
+            else
+            {
+                if (dynamic_pointer_cast<ComputationNode<float>>(input))
+                    transfer = AddNodeToNet(New<DeviceTransferNode<float>>(deviceId, transferName));
+                else
+                    transfer = AddNodeToNet(New<DeviceTransferNode<double>>(deviceId, transferName));
+                transfer->AttachInputs({input});
+                numInserted++;
+            }
+            node->SetInput(i, transfer);
+        }
+    }
+
+    if (numInserted > 0)
+        fprintf(stderr, "\nInserted %d DeviceTransfer nodes between nodes on different devices.\n", (int) numInserted);
+}
+
 } } }
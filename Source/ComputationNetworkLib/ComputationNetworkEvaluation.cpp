@@ -16,6 +16,8 @@
 #include <set>
 #include <algorithm>
 #include <map>
+#include <functional>
+#include <unordered_set>
 
 using namespace std;
 
@@ -46,7 +48,7 @@ void ComputationNetwork::ForwardProp(const ComputationNodeBasePtr rootNode)
 // set the gradient matrix of a node to an 1x1 matrix containing 1.0
 // Returns false if the node is not a ComputationNode<ElemType>.
 template <class ElemType>
-static bool SetGradientToScalarOne(ComputationNodeBasePtr nodep)
+static bool SetGradientToScalar(ComputationNodeBasePtr nodep, double value)
 {
     auto node = dynamic_pointer_cast<ComputationNode<ElemType>>(nodep);
     bool hasMatchingType = (node != nullptr);
@@ -54,7 +56,7 @@ static bool SetGradientToScalarOne(ComputationNodeBasePtr nodep)
     {
         node->Value().VerifySize(1, 1);
         node->Gradient().Resize(1, 1);
-        node->Gradient().SetValue((ElemType) 1.0);
+        node->Gradient().SetValue((ElemType) value);
     }
     return hasMatchingType;
 }
@@ -64,17 +66,30 @@ static bool SetGradientToScalarOne(ComputationNodeBasePtr nodep)
 //  - ForwardProp() for eval nodes
 //  - ForwardProp() for the training criterion (which will reuse computation results from the previous step)
 //  - Backprop() for the training criterion
-void ComputationNetwork::Backprop(const ComputationNodeBasePtr rootNode) // training criterion to compute the gradients for
+void ComputationNetwork::Backprop(const ComputationNodeBasePtr rootNode, double rootGradient, // training criterion to compute the gradients for
+                                  const std::function<void(const ComputationNodeBasePtr&)>& nodeBackpropDone,
+                                  bool accumulateParameterGradients)
 {
     // reset all gradients to zero (actually, internally, this is lazy, but we don't care here)
-    ZeroGradients(rootNode);
+    ZeroGradients(rootNode, accumulateParameterGradients);
 
-    // initialize root gradient with a scalar value of 1.0
-    if (!SetGradientToScalarOne<float>(rootNode) && !SetGradientToScalarOne<double>(rootNode))
+    // initialize root gradient with a scalar value (1.0 unless the loss is scaled)
+    if (!SetGradientToScalar<float>(rootNode, rootGradient) && !SetGradientToScalar<double>(rootNode, rootGradient))
         LogicError("Backprop: Training criterion is neither ComputationNode<float> nor ComputationNode<double>.");
 
     // backpropagate through the network
-    GetNestedNetwork(rootNode)->Backprop(FrameRange(nullptr), true, true);
+    auto network = dynamic_pointer_cast<PARTraversalFlowControlNode>(GetNestedNetwork(rootNode));
+    network->m_nodeBackpropDone = nodeBackpropDone;
+    try
+    {
+        network->Backprop(FrameRange(nullptr), true, true);
+    }
+    catch (...)
+    {
+        network->m_nodeBackpropDone = nullptr;
+        throw;
+    }
+    network->m_nodeBackpropDone = nullptr;
 }
 
 void ComputationNetwork::FormNestedNetwork(const ComputationNodeBasePtr& rootNode)
@@ -82,7 +97,39 @@ void ComputationNetwork::FormNestedNetwork(const ComputationNodeBasePtr& rootNod
     if (m_nestedNetworks.find(rootNode) != m_nestedNetworks.end())
         fprintf(stderr, "FormNestedNetwork: WARNING: Was called twice for %ls %ls operation\n", rootNode->NodeName().c_str(), rootNode->OperationName().c_str());
 
-    m_nestedNetworks[rootNode] = make_shared<PARTraversalFlowControlNode>(m_allSEQNodes, GetEvalOrder(rootNode));
+    auto network = make_shared<PARTraversalFlowControlNode>(m_allSEQNodes, GetEvalOrder(rootNode));
+    network->m_nodeProfiler = m_nodeProfiler;
+    network->m_nodeForwardPropBegin = m_nodeForwardPropBegin;
+    network->m_computeGraphs = m_computeGraphs;
+    m_nestedNetworks[rootNode] = network;
+}
+
+void ComputationNetwork::SetUseComputeGraphs(bool useComputeGraphs)
+{
+    if (useComputeGraphs && !ComputeGraph::IsSupported())
+    {
+        fprintf(stderr, "SetUseComputeGraphs: CUDA graphs need CUDA 10.1 or later, and the caching GPU memory allocator. Running eagerly.\n");
+        useComputeGraphs = false;
+    }
+    if (useComputeGraphs == (m_computeGraphs != nullptr))
+        return;
+    m_computeGraphs = useComputeGraphs ? make_shared<ComputeGraphCache>() : nullptr;
+    for (const auto& keyValue : m_nestedNetworks)
+        dynamic_pointer_cast<PARTraversalFlowControlNode>(keyValue.second)->m_computeGraphs = m_computeGraphs;
+}
+
+void ComputationNetwork::EnableNodeProfiling(const wstring& traceFileName)
+{
+    m_nodeProfiler = make_shared<NodeProfiler>(m_deviceId, traceFileName);
+    for (const auto& keyValue : m_nestedNetworks)
+        dynamic_pointer_cast<PARTraversalFlowControlNode>(keyValue.second)->m_nodeProfiler = m_nodeProfiler;
+}
+
+void ComputationNetwork::SetNodeForwardPropBegin(const std::function<void(const ComputationNodeBasePtr&)>& nodeForwardPropBegin)
+{
+    m_nodeForwardPropBegin = nodeForwardPropBegin;
+    for (const auto& keyValue : m_nestedNetworks)
+        dynamic_pointer_cast<PARTraversalFlowControlNode>(keyValue.second)->m_nodeForwardPropBegin = m_nodeForwardPropBegin;
 }
 
 ComputationNodeBasePtr ComputationNetwork::GetNestedNetwork(const ComputationNodeBasePtr& rootNode)
@@ -127,32 +174,432 @@ ComputationNetwork::PARTraversalFlowControlNode::PARTraversalFlowControlNode(con
 }
 /*virtual*/ void ComputationNetwork::PARTraversalFlowControlNode::ForwardProp(const FrameRange& fr) /*override*/
 {
-    for (auto& node : m_nestedNodes)
+    if (!m_computeGraphs || !RunComputeGraph(fr, /*isBackprop=*/false))
+        ForwardPropNodes(fr);
+}
+
+/*virtual*/ void ComputationNetwork::PARTraversalFlowControlNode::Backprop(const FrameRange& fr, bool childrenInThisLoop, bool childrenInOuterLoop) /*override*/
+{
+    childrenInThisLoop, childrenInOuterLoop; // TODO: think through what these mean when coming from PAR mode
+    if (!m_computeGraphs || !RunComputeGraph(fr, /*isBackprop=*/true))
+        BackpropNodes(fr);
+}
+
+void ComputationNetwork::PARTraversalFlowControlNode::ForwardPropNodes(const FrameRange& fr)
+{
+    if (m_computeStreamPool)
     {
-        if (node->IsOutOfDateWrtInputs())
+        m_computeStreamPool->Fork();
+        m_isRecorded.assign(m_nestedNodes.size(), false);
+    }
+    if (m_nodeProfiler)
+        m_nodeProfiler->BeginPass();
+    try
+    {
+        for (size_t i = 0; i < m_nestedNodes.size(); i++)
         {
-            node->BeginForwardProp();
-            node->ForwardProp(fr.WithLayout(node->GetMBLayout()));
-            node->EndForwardProp();
+            auto& node = m_nestedNodes[i];
+            if (node->IsOutOfDateWrtInputs())
+            {
+                if (m_computeStreamPool)
+                {
+                    UseStreamOf(i);
+                    for (size_t j : m_nestedInputs[i])
+                        WaitFor(i, j);
+                }
+                if (m_nodeForwardPropBegin)
+                    m_nodeForwardPropBegin(node);
 
-            node->BumpEvalTimeStamp();
+                if (m_nodeProfiler)
+                    m_nodeProfiler->BeginNode(node, NodeProfiler::Phase::forward);
+
+                node->BeginForwardProp();
+                node->ForwardProp(fr.WithLayout(node->GetMBLayout()));
+                node->EndForwardProp();
+
+                // offloaded values, also those of other traversals (see ComputationNetwork::PlanValueOffload())
+                if (node->IsValueOffloadedForBackprop())
+                    node->BeginValueOffload();
+                for (const auto& input : node->GetInputs())
+                {
+                    if (input->IsValueOffloadedForBackprop())
+                        input->NotifyValueOffloadReaderDone();
+                }
+
+                if (m_nodeProfiler)
+                    m_nodeProfiler->EndNode();
+
+                node->BumpEvalTimeStamp();
+
+                if (m_computeStreamPool)
+                {
+                    m_computeStreamPool->Record(i);
+                    m_isRecorded[i] = true;
+                }
+            }
         }
     }
+    catch (...)
+    {
+        if (m_computeStreamPool)
+            m_computeStreamPool->Join();
+        throw;
+    }
+    if (m_computeStreamPool)
+        m_computeStreamPool->Join();
+    if (m_nodeProfiler)
+        m_nodeProfiler->EndPass();
 }
 
-/*virtual*/ void ComputationNetwork::PARTraversalFlowControlNode::Backprop(const FrameRange& fr, bool childrenInThisLoop, bool childrenInOuterLoop) /*override*/
+void ComputationNetwork::PARTraversalFlowControlNode::BackpropNodes(const FrameRange& fr)
 {
-    childrenInThisLoop, childrenInOuterLoop; // TODO: think through what these mean when coming from PAR mode
-    // process nodes in pre-determined order
-    for (auto pnode = m_nestedNodes.rbegin(); pnode != m_nestedNodes.rend(); pnode++) // iterate backwards over evaluation order
+    if (m_computeStreamPool)
+    {
+        m_computeStreamPool->Fork();
+        m_isRecorded.assign(m_nestedNodes.size(), false);
+        m_lastGradientWriter.assign(m_nestedNodes.size(), SIZE_MAX);
+    }
+    if (m_nodeProfiler)
+        m_nodeProfiler->BeginPass();
+    try
+    {
+        // process nodes in pre-determined order
+        for (size_t k = m_nestedNodes.size(); k-- > 0;) // iterate backwards over evaluation order
+        {
+            auto& node = m_nestedNodes[k];
+
+            // offloaded values that are read by the backprop of the next node, or of this one
+            if (!m_prefetchedBefore.empty())
+            {
+                for (auto& prefetchedNode : m_prefetchedBefore[k])
+                    prefetchedNode->BeginValuePrefetch();
+                for (auto& prefetchedNode : m_prefetchAwaitedBefore[k])
+                    prefetchedNode->EndValuePrefetch();
+            }
+
+            // values that were released after forward prop, and are read by the backprop of this node or of earlier ones
+            if (!m_recomputedBefore.empty())
+            {
+                for (auto& recomputedNode : m_recomputedBefore[k])
+                {
+                    if (m_nodeProfiler)
+                        m_nodeProfiler->BeginNode(recomputedNode, NodeProfiler::Phase::recompute);
+                    recomputedNode->BeginForwardProp();
+                    recomputedNode->ForwardProp(fr.WithLayout(recomputedNode->GetMBLayout()));
+                    recomputedNode->EndForwardProp();
+                    if (m_nodeProfiler)
+                        m_nodeProfiler->EndNode();
+                }
+            }
+
+            // The node reads its own gradient and adds to those of its inputs. The writers of a gradient are serialized,
+            // so waiting for the last one waits for all of them.
+            if (m_computeStreamPool)
+            {
+                UseStreamOf(k);
+                WaitFor(k, m_lastGradientWriter[k]);
+                for (size_t j : m_nestedInputs[k])
+                    WaitFor(k, m_lastGradientWriter[j]);
+            }
+
+            if (m_nodeProfiler)
+                m_nodeProfiler->BeginNode(node, NodeProfiler::Phase::backward);
+
+            node->BeginBackprop();
+            node->Backprop(fr.WithLayout(node->GetMBLayout()), true /*childrenInThisLoop*/, true /*childrenInOuterLoop*/);
+            node->EndBackprop();
+
+            if (m_nodeProfiler)
+                m_nodeProfiler->EndNode();
+
+            if (m_computeStreamPool)
+            {
+                m_computeStreamPool->Record(k);
+                m_isRecorded[k] = true;
+                for (size_t j : m_nestedInputs[k])
+                    m_lastGradientWriter[j] = k;
+            }
+
+            if (m_nodeBackpropDone)
+            {
+                // After the gradients reported so far, whichever stream computed them. The callback may start transfers of
+                // several of them at once, e.g. a bucket of the gradient aggregation.
+                if (m_computeStreamPool)
+                {
+                    m_computeStreamPool->UseCollectStream();
+                    m_computeStreamPool->Wait(k);
+                }
+                m_nodeBackpropDone(node);
+            }
+        }
+    }
+    catch (...)
+    {
+        if (m_computeStreamPool)
+            m_computeStreamPool->Join();
+        throw;
+    }
+    if (m_computeStreamPool)
+        m_computeStreamPool->Join();
+    if (m_nodeProfiler)
+        m_nodeProfiler->EndPass();
+}
+
+// -----------------------------------------------------------------------
+// CUDA graphs of the passes (see ComputeGraphCache)
+// -----------------------------------------------------------------------
+
+static const size_t MaxComputeGraphSignatures = 64; // beyond that, the minibatch shapes vary too much to keep a graph for each
+static const size_t MaxWastedComputeGraphs = 3;     // graphs of a signature that were invalidated before they were replayed
+
+void ComputationNetwork::ComputeGraphCache::InvalidateGraphs()
+{
+    for (auto& keyValue : m_entries)
+    {
+        auto& entry = keyValue.second;
+        if (!entry.m_graph)
+            continue;
+        entry.m_graph.reset();
+        if (entry.m_numLaunches < 2 && ++entry.m_numWastedGraphs >= MaxWastedComputeGraphs)
+            entry.m_eagerOnly = true; // the eager pass that invalidates it keeps recurring
+    }
+}
+
+// the signature of a pass (see ComputeGraphCache); returns false if the pass cannot be captured
+bool ComputationNetwork::PARTraversalFlowControlNode::GetComputeGraphSignature(bool isBackprop, const std::vector<bool>& runs, std::vector<size_t>& signature) const
+{
+    // these run host code between the nodes
+    if (m_computeStreamPool || m_nodeProfiler || (isBackprop ? (bool) m_nodeBackpropDone : (bool) m_nodeForwardPropBegin))
+        return false;
+
+    signature.push_back((size_t) this);
+    signature.push_back(isBackprop);
+    for (size_t i = 0; i < m_nestedNodes.size(); i++)
+    {
+        const auto& node = m_nestedNodes[i];
+        // recurrent loops run frame by frame, depending on the sequence boundaries
+        if (dynamic_pointer_cast<FlowControlNode>(node) || node->GetDeviceId() < 0)
+            return false;
+        if (runs[i] && !node->IsGraphCapturable())
+            return false;
+        signature.push_back(runs[i]);
+        if (isBackprop)
+            signature.push_back(node->IsGradientInitialized());
+        if (!node->AppendGraphSignature(signature))
+            return false;
+        if (node->HasMBLayout())
+        {
+            const auto& pMBLayout = node->GetMBLayout();
+            if (pMBLayout->HasGaps()) // masking depends on where the gaps are
+                return false;
+            signature.push_back(pMBLayout->GetNumParallelSequences());
+            signature.push_back(pMBLayout->GetNumTimeSteps());
+        }
+    }
+    return true;
+}
+
+// Run the pass from a CUDA graph, capturing it if it is the second pass with this signature (see ComputeGraphCache).
+// Returns false if the pass is to run eagerly instead.
+bool ComputationNetwork::PARTraversalFlowControlNode::RunComputeGraph(const FrameRange& fr, bool isBackprop)
+{
+    // the nodes that run: in backprop all of them; in forward prop those that are out of date, or whose inputs run
+    std::vector<bool> runs(m_nestedNodes.size(), isBackprop);
+    if (!isBackprop)
+    {
+        std::set<const ComputationNodeBase*> running;
+        for (size_t i = 0; i < m_nestedNodes.size(); i++)
+        {
+            const auto& node = m_nestedNodes[i];
+            bool run = node->IsOutOfDateWrtInputs();
+            for (size_t j = 0; j < node->GetNumInputs() && !run; j++)
+                run = running.find(node->Input(j).get()) != running.end();
+            if (run)
+            {
+                runs[i] = true;
+                running.insert(node.get());
+            }
+        }
+        if (running.empty()) // nothing to do, the eager pass won't change anything
+            return false;
+    }
+
+    std::vector<size_t> signature;
+    if (!GetComputeGraphSignature(isBackprop, runs, signature))
+    {
+        m_computeGraphs->InvalidateGraphs();
+        return false;
+    }
+    auto& entries = m_computeGraphs->m_entries;
+    if (entries.size() >= MaxComputeGraphSignatures && entries.find(signature) == entries.end())
+        entries.clear();
+    auto& entry = entries[signature];
+
+    if (entry.m_graph) // replay, and do what the host side of the pass would have done
+    {
+        entry.m_graph->Launch();
+        entry.m_numLaunches++;
+        for (size_t i = 0; i < m_nestedNodes.size(); i++)
+        {
+            if (isBackprop)
+                m_nestedNodes[i]->SetGradientInitialized(entry.m_gradientInitialized[i]);
+            else if (runs[i])
+                m_nestedNodes[i]->BumpEvalTimeStamp();
+        }
+        return true;
+    }
+    if (entry.m_eagerOnly || entry.m_numEagerRuns++ == 0) // the first pass allocates what the later ones reuse
     {
-        auto& node = *pnode;
+        m_computeGraphs->InvalidateGraphs();
+        return false;
+    }
+
+    // capture; if that fails, the host side of the pass is undone, so that it can run again eagerly
+    std::vector<TimeStamp> timeStamps(m_nestedNodes.size());
+    std::vector<bool> gradientInitialized(m_nestedNodes.size());
+    for (size_t i = 0; i < m_nestedNodes.size(); i++)
+    {
+        m_nestedNodes[i]->TimeStamp::CopyTo(timeStamps[i]);
+        gradientInitialized[i] = m_nestedNodes[i]->IsGradientInitialized();
+    }
+    unique_ptr<ComputeGraph> graph(new ComputeGraph(m_nestedNodes.front()->GetDeviceId()));
+    graph->BeginCapture();
+    try
+    {
+        if (isBackprop)
+            BackpropNodes(fr);
+        else
+            ForwardPropNodes(fr);
+    }
+    catch (...)
+    {
+        graph->EndCapture();
+        throw;
+    }
+    if (!graph->EndCapture())
+    {
+        for (size_t i = 0; i < m_nestedNodes.size(); i++)
+        {
+            timeStamps[i].CopyTo(*m_nestedNodes[i]);
+            m_nestedNodes[i]->SetGradientInitialized(gradientInitialized[i]);
+        }
+        entry.m_eagerOnly = true;
+        m_computeGraphs->InvalidateGraphs();
+        return false;
+    }
+
+    graph->Launch();
+    entry.m_graph = move(graph);
+    entry.m_numLaunches = 1;
+    entry.m_gradientInitialized.resize(m_nestedNodes.size());
+    for (size_t i = 0; i < m_nestedNodes.size(); i++)
+        entry.m_gradientInitialized[i] = m_nestedNodes[i]->IsGradientInitialized();
+    return true;
+}
+
+void ComputationNetwork::PARTraversalFlowControlNode::SetComputeStreamPool(const shared_ptr<ComputeStreamPool>& computeStreamPool)
+{
+    m_computeStreamPool = computeStreamPool;
+    m_nestedInputs.clear();
+    if (!m_computeStreamPool)
+        return;
+
+    // positions of the nested nodes, with the members of a loop at the position of their SEQTraversalFlowControlNode
+    map<ComputationNodeBasePtr, size_t> positions;
+    for (size_t i = 0; i < m_nestedNodes.size(); i++)
+    {
+        auto seqNode = dynamic_pointer_cast<SEQTraversalFlowControlNode>(m_nestedNodes[i]);
+        if (seqNode)
+        {
+            for (const auto& node : seqNode->m_nestedNodes)
+                positions[node] = i;
+        }
+        else
+            positions[m_nestedNodes[i]] = i;
+    }
+
+    m_nestedInputs.resize(m_nestedNodes.size());
+    for (size_t i = 0; i < m_nestedNodes.size(); i++)
+    {
+        auto seqNode = dynamic_pointer_cast<SEQTraversalFlowControlNode>(m_nestedNodes[i]);
+        list<ComputationNodeBasePtr> nodes;
+        if (seqNode)
+            nodes.assign(seqNode->m_nestedNodes.begin(), seqNode->m_nestedNodes.end());
+        else
+            nodes.push_back(m_nestedNodes[i]);
+
+        set<size_t> inputPositions;
+        for (const auto& node : nodes)
+        {
+            vector<ComputationNodeBasePtr> inputs = node->GetInputs();
+            if (node->IsForwardPropFused()) // the end of a fused chain reads the inputs of the chain
+                inputs.insert(inputs.end(), node->GetElementWiseFusion()->m_inputs.begin(), node->GetElementWiseFusion()->m_inputs.end());
+            if (node->HasFusedProducer()) // a fused activation reads the inputs of its producer (and of the producer's fused operand)
+            {
+                inputs.insert(inputs.end(), node->GetFusedProducer()->GetInputs().begin(), node->GetFusedProducer()->GetInputs().end());
+                auto operand = dynamic_pointer_cast<IActivationFusableNode>(node->GetFusedProducer())->GetFusedOperand();
+                if (operand)
+                    inputs.insert(inputs.end(), operand->GetInputs().begin(), operand->GetInputs().end());
+            }
+            for (const auto& input : inputs)
+            {
+                auto iter = positions.find(input);
+                if (iter != positions.end() && iter->second != i)
+                    inputPositions.insert(iter->second);
+            }
+        }
+        m_nestedInputs[i].assign(inputPositions.begin(), inputPositions.end());
+    }
+}
+
+void ComputationNetwork::PARTraversalFlowControlNode::SetRecomputation(const map<ComputationNodeBasePtr, vector<ComputationNodeBasePtr>>& recomputedBefore)
+{
+    m_recomputedBefore.clear();
+    if (recomputedBefore.empty())
+        return;
 
-        node->BeginBackprop();
-        node->Backprop(fr.WithLayout(node->GetMBLayout()), true /*childrenInThisLoop*/, true /*childrenInOuterLoop*/);
-        node->EndBackprop();
+    m_recomputedBefore.resize(m_nestedNodes.size());
+    for (size_t i = 0; i < m_nestedNodes.size(); i++)
+    {
+        auto iter = recomputedBefore.find(m_nestedNodes[i]);
+        if (iter != recomputedBefore.end())
+            m_recomputedBefore[i] = iter->second;
     }
 }
+
+void ComputationNetwork::PARTraversalFlowControlNode::SetValuePrefetch(const map<ComputationNodeBasePtr, vector<ComputationNodeBasePtr>>& prefetchedBefore,
+                                                                     const map<ComputationNodeBasePtr, vector<ComputationNodeBasePtr>>& prefetchAwaitedBefore)
+{
+    m_prefetchedBefore.clear();
+    m_prefetchAwaitedBefore.clear();
+    if (prefetchedBefore.empty())
+        return;
+
+    m_prefetchedBefore.resize(m_nestedNodes.size());
+    m_prefetchAwaitedBefore.resize(m_nestedNodes.size());
+    for (size_t i = 0; i < m_nestedNodes.size(); i++)
+    {
+        auto iter = prefetchedBefore.find(m_nestedNodes[i]);
+        if (iter != prefetchedBefore.end())
+            m_prefetchedBefore[i] = iter->second;
+        iter = prefetchAwaitedBefore.find(m_nestedNodes[i]);
+        if (iter != prefetchAwaitedBefore.end())
+            m_prefetchAwaitedBefore[i] = iter->second;
+    }
+}
+
+void ComputationNetwork::PARTraversalFlowControlNode::UseStreamOf(size_t i)
+{
+    m_computeStreamPool->Use(m_nestedNodes[i]->GetComputeStream());
+}
+
+// Work that was not recorded in this pass was issued before the Fork() and is waited for already.
+void ComputationNetwork::PARTraversalFlowControlNode::WaitFor(size_t i, size_t j)
+{
+    if (j != SIZE_MAX && m_isRecorded[j] && m_nestedNodes[j]->GetComputeStream() != m_nestedNodes[i]->GetComputeStream())
+        m_computeStreamPool->Wait(j);
+}
+
 /*virtual*/ void ComputationNetwork::PARTraversalFlowControlNode::RequestMatricesBeforeForwardProp(MatrixPool& matrixPool) /*override*/
 {
 }
@@ -367,6 +814,12 @@ void ComputationNetwork::PrintComputationTree(const ComputationNodeBasePtr& root
 void ComputationNetwork::InvalidateCompiledNetwork()
 {
     m_isCompiled = false;
+    if (m_areElementWiseNodesFused)
+    {
+        for (auto& keyValue : m_nameToNodeMap)
+            keyValue.second->ClearElementWiseFusion();
+        m_areElementWiseNodesFused = false;
+    }
     m_allSEQNodes.clear();
     m_evalOrders.clear();
     m_nestedNetworks.clear();
@@ -391,6 +844,9 @@ void ComputationNetwork::CompileNetwork()
 {
     fprintf(stderr, "\nPost-processing network...\n");
 
+    // STEP: Connect nodes on different devices (model parallelism).
+    InsertDeviceTransferNodes();
+
     // all steps below have to be repeated for all root nodes (=nodes without parents and PreComputeNodes)
     DetermineSetOfAllRoots();
 
@@ -422,6 +878,7 @@ void ComputationNetwork::CompileNetwork()
         FormNestedNetwork(node);
 
     // STEP: Infer node dimensions.
+    // After an edit of a compiled network, only the nodes affected by the edit are validated again.
     ValidateNetwork();
 
     // STEP: Optimize the network.
@@ -495,10 +952,66 @@ void ComputationNetwork::DetermineSetOfAllRoots()
 // validation
 // -----------------------------------------------------------------------
 
+// helper to discover dimension changes
+static pair<TensorShape, bool> GetDims(const ComputationNodeBasePtr& node)
+{
+    return make_pair(node->GetSampleLayout(), node->HasMBLayout());
+}
+
+// determine the nodes that ValidateNetwork() has to validate, in evaluation order
+// These are all nodes unless the network was validated before. Then they are the nodes that were added since, or whose
+// inputs, dimensions, or need for a parameter update were changed (e.g. by model editing), and all nodes that depend on them.
+list<ComputationNodeBasePtr> ComputationNetwork::DetermineNodesToValidate(const list<ComputationNodeBasePtr>& nodes) const
+{
+    if (m_validatedNodeStates.empty())
+        return nodes;
+
+    set<ComputationNodeBasePtr> affected;
+    for (auto& node : nodes)
+    {
+        auto iter = m_validatedNodeStates.find(node);
+        if (iter == m_validatedNodeStates.end() ||
+            iter->second.m_inputs != node->GetInputs() ||
+            make_pair(iter->second.m_sampleLayout, iter->second.m_hasMBLayout) != GetDims(node) ||
+            iter->second.m_isParameterUpdateRequired != node->IsParameterUpdateRequired())
+        {
+            affected.insert(node);
+        }
+    }
+
+    // propagate to the consumers; repeat since the inputs of delay nodes may come later in the evaluation order
+    size_t numAffected;
+    do
+    {
+        numAffected = affected.size();
+        for (auto& node : nodes)
+        {
+            for (auto& input : node->GetInputs())
+            {
+                if (affected.find(input) != affected.end())
+                {
+                    affected.insert(node);
+                    break;
+                }
+            }
+        }
+    } while (affected.size() != numAffected);
+
+    list<ComputationNodeBasePtr> nodesToValidate;
+    for (auto& node : nodes)
+    {
+        if (affected.find(node) != affected.end())
+            nodesToValidate.push_back(node);
+    }
+    return nodesToValidate;
+}
+
 // validate sub-network needed to evalute a specific output node
 // This calls Validate() on every node in evaluation order (allowing to propagate things forwards through the net).
 // This is called lazily but once only per node until next ClearCache().
 // This also sets up MBLayout links.
+// If the network was validated before, only the nodes affected by changes since are validated (see DetermineNodesToValidate()).
+// The others keep their dimensions and serve as validated inputs.
 void ComputationNetwork::ValidateNetwork()
 {
     // reset to a well-defined MBLayout (any meaningful layout should do here)
@@ -514,12 +1027,18 @@ void ComputationNetwork::ValidateNetwork()
     // A problem is that recurrent loops may require partial validation.
     // Nodes validated on partial input (i.e. some children not yet validated) will be revisited.
     const auto& nodes = GetEvalOrder(nullptr);
+    auto nodesToValidate = DetermineNodesToValidate(nodes);
+    m_validatedNodeStates.clear();
 
     for (auto& node : nodes)
+        node->m_visited = true;
+    for (auto& node : nodesToValidate)
     {
         node->m_visited = false;
         node->m_needsGradient = node->IsParameterUpdateRequired(); // these get propagated upwards in the following
     }
+    if (nodesToValidate.size() < nodes.size())
+        fprintf(stderr, "\nValidating network incrementally: %d out of %d nodes were changed or depend on a change.\n", (int) nodesToValidate.size(), (int) nodes.size());
 
     // loop and validate until we are done
     // steps:
@@ -527,16 +1046,59 @@ void ComputationNetwork::ValidateNetwork()
     //    Keep going through the list until all nodes have been validated and all inputs have been validated as well.
     //  - validate (final)              // final means consistency checks
     //    Fail if any change during this stage.
-    size_t pass = 0;
-    size_t toValidate = nodes.size();
-    while (toValidate > 0)
+    // With the dimensions from the compiled plan of the model (see ReadCompiledPlan()), all nodes count as visited, and
+    // the final pass only verifies them. If that fails, e.g. the network was modified after loading, we validate from scratch.
+    size_t toValidate = nodesToValidate.size();
+    if (m_hasDimsFromCompiledPlan)
+    {
+        m_hasDimsFromCompiledPlan = false;
+        // the final pass also verifies m_needsGradient, so it must have been propagated already (repeated for the delay nodes in loops)
+        for (auto& node : nodesToValidate)
+            node->m_visited = true;
+        bool changed;
+        do
+        {
+            changed = false;
+            for (auto& node : nodesToValidate)
+            {
+                for (auto& input : node->GetInputs())
+                {
+                    if (input->m_needsGradient && !node->m_needsGradient)
+                    {
+                        node->m_needsGradient = true;
+                        changed = true;
+                    }
+                }
+            }
+        } while (changed);
+        try
+        {
+            fprintf(stderr, "\n\nValidating network, final pass only, with the dimensions from the compiled plan of the model.\n");
+            ValidateNodes(nodesToValidate, true /*isFinalValidationPass*/, toValidate);
+        }
+        catch (const exception& e)
+        {
+            fprintf(stderr, "\n\nValidating network: The compiled plan of the model does not apply (%s), validating from scratch.\n", e.what());
+            for (auto& node : nodesToValidate)
+            {
+                node->m_visited = false;
+                node->m_needsGradient = node->IsParameterUpdateRequired();
+            }
+            toValidate = nodesToValidate.size();
+        }
+    }
+    if (toValidate > 0)
     {
-        pass++;
-        fprintf(stderr, "\n\nValidating network. %d nodes to process in pass %d.\n", (int) toValidate, (int) pass);
-        ValidateNodes(nodes, false /*isFinalValidationPass*/, toValidate);
+        size_t pass = 0;
+        while (toValidate > 0)
+        {
+            pass++;
+            fprintf(stderr, "\n\nValidating network. %d nodes to process in pass %d.\n", (int) toValidate, (int) pass);
+            ValidateNodes(nodesToValidate, false /*isFinalValidationPass*/, toValidate);
+        }
+        fprintf(stderr, "\n\nValidating network, final pass.\n");
+        ValidateNodes(nodesToValidate, true /*isFinalValidationPass*/, toValidate);
     }
-    fprintf(stderr, "\n\nValidating network, final pass.\n");
-    ValidateNodes(nodes, true /*isFinalValidationPass*/, toValidate);
     if (toValidate != 0)
         LogicError("ValidateSubNetwork: ValidateNodes(true) unexpectedly returned with work left to do.");
 
@@ -571,12 +1133,10 @@ void ComputationNetwork::ValidateNetwork()
         //    fprintf(stderr, "    %ls\n", node->NodeName().c_str());
         // fprintf(stderr, "\n\n");
     }
-}
 
-// helper to discover dimension changes
-static pair<TensorShape, bool> GetDims(const ComputationNodeBasePtr& node)
-{
-    return make_pair(node->GetSampleLayout(), node->HasMBLayout());
+    // remember the validated state, for the next validation after an edit
+    for (auto& node : nodes)
+        m_validatedNodeStates[node] = ValidatedNodeState{node->GetInputs(), node->GetSampleLayout(), node->HasMBLayout(), node->IsParameterUpdateRequired()};
 }
 
 void ComputationNetwork::ValidateNodes(list<ComputationNodeBasePtr> nodes, bool isFinalValidationPass, size_t& todo)
@@ -642,55 +1202,49 @@ void ComputationNetwork::ValidateNodes(list<ComputationNodeBasePtr> nodes, bool
 // memory allocation
 // -----------------------------------------------------------------------
 // mark nodes that are purely induced by parameters as non-sharable and create space for value if null
+// Such nodes are constant: their inputs are parameters, precomputed values (e.g. mean and inverse standard deviation), or
+// other constant nodes. ForwardProp() skips nodes whose inputs did not change (see IsOutOfDateWrtInputs()), so a constant
+// node is computed once, and again only after a parameter it depends on was updated (SGD bumps its time stamp). For that,
+// its value must survive from one minibatch to the next, i.e. not be shared.
 void ComputationNetwork::MarkValueNonSharableNodes()
 {
     const auto& nodes = GetEvalOrder(nullptr);
-    std::map<wstring, bool> allLeafDescendentsAreParameters;
-    std::list<ComputationNodeBasePtr> allLearnableParameters = GetNodesWithType(OperationNameOf(LearnableParameter));
+    std::unordered_set<ComputationNodeBasePtr> constantNodes;
     // note that: we cannot use m_learnableParameters because we need all parameters node, regardless whether it requires update or not
+    for (const auto& node : GetNodesWithType(OperationNameOf(LearnableParameter)))
+        constantNodes.insert(node);
 
+    size_t numConstantNodes = 0;
     for (auto& node : nodes)
     {
+        if (node->RequiresPreCompute()) // (already non-sharable)
+        {
+            constantNodes.insert(node);
+            continue;
+        }
+        // we don't do the check for leaf node, cause all the possible leaf nodes (input/parameters/precompute node) are marked as non-sharable already
+        // Loops are stepped on every call, so they are never constant.
         auto children = node->GetInputs();
-        wstring myname = node->NodeName();
-        bool allParameters = true;
-
-        if (children.size()) // we don't do the check for leaf node, cause all the possible leaf nodes (input/parameters/precompute node) are marked as non-sharable already
+        if (children.empty() || node->IsPartOfLoop())
+            continue;
+        bool allConstant = true;
+        for (const auto& child : children)
         {
-            for (auto child : children)
-            {
-                wstring ChildName = child->NodeName();
-                if (allLeafDescendentsAreParameters.find(ChildName) == allLeafDescendentsAreParameters.end())
-                {
-                    // not found, means it is a leaf node (we are at eval order )
-                    assert(child->IsLeaf() || child->IsPartOfLoop());
-                    if (std::find(allLearnableParameters.begin(), allLearnableParameters.end(), child) != allLearnableParameters.end())
-                    {
-                        allLeafDescendentsAreParameters[ChildName] = true;
-                    }
-                    else
-                    {
-                        allParameters = false;
-                        allLeafDescendentsAreParameters[ChildName] = false;
-                        break;
-                    }
-                }
-                else
-                {
-                    if (allLeafDescendentsAreParameters[ChildName] == false)
-                    {
-                        allParameters = false;
-                        break;
-                    }
-                }
-            }
-            allLeafDescendentsAreParameters[myname] = allParameters;
-            if (allParameters)
+            if (constantNodes.find(child) == constantNodes.end())
             {
-                node->MarkValueNonSharable();
+                allConstant = false;
+                break;
             }
         }
+        if (allConstant)
+        {
+            constantNodes.insert(node);
+            node->MarkValueNonSharable();
+            numConstantNodes++;
+        }
     }
+    if (numConstantNodes > 0)
+        fprintf(stderr, "MarkValueNonSharableNodes: %d nodes only depend on parameters and precomputed values, they are only recomputed when those change.\n", (int) numConstantNodes);
 }
 
 // this function will need to be called before actual validation and execution to
@@ -718,6 +1272,14 @@ void ComputationNetwork::AllocateAllMatrices(const std::vector<ComputationNodeBa
     if (trainRootNode != nullptr)
         forwardPropRoots.push_back(trainRootNode);
 
+    // collapse chains of elementwise nodes into single tensor ops; this must precede the simulation below,
+    // since the values of absorbed nodes are not materialized and therefore must not be shared before the chain end has run
+    FuseActivations(forwardPropRoots);
+    FuseElementWiseNodes(forwardPropRoots, performingBackPropagation);
+
+    // the memory sharing below depends on which nodes run on which streams
+    AssignComputeStreams();
+
     // For each node determine parents and whether the output of the
     // node is needed during back propagation
     std::unordered_map<ComputationNodeBasePtr, bool> outputValueNeededDuringBackProp;
@@ -747,6 +1309,28 @@ void ComputationNetwork::AllocateAllMatrices(const std::vector<ComputationNodeBa
         }
     }
 
+    // values that are freed after forward prop and recomputed in backprop instead, and where
+    std::map<ComputationNodeBasePtr, std::vector<ComputationNodeBasePtr>> recomputedBefore;
+    if (performingBackPropagation)
+        PlanRecomputation(trainRootNode, parentsMap, outputValueNeededDuringBackProp, recomputedBefore);
+
+    // values that are copied to host memory after forward prop and back in backprop, and where they are needed again
+    std::map<ComputationNodeBasePtr, std::vector<ComputationNodeBasePtr>> prefetchedBefore;
+    if (performingBackPropagation)
+        PlanValueOffload(trainRootNode, parentsMap, outputValueNeededDuringBackProp, prefetchedBefore);
+    auto requestMatricesBeforeBackprop = [&](const ComputationNodeBasePtr& n)
+    {
+        for (const auto* reacquiredBefore : { &recomputedBefore, &prefetchedBefore })
+        {
+            auto reacquired = reacquiredBefore->find(n);
+            if (reacquired != reacquiredBefore->end())
+            {
+                for (auto& reacquiredNode : reacquired->second)
+                    reacquiredNode->RequestMatricesBeforeRecompute(m_matrixPool);
+            }
+        }
+    };
+
     std::unordered_map<ComputationNodeBasePtr, int> parentCount;
     for (auto& keyValue : parentsMap)
     {
@@ -783,16 +1367,23 @@ void ComputationNetwork::AllocateAllMatrices(const std::vector<ComputationNodeBa
 
                 for (auto& nodeLoopIter : recInfo->m_nestedNodes)
                 {
-                    ReleaseMatricesAfterEvalForChildren(nodeLoopIter, parentCount);
+                    if (!nodeLoopIter->IsFusedIntoConsumer())
+                        ReleaseMatricesAfterEvalForChildren(nodeLoopIter, parentCount);
                 }
             }
         }
         else
         {
-            nodeIter->RequestMatricesBeforeForwardProp(m_matrixPool);
+            // an elementwise node whose input dies with it overwrites the input value instead of taking a matrix of its own
+            if (IsValueComputedInPlace(nodeIter, forwardPropRoots, parentCount, outputValueNeededDuringBackProp))
+                nodeIter->RequestMatricesBeforeForwardPropInPlace(m_matrixPool);
+            else
+                nodeIter->RequestMatricesBeforeForwardProp(m_matrixPool);
             // we only release matrices for the children since the root node's informatioin will be used and should not be shared
             // with others
-            ReleaseMatricesAfterEvalForChildren(nodeIter, parentCount);
+            // Nodes absorbed into a fused chain release their inputs together with the chain end.
+            if (!nodeIter->IsFusedIntoConsumer())
+                ReleaseMatricesAfterEvalForChildren(nodeIter, parentCount);
         }
     }
 
@@ -815,6 +1406,8 @@ void ComputationNetwork::AllocateAllMatrices(const std::vector<ComputationNodeBa
                 shared_ptr<SEQTraversalFlowControlNode> recInfo = FindInRecurrentLoops(m_allSEQNodes, n);
                 if (completedGradient.insert(recInfo).second)
                 {
+                    requestMatricesBeforeBackprop(recInfo);
+
                     // SEQ mode: allocate all in loop first, then deallocate again
                     // TODO: next step: use PARTraversalFlowControlNode::AllocateGradientMatricesForInputs() and ReleaseMatricesAfterBackprop()...
                     // BUGBUG: naw, ^^ would not work! Wrong order! Need to rethink this. Need to make AllocateEvalMatrices() and AllocateGradientMatrices() the virtual functions.
@@ -826,6 +1419,7 @@ void ComputationNetwork::AllocateAllMatrices(const std::vector<ComputationNodeBa
             else
             {
                 // PAR mode: we can allocate and immediately deallocate one by one
+                requestMatricesBeforeBackprop(n);
                 n->AllocateGradientMatricesForInputs(m_matrixPool);
                 // Root node's information will be used and should not be shared with others, also it's small (1x1)
                 if ((n != trainRootNode) && n->NeedsGradient())
@@ -833,6 +1427,689 @@ void ComputationNetwork::AllocateAllMatrices(const std::vector<ComputationNodeBa
             }
         }
     }
+
+    // now that all live intervals are known, assign the requests to shared matrices
+    m_matrixPool.OptimizedMemoryAllocation();
+    m_matrixPool.PrintPlannedMemory();
+}
+
+// -----------------------------------------------------------------------
+// gradient checkpointing
+// -----------------------------------------------------------------------
+
+// PlanRecomputation() -- choose the values that are freed after forward prop and recomputed in backprop
+// Forward prop keeps every value that backprop reads until then, which makes up most of the memory of deep networks and
+// long sequences. Instead, the PAR nodes of the training criterion are split into segments. The recomputed nodes of a segment
+// release their values after forward prop like values that backprop does not read, and are computed again right before the
+// backprop of the last node that reads one of them. Only the other values, among them the checkpoints that the recomputed nodes
+// read, are kept. This costs one more forward pass of the recomputed nodes.
+//  - m_recomputedNodeNames = {L"auto"}: about sqrt(N) segments of equal length, all eligible nodes are recomputed
+//  - otherwise the named nodes (wildcards allowed) are recomputed, each run of consecutive ones in eval order is a segment
+// Eligible are non-loop nodes with a gradient and a shared value that backprop reads, and that can be recomputed
+// (IsValueRecomputable()), but not ends of fused chains. A node is kept if a recomputed node of another segment reads it,
+// since segments are recomputed in reverse order.
+void ComputationNetwork::PlanRecomputation(const ComputationNodeBasePtr& trainRootNode,
+                                           const std::unordered_map<ComputationNodeBasePtr, std::unordered_set<ComputationNodeBasePtr>>& parentsMap,
+                                           std::unordered_map<ComputationNodeBasePtr, bool>& outputValueNeededDuringBackProp,
+                                           std::map<ComputationNodeBasePtr, std::vector<ComputationNodeBasePtr>>& recomputedBefore)
+{
+    for (auto& iter : m_nameToNodeMap)
+        iter.second->m_isValueRecomputedForBackprop = false;
+    auto network = dynamic_pointer_cast<PARTraversalFlowControlNode>(GetNestedNetwork(trainRootNode));
+    network->SetRecomputation(recomputedBefore);
+
+    if (m_recomputedNodeNames.empty())
+        return;
+    if (!g_shareNodeValueMatrices)
+    {
+        fprintf(stderr, "\nPlanRecomputation: values are only recomputed with shareNodeValueMatrices=true.\n");
+        return;
+    }
+    if (m_computeStreamPool)
+    {
+        fprintf(stderr, "\nPlanRecomputation: values are not recomputed when the network runs on several compute streams.\n");
+        return;
+    }
+
+    bool isAutomatic = (m_recomputedNodeNames.size() == 1 && EqualCI(m_recomputedNodeNames[0], L"auto"));
+    set<ComputationNodeBasePtr> markedNodes;
+    if (!isAutomatic)
+    {
+        for (const auto& name : m_recomputedNodeNames)
+        {
+            auto nodes = GetNodesFromName(name);
+            if (nodes.empty())
+                InvalidArgument("PlanRecomputation: No node matches '%ls'.", name.c_str());
+            markedNodes.insert(nodes.begin(), nodes.end());
+        }
+    }
+
+    // positions in the PAR traversal, with the members of a loop at the position of the loop
+    const auto& nestedNodes = network->GetNestedNodes();
+    map<ComputationNodeBasePtr, size_t> positions;
+    for (size_t i = 0; i < nestedNodes.size(); i++)
+    {
+        auto seqNode = dynamic_pointer_cast<SEQTraversalFlowControlNode>(nestedNodes[i]);
+        if (seqNode)
+        {
+            for (const auto& node : seqNode->m_nestedNodes)
+                positions[node] = i;
+        }
+        else
+            positions[nestedNodes[i]] = i;
+    }
+
+    auto isEligible = [&](const ComputationNodeBasePtr& node)
+    {
+        return !node->IsPartOfLoop() && !node->IsLeaf() && !node->RequiresPreCompute() && node != trainRootNode &&
+               node->NeedsGradient() && outputValueNeededDuringBackProp[node] && node->IsValueSharable() && !node->IsAccessedFromOtherStreams() &&
+               !node->IsForwardPropFused() && !node->IsFusedIntoConsumer() && !node->HasFusedProducer() && node->IsValueRecomputable() && !dynamic_pointer_cast<IStatefulNode>(node);
+    };
+    size_t numSegments = max((size_t) 1, (size_t) (sqrt((double) nestedNodes.size()) + 0.5));
+    map<ComputationNodeBasePtr, size_t> segments; // [node] segment of each candidate
+    size_t numUnmarkedNodes = 0;
+    for (size_t i = 0; i < nestedNodes.size(); i++)
+    {
+        const auto& node = nestedNodes[i];
+        bool isMarked = isAutomatic || markedNodes.find(node) != markedNodes.end();
+        if (isMarked && isEligible(node))
+            segments[node] = isAutomatic ? i * numSegments / nestedNodes.size() : numUnmarkedNodes;
+        else
+            numUnmarkedNodes++;
+    }
+
+    // keep those that a recomputed node of another segment reads
+    vector<ComputationNodeBasePtr> recomputedNodes;
+    for (const auto& node : nestedNodes)
+    {
+        auto segment = segments.find(node);
+        if (segment == segments.end())
+            continue;
+        bool isReadByOtherSegment = false;
+        auto parents = parentsMap.find(node);
+        if (parents != parentsMap.end())
+        {
+            for (const auto& parent : parents->second)
+            {
+                auto parentSegment = segments.find(parent);
+                if (parentSegment != segments.end() && parentSegment->second != segment->second)
+                    isReadByOtherSegment = true;
+            }
+        }
+        if (!isReadByOtherSegment)
+            recomputedNodes.push_back(node);
+    }
+
+    // the recomputation of a segment precedes the backprop of the last node that reads one of its values in backprop
+    map<size_t, size_t> lastReaders; // [segment] position
+    for (auto iter = recomputedNodes.begin(); iter != recomputedNodes.end();)
+    {
+        const auto& node = *iter;
+        bool isRead = false;
+        size_t lastReader = 0;
+        if (node->OutputUsedInComputingInputNodesGradients())
+        {
+            isRead = true;
+            lastReader = positions[node];
+        }
+        auto parents = parentsMap.find(node);
+        if (parents != parentsMap.end())
+        {
+            for (const auto& parent : parents->second)
+            {
+                auto position = positions.find(parent);
+                if (position == positions.end()) // not part of backprop, e.g. an evaluation node
+                    continue;
+                for (size_t i = 0; i < parent->GetNumInputs(); i++)
+                {
+                    if (parent->GetInputs()[i] == node && parent->InputUsedInComputingInputNodesGradients(i))
+                    {
+                        isRead = true;
+                        lastReader = max(lastReader, position->second);
+                    }
+                }
+            }
+        }
+        if (!isRead) // only read by the backprop of other roots, which does not happen
+        {
+            iter = recomputedNodes.erase(iter);
+            continue;
+        }
+        size_t segment = segments[node];
+        lastReaders[segment] = lastReaders.find(segment) == lastReaders.end() ? lastReader : max(lastReaders[segment], lastReader);
+        iter++;
+    }
+
+    set<ComputationNodeBasePtr> isRecomputed(recomputedNodes.begin(), recomputedNodes.end());
+    for (const auto& node : recomputedNodes)
+    {
+        node->m_isValueRecomputedForBackprop = true;
+        recomputedBefore[nestedNodes[lastReaders[segments[node]]]].push_back(node);
+
+        // the inputs that are not recomputed are checkpoints, which must outlive the recomputation
+        for (const auto& input : node->GetInputs())
+        {
+            if (isRecomputed.find(input) == isRecomputed.end())
+                outputValueNeededDuringBackProp[input] = true;
+        }
+    }
+    network->SetRecomputation(recomputedBefore);
+
+    fprintf(stderr, "\nPlanRecomputation: %d values in %d segments are recomputed in backprop instead of being kept from forward prop.\n",
+            (int) recomputedNodes.size(), (int) lastReaders.size());
+}
+
+// -----------------------------------------------------------------------
+// host offload
+// -----------------------------------------------------------------------
+
+// PlanValueOffload() -- choose the values that are kept in host memory between forward prop and backprop
+// Like recomputation (see PlanRecomputation()), this frees the matrices of values that backprop reads for the time in between,
+// but at the cost of PCIe bandwidth instead of computation: the named nodes (wildcards allowed) copy their values to the host on
+// a side stream after their forward prop, which overlaps with the forward prop of their readers. The matrix is released after the
+// last reader, and requested again one node ahead of the first backprop that reads it, which the copy back overlaps with.
+// Eligible are non-loop nodes with a dense value on the GPU that backprop reads, that is shared and not recomputed, whose readers
+// are non-loop nodes of the training criterion that are neither recomputed nor fused.
+void ComputationNetwork::PlanValueOffload(const ComputationNodeBasePtr& trainRootNode,
+                                          const std::unordered_map<ComputationNodeBasePtr, std::unordered_set<ComputationNodeBasePtr>>& parentsMap,
+                                          const std::unordered_map<ComputationNodeBasePtr, bool>& outputValueNeededDuringBackProp,
+                                          std::map<ComputationNodeBasePtr, std::vector<ComputationNodeBasePtr>>& prefetchedBefore)
+{
+    for (auto& iter : m_nameToNodeMap)
+    {
+        iter.second->m_isValueOffloadedForBackprop = false;
+        iter.second->m_numValueOffloadReaders = 0;
+    }
+    auto network = dynamic_pointer_cast<PARTraversalFlowControlNode>(GetNestedNetwork(trainRootNode));
+    network->SetValuePrefetch(prefetchedBefore, prefetchedBefore);
+
+    if (m_offloadedNodeNames.empty())
+        return;
+    if (!g_shareNodeValueMatrices)
+    {
+        fprintf(stderr, "\nPlanValueOffload: values are only offloaded with shareNodeValueMatrices=true.\n");
+        return;
+    }
+    if (m_computeStreamPool || m_computeGraphs)
+    {
+        fprintf(stderr, "\nPlanValueOffload: values are not offloaded when the network runs on several compute streams or as CUDA graphs.\n");
+        return;
+    }
+
+    set<ComputationNodeBasePtr> markedNodes;
+    for (const auto& name : m_offloadedNodeNames)
+    {
+        auto nodes = GetNodesFromName(name);
+        if (nodes.empty())
+            InvalidArgument("PlanValueOffload: No node matches '%ls'.", name.c_str());
+        markedNodes.insert(nodes.begin(), nodes.end());
+    }
+
+    const auto& nestedNodes = network->GetNestedNodes();
+    map<ComputationNodeBasePtr, size_t> positions; // of the non-loop nodes in the PAR traversal
+    for (size_t i = 0; i < nestedNodes.size(); i++)
+    {
+        if (!dynamic_pointer_cast<SEQTraversalFlowControlNode>(nestedNodes[i]))
+            positions[nestedNodes[i]] = i;
+    }
+
+    auto isEligible = [&](const ComputationNodeBasePtr& node)
+    {
+        auto needed = outputValueNeededDuringBackProp.find(node);
+        if (node->IsPartOfLoop() || node->IsLeaf() || node->RequiresPreCompute() || node == trainRootNode ||
+            needed == outputValueNeededDuringBackProp.end() || !needed->second || !node->IsValueSharable() || node->IsAccessedFromOtherStreams() ||
+            node->IsForwardPropFused() || node->IsFusedIntoConsumer() || node->HasFusedProducer() || node->IsValueRecomputedForBackprop() ||
+            !node->IsValueOffloadable() || positions.find(node) == positions.end())
+            return false;
+        auto parents = parentsMap.find(node);
+        if (parents == parentsMap.end())
+            return false;
+        for (const auto& parent : parents->second)
+        {
+            if (positions.find(parent) == positions.end() || parent->IsForwardPropFused() || parent->IsFusedIntoConsumer() ||
+                parent->GetFusedProducer() == node || parent->IsValueRecomputedForBackprop())
+                return false;
+        }
+        return true;
+    };
+
+    std::map<ComputationNodeBasePtr, std::vector<ComputationNodeBasePtr>> prefetchAwaitedBefore;
+    size_t numOffloaded = 0;
+    for (const auto& node : markedNodes)
+    {
+        if (!isEligible(node))
+        {
+            fprintf(stderr, "PlanValueOffload: the value of %ls %ls operation cannot be offloaded.\n", node->NodeName().c_str(), node->OperationName().c_str());
+            continue;
+        }
+
+        // the last position whose backprop reads the value, which is the first in backprop
+        const auto& parents = parentsMap.find(node)->second;
+        bool isRead = node->OutputUsedInComputingInputNodesGradients();
+        size_t lastReader = positions[node];
+        for (const auto& parent : parents)
+        {
+            for (size_t i = 0; i < parent->GetNumInputs(); i++)
+            {
+                if (parent->GetInputs()[i] == node && parent->InputUsedInComputingInputNodesGradients(i))
+                {
+                    isRead = true;
+                    lastReader = max(lastReader, positions[parent]);
+                }
+            }
+        }
+        if (!isRead)
+            continue;
+
+        node->m_isValueOffloadedForBackprop = true;
+        node->m_numValueOffloadReaders = parents.size();
+        prefetchedBefore[nestedNodes[min(lastReader + 1, nestedNodes.size() - 1)]].push_back(node);
+        prefetchAwaitedBefore[nestedNodes[lastReader]].push_back(node);
+        numOffloaded++;
+    }
+    network->SetValuePrefetch(prefetchedBefore, prefetchAwaitedBefore);
+
+    fprintf(stderr, "\nPlanValueOffload: %d values are kept in host memory between forward prop and backprop.\n", (int) numOffloaded);
+}
+
+// -----------------------------------------------------------------------
+// concurrent execution on several streams
+// -----------------------------------------------------------------------
+
+// AssignComputeStreams() -- distribute the nodes over m_numComputeStreams CUDA streams
+// Independent branches of the network, such as the towers of a DSSM or the two directions of a BLSTM, then run concurrently,
+// which keeps the GPU busy for networks of many small kernels. The PAR traversal orders the streams by events (see
+// PARTraversalFlowControlNode::ForwardProp()).
+// Nodes are assigned greedily in the global evaluation order: a node continues the stream of one of its inputs if that input
+// was the last node assigned to it, otherwise it starts a chain on the least recently used stream. A loop counts as one node.
+// Leaves (parameters, inputs) take the stream of their first consumer. Values and gradients that are read or written by nodes
+// of another stream are not shared by the MatrixPool.
+// This is done for the whole network, so that it does not change between calls of AllocateAllMatrices() for different roots.
+void ComputationNetwork::AssignComputeStreams()
+{
+    const auto& nodes = GetEvalOrder(nullptr);
+    for (const auto& node : nodes)
+    {
+        node->m_computeStream = 0;
+        node->m_isAccessedFromOtherStreams = false;
+    }
+    for (const auto& recInfo : m_allSEQNodes)
+        recInfo->m_computeStream = 0;
+
+    bool useStreams = (m_numComputeStreams > 1);
+    if (useStreams && m_deviceId < 0)
+    {
+        // CPU kernels are parallelized by themselves, and nodes are not safe to run from several threads
+        fprintf(stderr, "AssignComputeStreams: The network runs on the CPU, using a single stream instead of %d.\n", (int) m_numComputeStreams);
+        useStreams = false;
+    }
+    for (const auto& node : nodes)
+    {
+        if (useStreams && node->GetDeviceId() != m_deviceId)
+        {
+            fprintf(stderr, "AssignComputeStreams: %ls %ls operation is placed on another device, using a single stream instead of %d.\n",
+                    node->NodeName().c_str(), node->OperationName().c_str(), (int) m_numComputeStreams);
+            useStreams = false;
+        }
+    }
+
+    if (!useStreams)
+        m_computeStreamPool.reset();
+    else
+    {
+        // the unit of assignment: a node, or the SEQTraversalFlowControlNode of its loop
+        auto unitOf = [this](const ComputationNodeBasePtr& node) -> ComputationNodeBasePtr
+        {
+            if (!node->IsPartOfLoop())
+                return node;
+            return FindInRecurrentLoops(m_allSEQNodes, node);
+        };
+
+        vector<ComputationNodeBasePtr> lastUnit(m_numComputeStreams); // [stream] unit that was assigned to it last
+        vector<size_t> lastUse(m_numComputeStreams, 0);               // [stream] when that was
+        size_t numAssigned = 0;
+        set<ComputationNodeBasePtr> assignedUnits;
+        for (const auto& node : nodes)
+        {
+            auto unit = unitOf(node);
+            if (node->IsLeaf() || !assignedUnits.insert(unit).second)
+                continue;
+
+            list<ComputationNodeBasePtr> members;
+            auto recInfo = dynamic_pointer_cast<SEQTraversalFlowControlNode>(unit);
+            if (recInfo)
+                members.assign(recInfo->m_nestedNodes.begin(), recInfo->m_nestedNodes.end());
+            else
+                members.push_back(node);
+
+            size_t stream = SIZE_MAX;
+            for (const auto& member : members)
+            {
+                for (const auto& input : member->GetInputs())
+                {
+                    if (stream != SIZE_MAX || input->IsLeaf())
+                        continue;
+                    auto inputUnit = unitOf(input);
+                    if (inputUnit != unit && lastUnit[inputUnit->m_computeStream] == inputUnit)
+                        stream = inputUnit->m_computeStream;
+                }
+            }
+            if (stream == SIZE_MAX)
+                stream = min_element(lastUse.begin(), lastUse.end()) - lastUse.begin();
+
+            unit->m_computeStream = stream;
+            for (const auto& member : members)
+                member->m_computeStream = stream;
+            lastUnit[stream] = unit;
+            lastUse[stream] = ++numAssigned;
+        }
+
+        // consumers of each node; the leaves go with the first one
+        std::unordered_map<ComputationNodeBasePtr, vector<ComputationNodeBasePtr>> consumers;
+        for (const auto& node : nodes)
+        {
+            for (const auto& input : node->GetInputs())
+            {
+                if (input->IsLeaf() && consumers[input].empty())
+                    input->m_computeStream = node->m_computeStream;
+                consumers[input].push_back(node);
+            }
+        }
+
+        // A fused chain reads the inputs of the nodes it absorbed. Which chains are formed depends on the roots of
+        // AllocateAllMatrices(), so the readers down every chain that may be formed count.
+        size_t numAccessedFromOtherStreams = 0;
+        for (const auto& node : nodes)
+        {
+            vector<ComputationNodeBasePtr> readers = consumers[node];
+            for (size_t k = 0; k < readers.size(); k++)
+            {
+                ComputationNodeBasePtr reader = readers[k];
+                if (reader->m_computeStream != node->m_computeStream)
+                {
+                    node->m_isAccessedFromOtherStreams = true;
+                    numAccessedFromOtherStreams++;
+                    break;
+                }
+                ElementWiseOperator op;
+                if (reader->GetElementWiseForwardOp(op) && consumers[reader].size() == 1)
+                    readers.push_back(consumers[reader].front());
+            }
+        }
+
+        if (!m_computeStreamPool || m_computeStreamPool->GetNumStreams() != m_numComputeStreams || m_computeStreamPool->GetDeviceId() != m_deviceId)
+            m_computeStreamPool = make_shared<ComputeStreamPool>(m_deviceId, m_numComputeStreams);
+        fprintf(stderr, "\nAssignComputeStreams: %d nodes on %d streams, %d of them accessed from other streams.\n",
+                (int) nodes.size(), (int) m_numComputeStreams, (int) numAccessedFromOtherStreams);
+    }
+
+    for (const auto& keyValue : m_nestedNetworks)
+    {
+        auto network = dynamic_pointer_cast<PARTraversalFlowControlNode>(keyValue.second);
+        if (network)
+            network->SetComputeStreamPool(m_computeStreamPool);
+    }
+}
+
+// -----------------------------------------------------------------------
+// elementwise fusion
+// -----------------------------------------------------------------------
+
+// FuseActivations() -- let nodes compute the activation that consumes their value in their own kernels
+// An activation node (e.g. RectifiedLinear) whose input implements IActivationFusableNode (e.g. BatchNormalization) for
+// its operation takes over that input's computation: its ForwardProp() has the input write the activated result directly
+// into the activation's value, and its Backprop() has the input propagate the activation's gradient straight to the
+// input's own inputs. The input's value and gradient are never formed, so this is only done where nobody else reads them:
+//  - the input has no other consumer and is not a root,
+//  - neither node is inside a recurrent loop.
+// The input may in turn take over the forward computation of one of its own inputs (GetFusedOperand()), e.g. the bias
+// Plus of a dense layer that of the Times, which is then computed as a GEMM with bias and activation applied to its
+// result. The same conditions apply to that operand, whose value is not formed either (its gradient still is).
+// Like FuseElementWiseNodes(), the first call after CompileNetwork() decides, and later calls may only undo.
+void ComputationNetwork::FuseActivations(const std::vector<ComputationNodeBasePtr>& forwardPropRoots)
+{
+    const auto& nodes = GetEvalOrder(nullptr);
+
+    std::unordered_map<ComputationNodeBasePtr, size_t> numConsumers;
+    for (const auto& node : nodes)
+        for (const auto& input : node->GetInputs())
+            numConsumers[input]++;
+
+    std::unordered_set<ComputationNodeBasePtr> roots(m_allRoots.begin(), m_allRoots.end());
+    roots.insert(forwardPropRoots.begin(), forwardPropRoots.end());
+
+    // can 'input' be computed by 'consumer', without its value being formed?
+    auto canAbsorb = [&](const ComputationNodeBasePtr& consumer, const ComputationNodeBasePtr& input)
+    {
+        return numConsumers[input] == 1 && roots.find(input) == roots.end() &&
+               !consumer->IsPartOfLoop() && !input->IsPartOfLoop() &&
+               consumer->GetMBLayout() == input->GetMBLayout() &&
+               (dynamic_pointer_cast<ComputationNode<float>>(consumer) != nullptr) == (dynamic_pointer_cast<ComputationNode<float>>(input) != nullptr);
+    };
+    auto canFuse = [&](const ComputationNodeBasePtr& activation, const ComputationNodeBasePtr& producer)
+    {
+        ElementWiseOperator op;
+        auto fusable = dynamic_pointer_cast<IActivationFusableNode>(producer);
+        if (!fusable || activation->GetNumInputs() != 1 || !activation->GetElementWiseForwardOp(op) || !fusable->CanFuseActivation(op) || !canAbsorb(activation, producer))
+            return false;
+        auto operand = fusable->GetFusedOperand();
+        return !operand || canAbsorb(producer, operand);
+    };
+
+    if (m_areElementWiseNodesFused)
+    {
+        size_t numUndone = 0;
+        for (const auto& node : nodes)
+        {
+            if (!node->HasFusedProducer() || canFuse(node, node->GetFusedProducer()))
+                continue;
+            auto operand = dynamic_pointer_cast<IActivationFusableNode>(node->GetFusedProducer())->GetFusedOperand();
+            if (operand)
+                operand->ClearElementWiseFusion();
+            node->GetFusedProducer()->ClearElementWiseFusion();
+            node->ClearElementWiseFusion();
+            numUndone++;
+        }
+        if (numUndone > 0)
+            fprintf(stderr, "\nFuseActivations: Undid %d fused activations.\n", (int) numUndone);
+        return;
+    }
+
+    size_t numFused = 0;
+    for (const auto& node : nodes)
+    {
+        if (node->GetNumInputs() != 1)
+            continue;
+        const auto producer = node->GetInputs()[0];
+        if (!canFuse(node, producer))
+            continue;
+        producer->m_fusedIntoNode = node.get();
+        node->m_fusedProducer = producer;
+        numFused++;
+        fprintf(stderr, "\tFused %ls %ls operation into %ls %ls operation.\n", node->NodeName().c_str(), node->OperationName().c_str(),
+                producer->NodeName().c_str(), producer->OperationName().c_str());
+        auto operand = dynamic_pointer_cast<IActivationFusableNode>(producer)->GetFusedOperand();
+        if (operand)
+        {
+            operand->m_fusedIntoNode = node.get();
+            fprintf(stderr, "\tFused %ls %ls operation into %ls %ls operation as well.\n", operand->NodeName().c_str(), operand->OperationName().c_str(),
+                    producer->NodeName().c_str(), producer->OperationName().c_str());
+        }
+    }
+    if (numFused > 0)
+        fprintf(stderr, "\nFuseActivations: Fused %d activations into the nodes that produce their inputs.\n", (int) numFused);
+}
+
+// FuseElementWiseNodes() -- collapse chains of elementwise nodes into a single tensor op
+// A node that implements GetElementWiseForwardOp() is absorbed into its consumer if that consumer is the only
+// one reading its value. The consumer ("chain end") then evaluates the whole tree as one ElementWiseProgram,
+// reading each leaf input once and writing only its own output, while the absorbed nodes' ForwardProp() does nothing.
+// Absorbed values are never materialized, so this is only done where nobody else can observe them:
+//  - not for roots (criteria, outputs, etc.),
+//  - not inside recurrent loops, which are evaluated frame by frame,
+//  - not for nodes that take part in backprop, whose gradients may need the intermediate values.
+// The first call after CompileNetwork() decides the chains. Matrices allocated at that time are not re-planned
+// by later calls, so these may only undo fusions that are invalid for them (e.g. training after a forward-only pass).
+void ComputationNetwork::FuseElementWiseNodes(const std::vector<ComputationNodeBasePtr>& forwardPropRoots, bool performingBackPropagation)
+{
+    const auto& nodes = GetEvalOrder(nullptr);
+
+    // count how many times each node's value is consumed
+    std::unordered_map<ComputationNodeBasePtr, size_t> numConsumers;
+    for (const auto& node : nodes)
+        for (const auto& input : node->GetInputs())
+            numConsumers[input]++;
+
+    std::unordered_set<ComputationNodeBasePtr> roots(m_allRoots.begin(), m_allRoots.end());
+    roots.insert(forwardPropRoots.begin(), forwardPropRoots.end());
+
+    // can this node's forward computation become an instruction of a fused program?
+    auto isFusable = [&](const ComputationNodeBasePtr& node)
+    {
+        ElementWiseOperator op;
+        return node->GetElementWiseForwardOp(op) &&
+               ElementWiseProgram::GetNumArgs(op) == (int) node->GetNumInputs() &&
+               !node->IsPartOfLoop() &&
+               !node->HasFusedProducer() &&
+               !(performingBackPropagation && node->NeedsGradient());
+    };
+    // can 'node' be absorbed into the chain that ends in 'chainEnd'?
+    auto isAbsorbable = [&](const ComputationNodeBasePtr& node, const ComputationNodeBasePtr& chainEnd)
+    {
+        return isFusable(node) &&
+               numConsumers[node] == 1 &&
+               roots.find(node) == roots.end() &&
+               node->GetMBLayout() == chainEnd->GetMBLayout();
+    };
+
+    if (m_areElementWiseNodesFused)
+    {
+        size_t numUndone = 0;
+        for (const auto& node : nodes)
+        {
+            if (!node->IsForwardPropFused())
+                continue;
+            const auto fusion = node->GetElementWiseFusion();
+            bool isValid = isFusable(node);
+            for (const auto& absorbed : fusion->m_nodes)
+                isValid &= isAbsorbable(absorbed, node);
+            if (isValid)
+                continue;
+            node->ClearElementWiseFusion();
+            for (const auto& absorbed : fusion->m_nodes)
+                absorbed->ClearElementWiseFusion();
+            numUndone++;
+        }
+        if (numUndone > 0)
+            fprintf(stderr, "\nFuseElementWiseNodes: Undid %d fused elementwise chains.\n", (int) numUndone);
+        return;
+    }
+    m_areElementWiseNodesFused = true;
+
+    size_t numChains = 0;
+    for (auto iter = nodes.rbegin(); iter != nodes.rend(); iter++) // chain ends come after the nodes they absorb
+    {
+        const auto& chainEnd = *iter;
+        if (chainEnd->IsFusedIntoConsumer() || !isFusable(chainEnd))
+            continue;
+
+        // grow the tree greedily from the chain end, as long as the program stays within its fixed limits
+        std::unordered_set<ComputationNodeBasePtr> tree{ chainEnd };
+        std::vector<ComputationNodeBasePtr> leaves;
+        auto addLeaves = [](std::vector<ComputationNodeBasePtr>& into, const ComputationNodeBasePtr& node)
+        {
+            for (const auto& input : node->GetInputs())
+                if (std::find(into.begin(), into.end(), input) == into.end())
+                    into.push_back(input);
+        };
+        addLeaves(leaves, chainEnd);
+        for (bool grown = true; grown;)
+        {
+            grown = false;
+            for (size_t i = 0; i < leaves.size() && tree.size() < ElementWiseProgram::MaxInstructions; i++)
+            {
+                const auto candidate = leaves[i];
+                if (!isAbsorbable(candidate, chainEnd))
+                    continue;
+                auto newLeaves = leaves;
+                newLeaves.erase(newLeaves.begin() + i);
+                addLeaves(newLeaves, candidate);
+                if (newLeaves.size() > ElementWiseProgram::MaxInputs)
+                    continue;
+                tree.insert(candidate);
+                leaves = move(newLeaves);
+                grown = true;
+                break;
+            }
+        }
+        if (tree.size() < 2)
+            continue;
+
+        // emit the program in evaluation order; leaves occupy the first registers
+        auto fusion = make_shared<ElementWiseFusion>();
+        fusion->m_program.Clear();
+        fusion->m_program.m_numInputs = (int) leaves.size();
+        fusion->m_inputs = leaves;
+        std::function<int(const ComputationNodeBasePtr&)> emit = [&](const ComputationNodeBasePtr& node) -> int
+        {
+            if (tree.find(node) == tree.end())
+                return (int) (std::find(leaves.begin(), leaves.end(), node) - leaves.begin());
+            int args[3];
+            for (size_t i = 0; i < node->GetNumInputs(); i++)
+                args[i] = emit(node->GetInputs()[i]);
+            ElementWiseOperator op;
+            node->GetElementWiseForwardOp(op);
+            if (node != chainEnd)
+                fusion->m_nodes.push_back(node);
+            return fusion->m_program.Append(op, (int) node->GetNumInputs(), args);
+        };
+        emit(chainEnd);
+
+        for (const auto& absorbed : fusion->m_nodes)
+            absorbed->m_fusedIntoNode = chainEnd.get();
+        chainEnd->m_elementWiseFusion = fusion;
+        numChains++;
+
+        fprintf(stderr, "\tFused %d nodes into %ls %ls operation with %d inputs:", (int) tree.size(), chainEnd->NodeName().c_str(), chainEnd->OperationName().c_str(), (int) leaves.size());
+        for (const auto& absorbed : fusion->m_nodes)
+            fprintf(stderr, " %ls", absorbed->NodeName().c_str());
+        fprintf(stderr, "\n");
+    }
+    if (numChains > 0)
+        fprintf(stderr, "\nFuseElementWiseNodes: Fused %d chains of elementwise nodes.\n", (int) numChains);
+}
+
+// IsValueComputedInPlace() -- can the node's value share the matrix of its input's value during the simulation in AllocateAllMatrices()?
+// The node must be able to run in place (CanComputeValueInPlace()), and nothing may read the input value after this node has
+// overwritten it: this node must be the input's last remaining consumer (parentCount), and backprop must not read the input value.
+// Both values must be plain PAR values of the same shape on the same stream that are shared through the pool, and neither may
+// be recomputed in backprop, be part of a fused chain, or be read from the outside as a root.
+bool ComputationNetwork::IsValueComputedInPlace(const ComputationNodeBasePtr& node, const std::vector<ComputationNodeBasePtr>& forwardPropRoots,
+                                                const std::unordered_map<ComputationNodeBasePtr, int>& parentCount,
+                                                const std::unordered_map<ComputationNodeBasePtr, bool>& outputValueNeededDuringBackProp) const
+{
+    if (!g_shareNodeValueMatrices || !node->CanComputeValueInPlace() || node->GetNumInputs() != 1)
+        return false;
+    const ComputationNodeBasePtr& input = node->GetInputs()[0];
+
+    auto count = parentCount.find(input);
+    if (count == parentCount.end() || count->second != 1)
+        return false;
+    auto needed = outputValueNeededDuringBackProp.find(input);
+    if (needed != outputValueNeededDuringBackProp.end() && needed->second)
+        return false;
+    if (std::find(forwardPropRoots.begin(), forwardPropRoots.end(), input) != forwardPropRoots.end())
+        return false;
+
+    for (const auto& n : { node, input })
+    {
+        if (n->IsPartOfLoop() || n->IsLeaf() || n->RequiresPreCompute() ||
+            !n->IsValueSharable() || n->IsAccessedFromOtherStreams() || n->IsValueRecomputedForBackprop() ||
+            n->IsForwardPropFused() || n->IsFusedIntoConsumer() || n->HasFusedProducer())
+            return false;
+    }
+    return node->GetComputeStream() == input->GetComputeStream() &&
+           node->GetSampleLayout() == input->GetSampleLayout() && node->GetMBLayout() == input->GetMBLayout();
 }
 
 void ComputationNetwork::ReleaseMatricesAfterEvalForChildren(ComputationNodeBasePtr n, std::unordered_map<ComputationNodeBasePtr, int>& parentCount)
@@ -840,6 +2117,9 @@ void ComputationNetwork::ReleaseMatricesAfterEvalForChildren(ComputationNodeBase
     for (int i = 0; i < n->GetNumInputs(); i++)
     {
         ComputationNodeBasePtr pNode = n->GetInputs()[i];
+        // the chain end reads the inputs of the nodes absorbed into it, so those stay alive until now
+        if (pNode->IsFusedIntoConsumer())
+            ReleaseMatricesAfterEvalForChildren(pNode, parentCount);
         parentCount[pNode]--;
         if (parentCount[pNode] == 0)
             pNode->ReleaseMatricesAfterForwardProp(m_matrixPool);
@@ -105,6 +105,26 @@ ComputationNetwork::ComputationNetwork(const IConfigRecordPtr configp)
     }
     // TODO: process "outputNodes" etc. arrays
 
+    // model parallelism: e.g. devicePlacement = ("L1.*=0" : "L2.*=1") places the nodes whose names match each pattern (as in MEL) on a device
+    if (config.Find(L"devicePlacement"))
+    {
+        let& placementp = config[L"devicePlacement"];
+        vector<wstring> placements;
+        if (placementp.Is<ScriptableObjects::ConfigArray>())
+            placements = placementp.AsRef<ScriptableObjects::ConfigArray>().AsVector<wstring>([&](const wstring& msg) { placementp.Fail(msg); });
+        else
+            placements.push_back(placementp);
+        for (let& placement : placements)
+        {
+            let pos = placement.find_last_of(L'=');
+            if (pos == wstring::npos || pos + 1 == placement.size())
+                InvalidArgument("ComputationNetwork: devicePlacement entry '%ls' must be of the form 'nodeNamePattern=deviceId'.", placement.c_str());
+            let pattern = placement.substr(0, pos);
+            if (SetNodesDevice(pattern, (DEVICEID_TYPE) stoi(placement.substr(pos + 1))) == 0)
+                InvalidArgument("ComputationNetwork: devicePlacement pattern '%ls' does not match any node.", pattern.c_str());
+        }
+    }
+
     // perform all necessary post-processing
     CompileNetwork();
 #if 1
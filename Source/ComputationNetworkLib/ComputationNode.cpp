@@ -9,6 +9,8 @@
 #include "InputAndParamNodes.h"
 #include "ComputationNetworkBuilder.h" // TODO: We should only pull in NewComputationNodeFromConfig(). Nodes should not know about network at large.
 #include "TensorShape.h"
+#include "GPUDataTransferer.h"
+#include "CUDAPageLockedMemAllocator.h"
 
 #ifndef let
 #define let const auto
@@ -229,6 +231,111 @@ template <class ElemType>
     }
 }
 
+// -----------------------------------------------------------------------
+// host offload of the value (see ComputationNetwork::PlanValueOffload())
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+struct ComputationNode<ElemType>::ValueOffload
+{
+    ValueOffload(DEVICEID_TYPE deviceId)
+        : m_transferer(deviceId, /*useConcurrentStreams=*/true), m_deviceId(deviceId), m_hostBuffer(nullptr), m_capacity(0), m_numElements(0),
+          m_numReadersLeft(0), m_isOffloaded(false), m_isPrefetching(false)
+    {
+    }
+
+    ~ValueOffload()
+    {
+        FreeHostBuffer();
+    }
+
+    void FreeHostBuffer()
+    {
+        if (!m_hostBuffer)
+            return;
+        m_transferer.WaitForCopyGPUToCPUAsync();
+        m_transferer.WaitForCopyCPUToGPUAsync();
+        CUDAPageLockedMemAllocator::Free(m_hostBuffer, m_deviceId);
+        m_hostBuffer = nullptr;
+        m_capacity = 0;
+    }
+
+    GPUDataTransferer<ElemType> m_transferer;
+    DEVICEID_TYPE m_deviceId;
+    ElemType* m_hostBuffer; // page-locked, grows to the value of the largest minibatch
+    size_t m_capacity;
+    size_t m_numElements;    // of the offloaded value
+    size_t m_numReadersLeft; // readers whose forward prop is still to come
+    bool m_isOffloaded;      // the host buffer holds the value of the last forward prop
+    bool m_isPrefetching;    // the copy back is issued, but the compute stream does not wait for it yet
+};
+
+template <class ElemType>
+/*virtual*/ void ComputationNode<ElemType>::BeginValueOffload()
+{
+    if (!m_valueOffload)
+        m_valueOffload = make_shared<ValueOffload>(m_deviceId);
+    auto& offload = *m_valueOffload;
+    if (m_value->GetMatrixType() != DENSE || m_value->GetDeviceId() < 0)
+        LogicError("BeginValueOffload: Only dense values on the GPU can be offloaded, not that of %ls %ls operation.", NodeName().c_str(), OperationName().c_str());
+
+    size_t numElements = m_value->GetNumElements();
+    if (numElements > offload.m_capacity)
+    {
+        offload.FreeHostBuffer();
+        offload.m_hostBuffer = (ElemType*) CUDAPageLockedMemAllocator::Malloc(numElements * sizeof(ElemType), m_deviceId);
+        offload.m_capacity = numElements;
+    }
+    offload.m_numElements = numElements;
+
+    // after the ForwardProp() that was just issued on the compute stream
+    offload.m_transferer.RecordComputeStreamSyncPoint();
+    offload.m_transferer.WaitForSyncPointOnFetchStreamAsync();
+    offload.m_transferer.CopyGPUToCPUAsync(m_value->BufferPointer(), numElements, offload.m_hostBuffer);
+    offload.m_isOffloaded = true;
+
+    offload.m_numReadersLeft = m_numValueOffloadReaders;
+    if (offload.m_numReadersLeft == 0)
+        offload.m_transferer.WaitForCopyGPUToCPUOnComputeStreamAsync();
+}
+
+template <class ElemType>
+/*virtual*/ void ComputationNode<ElemType>::NotifyValueOffloadReaderDone()
+{
+    if (!m_valueOffload || m_valueOffload->m_numReadersLeft == 0)
+        return;
+    // the matrix may be reused from here on
+    if (--m_valueOffload->m_numReadersLeft == 0)
+        m_valueOffload->m_transferer.WaitForCopyGPUToCPUOnComputeStreamAsync();
+}
+
+template <class ElemType>
+/*virtual*/ void ComputationNode<ElemType>::BeginValuePrefetch()
+{
+    if (!m_valueOffload || !m_valueOffload->m_isOffloaded) // no forward prop since the last backprop
+        return;
+    auto& offload = *m_valueOffload;
+    if (m_value->GetNumElements() != offload.m_numElements)
+        LogicError("BeginValuePrefetch: The value of %ls %ls operation has changed its size since it was offloaded.", NodeName().c_str(), OperationName().c_str());
+
+    // the matrix was reacquired here, after its previous user on the compute stream
+    offload.m_transferer.RecordComputeStreamSyncPoint();
+    offload.m_transferer.WaitForSyncPointOnAssignStreamAsync();
+    offload.m_transferer.WaitForCopyGPUToCPUOnAssignStreamAsync();
+    offload.m_transferer.CopyCPUToGPUAsync(offload.m_hostBuffer, offload.m_numElements, m_value->BufferPointer());
+    offload.m_isOffloaded = false;
+    offload.m_isPrefetching = true;
+}
+
+template <class ElemType>
+/*virtual*/ void ComputationNode<ElemType>::EndValuePrefetch()
+{
+    if (!m_valueOffload || !m_valueOffload->m_isPrefetching)
+        return;
+    m_valueOffload->m_transferer.WaitForCopyCPUToGPUOnComputeStreamAsync();
+    m_valueOffload->m_isPrefetching = false;
+}
+
 // -----------------------------------------------------------------------
 // instantiate the core class templates
 // -----------------------------------------------------------------------
@@ -31,7 +31,9 @@
 #define CNTK_MODEL_VERSION_1 1
 #define CNTK_MODEL_VERSION_2 2
 #define CNTK_MODEL_VERSION_3 3
-#define CURRENT_CNTK_MODEL_VERSION CNTK_MODEL_VERSION_3
+#define CNTK_MODEL_VERSION_4 4 // NoiseContrastiveEstimationNode saves numNoiseSamples
+#define CNTK_MODEL_VERSION_5 5 // ConvolutionNode saves groups
+#define CURRENT_CNTK_MODEL_VERSION CNTK_MODEL_VERSION_5
 
 extern bool g_shareNodeValueMatrices;
 
@@ -132,18 +134,40 @@ struct /*interface*/ IStatefulNode
 };
 typedef IStatefulNode::NodeStatePtr NodeStatePtr;
 
+// Interface for stateful nodes that can carry state for many independent streams at once, one per parallel sequence.
+// This is used for streaming evaluation, where each minibatch holds the next chunk of frames of a set of streams.
+struct /*interface*/ IStreamingNode
+{
+    // load the states of the streams in the next minibatch, one per parallel sequence; null for a stream that starts in it
+    virtual void GatherStreamStates(const std::vector<NodeStatePtr>& states, size_t numParallelSequences) = 0;
+    // after ForwardProp(): replace the state of each stream by the one that follows its first numFrames[s] frames in this minibatch
+    // (fewer than the sequence has if its last frames are only the right context of a latency-controlled chunk)
+    virtual void ScatterStreamStates(std::vector<NodeStatePtr>& states, const std::vector<size_t>& numFrames) = 0;
+};
+
 // =======================================================================
 // ComputationNetworkOwnedNodeState -- class to collect ComputationNode members that are really owned by ComputationNetwork
 // These members are only to be set, changed, and read by ComputationNetwork code.
 // =======================================================================
 
 class ComputationNetwork;
+
+// a chain of elementwise nodes that is computed by its last node in a single tensor operation
+// Set up by ComputationNetwork::FuseElementWiseNodes().
+struct ElementWiseFusion
+{
+    ElementWiseProgram m_program;                              // input register i holds the value of m_inputs[i]
+    vector<IComputationNode::ComputationNodeBasePtr> m_inputs; // leaf inputs of the chain
+    vector<IComputationNode::ComputationNodeBasePtr> m_nodes;  // nodes absorbed into the chain end (not including the chain end itself)
+};
+
 struct ComputationNetworkOwnedNodeState
 {
     friend class ComputationNetwork;
 
     ComputationNetworkOwnedNodeState()
-        : m_needsGradient(false), m_valueSharable(true)
+        : m_needsGradient(false), m_valueSharable(true), m_fusedIntoNode(nullptr), m_computeStream(0), m_isAccessedFromOtherStreams(false), m_isValueRecomputedForBackprop(false),
+          m_isValueOffloadedForBackprop(false), m_numValueOffloadReaders(0)
     {
         PurgeStateForFormingRecurrentLoops();
         m_isPartOfLoop = false;
@@ -162,6 +186,31 @@ struct ComputationNetworkOwnedNodeState
     virtual void MarkValueSharable() { m_valueSharable = true; }
     bool IsValueSharable() const { return m_valueSharable; }
 
+    // elementwise fusion (see ComputationNetwork::FuseElementWiseNodes())
+    bool IsForwardPropFused() const { return m_elementWiseFusion != nullptr; } // ForwardProp() computes the entire fused chain
+    bool IsFusedIntoConsumer() const { return m_fusedIntoNode != nullptr; }    // ForwardProp() does nothing; the value is never materialized
+    const shared_ptr<ElementWiseFusion>& GetElementWiseFusion() const { return m_elementWiseFusion; }
+    void ClearElementWiseFusion()
+    {
+        m_elementWiseFusion.reset();
+        m_fusedIntoNode = nullptr;
+        m_fusedProducer.reset();
+    }
+
+    // activation fusion (see ComputationNetwork::FuseActivations())
+    bool HasFusedProducer() const { return m_fusedProducer != nullptr; } // the input computes this node's value and gradient together with its own
+    const IComputationNode::ComputationNodeBasePtr& GetFusedProducer() const { return m_fusedProducer; }
+
+    // concurrent execution (see ComputationNetwork::AssignComputeStreams())
+    size_t GetComputeStream() const { return m_computeStream; }
+    bool IsAccessedFromOtherStreams() const { return m_isAccessedFromOtherStreams; } // value or gradient are not private to the node's stream
+
+    // gradient checkpointing (see ComputationNetwork::PlanRecomputation())
+    bool IsValueRecomputedForBackprop() const { return m_isValueRecomputedForBackprop; } // value is freed after forward prop and recomputed in backprop
+
+    // host offload (see ComputationNetwork::PlanValueOffload())
+    bool IsValueOffloadedForBackprop() const { return m_isValueOffloadedForBackprop; } // value is copied to host memory after forward prop and back before backprop
+
 protected:                // TODO: should be fully encapsulated here
 
     bool m_needsGradient; // true if this node or any children need a gradient to be computed (for own consumption or propagation to somewhere in the child tree)
@@ -169,6 +218,16 @@ protected:                // TODO: should be fully encapsulated here
     bool m_valueSharable; // a flag is needed for memory share.
                           // If it is false (e.g., learnableParameters/InputValue and those nodes are solely induced by learnableParameters),
                           // it will never be released to memory pool
+
+    shared_ptr<ElementWiseFusion> m_elementWiseFusion; // if set, this node is the end of a fused elementwise chain
+    ComputationNetworkOwnedNodeState* m_fusedIntoNode;  // if set, this node's computation is part of that node's fused chain
+    IComputationNode::ComputationNodeBasePtr m_fusedProducer; // if set, this node's input (an IActivationFusableNode) computes this activation
+
+    size_t m_computeStream;            // stream of the PAR traversal that computes this node, 0 unless the network uses several
+    bool m_isAccessedFromOtherStreams; // if true, value and gradient matrices must not be shared with other nodes
+    bool m_isValueRecomputedForBackprop;
+    bool m_isValueOffloadedForBackprop;
+    size_t m_numValueOffloadReaders; // nodes that read the offloaded value in forward prop; its matrix is reused after the last of them
 private:
 
     bool m_isPartOfLoop; // true if this loop is part of a recurrent loop
@@ -572,6 +631,15 @@ public:
 
     DEVICEID_TYPE GetDeviceId() const { return m_deviceId; }
 
+    // place the node on another device, for model parallelism; the matrices that the node already has are moved along
+    // Inputs on other devices are then reached through DeviceTransfer nodes, see ComputationNetwork::InsertDeviceTransferNodes().
+    void MoveToDevice(DEVICEID_TYPE deviceId)
+    {
+        m_deviceId = deviceId;
+        MoveMatricesToDevice(deviceId);
+    }
+    virtual void MoveMatricesToDevice(DEVICEID_TYPE deviceId) = 0;
+
     // helper to access to element(0,0) without having to type-cast
     virtual double Get00Element() const = 0;
     virtual MatrixBasePtr ValuePtr() const = 0; // for use in readers that pass the agnostic object around
@@ -688,6 +756,11 @@ public:
 
     virtual void ZeroGradientsOfInputs() = 0;
 
+    // for a backprop that adds to the gradient of the previous one, see ComputationNetwork::ZeroGradients()
+    bool IsGradientInitialized() const { return m_gradientInitialized; }
+    void KeepGradient() { m_gradientInitialized = true; }
+    void SetGradientInitialized(bool gradientInitialized) { m_gradientInitialized = gradientInitialized; } // (for replaying a CUDA graph of a backprop)
+
     // -----------------------------------------------------------------------
     // memory sharing
     // -----------------------------------------------------------------------
@@ -702,9 +775,72 @@ public:
     // Base-class version makes conservative assumption that it is. Override if not.
     virtual bool InputUsedInComputingInputNodesGradients(size_t /*childIndex*/) const { return true; }
 
+    // Does BackpropTo() write every element of the gradient of the specified input when called for the whole minibatch,
+    // scaling the existing gradient by InputGradientBeta()? If so, the first consumer that propagates into that input
+    // overwrites its gradient (beta = 0) instead of adding to a zeroed matrix, which saves the zeroing. Override if so.
+    virtual bool CanAssignGradientOfInput(size_t /*childIndex*/) const { return false; }
+
     void SetOutputNeededDuringBackprop(bool f) { m_outputNeededDuringBackprop = f; }
     bool IsOutputNeededDuringBackprop() const { return !g_shareNodeValueMatrices || m_outputNeededDuringBackprop; }
 
+    // Can the value be computed a second time within a minibatch, from the same inputs, with the same result?
+    // Not for nodes that draw random numbers or update state in ForwardProp(). Override if so.
+    virtual bool IsValueRecomputable() const { return true; }
+
+    // request the value again before it is recomputed in backprop, or copied back from host memory, after it was released after forward prop
+    virtual void RequestMatricesBeforeRecompute(MatrixPool& matrixPool) = 0;
+
+    // Host offload of the value from forward prop to backprop, through a side stream (see ComputationNetwork::PlanValueOffload()).
+    // The copy to the host starts after ForwardProp(), and the compute stream waits for it after the last reader's ForwardProp(),
+    // before the matrix is reused. The copy back starts one node ahead in backprop, and the compute stream waits for it before the
+    // first reader's backprop.
+    virtual bool IsValueOffloadable() const = 0; // a dense value on the GPU
+    virtual void BeginValueOffload() = 0;
+    virtual void NotifyValueOffloadReaderDone() = 0;
+    virtual void BeginValuePrefetch() = 0;
+    virtual void EndValuePrefetch() = 0;
+
+    // Can ForwardProp() and BackpropTo() run with the value in the same matrix as the value of Input(0)?
+    // Only if each output element depends on the input element at the same position alone, and backprop does not read the input value.
+    // The network decides whether to actually do so (see ComputationNetwork::IsValueComputedInPlace()). Override if so.
+    virtual bool CanComputeValueInPlace() const { return false; }
+
+    // request the value as the matrix of the value of Input(0), in place of RequestMatricesBeforeForwardProp()
+    virtual void RequestMatricesBeforeForwardPropInPlace(MatrixPool& matrixPool) = 0;
+
+    // -----------------------------------------------------------------------
+    // CUDA graphs (see ComputationNetwork::SetUseComputeGraphs())
+    // -----------------------------------------------------------------------
+
+    // Can the GPU work of ForwardProp() and BackpropTo() be captured once and replayed for later minibatches of the same shape?
+    // Not if it depends on host state that changes from minibatch to minibatch, such as random numbers, counters, or the
+    // sequence boundaries. (Work that reads values back to the host fails the capture anyway.) Override if not.
+    virtual bool IsGraphCapturable() const { return IsValueRecomputable(); }
+
+    // append the buffers and dimensions of the value and the gradient, which the captured work is bound to
+    // Returns false if they are not dense matrices on the GPU.
+    virtual bool AppendGraphSignature(std::vector<size_t>& signature) const = 0;
+
+    // -----------------------------------------------------------------------
+    // profiling (see NodeProfiler)
+    // -----------------------------------------------------------------------
+
+    // rough number of floating-point operations of ForwardProp() over the current minibatch
+    // The default is one per output element. Override if a node does more work per element.
+    virtual double EstimateForwardFlops() const { return (double) GetSampleMatrixNumRows() * GetSampleMatrixNumCols(); }
+
+    // bytes currently allocated for the value and the gradient of the node
+    virtual size_t GetAllocatedMatrixBytes() const { return 0; }
+
+    // -----------------------------------------------------------------------
+    // elementwise fusion
+    // -----------------------------------------------------------------------
+
+    // If ForwardProp() computes a single elementwise op over all inputs (padded to a common tensor rank, with
+    // broadcasting), return that op. This allows ComputationNetwork::FuseElementWiseNodes() to fuse chains of such nodes.
+    // Nodes that return true must call ForwardPropFusedElementWise() at the start of ForwardProp().
+    virtual bool GetElementWiseForwardOp(ElementWiseOperator& /*op*/) const { return false; }
+
     // -----------------------------------------------------------------------
     // helpers for network traversal
     // -----------------------------------------------------------------------
@@ -884,7 +1020,7 @@ public:
     // public constructor
     // Note: use the New<> helper function that is declared next, which gives you the convenience of returning a shared_ptr
     ComputationNode(DEVICEID_TYPE deviceId, const wstring& name)
-        : ComputationNodeBase(deviceId, name)
+        : ComputationNodeBase(deviceId, name), m_assignsInputGradient(false)
     {
     }
 
@@ -1101,6 +1237,29 @@ public:
     const Matrix<ElemType>& Gradient() const { return *m_gradient; }
     Matrix<ElemType>&       Gradient()       { return *m_gradient; }
 
+    virtual size_t GetAllocatedMatrixBytes() const override
+    {
+        return (m_value ? m_value->BufferSize() : 0) + (m_gradient ? m_gradient->BufferSize() : 0);
+    }
+
+    virtual bool AppendGraphSignature(std::vector<size_t>& signature) const override
+    {
+        for (const auto& matrix : { m_value, m_gradient })
+        {
+            if (!matrix)
+            {
+                signature.push_back(0);
+                continue;
+            }
+            if (matrix->GetMatrixType() != MatrixType::DENSE || matrix->GetCurrentMatrixLocation() != CurrentDataLocation::GPU)
+                return false;
+            signature.push_back((size_t) matrix->BufferPointer());
+            signature.push_back(matrix->GetNumRows());
+            signature.push_back(matrix->GetNumCols());
+        }
+        return true;
+    }
+
 private:
 
     template<class E>
@@ -1204,9 +1363,44 @@ public:
         return DataTensorFor(Gradient(), rank, fr);
     }
 
+    // elementwise fusion: to be called at the start of ForwardProp() by nodes that implement GetElementWiseForwardOp()
+    // Returns true if the node's ForwardProp() has nothing left to do:
+    //  - at the end of a fused chain, this computes the entire chain in a single tensor op;
+    //  - inside a chain, there is nothing to do since the consumer computes the value on the fly.
+    bool ForwardPropFusedElementWise(const FrameRange& fr)
+    {
+        if (IsFusedIntoConsumer())
+            return true;
+        if (!IsForwardPropFused())
+            return false;
+        const auto& fusion = *GetElementWiseFusion();
+        size_t rank = GetSampleLayout().GetRank();
+        for (const auto& input : fusion.m_inputs)
+            rank = max(rank, input->GetSampleLayout().GetRank());
+        auto result = ValueTensorFor(rank, fr);
+        vector<TensorView<ElemType>> inputs;
+        for (const auto& input : fusion.m_inputs)
+        {
+            auto inputNode = dynamic_pointer_cast<ComputationNode<ElemType>>(input);
+            if (!inputNode)
+                LogicError("ForwardPropFusedElementWise: %ls %ls operation has an input of mismatching element type.", NodeName().c_str(), OperationName().c_str());
+            inputs.push_back(inputNode->ValueTensorFor(rank, fr.AllowBroadcast()));
+        }
+        result.DoElementWiseProgramOf(0, inputs, 1, fusion.m_program);
+        return true;
+    }
+
     // TODO: Are all these meant to read out a scalar? Then rename and verify dimensions.
     virtual double Get00Element() const override final { return Value().Get00Element(); }
 
+    virtual void /*ComputationNodeBase::*/ MoveMatricesToDevice(DEVICEID_TYPE deviceId) override
+    {
+        if (m_value)
+            m_value->TransferToDeviceIfNotThere(deviceId, true);
+        if (m_gradient)
+            m_gradient->TransferToDeviceIfNotThere(deviceId, true);
+    }
+
     // -----------------------------------------------------------------------
     // dimensions and allocation
     // -----------------------------------------------------------------------
@@ -1358,7 +1552,16 @@ public:
 #if DUMPOUTPUT
                 fprintf(stderr, "Backprop%d_%ls\n", i, NodeName().c_str());
 #endif
-                child->LazyZeroGradient(); // set gradient to 0 if this is the first time
+                // The first consumer that writes all of the child's gradient assigns it rather than adding to zeros.
+                // m_gradientInitialized tracks whether the gradient was written in this pass (or is kept from the last one).
+                m_assignsInputGradient = fr.IsAllFrames() && !child->m_gradientInitialized && CanAssignGradientOfInput(i);
+                if (m_assignsInputGradient)
+                {
+                    child->UpdateDataSize(child->Gradient());
+                    child->m_gradientInitialized = true;
+                }
+                else
+                    child->LazyZeroGradient(); // set gradient to 0 if this is the first time
 
                 // If we propagate from a loop to a node that is outside the loop, we are not efficient.
                 // This case is handled by SEQTraversalFlowControlNode::Backprop().
@@ -1371,6 +1574,7 @@ public:
 
                 // fprintf(stderr, "BackpropTo %d %d %ls %ls\n", (int)fr.timeIdxInSeq, (int)i, NodeName().c_str(), OperationName().c_str());
                 BackpropTo(i, fr); // this computes partial wrt to the child and sums the gradient value in the child
+                m_assignsInputGradient = false;
             }
 #ifdef DISPLAY_DEBUG
             else
@@ -1379,6 +1583,12 @@ public:
         }
     }
 
+    // factor of the existing input gradient in BackpropTo(): 0 if this node is the first to write it (see CanAssignGradientOfInput())
+    ElemType InputGradientBeta() const
+    {
+        return m_assignsInputGradient ? (ElemType) 0 : (ElemType) 1;
+    }
+
     // TODO: why of the inputs, and not the node itself?
     void /*ComputationNodeBase::*/ ZeroGradientsOfInputs() override // clears the lazy-init flags (LazyZeroGradient() actually clears the values lazily)
     {
@@ -1408,20 +1618,44 @@ public:
     // request matrices needed to do node function value evaluation
     virtual void RequestMatricesBeforeForwardProp(MatrixPool& matrixPool) override
     {
-        if (IsValueSharable())
+        if (IsValueSharable() && !IsAccessedFromOtherStreams())
         RequestMatrixFromPool(m_value, matrixPool);
         else
             CreateMatrixIfNull(m_value);
     }
 
     // release temp matrices that are only used by forward computation
-    // don't release matrices that need to be used in the gradient computation
+    // don't release matrices that need to be used in the gradient computation, unless they are recomputed for it
     virtual void ReleaseMatricesAfterForwardProp(MatrixPool& matrixPool) override
     {
-        if (!IsOutputNeededDuringBackprop() && (m_value->GetMatrixType() != SPARSE) && IsValueSharable())
+        if ((!IsOutputNeededDuringBackprop() || IsValueRecomputedForBackprop() || IsValueOffloadedForBackprop()) && (m_value->GetMatrixType() != SPARSE) && IsValueSharable())
             ReleaseMatrixToPool(m_value, matrixPool);
     }
 
+    virtual void RequestMatricesBeforeRecompute(MatrixPool& matrixPool) override
+    {
+        if (m_value->GetMatrixType() != SPARSE)
+            matrixPool.Reacquire<ElemType>(m_value);
+    }
+
+    // (the value matrix of a computed node only exists once the pool is planned)
+    virtual bool IsValueOffloadable() const override
+    {
+        return (!m_value || m_value->GetMatrixType() == DENSE) && (m_deviceId >= 0);
+    }
+
+    virtual void BeginValueOffload() override;
+    virtual void NotifyValueOffloadReaderDone() override;
+    virtual void BeginValuePrefetch() override;
+    virtual void EndValuePrefetch() override;
+
+    // the input releases its value to the pool after this node's forward prop, but its matrix lives on as this node's value
+    virtual void RequestMatricesBeforeForwardPropInPlace(MatrixPool& matrixPool) override
+    {
+        if (m_value != nullptr || !matrixPool.RequestInPlace<ElemType>(m_value, Input(0)->m_value))
+            RequestMatricesBeforeForwardProp(matrixPool);
+    }
+
     virtual void AllocateGradientMatricesForInputs(MatrixPool& matrixPool) override
     {
         for (int i = 0; i < m_inputs.size(); i++)
@@ -1434,7 +1668,11 @@ public:
     // request matrices that are needed for gradient computation
     virtual void RequestMatricesBeforeBackprop(MatrixPool& matrixPool) override
     {
-        RequestMatrixFromPool(m_gradient, matrixPool);
+        // the pool only shares matrices among the nodes of one stream, where the order of their use is known
+        if (IsAccessedFromOtherStreams())
+            CreateMatrixIfNull(m_gradient);
+        else
+            RequestMatrixFromPool(m_gradient, matrixPool);
     }
 
     // release gradient and temp matrices that no longer needed after all the children's gradients are computed.
@@ -1478,7 +1716,8 @@ protected:
     {
         if (matrixPtr == nullptr)
         {
-            matrixPtr = matrixPool.Request<ElemType>(m_deviceId);
+            // size hint for the memory planner; node-internal temporaries are assumed to have the node's dimensions
+            matrixPool.Request<ElemType>(matrixPtr, m_deviceId, GetSampleMatrixNumRows(), HasMBLayout() ? 0 : 1, GetComputeStream());
         }
     }
 
@@ -1605,6 +1844,10 @@ public:
 protected:
 
     shared_ptr<Matrix<ElemType>> m_value, m_gradient;
+    bool m_assignsInputGradient; // set during BackpropTo() if the input gradient is to be overwritten (see InputGradientBeta())
+
+    struct ValueOffload; // host copy of the value, if offloaded (see BeginValueOffload())
+    shared_ptr<ValueOffload> m_valueOffload;
 
     static std::map<size_t, std::map<size_t, Matrix<ElemType>*>> s_constOnes;
 };
@@ -1679,6 +1922,7 @@ public:
     virtual void CopyTo(ComputationNodeBasePtr node, const std::wstring& newName, const CopyNodeFlags flags) const override { NOT_IMPLEMENTED; }
     virtual ComputationNodeBasePtr Duplicate(const std::wstring& newName, const CopyNodeFlags flags) override { NOT_IMPLEMENTED; }
     virtual double Get00Element() const override { NOT_IMPLEMENTED; }
+    virtual void MoveMatricesToDevice(DEVICEID_TYPE) override { NOT_IMPLEMENTED; }
     virtual MatrixBasePtr ValuePtr() const override { NOT_IMPLEMENTED; }
     virtual void UpdateFunctionMBSize() override { NOT_IMPLEMENTED; }
     virtual void AttachInputs(const std::vector<ComputationNodeBasePtr>& inputs) override { NOT_IMPLEMENTED; }
@@ -1691,12 +1935,36 @@ public:
     virtual void InvalidateMissingValueColumns(const Microsoft::MSR::CNTK::FrameRange&) override { NOT_IMPLEMENTED; }
     virtual void InvalidateMissingGradientColumns(const Microsoft::MSR::CNTK::FrameRange&) override { NOT_IMPLEMENTED; }
     virtual void NotifyFunctionValuesMBSizeModified(void) override { NOT_IMPLEMENTED; }
+    virtual void RequestMatricesBeforeRecompute(MatrixPool&) override { NOT_IMPLEMENTED; }
+    virtual bool IsValueOffloadable() const override { return false; }
+    virtual void BeginValueOffload() override { NOT_IMPLEMENTED; }
+    virtual void NotifyValueOffloadReaderDone() override { NOT_IMPLEMENTED; }
+    virtual void BeginValuePrefetch() override { NOT_IMPLEMENTED; }
+    virtual void EndValuePrefetch() override { NOT_IMPLEMENTED; }
+    virtual void RequestMatricesBeforeForwardPropInPlace(MatrixPool&) override { NOT_IMPLEMENTED; }
+    virtual bool AppendGraphSignature(std::vector<size_t>&) const override { NOT_IMPLEMENTED; }
     virtual std::wstring ToString(void) const override { NOT_IMPLEMENTED; }
     // these are meant to be called during computation, so provide dummy implementations
     virtual bool RequiresPreCompute() const override { return false; } // return true if the node's value should be computed before the normal training. e.g., mean and invStd of input features.
     virtual void PrintSelfBeforeValidation() const override { }
     virtual void DumpNodeInfo(const bool /*printValues*/, const bool /*printMetadata*/, File& fstream) const override {}
 
+    // profiled as a whole
+    virtual double EstimateForwardFlops() const override
+    {
+        double flops = 0;
+        for (auto& node : m_nestedNodes)
+            flops += node->EstimateForwardFlops();
+        return flops;
+    }
+    virtual size_t GetAllocatedMatrixBytes() const override
+    {
+        size_t bytes = 0;
+        for (auto& node : m_nestedNodes)
+            bytes += node->GetAllocatedMatrixBytes();
+        return bytes;
+    }
+
 protected: public:                                     // needed in ComputationNetwork::FindInRecurrentLoops(), which really should be part of SEQTraversalFlowControlNode
     std::vector<ComputationNodeBasePtr> m_nestedNodes; // nodes tucked away in this node, in evaluation order
 };
@@ -1740,6 +2008,89 @@ public:
 
 struct IRecurrentNode { virtual int GetRecurrenceSteppingDirection() const = 0; };
 
+// =======================================================================
+// IInt8QuantizableNode -- interface implemented by ComputationNodes whose
+// weights can be replaced by an int8 copy for inference on the CPU
+// =======================================================================
+
+struct IInt8QuantizableNode
+{
+    // Switches the node to int8 weights. Returns the weight input that is no longer read, or nullptr
+    // if the node cannot be quantized in its current configuration.
+    virtual ComputationNodeBasePtr QuantizeWeightsToInt8() = 0;
+
+protected:
+    // The int8 products only pay off for dense input on the CPU; nodes with other input (e.g. sparse features) keep their float weights.
+    // An input whose value is not allocated yet is computed by another node, i.e. dense.
+    template <class ElemType>
+    static bool IsDenseCPUInput(const shared_ptr<ComputationNode<ElemType>>& input)
+    {
+        auto value = dynamic_pointer_cast<Matrix<ElemType>>(input->ValuePtr());
+        if (!value)
+            return input->GetDeviceId() == CPUDEVICE;
+        return value->GetDeviceId() == CPUDEVICE && value->GetMatrixType() == MatrixType::DENSE;
+    }
+};
+
+// =======================================================================
+// IBlockSparseWeightsNode -- interface implemented by ComputationNodes whose
+// pruned weights can be replaced by a block-sparse copy for inference on the CPU
+// =======================================================================
+
+struct IBlockSparseWeightsNode
+{
+    // Switches the node to block-sparse weights if at least 'minSparsity' of their blocks are zero. Returns the weight
+    // input that is no longer read, or nullptr if the node is not switched.
+    virtual ComputationNodeBasePtr UseBlockSparseWeights(size_t blockRows, size_t blockCols, double minSparsity) = 0;
+};
+
+// =======================================================================
+// IPackedWeightsNode -- interface implemented by ComputationNodes whose
+// constant weights can be replaced by a copy packed for GEMM, for inference on the CPU
+// =======================================================================
+
+struct IPackedWeightsNode
+{
+    // Switches the node to packed weights. Returns the weight input that is no longer read, or nullptr
+    // if the node is not switched (e.g. because it already uses other weight copies).
+    virtual ComputationNodeBasePtr PackWeights() = 0;
+};
+
+// =======================================================================
+// IActivationFusableNode -- interface implemented by ComputationNodes that can
+// apply the elementwise activation that consumes their value in their own kernels
+// =======================================================================
+
+struct IActivationFusableNode
+{
+    virtual bool CanFuseActivation(ElementWiseOperator op) const = 0;
+    // an input whose forward computation this node takes over as well while fused (e.g. the product of a dense layer's bias Plus), or nullptr
+    virtual ComputationNodeBasePtr GetFusedOperand() const { return nullptr; }
+};
+
+template <class ElemType>
+struct IFusedActivationProducer : public IActivationFusableNode
+{
+    // computes the activation of this node's value into the consumer's value 'output'
+    virtual void ForwardPropWithActivation(const FrameRange& fr, ElementWiseOperator activation, Matrix<ElemType>& output) = 0;
+    // back-propagates the consumer's gradient through the activation and this node into this node's inputs
+    virtual void BackpropToWithActivation(const FrameRange& fr, ElementWiseOperator activation, const Matrix<ElemType>& outputGradient, const Matrix<ElemType>& output) = 0;
+};
+
+// =======================================================================
+// IFusedMatrixProduct -- interface implemented by ComputationNodes whose matrix
+// product can be computed together with the bias and activation applied to it
+// =======================================================================
+
+template <class ElemType>
+struct IFusedMatrixProduct
+{
+    // is the value a single GEMM [M x K] * [K x N] whose M rows a bias column of M elements can be added to?
+    virtual bool CanFuseBiasAndActivation() const = 0;
+    // output = activation(this node's value + bias), without forming this node's value
+    virtual void ForwardPropWithBiasAndActivation(const FrameRange& fr, const Matrix<ElemType>& bias, ElementWiseOperator activation, Matrix<ElemType>& output) = 0;
+};
+
 // =======================================================================
 // PreComputedNodeBase -- interface implemented by ComputationNodes that precompute
 // TODO: We can use this interface in more places.
@@ -1788,6 +2139,7 @@ protected:
     using Base::GetDeviceId;                                                                                                                             \
     using Base::GetInputSampleLayout;                                                                                                                    \
     using Base::GetInputsFromConfig;                                                                                                                     \
+    using Base::ForwardPropFusedElementWise;                                                                                                             \
     using Base::GetMBLayout;                                                                                                                             \
     using Base::GetNumInputs;                                                                                                                            \
     using Base::GetNumParallelSequences;                                                                                                                 \
@@ -1802,11 +2154,15 @@ protected:
     using Base::GradientFor;                                                                                                                             \
     using Base::GradientTensorFor;                                                                                                                       \
     using Base::HasMBLayout;                                                                                                                             \
+    using Base::HasFusedProducer;                                                                                                                        \
+    using Base::GetFusedProducer;                                                                                                                        \
     using Base::InferMBLayoutFromInputsForStandardCase;                                                                                                  \
     using Base::Input;                                                                                                                                   \
+    using Base::InputGradientBeta;                                                                                                                       \
     using Base::InputUsedInComputingInputNodesGradients;                                                                                                 \
     using Base::InvalidateMissingGradientColumns;                                                                                                        \
     using Base::InvalidateMissingValueColumns;                                                                                                           \
+    using Base::IsFusedIntoConsumer;                                                                                                                     \
     using Base::IsLeaf;                                                                                                                                  \
     using Base::IsOutOfDateWrtInputs;                                                                                                                    \
     using Base::IsPartOfLoop;                                                                                                                            \
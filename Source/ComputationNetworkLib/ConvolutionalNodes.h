@@ -56,7 +56,7 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 //     - for hidden layer: dimension of activation vector for each pixel
 //  - C' = output channels = dimension of activation vector for each pixel (also called N by NVidia, inconsistently)
 template <class ElemType>
-class ConvolutionNode : public ComputationNode<ElemType>, public NumInputs<2>
+class ConvolutionNode : public ComputationNode<ElemType>, public NumInputs<2>, public IInt8QuantizableNode
 {
     typedef ComputationNode<ElemType> Base;
     UsingComputationNodeMembersBoilerplate;
@@ -74,13 +74,15 @@ public:
           m_horizontalSubsample(SIZE_MAX),
           m_verticalSubsample(SIZE_MAX),
           m_zeroPadding(false),
+          m_groups(1),
           m_maxTempMemSizeInSamples(SIZE_MAX),
-          m_imageLayoutKind(ImageLayoutKind::HWC)
+          m_imageLayoutKind(ImageLayoutKind::HWC),
+          m_weightsQuantized(false)
     {
         SetDims(ImageDimensions::AsTensorShape(1, 1, 0, m_imageLayoutKind), 0);
     }
     ConvolutionNode(DEVICEID_TYPE deviceId, const wstring& name, const size_t kernelWidth, const size_t kernelHeight, const size_t outputChannels, const size_t horizontalSubsample, const size_t verticalSubsample, ImageLayoutKind imageLayoutKind,
-                    const bool zeroPadding = false, const size_t maxTempMemSizeInSamples = 0)
+                    const bool zeroPadding = false, const size_t maxTempMemSizeInSamples = 0, const size_t groups = 1)
         : Base(deviceId, name),
           m_outputChannels(outputChannels),
           m_kernelWidth(kernelWidth),
@@ -88,18 +90,22 @@ public:
           m_horizontalSubsample(horizontalSubsample),
           m_verticalSubsample(verticalSubsample),
           m_zeroPadding(zeroPadding),
+          m_groups(groups),
           m_maxTempMemSizeInSamples(maxTempMemSizeInSamples),
-          m_imageLayoutKind(imageLayoutKind)
+          m_imageLayoutKind(imageLayoutKind),
+          m_weightsQuantized(false)
     {
+        if (m_groups == 0 || m_outputChannels % m_groups != 0)
+            InvalidArgument("Convolution: The number of output channels (%d) must be a multiple of the number of groups (%d).", (int) m_outputChannels, (int) m_groups);
         SetDims(ImageDimensions::AsTensorShape(1, 1, m_outputChannels, m_imageLayoutKind), 0); // TODO: necessary?
         m_factory = ConvolutionEngineFactory<ElemType>::Create(deviceId, ConvolutionEngineFactory<ElemType>::EngineType::Auto, m_imageLayoutKind);
     }
     ConvolutionNode(const ScriptableObjects::IConfigRecordPtr configp)
         : ConvolutionNode(configp->Get(L"deviceId"), L"<placeholder>", configp->Get(L"kernelWidth"), configp->Get(L"kernelHeight"), configp->Get(L"outputChannels"),
                           configp->Get(L"horizontalSubsample"), configp->Get(L"verticalSubsample"), ImageLayoutKindFrom(configp->Get(L"imageLayout")),
-                          configp->Get(L"zeroPadding"), configp->Get(L"maxTempMemSizeInSamples"))
+                          configp->Get(L"zeroPadding"), configp->Get(L"maxTempMemSizeInSamples"), configp->Get(L"groups"))
     {
-        // weightNodeName, inputValueNodeName, kernelWidth, kernelHeight, outputChannels, horizontalSubsample, verticalSubsample, zeroPadding = false, maxTempMemSizeInSamples = 0
+        // weightNodeName, inputValueNodeName, kernelWidth, kernelHeight, outputChannels, horizontalSubsample, verticalSubsample, zeroPadding = false, maxTempMemSizeInSamples = 0, groups = 1
         AttachInputs(configp, this->GetExpectedNumInputs());
     }
 
@@ -111,6 +117,7 @@ public:
         uint32_t outputChannels = (uint32_t) m_outputChannels;
         fstream << outputChannels << imageLayoutKind;
         fstream << m_zeroPadding << m_maxTempMemSizeInSamples;
+        fstream << m_groups;
     }
 
     void Load(File& fstream, size_t modelVersion) override
@@ -123,6 +130,8 @@ public:
         m_outputChannels = outputChannels;
         SetDims(ImageDimensions::AsTensorShape(1, 1, m_outputChannels, m_imageLayoutKind), HasMBLayout()); // TODO: needed?
         fstream >> m_zeroPadding >> m_maxTempMemSizeInSamples;
+        if (modelVersion >= CNTK_MODEL_VERSION_5)
+            fstream >> m_groups;
         m_factory = ConvolutionEngineFactory<ElemType>::Create(GetDeviceId(), ConvolutionEngineFactory<ElemType>::EngineType::Auto, m_imageLayoutKind);
     }
 
@@ -139,6 +148,7 @@ public:
             node->m_verticalSubsample = m_verticalSubsample;
 
             node->m_zeroPadding = m_zeroPadding;
+            node->m_groups = m_groups;
 
             node->m_maxTempMemSizeInSamples = m_maxTempMemSizeInSamples;
 
@@ -177,9 +187,16 @@ public:
         return false;
     }
 
+    // each output element is a dot product over one row of the weights, [outputChannels, kernelWidth * kernelHeight * inputChannels / groups]
+    virtual double EstimateForwardFlops() const override
+    {
+        return 2.0 * GetSampleMatrixNumRows() * GetSampleMatrixNumCols() * Input(0)->GetAsMatrixNumCols();
+    }
+
     void ForwardProp(const FrameRange& fr) override
     {
-        const Matrix<ElemType>& input0 = Input(0)->ValueAsMatrix();
+        // with quantized weights, the engine does not read Input(0), whose value may have been freed
+        const Matrix<ElemType>& input0 = m_weightsQuantized ? Input(0)->Value() : Input(0)->ValueAsMatrix();
         Matrix<ElemType> sliceInput1Value = Input(1)->ValueFor(fr);
         Matrix<ElemType> sliceOutputValue = ValueFor(fr);
 
@@ -217,14 +234,17 @@ public:
             (inDims.m_height - kernelHeightCenter) / m_verticalSubsample   + 1,
             m_outputChannels);
 
-        size_t weightCols = m_kernelWidth * m_kernelHeight * inDims.m_numChannels;
+        // with groups, each output channel only sees the input channels of its group
+        if (isFinalValidationPass && inDims.m_numChannels % m_groups != 0)
+            InvalidArgument("%ls %ls operation requires that the number of input channels (%d) be a multiple of groups (%d).", NodeName().c_str(), OperationName().c_str(), (int) inDims.m_numChannels, (int) m_groups);
+        size_t weightCols = m_kernelWidth * m_kernelHeight * (inDims.m_numChannels / m_groups);
 
         // check/infer input [0] (weights)
         // BUGBUG: For now, we treat the weights as a 2D matrix. They should be a tensor proper.
         Input(0)->ValidateInferInputDimsFrom(TensorShape(m_outputChannels, weightCols));
 
         if (isFinalValidationPass && (Input(0)->GetAsMatrixNumCols() != weightCols || Input(0)->GetAsMatrixNumRows() != m_outputChannels))
-            LogicError("convolutionWeight matrix %ls should have dimension [%d, %d] which is [outputChannels, kernelWidth * kernelHeight * inputChannels]", Input(0)->NodeName().c_str(), (int) m_outputChannels, (int) weightCols);
+            LogicError("convolutionWeight matrix %ls should have dimension [%d, %d] which is [outputChannels, kernelWidth * kernelHeight * inputChannels / groups]", Input(0)->NodeName().c_str(), (int) m_outputChannels, (int) weightCols);
 
         // that's our dimension
         SetDims(outDims.AsTensorShape(m_imageLayoutKind), true);
@@ -243,11 +263,11 @@ public:
             if (m_inT == nullptr)
                 m_inT = m_factory->CreateTensor(inDims.m_width, inDims.m_height, inDims.m_numChannels, 1);
             if (m_filterT == nullptr)
-                m_filterT = m_factory->CreateFilter(m_kernelWidth, m_kernelHeight, inDims.m_numChannels, m_outputChannels);
+                m_filterT = m_factory->CreateFilter(m_kernelWidth, m_kernelHeight, inDims.m_numChannels / m_groups, m_outputChannels);
             if (m_outT == nullptr)
                 m_outT = m_factory->CreateTensor(outDims.m_width, outDims.m_height, outDims.m_numChannels, 1);
             if (m_convDesc == nullptr)
-                m_convDesc = m_factory->CreateConvDescriptor(*m_inT, *m_filterT, m_horizontalSubsample, m_verticalSubsample, m_zeroPadding);
+                m_convDesc = m_factory->CreateConvDescriptor(*m_inT, *m_filterT, m_horizontalSubsample, m_verticalSubsample, m_zeroPadding, m_groups);
             // REVIEW alexeyk: create per-channel bias (shared across all pixels). Consider adding other types of biases.
             if (m_biasT == nullptr)
                 m_biasT = m_factory->CreateTensor(1, 1, outDims.m_numChannels, 1);
@@ -268,7 +288,7 @@ public:
         fstream << string(str);
         sprintf(str, "Output[Width:%lu, Height:%lu, Channels:%lu]  \n", outDims.m_width, outDims.m_height, outDims.m_numChannels);
         fstream << string(str);
-        sprintf(str, "zeroPadding=%ls  maxTempMemSizeInSamples=%lu\n", m_zeroPadding ? L"true" : L"false", m_maxTempMemSizeInSamples);
+        sprintf(str, "zeroPadding=%ls  maxTempMemSizeInSamples=%lu  groups=%lu\n", m_zeroPadding ? L"true" : L"false", m_maxTempMemSizeInSamples, m_groups);
         fstream << string(str);
     }
 
@@ -277,6 +297,23 @@ public:
         m_maxTempMemSizeInSamples = maxTempMemSizeInSamples;
     }
 
+    size_t GetNumOutputChannels() const { return m_outputChannels; }
+    ImageLayoutKind GetImageLayoutKind() const { return m_imageLayoutKind; }
+
+    virtual ComputationNodeBasePtr /*IInt8QuantizableNode::*/ QuantizeWeightsToInt8() override
+    {
+        // the int8 product is an ungrouped GEMM of dense CPU input
+        if (Input(0)->OperationName() != OperationNameOf(LearnableParameter) || m_convEng == nullptr || m_groups != 1 || !IsDenseCPUInput(Input(1)))
+            return nullptr;
+        if (!m_weightsQuantized)
+        {
+            if (!m_convEng->SetQuantizedFilter(make_shared<Int8QuantizedMatrix<ElemType>>(Input(0)->ValueAsMatrix())))
+                return nullptr;
+            m_weightsQuantized = true;
+        }
+        return Input(0);
+    }
+
     // request matrices needed to do node function value evaluation
     void RequestMatricesBeforeForwardProp(MatrixPool& matrixPool) override
     {
@@ -296,6 +333,7 @@ private:
     size_t m_kernelWidth, m_kernelHeight;
     size_t m_horizontalSubsample, m_verticalSubsample;
     bool m_zeroPadding;
+    size_t m_groups; // 1, or e.g. the number of input channels for a depthwise convolution
     bool m_1DConvolutionOnGPUSparse;
 
     shared_ptr<Matrix<ElemType>> m_tempMatrix;
@@ -311,11 +349,226 @@ private:
     std::unique_ptr<ConvolutionTensor4D> m_outT;
     std::unique_ptr<ConvolutionDescriptor> m_convDesc;
     std::unique_ptr<ConvolutionTensor4D> m_biasT;
+
+    bool m_weightsQuantized; // the engine uses an int8 copy of Input(0)
 };
 
 template class ConvolutionNode<float>;
 template class ConvolutionNode<double>;
 
+// -----------------------------------------------------------------------
+// TemporalConvolutionNode (convolutionWeights, inputSequence)
+// -----------------------------------------------------------------------
+
+// 1-D convolution along the time axis of the sequences of a minibatch, as used by TDNN layers:
+//
+//     output(:,t) = W * [input(:,t + o_0); ...; input(:,t + o_{k-1})],  o_j = (j - (k-1)/2) * dilation
+//
+// Taps that fall outside their sequence read zeros, so sequences never see their neighbors in the minibatch.
+// The k taps of all frames are gathered into a [k*inputDim x T*S] matrix, and the convolution is a single GEMM
+// with the weights [outputDim x k*inputDim] on either device, instead of a cudnn convolution of height T per sequence.
+template <class ElemType>
+class TemporalConvolutionNode : public ComputationNodeNonLooping /*ComputationNode*/<ElemType>, public NumInputs<2>
+{
+    typedef ComputationNodeNonLooping<ElemType> Base;
+    UsingComputationNodeMembersBoilerplate;
+    static const std::wstring TypeName()
+    {
+        return L"TemporalConvolution";
+    }
+
+public:
+    TemporalConvolutionNode(DEVICEID_TYPE deviceId, const wstring& name, size_t kernelWidth = 1, size_t outputDim = 0, size_t dilation = 1)
+        : Base(deviceId, name),
+          m_kernelWidth(kernelWidth),
+          m_outputDim(outputDim),
+          m_dilation(dilation),
+          m_gatherIndex(deviceId),
+          m_scatterIndex(deviceId)
+    {
+        if (m_kernelWidth == 0 || m_dilation == 0)
+            InvalidArgument("TemporalConvolution: The kernel width (%d) and the dilation (%d) must be positive.", (int) m_kernelWidth, (int) m_dilation);
+    }
+    TemporalConvolutionNode(const ScriptableObjects::IConfigRecordPtr configp)
+        : TemporalConvolutionNode(configp->Get(L"deviceId"), L"<placeholder>", configp->Get(L"kernelWidth"), configp->Get(L"outputDim"), configp->Get(L"dilation"))
+    {
+        // weightNode, inputValueNode, kernelWidth, outputDim, dilation = 1
+        AttachInputs(configp, this->GetExpectedNumInputs());
+    }
+
+    void Save(File& fstream) const override
+    {
+        Base::Save(fstream);
+        fstream << m_kernelWidth << m_outputDim << m_dilation;
+    }
+
+    void Load(File& fstream, size_t modelVersion) override
+    {
+        Base::Load(fstream, modelVersion);
+        fstream >> m_kernelWidth >> m_outputDim >> m_dilation;
+    }
+
+    void CopyTo(ComputationNodeBasePtr nodeP, const std::wstring& newName, const CopyNodeFlags flags) const override
+    {
+        Base::CopyTo(nodeP, newName, flags);
+        if (flags & CopyNodeFlags::copyNodeValue)
+        {
+            auto node = dynamic_pointer_cast<TemporalConvolutionNode<ElemType>>(nodeP);
+            node->m_kernelWidth = m_kernelWidth;
+            node->m_outputDim = m_outputDim;
+            node->m_dilation = m_dilation;
+        }
+    }
+
+    void /*ComputationNodeNonLooping::*/ ForwardPropNonLooping() override
+    {
+        FrameRange fr(Input(1)->GetMBLayout());
+        auto input = Input(1)->ValueFor(fr);
+        const size_t inputDim = input.GetNumRows();
+        const size_t numCols = input.GetNumCols();
+        SetContextIndices();
+
+        // context(:, c*k + j) = input(:, c + o_j * S), reinterpreted as [k*inputDim x T*S]
+        m_context->DoGatherColumnsOf(0, m_gatherIndex, input, 1);
+        m_context->Reshape(m_kernelWidth * inputDim, numCols);
+        ValueFor(fr).AssignProductOf(Input(0)->ValueAsMatrix(), false, *m_context, false);
+    }
+
+    void /*ComputationNodeNonLooping::*/ BackpropToNonLooping(size_t inputIndex) override
+    {
+        FrameRange fr(Input(1)->GetMBLayout());
+        if (inputIndex == 0) // derivative with respect to the weights; the context columns of the gaps are zero
+        {
+            Matrix<ElemType>::MultiplyAndAdd(GradientFor(fr), false, *m_context, true, Input(0)->GradientAsMatrix());
+        }
+        else if (inputIndex == 1) // derivative with respect to the input: each tap adds its slice of W' * gradient back to the frames it read
+        {
+            auto inputGradient = Input(1)->GradientFor(fr);
+            const size_t inputDim = inputGradient.GetNumRows();
+            const size_t numCols = inputGradient.GetNumCols();
+            m_contextGradient->AssignProductOf(Input(0)->ValueAsMatrix(), true, GradientFor(fr), false);
+            m_contextGradient->Reshape(inputDim, m_kernelWidth * numCols);
+            for (size_t j = 0; j < m_kernelWidth; j++)
+                inputGradient.DoGatherColumnsOf(1, m_scatterIndex.ColumnSlice(j * numCols, numCols), *m_contextGradient, 1);
+        }
+    }
+
+    virtual bool OutputUsedInComputingInputNodesGradients() const override
+    {
+        return false;
+    }
+
+    virtual bool InputUsedInComputingInputNodesGradients(size_t childIndex) const override
+    {
+        return childIndex == 0; // the weights, for the input gradient; the input enters the weight gradient through the context
+    }
+
+    // the tap indices are computed on the host from the sequences of the minibatch
+    virtual bool /*ComputationNodeBase::*/ IsGraphCapturable() const override { return false; }
+
+    void /*ComputationNodeBase::*/ Validate(bool isFinalValidationPass) override
+    {
+        Base::Validate(isFinalValidationPass);
+        InferMBLayoutFromInputsForStandardCase();
+        if (isFinalValidationPass && !m_pMBLayout)
+            InvalidArgument("%ls %ls operation requires its input to be a sequence.", NodeName().c_str(), OperationName().c_str());
+
+        // check/infer input [0] (weights)
+        const size_t inputDim = GetInputSampleLayout(1).GetNumElements();
+        if (inputDim != 0) // (not known yet in early validation passes)
+            Input(0)->ValidateInferInputDimsFrom(TensorShape(m_outputDim, m_kernelWidth * inputDim));
+        if (isFinalValidationPass && (Input(0)->GetAsMatrixNumRows() != m_outputDim || Input(0)->GetAsMatrixNumCols() != m_kernelWidth * inputDim))
+            InvalidArgument("%ls %ls operation: weights %ls must be [%d x %d] for an output dimension of %d, a kernel width of %d, and an input dimension of %d.",
+                            NodeName().c_str(), OperationName().c_str(), Input(0)->NodeName().c_str(), (int) m_outputDim, (int) (m_kernelWidth * inputDim),
+                            (int) m_outputDim, (int) m_kernelWidth, (int) inputDim);
+
+        SetDims(TensorShape(m_outputDim), HasMBLayout());
+    }
+
+    void DumpNodeInfo(const bool printValues, const bool printMetadata, File& fstream) const override
+    {
+        Base::DumpNodeInfo(printValues, printMetadata, fstream);
+
+        char str[4096];
+        sprintf(str, "kernelWidth=%lu  outputDim=%lu  dilation=%lu\n", m_kernelWidth, m_outputDim, m_dilation);
+        fstream << string(str);
+    }
+
+    // each output element is a dot product over one row of the weights, [outputDim, kernelWidth * inputDim]
+    virtual double EstimateForwardFlops() const override
+    {
+        return 2.0 * GetSampleMatrixNumRows() * GetSampleMatrixNumCols() * Input(0)->GetAsMatrixNumCols();
+    }
+
+    // the context is kept from the forward pass for the weight gradient
+    void RequestMatricesBeforeForwardProp(MatrixPool& matrixPool) override
+    {
+        Base::RequestMatricesBeforeForwardProp(matrixPool);
+        RequestMatrixFromPool(m_context, matrixPool);
+    }
+
+    void RequestMatricesBeforeBackprop(MatrixPool& matrixPool) override
+    {
+        Base::RequestMatricesBeforeBackprop(matrixPool);
+        RequestMatrixFromPool(m_contextGradient, matrixPool);
+    }
+
+    // release gradient and temp matrices that no longer needed after all the children's gradients are computed.
+    void ReleaseMatricesAfterBackprop(MatrixPool& matrixPool) override
+    {
+        Base::ReleaseMatricesAfterBackprop(matrixPool);
+        ReleaseMatrixToPool(m_context, matrixPool);
+        ReleaseMatrixToPool(m_contextGradient, matrixPool);
+    }
+
+private:
+    // sets the input column of each tap of each frame (m_gatherIndex), and the inverse map per tap (m_scatterIndex); -1 reads zeros
+    void SetContextIndices()
+    {
+        const size_t numParallelSequences = m_pMBLayout->GetNumParallelSequences();
+        const size_t numTimeSteps = m_pMBLayout->GetNumTimeSteps();
+        const size_t numCols = numParallelSequences * numTimeSteps;
+        const size_t k = m_kernelWidth;
+        std::vector<ElemType> gatherIndex(k * numCols, (ElemType) -1);
+        std::vector<ElemType> scatterIndex(k * numCols, (ElemType) -1);
+        for (const auto& seq : m_pMBLayout->GetAllSequences())
+        {
+            if (seq.seqId == GAP_SEQUENCE_ID)
+                continue;
+            // frames outside the minibatch are not available, and are padded like the sequence boundaries
+            const ptrdiff_t tBegin = max(seq.tBegin, (ptrdiff_t) 0);
+            const ptrdiff_t tEnd = (ptrdiff_t) min(seq.tEnd, numTimeSteps);
+            for (ptrdiff_t t = tBegin; t < tEnd; t++)
+            {
+                const size_t c = t * numParallelSequences + seq.s;
+                for (size_t j = 0; j < k; j++)
+                {
+                    const ptrdiff_t tIn = t + ((ptrdiff_t) j - (ptrdiff_t) (k - 1) / 2) * (ptrdiff_t) m_dilation;
+                    if (tIn < tBegin || tIn >= tEnd)
+                        continue;
+                    const size_t cIn = tIn * numParallelSequences + seq.s;
+                    gatherIndex[c * k + j] = (ElemType) cIn;
+                    scatterIndex[j * numCols + cIn] = (ElemType) (c * k + j);
+                }
+            }
+        }
+        m_gatherIndex.SetValue(1, k * numCols, m_deviceId, gatherIndex.data());
+        m_scatterIndex.SetValue(1, k * numCols, m_deviceId, scatterIndex.data());
+    }
+
+    size_t m_kernelWidth;
+    size_t m_outputDim;
+    size_t m_dilation;
+
+    Matrix<ElemType> m_gatherIndex;  // [1 x k*T*S] input column of tap j of frame c at c*k + j
+    Matrix<ElemType> m_scatterIndex; // [1 x k*T*S] context column that reads input column c through tap j, at j*T*S + c
+    shared_ptr<Matrix<ElemType>> m_context;         // [k*inputDim x T*S]
+    shared_ptr<Matrix<ElemType>> m_contextGradient; // [k*inputDim x T*S]
+};
+
+template class TemporalConvolutionNode<float>;
+template class TemporalConvolutionNode<double>;
+
 // -----------------------------------------------------------------------
 // PoolingNodeBase (input)
 // -----------------------------------------------------------------------
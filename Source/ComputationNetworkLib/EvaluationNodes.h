@@ -57,11 +57,8 @@ public:
     virtual void /*ComputationNodeNonLooping::*/ ForwardPropNonLooping() override
     {
         FrameRange fr(Input(0)->GetMBLayout());
-        Input(0)->ValueFor(fr).VectorMax(*m_maxIndexes0, *m_maxValues, true);
-        Input(1)->ValueFor(fr).VectorMax(*m_maxIndexes1, *m_maxValues, true, m_topK);
-        MaskMissingColumnsToZero(*m_maxIndexes0, Input(0)->GetMBLayout(), fr);
-        MaskMissingColumnsToZero(*m_maxIndexes1, Input(1)->GetMBLayout(), fr);
-        Value().AssignNumOfDiff(*m_maxIndexes0, *m_maxIndexes1, m_topK > 1);
+        // gaps are zero in both inputs, which does not count as an error
+        Value().AssignNumOfTopKErrorsOf(Input(0)->MaskedValueFor(fr), Input(1)->MaskedValueFor(fr), m_topK);
 #if NANCHECK
         Value().HasNan("ErrorPrediction");
 #endif
@@ -81,53 +78,12 @@ public:
             if (Input(2)->GetSampleLayout().GetNumElements() != 1)
                 InvalidArgument("%ls %ls operation requires TopK to be a scalar value.", NodeName().c_str(), OperationName().c_str());
             m_topK = static_cast<int>(Input(2)->Get00Element());
+            if (isFinalValidationPass && (m_topK < 1 || m_topK > Input(1)->GetSampleMatrixNumRows()))
+                InvalidArgument("%ls %ls operation requires TopK to be between 1 and the dimension of the predictions (%d).", NodeName().c_str(), OperationName().c_str(), (int) Input(1)->GetSampleMatrixNumRows());
         }
     }
 
-    virtual void UpdateFunctionMBSize() override
-    {
-        Base::UpdateFunctionMBSize();
-
-        // resize the temporaries to their proper size
-        size_t cols = Input(0)->Value().GetNumCols();
-        m_maxIndexes0->Resize(m_topK, cols);
-        m_maxIndexes1->Resize(m_topK, cols);
-        m_maxValues->Resize(m_topK, cols);
-    }
-
-    virtual void CopyTo(ComputationNodeBasePtr nodeP, const std::wstring& newName, const CopyNodeFlags flags) const override
-    {
-        Base::CopyTo(nodeP, newName, flags);
-        if (flags & CopyNodeFlags::copyNodeValue)
-        {
-            auto node = dynamic_pointer_cast<ErrorPredictionNode<ElemType>>(nodeP);
-            *node->m_maxIndexes0 = *m_maxIndexes0;
-            *node->m_maxIndexes1 = *m_maxIndexes1;
-            *node->m_maxValues = *m_maxValues;
-        }
-    }
-    // request matrices needed to do node function value evaluation
-    virtual void RequestMatricesBeforeForwardProp(MatrixPool& matrixPool)
-    {
-        Base::RequestMatricesBeforeForwardProp(matrixPool);
-        RequestMatrixFromPool(m_maxIndexes0, matrixPool);
-        RequestMatrixFromPool(m_maxIndexes1, matrixPool);
-        RequestMatrixFromPool(m_maxValues, matrixPool);
-    }
-
-    // release temp matrices that are only used by forward computation
-    // don't release matrices that need to be used in the gradient computation
-    virtual void ReleaseMatricesAfterForwardProp(MatrixPool& matrixPool)
-    {
-        Base::ReleaseMatricesAfterForwardProp(matrixPool);
-        ReleaseMatrixToPool(m_maxIndexes0, matrixPool);
-        ReleaseMatrixToPool(m_maxIndexes1, matrixPool);
-        ReleaseMatrixToPool(m_maxValues, matrixPool);
-    }
-
 private:
-    shared_ptr<Matrix<ElemType>> m_maxIndexes0, m_maxIndexes1;
-    shared_ptr<Matrix<ElemType>> m_maxValues;
     int m_topK;
 };
 
@@ -160,6 +116,7 @@ private:
     // TODO: member variables go to the end
     Matrix<ElemType> mAlpha;
     Matrix<ElemType> mBacktrace;
+    Matrix<ElemType> mSequences; // [3 x N] (parallel sequence, first frame, end frame) of each sequence of the minibatch
 
     int mStartLab; // the starting output label
     int mEndLab;   // the ending output label, if avaliable
@@ -171,21 +128,21 @@ public:
         : Base(deviceId, name),
           mAlpha(deviceId),
           mBacktrace(deviceId),
+          mSequences(deviceId),
           mStartLab(-1),
           mEndLab(-1)
     {
     }
 
-    static void DecideStartEndingOutputLab(const Matrix<ElemType>& lbls, int& stt, int& stp)
+    // the labels of the first and the last frame of the pseudo label sequence in columns [firstCol, lastCol]
+    static void DecideStartEndingOutputLab(const Matrix<ElemType>& lbls, size_t firstCol, size_t lastCol, int& stt, int& stp)
     {
         if (stt != -1 && stp != -1)
             return; // have computed before
 
-        int iNumPos = lbls.GetNumCols();
-
         int firstLbl = -1;
         for (int ik = 0; ik < lbls.GetNumRows(); ik++)
-            if (lbls(ik, 0) != 0)
+            if (lbls(ik, firstCol) != 0)
             {
                 firstLbl = ik;
                 break;
@@ -193,7 +150,7 @@ public:
 
         int lastLbl = -1;
         for (int ik = 0; ik < lbls.GetNumRows(); ik++)
-            if (lbls(ik, iNumPos - 1) != 0)
+            if (lbls(ik, lastCol) != 0)
             {
                 lastLbl = ik;
                 break;
@@ -217,101 +174,35 @@ public:
         return false;
     }
 
-    // compute posterior probability of label y at position t
+    // decode the best label path of every sequence in the minibatch
+    // All sequences are decoded concurrently on the device of the scores, the backpointers do not leave it.
     virtual void /*ComputationNodeNonLooping::*/ ForwardPropNonLooping() override
     {
-        DecideStartEndingOutputLab(Input(0)->Value(), mStartLab, mEndLab);
-        ForwardPropS(mAlpha, mBacktrace, Value(), Input(1)->Value(),
-                     Input(2)->Value(), mStartLab, mEndLab);
-    }
-
-    // compute forward backward algorithm
-    void ForwardPropS(Matrix<ElemType>& alpha, Matrix<ElemType>& backtrace, Matrix<ElemType>& functionValues, const Matrix<ElemType>& pos_scores, const Matrix<ElemType>& pair_scores, const size_t stt, const size_t stp)
-    {
-        // to-do, each slice is for one sentence
-        // to-do, number of slices correspond to number of frames
-        // this implementation only supports one sentence per minibatch
-
-        // change to other values so can support multiple sentences in each minibatch
-        ForwardCompute(alpha, backtrace, pos_scores, pair_scores, stt);
-        BackwardCompute(functionValues, backtrace, stp);
-    };
-
-    // compute forward backward algorithm
-    static void ForwardCompute(Matrix<ElemType>& alpha,
-                               Matrix<ElemType>& backtrace,
-                               const Matrix<ElemType>& pos_scores, const Matrix<ElemType>& pair_scores,
-                               const size_t stt)
-    {
-        // to-do, shift more than 1 to support muliple sentences per minibatch
-        int iNumPos = pos_scores.GetNumCols();
-        int iNumLab = pos_scores.GetNumRows();
-        size_t iTmp = 0;
-
-        // need to have
-        alpha.Resize(iNumLab, iNumPos);
-        backtrace.Resize(iNumLab, iNumPos);
-
-        for (int t = 0; t < iNumPos; t++)
+        size_t numParallelSequences = 1;
+        std::vector<ElemType> sequences;
+        if (m_pMBLayout)
         {
-            for (int k = 0; k < iNumLab; k++)
+            numParallelSequences = m_pMBLayout->GetNumParallelSequences();
+            for (const auto& seq : m_pMBLayout->GetAllSequences())
             {
-                ElemType fTmp = (ElemType) LZERO;
-                if (t > 1)
-                {
-                    for (int j = 0; j < iNumLab; j++)
-                    {
-                        ElemType fAlpha = alpha(j, t - 1) + pair_scores(k, j);
-                        if (fAlpha > fTmp)
-                        {
-                            fTmp = fAlpha;
-                            iTmp = j;
-                        }
-                    }
-                    fTmp += pos_scores(k, t); // include position dependent score
-                }
-                else
-                {
-                    // with constrain that the first word is labeled as a given symbol
-                    iTmp = stt;
-                    fTmp = 0;
-                    if (t == 1)
-                    {
-                        fTmp = alpha(iTmp, t - 1);
-                        fTmp += pair_scores(k, iTmp);
-                        fTmp += pos_scores(k, t);
-                    }
-                    else
-                    {
-                        fTmp = (k == stt) ? pos_scores(k, t) : (ElemType) LZERO;
-                    }
-                }
-                alpha(k, t) = fTmp;
-                backtrace(k, t) = (ElemType) iTmp;
+                if (seq.seqId == GAP_SEQUENCE_ID)
+                    continue;
+                if (seq.tBegin < 0 || seq.tEnd > m_pMBLayout->GetNumTimeSteps())
+                    InvalidArgument("%ls %ls operation requires each sequence to be entirely in its minibatch, truncated sequences are not supported.", NodeName().c_str(), OperationName().c_str());
+                sequences.insert(sequences.end(), {(ElemType) seq.s, (ElemType) seq.tBegin, (ElemType) seq.tEnd});
             }
         }
-    };
+        else
+            sequences = {0, 0, (ElemType) Input(1)->Value().GetNumCols()};
+        if (sequences.empty())
+            return;
+        mSequences.SetValue(3, sequences.size() / 3, m_deviceId, sequences.data());
 
-    // compute backward algorithm
-    static void BackwardCompute(
-        Matrix<ElemType>& decodedpath,
-        const Matrix<ElemType>& backtrace, const size_t stp)
-    {
-        int iNumPos = backtrace.GetNumCols();
-        int iNumLab = backtrace.GetNumRows();
-
-        decodedpath.Resize(iNumLab, iNumPos);
-        decodedpath.SetValue(0);
-
-        size_t lastlbl = stp;
-        decodedpath(lastlbl, iNumPos - 1) = 1;
-
-        for (int t = iNumPos - 1; t > 0; t--)
-        {
-            lastlbl = (size_t) backtrace(lastlbl, t);
-            decodedpath(lastlbl, t - 1) = 1;
-        }
-    };
+        // the pseudo labels of the first sequence tell the beginning and ending output symbol
+        DecideStartEndingOutputLab(Input(0)->Value(), (size_t) sequences[1] * numParallelSequences + (size_t) sequences[0],
+                                   ((size_t) sequences[2] - 1) * numParallelSequences + (size_t) sequences[0], mStartLab, mEndLab);
+        Value().AssignViterbiPathOf(Input(1)->Value(), Input(2)->Value(), mSequences, numParallelSequences, mStartLab, mEndLab, mAlpha, mBacktrace);
+    }
 
     // need to feed in pseudo label data, which tells the decoder what is the beginning
     // and ending output symbol. these symbols will constrain the search space
@@ -248,6 +248,35 @@ public:
 #endif
     }
 
+    // Pruned weights (see ComputationNetwork::PruneParameters()) are kept at 0 while fine-tuning by masking the value after
+    // each update. The mask covers the elements that are exactly 0 now; it is not saved with the model.
+    // Returns the number of masked elements; there is no mask if there are none.
+    size_t SetPruningMaskFromZeros()
+    {
+        const auto& value = Value();
+        std::unique_ptr<ElemType[]> mask(value.CopyToArray());
+        size_t numZeros = 0;
+        for (size_t i = 0; i < value.GetNumElements(); i++)
+        {
+            numZeros += mask[i] == 0;
+            mask[i] = mask[i] == 0 ? 0 : 1;
+        }
+        if (numZeros == 0)
+            m_pruningMask.reset();
+        else
+        {
+            m_pruningMask = make_shared<Matrix<ElemType>>(m_deviceId);
+            m_pruningMask->SetValue(value.GetNumRows(), value.GetNumCols(), m_deviceId, mask.get(), matrixFlagNormal);
+        }
+        return numZeros;
+    }
+
+    void ApplyPruningMask()
+    {
+        if (m_pruningMask)
+            Value().ElementMultiplyWith(*m_pruningMask);
+    }
+
     // computation functions don't do anything for parameter nodes
     virtual void UpdateFunctionMBSize() override
     {
@@ -319,6 +348,9 @@ public:
 
         PrintNodeValuesToFile(printValues, printMetadata, fstream);
     }
+
+private:
+    shared_ptr<Matrix<ElemType>> m_pruningMask; // 1 for the elements that are trained, 0 for pruned ones; null if none are pruned
 };
 
 // -----------------------------------------------------------------------
@@ -536,6 +568,10 @@ public:
     {
         if (inputIndex == 0) // left derivative (embedding matrix)
         {
+            // For sparse input, the gradient only has the columns of the words that were looked up (block-column sparse), as in TimesNode.
+            if (Input(1)->Value().GetMatrixType() == SPARSE && Input(0)->Gradient().GetMatrixType() == DENSE && Gradient().GetMatrixType() == DENSE)
+                Input(0)->Gradient().SwitchToMatrixType(SPARSE, MatrixFormat::matrixFormatSparseBlockCol, false);
+
             // This is a reduction operation, hence we need to mask out gaps.
             Matrix<ElemType> sliceInput1Value = Input(1)->MaskedValueFor(t);
             Matrix<ElemType> sliceOutputGrad = MaskedGradientFor(t);
@@ -618,6 +654,18 @@ public:
         SetDims(TensorShape(Input(0)->GetAsMatrixNumRows() * wordsInEachSample), true);
     }
 
+    virtual void AllocateGradientMatricesForInputs(MatrixPool& matrixPool) override
+    {
+        // the sparse gradient of the embedding matrix is allocated directly instead of from the pool, see BackpropTo()
+        if (Input(0)->NeedsGradient() && Input(1)->Value().GetMatrixType() == SPARSE)
+        {
+            Input(0)->CreateGradientMatrixIfNull();
+            Input(0)->Gradient().SwitchToMatrixType(SPARSE, MatrixFormat::matrixFormatSparseBlockCol, false);
+        }
+
+        Base::AllocateGradientMatricesForInputs(matrixPool);
+    }
+
     bool UnitTest()
     {
         try
@@ -8,6 +8,9 @@
 #include "ComputationNode.h"
 #include "ConvolutionalNodes.h"
 #include "Matrix.h"
+#include "Int8QuantizedMatrix.h"
+#include "BlockSparseMatrix.h"
+#include "PackedWeightMatrix.h"
 #include "TensorView.h"
 
 #include <unordered_set>
@@ -25,10 +28,14 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 
 // -----------------------------------------------------------------------
 // PlusNode (summand1, summand2)
+// The bias of a dense layer, Sigmoid/Tanh/RectifiedLinear (Times (W, x) + b), is fused with the product and
+// the activation when the network is compiled (see ComputationNetwork::FuseActivations()): the activation's
+// value is then computed by the GEMM with the bias and activation as its epilogue, and its gradient is
+// back-propagated into the gradients of the product and the bias in one pass.
 // -----------------------------------------------------------------------
 
 template <class ElemType>
-class PlusNode : public BinaryElementWiseNode<ElemType>
+class PlusNode : public BinaryElementWiseNode<ElemType>, public IFusedActivationProducer<ElemType>
 {
     typedef BinaryElementWiseNode<ElemType> Base;
     UsingBinaryElementwiseNodeBaseMembers;
@@ -46,6 +53,10 @@ public:
 
     virtual void /*ComputationNode::*/ ForwardProp(const FrameRange& fr) override
     {
+        if (IsFusedIntoConsumer()) // the consumer computes our value together with its own, see ForwardPropWithActivation()
+            return;
+        if (ForwardPropFusedElementWise(fr))
+            return;
         size_t rank = DetermineElementwiseTensorRank();
         auto result =           ValueTensorFor(rank, fr);
         auto input0 = Input(0)->ValueTensorFor(rank, fr.AllowBroadcast());
@@ -53,7 +64,91 @@ public:
         result.AssignSumOf(input0, input1);
     }
 
+    virtual bool GetElementWiseForwardOp(ElementWiseOperator& op) const override
+    {
+        op = opSum;
+        return true;
+    }
+
     virtual void /*ComputationNode::*/ BackpropTo(const size_t inputIndex, const FrameRange& fr) override
+    {
+        // When fused, the consumer has already done this in BackpropToWithActivation().
+        if (!IsFusedIntoConsumer())
+            BackpropFromGradient(inputIndex, fr);
+    }
+
+    virtual bool CanAssignGradientOfInput(size_t /*childIndex*/) const override { return true; }
+
+    // Times (W, x) + b, where W * x is a single GEMM and b is a column vector of its rows
+    virtual bool /*IActivationFusableNode::*/ CanFuseActivation(ElementWiseOperator op) const override
+    {
+        if (op != ElementWiseOperator::opLinearRectifier && op != ElementWiseOperator::opSigmoid && op != ElementWiseOperator::opTanh)
+            return false;
+        auto product = dynamic_cast<IFusedMatrixProduct<ElemType>*>(Input(0).get());
+        const size_t rows = Input(0)->GetSampleMatrixNumRows();
+        return product && product->CanFuseBiasAndActivation() &&
+               Input(0)->GetMBLayout() == GetMBLayout() && GetSampleLayout() == Input(0)->GetSampleLayout() &&
+               !Input(1)->HasMBLayout() && Input(1)->GetSampleLayout().GetNumElements() == rows && Input(1)->GetSampleLayout()[0] == rows &&
+               Input(1)->Value().GetNumRows() == rows && Input(1)->Value().GetNumCols() == 1;
+    }
+
+    virtual ComputationNodeBasePtr /*IActivationFusableNode::*/ GetFusedOperand() const override
+    {
+        return Input(0);
+    }
+
+    virtual void /*IFusedActivationProducer::*/ ForwardPropWithActivation(const FrameRange& fr, ElementWiseOperator activation, Matrix<ElemType>& output) override
+    {
+        auto product = dynamic_cast<IFusedMatrixProduct<ElemType>*>(Input(0).get());
+        product->ForwardPropWithBiasAndActivation(fr, Input(1)->Value(), activation, output);
+    }
+
+    // The gradient of the product is written in the same pass that sums up the gradient of the bias. The product's own
+    // BackpropTo() then propagates it as usual. Where that cannot be done (gaps, which must not be summed into the bias,
+    // or a product without gradient), this node's own gradient takes the activation's gradient, as if not fused.
+    virtual void /*IFusedActivationProducer::*/ BackpropToWithActivation(const FrameRange& fr, ElementWiseOperator activation, const Matrix<ElemType>& outputGradient, const Matrix<ElemType>& output) override
+    {
+        auto product = Input(0), bias = Input(1);
+        if (product->NeedsGradient() && bias->NeedsGradient() && !(GetMBLayout() && GetMBLayout()->HasGaps(fr)))
+        {
+            ElemType productBeta = 1;
+            if (fr.IsAllFrames() && !product->IsGradientInitialized()) // (see ComputationNode::Backprop())
+            {
+                product->Gradient().Resize(product->Value());
+                product->KeepGradient();
+                productBeta = 0;
+            }
+            else
+                product->LazyZeroGradient();
+            bias->LazyZeroGradient();
+            auto productGradient = product->GradientFor(fr);
+            Matrix<ElemType>::BackpropBiasActivation(outputGradient, output, activation, productBeta, productGradient, 1, bias->Gradient());
+            return;
+        }
+
+        auto derivativeOp = activation == ElementWiseOperator::opSigmoid ? ElementWiseOperator::opElementwiseProductWithSigmoidDerivativeFromOutput :
+                            activation == ElementWiseOperator::opTanh    ? ElementWiseOperator::opElementwiseProductWithTanhDerivativeFromOutput :
+                                                                           ElementWiseOperator::opElementwiseProductWithLinearRectifierDerivativeFromOutput;
+        this->UpdateDataSize(this->Gradient()); // (the consumer's Backprop() bypasses the base implementation that does this)
+        TensorView<ElemType>(GradientFor(fr)).DoBinaryOpOf(0, TensorView<ElemType>(outputGradient), TensorView<ElemType>(output), 1, derivativeOp);
+        for (size_t i = 0; i < 2; i++)
+        {
+            if (!Input(i)->NeedsGradient())
+                continue;
+            Input(i)->LazyZeroGradient();
+            BackpropFromGradient(i, fr);
+        }
+    }
+
+    // while fused, the consumer requests the gradients of this node's inputs before its Backprop() computes them
+    virtual void /*ComputationNodeBase::*/ AllocateGradientMatricesForInputs(MatrixPool& matrixPool) override
+    {
+        if (!IsFusedIntoConsumer())
+            Base::AllocateGradientMatricesForInputs(matrixPool);
+    }
+
+private:
+    void BackpropFromGradient(const size_t inputIndex, const FrameRange& fr)
     {
         size_t rank = DetermineElementwiseTensorRank();
         auto gradient      =                    GradientTensorFor(rank, fr);
@@ -63,7 +158,7 @@ public:
         if (Input(inputIndex)->ReducesInTimeWrt(shared_from_this()))
             MaskMissingGradientColumnsToZero(fr);
 
-        inputGradient.AddCopyOf(gradient);
+        inputGradient.DoCopyOf(InputGradientBeta(), gradient, 1);
     }
 };
 
@@ -98,17 +193,27 @@ public:
         if (Input(inputIndex)->ReducesInTimeWrt(shared_from_this()))
             MaskMissingGradientColumnsToZero(fr);
 
-        inputGradient.AddCopyOf(gradient, sign);
+        inputGradient.DoCopyOf(InputGradientBeta(), gradient, sign);
     }
 
+    virtual bool CanAssignGradientOfInput(size_t /*childIndex*/) const override { return true; }
+
     virtual void /*ComputationNode::*/ ForwardProp(const FrameRange& fr) override
     {
+        if (ForwardPropFusedElementWise(fr))
+            return;
         size_t rank = DetermineElementwiseTensorRank();
         auto result =           ValueTensorFor(rank, fr);
         auto input0 = Input(0)->ValueTensorFor(rank, fr.AllowBroadcast());
         auto input1 = Input(1)->ValueTensorFor(rank, fr.AllowBroadcast());
         result.AssignDifferenceOf(input0, input1);
     }
+
+    virtual bool GetElementWiseForwardOp(ElementWiseOperator& op) const override
+    {
+        op = opDifference;
+        return true;
+    }
 };
 
 template class MinusNode<float>;
@@ -173,7 +278,7 @@ template class NegateNode<double>;
 // -----------------------------------------------------------------------
 
 template <class ElemType, bool m_transpose>
-class TimesNodeBase : public ComputationNode<ElemType>, public NumInputs<2>
+class TimesNodeBase : public ComputationNode<ElemType>, public NumInputs<2>, public IInt8QuantizableNode, public IBlockSparseWeightsNode, public IPackedWeightsNode, public IFusedMatrixProduct<ElemType>
 {
     typedef ComputationNode<ElemType> Base; UsingComputationNodeMembers; using Base::OperationName;                                                                                                                           \
 
@@ -200,6 +305,27 @@ public:
 
     virtual void /*ComputationNode::*/ ForwardProp(const FrameRange& fr) override
     {
+        if (IsFusedIntoConsumer()) // the bias Plus computes our value together with its own, see ForwardPropWithBiasAndActivation()
+            return;
+        if (m_quantizedWeights)
+        {
+            auto output = ValueFor(fr);
+            m_quantizedWeights->Multiply(Input(1)->ValueFor(fr), output);
+            return;
+        }
+        if (m_sparseWeights)
+        {
+            auto output = ValueFor(fr);
+            m_sparseWeights->Multiply(Input(1)->ValueFor(fr), output);
+            return;
+        }
+        if (m_packedWeights)
+        {
+            auto output = ValueFor(fr);
+            m_packedWeights->Multiply(Input(1)->ValueFor(fr), output);
+            return;
+        }
+
         // TensorView::DoMatrixProductOf() will reduce each tensor object into a 2D tensor (or fail if it cannot)
         // and recreate actual Matrix objects (in case of sparse, they must be identical to the original tensor storage object).
         // Transposition is applied after flattening into 2D.
@@ -224,20 +350,32 @@ public:
             auto outputGradient =           GradientTensorFor(          GetSampleLayout().GetRank(), fr);
             auto input0Gradient = Input(0)->GradientTensorFor(Input(0)->GetSampleLayout().GetRank(), FrameRange(/*select entire object*/));
             auto input1         = Input(1)->   ValueTensorFor(Input(1)->GetSampleLayout().GetRank(), fr);
-            input0Gradient.AddMatrixProductOf(m_transpose/*transC*/, outputGradient, false/*transA*/, input1, true/*transB*/);
+            input0Gradient.DoMatrixProductOf(InputGradientBeta(), m_transpose/*transC*/, outputGradient, false/*transA*/, input1, true/*transB*/, 1);
         }
         else if (inputIndex == 1) // right derivative
         {
             auto outputGradient =           GradientTensorFor(          GetSampleLayout().GetRank(), fr);
             auto input0         = Input(0)->   ValueTensorFor(Input(0)->GetSampleLayout().GetRank(), FrameRange(/*select entire object*/));
             auto input1Gradient = Input(1)->GradientTensorFor(Input(1)->GetSampleLayout().GetRank(), fr);
-            input1Gradient.AddMatrixProductOf(false/*transC*/, input0, !m_transpose/*transA*/, outputGradient, false/*transB*/);
+            input1Gradient.DoMatrixProductOf(InputGradientBeta(), false/*transC*/, input0, !m_transpose/*transA*/, outputGradient, false/*transB*/, 1);
         }
     }
 
+    // except for the block-sparse gradient of the weights of a sparse input, which is only ever accumulated
+    virtual bool CanAssignGradientOfInput(size_t childIndex) const override
+    {
+        return childIndex != 0 || (Input(1)->Value().GetMatrixType() != SPARSE && Input(0)->Gradient().GetMatrixType() != SPARSE);
+    }
+
     virtual bool OutputUsedInComputingInputNodesGradients() const override { return false; }
     // but both inputs are
 
+    // a product of a [M x K] and a [K x N] matrix, where Input(0) holds the M*K elements
+    virtual double EstimateForwardFlops() const override
+    {
+        return 2.0 * Input(0)->GetSampleLayout().GetNumElements() * GetSampleMatrixNumCols();
+    }
+
     virtual void /*ComputationNodeBase::*/ Validate(bool isFinalValidationPass) override
     {
         Base::Validate(isFinalValidationPass);
@@ -354,8 +492,79 @@ public:
         Base::AllocateGradientMatricesForInputs(matrixPool);
     }
 
+    // W * x as a single GEMM with a dense x
+    virtual bool /*IFusedMatrixProduct::*/ CanFuseBiasAndActivation() const override
+    {
+        bool transpose = m_transpose;
+        return !transpose && m_outputRank == 1 && !Input(0)->HasMBLayout() && Input(1)->Value().GetMatrixType() == DENSE &&
+               Input(0)->Value().GetNumRows() == GetSampleMatrixNumRows() && Input(0)->Value().GetNumCols() == Input(1)->GetSampleMatrixNumRows();
+    }
+
+    virtual void /*IFusedMatrixProduct::*/ ForwardPropWithBiasAndActivation(const FrameRange& fr, const Matrix<ElemType>& bias, ElementWiseOperator activation, Matrix<ElemType>& output) override
+    {
+        if (HasWeightCopy()) // their own kernels, with bias and activation in a second pass
+        {
+            if (m_quantizedWeights)
+                m_quantizedWeights->Multiply(Input(1)->ValueFor(fr), output);
+            else if (m_sparseWeights)
+                m_sparseWeights->Multiply(Input(1)->ValueFor(fr), output);
+            else
+                m_packedWeights->Multiply(Input(1)->ValueFor(fr), output);
+            output.AddBiasActivation(bias, activation);
+        }
+        else
+            Matrix<ElemType>::MultiplyAndAddBiasActivation(Input(0)->Value(), false, Input(1)->ValueFor(fr), bias, activation, output);
+    }
+
+    // only the plain matrix product W * x of a CPU network, where W is a parameter and x is dense, is quantized
+    virtual ComputationNodeBasePtr /*IInt8QuantizableNode::*/ QuantizeWeightsToInt8() override
+    {
+        if (!IsPlainParameterProductOnCPU() || !IsDenseCPUInput(Input(1)) || m_sparseWeights || m_packedWeights)
+            return nullptr;
+        if (!m_quantizedWeights)
+            m_quantizedWeights = make_shared<Int8QuantizedMatrix<ElemType>>(Input(0)->Value());
+        return Input(0);
+    }
+
+    // same for the block-sparse weights of pruned models
+    virtual ComputationNodeBasePtr /*IBlockSparseWeightsNode::*/ UseBlockSparseWeights(size_t blockRows, size_t blockCols, double minSparsity) override
+    {
+        if (!IsPlainParameterProductOnCPU() || m_quantizedWeights || m_packedWeights)
+            return nullptr;
+        if (!m_sparseWeights)
+        {
+            auto sparseWeights = make_shared<BlockSparseMatrix<ElemType>>(Input(0)->Value(), blockRows, blockCols);
+            if (sparseWeights->GetSparsity() < minSparsity)
+                return nullptr;
+            m_sparseWeights = sparseWeights;
+        }
+        return Input(0);
+    }
+
+    // and the remaining ones may use weights packed for GEMM
+    virtual ComputationNodeBasePtr /*IPackedWeightsNode::*/ PackWeights() override
+    {
+        if (!IsPlainParameterProductOnCPU() || m_quantizedWeights || m_sparseWeights)
+            return nullptr;
+        if (!m_packedWeights)
+            m_packedWeights = make_shared<PackedWeightMatrix<ElemType>>(Input(0)->Value());
+        return Input(0);
+    }
+
 private:
+    bool HasWeightCopy() const { return m_quantizedWeights || m_sparseWeights || m_packedWeights; }
+
+    bool IsPlainParameterProductOnCPU() const
+    {
+        bool transpose = m_transpose;
+        return !transpose && m_outputRank == 1 && Input(0)->OperationName() == OperationNameOf(LearnableParameter) && m_deviceId == CPUDEVICE &&
+               Input(0)->Value().GetNumRows() == GetSampleMatrixNumRows() && Input(0)->Value().GetNumCols() == Input(1)->GetSampleMatrixNumRows();
+    }
+
     size_t m_outputRank;
+    shared_ptr<Int8QuantizedMatrix<ElemType>> m_quantizedWeights; // if set, ForwardProp() uses this instead of Input(0)
+    shared_ptr<BlockSparseMatrix<ElemType>> m_sparseWeights;      // likewise
+    shared_ptr<PackedWeightMatrix<ElemType>> m_packedWeights;     // likewise
 };
 
 // -----------------------------------------------------------------------
@@ -457,9 +666,11 @@ public:
         if (Input(inputIndex)->ReducesInTimeWrt(Input(1 - inputIndex)))
             Input(1 - inputIndex)->MaskMissingValueColumnsToZero(fr);
 
-        inputGradient.AddElementwiseProductOf(gradient, otherInputValue);
+        inputGradient.DoElementwiseProductOf(InputGradientBeta(), gradient, otherInputValue, 1);
     }
 
+    virtual bool CanAssignGradientOfInput(size_t /*childIndex*/) const override { return true; }
+
     virtual bool InputUsedInComputingInputNodesGradients(size_t childIndex) const override
     {
         return true;
@@ -467,12 +678,20 @@ public:
 
     virtual void /*ComputationNode::*/ ForwardProp(const FrameRange& fr) override
     {
+        if (ForwardPropFusedElementWise(fr))
+            return;
         size_t rank = DetermineElementwiseTensorRank();
         auto result = ValueTensorFor(rank, fr);
         auto input0 = Input(0)->ValueTensorFor(rank, fr.AllowBroadcast());
         auto input1 = Input(1)->ValueTensorFor(rank, fr.AllowBroadcast());
         result.AssignElementwiseProductOf(input0, input1);
     }
+
+    virtual bool GetElementWiseForwardOp(ElementWiseOperator& op) const override
+    {
+        op = opElementwiseProduct;
+        return true;
+    }
 };
 
 template class ElementTimesNode<float>;
@@ -866,42 +1085,15 @@ public:
 
     virtual void /*ComputationNode::*/ BackpropTo(const size_t inputIndex, const FrameRange& fr) override
     {
-        // functionValues, invNorm0, invNorm1 - output from the EvaluateNode() method
-        // temp, rightTerm, leftTerm - temporary matrices
-        if (inputIndex == 0) // left derivative
-            m_temp->AssignElementProductOf(*m_invNorm0, *m_invNorm0);
-        else // right derivative
-            m_temp->AssignElementProductOf(*m_invNorm1, *m_invNorm1);
-
-        m_temp->ElementMultiplyWith(ValueFor(fr));
-        m_rightTerm->SetValue(Input(inputIndex)->ValueFor(fr));
-        m_rightTerm->RowElementMultiplyWith(*m_temp);
-
-        m_temp->AssignElementProductOf(*m_invNorm0, *m_invNorm1);
-        m_leftTerm->SetValue(Input(1 - inputIndex)->ValueFor(fr));
-        m_leftTerm->RowElementMultiplyWith(*m_temp);
-
-        *m_leftTerm -= *m_rightTerm;
-        m_leftTerm->RowElementMultiplyWith(GradientFor(fr));
-        Input(inputIndex)->GradientFor(fr) += *m_leftTerm;
+        // invNorm0, invNorm1 - output from ForwardProp()
+        Input(inputIndex)->GradientFor(fr).AddCosDistanceWithShiftNegGradientOf(GradientFor(fr), ValueFor(fr), Input(0)->ValueFor(fr), Input(1)->ValueFor(fr),
+                                                                               *m_invNorm0, *m_invNorm1, 0, inputIndex == 1);
     }
 
     virtual void /*ComputationNode::*/ ForwardProp(const FrameRange& fr) override
     {
-        Matrix<ElemType> sliceInput0Value = Input(0)->ValueFor(fr);
-        Matrix<ElemType> sliceInput1Value = Input(1)->ValueFor(fr);
-        Matrix<ElemType> sliceOutputValue = ValueFor(fr);
-
-        m_invNorm0->AssignVectorNorm2Of(sliceInput0Value, true);
-        m_invNorm0->AssignElementInverseOf(*m_invNorm0);
-
-        m_invNorm1->AssignVectorNorm2Of(sliceInput1Value, true);
-        m_invNorm1->AssignElementInverseOf(*m_invNorm1);
-
-        sliceOutputValue.AssignInnerProductOf(sliceInput0Value, sliceInput1Value, true);
-        sliceOutputValue.ElementMultiplyWith(*m_invNorm0);
-        sliceOutputValue.ElementMultiplyWith(*m_invNorm1);
-        // TODO: This formulation above would allow to use the TensorView lib for this, with automatic broadcasting.
+        // the norms and the dot products in one pass over the columns
+        ValueFor(fr).AssignCosDistanceWithShiftNegOf(Input(0)->ValueFor(fr), Input(1)->ValueFor(fr), 0, 0, *m_invNorm0, *m_invNorm1);
     }
 
     virtual void /*ComputationNodeBase::*/ Validate(bool isFinalValidationPass) override
@@ -924,9 +1116,6 @@ public:
             auto node = dynamic_pointer_cast<CosDistanceNode<ElemType>>(nodeP);
             *node->m_invNorm0 = *m_invNorm0;
             *node->m_invNorm1 = *m_invNorm1;
-            *node->m_leftTerm = *m_leftTerm;
-            *node->m_rightTerm = *m_rightTerm;
-            *node->m_temp = *m_temp;
         }
     }
     // request matrices needed to do node function value evaluation
@@ -937,34 +1126,18 @@ public:
         RequestMatrixFromPool(m_invNorm1, matrixPool);
     }
 
-    // request matrices that are needed for gradient computation
-    virtual void RequestMatricesBeforeBackprop(MatrixPool& matrixPool)
-    {
-        Base::RequestMatricesBeforeBackprop(matrixPool);
-        RequestMatrixFromPool(m_leftTerm, matrixPool);
-        RequestMatrixFromPool(m_rightTerm, matrixPool);
-        RequestMatrixFromPool(m_temp, matrixPool);
-    }
-
     // release gradient and temp matrices that no longer needed after all the children's gradients are computed.
     virtual void ReleaseMatricesAfterBackprop(MatrixPool& matrixPool)
     {
         Base::ReleaseMatricesAfterBackprop(matrixPool);
         ReleaseMatrixToPool(m_invNorm0, matrixPool);
         ReleaseMatrixToPool(m_invNorm1, matrixPool);
-        ReleaseMatrixToPool(m_leftTerm, matrixPool);
-        ReleaseMatrixToPool(m_rightTerm, matrixPool);
-        ReleaseMatrixToPool(m_temp, matrixPool);
     }
 
 private:
     // invNorm nodes tranfer data between ForwardProp and BackpropTo
     shared_ptr<Matrix<ElemType>> m_invNorm0;
     shared_ptr<Matrix<ElemType>> m_invNorm1;
-    // the rest are temporaries, values don't need to be maintained
-    shared_ptr<Matrix<ElemType>> m_leftTerm;
-    shared_ptr<Matrix<ElemType>> m_rightTerm;
-    shared_ptr<Matrix<ElemType>> m_temp;
 };
 
 template class CosDistanceNode<float>;
@@ -1071,147 +1244,21 @@ public:
 
     virtual void /*ComputationNode::*/ BackpropTo(const size_t inputIndex, const FrameRange& fr) override
     {
-        Matrix<ElemType> sliceInput0Value = Input(0)->ValueFor(fr);
-        Matrix<ElemType> sliceInput1Value = Input(1)->ValueFor(fr);
-        Matrix<ElemType> sliceOutputValue = ValueFor(fr);
-        Matrix<ElemType> sliceInputGrad = Input(inputIndex)->GradientFor(fr);
-        Matrix<ElemType> sliceThisGrad = GradientFor(fr);
-
-        BackpropToS(inputIndex, *m_invNorm0, *m_invNorm1, sliceOutputValue, *m_temp, *m_rightTerm, *m_leftTerm, *m_invNormSquare, sliceInput0Value, sliceInput1Value, Input(2)->Value(), Input(3)->Value(), sliceInputGrad, sliceThisGrad);
-    }
-
-    // functionValues, invNorm0, invNorm1 - output from the EvaluateNode() method
-    // temp, rightTerm, leftTerm - temporary matrices
-    // in0, in1, in2, in3 - input functionValues from other nodes
-    // inputGradientValues(x) - gradients to update, where x matches inputIndex
-    /*TODO: merge with call site*/ void BackpropToS(const size_t inputIndex, const Matrix<ElemType>& invNorm0, const Matrix<ElemType>& invNorm1, const Matrix<ElemType>& functionValues,
-                                                    Matrix<ElemType>& temp, Matrix<ElemType>& rightTerm, Matrix<ElemType>& leftTerm, Matrix<ElemType>& invNormSquare, // the temporary variables
-                                                    const Matrix<ElemType>& in0, const Matrix<ElemType>& in1, const Matrix<ElemType>& in2, const Matrix<ElemType>& in3,
-                                                    Matrix<ElemType>& inputGradientValues, Matrix<ElemType>& thisGradientValues)
-    {
-        size_t shift = (size_t) in2.Get00Element();
-        size_t negNumber = (size_t) in3.Get00Element();
-        size_t numCols = in0.GetNumCols(); // used in computing right child's graident
-
-        if (inputIndex == 0) // left derivative
-        {
-            invNormSquare.AssignElementProductOf(invNorm0, invNorm0);
-
-            for (long m = 0; m < negNumber + 1; m++)
-            {
-                temp.GetARowByIndex(functionValues, m); // set this matrx to be the m-th row in functionValues
-                temp.ElementMultiplyWith(invNormSquare);
-
-                Matrix<ElemType>::ConductRowElementMultiplyWithShift(temp, in0, rightTerm, 0, true);
-
-                if (m == 0)
-                {
-                    temp.AssignElementProductOf(invNorm0, invNorm1);
-
-                    Matrix<ElemType>::ConductRowElementMultiplyWithShift(temp, in1, leftTerm, 0, true);
-                }
-                else
-                {
-                    size_t currshift = m + shift - 1; // for current line, how much should we shift
-
-                    temp.AssignElementProductOfWithShift(invNorm0, invNorm1, currshift); // this is a row vector
-
-                    Matrix<ElemType>::ConductRowElementMultiplyWithShift(temp, in1, leftTerm, currshift, true);
-                }
-
-                leftTerm = leftTerm - rightTerm;
-
-                temp.GetARowByIndex(thisGradientValues, m);
-
-                Matrix<ElemType>::ConductRowElementMultiplyWithShift(temp, leftTerm, rightTerm, 0, true);
-
-                inputGradientValues += rightTerm;
-            }
-        }
-        else // right part
-        {
-            invNormSquare.AssignElementProductOf(invNorm1, invNorm1); // this matrix should be save and unchanged. It should not be changed
-
-            for (long m = 0; m < negNumber + 1; m++)
-            {
-                temp.GetARowByIndex(functionValues, m); // set this matrx to be the m-th row in functionValues
-
-                if (m == 0) // this is the first line. computation should be symmetric
-                {
-                    // the following is for the right part
-                    temp.ElementMultiplyWith(invNormSquare);
-
-                    Matrix<ElemType>::ConductRowElementMultiplyWithShift(temp, in1, rightTerm, 0, true);
-
-                    // the following is for the left part
-                    temp.AssignElementProductOf(invNorm0, invNorm1);
-
-                    Matrix<ElemType>::ConductRowElementMultiplyWithShift(temp, in0, leftTerm, 0, true);
-
-                    leftTerm = leftTerm - rightTerm;
-
-                    temp.GetARowByIndex(thisGradientValues, m);
-
-                    Matrix<ElemType>::ConductRowElementMultiplyWithShift(temp, leftTerm, rightTerm, 0, true);
-
-                    inputGradientValues += rightTerm;
-                }
-                else // this requires shift
-                {
-                    size_t currshift = (m + shift - 1) % numCols;
-                    size_t reverseshift = numCols - currshift;
-
-                    leftTerm.AssignElementProductOfWithShift(invNormSquare, temp, reverseshift); // use leftTerm as a temp variable here
-
-                    Matrix<ElemType>::ConductRowElementMultiplyWithShift(leftTerm, in1, rightTerm, 0, true);
-
-                    temp.AssignElementProductOfWithShift(invNorm1, invNorm0, reverseshift);
-
-                    Matrix<ElemType>::ConductRowElementMultiplyWithShift(temp, in0, leftTerm, reverseshift, true);
-
-                    leftTerm = leftTerm - rightTerm;
-
-                    temp.GetARowByIndex(thisGradientValues, m);
-
-                    Matrix<ElemType>::ConductRowElementMultiplyWithShift(temp, leftTerm, rightTerm, reverseshift, false);
-
-                    inputGradientValues += rightTerm;
-                }
-            }
-        }
+        // invNorm0, invNorm1 - output from ForwardProp()
+        // Each column of the input gradient collects the negNumber + 1 pairs it is part of, so no temporaries are needed.
+        size_t shift = (size_t) Input(2)->Get00Element();
+        Input(inputIndex)->GradientFor(fr).AddCosDistanceWithShiftNegGradientOf(GradientFor(fr), ValueFor(fr), Input(0)->ValueFor(fr), Input(1)->ValueFor(fr),
+                                                                               *m_invNorm0, *m_invNorm1, shift, inputIndex == 1);
     }
 
     virtual void /*ComputationNode::*/ ForwardProp(const FrameRange& fr) override
     {
-        Matrix<ElemType> sliceInput0Value = Input(0)->ValueFor(fr);
-        Matrix<ElemType> sliceInput1Value = Input(1)->ValueFor(fr);
-        Matrix<ElemType> sliceOutputValue = ValueFor(fr);
-
-        ForwardPropS(*m_invNorm0, *m_invNorm1, sliceOutputValue, sliceInput0Value, sliceInput1Value, Input(2)->Value(), Input(3)->Value(), *m_leftTerm, *m_rightTerm);
-    }
-
-    /*TODO: merge with call site*/ void ForwardPropS(Matrix<ElemType>& invNorm0, Matrix<ElemType>& invNorm1, Matrix<ElemType>& functionValues, Matrix<ElemType>& in0, Matrix<ElemType>& in1, Matrix<ElemType>& in2, Matrix<ElemType>& in3, Matrix<ElemType>& leftTermTemp, Matrix<ElemType>& rightTermTemp)
-    {
-        invNorm0.AssignVectorNorm2Of(in0, true); // seems to modify input (in0)
-        invNorm0.AssignElementInverseOf(invNorm0);
-
-        invNorm1.AssignVectorNorm2Of(in1, true); // seems to modify the input (in1)
-        invNorm1.AssignElementInverseOf(invNorm1);
-
-        size_t shift = (size_t) in2.Get00Element();
-        size_t negNumber = (size_t) in3.Get00Element();
-
-        // mutiply invNorm0 and invNorm1 with shift and neg.
-        // The result is a matrix of (numberneg+1, invNorm0.Cols)
-        leftTermTemp.AssignElementProductOfWithShiftNeg(invNorm0, invNorm1, shift, negNumber);
-
-        // compute the right values
-        // Again, the output is a matrix of (negNumber+1, invNorm0.cols)
-        rightTermTemp.AssignInnerProductOfWithShiftNeg(in0, in1, true, shift, negNumber);
+        size_t shift = (size_t) Input(2)->Get00Element();
+        size_t negNumber = (size_t) Input(3)->Get00Element();
 
-        // compute the evaluation result matrix by multiply these two matrices, element by element
-        // we get a (negNumber+1, n) matrix
-        functionValues.AssignElementProductOf(leftTermTemp, rightTermTemp);
+        // a (negNumber+1, n) matrix: row 0 pairs each left column with its right column, row m with the right column shifted by shift + m - 1;
+        // the norms, dot products and shifts are computed in one pass over the columns
+        ValueFor(fr).AssignCosDistanceWithShiftNegOf(Input(0)->ValueFor(fr), Input(1)->ValueFor(fr), shift, negNumber, *m_invNorm0, *m_invNorm1);
     }
 
     virtual void /*ComputationNodeBase::*/ Validate(bool isFinalValidationPass) override
@@ -1242,10 +1289,6 @@ public:
             auto node = dynamic_pointer_cast<CosDistanceWithNegativeSamplesNode<ElemType>>(nodeP);
             *node->m_invNorm0 = *m_invNorm0;
             *node->m_invNorm1 = *m_invNorm1;
-            *node->m_invNormSquare = *m_invNormSquare;
-            *node->m_leftTerm = *m_leftTerm;
-            *node->m_rightTerm = *m_rightTerm;
-            *node->m_temp = *m_temp;
         }
     }
     // request matrices needed to do node function value evaluation
@@ -1254,16 +1297,6 @@ public:
         Base::RequestMatricesBeforeForwardProp(matrixPool);
         RequestMatrixFromPool(m_invNorm0, matrixPool);
         RequestMatrixFromPool(m_invNorm1, matrixPool);
-        RequestMatrixFromPool(m_leftTerm, matrixPool);
-        RequestMatrixFromPool(m_rightTerm, matrixPool);
-    }
-
-    // request matrices that are needed for gradient computation
-    virtual void RequestMatricesBeforeBackprop(MatrixPool& matrixPool)
-    {
-        Base::RequestMatricesBeforeBackprop(matrixPool);
-        RequestMatrixFromPool(m_invNormSquare, matrixPool);
-        RequestMatrixFromPool(m_temp, matrixPool);
     }
 
     // release gradient and temp matrices that no longer needed after all the children's gradients are computed.
@@ -1272,24 +1305,317 @@ public:
         Base::ReleaseMatricesAfterBackprop(matrixPool);
         ReleaseMatrixToPool(m_invNorm0, matrixPool);
         ReleaseMatrixToPool(m_invNorm1, matrixPool);
-        ReleaseMatrixToPool(m_leftTerm, matrixPool);
-        ReleaseMatrixToPool(m_rightTerm, matrixPool);
-        ReleaseMatrixToPool(m_invNormSquare, matrixPool);
-        ReleaseMatrixToPool(m_temp, matrixPool);
     }
 
 private:
     // invNorm nodes tranfer data between ForwardProp and BackpropTo
     shared_ptr<Matrix<ElemType>> m_invNorm0;
     shared_ptr<Matrix<ElemType>> m_invNorm1;
-    shared_ptr<Matrix<ElemType>> m_leftTerm;
-    shared_ptr<Matrix<ElemType>> m_rightTerm;
-    // the rest are temporaries, values don't need to be maintained
-    shared_ptr<Matrix<ElemType>> m_invNormSquare;
-    shared_ptr<Matrix<ElemType>> m_temp;
 };
 
 template class CosDistanceWithNegativeSamplesNode<float>;
 template class CosDistanceWithNegativeSamplesNode<double>;
 
+// -----------------------------------------------------------------------
+// ScaledDotProductAttentionNode (query, key, value)
+// attention over sequences: softmax(key' * query / sqrt(d)) of each query frame weights the value frames of its sequence
+//  - query: [d x *q], e.g. the decoder states
+//  - key: [d x *k] and value: [dv x *k], with the same layout, e.g. the encoder states (or query == key == value)
+//  - output: [dv x *q], in the layout of the query
+// A query sequence attends to the key sequence with the same sequence id (the same sequence, where the layouts are the
+// same). The frames of each sequence are gathered into padded blocks, so that the products of all sequences are one
+// batched GEMM each, and the padded keys are masked in the softmax, which is fused with the scaling. The sequences are
+// processed in chunks of at most MaxScoresPerChunk scores, and the attention weights are not kept but recomputed in
+// the backward pass. As it attends over whole sequences, this node cannot be in a recurrent loop, and every sequence
+// must lie entirely in its minibatch (no truncated BPTT).
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+class ScaledDotProductAttentionNode : public ComputationNodeNonLooping /*ComputationNode*/<ElemType>, public NumInputs<3>
+{
+    typedef ComputationNodeNonLooping<ElemType> Base;
+    UsingComputationNodeMembersBoilerplate;
+    static const std::wstring TypeName()
+    {
+        return L"ScaledDotProductAttention";
+    }
+
+    static const size_t MaxScoresPerChunk = 16 * 1024 * 1024; // elements of the [keys x queries] weights held at a time
+
+public:
+    ScaledDotProductAttentionNode(DEVICEID_TYPE deviceId, const wstring& name)
+        : Base(deviceId, name),
+          m_queryIndex(deviceId),
+          m_keyIndex(deviceId),
+          m_numValidKeys(deviceId),
+          m_numSequences(0),
+          m_maxQueries(0),
+          m_maxKeys(0),
+          m_needRecomputeGradients(false)
+    {
+    }
+    ScaledDotProductAttentionNode(const ScriptableObjects::IConfigRecordPtr configp)
+        : ScaledDotProductAttentionNode(configp->Get(L"deviceId"), L"<placeholder>")
+    {
+        AttachInputs(configp, this->GetExpectedNumInputs());
+    }
+
+    virtual void BackpropToNonLooping(size_t inputIndex) override
+    {
+        FrameRange fr(Input(inputIndex)->GetMBLayout());
+        if (m_needRecomputeGradients)
+            ComputeGatheredGradients();
+        if (m_numSequences == 0)
+            return;
+
+        const auto& index = inputIndex == 0 ? m_queryIndex : m_keyIndex;
+        const auto& gradient = inputIndex == 0 ? *m_queryGradient : inputIndex == 1 ? *m_keyGradient : *m_valueGradient;
+        Input(inputIndex)->GradientFor(fr).DoScatterColumnsOf(1, index, gradient, 1);
+    }
+
+    // the gradients use the gathered inputs of the forward pass
+    virtual bool OutputUsedInComputingInputNodesGradients() const override { return false; }
+    virtual bool InputUsedInComputingInputNodesGradients(size_t /*childIndex*/) const override { return false; }
+
+    virtual void /*ComputationNodeNonLooping::*/ ForwardPropNonLooping() override
+    {
+        FrameRange fr(Input(0)->GetMBLayout());
+        SetSequenceIndices();
+        m_needRecomputeGradients = true;
+        if (m_numSequences == 0)
+        {
+            Value().SetValue(0);
+            return;
+        }
+
+        m_gatheredQuery->DoGatherColumnsOf(0, m_queryIndex, Input(0)->ValueFor(fr), 1);
+        m_gatheredKey->DoGatherColumnsOf(0, m_keyIndex, Input(1)->ValueFor(FrameRange(Input(1)->GetMBLayout())), 1);
+        m_gatheredValue->DoGatherColumnsOf(0, m_keyIndex, Input(2)->ValueFor(FrameRange(Input(2)->GetMBLayout())), 1);
+
+        m_output->Resize(m_gatheredValue->GetNumRows(), m_maxQueries * m_numSequences);
+        const size_t sequencesPerChunk = GetSequencesPerChunk();
+        for (size_t n = 0; n < m_numSequences; n += sequencesPerChunk)
+        {
+            const size_t numChunkSequences = min(sequencesPerChunk, m_numSequences - n);
+            ComputeAttentionWeights(n, numChunkSequences);
+            auto output = m_output->ColumnSlice(n * m_maxQueries, numChunkSequences * m_maxQueries);
+            Matrix<ElemType>::BatchedMultiplyAndWeightedAdd(1, m_gatheredValue->ColumnSlice(n * m_maxKeys, numChunkSequences * m_maxKeys), false, *m_weights, false, 0, output, numChunkSequences);
+        }
+        Value().DoScatterColumnsOf(0, m_queryIndex, *m_output, 1); // (the gaps become 0)
+    }
+
+    // the sequences are matched on the host
+    virtual bool /*ComputationNodeBase::*/ IsGraphCapturable() const override { return false; }
+
+    virtual void /*ComputationNodeBase::*/ Validate(bool isFinalValidationPass) override
+    {
+        Base::Validate(isFinalValidationPass);
+        m_pMBLayout = Input(0)->GetMBLayout();
+
+        if (isFinalValidationPass)
+        {
+            if (!Input(0)->HasMBLayout() || !Input(1)->HasMBLayout() || Input(1)->GetMBLayout() != Input(2)->GetMBLayout())
+                LogicError("%ls %ls operation requires the query, key and value to be minibatches, with the same layout for key and value.", NodeName().c_str(), OperationName().c_str());
+            if (Input(0)->GetSampleMatrixNumRows() != Input(1)->GetSampleMatrixNumRows())
+                InvalidArgument("%ls %ls operation: The dimension of the query (%d) does not match that of the key (%d).", NodeName().c_str(), OperationName().c_str(),
+                                (int) Input(0)->GetSampleMatrixNumRows(), (int) Input(1)->GetSampleMatrixNumRows());
+        }
+
+        SetDims(TensorShape(Input(2)->GetSampleMatrixNumRows()), HasMBLayout());
+    }
+
+    // the two products of each query frame with the keys and values of its sequence
+    virtual double EstimateForwardFlops() const override
+    {
+        return 2.0 * (Input(1)->GetSampleMatrixNumRows() + Input(2)->GetSampleMatrixNumRows()) * m_maxKeys * m_maxQueries * m_numSequences;
+    }
+
+    virtual void RequestMatricesBeforeForwardProp(MatrixPool& matrixPool) override
+    {
+        Base::RequestMatricesBeforeForwardProp(matrixPool);
+        RequestMatrixFromPool(m_gatheredQuery, matrixPool);
+        RequestMatrixFromPool(m_gatheredKey, matrixPool);
+        RequestMatrixFromPool(m_gatheredValue, matrixPool);
+        RequestMatrixFromPool(m_scores, matrixPool);
+        RequestMatrixFromPool(m_weights, matrixPool);
+        RequestMatrixFromPool(m_output, matrixPool);
+    }
+
+    virtual void RequestMatricesBeforeBackprop(MatrixPool& matrixPool) override
+    {
+        Base::RequestMatricesBeforeBackprop(matrixPool);
+        RequestMatrixFromPool(m_outputGradient, matrixPool);
+        RequestMatrixFromPool(m_weightsGradient, matrixPool);
+        RequestMatrixFromPool(m_columnSums, matrixPool);
+        RequestMatrixFromPool(m_queryGradient, matrixPool);
+        RequestMatrixFromPool(m_keyGradient, matrixPool);
+        RequestMatrixFromPool(m_valueGradient, matrixPool);
+    }
+
+    virtual void ReleaseMatricesAfterBackprop(MatrixPool& matrixPool) override
+    {
+        Base::ReleaseMatricesAfterBackprop(matrixPool);
+        ReleaseMatrixToPool(m_gatheredQuery, matrixPool);
+        ReleaseMatrixToPool(m_gatheredKey, matrixPool);
+        ReleaseMatrixToPool(m_gatheredValue, matrixPool);
+        ReleaseMatrixToPool(m_scores, matrixPool);
+        ReleaseMatrixToPool(m_weights, matrixPool);
+        ReleaseMatrixToPool(m_output, matrixPool);
+        ReleaseMatrixToPool(m_outputGradient, matrixPool);
+        ReleaseMatrixToPool(m_weightsGradient, matrixPool);
+        ReleaseMatrixToPool(m_columnSums, matrixPool);
+        ReleaseMatrixToPool(m_queryGradient, matrixPool);
+        ReleaseMatrixToPool(m_keyGradient, matrixPool);
+        ReleaseMatrixToPool(m_valueGradient, matrixPool);
+    }
+
+private:
+    // matches the query sequences to the key sequences, and sets the gather indices of the padded blocks:
+    // column t of block n is frame t of sequence n, or -1 (a padding column)
+    void SetSequenceIndices()
+    {
+        const auto& queryLayout = Input(0)->GetMBLayout();
+        const auto& keyLayout = Input(1)->GetMBLayout();
+        std::map<UniqueSequenceId, const MBLayout::SequenceInfo*> keySequences;
+        for (const auto& seq : keyLayout->GetAllSequences())
+        {
+            if (seq.seqId == GAP_SEQUENCE_ID)
+                continue;
+            if (seq.tBegin < 0 || seq.tEnd > keyLayout->GetNumTimeSteps())
+                InvalidArgument("%ls %ls operation requires each sequence to be entirely in its minibatch, truncated sequences are not supported.", NodeName().c_str(), OperationName().c_str());
+            keySequences[seq.seqId] = &seq;
+        }
+        std::vector<std::pair<const MBLayout::SequenceInfo*, const MBLayout::SequenceInfo*>> sequences;
+        m_maxQueries = m_maxKeys = 0;
+        for (const auto& seq : queryLayout->GetAllSequences())
+        {
+            if (seq.seqId == GAP_SEQUENCE_ID)
+                continue;
+            if (seq.tBegin < 0 || seq.tEnd > queryLayout->GetNumTimeSteps())
+                InvalidArgument("%ls %ls operation requires each sequence to be entirely in its minibatch, truncated sequences are not supported.", NodeName().c_str(), OperationName().c_str());
+            auto keySeq = keySequences.find(seq.seqId);
+            if (keySeq == keySequences.end())
+                InvalidArgument("%ls %ls operation: The query sequence %d has no key sequence.", NodeName().c_str(), OperationName().c_str(), (int) seq.seqId);
+            sequences.push_back(make_pair(&seq, keySeq->second));
+            m_maxQueries = max(m_maxQueries, seq.GetNumTimeSteps());
+            m_maxKeys = max(m_maxKeys, keySeq->second->GetNumTimeSteps());
+        }
+        m_numSequences = sequences.size();
+        if (m_numSequences == 0)
+            return;
+
+        std::vector<ElemType> queryIndex(m_maxQueries * m_numSequences, -1), keyIndex(m_maxKeys * m_numSequences, -1), numValidKeys(m_maxQueries * m_numSequences, 0);
+        for (size_t n = 0; n < m_numSequences; n++)
+        {
+            const auto& query = *sequences[n].first;
+            const auto& key = *sequences[n].second;
+            for (size_t t = 0; t < query.GetNumTimeSteps(); t++)
+            {
+                queryIndex[n * m_maxQueries + t] = (ElemType) ((query.tBegin + t) * queryLayout->GetNumParallelSequences() + query.s);
+                numValidKeys[n * m_maxQueries + t] = (ElemType) key.GetNumTimeSteps();
+            }
+            for (size_t t = 0; t < key.GetNumTimeSteps(); t++)
+                keyIndex[n * m_maxKeys + t] = (ElemType) ((key.tBegin + t) * keyLayout->GetNumParallelSequences() + key.s);
+        }
+        m_queryIndex.SetValue(1, queryIndex.size(), m_deviceId, queryIndex.data());
+        m_keyIndex.SetValue(1, keyIndex.size(), m_deviceId, keyIndex.data());
+        m_numValidKeys.SetValue(1, numValidKeys.size(), m_deviceId, numValidKeys.data());
+    }
+
+    size_t GetSequencesPerChunk() const
+    {
+        return max((size_t) 1, MaxScoresPerChunk / max((size_t) 1, m_maxKeys * m_maxQueries));
+    }
+
+    // m_weights = the masked softmax of the scaled scores of the chunk of sequences [n, n + numChunkSequences)
+    void ComputeAttentionWeights(size_t n, size_t numChunkSequences)
+    {
+        const ElemType scale = (ElemType) (1 / sqrt((double) Input(0)->GetSampleMatrixNumRows()));
+        Matrix<ElemType>::BatchedMultiplyAndWeightedAdd(1, m_gatheredKey->ColumnSlice(n * m_maxKeys, numChunkSequences * m_maxKeys), true,
+                                                        m_gatheredQuery->ColumnSlice(n * m_maxQueries, numChunkSequences * m_maxQueries), false, 0, *m_scores, numChunkSequences);
+        m_weights->AssignMaskedSoftmaxOf(*m_scores, scale, m_numValidKeys.ColumnSlice(n * m_maxQueries, numChunkSequences * m_maxQueries));
+    }
+
+    // the gradients of the gathered inputs that need one, recomputing the attention weights chunk by chunk
+    void ComputeGatheredGradients()
+    {
+        m_needRecomputeGradients = false;
+        if (m_numSequences == 0)
+            return;
+
+        const bool queryNeedsGradient = Input(0)->NeedsGradient(), keyNeedsGradient = Input(1)->NeedsGradient(), valueNeedsGradient = Input(2)->NeedsGradient();
+        const ElemType scale = (ElemType) (1 / sqrt((double) Input(0)->GetSampleMatrixNumRows()));
+        m_outputGradient->DoGatherColumnsOf(0, m_queryIndex, Gradient(), 1);
+        if (queryNeedsGradient)
+            m_queryGradient->Resize(m_gatheredQuery->GetNumRows(), m_maxQueries * m_numSequences);
+        if (keyNeedsGradient)
+            m_keyGradient->Resize(m_gatheredKey->GetNumRows(), m_maxKeys * m_numSequences);
+        if (valueNeedsGradient)
+            m_valueGradient->Resize(m_gatheredValue->GetNumRows(), m_maxKeys * m_numSequences);
+
+        const size_t sequencesPerChunk = GetSequencesPerChunk();
+        for (size_t n = 0; n < m_numSequences; n += sequencesPerChunk)
+        {
+            const size_t numChunkSequences = min(sequencesPerChunk, m_numSequences - n);
+            const size_t queryBegin = n * m_maxQueries, numChunkQueries = numChunkSequences * m_maxQueries;
+            const size_t keyBegin = n * m_maxKeys, numChunkKeys = numChunkSequences * m_maxKeys;
+            ComputeAttentionWeights(n, numChunkSequences);
+            auto outputGradient = m_outputGradient->ColumnSlice(queryBegin, numChunkQueries);
+
+            // value: outputGradient * weights'
+            if (valueNeedsGradient)
+            {
+                auto valueGradient = m_valueGradient->ColumnSlice(keyBegin, numChunkKeys);
+                Matrix<ElemType>::BatchedMultiplyAndWeightedAdd(1, outputGradient, false, *m_weights, true, 0, valueGradient, numChunkSequences);
+            }
+            if (!queryNeedsGradient && !keyNeedsGradient)
+                continue;
+
+            // scores: the softmax gradient of value' * outputGradient, which is 0 where the weights are (the masked keys)
+            Matrix<ElemType>::BatchedMultiplyAndWeightedAdd(1, m_gatheredValue->ColumnSlice(keyBegin, numChunkKeys), true, outputGradient, false, 0, *m_weightsGradient, numChunkSequences);
+            m_columnSums->AssignInnerProductOf(*m_weightsGradient, *m_weights, true);
+            m_weightsGradient->AssignDifferenceOf(*m_weightsGradient, *m_columnSums);
+            m_weightsGradient->ElementMultiplyWith(*m_weights);
+
+            // query: key * scoresGradient, key: query * scoresGradient', both scaled
+            if (queryNeedsGradient)
+            {
+                auto queryGradient = m_queryGradient->ColumnSlice(queryBegin, numChunkQueries);
+                Matrix<ElemType>::BatchedMultiplyAndWeightedAdd(scale, m_gatheredKey->ColumnSlice(keyBegin, numChunkKeys), false, *m_weightsGradient, false, 0, queryGradient, numChunkSequences);
+            }
+            if (keyNeedsGradient)
+            {
+                auto keyGradient = m_keyGradient->ColumnSlice(keyBegin, numChunkKeys);
+                Matrix<ElemType>::BatchedMultiplyAndWeightedAdd(scale, m_gatheredQuery->ColumnSlice(queryBegin, numChunkQueries), false, *m_weightsGradient, true, 0, keyGradient, numChunkSequences);
+            }
+        }
+    }
+
+    Matrix<ElemType> m_queryIndex;   // [1 x Tq*N] query column of each padded query frame, or -1
+    Matrix<ElemType> m_keyIndex;     // [1 x Tk*N] key column of each padded key frame, or -1
+    Matrix<ElemType> m_numValidKeys; // [1 x Tq*N] number of keys of the sequence of each padded query frame (0 for padding)
+    size_t m_numSequences;           // N
+    size_t m_maxQueries;             // Tq, the longest query sequence
+    size_t m_maxKeys;                // Tk, the longest key sequence
+    bool m_needRecomputeGradients;
+
+    // gathered inputs, kept for the backward pass
+    shared_ptr<Matrix<ElemType>> m_gatheredQuery; // [d x Tq*N]
+    shared_ptr<Matrix<ElemType>> m_gatheredKey;   // [d x Tk*N]
+    shared_ptr<Matrix<ElemType>> m_gatheredValue; // [dv x Tk*N]
+    // the rest are temporaries
+    shared_ptr<Matrix<ElemType>> m_scores;          // [Tk x Tq*chunk]
+    shared_ptr<Matrix<ElemType>> m_weights;         // [Tk x Tq*chunk]
+    shared_ptr<Matrix<ElemType>> m_output;          // [dv x Tq*N]
+    shared_ptr<Matrix<ElemType>> m_outputGradient;  // [dv x Tq*N]
+    shared_ptr<Matrix<ElemType>> m_weightsGradient; // [Tk x Tq*chunk]
+    shared_ptr<Matrix<ElemType>> m_columnSums;      // [1 x Tq*chunk]
+    shared_ptr<Matrix<ElemType>> m_queryGradient;   // [d x Tq*N]
+    shared_ptr<Matrix<ElemType>> m_keyGradient;     // [d x Tk*N]
+    shared_ptr<Matrix<ElemType>> m_valueGradient;   // [dv x Tk*N]
+};
+
+template class ScaledDotProductAttentionNode<float>;
+template class ScaledDotProductAttentionNode<double>;
+
 }}}
@@ -9,6 +9,7 @@
 #include <stdexcept>
 #include <vector>
 #include <algorithm>
+#include <map>
 #include <stdlib.h>
 
 #include "Basics.h"
@@ -17,52 +18,303 @@
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
+// -----------------------------------------------------------------------
+// MatrixPool -- plans the sharing of node matrices across the network
+//
+// ComputationNetwork::AllocateAllMatrices() simulates forward and backward
+// propagation in evaluation order, during which nodes Request() the matrices
+// they need and Release() them once they are no longer used. Rather than
+// handing out buffers on the fly, the pool records the live interval
+// [request step, release step] and the expected size of each request.
+// OptimizedMemoryAllocation() then assigns requests to physical matrices
+// such that no two requests with overlapping live intervals share one,
+// packing larger requests first and putting each into the smallest-fitting
+// existing matrix (best-fit interval packing). This way, buffers are not
+// resized back and forth as they would be with plain LIFO reuse, and the
+// total memory is close to the peak of simultaneously live data.
+//
+// Sizes are estimated from the node's sample layout. Requests from nodes
+// with an MBLayout scale with the minibatch size; for packing decisions those
+// are compared at a nominal minibatch size (s_nominalMBSize).
+//
+// If the network runs on several compute streams, matrices are only shared
+// among the requests of the same stream, since their order of use on the
+// device is only known within a stream.
+//
+// A value that is recomputed in backprop (gradient checkpointing) is live
+// twice: Reacquire() opens a second interval for an already released
+// request, and both intervals then belong to the same matrix.
+//
+// A node that computes its value in place (see
+// ComputationNodeBase::CanComputeValueInPlace()) joins the request of its
+// input through RequestInPlace(). The request then has several holders and
+// its interval only ends when the last of them releases it.
+// -----------------------------------------------------------------------
+
 class MatrixPool
 {
-    vector<shared_ptr<Matrix<float>>> m_releasedFloatMatrices;
-    vector<shared_ptr<Matrix<double>>> m_releasedDoubleMatrices;
+    // a single matrix request recorded during the simulation
+    template <class ElemType>
+    struct MemRequestInfo
+    {
+        vector<shared_ptr<Matrix<ElemType>>*> m_pMatrixPtrs; // node members that will receive the shared matrix
+        size_t m_numHolders; // number of those members that have not released the matrix yet
+        DEVICEID_TYPE m_deviceId;
+        size_t m_stream;   // compute stream of the requesting node
+        size_t m_numRows;  // elements per column
+        size_t m_numCols;  // number of columns, or 0 if the matrix scales with the minibatch size
+        vector<pair<size_t, size_t>> m_liveIntervals; // [step at which the matrix is requested, step at which it is released (SIZE_MAX if never)]
+
+        size_t GetNumElements(size_t mbSize) const
+        {
+            return m_numRows * (m_numCols == 0 ? mbSize : m_numCols);
+        }
+        bool Overlaps(const MemRequestInfo& other) const
+        {
+            for (const auto& interval : m_liveIntervals)
+                for (const auto& otherInterval : other.m_liveIntervals)
+                    if (interval.first <= otherInterval.second && otherInterval.first <= interval.second)
+                        return true;
+            return false;
+        }
+    };
+
+    // a physical matrix and the requests mapped onto it
+    struct SharedBufferInfo
+    {
+        DEVICEID_TYPE m_deviceId;
+        size_t m_stream;
+        size_t m_elemSize;
+        vector<pair<size_t, size_t>> m_sizes; // [numRows, numCols/0] of all requests assigned to it
+        vector<size_t> m_requestIndices;
+
+        size_t GetNumElements(size_t mbSize) const
+        {
+            size_t numElements = 0;
+            for (const auto& size : m_sizes)
+                numElements = max(numElements, size.first * (size.second == 0 ? mbSize : size.second));
+            return numElements;
+        }
+    };
+
+    vector<MemRequestInfo<float>> m_memRequestInfoFloatVec;
+    vector<MemRequestInfo<double>> m_memRequestInfoDoubleVec;
+    vector<SharedBufferInfo> m_plannedBuffers; // result of the last OptimizedMemoryAllocation(), for reporting
+    size_t m_stepCounter;
+
+    static const size_t s_nominalMBSize = 256;
 
     template <class ElemType>
-    vector<shared_ptr<Matrix<ElemType>>>& GetReleasedMatrices();
+    vector<MemRequestInfo<ElemType>>& GetMemRequestInfoVec();
 
 public:
-    // release here means the matrix can be put back and shared by others
+    MatrixPool()
+        : m_stepCounter(0)
+    {
+    }
+
+    // request a matrix for the given node member
+    // The member receives an empty placeholder now and the actual (possibly shared) matrix upon OptimizedMemoryAllocation().
+    template <class ElemType>
+    void Request(shared_ptr<Matrix<ElemType>>& matrixPtr, DEVICEID_TYPE deviceId, size_t numRows, size_t numCols /*0 = minibatch*/, size_t stream = 0)
+    {
+        if (matrixPtr != nullptr)
+            LogicError("MatrixPool::Request: matrix has already been allocated.");
+        matrixPtr = make_shared<Matrix<ElemType>>(deviceId);
+
+        MemRequestInfo<ElemType> info;
+        info.m_pMatrixPtrs.push_back(&matrixPtr);
+        info.m_numHolders = 1;
+        info.m_deviceId = deviceId;
+        info.m_stream = stream;
+        info.m_numRows = numRows;
+        info.m_numCols = numCols;
+        info.m_liveIntervals.push_back(make_pair(m_stepCounter++, SIZE_MAX));
+        GetMemRequestInfoVec<ElemType>().push_back(info);
+    }
+
+    // request the matrix of another, still live request for the given node member, which then overwrites its content
+    // Returns false if inputMatrixPtr was not requested through the pool in this round or is sparse; the caller should then Request() as usual.
+    template <class ElemType>
+    bool RequestInPlace(shared_ptr<Matrix<ElemType>>& matrixPtr, shared_ptr<Matrix<ElemType>>& inputMatrixPtr)
+    {
+        if (matrixPtr != nullptr)
+            LogicError("MatrixPool::RequestInPlace: matrix has already been allocated.");
+        MemRequestInfo<ElemType>* info = FindRequest(inputMatrixPtr);
+        if (!info || info->m_liveIntervals.back().second != SIZE_MAX || inputMatrixPtr->GetMatrixType() == SPARSE)
+            return false;
+        matrixPtr = inputMatrixPtr; // the same placeholder until OptimizedMemoryAllocation()
+        info->m_pMatrixPtrs.push_back(&matrixPtr);
+        info->m_numHolders++;
+        return true;
+    }
+
+    // request a released matrix again; its content from before the release is not kept
+    template <class ElemType>
+    void Reacquire(shared_ptr<Matrix<ElemType>>& matrixPtr)
+    {
+        MemRequestInfo<ElemType>* info = FindRequest(matrixPtr);
+        // not requested through the pool in this round, so it is not shared and keeps its content anyway
+        if (!info)
+            return;
+        // still live if it was never released, e.g. a sparse matrix
+        if (info->m_liveIntervals.back().second != SIZE_MAX)
+        {
+            info->m_liveIntervals.push_back(make_pair(m_stepCounter++, SIZE_MAX));
+            info->m_numHolders = 1;
+        }
+    }
+
+    // release here means the matrix is no longer used from this step on and can be shared by others
     template <class ElemType>
-    void Release(shared_ptr<Matrix<ElemType>> freeMatrix)
+    void Release(shared_ptr<Matrix<ElemType>>& matrixPtr)
     {
-        vector<shared_ptr<Matrix<ElemType>>>& releasedMatrices = GetReleasedMatrices<ElemType>();
-        if (freeMatrix == nullptr || freeMatrix->GetMatrixType() == SPARSE)
+        if (matrixPtr == nullptr || matrixPtr->GetMatrixType() == SPARSE)
             RuntimeError("MatrixPool::Release: freeMatrix should not be null or sparse.");
+        MemRequestInfo<ElemType>* info = FindRequest(matrixPtr);
+        // Not requested through the pool in this round (e.g. created by CreateMatrixIfNull() or in an earlier
+        // call to AllocateAllMatrices()). It may still be referenced elsewhere, so we do not share it.
+        if (!info)
+            return;
 #ifdef _DEBUG
-        for (int i = 0; i < releasedMatrices.size(); i++)
+        if (info->m_liveIntervals.back().second != SIZE_MAX || info->m_numHolders == 0)
+            RuntimeError("MatrixPool::Release: freeMatrix is already released.");
+#endif
+        // shared in place by several nodes: live until the last of them is done with it
+        if (--info->m_numHolders == 0)
+            info->m_liveIntervals.back().second = m_stepCounter++;
+    }
+
+    // assign all recorded requests to physical matrices and hand them to the nodes
+    void OptimizedMemoryAllocation()
+    {
+        m_plannedBuffers.clear();
+        OptimizedMemoryAllocation(m_memRequestInfoFloatVec);
+        OptimizedMemoryAllocation(m_memRequestInfoDoubleVec);
+        m_memRequestInfoFloatVec.clear();
+        m_memRequestInfoDoubleVec.clear();
+        m_stepCounter = 0;
+    }
+
+    // memory needed by the last plan on a given device, for a given minibatch size
+    size_t GetPlannedPeakMemoryInBytes(DEVICEID_TYPE deviceId, size_t mbSize) const
+    {
+        size_t numBytes = 0;
+        for (const auto& buffer : m_plannedBuffers)
         {
-            if (releasedMatrices[i] == freeMatrix)
-                RuntimeError("MatrixPool::Release: freeMatrix is already in the released pool.");
+            if (buffer.m_deviceId == deviceId)
+                numBytes += buffer.GetNumElements(mbSize) * buffer.m_elemSize;
         }
+        return numBytes;
+    }
 
-#endif
-        releasedMatrices.push_back(freeMatrix);
+    void PrintPlannedMemory() const
+    {
+        map<DEVICEID_TYPE, pair<size_t, size_t>> numBuffersAndRequestsPerDevice;
+        for (const auto& buffer : m_plannedBuffers)
+        {
+            auto& counts = numBuffersAndRequestsPerDevice[buffer.m_deviceId];
+            counts.first++;
+            counts.second += buffer.m_requestIndices.size();
+        }
+        for (const auto& iter : numBuffersAndRequestsPerDevice)
+        {
+            const DEVICEID_TYPE deviceId = iter.first;
+            // linear in the minibatch size, so two points tell the full story
+            const size_t fixedBytes = GetPlannedPeakMemoryInBytes(deviceId, 0);
+            const size_t bytesPerSample = GetPlannedPeakMemoryInBytes(deviceId, 1) - fixedBytes;
+            const size_t nominalBytes = GetPlannedPeakMemoryInBytes(deviceId, s_nominalMBSize);
+            fprintf(stderr, "Memory plan for %s: %d shared matrices for %d requests; planned peak = %.1f KB + %.1f KB per sample (%.1f MB at %d samples per minibatch).\n",
+                    deviceId == CPUDEVICE ? "CPU" : msra::strfun::strprintf("GPU %d", (int) deviceId).c_str(),
+                    (int) iter.second.first, (int) iter.second.second,
+                    fixedBytes / 1024.0, bytesPerSample / 1024.0, nominalBytes / (1024.0 * 1024.0), (int) s_nominalMBSize);
+        }
     }
 
+private:
+    // the request that a node member was registered with, or nullptr
     template <class ElemType>
-    shared_ptr<Matrix<ElemType>> Request(DEVICEID_TYPE deviceId)
+    MemRequestInfo<ElemType>* FindRequest(const shared_ptr<Matrix<ElemType>>& matrixPtr)
     {
-        vector<shared_ptr<Matrix<ElemType>>>& releasedMatrices = GetReleasedMatrices<ElemType>();
-        shared_ptr<Matrix<ElemType>> matrixPtr;
-        if (releasedMatrices.empty())
+        for (auto& info : GetMemRequestInfoVec<ElemType>())
         {
-            matrixPtr = make_shared<Matrix<ElemType>>(deviceId);
+            if (find(info.m_pMatrixPtrs.begin(), info.m_pMatrixPtrs.end(), &matrixPtr) != info.m_pMatrixPtrs.end())
+                return &info;
         }
-        else
+        return nullptr;
+    }
+
+    template <class ElemType>
+    void OptimizedMemoryAllocation(vector<MemRequestInfo<ElemType>>& memRequestInfoVec)
+    {
+        // pack large requests first
+        vector<size_t> order(memRequestInfoVec.size());
+        for (size_t i = 0; i < order.size(); i++)
+            order[i] = i;
+        sort(order.begin(), order.end(), [&memRequestInfoVec](size_t a, size_t b)
+             {
+                 const size_t sizeA = memRequestInfoVec[a].GetNumElements(s_nominalMBSize);
+                 const size_t sizeB = memRequestInfoVec[b].GetNumElements(s_nominalMBSize);
+                 return sizeA != sizeB ? sizeA > sizeB : memRequestInfoVec[a].m_liveIntervals.front().first < memRequestInfoVec[b].m_liveIntervals.front().first;
+             });
+
+        const size_t firstBuffer = m_plannedBuffers.size();
+        for (size_t requestIndex : order)
         {
-            matrixPtr = releasedMatrices.back();
-            releasedMatrices.pop_back();
-        }
+            const auto& request = memRequestInfoVec[requestIndex];
+            const size_t requestSize = request.GetNumElements(s_nominalMBSize);
 
-        if (!matrixPtr) // this can't really happen
-            LogicError("MatrixPool::Request: failed to get a valid matrix.");
+            // find a matrix on the same device and stream that is not live during this request;
+            // prefer the smallest one that fits, otherwise the largest one (which then needs to grow the least)
+            size_t bestBuffer = SIZE_MAX;
+            for (size_t b = firstBuffer; b < m_plannedBuffers.size(); b++)
+            {
+                const auto& buffer = m_plannedBuffers[b];
+                if (buffer.m_deviceId != request.m_deviceId || buffer.m_stream != request.m_stream)
+                    continue;
+                bool isFree = true;
+                for (size_t other : buffer.m_requestIndices)
+                {
+                    if (memRequestInfoVec[other].Overlaps(request))
+                    {
+                        isFree = false;
+                        break;
+                    }
+                }
+                if (!isFree)
+                    continue;
+                if (bestBuffer == SIZE_MAX)
+                {
+                    bestBuffer = b;
+                    continue;
+                }
+                const size_t size = buffer.GetNumElements(s_nominalMBSize);
+                const size_t bestSize = m_plannedBuffers[bestBuffer].GetNumElements(s_nominalMBSize);
+                if (bestSize >= requestSize ? (size >= requestSize && size < bestSize) : size > bestSize)
+                    bestBuffer = b;
+            }
 
-        return matrixPtr;
+            if (bestBuffer == SIZE_MAX)
+            {
+                SharedBufferInfo buffer;
+                buffer.m_deviceId = request.m_deviceId;
+                buffer.m_stream = request.m_stream;
+                buffer.m_elemSize = sizeof(ElemType);
+                m_plannedBuffers.push_back(buffer);
+                bestBuffer = m_plannedBuffers.size() - 1;
+            }
+            m_plannedBuffers[bestBuffer].m_sizes.push_back(make_pair(request.m_numRows, request.m_numCols));
+            m_plannedBuffers[bestBuffer].m_requestIndices.push_back(requestIndex);
+        }
+
+        // create the physical matrices and hand them to the nodes
+        for (size_t b = firstBuffer; b < m_plannedBuffers.size(); b++)
+        {
+            auto matrixPtr = make_shared<Matrix<ElemType>>(m_plannedBuffers[b].m_deviceId);
+            for (size_t requestIndex : m_plannedBuffers[b].m_requestIndices)
+                for (auto pMatrixPtr : memRequestInfoVec[requestIndex].m_pMatrixPtrs)
+                    *pMatrixPtr = matrixPtr;
+        }
     }
 };
 } } }
@@ -0,0 +1,254 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#define _CRT_SECURE_NO_WARNINGS // "secure" CRT not available on all platforms  --add this at the top of all CPP files that give "function or variable may be unsafe" warnings
+
+#include "Basics.h"
+#include "NodeProfiler.h"
+#include "fileutil.h"
+#include <string>
+#include <vector>
+#include <algorithm>
+
+using namespace std;
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+static const char* PhaseName(NodeProfiler::Phase phase)
+{
+    switch (phase)
+    {
+    case NodeProfiler::Phase::forward:   return "forward";
+    case NodeProfiler::Phase::backward:  return "backward";
+    case NodeProfiler::Phase::recompute: return "recompute";
+    default: LogicError("NodeProfiler: invalid phase.");
+    }
+}
+
+NodeProfiler::Totals::Totals()
+    : m_numNodes(0), m_flops(0), m_bytesAllocated(0)
+{
+    for (size_t phase = 0; phase < (size_t) Phase::numPhases; phase++)
+    {
+        m_calls[phase] = 0;
+        m_milliseconds[phase] = 0;
+    }
+}
+
+void NodeProfiler::Totals::Add(const Totals& other)
+{
+    for (size_t phase = 0; phase < (size_t) Phase::numPhases; phase++)
+    {
+        m_calls[phase] += other.m_calls[phase];
+        m_milliseconds[phase] += other.m_milliseconds[phase];
+    }
+    m_flops += other.m_flops;
+    m_bytesAllocated += other.m_bytesAllocated;
+}
+
+double NodeProfiler::Totals::TotalMilliseconds() const
+{
+    double milliseconds = 0;
+    for (size_t phase = 0; phase < (size_t) Phase::numPhases; phase++)
+        milliseconds += m_milliseconds[phase];
+    return milliseconds;
+}
+
+NodeProfiler::NodeProfiler(DEVICEID_TYPE deviceId, const wstring& traceFileName)
+    : m_startTime(chrono::steady_clock::now()), m_traceFileName(traceFileName), m_passBegin(0), m_numPasses(0)
+{
+    if (deviceId >= 0)
+        m_eventTimer.reset(new ComputeEventTimer(deviceId));
+}
+
+double NodeProfiler::HostMicroseconds() const
+{
+    return chrono::duration<double, micro>(chrono::steady_clock::now() - m_startTime).count();
+}
+
+void NodeProfiler::BeginPass()
+{
+    m_records.clear();
+    m_passBegin = HostMicroseconds();
+    if (m_eventTimer)
+        m_eventTimer->Record(0);
+}
+
+void NodeProfiler::BeginNode(const ComputationNodeBasePtr& node, Phase phase)
+{
+    NodeRecord record;
+    record.m_node = node;
+    record.m_phase = phase;
+    record.m_bytesBefore = node->GetAllocatedMatrixBytes();
+    record.m_bytesAfter = record.m_bytesBefore;
+    if (m_eventTimer)
+        m_eventTimer->Record(2 * m_records.size() + 1);
+    record.m_hostBegin = HostMicroseconds();
+    record.m_hostEnd = record.m_hostBegin;
+    m_records.push_back(record);
+}
+
+void NodeProfiler::EndNode()
+{
+    if (m_records.empty())
+        LogicError("NodeProfiler::EndNode: called without BeginNode().");
+
+    auto& record = m_records.back();
+    if (m_eventTimer)
+        m_eventTimer->Record(2 * m_records.size());
+    record.m_hostEnd = HostMicroseconds();
+    record.m_bytesAfter = record.m_node->GetAllocatedMatrixBytes();
+}
+
+// read the times of the pass, and add them to the totals
+// This waits for the GPU work of the pass to complete.
+void NodeProfiler::EndPass()
+{
+    for (size_t i = 0; i < m_records.size(); i++)
+    {
+        const auto& record = m_records[i];
+        double begin, duration;
+        if (m_eventTimer)
+        {
+            begin = m_passBegin + 1000.0 * m_eventTimer->ElapsedMilliseconds(0, 2 * i + 1);
+            duration = 1000.0 * m_eventTimer->ElapsedMilliseconds(2 * i + 1, 2 * i + 2);
+        }
+        else
+        {
+            begin = record.m_hostBegin;
+            duration = record.m_hostEnd - record.m_hostBegin;
+        }
+
+        double flops = record.m_node->EstimateForwardFlops();
+        if (record.m_phase == Phase::backward)
+            flops *= 2; // gradients w.r.t. the inputs, and w.r.t. the weights
+        size_t bytesAllocated = record.m_bytesAfter > record.m_bytesBefore ? record.m_bytesAfter - record.m_bytesBefore : 0;
+
+        auto& totals = m_nodeTotals[record.m_node->NodeName()];
+        totals.m_operationName = record.m_node->OperationName();
+        totals.m_calls[(size_t) record.m_phase]++;
+        totals.m_milliseconds[(size_t) record.m_phase] += duration / 1000.0;
+        totals.m_flops += flops;
+        totals.m_bytesAllocated += bytesAllocated;
+
+        if (!m_traceFileName.empty() && m_trace.size() < s_maxTraceEvents)
+        {
+            TraceEvent event;
+            event.m_nodeName = record.m_node->NodeName();
+            event.m_operationName = record.m_node->OperationName();
+            event.m_phase = record.m_phase;
+            event.m_stream = record.m_node->GetComputeStream();
+            event.m_begin = begin;
+            event.m_duration = duration;
+            event.m_flops = flops;
+            event.m_bytesAllocated = bytesAllocated;
+            m_trace.push_back(event);
+            if (m_trace.size() == s_maxTraceEvents)
+                fprintf(stderr, "NodeProfiler: The trace is limited to %d events, further passes are not traced.\n", (int) s_maxTraceEvents);
+        }
+    }
+    m_records.clear();
+    m_numPasses++;
+}
+
+void NodeProfiler::PrintSummary(const string& title)
+{
+    // totals per operation
+    map<wstring, Totals> operationTotals;
+    Totals allTotals;
+    for (const auto& keyValue : m_nodeTotals)
+    {
+        auto& totals = operationTotals[keyValue.second.m_operationName];
+        totals.m_operationName = keyValue.second.m_operationName;
+        totals.m_numNodes++;
+        totals.Add(keyValue.second);
+        allTotals.Add(keyValue.second);
+    }
+    auto byTime = [](const Totals* a, const Totals* b)
+    {
+        return a->TotalMilliseconds() > b->TotalMilliseconds();
+    };
+    double allMilliseconds = max(allTotals.TotalMilliseconds(), 1e-9);
+
+    fprintf(stderr, "\nNode profile %s: %d passes, %.1f ms in the nodes, %.3f GFLOP (estimated), %.1f MB allocated.\n",
+            title.c_str(), (int) m_numPasses, allTotals.TotalMilliseconds(), allTotals.m_flops * 1e-9, allTotals.m_bytesAllocated / 1e6);
+    fprintf(stderr, "%-28s %6s %10s %10s %10s %6s %10s %8s %10s\n", "operation", "nodes", "fwd ms", "bwd ms", "recomp ms", "%", "GFLOP", "GFLOP/s", "MB alloc");
+    vector<const Totals*> operations;
+    for (const auto& keyValue : operationTotals)
+        operations.push_back(&keyValue.second);
+    sort(operations.begin(), operations.end(), byTime);
+    for (auto totals : operations)
+    {
+        fprintf(stderr, "%-28ls %6d %10.1f %10.1f %10.1f %6.1f %10.3f %8.1f %10.1f\n",
+                totals->m_operationName.c_str(), (int) totals->m_numNodes,
+                totals->m_milliseconds[(size_t) Phase::forward], totals->m_milliseconds[(size_t) Phase::backward], totals->m_milliseconds[(size_t) Phase::recompute],
+                100.0 * totals->TotalMilliseconds() / allMilliseconds, totals->m_flops * 1e-9,
+                totals->TotalMilliseconds() > 0 ? totals->m_flops * 1e-6 / totals->TotalMilliseconds() : 0.0, totals->m_bytesAllocated / 1e6);
+    }
+
+    // the slowest nodes
+    const size_t maxNodes = 20;
+    vector<pair<const wstring*, const Totals*>> nodes;
+    for (const auto& keyValue : m_nodeTotals)
+        nodes.push_back(make_pair(&keyValue.first, &keyValue.second));
+    sort(nodes.begin(), nodes.end(), [&byTime](const pair<const wstring*, const Totals*>& a, const pair<const wstring*, const Totals*>& b)
+    {
+        return byTime(a.second, b.second);
+    });
+    if (nodes.size() > maxNodes)
+        nodes.resize(maxNodes);
+    fprintf(stderr, "\n%-40s %-28s %10s %10s %6s %8s\n", "slowest nodes", "operation", "fwd ms", "bwd ms", "%", "GFLOP/s");
+    for (const auto& node : nodes)
+    {
+        auto totals = node.second;
+        fprintf(stderr, "%-40ls %-28ls %10.1f %10.1f %6.1f %8.1f\n",
+                node.first->c_str(), totals->m_operationName.c_str(),
+                totals->m_milliseconds[(size_t) Phase::forward] + totals->m_milliseconds[(size_t) Phase::recompute], totals->m_milliseconds[(size_t) Phase::backward],
+                100.0 * totals->TotalMilliseconds() / allMilliseconds,
+                totals->TotalMilliseconds() > 0 ? totals->m_flops * 1e-6 / totals->TotalMilliseconds() : 0.0);
+    }
+    fprintf(stderr, "\n");
+
+    m_nodeTotals.clear();
+    m_numPasses = 0;
+
+    if (!m_traceFileName.empty())
+        WriteTrace();
+}
+
+// the node names, escaped for a JSON string
+static string JsonString(const wstring& s)
+{
+    string result;
+    for (char c : msra::strfun::utf8(s))
+    {
+        if (c == '"' || c == '\\')
+            result += '\\';
+        if ((unsigned char) c >= 0x20)
+            result += c;
+    }
+    return result;
+}
+
+// write all trace events so far in the Chrome trace format
+// The file is rewritten each time, through a temporary file like models are.
+void NodeProfiler::WriteTrace() const
+{
+    wstring tmpFileName = m_traceFileName + L".tmp";
+    FILE* f = fopenOrDie(tmpFileName, L"w");
+    fprintf(f, "{\"traceEvents\":[\n");
+    for (size_t i = 0; i < m_trace.size(); i++)
+    {
+        const auto& event = m_trace[i];
+        fprintf(f, "{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":0,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"operation\":\"%s\",\"flops\":%.0f,\"bytesAllocated\":%d}}%s\n",
+                JsonString(event.m_nodeName).c_str(), PhaseName(event.m_phase), (int) event.m_stream, event.m_begin, event.m_duration,
+                JsonString(event.m_operationName).c_str(), event.m_flops, (int) event.m_bytesAllocated, i + 1 < m_trace.size() ? "," : "");
+    }
+    fprintf(f, "]}\n");
+    fcloseOrDie(f);
+    renameOrDie(tmpFileName, m_traceFileName);
+}
+
+} } }
@@ -0,0 +1,111 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <chrono>
+
+#include "Basics.h"
+#include "ComputeEventTimer.h"
+#include "ComputationNode.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// -----------------------------------------------------------------------
+// NodeProfiler -- opt-in per-node breakdown of forward and backward propagation
+//
+// PARTraversalFlowControlNode brackets each pass with BeginPass()/EndPass(),
+// and each of its nested nodes with BeginNode()/EndNode(). A recurrent loop
+// is profiled as one node. For each node, this records the time, the growth
+// of its value and gradient matrices (this is where they are allocated), and
+// EstimateForwardFlops() (twice that for backprop).
+// On the GPU, the times are measured with CUDA events, which are only read
+// in EndPass(): the profiler synchronizes once per pass, not once per node.
+// PrintSummary() prints the totals per operation and of the slowest nodes,
+// and rewrites the trace file, if any, in the Chrome trace format
+// (load it in chrome://tracing). Trace timestamps of GPU work are relative
+// to the host time at the start of its pass.
+// -----------------------------------------------------------------------
+
+class NodeProfiler
+{
+public:
+    enum class Phase
+    {
+        forward,
+        backward,
+        recompute, // forward prop in backprop for gradient checkpointing
+        numPhases
+    };
+
+    NodeProfiler(DEVICEID_TYPE deviceId, const std::wstring& traceFileName);
+
+    void BeginPass();
+    void EndPass();
+    void BeginNode(const ComputationNodeBasePtr& node, Phase phase);
+    void EndNode();
+
+    // prints the totals since the last call, e.g. of an epoch, and writes the trace of all passes so far
+    void PrintSummary(const std::string& title);
+
+private:
+    struct Totals
+    {
+        Totals();
+        void Add(const Totals& other);
+        double TotalMilliseconds() const;
+
+        std::wstring m_operationName;
+        size_t m_numNodes; // for totals per operation
+        size_t m_calls[(size_t) Phase::numPhases];
+        double m_milliseconds[(size_t) Phase::numPhases];
+        double m_flops;
+        size_t m_bytesAllocated;
+    };
+
+    struct NodeRecord
+    {
+        ComputationNodeBasePtr m_node;
+        Phase m_phase;
+        double m_hostBegin; // microseconds since construction
+        double m_hostEnd;
+        size_t m_bytesBefore;
+        size_t m_bytesAfter;
+    };
+
+    struct TraceEvent
+    {
+        std::wstring m_nodeName;
+        std::wstring m_operationName;
+        Phase m_phase;
+        size_t m_stream;
+        double m_begin; // microseconds since construction
+        double m_duration;
+        double m_flops;
+        size_t m_bytesAllocated;
+    };
+
+    double HostMicroseconds() const;
+    void WriteTrace() const;
+
+    std::unique_ptr<ComputeEventTimer> m_eventTimer; // null on the CPU
+    std::chrono::steady_clock::time_point m_startTime;
+    std::wstring m_traceFileName;
+
+    double m_passBegin;
+    std::vector<NodeRecord> m_records; // of the current pass; the events of record i are 2i+1 and 2i+2, 0 is the begin of the pass
+
+    size_t m_numPasses;
+    std::map<std::wstring, Totals> m_nodeTotals; // [node name]
+
+    std::vector<TraceEvent> m_trace;
+    static const size_t s_maxTraceEvents = 1000000; // the trace stops after these, to keep the file loadable
+};
+
+} } }
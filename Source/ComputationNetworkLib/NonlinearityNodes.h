@@ -41,12 +41,44 @@ public:
 
     virtual void /*ComputationNode::*/ ForwardProp(const FrameRange& fr) override
     {
+        if (HasFusedProducer())
+        {
+            auto sliceOutputValue = ValueFor(fr);
+            FusedProducer()->ForwardPropWithActivation(fr, opForward, sliceOutputValue);
+            return;
+        }
+        if (ForwardPropFusedElementWise(fr))
+            return;
         size_t rank = DetermineElementwiseTensorRank();
         auto result = ValueTensorFor(rank, fr);
         auto input = Input(0)->ValueTensorFor(rank, fr);
         result.DoUnaryOpOf(0, input, 1, opForward);
     }
 
+    virtual bool GetElementWiseForwardOp(ElementWiseOperator& op) const override
+    {
+        op = opForward;
+        return true;
+    }
+
+    // With a fused producer, the producer propagates the gradient through this activation directly into its own inputs,
+    // so the gradient of the producer's value is never formed.
+    virtual void /*ComputationNodeBase::*/ Backprop(const FrameRange& fr, bool childrenInThisLoop, bool childrenInOuterLoop) override
+    {
+        if (!HasFusedProducer())
+            return Base::Backprop(fr, childrenInThisLoop, childrenInOuterLoop);
+        if (childrenInThisLoop && Input(0)->NeedsGradient())
+            FusedProducer()->BackpropToWithActivation(fr, opForward, GradientFor(fr), ValueFor(fr));
+    }
+
+    // the producer's inputs receive their gradients in this node's Backprop()
+    virtual void /*ComputationNodeBase::*/ AllocateGradientMatricesForInputs(MatrixPool& matrixPool) override
+    {
+        Base::AllocateGradientMatricesForInputs(matrixPool);
+        if (HasFusedProducer()) // (the producer's own override does nothing while it is fused)
+            Input(0)->Base::AllocateGradientMatricesForInputs(matrixPool);
+    }
+
     virtual void /*ComputationNode::*/ BackpropTo(const size_t inputIndex, const FrameRange& fr) override
     {
         assert(inputIndex == 0);
@@ -60,9 +92,11 @@ public:
                               Input(0)->ValueTensorFor(rank, fr);
         // If gradient can be compute from output rather than input, then that's better for mem sharing (and faster in most cases).
         // Not possible for Cos().
-        sliceInputGrad.DoBinaryOpOf(1, sliceOutputGrad, sliceValue, 1, opBackward);
+        sliceInputGrad.DoBinaryOpOf(InputGradientBeta(), sliceOutputGrad, sliceValue, 1, opBackward);
     }
 
+    virtual bool CanAssignGradientOfInput(size_t /*childIndex*/) const override { return true; }
+
     virtual void /*ComputationNodeBase::*/ Validate(bool isFinalValidationPass) override
     {
         ValidateUnaryMap(isFinalValidationPass);
@@ -76,6 +110,21 @@ public:
     {
         return !gradientFromOutput;
     }
+
+    // with the gradient computed from the output, the input value is dead once the opcode has been applied to it
+    virtual bool CanComputeValueInPlace() const override
+    {
+        return gradientFromOutput;
+    }
+
+private:
+    IFusedActivationProducer<ElemType>* FusedProducer()
+    {
+        auto producer = dynamic_cast<IFusedActivationProducer<ElemType>*>(this->GetFusedProducer().get());
+        if (!producer)
+            LogicError("%ls %ls operation: The fused input %ls has a mismatching element type.", this->NodeName().c_str(), this->OperationName().c_str(), this->GetFusedProducer()->NodeName().c_str());
+        return producer;
+    }
 };
 
 #define UnaryElementWiseWithOpCodeNodeBaseMembers UsingComputationNodeMembersBoilerplate;
@@ -248,8 +297,7 @@ public:
 
     /*virtual*/ void ForwardPropV(Matrix<ElemType>& functionValues, const Matrix<ElemType>& inputFunctionValues) override
     {
-        functionValues.AssignLogSoftmaxOf(inputFunctionValues, true);
-        functionValues.InplaceExp();
+        functionValues.AssignSoftmaxOf(inputFunctionValues, true);
     }
 
     virtual void CopyTo(ComputationNodeBasePtr nodeP, const std::wstring& newName, const CopyNodeFlags flags) const override
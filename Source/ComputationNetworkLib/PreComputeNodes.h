@@ -58,6 +58,12 @@ public:
         return true;
     }
 
+    // while precomputing, ForwardProp() accumulates over the minibatches
+    virtual bool IsGraphCapturable() const override
+    {
+        return m_hasComputed;
+    }
+
     virtual void Save(File& fstream) const override
     {
         Base::Save(fstream);
@@ -185,6 +191,27 @@ public:
         // LogicError("Mean operation should not be involved in the gradient calculation.");
     }
 
+    // The accumulators, for distributed precomputation: Each worker accumulates over its share of the data, and the
+    // workers merge their accumulators before MarkComputed(true) (see SGD::MergePreComputeStatistics()).
+    // The mean and the variance are normalized by the number of samples.
+    size_t GetNumAccumulatedSamples() const
+    {
+        if (!IsAccumulating())
+            LogicError("%ls %ls operation: GetNumAccumulatedSamples() called while not accumulating.", NodeName().c_str(), OperationName().c_str());
+        return m_numSamples;
+    }
+    void SetNumAccumulatedSamples(size_t numSamples)
+    {
+        if (!IsAccumulating() || numSamples == SIZE_MAX)
+            LogicError("%ls %ls operation: SetNumAccumulatedSamples() called while not accumulating.", NodeName().c_str(), OperationName().c_str());
+        m_numSamples = numSamples;
+    }
+    virtual Matrix<ElemType>& MeanAccumulator() = 0;
+    virtual Matrix<ElemType>* VarianceAccumulator() // (nullptr if the node does not estimate the variance)
+    {
+        return nullptr;
+    }
+
     virtual void CopyTo(ComputationNodeBasePtr nodeP, const std::wstring& newName, const CopyNodeFlags flags) const override
     {
         Base::CopyTo(nodeP, newName, flags);
@@ -243,6 +270,11 @@ public:
         // no else branch because ForwardPropNonLooping() already leaves a valid mean in m_value
     }
 
+    virtual Matrix<ElemType>& /*MeanInvStdDevNodeBase::*/ MeanAccumulator() override
+    {
+        return Value();
+    }
+
     virtual void /*ComputationNodeNonLooping::*/ ForwardPropNonLooping() override
     {
         FrameRange fr(Input(0)->GetMBLayout());
@@ -335,6 +367,15 @@ public:
         }
     }
 
+    virtual Matrix<ElemType>& /*MeanInvStdDevNodeBase::*/ MeanAccumulator() override
+    {
+        return m_mean;
+    }
+    virtual Matrix<ElemType>* /*MeanInvStdDevNodeBase::*/ VarianceAccumulator() override
+    {
+        return &m_var;
+    }
+
     virtual void /*ComputationNodeNonLooping::*/ ForwardPropNonLooping() override
     {
         FrameRange fr(Input(0)->GetMBLayout());
@@ -9,6 +9,7 @@
 #include "Sequences.h"
 #include "Matrix.h"
 #include "TensorShape.h"
+#include "RNNEngine.h"
 
 #include <unordered_set>
 #include <map>
@@ -89,7 +90,7 @@ protected:
 
 // TODO: 'direction' is really too general. signOfTimeOffset?
 template <class ElemType, int direction /*-1 for Past/left-to-right or +1 for Future/right-to-left*/ /*, MinibatchPackingFlags SequenceStart_or_End/*-Start or -End*/>
-class DelayedValueNodeBase : public ComputationNode<ElemType>, public IRecurrentNode, public ILateAttachingNode, public IStatefulNode, public NumInputs<1>
+class DelayedValueNodeBase : public ComputationNode<ElemType>, public IRecurrentNode, public ILateAttachingNode, public IStatefulNode, public IStreamingNode, public NumInputs<1>
 {
     typedef ComputationNode<ElemType> Base;
     UsingComputationNodeMembersBoilerplate;
@@ -172,6 +173,9 @@ public:
             fstream >> m_initialActivationValue;
     }
 
+    // carries state across minibatches, and depends on the sequence boundaries
+    virtual bool /*ComputationNodeBase::*/ IsGraphCapturable() const override { return false; }
+
     virtual void /*ComputationNode::*/ BackpropTo(const size_t inputIndex, const FrameRange& fr) override
     {
         assert(inputIndex == 0);
@@ -201,7 +205,16 @@ public:
             // if there is a boundary in this frame, we treat each stream separately; otherwise we do all in one go
             // assert(m_pShiftedMBLayout->Is(t, SequenceStart_or_End | MinibatchPackingFlags::NoFeature) ==
             //       m_pMBLayout->IsGap(fr) || m_pMBLayout->IsBeyondStartOrEnd(frDelayed));
-            if (m_pMBLayout->IsGap(fr) || m_pMBLayout->IsBeyondStartOrEnd(frDelayed)) // true if at least one parallel sequence has a boundary or gap
+            if ((m_pMBLayout->IsGap(fr) || m_pMBLayout->IsBeyondStartOrEnd(frDelayed)) && m_maskedGradient && Gradient().GetMatrixType() == MatrixType::DENSE)
+            {
+                // zero the boundary frames and gaps with the layout's cached mask and propagate the whole time step in one go
+                const auto& mask = m_pMBLayout->GetColumnsBoundaryMask(direction * m_timeStep, Gradient().GetDeviceId());
+                m_maskedGradient->SetValue(GradientFor(fr));
+                m_maskedGradient->MaskColumnsValue(DataWithMBLayoutFor(mask, fr, m_pMBLayout), 0);
+                Matrix<ElemType> to = Input(0)->GradientFor(frDelayed);
+                to += *m_maskedGradient;
+            }
+            else if (m_pMBLayout->IsGap(fr) || m_pMBLayout->IsBeyondStartOrEnd(frDelayed)) // true if at least one parallel sequence has a boundary or gap
             {
                 size_t mNbr = m_pMBLayout->GetNumParallelSequences();
                 for (size_t id = 0; id < mNbr; id++)
@@ -294,10 +307,11 @@ public:
 
         Matrix<ElemType> inp((DEVICEID_TYPE)m_value->GetDeviceId());
 
-        // if any sequence at this time step has a boundary flag, then process one by one
-        // TODO: Would there be an efficiency gain from grouping consecutive sequences with identical flags?
+        // if any sequence at this time step has a boundary flag, then copy the whole time step and overwrite the boundary frames using the layout's cached mask,
+        // unless the delayed values of this time step cannot be read as a whole; then process one by one
         // assert(m_pShiftedMBLayout->Is(t, SequenceStart_or_End) == m_pMBLayout->IsBeyondStartOrEnd(frDelayed));
-        if (m_pMBLayout->IsBeyondStartOrEnd(frDelayed))
+        bool hasBoundary = m_pMBLayout->IsBeyondStartOrEnd(frDelayed);
+        if (hasBoundary && !CanMaskBoundaries(t_delayed))
         {
             for (size_t id = 0; id < GetNumParallelSequences(); id++)
             {
@@ -358,9 +372,41 @@ public:
             // inp = Input(0)->ValueFor(FrameRange(m_pMBLayout, t_delayed));
 
             out.SetValue(inp);
+            if (hasBoundary)
+                out.MaskColumnsValue(DataWithMBLayoutFor(m_pMBLayout->GetColumnsBoundaryMask(direction * m_timeStep, out.GetDeviceId()), fr, m_pMBLayout), m_initialActivationValue);
         }
     }
 
+    // whether ForwardProp() can handle a time step with boundaries by masking, i.e. whether the delayed values of all
+    // parallel sequences can be read as one slice, from this minibatch or from the one carried over in m_delayedValue
+    bool CanMaskBoundaries(int t_delayed) const
+    {
+        if (Value().GetMatrixType() != MatrixType::DENSE)
+            return false;
+        int T = (int) GetNumTimeSteps();
+        if (t_delayed >= 0 && t_delayed < T)
+            return true;
+        if (m_delayedValue.IsEmpty() || !m_delayedActivationMBLayout || m_delayedActivationMBLayout->GetNumParallelSequences() != GetNumParallelSequences())
+            return false;
+        int T_delayedActivation = (int) m_delayedActivationMBLayout->GetNumTimeSteps();
+        int t_carriedOver = t_delayed < 0 ? t_delayed + T_delayedActivation : t_delayed - T;
+        return t_carriedOver >= 0 && t_carriedOver < T_delayedActivation;
+    }
+
+    // request matrices needed to do node function value evaluation
+    virtual void RequestMatricesBeforeBackprop(MatrixPool& matrixPool) override
+    {
+        Base::RequestMatricesBeforeBackprop(matrixPool);
+        RequestMatrixFromPool(m_maskedGradient, matrixPool);
+    }
+
+    // release gradient and temp matrices that no longer needed after all the children's gradients are computed.
+    virtual void ReleaseMatricesAfterBackprop(MatrixPool& matrixPool) override
+    {
+        Base::ReleaseMatricesAfterBackprop(matrixPool);
+        ReleaseMatrixToPool(m_maskedGradient, matrixPool);
+    }
+
     virtual void /*ComputationNodeBase::*/ Validate(bool isFinalValidationPass) override
     {
         ValidateUnaryMap(isFinalValidationPass);
@@ -463,10 +509,75 @@ public:
             LogicError("Unrecognized direction in DelayedValueNodeBase");
     }
 
+    // The state of a stream is the input of this node in its last m_timeStep frames, one column per frame.
+    // Only past values can be streamed: the future of a chunk is in the next one.
+    virtual void /*IStreamingNode::*/ GatherStreamStates(const std::vector<NodeStatePtr>& states, size_t numParallelSequences) override
+    {
+        int dir = direction;
+        if (dir != -1)
+            InvalidArgument("%ls %ls operation looks into the future, which cannot be evaluated in chunks of a stream.", NodeName().c_str(), OperationName().c_str());
+        if (states.size() != numParallelSequences)
+            LogicError("GatherStreamStates: %d states for %d parallel sequences.", (int) states.size(), (int) numParallelSequences);
+
+        // the carried-over value of a minibatch of m_timeStep frames, as ForwardProp() reads it when a delay reaches across the start
+        const size_t numFrames = m_timeStep;
+        m_delayedValue.Resize(GetSampleMatrixNumRows(), numFrames * numParallelSequences);
+        if (!m_delayedActivationMBLayout)
+            m_delayedActivationMBLayout = make_shared<MBLayout>();
+        m_delayedActivationMBLayout->Init(numParallelSequences, numFrames);
+        for (size_t s = 0; s < numParallelSequences; s++)
+        {
+            m_delayedActivationMBLayout->AddSequence(NEW_SEQUENCE_ID, s, 0, numFrames);
+            if (!states[s]) // a new stream; its frames before the start are never read
+                continue;
+            const Matrix<ElemType>& history = dynamic_pointer_cast<DelayedValueNodeState<ElemType>>(states[s])->ExportCachedActivity();
+            for (size_t t = 0; t < numFrames; t++)
+                m_delayedValue.SetColumnSlice(history.ColumnSlice(t, 1), t * numParallelSequences + s, 1);
+        }
+    }
+
+    virtual void /*IStreamingNode::*/ ScatterStreamStates(std::vector<NodeStatePtr>& states, const std::vector<size_t>& numStreamFrames) override
+    {
+        // after EndForwardProp(), m_delayedValue is the input of this minibatch
+        const size_t numParallelSequences = GetNumParallelSequences();
+        const size_t numFrames = m_timeStep;
+        states.resize(numParallelSequences);
+        std::vector<size_t> lengths(numParallelSequences, 0);
+        for (const auto& seq : m_pMBLayout->GetAllSequences())
+        {
+            if (seq.seqId != GAP_SEQUENCE_ID)
+                lengths[seq.s] = min(min(seq.tEnd, GetNumTimeSteps()), numStreamFrames[seq.s]);
+        }
+        for (size_t s = 0; s < numParallelSequences; s++)
+        {
+            Matrix<ElemType> history(GetSampleMatrixNumRows(), numFrames, m_deviceId);
+            const size_t numNew = min(lengths[s], numFrames);
+            if (numNew < numFrames) // a chunk shorter than the delay keeps the newest frames of the previous state
+            {
+                if (states[s])
+                {
+                    const auto& previous = dynamic_pointer_cast<DelayedValueNodeState<ElemType>>(states[s])->ExportCachedActivity();
+                    history.SetColumnSlice(previous.ColumnSlice(numNew, numFrames - numNew), 0, numFrames - numNew);
+                }
+                else
+                    history.ColumnSlice(0, numFrames - numNew).SetValue(m_initialActivationValue);
+            }
+            for (size_t j = numFrames - numNew; j < numFrames; j++)
+            {
+                size_t t = lengths[s] - numFrames + j;
+                history.SetColumnSlice(m_delayedValue.ColumnSlice(t * numParallelSequences + s, 1), j, 1);
+            }
+            auto state = make_shared<DelayedValueNodeState<ElemType>>(m_deviceId);
+            state->CacheState(history);
+            states[s] = state;
+        }
+    }
+
 protected:
     ElemType m_initialActivationValue;       // starting value for hidden activation vector at boundary
     Matrix<ElemType> m_delayedValue;         // saves the activation of the previous step that this node points to
     MBLayoutPtr m_delayedActivationMBLayout; // layout for m_delayedValue
+    shared_ptr<Matrix<ElemType>> m_maskedGradient; // gradient of a time step with its boundary frames and gaps zeroed
     int m_timeStep;                          // delay in frames (typ. 1)
     function<void()> m_attachInputsFn;       // for late expansion of inputs (scripting)
 };
@@ -640,6 +751,9 @@ public:
         fstream >> m_fromOffset >> m_boundaryMode >> m_shiftDimParam;
     }
 
+    // carries state across minibatches, and depends on the sequence boundaries
+    virtual bool /*ComputationNodeBase::*/ IsGraphCapturable() const override { return false; }
+
     virtual void BeginForwardProp() override // called after last iteration step of ForwardProp()
     {
         Base::BeginForwardProp();
@@ -1180,4 +1294,200 @@ protected:
 
 #endif
 
+// -----------------------------------------------------------------------
+// OptimizedRNNStackNode (weights, input)
+// A stack of recurrent layers (LSTM, GRU, or plain RNN with tanh or ReLU), optionally bidirectional,
+// that is computed over entire sequences at once, rather than frame by frame inside a loop.
+// On GPU this uses cuDNN's fused RNN kernels; otherwise the stack is computed with one GEMM per gate over
+// all frames for the input projections, and only the recurrent projections step through time.
+//
+// All parameters are held by a single LearnableParameter 'weights' as a vector; see RNNAttributes for its
+// layout. Its dimension is inferred from the input dimension.
+// The recurrence starts from a zero state at the first frame of each sequence in the minibatch
+// (truncated BPTT with state carried across minibatches is not supported).
+// The output has dimension hiddenDims (or 2 * hiddenDims if bidirectional, forward direction first).
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+class OptimizedRNNStackNode : public ComputationNodeNonLooping<ElemType>, public NumInputs<2>
+{
+    typedef ComputationNodeNonLooping<ElemType> Base;
+    UsingComputationNodeMembersBoilerplate;
+    static const std::wstring TypeName()
+    {
+        return L"OptimizedRNNStack";
+    }
+
+public:
+    OptimizedRNNStackNode(DEVICEID_TYPE deviceId, const wstring& name)
+        : Base(deviceId, name), m_engineKind(RNNEngineKind::Auto), m_isBackwardDataDone(false)
+    {
+    }
+    OptimizedRNNStackNode(DEVICEID_TYPE deviceId, const wstring& name, size_t hiddenDims, size_t numLayers, bool bidirectional, RNNCellKind kind, RNNEngineKind engineKind = RNNEngineKind::Auto)
+        : Base(deviceId, name), m_attributes(kind, hiddenDims, numLayers, bidirectional), m_engineKind(engineKind), m_isBackwardDataDone(false)
+    {
+    }
+    OptimizedRNNStackNode(const ScriptableObjects::IConfigRecordPtr configp)
+        : OptimizedRNNStackNode(configp->Get(L"deviceId"), L"<placeholder>", configp->Get(L"hiddenDims"), configp->Get(L"numLayers"), configp->Get(L"bidirectional"),
+                                RNNCellKindFrom(configp->Get(L"recurrentOp")), RNNEngineKindFrom(configp->Get(L"engine")))
+    {
+        // weights, input, hiddenDims, numLayers = 1, bidirectional = false, recurrentOp = 'lstm', engine = 'auto'
+        AttachInputs(configp, this->GetExpectedNumInputs());
+    }
+
+    static RNNEngineKind RNNEngineKindFrom(const wstring& s)
+    {
+        if (EqualCI(s, L"auto"))
+            return RNNEngineKind::Auto;
+        else if (EqualCI(s, L"cudnn"))
+            return RNNEngineKind::CuDnn;
+        else if (EqualCI(s, L"cntk"))
+            return RNNEngineKind::Cntk;
+        else
+            InvalidArgument("Unsupported RNN engine '%ls', choose one of \"auto\" (default), \"cudnn\", or \"cntk\".", s.c_str());
+    }
+
+    void Save(File& fstream) const override
+    {
+        Base::Save(fstream);
+        fstream << (uint32_t) m_attributes.m_kind << m_attributes.m_hiddenSize << m_attributes.m_numLayers << m_attributes.m_bidirectional;
+        fstream << (uint32_t) m_engineKind;
+    }
+
+    void Load(File& fstream, size_t modelVersion) override
+    {
+        Base::Load(fstream, modelVersion);
+        uint32_t kind, engineKind;
+        fstream >> kind >> m_attributes.m_hiddenSize >> m_attributes.m_numLayers >> m_attributes.m_bidirectional;
+        fstream >> engineKind;
+        m_attributes.m_kind = (RNNCellKind) kind;
+        m_engineKind = (RNNEngineKind) engineKind;
+    }
+
+    void CopyTo(ComputationNodeBasePtr nodeP, const std::wstring& newName, const CopyNodeFlags flags) const override
+    {
+        Base::CopyTo(nodeP, newName, flags);
+        if (flags & CopyNodeFlags::copyNodeValue)
+        {
+            auto node = dynamic_pointer_cast<OptimizedRNNStackNode<ElemType>>(nodeP);
+            node->m_attributes = m_attributes;
+            node->m_engineKind = m_engineKind;
+        }
+    }
+
+    void /*ComputationNodeNonLooping::*/ ForwardPropNonLooping() override
+    {
+        FrameRange fr(Input(1)->GetMBLayout());
+        Matrix<ElemType> sliceOutputValue = ValueFor(fr);
+        assert(m_rnnEngine != nullptr);
+        m_rnnEngine->Forward(Input(1)->ValueFor(fr), Input(0)->ValueAsMatrix(), sliceOutputValue, GetRNNMinibatchLayout(), this->NeedsGradient());
+        m_isBackwardDataDone = false;
+    }
+
+    void /*ComputationNodeNonLooping::*/ BackpropToNonLooping(size_t inputIndex) override
+    {
+        FrameRange fr(Input(1)->GetMBLayout());
+        // cuDNN computes the weight gradient from state left behind by the data gradient, so that one always goes first.
+        // Since inputs are processed in order, the weights (input 0) will ask for it before the data (input 1) does.
+        if (!m_isBackwardDataDone)
+        {
+            if (Input(1)->NeedsGradient())
+            {
+                Input(1)->LazyZeroGradient();
+                Matrix<ElemType> sliceInputGrad = Input(1)->GradientFor(fr);
+                m_rnnEngine->BackwardData(ValueFor(fr), GradientFor(fr), Input(0)->ValueAsMatrix(), sliceInputGrad);
+            }
+            else
+            {
+                m_tempInputGrad->Resize(Input(1)->GetSampleMatrixNumRows(), Input(1)->GetMBLayout()->GetNumCols());
+                m_tempInputGrad->SetValue(0);
+                m_rnnEngine->BackwardData(ValueFor(fr), GradientFor(fr), Input(0)->ValueAsMatrix(), *m_tempInputGrad);
+            }
+            m_isBackwardDataDone = true;
+        }
+        if (inputIndex == 0) // derivative with respect to the weights
+            m_rnnEngine->BackwardWeights(Input(1)->ValueFor(fr), ValueFor(fr), Input(0)->GradientAsMatrix());
+    }
+
+    // the sequences are packed on the host
+    virtual bool /*ComputationNodeBase::*/ IsGraphCapturable() const override { return false; }
+
+    void /*ComputationNodeBase::*/ Validate(bool isFinalValidationPass) override
+    {
+        Base::Validate(isFinalValidationPass);
+        InferMBLayoutFromInputsForStandardCase();
+        if (isFinalValidationPass && !m_pMBLayout)
+            InvalidArgument("%ls %ls operation requires its input to be a sequence.", NodeName().c_str(), OperationName().c_str());
+
+        // check/infer input [0] (weights)
+        const size_t inputDim = GetInputSampleLayout(1).GetNumElements();
+        const size_t numParameters = m_attributes.GetNumParameters(inputDim);
+        if (inputDim != 0) // (not known yet in early validation passes)
+            Input(0)->ValidateInferInputDimsFrom(TensorShape(numParameters));
+        if (isFinalValidationPass && Input(0)->GetSampleLayout().GetNumElements() != numParameters)
+            InvalidArgument("%ls %ls operation: weights %ls must have %d elements for %d layer(s) of %ls with hidden dimension %d and input dimension %d.",
+                            NodeName().c_str(), OperationName().c_str(), Input(0)->NodeName().c_str(), (int) numParameters,
+                            (int) m_attributes.m_numLayers, ToString(m_attributes.m_kind).c_str(), (int) m_attributes.m_hiddenSize, (int) inputDim);
+
+        SetDims(TensorShape(m_attributes.GetOutputDim()), HasMBLayout());
+
+        if (isFinalValidationPass && (m_rnnEngine == nullptr || m_rnnEngine->GetAttributes() != m_attributes))
+            m_rnnEngine = RNNEngine<ElemType>::Create(m_deviceId, m_attributes, m_engineKind);
+    }
+
+    void DumpNodeInfo(const bool printValues, const bool printMetadata, File& fstream) const override
+    {
+        Base::DumpNodeInfo(printValues, printMetadata, fstream);
+
+        char str[4096];
+        sprintf(str, "recurrentOp=%ls  hiddenDims=%lu  numLayers=%lu  bidirectional=%ls\n",
+                ToString(m_attributes.m_kind).c_str(), m_attributes.m_hiddenSize, m_attributes.m_numLayers, m_attributes.m_bidirectional ? L"true" : L"false");
+        fstream << string(str);
+    }
+
+    // request matrices needed to do node function value evaluation
+    void RequestMatricesBeforeBackprop(MatrixPool& matrixPool) override
+    {
+        Base::RequestMatricesBeforeBackprop(matrixPool);
+        RequestMatrixFromPool(m_tempInputGrad, matrixPool);
+    }
+
+    // release gradient and temp matrices that no longer needed after all the children's gradients are computed.
+    void ReleaseMatricesAfterBackprop(MatrixPool& matrixPool) override
+    {
+        Base::ReleaseMatricesAfterBackprop(matrixPool);
+        ReleaseMatrixToPool(m_tempInputGrad, matrixPool);
+    }
+
+private:
+    // the sequences of the current minibatch, clipped to it
+    RNNMinibatchLayout GetRNNMinibatchLayout() const
+    {
+        RNNMinibatchLayout layout;
+        layout.m_numParallelSequences = m_pMBLayout->GetNumParallelSequences();
+        layout.m_numTimeSteps = m_pMBLayout->GetNumTimeSteps();
+        for (const auto& seq : m_pMBLayout->GetAllSequences())
+        {
+            if (seq.seqId == GAP_SEQUENCE_ID)
+                continue;
+            RNNMinibatchLayout::Sequence clipped;
+            clipped.s = seq.s;
+            clipped.tBegin = (size_t) max(seq.tBegin, (ptrdiff_t) 0);
+            clipped.tEnd = min(seq.tEnd, layout.m_numTimeSteps);
+            layout.m_sequences.push_back(clipped);
+        }
+        return layout;
+    }
+
+private:
+    RNNAttributes m_attributes;
+    RNNEngineKind m_engineKind;
+    std::unique_ptr<RNNEngine<ElemType>> m_rnnEngine;
+    bool m_isBackwardDataDone;
+    shared_ptr<Matrix<ElemType>> m_tempInputGrad; // receives the data gradient if the input does not need one
+};
+
+template class OptimizedRNNStackNode<float>;
+template class OptimizedRNNStackNode<double>;
+
 } } }
@@ -199,6 +199,9 @@ public:
     {
     }
 
+    // depends on the sequence boundaries
+    virtual bool /*ComputationNodeBase::*/ IsGraphCapturable() const override { return false; }
+
     virtual void /*ComputationNode::*/ ForwardProp(const FrameRange& fr) override
     {
         // enforce compatibility of 'dataInput' with 'layoutInput'
@@ -421,9 +424,12 @@ public:
         auto inputGrad = Input(inputIndex)->GradientTensorFor(rank, fr.AllowBroadcast());
         let outputSubSlice = NarrowToStripe(outputSlice, inputIndex);
         let outputGrad = TensorView<ElemType>(Gradient(), outputSubSlice);
-        inputGrad.AddCopyOf(outputGrad);
+        inputGrad.DoCopyOf(InputGradientBeta(), outputGrad, 1);
     }
 
+    // each input's gradient is exactly its stripe of ours
+    virtual bool CanAssignGradientOfInput(size_t /*childIndex*/) const override { return true; }
+
     virtual bool OutputUsedInComputingInputNodesGradients() const override { return false; }
     virtual bool InputUsedInComputingInputNodesGradients(size_t /*childIndex*/) const override { return false; }
 
@@ -1070,6 +1076,190 @@ private:
 template class LegacyReshapeNode<float>;
 template class LegacyReshapeNode<double>;
 
+// -----------------------------------------------------------------------
+// StackFramesNode (input) -- stack each k consecutive frames of a sequence
+// into one frame that is k times taller, reducing the frame rate by k
+//
+// E.g. for low-frame-rate acoustic models: 10 ms frames of dimension D
+// become 30 ms frames of dimension 3 D, so the rest of the network runs on
+// a third of the frames.
+//
+// Each sequence of length T becomes a sequence of ceil(T/k) frames, and the
+// last frame is padded with zeros if k does not divide T. The output has its
+// own MBLayout with these sequences (in the same parallel sequences as the
+// input), so recurrences like PastValue after this node run at the reduced
+// rate and reset at the right boundaries.
+//
+// Frame-level labels can be reduced the same way, followed by a RowSlice of
+// the first frame's label dimensions, which keeps the label of every k-th frame.
+//
+// Sequences must lie entirely in the minibatch (no truncated BPTT), and this
+// node cannot be inside a recurrent loop, since it changes the time base.
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+class StackFramesNode : public ComputationNode<ElemType>, public NumInputs<1>
+{
+    typedef ComputationNode<ElemType> Base;
+    UsingComputationNodeMembersBoilerplate;
+    static const std::wstring TypeName()
+    {
+        return L"StackFrames";
+    }
+
+public:
+    StackFramesNode(DEVICEID_TYPE deviceId, const wstring& name, size_t numFrames = 1)
+        : Base(deviceId, name),
+          m_numFrames(numFrames)
+    {
+    }
+    StackFramesNode(const ScriptableObjects::IConfigRecordPtr configp)
+        : StackFramesNode(configp->Get(L"deviceId"), L"<placeholder>", configp->Get(L"numFrames"))
+    {
+        AttachInputs(configp, this->GetExpectedNumInputs());
+    }
+
+    virtual void CopyTo(ComputationNodeBasePtr nodeP, const std::wstring& newName, const CopyNodeFlags flags) const override
+    {
+        Base::CopyTo(nodeP, newName, flags);
+        if (flags & CopyNodeFlags::copyNodeValue)
+        {
+            auto node = dynamic_pointer_cast<StackFramesNode<ElemType>>(nodeP);
+            node->m_numFrames = m_numFrames;
+        }
+    }
+
+    virtual void Save(File& fstream) const override
+    {
+        Base::Save(fstream);
+        fstream << m_numFrames;
+    }
+
+    virtual void Load(File& fstream, size_t modelVersion) override
+    {
+        Base::Load(fstream, modelVersion);
+        fstream >> m_numFrames;
+    }
+
+    virtual void PrintSelfBeforeValidation() const override
+    {
+        Base::PrintSelfBeforeValidation();
+        fprintf(stderr, ", numFrames=%lu", m_numFrames);
+    }
+
+    virtual void /*ComputationNodeBase::*/ Validate(bool isFinalValidationPass) override
+    {
+        Base::Validate(isFinalValidationPass);
+        if (m_numFrames == 0)
+            InvalidArgument("%ls %ls operation: numFrames must be at least 1.", NodeName().c_str(), OperationName().c_str());
+        if (!Input(0)->HasMBLayout())
+            InvalidArgument("%ls %ls operation: The input must be a sequence.", NodeName().c_str(), OperationName().c_str());
+        if (!m_pMBLayout)
+            m_pMBLayout = make_shared<MBLayout>(); // the reduced time base
+
+        SetDims(TensorShape(Input(0)->GetSampleMatrixNumRows() * m_numFrames), true);
+    }
+
+    // create the reduced layout, and the copies that stack the frames
+    virtual void /*IComputationNode::*/ BeginForwardProp() override
+    {
+        const auto& inputLayout = Input(0)->GetMBLayout();
+        const size_t S = inputLayout->GetNumParallelSequences();
+        const size_t T = inputLayout->GetNumTimeSteps();
+        const size_t K = m_numFrames;
+
+        // sequences are packed into the same parallel sequence as in the input, in the same order
+        vector<MBLayout::SequenceInfo> sequences;
+        for (const auto& seq : inputLayout->GetAllSequences())
+        {
+            if (seq.seqId == GAP_SEQUENCE_ID)
+                continue;
+            if (seq.tBegin < 0 || seq.tEnd > T)
+                InvalidArgument("%ls %ls operation: Sequences must not extend beyond the minibatch (truncated BPTT is not supported).", NodeName().c_str(), OperationName().c_str());
+            sequences.push_back(seq);
+        }
+        sort(sequences.begin(), sequences.end(), [](const MBLayout::SequenceInfo& a, const MBLayout::SequenceInfo& b)
+        {
+            return a.s != b.s ? a.s < b.s : a.tBegin < b.tBegin;
+        });
+        vector<size_t> ends(S, 0); // end of the reduced sequences so far, per parallel sequence
+        m_copies.clear();
+        for (auto& seq : sequences)
+        {
+            const size_t length = seq.GetNumTimeSteps();
+            const size_t begin = ends[seq.s];
+            ends[seq.s] += (length + K - 1) / K;
+            // frame i of the sequence goes to slot i % K of frame i / K; the frames of one slot are K * S columns apart in both
+            for (size_t j = 0; j < K && j < length; j++)
+                m_copies.push_back(Copy{((size_t) seq.tBegin + j) * S + seq.s, (begin * S + seq.s) * K + j, (length - j + K - 1) / K});
+            seq.tBegin = begin;
+            seq.tEnd = ends[seq.s];
+        }
+
+        m_pMBLayout->Init(S, *max_element(ends.begin(), ends.end()));
+        for (const auto& seq : sequences)
+            m_pMBLayout->AddSequence(seq);
+        for (size_t s = 0; s < S; s++)
+            m_pMBLayout->AddGap(s, ends[s], m_pMBLayout->GetNumTimeSteps());
+
+        // this resizes Value() to the new layout
+        Base::BeginForwardProp();
+    }
+
+    virtual void /*ComputationNode::*/ ForwardProp(const FrameRange& fr) override
+    {
+        if (!fr.IsAllFrames())
+            InvalidArgument("%ls %ls operation cannot be run from inside a loop since it changes the time base.", NodeName().c_str(), OperationName().c_str());
+
+        // padding and gaps are 0
+        Value().SetValue(0);
+        auto to = Value().Reshaped(Input(0)->Value().GetNumRows(), Value().GetNumCols() * m_numFrames);
+        StackOrUnstack(Input(0)->Value(), to, /*stack=*/true);
+    }
+
+    virtual void /*ComputationNode::*/ BackpropTo(const size_t /*inputIndex*/, const FrameRange& /*fr*/) override
+    {
+        auto from = Gradient().Reshaped(Input(0)->Value().GetNumRows(), Gradient().GetNumCols() * m_numFrames);
+        Matrix<ElemType> inputGradient(Input(0)->Gradient().GetNumRows(), Input(0)->Gradient().GetNumCols(), Input(0)->Gradient().GetDeviceId());
+        inputGradient.SetValue(0);
+        StackOrUnstack(inputGradient, from, /*stack=*/false);
+        Input(0)->Gradient() += inputGradient;
+    }
+
+    virtual bool OutputUsedInComputingInputNodesGradients() const override { return false; }
+    virtual bool InputUsedInComputingInputNodesGradients(size_t /*childIndex*/) const override { return false; }
+
+private:
+    // copies 'numCols' frames of the input, 'stride' columns apart, to the stacked output (as a [D x K * S * T'] matrix)
+    struct Copy
+    {
+        size_t m_inputCol;
+        size_t m_outputCol;
+        size_t m_numCols;
+    };
+
+    void StackOrUnstack(Matrix<ElemType>& input, Matrix<ElemType>& stacked, bool stack) const
+    {
+        const size_t stride = m_numFrames * Input(0)->GetMBLayout()->GetNumParallelSequences();
+        for (const auto& copy : m_copies)
+        {
+            size_t span = (copy.m_numCols - 1) * stride + 1;
+            auto inputSlice = input.ColumnSlice(copy.m_inputCol, span);
+            auto stackedSlice = stacked.ColumnSlice(copy.m_outputCol, span);
+            if (stack)
+                stackedSlice.CopyColumnsStrided(inputSlice, copy.m_numCols, stride, stride);
+            else
+                inputSlice.CopyColumnsStrided(stackedSlice, copy.m_numCols, stride, stride);
+        }
+    }
+
+    size_t m_numFrames;
+    vector<Copy> m_copies;
+};
+
+template class StackFramesNode<float>;
+template class StackFramesNode<double>;
+
 /*
 
 notes on tensor operations
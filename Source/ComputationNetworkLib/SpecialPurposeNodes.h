@@ -50,60 +50,21 @@ public:
 
     virtual void /*ComputationNode::*/ BackpropTo(const size_t inputIndex, const FrameRange& fr) override
     {
+        if (inputIndex > 3)
+            InvalidArgument("GMMLogLikelihoodNode criterion only takes four inputs.");
+
         // get the right slice
         const size_t colsPrior = Input(0)->GetSampleMatrixNumCols();
 
         Matrix<ElemType> sliceGradientValue = DataFor(*m_gradient, fr);
         Matrix<ElemType> slicePosterior = DataFor(*m_posterior, fr);
+        Matrix<ElemType> sliceNormedDeviation = DataFor(*m_normedDeviation, fr);
+        Matrix<ElemType> sliceNormedDeviationVectors = DataFor(*m_normedDeviationVectors, fr);
+        Matrix<ElemType> sliceLogPrior = colsPrior == 1 ? m_prior->ColumnSlice(0, 1) : DataFor(*m_prior, fr); // TODO: use the right MBLayout, then we won't need the special case
 
-        switch (inputIndex)
-        {
-        case 0:
-        {
-            if (colsPrior == 1)
-                BackpropToUnnormedPrior(Input(0)->Gradient(), sliceGradientValue, *m_prior, slicePosterior, *m_temp);
-            else
-            {
-                Matrix<ElemType> sliceUnnormedPriorGradient = Input(0)->GradientFor(fr);
-                Matrix<ElemType> slicePrior = DataFor(*m_prior, fr); // TODO: use the right MBLayout, then we won't need the special case
-                BackpropToUnnormedPrior(sliceUnnormedPriorGradient, sliceGradientValue, slicePrior, slicePosterior, *m_temp);
-            }
-        }
-        break;
-        case 1:
-        {
-            Matrix<ElemType> sliceNormedDeviationVectors = DataFor(*m_normedDeviationVectors, fr);
-            if (colsPrior == 1)
-                BackpropToMean(Input(1)->Gradient(), sliceGradientValue, sliceNormedDeviationVectors, slicePosterior, *m_temp);
-            else
-            {
-                Matrix<ElemType> sliceMeanGradient = Input(1)->GradientFor(fr);
-                BackpropToMean(sliceMeanGradient, sliceGradientValue, sliceNormedDeviationVectors, slicePosterior, *m_temp);
-            }
-        }
-        break;
-        case 2:
-        {
-            Matrix<ElemType> sliceNormedDeviation = DataFor(*m_normedDeviation, fr);
-            if (colsPrior == 1)
-                BackpropToLogStddev(Input(2)->Gradient(), sliceGradientValue, sliceNormedDeviation, slicePosterior, *m_temp);
-            else
-            {
-                Matrix<ElemType> sliceLotStddevGradient = Input(2)->GradientFor(fr);
-                BackpropToLogStddev(sliceLotStddevGradient, sliceGradientValue, sliceNormedDeviation, slicePosterior, *m_temp);
-            }
-        }
-        break;
-        case 3:
-        {
-            Matrix<ElemType> sliceNormedDeviationVectors = DataFor(*m_normedDeviationVectors, fr);
-            Matrix<ElemType> sliceFeatureGradient = Input(3)->GradientFor(fr);
-            BackpropToFeature(sliceFeatureGradient, sliceGradientValue, sliceNormedDeviationVectors, slicePosterior, *m_temp);
-        }
-        break;
-        default:
-            InvalidArgument("GMMLogLikelihoodNode criterion only takes four inputs.");
-        }
+        // parameters shared by all samples receive the gradient summed over the minibatch
+        Matrix<ElemType> sliceInputGradient = colsPrior == 1 && inputIndex != 3 ? Input(inputIndex)->Gradient().ColumnSlice(0, 1) : Input(inputIndex)->GradientFor(fr);
+        sliceInputGradient.AddGMMLogLikelihoodGradient(inputIndex, sliceGradientValue, sliceLogPrior, slicePosterior, sliceNormedDeviation, sliceNormedDeviationVectors);
     }
 
     virtual bool OutputUsedInComputingInputNodesGradients() const override
@@ -121,83 +82,6 @@ public:
         return false;
     }
 
-    void BackpropToUnnormedPrior(Matrix<ElemType>& unnormedPriorGradientValues, const Matrix<ElemType>& gradientValues,
-                                 const Matrix<ElemType>& prior, const Matrix<ElemType>& posterior, Matrix<ElemType>& temp)
-    {
-        temp.AssignDifferenceOf(posterior, prior);
-        temp.RowElementMultiplyWith(gradientValues);
-        if (prior.GetNumCols() == posterior.GetNumCols())
-            unnormedPriorGradientValues += temp;
-        else if (prior.GetNumCols() == 1)
-            Matrix<ElemType>::MultiplyAndAdd(temp, false, ConstOnes(posterior.GetNumCols(), 1, unnormedPriorGradientValues.GetDeviceId()), false, unnormedPriorGradientValues);
-        else
-            RuntimeError("GMMLogLikelihoodNode: UnnormedPrior should either have same number of columns as the features or have only one column.");
-    }
-
-    void BackpropToMean(Matrix<ElemType>& meanGradientValues, const Matrix<ElemType>& gradientValues, const Matrix<ElemType>& normedDeviationVectors,
-                        Matrix<ElemType>& posterior, Matrix<ElemType>& temp)
-    {
-        size_t numComponent = posterior.GetNumRows();
-        size_t numSamples = posterior.GetNumCols();
-        size_t featureSize = normedDeviationVectors.GetNumRows() / numComponent;
-
-        temp.SetValue(normedDeviationVectors); // recall normedDeviationVectors <-- (x-u_c)/(stddev^2)
-        temp.Reshape(featureSize, numSamples * numComponent);
-
-        posterior.Reshape(1, numSamples * numComponent);
-        temp.RowElementMultiplyWith(posterior); // temp <-- posterior * (x-u_c)/(stddev^2)
-
-        posterior.Reshape(numComponent, numSamples);          // reshape back
-        temp.Reshape(featureSize * numComponent, numSamples); // reshape back
-
-        temp.RowElementMultiplyWith(gradientValues);
-
-        if (numSamples == meanGradientValues.GetNumCols())
-            meanGradientValues += temp;
-        else if (meanGradientValues.GetNumCols() == 1)
-            Matrix<ElemType>::MultiplyAndAdd(temp, false, ConstOnes(numSamples, 1, meanGradientValues.GetDeviceId()), false, meanGradientValues);
-        else
-            RuntimeError("GMMLogLikelihoodNode: stddev should either have same number of columns as the features or have only one column.");
-    }
-
-    void BackpropToLogStddev(Matrix<ElemType>& logStddevGradientValues, const Matrix<ElemType>& gradientValues, const Matrix<ElemType>& normedDeviation,
-                             const Matrix<ElemType>& posterior, Matrix<ElemType>& temp)
-    {
-        size_t numComponent = posterior.GetNumRows();
-        size_t numSamples = posterior.GetNumCols();
-
-        temp.AssignDifferenceOf(normedDeviation, (ElemType) numComponent);
-        temp.ElementMultiplyWith(posterior);
-        temp.RowElementMultiplyWith(gradientValues);
-        if (logStddevGradientValues.GetNumCols() == numSamples)
-            logStddevGradientValues += temp;
-        else if (logStddevGradientValues.GetNumCols() == 1)
-            Matrix<ElemType>::MultiplyAndAdd(temp, false, ConstOnes(numSamples, 1, logStddevGradientValues.GetDeviceId()), false, logStddevGradientValues);
-        else
-            RuntimeError("GMMLogLikelihoodNode: stddev should either have same number of columns as the features or have only one column.");
-    }
-
-    void BackpropToFeature(Matrix<ElemType>& featureGradientValues, const Matrix<ElemType>& gradientValues, const Matrix<ElemType>& normedDeviationVectors,
-                           Matrix<ElemType>& posterior, Matrix<ElemType>& temp)
-    {
-        size_t numComponent = posterior.GetNumRows();
-        size_t numSamples = posterior.GetNumCols();
-        size_t featureSize = normedDeviationVectors.GetNumRows() / numComponent;
-
-        temp.SetValue(normedDeviationVectors);
-        temp *= -1;
-        temp.Reshape(featureSize, numSamples * numComponent);
-        posterior.Reshape(1, numSamples * numComponent);
-        temp.RowElementMultiplyWith(posterior);
-
-        posterior.Reshape(numComponent, numSamples);
-        temp.Reshape(featureSize * numComponent, numSamples);
-        temp.RowElementMultiplyWith(gradientValues);
-
-        for (int i = 0; i < numComponent; i++)
-            featureGradientValues.AddWithRowSliceValuesOf(temp, i * featureSize, featureSize);
-    }
-
     virtual void UpdateFunctionMBSize() override
     {
         Base::UpdateFunctionMBSize();
@@ -208,13 +92,14 @@ public:
         size_t featureSize = Input(3)->GetSampleMatrixNumRows();
 
         m_prior->Resize(numComponents, colsPrior);
-        m_stddev->Resize(numComponents, colsPrior);
         m_normedDeviation->Resize(numComponents, numCols);
         m_normedDeviationVectors->Resize(numComponents * featureSize, numCols);
         m_posterior->Resize(numComponents, numCols);
     }
 
     // input0=unnormedPrior, input1=mean, input2=logstddev, input3=feature
+    // The mixture densities of all frames are evaluated by one fused kernel (log-sum-exp over the components), which also
+    // keeps the posteriors and normed deviations that BackpropTo() needs.
     virtual void /*ComputationNode::*/ ForwardProp(const FrameRange& fr) override
     {
         size_t colsPrior = Input(0)->GetSampleMatrixNumCols();
@@ -229,8 +114,9 @@ public:
 
         if (colsPrior == 1)
         {
-            ForwardPropS(sliceOutputValue, Input(0)->Value(), Input(1)->Value(), Input(2)->Value(), sliceFeature,
-                         *m_prior, *m_stddev, sliceNormedDeviationVectors, sliceNormedDeviation, slicePosterior, *m_temp);
+            m_prior->AssignLogSoftmaxOf(Input(0)->Value(), true); // log prior
+            sliceOutputValue.AssignGMMLogLikelihoodOf(*m_prior, Input(1)->Value(), Input(2)->Value(), sliceFeature,
+                                                      slicePosterior, sliceNormedDeviation, sliceNormedDeviationVectors);
         }
         else if (colsPrior == numSamples)
         {
@@ -238,89 +124,18 @@ public:
             Matrix<ElemType> sliceMean = Input(1)->ValueFor(fr);
             Matrix<ElemType> sliceLogstddev = Input(2)->ValueFor(fr);
 
-            Matrix<ElemType> slicePrior = DataFor(*m_prior, fr);
-            Matrix<ElemType> sliceStddev = DataFor(*m_stddev, fr);
-
-            ForwardPropS(sliceOutputValue, sliceUnnormedPrior, sliceMean, sliceLogstddev, sliceFeature,
-                         slicePrior, sliceStddev, sliceNormedDeviationVectors, sliceNormedDeviation, slicePosterior, *m_temp);
+            Matrix<ElemType> sliceLogPrior = DataFor(*m_prior, fr);
+            sliceLogPrior.AssignLogSoftmaxOf(sliceUnnormedPrior, true);
+            sliceOutputValue.AssignGMMLogLikelihoodOf(sliceLogPrior, sliceMean, sliceLogstddev, sliceFeature,
+                                                      slicePosterior, sliceNormedDeviation, sliceNormedDeviationVectors);
         }
         else // should not reach the code since validation should fail already
             RuntimeError("GMMLogLikelihoodNode: UnnormedPrior should either have same number of columns as the features or have only one column.");
-    }
-
-    // input0=unnormedPrior, input1=mean, input2=logstddev, input3=feature
-    // If we want to speed up we need to replace following code with a several specialized GPU functions
-    /*TODO: merge with call site*/ void ForwardPropS(Matrix<ElemType>& functionValues, const Matrix<ElemType>& unnormedPrior, const Matrix<ElemType>& mean, Matrix<ElemType>& logstddev,
-                                                     const Matrix<ElemType>& feature, Matrix<ElemType>& prior, Matrix<ElemType>& stddev, Matrix<ElemType>& normedDeviationVectors,
-                                                     Matrix<ElemType>& normedDeviation, Matrix<ElemType>& posterior, Matrix<ElemType>& temp)
-    {
-        int numComponent = unnormedPrior.GetNumRows();
-        size_t numSamples = feature.GetNumCols();
-        size_t featureDim = feature.GetNumRows();
-
-        // compute prior which is softmax of unnormedPrior
-        prior.AssignLogSoftmaxOf(unnormedPrior, true); // log prior
-
-        prior.InplaceExp();
-
-        // compute stddev
-        stddev.AssignExpOf(logstddev);
 
 #if DUMPOUTPUT
-        unnormedPrior.Print("unnormedPrior", 0, min(5, unnormedPrior.GetNumRows() - 1), 0, min(10, unnormedPrior.GetNumCols() - 1));
-        mean.Print("mean", 0, min(5, mean.GetNumRows() - 1), 0, min(10, mean.GetNumCols() - 1));
-        logstddev.Print("logstddev", 0, min(5, logstddev.GetNumRows() - 1), 0, min(10, logstddev.GetNumCols() - 1));
-
-        prior.Print("prior", 0, min(5, prior.GetNumRows() - 1), 0, min(10, prior.GetNumCols() - 1));
-        stddev.Print("stddev", 0, min(5, stddev.GetNumRows() - 1), 0, min(10, stddev.GetNumCols() - 1));
-#endif
-
-        // compute normedDeviation <-- ||x-u_c||^2/(stddev^2)
-        normedDeviationVectors.AssignRepeatOf(feature, numComponent, 1);
-        normedDeviationVectors -= mean;                                        // each column of the mean has multiple mean components
-        normedDeviationVectors.Reshape(featureDim, numSamples * numComponent); // now each column is feature-mean_i
-
-        normedDeviation.AssignVectorNorm2Of(normedDeviationVectors, true);
-        normedDeviation ^= 2;
-        temp.AssignRepeatOf(stddev, 1, numSamples / stddev.GetNumCols()); // stddev.GetNumCols() is either 1 or =numSamples
-        temp.Reshape(1, temp.GetNumElements());                           // one stddev value for each component for each sample
-        temp ^= 2;
-        normedDeviation.ElementDivideBy(temp); // normedDeviation and temp have same dim (1, numSamples* numComponent)
-
-        // compute  normedDeviationVectors <-- (x-u_c)/(stddev^2)
-        normedDeviationVectors.RowElementDivideBy(temp);                       // divide twice
-        normedDeviationVectors.Reshape(featureDim * numComponent, numSamples); // reshape back
-
-        // compute per-component likelihood
-        posterior.AssignProductOf(-0.5f, normedDeviation); // posterior  <-- -||x-u_c||^2/(stddev^2)/2 and in (1, numSamples* numComponent) dim
-        temp.InplaceLog();
-        temp *= ((ElemType) numComponent / 2.0f);                   // temp <-- stddev^c and in (1, numSamples* numComponent) dim
-        posterior -= temp;                                          // posterior  <-- exp[-||x-u_c||^2/(stddev^2)/2]/(stddev^c)
-        posterior -= (ElemType)(numComponent / 2.0f * log(TWO_PI)); // likelihood for each component and sample is now computed and stored in posterior
-        posterior.InplaceExp();                                     // posterior  <-- exp(-||x-u_c||^2/(stddev^2)/2)
-
-        normedDeviation.Reshape(numComponent, numSamples); // reshape back
-        posterior.Reshape(numComponent, numSamples);       // reshape back
-
-        // compute posterior <-- prior_i * likelihood_i
-        if (unnormedPrior.GetNumCols() == numSamples) // each sample has different prior
-            posterior.ElementMultiplyWith(prior);
-        else // all samples share the same prior
-            posterior.ColumnElementMultiplyWith(prior);
-
-        // compute GMM log-likelihood
-        Matrix<ElemType>::Multiply(ConstOnes(1, numComponent, posterior.GetDeviceId()), false, posterior, false, functionValues); // functionValues <-- total likelihood
-        posterior.RowElementDivideBy(functionValues);                                                                             // posterior <-- per-comp likelihood / total likelihood
-        functionValues.InplaceLog();                                                                                              // log likelihood
-
-#if DUMPOUTPUT
-        temp.Print("temp", 0, min(5, temp.GetNumRows() - 1), 0, min(10, temp.GetNumCols() - 1));
-        normedDeviation.Print("normedDeviation", 0, min(5, normedDeviation.GetNumRows() - 1), 0, min(10, normedDeviation.GetNumCols() - 1));
-
-        posterior.Print("posterior", 0, min(5, posterior.GetNumRows() - 1), 0, min(10, posterior.GetNumCols() - 1));
-        functionValues.Print("functionValues", 0, min(5, functionValues.GetNumRows() - 1), 0, min(10, functionValues.GetNumCols() - 1));
-
-        functionValues.Print("GMMLogLikelihoodNode");
+        m_prior->Print("logPrior", 0, min(5, m_prior->GetNumRows() - 1), 0, min(10, m_prior->GetNumCols() - 1));
+        slicePosterior.Print("posterior", 0, min(5, slicePosterior.GetNumRows() - 1), 0, min(10, slicePosterior.GetNumCols() - 1));
+        sliceOutputValue.Print("GMMLogLikelihoodNode");
 #endif
     }
 
@@ -359,7 +174,6 @@ public:
             *node->m_prior = *m_prior;
             *node->m_normedDeviation = *m_normedDeviation;
             *node->m_normedDeviationVectors = *m_normedDeviationVectors;
-            *node->m_stddev = *m_stddev;
             *node->m_posterior = *m_posterior;
         }
     }
@@ -371,9 +185,7 @@ public:
         RequestMatrixFromPool(m_prior, matrixPool);
         RequestMatrixFromPool(m_normedDeviation, matrixPool);
         RequestMatrixFromPool(m_normedDeviationVectors, matrixPool);
-        RequestMatrixFromPool(m_stddev, matrixPool);
         RequestMatrixFromPool(m_posterior, matrixPool);
-        RequestMatrixFromPool(m_temp, matrixPool);
     }
 
     // release gradient and temp matrices that no longer needed after all the children's gradients are computed.
@@ -383,18 +195,14 @@ public:
         ReleaseMatrixToPool(m_prior, matrixPool);
         ReleaseMatrixToPool(m_normedDeviation, matrixPool);
         ReleaseMatrixToPool(m_normedDeviationVectors, matrixPool);
-        ReleaseMatrixToPool(m_stddev, matrixPool);
         ReleaseMatrixToPool(m_posterior, matrixPool);
-        ReleaseMatrixToPool(m_temp, matrixPool);
     }
 
 protected:
-    shared_ptr<Matrix<ElemType>> m_prior;
+    shared_ptr<Matrix<ElemType>> m_prior; // log of the normalized prior
     shared_ptr<Matrix<ElemType>> m_normedDeviation;
     shared_ptr<Matrix<ElemType>> m_normedDeviationVectors;
-    shared_ptr<Matrix<ElemType>> m_stddev;
     shared_ptr<Matrix<ElemType>> m_posterior;
-    shared_ptr<Matrix<ElemType>> m_temp;
 };
 
 template class GMMLogLikelihoodNode<float>;
@@ -532,6 +340,9 @@ public:
 #endif
     }
 
+    // the lattices of the minibatch are processed on the host
+    virtual bool /*ComputationNodeBase::*/ IsGraphCapturable() const override { return false; }
+
     virtual void /*ComputationNodeBase::*/ Validate(bool isFinalValidationPass) override
     {
         Base::Validate(isFinalValidationPass);
@@ -602,7 +413,8 @@ public:
     void SetFrameDropThresh(double frameDropThresh) { m_frameDropThreshold = frameDropThresh; }
     void SetReferenceAlign(const bool doreferencealign) { m_doReferenceAlignment = doreferencealign; }
 
-    void SetGammarCalculationParam(const double& amf, const double& lmf, const double& wp, const double& bMMIfactor, const bool& sMBR)
+    void SetGammarCalculationParam(const double& amf, const double& lmf, const double& wp, const double& bMMIfactor, const bool& sMBR, const size_t& latticeCacheSizeMB = 0,
+                                   const double& latticePruneBeam = 0)
     {
         msra::lattices::SeqGammarCalParam param;
         param.amf = amf;
@@ -610,6 +422,8 @@ public:
         param.wp = wp;
         param.bMMIfactor = bMMIfactor;
         param.sMBRmode = sMBR;
+        param.latticeCacheSizeMB = latticeCacheSizeMB;
+        param.latticePruneBeam = latticePruneBeam;
         m_gammaCalculator.SetGammarCalculationParams(param);
     }
 
@@ -646,6 +460,587 @@ protected:
 template class SequenceWithSoftmaxNode<float>;
 template class SequenceWithSoftmaxNode<double>;
 
+// -----------------------------------------------------------------------
+// LatticeFreeMMINode (labels, logLikelihoods)
+// lattice-free MMI sequence training criterion: log Z(denominator graph) - log p(numerator), summed over all sequences
+//  - labels: the numerator supervision, a dense one-hot frame alignment to the pdfs [P x T]
+//  - logLikelihoods: the network output, unnormalized pdf log-likelihoods [P x T]
+// The denominator is a phone-level graph shared by all utterances, given by 'denominatorGraph': a text file in the
+// format printed by OpenFst's fstprint, e.g. Kaldi's den.fst. Each arc line is "src dst ilabel olabel [cost]" with
+// ilabel = pdf + 1 (as in Kaldi), the cost being -log of the transition probability; a final state is "state [cost]".
+// The start state is the source of the first arc. The graph is read once, and kept on the device as sparse matrices
+// of its arcs, such that the forward-backward of all parallel sequences of a minibatch runs as one sparse product per
+// step (see ForwardPropNonLooping()); no per-utterance lattices are needed. Like Kaldi's chain models, the
+// log-likelihoods are clipped to [-30, 30] in the denominator, and the forward and backward probabilities are
+// renormalized at every frame.
+// Every sequence must lie entirely in its minibatch (no truncated BPTT). Only the path of the graph is saved with the
+// model; a model must be loaded where the graph can still be read, if it is trained further with this criterion.
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+class LatticeFreeMMINode : public ComputationNodeNonLooping /*ComputationNode*/<ElemType>, public NumInputs<2>
+{
+    typedef ComputationNodeNonLooping<ElemType> Base;
+    UsingComputationNodeMembersBoilerplate;
+    static const std::wstring TypeName()
+    {
+        return L"LatticeFreeMMI";
+    }
+
+public:
+    LatticeFreeMMINode(DEVICEID_TYPE deviceId, const wstring& name, const wstring& denominatorGraph = L"")
+        : Base(deviceId, name),
+          m_denominatorGraph(denominatorGraph),
+          m_arcSources(deviceId),
+          m_arcDestinations(deviceId),
+          m_arcPdfs(deviceId),
+          m_startState(deviceId),
+          m_finalWeights(deviceId),
+          m_sequenceStarts(deviceId),
+          m_sequenceEnds(deviceId),
+          m_notSequenceStarts(deviceId),
+          m_notSequenceEnds(deviceId),
+          m_gaps(deviceId),
+          m_emissions(deviceId),
+          m_alpha(deviceId),
+          m_beta(deviceId),
+          m_predecessors(deviceId),
+          m_arcScores(deviceId),
+          m_arcEmissions(deviceId),
+          m_arcSuccessors(deviceId),
+          m_columnSums(deviceId),
+          m_logScales(deviceId),
+          m_logFinalScores(deviceId),
+          m_logSum(deviceId),
+          m_denominatorPosteriors(deviceId),
+          m_needRecomputePosteriors(false)
+    {
+    }
+    LatticeFreeMMINode(const ScriptableObjects::IConfigRecordPtr configp)
+        : LatticeFreeMMINode(configp->Get(L"deviceId"), L"<placeholder>", configp->Get(L"denominatorGraph"))
+    {
+        AttachInputs(configp, this->GetExpectedNumInputs());
+    }
+
+    virtual void Save(File& fstream) const override
+    {
+        Base::Save(fstream);
+        fstream << m_denominatorGraph;
+    }
+
+    virtual void Load(File& fstream, size_t modelVersion) override
+    {
+        Base::Load(fstream, modelVersion);
+        fstream >> m_denominatorGraph;
+    }
+
+    virtual void CopyTo(ComputationNodeBasePtr nodeP, const std::wstring& newName, const CopyNodeFlags flags) const override
+    {
+        Base::CopyTo(nodeP, newName, flags);
+        if (flags & CopyNodeFlags::copyNodeValue)
+        {
+            auto node = dynamic_pointer_cast<LatticeFreeMMINode<ElemType>>(nodeP);
+            node->m_denominatorGraph = m_denominatorGraph;
+        }
+    }
+
+    virtual void BackpropToNonLooping(size_t inputIndex) override
+    {
+        FrameRange fr(Input(0)->GetMBLayout());
+        if (inputIndex == 0)
+            InvalidArgument("%ls %ls operation: The labels have no gradient.", NodeName().c_str(), OperationName().c_str());
+
+        if (m_needRecomputePosteriors)
+            ComputeDenominatorPosteriors();
+
+        // gradient of log Z - log p(numerator): denominator posteriors - numerator posteriors
+        auto gradient = Input(1)->GradientFor(fr);
+        Matrix<ElemType>::AddScaledDifference(Gradient() /*1x1*/, m_denominatorPosteriors, Input(0)->ValueFor(fr), gradient);
+        MaskMissingColumnsToZero(gradient, Input(1)->GetMBLayout(), fr);
+    }
+
+    virtual bool OutputUsedInComputingInputNodesGradients() const override
+    {
+        return false;
+    }
+
+    virtual void /*ComputationNodeNonLooping::*/ ForwardPropNonLooping() override
+    {
+        FrameRange fr(Input(0)->GetMBLayout());
+        if (m_arcPdfs.IsEmpty())
+            LoadDenominatorGraph();
+        SetSequenceMasks(Input(1)->GetMBLayout());
+
+        const size_t numParallelSequences = Input(1)->GetMBLayout()->GetNumParallelSequences();
+        const size_t numTimeSteps = Input(1)->GetMBLayout()->GetNumTimeSteps();
+        const size_t numCols = numParallelSequences * numTimeSteps;
+
+        // pdf likelihoods, zero in the gaps
+        m_emissions.SetValue(Input(1)->ValueFor(fr));
+        m_emissions.InplaceTruncate(30);
+        m_emissions.InplaceExp();
+        MaskMissingColumnsToZero(m_emissions, Input(1)->GetMBLayout(), fr);
+
+        // forward: alpha_t = destinations * ((sources' * alpha_{t-1}) .* (pdfs * emissions_t)), normalized per column
+        m_alpha.Resize(m_startState.GetNumRows(), numCols);
+        m_logScales.Resize(1, numCols);
+        for (size_t t = 0; t < numTimeSteps; t++)
+        {
+            ComputePredecessors(t, numParallelSequences);
+            ComputeArcEmissions(t, numParallelSequences);
+            Matrix<ElemType>::MultiplyAndWeightedAdd(1, m_arcSources, true, m_predecessors, false, 0, m_arcScores);
+            m_arcScores.ElementMultiplyWith(m_arcEmissions);
+            auto alpha = m_alpha.ColumnSlice(t * numParallelSequences, numParallelSequences);
+            Matrix<ElemType>::MultiplyAndWeightedAdd(1, m_arcDestinations, false, m_arcScores, false, 0, alpha);
+            Matrix<ElemType>::VectorSum(alpha, m_columnSums, true);
+            alpha.RowElementDivideBy(m_columnSums); // (a gap sums to 0, and stays 0)
+            m_logScales.SetColumnSlice(m_columnSums, t * numParallelSequences, numParallelSequences);
+        }
+
+        // log Z = the sum of the log scales, and the log final weight at the last frame of each sequence
+        m_logScales += m_gaps;
+        m_logScales.InplaceLog();
+        Matrix<ElemType>::MultiplyAndWeightedAdd(1, m_finalWeights, true, m_alpha, false, 0, m_logFinalScores);
+        m_logFinalScores.ElementMultiplyWith(m_sequenceEnds);
+        m_logFinalScores += m_notSequenceEnds;
+        m_logFinalScores.InplaceLog();
+
+        // the numerator log-likelihood is that of the alignment
+        Value().AssignInnerProductOfMatrices(Input(0)->MaskedValueFor(fr), Input(1)->MaskedValueFor(fr));
+        Value() *= -1;
+        m_logSum.AssignSumOfElements(m_logScales);
+        Value() += m_logSum;
+        m_logSum.AssignSumOfElements(m_logFinalScores);
+        Value() += m_logSum;
+#if NANCHECK
+        Value().HasNan("LatticeFreeMMI");
+#endif
+        m_needRecomputePosteriors = true;
+    }
+
+    // the denominator graph is processed on the host
+    virtual bool /*ComputationNodeBase::*/ IsGraphCapturable() const override { return false; }
+
+    virtual void /*ComputationNodeBase::*/ Validate(bool isFinalValidationPass) override
+    {
+        Base::Validate(isFinalValidationPass);
+        m_pMBLayout = nullptr; // this node does not hold mini-batch data
+
+        if (isFinalValidationPass)
+        {
+            if (!Input(0)->HasMBLayout() || Input(0)->GetMBLayout() != Input(1)->GetMBLayout())
+                LogicError("%ls %ls operation requires the labels and the log-likelihoods to be minibatches with the same layout.", NodeName().c_str(), OperationName().c_str());
+            if (Input(0)->GetSampleMatrixNumRows() != Input(1)->GetSampleMatrixNumRows())
+                InvalidArgument("%ls %ls operation: The dimension of the labels (%d) does not match that of the log-likelihoods (%d).", NodeName().c_str(), OperationName().c_str(),
+                                (int) Input(0)->GetSampleMatrixNumRows(), (int) Input(1)->GetSampleMatrixNumRows());
+            if (m_denominatorGraph.empty())
+                InvalidArgument("%ls %ls operation: No denominatorGraph was given.", NodeName().c_str(), OperationName().c_str());
+        }
+
+        SetDims(TensorShape(1), false);
+    }
+
+    // the sparse products of the forward pass, per frame
+    virtual double EstimateForwardFlops() const override
+    {
+        return 6.0 * m_arcPdfs.GetNumRows() * Input(1)->GetSampleMatrixNumCols();
+    }
+
+private:
+    // reads the graph, and sets the arc matrices on the device
+    void LoadDenominatorGraph()
+    {
+        File file(m_denominatorGraph, FileOptions::fileOptionsText | FileOptions::fileOptionsRead);
+        std::vector<std::string> lines;
+        file.GetLines(lines);
+
+        std::vector<CPUSPARSE_INDEX_TYPE> sources, destinations, pdfs;
+        std::vector<ElemType> weights;
+        std::map<size_t, double> finalCosts;
+        size_t numStates = 0;
+        const size_t numPdfs = Input(1)->GetSampleMatrixNumRows();
+        for (const auto& line : lines)
+        {
+            if (line.empty() || line[0] == '#')
+                continue;
+            int src, dst, ilabel, olabel;
+            double cost = 0;
+            int numFields = sscanf(line.c_str(), "%d %d %d %d %lf", &src, &dst, &ilabel, &olabel, &cost);
+            if (numFields >= 4)
+            {
+                if (src < 0 || dst < 0 || ilabel < 1 || ilabel > (int) numPdfs)
+                    InvalidArgument("%ls %ls operation: Invalid arc '%s' in the denominator graph '%ls', which has pdfs 1..%d as input labels.",
+                                    NodeName().c_str(), OperationName().c_str(), line.c_str(), m_denominatorGraph.c_str(), (int) numPdfs);
+                sources.push_back(src);
+                destinations.push_back(dst);
+                pdfs.push_back(ilabel - 1);
+                weights.push_back((ElemType) exp(-cost));
+                numStates = max(numStates, (size_t) max(src, dst) + 1);
+            }
+            else if (sscanf(line.c_str(), "%d %lf", &src, &cost) >= 1 && src >= 0)
+            {
+                if (numFields < 2)
+                    cost = 0;
+                finalCosts[src] = cost;
+                numStates = max(numStates, (size_t) src + 1);
+            }
+            else
+                InvalidArgument("%ls %ls operation: Invalid line '%s' in the denominator graph '%ls'.", NodeName().c_str(), OperationName().c_str(), line.c_str(), m_denominatorGraph.c_str());
+        }
+        if (sources.empty() || finalCosts.empty())
+            InvalidArgument("%ls %ls operation: The denominator graph '%ls' has no arcs or no final states.", NodeName().c_str(), OperationName().c_str(), m_denominatorGraph.c_str());
+
+        // sources and destinations [Q x A]: one entry per arc (column), the destinations weighted by the transition probability
+        const size_t numArcs = sources.size();
+        std::vector<CPUSPARSE_INDEX_TYPE> arcOffsets(numArcs + 1);
+        std::vector<ElemType> ones(numArcs, 1);
+        for (size_t a = 0; a <= numArcs; a++)
+            arcOffsets[a] = (CPUSPARSE_INDEX_TYPE) a;
+        m_arcSources.SwitchToMatrixType(MatrixType::SPARSE, matrixFormatSparseCSC, false);
+        m_arcSources.SetMatrixFromCSCFormat(arcOffsets.data(), sources.data(), ones.data(), numArcs, numStates, numArcs);
+        m_arcDestinations.SwitchToMatrixType(MatrixType::SPARSE, matrixFormatSparseCSC, false);
+        m_arcDestinations.SetMatrixFromCSCFormat(arcOffsets.data(), destinations.data(), weights.data(), numArcs, numStates, numArcs);
+
+        // pdfs [A x P]: the arcs of each pdf (column)
+        std::vector<CPUSPARSE_INDEX_TYPE> pdfOffsets(numPdfs + 1, 0), pdfArcs(numArcs);
+        for (auto pdf : pdfs)
+            pdfOffsets[pdf + 1]++;
+        for (size_t p = 0; p < numPdfs; p++)
+            pdfOffsets[p + 1] += pdfOffsets[p];
+        std::vector<CPUSPARSE_INDEX_TYPE> next(pdfOffsets.begin(), pdfOffsets.end() - 1);
+        for (size_t a = 0; a < numArcs; a++)
+            pdfArcs[next[pdfs[a]]++] = (CPUSPARSE_INDEX_TYPE) a;
+        m_arcPdfs.SwitchToMatrixType(MatrixType::SPARSE, matrixFormatSparseCSC, false);
+        m_arcPdfs.SetMatrixFromCSCFormat(pdfOffsets.data(), pdfArcs.data(), ones.data(), numArcs, numArcs, numPdfs);
+
+        // the start state and the final weights [Q x 1]
+        std::vector<ElemType> startState(numStates, 0), finalWeights(numStates, 0);
+        startState[sources[0]] = 1;
+        for (const auto& finalCost : finalCosts)
+            finalWeights[finalCost.first] = (ElemType) exp(-finalCost.second);
+        m_startState.SetValue(numStates, 1, m_deviceId, startState.data());
+        m_finalWeights.SetValue(numStates, 1, m_deviceId, finalWeights.data());
+
+        fprintf(stderr, "%ls %ls operation: Read the denominator graph '%ls' with %d states and %d arcs.\n",
+                NodeName().c_str(), OperationName().c_str(), m_denominatorGraph.c_str(), (int) numStates, (int) numArcs);
+    }
+
+    // [1 x (T * S)] rows that mark the first and the last frame of each sequence, and the gaps
+    void SetSequenceMasks(const MBLayoutPtr& pMBLayout)
+    {
+        const size_t numParallelSequences = pMBLayout->GetNumParallelSequences();
+        const size_t numTimeSteps = pMBLayout->GetNumTimeSteps();
+        const size_t numCols = numParallelSequences * numTimeSteps;
+        std::vector<ElemType> starts(numCols, 0), ends(numCols, 0), gaps(numCols, 1);
+        for (const auto& seq : pMBLayout->GetAllSequences())
+        {
+            if (seq.seqId == GAP_SEQUENCE_ID)
+                continue;
+            if (seq.tBegin < 0 || seq.tEnd > numTimeSteps)
+                InvalidArgument("%ls %ls operation requires each sequence to be entirely in its minibatch, truncated sequences are not supported.", NodeName().c_str(), OperationName().c_str());
+            starts[seq.tBegin * numParallelSequences + seq.s] = 1;
+            ends[(seq.tEnd - 1) * numParallelSequences + seq.s] = 1;
+            for (size_t t = seq.tBegin; t < seq.tEnd; t++)
+                gaps[t * numParallelSequences + seq.s] = 0;
+        }
+        m_sequenceStarts.SetValue(1, numCols, m_deviceId, starts.data());
+        m_sequenceEnds.SetValue(1, numCols, m_deviceId, ends.data());
+        m_gaps.SetValue(1, numCols, m_deviceId, gaps.data());
+        m_notSequenceStarts.AssignDifferenceOf(1, m_sequenceStarts);
+        m_notSequenceEnds.AssignDifferenceOf(1, m_sequenceEnds);
+    }
+
+    // the state distribution before frame t [Q x S]: alpha_{t-1}, or the start state where a sequence starts
+    void ComputePredecessors(size_t t, size_t numParallelSequences)
+    {
+        auto starts = m_sequenceStarts.ColumnSlice(t * numParallelSequences, numParallelSequences);
+        if (t == 0)
+        {
+            Matrix<ElemType>::MultiplyAndWeightedAdd(1, m_startState, false, starts, false, 0, m_predecessors);
+            return;
+        }
+        m_predecessors.SetValue(m_alpha.ColumnSlice((t - 1) * numParallelSequences, numParallelSequences));
+        m_predecessors.RowElementMultiplyWith(m_notSequenceStarts.ColumnSlice(t * numParallelSequences, numParallelSequences));
+        Matrix<ElemType>::MultiplyAndWeightedAdd(1, m_startState, false, starts, false, 1, m_predecessors);
+    }
+
+    // the likelihood of the pdf of each arc at frame t [A x S]
+    void ComputeArcEmissions(size_t t, size_t numParallelSequences)
+    {
+        Matrix<ElemType>::MultiplyAndWeightedAdd(1, m_arcPdfs, false, m_emissions.ColumnSlice(t * numParallelSequences, numParallelSequences), false, 0, m_arcEmissions);
+    }
+
+    // backward pass; the arc posteriors of each frame are summed into the pdf posteriors of the denominator
+    void ComputeDenominatorPosteriors()
+    {
+        const size_t numParallelSequences = Input(1)->GetMBLayout()->GetNumParallelSequences();
+        const size_t numTimeSteps = Input(1)->GetMBLayout()->GetNumTimeSteps();
+        m_denominatorPosteriors.Resize(m_arcPdfs.GetNumCols(), numParallelSequences * numTimeSteps);
+        for (size_t t = numTimeSteps; t-- > 0;)
+        {
+            // beta_t = sources * successors_{t+1}, or the final weights at the last frame of a sequence
+            auto ends = m_sequenceEnds.ColumnSlice(t * numParallelSequences, numParallelSequences);
+            if (t + 1 == numTimeSteps)
+                Matrix<ElemType>::MultiplyAndWeightedAdd(1, m_finalWeights, false, ends, false, 0, m_beta);
+            else
+            {
+                Matrix<ElemType>::MultiplyAndWeightedAdd(1, m_arcSources, false, m_arcSuccessors, false, 0, m_beta);
+                m_beta.RowElementMultiplyWith(m_notSequenceEnds.ColumnSlice(t * numParallelSequences, numParallelSequences));
+                Matrix<ElemType>::MultiplyAndWeightedAdd(1, m_finalWeights, false, ends, false, 1, m_beta);
+            }
+            Matrix<ElemType>::VectorSum(m_beta, m_columnSums, true);
+            m_beta.RowElementDivideBy(m_columnSums);
+
+            // successors_t = (destinations' * beta_t) .* (pdfs * emissions_t), the arc scores without their predecessors
+            ComputeArcEmissions(t, numParallelSequences);
+            Matrix<ElemType>::MultiplyAndWeightedAdd(1, m_arcDestinations, true, m_beta, false, 0, m_arcSuccessors);
+            m_arcSuccessors.ElementMultiplyWith(m_arcEmissions);
+
+            // arc posteriors = (sources' * predecessors_t) .* successors_t, normalized per column
+            ComputePredecessors(t, numParallelSequences);
+            Matrix<ElemType>::MultiplyAndWeightedAdd(1, m_arcSources, true, m_predecessors, false, 0, m_arcScores);
+            m_arcScores.ElementMultiplyWith(m_arcSuccessors);
+            Matrix<ElemType>::VectorSum(m_arcScores, m_columnSums, true);
+            m_arcScores.RowElementDivideBy(m_columnSums);
+            auto posteriors = m_denominatorPosteriors.ColumnSlice(t * numParallelSequences, numParallelSequences);
+            Matrix<ElemType>::MultiplyAndWeightedAdd(1, m_arcPdfs, true, m_arcScores, false, 0, posteriors);
+        }
+        m_needRecomputePosteriors = false;
+    }
+
+    std::wstring m_denominatorGraph;
+
+    Matrix<ElemType> m_arcSources;            // [Q x A] sparse, the source state of each arc
+    Matrix<ElemType> m_arcDestinations;       // [Q x A] sparse, the destination state of each arc, weighted by its probability
+    Matrix<ElemType> m_arcPdfs;               // [A x P] sparse, the arcs of each pdf
+    Matrix<ElemType> m_startState;            // [Q x 1] one-hot
+    Matrix<ElemType> m_finalWeights;          // [Q x 1]
+    Matrix<ElemType> m_sequenceStarts;        // [1 x T*S]
+    Matrix<ElemType> m_sequenceEnds;          // [1 x T*S]
+    Matrix<ElemType> m_notSequenceStarts;     // [1 x T*S]
+    Matrix<ElemType> m_notSequenceEnds;       // [1 x T*S]
+    Matrix<ElemType> m_gaps;                  // [1 x T*S]
+    Matrix<ElemType> m_emissions;             // [P x T*S] exp of the clipped log-likelihoods
+    Matrix<ElemType> m_alpha;                 // [Q x T*S] normalized forward probabilities
+    Matrix<ElemType> m_beta;                  // [Q x S] normalized backward probabilities of the current frame
+    Matrix<ElemType> m_predecessors;          // [Q x S]
+    Matrix<ElemType> m_arcScores;             // [A x S]
+    Matrix<ElemType> m_arcEmissions;          // [A x S]
+    Matrix<ElemType> m_arcSuccessors;         // [A x S]
+    Matrix<ElemType> m_columnSums;            // [1 x S]
+    Matrix<ElemType> m_logScales;             // [1 x T*S] log of the normalization of alpha
+    Matrix<ElemType> m_logFinalScores;        // [1 x T*S]
+    Matrix<ElemType> m_logSum;                // [1 x 1]
+    Matrix<ElemType> m_denominatorPosteriors; // [P x T*S]
+    bool m_needRecomputePosteriors;
+};
+
+template class LatticeFreeMMINode<float>;
+template class LatticeFreeMMINode<double>;
+
+// -----------------------------------------------------------------------
+// CTCWithSoftmaxNode (labels, z)
+// connectionist temporal classification (CTC) criterion: -log p(labels | input), summed over all sequences, where p is the sum
+// over all alignments of the label sequence to the frames that may repeat labels and insert blanks, under softmax(z)
+//  - labels: the label sequence of each input sequence [P x T], with the same layout as z: the frames whose column is nonzero
+//    carry the tokens of the sequence in order (one-hot, the argmax is taken), all other columns are 0. Dense or sparse.
+//  - z: the network output, unnormalized log-probabilities [P x T]
+// 'blankTokenId' is the row of the blank in z, which must not be used as a label.
+// The forward-backward of all sequences of the minibatch runs at once on the device (see Matrix::AssignCTCPosteriors()); only
+// the label sequences are read on the host. A sequence with fewer frames than it takes to emit its labels is skipped, with a
+// warning. Every sequence must lie entirely in its minibatch (no truncated BPTT).
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+class CTCWithSoftmaxNode : public ComputationNodeNonLooping /*ComputationNode*/<ElemType>, public NumInputs<2>
+{
+    typedef ComputationNodeNonLooping<ElemType> Base;
+    UsingComputationNodeMembersBoilerplate;
+    static const std::wstring TypeName()
+    {
+        return L"CTCWithSoftmax";
+    }
+
+public:
+    CTCWithSoftmaxNode(DEVICEID_TYPE deviceId, const wstring& name, size_t blankTokenId = 0)
+        : Base(deviceId, name),
+          m_blankTokenId(blankTokenId),
+          m_logSoftmax(deviceId),
+          m_softmax(deviceId),
+          m_posteriors(deviceId),
+          m_stateLabels(deviceId),
+          m_sequences(deviceId),
+          m_alpha(deviceId),
+          m_beta(deviceId),
+          m_logLikelihoods(deviceId)
+    {
+    }
+    CTCWithSoftmaxNode(const ScriptableObjects::IConfigRecordPtr configp)
+        : CTCWithSoftmaxNode(configp->Get(L"deviceId"), L"<placeholder>", configp->Get(L"blankTokenId"))
+    {
+        AttachInputs(configp, this->GetExpectedNumInputs());
+    }
+
+    virtual void Save(File& fstream) const override
+    {
+        Base::Save(fstream);
+        fstream << m_blankTokenId;
+    }
+
+    virtual void Load(File& fstream, size_t modelVersion) override
+    {
+        Base::Load(fstream, modelVersion);
+        fstream >> m_blankTokenId;
+    }
+
+    virtual void CopyTo(ComputationNodeBasePtr nodeP, const std::wstring& newName, const CopyNodeFlags flags) const override
+    {
+        Base::CopyTo(nodeP, newName, flags);
+        if (flags & CopyNodeFlags::copyNodeValue)
+        {
+            auto node = dynamic_pointer_cast<CTCWithSoftmaxNode<ElemType>>(nodeP);
+            node->m_blankTokenId = m_blankTokenId;
+        }
+    }
+
+    virtual void BackpropToNonLooping(size_t inputIndex) override
+    {
+        FrameRange fr(Input(0)->GetMBLayout());
+        if (inputIndex == 0)
+            InvalidArgument("%ls %ls operation: The labels have no gradient.", NodeName().c_str(), OperationName().c_str());
+
+        // gradient of -log p(labels) w.r.t. z: softmax - label posteriors
+        m_softmax.AssignExpOf(m_logSoftmax);
+        auto gradient = Input(1)->GradientFor(fr);
+        Matrix<ElemType>::AddScaledDifference(Gradient() /*1x1*/, m_softmax, m_posteriors, gradient);
+        MaskMissingColumnsToZero(gradient, Input(1)->GetMBLayout(), fr);
+    }
+
+    virtual bool OutputUsedInComputingInputNodesGradients() const override
+    {
+        return false;
+    }
+
+    virtual bool InputUsedInComputingInputNodesGradients(size_t /*childIndex*/) const override
+    {
+        return false;
+    }
+
+    virtual void /*ComputationNodeNonLooping::*/ ForwardPropNonLooping() override
+    {
+        FrameRange fr(Input(0)->GetMBLayout());
+        SetStateLabels(Input(0)->ValueFor(fr), Input(1)->GetMBLayout());
+
+        m_logSoftmax.AssignLogSoftmaxOf(Input(1)->ValueFor(fr), true);
+        m_posteriors.AssignCTCPosteriors(m_logSoftmax, m_stateLabels, m_sequences, Input(1)->GetMBLayout()->GetNumParallelSequences(),
+                                         m_alpha, m_beta, m_logLikelihoods);
+        Value().AssignSumOfElements(m_logLikelihoods);
+        Value() *= -1;
+#if NANCHECK
+        Value().HasNan("CTCWithSoftmax");
+#endif
+    }
+
+    // the label sequences are read on the host
+    virtual bool /*ComputationNodeBase::*/ IsGraphCapturable() const override { return false; }
+
+    virtual void /*ComputationNodeBase::*/ Validate(bool isFinalValidationPass) override
+    {
+        Base::Validate(isFinalValidationPass);
+        m_pMBLayout = nullptr; // this node does not hold mini-batch data
+
+        if (isFinalValidationPass)
+        {
+            if (!Input(0)->HasMBLayout() || Input(0)->GetMBLayout() != Input(1)->GetMBLayout())
+                LogicError("%ls %ls operation requires the labels and the network output to be minibatches with the same layout.", NodeName().c_str(), OperationName().c_str());
+            if (Input(0)->GetSampleMatrixNumRows() != Input(1)->GetSampleMatrixNumRows())
+                InvalidArgument("%ls %ls operation: The dimension of the labels (%d) does not match that of the network output (%d).", NodeName().c_str(), OperationName().c_str(),
+                                (int) Input(0)->GetSampleMatrixNumRows(), (int) Input(1)->GetSampleMatrixNumRows());
+            if (m_blankTokenId >= Input(1)->GetSampleMatrixNumRows())
+                InvalidArgument("%ls %ls operation: The blankTokenId (%d) is out of the range of the network output [0, %d).", NodeName().c_str(), OperationName().c_str(),
+                                (int) m_blankTokenId, (int) Input(1)->GetSampleMatrixNumRows());
+        }
+
+        SetDims(TensorShape(1), false);
+    }
+
+    // the forward and the backward recursion, over 2L+1 states of each frame
+    virtual double EstimateForwardFlops() const override
+    {
+        return 10.0 * Input(1)->GetSampleMatrixNumRows() * Input(1)->GetSampleMatrixNumCols();
+    }
+
+private:
+    // reads the tokens of each sequence from the labels, and sets the states and the sequences for AssignCTCPosteriors()
+    void SetStateLabels(const Matrix<ElemType>& labelsValue, const MBLayoutPtr& pMBLayout)
+    {
+        Matrix<ElemType> labels(CPUDEVICE);
+        labels.SetValueFromOtherDevice(labelsValue);
+        if (labels.GetMatrixType() != MatrixType::DENSE)
+            labels.SwitchToMatrixType(MatrixType::DENSE, matrixFormatDense, true);
+        const size_t numLabels = labels.GetNumRows();
+        std::unique_ptr<ElemType[]> values(labels.CopyToArray());
+
+        const size_t numParallelSequences = pMBLayout->GetNumParallelSequences();
+        const size_t numTimeSteps = pMBLayout->GetNumTimeSteps();
+        std::vector<std::vector<ElemType>> states;
+        std::vector<ElemType> sequences;
+        size_t maxStates = 1, numInfeasible = 0;
+        for (const auto& seq : pMBLayout->GetAllSequences())
+        {
+            if (seq.seqId == GAP_SEQUENCE_ID)
+                continue;
+            if (seq.tBegin < 0 || seq.tEnd > numTimeSteps)
+                InvalidArgument("%ls %ls operation requires each sequence to be entirely in its minibatch, truncated sequences are not supported.", NodeName().c_str(), OperationName().c_str());
+
+            // states blank, l_1, blank, ..., l_L, blank; a repeated label needs a blank frame in between
+            std::vector<ElemType> seqStates(1, (ElemType) m_blankTokenId);
+            size_t numRepeats = 0;
+            for (size_t t = seq.tBegin; t < seq.tEnd; t++)
+            {
+                const ElemType* column = values.get() + (t * numParallelSequences + seq.s) * numLabels;
+                const ElemType* maxElement = std::max_element(column, column + numLabels);
+                if (*maxElement == 0)
+                    continue;
+                const size_t token = maxElement - column;
+                if (token == m_blankTokenId)
+                    InvalidArgument("%ls %ls operation: The blank (%d) is used as a label.", NodeName().c_str(), OperationName().c_str(), (int) m_blankTokenId);
+                if (seqStates.size() > 1 && seqStates[seqStates.size() - 2] == (ElemType) token)
+                    numRepeats++;
+                seqStates.push_back((ElemType) token);
+                seqStates.push_back((ElemType) m_blankTokenId);
+            }
+            if (seq.GetNumTimeSteps() < seqStates.size() / 2 + numRepeats)
+                numInfeasible++;
+            maxStates = max(maxStates, seqStates.size());
+            sequences.insert(sequences.end(), {(ElemType) seq.s, (ElemType) seq.tBegin, (ElemType) seq.GetNumTimeSteps(), (ElemType) seqStates.size()});
+            states.push_back(std::move(seqStates));
+        }
+        if (numInfeasible > 0)
+            fprintf(stderr, "WARNING: %ls %ls operation: %d sequences have fewer frames than labels, and are ignored.\n", NodeName().c_str(), OperationName().c_str(), (int) numInfeasible);
+
+        std::vector<ElemType> stateLabels(maxStates * states.size(), (ElemType) m_blankTokenId);
+        for (size_t n = 0; n < states.size(); n++)
+            std::copy(states[n].begin(), states[n].end(), stateLabels.begin() + n * maxStates);
+        m_stateLabels.SetValue(maxStates, states.size(), m_deviceId, stateLabels.data());
+        m_sequences.SetValue(4, states.size(), m_deviceId, sequences.data());
+    }
+
+    size_t m_blankTokenId;
+
+    Matrix<ElemType> m_logSoftmax;     // [P x T*S]
+    Matrix<ElemType> m_softmax;        // [P x T*S]
+    Matrix<ElemType> m_posteriors;     // [P x T*S] label posteriors of the frames
+    Matrix<ElemType> m_stateLabels;    // [maxStates x N] the labels of the states of each sequence
+    Matrix<ElemType> m_sequences;      // [4 x N] parallel sequence, first frame, number of frames, number of states
+    Matrix<ElemType> m_alpha;          // [maxStates x N*T]
+    Matrix<ElemType> m_beta;           // [maxStates x N*T]
+    Matrix<ElemType> m_logLikelihoods; // [1 x N]
+};
+
+template class CTCWithSoftmaxNode<float>;
+template class CTCWithSoftmaxNode<double>;
+
 
 // -----------------------------------------------------------------------
 /// DummyCriterionNode (objectives, derivatives, prediction)
@@ -734,4 +1129,72 @@ public:
 template class DummyCriterionNode<float>;
 template class DummyCriterionNode<double>;
 
+// -----------------------------------------------------------------------
+// DeviceTransferNode (input) -- copy of the input on the device of this node
+// This is the edge between two nodes that are placed on different devices (model parallelism).
+// It is inserted by ComputationNetwork::InsertDeviceTransferNodes() and not meant to be used directly.
+// The copies between GPUs are asynchronous, so that each device only waits for the data it needs.
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+class DeviceTransferNode : public ComputationNode<ElemType>, public NumInputs<1>
+{
+    typedef ComputationNode<ElemType> Base;
+    UsingComputationNodeMembersBoilerplate;
+    static const std::wstring TypeName()
+    {
+        return L"DeviceTransfer";
+    }
+
+public:
+    DeclareConstructorFromConfigWithNumInputs(DeviceTransferNode);
+    DeviceTransferNode(DEVICEID_TYPE deviceId, const wstring& name)
+        : Base(deviceId, name)
+    {
+    }
+
+    // copies between devices
+    virtual bool /*ComputationNodeBase::*/ IsGraphCapturable() const override { return false; }
+
+    virtual void /*ComputationNode::*/ ForwardProp(const FrameRange& fr) override
+    {
+        ValueFor(fr).SetValueFromOtherDevice(Input(0)->ValueFor(fr));
+    }
+
+    virtual void /*ComputationNode::*/ BackpropTo(const size_t /*inputIndex*/, const FrameRange& fr) override
+    {
+        // the gradient is copied back, and then added on the device of the input
+        m_gradientOnInputDevice->SetValueFromOtherDevice(GradientFor(fr));
+        Input(0)->GradientFor(fr) += *m_gradientOnInputDevice;
+    }
+
+    virtual bool OutputUsedInComputingInputNodesGradients() const override { return false; }
+    virtual bool InputUsedInComputingInputNodesGradients(size_t /*childIndex*/) const override { return false; }
+
+    virtual void /*ComputationNodeBase::*/ Validate(bool isFinalValidationPass) override
+    {
+        ValidateUnaryMap(isFinalValidationPass);
+    }
+
+    // request matrices that are needed for gradient computation
+    virtual void RequestMatricesBeforeBackprop(MatrixPool& matrixPool) override
+    {
+        Base::RequestMatricesBeforeBackprop(matrixPool);
+        matrixPool.Request<ElemType>(m_gradientOnInputDevice, Input(0)->GetDeviceId(), GetSampleMatrixNumRows(), HasMBLayout() ? 0 : 1);
+    }
+
+    // release gradient and temp matrices that no longer needed after all the children's gradients are computed.
+    virtual void ReleaseMatricesAfterBackprop(MatrixPool& matrixPool) override
+    {
+        Base::ReleaseMatricesAfterBackprop(matrixPool);
+        ReleaseMatrixToPool(m_gradientOnInputDevice, matrixPool);
+    }
+
+private:
+    shared_ptr<Matrix<ElemType>> m_gradientOnInputDevice;
+};
+
+template class DeviceTransferNode<float>;
+template class DeviceTransferNode<double>;
+
 } } }
@@ -132,6 +132,7 @@ public:
     {
     }
 
+    // The softmax is not kept; both gradients are recomputed from the right input and its per-column log-sum-exp.
     virtual void BackpropToNonLooping(size_t inputIndex) override
     {
         FrameRange fr(Input(0)->GetMBLayout());
@@ -139,13 +140,13 @@ public:
         if (inputIndex == 0) // left derivative
         {
 #if DUMPOUTPUT
-            *m_logSoftmaxOfRight.Print("CrossEntropyWithSoftmax Partial-logSoftmaxOfRight");
+            m_logSumExpOfRight->Print("CrossEntropyWithSoftmax Partial-logSumExpOfRight");
             Gradient().Print("CrossEntropyWithSoftmax Partial-gradientValues");
             Input(0)->GradientFor(fr).Print("CrossEntropyWithSoftmaxNode Partial-Left-in");
 #endif
 
             auto gradient = Input(0)->GradientFor(fr);
-            Matrix<ElemType>::Multiply1x1AndWeightedAdd(-1.0f, Gradient() /*1x1*/, *m_logSoftmaxOfRight, 1.0f, gradient);
+            gradient.AddCrossEntropyWithSoftmaxGradient(0, Gradient() /*1x1*/, Input(0)->ValueFor(fr), Input(1)->ValueFor(fr), *m_logSumExpOfRight);
 #if DUMPOUTPUT
             Input(0)->GradientFor(fr).Print("CrossEntropyWithSoftmaxNode Partial-Left-out");
 #endif
@@ -154,14 +155,14 @@ public:
         else if (inputIndex == 1) // right derivative
         {
 #if DUMPOUTPUT
-            *m_softmaxOfRight.Print("CrossEntropyWithSoftmax Partial-softmaxOfRight");
+            m_logSumExpOfRight->Print("CrossEntropyWithSoftmax Partial-logSumExpOfRight");
             Input(0)->ValueFor(fr).Print("CrossEntropyWithSoftmax Partial-inputFunctionValues");
             Gradient().Print("CrossEntropyWithSoftmax Partial-gradientValues");
             Input(1)->GradientFor(fr).Print("CrossEntropyWithSoftmaxNode Partial-Right-in");
 #endif
 
             auto gradient = Input(1)->GradientFor(fr);
-            Matrix<ElemType>::AddScaledDifference(Gradient(), *m_softmaxOfRight, Input(0)->ValueFor(fr), gradient);
+            gradient.AddCrossEntropyWithSoftmaxGradient(1, Gradient() /*1x1*/, Input(0)->ValueFor(fr), Input(1)->ValueFor(fr), *m_logSumExpOfRight); // softmax - label
 #if DUMPOUTPUT
             Input(1)->GradientFor(fr).Print("CrossEntropyWithSoftmaxNode Partial-Right");
 #endif
@@ -178,23 +179,15 @@ public:
 
     virtual void UpdateFunctionMBSize() override
     {
-        m_logSoftmaxOfRight->Resize(Input(1)->Value());
-        m_softmaxOfRight->Resize(*m_logSoftmaxOfRight);
+        m_logSumExpOfRight->Resize(1, Input(1)->Value().GetNumCols());
     }
 
     virtual void /*ComputationNodeNonLooping::*/ ForwardPropNonLooping() override // -sum(left_i * log(softmax_i(right)))
     {
         FrameRange fr(Input(0)->GetMBLayout());
-        // first compute the softmax (column-wise)
-        // Note that we need both log and non-log for gradient computation.
-        m_logSoftmaxOfRight->AssignLogSoftmaxOf(Input(1)->ValueFor(fr), true);
-        m_softmaxOfRight->SetValue(*m_logSoftmaxOfRight);
-        m_softmaxOfRight->InplaceExp();
-        // flatten all gaps to zero, such that gaps will contribute zero to the sum
-        MaskMissingColumnsToZero(*m_logSoftmaxOfRight, Input(1)->GetMBLayout(), fr);
-        // reduce over all frames
-        Value().AssignInnerProductOfMatrices(Input(0)->MaskedValueFor(fr), *m_logSoftmaxOfRight);
-        Value() *= -1;
+        // fused column-wise log-softmax and reduction over all frames; only the log-sum-exp of each column is kept for the gradient
+        // Gaps have zero (masked) labels and thus contribute zero to the sum.
+        Value().AssignCrossEntropyWithSoftmaxOf(Input(0)->MaskedValueFor(fr), Input(1)->ValueFor(fr), *m_logSumExpOfRight);
 #if NANCHECK
         Value().HasNan("CrossEntropyWithSoftmax");
 #endif
@@ -214,8 +207,7 @@ public:
         if (flags & CopyNodeFlags::copyNodeValue)
         {
             auto node = dynamic_pointer_cast<CrossEntropyWithSoftmaxNode<ElemType>>(nodeP);
-            *node->m_logSoftmaxOfRight = *m_logSoftmaxOfRight;
-            *node->m_softmaxOfRight = *m_softmaxOfRight;
+            *node->m_logSumExpOfRight = *m_logSumExpOfRight;
         }
     }
 
@@ -223,13 +215,11 @@ public:
     virtual void RequestMatricesBeforeForwardProp(MatrixPool& matrixPool)
     {
         Base::RequestMatricesBeforeForwardProp(matrixPool);
-        RequestMatrixFromPool(m_logSoftmaxOfRight, matrixPool);
-        RequestMatrixFromPool(m_softmaxOfRight, matrixPool);
+        RequestMatrixFromPool(m_logSumExpOfRight, matrixPool);
     }
 
 protected:
-    shared_ptr<Matrix<ElemType>> m_logSoftmaxOfRight;
-    shared_ptr<Matrix<ElemType>> m_softmaxOfRight;
+    shared_ptr<Matrix<ElemType>> m_logSumExpOfRight; // [1 x T] log sum_i exp(right_i) of each column
 };
 
 template class CrossEntropyWithSoftmaxNode<float>;
@@ -511,7 +501,7 @@ template class MatrixL2RegNode<float>;
 template class MatrixL2RegNode<double>;
 
 // -----------------------------------------------------------------------
-// NoiseContrastiveEstimationNode (labels, input, inputWeights, biasWeights)
+// NoiseContrastiveEstimationNode (labels, input, inputWeights, biasWeights[, noiseCounts])
 //  -labels: label in dense matrix in [4 x T]
 //           the first row is the word index, the second row is the class index, the third row is the first word index of the class
 //           the last row is the first word index of the next class
@@ -519,6 +509,14 @@ template class MatrixL2RegNode<double>;
 //  - inputWeights: weight matrix in [hdsize x vocab_size], for speed-up, as per word matrix can be simply obtained as column slice
 //  - biasWeights: clsprob in dense matrix in [nbr_cls x T]. this is the output from logsoftmax node for the log-posterior probabilty of class given observations
 // */
+// With numNoiseSamples > 0, the training criterion draws that many noise words for each minibatch on the device, shared by all
+// its frames, instead of reading samples and their probabilities from the labels:
+//  - labels: one-hot [vocab_size x T] (sparse or dense), or the word ids in a [1 x T] row
+//  - biasWeights: [1 x vocab_size], a parameter
+//  - noiseCounts: optional [vocab_size] constant, e.g. the unigram counts; the noise is drawn proportionally to these with an alias
+//    table. Without it, the noise is log-uniform (Zipfian), which assumes word ids sorted by decreasing frequency.
+// The scores of the label and the noise words are gathered from the columns of inputWeights, and its gradient is a sparse block-column
+// matrix of the noise and label words: inputWeights must not be used by other nodes that write dense gradients into them.
 // BUGBUG: This node has not been converted to memshare conventions.
 // -----------------------------------------------------------------------
 
@@ -529,7 +527,7 @@ enum NCEEvalMode
     None = 2
 };
 template <class ElemType>
-class NoiseContrastiveEstimationNode : public ComputationNodeNonLooping /*ComputationNode*/<ElemType>, public NumInputs<4>
+class NoiseContrastiveEstimationNode : public ComputationNodeNonLooping /*ComputationNode*/<ElemType> // note: not deriving from NumInputs<>, the noise counts are optional
 {
     typedef ComputationNodeNonLooping<ElemType> Base;
     UsingComputationNodeMembersBoilerplate;
@@ -539,31 +537,48 @@ class NoiseContrastiveEstimationNode : public ComputationNodeNonLooping /*Comput
     }
 
 public:
-    DeclareConstructorFromConfigWithNumInputs(NoiseContrastiveEstimationNode);
     NoiseContrastiveEstimationNode(DEVICEID_TYPE deviceId, const wstring& name)
-        : Base(deviceId, name),
-          m_logSoftmax(deviceId),
-          m_softMax(deviceId),
-          m_grdToSoftMaxInput(deviceId),
-          m_ncePrediction(deviceId),
-          m_evalMode(NCEEvalMode::None)
+        : NoiseContrastiveEstimationNode(deviceId, name, NCEEvalMode::None)
     {
     }
-    NoiseContrastiveEstimationNode(DEVICEID_TYPE deviceId, const wstring& name, NCEEvalMode xm_evalMode)
+    NoiseContrastiveEstimationNode(DEVICEID_TYPE deviceId, const wstring& name, NCEEvalMode xm_evalMode, size_t numNoiseSamples = 0)
         : Base(deviceId, name),
           m_logSoftmax(deviceId),
           m_softMax(deviceId),
           m_grdToSoftMaxInput(deviceId),
           m_ncePrediction(deviceId),
+          m_numNoiseSamples(numNoiseSamples),
+          m_aliasProbs(deviceId),
+          m_aliases(deviceId),
+          m_logNoiseCounts(deviceId),
+          m_wordIds(deviceId),
+          m_uniforms(deviceId),
+          m_noiseIds(deviceId),
+          m_labelIds(deviceId),
+          m_frameLosses(deviceId),
+          m_scoreGradients(deviceId),
+          m_labelGradients(deviceId),
+          m_noiseGradients(deviceId),
+          m_noiseGradientSums(deviceId),
+          m_candidateIds(deviceId),
+          m_candidates(deviceId),
+          m_candidateWeightGradients(deviceId),
+          m_candidateBiasGradients(deviceId),
           m_evalMode(xm_evalMode)
     {
+        m_randomSeed = (unsigned long) CreateUniqId();
+    }
+    NoiseContrastiveEstimationNode(const ScriptableObjects::IConfigRecordPtr configp)
+        : NoiseContrastiveEstimationNode(configp->Get(L"deviceId"), L"<placeholder>", NCEEvalMode::None, configp->Get(L"numNoiseSamples"))
+    {
+        AttachInputs(configp);
     }
-    // ^^ TODO: we can merge these two
 
     virtual void Save(File& fstream) const override
     {
         Base::Save(fstream);
         fstream << m_evalMode;
+        fstream << m_numNoiseSamples;
     }
 
     virtual void Load(File& fstream, size_t modelVersion) override
@@ -575,6 +590,24 @@ public:
             m_evalMode = NCEEvalMode::None;
             fstream.SetPosition(fstream.GetPosition() - sizeof(m_evalMode));
         }
+        if (modelVersion >= CNTK_MODEL_VERSION_4)
+            fstream >> m_numNoiseSamples;
+    }
+
+    virtual void CopyTo(ComputationNodeBasePtr nodeP, const std::wstring& newName, const CopyNodeFlags flags) const override
+    {
+        Base::CopyTo(nodeP, newName, flags);
+        if (flags & CopyNodeFlags::copyNodeValue)
+        {
+            auto node = dynamic_pointer_cast<NoiseContrastiveEstimationNode<ElemType>>(nodeP);
+            node->m_numNoiseSamples = m_numNoiseSamples;
+            node->m_randomSeed = m_randomSeed;
+        }
+    }
+
+    void SetRandomSeed(const unsigned long val)
+    {
+        m_randomSeed = (unsigned long) val;
     }
 
     void SetEvalMode(NCEEvalMode& xevMode)
@@ -592,13 +625,15 @@ public:
     virtual void BackpropToNonLooping(size_t inputIndex) override
     {
         FrameRange fr(Input(0)->GetMBLayout());
-        m_needRecomputeGradientToSoftmaxInput = false;
         // gradient computation@yinggongzhao
         // inputIndex should be 2 this time
         if (m_evalMode != NCEEvalMode::None)
             LogicError("BackpropTo should only be called in training mode");
         if (inputIndex == 0)
             InvalidArgument("ComputeInput partial should not be called for label");
+        if (m_numNoiseSamples > 0)
+            return BackpropToWithNoiseSamples(inputIndex, fr);
+        m_needRecomputeGradientToSoftmaxInput = false;
         //                                                                              samples+probs                   hidden                  embedding
         // Input(inputIndex)->GradientFor(fr).AssignNCEDerivative(m_ncePrediction, Input(0)->ValueFor(fr), Input(1)->ValueFor(fr), Input(2)->Value(), inputIndex);
         if (inputIndex >= 2)
@@ -617,9 +652,26 @@ public:
         // TODO (this does not really break it since for full matrices, class Matrix will resize by itself)
     }
 
+    // each ForwardProp() of the training criterion draws new noise
+    virtual bool IsValueRecomputable() const override { return m_numNoiseSamples == 0; }
+
+    virtual void AllocateGradientMatricesForInputs(MatrixPool& matrixPool) override
+    {
+        // with noise drawn on the device, the gradient of the weights only has the columns of the noise and label words
+        if (m_numNoiseSamples > 0 && Input(2)->NeedsGradient())
+        {
+            Input(2)->CreateGradientMatrixIfNull();
+            Input(2)->Gradient().SwitchToMatrixType(SPARSE, MatrixFormat::matrixFormatSparseBlockCol, false);
+        }
+
+        Base::AllocateGradientMatricesForInputs(matrixPool);
+    }
+
     virtual void /*ComputationNodeNonLooping::*/ ForwardPropNonLooping() override // -sum(left_i * log(softmax_i(right)))
     {
         FrameRange fr(Input(0)->GetMBLayout());
+        if (m_evalMode == NCEEvalMode::None && m_numNoiseSamples > 0)
+            return ForwardPropWithNoiseSamples(fr);
         if (Input(0)->HasMBLayout() && Input(0)->GetMBLayout()->HasGaps())
             LogicError("%ls %ls operation does not handle multiple parallel sequences with gaps correctly. Contact fseide@microsoft.com if you have a need and a test case.", NodeName().c_str(), OperationName().c_str());
 
@@ -664,17 +716,158 @@ public:
         Base::Validate(isFinalValidationPass);
         m_pMBLayout = nullptr; // this node does not hold mini-batch data
 
+        if (GetNumInputs() != 4 && (GetNumInputs() != 5 || m_numNoiseSamples == 0))
+            InvalidArgument("%ls %ls operation expects 4 inputs (labels, input, inputWeights, biasWeights), or 5 (and the noise counts) with numNoiseSamples > 0, not %d.",
+                            NodeName().c_str(), OperationName().c_str(), (int) GetNumInputs());
+
         if (isFinalValidationPass)
         {
             if (Input(1)->GetSampleMatrixNumRows() != Input(2)->GetAsMatrixNumRows())
                 LogicError("The Matrix dimension for observation and weight in the NoiseContrastiveEstimationNode operation does not match.");
-            if (!Input(0)->HasMBLayout() || !Input(1)->HasMBLayout() || Input(2)->HasMBLayout() || !Input(3)->HasMBLayout())
-                LogicError("%ls %ls operation requires inputs 0, 1, and 3 to be a minibatch, and input 2 to be a matrix.", NodeName().c_str(), OperationName().c_str());
+            if (!Input(0)->HasMBLayout() || !Input(1)->HasMBLayout() || Input(2)->HasMBLayout() || Input(3)->HasMBLayout())
+                LogicError("%ls %ls operation requires inputs 0 and 1 to be a minibatch, and inputs 2 and 3 to be a matrix.", NodeName().c_str(), OperationName().c_str());
+            if (m_numNoiseSamples > 0)
+            {
+                const size_t numWords = Input(2)->GetAsMatrixNumCols();
+                if (Input(0)->GetSampleMatrixNumRows() != numWords && Input(0)->GetSampleMatrixNumRows() != 1)
+                    InvalidArgument("%ls %ls operation: The labels must be one-hot vectors of the %d words, or word ids.", NodeName().c_str(), OperationName().c_str(), (int) numWords);
+                if (Input(3)->GetSampleLayout().GetNumElements() != numWords || (GetNumInputs() > 4 && (Input(4)->HasMBLayout() || Input(4)->GetSampleLayout().GetNumElements() != numWords)))
+                    InvalidArgument("%ls %ls operation: The bias and the noise counts must have one element per word (%d).", NodeName().c_str(), OperationName().c_str(), (int) numWords);
+            }
         }
 
         SetDims(TensorShape(1), false);
     }
 
+private:
+    // the noise distribution as an alias table, on the device; computed on the host once
+    void InitNoiseDistribution(size_t numWords)
+    {
+        std::vector<double> weights(numWords);
+        if (GetNumInputs() > 4)
+        {
+            ElemType* counts = Input(4)->Value().CopyToArray();
+            for (size_t k = 0; k < numWords; k++)
+                weights[k] = max((double) counts[k], 0.0);
+            delete[] counts;
+        }
+        else
+        {
+            for (size_t k = 0; k < numWords; k++)
+                weights[k] = log((k + 2.0) / (k + 1.0)); // log-uniform: P(k) = log((k + 2) / (k + 1)) / log(V + 1)
+        }
+        double total = 0;
+        for (auto weight : weights)
+            total += weight;
+        if (!(total > 0))
+            InvalidArgument("%ls %ls operation: The noise counts must not all be zero.", NodeName().c_str(), OperationName().c_str());
+
+        // Vose's alias method: each bucket k keeps word k with probability aliasProbs[k], and holds one other word for the rest
+        std::vector<ElemType> aliasProbs(numWords, 1), aliases(numWords), logNoiseCounts(numWords), wordIds(numWords);
+        std::vector<double> scaled(numWords);
+        std::vector<size_t> small, large;
+        for (size_t k = 0; k < numWords; k++)
+        {
+            double p = weights[k] / total;
+            logNoiseCounts[k] = (ElemType) log(max(m_numNoiseSamples * p, 1e-10)); // (a word that is never drawn may still be a label)
+            wordIds[k] = aliases[k] = (ElemType) k;
+            scaled[k] = p * numWords;
+            (scaled[k] < 1 ? small : large).push_back(k);
+        }
+        while (!small.empty() && !large.empty())
+        {
+            size_t s = small.back();
+            small.pop_back();
+            size_t l = large.back();
+            aliasProbs[s] = (ElemType) scaled[s];
+            aliases[s] = (ElemType) l;
+            scaled[l] -= 1 - scaled[s];
+            if (scaled[l] < 1)
+            {
+                large.pop_back();
+                small.push_back(l);
+            }
+        }
+        // the buckets left over by rounding keep their word: aliasProbs is 1
+        m_aliasProbs.SetValue(1, numWords, m_deviceId, aliasProbs.data());
+        m_aliases.SetValue(1, numWords, m_deviceId, aliases.data());
+        m_logNoiseCounts.SetValue(1, numWords, m_deviceId, logNoiseCounts.data());
+        m_wordIds.SetValue(1, numWords, m_deviceId, wordIds.data());
+    }
+
+    void ForwardPropWithNoiseSamples(const FrameRange& fr)
+    {
+        const size_t numWords = Input(2)->GetAsMatrixNumCols();
+        if (m_aliasProbs.GetNumElements() != numWords)
+            InitNoiseDistribution(numWords);
+
+        // draw the noise of this minibatch
+        m_uniforms.Resize(2, m_numNoiseSamples);
+        m_uniforms.SetUniformRandomValue(0, 1, m_randomSeed);
+        m_randomSeed += 1073807359; // 1073807359 is a very large prime number to avoid collision with other nodes
+        m_noiseIds.AssignAliasSamplesOf(m_uniforms, m_aliasProbs, m_aliases);
+        if (Input(0)->GetSampleMatrixNumRows() == 1)
+            m_labelIds.SetValue(Input(0)->MaskedValueFor(fr));
+        else
+            m_labelIds.AssignProductOf(m_wordIds, false, Input(0)->MaskedValueFor(fr), false);
+
+        m_frameLosses.AssignNCELossOf(m_labelIds, m_noiseIds, Input(1)->MaskedValueFor(fr), Input(2)->ValueAsMatrix(), Input(3)->Value(), m_logNoiseCounts, m_scoreGradients);
+        // flatten all gaps to zero, such that gaps will contribute zero to the sum and the gradients
+        MaskMissingColumnsToZero(m_frameLosses, Input(1)->GetMBLayout(), fr);
+        MaskMissingColumnsToZero(m_scoreGradients, Input(1)->GetMBLayout(), fr);
+        Value().AssignSumOfElements(m_frameLosses);
+#if NANCHECK
+        Value().HasNan("NoiseContrastiveEstimation");
+#endif
+        m_needRecomputeGradientToSoftmaxInput = true;
+    }
+
+    void BackpropToWithNoiseSamples(size_t inputIndex, const FrameRange& fr)
+    {
+        if (inputIndex == 4)
+            InvalidArgument("%ls %ls operation: The noise counts have no gradient, they must be a constant.", NodeName().c_str(), OperationName().c_str());
+
+        const size_t numCols = m_scoreGradients.GetNumCols();
+        if (m_needRecomputeGradientToSoftmaxInput)
+        {
+            // scale the gradients w.r.t. the scores once, and list the noise and label words whose columns receive them
+            Matrix<ElemType>::Scale(Gradient() /*1x1*/, m_scoreGradients);
+            m_labelGradients.AssignRowSliceValuesOf(m_scoreGradients, 0, 1);
+            m_noiseGradients.AssignRowSliceValuesOf(m_scoreGradients, 1, m_numNoiseSamples);
+            m_candidateIds.Resize(1, m_numNoiseSamples + numCols);
+            m_candidateIds.SetColumnSlice(m_noiseIds, 0, m_numNoiseSamples);
+            m_candidateIds.SetColumnSlice(m_labelIds, m_numNoiseSamples, numCols);
+            m_candidates.AssignOneHotColumnsOf(m_candidateIds, Input(2)->GetAsMatrixNumCols());
+            m_needRecomputeGradientToSoftmaxInput = false;
+        }
+
+        if (inputIndex == 1) // hidden += the columns of the weights of the words, weighted by their score gradients
+        {
+            auto gradient = Input(1)->GradientFor(fr);
+            gradient.AddNCEHiddenGradientOf(m_scoreGradients, m_labelIds, m_noiseIds, Input(2)->ValueAsMatrix());
+        }
+        else if (inputIndex == 2) // weights: the gradients of the noise and label words, scattered into their columns
+        {
+            auto hidden = Input(1)->ValueFor(fr);
+            m_candidateWeightGradients.Resize(hidden.GetNumRows(), m_numNoiseSamples + numCols);
+            auto noiseWeightGradients = m_candidateWeightGradients.ColumnSlice(0, m_numNoiseSamples);
+            Matrix<ElemType>::MultiplyAndWeightedAdd(1, hidden, false, m_noiseGradients, true, 0, noiseWeightGradients);
+            m_candidateWeightGradients.SetColumnSlice(hidden, m_numNoiseSamples, numCols);
+            auto labelWeightGradients = m_candidateWeightGradients.ColumnSlice(m_numNoiseSamples, numCols);
+            labelWeightGradients.RowElementMultiplyWith(m_labelGradients);
+            Matrix<ElemType>::MultiplyAndAdd(m_candidateWeightGradients, false, m_candidates, true, Input(2)->Gradient());
+        }
+        else if (inputIndex == 3) // bias: the sums of the gradients of the noise and label words, scattered into their rows
+        {
+            Matrix<ElemType>::VectorSum(m_noiseGradients, m_noiseGradientSums, false);
+            m_candidateBiasGradients.Resize(1, m_numNoiseSamples + numCols);
+            m_candidateBiasGradients.SetColumnSlice(m_noiseGradientSums.Reshaped(1, m_numNoiseSamples), 0, m_numNoiseSamples);
+            m_candidateBiasGradients.SetColumnSlice(m_labelGradients, m_numNoiseSamples, numCols);
+            auto gradient = Input(3)->Gradient().Reshaped(m_candidates.GetNumRows(), 1);
+            Matrix<ElemType>::MultiplyAndWeightedAdd(1, m_candidates, false, m_candidateBiasGradients.Reshaped(m_numNoiseSamples + numCols, 1), false, 1, gradient);
+        }
+    }
+
 protected:
     Matrix<ElemType> m_logSoftmax;
     Matrix<ElemType> m_softMax;
@@ -689,12 +882,344 @@ protected:
     size_t m_nbrNoise;
     size_t m_totalNbrWords;
 
+    // noise drawn on the device, see ForwardPropWithNoiseSamples()
+    size_t m_numNoiseSamples; // K
+    unsigned long m_randomSeed;
+    Matrix<ElemType> m_aliasProbs;               // [1 x V] alias table of the noise distribution
+    Matrix<ElemType> m_aliases;                  // [1 x V]
+    Matrix<ElemType> m_logNoiseCounts;           // [1 x V] log of the expected count of each word in the noise
+    Matrix<ElemType> m_wordIds;                  // [1 x V] 0, 1, ..., V-1: turns one-hot labels into word ids
+    Matrix<ElemType> m_uniforms;                 // [2 x K]
+    Matrix<ElemType> m_noiseIds;                 // [1 x K]
+    Matrix<ElemType> m_labelIds;                 // [1 x T]
+    Matrix<ElemType> m_frameLosses;              // [1 x T]
+    Matrix<ElemType> m_scoreGradients;           // [(K+1) x T] of the label (row 0) and the noise words
+    Matrix<ElemType> m_labelGradients;           // [1 x T]
+    Matrix<ElemType> m_noiseGradients;           // [K x T]
+    Matrix<ElemType> m_noiseGradientSums;        // [K x 1]
+    Matrix<ElemType> m_candidateIds;             // [1 x (K+T)] the noise words, then the label of each frame
+    Matrix<ElemType> m_candidates;               // [V x (K+T)] sparse, one-hot columns of the candidates
+    Matrix<ElemType> m_candidateWeightGradients; // [D x (K+T)]
+    Matrix<ElemType> m_candidateBiasGradients;   // [1 x (K+T)]
+
 private:
     NCEEvalMode m_evalMode;
 };
 template class NoiseContrastiveEstimationNode<float>;
 template class NoiseContrastiveEstimationNode<double>;
 
+// -----------------------------------------------------------------------
+// SampledCrossEntropyWithSoftmaxNode (labels, hidden, weights, bias[, classCounts])
+// sampled softmax: cross entropy of softmax(weights' * hidden + bias) over the true classes and a sample of the others
+//  - labels: one-hot [V x T] (sparse or dense), or the class ids in a [1 x T] row
+//  - hidden: [D x T]
+//  - weights: the output embedding [D x V], a parameter
+//  - bias: [V], a parameter
+//  - classCounts: optional [V] constant, e.g. the unigram counts; sampled proportionally to these. Without it, the
+//    classes are sampled from the log-uniform (Zipfian) distribution, which assumes class ids sorted by decreasing frequency.
+// 'numSamples' classes are drawn on the device for each minibatch, with replacement, and shared by all its frames. Each
+// frame computes the softmax over its true class and the samples, with the logits corrected by the log expected
+// counts of the classes in the sample (importance sampling); samples that hit the true class of a frame are
+// excluded from its softmax. The gradient of the weights is a sparse block-column matrix of the sampled and true
+// classes: the weights must not be used by other nodes that write dense gradients into them.
+// This is a training criterion only: for evaluation, use CrossEntropyWithSoftmax over the full output layer with the
+// same parameters.
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+class SampledCrossEntropyWithSoftmaxNode : public ComputationNodeNonLooping /*ComputationNode*/<ElemType> // note: not deriving from NumInputs<>, the class counts are optional
+{
+    typedef ComputationNodeNonLooping<ElemType> Base;
+    UsingComputationNodeMembersBoilerplate;
+    static const std::wstring TypeName()
+    {
+        return L"SampledCrossEntropyWithSoftmax";
+    }
+
+public:
+    SampledCrossEntropyWithSoftmaxNode(DEVICEID_TYPE deviceId, const wstring& name, size_t numSamples = 1024)
+        : Base(deviceId, name),
+          m_numSamples(numSamples),
+          m_cdf(deviceId),
+          m_logExpectedCounts(deviceId),
+          m_classIds(deviceId),
+          m_classBiases(deviceId),
+          m_samples(deviceId),
+          m_labelIds(deviceId),
+          m_candidateIds(deviceId),
+          m_candidates(deviceId),
+          m_candidateWeights(deviceId),
+          m_candidateBiases(deviceId),
+          m_sampledLogits(deviceId),
+          m_trueLogits(deviceId),
+          m_logits(deviceId),
+          m_trueLogProbs(deviceId),
+          m_sampledGradients(deviceId),
+          m_trueGradients(deviceId),
+          m_sampleGradientSums(deviceId),
+          m_candidateWeightGradients(deviceId),
+          m_candidateBiasGradients(deviceId),
+          m_scaledTrueWeights(deviceId),
+          m_needRecomputeLogitGradients(false)
+    {
+        m_randomSeed = (unsigned long) CreateUniqId();
+    }
+    SampledCrossEntropyWithSoftmaxNode(const ScriptableObjects::IConfigRecordPtr configp)
+        : SampledCrossEntropyWithSoftmaxNode(configp->Get(L"deviceId"), L"<placeholder>", configp->Get(L"numSamples"))
+    {
+        AttachInputs(configp);
+    }
+
+    virtual void Save(File& fstream) const override
+    {
+        Base::Save(fstream);
+        fstream << m_numSamples;
+    }
+
+    virtual void Load(File& fstream, size_t modelVersion) override
+    {
+        Base::Load(fstream, modelVersion);
+        fstream >> m_numSamples;
+    }
+
+    virtual void CopyTo(ComputationNodeBasePtr nodeP, const std::wstring& newName, const CopyNodeFlags flags) const override
+    {
+        Base::CopyTo(nodeP, newName, flags);
+        if (flags & CopyNodeFlags::copyNodeValue)
+        {
+            auto node = dynamic_pointer_cast<SampledCrossEntropyWithSoftmaxNode<ElemType>>(nodeP);
+            node->m_numSamples = m_numSamples;
+            node->m_randomSeed = m_randomSeed;
+        }
+    }
+
+    void SetRandomSeed(const unsigned long val)
+    {
+        m_randomSeed = (unsigned long) val;
+    }
+
+    virtual void BackpropToNonLooping(size_t inputIndex) override
+    {
+        FrameRange fr(Input(0)->GetMBLayout());
+        if (inputIndex == 0)
+            InvalidArgument("%ls %ls operation: The labels have no gradient.", NodeName().c_str(), OperationName().c_str());
+        if (inputIndex == 4)
+            InvalidArgument("%ls %ls operation: The class counts have no gradient, they must be a constant.", NodeName().c_str(), OperationName().c_str());
+
+        if (m_needRecomputeLogitGradients)
+            ComputeLogitGradients(fr);
+
+        const size_t numSamples = m_sampledGradients.GetNumRows();
+        const size_t numCols = m_sampledGradients.GetNumCols();
+        if (inputIndex == 1) // hidden += sampled weights * sampled gradients + true weights .* true gradients
+        {
+            auto gradient = Input(1)->GradientFor(fr);
+            Matrix<ElemType>::MultiplyAndWeightedAdd(1, m_candidateWeights.ColumnSlice(0, numSamples), false, m_sampledGradients, false, 1, gradient);
+            m_scaledTrueWeights.SetValue(m_candidateWeights.ColumnSlice(numSamples, numCols));
+            m_scaledTrueWeights.RowElementMultiplyWith(m_trueGradients);
+            gradient += m_scaledTrueWeights;
+        }
+        else if (inputIndex == 2) // weights: the gradients of the candidates, scattered into their columns
+        {
+            auto hidden = Input(1)->ValueFor(fr);
+            m_candidateWeightGradients.Resize(hidden.GetNumRows(), numSamples + numCols);
+            auto sampledWeightGradients = m_candidateWeightGradients.ColumnSlice(0, numSamples);
+            Matrix<ElemType>::MultiplyAndWeightedAdd(1, hidden, false, m_sampledGradients, true, 0, sampledWeightGradients);
+            m_candidateWeightGradients.SetColumnSlice(hidden, numSamples, numCols);
+            auto trueWeightGradients = m_candidateWeightGradients.ColumnSlice(numSamples, numCols);
+            trueWeightGradients.RowElementMultiplyWith(m_trueGradients);
+            Matrix<ElemType>::MultiplyAndAdd(m_candidateWeightGradients, false, m_candidates, true, Input(2)->Gradient());
+        }
+        else if (inputIndex == 3) // bias: the sums of the gradients of the candidates, scattered into their rows
+        {
+            Matrix<ElemType>::VectorSum(m_sampledGradients, m_sampleGradientSums, false);
+            m_candidateBiasGradients.Resize(1, numSamples + numCols);
+            m_candidateBiasGradients.SetColumnSlice(m_sampleGradientSums.Reshaped(1, numSamples), 0, numSamples);
+            m_candidateBiasGradients.SetColumnSlice(m_trueGradients, numSamples, numCols);
+            auto gradient = Input(3)->Gradient().Reshaped(m_candidates.GetNumRows(), 1);
+            Matrix<ElemType>::MultiplyAndWeightedAdd(1, m_candidates, false, m_candidateBiasGradients.Reshaped(numSamples + numCols, 1), false, 1, gradient);
+        }
+    }
+
+    virtual bool OutputUsedInComputingInputNodesGradients() const override
+    {
+        return false;
+    }
+
+    // each ForwardProp() draws new samples
+    virtual bool IsValueRecomputable() const override { return false; }
+
+    virtual void AllocateGradientMatricesForInputs(MatrixPool& matrixPool) override
+    {
+        // the gradient of the weights only has the columns of the candidates, like that of TimesNode for a sparse right operand
+        if (Input(2)->NeedsGradient())
+        {
+            Input(2)->CreateGradientMatrixIfNull();
+            Input(2)->Gradient().SwitchToMatrixType(SPARSE, MatrixFormat::matrixFormatSparseBlockCol, false);
+        }
+
+        Base::AllocateGradientMatricesForInputs(matrixPool);
+    }
+
+    virtual void /*ComputationNodeNonLooping::*/ ForwardPropNonLooping() override
+    {
+        FrameRange fr(Input(0)->GetMBLayout());
+        auto hidden = Input(1)->MaskedValueFor(fr);
+        const size_t numClasses = Input(2)->GetAsMatrixNumCols();
+        const size_t numCols = hidden.GetNumCols();
+        if (m_cdf.GetNumElements() != numClasses)
+            InitSamplingDistribution(numClasses);
+
+        // draw the samples of this minibatch; the candidates are the samples followed by the true class of each frame
+        m_samples.Resize(1, m_numSamples);
+        m_samples.SetUniformRandomValue(0, 1, m_randomSeed);
+        m_randomSeed += 1073807359; // 1073807359 is a very large prime number to avoid collision with other nodes
+        m_samples.InplaceSampleFromCDF(m_cdf);
+        if (Input(0)->GetSampleMatrixNumRows() == 1)
+            m_labelIds.SetValue(Input(0)->MaskedValueFor(fr));
+        else
+            m_labelIds.AssignProductOf(m_classIds, false, Input(0)->MaskedValueFor(fr), false);
+        m_candidateIds.Resize(1, m_numSamples + numCols);
+        m_candidateIds.SetColumnSlice(m_samples, 0, m_numSamples);
+        m_candidateIds.SetColumnSlice(m_labelIds, m_numSamples, numCols);
+        m_candidates.AssignOneHotColumnsOf(m_candidateIds, numClasses);
+
+        // gather the weights and the corrected biases of the candidates
+        m_candidateWeights.AssignProductOf(Input(2)->ValueAsMatrix(), false, m_candidates, false);
+        m_classBiases.AssignDifferenceOf(Input(3)->Value().Reshaped(1, numClasses), m_logExpectedCounts);
+        m_candidateBiases.AssignProductOf(m_classBiases, false, m_candidates, false);
+
+        // logits of the true class and of the samples
+        m_sampledLogits.AssignProductOf(m_candidateWeights.ColumnSlice(0, m_numSamples), true, hidden, false);
+        m_trueLogits.AssignInnerProductOf(m_candidateWeights.ColumnSlice(m_numSamples, numCols), hidden, true);
+        m_logits.AssignSampledSoftmaxLogits(m_trueLogits, m_sampledLogits, m_candidateBiases, m_candidateIds);
+        m_logits.InplaceLogSoftmax(true);
+        // flatten all gaps to zero, such that gaps will contribute zero to the sum
+        MaskMissingColumnsToZero(m_logits, Input(1)->GetMBLayout(), fr);
+
+        m_trueLogProbs.AssignRowSliceValuesOf(m_logits, 0, 1);
+        Value().AssignSumOfElements(m_trueLogProbs);
+        Value() *= -1;
+#if NANCHECK
+        Value().HasNan("SampledCrossEntropyWithSoftmax");
+#endif
+        m_needRecomputeLogitGradients = true;
+    }
+
+    virtual void /*ComputationNodeBase::*/ Validate(bool isFinalValidationPass) override
+    {
+        Base::Validate(isFinalValidationPass);
+        m_pMBLayout = nullptr; // this node does not hold mini-batch data
+
+        if (GetNumInputs() != 4 && GetNumInputs() != 5)
+            InvalidArgument("%ls %ls operation expects 4 inputs (labels, hidden, weights, bias) or 5 (and the class counts), not %d.", NodeName().c_str(), OperationName().c_str(), (int) GetNumInputs());
+
+        if (isFinalValidationPass)
+        {
+            if (!Input(0)->HasMBLayout() || !Input(1)->HasMBLayout() || Input(2)->HasMBLayout() || Input(3)->HasMBLayout() || (GetNumInputs() > 4 && Input(4)->HasMBLayout()))
+                LogicError("%ls %ls operation requires inputs 0 and 1 to be a minibatch, and the others not.", NodeName().c_str(), OperationName().c_str());
+            const size_t numClasses = Input(2)->GetAsMatrixNumCols();
+            if (Input(1)->GetSampleMatrixNumRows() != Input(2)->GetAsMatrixNumRows())
+                InvalidArgument("%ls %ls operation: The dimension of the hidden input (%d) does not match the rows of the weights (%d).", NodeName().c_str(), OperationName().c_str(),
+                                (int) Input(1)->GetSampleMatrixNumRows(), (int) Input(2)->GetAsMatrixNumRows());
+            if (Input(0)->GetSampleMatrixNumRows() != numClasses && Input(0)->GetSampleMatrixNumRows() != 1)
+                InvalidArgument("%ls %ls operation: The labels must be one-hot vectors of the %d classes, or class ids.", NodeName().c_str(), OperationName().c_str(), (int) numClasses);
+            if (Input(3)->GetSampleLayout().GetNumElements() != numClasses || (GetNumInputs() > 4 && Input(4)->GetSampleLayout().GetNumElements() != numClasses))
+                InvalidArgument("%ls %ls operation: The bias and the class counts must have one element per class (%d).", NodeName().c_str(), OperationName().c_str(), (int) numClasses);
+            if (m_numSamples == 0)
+                InvalidArgument("%ls %ls operation: numSamples must be positive.", NodeName().c_str(), OperationName().c_str());
+        }
+
+        SetDims(TensorShape(1), false);
+    }
+
+    // the products that gather the logits of the candidates, per frame
+    virtual double EstimateForwardFlops() const override
+    {
+        return 2.0 * Input(1)->GetSampleMatrixNumRows() * (m_numSamples + 1) * Input(1)->GetSampleMatrixNumCols();
+    }
+
+private:
+    // the sampling distribution, on the device; computed on the host once
+    void InitSamplingDistribution(size_t numClasses)
+    {
+        std::vector<double> weights(numClasses);
+        if (GetNumInputs() > 4)
+        {
+            ElemType* counts = Input(4)->Value().CopyToArray();
+            for (size_t k = 0; k < numClasses; k++)
+                weights[k] = max((double) counts[k], 0.0);
+            delete[] counts;
+        }
+        else
+        {
+            for (size_t k = 0; k < numClasses; k++)
+                weights[k] = log((k + 2.0) / (k + 1.0)); // log-uniform: P(k) = log((k + 2) / (k + 1)) / log(V + 1)
+        }
+        double total = 0;
+        for (auto weight : weights)
+            total += weight;
+        if (!(total > 0))
+            InvalidArgument("%ls %ls operation: The class counts must not all be zero.", NodeName().c_str(), OperationName().c_str());
+
+        std::vector<ElemType> cdf(numClasses), logExpectedCounts(numClasses), classIds(numClasses);
+        double sum = 0;
+        for (size_t k = 0; k < numClasses; k++)
+        {
+            double p = weights[k] / total;
+            sum += p;
+            cdf[k] = (ElemType) sum;
+            logExpectedCounts[k] = (ElemType) log(max(m_numSamples * p, 1e-10)); // (a class that is never sampled may still be a label)
+            classIds[k] = (ElemType) k;
+        }
+        m_cdf.SetValue(1, numClasses, m_deviceId, cdf.data());
+        m_logExpectedCounts.SetValue(1, numClasses, m_deviceId, logExpectedCounts.data());
+        m_classIds.SetValue(1, numClasses, m_deviceId, classIds.data());
+    }
+
+    // the gradients of the criterion w.r.t. the logits: softmax - 1 for the true class, softmax for the samples
+    void ComputeLogitGradients(const FrameRange& fr)
+    {
+        m_sampledGradients.AssignRowSliceValuesOf(m_logits, 1, m_numSamples);
+        m_sampledGradients.InplaceExp();
+        MaskMissingColumnsToZero(m_sampledGradients, Input(1)->GetMBLayout(), fr);
+        m_trueGradients.AssignExpOf(m_trueLogProbs);
+        m_trueGradients -= 1;
+        MaskMissingColumnsToZero(m_trueGradients, Input(1)->GetMBLayout(), fr);
+        Matrix<ElemType>::Scale(Gradient() /*1x1*/, m_sampledGradients);
+        Matrix<ElemType>::Scale(Gradient() /*1x1*/, m_trueGradients);
+        m_needRecomputeLogitGradients = false;
+    }
+
+    size_t m_numSamples;
+    unsigned long m_randomSeed;
+
+    Matrix<ElemType> m_cdf;                      // [1 x V] cumulative sampling distribution
+    Matrix<ElemType> m_logExpectedCounts;        // [1 x V] log of the expected count of each class in the sample
+    Matrix<ElemType> m_classIds;                 // [1 x V] 0, 1, ..., V-1: turns one-hot labels into class ids
+    Matrix<ElemType> m_classBiases;              // [1 x V] bias - log expected counts
+    Matrix<ElemType> m_samples;                  // [1 x S]
+    Matrix<ElemType> m_labelIds;                 // [1 x T]
+    Matrix<ElemType> m_candidateIds;             // [1 x (S+T)] the samples, then the true class of each frame
+    Matrix<ElemType> m_candidates;               // [V x (S+T)] sparse, one-hot columns of the candidates
+    Matrix<ElemType> m_candidateWeights;         // [D x (S+T)]
+    Matrix<ElemType> m_candidateBiases;          // [1 x (S+T)]
+    Matrix<ElemType> m_sampledLogits;            // [S x T]
+    Matrix<ElemType> m_trueLogits;               // [1 x T]
+    Matrix<ElemType> m_logits;                   // [(S+1) x T] log softmax of the true class (row 0) and the samples
+    Matrix<ElemType> m_trueLogProbs;             // [1 x T]
+    Matrix<ElemType> m_sampledGradients;         // [S x T]
+    Matrix<ElemType> m_trueGradients;            // [1 x T]
+    Matrix<ElemType> m_sampleGradientSums;       // [S x 1]
+    Matrix<ElemType> m_candidateWeightGradients; // [D x (S+T)]
+    Matrix<ElemType> m_candidateBiasGradients;   // [1 x (S+T)]
+    Matrix<ElemType> m_scaledTrueWeights;        // [D x T]
+    bool m_needRecomputeLogitGradients;
+};
+
+template class SampledCrossEntropyWithSoftmaxNode<float>;
+template class SampledCrossEntropyWithSoftmaxNode<double>;
+
 // -----------------------------------------------------------------------
 // ClassBasedCrossEntropyWithSoftmaxNode (labeldata(.,t), inputdata(.,t), embeddingMatrix, clsProbBeforeSoftmaxData(.,t))
 //  - Input(0) [4 x T] label in dense matrix in
@@ -725,23 +1250,25 @@ public:
     DeclareConstructorFromConfigWithNumInputs(ClassBasedCrossEntropyWithSoftmaxNode);
     ClassBasedCrossEntropyWithSoftmaxNode(DEVICEID_TYPE deviceId, const wstring& name)
         : Base(deviceId, name),
-          m_logSoftmax(deviceId),
-          m_softMax(deviceId),
-          m_grdToSoftMaxInput(deviceId),
+          m_softmax(deviceId),
           m_clsLogSoftmax(deviceId),
-          m_clsSoftmax(deviceId)
+          m_buckets(deviceId),
+          m_frames(deviceId),
+          m_maxClassSize(0)
     {
     }
 
 private:
-    // iterate over a large workspace that contains all class-conditioned probs concatenated
-    // 'sz' is the offset into that vector. We will iterate over these vectors at a few places. Always use this same boilerplate code.
-    template<class F>
-    size_t ForColumnsWithClass(const F& op)
+    // group the non-gap frames of the minibatch by class, from the labels on the CPU (see Matrix::AssignClassBasedCrossEntropyWithSoftmaxOf()):
+    // m_frames lists their columns sorted by class, m_buckets the (first word, end word, first entry, end entry into m_frames) of each class
+    void GroupFramesByClass(const Matrix<ElemType>& labels)
     {
         const size_t nT = Input(LABELDATA)->GetNumTimeSteps();
         const size_t nS = Input(LABELDATA)->GetNumParallelSequences();
-        size_t sz = 0; // iterate over the packed concatenated class-conditioned prob vectors
+        std::vector<size_t> columns, columnClasses;
+        std::vector<size_t> numClassFrames(m_nbrCls, 0);
+        std::vector<std::pair<size_t, size_t>> classWords(m_nbrCls);
+        m_maxClassSize = 0;
         for (size_t s = 0; s < nS; s++)
             for (size_t t = 0; t < nT; t++)
             {
@@ -749,19 +1276,50 @@ private:
                 if (Input(LABELDATA)->GetMBLayout()->IsGap(fr)) // skip gaps
                     continue;
 
-                const Matrix<ElemType>& lbl_t = Input(LABELDATA)->ValueFor(fr);
-                size_t y_t = (size_t)lbl_t(0, 0);     // current word token index
-                size_t c_t = (size_t)lbl_t(1, 0);     // current word token's class index
-                size_t lft_bnd = (size_t)lbl_t(2, 0); // index of first word belonging to current word token's class
-                size_t rgt_bnd = (size_t)lbl_t(3, 0); // and end of that range
-                size_t nbr_wrd = (rgt_bnd - lft_bnd); // number of words in the class
+                const size_t j = t * nS + s;
+                size_t y_t = (size_t)labels(0, j);     // current word token index
+                size_t c_t = (size_t)labels(1, j);     // current word token's class index
+                size_t lft_bnd = (size_t)labels(2, j); // index of first word belonging to current word token's class
+                size_t rgt_bnd = (size_t)labels(3, j); // and end of that range
+                if (rgt_bnd <= lft_bnd)
+                    LogicError("ClassBasedCrossEntropyWithSoftmax: Encountered a class of size 0.");
+                if (y_t < lft_bnd || y_t >= rgt_bnd)
+                    LogicError("ClassBasedCrossEntropyWithSoftmax: Word index out of bounds of class-member index range (word not a class member).");
+                if (c_t >= m_nbrCls)
+                    LogicError("ClassBasedCrossEntropyWithSoftmax: Class index %d out of bounds of the %d classes.", (int) c_t, (int) m_nbrCls);
+                if (numClassFrames[c_t]++ == 0)
+                    classWords[c_t] = make_pair(lft_bnd, rgt_bnd);
+                else if (classWords[c_t] != make_pair(lft_bnd, rgt_bnd))
+                    LogicError("ClassBasedCrossEntropyWithSoftmax: Frames of class %d disagree about its word range.", (int) c_t);
+                m_maxClassSize = max(m_maxClassSize, rgt_bnd - lft_bnd);
+                columns.push_back(j);
+                columnClasses.push_back(c_t);
+            }
 
-                // perform the operation
-                op(s, t, fr, y_t, c_t, sz, lft_bnd, nbr_wrd);
+        // counting sort of the frames by class
+        std::vector<ElemType> buckets;
+        std::vector<size_t> nextEntry(m_nbrCls);
+        size_t numEntries = 0;
+        for (size_t c = 0; c < m_nbrCls; c++)
+        {
+            if (numClassFrames[c] == 0)
+                continue;
+            buckets.insert(buckets.end(), {(ElemType) classWords[c].first, (ElemType) classWords[c].second, (ElemType) numEntries, (ElemType)(numEntries + numClassFrames[c])});
+            nextEntry[c] = numEntries;
+            numEntries += numClassFrames[c];
+        }
+        std::vector<ElemType> frames(columns.size());
+        for (size_t i = 0; i < columns.size(); i++)
+            frames[nextEntry[columnClasses[i]]++] = (ElemType) columns[i];
 
-                sz += nbr_wrd;
-            }
-        return sz;
+        if (frames.empty())
+        {
+            m_buckets.Resize(4, 0);
+            m_frames.Resize(1, 0);
+            return;
+        }
+        m_buckets.SetValue(4, buckets.size() / 4, m_deviceId, buckets.data());
+        m_frames.SetValue(1, frames.size(), m_deviceId, frames.data());
     }
 
     // compute gradients to input observations, the weights to the observations, and the class log posterior probabilites
@@ -771,71 +1329,23 @@ private:
         if (inputIndex != 1 && inputIndex != 2 && inputIndex != 3)
             InvalidArgument("ClassCrossEntropyWithSoftmaxNode criterion only takes with respect to input, weight to the input and class log posterior probability.");
 
-        ComputeSoftMaxPartial(); // Note: Flag m_needRecomputeGradientToSoftmaxInput guards so that this computes only once.
-
-        ForColumnsWithClass([&](size_t /*s*/, size_t /*t*/, const FrameRange& fr, size_t /*y_t*/, size_t c_t, size_t sz, size_t lft_bnd, size_t nbr_wrd)
+        FrameRange fr(Input(LABELDATA)->GetMBLayout());
+        if (inputIndex == EMBEDDINGMATRIX)
+            AddGradientTo(Input(EMBEDDINGMATRIX)->GradientAsMatrix(), inputIndex, fr);
+        else
         {
-            // compute prb - 1 and prb
-            Matrix<ElemType> weightForClass = Input(EMBEDDINGMATRIX)->ValueAsMatrix().ColumnSlice(lft_bnd, nbr_wrd);
-            Matrix<ElemType> obs = Input(INPUTDATA)->ValueFor(fr); // hidden activation vector for current word token
-            Matrix<ElemType> grd_to_soft_max_input = m_grdToSoftMaxInput.ColumnSlice(sz, nbr_wrd);
-
-            switch (inputIndex)
-            {
-                case 1:
-                {
-                    // gradient to input
-                    Matrix<ElemType> grd_t = Input(INPUTDATA)->GradientFor(fr);
-                    Matrix<ElemType>::MultiplyAndAdd(weightForClass, false, grd_to_soft_max_input, true, grd_t);
-                    break;
-                }
-                case 2:
-                {
-                    // gradient to input weight
-                    Matrix<ElemType> grd_to_wgt_t = Input(EMBEDDINGMATRIX)->GradientAsMatrix().ColumnSlice(lft_bnd, nbr_wrd);
-                    Matrix<ElemType>::MultiplyAndAdd(obs, false, grd_to_soft_max_input, false, grd_to_wgt_t);
-                    break;
-                }
-                case 3:
-                {
-                    Matrix<ElemType> grd_t = Input(CLASSPROBINDATA)->GradientFor(fr);
-                    grd_t.SetValue(Input(CLASSPROBINDATA)->DataFor(m_clsSoftmax, fr));
-                    ComputeCEPartialToSoftmaxInputs(grd_t, Gradient(), c_t);
-                    break;
-                }
-            }
-        });
+            Matrix<ElemType> inputGradient = Input(inputIndex)->GradientFor(fr);
+            AddGradientTo(inputGradient, inputIndex, fr);
+        }
     }
 
-    virtual bool OutputUsedInComputingInputNodesGradients() const override { return false; }
-
-private:
-    void ComputeCEPartialToSoftmaxInputs(Matrix<ElemType>& inputGradientValues, Matrix<ElemType>& gradientValues, size_t y_t)
+    void AddGradientTo(Matrix<ElemType>& inputGradient, size_t inputIndex, const FrameRange& fr)
     {
-        Matrix<ElemType>::MinusOneAt(inputGradientValues, y_t);
-        Matrix<ElemType>::Scale(gradientValues, inputGradientValues);
+        inputGradient.AddClassBasedCrossEntropyWithSoftmaxGradient(inputIndex, Gradient(), Input(LABELDATA)->ValueFor(fr), Input(INPUTDATA)->ValueFor(fr),
+                                                                   Input(EMBEDDINGMATRIX)->ValueAsMatrix(), m_clsLogSoftmax, m_buckets, m_frames, m_softmax);
     }
 
-    // gradient of cross entropy w.r.t. to input to softmax
-    void ComputeSoftMaxPartial()
-    {
-        if (m_needRecomputeGradientToSoftmaxInput)
-        {
-            m_grdToSoftMaxInput.Resize(1, m_totalNbrWords); // buffer that contains a concatenation of class-conditional values
-
-            ForColumnsWithClass([&](size_t /*s*/, size_t /*t*/, const FrameRange& /*fr*/, size_t y_t, size_t /*c_t*/, size_t sz, size_t lft_bnd, size_t nbr_wrd)
-            {
-                Matrix<ElemType> softMax = m_softMax.ColumnSlice(sz, nbr_wrd);
-
-                size_t idx_in_class = y_t - lft_bnd;
-                ComputeCEPartialToSoftmaxInputs(softMax, Gradient(), idx_in_class);
-
-                m_grdToSoftMaxInput.ColumnSlice(sz, nbr_wrd).SetValue(softMax);
-            });
-
-            m_needRecomputeGradientToSoftmaxInput = false;
-        }
-    }
+    virtual bool OutputUsedInComputingInputNodesGradients() const override { return false; }
 
 public:
     virtual void UpdateFunctionMBSize() override
@@ -844,80 +1354,29 @@ public:
     }
 
     // -sum(left_i * log(softmax_i(right)))
+    // The frames are grouped by class on the CPU; all products, softmaxes and gradients then run for the whole minibatch at once.
     virtual void /*ComputationNodeNonLooping::*/ ForwardPropNonLooping() override
     {
         // get the label matrix to CPU, ideally in location=BOTH state
         Input(LABELDATA)->Value().TransferToDeviceIfNotThere(CPUDEVICE, /*ismoved =*/ false/*means: BOTH state OK*/, /*emptyTransfer =*/ false, /*updatePreferredDevice =*/ false);
 
-        auto& functionValues = Value();
-
-        const size_t hdSize = Input(INPUTDATA)->GetSampleMatrixNumRows();
+        FrameRange fr(Input(LABELDATA)->GetMBLayout());
         assert(m_nbrCls == Input(CLASSPROBINDATA)->GetSampleMatrixNumRows());
+        GroupFramesByClass(Input(LABELDATA)->ValueFor(fr));
 
-        // compute the class posteriors
-        m_clsLogSoftmax = Input(CLASSPROBINDATA)->Value();
-        m_clsLogSoftmax.InplaceLogSoftmax(true);   // log
-        m_clsSoftmax.AssignExpOf(m_clsLogSoftmax); // non-log
-
-        // create a large workspace to contain all class-conditioned probs concatenated
-        m_totalNbrWords = ForColumnsWithClass([](size_t /*s*/, size_t /*t*/, const FrameRange& /*fr*/, size_t y_t, size_t /*c_t*/, size_t /*sz*/, size_t lft_bnd, size_t nbr_wrd)
-        {
-            if (nbr_wrd == 0)
-                LogicError("ClassBasedCrossEntropyWithSoftmax: Encountered a class of size 0.");
-            if (y_t < lft_bnd || y_t >= lft_bnd + nbr_wrd)
-                LogicError("ClassBasedCrossEntropyWithSoftmax: Word index out of bounds of class-member index range (word not a class member).");
-        });
-        // now m_totalNbrWords = total size of concatenated vector
-
-        // buffer to hold the concatenated class-conditioned prob vectors
-        m_softMax.Resize(1, m_totalNbrWords);
-        m_logSoftmax.Resize(1, m_totalNbrWords);
-
-        // accumulate objective
-        functionValues.SetValue(0);
-        ForColumnsWithClass([&](size_t s, size_t t, const FrameRange& fr, size_t y_t, size_t c_t, size_t sz, size_t lft_bnd, size_t nbr_wrd)
-        {
-            // now get views of various arrays that correspond to the index range of words belonging to this class
-
-            // get hidden vectors for the words in this class
-            Matrix<ElemType> weightForClass = Input(EMBEDDINGMATRIX)->ValueAsMatrix().ColumnSlice(lft_bnd, nbr_wrd); // [hdSize x nbr_wrd]
-
-            // buffer to hold the class-conditional distribution
-            Matrix<ElemType> softMax_t = m_softMax.ColumnSlice(sz, nbr_wrd); // TODO: declare these outside of the loop to avoid the malloc
-            Matrix<ElemType> logSoftMax_t = m_logSoftmax.ColumnSlice(sz, nbr_wrd);
-
-            Matrix<ElemType> obs = Input(INPUTDATA)->ValueFor(fr); // hidden activation vector for current word token
-
-            // multiply hidden activation with weight matrix (the slice of the weight matrix for the range of class members)
-            // TODO: can we use 'true' here instead? Above transposition hack won't work with row slices. 'obs' not used elsewhere
-            obs.Reshape(1, hdSize);                                                                                // transpose it (make it a column vector)
-            logSoftMax_t.AssignProductOf(obs /*(1 x hdSize)*/, false, weightForClass /*hdSize x nbr_wrd*/, false); // -> 1 x nbr_word
-
-            // log softmax(W x_t)
-            logSoftMax_t.InplaceLogSoftmax(false);
-
-            // and non-log version
-            softMax_t.SetValue(logSoftMax_t);
-            softMax_t.InplaceExp();
-            // we now have a column vector of class-conditional probabilities over the class members
-
-            // add  the word's class-conditional log posterior
-            size_t idx_in_class = y_t - lft_bnd;
-            Matrix<ElemType>::AddElementToElement(logSoftMax_t, 0, idx_in_class, functionValues, 0, 0); // (1x1)
-
-            // add the class log posterior probability (for backprop)
-            auto clsLogSoftmax_t = Input(CLASSPROBINDATA)->DataFor(m_clsLogSoftmax, fr);
-            Matrix<ElemType>::AddElementToElement(clsLogSoftmax_t, c_t, 0, functionValues, 0, 0); // (1x1)
-        });
-
-        functionValues *= (-1);
+        // the class posteriors, then the class-conditional word posteriors and the objective
+        m_clsLogSoftmax.AssignLogSoftmaxOf(Input(CLASSPROBINDATA)->ValueFor(fr), true);
+        Value().AssignClassBasedCrossEntropyWithSoftmaxOf(Input(LABELDATA)->ValueFor(fr), Input(INPUTDATA)->ValueFor(fr), Input(EMBEDDINGMATRIX)->ValueAsMatrix(),
+                                                          m_clsLogSoftmax, m_buckets, m_frames, m_maxClassSize, m_softmax);
 
 #if NANCHECK
-        functionValues.HasNan("ClassBasedCrossEntropyWithSoftmax");
+        Value().HasNan("ClassBasedCrossEntropyWithSoftmax");
 #endif
-        m_needRecomputeGradientToSoftmaxInput = true;
     }
 
+    // the classes of the labels select the work on the host
+    virtual bool /*ComputationNodeBase::*/ IsGraphCapturable() const override { return false; }
+
     virtual void /*ComputationNodeBase::*/ Validate(bool isFinalValidationPass) override
     {
         Base::Validate(isFinalValidationPass);
@@ -939,20 +1398,14 @@ public:
     }
 
 protected:
-    Matrix<ElemType> m_logSoftmax;
-    Matrix<ElemType> m_softMax;
+    Matrix<ElemType> m_softmax;       // [maxClassSize x T] posteriors of the words of the class of each frame
+    Matrix<ElemType> m_clsLogSoftmax; // [nbr_cls x T]
 
-    Matrix<ElemType> m_clsLogSoftmax;
-    Matrix<ElemType> m_clsSoftmax;
-
-    // gradient of cross entropy with respect to the input of softmax
-    // a 1 row by \sum_t m_nbrWordsInEachTime[t] vector
-    // one slice of size m_nbrWordsInEachTime[t] saves the input to softmax for word y_t
-    Matrix<ElemType> m_grdToSoftMaxInput;
-    bool m_needRecomputeGradientToSoftmaxInput;
+    Matrix<ElemType> m_buckets; // [4 x B] see GroupFramesByClass()
+    Matrix<ElemType> m_frames;  // [1 x N]
 
     size_t m_nbrCls;
-    size_t m_totalNbrWords;
+    size_t m_maxClassSize;
 };
 
 template class ClassBasedCrossEntropyWithSoftmaxNode<float>;
@@ -1218,6 +1671,9 @@ public:
         postprob.InplaceExp();
     }
 
+    // the forward-backward recursions run on the host
+    virtual bool /*ComputationNodeBase::*/ IsGraphCapturable() const override { return false; }
+
     virtual void /*ComputationNodeBase::*/ Validate(bool isFinalValidationPass) override
     {
         Base::Validate(isFinalValidationPass);
@@ -1422,6 +1878,9 @@ template class LogisticNode<double>;
 // -----------------------------------------------------------------------
 // DropoutNode (input) -- perform drop-out
 // Output is scaled such that no post-scaling is necessary.
+// By default, the mask is drawn into a matrix that is kept for backprop. With SetCounterBasedRNG(true), it is
+// instead regenerated from (seed, element index) by the kernels that apply it (see PhiloxRandom.h),
+// which saves that matrix and the pass that fills it.
 // -----------------------------------------------------------------------
 
 template <class ElemType>
@@ -1438,7 +1897,9 @@ public:
     DeclareConstructorFromConfigWithNumInputs(DropoutNode);
     DropoutNode(DEVICEID_TYPE deviceId, const wstring& name)
         : Base(deviceId, name),
-          m_dropoutRate(0)
+          m_dropoutRate(0),
+          m_counterBasedRNG(false),
+          m_maskSeed(0)
     {
         m_randomSeed = (unsigned long) CreateUniqId();
     }
@@ -1448,7 +1909,9 @@ public:
         Matrix<ElemType> sliceInput0Grad = Input(0)->GradientFor(fr);
         Matrix<ElemType> sliceOutputGrad = GradientFor(fr);
 
-        if (m_dropoutRate > 0)
+        if (m_dropoutRate > 0 && m_counterBasedRNG)
+            sliceInput0Grad.ScaleAndAddDropoutOf(1, sliceOutputGrad, (ElemType) m_dropoutRate, MaskScale(), m_maskSeed, MaskCounterOffset(fr));
+        else if (m_dropoutRate > 0)
             sliceInput0Grad.AddElementProductOf(sliceOutputGrad, DataFor(*m_maskOfDropout, fr));
         else
             sliceInput0Grad += sliceOutputGrad;
@@ -1469,20 +1932,40 @@ public:
         return false;
     }
 
+    // each ForwardProp() draws a new mask
+    virtual bool IsValueRecomputable() const override { return false; }
+
     virtual void UpdateFunctionMBSize() override
     {
         Base::UpdateFunctionMBSize();
         // resize temporaries to their proper size
-        if (m_dropoutRate > 0)
+        if (m_dropoutRate > 0 && !m_counterBasedRNG)
             m_maskOfDropout->Resize(Input(0)->Value());
     }
 
+    virtual void /*IComputationNode::*/ BeginForwardProp() override
+    {
+        Base::BeginForwardProp();
+        // With the counter-based generator, one seed serves all frames of the minibatch, as the elements are numbered
+        // across the whole minibatch. Backprop reuses it.
+        if (m_counterBasedRNG)
+        {
+            m_maskSeed = m_randomSeed;
+            m_randomSeed += 1073807359; // see ForwardProp()
+        }
+    }
+
     virtual void /*ComputationNode::*/ ForwardProp(const FrameRange& fr) override
     {
         Matrix<ElemType> sliceInput0Value = Input(0)->ValueFor(fr);
         Matrix<ElemType> sliceOutputValue = ValueFor(fr);
 
-        if (m_dropoutRate > 0)
+        if (m_dropoutRate > 0 && m_counterBasedRNG)
+        {
+            // generate the mask and apply it in one pass
+            sliceOutputValue.ScaleAndAddDropoutOf(0, sliceInput0Value, (ElemType) m_dropoutRate, MaskScale(), m_maskSeed, MaskCounterOffset(fr));
+        }
+        else if (m_dropoutRate > 0)
         {
             // determine drop-out mask for this minibatch
             auto sliceMask = DataFor(*m_maskOfDropout, fr);
@@ -1515,6 +1998,12 @@ public:
         m_randomSeed = (unsigned long) val;
     }
 
+    // must be set before the matrices are allocated, since it decides whether the mask matrix is needed
+    void SetCounterBasedRNG(const bool val)
+    {
+        m_counterBasedRNG = val;
+    }
+
     virtual void CopyTo(ComputationNodeBasePtr nodeP, const std::wstring& newName, const CopyNodeFlags flags) const override
     {
         Base::CopyTo(nodeP, newName, flags);
@@ -1523,6 +2012,8 @@ public:
             auto node = dynamic_pointer_cast<DropoutNode<ElemType>>(nodeP);
             node->m_dropoutRate = m_dropoutRate;
             node->m_randomSeed = m_randomSeed;
+            node->m_counterBasedRNG = m_counterBasedRNG;
+            node->m_maskSeed = m_maskSeed;
             node->m_maskOfDropout = m_maskOfDropout;
         }
     }
@@ -1530,19 +2021,34 @@ public:
     virtual void RequestMatricesBeforeForwardProp(MatrixPool& matrixPool)
     {
         Base::RequestMatricesBeforeForwardProp(matrixPool);
-        RequestMatrixFromPool(m_maskOfDropout, matrixPool);
+        if (!m_counterBasedRNG)
+            RequestMatrixFromPool(m_maskOfDropout, matrixPool);
     }
 
     // release gradient and temp matrices that no longer needed after all the children's gradients are computed.
     virtual void ReleaseMatricesAfterBackprop(MatrixPool& matrixPool)
     {
         Base::ReleaseMatricesAfterBackprop(matrixPool);
-        ReleaseMatrixToPool(m_maskOfDropout, matrixPool);
+        if (!m_counterBasedRNG)
+            ReleaseMatrixToPool(m_maskOfDropout, matrixPool);
     }
 
 private:
+    ElemType MaskScale() const
+    {
+        return (ElemType)(1.0 / (1.0 - m_dropoutRate)); // pre-scaled
+    }
+
+    // the number of the first element of the frame range within the minibatch, which selects its part of the random sequence
+    size_t MaskCounterOffset(const FrameRange& fr) const
+    {
+        return ColumnRangeWithMBLayoutFor(Value().GetNumCols(), fr, GetMBLayout()).first * Value().GetNumRows();
+    }
+
     double m_dropoutRate;
     unsigned long m_randomSeed;
+    bool m_counterBasedRNG;
+    unsigned long m_maskSeed; // the seed of the current minibatch, with the counter-based generator
 
     shared_ptr<Matrix<ElemType>> m_maskOfDropout;
 };
@@ -1557,8 +2063,11 @@ template class DropoutNode<double>;
 // Implements batch normalization technique as described in:
 // Batch Normalization: Accelerating Deep Network Training by Reducing Internal Covariate Shift [S. Ioffe, C. Szegedy]
 // http://arxiv.org/abs/1502.03167
+// A RectifiedLinear node that is the only consumer of this node is fused into it when the network is compiled
+// (see ComputationNetwork::FuseActivations()): the engine then writes max(0, BN(x)) directly into the ReLU's value,
+// and back-propagates the ReLU's gradient straight to x, scale and bias.
 template <class ElemType>
-class BatchNormalizationNode : public ComputationNode<ElemType>, public NumInputs<5>
+class BatchNormalizationNode : public ComputationNode<ElemType>, public NumInputs<5>, public IFusedActivationProducer<ElemType>
 {
     typedef ComputationNode<ElemType> Base;
     UsingComputationNodeMembersBoilerplate;
@@ -1666,21 +2175,9 @@ public:
 
         if (inputIndex == 0) // derivative with respect to the input.
         {
-            auto sliceOutputGrad = GradientFor(fr);
-            auto sliceInputValue = Input(0)->ValueFor(fr);
-            const Matrix<ElemType>& scale = Input(1)->Value();
-            const Matrix<ElemType>& bias = Input(2)->Value();
-
-            size_t batchSize = sliceInputValue.GetNumCols();
-            m_inT->setN(batchSize);
-            assert(m_convEng != nullptr);
-
-            auto sliceInputGrad = Input(0)->GradientFor(fr);
-            m_dScale->Resize(scale);
-            m_dBias->Resize(bias);
-            // Compute all derivatives in one step. Save derivatives with respect to scale and bias in temp matrices.
-            m_convEng->BackwardNormalizeBatch(*m_inT, sliceInputValue, sliceOutputGrad, sliceInputGrad, *m_scaleBiasT, scale, m_spatial,
-                                              *m_saveMean, *m_saveInvStdDev, *m_dScale, *m_dBias);
+            // When fused, the consumer has already done this in BackpropToWithActivation().
+            if (!IsFusedIntoConsumer())
+                BackpropToInput(fr, GradientFor(fr), nullptr);
         }
         else if (inputIndex == 1) // derivative with respect to the scale
         {
@@ -1697,6 +2194,33 @@ public:
         // No derivatives with respect to running mean and InvStdDev.
     }
 
+    virtual bool /*IActivationFusableNode::*/ CanFuseActivation(ElementWiseOperator op) const override
+    {
+        return op == ElementWiseOperator::opLinearRectifier;
+    }
+
+    virtual void /*IFusedActivationProducer::*/ ForwardPropWithActivation(const FrameRange& fr, ElementWiseOperator /*activation: always ReLU*/, Matrix<ElemType>& output) override
+    {
+        ForwardPropTo(fr, output, /*relu=*/true);
+    }
+
+    virtual void /*IFusedActivationProducer::*/ BackpropToWithActivation(const FrameRange& fr, ElementWiseOperator /*activation: always ReLU*/, const Matrix<ElemType>& outputGradient, const Matrix<ElemType>& output) override
+    {
+        if (m_eval)
+            LogicError("BatchNormalization does not compute derivatives in inference mode.");
+        if (!Input(0)->NeedsGradient())
+            return;
+        Input(0)->LazyZeroGradient();
+        BackpropToInput(fr, outputGradient, &output);
+    }
+
+    // while fused, the consumer requests the gradients of this node's inputs before its Backprop() computes them
+    virtual void /*ComputationNodeBase::*/ AllocateGradientMatricesForInputs(MatrixPool& matrixPool) override
+    {
+        if (!IsFusedIntoConsumer())
+            Base::AllocateGradientMatricesForInputs(matrixPool);
+    }
+
     virtual bool OutputUsedInComputingInputNodesGradients() const override
     {
         // The BatchNormalizationNode does not require its output value for computing
@@ -1704,7 +2228,19 @@ public:
         return false;
     }
 
+    // in training, ForwardProp() updates the running mean and variance
+    virtual bool IsValueRecomputable() const override { return m_eval; }
+
     void ForwardProp(const FrameRange& fr) override
+    {
+        if (IsFusedIntoConsumer()) // the consumer computes our value together with its own, see ForwardPropWithActivation()
+            return;
+        Matrix<ElemType> sliceOutputValue = ValueFor(fr);
+        ForwardPropTo(fr, sliceOutputValue, /*relu=*/false);
+    }
+
+private:
+    void ForwardPropTo(const FrameRange& fr, Matrix<ElemType>& sliceOutputValue, bool relu)
     {
         Matrix<ElemType> sliceInputValue = Input(0)->ValueFor(fr);
 
@@ -1719,8 +2255,6 @@ public:
         assert(runMean.GetNumRows() == runInvStdDev.GetNumRows());
         assert(runMean.GetNumCols() == runInvStdDev.GetNumCols());
 
-        Matrix<ElemType> sliceOutputValue = ValueFor(fr);
-
         size_t batchSize = sliceInputValue.GetNumCols();
         m_inT->setN(batchSize);
         assert(m_convEng != nullptr);
@@ -1728,7 +2262,7 @@ public:
         sliceInputValue.HasNan("BatchNormalization-input");
 #endif
         if (m_eval)
-            m_convEng->NormalizeBatchInference(*m_inT, sliceInputValue, *m_scaleBiasT, scale, bias, m_spatial, runMean, runInvStdDev, sliceOutputValue);
+            m_convEng->NormalizeBatchInference(*m_inT, sliceInputValue, *m_scaleBiasT, scale, bias, m_spatial, runMean, runInvStdDev, sliceOutputValue, relu);
         else
         {
             double expAvgFactor;
@@ -1749,7 +2283,7 @@ public:
                 m_saveInvStdDev->Resize(runMean.GetNumRows(), runMean.GetNumCols());
 
             m_convEng->NormalizeBatch(*m_inT, sliceInputValue, *m_scaleBiasT, scale, bias, m_spatial, expAvgFactor, runMean, runInvStdDev,
-                                      sliceOutputValue, m_epsilon, *m_saveMean, *m_saveInvStdDev);
+                                      sliceOutputValue, m_epsilon, *m_saveMean, *m_saveInvStdDev, relu);
 
             m_mbCount++;
         }
@@ -1762,6 +2296,27 @@ public:
 #endif
     }
 
+    // 'reluOut' is the value of a fused ReLU, which masks the gradient; see ConvolutionEngine::BackwardNormalizeBatch()
+    void BackpropToInput(const FrameRange& fr, const Matrix<ElemType>& sliceOutputGrad, const Matrix<ElemType>* reluOut)
+    {
+        auto sliceInputValue = Input(0)->ValueFor(fr);
+        const Matrix<ElemType>& scale = Input(1)->Value();
+        const Matrix<ElemType>& bias = Input(2)->Value();
+
+        size_t batchSize = sliceInputValue.GetNumCols();
+        m_inT->setN(batchSize);
+        assert(m_convEng != nullptr);
+
+        auto sliceInputGrad = Input(0)->GradientFor(fr);
+        m_dScale->Resize(scale);
+        m_dBias->Resize(bias);
+        // Compute all derivatives in one step. Save derivatives with respect to scale and bias in temp matrices.
+        m_convEng->BackwardNormalizeBatch(*m_inT, sliceInputValue, sliceOutputGrad, sliceInputGrad, *m_scaleBiasT, scale, m_spatial,
+                                          *m_saveMean, *m_saveInvStdDev, *m_dScale, *m_dBias, reluOut);
+    }
+
+public:
+
     void Validate(bool isFinalValidationPass) override
     {
         Base::Validate(isFinalValidationPass);
@@ -1843,6 +2398,13 @@ public:
         m_eval = bnEvalMode;
     }
 
+    bool IsEvalMode() const { return m_eval; }
+    bool IsSpatial() const { return m_spatial; }
+
+    // the number of minibatches in the running statistics, saved and restored with the model parameters
+    size_t GetMBCount() const { return m_mbCount; }
+    void SetMBCount(size_t mbCount) { m_mbCount = mbCount; }
+
 private:
     struct VersionInfo
     {
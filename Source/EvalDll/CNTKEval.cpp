@@ -6,11 +6,18 @@
 //
 
 #include "stdafx.h"
+#include "Basics.h"
 #define EVAL_EXPORTS // creating the exports here
 #include "Eval.h"
 #include "CNTKEval.h"
 #include "CPUMatrix.h" // for SetNumThreads()
+#include "CPUThreadBudget.h"
+#include "ComputeStreamPool.h" // for SharedComputeStreams
 #include "SimpleOutputWriter.h"
+#include "InputAndParamNodes.h"
+#include "LinearAlgebraNodes.h"
+#include "NonlinearityNodes.h"
+#include "RecurrentNodes.h"
 #ifdef LEAKDETECT
 #include <vld.h> // leak detection
 #endif
@@ -47,15 +54,32 @@ void CNTKEval<ElemType>::Init(const std::string& config)
 {
     m_start = 0;
     m_config.Parse(config);
+
+    // The threads of this evaluator: numCPUThreads for OpenMP loops and MKL, on the cores cpuCores=0:1:2:3 (default: any).
+    // They apply to the threads that call into this evaluator, so several evaluators in one process can each get their own.
+    intargvector cpuCores = ConfigArray(m_config("cpuCores", ""), ':', false);
+    std::vector<int> cores;
+    for (size_t i = 0; i < cpuCores.size(); i++)
+        cores.push_back(cpuCores[i]);
+    int nThreads = m_config.Exists("numCPUThreads") ? (int) m_config("numCPUThreads") : cores.empty() ? 1 : (int) cores.size();
+    m_threadBudget = CPUThreadBudget(nThreads, cores);
+    // (BLAS libraries without per-thread settings, i.e. OpenBLAS, keep using the process-wide count)
+    CPUMatrix<ElemType>::SetNumThreads(nThreads);
+
+    // Evaluators on one GPU share its memory cache, library handles and workspace. With sharedGPUStreams=N, each evaluation
+    // takes one of up to N streams per GPU, so that those of different evaluators run concurrently. This is a process-wide setting.
+    if (m_config.Exists("sharedGPUStreams"))
+        SharedComputeStreams::SetMaxStreams(m_config(L"sharedGPUStreams"));
+
     if (m_config.Exists("modelPath"))
     {
         std::wstring path = m_config("modelPath");
         LoadModel(path);
     }
-    size_t nThreads = m_config("numCPUThreads", "1");
-    CPUMatrix<ElemType>::SetNumThreads(nThreads);
 
     g_shareNodeValueMatrices = m_config(L"shareNodeValueMatrices", false);
+    m_minibatchSize = m_config(L"minibatchSize", (size_t) 10240);
+    m_streamRightContext = m_config.Exists("streamRightContext") ? (size_t) m_config(L"streamRightContext") : SIZE_MAX;
 }
 
 // Destroy - cleanup and remove this class
@@ -67,6 +91,7 @@ void CNTKEval<ElemType>::Destroy()
     m_net.reset();
     delete m_reader;
     delete m_writer;
+    delete m_shortlistWriter;
     delete this;
 }
 
@@ -75,9 +100,66 @@ void CNTKEval<ElemType>::Destroy()
 template <class ElemType>
 void CNTKEval<ElemType>::LoadModel(const std::wstring& modelFileName)
 {
+    CPUThreadBudget::Scope threadBudget(m_threadBudget);
     DEVICEID_TYPE deviceId = DeviceFromConfig(m_config);
     fprintf(stderr, "DeviceID=%d\n", (int) deviceId);
-    m_net = ComputationNetwork::CreateFromFile<ElemType>(deviceId, modelFileName);
+    m_net = make_shared<ComputationNetwork>(deviceId);
+    m_outputLayers.clear();
+    delete m_shortlistWriter;
+    m_shortlistWriter = nullptr;
+    // parameters saved as aligned blocks are mapped copy-on-write, so that processes that serve the same model share them
+    m_net->SetMapModelParameters(m_config(L"mapModelParameters", false));
+    m_net->Load<ElemType>(modelFileName);
+
+    // an ensemble of this and further models is merged into one network, which shares their inputs and common preprocessing;
+    // this comes before folding, which leaves shared normalization alone
+    ConfigArray ensembleModelPaths = m_config(L"ensembleModelPaths", "");
+    if (ensembleModelPaths.size() > 0)
+    {
+        wstring ensembleOutputs = m_config(L"ensembleOutputs", L"average");
+        if (ensembleOutputs != L"average" && ensembleOutputs != L"all")
+            InvalidArgument("Invalid value '%ls' for ensembleOutputs parameter. Allowed are 'average' and 'all'.", ensembleOutputs.c_str());
+        vector<ComputationNetworkPtr> members(1, m_net);
+        for (size_t i = 0; i < ensembleModelPaths.size(); i++)
+        {
+            members.push_back(make_shared<ComputationNetwork>(deviceId));
+            members.back()->SetMapModelParameters(m_config(L"mapModelParameters", false));
+            members.back()->Load<ElemType>(ensembleModelPaths[i]);
+        }
+        m_net = make_shared<ComputationNetwork>(deviceId);
+        m_net->MergeEnsemble<ElemType>(members, ensembleOutputs == L"average");
+    }
+
+    // BatchNormalization and PerDimMeanVarNormalization are folded into the adjacent weights, before these may be quantized
+    if (m_config(L"foldNormalization", true))
+        m_net->FoldNormalizationIntoWeights<ElemType>();
+
+    // block-sparse weights for the Times nodes of pruned models (see the "prune" action); the others may still be quantized below
+    if (m_config(L"sparseWeights", false))
+    {
+        if (deviceId != CPUDEVICE)
+            InvalidArgument("sparseWeights is only supported with deviceId=cpu.");
+        size_t blockRows = m_config(L"sparseWeightsBlockRows", (size_t) 1);
+        size_t blockCols = m_config(L"sparseWeightsBlockCols", (size_t) 1);
+        double minSparsity = m_config(L"sparseWeightsMinSparsity", 0.5);
+        m_net->UseBlockSparseWeights<ElemType>(blockRows, blockCols, minSparsity);
+    }
+
+    // int8 weights for Times and Convolution nodes, which trades some accuracy for memory and CPU speed
+    if (m_config(L"quantizeWeightsToInt8", false))
+    {
+        if (deviceId != CPUDEVICE)
+            InvalidArgument("quantizeWeightsToInt8 is only supported with deviceId=cpu.");
+        m_net->QuantizeWeightsToInt8<ElemType>();
+    }
+
+    // the weights of the remaining Times nodes are packed for GEMM once here, instead of inside every BLAS call
+    if (m_config(L"packWeights", false))
+    {
+        if (deviceId != CPUDEVICE)
+            InvalidArgument("packWeights is only supported with deviceId=cpu.");
+        m_net->PackWeights<ElemType>();
+    }
 }
 
 // GetNodeDimensions - Get the node dimensions of the specified nodes
@@ -143,36 +225,608 @@ void CNTKEval<ElemType>::StartEvaluateMinibatchLoop(const std::wstring& outputNo
 template <class ElemType>
 void CNTKEval<ElemType>::Evaluate(std::map<std::wstring, std::vector<ElemType>*>& inputs, std::map<std::wstring, std::vector<ElemType>*>& outputs)
 {
-    size_t minibatchSize = m_config(L"minibatchSize", (size_t) 10240);
-    // get the evaluation names from the output string
-    vector<wstring> outNodeNames;
+    std::lock_guard<std::mutex> lock(m_evalMutex);
+    EvaluateLocked(inputs, outputs, nullptr);
+}
 
-    ConfigParameters config;
-    // config["deviceId"] = to_string(m_net->GetDeviceId());
+// EvaluateConcurrent - Evaluate one independent sequence; may be called from many threads at once
+// Concurrent calls are merged into one minibatch with one parallel sequence per call, see EvalBatcher.
+// Config: batchingMaxLatencyMs=2 (how long to wait for more requests), batchingMaxRequests=64 (sequences per minibatch)
+template <class ElemType>
+void CNTKEval<ElemType>::EvaluateConcurrent(std::map<std::wstring, std::vector<ElemType>*>& inputs, std::map<std::wstring, std::vector<ElemType>*>& outputs)
+{
+    auto evaluate = [this](std::map<std::wstring, std::vector<ElemType>*>& batchInputs, std::map<std::wstring, std::vector<ElemType>*>& batchOutputs,
+                           const std::vector<size_t>& sequenceLengths, const std::vector<size_t>& /*tags*/)
+    {
+        std::lock_guard<std::mutex> lock(m_evalMutex);
+        EvaluateLocked(batchInputs, batchOutputs, &sequenceLengths);
+    };
+    GetBatcher(m_batcher, evaluate)->Evaluate(inputs, outputs);
+}
 
-    // create the reader if necessary
-    if (m_reader == nullptr)
+// creates 'batcher' on first use
+template <class ElemType>
+EvalBatcher<ElemType>* CNTKEval<ElemType>::GetBatcher(std::unique_ptr<EvalBatcher<ElemType>>& batcher, const typename EvalBatcher<ElemType>::BatchEvaluator& evaluate)
+{
+    std::lock_guard<std::mutex> lock(m_batcherMutex);
+    if (!batcher)
     {
-        m_reader = new EvalReader<ElemType>(config);
+        if (m_net == nullptr)
+            LogicError("EvaluateConcurrent: No model has been loaded.");
+        std::map<std::wstring, size_t> inputDims, outputDims;
+        {
+            std::lock_guard<std::mutex> evalLock(m_evalMutex);
+            GetNodeDimensions(inputDims, nodeInput);
+            GetNodeDimensions(outputDims, nodeOutput);
+        }
+        batcher.reset(new EvalBatcher<ElemType>(evaluate, inputDims, outputDims, m_config(L"batchingMaxLatencyMs", (size_t) 2), m_config(L"batchingMaxRequests", (size_t) 64)));
     }
+    return batcher.get();
+}
 
-    // now set the data in the reader
-    GetNodeDimensions(m_dimensions, nodeInput);
-    m_reader->SetData(&inputs, &m_dimensions);
-    m_reader->SetBoundary(m_start);
-    // create the reader if necessary
+// CreateStream - Create a handle for the recurrent state of a new stream, which starts with its first EvaluateStream() call
+template <class ElemType>
+size_t CNTKEval<ElemType>::CreateStream()
+{
+    std::lock_guard<std::mutex> lock(m_streamsMutex);
+    size_t id = ++m_lastStreamId;
+    Stream& stream = m_streams[id];
+    stream.m_numFrames = 0;
+    stream.m_busy = false;
+    stream.m_numChunkFrames = 0;
+    return id;
+}
+
+// DestroyStream - Release a stream and its recurrent state
+template <class ElemType>
+void CNTKEval<ElemType>::DestroyStream(size_t stream)
+{
+    std::lock_guard<std::mutex> lock(m_streamsMutex);
+    auto iter = m_streams.find(stream);
+    if (iter == m_streams.end())
+        InvalidArgument("DestroyStream: Unknown stream %d.", (int) stream);
+    if (iter->second.m_busy)
+        InvalidArgument("DestroyStream: Stream %d is being evaluated.", (int) stream);
+    m_streams.erase(iter);
+}
+
+// EvaluateStream - Evaluate the next chunk of frames of a stream, continuing from its recurrent state
+// Concurrent calls for different streams are merged into one minibatch with one parallel sequence per stream, like EvaluateConcurrent();
+// the state of each stream is gathered into the PastValue nodes before, and scattered back after the forward pass.
+// The chunks of one stream must be evaluated one after the other. FutureValue nodes can only be evaluated in chunks
+// latency-controlled (streamRightContext=N, see EvaluateLatencyControlled()).
+template <class ElemType>
+void CNTKEval<ElemType>::EvaluateStream(size_t stream, std::map<std::wstring, std::vector<ElemType>*>& inputs, std::map<std::wstring, std::vector<ElemType>*>& outputs)
+{
+    Stream* busyStream;
+    {
+        std::lock_guard<std::mutex> lock(m_streamsMutex);
+        auto iter = m_streams.find(stream);
+        if (iter == m_streams.end())
+            InvalidArgument("EvaluateStream: Unknown stream %d.", (int) stream);
+        if (iter->second.m_busy)
+            InvalidArgument("EvaluateStream: Stream %d is already being evaluated; the chunks of a stream must be evaluated one after the other.", (int) stream);
+        iter->second.m_busy = true;
+        busyStream = &iter->second;
+    }
+
+    std::exception_ptr error;
+    try
+    {
+        if (m_streamRightContext == SIZE_MAX)
+        {
+            busyStream->m_numChunkFrames = SIZE_MAX; // all of them
+            GetStreamBatcher()->Evaluate(inputs, outputs, stream);
+        }
+        else
+            EvaluateLatencyControlled(stream, *busyStream, inputs, outputs, /*endOfStream=*/false);
+    }
+    catch (...)
+    {
+        error = std::current_exception();
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_streamsMutex);
+        m_streams[stream].m_busy = false;
+    }
+    if (error)
+        std::rethrow_exception(error);
+}
+
+// EndStream - Evaluate the frames a latency-controlled stream holds back as right context, and start the stream over
+template <class ElemType>
+void CNTKEval<ElemType>::EndStream(size_t stream, std::map<std::wstring, std::vector<ElemType>*>& outputs)
+{
+    Stream* busyStream;
+    {
+        std::lock_guard<std::mutex> lock(m_streamsMutex);
+        auto iter = m_streams.find(stream);
+        if (iter == m_streams.end())
+            InvalidArgument("EndStream: Unknown stream %d.", (int) stream);
+        if (iter->second.m_busy)
+            InvalidArgument("EndStream: Stream %d is being evaluated.", (int) stream);
+        iter->second.m_busy = true;
+        busyStream = &iter->second;
+    }
+
+    std::exception_ptr error;
+    try
+    {
+        std::map<std::wstring, std::vector<ElemType>*> noInputs;
+        if (m_streamRightContext == SIZE_MAX)
+        {
+            for (auto& output : outputs)
+                output.second->clear();
+        }
+        else
+            EvaluateLatencyControlled(stream, *busyStream, noInputs, outputs, /*endOfStream=*/true);
+    }
+    catch (...)
+    {
+        error = std::current_exception();
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_streamsMutex);
+        Stream& s = m_streams[stream];
+        s.m_busy = false;
+        s.m_numFrames = 0;
+        s.m_states.clear();
+        s.m_rightContext.clear();
+    }
+    if (error)
+        std::rethrow_exception(error);
+}
+
+// latency-controlled streams: the chunk that is evaluated are the frames held back from the previous call followed by the new ones.
+// Of these, the last m_streamRightContext frames are only the right context of the chunk, which the FutureValue nodes see
+// as the end of the sequence. Their outputs are dropped, the PastValue nodes keep their state from before them, and they
+// are held back to be evaluated again at the start of the next chunk, so that the outputs lag the inputs by that many frames.
+// At the end of the stream, the frames held back are evaluated as a last chunk without right context.
+template <class ElemType>
+void CNTKEval<ElemType>::EvaluateLatencyControlled(size_t streamId, Stream& stream, std::map<std::wstring, std::vector<ElemType>*>& inputs,
+                                                   std::map<std::wstring, std::vector<ElemType>*>& outputs, bool endOfStream)
+{
+    if (m_net == nullptr)
+        LogicError("EvaluateStream: No model has been loaded.");
+
+    std::map<std::wstring, std::vector<ElemType>> chunkData = stream.m_rightContext;
+    for (auto& input : inputs)
+    {
+        auto& data = chunkData[input.first];
+        data.insert(data.end(), input.second->begin(), input.second->end());
+    }
+    size_t numFrames = 0;
+    if (!chunkData.empty())
+        numFrames = chunkData.begin()->second.size() / m_net->GetNodeFromName(chunkData.begin()->first)->GetSampleMatrixNumRows();
+    const size_t numRightContext = endOfStream ? 0 : min(numFrames, m_streamRightContext);
+
+    stream.m_numChunkFrames = numFrames - numRightContext;
+    if (stream.m_numChunkFrames > 0)
+    {
+        std::map<std::wstring, std::vector<ElemType>*> chunkInputs;
+        for (auto& input : chunkData)
+            chunkInputs[input.first] = &input.second;
+        GetStreamBatcher()->Evaluate(chunkInputs, outputs, streamId);
+    }
+    for (auto& output : outputs)
+        output.second->resize(stream.m_numChunkFrames * m_net->GetNodeFromName(output.first)->GetSampleMatrixNumRows());
+
+    stream.m_rightContext.clear();
+    for (auto& input : chunkData)
+    {
+        const size_t numValues = numRightContext * m_net->GetNodeFromName(input.first)->GetSampleMatrixNumRows();
+        stream.m_rightContext[input.first].assign(input.second.end() - numValues, input.second.end());
+    }
+}
+
+template <class ElemType>
+EvalBatcher<ElemType>* CNTKEval<ElemType>::GetStreamBatcher()
+{
+    auto evaluate = [this](std::map<std::wstring, std::vector<ElemType>*>& batchInputs, std::map<std::wstring, std::vector<ElemType>*>& batchOutputs,
+                           const std::vector<size_t>& sequenceLengths, const std::vector<size_t>& streamIds)
+    {
+        std::lock_guard<std::mutex> lock(m_evalMutex);
+        EvaluateStreamsLocked(batchInputs, batchOutputs, sequenceLengths, streamIds);
+    };
+    return GetBatcher(m_streamBatcher, evaluate);
+}
+
+// evaluates one chunk of each of the given streams, with m_evalMutex held
+template <class ElemType>
+void CNTKEval<ElemType>::EvaluateStreamsLocked(std::map<std::wstring, std::vector<ElemType>*>& inputs, std::map<std::wstring, std::vector<ElemType>*>& outputs,
+                                               const std::vector<size_t>& sequenceLengths, const std::vector<size_t>& streamIds)
+{
+    if (!m_streamingNodesDetermined)
+    {
+        for (const auto& output : m_net->OutputNodes())
+        {
+            for (const auto& node : m_net->GetEvalOrder(output))
+            {
+                if (!dynamic_pointer_cast<IStatefulNode>(node))
+                    continue;
+                if (m_streamRightContext != SIZE_MAX && node->OperationName() == OperationNameOf(FutureValueNode))
+                    continue; // starts over with each latency-controlled chunk
+                auto streamingNode = dynamic_pointer_cast<IStreamingNode>(node);
+                if (!streamingNode)
+                    InvalidArgument("EvaluateStream: %ls %ls operation cannot carry state for streams.", node->NodeName().c_str(), node->OperationName().c_str());
+                if (find(m_streamingNodes.begin(), m_streamingNodes.end(), streamingNode) == m_streamingNodes.end())
+                    m_streamingNodes.push_back(streamingNode);
+            }
+        }
+        m_streamingNodesDetermined = true;
+    }
+
+    // the streams are busy, so nothing else touches their states
+    std::vector<Stream*> streams;
+    {
+        std::lock_guard<std::mutex> lock(m_streamsMutex);
+        for (size_t id : streamIds)
+            streams.push_back(&m_streams[id]);
+    }
+    const size_t numStreams = streams.size();
+    std::vector<size_t> numPastFrames, numChunkFrames;
+    for (size_t s = 0; s < numStreams; s++)
+    {
+        numPastFrames.push_back(streams[s]->m_numFrames);
+        numChunkFrames.push_back(min(sequenceLengths[s], streams[s]->m_numChunkFrames));
+    }
+
+    std::vector<std::vector<NodeStatePtr>> states(m_streamingNodes.size(), std::vector<NodeStatePtr>(numStreams));
+    for (size_t n = 0; n < m_streamingNodes.size(); n++)
+    {
+        for (size_t s = 0; s < numStreams; s++)
+        {
+            if (!streams[s]->m_states.empty())
+                states[n][s] = streams[s]->m_states[n];
+        }
+        m_streamingNodes[n]->GatherStreamStates(states[n], numStreams);
+    }
+
+    EvaluateLocked(inputs, outputs, &sequenceLengths, &numPastFrames);
+
+    for (size_t n = 0; n < m_streamingNodes.size(); n++)
+        m_streamingNodes[n]->ScatterStreamStates(states[n], numChunkFrames);
+    for (size_t s = 0; s < numStreams; s++)
+    {
+        streams[s]->m_states.resize(m_streamingNodes.size());
+        for (size_t n = 0; n < m_streamingNodes.size(); n++)
+            streams[s]->m_states[n] = states[n][s];
+        streams[s]->m_numFrames += numChunkFrames[s];
+    }
+}
+
+// BindInput - Bind a caller-owned buffer to an input node for EvaluateBound()
+// deviceId - -1 for host memory, otherwise the GPU of the model
+template <class ElemType>
+void CNTKEval<ElemType>::BindInput(const std::wstring& nodeName, ElemType* buffer, size_t capacity, int deviceId)
+{
+    std::lock_guard<std::mutex> lock(m_evalMutex);
+    Bind(m_boundInputs, nodeName, buffer, capacity, deviceId);
+}
+
+// BindOutput - Bind a caller-owned buffer to an output node for EvaluateBound()
+// deviceId - -1 for host memory, otherwise the GPU of the model
+template <class ElemType>
+void CNTKEval<ElemType>::BindOutput(const std::wstring& nodeName, ElemType* buffer, size_t capacity, int deviceId)
+{
+    std::lock_guard<std::mutex> lock(m_evalMutex);
+    Bind(m_boundOutputs, nodeName, buffer, capacity, deviceId);
+}
+
+template <class ElemType>
+void CNTKEval<ElemType>::Bind(std::vector<BoundBuffer>& bindings, const std::wstring& nodeName, ElemType* buffer, size_t capacity, int deviceId)
+{
+    if (m_net == nullptr)
+        LogicError("Bind: No model has been loaded.");
+    if (buffer == nullptr)
+        InvalidArgument("Bind: The buffer for node %ls is null.", nodeName.c_str());
+    if (deviceId != CPUDEVICE && deviceId != m_net->GetDeviceId())
+        InvalidArgument("Bind: The buffer for node %ls is on device %d, but the model is on device %d. Use -1 for host memory.", nodeName.c_str(), deviceId, (int) m_net->GetDeviceId());
+    auto node = dynamic_pointer_cast<ComputationNode<ElemType>>(m_net->GetNodeFromName(nodeName));
+    if (node->Value().GetMatrixType() != DENSE)
+        InvalidArgument("Bind: Node %ls has a sparse value, which cannot be bound to a buffer.", nodeName.c_str());
+
+    BoundBuffer binding;
+    binding.m_node = node;
+    binding.m_buffer = buffer;
+    binding.m_capacity = capacity;
+    binding.m_deviceId = deviceId;
+    binding.m_aliasedNumSamples = 0;
+    if (&bindings == &m_boundOutputs && deviceId != CPUDEVICE)
+        binding.m_gpuView = make_shared<Matrix<ElemType>>(deviceId);
+
+    auto iter = find_if(bindings.begin(), bindings.end(), [&node](const BoundBuffer& b) { return b.m_node == node; });
+    if (iter == bindings.end())
+        bindings.push_back(binding);
+    else
+    {
+        if (iter->m_aliasedNumSamples > 0) // don't keep pointing into a buffer the caller may free now
+            DetachBoundInputs();
+        *iter = binding;
+    }
+    m_boundPrepared = false;
+}
+
+// give the input nodes that alias a bound buffer their own memory again, before anything else writes into them
+template <class ElemType>
+void CNTKEval<ElemType>::DetachBoundInputs()
+{
+    for (auto& b : m_boundInputs)
+    {
+        if (b.m_aliasedNumSamples == 0)
+            continue;
+        b.m_node->Value() = Matrix<ElemType>(b.m_node->GetSampleMatrixNumRows(), 0, b.m_node->Value().GetDeviceId());
+        b.m_aliasedNumSamples = 0;
+    }
+}
+
+// allocates the matrices for the bound outputs; done once per change of the bindings, not per EvaluateBound() call
+template <class ElemType>
+void CNTKEval<ElemType>::PrepareBound()
+{
+    if (m_boundOutputs.empty())
+        LogicError("EvaluateBound: No output has been bound.");
+    m_boundOutputNodes.clear();
+    for (auto& b : m_boundOutputs)
+        m_boundOutputNodes.push_back(b.m_node);
+    m_net->AllocateAllMatrices({}, m_boundOutputNodes, nullptr);
+    m_net->StartEvaluateMinibatchLoop(m_boundOutputNodes);
+
+    // all inputs the outputs depend on must be bound
+    m_boundInputNodes.clear();
+    for (auto& output : m_boundOutputNodes)
+    {
+        for (auto& input : m_net->InputNodes(output))
+        {
+            if (find_if(m_boundInputs.begin(), m_boundInputs.end(), [&input](const BoundBuffer& b) { return b.m_node == input; }) == m_boundInputs.end())
+                InvalidArgument("EvaluateBound: Input %ls is needed for output %ls, but has not been bound.", input->NodeName().c_str(), output->NodeName().c_str());
+            if (find(m_boundInputNodes.begin(), m_boundInputNodes.end(), input) == m_boundInputNodes.end())
+                m_boundInputNodes.push_back(input);
+        }
+    }
+    m_boundPrepared = true;
+}
+
+// EvaluateBound - Evaluate the bound outputs from 'numSamples' samples in the bound input buffers, as one new sequence
+// Input buffers on the device of the model become the values of the input nodes, so nothing is copied on the input side;
+// host buffers for a GPU model take a single host-to-device copy. Output values live in the shared matrix pool,
+// so each output takes one copy straight into its buffer.
+template <class ElemType>
+void CNTKEval<ElemType>::EvaluateBound(size_t numSamples)
+{
+    std::lock_guard<std::mutex> lock(m_evalMutex);
+    CPUThreadBudget::Scope threadBudget(m_threadBudget);
+    if (m_net == nullptr)
+        LogicError("EvaluateBound: No model has been loaded.");
+    SharedComputeStreams::Scope stream(m_net->GetDeviceId());
+    if (numSamples == 0)
+        InvalidArgument("EvaluateBound: At least one sample is needed.");
+    if (!m_boundPrepared)
+        PrepareBound();
+
+    const auto& pMBLayout = m_net->GetMBLayoutPtr();
+    pMBLayout->Init(1, numSamples);
+    pMBLayout->AddSequence(NEW_SEQUENCE_ID, 0, 0, numSamples);
+
+    for (auto& b : m_boundInputs)
+    {
+        const size_t numRows = b.m_node->GetSampleMatrixNumRows();
+        if (numRows * numSamples > b.m_capacity)
+            InvalidArgument("EvaluateBound: %d samples of input %ls need %d elements, but its buffer holds %d.", (int) numSamples, b.m_node->NodeName().c_str(), (int) (numRows * numSamples), (int) b.m_capacity);
+        auto& value = b.m_node->Value();
+        if (b.m_deviceId == value.GetDeviceId())
+        {
+            if (b.m_aliasedNumSamples != numSamples)
+            {
+                value.SetValue(numRows, numSamples, b.m_deviceId, b.m_buffer, matrixFlagDontOwnBuffer);
+                b.m_aliasedNumSamples = numSamples;
+            }
+        }
+        else
+            value.SetValue(numRows, numSamples, value.GetDeviceId(), b.m_buffer);
+        b.m_node->NotifyFunctionValuesMBSizeModified();
+    }
+
+    ComputationNetwork::BumpEvalTimeStamp(m_boundInputNodes);
+    for (auto& node : m_boundOutputNodes)
+        m_net->ForwardProp(node);
+
+    for (auto& b : m_boundOutputs)
+    {
+        const auto& value = b.m_node->Value();
+        if (value.GetNumElements() > b.m_capacity)
+            InvalidArgument("EvaluateBound: Output %ls has %d elements, but its buffer holds %d.", b.m_node->NodeName().c_str(), (int) value.GetNumElements(), (int) b.m_capacity);
+        if (b.m_deviceId == CPUDEVICE)
+            value.CopySection(value.GetNumRows(), value.GetNumCols(), b.m_buffer, value.GetNumRows());
+        else
+        {
+            b.m_gpuView->SetValue(value.GetNumRows(), value.GetNumCols(), b.m_deviceId, b.m_buffer, matrixFlagDontOwnBuffer);
+            b.m_gpuView->SetValue(value);
+        }
+    }
+}
+
+// Warmup - Evaluate zeros in the largest expected shape once, so that the first requests do not allocate
+// The matrices only grow, so after a minibatch of 'maxNumSequences' parallel sequences of 'maxSequenceLength' frames,
+// smaller minibatches find them (and the shared matrices of the memory pool) large enough, and the cuDNN algorithms
+// have been selected for at least that many samples.
+template <class ElemType>
+void CNTKEval<ElemType>::Warmup(size_t maxNumSequences, size_t maxSequenceLength)
+{
+    if (maxNumSequences == 0 || maxSequenceLength == 0)
+        InvalidArgument("Warmup: The number of sequences and their length must be positive.");
+
+    std::lock_guard<std::mutex> lock(m_evalMutex);
+    if (m_net == nullptr)
+        LogicError("Warmup: No model has been loaded.");
+
+    std::map<std::wstring, size_t> inputDims, outputDims;
+    GetNodeDimensions(inputDims, nodeInput);
+    GetNodeDimensions(outputDims, nodeOutput);
+    std::map<std::wstring, std::vector<ElemType>> inputData, outputData;
+    std::map<std::wstring, std::vector<ElemType>*> inputs, outputs;
+    for (const auto& input : inputDims)
+    {
+        inputData[input.first].assign(input.second * maxNumSequences * maxSequenceLength, 0);
+        inputs[input.first] = &inputData[input.first];
+    }
+    for (const auto& output : outputDims)
+        outputs[output.first] = &outputData[output.first];
+
+    // as independent parallel sequences, in one minibatch, and without touching the state of Evaluate()
+    std::vector<size_t> sequenceLengths(maxNumSequences, maxSequenceLength);
+    EvaluateLocked(inputs, outputs, &sequenceLengths);
+}
+
+// EvaluateShortlist - Evaluate the logits of the given rows of an output, from the weights of only these rows
+// The output must be W x + b (Times, or TransposeTimes with W stored transposed), optionally followed by Softmax or LogSoftmax,
+// where W and b are parameters. The network is evaluated up to x, and the rows of W for the shortlist are gathered into
+// one small product per minibatch on the device of the model, instead of the product with all of W.
+template <class ElemType>
+void CNTKEval<ElemType>::EvaluateShortlist(std::map<std::wstring, std::vector<ElemType>*>& inputs, const std::wstring& outputNodeName, const std::vector<size_t>& shortlist, std::vector<ElemType>& scores)
+{
+    std::lock_guard<std::mutex> lock(m_evalMutex);
+    if (m_net == nullptr)
+        LogicError("EvaluateShortlist: No model has been loaded.");
+    if (shortlist.empty())
+        InvalidArgument("EvaluateShortlist: The shortlist is empty.");
+
+    const OutputLayer& layer = GetOutputLayer(outputNodeName);
+    const size_t outputDim = layer.m_weights.GetNumCols();
+    for (size_t index : shortlist)
+    {
+        if (index >= outputDim)
+            InvalidArgument("EvaluateShortlist: Index %d in the shortlist is out of the range of output %ls [0, %d).", (int) index, outputNodeName.c_str(), (int) outputDim);
+    }
+
+    if (m_shortlistWriter == nullptr)
+        m_shortlistWriter = new EvalShortlistWriter<ElemType>(m_net->GetDeviceId());
+    m_shortlistWriter->SetShortlist(layer.m_hiddenNodeName, layer.m_weights, layer.m_bias, shortlist, &scores);
+    EvaluateInto(inputs, *m_shortlistWriter, vector<wstring>(1, layer.m_hiddenNodeName), nullptr, nullptr);
+}
+
+// EvaluateTopK - Evaluate an output, and copy back only its k largest values of each frame and their rows
+// The full output is computed as by Evaluate(), but the values are selected by a partial sort on the device of the model,
+// so that only k of each frame are copied to the host.
+template <class ElemType>
+void CNTKEval<ElemType>::EvaluateTopK(std::map<std::wstring, std::vector<ElemType>*>& inputs, const std::wstring& outputNodeName, size_t k, std::vector<size_t>& indices, std::vector<ElemType>& scores)
+{
+    std::lock_guard<std::mutex> lock(m_evalMutex);
+    if (m_net == nullptr)
+        LogicError("EvaluateTopK: No model has been loaded.");
+    const size_t outputDim = m_net->GetNodeFromName(outputNodeName)->GetSampleMatrixNumRows();
+    if (k == 0 || k > outputDim)
+        InvalidArgument("EvaluateTopK: k must be between 1 and the dimension %d of output %ls, but is %d.", (int) outputDim, outputNodeName.c_str(), (int) k);
+
+    if (m_shortlistWriter == nullptr)
+        m_shortlistWriter = new EvalShortlistWriter<ElemType>(m_net->GetDeviceId());
+    m_shortlistWriter->SetTopK(outputNodeName, k, &indices, &scores);
+    EvaluateInto(inputs, *m_shortlistWriter, vector<wstring>(1, outputNodeName), nullptr, nullptr);
+}
+
+// finds W, b and x of an output Softmax(W x + b) or the like, and keeps W and b with one column per output row
+// For Times, this is a transposed copy of W, which is made once per output.
+template <class ElemType>
+const typename CNTKEval<ElemType>::OutputLayer& CNTKEval<ElemType>::GetOutputLayer(const std::wstring& outputNodeName)
+{
+    auto iter = m_outputLayers.find(outputNodeName);
+    if (iter != m_outputLayers.end())
+        return *iter->second;
+
+    ComputationNodeBasePtr node = m_net->GetNodeFromName(outputNodeName);
+    const size_t outputDim = node->GetSampleMatrixNumRows();
+    if (node->OperationName() == OperationNameOf(SoftmaxNode) || node->OperationName() == OperationNameOf(LogSoftmaxNode))
+        node = node->Input(0);
+    ComputationNodeBasePtr bias;
+    if (node->OperationName() == OperationNameOf(PlusNode))
+    {
+        size_t biasInput = node->Input(1)->OperationName() == OperationNameOf(LearnableParameter) ? 1 : 0;
+        bias = node->Input(biasInput);
+        node = node->Input(1 - biasInput);
+    }
+    const bool isTimes = node->OperationName() == OperationNameOf(TimesNode);
+    if ((!isTimes && node->OperationName() != OperationNameOf(TransposeTimesNode)) || node->Input(0)->OperationName() != OperationNameOf(LearnableParameter) ||
+        (bias && bias->OperationName() != OperationNameOf(LearnableParameter)))
+        InvalidArgument("EvaluateShortlist: Output %ls is not of the form W x + b, optionally followed by Softmax or LogSoftmax, where W and b are parameters.", outputNodeName.c_str());
+
+    const auto& weights = dynamic_pointer_cast<ComputationNode<ElemType>>(node->Input(0))->Value();
+    if (weights.IsEmpty())
+        InvalidArgument("EvaluateShortlist: The weights %ls of output %ls were replaced by a packed, int8 or sparse copy.", node->Input(0)->NodeName().c_str(), outputNodeName.c_str());
+    unique_ptr<OutputLayer> layer(new OutputLayer(m_net->GetDeviceId()));
+    layer->m_hiddenNodeName = node->Input(1)->NodeName();
+    if (isTimes)
+        layer->m_weights.AssignTransposeOf(weights);
+    else
+        layer->m_weights.SetValue(weights);
+    const size_t hiddenDim = node->Input(1)->GetSampleMatrixNumRows();
+    if (layer->m_weights.GetNumRows() != hiddenDim || layer->m_weights.GetNumCols() != outputDim)
+        InvalidArgument("EvaluateShortlist: The weights %ls of output %ls do not map the %d dimensions of %ls to the %d of the output.",
+                        node->Input(0)->NodeName().c_str(), outputNodeName.c_str(), (int) hiddenDim, layer->m_hiddenNodeName.c_str(), (int) outputDim);
+    if (bias)
+    {
+        const auto& biasValue = dynamic_pointer_cast<ComputationNode<ElemType>>(bias)->Value();
+        if (biasValue.GetNumElements() != outputDim)
+            InvalidArgument("EvaluateShortlist: The bias %ls of output %ls does not have the %d elements of the output.", bias->NodeName().c_str(), outputNodeName.c_str(), (int) outputDim);
+        layer->m_bias.SetValue(biasValue);
+        layer->m_bias.Reshape(1, outputDim);
+    }
+    return *(m_outputLayers[outputNodeName] = move(layer));
+}
+
+// evaluates with m_evalMutex held; 'sequenceLengths' is given for the interleaved parallel sequences of EvaluateConcurrent(),
+// and 'numPastFrames' for those of EvaluateStream() that continue a stream
+template <class ElemType>
+void CNTKEval<ElemType>::EvaluateLocked(std::map<std::wstring, std::vector<ElemType>*>& inputs, std::map<std::wstring, std::vector<ElemType>*>& outputs,
+                                        const std::vector<size_t>* sequenceLengths, const std::vector<size_t>* numPastFrames)
+{
+    // create the writer if necessary
     if (m_writer == nullptr)
     {
+        ConfigParameters config;
         m_writer = new EvalWriter<ElemType>(config);
     }
 
-    // now set the data in the reader
+    // now set the data in the writer
     GetNodeDimensions(m_dimensions, nodeOutput);
     m_writer->SetData(&outputs, &m_dimensions);
 
+    // the outputs of the model
+    EvaluateInto(inputs, *m_writer, vector<wstring>(), sequenceLengths, numPastFrames);
+}
+
+// runs 'inputs' through the network into 'writer', for the nodes 'outputNodeNames' (the outputs of the model if empty), with m_evalMutex held
+template <class ElemType>
+void CNTKEval<ElemType>::EvaluateInto(std::map<std::wstring, std::vector<ElemType>*>& inputs, IDataWriter& writer, const std::vector<std::wstring>& outputNodeNames,
+                                      const std::vector<size_t>* sequenceLengths, const std::vector<size_t>* numPastFrames)
+{
+    CPUThreadBudget::Scope threadBudget(m_threadBudget);
+    SharedComputeStreams::Scope stream(m_net != nullptr ? m_net->GetDeviceId() : CPUDEVICE);
+
+    // the reader writes into the input values, and the matrices are allocated for other outputs
+    DetachBoundInputs();
+    m_boundPrepared = false;
+
+    size_t minibatchSize = m_minibatchSize;
+
+    // create the reader if necessary
+    if (m_reader == nullptr)
+    {
+        ConfigParameters config;
+        m_reader = new EvalReader<ElemType>(config);
+    }
+
+    // now set the data in the reader
+    GetNodeDimensions(m_dimensions, nodeInput);
+    m_reader->SetData(&inputs, &m_dimensions);
+    m_reader->SetSequenceLengths(sequenceLengths, numPastFrames);
+    if (sequenceLengths)
+        minibatchSize = SIZE_MAX; // parallel sequences must go in one minibatch
+    else
+        m_reader->SetBoundary(m_start);
+
     // call the evaluator
     SimpleOutputWriter<ElemType> eval(m_net);
-    eval.WriteOutput(*m_reader, minibatchSize, *m_writer, outNodeNames);
+    eval.WriteOutput(*m_reader, minibatchSize, writer, outputNodeNames);
 }
 
 // ResetState - Reset the cell state when we get start of an utterance
@@ -9,12 +9,17 @@
 #include <string>
 #include <map>
 #include <vector>
+#include <memory>
+#include <mutex>
 
 #include "Eval.h"
 #include "EvalReader.h"
 #include "EvalWriter.h"
+#include "EvalShortlistWriter.h"
+#include "EvalBatcher.h"
 
 #include "ComputationNetwork.h"
+#include "CPUThreadBudget.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -24,15 +29,81 @@ class CNTKEval : public IEvaluateModel<ElemType>
     typedef shared_ptr<ComputationNode<ElemType>> ComputationNodePtr;
     EvalReader<ElemType>* m_reader;
     EvalWriter<ElemType>* m_writer;
+    EvalShortlistWriter<ElemType>* m_shortlistWriter;
     ConfigParameters m_config;
+    size_t m_minibatchSize; // read from m_config once by Init(), not on every evaluation
+    CPUThreadBudget m_threadBudget; // applied to the calling thread while evaluating
     ComputationNetworkPtr m_net;
     std::map<std::wstring, size_t> m_dimensions;
     size_t m_start;
 
+    std::mutex m_evalMutex; // the network can only run one minibatch at a time
+    std::mutex m_batcherMutex;
+    std::unique_ptr<EvalBatcher<ElemType>> m_batcher;       // created by the first EvaluateConcurrent() call
+    std::unique_ptr<EvalBatcher<ElemType>> m_streamBatcher; // created by the first EvaluateStream() call
+
+    // a stream of EvaluateStream() calls, with the recurrent state after its last chunk
+    struct Stream
+    {
+        size_t m_numFrames;                 // frames evaluated so far
+        std::vector<NodeStatePtr> m_states; // one per node in m_streamingNodes, empty before the first chunk
+        bool m_busy;                        // a chunk of this stream is being evaluated
+        size_t m_numChunkFrames;            // of the chunk being evaluated, the frames that are not only right context
+        std::map<std::wstring, std::vector<ElemType>> m_rightContext; // latency-controlled: the inputs of the frames held back for the next chunk
+    };
+    std::mutex m_streamsMutex; // protects the map, not the states, which only the batch that evaluates a stream touches
+    std::map<size_t, Stream> m_streams;
+    size_t m_lastStreamId;
+    std::vector<shared_ptr<IStreamingNode>> m_streamingNodes;
+    bool m_streamingNodesDetermined;
+    size_t m_streamRightContext; // latency-controlled streams: frames of right context of each chunk; SIZE_MAX if FutureValue nodes cannot be streamed
+
+    EvalBatcher<ElemType>* GetBatcher(std::unique_ptr<EvalBatcher<ElemType>>& batcher, const typename EvalBatcher<ElemType>::BatchEvaluator& evaluate);
+    EvalBatcher<ElemType>* GetStreamBatcher();
+    void EvaluateLatencyControlled(size_t streamId, Stream& stream, std::map<std::wstring, std::vector<ElemType>*>& inputs, std::map<std::wstring, std::vector<ElemType>*>& outputs, bool endOfStream);
+    void EvaluateStreamsLocked(std::map<std::wstring, std::vector<ElemType>*>& inputs, std::map<std::wstring, std::vector<ElemType>*>& outputs,
+                               const std::vector<size_t>& sequenceLengths, const std::vector<size_t>& streamIds);
+
+    // a caller-owned buffer bound to an input or output node, see BindInput()
+    struct BoundBuffer
+    {
+        ComputationNodePtr m_node;
+        ElemType* m_buffer;
+        size_t m_capacity;
+        int m_deviceId;
+        size_t m_aliasedNumSamples;              // inputs: number of columns of the node's value that currently alias the buffer, 0 if none
+        shared_ptr<Matrix<ElemType>> m_gpuView; // outputs in GPU memory: a matrix over the buffer, to copy into
+    };
+    std::vector<BoundBuffer> m_boundInputs;
+    std::vector<BoundBuffer> m_boundOutputs;
+    std::vector<ComputationNodeBasePtr> m_boundOutputNodes;
+    std::vector<ComputationNodeBasePtr> m_boundInputNodes;
+    bool m_boundPrepared; // matrices are allocated for the bound outputs
+
+    void Bind(std::vector<BoundBuffer>& bindings, const std::wstring& nodeName, ElemType* buffer, size_t capacity, int deviceId);
+    void PrepareBound();
+    void DetachBoundInputs();
+
+    void EvaluateLocked(std::map<std::wstring, std::vector<ElemType>*>& inputs, std::map<std::wstring, std::vector<ElemType>*>& outputs,
+                        const std::vector<size_t>* sequenceLengths, const std::vector<size_t>* numPastFrames = nullptr);
+    void EvaluateInto(std::map<std::wstring, std::vector<ElemType>*>& inputs, IDataWriter& writer, const std::vector<std::wstring>& outputNodeNames,
+                      const std::vector<size_t>* sequenceLengths, const std::vector<size_t>* numPastFrames);
+
+    // the last layer of an output, Softmax(W x + b) or the like, for EvaluateShortlist()
+    struct OutputLayer
+    {
+        std::wstring m_hiddenNodeName; // x
+        Matrix<ElemType> m_weights;    // [hidden dim x output dim]: a transposed copy for Times, W itself for TransposeTimes
+        Matrix<ElemType> m_bias;       // [1 x output dim], empty without bias
+        OutputLayer(DEVICEID_TYPE deviceId) : m_weights(deviceId), m_bias(deviceId) { }
+    };
+    std::map<std::wstring, std::unique_ptr<OutputLayer>> m_outputLayers; // [output node name], determined on first use
+    const OutputLayer& GetOutputLayer(const std::wstring& outputNodeName);
+
 public:
     // constructor
     CNTKEval()
-        : m_reader(nullptr), m_net(nullptr)
+        : m_reader(nullptr), m_writer(nullptr), m_shortlistWriter(nullptr), m_minibatchSize(10240), m_net(nullptr), m_boundPrepared(false), m_lastStreamId(0), m_streamingNodesDetermined(false), m_streamRightContext(SIZE_MAX)
     {
     }
 
@@ -57,5 +128,38 @@ public:
     virtual void Init(const std::string& config);
     virtual void Destroy();
     virtual void ResetState();
+
+    // EvaluateConcurrent - Evaluate one independent sequence; thread-safe, and batched with concurrent calls
+    // inputs - map from node name to input vector
+    // outputs - map from node name to output vector, resized to the number of frames of the inputs
+    virtual void EvaluateConcurrent(std::map<std::wstring, std::vector<ElemType>*>& inputs, std::map<std::wstring, std::vector<ElemType>*>& outputs);
+
+    // BindInput, BindOutput - Bind a caller-owned buffer to a node for EvaluateBound()
+    // deviceId - -1 for host memory, otherwise the GPU of the model
+    virtual void BindInput(const std::wstring& nodeName, ElemType* buffer, size_t capacity, int deviceId);
+    virtual void BindOutput(const std::wstring& nodeName, ElemType* buffer, size_t capacity, int deviceId);
+
+    // EvaluateBound - Evaluate the bound outputs from 'numSamples' samples in the bound input buffers, as one new sequence
+    virtual void EvaluateBound(size_t numSamples);
+
+    // CreateStream, DestroyStream - Create and release a handle for the recurrent state of one stream, see EvaluateStream()
+    virtual size_t CreateStream();
+    virtual void DestroyStream(size_t stream);
+
+    // EvaluateStream - Evaluate the next chunk of frames of a stream, continuing from its recurrent state; thread-safe,
+    // and batched with concurrent calls for other streams
+    virtual void EvaluateStream(size_t stream, std::map<std::wstring, std::vector<ElemType>*>& inputs, std::map<std::wstring, std::vector<ElemType>*>& outputs);
+
+    // EndStream - Evaluate the frames a latency-controlled stream holds back as right context, and start the stream over
+    virtual void EndStream(size_t stream, std::map<std::wstring, std::vector<ElemType>*>& outputs);
+
+    // Warmup - Evaluate zeros in the largest expected shape once, so that the first requests do not allocate
+    virtual void Warmup(size_t maxNumSequences, size_t maxSequenceLength);
+
+    // EvaluateShortlist - Evaluate the logits of the given rows of an output, from the weights of only these rows
+    virtual void EvaluateShortlist(std::map<std::wstring, std::vector<ElemType>*>& inputs, const std::wstring& outputNodeName, const std::vector<size_t>& shortlist, std::vector<ElemType>& scores);
+
+    // EvaluateTopK - Evaluate an output, and copy back only its k largest values of each frame and their rows
+    virtual void EvaluateTopK(std::map<std::wstring, std::vector<ElemType>*>& inputs, const std::wstring& outputNodeName, size_t k, std::vector<size_t>& indices, std::vector<ElemType>& scores);
 };
 } } }
@@ -0,0 +1,218 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// EvalBatcher.h -- merges concurrent evaluation requests into a single minibatch
+//
+#pragma once
+
+#include "Basics.h"
+#include <map>
+#include <vector>
+#include <string>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <functional>
+#include <exception>
+#include <algorithm>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// -----------------------------------------------------------------------
+// EvalBatcher -- dynamic batching for CNTKEval::EvaluateConcurrent()
+// Each caller thread submits one request (a sequence of frames per input) and blocks until its outputs are
+// ready. The first caller that finds no batch in progress becomes the leader: it waits until 'maxRequests'
+// requests are pending or 'maxLatency' has passed, takes the pending requests, and evaluates them as one
+// minibatch in which each request is a parallel sequence. Shorter sequences are padded with gaps.
+// The merged data is interleaved like a minibatch matrix with one sequence per request: column (t * S + s)
+// holds frame t of request s, with S the number of requests.
+// Per request, only the pointers to its inputs and outputs, a caller-defined tag (e.g. a stream, see
+// CNTKEval::EvaluateStream()) and a completion flag are kept.
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+class EvalBatcher
+{
+public:
+    typedef std::map<std::wstring, std::vector<ElemType>*> Layer;
+    // evaluates a merged batch; the lengths are the number of frames of each request, the tags those passed to Evaluate()
+    typedef std::function<void(Layer& inputs, Layer& outputs, const std::vector<size_t>& sequenceLengths, const std::vector<size_t>& tags)> BatchEvaluator;
+
+    EvalBatcher(const BatchEvaluator& evaluate, const std::map<std::wstring, size_t>& inputDims, const std::map<std::wstring, size_t>& outputDims,
+                size_t maxLatencyMs, size_t maxRequests)
+        : m_evaluate(evaluate), m_inputDims(inputDims), m_outputDims(outputDims),
+          m_maxLatency(std::chrono::milliseconds(maxLatencyMs)), m_maxRequests(std::max(maxRequests, (size_t) 1)), m_hasLeader(false)
+    {
+    }
+
+    // Evaluates one request. May be called from any number of threads at the same time.
+    // The output vectors are resized to the number of frames of the request.
+    void Evaluate(Layer& inputs, Layer& outputs, size_t tag = 0)
+    {
+        Request request(inputs, outputs, DetermineNumFrames(inputs), tag);
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_pending.push_back(&request);
+        m_cv.notify_all(); // a waiting leader may now have enough requests
+        while (!request.m_done)
+        {
+            if (m_hasLeader)
+            {
+                m_cv.wait(lock);
+                continue;
+            }
+
+            // lead the next batch
+            m_hasLeader = true;
+            const auto deadline = std::chrono::steady_clock::now() + m_maxLatency;
+            m_cv.wait_until(lock, deadline, [this]() { return m_pending.size() >= m_maxRequests; });
+            const size_t numRequests = std::min(m_pending.size(), m_maxRequests);
+            std::vector<Request*> batch(m_pending.begin(), m_pending.begin() + numRequests);
+            m_pending.erase(m_pending.begin(), m_pending.begin() + numRequests);
+
+            lock.unlock();
+            std::exception_ptr error;
+            try
+            {
+                EvaluateBatch(batch);
+            }
+            catch (...)
+            {
+                error = std::current_exception();
+            }
+            lock.lock();
+
+            for (auto r : batch)
+            {
+                r->m_error = error;
+                r->m_done = true;
+            }
+            m_hasLeader = false;
+            m_cv.notify_all(); // wake up the requests of this batch, and the next leader
+        }
+        if (request.m_error)
+            std::rethrow_exception(request.m_error);
+    }
+
+private:
+    struct Request
+    {
+        Request(Layer& inputs, Layer& outputs, size_t numFrames, size_t tag)
+            : m_inputs(inputs), m_outputs(outputs), m_numFrames(numFrames), m_tag(tag), m_done(false)
+        {
+        }
+        Layer& m_inputs;
+        Layer& m_outputs;
+        size_t m_numFrames;
+        size_t m_tag;
+        bool m_done;
+        std::exception_ptr m_error;
+    };
+
+    size_t GetDim(const std::map<std::wstring, size_t>& dims, const std::wstring& name, const char* what) const
+    {
+        auto iter = dims.find(name);
+        if (iter == dims.end() || iter->second == 0)
+            InvalidArgument("EvalBatcher: %s %ls not found in the model.", what, name.c_str());
+        return iter->second;
+    }
+
+    size_t DetermineNumFrames(const Layer& inputs) const
+    {
+        if (inputs.size() != m_inputDims.size())
+            InvalidArgument("EvalBatcher: %d inputs were given, but the model has %d.", (int) inputs.size(), (int) m_inputDims.size());
+        size_t numFrames = SIZE_MAX;
+        for (auto& input : inputs)
+        {
+            size_t dim = GetDim(m_inputDims, input.first, "Input");
+            size_t n = input.second->size() / dim;
+            if (n * dim != input.second->size() || (numFrames != SIZE_MAX && n != numFrames))
+                InvalidArgument("EvalBatcher: Input %ls has %d values, which is not a multiple of its dimension %d or does not match the number of frames of the other inputs.",
+                                input.first.c_str(), (int) input.second->size(), (int) dim);
+            numFrames = n;
+        }
+        if (numFrames == 0 || numFrames == SIZE_MAX)
+            InvalidArgument("EvalBatcher: A request must have at least one frame.");
+        return numFrames;
+    }
+
+    void EvaluateBatch(const std::vector<Request*>& batch)
+    {
+        const size_t numSequences = batch.size();
+        std::vector<size_t> sequenceLengths, tags;
+        for (auto r : batch)
+        {
+            sequenceLengths.push_back(r->m_numFrames);
+            tags.push_back(r->m_tag);
+        }
+        const size_t numTimeSteps = *std::max_element(sequenceLengths.begin(), sequenceLengths.end());
+
+        // interleave the inputs; gaps are zero
+        std::map<std::wstring, std::vector<ElemType>> inputData;
+        Layer inputs;
+        for (auto& input : batch[0]->m_inputs)
+        {
+            const std::wstring& name = input.first;
+            const size_t dim = GetDim(m_inputDims, name, "Input");
+            auto& data = inputData[name];
+            data.assign(dim * numSequences * numTimeSteps, 0);
+            for (size_t s = 0; s < numSequences; s++)
+            {
+                auto iter = batch[s]->m_inputs.find(name);
+                if (iter == batch[s]->m_inputs.end())
+                    InvalidArgument("EvalBatcher: Input %ls is missing in one of the requests.", name.c_str());
+                const ElemType* from = iter->second->data();
+                for (size_t t = 0; t < sequenceLengths[s]; t++)
+                    std::copy(from + t * dim, from + (t + 1) * dim, data.begin() + (t * numSequences + s) * dim);
+            }
+            inputs[name] = &data;
+        }
+
+        std::map<std::wstring, std::vector<ElemType>> outputData;
+        Layer outputs;
+        for (auto r : batch) // the union of the outputs requested
+        {
+            for (auto& output : r->m_outputs)
+            {
+                if (outputs.find(output.first) != outputs.end())
+                    continue;
+                auto& data = outputData[output.first];
+                data.resize(GetDim(m_outputDims, output.first, "Output") * numSequences * numTimeSteps);
+                outputs[output.first] = &data;
+            }
+        }
+
+        m_evaluate(inputs, outputs, sequenceLengths, tags);
+
+        // de-interleave the outputs
+        for (auto& output : outputData)
+        {
+            const std::wstring& name = output.first;
+            const size_t dim = GetDim(m_outputDims, name, "Output");
+            for (size_t s = 0; s < numSequences; s++)
+            {
+                auto iter = batch[s]->m_outputs.find(name);
+                if (iter == batch[s]->m_outputs.end())
+                    continue;
+                auto& to = *iter->second;
+                to.resize(dim * sequenceLengths[s]);
+                for (size_t t = 0; t < sequenceLengths[s]; t++)
+                    std::copy(output.second.begin() + (t * numSequences + s) * dim, output.second.begin() + (t * numSequences + s + 1) * dim, to.begin() + t * dim);
+            }
+        }
+    }
+
+    BatchEvaluator m_evaluate;
+    std::map<std::wstring, size_t> m_inputDims;
+    std::map<std::wstring, size_t> m_outputDims;
+    std::chrono::steady_clock::duration m_maxLatency;
+    size_t m_maxRequests;
+
+    std::mutex m_mutex; // protects everything below
+    std::condition_variable m_cv;
+    std::deque<Request*> m_pending;
+    bool m_hasLeader;
+};
+} } }
@@ -21,6 +21,8 @@ class EvalReader : public IDataReader
     size_t m_mbSize;
     vector<size_t> m_switchFrame;
     size_t m_oldSig;
+    const vector<size_t>* m_sequenceLengths; // if not null, the data holds one parallel sequence per entry, interleaved and padded to the longest
+    const vector<size_t>* m_numPastFrames;   // if not null, the number of frames each parallel sequence has had in earlier minibatches
 
 public:
     // Method to setup the data for the reader
@@ -51,6 +53,17 @@ public:
         }
     }
 
+    // Switches to parallel sequences (as merged by EvalBatcher); nullptr switches back to a single stream
+    // that continues across calls. With parallel sequences, each minibatch must contain the entire data.
+    // numPastFrames - for streams (see CNTKEval::EvaluateStream()), the frames of each sequence before this minibatch; null if all start here
+    void SetSequenceLengths(const vector<size_t>* sequenceLengths, const vector<size_t>* numPastFrames = nullptr)
+    {
+        m_sequenceLengths = sequenceLengths;
+        m_numPastFrames = numPastFrames;
+        if (m_sequenceLengths && m_recordCount % m_sequenceLengths->size() != 0)
+            LogicError("EvalReader: The record count %d is not a multiple of the number of parallel sequences %d.", (int) m_recordCount, (int) m_sequenceLengths->size());
+    }
+
     void SetBoundary(size_t newSig)
     {
         if (m_switchFrame.size() == 0)
@@ -92,6 +105,8 @@ public:
     EvalReader(const ConfigRecordType& config)
     {
         m_recordCount = m_currentRecord = 0;
+        m_sequenceLengths = nullptr;
+        m_numPastFrames = nullptr;
         Init(config);
     }
 
@@ -152,7 +167,7 @@ public:
 
     size_t GetNumParallelSequences()
     {
-        return 1;
+        return m_sequenceLengths ? m_sequenceLengths->size() : 1;
     }
 
     void SetNumParallelSequences(const size_t)
@@ -168,6 +183,25 @@ public:
     }
     void CopyMBLayoutTo(MBLayoutPtr pMBLayout)
     {
+        if (m_sequenceLengths)
+        {
+            // each sequence ends within this minibatch, and starts in it unless it continues a stream; the remainder is a gap
+            const size_t numParallelSequences = m_sequenceLengths->size();
+            const size_t numTimeSteps = m_mbSize / numParallelSequences;
+            if (m_mbSize != m_recordCount)
+                LogicError("EvalReader: Parallel sequences must be read in a single minibatch.");
+            pMBLayout->Init(numParallelSequences, numTimeSteps);
+            for (size_t s = 0; s < numParallelSequences; s++)
+            {
+                const size_t length = (*m_sequenceLengths)[s];
+                const ptrdiff_t begin = m_numPastFrames ? -(ptrdiff_t) (*m_numPastFrames)[s] : 0;
+                pMBLayout->AddSequence(NEW_SEQUENCE_ID, s, begin, length);
+                if (length < numTimeSteps)
+                    pMBLayout->AddGap(s, length, numTimeSteps);
+            }
+            return;
+        }
+
         assert(m_switchFrame.size() == 1);
         pMBLayout->Init(1, m_mbSize);
 
@@ -0,0 +1,129 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#define DATAWRITER_LOCAL
+#include "DataWriter.h"
+#include "Matrix.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Writer for EvaluateShortlist() and EvaluateTopK()
+// Rather than copying the value of a node to the host like EvalWriter, it reduces the value to the requested scores on the
+// device of the model, and appends only those to the caller's vectors.
+//  - shortlist: the node is the input of the output layer. Its scores are W^T x + b for the shortlisted columns of W (and b),
+//    which are gathered once per request, so each minibatch takes a product with [hidden dim x shortlist size] weights.
+//  - top-k: the node is the output. The k largest values of each frame and their rows are selected with a partial sort.
+template <class ElemType>
+class EvalShortlistWriter : public IDataWriter
+{
+    std::wstring m_nodeName;
+    std::vector<ElemType>* m_scores;
+    std::vector<size_t>* m_indices; // top-k only
+    size_t m_topK;                  // 0 for the shortlist
+
+    Matrix<ElemType> m_shortlist;     // [1 x shortlist size] indices of the columns to gather
+    Matrix<ElemType> m_weightColumns; // [hidden dim x shortlist size]
+    Matrix<ElemType> m_biasColumns;   // [shortlist size x 1], empty without bias
+    Matrix<ElemType> m_result;        // scores or top-k values of a minibatch
+    Matrix<ElemType> m_resultIndices; // top-k rows of a minibatch
+    std::vector<ElemType> m_hostIndices;
+
+public:
+    EvalShortlistWriter(DEVICEID_TYPE deviceId)
+        : m_scores(nullptr), m_indices(nullptr), m_topK(0),
+          m_shortlist(deviceId), m_weightColumns(deviceId), m_biasColumns(deviceId), m_result(deviceId), m_resultIndices(deviceId)
+    {
+    }
+
+    // weights - [hidden dim x output dim], one column per output row; bias - [1 x output dim], or empty
+    void SetShortlist(const std::wstring& hiddenNodeName, const Matrix<ElemType>& weights, const Matrix<ElemType>& bias,
+                      const std::vector<size_t>& shortlist, std::vector<ElemType>* scores)
+    {
+        m_nodeName = hiddenNodeName;
+        m_scores = scores;
+        m_indices = nullptr;
+        m_topK = 0;
+        m_scores->clear();
+
+        m_hostIndices.assign(shortlist.begin(), shortlist.end());
+        m_shortlist.SetValue(1, m_hostIndices.size(), m_shortlist.GetDeviceId(), m_hostIndices.data());
+        m_weightColumns.DoGatherColumnsOf(0, m_shortlist, weights, 1);
+        if (bias.IsEmpty())
+            m_biasColumns.Resize(0, 0);
+        else
+        {
+            m_biasColumns.DoGatherColumnsOf(0, m_shortlist, bias, 1);
+            m_biasColumns.Reshape(shortlist.size(), 1);
+        }
+    }
+
+    void SetTopK(const std::wstring& outputNodeName, size_t k, std::vector<size_t>* indices, std::vector<ElemType>* scores)
+    {
+        m_nodeName = outputNodeName;
+        m_scores = scores;
+        m_indices = indices;
+        m_topK = k;
+        m_scores->clear();
+        m_indices->clear();
+    }
+
+    virtual void Init(const ConfigParameters& /*config*/) override
+    {
+    }
+    virtual void Init(const ScriptableObjects::IConfigRecord& /*config*/) override
+    {
+    }
+
+    // Destroy - cleanup and remove this class
+    // NOTE: this destroys the object, and it can't be used past this point
+    virtual void Destroy()
+    {
+        delete this;
+    }
+
+    virtual void GetSections(std::map<std::wstring, SectionType, nocase_compare>& /*sections*/)
+    {
+        assert(false);
+        NOT_IMPLEMENTED;
+    }
+
+    virtual bool SaveData(size_t /*recordStart*/, const std::map<std::wstring, void*, nocase_compare>& matrices, size_t numRecords, size_t /*datasetSize*/, size_t /*byteVariableSized*/)
+    {
+        const auto iter = matrices.find(m_nodeName);
+        if (iter == matrices.end())
+            RuntimeError("No matrix data found for key '%ls', cannot continue", m_nodeName.c_str());
+        const Matrix<ElemType>& value = *(Matrix<ElemType>*) iter->second;
+        if (value.GetNumCols() != numRecords)
+            RuntimeError("The output matrix being saved has %d columns, but %d records were requested to be saved", (int) value.GetNumCols(), (int) numRecords);
+
+        if (m_topK == 0)
+        {
+            Matrix<ElemType>::Multiply(m_weightColumns, true, value, false, m_result);
+            if (!m_biasColumns.IsEmpty())
+                Matrix<ElemType>::ScaleAndAdd(1, m_biasColumns, m_result); // added to each column
+        }
+        else
+        {
+            value.VectorMax(m_resultIndices, m_result, /*isColWise=*/true, (int) m_topK);
+            m_hostIndices.resize(m_resultIndices.GetNumElements());
+            m_resultIndices.CopySection(m_resultIndices.GetNumRows(), m_resultIndices.GetNumCols(), m_hostIndices.data(), m_resultIndices.GetNumRows());
+            for (const ElemType index : m_hostIndices)
+                m_indices->push_back((size_t) index);
+        }
+
+        size_t index = m_scores->size();
+        m_scores->resize(index + m_result.GetNumElements());
+        m_result.CopySection(m_result.GetNumRows(), m_result.GetNumCols(), m_scores->data() + index, m_result.GetNumRows());
+        return true;
+    }
+
+    virtual void SaveMapping(std::wstring saveId, const std::map<typename EvalShortlistWriter<ElemType>::LabelIdType, typename EvalShortlistWriter<ElemType>::LabelType>& /*labelMapping*/){};
+    virtual bool SupportMultiUtterances() const
+    {
+        return false;
+    };
+};
+} } }
@@ -0,0 +1,433 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// EvalServer.cpp -- persistent HTTP server that hosts models for evaluation through CNTKEval
+//
+// Usage: cntkevalserver configFile=server.cntk [port=8080]
+//
+//    port = 8080
+//    maxConnections = 256
+//    models = [
+//        mnist = [
+//            modelPath = "$ModelDir$/mnist.dnn"
+//            deviceId = 0              # per-model device placement
+//            latencySloMs = 20         # shed requests that cannot make it in time
+//            batchingMaxRequests = 32  # and any other CNTKEval configuration
+//            warmupSequenceLength = 100 # warm up with full batches of sequences this long (default 1)
+//        ]
+//    ]
+//
+// Requests (one connection may send several):
+//    POST /models/<name>/evaluate    body: one line per input node, "<nodeName> <values...>", the frames of a sequence
+//                                    concatenated; returns one line per output node in the same format.
+//                                    503 if the model is overloaded, 400 for malformed inputs.
+//    POST /models/<name>/load        body: a model path, or empty to reload the current one; swapped in
+//                                    after loading and warmup, without interrupting running requests.
+//    GET  /models                    the loaded models with their versions and node dimensions
+//    GET  /metrics                   request counters and latency histograms in the Prometheus text format
+//
+
+#define _CRT_SECURE_NO_WARNINGS // "secure" CRT not available on all platforms  --add this at the top of all CPP files that give "function or variable may be unsafe" warnings
+
+#include "Basics.h"
+#include "Config.h"
+#include "ServedModel.h"
+#include <string>
+#include <map>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#pragma comment(lib, "ws2_32.lib")
+typedef SOCKET socket_t;
+#define MSG_NOSIGNAL 0
+#else
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <unistd.h>
+#include <signal.h>
+typedef int socket_t;
+#define INVALID_SOCKET (-1)
+#define closesocket close
+#endif
+
+using namespace std;
+using namespace Microsoft::MSR::CNTK;
+
+namespace {
+
+struct HttpRequest
+{
+    string m_method;
+    string m_path;
+    string m_body;
+    bool m_keepAlive;
+};
+
+const size_t maxHeaderBytes = 64 * 1024;
+
+class Server
+{
+public:
+    Server(const ConfigParameters& config)
+        : m_numConnections(0)
+    {
+        m_port = config(L"port", (size_t) 8080);
+        m_maxConnections = config(L"maxConnections", (size_t) 256);
+        m_maxRequestBytes = config(L"maxRequestBytes", (size_t) 64 * 1024 * 1024);
+
+        if (!config.ExistsCurrent(L"models"))
+            InvalidArgument("EvalServer: No models are configured.");
+        const ConfigParameters& modelsConfig = config(L"models");
+        for (const auto& name : modelsConfig.GetMemberIds())
+        {
+            const ConfigParameters& modelConfig = modelsConfig(name);
+            wstring modelPath = modelConfig(L"modelPath");
+            string evalConfig = modelsConfig(name);
+            auto model = make_shared<ServedModel>(name, evalConfig, modelConfig(L"latencySloMs", (size_t) 0), modelConfig(L"maxQueuedRequests", (size_t) 0));
+            model->Load(modelPath);
+            m_models[name] = model;
+        }
+    }
+
+    void Run()
+    {
+        socket_t listener = socket(AF_INET, SOCK_STREAM, 0);
+        if (listener == INVALID_SOCKET)
+            RuntimeError("EvalServer: Failed to create a socket.");
+        int yes = 1;
+        setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, (const char*) &yes, sizeof(yes));
+        sockaddr_in address;
+        memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_ANY);
+        address.sin_port = htons((unsigned short) m_port);
+        if (::bind(listener, (const sockaddr*) &address, sizeof(address)) != 0 || listen(listener, SOMAXCONN) != 0)
+            RuntimeError("EvalServer: Failed to listen on port %d.", (int) m_port);
+        fprintf(stderr, "EvalServer: Serving %d models on port %d.\n", (int) m_models.size(), (int) m_port);
+
+        for (;;)
+        {
+            socket_t connection = accept(listener, nullptr, nullptr);
+            if (connection == INVALID_SOCKET)
+                continue;
+            setsockopt(connection, IPPROTO_TCP, TCP_NODELAY, (const char*) &yes, sizeof(yes));
+            // one thread per connection; concurrent requests for a model are batched by its evaluator
+            if (++m_numConnections > m_maxConnections)
+            {
+                SendResponse(connection, 503, "Too many connections.\n", false);
+                closesocket(connection);
+                m_numConnections--;
+                continue;
+            }
+            thread([this, connection]()
+                   {
+                       Serve(connection);
+                       closesocket(connection);
+                       m_numConnections--;
+                   }).detach();
+        }
+    }
+
+private:
+    void Serve(socket_t connection)
+    {
+        string buffer;
+        HttpRequest request;
+        while (ReadRequest(connection, buffer, request))
+        {
+            int status = 200;
+            string body;
+            try
+            {
+                status = Handle(request, body);
+            }
+            catch (const invalid_argument& e)
+            {
+                status = 400;
+                body = string(e.what()) + "\n";
+            }
+            catch (const exception& e)
+            {
+                status = 500;
+                body = string(e.what()) + "\n";
+            }
+            if (!SendResponse(connection, status, body, request.m_keepAlive) || !request.m_keepAlive)
+                break;
+        }
+    }
+
+    int Handle(const HttpRequest& request, string& body)
+    {
+        if (request.m_method == "GET" && request.m_path == "/metrics")
+        {
+            vector<const ServedModel*> models;
+            for (const auto& model : m_models)
+                models.push_back(model.second.get());
+            ServedModel::WriteMetrics(body, models);
+            return 200;
+        }
+        if (request.m_method == "GET" && request.m_path == "/models")
+        {
+            for (const auto& model : m_models)
+                DescribeModel(*model.second, body);
+            return 200;
+        }
+
+        // /models/<name>/<action>
+        const string prefix = "/models/";
+        size_t slash = request.m_path.find('/', prefix.size());
+        if (request.m_method != "POST" || request.m_path.compare(0, prefix.size(), prefix) != 0 || slash == string::npos)
+        {
+            body = "Not found.\n";
+            return 404;
+        }
+        auto iter = m_models.find(msra::strfun::utf16(request.m_path.substr(prefix.size(), slash - prefix.size())));
+        string action = request.m_path.substr(slash + 1);
+        if (iter == m_models.end() || (action != "evaluate" && action != "load"))
+        {
+            body = "Not found.\n";
+            return 404;
+        }
+        ServedModel& model = *iter->second;
+
+        if (action == "load")
+        {
+            string path = Trim(request.m_body);
+            ServedModel::Dimensions inputDims, outputDims;
+            wstring modelPath;
+            size_t version;
+            model.GetDimensions(inputDims, outputDims, modelPath, version);
+            model.Load(path.empty() ? modelPath : msra::strfun::utf16(path));
+            DescribeModel(model, body);
+            return 200;
+        }
+
+        map<wstring, vector<float>> inputData;
+        ParseLayer(request.m_body, inputData);
+        ServedModel::Layer inputs;
+        for (auto& input : inputData)
+            inputs[input.first] = &input.second;
+        map<wstring, vector<float>> outputs;
+        if (model.Evaluate(inputs, outputs) == ServedModel::Status::overloaded)
+        {
+            body = "Overloaded.\n";
+            return 503;
+        }
+        WriteLayer(outputs, body);
+        return 200;
+    }
+
+    static void DescribeModel(const ServedModel& model, string& out)
+    {
+        ServedModel::Dimensions inputDims, outputDims;
+        wstring modelPath;
+        size_t version;
+        model.GetDimensions(inputDims, outputDims, modelPath, version);
+        out += msra::strfun::utf8(model.Name()) + " version=" + to_string(version) + " modelPath=" + msra::strfun::utf8(modelPath);
+        for (const auto& input : inputDims)
+            out += " input:" + msra::strfun::utf8(input.first) + "=" + to_string(input.second);
+        for (const auto& output : outputDims)
+            out += " output:" + msra::strfun::utf8(output.first) + "=" + to_string(output.second);
+        out += "\n";
+    }
+
+    // one line per node: the node name followed by its values
+    static void ParseLayer(const string& text, map<wstring, vector<float>>& layer)
+    {
+        size_t pos = 0;
+        while (pos < text.size())
+        {
+            size_t end = text.find('\n', pos);
+            if (end == string::npos)
+                end = text.size();
+            string line = Trim(text.substr(pos, end - pos));
+            pos = end + 1;
+            if (line.empty())
+                continue;
+            size_t space = line.find_first_of(" \t");
+            wstring name = msra::strfun::utf16(line.substr(0, space));
+            if (layer.find(name) != layer.end())
+                InvalidArgument("Input %ls is given more than once.", name.c_str());
+            auto& values = layer[name];
+            const char* p = space == string::npos ? line.c_str() + line.size() : line.c_str() + space;
+            for (;;)
+            {
+                char* next;
+                float value = strtof(p, &next);
+                if (next == p)
+                    break;
+                values.push_back(value);
+                p = next;
+            }
+            while (*p == ' ' || *p == '\t')
+                p++;
+            if (*p != 0)
+                InvalidArgument("Input %ls: '%s' is not a number.", name.c_str(), p);
+        }
+    }
+
+    static void WriteLayer(const map<wstring, vector<float>>& layer, string& out)
+    {
+        char number[32];
+        for (const auto& node : layer)
+        {
+            out += msra::strfun::utf8(node.first);
+            for (float value : node.second)
+            {
+                snprintf(number, sizeof(number), " %.9g", value);
+                out += number;
+            }
+            out += "\n";
+        }
+    }
+
+    static string Trim(const string& s)
+    {
+        size_t begin = s.find_first_not_of(" \t\r\n");
+        if (begin == string::npos)
+            return string();
+        return s.substr(begin, s.find_last_not_of(" \t\r\n") - begin + 1);
+    }
+
+    static bool HeaderEquals(const string& line, const char* name, string& value)
+    {
+        size_t colon = line.find(':');
+        if (colon == string::npos || colon != strlen(name) || _strnicmp(line.c_str(), name, colon) != 0)
+            return false;
+        value = Trim(line.substr(colon + 1));
+        return true;
+    }
+
+    // reads one request; 'buffer' keeps what has been received beyond it
+    bool ReadRequest(socket_t connection, string& buffer, HttpRequest& request)
+    {
+        size_t headerEnd;
+        while ((headerEnd = buffer.find("\r\n\r\n")) == string::npos)
+        {
+            if (buffer.size() > maxHeaderBytes || !Receive(connection, buffer))
+                return false;
+        }
+
+        string header = buffer.substr(0, headerEnd);
+        size_t lineEnd = header.find("\r\n");
+        string requestLine = header.substr(0, lineEnd);
+        size_t space1 = requestLine.find(' ');
+        size_t space2 = requestLine.find(' ', space1 + 1);
+        if (space1 == string::npos || space2 == string::npos)
+            return false;
+        request.m_method = requestLine.substr(0, space1);
+        request.m_path = requestLine.substr(space1 + 1, space2 - space1 - 1);
+        request.m_keepAlive = requestLine.compare(space2 + 1, string::npos, "HTTP/1.0") != 0;
+
+        size_t contentLength = 0;
+        while (lineEnd != string::npos)
+        {
+            size_t next = header.find("\r\n", lineEnd + 2);
+            string line = header.substr(lineEnd + 2, next == string::npos ? string::npos : next - lineEnd - 2);
+            lineEnd = next;
+            string value;
+            if (HeaderEquals(line, "Content-Length", value))
+                contentLength = strtoull(value.c_str(), nullptr, 10);
+            else if (HeaderEquals(line, "Connection", value))
+            {
+                if (_stricmp(value.c_str(), "close") == 0)
+                    request.m_keepAlive = false;
+                else if (_stricmp(value.c_str(), "keep-alive") == 0)
+                    request.m_keepAlive = true;
+            }
+            else if (HeaderEquals(line, "Transfer-Encoding", value))
+                return false; // chunked bodies are not supported
+        }
+        if (contentLength > m_maxRequestBytes)
+            return false;
+
+        size_t bodyBegin = headerEnd + 4;
+        while (buffer.size() < bodyBegin + contentLength)
+        {
+            if (!Receive(connection, buffer))
+                return false;
+        }
+        request.m_body = buffer.substr(bodyBegin, contentLength);
+        buffer.erase(0, bodyBegin + contentLength);
+        return true;
+    }
+
+    static bool Receive(socket_t connection, string& buffer)
+    {
+        char chunk[64 * 1024];
+        int received = (int) recv(connection, chunk, sizeof(chunk), 0);
+        if (received <= 0)
+            return false;
+        buffer.append(chunk, received);
+        return true;
+    }
+
+    static bool SendResponse(socket_t connection, int status, const string& body, bool keepAlive)
+    {
+        const char* reason = status == 200 ? "OK" : status == 400 ? "Bad Request" : status == 404 ? "Not Found" : status == 503 ? "Service Unavailable" : "Internal Server Error";
+        char header[256];
+        snprintf(header, sizeof(header), "HTTP/1.1 %d %s\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: %d\r\nConnection: %s\r\n\r\n",
+                 status, reason, (int) body.size(), keepAlive ? "keep-alive" : "close");
+        string response = header + body;
+        for (size_t sent = 0; sent < response.size();)
+        {
+            int n = (int) send(connection, response.data() + sent, (int) (response.size() - sent), MSG_NOSIGNAL);
+            if (n <= 0)
+                return false;
+            sent += n;
+        }
+        return true;
+    }
+
+    size_t m_port;
+    size_t m_maxConnections;
+    size_t m_maxRequestBytes;
+    atomic<size_t> m_numConnections;
+    map<wstring, shared_ptr<ServedModel>> m_models; // fixed after startup; versions are swapped inside each model
+};
+}
+
+int wmain(int argc, wchar_t* argv[])
+{
+    try
+    {
+#ifdef _WIN32
+        WSADATA wsaData;
+        if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0)
+            RuntimeError("EvalServer: Failed to initialize Winsock.");
+#else
+        signal(SIGPIPE, SIG_IGN); // a client that disconnects must not terminate the server
+#endif
+        ConfigParameters config;
+        ConfigParameters::ParseCommandLine(argc, argv, config);
+        Server server(config);
+        server.Run();
+    }
+    catch (const exception& e)
+    {
+        fprintf(stderr, "EvalServer: %s\n", e.what());
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+#ifdef __UNIX__
+int main(int argc, char* argv[])
+{
+    vector<wstring> args;
+    for (int i = 0; i < argc; ++i)
+        args.push_back(msra::strfun::utf16(argv[i]));
+    vector<wchar_t*> wargs;
+    for (auto& arg : args)
+        wargs.push_back(&arg[0]);
+    return wmain(argc, wargs.data());
+}
+#endif
@@ -0,0 +1,64 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// LatencyHistogram.h -- cumulative latency histogram in the Prometheus text exposition format
+//
+#pragma once
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <cstdio>
+#include <cstdint>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+class LatencyHistogram
+{
+public:
+    // bucket upper bounds in seconds, from 0.5 ms to 10 s
+    LatencyHistogram()
+        : m_bounds({0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10}),
+          m_counts(m_bounds.size() + 1, 0), m_sum(0), m_count(0)
+    {
+    }
+
+    void Observe(double seconds)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        size_t i = 0;
+        while (i < m_bounds.size() && seconds > m_bounds[i])
+            i++;
+        m_counts[i]++; // the last slot is the +Inf bucket
+        m_sum += seconds;
+        m_count++;
+    }
+
+    // appends the _bucket, _sum and _count series; 'labels' is e.g. model="mnist", without braces
+    void Write(std::string& out, const char* name, const std::string& labels) const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        char line[512];
+        uint64_t cumulative = 0;
+        for (size_t i = 0; i <= m_bounds.size(); i++)
+        {
+            cumulative += m_counts[i];
+            if (i < m_bounds.size())
+                snprintf(line, sizeof(line), "%s_bucket{%s,le=\"%g\"} %llu\n", name, labels.c_str(), m_bounds[i], (unsigned long long) cumulative);
+            else
+                snprintf(line, sizeof(line), "%s_bucket{%s,le=\"+Inf\"} %llu\n", name, labels.c_str(), (unsigned long long) cumulative);
+            out += line;
+        }
+        snprintf(line, sizeof(line), "%s_sum{%s} %.6f\n%s_count{%s} %llu\n", name, labels.c_str(), m_sum, name, labels.c_str(), (unsigned long long) m_count);
+        out += line;
+    }
+
+private:
+    const std::vector<double> m_bounds;
+    std::vector<uint64_t> m_counts;
+    double m_sum;
+    uint64_t m_count;
+    mutable std::mutex m_mutex;
+};
+} } }
@@ -0,0 +1,222 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// ServedModel.cpp -- one model hosted by the evaluation server
+//
+
+#define _CRT_SECURE_NO_WARNINGS // "secure" CRT not available on all platforms  --add this at the top of all CPP files that give "function or variable may be unsafe" warnings
+
+#include "Basics.h"
+#include "Config.h"
+#include "ServedModel.h"
+#include <chrono>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+ServedModel::ServedModel(const std::wstring& name, const std::string& evalConfig, size_t latencySloMs, size_t maxQueuedRequests)
+    : m_name(name), m_evalConfig(evalConfig), m_latencySloMs(latencySloMs), m_maxQueuedRequests(maxQueuedRequests),
+      m_inFlight(0), m_averageLatencyUs(0), m_numRequests(0), m_numShed(0), m_numErrors(0), m_numSloViolations(0)
+{
+    ConfigParameters config;
+    config.Parse(evalConfig);
+    m_batchingMaxRequests = config(L"batchingMaxRequests", (size_t) 64);
+    if (m_batchingMaxRequests == 0)
+        InvalidArgument("Model %ls: batchingMaxRequests must be positive.", name.c_str());
+    // the longest sequence expected in a request, for the warmup
+    m_warmupSequenceLength = config(L"warmupSequenceLength", (size_t) 1);
+
+    // without an explicit batching window, batches wait for at most a tenth of the SLO
+    if (latencySloMs > 0 && !config.ExistsCurrent(L"batchingMaxLatencyMs"))
+        m_evalConfig += "\nbatchingMaxLatencyMs=" + std::to_string(std::max<size_t>(latencySloMs / 10, 1));
+}
+
+// Load - load and warm up the model at 'modelPath', then make it the current version
+// The previous version stays alive until the requests that use it have finished, so both are in memory for a while.
+void ServedModel::Load(const std::wstring& modelPath)
+{
+    std::lock_guard<std::mutex> loadLock(m_loadMutex);
+
+    auto version = std::make_shared<Version>();
+    GetEvalF(&version->m_eval);
+    version->m_eval->Init(m_evalConfig + "\nmodelPath=" + msra::strfun::utf8(modelPath));
+    version->m_modelPath = modelPath;
+    version->m_eval->GetNodeDimensions(version->m_inputDims, nodeInput);
+    version->m_eval->GetNodeDimensions(version->m_outputDims, nodeOutput);
+
+    // one frame of zeros creates the batcher; a full batch of the longest sequences allocates the matrices at
+    // their largest size and selects the cuDNN algorithms, so that no request pays for it
+    std::map<std::wstring, std::vector<float>> inputData, outputData;
+    Layer inputs, outputs;
+    for (const auto& input : version->m_inputDims)
+    {
+        inputData[input.first].assign(input.second, 0.0f);
+        inputs[input.first] = &inputData[input.first];
+    }
+    for (const auto& output : version->m_outputDims)
+        outputs[output.first] = &outputData[output.first];
+    version->m_eval->EvaluateConcurrent(inputs, outputs);
+    if (m_warmupSequenceLength > 0)
+        version->m_eval->Warmup(m_batchingMaxRequests, m_warmupSequenceLength);
+
+    {
+        std::lock_guard<std::mutex> lock(m_versionMutex);
+        version->m_number = m_version ? m_version->m_number + 1 : 1;
+        m_version = version;
+    }
+    fprintf(stderr, "EvalServer: Model %ls version %d loaded from %ls.\n", m_name.c_str(), (int) version->m_number, modelPath.c_str());
+}
+
+std::shared_ptr<ServedModel::Version> ServedModel::CurrentVersion() const
+{
+    std::lock_guard<std::mutex> lock(m_versionMutex);
+    return m_version;
+}
+
+void ServedModel::GetDimensions(Dimensions& inputDims, Dimensions& outputDims, std::wstring& modelPath, size_t& version) const
+{
+    auto current = CurrentVersion();
+    if (!current)
+        LogicError("Model %ls has not been loaded.", m_name.c_str());
+    inputDims = current->m_inputDims;
+    outputDims = current->m_outputDims;
+    modelPath = current->m_modelPath;
+    version = current->m_number;
+}
+
+// a malformed request must be rejected here, since in a batch it would fail the requests it is batched with
+void ServedModel::CheckInputs(const Version& version, const Layer& inputs) const
+{
+    size_t numFrames = 0;
+    for (const auto& input : version.m_inputDims)
+    {
+        auto iter = inputs.find(input.first);
+        if (iter == inputs.end())
+            InvalidArgument("Model %ls: Input %ls is missing.", m_name.c_str(), input.first.c_str());
+        size_t size = iter->second->size();
+        if (size == 0 || size % input.second != 0)
+            InvalidArgument("Model %ls: Input %ls has %d values, which is not a positive multiple of its dimension %d.", m_name.c_str(), input.first.c_str(), (int) size, (int) input.second);
+        if (numFrames != 0 && size / input.second != numFrames)
+            InvalidArgument("Model %ls: All inputs must have the same number of frames.", m_name.c_str());
+        numFrames = size / input.second;
+    }
+    for (const auto& input : inputs)
+    {
+        if (version.m_inputDims.find(input.first) == version.m_inputDims.end())
+            InvalidArgument("Model %ls has no input %ls.", m_name.c_str(), input.first.c_str());
+    }
+}
+
+// a request that would only make it into a later batch is shed if the batches ahead of it are expected to exceed the SLO
+bool ServedModel::ShouldShed(size_t numAhead) const
+{
+    if (m_maxQueuedRequests > 0 && numAhead >= m_maxQueuedRequests)
+        return true;
+    if (m_latencySloMs == 0 || numAhead < m_batchingMaxRequests)
+        return false;
+    size_t numBatches = numAhead / m_batchingMaxRequests + 1;
+    return numBatches * m_averageLatencyUs.load() > m_latencySloMs * 1000;
+}
+
+// Evaluate - evaluate one sequence; 'outputs' receives all output nodes of the model
+ServedModel::Status ServedModel::Evaluate(const Layer& inputs, std::map<std::wstring, std::vector<float>>& outputs)
+{
+    auto version = CurrentVersion(); // kept until this request is done, even if a new version is loaded meanwhile
+    if (!version)
+        LogicError("Model %ls has not been loaded.", m_name.c_str());
+    try
+    {
+        CheckInputs(*version, inputs);
+    }
+    catch (...)
+    {
+        m_numErrors++;
+        throw;
+    }
+
+    if (ShouldShed(m_inFlight++))
+    {
+        m_inFlight--;
+        m_numShed++;
+        return Status::overloaded;
+    }
+
+    Layer evalInputs = inputs;
+    Layer evalOutputs;
+    for (const auto& output : version->m_outputDims)
+        evalOutputs[output.first] = &outputs[output.first];
+
+    auto start = std::chrono::steady_clock::now();
+    try
+    {
+        version->m_eval->EvaluateConcurrent(evalInputs, evalOutputs);
+    }
+    catch (...)
+    {
+        m_inFlight--;
+        m_numErrors++;
+        throw;
+    }
+    m_inFlight--;
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    m_numRequests++;
+    m_latency.Observe(seconds);
+    if (m_latencySloMs > 0 && seconds * 1000 > m_latencySloMs)
+        m_numSloViolations++;
+    // not atomic as a whole; a lost update only delays the estimate a little
+    uint64_t latencyUs = (uint64_t) (seconds * 1e6);
+    uint64_t average = m_averageLatencyUs.load();
+    m_averageLatencyUs.store(average == 0 ? latencyUs : (7 * average + latencyUs) / 8);
+    return Status::ok;
+}
+
+std::string ServedModel::Labels() const
+{
+    return "model=\"" + msra::strfun::utf8(m_name) + "\"";
+}
+
+// WriteMetrics - append the metrics of all models in the Prometheus text format
+// The lines of one metric must not be interleaved with other metrics, hence all models at once.
+/*static*/ void ServedModel::WriteMetrics(std::string& out, const std::vector<const ServedModel*>& models)
+{
+    char line[512];
+    out += "# HELP cntk_eval_requests_total Requests by outcome.\n# TYPE cntk_eval_requests_total counter\n";
+    for (auto model : models)
+    {
+        const auto labels = model->Labels();
+        snprintf(line, sizeof(line), "cntk_eval_requests_total{%s,status=\"ok\"} %llu\n", labels.c_str(), (unsigned long long) model->m_numRequests.load());
+        out += line;
+        snprintf(line, sizeof(line), "cntk_eval_requests_total{%s,status=\"overloaded\"} %llu\n", labels.c_str(), (unsigned long long) model->m_numShed.load());
+        out += line;
+        snprintf(line, sizeof(line), "cntk_eval_requests_total{%s,status=\"error\"} %llu\n", labels.c_str(), (unsigned long long) model->m_numErrors.load());
+        out += line;
+    }
+
+    out += "# HELP cntk_eval_slo_violations_total Requests that took longer than the latency SLO.\n# TYPE cntk_eval_slo_violations_total counter\n";
+    for (auto model : models)
+    {
+        snprintf(line, sizeof(line), "cntk_eval_slo_violations_total{%s} %llu\n", model->Labels().c_str(), (unsigned long long) model->m_numSloViolations.load());
+        out += line;
+    }
+
+    out += "# HELP cntk_eval_in_flight_requests Requests being evaluated or waiting for a batch.\n# TYPE cntk_eval_in_flight_requests gauge\n";
+    for (auto model : models)
+    {
+        snprintf(line, sizeof(line), "cntk_eval_in_flight_requests{%s} %d\n", model->Labels().c_str(), (int) model->m_inFlight.load());
+        out += line;
+    }
+
+    out += "# HELP cntk_eval_model_version Number of the loaded version of the model, 0 if none.\n# TYPE cntk_eval_model_version gauge\n";
+    for (auto model : models)
+    {
+        auto version = model->CurrentVersion();
+        snprintf(line, sizeof(line), "cntk_eval_model_version{%s} %d\n", model->Labels().c_str(), version ? (int) version->m_number : 0);
+        out += line;
+    }
+
+    out += "# HELP cntk_eval_request_duration_seconds Time from submitting a request until its outputs are ready, including the wait for a batch.\n# TYPE cntk_eval_request_duration_seconds histogram\n";
+    for (auto model : models)
+        model->m_latency.Write(out, "cntk_eval_request_duration_seconds", model->Labels());
+}
+} } }
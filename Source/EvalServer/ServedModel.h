@@ -0,0 +1,102 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// ServedModel.h -- one model hosted by the evaluation server
+//
+#pragma once
+
+#include "Eval.h"
+#include "LatencyHistogram.h"
+#include <string>
+#include <map>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// -----------------------------------------------------------------------
+// ServedModel -- a named model with its own device, batching and latency SLO
+// Requests go through CNTKEval::EvaluateConcurrent(), so concurrent requests for one model are batched.
+// Load() swaps in a new version only after it has been loaded and warmed up; requests that are already
+// running keep the version they started with, which is destroyed when the last of them has finished.
+// -----------------------------------------------------------------------
+
+class ServedModel
+{
+public:
+    typedef std::map<std::wstring, std::vector<float>*> Layer;
+    typedef std::map<std::wstring, size_t> Dimensions;
+
+    enum class Status
+    {
+        ok,
+        overloaded // not evaluated, the request would not finish within the latency SLO
+    };
+
+    // name - name of the model in requests and metrics
+    // evalConfig - configuration for CNTKEval::Init(), e.g. deviceId and batchingMaxRequests
+    // latencySloMs - target latency of a request, 0 for none; requests are shed when the queue is too long for it
+    // maxQueuedRequests - requests in flight at which new ones are rejected, 0 for no limit
+    ServedModel(const std::wstring& name, const std::string& evalConfig, size_t latencySloMs, size_t maxQueuedRequests);
+
+    // Load - load and warm up the model at 'modelPath', then make it the current version
+    void Load(const std::wstring& modelPath);
+
+    // Evaluate - evaluate one sequence; 'outputs' receives all output nodes of the model
+    Status Evaluate(const Layer& inputs, std::map<std::wstring, std::vector<float>>& outputs);
+
+    const std::wstring& Name() const { return m_name; }
+    void GetDimensions(Dimensions& inputDims, Dimensions& outputDims, std::wstring& modelPath, size_t& version) const;
+
+    // WriteMetrics - append the metrics of all models in the Prometheus text format
+    static void WriteMetrics(std::string& out, const std::vector<const ServedModel*>& models);
+
+private:
+    struct Version
+    {
+        IEvaluateModel<float>* m_eval;
+        std::wstring m_modelPath;
+        size_t m_number;
+        Dimensions m_inputDims;
+        Dimensions m_outputDims;
+
+        Version()
+            : m_eval(nullptr), m_number(0)
+        {
+        }
+        ~Version()
+        {
+            if (m_eval)
+                m_eval->Destroy();
+        }
+    };
+
+    std::shared_ptr<Version> CurrentVersion() const;
+    void CheckInputs(const Version& version, const Layer& inputs) const;
+    bool ShouldShed(size_t numAhead) const;
+    std::string Labels() const;
+
+    const std::wstring m_name;
+    std::string m_evalConfig;
+    const size_t m_latencySloMs;
+    const size_t m_maxQueuedRequests;
+    size_t m_batchingMaxRequests;
+    size_t m_warmupSequenceLength; // 0 for no warmup beyond a single frame
+
+    std::mutex m_loadMutex; // one Load() at a time
+    mutable std::mutex m_versionMutex;
+    std::shared_ptr<Version> m_version;
+
+    std::atomic<size_t> m_inFlight;
+    std::atomic<uint64_t> m_averageLatencyUs; // moving average of the evaluation time of a request
+    std::atomic<uint64_t> m_numRequests;
+    std::atomic<uint64_t> m_numShed;
+    std::atomic<uint64_t> m_numErrors;
+    std::atomic<uint64_t> m_numSloViolations;
+    LatencyHistogram m_latency;
+};
+} } }
@@ -23,6 +23,7 @@ using namespace std;
 using namespace System;
 using namespace System::Collections::Generic;
 using namespace System::Collections;
+using namespace System::Runtime::InteropServices;
 using namespace Microsoft::MSR::CNTK;
 
 namespace Microsoft { namespace MSR { namespace CNTK { namespace Extensibility { namespace Managed {
@@ -64,6 +65,9 @@ public:
         {
             throw gcnew CNTKException(gcnew System::String(ex.what()));
         }
+
+        m_pinnedInputs = gcnew Dictionary<String^, GCHandle>();
+        m_pinnedOutputs = gcnew Dictionary<String^, GCHandle>();
     }
 
     /// <summary>Initializes the model evaluation library with a CNTK configuration</summary>
@@ -196,6 +200,49 @@ public:
         return outputMap[outputKey];
     }
 
+    /// <summary>Binds a caller-owned array to an input node, for all following EvaluateBound() calls</summary>
+    /// <remarks>The array stays pinned until the node is rebound or the model is disposed. Its values are read in place,
+    /// without any copy or conversion; write the next request into it, then call EvaluateBound().</remarks>
+    /// <param name="nodeName">The name of the input node</param>
+    /// <param name="buffer">Column-major samples of the node's dimension</param>
+    void BindInput(String^ nodeName, array<ElemType>^ buffer)
+    {
+        Bind(nodeName, buffer, m_pinnedInputs, true);
+    }
+
+    /// <summary>Binds a caller-owned array to an output node, for all following EvaluateBound() calls</summary>
+    /// <remarks>The array stays pinned until the node is rebound or the model is disposed. EvaluateBound() writes the
+    /// output values straight into it.</remarks>
+    /// <param name="nodeName">The name of the output node</param>
+    /// <param name="buffer">Receives the column-major samples of the node's dimension</param>
+    void BindOutput(String^ nodeName, array<ElemType>^ buffer)
+    {
+        Bind(nodeName, buffer, m_pinnedOutputs, false);
+    }
+
+    /// <summary>Evaluates the bound outputs from the bound input arrays, without marshaling</summary>
+    /// <param name="numSamples">The number of samples in the input arrays, evaluated as one sequence</param>
+    void EvaluateBound(int numSamples)
+    {
+        if (m_eval == nullptr)
+        {
+            throw gcnew ObjectDisposedException("Object has been disposed.");
+        }
+        if (numSamples <= 0)
+        {
+            throw gcnew ArgumentOutOfRangeException("numSamples");
+        }
+
+        try
+        {
+            m_eval->EvaluateBound(numSamples);
+        }
+        catch (const exception& ex)
+        {
+            throw GetCustomException(ex);
+        }
+    }
+
     ~IEvaluateModelManaged()
     {
         if (m_eval == nullptr)
@@ -214,12 +261,70 @@ protected:
             m_eval->Destroy();
             m_eval = nullptr;
         }
+
+        // only now that the native model is gone may the bound arrays move
+        FreePinned(m_pinnedInputs);
+        FreePinned(m_pinnedOutputs);
     }
 
 private:
     // Native model evaluation instance
     IEvaluateModel<ElemType> *m_eval;
 
+    // Pinned arrays of BindInput() and BindOutput(), by node name
+    Dictionary<String^, GCHandle>^ m_pinnedInputs;
+    Dictionary<String^, GCHandle>^ m_pinnedOutputs;
+
+    /// <summary>Pins an array and binds it to a node of the native model, releasing the array it replaces</summary>
+    void Bind(String^ nodeName, array<ElemType>^ buffer, Dictionary<String^, GCHandle>^ pinned, bool isInput)
+    {
+        if (m_eval == nullptr)
+        {
+            throw gcnew ObjectDisposedException("Object has been disposed.");
+        }
+        if (nodeName == nullptr || buffer == nullptr)
+        {
+            throw gcnew ArgumentNullException(nodeName == nullptr ? "nodeName" : "buffer");
+        }
+
+        GCHandle handle = GCHandle::Alloc(buffer, GCHandleType::Pinned);
+        try
+        {
+            pin_ptr<const WCHAR> key = PtrToStringChars(nodeName);
+            ElemType* data = (ElemType*) handle.AddrOfPinnedObject().ToPointer();
+            if (isInput)
+                m_eval->BindInput(key, data, buffer->Length, -1 /*host memory*/);
+            else
+                m_eval->BindOutput(key, data, buffer->Length, -1 /*host memory*/);
+        }
+        catch (const exception& ex)
+        {
+            handle.Free();
+            throw GetCustomException(ex);
+        }
+
+        GCHandle previous;
+        if (pinned->TryGetValue(nodeName, previous))
+        {
+            previous.Free();
+        }
+        pinned[nodeName] = handle;
+    }
+
+    /// <summary>Unpins all arrays in 'pinned'</summary>
+    static void FreePinned(Dictionary<String^, GCHandle>^ pinned)
+    {
+        if (pinned == nullptr)
+        {
+            return;
+        }
+        for each (auto item in pinned)
+        {
+            item.Value.Free();
+        }
+        pinned->Clear();
+    }
+
     /// <summary>Copies a list of element types from a CLI structure to a native structure</summary>
     /// <param name="list">The CLI list of items</param>
     /// <returns>A native vector of items</returns>
@@ -355,12 +460,18 @@ void emit()
     f.Evaluate(nullptr, nullptr);
     f.Evaluate(nullptr, "", 0);
     f.LoadModel("");
+    f.BindInput("", nullptr);
+    f.BindOutput("", nullptr);
+    f.EvaluateBound(0);
 
     IEvaluateModelManagedD d;
     d.Init("");
     d.Evaluate(nullptr, nullptr);
     d.Evaluate(nullptr, "", 0);
     d.LoadModel("");
+    d.BindInput("", nullptr);
+    d.BindOutput("", nullptr);
+    d.EvaluateBound(0);
 }
 
 }}}}}
@@ -0,0 +1,145 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+#include "BlockSparseMatrix.h"
+#include "CPUVectorKernels.h"
+#include <algorithm>
+#include <memory>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// c += alpha * a, with the SIMD kernel for float
+static void AddScaled(const CPUVectorKernels& kernels, const float* a, float alpha, float* c, size_t n)
+{
+    kernels.AddScaled(a, alpha, c, n);
+}
+static void AddScaled(const CPUVectorKernels&, const double* a, double alpha, double* c, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+        c[i] += a[i] * alpha;
+}
+
+template <class ElemType>
+BlockSparseMatrix<ElemType>::BlockSparseMatrix(const Matrix<ElemType>& weights, size_t blockRows, size_t blockCols)
+    : m_numRows(weights.GetNumRows()), m_numCols(weights.GetNumCols()), m_blockRows(blockRows), m_blockCols(blockCols)
+{
+    if (weights.GetMatrixType() != MatrixType::DENSE)
+        InvalidArgument("BlockSparseMatrix: Only dense matrices can be converted.");
+    if (blockRows == 0 || blockCols == 0)
+        InvalidArgument("BlockSparseMatrix: The block dimensions must not be 0.");
+
+    std::unique_ptr<ElemType[]> columnMajor(weights.CopyToArray());
+    const size_t numBlockRows = (m_numRows + blockRows - 1) / blockRows;
+    const size_t numBlockCols = (m_numCols + blockCols - 1) / blockCols;
+    const size_t blockSize = blockRows * blockCols;
+    std::vector<ElemType> block(blockSize);
+
+    m_blockRowStarts.reserve(numBlockRows + 1);
+    m_blockRowStarts.push_back(0);
+    for (size_t br = 0; br < numBlockRows; br++)
+    {
+        const size_t rowBegin = br * blockRows;
+        const size_t rowEnd = std::min(m_numRows, rowBegin + blockRows);
+        for (size_t bc = 0; bc < numBlockCols; bc++)
+        {
+            const size_t colBegin = bc * blockCols;
+            const size_t colEnd = std::min(m_numCols, colBegin + blockCols);
+            bool isZero = true;
+            std::fill(block.begin(), block.end(), (ElemType) 0);
+            for (size_t i = rowBegin; i < rowEnd; i++)
+            {
+                for (size_t k = colBegin; k < colEnd; k++)
+                {
+                    ElemType value = columnMajor[k * m_numRows + i];
+                    block[(i - rowBegin) * blockCols + (k - colBegin)] = value;
+                    isZero &= value == 0;
+                }
+            }
+            if (isZero)
+                continue;
+            m_blockColIndices.push_back(bc);
+            m_values.insert(m_values.end(), block.begin(), block.end());
+        }
+        m_blockRowStarts.push_back(m_blockColIndices.size());
+    }
+}
+
+template <class ElemType>
+double BlockSparseMatrix<ElemType>::GetSparsity() const
+{
+    const size_t numBlocks = ((m_numRows + m_blockRows - 1) / m_blockRows) * ((m_numCols + m_blockCols - 1) / m_blockCols);
+    return numBlocks ? 1.0 - (double) GetNumBlocks() / numBlocks : 0.0;
+}
+
+template <class ElemType>
+void BlockSparseMatrix<ElemType>::Multiply(const Matrix<ElemType>& in, Matrix<ElemType>& out) const
+{
+    if (out.GetDeviceId() != CPUDEVICE || out.GetMatrixType() != MatrixType::DENSE)
+        LogicError("BlockSparseMatrix::Multiply: The output must be a dense CPU matrix.");
+    if (in.GetNumRows() != m_numCols || out.GetNumRows() != m_numRows || out.GetNumCols() != in.GetNumCols())
+        InvalidArgument("BlockSparseMatrix::Multiply: Dimensions [%d x %d] * [%d x %d] -> [%d x %d] do not match.",
+                        (int) m_numRows, (int) m_numCols, (int) in.GetNumRows(), (int) in.GetNumCols(), (int) out.GetNumRows(), (int) out.GetNumCols());
+
+    const size_t numSamples = in.GetNumCols();
+    Matrix<ElemType> inCopy(CPUDEVICE);
+    const Matrix<ElemType>* pIn = &in;
+    if (in.GetDeviceId() != CPUDEVICE || in.GetMatrixType() != MatrixType::DENSE)
+    {
+        inCopy = Matrix<ElemType>(in, CPUDEVICE);
+        inCopy.SwitchToMatrixType(MatrixType::DENSE, MatrixFormat::matrixFormatDense, true);
+        pIn = &inCopy;
+    }
+    const ElemType* inData = pIn->BufferPointer();
+    ElemType* outData = out.BufferPointer();
+
+    // The input is transposed, so that the samples of an input row are contiguous: each weight of a block is then
+    // multiplied with a vector of samples, which vectorizes. The products of a block row are accumulated for a tile of
+    // samples, which stays in cache while the blocks are swept.
+    std::vector<ElemType> inTransposed(m_numCols * numSamples);
+#pragma omp parallel for
+    for (long k = 0; k < (long) m_numCols; k++)
+        for (size_t j = 0; j < numSamples; j++)
+            inTransposed[k * numSamples + j] = inData[j * m_numCols + k];
+
+    const auto& kernels = CPUVectorKernels::Get();
+    const size_t tileSize = std::min(numSamples, (size_t) 256);
+    const size_t blockSize = m_blockRows * m_blockCols;
+    const long numBlockRows = (long) m_blockRowStarts.size() - 1;
+#pragma omp parallel
+    {
+        std::vector<ElemType> sums(m_blockRows * tileSize);
+#pragma omp for schedule(dynamic, 1)
+        for (long br = 0; br < numBlockRows; br++)
+        {
+            const size_t rowBegin = br * m_blockRows;
+            const size_t numRows = std::min(m_numRows - rowBegin, m_blockRows);
+            for (size_t tileBegin = 0; tileBegin < numSamples; tileBegin += tileSize)
+            {
+                const size_t numTileSamples = std::min(numSamples - tileBegin, tileSize);
+                std::fill(sums.begin(), sums.end(), (ElemType) 0);
+                for (size_t n = m_blockRowStarts[br]; n < m_blockRowStarts[br + 1]; n++)
+                {
+                    const size_t colBegin = m_blockColIndices[n] * m_blockCols;
+                    const size_t numCols = std::min(m_numCols - colBegin, m_blockCols);
+                    const ElemType* block = m_values.data() + n * blockSize;
+                    for (size_t r = 0; r < numRows; r++)
+                    {
+                        ElemType* rowSums = sums.data() + r * tileSize;
+                        for (size_t c = 0; c < numCols; c++)
+                            AddScaled(kernels, inTransposed.data() + (colBegin + c) * numSamples + tileBegin, block[r * m_blockCols + c], rowSums, numTileSamples);
+                    }
+                }
+                for (size_t j = 0; j < numTileSamples; j++)
+                    for (size_t r = 0; r < numRows; r++)
+                        outData[(tileBegin + j) * m_numRows + rowBegin + r] = sums[r * tileSize + j];
+            }
+        }
+    }
+}
+
+template class BlockSparseMatrix<float>;
+template class BlockSparseMatrix<double>;
+} } }
@@ -0,0 +1,58 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#ifdef _WIN32
+#ifdef MATH_EXPORTS
+#define MATH_API __declspec(dllexport)
+#else
+#define MATH_API __declspec(dllimport)
+#endif
+#else // no DLLs on Linux
+#define MATH_API
+#endif
+
+#include "Matrix.h"
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// -----------------------------------------------------------------------
+// BlockSparseMatrix -- a pruned weight matrix in block-sparse row (BSR) form, for inference on the CPU
+// The [M x K] matrix W is tiled into blocks of [blockRows x blockCols] elements (the last block row
+// and column may be partial). Only blocks with a nonzero element are stored, as dense row-major
+// arrays, ordered by block row. With 1 x 1 blocks, this is the CSR format.
+// Multiply() computes W * x for dense x and skips the pruned blocks; larger blocks need less index
+// arithmetic per multiply-add, but prune less selectively (see ComputationNetwork::PruneParameters()).
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+class MATH_API BlockSparseMatrix
+{
+public:
+    // 'weights' must be a dense matrix; it may live on any device
+    BlockSparseMatrix(const Matrix<ElemType>& weights, size_t blockRows, size_t blockCols);
+
+    size_t GetNumRows() const { return m_numRows; }
+    size_t GetNumCols() const { return m_numCols; }
+    size_t GetNumBlocks() const { return m_blockColIndices.size(); }
+    // fraction of the blocks that are all zero, i.e. not stored
+    double GetSparsity() const;
+    size_t GetSizeInBytes() const { return m_values.size() * sizeof(ElemType) + (m_blockColIndices.size() + m_blockRowStarts.size()) * sizeof(size_t); }
+
+    // out = W * in, with in: [K x N] and out: [M x N]; 'out' must be a dense CPU matrix of the right size
+    void Multiply(const Matrix<ElemType>& in, Matrix<ElemType>& out) const;
+
+private:
+    size_t m_numRows;
+    size_t m_numCols;
+    size_t m_blockRows;
+    size_t m_blockCols;
+    std::vector<size_t> m_blockRowStarts;  // the blocks of block row b are [m_blockRowStarts[b], m_blockRowStarts[b + 1])
+    std::vector<size_t> m_blockColIndices; // block column of each stored block
+    std::vector<ElemType> m_values;        // stored block n at [n * m_blockRows * m_blockCols, (n + 1) * m_blockRows * m_blockCols), zero-padded
+};
+} } }
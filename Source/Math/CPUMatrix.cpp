@@ -10,7 +10,11 @@
 #include "File.h"
 
 #include "CPUMatrix.h"
+#include "CPUVectorKernels.h"
+#include "HostCachingMemAllocator.h"
+#include "CPUThreadBudget.h"
 #include "TensorOps.h"
+#include "PhiloxRandom.h"
 #include <assert.h>
 #include <stdexcept>
 #include <omp.h>
@@ -21,11 +25,14 @@
 #include <thread>
 #include <iostream>
 #include <algorithm>
+#include <atomic>
 #ifdef _WIN32
 #define NOMINMAX
 #include "Windows.h"
 #else
 #include <cfloat>
+#include <pthread.h>
+#include <sched.h>
 #endif
 
 #ifdef LEAKDETECT
@@ -82,6 +89,94 @@ bool TracingGPUMemoryAllocator::IsTraceEnabled()
     return (m_traceLevel > 0);
 }
 
+bool MATH_API GPUMathOptions::m_useHalfPrecisionGemm = false;
+std::wstring MATH_API GPUMathOptions::m_convolutionAlgoCacheFile;
+bool MATH_API GPUMathOptions::m_logImplicitDeviceSyncs = false;
+size_t MATH_API GPUMathOptions::m_numHostTransfers = 0;
+bool MATH_API GPUMathOptions::m_jitTensorKernels = false;
+std::wstring MATH_API GPUMathOptions::m_jitKernelCacheDir;
+
+void GPUMathOptions::LogImplicitDeviceSync(const char* operation)
+{
+    fprintf(stderr, "Implicit device synchronization in %s, called from:\n", operation);
+    DebugUtil::PrintCallStack();
+}
+
+// free lists of MatrixObjectRecycler, by object size in steps of Granularity bytes, linked through the freed objects
+struct MatrixObjectFreeLists
+{
+    static const size_t Granularity = 16;
+    static const size_t NumSizes = 32;       // objects of up to 512 bytes are recycled
+    static const size_t MaxNumPerSize = 256; // more freed objects of a size go back to the heap
+
+    struct FreeObject
+    {
+        FreeObject* m_next;
+    };
+    FreeObject* m_heads[NumSizes] = {};
+    size_t m_counts[NumSizes] = {};
+
+    ~MatrixObjectFreeLists();
+};
+
+static thread_local MatrixObjectFreeLists t_matrixObjectFreeLists;
+static thread_local bool t_matrixObjectFreeListsDestroyed = false; // objects may still be freed after, e.g. by static Matrix objects
+
+MatrixObjectFreeLists::~MatrixObjectFreeLists()
+{
+    for (auto head : m_heads)
+    {
+        while (head)
+        {
+            auto next = head->m_next;
+            ::operator delete(head);
+            head = next;
+        }
+    }
+    t_matrixObjectFreeListsDestroyed = true;
+}
+
+void* MatrixObjectRecycler::Allocate(size_t size)
+{
+    const size_t sizeIndex = (size - 1) / MatrixObjectFreeLists::Granularity;
+    if (sizeIndex >= MatrixObjectFreeLists::NumSizes)
+        return ::operator new(size);
+    if (!t_matrixObjectFreeListsDestroyed)
+    {
+        auto& freeLists = t_matrixObjectFreeLists;
+        auto p = freeLists.m_heads[sizeIndex];
+        if (p)
+        {
+            freeLists.m_heads[sizeIndex] = p->m_next;
+            freeLists.m_counts[sizeIndex]--;
+            return p;
+        }
+    }
+    // allocate the full size of the class, so that the object can be reused for any size within it
+    return ::operator new((sizeIndex + 1) * MatrixObjectFreeLists::Granularity);
+}
+
+void MatrixObjectRecycler::Free(void* p, size_t size)
+{
+    if (!p)
+        return;
+    // Note: The object may have been allocated by another thread; the free lists only hold memory, so it can move between threads.
+    const size_t sizeIndex = (size - 1) / MatrixObjectFreeLists::Granularity;
+    if (sizeIndex < MatrixObjectFreeLists::NumSizes && !t_matrixObjectFreeListsDestroyed)
+    {
+        auto& freeLists = t_matrixObjectFreeLists;
+        if (freeLists.m_counts[sizeIndex] < MatrixObjectFreeLists::MaxNumPerSize)
+        {
+            auto object = static_cast<MatrixObjectFreeLists::FreeObject*>(p);
+            object->m_next = freeLists.m_heads[sizeIndex];
+            freeLists.m_heads[sizeIndex] = object;
+            freeLists.m_counts[sizeIndex]++;
+            return;
+        }
+    }
+    ::operator delete(p);
+}
+
 #pragma region Helpful Enum Definitions
 enum class MatrixOrder
 {
@@ -111,6 +206,118 @@ enum class MatrixOpSide : char
 };
 #pragma endregion Helpful Enum Definitions
 
+#pragma region Vector Kernels
+
+// Element-wise operations on float matrices use the SIMD kernels of CPUVectorKernels, applied to chunks
+// of the (contiguous) element array that are spread over the OpenMP threads. The double overloads
+// return false, and the callers then run their scalar loops.
+static const size_t VectorKernelChunkSize = 16384;
+
+template <class F>
+static void ForEachVectorKernelChunk(size_t n, F f)
+{
+    const long numChunks = (long) ((n + VectorKernelChunkSize - 1) / VectorKernelChunkSize);
+#pragma omp parallel for
+    for (long c = 0; c < numChunks; c++)
+    {
+        const size_t begin = c * VectorKernelChunkSize;
+        f(begin, min(VectorKernelChunkSize, n - begin));
+    }
+}
+
+static bool TryVectorKernel(CPUVectorKernels::UnaryKernel kernel, const float* a, float* us, size_t n)
+{
+    ForEachVectorKernelChunk(n, [=](size_t begin, size_t count)
+                             {
+                                 kernel(a + begin, us + begin, count);
+                             });
+    return true;
+}
+static bool TryVectorKernel(CPUVectorKernels::UnaryKernel, const double*, double*, size_t)
+{
+    return false;
+}
+
+static bool TryVectorLog(const float* a, float* us, size_t n)
+{
+    ForEachVectorKernelChunk(n, [=](size_t begin, size_t count)
+                             {
+                                 CPUVectorKernels::Get().Log(a + begin, us + begin, count, EPS_IN_LOG, LOG_OF_EPS_IN_LOG);
+                             });
+    return true;
+}
+static bool TryVectorLog(const double*, double*, size_t)
+{
+    return false;
+}
+
+static bool TryVectorAddElementProduct(const float* a, const float* b, float* us, size_t n)
+{
+    ForEachVectorKernelChunk(n, [=](size_t begin, size_t count)
+                             {
+                                 CPUVectorKernels::Get().AddElementProduct(a + begin, b + begin, us + begin, count);
+                             });
+    return true;
+}
+static bool TryVectorAddElementProduct(const double*, const double*, double*, size_t)
+{
+    return false;
+}
+
+// per column; these are called from within parallel loops over the columns
+static bool TryVectorMax(const float* col, size_t n, float& maxV)
+{
+    maxV = CPUVectorKernels::Get().Max(col, n);
+    return true;
+}
+static bool TryVectorMax(const double*, size_t, double&)
+{
+    return false;
+}
+
+static bool TryVectorMaxAndSumExp(const float* col, size_t n, float& maxV, float& sum)
+{
+    sum = CPUVectorKernels::Get().MaxAndSumExp(col, n, maxV);
+    return true;
+}
+static bool TryVectorMaxAndSumExp(const double*, size_t, double&, double&)
+{
+    return false;
+}
+
+static bool TryVectorShiftExpAndSum(const float* col, float shift, float* out, size_t n, float& sum)
+{
+    sum = CPUVectorKernels::Get().ShiftExpAndSum(col, shift, out, n);
+    return true;
+}
+static bool TryVectorShiftExpAndSum(const double*, double, double*, size_t, double&)
+{
+    return false;
+}
+
+// Products with at most this many multiply-adds are computed by the register-blocked kernel on the calling thread:
+// for them, the dispatch and threading overhead of the BLAS call costs as much as the arithmetic.
+static const size_t SmallGemmMaxMultiplyAdds = 256 * 1024;
+
+static bool IsSmallGemm(size_t m, size_t n, size_t k)
+{
+    return m * n * k <= SmallGemmMaxMultiplyAdds;
+}
+
+// c = alpha * a * op(b) + beta * c, column-major
+static bool TryVectorSmallGemm(size_t m, size_t n, size_t k, float alpha, const float* a, size_t lda, const float* b, size_t ldb, bool transposeB,
+                               float beta, float* c, size_t ldc)
+{
+    CPUVectorKernels::Get().SmallGemm(m, n, k, alpha, a, lda, b, ldb, transposeB, beta, c, ldc);
+    return true;
+}
+static bool TryVectorSmallGemm(size_t, size_t, size_t, double, const double*, size_t, const double*, size_t, bool, double, double*, size_t)
+{
+    return false;
+}
+
+#pragma endregion Vector Kernels
+
 #pragma region Constructors and Destructor
 
 //should only be used by constructors.
@@ -134,10 +341,12 @@ CPUMatrix<ElemType>::CPUMatrix()
 
 // helper to allocate an array of ElemType
 // Use this instead of new[] to get NaN initialization for debugging.
+// The memory comes from the caching host allocator and must be released with DeleteArray().
 template <class ElemType>
 static ElemType* NewArray(size_t n)
 {
-    ElemType* p = new ElemType[n]();
+    ElemType* p = HostCachingMemAllocator::NewArray<ElemType>(n);
+    memset(p, 0, n * sizeof(ElemType));
 #if 0 // _DEBUG
         ElemType nan = Matrix<ElemType>::MakeNan(__LINE__);
         for (size_t i = 0; i < n; i++)
@@ -146,6 +355,12 @@ static ElemType* NewArray(size_t n)
     return p;
 }
 
+template <class ElemType>
+static void DeleteArray(ElemType* p)
+{
+    HostCachingMemAllocator::DeleteArray(p);
+}
+
 template <class ElemType>
 CPUMatrix<ElemType>::CPUMatrix(const size_t numRows, const size_t numCols)
 {
@@ -207,7 +422,7 @@ CPUMatrix<ElemType>& CPUMatrix<ElemType>::operator=(CPUMatrix<ElemType>&& moveFr
     if (this != &moveFrom)
     {
         if (OwnBuffer() && m_pArray != nullptr)
-            delete[] m_pArray; // always delete the data pointer since we will use the pointer from moveFrom
+            DeleteArray(m_pArray); // always delete the data pointer since we will use the pointer from moveFrom
 
         m_computeDevice = moveFrom.m_computeDevice;
         m_numRows = moveFrom.m_numRows;
@@ -234,7 +449,7 @@ void CPUMatrix<ElemType>::Clear()
 {
     if (m_pArray != nullptr && OwnBuffer())
     {
-        delete[] m_pArray;
+        DeleteArray(m_pArray);
         m_pArray = nullptr;
         m_elemSizeAllocated = 0;
     }
@@ -343,6 +558,77 @@ void CPUMatrix<ElemType>::CopyColumnsStrided(const CPUMatrix<ElemType>& fromMatr
     }
 }
 
+// this(:,j) = beta * this(:,j) + alpha * a(:,idx(j)); a negative index leaves beta * this(:,j)
+template <class ElemType>
+CPUMatrix<ElemType>& CPUMatrix<ElemType>::DoGatherColumnsOf(ElemType beta, const CPUMatrix<ElemType>& idx, const CPUMatrix<ElemType>& a, ElemType alpha)
+{
+    if (idx.GetNumRows() != 1)
+        InvalidArgument("DoGatherColumnsOf: The index must be a row vector.");
+    if (beta)
+        this->VerifySize(a.GetNumRows(), idx.GetNumCols());
+    else
+        Resize(a.GetNumRows(), idx.GetNumCols());
+    foreach_column (j, idx)
+    {
+        if (idx(0, j) >= a.GetNumCols())
+            InvalidArgument("DoGatherColumnsOf: Index %d is out of the range of the input [0, %d).", (int) idx(0, j), (int) a.GetNumCols());
+    }
+
+    auto& us = *this;
+#pragma omp parallel for
+    foreach_column (j, us)
+    {
+        const ptrdiff_t jIn = (ptrdiff_t) idx(0, j);
+        ElemType* out = &us(0, j);
+        const size_t m = us.GetNumRows();
+        if (jIn < 0)
+        {
+            for (size_t i = 0; i < m; i++)
+                out[i] = beta ? beta * out[i] : 0;
+            continue;
+        }
+        const ElemType* in = &a(0, (size_t) jIn);
+        for (size_t i = 0; i < m; i++)
+            out[i] = (beta ? beta * out[i] : 0) + alpha * in[i];
+    }
+    return *this;
+}
+
+// this(:,idx(j)) = beta * this(:,idx(j)) + alpha * a(:,j), and beta * this elsewhere; a negative index drops the column
+// The indices must not repeat.
+template <class ElemType>
+CPUMatrix<ElemType>& CPUMatrix<ElemType>::DoScatterColumnsOf(ElemType beta, const CPUMatrix<ElemType>& idx, const CPUMatrix<ElemType>& a, ElemType alpha)
+{
+    if (idx.GetNumRows() != 1 || idx.GetNumCols() != a.GetNumCols())
+        InvalidArgument("DoScatterColumnsOf: The index must be a row vector with one entry per column of the input.");
+    if (GetNumRows() != a.GetNumRows())
+        InvalidArgument("DoScatterColumnsOf: The number of rows of the input (%d) does not match that of the target (%d).", (int) a.GetNumRows(), (int) GetNumRows());
+    foreach_column (j, idx)
+    {
+        if (idx(0, j) >= GetNumCols())
+            InvalidArgument("DoScatterColumnsOf: Index %d is out of the range of the target [0, %d).", (int) idx(0, j), (int) GetNumCols());
+    }
+    if (beta == 0)
+        SetValue(0);
+    else if (beta != 1)
+        *this *= beta;
+
+    auto& us = *this;
+#pragma omp parallel for
+    foreach_column (j, a)
+    {
+        const ptrdiff_t jOut = (ptrdiff_t) idx(0, j);
+        if (jOut < 0)
+            continue;
+        ElemType* out = &us(0, (size_t) jOut);
+        const ElemType* in = &a(0, j);
+        const size_t m = a.GetNumRows();
+        for (size_t i = 0; i < m; i++)
+            out[i] += alpha * in[i];
+    }
+    return *this;
+}
+
 //for each column of a, we add all rows of a to this starting from startIndex
 template <class ElemType>
 CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignToRowSliceValuesOf(const CPUMatrix<ElemType>& a, const size_t startIndex, const size_t numRows)
@@ -838,9 +1124,9 @@ void CPUMatrix<ElemType>::SetValue(const size_t numRows, const size_t numCols, E
     // if it's externally managed, then populate the structure
     if (matrixFlags & matrixFlagDontOwnBuffer)
     {
-        // free previous array allocation if any before overwriting
-        if (m_pArray != nullptr)
-            delete[] m_pArray;
+        // free previous array allocation if any before overwriting (but not someone else's buffer, e.g. when rebinding)
+        if (m_pArray != nullptr && OwnBuffer())
+            DeleteArray(m_pArray);
 
         m_pArray = pArray;
         m_numRows = numRows;
@@ -1036,6 +1322,41 @@ void CPUMatrix<ElemType>::SetGaussianRandomValue(const ElemType mean, const Elem
     }
 }
 
+// [this] = beta * [this] + a .* mask, the mask from the counter-based generator (see Matrix::ScaleAndAddDropoutOf())
+template <class ElemType>
+CPUMatrix<ElemType>& CPUMatrix<ElemType>::ScaleAndAddDropoutOf(const ElemType beta, const CPUMatrix<ElemType>& a, const ElemType maskRate, const ElemType scaleValue, unsigned long seed, size_t counterOffset)
+{
+    if (a.IsEmpty())
+        LogicError("ScaleAndAddDropoutOf: Matrix is empty.");
+    if (beta == 0)
+        Resize(a.GetNumRows(), a.GetNumCols());
+    else if (!(a.GetNumRows() == GetNumRows() && a.GetNumCols() == GetNumCols()))
+        InvalidArgument("ScaleAndAddDropoutOf: The input matrix dimensions do not match [this].");
+
+    const ElemType* pa = a.m_pArray;
+    ElemType* pus = m_pArray;
+    const long n = (long) GetNumElements();
+    const long numBlocks = (long) ((counterOffset + n + 3) / 4 - counterOffset / 4);
+    // each Philox block yields the mask of four consecutive elements
+#pragma omp parallel for
+    for (long b = 0; b < numBlocks; b++)
+    {
+        const uint64_t block = counterOffset / 4 + b;
+        uint32_t words[4];
+        Philox4x32(seed, block, words);
+        for (int k = 0; k < 4; k++)
+        {
+            const long i = (long) (block * 4 + k - counterOffset);
+            if (i < 0 || i >= n)
+                continue;
+            const ElemType u = (ElemType) PhiloxWordToUniform(words[k]);
+            const ElemType value = u <= maskRate ? 0 : scaleValue * pa[i];
+            pus[i] = beta == 0 ? value : beta * pus[i] + value;
+        }
+    }
+    return *this;
+}
+
 template <class ElemType>
 void CPUMatrix<ElemType>::AddGaussianRandomValue(const ElemType mean, const ElemType sigma, unsigned long seed)
 {
@@ -1230,6 +1551,92 @@ void CPUMatrix<ElemType>::FSAdagrad(CPUMatrix<ElemType>& gradients,
     }
 }
 
+// Adam in the form of Kingma and Ba, section 2: the bias correction sqrt(1 - beta2^t) / (1 - beta1^t) is folded into
+// 'biasCorrection', and 'epsilon' is already multiplied by sqrt(1 - beta2^t).
+// Without functionValues, the gradients are replaced by the update direction.
+template <class ElemType>
+void CPUMatrix<ElemType>::Adam(CPUMatrix<ElemType>& gradients,
+                               CPUMatrix<ElemType>* functionValues,
+                               ElemType learnRate,
+                               ElemType beta1,
+                               ElemType beta2,
+                               ElemType epsilon,
+                               ElemType biasCorrection)
+{
+    size_t numColsNeeded = 2 * gradients.GetNumCols();
+
+    if (IsEmpty() || (GetNumCols() < numColsNeeded))
+    {
+        Resize(gradients.GetNumRows(), numColsNeeded);
+        SetValue(0.0);
+    }
+
+    assert((GetNumRows() == gradients.GetNumRows()) && (GetNumCols() == numColsNeeded));
+
+    size_t n = gradients.GetNumElements();
+    ElemType* grad = gradients.m_pArray;
+    ElemType* smoothMom = m_pArray;
+    ElemType* smoothSqr = m_pArray + n;
+    ElemType* val = functionValues ? functionValues->m_pArray : nullptr;
+#pragma omp parallel for
+    for (long i = 0; i < n; i++)
+    {
+        ElemType g = grad[i];
+        ElemType mom = beta1 * smoothMom[i] + (1 - beta1) * g;
+        ElemType sqr = beta2 * smoothSqr[i] + (1 - beta2) * g * g;
+        smoothMom[i] = mom;
+        smoothSqr[i] = sqr;
+        ElemType direction = biasCorrection * mom / (sqrt(sqr) + epsilon);
+        if (val)
+            val[i] -= learnRate * direction;
+        else
+            grad[i] = direction;
+    }
+}
+
+// all tensors of the batch in one parallel loop, over chunks so that small tensors do not each pay for a parallel region
+template <class ElemType>
+/*static*/ void CPUMatrix<ElemType>::FusedSGDUpdate(const FusedSGDBatch<ElemType>& batch)
+{
+    const size_t chunkSize = 4096;
+    std::vector<int> chunkTensors;
+    std::vector<size_t> chunkBegins;
+    for (int t = 0; t < batch.m_numTensors; t++)
+    {
+        for (size_t begin = 0; begin < batch.m_tensors[t].m_numElements; begin += chunkSize)
+        {
+            chunkTensors.push_back(t);
+            chunkBegins.push_back(begin);
+        }
+    }
+
+    long numChunks = (long) chunkTensors.size();
+#pragma omp parallel for
+    for (long c = 0; c < numChunks; c++)
+    {
+        const auto& tensor = batch.m_tensors[chunkTensors[c]];
+        size_t end = min(chunkBegins[c] + chunkSize, tensor.m_numElements);
+        for (size_t i = chunkBegins[c]; i < end; i++)
+            FusedSGDUpdateElement(batch, tensor, i);
+    }
+}
+
+// adds the sum of the squared gradient elements of the batch to *sumOfSquares
+template <class ElemType>
+/*static*/ void CPUMatrix<ElemType>::FusedSGDSquaredNorm(const FusedSGDBatch<ElemType>& batch, ElemType* sumOfSquares)
+{
+    double sum = 0;
+    for (int t = 0; t < batch.m_numTensors; t++)
+    {
+        const ElemType* grad = batch.m_tensors[t].m_gradient;
+        long n = (long) batch.m_tensors[t].m_numElements;
+#pragma omp parallel for reduction(+ : sum)
+        for (long i = 0; i < n; i++)
+            sum += (double) grad[i] * grad[i];
+    }
+    *sumOfSquares += (ElemType) sum;
+}
+
 template <class ElemType>
 ElemType CPUMatrix<ElemType>::RmsProp(CPUMatrix<ElemType>& gradients,
                                       ElemType RMS_GAMMA,
@@ -1363,7 +1770,7 @@ void CPUMatrix<ElemType>::Resize(const size_t numRows, const size_t numCols, boo
         }
         // success: update the object
         if (OwnBuffer())
-            delete[] m_pArray;
+            DeleteArray(m_pArray);
         else
             assert(pArray == nullptr); // (if !OwnBuffer we can still resize to 0)
         m_pArray = pArray;
@@ -1383,7 +1790,7 @@ ElemType* CPUMatrix<ElemType>::CopyToArray() const
     size_t numElements = GetNumElements();
     if (numElements != 0)
     {
-        ElemType* arrayCopyTo = NewArray<ElemType>(numElements);
+        ElemType* arrayCopyTo = new ElemType[numElements]; // (the caller frees it with delete[])
         memcpy(arrayCopyTo, m_pArray, sizeof(ElemType) * numElements);
         return arrayCopyTo;
     }
@@ -1403,7 +1810,7 @@ size_t CPUMatrix<ElemType>::CopyToArray(ElemType*& arrayCopyTo, size_t& currentA
     if (numElements > currentArraySize)
     {
         delete arrayCopyTo;
-        arrayCopyTo = NewArray<ElemType>(numElements);
+        arrayCopyTo = new ElemType[numElements];
         currentArraySize = numElements;
     }
 
@@ -1818,6 +2225,9 @@ CPUMatrix<ElemType>& CPUMatrix<ElemType>::AddElementProductOf(const CPUMatrix<El
     if (!(a.GetNumRows() == GetNumRows() && a.GetNumCols() == GetNumCols()))
         InvalidArgument("AddElementProductOf : The input matrix dimensions do not match [this].");
 
+    if (TryVectorAddElementProduct(a.m_pArray, b.m_pArray, m_pArray, GetNumElements()))
+        return *this;
+
     auto& us = *this;
 
     long m = (long) GetNumRows(), n = (long) GetNumCols();
@@ -2066,6 +2476,9 @@ CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignSigmoidOf(const CPUMatrix<ElemTy
     if (this != &a)
         Resize(a.GetNumRows(), a.GetNumCols());
 
+    if (TryVectorKernel(CPUVectorKernels::Get().Sigmoid, a.m_pArray, m_pArray, GetNumElements()))
+        return *this;
+
 #pragma omp parallel for
     foreach_coord (i, j, us)
     {
@@ -2182,6 +2595,9 @@ CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignTanhOf(const CPUMatrix<ElemType>
     if (this != &a)
         Resize(a.GetNumRows(), a.GetNumCols());
 
+    if (TryVectorKernel(CPUVectorKernels::Get().Tanh, a.m_pArray, m_pArray, GetNumElements()))
+        return *this;
+
     long m = (long) GetNumRows(), n = (long) GetNumCols();
 #pragma omp parallel for
     for (long j = 0; j < n; j++)
@@ -2226,17 +2642,22 @@ CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignLogSoftmaxOf(const CPUMatrix<Ele
 #pragma omp parallel for
         foreach_column (j, a)
         {
-            // we need to extract max before applying exp to avoid overflow
+            const size_t m = a.GetNumRows();
+            // max and sum of exp() in a single read of the column; we need the max to avoid overflow
             ElemType maxV = a(0, j);
-            foreach_row (i, a)
-                maxV = std::max(maxV, a(i, j));
-
             ElemType sum = 0;
-            foreach_row (i, a)
-                sum += exp(us(i, j) = a(i, j) - maxV);
-            sum = log(sum);
-            foreach_row (i, us)
-                us(i, j) -= sum;
+            if (!TryVectorMaxAndSumExp(&a(0, j), m, maxV, sum))
+            {
+                foreach_row (i, a)
+                    maxV = std::max(maxV, a(i, j));
+                foreach_row (i, a)
+                    sum += exp(a(i, j) - maxV);
+            }
+            const ElemType logSum = maxV + log(sum);
+            const ElemType* in = &a(0, j);
+            ElemType* out = &us(0, j);
+            for (size_t i = 0; i < m; i++)
+                out[i] = in[i] - logSum;
         }
     }
     else
@@ -2261,6 +2682,87 @@ CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignLogSoftmaxOf(const CPUMatrix<Ele
     return *this;
 }
 
+//[this]=softmax([this]) element wise
+template <class ElemType>
+CPUMatrix<ElemType>& CPUMatrix<ElemType>::InplaceSoftmax(const bool isColWise)
+{
+    return AssignSoftmaxOf(*this, isColWise);
+}
+
+// This takes one exp() per element: the exponentials are written while they are summed, and then scaled by
+// the reciprocal of the sum while the column is still in cache.
+template <class ElemType>
+CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignSoftmaxOf(const CPUMatrix<ElemType>& a, const bool isColWise)
+{
+    if (a.IsEmpty())
+        LogicError("AssignSoftmaxOf: Matrix a is empty.");
+    if (!isColWise)
+        return AssignLogSoftmaxOf(a, isColWise).InplaceExp();
+
+    auto& us = *this;
+    if (this != &a)
+        Resize(a.GetNumRows(), a.GetNumCols());
+
+#pragma omp parallel for
+    foreach_column (j, a)
+    {
+        const size_t m = a.GetNumRows();
+        const ElemType* in = &a(0, j);
+        ElemType* out = &us(0, j);
+        ElemType maxV = in[0];
+        if (!TryVectorMax(in, m, maxV))
+        {
+            for (size_t i = 1; i < m; i++)
+                maxV = std::max(maxV, in[i]);
+        }
+
+        ElemType sum = 0;
+        if (!TryVectorShiftExpAndSum(in, maxV, out, m, sum))
+        {
+            for (size_t i = 0; i < m; i++)
+                sum += out[i] = exp(in[i] - maxV);
+        }
+        const ElemType scale = 1 / sum;
+        for (size_t i = 0; i < m; i++)
+            out[i] *= scale;
+    }
+
+    return *this;
+}
+
+// column-wise softmax of scale * a over the first numValidRows(0,j) rows of each column j; the other rows are 0
+template <class ElemType>
+CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignMaskedSoftmaxOf(const CPUMatrix<ElemType>& a, ElemType scale, const CPUMatrix<ElemType>& numValidRows)
+{
+    if (numValidRows.GetNumRows() != 1 || numValidRows.GetNumCols() != a.GetNumCols())
+        InvalidArgument("AssignMaskedSoftmaxOf: numValidRows must be a row vector with one entry per column.");
+
+    auto& us = *this;
+    if (this != &a)
+        Resize(a.GetNumRows(), a.GetNumCols());
+
+#pragma omp parallel for
+    foreach_column (j, a)
+    {
+        const size_t m = a.GetNumRows();
+        const size_t numValid = std::min(m, (size_t) numValidRows(0, j));
+        const ElemType* in = &a(0, j);
+        ElemType* out = &us(0, j);
+        ElemType maxV = numValid > 0 ? scale * in[0] : 0;
+        for (size_t i = 1; i < numValid; i++)
+            maxV = std::max(maxV, scale * in[i]);
+        ElemType sum = 0;
+        for (size_t i = 0; i < numValid; i++)
+            sum += out[i] = exp(scale * in[i] - maxV);
+        const ElemType norm = sum > 0 ? 1 / sum : 0;
+        for (size_t i = 0; i < numValid; i++)
+            out[i] *= norm;
+        for (size_t i = numValid; i < m; i++)
+            out[i] = 0;
+    }
+    return *this;
+}
+
 //[this]=hardmax([this])
 //the max element is 1 else is 0
 template <class ElemType>
@@ -2383,6 +2885,9 @@ CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignExpOf(const CPUMatrix<ElemType>&
     if (this != &a)
         Resize(a.GetNumRows(), a.GetNumCols());
 
+    if (TryVectorKernel(CPUVectorKernels::Get().Exp, a.m_pArray, m_pArray, GetNumElements()))
+        return *this;
+
     long m = (long) GetNumRows(), n = (long) GetNumCols();
 #pragma omp parallel for
     for (long j = 0; j < n; j++)
@@ -2468,6 +2973,9 @@ CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignLogOf(const CPUMatrix<ElemType>&
     if (this != &a)
         Resize(a.GetNumRows(), a.GetNumCols());
 
+    if (TryVectorLog(a.m_pArray, m_pArray, GetNumElements()))
+        return *this;
+
 #pragma omp parallel for
     foreach_coord (i, j, a)
     {
@@ -3260,6 +3768,45 @@ CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignFrobeniusNormOf(const CPUMatrix<
     return us;
 }
 
+template <class ElemType>
+CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignMatrixNormInfOf(const CPUMatrix<ElemType>& a)
+{
+    if (a.IsEmpty())
+        LogicError("AssignMatrixNormInfOf: Matrix a is empty.");
+
+    auto& us = *this;
+    ElemType norm = a.MatrixNormInf(); // before the resize, a may be us
+    us.Resize(1, 1);
+    us(0, 0) = norm;
+
+    return us;
+}
+
+template <class ElemType>
+CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignMatrixNorm1Of(const CPUMatrix<ElemType>& a)
+{
+    if (a.IsEmpty())
+        LogicError("AssignMatrixNorm1Of: Matrix a is empty.");
+
+    auto& us = *this;
+    ElemType norm = a.MatrixNorm1(); // before the resize, a may be us
+    us.Resize(1, 1);
+    us(0, 0) = norm;
+
+    return us;
+}
+
+template <class ElemType>
+CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignIsEqualTo(const CPUMatrix<ElemType>& a, const CPUMatrix<ElemType>& b, const ElemType threshold /*= 1e-8*/)
+{
+    auto& us = *this;
+    bool isEqual = a.IsEqualTo(b, threshold);
+    us.Resize(1, 1);
+    us(0, 0) = isEqual ? (ElemType) 1 : (ElemType) 0;
+
+    return us;
+}
+
 template <class ElemType>
 ElemType CPUMatrix<ElemType>::MatrixNormInf() const
 {
@@ -3397,12 +3944,27 @@ void CPUMatrix<ElemType>::VectorMax(CPUMatrix<ElemType>& maxIndexes, CPUMatrix<E
             {
                 ElemType v = us(0, j);
                 size_t index = 0;
-                foreach_row (i, us)
+                if (TryVectorMax(&us(0, j), m, v))
                 {
-                    if (v < us(i, j))
+                    // the first occurrence of the maximum, like the loop below
+                    foreach_row (i, us)
                     {
-                        index = i;
-                        v = us(i, j);
+                        if (us(i, j) == v)
+                        {
+                            index = i;
+                            break;
+                        }
+                    }
+                }
+                else
+                {
+                    foreach_row (i, us)
+                    {
+                        if (v < us(i, j))
+                        {
+                            index = i;
+                            v = us(i, j);
+                        }
                     }
                 }
                 maxValues(0, j) = v;
@@ -3558,6 +4120,37 @@ CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignNumOfDiff(const CPUMatrix<ElemTy
     return *this;
 }
 
+template <class ElemType>
+CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignNumOfTopKErrorsOf(const CPUMatrix<ElemType>& labels, const CPUMatrix<ElemType>& predictions, const size_t topK)
+{
+    const size_t numRows = predictions.GetNumRows();
+    const long numCols = (long) predictions.GetNumCols();
+    long numErrors = 0;
+#pragma omp parallel for reduction(+ : numErrors)
+    for (long t = 0; t < numCols; t++)
+    {
+        // the label is the first maximum of its column
+        const ElemType* label = labels.m_pArray + t * numRows;
+        size_t labelIndex = 0;
+        for (size_t i = 1; i < numRows; i++)
+        {
+            if (label[i] > label[labelIndex])
+                labelIndex = i;
+        }
+        // the rank of the label among the predictions
+        const ElemType* prediction = predictions.m_pArray + t * numRows;
+        const ElemType labelPrediction = prediction[labelIndex];
+        size_t rank = 0;
+        for (size_t i = 0; i < numRows; i++)
+            rank += prediction[i] > labelPrediction || (prediction[i] == labelPrediction && i < labelIndex);
+        numErrors += rank >= topK;
+    }
+
+    Resize(1, 1);
+    (*this)(0, 0) = (ElemType) numErrors;
+    return *this;
+}
+
 #pragma endregion Member BLAS Functions
 
 #pragma region Other helper Functions
@@ -3823,144 +4416,648 @@ CPUMatrix<ElemType>& CPUMatrix<ElemType>::UnpackConvolutionInput(CPUMatrix<ElemT
     return inputSubBatch;
 }
 
-//assume each column is an input sample. Each sample is stored in  (r00, g00, b00, r01, g01, b01, r10, g10, b10, r11, g11, b11)
+// direct convolution of samples in the layout of AssignPackedConvolutionInput, (channel, row, col), without unrolling
+// The filter is repacked as [posyInKernel][posxInKernel][channel][outputChannel], so that the innermost loop runs over
+// the output channels of an output position, which are contiguous in the output. Blocks of output positions along a
+// column share the loads of the filter.
 template <class ElemType>
-CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignMaxPoolingResult(const CPUMatrix<ElemType>& inputBatch, const size_t channels,
-                                                                 const size_t /*inputWidth*/, const size_t inputHeight, const size_t /*inputSizePerSample*/,
-                                                                 const size_t /*outputWidth*/, const size_t outputHeight, const size_t outputSizePerSample,
-                                                                 const size_t windowWidth, const size_t windowHeight, const size_t horizontalSubsample, const size_t verticalSubsample)
+static void DirectConvolutionHWC(const ElemType* input, const ElemType* packedFilter, ElemType* output, const size_t numSamples,
+                                 const size_t inputWidth, const size_t inputHeight, const size_t inputChannels,
+                                 const size_t outputWidth, const size_t outputHeight, const size_t outputChannels,
+                                 const size_t kernelWidth, const size_t kernelHeight, const size_t horizontalSubsample, const size_t verticalSubsample,
+                                 const long horizontalPad, const long verticalPad)
 {
-    const long inputHeightTimesChannel = (long) (inputHeight * channels);
-    const long outputHeightTimesChannel = (long) (outputHeight * channels);
-    const size_t batchSize = inputBatch.GetNumCols();
-    Resize(outputSizePerSample, batchSize);
-
-// IN_ELEM_ROWPOS(channel, row, col) = (channel + (row + col * inputHeight) * channels)
-// IN_ELEM_COLPOS = sample
-
-// OUT_ELEM_ROWPOS(channel, wrow, wcol) = (channel + (wrow + wcol * outputHeight) * channels)
-// OUT_ELEM_COLPOS = sample
+    const size_t blockRows = 4;
+    const size_t inputDim = inputWidth * inputHeight * inputChannels;
+    const size_t outputDim = outputWidth * outputHeight * outputChannels;
+    const size_t K = outputChannels;
+    const size_t C = inputChannels;
 
 #pragma omp parallel for
-    for (long sample = 0; sample < (long) batchSize; sample++)
+    for (long sampleCol = 0; sampleCol < (long) (numSamples * outputWidth); sampleCol++)
     {
-        for (long outputIndexWithinSample = 0; outputIndexWithinSample < outputSizePerSample; outputIndexWithinSample++)
+        const size_t sample = sampleCol / outputWidth;
+        const size_t wcol = sampleCol % outputWidth;
+        const ElemType* in = input + sample * inputDim;
+        ElemType* out = output + sample * outputDim + wcol * outputHeight * K; // the rows of a column are contiguous
+
+        for (size_t wrow0 = 0; wrow0 < outputHeight; wrow0 += blockRows)
         {
-            const long y = outputIndexWithinSample / outputHeightTimesChannel;   // wcol
-            const long nXC = outputIndexWithinSample % outputHeightTimesChannel; // channel + wrow*channels
-            const long x = (long) (nXC / channels);                              // wrow
-            const long c = (long) (nXC % channels);                              // channel
+            const size_t numRows = min(blockRows, outputHeight - wrow0);
+            ElemType* outBlock = out + wrow0 * K;
+            memset(outBlock, 0, sizeof(ElemType) * numRows * K);
+
+            for (size_t posyInKernel = 0; posyInKernel < kernelWidth; posyInKernel++)
+            {
+                const long y = (long) (wcol * horizontalSubsample + posyInKernel) - horizontalPad; // inputCol
+                if (y < 0 || y >= (long) inputWidth)
+                    continue;
+                for (size_t posxInKernel = 0; posxInKernel < kernelHeight; posxInKernel++)
+                {
+                    // the positions of the block that see this kernel element inside the input
+                    const ElemType* inRows[blockRows];
+                    ElemType* outRows[blockRows];
+                    size_t numValid = 0;
+                    for (size_t r = 0; r < numRows; r++)
+                    {
+                        const long x = (long) ((wrow0 + r) * verticalSubsample + posxInKernel) - verticalPad; // inputRow
+                        if (x < 0 || x >= (long) inputHeight)
+                            continue;
+                        inRows[numValid] = in + (x + y * inputHeight) * C;
+                        outRows[numValid] = outBlock + r * K;
+                        numValid++;
+                    }
+                    const ElemType* w = packedFilter + (posyInKernel * kernelHeight + posxInKernel) * C * K;
+                    for (size_t c = 0; c < C; c++, w += K)
+                    {
+                        for (size_t r = 0; r < numValid; r++)
+                        {
+                            const ElemType a = inRows[r][c];
+                            ElemType* o = outRows[r];
+                            for (size_t k = 0; k < K; k++)
+                                o[k] += a * w[k];
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+// Winograd convolution F(2x2, 3x3) for 3x3 kernels with stride 1 (Lavin and Gray, "Fast Algorithms for Convolutional
+// Neural Networks"), in the same layout.
+// Each 2x2 tile of output positions is computed from a 4x4 tile of the input: the tiles are transformed (V = B^T d B),
+// multiplied element-wise with the transformed filter (U = G g G^T) and summed over the input channels, which for each of
+// the 16 elements is a product of the matrices U (outputChannels x inputChannels) and V (inputChannels x tiles), and
+// transformed back (Y = A^T M A). This needs 16 instead of 36 multiplications per tile, input and output channel.
+template <class ElemType>
+static void WinogradConvolutionHWC3x3(const CPUMatrix<ElemType>& input, const CPUMatrix<ElemType>& filter, CPUMatrix<ElemType>& output,
+                                      const size_t inputWidth, const size_t inputHeight, const size_t inputChannels,
+                                      const size_t outputWidth, const size_t outputHeight, const size_t outputChannels,
+                                      const long horizontalPad, const long verticalPad)
+{
+    const size_t K = outputChannels;
+    const size_t C = inputChannels;
+    const size_t numSamples = input.GetNumCols();
+    const size_t inputDim = inputWidth * inputHeight * C;
+    const size_t outputDim = outputWidth * outputHeight * K;
 
-            ElemType maxVal = -FLT_MAX;
-            ElemType minVal = FLT_MAX;
-            const long rowInWindowBase = (long) ((x * verticalSubsample + y * horizontalSubsample * inputHeight) * channels + c);
-            for (long colInWindow = 0; colInWindow < windowWidth; colInWindow++)
+    // U(k, xi * C + c) for the transform element xi = 4 * a + b, a along the rows and b along the columns
+    CPUMatrix<ElemType> u(K, 16 * C);
+    const ElemType G[4][3] = {{1, 0, 0}, {0.5, 0.5, 0.5}, {0.5, -0.5, 0.5}, {0, 0, 1}};
+#pragma omp parallel for
+    for (long kc = 0; kc < (long) (K * C); kc++)
+    {
+        const size_t k = kc / C;
+        const size_t c = kc % C;
+        ElemType g[3][3]; // [posxInKernel][posyInKernel]
+        for (size_t j = 0; j < 3; j++)
+            for (size_t i = 0; i < 3; i++)
+                g[i][j] = filter(k, c * 9 + j * 3 + i);
+        ElemType t[4][3]; // G g
+        for (size_t a = 0; a < 4; a++)
+            for (size_t j = 0; j < 3; j++)
+                t[a][j] = G[a][0] * g[0][j] + G[a][1] * g[1][j] + G[a][2] * g[2][j];
+        for (size_t a = 0; a < 4; a++)
+            for (size_t b = 0; b < 4; b++)
+                u(k, (4 * a + b) * C + c) = t[a][0] * G[b][0] + t[a][1] * G[b][1] + t[a][2] * G[b][2];
+    }
+
+    // the samples are processed in chunks, which bounds the transformed tiles to about 4M elements
+    const size_t tileRows = (outputHeight + 1) / 2;
+    const size_t tileCols = (outputWidth + 1) / 2;
+    const size_t tilesPerSample = tileRows * tileCols;
+    const size_t maxChunkElements = (size_t) 1 << 22;
+    const size_t samplesPerChunk = max((size_t) 1, min(numSamples, maxChunkElements / (16 * tilesPerSample * max(C, K))));
+
+    CPUMatrix<ElemType> v(C, 16 * tilesPerSample * samplesPerChunk);
+    CPUMatrix<ElemType> m(K, 16 * tilesPerSample * samplesPerChunk);
+    for (size_t firstSample = 0; firstSample < numSamples; firstSample += samplesPerChunk)
+    {
+        const size_t chunkSamples = min(samplesPerChunk, numSamples - firstSample);
+        const size_t T = tilesPerSample * chunkSamples;
+
+        // V = B^T d B, for all input channels of a tile at once
+        ElemType* vData = v.BufferPointer();
+#pragma omp parallel for
+        for (long tile = 0; tile < (long) T; tile++)
+        {
+            const size_t sample = firstSample + tile / tilesPerSample;
+            const size_t tileRow = (tile % tilesPerSample) % tileRows;
+            const size_t tileCol = (tile % tilesPerSample) / tileRows;
+            const ElemType* in = input.BufferPointer() + sample * inputDim;
+            const ElemType* d[4][4]; // the input rows of the tile, null outside of the image (zero padding)
+            for (size_t a = 0; a < 4; a++)
             {
-                long rowInInput = rowInWindowBase + colInWindow * inputHeightTimesChannel;
-                for (long rowInWindow = 0; rowInWindow < windowHeight; rowInWindow++)
+                for (size_t b = 0; b < 4; b++)
+                {
+                    const long x = (long) (2 * tileRow + a) - verticalPad;
+                    const long y = (long) (2 * tileCol + b) - horizontalPad;
+                    d[a][b] = (x >= 0 && x < (long) inputHeight && y >= 0 && y < (long) inputWidth) ? in + (x + y * inputHeight) * C : nullptr;
+                }
+            }
+            for (size_t c = 0; c < C; c++)
+            {
+                ElemType e[4][4];
+                for (size_t a = 0; a < 4; a++)
+                    for (size_t b = 0; b < 4; b++)
+                        e[a][b] = d[a][b] ? d[a][b][c] : 0;
+                ElemType t[4][4]; // B^T d
+                for (size_t b = 0; b < 4; b++)
+                {
+                    t[0][b] = e[0][b] - e[2][b];
+                    t[1][b] = e[1][b] + e[2][b];
+                    t[2][b] = e[2][b] - e[1][b];
+                    t[3][b] = e[1][b] - e[3][b];
+                }
+                for (size_t a = 0; a < 4; a++)
                 {
-                    const ElemType val = inputBatch(rowInInput, sample); // pf[rowInWindow*channels];
-                    maxVal = std::max(maxVal, val);
-                    minVal = std::min(minVal, val);
-                    rowInInput += (long) channels;
+                    vData[((4 * a + 0) * T + tile) * C + c] = t[a][0] - t[a][2];
+                    vData[((4 * a + 1) * T + tile) * C + c] = t[a][1] + t[a][2];
+                    vData[((4 * a + 2) * T + tile) * C + c] = t[a][2] - t[a][1];
+                    vData[((4 * a + 3) * T + tile) * C + c] = t[a][1] - t[a][3];
                 }
             }
+        }
 
-            (*this)(outputIndexWithinSample, sample) = maxVal;
+        // M = U V, summed over the input channels, for each transform element
+        for (size_t xi = 0; xi < 16; xi++)
+        {
+            CPUMatrix<ElemType> uSlice = u.ColumnSlice(xi * C, C);
+            CPUMatrix<ElemType> vSlice = v.ColumnSlice(xi * T, T);
+            CPUMatrix<ElemType> mSlice = m.ColumnSlice(xi * T, T);
+            CPUMatrix<ElemType>::MultiplyAndWeightedAdd(1, uSlice, false, vSlice, false, 0, mSlice);
+        }
+
+        // Y = A^T M A, for all output channels of a tile at once
+        const ElemType* mData = m.BufferPointer();
+#pragma omp parallel for
+        for (long tile = 0; tile < (long) T; tile++)
+        {
+            const size_t sample = firstSample + tile / tilesPerSample;
+            const size_t tileRow = (tile % tilesPerSample) % tileRows;
+            const size_t tileCol = (tile % tilesPerSample) / tileRows;
+            ElemType* out = output.BufferPointer() + sample * outputDim;
+            const size_t numRows = min((size_t) 2, outputHeight - 2 * tileRow);
+            const size_t numCols = min((size_t) 2, outputWidth - 2 * tileCol);
+            for (size_t k = 0; k < K; k++)
+            {
+                ElemType e[4][4];
+                for (size_t a = 0; a < 4; a++)
+                    for (size_t b = 0; b < 4; b++)
+                        e[a][b] = mData[((4 * a + b) * T + tile) * K + k];
+                ElemType t[2][4]; // A^T M
+                for (size_t b = 0; b < 4; b++)
+                {
+                    t[0][b] = e[0][b] + e[1][b] + e[2][b];
+                    t[1][b] = e[1][b] - e[2][b] - e[3][b];
+                }
+                for (size_t i = 0; i < numRows; i++)
+                {
+                    const ElemType y[2] = {t[i][0] + t[i][1] + t[i][2], t[i][1] - t[i][2] - t[i][3]};
+                    for (size_t j = 0; j < numCols; j++)
+                        out[(2 * tileRow + i + (2 * tileCol + j) * outputHeight) * K + k] = y[j];
+                }
+            }
         }
     }
+}
+
+// this = convolution of each sample (column) of inputBatch with filter, in the layouts of AssignPackedConvolutionInput,
+// i.e. the same result as Multiply(filter, false, packedInput, false, this) reshaped to one column per sample, but
+// without the unrolled input. 3x3 kernels with stride 1 use the Winograd algorithm, all others a direct convolution.
+template <class ElemType>
+CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignConvolutionResult(const CPUMatrix<ElemType>& inputBatch, const CPUMatrix<ElemType>& filter,
+                                                                  const size_t inputWidth, const size_t inputHeight, const size_t inputChannels,
+                                                                  const size_t outputWidth, const size_t outputHeight, const size_t outputChannels,
+                                                                  const size_t kernelWidth, const size_t kernelHeight, const size_t horizontalSubsample, const size_t verticalSubsample,
+                                                                  const bool zeroPadding)
+{
+    if (inputBatch.GetNumRows() != inputWidth * inputHeight * inputChannels)
+        InvalidArgument("AssignConvolutionResult: The input has %d rows instead of %d.", (int) inputBatch.GetNumRows(), (int) (inputWidth * inputHeight * inputChannels));
+    if (filter.GetNumRows() != outputChannels || filter.GetNumCols() != kernelWidth * kernelHeight * inputChannels)
+        InvalidArgument("AssignConvolutionResult: Kernel dimensions and weight matrix dimensions don't match.");
+    if (this == &inputBatch || this == &filter)
+        InvalidArgument("AssignConvolutionResult: The result cannot be an argument.");
+
+    const size_t numSamples = inputBatch.GetNumCols();
+    Resize(outputWidth * outputHeight * outputChannels, numSamples);
+    if (IsEmpty())
+        return *this;
+
+    const long horizontalPad = zeroPadding ? (long) kernelWidth / 2 : 0;
+    const long verticalPad = zeroPadding ? (long) kernelHeight / 2 : 0;
+
+    if (kernelWidth == 3 && kernelHeight == 3 && horizontalSubsample == 1 && verticalSubsample == 1)
+    {
+        WinogradConvolutionHWC3x3(inputBatch, filter, *this,
+                                  inputWidth, inputHeight, inputChannels, outputWidth, outputHeight, outputChannels,
+                                  horizontalPad, verticalPad);
+        return *this;
+    }
 
+    // PACK_ELEM_ROWPOS(channel, posxInKernel, posyInKernel) = (channel * kernelWidth * kernelHeight + posxInKernel + posyInKernel * kernelHeight)
+    const size_t kernelSize = kernelWidth * kernelHeight;
+    std::vector<ElemType> packedFilter(kernelSize * inputChannels * outputChannels);
+    for (size_t c = 0; c < inputChannels; c++)
+        for (size_t pos = 0; pos < kernelSize; pos++)
+            for (size_t k = 0; k < outputChannels; k++)
+                packedFilter[(pos * inputChannels + c) * outputChannels + k] = filter(k, c * kernelSize + pos);
+
+    DirectConvolutionHWC(inputBatch.BufferPointer(), packedFilter.data(), BufferPointer(), numSamples,
+                         inputWidth, inputHeight, inputChannels, outputWidth, outputHeight, outputChannels,
+                         kernelWidth, kernelHeight, horizontalSubsample, verticalSubsample, horizontalPad, verticalPad);
     return *this;
 }
 
+// Grouped convolution, in the layouts of AssignConvolutionResult(): output channel k belongs to group k / outputsPerGroup and
+// only sees the channelsPerGroup input channels of that group, whose filter column for input channel ci of the group is
+// ci * kernelSize + posxInKernel + posyInKernel * kernelHeight. The filter columns are contiguous over the output
+// channels, so the innermost loops run over the channels of a position; for a depthwise convolution (one input and one
+// output channel per group) they are plain element-wise products, which the compiler vectorizes.
+static const size_t convolutionGroupBlock = 16;
+
 template <class ElemType>
-CPUMatrix<ElemType>& CPUMatrix<ElemType>::AddMaxPoolingGradient(const CPUMatrix<ElemType>& outputGradientBatch, const CPUMatrix<ElemType>& inputBatch, const CPUMatrix<ElemType>& outputBatch,
-                                                                const size_t channels,
-                                                                const size_t /*inputWidth*/, const size_t inputHeight, const size_t inputSizePerSample,
-                                                                const size_t outputWidth, const size_t outputHeight, const size_t /*outputSizePerSample*/,
-                                                                const size_t windowWidth, const size_t windowHeight, const size_t horizontalSubsample, const size_t verticalSubsample)
+CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignGroupedConvolutionResult(const CPUMatrix<ElemType>& inputBatch, const CPUMatrix<ElemType>& filter,
+                                                                         const size_t inputWidth, const size_t inputHeight, const size_t inputChannels,
+                                                                         const size_t outputWidth, const size_t outputHeight, const size_t outputChannels,
+                                                                         const size_t kernelWidth, const size_t kernelHeight, const size_t horizontalSubsample, const size_t verticalSubsample,
+                                                                         const bool zeroPadding, const size_t groups)
 {
-    size_t batchSize = inputBatch.GetNumCols();
-    const long inputHeightTimesChannel = (long) (inputHeight * channels);
-    const long outputHeightTimesChannel = (long) (outputHeight * channels);
+    const size_t numSamples = inputBatch.GetNumCols();
+    Resize(outputWidth * outputHeight * outputChannels, numSamples);
 
-// IN_ELEM_ROWPOS(channel, row, col) = (channel + (row + col * inputHeight) * channels)
-// IN_ELEM_COLPOS = sample
+    const long horizontalPad = zeroPadding ? (long) kernelWidth / 2 : 0;
+    const long verticalPad = zeroPadding ? (long) kernelHeight / 2 : 0;
+    const size_t inputDim = inputWidth * inputHeight * inputChannels;
+    const size_t outputDim = outputWidth * outputHeight * outputChannels;
+    const size_t kernelSize = kernelWidth * kernelHeight;
+    const size_t K = outputChannels;
+    const size_t channelsPerGroup = inputChannels / groups;
+    const size_t outputsPerGroup = outputChannels / groups;
 
-// OUT_ELEM_ROWPOS(channel, wrow, wcol) = (channel + (wrow + wcol * outputHeight) * channels)
-// OUT_ELEM_COLPOS = sample
+#pragma omp parallel for
+    for (long sampleCol = 0; sampleCol < (long) (numSamples * outputWidth); sampleCol++)
+    {
+        const size_t sample = sampleCol / outputWidth;
+        const size_t wcol = sampleCol % outputWidth;
+        const ElemType* in = inputBatch.m_pArray + sample * inputDim;
+        for (size_t wrow = 0; wrow < outputHeight; wrow++)
+        {
+            ElemType* out = m_pArray + sample * outputDim + (wrow + wcol * outputHeight) * K;
+            memset(out, 0, sizeof(ElemType) * K);
+            for (size_t posyInKernel = 0; posyInKernel < kernelWidth; posyInKernel++)
+            {
+                const long y = (long) (wcol * horizontalSubsample + posyInKernel) - horizontalPad; // inputCol
+                if (y < 0 || y >= (long) inputWidth)
+                    continue;
+                for (size_t posxInKernel = 0; posxInKernel < kernelHeight; posxInKernel++)
+                {
+                    const long x = (long) (wrow * verticalSubsample + posxInKernel) - verticalPad; // inputRow
+                    if (x < 0 || x >= (long) inputHeight)
+                        continue;
+                    const ElemType* inPos = in + (x + y * inputHeight) * inputChannels;
+                    for (size_t ci = 0; ci < channelsPerGroup; ci++)
+                    {
+                        const ElemType* w = filter.m_pArray + (ci * kernelSize + posxInKernel + posyInKernel * kernelHeight) * K;
+                        if (channelsPerGroup == 1 && outputsPerGroup == 1)
+                        {
+                            for (size_t k = 0; k < K; k++)
+                                out[k] += inPos[k] * w[k];
+                        }
+                        else
+                        {
+                            for (size_t g = 0; g < groups; g++)
+                            {
+                                const ElemType a = inPos[g * channelsPerGroup + ci];
+                                for (size_t k = g * outputsPerGroup; k < (g + 1) * outputsPerGroup; k++)
+                                    out[k] += a * w[k];
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    return *this;
+}
+
+// this += the gradient of AssignGroupedConvolutionResult() w.r.t. its input, in parallel over samples and blocks of groups
+template <class ElemType>
+CPUMatrix<ElemType>& CPUMatrix<ElemType>::AddGroupedConvolutionGradientOfInput(const CPUMatrix<ElemType>& outputGradientBatch, const CPUMatrix<ElemType>& filter,
+                                                                               const size_t inputWidth, const size_t inputHeight, const size_t inputChannels,
+                                                                               const size_t outputWidth, const size_t outputHeight, const size_t outputChannels,
+                                                                               const size_t kernelWidth, const size_t kernelHeight, const size_t horizontalSubsample, const size_t verticalSubsample,
+                                                                               const bool zeroPadding, const size_t groups)
+{
+    const size_t numSamples = GetNumCols();
+    const long horizontalPad = zeroPadding ? (long) kernelWidth / 2 : 0;
+    const long verticalPad = zeroPadding ? (long) kernelHeight / 2 : 0;
+    const size_t inputDim = inputWidth * inputHeight * inputChannels;
+    const size_t outputDim = outputWidth * outputHeight * outputChannels;
+    const size_t kernelSize = kernelWidth * kernelHeight;
+    const size_t K = outputChannels;
+    const size_t channelsPerGroup = inputChannels / groups;
+    const size_t outputsPerGroup = outputChannels / groups;
+    const size_t numGroupBlocks = (groups + convolutionGroupBlock - 1) / convolutionGroupBlock;
 
 #pragma omp parallel for
-    for (long sample = 0; sample < batchSize; sample++)
+    for (long sampleBlock = 0; sampleBlock < (long) (numSamples * numGroupBlocks); sampleBlock++)
     {
-        for (long inputIndexWithinSample = 0; inputIndexWithinSample < inputSizePerSample; inputIndexWithinSample++)
+        const size_t sample = sampleBlock / numGroupBlocks;
+        const size_t g0 = (sampleBlock % numGroupBlocks) * convolutionGroupBlock;
+        const size_t g1 = min(groups, g0 + convolutionGroupBlock);
+        const ElemType* outGrad = outputGradientBatch.m_pArray + sample * outputDim;
+        ElemType* grad = m_pArray + sample * inputDim;
+        for (size_t wcol = 0; wcol < outputWidth; wcol++)
         {
-            const long y = inputIndexWithinSample / inputHeightTimesChannel;   // col in input
-            const long nXC = inputIndexWithinSample % inputHeightTimesChannel; // channel + row*chanels
-            const long x = (long) (nXC / channels);                            // row in input
-            const long c = (long) (nXC % channels);                            // channel
+            for (size_t wrow = 0; wrow < outputHeight; wrow++)
+            {
+                const ElemType* og = outGrad + (wrow + wcol * outputHeight) * K;
+                for (size_t posyInKernel = 0; posyInKernel < kernelWidth; posyInKernel++)
+                {
+                    const long y = (long) (wcol * horizontalSubsample + posyInKernel) - horizontalPad; // inputCol
+                    if (y < 0 || y >= (long) inputWidth)
+                        continue;
+                    for (size_t posxInKernel = 0; posxInKernel < kernelHeight; posxInKernel++)
+                    {
+                        const long x = (long) (wrow * verticalSubsample + posxInKernel) - verticalPad; // inputRow
+                        if (x < 0 || x >= (long) inputHeight)
+                            continue;
+                        ElemType* gradPos = grad + (x + y * inputHeight) * inputChannels;
+                        for (size_t ci = 0; ci < channelsPerGroup; ci++)
+                        {
+                            const ElemType* w = filter.m_pArray + (ci * kernelSize + posxInKernel + posyInKernel * kernelHeight) * K;
+                            if (channelsPerGroup == 1 && outputsPerGroup == 1)
+                            {
+                                for (size_t g = g0; g < g1; g++)
+                                    gradPos[g] += og[g] * w[g];
+                            }
+                            else
+                            {
+                                for (size_t g = g0; g < g1; g++)
+                                {
+                                    ElemType sum = 0;
+                                    for (size_t k = g * outputsPerGroup; k < (g + 1) * outputsPerGroup; k++)
+                                        sum += og[k] * w[k];
+                                    gradPos[g * channelsPerGroup + ci] += sum;
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
 
-            long startOutX = (long) max((ElemType)0, ceil((x - (ElemType) windowHeight + 1) / (ElemType) verticalSubsample));          // inclusive start
-            long endOutX = (long) ((x / verticalSubsample < outputHeight - 1) ? x / verticalSubsample : outputHeight - 1);   // inclusive end
-            long startOutY = (long) max((ElemType)0, ceil((y - (ElemType) windowWidth + 1) / (ElemType) horizontalSubsample));         // inclusive start
-            long endOutY = (long) ((y / horizontalSubsample < outputWidth - 1) ? y / horizontalSubsample : outputWidth - 1); // inclusive end
+    return *this;
+}
 
-            ElemType inputValue = inputBatch(inputIndexWithinSample, sample);
-            for (long outY = startOutY; outY <= endOutY; outY++)
+// this += the gradient of AssignGroupedConvolutionResult() w.r.t. its filter; each thread accumulates its part of the
+// output positions into its own copy of the (small) filter gradient, and the copies are added up at the end
+template <class ElemType>
+CPUMatrix<ElemType>& CPUMatrix<ElemType>::AddGroupedConvolutionGradientOfFilter(const CPUMatrix<ElemType>& outputGradientBatch, const CPUMatrix<ElemType>& inputBatch,
+                                                                                const size_t inputWidth, const size_t inputHeight, const size_t inputChannels,
+                                                                                const size_t outputWidth, const size_t outputHeight, const size_t outputChannels,
+                                                                                const size_t kernelWidth, const size_t kernelHeight, const size_t horizontalSubsample, const size_t verticalSubsample,
+                                                                                const bool zeroPadding, const size_t groups)
+{
+    const size_t numSamples = inputBatch.GetNumCols();
+    const long horizontalPad = zeroPadding ? (long) kernelWidth / 2 : 0;
+    const long verticalPad = zeroPadding ? (long) kernelHeight / 2 : 0;
+    const size_t inputDim = inputWidth * inputHeight * inputChannels;
+    const size_t outputDim = outputWidth * outputHeight * outputChannels;
+    const size_t kernelSize = kernelWidth * kernelHeight;
+    const size_t K = outputChannels;
+    const size_t channelsPerGroup = inputChannels / groups;
+    const size_t outputsPerGroup = outputChannels / groups;
+    const size_t filterSize = GetNumElements();
+
+#pragma omp parallel
+    {
+        std::vector<ElemType> partialGradient(filterSize, 0);
+#pragma omp for
+        for (long sampleCol = 0; sampleCol < (long) (numSamples * outputWidth); sampleCol++)
+        {
+            const size_t sample = sampleCol / outputWidth;
+            const size_t wcol = sampleCol % outputWidth;
+            const ElemType* in = inputBatch.m_pArray + sample * inputDim;
+            for (size_t wrow = 0; wrow < outputHeight; wrow++)
             {
-                for (long outX = startOutX; outX <= endOutX; outX++)
+                const ElemType* og = outputGradientBatch.m_pArray + sample * outputDim + (wrow + wcol * outputHeight) * K;
+                for (size_t posyInKernel = 0; posyInKernel < kernelWidth; posyInKernel++)
                 {
-                    long outputIndex = (long) (outY * outputHeightTimesChannel + outX * channels + c);
-                    if (inputValue == outputBatch(outputIndex, sample))
-                        (*this)(inputIndexWithinSample, sample) += outputGradientBatch(outputIndex, sample);
+                    const long y = (long) (wcol * horizontalSubsample + posyInKernel) - horizontalPad; // inputCol
+                    if (y < 0 || y >= (long) inputWidth)
+                        continue;
+                    for (size_t posxInKernel = 0; posxInKernel < kernelHeight; posxInKernel++)
+                    {
+                        const long x = (long) (wrow * verticalSubsample + posxInKernel) - verticalPad; // inputRow
+                        if (x < 0 || x >= (long) inputHeight)
+                            continue;
+                        const ElemType* inPos = in + (x + y * inputHeight) * inputChannels;
+                        for (size_t ci = 0; ci < channelsPerGroup; ci++)
+                        {
+                            ElemType* w = partialGradient.data() + (ci * kernelSize + posxInKernel + posyInKernel * kernelHeight) * K;
+                            if (channelsPerGroup == 1 && outputsPerGroup == 1)
+                            {
+                                for (size_t k = 0; k < K; k++)
+                                    w[k] += og[k] * inPos[k];
+                            }
+                            else
+                            {
+                                for (size_t g = 0; g < groups; g++)
+                                {
+                                    const ElemType a = inPos[g * channelsPerGroup + ci];
+                                    for (size_t k = g * outputsPerGroup; k < (g + 1) * outputsPerGroup; k++)
+                                        w[k] += og[k] * a;
+                                }
+                            }
+                        }
+                    }
                 }
             }
         }
+#pragma omp critical
+        for (size_t i = 0; i < filterSize; i++)
+            m_pArray[i] += partialGradient[i];
     }
 
     return *this;
 }
+
+// The pooling functions below run over the channels of a position in their innermost loops, which are contiguous in
+// the input and the output, so the compiler can vectorize them:
+// IN_ELEM_ROWPOS(channel, row, col) = (channel + (row + col * inputHeight) * channels)
+// OUT_ELEM_ROWPOS(channel, wrow, wcol) = (channel + (wrow + wcol * outputHeight) * channels)
+// The forward functions parallelize over the output columns of all samples. A window overlaps those of its
+// neighbors, so the gradients are accumulated in parallel over samples and blocks of channels instead.
+static const size_t poolingChannelBlock = 16;
+
+//assume each column is an input sample. Each sample is stored in  (r00, g00, b00, r01, g01, b01, r10, g10, b10, r11, g11, b11)
+// If 'argmax' is given, it receives the input row of the maximum of each output element, for AddMaxPoolingGradient().
 template <class ElemType>
-CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignAveragePoolingResult(const CPUMatrix<ElemType>& inputBatch, const size_t channels,
-                                                                     const size_t /*inputWidth*/, const size_t inputHeight, const size_t /*inputSizePerSample*/,
-                                                                     const size_t /*outputWidth*/, const size_t outputHeight, const size_t outputSizePerSample,
-                                                                     const size_t windowWidth, const size_t windowHeight, const size_t horizontalSubsample, const size_t verticalSubsample)
+CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignMaxPoolingResult(const CPUMatrix<ElemType>& inputBatch, const size_t channels,
+                                                                 const size_t /*inputWidth*/, const size_t inputHeight, const size_t inputSizePerSample,
+                                                                 const size_t outputWidth, const size_t outputHeight, const size_t outputSizePerSample,
+                                                                 const size_t windowWidth, const size_t windowHeight, const size_t horizontalSubsample, const size_t verticalSubsample,
+                                                                 std::vector<int>* argmax)
 {
-    const long inputHeightTimesChannel = (long) (inputHeight * channels);
-    const long outputHeightTimesChannel = (long) (outputHeight * channels);
     const size_t batchSize = inputBatch.GetNumCols();
-    const size_t windowSize = windowWidth * windowHeight;
     Resize(outputSizePerSample, batchSize);
+    if (argmax)
+        argmax->resize(outputSizePerSample * batchSize);
 
-// IN_ELEM_ROWPOS(channel, row, col) = (channel + (row + col * inputHeight) * channels)
-// IN_ELEM_COLPOS = sample
+#pragma omp parallel for
+    for (long sampleCol = 0; sampleCol < (long) (batchSize * outputWidth); sampleCol++)
+    {
+        const size_t sample = sampleCol / outputWidth;
+        const size_t y = sampleCol % outputWidth; // wcol
+        const ElemType* in = inputBatch.m_pArray + sample * inputSizePerSample;
+        for (size_t x = 0; x < outputHeight; x++) // wrow
+        {
+            const size_t outputIndex = (x + y * outputHeight) * channels;
+            ElemType* out = m_pArray + sample * outputSizePerSample + outputIndex;
+            int* outArgmax = argmax ? argmax->data() + sample * outputSizePerSample + outputIndex : nullptr;
+            for (size_t c = 0; c < channels; c++)
+                out[c] = -FLT_MAX;
+            for (size_t colInWindow = 0; colInWindow < windowWidth; colInWindow++)
+            {
+                for (size_t rowInWindow = 0; rowInWindow < windowHeight; rowInWindow++)
+                {
+                    const int inputIndex = (int) ((x * verticalSubsample + rowInWindow + (y * horizontalSubsample + colInWindow) * inputHeight) * channels);
+                    const ElemType* val = in + inputIndex;
+                    if (outArgmax)
+                    {
+                        for (size_t c = 0; c < channels; c++)
+                        {
+                            if (val[c] > out[c] || (colInWindow == 0 && rowInWindow == 0))
+                            {
+                                out[c] = val[c];
+                                outArgmax[c] = inputIndex + (int) c;
+                            }
+                        }
+                    }
+                    else
+                    {
+                        for (size_t c = 0; c < channels; c++)
+                            out[c] = std::max(out[c], val[c]);
+                    }
+                }
+            }
+        }
+    }
 
-// OUT_ELEM_ROWPOS(channel, wrow, wcol) = (channel + (wrow + wcol * outputHeight) * channels)
-// OUT_ELEM_COLPOS = sample
+    return *this;
+}
 
+template <class ElemType>
+CPUMatrix<ElemType>& CPUMatrix<ElemType>::AddMaxPoolingGradient(const CPUMatrix<ElemType>& outputGradientBatch, const CPUMatrix<ElemType>& inputBatch, const CPUMatrix<ElemType>& outputBatch,
+                                                                const size_t channels,
+                                                                const size_t /*inputWidth*/, const size_t inputHeight, const size_t inputSizePerSample,
+                                                                const size_t outputWidth, const size_t outputHeight, const size_t outputSizePerSample,
+                                                                const size_t windowWidth, const size_t windowHeight, const size_t horizontalSubsample, const size_t verticalSubsample)
+{
+    const size_t batchSize = inputBatch.GetNumCols();
+    const size_t numChannelBlocks = (channels + poolingChannelBlock - 1) / poolingChannelBlock;
+
+    // the gradient goes to each input element in the window that equals the maximum
 #pragma omp parallel for
-    for (long sample = 0; sample < batchSize; sample++)
+    for (long sampleBlock = 0; sampleBlock < (long) (batchSize * numChannelBlocks); sampleBlock++)
+    {
+        const size_t sample = sampleBlock / numChannelBlocks;
+        const size_t c0 = (sampleBlock % numChannelBlocks) * poolingChannelBlock;
+        const size_t c1 = min(channels, c0 + poolingChannelBlock);
+        const ElemType* in = inputBatch.m_pArray + sample * inputSizePerSample;
+        const ElemType* out = outputBatch.m_pArray + sample * outputSizePerSample;
+        const ElemType* outGrad = outputGradientBatch.m_pArray + sample * outputSizePerSample;
+        ElemType* grad = m_pArray + sample * inputSizePerSample;
+        for (size_t y = 0; y < outputWidth; y++)
+        {
+            for (size_t x = 0; x < outputHeight; x++)
+            {
+                const size_t outputIndex = (x + y * outputHeight) * channels;
+                for (size_t colInWindow = 0; colInWindow < windowWidth; colInWindow++)
+                {
+                    for (size_t rowInWindow = 0; rowInWindow < windowHeight; rowInWindow++)
+                    {
+                        const size_t inputIndex = (x * verticalSubsample + rowInWindow + (y * horizontalSubsample + colInWindow) * inputHeight) * channels;
+                        for (size_t c = c0; c < c1; c++)
+                        {
+                            if (in[inputIndex + c] == out[outputIndex + c])
+                                grad[inputIndex + c] += outGrad[outputIndex + c];
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    return *this;
+}
+
+// the gradient goes to the maximum recorded by AssignMaxPoolingResult() only
+template <class ElemType>
+CPUMatrix<ElemType>& CPUMatrix<ElemType>::AddMaxPoolingGradientAtArgmax(const CPUMatrix<ElemType>& outputGradientBatch, const std::vector<int>& argmax,
+                                                                        const size_t channels, const size_t inputSizePerSample, const size_t outputSizePerSample)
+{
+    const size_t batchSize = outputGradientBatch.GetNumCols();
+    if (argmax.size() != outputSizePerSample * batchSize || outputGradientBatch.GetNumRows() != outputSizePerSample)
+        InvalidArgument("AddMaxPoolingGradientAtArgmax: The recorded maxima do not match the output gradient.");
+    const size_t numChannelBlocks = (channels + poolingChannelBlock - 1) / poolingChannelBlock;
+
+#pragma omp parallel for
+    for (long sampleBlock = 0; sampleBlock < (long) (batchSize * numChannelBlocks); sampleBlock++)
     {
-        for (long outputIndexWithinSample = 0; outputIndexWithinSample < outputSizePerSample; outputIndexWithinSample++)
+        const size_t sample = sampleBlock / numChannelBlocks;
+        const size_t c0 = (sampleBlock % numChannelBlocks) * poolingChannelBlock;
+        const size_t c1 = min(channels, c0 + poolingChannelBlock);
+        const int* sampleArgmax = argmax.data() + sample * outputSizePerSample;
+        const ElemType* outGrad = outputGradientBatch.m_pArray + sample * outputSizePerSample;
+        ElemType* grad = m_pArray + sample * inputSizePerSample;
+        for (size_t outputIndex = 0; outputIndex < outputSizePerSample; outputIndex += channels)
         {
-            const long y = outputIndexWithinSample / outputHeightTimesChannel;   // wcol
-            const long nXC = outputIndexWithinSample % outputHeightTimesChannel; // channel + wrow*channels
-            const long x = (long) (nXC / channels);                              // wrow
-            const long c = (long) (nXC % channels);                              // channel
+            for (size_t c = c0; c < c1; c++)
+                grad[sampleArgmax[outputIndex + c]] += outGrad[outputIndex + c];
+        }
+    }
 
-            ElemType sum = 0;
-            const long rowInWindowBase = (long) ((x * verticalSubsample + y * horizontalSubsample * inputHeight) * channels + c);
-            for (long colInWindow = 0; colInWindow < windowWidth; colInWindow++)
+    return *this;
+}
+
+template <class ElemType>
+CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignAveragePoolingResult(const CPUMatrix<ElemType>& inputBatch, const size_t channels,
+                                                                     const size_t /*inputWidth*/, const size_t inputHeight, const size_t inputSizePerSample,
+                                                                     const size_t outputWidth, const size_t outputHeight, const size_t outputSizePerSample,
+                                                                     const size_t windowWidth, const size_t windowHeight, const size_t horizontalSubsample, const size_t verticalSubsample)
+{
+    const size_t batchSize = inputBatch.GetNumCols();
+    const ElemType scale = (ElemType) 1 / (ElemType) (windowWidth * windowHeight);
+    Resize(outputSizePerSample, batchSize);
+
+#pragma omp parallel for
+    for (long sampleCol = 0; sampleCol < (long) (batchSize * outputWidth); sampleCol++)
+    {
+        const size_t sample = sampleCol / outputWidth;
+        const size_t y = sampleCol % outputWidth; // wcol
+        const ElemType* in = inputBatch.m_pArray + sample * inputSizePerSample;
+        for (size_t x = 0; x < outputHeight; x++) // wrow
+        {
+            ElemType* out = m_pArray + sample * outputSizePerSample + (x + y * outputHeight) * channels;
+            for (size_t c = 0; c < channels; c++)
+                out[c] = 0;
+            for (size_t colInWindow = 0; colInWindow < windowWidth; colInWindow++)
             {
-                long rowInInput = rowInWindowBase + colInWindow * inputHeightTimesChannel;
-                for (long rowInWindow = 0; rowInWindow < windowHeight; rowInWindow++)
+                for (size_t rowInWindow = 0; rowInWindow < windowHeight; rowInWindow++)
                 {
-                    sum += inputBatch(rowInInput, sample);
-                    rowInInput += (long) channels;
+                    const ElemType* val = in + (x * verticalSubsample + rowInWindow + (y * horizontalSubsample + colInWindow) * inputHeight) * channels;
+                    for (size_t c = 0; c < channels; c++)
+                        out[c] += val[c];
                 }
             }
-
-            (*this)(outputIndexWithinSample, sample) = sum / windowSize;
+            for (size_t c = 0; c < channels; c++)
+                out[c] *= scale;
         }
     }
 
@@ -3971,41 +5068,34 @@ template <class ElemType>
 CPUMatrix<ElemType>& CPUMatrix<ElemType>::AddAveragePoolingGradient(const CPUMatrix<ElemType>& outputGradientBatch,
                                                                     const size_t channels,
                                                                     const size_t /*inputWidth*/, const size_t inputHeight, const size_t inputSizePerSample,
-                                                                    const size_t outputWidth, const size_t outputHeight, const size_t /*outputSizePerSample*/,
+                                                                    const size_t outputWidth, const size_t outputHeight, const size_t outputSizePerSample,
                                                                     const size_t windowWidth, const size_t windowHeight, const size_t horizontalSubsample, const size_t verticalSubsample)
 {
-    size_t batchSize = outputGradientBatch.GetNumCols();
-    const long inputHeightTimesChannel = (long) (inputHeight * channels);
-    const long outputHeightTimesChannel = (long) (outputHeight * channels);
-    const long windowSize = (long) (windowWidth * windowHeight);
-
-// IN_ELEM_ROWPOS(channel, row, col) = (channel + (row + col * inputHeight) * channels)
-// IN_ELEM_COLPOS = sample
-
-// OUT_ELEM_ROWPOS(channel, wrow, wcol) = (channel + (wrow + wcol * outputHeight) * channels)
-// OUT_ELEM_COLPOS = sample
+    const size_t batchSize = outputGradientBatch.GetNumCols();
+    const ElemType scale = (ElemType) 1 / (ElemType) (windowWidth * windowHeight);
+    const size_t numChannelBlocks = (channels + poolingChannelBlock - 1) / poolingChannelBlock;
 
 #pragma omp parallel for
-    for (long sample = 0; sample < batchSize; sample++)
+    for (long sampleBlock = 0; sampleBlock < (long) (batchSize * numChannelBlocks); sampleBlock++)
     {
-        for (long inputIndexWithinSample = 0; inputIndexWithinSample < inputSizePerSample; inputIndexWithinSample++)
+        const size_t sample = sampleBlock / numChannelBlocks;
+        const size_t c0 = (sampleBlock % numChannelBlocks) * poolingChannelBlock;
+        const size_t c1 = min(channels, c0 + poolingChannelBlock);
+        const ElemType* outGrad = outputGradientBatch.m_pArray + sample * outputSizePerSample;
+        ElemType* grad = m_pArray + sample * inputSizePerSample;
+        for (size_t y = 0; y < outputWidth; y++)
         {
-            const long y = inputIndexWithinSample / inputHeightTimesChannel;   // col in input
-            const long nXC = inputIndexWithinSample % inputHeightTimesChannel; // channel + row*chanels
-            const long x = nXC / (long) channels;                              // row in input
-            const long c = nXC % (long) channels;                              // channel
-
-            long startOutX = (long) max((ElemType)0, ceil((x - (ElemType) windowHeight + 1) / (ElemType) verticalSubsample));               // inclusive start
-            long endOutX = (long) ((x / verticalSubsample < outputHeight - 1) ? x / (long) verticalSubsample : outputHeight - 1); // inclusive end
-            long startOutY = (long) max((ElemType)0, ceil((y - (ElemType) windowWidth + 1) / (ElemType) horizontalSubsample));              // inclusive start
-            long endOutY = (long) ((y / horizontalSubsample < outputWidth - 1) ? y / horizontalSubsample : outputWidth - 1);      // inclusive end
-
-            for (long outY = startOutY; outY <= endOutY; outY++)
+            for (size_t x = 0; x < outputHeight; x++)
             {
-                for (long outX = startOutX; outX <= endOutX; outX++)
+                const ElemType* g = outGrad + (x + y * outputHeight) * channels;
+                for (size_t colInWindow = 0; colInWindow < windowWidth; colInWindow++)
                 {
-                    long outputIndex = outY * outputHeightTimesChannel + outX * (long) channels + c;
-                    (*this)(inputIndexWithinSample, sample) += outputGradientBatch(outputIndex, sample) / windowSize;
+                    for (size_t rowInWindow = 0; rowInWindow < windowHeight; rowInWindow++)
+                    {
+                        ElemType* dst = grad + (x * verticalSubsample + rowInWindow + (y * horizontalSubsample + colInWindow) * inputHeight) * channels;
+                        for (size_t c = c0; c < c1; c++)
+                            dst[c] += g[c] * scale;
+                    }
                 }
             }
         }
@@ -4099,6 +5189,11 @@ void CPUMatrix<ElemType>::MultiplyAndWeightedAdd(ElemType alpha, const CPUMatrix
 
     ldc = (int) c.GetNumRows();
 
+    // small products (e.g. those of a recurrence, one time step at a time) skip the BLAS call
+    if (!transposeA && IsSmallGemm(m, n, k) &&
+        TryVectorSmallGemm(m, n, k, alpha, a.m_pArray, lda, b.m_pArray, ldb, transposeB, beta, c.m_pArray, ldc))
+        return;
+
     if (sizeof(ElemType) == sizeof(double))
     {
 #ifdef USE_ACML
@@ -4118,6 +5213,86 @@ void CPUMatrix<ElemType>::MultiplyAndWeightedAdd(ElemType alpha, const CPUMatrix
     }
 }
 
+/// <summary>Batch of matrix-matrix multiplies of the same shape: c[i] = alpha * op(a[i]) * op(b[i]) + beta*c[i] for i = 0..numBatches-1</summary>
+/// <param name="alpha">Scalar</param>
+/// <param name="a">Input matrices, side by side: a[i] is the i-th slice of a.GetNumCols()/numBatches columns</param>
+/// <param name="transposeA">Whether the matrices a[i] are transposed</param>
+/// <param name="b">Input matrices, side by side</param>
+/// <param name="transposeB">Whether the matrices b[i] are transposed</param>
+/// <param name="beta">Scalar</param>
+/// <param name="c">Resulting matrices, side by side</param>
+/// <param name="numBatches">Number of products</param>
+template <class ElemType>
+void CPUMatrix<ElemType>::BatchedMultiplyAndWeightedAdd(ElemType alpha, const CPUMatrix<ElemType>& a, const bool transposeA, const CPUMatrix<ElemType>& b, const bool transposeB,
+                                                        ElemType beta, CPUMatrix<ElemType>& c, size_t numBatches)
+{
+    if (a.IsEmpty() || b.IsEmpty())
+        return;
+    if (numBatches == 0 || a.GetNumCols() % numBatches != 0 || b.GetNumCols() % numBatches != 0)
+        InvalidArgument("CPUMatrix<ElemType>::BatchedMultiplyAndWeightedAdd : The number of columns of a and b must be multiples of the number of batches.");
+
+    size_t aCols = a.GetNumCols() / numBatches;
+    size_t bCols = b.GetNumCols() / numBatches;
+    int m = (int) (transposeA ? aCols : a.GetNumRows());
+    int k = (int) (transposeA ? a.GetNumRows() : aCols);
+    int l = (int) (transposeB ? bCols : b.GetNumRows());
+    int n = (int) (transposeB ? b.GetNumRows() : bCols);
+
+    assert(m > 0 && k > 0 && l > 0 && n > 0); // converting from size_t to int may cause overflow
+    if (k != l)
+        InvalidArgument("CPUMatrix<ElemType>::BatchedMultiplyAndWeightedAdd : The inner dimensions of a and b must match.");
+
+    if (beta == 0)
+        c.Resize(m, n * numBatches);
+    else
+        c.VerifySize(m, n * numBatches); // Can't resize if beta != 0
+
+    // small products: one kernel call per batch, the batches in parallel (the kernel is float only)
+    if (!transposeA && IsSmallGemm(m, n, k) && sizeof(ElemType) == sizeof(float))
+    {
+        const size_t lda = a.GetNumRows(), ldb = b.GetNumRows(), ldc = c.GetNumRows();
+#pragma omp parallel for
+        for (long i = 0; i < (long) numBatches; i++)
+            TryVectorSmallGemm(m, n, k, alpha, a.m_pArray + i * lda * aCols, lda, b.m_pArray + i * ldb * bCols, ldb, transposeB, beta, c.m_pArray + i * ldc * n, ldc);
+        return;
+    }
+
+#if defined(USE_MKL) && INTEL_MKL_VERSION >= 110300
+    // a single call with one group of numBatches products of the same shape
+    CBLAS_TRANSPOSE mklTransA = transposeA ? CblasTrans : CblasNoTrans;
+    CBLAS_TRANSPOSE mklTransB = transposeB ? CblasTrans : CblasNoTrans;
+    MKL_INT mm = m, nn = n, kk = k, groupSize = (MKL_INT) numBatches;
+    MKL_INT lda = (MKL_INT) a.GetNumRows(), ldb = (MKL_INT) b.GetNumRows(), ldc = (MKL_INT) c.GetNumRows();
+    vector<const ElemType*> aBatches(numBatches), bBatches(numBatches);
+    vector<ElemType*> cBatches(numBatches);
+    for (size_t i = 0; i < numBatches; i++)
+    {
+        aBatches[i] = a.m_pArray + i * a.GetNumRows() * aCols;
+        bBatches[i] = b.m_pArray + i * b.GetNumRows() * bCols;
+        cBatches[i] = c.m_pArray + i * c.GetNumRows() * n;
+    }
+    if (sizeof(ElemType) == sizeof(double))
+    {
+        double dalpha = (double) alpha, dbeta = (double) beta;
+        cblas_dgemm_batch(CblasColMajor, &mklTransA, &mklTransB, &mm, &nn, &kk, &dalpha, reinterpret_cast<const double**>(aBatches.data()), &lda,
+                          reinterpret_cast<const double**>(bBatches.data()), &ldb, &dbeta, reinterpret_cast<double**>(cBatches.data()), &ldc, 1, &groupSize);
+    }
+    else
+    {
+        float falpha = (float) alpha, fbeta = (float) beta;
+        cblas_sgemm_batch(CblasColMajor, &mklTransA, &mklTransB, &mm, &nn, &kk, &falpha, reinterpret_cast<const float**>(aBatches.data()), &lda,
+                          reinterpret_cast<const float**>(bBatches.data()), &ldb, &fbeta, reinterpret_cast<float**>(cBatches.data()), &ldc, 1, &groupSize);
+    }
+#else
+    // one GEMM per batch, on column slices (views)
+    for (size_t i = 0; i < numBatches; i++)
+    {
+        auto cBatch = c.ColumnSlice(i * n, n);
+        MultiplyAndWeightedAdd(alpha, a.ColumnSlice(i * aCols, aCols), transposeA, b.ColumnSlice(i * bCols, bCols), transposeB, beta, cBatch);
+    }
+#endif
+}
+
 template <class ElemType>
 void CPUMatrix<ElemType>::Multiply1x1AndWeightedAdd(ElemType alpha, const CPUMatrix<ElemType>& a, const CPUMatrix<ElemType>& b,
                                                     ElemType beta, CPUMatrix<ElemType>& c)
@@ -4135,6 +5310,139 @@ void CPUMatrix<ElemType>::Multiply1x1AndWeightedAdd(ElemType alpha, const CPUMat
             c(i, j) = b(i, j) * f + c(i, j) * beta;
 }
 
+// -----------------------------------------------------------------------
+// dense layer with fused bias and activation
+// -----------------------------------------------------------------------
+
+// c(:, j) = opfn(c(:, j) + bias) for the columns [firstCol, endCol) of a column-major matrix with 'rows' rows
+template <class ElemType, class OPFN>
+static void AddBiasAndApply(ElemType* c, const ElemType* bias, size_t rows, size_t firstCol, size_t endCol, const OPFN& opfn)
+{
+#pragma omp parallel for if ((endCol - firstCol) * rows >= 4096)
+    for (long j = (long) firstCol; j < (long) endCol; j++)
+    {
+        ElemType* col = c + j * rows;
+        for (size_t i = 0; i < rows; i++)
+            col[i] = opfn(col[i] + bias[i]);
+    }
+}
+
+// the same, with the switch over the activation outside of the loops
+template <class ElemType>
+static void AddBiasActivationToColumns(ElemType* c, const ElemType* bias, size_t rows, size_t firstCol, size_t endCol, ElementWiseOperator activation)
+{
+    switch (activation)
+    {
+    case ElementWiseOperator::opLinearRectifier: return AddBiasAndApply(c, bias, rows, firstCol, endCol, [](ElemType z) { return OpLinearRectifier(z); });
+    case ElementWiseOperator::opSigmoid:         return AddBiasAndApply(c, bias, rows, firstCol, endCol, [](ElemType z) { return OpSigmoid(z); });
+    case ElementWiseOperator::opTanh:            return AddBiasAndApply(c, bias, rows, firstCol, endCol, [](ElemType z) { return OpTanh(z); });
+    default:
+        InvalidArgument("AddBiasActivation: Activation %d is not supported, only opLinearRectifier, opSigmoid and opTanh.", (int) activation);
+    }
+}
+
+static void VerifyBiasSize(const char* function, size_t biasElements, size_t rows)
+{
+    if (biasElements != rows)
+        InvalidArgument("%s: The bias has %d elements, but the product has %d rows.", function, (int) biasElements, (int) rows);
+}
+
+// c = activation(op(a) * b + bias)
+// The GEMM is done in blocks of columns that fit into the L2 cache, and bias and activation are applied to each
+// block right after it was computed, while it is still in the cache, instead of in two more passes over c.
+template <class ElemType>
+void CPUMatrix<ElemType>::MultiplyAndAddBiasActivation(const CPUMatrix<ElemType>& a, const bool transposeA, const CPUMatrix<ElemType>& b, const CPUMatrix<ElemType>& bias,
+                                                       ElementWiseOperator activation, CPUMatrix<ElemType>& c)
+{
+    const size_t m = transposeA ? a.GetNumCols() : a.GetNumRows();
+    const size_t n = b.GetNumCols();
+    VerifyBiasSize("MultiplyAndAddBiasActivation", bias.GetNumElements(), m);
+    c.Resize(m, n);
+    if (a.IsEmpty() || b.IsEmpty())
+        return;
+
+    const size_t blockBytes = 256 * 1024;
+    const size_t blockCols = std::max((size_t) 16, blockBytes / (m * sizeof(ElemType)));
+    for (size_t j0 = 0; j0 < n; j0 += blockCols)
+    {
+        const size_t j1 = std::min(n, j0 + blockCols);
+        auto cBlock = c.ColumnSlice(j0, j1 - j0);
+        MultiplyAndWeightedAdd(1, a, transposeA, b.ColumnSlice(j0, j1 - j0), false, 0, cBlock);
+        AddBiasActivationToColumns(c.m_pArray, bias.m_pArray, m, j0, j1, activation);
+    }
+}
+
+// this = activation(this + bias)
+template <class ElemType>
+void CPUMatrix<ElemType>::AddBiasActivation(const CPUMatrix<ElemType>& bias, ElementWiseOperator activation)
+{
+    VerifyBiasSize("AddBiasActivation", bias.GetNumElements(), GetNumRows());
+    AddBiasActivationToColumns(m_pArray, bias.m_pArray, GetNumRows(), 0, GetNumCols(), activation);
+}
+
+// g = outputGradient .* derivative; productGradient = productBeta * productGradient + g; biasGradient = biasBeta * biasGradient + rowsum(g)
+// in one pass, parallel over chunks of rows so that each thread owns the bias elements it sums into
+template <class ElemType, class OPFN>
+static void BackpropBiasAndApply(const ElemType* outputGradient, const ElemType* output, size_t rows, size_t cols,
+                                 ElemType productBeta, ElemType* productGradient, ElemType biasBeta, ElemType* biasGradient, const OPFN& opfn)
+{
+    const size_t chunkRows = 64;
+    const long numChunks = (long) ((rows + chunkRows - 1) / chunkRows);
+#pragma omp parallel for
+    for (long chunk = 0; chunk < numChunks; chunk++)
+    {
+        const size_t i0 = chunk * chunkRows;
+        const size_t i1 = std::min(rows, i0 + chunkRows);
+        ElemType sums[chunkRows] = {0};
+        for (size_t j = 0; j < cols; j++)
+        {
+            const size_t offset = j * rows;
+            for (size_t i = i0; i < i1; i++)
+            {
+                ElemType g = opfn(outputGradient[offset + i], output[offset + i]);
+                productGradient[offset + i] = productBeta == 0 ? g : productBeta * productGradient[offset + i] + g; // (don't read the memory if beta is 0)
+                sums[i - i0] += g;
+            }
+        }
+        for (size_t i = i0; i < i1; i++)
+            biasGradient[i] = biasBeta == 0 ? sums[i - i0] : biasBeta * biasGradient[i] + sums[i - i0];
+    }
+}
+
+template <class ElemType>
+void CPUMatrix<ElemType>::BackpropBiasActivation(const CPUMatrix<ElemType>& outputGradient, const CPUMatrix<ElemType>& output, ElementWiseOperator activation,
+                                                 ElemType productBeta, CPUMatrix<ElemType>& productGradient, ElemType biasBeta, CPUMatrix<ElemType>& biasGradient)
+{
+    const size_t rows = output.GetNumRows(), cols = output.GetNumCols();
+    if (outputGradient.GetNumRows() != rows || outputGradient.GetNumCols() != cols)
+        InvalidArgument("BackpropBiasActivation: The output gradient has a different size than the output.");
+    if (productBeta == 0)
+        productGradient.Resize(rows, cols);
+    else
+        productGradient.VerifySize(rows, cols);
+    if (biasBeta == 0)
+        biasGradient.Resize(rows, 1);
+    else
+        VerifyBiasSize("BackpropBiasActivation", biasGradient.GetNumElements(), rows);
+
+    const ElemType* dy = outputGradient.m_pArray;
+    const ElemType* y = output.m_pArray;
+    switch (activation)
+    {
+    case ElementWiseOperator::opLinearRectifier:
+        return BackpropBiasAndApply(dy, y, rows, cols, productBeta, productGradient.m_pArray, biasBeta, biasGradient.m_pArray,
+                                    [](ElemType g, ElemType v) { return OpElementwiseProductWithLinearRectifierDerivativeFromOutput(g, v); });
+    case ElementWiseOperator::opSigmoid:
+        return BackpropBiasAndApply(dy, y, rows, cols, productBeta, productGradient.m_pArray, biasBeta, biasGradient.m_pArray,
+                                    [](ElemType g, ElemType v) { return OpElementwiseProductWithSigmoidDerivativeFromOutput(g, v); });
+    case ElementWiseOperator::opTanh:
+        return BackpropBiasAndApply(dy, y, rows, cols, productBeta, productGradient.m_pArray, biasBeta, biasGradient.m_pArray,
+                                    [](ElemType g, ElemType v) { return OpElementwiseProductWithTanhDerivativeFromOutput(g, v); });
+    default:
+        InvalidArgument("BackpropBiasActivation: Activation %d is not supported, only opLinearRectifier, opSigmoid and opTanh.", (int) activation);
+    }
+}
+
 /* compute singular value decomposition as
     A = U*SIGMA*VT
     W is used as temp working memory
@@ -4192,107 +5500,572 @@ void CPUMatrix<ElemType>::SVD(const CPUMatrix<ElemType>& A, CPUMatrix<ElemType>&
             reinterpret_cast<float*>(U.m_pArray), (int) ldu, reinterpret_cast<float*>(VT.m_pArray), (int) ldvt, &superb[0]);
 #endif
     }
-
-    if (info > 0)
+
+    if (info > 0)
+    {
+        RuntimeError("The algorithm computing SVD failed to converge.\n");
+    }
+}
+
+/// <summary>Matrix-matrix multiply with col-major matrices (a and b may be transposed): c =  op(a) * op(b) + c</summary>
+/// <param name="a">Input matrix</param>
+/// <param name="transposeA">Whether matrix a is transposed</param>
+/// <param name="b">Input matrix</param>
+/// <param name="transposeB">Whether matrix b is transposed</param>
+/// <param name="c">Resulting matrix, user is responsible for allocating this</param>
+template <class ElemType>
+void CPUMatrix<ElemType>::MultiplyAndAdd(const CPUMatrix<ElemType>& a, const bool transposeA, const CPUMatrix<ElemType>& b, const bool transposeB,
+                                         CPUMatrix<ElemType>& c)
+{
+    return CPUMatrix<ElemType>::MultiplyAndWeightedAdd(1.0, a, transposeA, b, transposeB, 1.0, c);
+}
+template <class ElemType>
+void CPUMatrix<ElemType>::AssignSoftmaxSum(const CPUMatrix<ElemType>& softmax, CPUMatrix<ElemType>& c)
+{
+    ElemType log_likelihood = 0.0;
+    size_t batch_size = this->GetNumCols();
+#pragma omp parallel for reduction(+ : log_likelihood)
+    for (int instance_id = 0; instance_id < batch_size; instance_id++)
+    {
+        int sample = (int) (*this)(0, instance_id);
+        log_likelihood += softmax(instance_id, sample);
+    }
+    c(0, 0) = -log_likelihood;
+}
+
+template <class ElemType>
+void CPUMatrix<ElemType>::AssignNCEUnnormalizedEval(const CPUMatrix<ElemType>& a,
+                                                    const CPUMatrix<ElemType>& b, const CPUMatrix<ElemType>& bias, CPUMatrix<ElemType>& c)
+//this: samples+probs
+// a:   hidden
+// b:   embedding
+// tmp:  softmax
+//  c: loglikelihood
+{
+    ElemType log_likelihood = 0.0;
+    size_t batch_size = this->GetNumCols();
+#pragma omp parallel for reduction(+ : log_likelihood)
+    for (int instance_id = 0; instance_id < batch_size; instance_id++)
+    {
+        int sample = -(int) (*this)(0, instance_id);
+        ElemType score = bias(sample, 0);
+        for (int dim = 0; dim < b.GetNumRows(); dim++)
+            score += b(dim, sample) * a(dim, instance_id);
+        log_likelihood += score;
+    }
+    c(0, 0) = -log_likelihood;
+}
+
+//samples+prob                         gradient           hidden               embedding          embedding/hidden
+//a.m_CPUMatrix->AssignNCEDerivative(*tmp.m_CPUMatrix, *a.m_CPUMatrix, *b.m_CPUMatrix, inputIndex, *c.m_CPUMatrix);
+template <class ElemType>
+CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignNCEDerivative(const CPUMatrix<ElemType>& tmp, const CPUMatrix<ElemType>& a, const CPUMatrix<ElemType>& b, size_t inputIndex, CPUMatrix<ElemType>& c)
+{
+    size_t sample_size = this->GetNumRows() / 2;
+    size_t batch_size = this->GetNumCols();
+    if (inputIndex == 1)
+    {
+#pragma omp parallel for
+        for (int instance_id = 0; instance_id < batch_size; instance_id++)
+            for (int sample_id = 0; sample_id < sample_size; sample_id++)
+            {
+                int sample = (int) (*this)(2 * sample_id, instance_id);
+                for (int dim = 0; dim < b.GetNumRows(); dim++)
+                    c(dim, instance_id) -= b(dim, sample) * tmp(sample_id, instance_id);
+            }
+    }
+    else if (inputIndex == 2)
+    {
+        int i_blocks = omp_get_num_threads() * 16;
+// Assume only one block in k direction.
+// We don't need to explicitly block in the j direction.
+#pragma omp parallel for
+        for (int ib = 0; ib < i_blocks; ib++)
+            for (int instance_id = 0; instance_id < batch_size; instance_id++)
+                for (int sample_id = 0; sample_id < sample_size; sample_id++)
+                {
+                    int sample = (int) (*this)(2 * sample_id, instance_id);
+                    if (sample % i_blocks == ib)
+                        for (int dim = 0; dim < b.GetNumRows(); dim++)
+                            c(dim, sample) -= a(dim, instance_id) * tmp(sample_id, instance_id);
+                }
+    }
+    else
+    {
+        assert(inputIndex == 3);
+        // Assume only one block in k direction.
+        // We don't need to explicitly block in the j direction.
+        for (int instance_id = 0; instance_id < batch_size; instance_id++)
+            for (int sample_id = 0; sample_id < sample_size; sample_id++)
+            {
+                int sample = (int) (*this)(2 * sample_id, instance_id);
+                c(0, sample) -= tmp(sample_id, instance_id);
+            }
+    }
+    return *this;
+}
+
+// this: uniform random values in [0, 1), replaced by the first class k with cdf[k] > value
+template <class ElemType>
+CPUMatrix<ElemType>& CPUMatrix<ElemType>::InplaceSampleFromCDF(const CPUMatrix<ElemType>& cdf)
+{
+    if (cdf.IsEmpty())
+        LogicError("InplaceSampleFromCDF: the distribution is empty.");
+
+    const ElemType* cdfBegin = cdf.m_pArray;
+    const ElemType* cdfEnd = cdf.m_pArray + cdf.GetNumElements();
+    const long n = (long) GetNumElements();
+#pragma omp parallel for
+    for (long i = 0; i < n; i++)
+    {
+        size_t k = std::upper_bound(cdfBegin, cdfEnd, m_pArray[i]) - cdfBegin;
+        m_pArray[i] = (ElemType) std::min(k, cdf.GetNumElements() - 1); // the last class if the cdf falls short of 1 by rounding
+    }
+    return *this;
+}
+
+template <class ElemType>
+CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignSampledSoftmaxLogits(const CPUMatrix<ElemType>& trueLogits, const CPUMatrix<ElemType>& sampledLogits,
+                                                                     const CPUMatrix<ElemType>& candidateBiases, const CPUMatrix<ElemType>& candidateIds)
+{
+    const size_t numSamples = sampledLogits.GetNumRows();
+    const long numCols = (long) sampledLogits.GetNumCols();
+    Resize(numSamples + 1, numCols);
+#pragma omp parallel for
+    for (long t = 0; t < numCols; t++)
+    {
+        const ElemType label = candidateIds.m_pArray[numSamples + t];
+        (*this)(0, t) = trueLogits.m_pArray[t] + candidateBiases.m_pArray[numSamples + t];
+        for (size_t j = 0; j < numSamples; j++)
+            (*this)(j + 1, t) = candidateIds.m_pArray[j] == label ? (ElemType) -1e30 : sampledLogits(j, t) + candidateBiases.m_pArray[j];
+    }
+    return *this;
+}
+
+template <class ElemType>
+CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignAliasSamplesOf(const CPUMatrix<ElemType>& uniforms, const CPUMatrix<ElemType>& aliasProbs, const CPUMatrix<ElemType>& aliases)
+{
+    const size_t numClasses = aliasProbs.GetNumElements();
+    const long n = (long) uniforms.GetNumCols();
+    Resize(1, n);
+#pragma omp parallel for
+    for (long i = 0; i < n; i++)
+    {
+        const size_t k = std::min((size_t)(uniforms(0, i) * numClasses), numClasses - 1);
+        m_pArray[i] = uniforms(1, i) < aliasProbs.m_pArray[k] ? (ElemType) k : aliases.m_pArray[k];
+    }
+    return *this;
+}
+
+// the scores are gathered from the columns of the weights of the label and noise words of each frame; see Matrix<ElemType>::AssignNCELossOf()
+template <class ElemType>
+CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignNCELossOf(const CPUMatrix<ElemType>& labelIds, const CPUMatrix<ElemType>& noiseIds, const CPUMatrix<ElemType>& hidden, const CPUMatrix<ElemType>& weights,
+                                                          const CPUMatrix<ElemType>& bias, const CPUMatrix<ElemType>& logNoiseCounts, CPUMatrix<ElemType>& scoreGradients)
+{
+    const size_t numNoise = noiseIds.GetNumElements();
+    const size_t dim = hidden.GetNumRows();
+    const long numCols = (long) hidden.GetNumCols();
+    Resize(1, numCols);
+    scoreGradients.Resize(numNoise + 1, numCols);
+#pragma omp parallel for
+    for (long t = 0; t < numCols; t++)
+    {
+        const ElemType* h = hidden.m_pArray + t * dim;
+        double loss = 0;
+        for (size_t j = 0; j <= numNoise; j++)
+        {
+            const size_t w = (size_t)(j == 0 ? labelIds.m_pArray[t] : noiseIds.m_pArray[j - 1]);
+            const ElemType* e = weights.m_pArray + w * dim;
+            ElemType s = bias.m_pArray[w] - logNoiseCounts.m_pArray[w];
+            for (size_t d = 0; d < dim; d++)
+                s += h[d] * e[d];
+            // -log sigmoid(s) for the label, -log(1 - sigmoid(s)) for the noise, as softplus(-s) and softplus(s)
+            const ElemType z = j == 0 ? -s : s;
+            loss += std::max(z, (ElemType) 0) + log1p(exp(-fabs(z)));
+            const ElemType sigmoid = 1 / (1 + exp(-s));
+            scoreGradients(j, t) = j == 0 ? sigmoid - 1 : sigmoid;
+        }
+        m_pArray[t] = (ElemType) loss;
+    }
+    return *this;
+}
+
+template <class ElemType>
+CPUMatrix<ElemType>& CPUMatrix<ElemType>::AddNCEHiddenGradientOf(const CPUMatrix<ElemType>& scoreGradients, const CPUMatrix<ElemType>& labelIds, const CPUMatrix<ElemType>& noiseIds,
+                                                                 const CPUMatrix<ElemType>& weights)
+{
+    const size_t numNoise = noiseIds.GetNumElements();
+    const size_t dim = GetNumRows();
+    const long numCols = (long) GetNumCols();
+#pragma omp parallel for
+    for (long t = 0; t < numCols; t++)
+    {
+        ElemType* g = m_pArray + t * dim;
+        for (size_t j = 0; j <= numNoise; j++)
+        {
+            const ElemType scoreGradient = scoreGradients(j, t);
+            if (scoreGradient == 0) // gaps
+                continue;
+            const ElemType* e = weights.m_pArray + (size_t)(j == 0 ? labelIds.m_pArray[t] : noiseIds.m_pArray[j - 1]) * dim;
+            for (size_t d = 0; d < dim; d++)
+                g[d] += scoreGradient * e[d];
+        }
+    }
+    return *this;
+}
+
+template <class ElemType>
+CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignGMMLogLikelihoodOf(const CPUMatrix<ElemType>& logPrior, const CPUMatrix<ElemType>& mean, const CPUMatrix<ElemType>& logStddev, const CPUMatrix<ElemType>& feature,
+                                                                   CPUMatrix<ElemType>& posterior, CPUMatrix<ElemType>& normedDeviation, CPUMatrix<ElemType>& normedDeviationVectors)
+{
+    const size_t numComponents = logPrior.GetNumRows();
+    const size_t featureDim = feature.GetNumRows();
+    const long numSamples = (long) feature.GetNumCols();
+    Resize(1, numSamples);
+    posterior.Resize(numComponents, numSamples);
+    normedDeviation.Resize(numComponents, numSamples);
+    normedDeviationVectors.Resize(numComponents * featureDim, numSamples);
+
+    // parameters with a single column are shared by all samples
+    const size_t priorStride = logPrior.GetNumCols() == 1 ? 0 : numComponents;
+    const size_t meanStride = mean.GetNumCols() == 1 ? 0 : numComponents * featureDim;
+    const size_t stddevStride = logStddev.GetNumCols() == 1 ? 0 : numComponents;
+    const ElemType logNormalizer = (ElemType)(0.5 * featureDim * log(6.283185307179586));
+
+#pragma omp parallel for
+    for (long t = 0; t < numSamples; t++)
+    {
+        const ElemType* x = feature.m_pArray + t * featureDim;
+        ElemType* logLikelihoods = posterior.m_pArray + t * numComponents;
+        ElemType maxLogLikelihood = std::numeric_limits<ElemType>::lowest();
+        for (size_t c = 0; c < numComponents; c++)
+        {
+            const ElemType* mu = mean.m_pArray + t * meanStride + c * featureDim;
+            ElemType* deviation = normedDeviationVectors.m_pArray + (t * numComponents + c) * featureDim;
+            const ElemType logSigma = logStddev.m_pArray[t * stddevStride + c];
+            const ElemType invVariance = exp(-2 * logSigma);
+            ElemType sqrDistance = 0;
+            for (size_t i = 0; i < featureDim; i++)
+            {
+                const ElemType d = x[i] - mu[i];
+                sqrDistance += d * d;
+                deviation[i] = d * invVariance;
+            }
+            normedDeviation.m_pArray[t * numComponents + c] = sqrDistance * invVariance;
+            logLikelihoods[c] = logPrior.m_pArray[t * priorStride + c] - sqrDistance * invVariance / 2 - featureDim * logSigma - logNormalizer;
+            maxLogLikelihood = std::max(maxLogLikelihood, logLikelihoods[c]);
+        }
+        ElemType sum = 0;
+        for (size_t c = 0; c < numComponents; c++)
+            sum += exp(logLikelihoods[c] - maxLogLikelihood);
+        const ElemType logSum = maxLogLikelihood + log(sum);
+        for (size_t c = 0; c < numComponents; c++)
+            logLikelihoods[c] = exp(logLikelihoods[c] - logSum);
+        m_pArray[t] = logSum;
+    }
+    return *this;
+}
+
+template <class ElemType>
+CPUMatrix<ElemType>& CPUMatrix<ElemType>::AddGMMLogLikelihoodGradient(const size_t inputIndex, const CPUMatrix<ElemType>& gradient, const CPUMatrix<ElemType>& logPrior,
+                                                                      const CPUMatrix<ElemType>& posterior, const CPUMatrix<ElemType>& normedDeviation, const CPUMatrix<ElemType>& normedDeviationVectors)
+{
+    const size_t numComponents = posterior.GetNumRows();
+    const size_t featureDim = normedDeviationVectors.GetNumRows() / numComponents;
+    const long numSamples = (long) posterior.GetNumCols();
+    const long numRows = (long) GetNumRows();
+    const size_t priorStride = logPrior.GetNumCols() == 1 ? 0 : numComponents;
+
+    // d logLikelihood(t) / d input(r, t), times gradient(t)
+    auto element = [&](long r, long t) -> ElemType
+    {
+        const ElemType* post = posterior.m_pArray + t * numComponents;
+        const ElemType* deviation = normedDeviationVectors.m_pArray + t * numComponents * featureDim;
+        ElemType value;
+        switch (inputIndex)
+        {
+        case 0: // unnormed prior, through the softmax
+            value = post[r] - exp(logPrior.m_pArray[t * priorStride + r]);
+            break;
+        case 1: // mean
+            value = post[r / featureDim] * deviation[r];
+            break;
+        case 2: // logStddev
+            value = post[r] * (normedDeviation.m_pArray[t * numComponents + r] - featureDim);
+            break;
+        default: // feature
+            value = 0;
+            for (size_t c = 0; c < numComponents; c++)
+                value -= post[c] * deviation[c * featureDim + r];
+        }
+        return gradient.m_pArray[t] * value;
+    };
+
+    if (GetNumCols() == numSamples)
+    {
+#pragma omp parallel for
+        for (long t = 0; t < numSamples; t++)
+            for (long r = 0; r < numRows; r++)
+                (*this)(r, t) += element(r, t);
+    }
+    else // shared parameter: accumulate over all samples
     {
-        RuntimeError("The algorithm computing SVD failed to converge.\n");
+#pragma omp parallel for
+        for (long r = 0; r < numRows; r++)
+        {
+            ElemType sum = 0;
+            for (long t = 0; t < numSamples; t++)
+                sum += element(r, t);
+            m_pArray[r] += sum;
+        }
     }
+    return *this;
 }
 
-/// <summary>Matrix-matrix multiply with col-major matrices (a and b may be transposed): c =  op(a) * op(b) + c</summary>
-/// <param name="a">Input matrix</param>
-/// <param name="transposeA">Whether matrix a is transposed</param>
-/// <param name="b">Input matrix</param>
-/// <param name="transposeB">Whether matrix b is transposed</param>
-/// <param name="c">Resulting matrix, user is responsible for allocating this</param>
-template <class ElemType>
-void CPUMatrix<ElemType>::MultiplyAndAdd(const CPUMatrix<ElemType>& a, const bool transposeA, const CPUMatrix<ElemType>& b, const bool transposeB,
-                                         CPUMatrix<ElemType>& c)
-{
-    return CPUMatrix<ElemType>::MultiplyAndWeightedAdd(1.0, a, transposeA, b, transposeB, 1.0, c);
-}
 template <class ElemType>
-void CPUMatrix<ElemType>::AssignSoftmaxSum(const CPUMatrix<ElemType>& softmax, CPUMatrix<ElemType>& c)
+CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignCrossEntropyWithSoftmaxOf(const CPUMatrix<ElemType>& labels, const CPUMatrix<ElemType>& logits, CPUMatrix<ElemType>& logSumExp)
 {
-    ElemType log_likelihood = 0.0;
-    size_t batch_size = this->GetNumCols();
-#pragma omp parallel for reduction(+ : log_likelihood)
-    for (int instance_id = 0; instance_id < batch_size; instance_id++)
+    const size_t numRows = logits.GetNumRows();
+    const long numCols = (long) logits.GetNumCols();
+    logSumExp.Resize(1, numCols);
+
+    double criterion = 0;
+#pragma omp parallel for reduction(+ : criterion)
+    for (long t = 0; t < numCols; t++)
     {
-        int sample = (int) (*this)(0, instance_id);
-        log_likelihood += softmax(instance_id, sample);
+        const ElemType* x = logits.m_pArray + t * numRows;
+        const ElemType* y = labels.m_pArray + t * numRows;
+        // running maximum: the sum is rescaled whenever a larger value comes along
+        ElemType maxValue = numRows > 0 ? x[0] : 0;
+        ElemType sum = 0;
+        ElemType labelDot = 0;
+        ElemType labelSum = 0;
+        for (size_t i = 0; i < numRows; i++)
+        {
+            if (x[i] > maxValue)
+            {
+                sum *= exp(maxValue - x[i]);
+                maxValue = x[i];
+            }
+            sum += exp(x[i] - maxValue);
+            if (y[i] != 0)
+            {
+                labelDot += y[i] * x[i];
+                labelSum += y[i];
+            }
+        }
+        const ElemType lse = maxValue + log(sum);
+        logSumExp.m_pArray[t] = lse;
+        if (labelSum != 0)
+            criterion += labelSum * lse - labelDot;
     }
-    c(0, 0) = -log_likelihood;
+    Resize(1, 1);
+    m_pArray[0] = (ElemType) criterion;
+    return *this;
 }
 
 template <class ElemType>
-void CPUMatrix<ElemType>::AssignNCEUnnormalizedEval(const CPUMatrix<ElemType>& a,
-                                                    const CPUMatrix<ElemType>& b, const CPUMatrix<ElemType>& bias, CPUMatrix<ElemType>& c)
-//this: samples+probs
-// a:   hidden
-// b:   embedding
-// tmp:  softmax
-//  c: loglikelihood
+CPUMatrix<ElemType>& CPUMatrix<ElemType>::AddCrossEntropyWithSoftmaxGradient(const size_t inputIndex, const CPUMatrix<ElemType>& gradient, const CPUMatrix<ElemType>& labels,
+                                                                             const CPUMatrix<ElemType>& logits, const CPUMatrix<ElemType>& logSumExp)
 {
-    ElemType log_likelihood = 0.0;
-    size_t batch_size = this->GetNumCols();
-#pragma omp parallel for reduction(+ : log_likelihood)
-    for (int instance_id = 0; instance_id < batch_size; instance_id++)
+    const size_t numRows = logits.GetNumRows();
+    const long numCols = (long) logits.GetNumCols();
+    const ElemType g = gradient.m_pArray[0];
+#pragma omp parallel for
+    for (long t = 0; t < numCols; t++)
     {
-        int sample = -(int) (*this)(0, instance_id);
-        ElemType score = bias(sample, 0);
-        for (int dim = 0; dim < b.GetNumRows(); dim++)
-            score += b(dim, sample) * a(dim, instance_id);
-        log_likelihood += score;
+        const ElemType* x = logits.m_pArray + t * numRows;
+        const ElemType* y = labels.m_pArray + t * numRows;
+        ElemType* us = m_pArray + t * numRows;
+        const ElemType lse = logSumExp.m_pArray[t];
+        if (inputIndex == 0) // labels: -log softmax
+        {
+            for (size_t i = 0; i < numRows; i++)
+                us[i] -= g * (x[i] - lse);
+        }
+        else // logits: softmax - labels
+        {
+            for (size_t i = 0; i < numRows; i++)
+                us[i] += g * (exp(x[i] - lse) - y[i]);
+        }
     }
-    c(0, 0) = -log_likelihood;
+    return *this;
 }
 
-//samples+prob                         gradient           hidden               embedding          embedding/hidden
-//a.m_CPUMatrix->AssignNCEDerivative(*tmp.m_CPUMatrix, *a.m_CPUMatrix, *b.m_CPUMatrix, inputIndex, *c.m_CPUMatrix);
 template <class ElemType>
-CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignNCEDerivative(const CPUMatrix<ElemType>& tmp, const CPUMatrix<ElemType>& a, const CPUMatrix<ElemType>& b, size_t inputIndex, CPUMatrix<ElemType>& c)
+CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignViterbiPathOf(const CPUMatrix<ElemType>& posScores, const CPUMatrix<ElemType>& pairScores, const CPUMatrix<ElemType>& sequences, const size_t numParallelSequences,
+                                                              const int startLabel, const int endLabel, CPUMatrix<ElemType>& alpha, CPUMatrix<ElemType>& backtrace)
 {
-    size_t sample_size = this->GetNumRows() / 2;
-    size_t batch_size = this->GetNumCols();
-    if (inputIndex == 1)
+    const long numLabels = (long) posScores.GetNumRows();
+    const size_t numCols = posScores.GetNumCols();
+    Resize(numLabels, numCols);
+    SetValue(0);
+    alpha.Resize(numLabels, numCols);
+    backtrace.Resize(numLabels, numCols);
+
+    const long numSequences = (long) sequences.GetNumCols();
+#pragma omp parallel for schedule(dynamic)
+    for (long n = 0; n < numSequences; n++)
     {
-#pragma omp parallel for
-        for (int instance_id = 0; instance_id < batch_size; instance_id++)
-            for (int sample_id = 0; sample_id < sample_size; sample_id++)
+        const size_t s = (size_t) sequences(0, n);
+        const size_t tBegin = (size_t) sequences(1, n);
+        const size_t tEnd = (size_t) sequences(2, n);
+        for (size_t t = tBegin; t < tEnd; t++)
+        {
+            const size_t col = t * numParallelSequences + s;
+            for (long k = 0; k < numLabels; k++)
             {
-                int sample = (int) (*this)(2 * sample_id, instance_id);
-                for (int dim = 0; dim < b.GetNumRows(); dim++)
-                    c(dim, instance_id) -= b(dim, sample) * tmp(sample_id, instance_id);
+                ElemType best = (ElemType) LZERO;
+                long bestLabel = 0;
+                if (t == tBegin)
+                {
+                    bestLabel = startLabel < 0 ? k : startLabel;
+                    if (bestLabel == k)
+                        best = 0;
+                }
+                else
+                {
+                    for (long j = 0; j < numLabels; j++)
+                    {
+                        const ElemType score = alpha(j, col - numParallelSequences) + pairScores(k, j);
+                        if (score > best)
+                        {
+                            best = score;
+                            bestLabel = j;
+                        }
+                    }
+                }
+                alpha(k, col) = best + posScores(k, col);
+                backtrace(k, col) = (ElemType) bestLabel;
             }
+        }
+        if (tEnd <= tBegin)
+            continue;
+
+        // trace the best path back from the last frame
+        size_t col = (tEnd - 1) * numParallelSequences + s;
+        long label = endLabel;
+        if (label < 0)
+        {
+            label = 0;
+            for (long k = 1; k < numLabels; k++)
+                if (alpha(k, col) > alpha(label, col))
+                    label = k;
+        }
+        (*this)(label, col) = 1;
+        for (size_t t = tEnd - 1; t > tBegin; t--, col -= numParallelSequences)
+        {
+            label = (long) backtrace(label, col);
+            (*this)(label, col - numParallelSequences) = 1;
+        }
     }
-    else if (inputIndex == 2)
+    return *this;
+}
+
+template <class ElemType>
+CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignClassBasedCrossEntropyWithSoftmaxOf(const CPUMatrix<ElemType>& labels, const CPUMatrix<ElemType>& input, const CPUMatrix<ElemType>& weight,
+                                                                                    const CPUMatrix<ElemType>& classLogSoftmax, const CPUMatrix<ElemType>& /*buckets*/, const CPUMatrix<ElemType>& frames,
+                                                                                    const size_t maxClassSize, CPUMatrix<ElemType>& softmax)
+{
+    const size_t dim = input.GetNumRows();
+    softmax.Resize(maxClassSize, labels.GetNumCols());
+
+    // the frames are sorted by class, so that consecutive frames of a thread share the weights of their class
+    const long numFrames = (long) frames.GetNumCols();
+    double criterion = 0;
+#pragma omp parallel for reduction(+ : criterion)
+    for (long n = 0; n < numFrames; n++)
+    {
+        const size_t t = (size_t) frames.m_pArray[n];
+        const size_t wordBegin = (size_t) labels(2, t);
+        const size_t numWords = (size_t) labels(3, t) - wordBegin;
+        const ElemType* x = input.m_pArray + t * dim;
+        ElemType* y = softmax.m_pArray + t * maxClassSize;
+        ElemType maxValue = 0;
+        for (size_t k = 0; k < numWords; k++)
+        {
+            const ElemType* w = weight.m_pArray + (wordBegin + k) * dim;
+            ElemType logit = 0;
+            for (size_t d = 0; d < dim; d++)
+                logit += w[d] * x[d];
+            y[k] = logit;
+            if (k == 0 || logit > maxValue)
+                maxValue = logit;
+        }
+        const ElemType wordLogit = y[(size_t) labels(0, t) - wordBegin];
+        ElemType sum = 0;
+        for (size_t k = 0; k < numWords; k++)
+            sum += y[k] = exp(y[k] - maxValue);
+        criterion -= wordLogit - maxValue - log(sum) + classLogSoftmax((size_t) labels(1, t), t);
+        for (size_t k = 0; k < numWords; k++)
+            y[k] /= sum;
+    }
+    Resize(1, 1);
+    m_pArray[0] = (ElemType) criterion;
+    return *this;
+}
+
+template <class ElemType>
+CPUMatrix<ElemType>& CPUMatrix<ElemType>::AddClassBasedCrossEntropyWithSoftmaxGradient(const size_t inputIndex, const CPUMatrix<ElemType>& gradient, const CPUMatrix<ElemType>& labels,
+                                                                                       const CPUMatrix<ElemType>& input, const CPUMatrix<ElemType>& weight, const CPUMatrix<ElemType>& classLogSoftmax,
+                                                                                       const CPUMatrix<ElemType>& buckets, const CPUMatrix<ElemType>& frames, const CPUMatrix<ElemType>& softmax)
+{
+    const size_t dim = input.GetNumRows();
+    const size_t maxClassSize = softmax.GetNumRows();
+    const ElemType g = gradient.m_pArray[0];
+    if (inputIndex == 2) // weight: the classes own disjoint word ranges, so each bucket is one thread's
     {
-        int i_blocks = omp_get_num_threads() * 16;
-// Assume only one block in k direction.
-// We don't need to explicitly block in the j direction.
-#pragma omp parallel for
-        for (int ib = 0; ib < i_blocks; ib++)
-            for (int instance_id = 0; instance_id < batch_size; instance_id++)
-                for (int sample_id = 0; sample_id < sample_size; sample_id++)
+        const long numBuckets = (long) buckets.GetNumCols();
+#pragma omp parallel for schedule(dynamic)
+        for (long b = 0; b < numBuckets; b++)
+        {
+            const size_t wordBegin = (size_t) buckets(0, b);
+            const size_t numWords = (size_t) buckets(1, b) - wordBegin;
+            for (size_t n = (size_t) buckets(2, b); n < (size_t) buckets(3, b); n++)
+            {
+                const size_t t = (size_t) frames.m_pArray[n];
+                const size_t word = (size_t) labels(0, t) - wordBegin;
+                const ElemType* x = input.m_pArray + t * dim;
+                const ElemType* y = softmax.m_pArray + t * maxClassSize;
+                for (size_t k = 0; k < numWords; k++)
                 {
-                    int sample = (int) (*this)(2 * sample_id, instance_id);
-                    if (sample % i_blocks == ib)
-                        for (int dim = 0; dim < b.GetNumRows(); dim++)
-                            c(dim, sample) -= a(dim, instance_id) * tmp(sample_id, instance_id);
+                    const ElemType gk = g * (y[k] - (k == word ? 1 : 0));
+                    ElemType* us = m_pArray + (wordBegin + k) * dim;
+                    for (size_t d = 0; d < dim; d++)
+                        us[d] += gk * x[d];
                 }
+            }
+        }
+        return *this;
     }
-    else
+
+    const long numFrames = (long) frames.GetNumCols();
+#pragma omp parallel for
+    for (long n = 0; n < numFrames; n++)
     {
-        assert(inputIndex == 3);
-        // Assume only one block in k direction.
-        // We don't need to explicitly block in the j direction.
-        for (int instance_id = 0; instance_id < batch_size; instance_id++)
-            for (int sample_id = 0; sample_id < sample_size; sample_id++)
+        const size_t t = (size_t) frames.m_pArray[n];
+        if (inputIndex == 1) // input: the weights of the class, weighted by softmax - labels
+        {
+            const size_t wordBegin = (size_t) labels(2, t);
+            const size_t numWords = (size_t) labels(3, t) - wordBegin;
+            const size_t word = (size_t) labels(0, t) - wordBegin;
+            const ElemType* y = softmax.m_pArray + t * maxClassSize;
+            ElemType* us = m_pArray + t * dim;
+            for (size_t k = 0; k < numWords; k++)
             {
-                int sample = (int) (*this)(2 * sample_id, instance_id);
-                c(0, sample) -= tmp(sample_id, instance_id);
+                const ElemType gk = g * (y[k] - (k == word ? 1 : 0));
+                const ElemType* w = weight.m_pArray + (wordBegin + k) * dim;
+                for (size_t d = 0; d < dim; d++)
+                    us[d] += gk * w[d];
             }
+        }
+        else // class logits: class softmax - labels
+        {
+            const size_t numClasses = classLogSoftmax.GetNumRows();
+            const size_t cls = (size_t) labels(1, t);
+            for (size_t c = 0; c < numClasses; c++)
+                (*this)(c, t) += g * (exp(classLogSoftmax(c, t)) - (c == cls ? 1 : 0));
+        }
     }
     return *this;
 }
@@ -5129,6 +6902,155 @@ void CPUMatrix<ElemType>::InnerProductWithShiftNeg(const CPUMatrix<ElemType>& a,
     }
 }
 
+// this(m,j) = cos(a(:,j), b(:,s)) with s = j in row 0 and s = (j + shift + m - 1) % n in the negNumber rows below,
+// in one pass over the columns; also sets the inverse column norms of a and b, which the gradient reuses
+template <class ElemType>
+CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignCosDistanceWithShiftNegOf(const CPUMatrix<ElemType>& a, const CPUMatrix<ElemType>& b, size_t shift, size_t negNumber,
+                                                                          CPUMatrix<ElemType>& invNormA, CPUMatrix<ElemType>& invNormB)
+{
+    if (a.GetNumRows() != b.GetNumRows() || a.GetNumCols() != b.GetNumCols())
+        InvalidArgument("AssignCosDistanceWithShiftNegOf: Matrices a and b should have the same dimensions.");
+
+    const long rows = (long) a.GetNumRows();
+    const long n = (long) a.GetNumCols();
+    Resize(negNumber + 1, n);
+    invNormA.Resize(1, n);
+    invNormB.Resize(1, n);
+
+#pragma omp parallel for
+    for (long j = 0; j < n; j++)
+    {
+        const ElemType* pa = a.m_pArray + a.LocateColumn(j);
+        const ElemType* pb = b.m_pArray + b.LocateColumn(j);
+        ElemType sumA = 0, sumB = 0;
+        for (long i = 0; i < rows; i++)
+        {
+            sumA += pa[i] * pa[i];
+            sumB += pb[i] * pb[i];
+        }
+        invNormA(0, j) = 1 / sqrt(sumA);
+        invNormB(0, j) = 1 / sqrt(sumB);
+    }
+
+    auto& us = *this;
+#pragma omp parallel for
+    for (long j = 0; j < n; j++)
+    {
+        const ElemType* pa = a.m_pArray + a.LocateColumn(j);
+        for (long m = 0; m <= (long) negNumber; m++)
+        {
+            const long s = m == 0 ? j : (long) ((j + shift + m - 1) % n);
+            const ElemType* pb = b.m_pArray + b.LocateColumn(s);
+            ElemType dot = 0;
+            for (long i = 0; i < rows; i++)
+                dot += pa[i] * pb[i];
+            us(m, j) = dot * invNormA(0, j) * invNormB(0, s);
+        }
+    }
+    return *this;
+}
+
+// this += the gradient of value = AssignCosDistanceWithShiftNegOf(a, b, shift, ...) w.r.t. a, or w.r.t. b if rightInput;
+// each column of the result collects its negNumber + 1 pairs, so the columns are independent
+template <class ElemType>
+CPUMatrix<ElemType>& CPUMatrix<ElemType>::AddCosDistanceWithShiftNegGradientOf(const CPUMatrix<ElemType>& gradient, const CPUMatrix<ElemType>& value,
+                                                                               const CPUMatrix<ElemType>& a, const CPUMatrix<ElemType>& b,
+                                                                               const CPUMatrix<ElemType>& invNormA, const CPUMatrix<ElemType>& invNormB, size_t shift, bool rightInput)
+{
+    const long rows = (long) a.GetNumRows();
+    const long n = (long) a.GetNumCols();
+    const long numPairs = (long) value.GetNumRows();
+    if (GetNumRows() != rows || GetNumCols() != n || gradient.GetNumRows() != numPairs || gradient.GetNumCols() != n)
+        InvalidArgument("AddCosDistanceWithShiftNegGradientOf: The dimensions of the gradient, the value, and the target do not match.");
+
+    auto& us = *this;
+#pragma omp parallel for
+    for (long k = 0; k < n; k++)
+    {
+        // d cos(x, y) / dx = y / (|x| |y|) - cos(x, y) x / |x|^2, with x = this input's column k and y its partner in pair m
+        const CPUMatrix<ElemType>& input = rightInput ? b : a;
+        const ElemType* x = input.m_pArray + input.LocateColumn(k);
+        const ElemType invNormX = (rightInput ? invNormB : invNormA)(0, k);
+        ElemType* out = us.m_pArray + LocateColumn(k);
+        ElemType selfWeight = 0;
+        for (long m = 0; m < numPairs; m++)
+        {
+            const long d = m == 0 ? 0 : (long) ((shift + m - 1) % n);
+            const long j = rightInput ? (k + n - d) % n : k; // the column of a and of the output
+            const long s = rightInput ? k : (k + d) % n;     // the column of b
+            const ElemType g = gradient(m, j);
+            const ElemType* y = rightInput ? a.m_pArray + a.LocateColumn(j) : b.m_pArray + b.LocateColumn(s);
+            const ElemType yWeight = g * invNormA(0, j) * invNormB(0, s);
+            selfWeight += g * value(m, j) * invNormX * invNormX;
+            for (long i = 0; i < rows; i++)
+                out[i] += yWeight * y[i];
+        }
+        for (long i = 0; i < rows; i++)
+            out[i] -= selfWeight * x[i];
+    }
+    return *this;
+}
+
+// Each column of staged is an HWC image of stagingWidth x stagingHeight x channels, followed by the crop x and y offset,
+// width and height in staging pixels and a horizontal flip flag. this(:,j) = the crop of column j bilinearly scaled
+// (with pixel centers at +0.5) to width x height, flipped if requested, minus mean (HWC, unless empty), in HWC or CHW.
+template <class ElemType>
+CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignAugmentedImagesOf(const CPUMatrix<ElemType>& staged, const CPUMatrix<ElemType>& mean, size_t stagingWidth, size_t stagingHeight,
+                                                                  size_t channels, size_t width, size_t height, bool transposeToCHW)
+{
+    const long stagingSize = (long) (stagingWidth * stagingHeight * channels);
+    const long outputSize = (long) (width * height * channels);
+    if (staged.GetNumRows() != stagingSize + 5)
+        InvalidArgument("AssignAugmentedImagesOf: The staged images have %d rows, %d expected.", (int) staged.GetNumRows(), (int) stagingSize + 5);
+    if (!mean.IsEmpty() && mean.GetNumElements() != outputSize)
+        InvalidArgument("AssignAugmentedImagesOf: The mean has %d elements, %d expected.", (int) mean.GetNumElements(), (int) outputSize);
+
+    const long n = (long) staged.GetNumCols();
+    Resize(outputSize, n);
+    const long sw = (long) stagingWidth;
+    const long sh = (long) stagingHeight;
+    const long C = (long) channels;
+    const long W = (long) width;
+    const long H = (long) height;
+    const ElemType* meanImage = mean.IsEmpty() ? nullptr : mean.m_pArray + mean.LocateColumn(0);
+
+#pragma omp parallel for
+    for (long j = 0; j < n; j++)
+    {
+        const ElemType* image = staged.m_pArray + staged.LocateColumn(j);
+        const ElemType* crop = image + stagingSize;
+        const bool flip = crop[4] != 0;
+        ElemType* out = m_pArray + LocateColumn(j);
+        for (long y = 0; y < H; y++)
+        {
+            ElemType v = crop[1] + (y + (ElemType) 0.5) * crop[3] / H - (ElemType) 0.5;
+            v = std::min(std::max(v, (ElemType) 0), (ElemType) (sh - 1));
+            const long v0 = (long) v;
+            const long v1 = std::min(v0 + 1, sh - 1);
+            const ElemType fv = v - v0;
+            for (long x = 0; x < W; x++)
+            {
+                const long xs = flip ? W - 1 - x : x;
+                ElemType u = crop[0] + (xs + (ElemType) 0.5) * crop[2] / W - (ElemType) 0.5;
+                u = std::min(std::max(u, (ElemType) 0), (ElemType) (sw - 1));
+                const long u0 = (long) u;
+                const long u1 = std::min(u0 + 1, sw - 1);
+                const ElemType fu = u - u0;
+                for (long c = 0; c < C; c++)
+                {
+                    ElemType value = (1 - fv) * ((1 - fu) * image[(v0 * sw + u0) * C + c] + fu * image[(v0 * sw + u1) * C + c]) +
+                                     fv * ((1 - fu) * image[(v1 * sw + u0) * C + c] + fu * image[(v1 * sw + u1) * C + c]);
+                    const long hwc = (y * W + x) * C + c;
+                    if (meanImage)
+                        value -= meanImage[hwc];
+                    out[transposeToCHW ? (c * H + y) * W + x : hwc] = value;
+                }
+            }
+        }
+    }
+    return *this;
+}
+
 template <class ElemType>
 CPUMatrix<ElemType>& CPUMatrix<ElemType>::GetARowByIndex(const CPUMatrix<ElemType>& a, size_t index)
 {
@@ -5478,6 +7400,108 @@ void CPUMatrix<ElemType>::_rcrfTransGrdCompute(size_t i,
         }
     }
 };
+
+// CTC forward-backward of one sequence, in log space. States are q = 0..numStates-1 with labels blank, l_1, blank, ..., l_L, blank;
+// a path stays in its state, moves to the next one, or skips a blank between two different labels. alpha includes the frame's
+// log-probability, beta does not, so that alpha + beta is the log-probability of the paths through the state.
+template <class ElemType>
+static ElemType CTCForwardBackward(const ElemType* logProbs, size_t numLabels, size_t columnStride, size_t numFrames,
+                                   const ElemType* labels, size_t numStates, ElemType* alpha, ElemType* beta, size_t alphaStride)
+{
+    for (size_t t = 0; t < numFrames; t++)
+    {
+        const ElemType* y = logProbs + t * columnStride;
+        ElemType* a = alpha + t * alphaStride;
+        for (size_t q = 0; q < numStates; q++)
+        {
+            ElemType v;
+            if (t == 0)
+                v = q < 2 ? 0 : (ElemType) LZERO;
+            else
+            {
+                const ElemType* prev = a - alphaStride;
+                v = prev[q];
+                if (q >= 1)
+                    v = LogAdd(v, prev[q - 1]);
+                if (q >= 2 && q % 2 == 1 && labels[q] != labels[q - 2])
+                    v = LogAdd(v, prev[q - 2]);
+            }
+            a[q] = v + y[(size_t) labels[q]];
+        }
+    }
+    for (size_t t = numFrames; t-- > 0;)
+    {
+        ElemType* b = beta + t * alphaStride;
+        for (size_t q = 0; q < numStates; q++)
+        {
+            ElemType v;
+            if (t + 1 == numFrames)
+                v = q + 2 >= numStates ? 0 : (ElemType) LZERO;
+            else
+            {
+                const ElemType* y = logProbs + (t + 1) * columnStride;
+                const ElemType* next = b + alphaStride;
+                v = next[q] + y[(size_t) labels[q]];
+                if (q + 1 < numStates)
+                    v = LogAdd(v, next[q + 1] + y[(size_t) labels[q + 1]]);
+                if (q + 2 < numStates && q % 2 == 1 && labels[q] != labels[q + 2])
+                    v = LogAdd(v, next[q + 2] + y[(size_t) labels[q + 2]]);
+            }
+            b[q] = v;
+        }
+    }
+    const ElemType* last = alpha + (numFrames - 1) * alphaStride;
+    return numStates >= 2 ? LogAdd(last[numStates - 1], last[numStates - 2]) : last[0];
+}
+
+template <class ElemType>
+CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignCTCPosteriors(const CPUMatrix<ElemType>& logProbs, const CPUMatrix<ElemType>& stateLabels, const CPUMatrix<ElemType>& sequences,
+                                                              size_t numParallelSequences, CPUMatrix<ElemType>& alpha, CPUMatrix<ElemType>& beta, CPUMatrix<ElemType>& logLikelihoods)
+{
+    const size_t numLabels = logProbs.GetNumRows();
+    const size_t numSequences = sequences.GetNumCols();
+    const size_t maxStates = stateLabels.GetNumRows();
+    if (numParallelSequences == 0 || logProbs.GetNumCols() % numParallelSequences != 0 || sequences.GetNumRows() != 4 || stateLabels.GetNumCols() != numSequences)
+        InvalidArgument("AssignCTCPosteriors: The dimensions of the inputs do not match.");
+    const size_t numTimeSteps = logProbs.GetNumCols() / numParallelSequences;
+
+    Resize(numLabels, logProbs.GetNumCols());
+    SetValue(0);
+    alpha.Resize(maxStates, numSequences * numTimeSteps);
+    beta.Resize(maxStates, numSequences * numTimeSteps);
+    logLikelihoods.Resize(1, numSequences);
+
+    // the sequences of a parallel sequence have disjoint columns, so that each sequence can write its own posteriors
+#pragma omp parallel for schedule(dynamic, 1)
+    for (long n = 0; n < (long) numSequences; n++)
+    {
+        const size_t s = (size_t) sequences(0, n), tBegin = (size_t) sequences(1, n), numFrames = (size_t) sequences(2, n), numStates = (size_t) sequences(3, n);
+        if (s >= numParallelSequences || tBegin + numFrames > numTimeSteps || numFrames == 0 || numStates == 0 || numStates > maxStates)
+            InvalidArgument("AssignCTCPosteriors: Sequence %d is out of bounds.", (int) n);
+        const size_t firstColumn = tBegin * numParallelSequences + s;
+        const size_t columnStride = numParallelSequences * numLabels;
+        const ElemType* labels = stateLabels.m_pArray + n * maxStates;
+        ElemType* a = alpha.m_pArray + n * numTimeSteps * maxStates;
+        ElemType* b = beta.m_pArray + n * numTimeSteps * maxStates;
+        ElemType logZ = CTCForwardBackward(logProbs.m_pArray + firstColumn * numLabels, numLabels, columnStride, numFrames, labels, numStates, a, b, maxStates);
+
+        for (size_t t = 0; t < numFrames; t++)
+        {
+            const size_t j = firstColumn + t * numParallelSequences;
+            if (logZ < (ElemType) LSMALL) // too few frames for the labels: the posteriors are the softmax, i.e. no gradient
+            {
+                for (size_t k = 0; k < numLabels; k++)
+                    (*this)(k, j) = exp(logProbs(k, j));
+                continue;
+            }
+            for (size_t q = 0; q < numStates; q++)
+                (*this)((size_t) labels[q], j) += exp(a[t * maxStates + q] + b[t * maxStates + q] - logZ);
+        }
+        logLikelihoods(0, n) = logZ < (ElemType) LSMALL ? 0 : logZ;
+    }
+    return *this;
+}
+
 template <class ElemType>
 CPUMatrix<ElemType>& CPUMatrix<ElemType>::DropFrame(const CPUMatrix<ElemType>& label, const CPUMatrix<ElemType>& gamma, const ElemType& threshhold)
 {
@@ -5548,6 +7572,116 @@ int CPUMatrix<ElemType>::SetNumThreads(int numThreads)
     return numThreads;
 }
 
+// -----------------------------------------------------------------------
+// CPUThreadBudget
+// -----------------------------------------------------------------------
+
+static std::atomic<size_t> s_numThreadBudgets(0);
+static thread_local size_t t_boundThreadBudget = 0; // m_id of the budget whose cores this thread's OpenMP threads are bound to, 0 if none
+
+// binds the calling thread to 'cores', returning its previous affinity
+static std::vector<unsigned char> SetThreadCores(const std::vector<int>& cores)
+{
+#ifdef _WIN32
+    DWORD_PTR mask = 0;
+    for (int core : cores)
+        mask |= (DWORD_PTR) 1 << core;
+    DWORD_PTR prevMask = SetThreadAffinityMask(GetCurrentThread(), mask);
+    if (prevMask == 0)
+        RuntimeError("CPUThreadBudget: SetThreadAffinityMask() failed.");
+    std::vector<unsigned char> prevAffinity(sizeof(prevMask));
+    memcpy(prevAffinity.data(), &prevMask, sizeof(prevMask));
+#else
+    cpu_set_t prevSet;
+    if (pthread_getaffinity_np(pthread_self(), sizeof(prevSet), &prevSet) != 0)
+        RuntimeError("CPUThreadBudget: pthread_getaffinity_np() failed.");
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int core : cores)
+        CPU_SET(core, &set);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0)
+        RuntimeError("CPUThreadBudget: pthread_setaffinity_np() failed.");
+    std::vector<unsigned char> prevAffinity(sizeof(prevSet));
+    memcpy(prevAffinity.data(), &prevSet, sizeof(prevSet));
+#endif
+    return prevAffinity;
+}
+
+static void RestoreThreadCores(const std::vector<unsigned char>& affinity)
+{
+#ifdef _WIN32
+    DWORD_PTR mask;
+    memcpy(&mask, affinity.data(), sizeof(mask));
+    SetThreadAffinityMask(GetCurrentThread(), mask);
+#else
+    pthread_setaffinity_np(pthread_self(), affinity.size(), (const cpu_set_t*) affinity.data());
+#endif
+}
+
+CPUThreadBudget::CPUThreadBudget(int numThreads, const std::vector<int>& cores)
+    : m_numThreads(numThreads), m_cores(cores), m_id(++s_numThreadBudgets)
+{
+    const int numCores = (int) std::thread::hardware_concurrency();
+#ifdef _WIN32
+    const int maxCore = std::min(numCores, (int) sizeof(DWORD_PTR) * 8); // (only the first processor group)
+#else
+    const int maxCore = std::min(numCores, (int) CPU_SETSIZE);
+#endif
+    for (int core : m_cores)
+    {
+        if (core < 0 || core >= maxCore)
+            InvalidArgument("CPUThreadBudget: Core %d does not exist, cores are numbered 0..%d.", core, maxCore - 1);
+    }
+    if (m_numThreads < 0)
+        InvalidArgument("CPUThreadBudget: The number of threads must not be negative.");
+    if (m_numThreads == 0 && !m_cores.empty()) // one thread per core
+        m_numThreads = (int) m_cores.size();
+}
+
+CPUThreadBudget::Scope::Scope(const CPUThreadBudget& budget)
+    : m_budget(budget), m_prevNumThreads(0), m_prevBlasNumThreads(0)
+{
+    if (!m_budget.m_cores.empty())
+        m_prevAffinity = SetThreadCores(m_budget.m_cores);
+#ifdef _OPENMP
+    // the number of threads is a per-thread setting of OpenMP, inherited by the parallel regions this thread starts
+    if (m_budget.m_numThreads > 0)
+    {
+        m_prevNumThreads = omp_get_max_threads();
+        omp_set_num_threads(m_budget.m_numThreads);
+#ifdef USE_MKL
+        m_prevBlasNumThreads = mkl_set_num_threads_local(m_budget.m_numThreads);
+#endif
+    }
+    // The OpenMP threads are kept from one parallel region to the next. Bind them once, unless another budget ran on this thread in between.
+    if (!m_budget.m_cores.empty() && t_boundThreadBudget != m_budget.m_id)
+    {
+        const auto& cores = m_budget.m_cores;
+#pragma omp parallel
+        {
+            if (omp_get_thread_num() != 0) // (the calling thread is bound already, and restored later)
+                SetThreadCores(cores);
+        }
+        t_boundThreadBudget = m_budget.m_id;
+    }
+#endif
+}
+
+CPUThreadBudget::Scope::~Scope()
+{
+#ifdef _OPENMP
+    if (m_budget.m_numThreads > 0)
+    {
+        omp_set_num_threads(m_prevNumThreads);
+#ifdef USE_MKL
+        mkl_set_num_threads_local(m_prevBlasNumThreads); // (0 reverts to the global setting)
+#endif
+    }
+#endif
+    if (!m_prevAffinity.empty())
+        RestoreThreadCores(m_prevAffinity);
+}
+
 // =======================================================================
 // TensorView support
 // =======================================================================
@@ -5842,6 +7976,27 @@ void CPUMatrix<ElemType>::TensorOp(ElemType beta, const CPUMatrix<ElemType>& a,
     }
 }
 
+// perform a fused sequence of elementwise ops ('program') on a, b, c, and d giving 'this'
+// Only the first program.m_numInputs inputs are read.
+template <class ElemType>
+void CPUMatrix<ElemType>::TensorOp(ElemType beta, const CPUMatrix<ElemType>& a, const CPUMatrix<ElemType>& b, const CPUMatrix<ElemType>& c, const CPUMatrix<ElemType>& d, ElemType alpha, const ElementWiseProgram& program,
+                                   const array<size_t, 5>& offsets,
+                                   const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, 5>& regularStrides)
+{
+    array<ElemType*, 5> pointers = {a.m_pArray, b.m_pArray, c.m_pArray, d.m_pArray, m_pArray};
+    const SmallVector<size_t> reducingOpDims;
+    const array<SmallVector<ptrdiff_t>, 5> reducingStrides;
+    const int numInputs = program.m_numInputs;
+    TensorOpWithFn(beta, pointers, alpha, [&program, numInputs](const array<ElemType*, 5>& pp)
+                   {
+                       ElemType inputs[ElementWiseProgram::MaxInputs] = {};
+                       for (int i = 0; i < numInputs; i++)
+                           inputs[i] = *(pp[i]);
+                       return EvaluateElementWiseProgram(program, inputs);
+                   },
+                   offsets, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+}
+
 // =======================================================================
 // explicit instantiations
 // =======================================================================
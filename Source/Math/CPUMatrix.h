@@ -69,10 +69,16 @@ public:
 
     void CopyColumnsStrided(const CPUMatrix<ElemType>& fromMatrix, size_t numCols, size_t srcNumColsStride, size_t destNumColsStride);
 
+    CPUMatrix<ElemType>& DoGatherColumnsOf(ElemType beta, const CPUMatrix<ElemType>& idx, const CPUMatrix<ElemType>& a, ElemType alpha);
+    CPUMatrix<ElemType>& DoScatterColumnsOf(ElemType beta, const CPUMatrix<ElemType>& idx, const CPUMatrix<ElemType>& a, ElemType alpha);
+
     CPUMatrix<ElemType> Diagonal() const;
 
     ElemType Adagrad(CPUMatrix<ElemType>& gradients, const bool needAveMultiplier);
     void FSAdagrad(CPUMatrix<ElemType>& gradients, CPUMatrix<ElemType>& functionValues, ElemType learnRatePerSample, ElemType momentum, ElemType adaWeight, ElemType adaMul);
+    void Adam(CPUMatrix<ElemType>& gradients, CPUMatrix<ElemType>* functionValues, ElemType learnRate, ElemType beta1, ElemType beta2, ElemType epsilon, ElemType biasCorrection);
+    static void FusedSGDUpdate(const FusedSGDBatch<ElemType>& batch);
+    static void FusedSGDSquaredNorm(const FusedSGDBatch<ElemType>& batch, ElemType* sumOfSquares);
     ElemType RmsProp(CPUMatrix<ElemType>& gradients,
                      ElemType RMS_GAMMA,
                      ElemType RMS_WGT_INC,
@@ -115,6 +121,7 @@ public:
     void SetUniformRandomValue(const ElemType low, const ElemType high, unsigned long seed = USE_TIME_BASED_SEED);
     void SetGaussianRandomValue(const ElemType mean, const ElemType sigma, unsigned long seed = USE_TIME_BASED_SEED);
     void SetUniformRandomMask(const ElemType maskRate, const ElemType scaleValue, unsigned long seed = USE_TIME_BASED_SEED);
+    CPUMatrix<ElemType>& ScaleAndAddDropoutOf(const ElemType beta, const CPUMatrix<ElemType>& a, const ElemType maskRate, const ElemType scaleValue, unsigned long seed, size_t counterOffset);
     void AddGaussianRandomValue(const ElemType mean, const ElemType sigma, unsigned long seed = USE_TIME_BASED_SEED);
 
     CPUMatrix<ElemType> Transpose();
@@ -182,6 +189,10 @@ public:
     CPUMatrix<ElemType>& InplaceLogSoftmax(const bool isColWise);
     CPUMatrix<ElemType>& AssignLogSoftmaxOf(const CPUMatrix<ElemType>& a, const bool isColWise);
 
+    CPUMatrix<ElemType>& InplaceSoftmax(const bool isColWise);
+    CPUMatrix<ElemType>& AssignSoftmaxOf(const CPUMatrix<ElemType>& a, const bool isColWise);
+    CPUMatrix<ElemType>& AssignMaskedSoftmaxOf(const CPUMatrix<ElemType>& a, ElemType scale, const CPUMatrix<ElemType>& numValidRows);
+
     CPUMatrix<ElemType>& InplaceHardmax(const bool isColWise);
     CPUMatrix<ElemType>& AssignHardmaxOf(const CPUMatrix<ElemType>& a, const bool isColWise);
 
@@ -242,6 +253,39 @@ public:
 
     CPUMatrix<ElemType>& AssignNCEDerivative(const CPUMatrix<ElemType>& tmp, const CPUMatrix<ElemType>& a, const CPUMatrix<ElemType>& b, size_t inputIndex, CPUMatrix<ElemType>& c);
 
+    // sampled softmax, see Matrix<ElemType>::InplaceSampleFromCDF() and Matrix<ElemType>::AssignSampledSoftmaxLogits()
+    CPUMatrix<ElemType>& InplaceSampleFromCDF(const CPUMatrix<ElemType>& cdf);
+    CPUMatrix<ElemType>& AssignSampledSoftmaxLogits(const CPUMatrix<ElemType>& trueLogits, const CPUMatrix<ElemType>& sampledLogits,
+                                                    const CPUMatrix<ElemType>& candidateBiases, const CPUMatrix<ElemType>& candidateIds);
+
+    // NCE with noise drawn on the device, see Matrix<ElemType>::AssignAliasSamplesOf(), Matrix<ElemType>::AssignNCELossOf() and Matrix<ElemType>::AddNCEHiddenGradientOf()
+    CPUMatrix<ElemType>& AssignAliasSamplesOf(const CPUMatrix<ElemType>& uniforms, const CPUMatrix<ElemType>& aliasProbs, const CPUMatrix<ElemType>& aliases);
+    CPUMatrix<ElemType>& AssignNCELossOf(const CPUMatrix<ElemType>& labelIds, const CPUMatrix<ElemType>& noiseIds, const CPUMatrix<ElemType>& hidden, const CPUMatrix<ElemType>& weights,
+                                 const CPUMatrix<ElemType>& bias, const CPUMatrix<ElemType>& logNoiseCounts, CPUMatrix<ElemType>& scoreGradients);
+    CPUMatrix<ElemType>& AddNCEHiddenGradientOf(const CPUMatrix<ElemType>& scoreGradients, const CPUMatrix<ElemType>& labelIds, const CPUMatrix<ElemType>& noiseIds, const CPUMatrix<ElemType>& weights);
+
+    // GMM log-likelihood, see Matrix<ElemType>::AssignGMMLogLikelihoodOf() and Matrix<ElemType>::AddGMMLogLikelihoodGradient()
+    CPUMatrix<ElemType>& AssignGMMLogLikelihoodOf(const CPUMatrix<ElemType>& logPrior, const CPUMatrix<ElemType>& mean, const CPUMatrix<ElemType>& logStddev, const CPUMatrix<ElemType>& feature,
+                                                  CPUMatrix<ElemType>& posterior, CPUMatrix<ElemType>& normedDeviation, CPUMatrix<ElemType>& normedDeviationVectors);
+    CPUMatrix<ElemType>& AddGMMLogLikelihoodGradient(const size_t inputIndex, const CPUMatrix<ElemType>& gradient, const CPUMatrix<ElemType>& logPrior,
+                                                     const CPUMatrix<ElemType>& posterior, const CPUMatrix<ElemType>& normedDeviation, const CPUMatrix<ElemType>& normedDeviationVectors);
+
+    // fused softmax cross entropy, see Matrix<ElemType>::AssignCrossEntropyWithSoftmaxOf() and Matrix<ElemType>::AddCrossEntropyWithSoftmaxGradient()
+    CPUMatrix<ElemType>& AssignCrossEntropyWithSoftmaxOf(const CPUMatrix<ElemType>& labels, const CPUMatrix<ElemType>& logits, CPUMatrix<ElemType>& logSumExp);
+    CPUMatrix<ElemType>& AddCrossEntropyWithSoftmaxGradient(const size_t inputIndex, const CPUMatrix<ElemType>& gradient, const CPUMatrix<ElemType>& labels,
+                                                            const CPUMatrix<ElemType>& logits, const CPUMatrix<ElemType>& logSumExp);
+
+    // Viterbi decoding, see Matrix<ElemType>::AssignViterbiPathOf()
+    CPUMatrix<ElemType>& AssignViterbiPathOf(const CPUMatrix<ElemType>& posScores, const CPUMatrix<ElemType>& pairScores, const CPUMatrix<ElemType>& sequences, const size_t numParallelSequences,
+                                             const int startLabel, const int endLabel, CPUMatrix<ElemType>& alpha, CPUMatrix<ElemType>& backtrace);
+
+    // class-based softmax cross entropy, see Matrix<ElemType>::AssignClassBasedCrossEntropyWithSoftmaxOf() and Matrix<ElemType>::AddClassBasedCrossEntropyWithSoftmaxGradient()
+    CPUMatrix<ElemType>& AssignClassBasedCrossEntropyWithSoftmaxOf(const CPUMatrix<ElemType>& labels, const CPUMatrix<ElemType>& input, const CPUMatrix<ElemType>& weight, const CPUMatrix<ElemType>& classLogSoftmax,
+                                                                   const CPUMatrix<ElemType>& buckets, const CPUMatrix<ElemType>& frames, const size_t maxClassSize, CPUMatrix<ElemType>& softmax);
+    CPUMatrix<ElemType>& AddClassBasedCrossEntropyWithSoftmaxGradient(const size_t inputIndex, const CPUMatrix<ElemType>& gradient, const CPUMatrix<ElemType>& labels, const CPUMatrix<ElemType>& input,
+                                                                      const CPUMatrix<ElemType>& weight, const CPUMatrix<ElemType>& classLogSoftmax, const CPUMatrix<ElemType>& buckets,
+                                                                      const CPUMatrix<ElemType>& frames, const CPUMatrix<ElemType>& softmax);
+
     void VectorNormInf(CPUMatrix<ElemType>& c, const bool isColWise) const;
     CPUMatrix<ElemType>& AssignVectorNormInfOf(CPUMatrix<ElemType>& a, const bool isColWise);
 
@@ -257,6 +301,10 @@ public:
     ElemType MatrixNormInf() const;
     ElemType MatrixNorm1() const;
     ElemType MatrixNorm0() const; // number of non-zero elemets
+    // 1x1 results that stay on the device (see Matrix)
+    CPUMatrix<ElemType>& AssignMatrixNormInfOf(const CPUMatrix<ElemType>& a);
+    CPUMatrix<ElemType>& AssignMatrixNorm1Of(const CPUMatrix<ElemType>& a);
+    CPUMatrix<ElemType>& AssignIsEqualTo(const CPUMatrix<ElemType>& a, const CPUMatrix<ElemType>& b, const ElemType threshold = 1e-8);
     CPUMatrix<ElemType>& AssignSignOf(const CPUMatrix<ElemType>& a);
     CPUMatrix<ElemType>& AddSignOf(const CPUMatrix<ElemType>& a);
 
@@ -277,6 +325,7 @@ public:
     void VectorMin(CPUMatrix<ElemType>& minIndexes, CPUMatrix<ElemType>& minValues, const bool isColWise) const;
 
     CPUMatrix<ElemType>& AssignNumOfDiff(const CPUMatrix<ElemType>& a, const CPUMatrix<ElemType>& b, bool searchInCol = false);
+    CPUMatrix<ElemType>& AssignNumOfTopKErrorsOf(const CPUMatrix<ElemType>& labels, const CPUMatrix<ElemType>& predictions, const size_t topK);
 
     void Print(const char* matrixName, ptrdiff_t rowStart, ptrdiff_t rowEnd, ptrdiff_t colStart, ptrdiff_t colEnd) const;
     void Print(const char* matrixName = nullptr) const; // print whole matrix. can be expensive
@@ -294,15 +343,38 @@ public:
                                                 const size_t outputWidth, const size_t outputHeight, const size_t outputChannels,
                                                 const size_t kernelWidth, const size_t kernelHeight, const size_t horizontalSubsample, const size_t verticalSubsample,
                                                 const bool zeroPadding = false) const;
+    CPUMatrix<ElemType>& AssignConvolutionResult(const CPUMatrix<ElemType>& inputBatch, const CPUMatrix<ElemType>& filter,
+                                                 const size_t inputWidth, const size_t inputHeight, const size_t inputChannels,
+                                                 const size_t outputWidth, const size_t outputHeight, const size_t outputChannels,
+                                                 const size_t kernelWidth, const size_t kernelHeight, const size_t horizontalSubsample, const size_t verticalSubsample,
+                                                 const bool zeroPadding = false);
+    CPUMatrix<ElemType>& AssignGroupedConvolutionResult(const CPUMatrix<ElemType>& inputBatch, const CPUMatrix<ElemType>& filter,
+                                                        const size_t inputWidth, const size_t inputHeight, const size_t inputChannels,
+                                                        const size_t outputWidth, const size_t outputHeight, const size_t outputChannels,
+                                                        const size_t kernelWidth, const size_t kernelHeight, const size_t horizontalSubsample, const size_t verticalSubsample,
+                                                        const bool zeroPadding, const size_t groups);
+    CPUMatrix<ElemType>& AddGroupedConvolutionGradientOfInput(const CPUMatrix<ElemType>& outputGradientBatch, const CPUMatrix<ElemType>& filter,
+                                                              const size_t inputWidth, const size_t inputHeight, const size_t inputChannels,
+                                                              const size_t outputWidth, const size_t outputHeight, const size_t outputChannels,
+                                                              const size_t kernelWidth, const size_t kernelHeight, const size_t horizontalSubsample, const size_t verticalSubsample,
+                                                              const bool zeroPadding, const size_t groups);
+    CPUMatrix<ElemType>& AddGroupedConvolutionGradientOfFilter(const CPUMatrix<ElemType>& outputGradientBatch, const CPUMatrix<ElemType>& inputBatch,
+                                                               const size_t inputWidth, const size_t inputHeight, const size_t inputChannels,
+                                                               const size_t outputWidth, const size_t outputHeight, const size_t outputChannels,
+                                                               const size_t kernelWidth, const size_t kernelHeight, const size_t horizontalSubsample, const size_t verticalSubsample,
+                                                               const bool zeroPadding, const size_t groups);
     CPUMatrix<ElemType>& AssignMaxPoolingResult(const CPUMatrix<ElemType>& inputBatch, const size_t channels,
                                                 const size_t inputWidth, const size_t inputHeight, const size_t inputSizePerSample,
                                                 const size_t outputWidth, const size_t outputHeight, const size_t outputSizePerSample,
-                                                const size_t windowWidth, const size_t windowHeight, const size_t horizontalSubsample, const size_t verticalSubsample);
+                                                const size_t windowWidth, const size_t windowHeight, const size_t horizontalSubsample, const size_t verticalSubsample,
+                                                std::vector<int>* argmax = nullptr);
     CPUMatrix<ElemType>& AddMaxPoolingGradient(const CPUMatrix<ElemType>& outputGradientBatch, const CPUMatrix<ElemType>& inputBatch, const CPUMatrix<ElemType>& outputBatch,
                                                const size_t channels,
                                                const size_t inputWidth, const size_t inputHeight, const size_t inputSizePerSample,
                                                const size_t outputWidth, const size_t outputHeight, const size_t outputSizePerSample,
                                                const size_t windowWidth, const size_t windowHeight, const size_t horizontalSubsample, const size_t verticalSubsample);
+    CPUMatrix<ElemType>& AddMaxPoolingGradientAtArgmax(const CPUMatrix<ElemType>& outputGradientBatch, const std::vector<int>& argmax,
+                                                       const size_t channels, const size_t inputSizePerSample, const size_t outputSizePerSample);
     CPUMatrix<ElemType>& AssignAveragePoolingResult(const CPUMatrix<ElemType>& inputBatch, const size_t channels,
                                                     const size_t inputWidth, const size_t inputHeight, const size_t inputSizePerSample,
                                                     const size_t outputWidth, const size_t outputHeight, const size_t outputSizePerSample,
@@ -320,11 +392,17 @@ public:
     static void SVD(const CPUMatrix<ElemType>& A, CPUMatrix<ElemType>& SIGMA, CPUMatrix<ElemType>& U, CPUMatrix<ElemType>& VT, CPUMatrix<ElemType>& W);
 
     static void MultiplyAndWeightedAdd(ElemType alpha, const CPUMatrix<ElemType>& a, const bool transposeA, const CPUMatrix<ElemType>& b, const bool transposeB, ElemType beta, CPUMatrix<ElemType>& c);
+    static void BatchedMultiplyAndWeightedAdd(ElemType alpha, const CPUMatrix<ElemType>& a, const bool transposeA, const CPUMatrix<ElemType>& b, const bool transposeB, ElemType beta, CPUMatrix<ElemType>& c, size_t numBatches);
     static void MultiplyAndAdd(const CPUMatrix<ElemType>& a, const bool transposeA, const CPUMatrix<ElemType>& b, const bool transposeB, CPUMatrix<ElemType>& c);
     static void Multiply(const CPUMatrix<ElemType>& a, const bool transposeA, const CPUMatrix<ElemType>& b, const bool transposeB, CPUMatrix<ElemType>& c);
     static void Multiply(const CPUMatrix<ElemType>& a, const CPUMatrix<ElemType>& b, CPUMatrix<ElemType>& c);
     static void Multiply1x1AndWeightedAdd(ElemType alpha, const CPUMatrix<ElemType>& a, const CPUMatrix<ElemType>& b, ElemType beta, CPUMatrix<ElemType>& c);
 
+    static void MultiplyAndAddBiasActivation(const CPUMatrix<ElemType>& a, const bool transposeA, const CPUMatrix<ElemType>& b, const CPUMatrix<ElemType>& bias, ElementWiseOperator activation, CPUMatrix<ElemType>& c);
+    void AddBiasActivation(const CPUMatrix<ElemType>& bias, ElementWiseOperator activation);
+    static void BackpropBiasActivation(const CPUMatrix<ElemType>& outputGradient, const CPUMatrix<ElemType>& output, ElementWiseOperator activation,
+                                       ElemType productBeta, CPUMatrix<ElemType>& productGradient, ElemType biasBeta, CPUMatrix<ElemType>& biasGradient);
+
     static void ScaleAndAdd(ElemType alpha, const CPUMatrix<ElemType>& a, CPUMatrix<ElemType>& c);
     static void AddScaledDifference(const ElemType alpha, const CPUMatrix<ElemType>& a, const CPUMatrix<ElemType>& b, CPUMatrix<ElemType>& c);
     static void AssignScaledDifference(const ElemType alpha, const CPUMatrix<ElemType>& a, const CPUMatrix<ElemType>& b, CPUMatrix<ElemType>& c);
@@ -360,6 +438,10 @@ public:
                   const std::array<size_t, 4>& offsets,
                   const SmallVector<size_t>& regularOpDims, const std::array<SmallVector<ptrdiff_t>, 4>& regularStrides,
                   const SmallVector<size_t>& reducingOpDims, const std::array<SmallVector<ptrdiff_t>, 4>& reducingStrides);
+    // fused sequence of elementwise ops over up to 4 inputs (unused inputs are passed as any valid matrix); no reduction
+    void TensorOp(ElemType beta, const CPUMatrix<ElemType>& a, const CPUMatrix<ElemType>& b, const CPUMatrix<ElemType>& c, const CPUMatrix<ElemType>& d, ElemType alpha, const ElementWiseProgram& program,
+                  const std::array<size_t, 5>& offsets,
+                  const SmallVector<size_t>& regularOpDims, const std::array<SmallVector<ptrdiff_t>, 5>& regularStrides);
 
     static CPUMatrix<ElemType> Ones(const size_t rows, const size_t cols);
     static CPUMatrix<ElemType> Zeros(const size_t rows, const size_t cols);
@@ -373,15 +455,27 @@ public:
 public:
     CPUMatrix<ElemType>& AssignElementProductOfWithShiftNeg(const CPUMatrix<ElemType>& a, const CPUMatrix<ElemType>& b, size_t shift, size_t negnumber);
     static void InnerProductWithShiftNeg(const CPUMatrix<ElemType>& a, const CPUMatrix<ElemType>& b, CPUMatrix<ElemType>& c, const bool isColWise, size_t shift, size_t negnumber);
+    CPUMatrix<ElemType>& AssignCosDistanceWithShiftNegOf(const CPUMatrix<ElemType>& a, const CPUMatrix<ElemType>& b, size_t shift, size_t negNumber,
+                                                         CPUMatrix<ElemType>& invNormA, CPUMatrix<ElemType>& invNormB);
+    CPUMatrix<ElemType>& AddCosDistanceWithShiftNegGradientOf(const CPUMatrix<ElemType>& gradient, const CPUMatrix<ElemType>& value,
+                                                              const CPUMatrix<ElemType>& a, const CPUMatrix<ElemType>& b,
+                                                              const CPUMatrix<ElemType>& invNormA, const CPUMatrix<ElemType>& invNormB, size_t shift, bool rightInput);
+    CPUMatrix<ElemType>& AssignAugmentedImagesOf(const CPUMatrix<ElemType>& staged, const CPUMatrix<ElemType>& mean, size_t stagingWidth, size_t stagingHeight,
+                                                 size_t channels, size_t width, size_t height, bool transposeToCHW);
     // extract out a row from a, assign it to [this].
     CPUMatrix<ElemType>& GetARowByIndex(const CPUMatrix<ElemType>& a, const size_t index);
     static void ConductRowElementMultiplyWithShift(const CPUMatrix<ElemType>& a, const CPUMatrix<ElemType>& b, CPUMatrix<ElemType>& c, const size_t shift, bool bFirstmatrixfixed);
     CPUMatrix<ElemType>& AssignElementProductOfWithShift(const CPUMatrix<ElemType>& a, const CPUMatrix<ElemType>& b, const size_t shift);
 
 public:
+    // "BMATA" is the variant with the elements in an aligned block (see File::PutAlignedBlock()),
+    // "BMATH" the one with the elements in half precision (see File::WritesHalfMatrices())
     friend File& operator>>(File& stream, CPUMatrix<ElemType>& us)
     {
-        stream.GetMarker(fileMarkerBeginSection, std::wstring(L"BMAT"));
+        std::wstring section;
+        stream >> section;
+        if (section != L"BMAT" && section != L"BMATA" && section != L"BMATH")
+            RuntimeError("section name mismatch %ls != BMAT", section.c_str());
         size_t elsize;
         stream >> elsize;
         if (sizeof(ElemType) != elsize)
@@ -390,9 +484,37 @@ public:
         size_t numRows, numCols;
         int format;
         stream >> matrixName >> format >> numRows >> numCols;
+        if (section == L"BMATA" && stream.MapsAlignedBlocks())
+        {
+            // the matrix uses the mapped pages, which are only copied when written to
+            ElemType* mapped = (ElemType*) stream.MapAlignedBlock(numRows * numCols * sizeof(ElemType));
+            stream.GetMarker(fileMarkerEndSection, std::wstring(L"EMAT"));
+            us.SetValue(numRows, numCols, mapped, matrixFlagDontOwnBuffer);
+            return stream;
+        }
+        if (section == L"BMATA" && stream.TransfersBlocksInParallel())
+        {
+            // sized now, filled by File::FinishAlignedBlocks()
+            us.Resize(numRows, numCols);
+            stream.GetAlignedBlock(numRows * numCols * sizeof(ElemType), [&us, numRows, numCols](void* buffer)
+                                   {
+                                       us.SetValue(numRows, numCols, (ElemType*) buffer, matrixFlagNormal);
+                                   });
+            stream.GetMarker(fileMarkerEndSection, std::wstring(L"EMAT"));
+            return stream;
+        }
         ElemType* d_array = new ElemType[numRows * numCols];
-        for (size_t i = 0; i < numRows * numCols; ++i)
-            stream >> d_array[i];
+        if (section == L"BMATA")
+            stream.GetAlignedBlock(d_array, numRows * numCols * sizeof(ElemType));
+        else if (section == L"BMATH")
+        {
+            std::vector<uint16_t> halves(numRows * numCols);
+            stream.GetArray(halves.data(), halves.size());
+            for (size_t i = 0; i < halves.size(); i++)
+                d_array[i] = (ElemType) HalfToFloat(halves[i]);
+        }
+        else
+            stream.GetArray(d_array, numRows * numCols);
         stream.GetMarker(fileMarkerEndSection, std::wstring(L"EMAT"));
         us.SetValue(numRows, numCols, d_array, matrixFlagNormal);
 
@@ -401,7 +523,9 @@ public:
     }
     friend File& operator<<(File& stream, const CPUMatrix<ElemType>& us)
     {
-        stream.PutMarker(fileMarkerBeginSection, std::wstring(L"BMAT"));
+        bool half = stream.WritesHalfMatrices();
+        bool aligned = !half && stream.WritesAlignedBlocks();
+        stream.PutMarker(fileMarkerBeginSection, std::wstring(half ? L"BMATH" : aligned ? L"BMATA" : L"BMAT"));
         stream << sizeof(ElemType);
 
         std::wstring s = std::wstring(L"unnamed");
@@ -409,8 +533,22 @@ public:
         stream << s << format;
 
         stream << us.m_numRows << us.m_numCols;
-        for (size_t i = 0; i < us.GetNumElements(); ++i)
-            stream << us.m_pArray[i];
+        if (half)
+        {
+            std::vector<uint16_t> halves(us.GetNumElements());
+            for (size_t i = 0; i < halves.size(); i++)
+                halves[i] = FloatToHalf((float) us.m_pArray[i]);
+            stream.PutArray(halves.data(), halves.size());
+        }
+        else if (aligned)
+        {
+            stream.PutAlignedBlock(us.GetNumElements() * sizeof(ElemType), [&us](void* buffer)
+                                   {
+                                       memcpy(buffer, us.m_pArray, us.GetNumElements() * sizeof(ElemType));
+                                   });
+        }
+        else
+            stream.PutArray(us.m_pArray, us.GetNumElements());
         stream.PutMarker(fileMarkerEndSection, std::wstring(L"EMAT"));
         return stream;
     }
@@ -442,6 +580,10 @@ public:
                                      const size_t tPos // position
                                      );
 
+    // CTC forward-backward, see Matrix::AssignCTCPosteriors()
+    CPUMatrix<ElemType>& AssignCTCPosteriors(const CPUMatrix<ElemType>& logProbs, const CPUMatrix<ElemType>& stateLabels, const CPUMatrix<ElemType>& sequences,
+                                             size_t numParallelSequences, CPUMatrix<ElemType>& alpha, CPUMatrix<ElemType>& beta, CPUMatrix<ElemType>& logLikelihoods);
+
 protected:
     size_t LocateElement(const size_t i, const size_t j) const;
     size_t LocateColumn(const size_t j) const;
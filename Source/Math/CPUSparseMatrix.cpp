@@ -14,6 +14,8 @@
 #include <math.h>
 #include "CPUMatrix.h"
 #include "CPUSparseMatrix.h"
+#include "TensorOps.h"
+#include "HostCachingMemAllocator.h"
 #include <random>
 #include <chrono>
 #include <iostream>
@@ -64,6 +66,36 @@
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
+// ParallelForColumnsByNnz -- call f(jBegin, jEnd) for ranges of the columns [0, numCols) of a CSC matrix (rows of a CSR matrix)
+// on the OpenMP threads. The ranges are contiguous and hold about the same number of nonzeros, so that a few long columns do not
+// leave the other threads waiting, as a static partition by column count would. 'workPerNz' is the number of multiply-adds
+// per nonzero; if the total is too small to pay for the threads, f() is called once for all columns on the calling thread.
+template <class F>
+static void ParallelForColumnsByNnz(const CPUSPARSE_INDEX_TYPE* compIndex, size_t numCols, size_t workPerNz, const F& f)
+{
+    const size_t minWorkPerThread = 16384;
+    const size_t nz = compIndex[numCols] - compIndex[0];
+    const int numThreads = (int) min((size_t) omp_get_max_threads(), nz * workPerNz / minWorkPerThread + 1);
+    if (numThreads <= 1)
+    {
+        f((size_t) 0, numCols);
+        return;
+    }
+    // first column whose nonzeros start at or after the given offset
+    auto columnAt = [&](size_t nzOffset)
+    {
+        return (size_t) (lower_bound(compIndex, compIndex + numCols, (CPUSPARSE_INDEX_TYPE) (compIndex[0] + nzOffset)) - compIndex);
+    };
+#pragma omp parallel for num_threads(numThreads)
+    for (int t = 0; t < numThreads; t++)
+    {
+        const size_t jBegin = t == 0 ? 0 : columnAt(nz * t / numThreads);
+        const size_t jEnd = t + 1 == numThreads ? numCols : columnAt(nz * (t + 1) / numThreads);
+        if (jBegin < jEnd)
+            f(jBegin, jEnd);
+    }
+}
+
 #pragma region Helpful Enum Definitions
 
 enum class MatrixOrder
@@ -234,23 +266,23 @@ void CPUSparseMatrix<ElemType>::ReleaseMemory()
     {
         if (m_format == MatrixFormat::matrixFormatSparseCSC || m_format == MatrixFormat::matrixFormatSparseCSR)
         {
-            delete[] m_pArray;
+            HostCachingMemAllocator::DeleteArray(m_pArray);
             m_pArray = nullptr;
             m_nzValues = nullptr;
 
-            delete[] m_unCompIndex;
+            HostCachingMemAllocator::DeleteArray(m_unCompIndex);
             m_unCompIndex = nullptr;
 
-            delete[] m_compIndex;
+            HostCachingMemAllocator::DeleteArray(m_compIndex);
             m_compIndex = nullptr;
         }
         else if (m_format == MatrixFormat::matrixFormatSparseBlockCol || m_format == MatrixFormat::matrixFormatSparseBlockRow)
         {
-            delete[] m_pArray;
+            HostCachingMemAllocator::DeleteArray(m_pArray);
             m_pArray = nullptr;
             m_nzValues = nullptr;
 
-            delete[] m_blockIds;
+            HostCachingMemAllocator::DeleteArray(m_blockIds);
             m_blockIds = nullptr;
         }
     }
@@ -517,6 +549,59 @@ void CPUSparseMatrix<ElemType>::SetMatrixFromCSCFormat(const CPUSPARSE_INDEX_TYP
     memcpy(NzValues(), h_Val, NzSize());
 }
 
+template <class ElemType>
+void CPUSparseMatrix<ElemType>::SetMatrixFromBlockColFormat(const size_t* h_ColIds, const ElemType* h_Val, const size_t numBlocks, const size_t numRows, const size_t numCols)
+{
+    if (!OwnBuffer())
+        LogicError("Cannot modify since the buffer is managed externally.");
+
+    if (numBlocks > numCols)
+        InvalidArgument("SetMatrixFromBlockColFormat: %d blocks exceed the %d columns of the matrix.", (int) numBlocks, (int) numCols);
+
+    m_format = matrixFormatSparseBlockCol;
+    Resize(numRows, numCols, numRows * numBlocks, true, false);
+    m_blockSize = numBlocks;
+    m_blockIdShift = 0;
+    m_nz = numRows * numBlocks;
+
+    memcpy(m_blockIds, h_ColIds, sizeof(size_t) * numBlocks);
+    memcpy(m_pArray, h_Val, NzSize());
+}
+
+template <class ElemType>
+void CPUSparseMatrix<ElemType>::AssignOneHotColumnsOf(const CPUMatrix<ElemType>& ids, const size_t numRows)
+{
+    if (numRows == 0)
+        InvalidArgument("AssignOneHotColumnsOf: the matrix needs at least one row.");
+
+    const size_t numCols = ids.GetNumElements();
+    std::vector<CPUSPARSE_INDEX_TYPE> colStarts(numCols + 1);
+    std::vector<CPUSPARSE_INDEX_TYPE> rowIndices(numCols);
+    std::vector<ElemType> values(numCols, 1);
+    const ElemType* idValues = ids.BufferPointer();
+    for (size_t j = 0; j < numCols; j++)
+    {
+        long row = (long) idValues[j];
+        rowIndices[j] = (CPUSPARSE_INDEX_TYPE) (row < 0 ? 0 : row >= (long) numRows ? numRows - 1 : row);
+        colStarts[j] = (CPUSPARSE_INDEX_TYPE) j;
+    }
+    colStarts[numCols] = (CPUSPARSE_INDEX_TYPE) numCols;
+    SetMatrixFromCSCFormat(colStarts.data(), rowIndices.data(), values.data(), numCols, numRows, numCols);
+}
+
+template <class ElemType>
+void CPUSparseMatrix<ElemType>::GetMatrixFromBlockColFormat(std::vector<size_t>& colIds, std::vector<ElemType>& values) const
+{
+    if (m_format != matrixFormatSparseBlockCol)
+        LogicError("GetMatrixFromBlockColFormat: the matrix is not in block column format.");
+
+    colIds.resize(m_blockSize);
+    for (size_t j = 0; j < m_blockSize; j++)
+        colIds[j] = m_blockIds[j] - m_blockIdShift;
+
+    values.assign(m_pArray, m_pArray + m_blockSize * m_numRows);
+}
+
 template <class ElemType>
 ElemType* CPUSparseMatrix<ElemType>::BufferPointer() const
 {
@@ -543,9 +628,10 @@ void CPUSparseMatrix<ElemType>::Resize(const size_t numRows, const size_t numCol
     {
         if (m_format == MatrixFormat::matrixFormatSparseCSC || m_format == MatrixFormat::matrixFormatSparseCSR)
         {
-            auto* pArray      = new ElemType[numNZElemToReserve]();
-            auto* unCompIndex = new CPUSPARSE_INDEX_TYPE[numNZElemToReserve];
-            auto* compIndex   = new CPUSPARSE_INDEX_TYPE[newCompIndexSize];
+            auto* pArray      = HostCachingMemAllocator::NewArray<ElemType>(numNZElemToReserve);
+            auto* unCompIndex = HostCachingMemAllocator::NewArray<CPUSPARSE_INDEX_TYPE>(numNZElemToReserve);
+            auto* compIndex   = HostCachingMemAllocator::NewArray<CPUSPARSE_INDEX_TYPE>(newCompIndexSize);
+            memset(pArray, 0, sizeof(ElemType) * numNZElemToReserve);
 
             if (keepExistingValues && (m_nz > numNZElemToReserve || m_compIndexSize > newCompIndexSize))
                 LogicError("Resize: To keep values m_nz should <= numNZElemToReserve and m_compIndexSize <= newCompIndexSize");
@@ -558,9 +644,9 @@ void CPUSparseMatrix<ElemType>::Resize(const size_t numRows, const size_t numCol
                 memcpy(compIndex, m_compIndex, SecondaryIndexSize());
             }
 
-            delete[] m_pArray;
-            delete[] m_unCompIndex;
-            delete[] m_compIndex;
+            HostCachingMemAllocator::DeleteArray(m_pArray);
+            HostCachingMemAllocator::DeleteArray(m_unCompIndex);
+            HostCachingMemAllocator::DeleteArray(m_compIndex);
 
             m_pArray = pArray;
             m_nzValues = m_pArray; // TODO: can this ever be different?
@@ -569,8 +655,8 @@ void CPUSparseMatrix<ElemType>::Resize(const size_t numRows, const size_t numCol
         }
         else if (m_format == MatrixFormat::matrixFormatSparseBlockCol || m_format == MatrixFormat::matrixFormatSparseBlockRow)
         {
-            ElemType* blockVal = new ElemType[numNZElemToReserve];
-            size_t* blockIds = new size_t[newCompIndexSize];
+            ElemType* blockVal = HostCachingMemAllocator::NewArray<ElemType>(numNZElemToReserve);
+            size_t* blockIds = HostCachingMemAllocator::NewArray<size_t>(newCompIndexSize);
 
             if (keepExistingValues && (m_nz > numNZElemToReserve || m_compIndexSize > newCompIndexSize))
                 LogicError("Resize: To keep values m_nz should <= numNZElemToReserve and m_compIndexSize <= newCompIndexSize");
@@ -582,8 +668,8 @@ void CPUSparseMatrix<ElemType>::Resize(const size_t numRows, const size_t numCol
                 memcpy(blockIds, m_blockIds, sizeof(size_t) * m_compIndexSize);
             }
 
-            delete[] m_pArray;
-            delete[] m_blockIds;
+            HostCachingMemAllocator::DeleteArray(m_pArray);
+            HostCachingMemAllocator::DeleteArray(m_blockIds);
 
             m_pArray = blockVal;
             m_nzValues = m_pArray;
@@ -652,43 +738,71 @@ void CPUSparseMatrix<ElemType>::MultiplyAndWeightedAdd(ElemType alpha, const CPU
 
     if (!transposeA && !transposeB)
     {
-        for (size_t j = 0; j < rhs.GetNumCols(); j++)
+        // column j of c only depends on column j of rhs
+        const size_t numRows = lhs.GetNumRows();
+        ParallelForColumnsByNnz(rhs.m_compIndex, rhs.GetNumCols(), numRows, [&](size_t jBegin, size_t jEnd)
         {
-            size_t start = rhs.m_compIndex[j]; // ColLocation
-            size_t end = rhs.m_compIndex[j + 1];
-            for (size_t p = start; p < end; p++)
+            for (size_t j = jBegin; j < jEnd; j++)
             {
-                size_t i = rhs.m_unCompIndex[p]; // RowLocation
-                ElemType val = rhs.m_pArray[p];
-
-                for (size_t h = 0; h < lhs.GetNumRows(); h++)
+                size_t start = rhs.m_compIndex[j]; // ColLocation
+                size_t end = rhs.m_compIndex[j + 1];
+                ElemType* cj = &c(0, j);
+                for (size_t p = start; p < end; p++)
                 {
-                    c(h, j) += alpha * lhs(h, i) * val;
+                    size_t i = rhs.m_unCompIndex[p]; // RowLocation
+                    ElemType val = rhs.m_pArray[p];
+                    const ElemType* lhsi = &lhs(0, i);
+                    for (size_t h = 0; h < numRows; h++) // contiguous, so that this vectorizes
+                        cj[h] += alpha * lhsi[h] * val;
                 }
             }
-        }
+        });
     }
     else if (!transposeA && transposeB)
     {
-        for (size_t j = 0; j < rhs.GetNumCols(); j++)
+        // different columns of rhs add into the same column of c, so the threads split the rows of c instead
+        const long numRows = (long) lhs.GetNumRows();
+        const long rowsPerBlock = 64;
+#pragma omp parallel for if (rhs.NzCount() * numRows >= 65536)
+        for (long h0 = 0; h0 < numRows; h0 += rowsPerBlock)
         {
-            size_t start = rhs.m_compIndex[j];
-            size_t end = rhs.m_compIndex[j + 1];
-
-            for (size_t p = start; p < end; p++)
+            const size_t blockRows = (size_t) min(rowsPerBlock, numRows - h0);
+            for (size_t j = 0; j < rhs.GetNumCols(); j++)
             {
-                size_t i = rhs.m_unCompIndex[p];
-                ElemType val = rhs.m_pArray[p];
-                for (size_t h = 0; h < lhs.GetNumRows(); h++)
+                size_t start = rhs.m_compIndex[j];
+                size_t end = rhs.m_compIndex[j + 1];
+                const ElemType* lhsj = &lhs(h0, j);
+                for (size_t p = start; p < end; p++)
                 {
-                    c(h, i) += alpha * lhs(h, j) * val;
+                    size_t i = rhs.m_unCompIndex[p];
+                    ElemType val = rhs.m_pArray[p];
+                    ElemType* ci = &c(h0, i);
+                    for (size_t h = 0; h < blockRows; h++)
+                        ci[h] += alpha * lhsj[h] * val;
                 }
             }
         }
     }
     else if (transposeA && !transposeB)
     {
-        NOT_IMPLEMENTED;
+        // the gradient of a sparse input that is multiplied from the left
+        ParallelForColumnsByNnz(rhs.m_compIndex, rhs.GetNumCols(), lhs.GetNumCols(), [&](size_t jBegin, size_t jEnd)
+        {
+            for (size_t j = jBegin; j < jEnd; j++)
+            {
+                size_t start = rhs.m_compIndex[j];
+                size_t end = rhs.m_compIndex[j + 1];
+                for (size_t p = start; p < end; p++)
+                {
+                    size_t i = rhs.m_unCompIndex[p];
+                    ElemType val = rhs.m_pArray[p];
+                    for (size_t h = 0; h < lhs.GetNumCols(); h++)
+                    {
+                        c(h, j) += alpha * lhs(i, h) * val;
+                    }
+                }
+            }
+        });
     }
     else
     {
@@ -696,6 +810,78 @@ void CPUSparseMatrix<ElemType>::MultiplyAndWeightedAdd(ElemType alpha, const CPU
     }
 }
 
+// c = alpha*op(lhs) * rhs + beta*c
+// sparse x dense = dense, where lhs is in CSC format
+template <class ElemType>
+void CPUSparseMatrix<ElemType>::MultiplyAndWeightedAdd(ElemType alpha, const CPUSparseMatrix<ElemType>& lhs, const bool transposeA,
+                                                       const CPUMatrix<ElemType>& rhs, const bool transposeB, ElemType beta, CPUMatrix<ElemType>& c)
+{
+    if (lhs.IsEmpty() || rhs.IsEmpty())
+        LogicError("MultiplyAndWeightedAdd:  one of the input matrix is empty.");
+
+    if (lhs.GetFormat() != matrixFormatSparseCSC || transposeB)
+        NOT_IMPLEMENTED;
+
+    size_t m = transposeA ? lhs.GetNumCols() : lhs.GetNumRows();
+    size_t k = transposeA ? lhs.GetNumRows() : lhs.GetNumCols();
+    size_t n = rhs.GetNumCols();
+    if (k != rhs.GetNumRows())
+        InvalidArgument("CPUSparseMatrix::MultiplyAndWeightedAdd: The inner dimensions of a and b must match.");
+
+    if (beta == 0)
+        c.Resize(m, n);
+    else
+        c.VerifySize(m, n); // Can't resize if beta != 0
+
+    if (beta == 0)
+    {
+        memset(c.GetArray(), 0, sizeof(ElemType) * c.GetNumElements());
+    }
+    else if (beta != 1)
+    {
+#pragma omp parallel for
+        foreach_coord (i, j, c)
+        {
+            c(i, j) = beta * c(i, j);
+        }
+    }
+
+    // each column of c only depends on the same column of rhs, so the columns are computed in parallel
+    if (!transposeA)
+    {
+#pragma omp parallel for
+        for (long j = 0; j < (long) n; j++)
+        {
+            for (size_t col = 0; col < lhs.GetNumCols(); col++)
+            {
+                ElemType val = rhs(col, j);
+                if (val == 0)
+                    continue;
+                size_t start = lhs.m_compIndex[col];
+                size_t end = lhs.m_compIndex[col + 1];
+                for (size_t p = start; p < end; p++)
+                    c(lhs.m_unCompIndex[p], j) += alpha * lhs.m_pArray[p] * val;
+            }
+        }
+    }
+    else
+    {
+#pragma omp parallel for
+        for (long j = 0; j < (long) n; j++)
+        {
+            for (size_t col = 0; col < lhs.GetNumCols(); col++)
+            {
+                size_t start = lhs.m_compIndex[col];
+                size_t end = lhs.m_compIndex[col + 1];
+                ElemType sum = 0;
+                for (size_t p = start; p < end; p++)
+                    sum += lhs.m_pArray[p] * rhs(lhs.m_unCompIndex[p], j);
+                c(col, j) += alpha * sum;
+            }
+        }
+    }
+}
+
 // dense x sparse = sparse
 // c = alpha * op(lhs) * op(rhs)
 template <class ElemType>
@@ -810,23 +996,28 @@ void CPUSparseMatrix<ElemType>::ScaleAndAdd(const ElemType alpha, const CPUSpars
     if (lhs.GetFormat() == MatrixFormat::matrixFormatSparseCSC || lhs.GetFormat() == MatrixFormat::matrixFormatSparseCSR)
     {
         size_t col_num = (lhs.m_format == MatrixFormat::matrixFormatSparseCSC) ? lhs.GetNumCols() : lhs.GetNumRows();
-        for (size_t j = 0; j < col_num; j++)
+        ParallelForColumnsByNnz(lhs.m_compIndex, col_num, 1, [&](size_t jBegin, size_t jEnd)
         {
-            size_t start = lhs.m_compIndex[j];
-            size_t end = lhs.m_compIndex[j + 1];
-            for (size_t p = start; p < end; p++)
+            for (size_t j = jBegin; j < jEnd; j++)
             {
-                size_t i = lhs.m_unCompIndex[p];
-                ElemType val = lhs.m_pArray[p];
-                size_t r = (lhs.m_format == MatrixFormat::matrixFormatSparseCSC) ? i : j;
-                size_t c = (lhs.m_format == MatrixFormat::matrixFormatSparseCSC) ? j : i;
-                rhs(r, c) += alpha * val;
+                size_t start = lhs.m_compIndex[j];
+                size_t end = lhs.m_compIndex[j + 1];
+                for (size_t p = start; p < end; p++)
+                {
+                    size_t i = lhs.m_unCompIndex[p];
+                    ElemType val = lhs.m_pArray[p];
+                    size_t r = (lhs.m_format == MatrixFormat::matrixFormatSparseCSC) ? i : j;
+                    size_t c = (lhs.m_format == MatrixFormat::matrixFormatSparseCSC) ? j : i;
+                    rhs(r, c) += alpha * val;
+                }
             }
-        }
+        });
     }
     else if (lhs.m_format == MatrixFormat::matrixFormatSparseBlockCol || lhs.m_format == MatrixFormat::matrixFormatSparseBlockRow)
     {
-        for (size_t j = 0; j < lhs.m_blockSize; j++)
+        // block ids are unique, so the blocks update disjoint columns (rows) of rhs
+#pragma omp parallel for if (lhs.m_nz >= 65536)
+        for (long j = 0; j < (long) lhs.m_blockSize; j++)
         {
             size_t i = lhs.m_blockIds[j] - lhs.m_blockIdShift;
             size_t len = (lhs.m_format == MatrixFormat::matrixFormatSparseBlockCol) ? lhs.GetNumRows() : lhs.GetNumCols();
@@ -885,7 +1076,8 @@ void CPUSparseMatrix<ElemType>::NormalGrad(CPUMatrix<ElemType>& c, const ElemTyp
 
     if (m_format == MatrixFormat::matrixFormatSparseBlockCol || m_format == MatrixFormat::matrixFormatSparseBlockRow)
     {
-        for (size_t j = 0; j < m_blockSize; j++)
+#pragma omp parallel for if (m_nz >= 65536)
+        for (long j = 0; j < (long) m_blockSize; j++)
         {
             size_t i = m_blockIds[j] - m_blockIdShift;
             size_t len = (m_format == MatrixFormat::matrixFormatSparseBlockCol) ? GetNumRows() : GetNumCols();
@@ -923,36 +1115,44 @@ ElemType CPUSparseMatrix<ElemType>::Adagrad(CPUMatrix<ElemType>& c, const bool n
     if (m_format == MatrixFormat::matrixFormatSparseCSC || m_format == MatrixFormat::matrixFormatSparseCSR)
     {
         size_t col_num = (m_format == MatrixFormat::matrixFormatSparseCSC) ? GetNumCols() : GetNumRows();
-        for (size_t j = 0; j < col_num; j++)
+        ParallelForColumnsByNnz(m_compIndex, col_num, 1, [&](size_t jBegin, size_t jEnd)
         {
-            size_t start = m_compIndex[j];
-            size_t end = m_compIndex[j + 1];
-            for (size_t p = start; p < end; p++)
+            ElemType rangeMultiplier = 0;
+            for (size_t j = jBegin; j < jEnd; j++)
             {
-                size_t i = m_unCompIndex[p];
-                ElemType val = m_pArray[p];
-
-                size_t row = (m_format == MatrixFormat::matrixFormatSparseCSC) ? i : j;
-                size_t col = (m_format == MatrixFormat::matrixFormatSparseCSC) ? j : i;
-                ElemType adenorm = c(row, col);
-                adenorm += val * val;
-                ElemType a = sqrt(floor + adenorm);
-                m_pArray[p] = val / a;
-                c(row, col) = adenorm;
-
-                if (needAveMultiplier)
-                    aveMultiplier += 1 / a;
+                size_t start = m_compIndex[j];
+                size_t end = m_compIndex[j + 1];
+                for (size_t p = start; p < end; p++)
+                {
+                    size_t i = m_unCompIndex[p];
+                    ElemType val = m_pArray[p];
+
+                    size_t row = (m_format == MatrixFormat::matrixFormatSparseCSC) ? i : j;
+                    size_t col = (m_format == MatrixFormat::matrixFormatSparseCSC) ? j : i;
+                    ElemType adenorm = c(row, col);
+                    adenorm += val * val;
+                    ElemType a = sqrt(floor + adenorm);
+                    m_pArray[p] = val / a;
+                    c(row, col) = adenorm;
+
+                    if (needAveMultiplier)
+                        rangeMultiplier += 1 / a;
+                }
             }
-        }
+#pragma omp atomic
+            aveMultiplier += rangeMultiplier;
+        });
     }
     else if (m_format == MatrixFormat::matrixFormatSparseBlockCol || m_format == MatrixFormat::matrixFormatSparseBlockRow)
     {
+        // block ids are unique, so the blocks update disjoint columns (rows) of c
         size_t len = (m_format == MatrixFormat::matrixFormatSparseBlockCol) ? GetNumRows() : GetNumCols();
-        size_t p = 0;
-        for (long j = 0; j < m_blockSize; j++)
+#pragma omp parallel for reduction(+ : aveMultiplier) if (m_nz >= 65536)
+        for (long j = 0; j < (long) m_blockSize; j++)
         {
             size_t colOrRow = m_blockIds[j] - m_blockIdShift;
-            for (long i = 0; i < len; i++, p++)
+            size_t p = j * len;
+            for (long i = 0; i < (long) len; i++, p++)
             {
                 ElemType val = m_pArray[p];
 
@@ -974,6 +1174,62 @@ ElemType CPUSparseMatrix<ElemType>::Adagrad(CPUMatrix<ElemType>& c, const bool n
         return 1;
 }
 
+// lazy updates of the columns of block-column gradients, see Matrix::LazyNormalGrad()
+// c has one more row than this, which holds the step of the last update of each column.
+template <class ElemType>
+void CPUSparseMatrix<ElemType>::LazyNormalGrad(size_t step, CPUMatrix<ElemType>& c, CPUMatrix<ElemType>& functionValues, const ElemType learnRatePerSample, const ElemType momentum, const ElemType l2Weight)
+{
+    if (m_format != MatrixFormat::matrixFormatSparseBlockCol)
+        RuntimeError("CPUSparseMatrix::LazyNormalGrad() only supports the block column format.");
+
+    const size_t numRows = GetNumRows();
+#pragma omp parallel for if (m_nz >= 65536)
+    for (long j = 0; j < (long) m_blockSize; j++)
+    {
+        size_t col = m_blockIds[j] - m_blockIdShift;
+        size_t numSkipped = LazyNumSkippedSteps(c(numRows, col), step);
+        const ElemType* g = m_pArray + j * numRows;
+        for (size_t row = 0; row < numRows; row++)
+            LazyNormalGradElement(c(row, col), functionValues(row, col), g[row], learnRatePerSample, momentum, l2Weight, numSkipped);
+        c(numRows, col) = (ElemType) step;
+    }
+}
+
+template <class ElemType>
+void CPUSparseMatrix<ElemType>::LazyAdagrad(size_t step, CPUMatrix<ElemType>& c, CPUMatrix<ElemType>& functionValues, const ElemType learnRatePerSample, const ElemType l2Weight, const bool needAveMultiplier)
+{
+    if (m_format != MatrixFormat::matrixFormatSparseBlockCol)
+        RuntimeError("CPUSparseMatrix::LazyAdagrad() only supports the block column format.");
+
+    const size_t numRows = GetNumRows();
+    ElemType aveMultiplier = 1;
+    if (needAveMultiplier && m_nz > 0)
+    {
+        ElemType sumMultipliers = 0;
+#pragma omp parallel for reduction(+ : sumMultipliers) if (m_nz >= 65536)
+        for (long j = 0; j < (long) m_blockSize; j++)
+        {
+            size_t col = m_blockIds[j] - m_blockIdShift;
+            const ElemType* g = m_pArray + j * numRows;
+            for (size_t row = 0; row < numRows; row++)
+                sumMultipliers += LazyAdagradMultiplier(c(row, col), functionValues(row, col), g[row], l2Weight);
+        }
+        aveMultiplier = sumMultipliers / m_nz;
+    }
+
+    const ElemType learnRate = learnRatePerSample / aveMultiplier;
+#pragma omp parallel for if (m_nz >= 65536)
+    for (long j = 0; j < (long) m_blockSize; j++)
+    {
+        size_t col = m_blockIds[j] - m_blockIdShift;
+        size_t numSkipped = LazyNumSkippedSteps(c(numRows, col), step);
+        const ElemType* g = m_pArray + j * numRows;
+        for (size_t row = 0; row < numRows; row++)
+            LazyAdagradElement(c(row, col), functionValues(row, col), g[row], learnRate, l2Weight, numSkipped);
+        c(numRows, col) = (ElemType) step;
+    }
+}
+
 template <class ElemType>
 CPUSparseMatrix<ElemType>& CPUSparseMatrix<ElemType>::InplaceTruncateTop(const ElemType threshold)
 {
@@ -87,9 +87,19 @@ public:
     void SetMatrixFromCSCFormat(const CPUSPARSE_INDEX_TYPE* h_CSCCol, const CPUSPARSE_INDEX_TYPE* h_Row, const ElemType* h_Val,
                                 const size_t nz, const size_t numRows, const size_t numCols);
 
+    // block column format: the ids of the 'numBlocks' columns that have values, and the values of these columns
+    void SetMatrixFromBlockColFormat(const size_t* h_ColIds, const ElemType* h_Val, const size_t numBlocks, const size_t numRows, const size_t numCols);
+    void GetMatrixFromBlockColFormat(std::vector<size_t>& colIds, std::vector<ElemType>& values) const;
+
+    // CSC with a 1 in each column j, in row ids[j]
+    void AssignOneHotColumnsOf(const CPUMatrix<ElemType>& ids, const size_t numRows);
+
     static void MultiplyAndWeightedAdd(ElemType alpha, const CPUMatrix<ElemType>& lhs, const bool transposeA,
                                        const CPUSparseMatrix<ElemType>& rhs, const bool transposeB, ElemType beta, CPUMatrix<ElemType>& c);
 
+    static void MultiplyAndWeightedAdd(ElemType alpha, const CPUSparseMatrix<ElemType>& lhs, const bool transposeA,
+                                       const CPUMatrix<ElemType>& rhs, const bool transposeB, ElemType beta, CPUMatrix<ElemType>& c);
+
     static void MultiplyAndAdd(ElemType alpha, const CPUMatrix<ElemType>& lhs, const bool transposeA,
                                const CPUSparseMatrix<ElemType>& rhs, const bool transposeB, CPUSparseMatrix<ElemType>& c);
 
@@ -153,6 +163,8 @@ public:
 public:
     void NormalGrad(CPUMatrix<ElemType>& c, const ElemType momentum);
     ElemType Adagrad(CPUMatrix<ElemType>& c, const bool needAveMultiplier);
+    void LazyNormalGrad(size_t step, CPUMatrix<ElemType>& c, CPUMatrix<ElemType>& functionValues, const ElemType learnRatePerSample, const ElemType momentum, const ElemType l2Weight);
+    void LazyAdagrad(size_t step, CPUMatrix<ElemType>& c, CPUMatrix<ElemType>& functionValues, const ElemType learnRatePerSample, const ElemType l2Weight, const bool needAveMultiplier);
 
 public:
     CPUSparseMatrix<ElemType>& InplaceTruncateTop(const ElemType threshold);
@@ -0,0 +1,77 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// CPUThreadBudget.h -- per-caller limits on the CPU threads of OpenMP loops and BLAS calls
+//
+
+#pragma once
+
+#include "Basics.h"
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+#ifdef _WIN32
+#ifdef MATH_EXPORTS
+#define MATH_API __declspec(dllexport)
+#else
+#define MATH_API __declspec(dllimport)
+#endif
+#else // no DLLs on Linux
+#define MATH_API
+#endif
+
+// -----------------------------------------------------------------------
+// CPUThreadBudget -- the threads and cores that one user of the CPU math may take
+//
+// CPUMatrix::SetNumThreads() is process-wide. When a process serves several
+// models, each would use all threads, and they slow each other down. A
+// budget instead applies to the thread that enters a Scope: its OpenMP
+// loops use at most GetNumThreads() threads, and these threads only run on
+// GetCores(). With MKL, GEMMs and other MKL calls use the same number of
+// threads (mkl_set_num_threads_local()), as do ACML calls, which run on
+// OpenMP. OpenBLAS only has a process-wide thread count.
+//
+// The OpenMP threads started by a thread are rebound to the cores when a
+// different budget than last time enters a Scope on that thread; the
+// calling thread's own affinity is restored when the Scope ends.
+// -----------------------------------------------------------------------
+
+#pragma warning(push)
+#pragma warning(disable : 4251) // needs to have dll-interface to be used by clients of... (std::vector)
+
+class MATH_API CPUThreadBudget
+{
+public:
+    // numThreads = 0 keeps the process-wide thread count; no cores keeps the affinity
+    CPUThreadBudget(int numThreads = 0, const std::vector<int>& cores = std::vector<int>());
+
+    int GetNumThreads() const { return m_numThreads; }
+    const std::vector<int>& GetCores() const { return m_cores; }
+
+    // applies the budget to the calling thread until destructed
+    class MATH_API Scope
+    {
+    public:
+        Scope(const CPUThreadBudget& budget);
+        ~Scope();
+
+        DISABLE_COPY_AND_MOVE(Scope);
+
+    private:
+        const CPUThreadBudget& m_budget;
+        int m_prevNumThreads;
+        int m_prevBlasNumThreads;
+        std::vector<unsigned char> m_prevAffinity; // (platform-specific) affinity of the calling thread, empty if unchanged
+    };
+
+private:
+    int m_numThreads;
+    std::vector<int> m_cores;
+    size_t m_id; // identifies the budget that the OpenMP threads of a thread were bound for
+};
+
+#pragma warning(pop)
+
+} } }
@@ -0,0 +1,163 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// CPUVectorKernels.cpp -- instruction set detection, and the SSE2 kernels (x64 baseline)
+//
+
+#include "stdafx.h"
+#include "Basics.h"
+#include "CPUVectorKernels.h"
+#include "CPUVectorKernelsImpl.h"
+#include <emmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+struct SSE2Traits
+{
+    typedef __m128 Reg;
+    typedef __m128i IReg;
+    typedef __m128 Mask;
+    enum { Width = 4 };
+
+    static Reg Load(const float* p) { return _mm_loadu_ps(p); }
+    static void Store(float* p, Reg x) { _mm_storeu_ps(p, x); }
+    static Reg Set(float v) { return _mm_set1_ps(v); }
+    static IReg ISet(int v) { return _mm_set1_epi32(v); }
+
+    static Reg Add(Reg a, Reg b) { return _mm_add_ps(a, b); }
+    static Reg Sub(Reg a, Reg b) { return _mm_sub_ps(a, b); }
+    static Reg Mul(Reg a, Reg b) { return _mm_mul_ps(a, b); }
+    static Reg Div(Reg a, Reg b) { return _mm_div_ps(a, b); }
+    static Reg FMAdd(Reg a, Reg b, Reg c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+    static Reg Min(Reg a, Reg b) { return _mm_min_ps(a, b); }
+    static Reg Max(Reg a, Reg b) { return _mm_max_ps(a, b); }
+    // SSE2 has no rounding instruction: truncate, then correct the negative non-integers
+    static Reg Floor(Reg x)
+    {
+        Reg t = _mm_cvtepi32_ps(_mm_cvttps_epi32(x));
+        return _mm_sub_ps(t, _mm_and_ps(_mm_cmpgt_ps(t, x), _mm_set1_ps(1.0f)));
+    }
+
+    static Mask CmpLT(Reg a, Reg b) { return _mm_cmplt_ps(a, b); }
+    static Mask CmpNotLE(Reg a, Reg b) { return _mm_cmpnle_ps(a, b); }
+    static Reg Select(Mask m, Reg a, Reg b) { return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b)); }
+
+    static IReg AsInt(Reg x) { return _mm_castps_si128(x); }
+    static Reg AsFloat(IReg x) { return _mm_castsi128_ps(x); }
+    static IReg IAnd(IReg a, IReg b) { return _mm_and_si128(a, b); }
+    static IReg IOr(IReg a, IReg b) { return _mm_or_si128(a, b); }
+    static IReg IAdd(IReg a, IReg b) { return _mm_add_epi32(a, b); }
+    static IReg ISub(IReg a, IReg b) { return _mm_sub_epi32(a, b); }
+    static IReg IShiftLeft23(IReg x) { return _mm_slli_epi32(x, 23); }
+    static IReg IShiftRight23(IReg x) { return _mm_srli_epi32(x, 23); }
+    static IReg ToInt(Reg x) { return _mm_cvttps_epi32(x); }
+    static Reg ToFloat(IReg x) { return _mm_cvtepi32_ps(x); }
+
+    static int32_t DotInt8(const int8_t* a, const int8_t* b, size_t n)
+    {
+        __m128i acc = _mm_setzero_si128();
+        size_t i = 0;
+        for (; i + 16 <= n; i += 16)
+        {
+            __m128i va = _mm_loadu_si128((const __m128i*) (a + i));
+            __m128i vb = _mm_loadu_si128((const __m128i*) (b + i));
+            // SSE2 cannot sign-extend bytes: move them into the upper half of 16-bit lanes, then shift arithmetically
+            __m128i zero = _mm_setzero_si128();
+            __m128i aLo = _mm_srai_epi16(_mm_unpacklo_epi8(zero, va), 8);
+            __m128i aHi = _mm_srai_epi16(_mm_unpackhi_epi8(zero, va), 8);
+            __m128i bLo = _mm_srai_epi16(_mm_unpacklo_epi8(zero, vb), 8);
+            __m128i bHi = _mm_srai_epi16(_mm_unpackhi_epi8(zero, vb), 8);
+            acc = _mm_add_epi32(acc, _mm_add_epi32(_mm_madd_epi16(aLo, bLo), _mm_madd_epi16(aHi, bHi)));
+        }
+        int32_t buf[4];
+        _mm_storeu_si128((__m128i*) buf, acc);
+        int32_t sum = buf[0] + buf[1] + buf[2] + buf[3];
+        for (; i < n; i++)
+            sum += (int32_t) a[i] * b[i];
+        return sum;
+    }
+};
+
+static void CpuId(int info[4], int function, int subfunction)
+{
+#ifdef _MSC_VER
+    __cpuidex(info, function, subfunction);
+#else
+    unsigned int a, b, c, d;
+    __cpuid_count(function, subfunction, a, b, c, d);
+    info[0] = (int) a, info[1] = (int) b, info[2] = (int) c, info[3] = (int) d;
+#endif
+}
+
+// which register states the OS saves on context switches
+static unsigned long long GetEnabledRegisterStates()
+{
+#ifdef _MSC_VER
+    return _xgetbv(0);
+#else
+    unsigned int eax, edx;
+    __asm__ __volatile__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return ((unsigned long long) edx << 32) | eax;
+#endif
+}
+
+static CPUInstructionSet DetectInstructionSet()
+{
+    int info[4];
+    CpuId(info, 0, 0);
+    const int maxFunction = info[0];
+    CpuId(info, 1, 0);
+    const bool hasFma = (info[2] & (1 << 12)) != 0;
+    const bool hasOSXSave = (info[2] & (1 << 27)) != 0;
+    const bool hasAvx = (info[2] & (1 << 28)) != 0;
+    if (maxFunction < 7 || !hasOSXSave || !hasAvx || !hasFma)
+        return CPUInstructionSet::SSE2;
+    const unsigned long long registerStates = GetEnabledRegisterStates();
+    if ((registerStates & 0x6) != 0x6) // XMM and YMM
+        return CPUInstructionSet::SSE2;
+    CpuId(info, 7, 0);
+    const bool hasAvx2 = (info[1] & (1 << 5)) != 0;
+    const bool hasAvx512F = (info[1] & (1 << 16)) != 0;
+    if (!hasAvx2)
+        return CPUInstructionSet::SSE2;
+    if (hasAvx512F && (registerStates & 0xe6) == 0xe6 && GetAVX512VectorKernels() != nullptr) // plus opmask and ZMM
+        return CPUInstructionSet::AVX512;
+    if (GetAVX2VectorKernels() != nullptr)
+        return CPUInstructionSet::AVX2;
+    return CPUInstructionSet::SSE2;
+}
+
+/*static*/ CPUInstructionSet CPUVectorKernels::GetSupportedInstructionSet()
+{
+    static const CPUInstructionSet instructionSet = DetectInstructionSet();
+    return instructionSet;
+}
+
+/*static*/ const size_t CPUVectorKernels::PackedPanelRows;
+
+/*static*/ const CPUVectorKernels& CPUVectorKernels::Get(CPUInstructionSet instructionSet)
+{
+    static const CPUVectorKernels sse2Kernels = VectorKernels<SSE2Traits>::Create();
+    if (instructionSet > GetSupportedInstructionSet())
+        RuntimeError("CPUVectorKernels: Instruction set %d is not supported by this CPU or build.", (int) instructionSet);
+    switch (instructionSet)
+    {
+    case CPUInstructionSet::SSE2:   return sse2Kernels;
+    case CPUInstructionSet::AVX2:   return *GetAVX2VectorKernels();
+    case CPUInstructionSet::AVX512: return *GetAVX512VectorKernels();
+    default: LogicError("CPUVectorKernels: Invalid instruction set %d.", (int) instructionSet);
+    }
+}
+
+/*static*/ const CPUVectorKernels& CPUVectorKernels::Get()
+{
+    static const CPUVectorKernels& kernels = Get(GetSupportedInstructionSet());
+    return kernels;
+}
+} } }
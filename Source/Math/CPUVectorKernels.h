@@ -0,0 +1,76 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#ifdef _WIN32
+#ifdef MATH_EXPORTS
+#define MATH_API __declspec(dllexport)
+#else
+#define MATH_API __declspec(dllimport)
+#endif
+#else // no DLLs on Linux
+#define MATH_API
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+// This header is also included by the translation units that are compiled for specific instruction sets
+// (CPUVectorKernelsAVX2.cpp etc.), so it must not pull in anything that defines inline functions or templates:
+// the linker may pick any instance of those, including one that uses instructions the CPU does not have.
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+enum class CPUInstructionSet : int
+{
+    SSE2 = 0,  // baseline of x64
+    AVX2 = 1,  // AVX2 and FMA3
+    AVX512 = 2 // AVX-512F
+};
+
+// -----------------------------------------------------------------------
+// CPUVectorKernels -- SIMD kernels over contiguous float arrays, used by CPUMatrix<float>
+// There is one set of kernels per instruction set; Get() returns the best one the CPU and OS
+// support, determined once via cpuid. exp() is a Cephes-style polynomial with a relative error
+// of a few ulp; log(), tanh() and the sigmoid are built on the same approximations.
+// All kernels allow 'out' to be the same array as an input.
+// -----------------------------------------------------------------------
+
+struct MATH_API CPUVectorKernels
+{
+    typedef void (*UnaryKernel)(const float* in, float* out, size_t n);
+
+    UnaryKernel Exp;
+    UnaryKernel Tanh;
+    UnaryKernel Sigmoid;                                                                      // 1 / (1 + exp(-x))
+    void (*Log)(const float* in, float* out, size_t n, float minValue, float valueBelowMin); // values below 'minValue' yield 'valueBelowMin'
+    void (*AddElementProduct)(const float* a, const float* b, float* c, size_t n);           // c += a .* b
+    void (*AddScaled)(const float* a, float alpha, float* c, size_t n);                      // c += alpha * a
+    float (*Max)(const float* in, size_t n);                                                 // n > 0
+    float (*ShiftAndSumExp)(const float* in, float shift, float* out, size_t n);              // out = in - shift; returns sum(exp(out))
+    float (*ShiftExpAndSum)(const float* in, float shift, float* out, size_t n);              // out = exp(in - shift); returns sum(out)
+    float (*MaxAndSumExp)(const float* in, size_t n, float& maxV);                           // maxV = max(in); returns sum(exp(in - maxV)) in a single read of 'in'; n > 0
+    int32_t (*DotInt8)(const int8_t* a, const int8_t* b, size_t n);                          // sum(a .* b); no overflow for values in [-127, 127] and n < 2^17
+    // c = alpha * a * op(b) + beta * c for column-major [m x k] a, op(b) [k x n] and [m x n] c, for products too small
+    // for the call overhead of BLAS; beta = 0 does not read c. Single-threaded.
+    void (*SmallGemm)(size_t m, size_t n, size_t k, float alpha, const float* a, size_t lda, const float* b, size_t ldb, bool transposeB,
+                      float beta, float* c, size_t ldc);
+    // c = a * b for one panel of a weight matrix in the layout of PackedWeightMatrix: 'panel' holds PackedPanelRows contiguous
+    // values per column of a; the first 'rows' of them are multiplied with the column-major [k x n] b. Single-threaded.
+    void (*PackedPanelGemm)(size_t rows, size_t n, size_t k, const float* panel, const float* b, size_t ldb, float* c, size_t ldc);
+
+    static const size_t PackedPanelRows = 16; // a multiple of the vector width of each instruction set
+
+    static const CPUVectorKernels& Get();
+    // throws if 'instructionSet' is not supported by this CPU
+    static const CPUVectorKernels& Get(CPUInstructionSet instructionSet);
+    static CPUInstructionSet GetSupportedInstructionSet();
+};
+
+// defined in the per-instruction-set translation units; return nullptr if the compiler cannot target the instruction set
+const CPUVectorKernels* GetAVX2VectorKernels();
+const CPUVectorKernels* GetAVX512VectorKernels();
+} } }
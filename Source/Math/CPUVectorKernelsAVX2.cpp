@@ -0,0 +1,78 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// CPUVectorKernelsAVX2.cpp -- CPUVectorKernels for AVX2 and FMA3
+// This file is compiled with AVX2 code generation (-mavx2 -mfma, /arch:AVX2). Its code must only run after
+// CPUVectorKernels has checked the CPU, so do not include anything else here (see CPUVectorKernels.h).
+//
+
+#include "CPUVectorKernels.h"
+#include "CPUVectorKernelsImpl.h"
+#include <immintrin.h>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+struct AVX2Traits
+{
+    typedef __m256 Reg;
+    typedef __m256i IReg;
+    typedef __m256 Mask;
+    enum { Width = 8 };
+
+    static Reg Load(const float* p) { return _mm256_loadu_ps(p); }
+    static void Store(float* p, Reg x) { _mm256_storeu_ps(p, x); }
+    static Reg Set(float v) { return _mm256_set1_ps(v); }
+    static IReg ISet(int v) { return _mm256_set1_epi32(v); }
+
+    static Reg Add(Reg a, Reg b) { return _mm256_add_ps(a, b); }
+    static Reg Sub(Reg a, Reg b) { return _mm256_sub_ps(a, b); }
+    static Reg Mul(Reg a, Reg b) { return _mm256_mul_ps(a, b); }
+    static Reg Div(Reg a, Reg b) { return _mm256_div_ps(a, b); }
+    static Reg FMAdd(Reg a, Reg b, Reg c) { return _mm256_fmadd_ps(a, b, c); }
+    static Reg Min(Reg a, Reg b) { return _mm256_min_ps(a, b); }
+    static Reg Max(Reg a, Reg b) { return _mm256_max_ps(a, b); }
+    static Reg Floor(Reg x) { return _mm256_floor_ps(x); }
+
+    static Mask CmpLT(Reg a, Reg b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+    static Mask CmpNotLE(Reg a, Reg b) { return _mm256_cmp_ps(a, b, _CMP_NLE_UQ); }
+    static Reg Select(Mask m, Reg a, Reg b) { return _mm256_blendv_ps(b, a, m); }
+
+    static IReg AsInt(Reg x) { return _mm256_castps_si256(x); }
+    static Reg AsFloat(IReg x) { return _mm256_castsi256_ps(x); }
+    static IReg IAnd(IReg a, IReg b) { return _mm256_and_si256(a, b); }
+    static IReg IOr(IReg a, IReg b) { return _mm256_or_si256(a, b); }
+    static IReg IAdd(IReg a, IReg b) { return _mm256_add_epi32(a, b); }
+    static IReg ISub(IReg a, IReg b) { return _mm256_sub_epi32(a, b); }
+    static IReg IShiftLeft23(IReg x) { return _mm256_slli_epi32(x, 23); }
+    static IReg IShiftRight23(IReg x) { return _mm256_srli_epi32(x, 23); }
+    static IReg ToInt(Reg x) { return _mm256_cvttps_epi32(x); }
+    static Reg ToFloat(IReg x) { return _mm256_cvtepi32_ps(x); }
+
+    static int32_t DotInt8(const int8_t* a, const int8_t* b, size_t n)
+    {
+        __m256i acc = _mm256_setzero_si256();
+        size_t i = 0;
+        for (; i + 16 <= n; i += 16)
+        {
+            __m256i va = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i*) (a + i)));
+            __m256i vb = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i*) (b + i)));
+            acc = _mm256_add_epi32(acc, _mm256_madd_epi16(va, vb));
+        }
+        int32_t buf[8];
+        _mm256_storeu_si256((__m256i*) buf, acc);
+        int32_t sum = 0;
+        for (size_t k = 0; k < 8; k++)
+            sum += buf[k];
+        for (; i < n; i++)
+            sum += (int32_t) a[i] * b[i];
+        return sum;
+    }
+};
+
+const CPUVectorKernels* GetAVX2VectorKernels()
+{
+    static const CPUVectorKernels kernels = VectorKernels<AVX2Traits>::Create();
+    return &kernels;
+}
+} } }
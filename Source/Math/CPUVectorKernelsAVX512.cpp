@@ -0,0 +1,96 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// CPUVectorKernelsAVX512.cpp -- CPUVectorKernels for AVX-512F
+// This file is compiled with AVX-512 code generation (-mavx512f) if the compiler supports it. Its code must only
+// run after CPUVectorKernels has checked the CPU, so do not include anything else here (see CPUVectorKernels.h).
+//
+
+#include "CPUVectorKernels.h"
+
+// Visual Studio has AVX-512 intrinsics from VS 2015 on; gcc defines __AVX512F__ when compiling with -mavx512f
+#if defined(__AVX512F__) || (defined(_MSC_VER) && _MSC_VER >= 1900)
+#define HAS_AVX512_KERNELS
+#include "CPUVectorKernelsImpl.h"
+#include <immintrin.h>
+#endif
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+#ifdef HAS_AVX512_KERNELS
+
+struct AVX512Traits
+{
+    typedef __m512 Reg;
+    typedef __m512i IReg;
+    typedef __mmask16 Mask;
+    enum { Width = 16 };
+
+    static Reg Load(const float* p) { return _mm512_loadu_ps(p); }
+    static void Store(float* p, Reg x) { _mm512_storeu_ps(p, x); }
+    static Reg Set(float v) { return _mm512_set1_ps(v); }
+    static IReg ISet(int v) { return _mm512_set1_epi32(v); }
+
+    static Reg Add(Reg a, Reg b) { return _mm512_add_ps(a, b); }
+    static Reg Sub(Reg a, Reg b) { return _mm512_sub_ps(a, b); }
+    static Reg Mul(Reg a, Reg b) { return _mm512_mul_ps(a, b); }
+    static Reg Div(Reg a, Reg b) { return _mm512_div_ps(a, b); }
+    static Reg FMAdd(Reg a, Reg b, Reg c) { return _mm512_fmadd_ps(a, b, c); }
+    // min/max with the same NaN behavior as SSE/AVX
+    static Reg Min(Reg a, Reg b) { return _mm512_mask_blend_ps(_mm512_cmp_ps_mask(a, b, _CMP_LT_OQ), b, a); }
+    static Reg Max(Reg a, Reg b) { return _mm512_mask_blend_ps(_mm512_cmp_ps_mask(a, b, _CMP_GT_OQ), b, a); }
+    static Reg Floor(Reg x) { return _mm512_roundscale_ps(x, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC); }
+
+    static Mask CmpLT(Reg a, Reg b) { return _mm512_cmp_ps_mask(a, b, _CMP_LT_OQ); }
+    static Mask CmpNotLE(Reg a, Reg b) { return _mm512_cmp_ps_mask(a, b, _CMP_NLE_UQ); }
+    static Reg Select(Mask m, Reg a, Reg b) { return _mm512_mask_blend_ps(m, b, a); }
+
+    static IReg AsInt(Reg x) { return _mm512_castps_si512(x); }
+    static Reg AsFloat(IReg x) { return _mm512_castsi512_ps(x); }
+    static IReg IAnd(IReg a, IReg b) { return _mm512_and_si512(a, b); }
+    static IReg IOr(IReg a, IReg b) { return _mm512_or_si512(a, b); }
+    static IReg IAdd(IReg a, IReg b) { return _mm512_add_epi32(a, b); }
+    static IReg ISub(IReg a, IReg b) { return _mm512_sub_epi32(a, b); }
+    static IReg IShiftLeft23(IReg x) { return _mm512_slli_epi32(x, 23); }
+    static IReg IShiftRight23(IReg x) { return _mm512_srli_epi32(x, 23); }
+    static IReg ToInt(Reg x) { return _mm512_cvttps_epi32(x); }
+    static Reg ToFloat(IReg x) { return _mm512_cvtepi32_ps(x); }
+
+    // without AVX-512BW there is no 16-bit multiply-add, so the bytes are widened to 32 bits
+    static int32_t DotInt8(const int8_t* a, const int8_t* b, size_t n)
+    {
+        __m512i acc = _mm512_setzero_si512();
+        size_t i = 0;
+        for (; i + 16 <= n; i += 16)
+        {
+            __m512i va = _mm512_cvtepi8_epi32(_mm_loadu_si128((const __m128i*) (a + i)));
+            __m512i vb = _mm512_cvtepi8_epi32(_mm_loadu_si128((const __m128i*) (b + i)));
+            acc = _mm512_add_epi32(acc, _mm512_mullo_epi32(va, vb));
+        }
+        int32_t buf[16];
+        _mm512_storeu_si512(buf, acc);
+        int32_t sum = 0;
+        for (size_t k = 0; k < 16; k++)
+            sum += buf[k];
+        for (; i < n; i++)
+            sum += (int32_t) a[i] * b[i];
+        return sum;
+    }
+};
+
+const CPUVectorKernels* GetAVX512VectorKernels()
+{
+    static const CPUVectorKernels kernels = VectorKernels<AVX512Traits>::Create();
+    return &kernels;
+}
+
+#else
+
+const CPUVectorKernels* GetAVX512VectorKernels()
+{
+    return nullptr;
+}
+
+#endif
+} } }
@@ -0,0 +1,441 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// CPUVectorKernelsImpl.h -- the kernels of CPUVectorKernels, written once against a traits class V that wraps
+// the intrinsics of one instruction set. Included only by the translation unit of that instruction set.
+// Like CPUVectorKernels.h, this must only contain templates that are instantiated with the traits class,
+// so that nothing compiled for a wider instruction set can leak into code that runs on any CPU.
+//
+// V provides:
+//  - types Reg (float vector), IReg (int32 vector), Mask (result of comparisons), and enum value Width
+//  - Load, Store (unaligned), Set, ISet
+//  - Add, Sub, Mul, Div, FMAdd(a, b, c) = a * b + c, Min, Max, Floor
+//    (Min and Max return the second operand if either one is NaN, like the x86 instructions)
+//  - CmpLT(a, b) = a < b, CmpNotLE(a, b) = !(a <= b), Select(m, a, b) = m ? a : b
+//  - AsInt, AsFloat (bit casts), IAnd, IOr, IAdd, ISub, IShiftLeft23, IShiftRight23 (logical), ToInt, ToFloat
+//  - DotInt8, the int8 kernel of CPUVectorKernels, which does not fit the float abstraction above
+//
+
+#pragma once
+
+#include "CPUVectorKernels.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+template <class V>
+struct VectorMath
+{
+    typedef typename V::Reg Reg;
+    typedef typename V::IReg IReg;
+    typedef typename V::Mask Mask;
+
+    static Reg Abs(Reg x)
+    {
+        return V::AsFloat(V::IAnd(V::AsInt(x), V::ISet(0x7fffffff)));
+    }
+    // 'x' must be non-negative
+    static Reg CopySign(Reg x, Reg sign)
+    {
+        return V::AsFloat(V::IOr(V::AsInt(x), V::IAnd(V::AsInt(sign), V::ISet((int) 0x80000000))));
+    }
+
+    // Cephes expf(): exp(x) = 2^n * exp(g) with |g| <= ln(2)/2, where exp(g) is a polynomial.
+    // Results below the smallest normalized float are flushed to 0, results near or above FLT_MAX are +inf.
+    static Reg Exp(Reg x)
+    {
+        Reg overflow = V::Select(V::CmpLT(V::Set(88.3762626647949f), x), V::AsFloat(V::ISet(0x7f800000)), V::Set(0.0f));
+        // the clipping bounds go first so that NaNs propagate
+        x = V::Min(V::Set(88.3762626647949f), V::Max(V::Set(-88.3762626647949f), x));
+        Reg n = V::Floor(V::FMAdd(x, V::Set(1.44269504088896341f), V::Set(0.5f)));
+        // g = x - n * ln(2), with ln(2) split into two parts for precision
+        x = V::Sub(x, V::Mul(n, V::Set(0.693359375f)));
+        x = V::Add(x, V::Mul(n, V::Set(2.12194440e-4f)));
+        Reg y = V::Set(1.9875691500E-4f);
+        y = V::FMAdd(y, x, V::Set(1.3981999507E-3f));
+        y = V::FMAdd(y, x, V::Set(8.3334519073E-3f));
+        y = V::FMAdd(y, x, V::Set(4.1665795894E-2f));
+        y = V::FMAdd(y, x, V::Set(1.6666665459E-1f));
+        y = V::FMAdd(y, x, V::Set(5.0000001201E-1f));
+        y = V::FMAdd(y, V::Mul(x, x), V::Add(x, V::Set(1.0f)));
+        Reg pow2n = V::AsFloat(V::IShiftLeft23(V::IAdd(V::ToInt(n), V::ISet(127))));
+        return V::Add(V::Mul(y, pow2n), overflow);
+    }
+
+    // Cephes logf(): log(x) = e * ln(2) + log(m) with m in [sqrt(1/2), sqrt(2)), where log(m) is a polynomial.
+    // 'x' must be a positive normalized float; +inf and NaN are passed through.
+    static Reg Log(Reg x)
+    {
+        IReg xi = V::AsInt(x);
+        Reg e = V::ToFloat(V::ISub(V::IShiftRight23(xi), V::ISet(126)));
+        Reg m = V::AsFloat(V::IOr(V::IAnd(xi, V::ISet(0x007fffff)), V::ISet(0x3f000000))); // in [0.5, 1)
+        // if m < sqrt(1/2) then e = e - 1, m = 2 * m - 1 else m = m - 1
+        Mask isSmall = V::CmpLT(m, V::Set(0.707106781186547524f));
+        e = V::Sub(e, V::Select(isSmall, V::Set(1.0f), V::Set(0.0f)));
+        m = V::Sub(V::Add(m, V::Select(isSmall, m, V::Set(0.0f))), V::Set(1.0f));
+        Reg z = V::Mul(m, m);
+        Reg y = V::Set(7.0376836292E-2f);
+        y = V::FMAdd(y, m, V::Set(-1.1514610310E-1f));
+        y = V::FMAdd(y, m, V::Set(1.1676998740E-1f));
+        y = V::FMAdd(y, m, V::Set(-1.2420140846E-1f));
+        y = V::FMAdd(y, m, V::Set(1.4249322787E-1f));
+        y = V::FMAdd(y, m, V::Set(-1.6668057665E-1f));
+        y = V::FMAdd(y, m, V::Set(2.0000714765E-1f));
+        y = V::FMAdd(y, m, V::Set(-2.4999993993E-1f));
+        y = V::FMAdd(y, m, V::Set(3.3333331174E-1f));
+        y = V::Mul(V::Mul(y, m), z);
+        y = V::FMAdd(e, V::Set(-2.12194440e-4f), y);
+        y = V::FMAdd(z, V::Set(-0.5f), y);
+        Reg res = V::FMAdd(e, V::Set(0.693359375f), V::Add(m, y));
+        return V::Select(V::CmpNotLE(x, V::Set(3.402823466e+38f)), x, res);
+    }
+
+    // Cephes tanhf(): an odd polynomial for |x| < 0.625, which avoids the cancellation in 1 - 2 / (exp(2x) + 1)
+    static Reg Tanh(Reg x)
+    {
+        Reg ax = Abs(x);
+        Reg z = V::Mul(x, x);
+        Reg p = V::Set(-5.70498872745E-3f);
+        p = V::FMAdd(p, z, V::Set(2.06390887954E-2f));
+        p = V::FMAdd(p, z, V::Set(-5.37397155531E-2f));
+        p = V::FMAdd(p, z, V::Set(1.33314422036E-1f));
+        p = V::FMAdd(p, z, V::Set(-3.33332819422E-1f));
+        Reg small = V::FMAdd(V::Mul(p, z), x, x);
+        Reg large = V::Sub(V::Set(1.0f), V::Div(V::Set(2.0f), V::Add(Exp(V::Add(ax, ax)), V::Set(1.0f))));
+        return V::Select(V::CmpLT(ax, V::Set(0.625f)), small, CopySign(large, x));
+    }
+
+    // same formulation as the scalar CPUMatrix::AssignSigmoidOf(): exp() is only applied to non-positive values
+    static Reg Sigmoid(Reg x)
+    {
+        Reg e = Exp(V::Sub(V::Set(0.0f), Abs(x)));
+        Reg num = V::Select(V::CmpLT(x, V::Set(0.0f)), e, V::Set(1.0f));
+        return V::Div(num, V::Add(e, V::Set(1.0f)));
+    }
+
+    static Reg Log(Reg x, Reg minValue, Reg valueBelowMin)
+    {
+        return V::Select(V::CmpLT(x, minValue), valueBelowMin, Log(x));
+    }
+};
+
+template <class V>
+struct VectorKernels
+{
+    typedef typename V::Reg Reg;
+    typedef VectorMath<V> M;
+
+    // Apply 'f' to all elements. The tail goes through a full-width buffer so that every element
+    // is computed by the same code, independent of its position.
+    template <class F>
+    static void Map(const float* in, float* out, size_t n, F f)
+    {
+        size_t i = 0;
+        for (; i + V::Width <= n; i += V::Width)
+            V::Store(out + i, f(V::Load(in + i)));
+        if (i < n)
+        {
+            float buf[V::Width];
+            for (size_t k = 0; k < V::Width; k++)
+                buf[k] = i + k < n ? in[i + k] : 0.0f;
+            V::Store(buf, f(V::Load(buf)));
+            for (size_t k = 0; i + k < n; k++)
+                out[i + k] = buf[k];
+        }
+    }
+
+    static void Exp(const float* in, float* out, size_t n)
+    {
+        Map(in, out, n, [](Reg x) { return M::Exp(x); });
+    }
+    static void Tanh(const float* in, float* out, size_t n)
+    {
+        Map(in, out, n, [](Reg x) { return M::Tanh(x); });
+    }
+    static void Sigmoid(const float* in, float* out, size_t n)
+    {
+        Map(in, out, n, [](Reg x) { return M::Sigmoid(x); });
+    }
+    static void Log(const float* in, float* out, size_t n, float minValue, float valueBelowMin)
+    {
+        Reg minV = V::Set(minValue);
+        Reg belowV = V::Set(valueBelowMin);
+        Map(in, out, n, [=](Reg x) { return M::Log(x, minV, belowV); });
+    }
+
+    static void AddElementProduct(const float* a, const float* b, float* c, size_t n)
+    {
+        size_t i = 0;
+        for (; i + V::Width <= n; i += V::Width)
+            V::Store(c + i, V::FMAdd(V::Load(a + i), V::Load(b + i), V::Load(c + i)));
+        for (; i < n; i++)
+            c[i] += a[i] * b[i];
+    }
+
+    static void AddScaled(const float* a, float alpha, float* c, size_t n)
+    {
+        Reg alphaV = V::Set(alpha);
+        size_t i = 0;
+        for (; i + V::Width <= n; i += V::Width)
+            V::Store(c + i, V::FMAdd(V::Load(a + i), alphaV, V::Load(c + i)));
+        for (; i < n; i++)
+            c[i] += a[i] * alpha;
+    }
+
+    static float Max(const float* in, size_t n)
+    {
+        float res = in[0];
+        size_t i = 0;
+        if (n >= V::Width)
+        {
+            Reg acc = V::Load(in);
+            for (i = V::Width; i + V::Width <= n; i += V::Width)
+                acc = V::Max(acc, V::Load(in + i));
+            float buf[V::Width];
+            V::Store(buf, acc);
+            for (size_t k = 0; k < V::Width; k++)
+                res = buf[k] > res ? buf[k] : res;
+        }
+        for (; i < n; i++)
+            res = in[i] > res ? in[i] : res;
+        return res;
+    }
+
+    static float ShiftAndSumExp(const float* in, float shift, float* out, size_t n)
+    {
+        Reg shiftV = V::Set(shift);
+        Reg acc = V::Set(0.0f);
+        size_t i = 0;
+        for (; i + V::Width <= n; i += V::Width)
+        {
+            Reg x = V::Sub(V::Load(in + i), shiftV);
+            V::Store(out + i, x);
+            acc = V::Add(acc, M::Exp(x));
+        }
+        float buf[V::Width];
+        V::Store(buf, acc);
+        float sum = 0;
+        for (size_t k = 0; k < V::Width; k++)
+            sum += buf[k];
+        if (i < n)
+        {
+            for (size_t k = 0; k < V::Width; k++)
+                buf[k] = i + k < n ? in[i + k] - shift : 0.0f;
+            for (size_t k = 0; i + k < n; k++)
+                out[i + k] = buf[k];
+            V::Store(buf, M::Exp(V::Load(buf)));
+            for (size_t k = 0; i + k < n; k++)
+                sum += buf[k];
+        }
+        return sum;
+    }
+
+    static float ShiftExpAndSum(const float* in, float shift, float* out, size_t n)
+    {
+        Reg shiftV = V::Set(shift);
+        Reg acc = V::Set(0.0f);
+        size_t i = 0;
+        for (; i + V::Width <= n; i += V::Width)
+        {
+            Reg e = M::Exp(V::Sub(V::Load(in + i), shiftV));
+            V::Store(out + i, e);
+            acc = V::Add(acc, e);
+        }
+        float buf[V::Width];
+        V::Store(buf, acc);
+        float sum = 0;
+        for (size_t k = 0; k < V::Width; k++)
+            sum += buf[k];
+        if (i < n)
+        {
+            for (size_t k = 0; k < V::Width; k++)
+                buf[k] = i + k < n ? in[i + k] - shift : 0.0f;
+            V::Store(buf, M::Exp(V::Load(buf)));
+            for (size_t k = 0; i + k < n; k++)
+                sum += out[i + k] = buf[k];
+        }
+        return sum;
+    }
+
+    // online normalizer: every lane keeps a running maximum and the sum of exp() relative to it. The sum is
+    // rescaled once per block of 4 vectors, to the maximum of the block, so this costs 1.25 exp() per element.
+    static float MaxAndSumExp(const float* in, size_t n, float& maxV)
+    {
+        const size_t blockSize = 4 * V::Width;
+        Reg m = V::Set(in[0]);
+        Reg s = V::Set(0.0f);
+        size_t i = 0;
+        for (; i + blockSize <= n; i += blockSize)
+        {
+            Reg x0 = V::Load(in + i);
+            Reg x1 = V::Load(in + i + V::Width);
+            Reg x2 = V::Load(in + i + 2 * V::Width);
+            Reg x3 = V::Load(in + i + 3 * V::Width);
+            Reg newM = V::Max(V::Max(m, V::Max(x0, x1)), V::Max(x2, x3));
+            Reg e = V::Add(V::Add(M::Exp(V::Sub(x0, newM)), M::Exp(V::Sub(x1, newM))),
+                           V::Add(M::Exp(V::Sub(x2, newM)), M::Exp(V::Sub(x3, newM))));
+            s = V::FMAdd(s, M::Exp(V::Sub(m, newM)), e);
+            m = newM;
+        }
+        float buf[V::Width];
+        V::Store(buf, m);
+        maxV = buf[0];
+        for (size_t k = 1; k < V::Width; k++)
+            maxV = buf[k] > maxV ? buf[k] : maxV;
+        for (size_t k = i; k < n; k++)
+            maxV = in[k] > maxV ? in[k] : maxV;
+        // bring the lanes to the common maximum
+        V::Store(buf, V::Mul(s, M::Exp(V::Sub(m, V::Set(maxV)))));
+        float sum = 0;
+        for (size_t k = 0; k < V::Width; k++)
+            sum += buf[k];
+        for (; i < n; i += V::Width)
+        {
+            for (size_t k = 0; k < V::Width; k++)
+                buf[k] = i + k < n ? in[i + k] - maxV : 0.0f;
+            V::Store(buf, M::Exp(V::Load(buf)));
+            for (size_t k = 0; k < V::Width && i + k < n; k++)
+                sum += buf[k];
+        }
+        return sum;
+    }
+
+    // Register-blocked product: each block of R vectors of rows times NC columns of c is accumulated in R * NC
+    // registers over all of k, reading a column of a and broadcasting NC elements of b per step.
+    template <size_t R, size_t NC>
+    static void SmallGemmBlock(size_t i, size_t j, size_t k, float alpha, const float* a, size_t lda, const float* b, size_t bRowStride, size_t bColStride,
+                               float beta, float* c, size_t ldc)
+    {
+        Reg acc[R][NC];
+        for (size_t r = 0; r < R; r++)
+            for (size_t q = 0; q < NC; q++)
+                acc[r][q] = V::Set(0.0f);
+        for (size_t p = 0; p < k; p++)
+        {
+            Reg av[R];
+            for (size_t r = 0; r < R; r++)
+                av[r] = V::Load(a + i + r * V::Width + p * lda);
+            for (size_t q = 0; q < NC; q++)
+            {
+                Reg bv = V::Set(b[p * bRowStride + (j + q) * bColStride]);
+                for (size_t r = 0; r < R; r++)
+                    acc[r][q] = V::FMAdd(av[r], bv, acc[r][q]);
+            }
+        }
+        Reg alphaV = V::Set(alpha), betaV = V::Set(beta);
+        for (size_t q = 0; q < NC; q++)
+        {
+            for (size_t r = 0; r < R; r++)
+            {
+                float* cp = c + i + r * V::Width + (j + q) * ldc;
+                V::Store(cp, beta == 0 ? V::Mul(acc[r][q], alphaV) : V::FMAdd(acc[r][q], alphaV, V::Mul(V::Load(cp), betaV)));
+            }
+        }
+    }
+
+    template <size_t NC>
+    static void SmallGemmColumns(size_t m, size_t j, size_t k, float alpha, const float* a, size_t lda, const float* b, size_t bRowStride, size_t bColStride,
+                                 float beta, float* c, size_t ldc)
+    {
+        size_t i = 0;
+        for (; i + 2 * V::Width <= m; i += 2 * V::Width)
+            SmallGemmBlock<2, NC>(i, j, k, alpha, a, lda, b, bRowStride, bColStride, beta, c, ldc);
+        for (; i + V::Width <= m; i += V::Width)
+            SmallGemmBlock<1, NC>(i, j, k, alpha, a, lda, b, bRowStride, bColStride, beta, c, ldc);
+        for (; i < m; i++) // remaining rows
+        {
+            for (size_t q = 0; q < NC; q++)
+            {
+                float sum = 0;
+                for (size_t p = 0; p < k; p++)
+                    sum += a[i + p * lda] * b[p * bRowStride + (j + q) * bColStride];
+                float& cij = c[i + (j + q) * ldc];
+                cij = beta == 0 ? alpha * sum : alpha * sum + beta * cij;
+            }
+        }
+    }
+
+    static void SmallGemm(size_t m, size_t n, size_t k, float alpha, const float* a, size_t lda, const float* b, size_t ldb, bool transposeB,
+                          float beta, float* c, size_t ldc)
+    {
+        // element (p, j) of op(b) is b[p * bRowStride + j * bColStride]
+        const size_t bRowStride = transposeB ? ldb : 1;
+        const size_t bColStride = transposeB ? 1 : ldb;
+        size_t j = 0;
+        for (; j + 4 <= n; j += 4)
+            SmallGemmColumns<4>(m, j, k, alpha, a, lda, b, bRowStride, bColStride, beta, c, ldc);
+        for (; j < n; j++)
+            SmallGemmColumns<1>(m, j, k, alpha, a, lda, b, bRowStride, bColStride, beta, c, ldc);
+    }
+
+    // Same for a panel of packed rows, which are read as one contiguous stream; a partial panel goes through a buffer.
+    template <size_t NC>
+    static void PackedPanelColumns(size_t rows, size_t j, size_t k, const float* panel, const float* b, size_t ldb, float* c, size_t ldc)
+    {
+        const size_t R = CPUVectorKernels::PackedPanelRows / V::Width;
+        Reg acc[R][NC];
+        for (size_t r = 0; r < R; r++)
+            for (size_t q = 0; q < NC; q++)
+                acc[r][q] = V::Set(0.0f);
+        for (size_t p = 0; p < k; p++)
+        {
+            Reg av[R];
+            for (size_t r = 0; r < R; r++)
+                av[r] = V::Load(panel + p * CPUVectorKernels::PackedPanelRows + r * V::Width);
+            for (size_t q = 0; q < NC; q++)
+            {
+                Reg bv = V::Set(b[p + (j + q) * ldb]);
+                for (size_t r = 0; r < R; r++)
+                    acc[r][q] = V::FMAdd(av[r], bv, acc[r][q]);
+            }
+        }
+        for (size_t q = 0; q < NC; q++)
+        {
+            float* cp = c + (j + q) * ldc;
+            if (rows == CPUVectorKernels::PackedPanelRows)
+            {
+                for (size_t r = 0; r < R; r++)
+                    V::Store(cp + r * V::Width, acc[r][q]);
+            }
+            else
+            {
+                float buffer[CPUVectorKernels::PackedPanelRows];
+                for (size_t r = 0; r < R; r++)
+                    V::Store(buffer + r * V::Width, acc[r][q]);
+                for (size_t i = 0; i < rows; i++)
+                    cp[i] = buffer[i];
+            }
+        }
+    }
+
+    // 8 accumulators per block of columns, enough independent FMAs to hide their latency
+    static void PackedPanelGemm(size_t rows, size_t n, size_t k, const float* panel, const float* b, size_t ldb, float* c, size_t ldc)
+    {
+        const size_t NC = 8 * V::Width / CPUVectorKernels::PackedPanelRows;
+        size_t j = 0;
+        for (; j + NC <= n; j += NC)
+            PackedPanelColumns<NC>(rows, j, k, panel, b, ldb, c, ldc);
+        for (; j < n; j++)
+            PackedPanelColumns<1>(rows, j, k, panel, b, ldb, c, ldc);
+    }
+
+    static CPUVectorKernels Create()
+    {
+        CPUVectorKernels kernels;
+        kernels.Exp = &Exp;
+        kernels.Tanh = &Tanh;
+        kernels.Sigmoid = &Sigmoid;
+        kernels.Log = &Log;
+        kernels.AddElementProduct = &AddElementProduct;
+        kernels.AddScaled = &AddScaled;
+        kernels.Max = &Max;
+        kernels.ShiftAndSumExp = &ShiftAndSumExp;
+        kernels.ShiftExpAndSum = &ShiftExpAndSum;
+        kernels.MaxAndSumExp = &MaxAndSumExp;
+        kernels.DotInt8 = &V::DotInt8;
+        kernels.SmallGemm = &SmallGemm;
+        kernels.PackedPanelGemm = &PackedPanelGemm;
+        return kernels;
+    }
+};
+} } }
@@ -0,0 +1,350 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// CUDACachingMemAllocator.cpp -- size-bucketed caching allocator for GPU device memory
+//
+
+#include "stdafx.h"
+#include "Basics.h"
+#include "CUDACachingMemAllocator.h"
+#include "BestGpu.h" // for CPUONLY
+#include <algorithm>
+#ifndef CPUONLY
+#include "GPUMatrix.h" // for PrepareDevice()
+#include <cuda_runtime_api.h>
+#endif
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+bool CUDACachingMemAllocator::s_enabled = true;
+
+void CUDACachingMemAllocator::SetEnabled(bool enabled)
+{
+    if (!enabled && s_enabled)
+        ReleaseCachedMemoryForAllDevices();
+    s_enabled = enabled;
+}
+
+bool CUDACachingMemAllocator::IsEnabled()
+{
+    return s_enabled;
+}
+
+// Buckets are quarter powers of two (2^k, 1.25 * 2^k, 1.5 * 2^k, 1.75 * 2^k) with a minimum of 512 bytes.
+// This bounds the rounding overhead to 25% while keeping the number of distinct sizes small,
+// so that matrices whose dimensions vary a little from minibatch to minibatch share buckets.
+size_t CUDACachingMemAllocator::RoundUp(size_t size)
+{
+    const size_t minBlockSize = 512;
+    if (size <= minBlockSize)
+        return minBlockSize;
+    size_t pow2 = minBlockSize;
+    while (pow2 * 2 <= size) // largest power of two <= size
+        pow2 *= 2;
+    size_t quarter = pow2 / 4;
+    return (size + quarter - 1) / quarter * quarter;
+}
+
+CUDACachingMemAllocator& CUDACachingMemAllocator::ForDevice(int deviceId)
+{
+    // Note: allocators are intentionally never destructed. Blocks may still be freed during
+    // process exit (from static Matrix objects), at which time the CUDA runtime may be gone already.
+    static CUDACachingMemAllocator* allocators[MaxGpus] = {};
+    static std::mutex creationMutex;
+    if (deviceId < 0 || deviceId >= MaxGpus)
+        LogicError("CUDACachingMemAllocator: Invalid device id %d.", deviceId);
+    std::lock_guard<std::mutex> lock(creationMutex);
+    if (!allocators[deviceId])
+        allocators[deviceId] = new CUDACachingMemAllocator(deviceId);
+    return *allocators[deviceId];
+}
+
+void CUDACachingMemAllocator::PrintStatisticsForAllDevices()
+{
+#ifndef CPUONLY
+    int deviceCount = 0;
+    if (cudaGetDeviceCount(&deviceCount) != cudaSuccess)
+        return;
+    for (int deviceId = 0; deviceId < deviceCount && deviceId < MaxGpus; deviceId++)
+    {
+        let& allocator = ForDevice(deviceId);
+        if (allocator.GetStatistics().m_numMallocs > 0)
+            allocator.PrintStatistics();
+    }
+#endif
+}
+
+void CUDACachingMemAllocator::ReleaseCachedMemoryForAllDevices()
+{
+#ifndef CPUONLY
+    int deviceCount = 0;
+    if (cudaGetDeviceCount(&deviceCount) != cudaSuccess)
+        return;
+    for (int deviceId = 0; deviceId < deviceCount && deviceId < MaxGpus; deviceId++)
+        ForDevice(deviceId).ReleaseCachedMemory();
+#endif
+}
+
+CUDACachingMemAllocator::CUDACachingMemAllocator(int deviceId)
+    : m_deviceId(deviceId), m_capturing(false), m_streamEvent(nullptr)
+{
+}
+
+int CUDACachingMemAllocator::GetDeviceId() const
+{
+    return m_deviceId;
+}
+
+CUDACachingMemAllocator::Statistics CUDACachingMemAllocator::GetStatistics() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats;
+}
+
+void CUDACachingMemAllocator::PrintStatistics() const
+{
+    let stats = GetStatistics();
+    const double MB = 1024.0 * 1024.0;
+    fprintf(stderr, "GPU memory cache statistics for DeviceId = %d: %d allocations, %.2f%% cache hits, %d cudaMalloc, %d cudaFree; "
+                    "in use = %.1f MB (peak %.1f MB), cached = %.1f MB, peak reserved = %.1f MB, fragmentation = %.2f%%\n",
+            m_deviceId, (int) stats.m_numMallocs, 100.0 * stats.HitRate(), (int) stats.m_numDeviceMallocs, (int) stats.m_numDeviceFrees,
+            stats.m_bytesInUse / MB, stats.m_peakBytesInUse / MB, stats.m_bytesCached / MB, stats.m_peakBytesReserved / MB, 100.0 * stats.Fragmentation());
+}
+
+#ifndef CPUONLY
+
+void* CUDACachingMemAllocator::DeviceMalloc(size_t size)
+{
+    void* p = nullptr;
+    cudaError_t rc = cudaMalloc(&p, size);
+    if (rc == cudaErrorMemoryAllocation && m_stats.m_bytesCached > 0)
+    {
+        // out of memory: give the cached blocks back to the driver and try once more
+        cudaGetLastError(); // clear the error state
+        ReleaseCachedMemoryNoLock();
+        rc = cudaMalloc(&p, size);
+    }
+    if (rc != cudaSuccess)
+        RuntimeError("CUDACachingMemAllocator: cudaMalloc of %d bytes failed on DeviceId = %d: %s (cuda error %d)", (int) size, m_deviceId, cudaGetErrorString(rc), (int) rc);
+    m_stats.m_numDeviceMallocs++;
+    return p;
+}
+
+void CUDACachingMemAllocator::ReleaseCachedMemoryNoLock()
+{
+    for (auto& block : m_freeBlocks)
+    {
+        cudaFree(block.second.m_p); // (may be called at process exit, so we ignore the return code)
+        m_stats.m_numDeviceFrees++;
+    }
+    m_freeBlocks.clear();
+    m_stats.m_bytesCached = 0;
+}
+
+// best fit among cached blocks; we accept a somewhat larger block (up to 1.5 x the bucket size)
+// rather than holding on to more memory
+CUDACachingMemAllocator::FreeBlocks::iterator CUDACachingMemAllocator::FindFreeBlock(FreeBlocks& freeBlocks, size_t bucketSize)
+{
+    const cudaStream_t stream = GetStream();
+    auto end = freeBlocks.upper_bound(bucketSize + bucketSize / 2);
+    auto found = freeBlocks.end();
+    for (auto iter = freeBlocks.lower_bound(bucketSize); iter != end; iter++)
+    {
+        if (iter->second.m_stream == stream)
+            return iter;
+        if (found == freeBlocks.end())
+            found = iter;
+    }
+    return found;
+}
+
+void CUDACachingMemAllocator::WaitForStreamOf(const FreeBlock& block)
+{
+    // (cudaStreamWaitEvent() takes the state of the event at the time of the call, so one event will do)
+    if (m_streamEvent == nullptr)
+        CUDA_CALL(cudaEventCreateWithFlags(&m_streamEvent, cudaEventDisableTiming));
+    CUDA_CALL(cudaEventRecord(m_streamEvent, block.m_stream));
+    CUDA_CALL(cudaStreamWaitEvent(GetStream(), m_streamEvent, 0));
+}
+
+void* CUDACachingMemAllocator::Malloc(size_t size)
+{
+    if (size == 0)
+        return nullptr;
+
+    const size_t bucketSize = RoundUp(size);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stats.m_numMallocs++;
+
+    void* p = nullptr;
+    size_t blockSize = bucketSize;
+    auto iter = m_capturing ? FindFreeBlock(m_captureFreeBlocks, bucketSize) : m_captureFreeBlocks.end();
+    if (iter != m_captureFreeBlocks.end())
+    {
+        // (not counted in m_bytesCached, which only covers blocks that any later request may get)
+        p = iter->second.m_p;
+        blockSize = iter->first;
+        m_captureFreeBlocks.erase(iter);
+        m_stats.m_numCacheHits++;
+    }
+    else if ((iter = FindFreeBlock(m_freeBlocks, bucketSize)) != m_freeBlocks.end())
+    {
+        p = iter->second.m_p;
+        blockSize = iter->first;
+        // (not while capturing: the graph is launched later, on the stream that it was captured from)
+        if (iter->second.m_stream != GetStream() && !m_capturing)
+        {
+            PrepareDevice(m_deviceId);
+            WaitForStreamOf(iter->second);
+        }
+        m_freeBlocks.erase(iter);
+        m_stats.m_bytesCached -= blockSize;
+        m_stats.m_numCacheHits++;
+    }
+    else
+    {
+        PrepareDevice(m_deviceId);
+        p = DeviceMalloc(bucketSize);
+    }
+
+    if (m_capturing)
+        m_captureBlocks.push_back(p);
+    m_usedBlocks[p] = std::make_pair(blockSize, size);
+    m_stats.m_bytesInUse += blockSize;
+    m_stats.m_bytesRequested += size;
+    m_stats.m_peakBytesInUse = std::max(m_stats.m_peakBytesInUse, m_stats.m_bytesInUse);
+    m_stats.m_peakBytesReserved = std::max(m_stats.m_peakBytesReserved, m_stats.m_bytesInUse + m_stats.m_bytesCached);
+    return p;
+}
+
+void CUDACachingMemAllocator::Free(void* p)
+{
+    if (p == nullptr)
+        return;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto iter = m_usedBlocks.find(p);
+    if (iter == m_usedBlocks.end())
+        LogicError("CUDACachingMemAllocator: Attempted to free a block (%p) on DeviceId = %d that was not allocated by this allocator.", p, m_deviceId);
+
+    const size_t blockSize = iter->second.first;
+    m_stats.m_bytesInUse -= blockSize;
+    m_stats.m_bytesRequested -= iter->second.second;
+    m_usedBlocks.erase(iter);
+
+    if (m_capturing)
+    {
+        m_captureBlocks.push_back(p);
+        m_captureFreeBlocks.insert(std::make_pair(blockSize, FreeBlock{p, GetStream()}));
+    }
+    else if (m_graphRefCounts.find(p) != m_graphRefCounts.end())
+        m_heldBlocks[p] = std::make_pair(blockSize, GetStream());
+    else
+    {
+        m_freeBlocks.insert(std::make_pair(blockSize, FreeBlock{p, GetStream()}));
+        m_stats.m_bytesCached += blockSize;
+    }
+}
+
+void CUDACachingMemAllocator::BeginGraphCapture()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_capturing)
+        LogicError("CUDACachingMemAllocator: A graph is being captured already on DeviceId = %d.", m_deviceId);
+    m_capturing = true;
+}
+
+std::vector<void*> CUDACachingMemAllocator::EndGraphCapture()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_capturing)
+        LogicError("CUDACachingMemAllocator: EndGraphCapture() without BeginGraphCapture() on DeviceId = %d.", m_deviceId);
+    m_capturing = false;
+
+    // a block may have been allocated and freed (and allocated again) during the capture
+    std::sort(m_captureBlocks.begin(), m_captureBlocks.end());
+    m_captureBlocks.erase(std::unique(m_captureBlocks.begin(), m_captureBlocks.end()), m_captureBlocks.end());
+    for (auto p : m_captureBlocks)
+        m_graphRefCounts[p]++;
+    for (auto& block : m_captureFreeBlocks)
+        m_heldBlocks[block.second.m_p] = std::make_pair(block.first, block.second.m_stream);
+    m_captureFreeBlocks.clear();
+
+    std::vector<void*> blocks;
+    blocks.swap(m_captureBlocks);
+    return blocks;
+}
+
+void CUDACachingMemAllocator::ReleaseGraphBlocks(const std::vector<void*>& blocks)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto p : blocks)
+    {
+        auto iter = m_graphRefCounts.find(p);
+        if (iter == m_graphRefCounts.end())
+            LogicError("CUDACachingMemAllocator: Attempted to release a block (%p) on DeviceId = %d that no graph uses.", p, m_deviceId);
+        if (--iter->second > 0)
+            continue;
+        m_graphRefCounts.erase(iter);
+
+        auto held = m_heldBlocks.find(p);
+        if (held != m_heldBlocks.end()) // freed meanwhile: now it can be handed out again
+        {
+            m_freeBlocks.insert(std::make_pair(held->second.first, FreeBlock{p, held->second.second}));
+            m_stats.m_bytesCached += held->second.first;
+            m_heldBlocks.erase(held);
+        }
+    }
+}
+
+void CUDACachingMemAllocator::ReleaseCachedMemory()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_freeBlocks.empty())
+        return;
+    PrepareDevice(m_deviceId);
+    ReleaseCachedMemoryNoLock();
+}
+
+#else // CPUONLY
+
+// Dummy definitions when compiling for CPUONLY
+void* CUDACachingMemAllocator::DeviceMalloc(size_t)
+{
+    return nullptr;
+}
+
+void CUDACachingMemAllocator::ReleaseCachedMemoryNoLock()
+{
+}
+
+void* CUDACachingMemAllocator::Malloc(size_t)
+{
+    return nullptr;
+}
+
+void CUDACachingMemAllocator::Free(void*)
+{
+}
+
+void CUDACachingMemAllocator::ReleaseCachedMemory()
+{
+}
+
+void CUDACachingMemAllocator::BeginGraphCapture()
+{
+}
+
+std::vector<void*> CUDACachingMemAllocator::EndGraphCapture()
+{
+    return std::vector<void*>();
+}
+
+void CUDACachingMemAllocator::ReleaseGraphBlocks(const std::vector<void*>&)
+{
+}
+
+#endif // CPUONLY
+} } }
@@ -0,0 +1,149 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// CUDACachingMemAllocator.h -- size-bucketed caching allocator for GPU device memory
+//
+
+#pragma once
+
+#include "MemAllocator.h"
+#include <map>
+#include <unordered_map>
+#include <vector>
+#include <mutex>
+
+typedef struct CUstream_st* cudaStream_t;
+typedef struct CUevent_st* cudaEvent_t;
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+#ifdef _WIN32
+#ifdef MATH_EXPORTS
+#define MATH_API __declspec(dllexport)
+#else
+#define MATH_API __declspec(dllimport)
+#endif
+#else // no DLLs on Linux
+#define MATH_API
+#endif
+
+// -----------------------------------------------------------------------
+// CUDACachingMemAllocator -- per-device caching allocator for device memory
+//
+// Freed blocks are not returned to the driver but kept in a free list keyed
+// by their (bucketed) size, and handed out again for later requests of a
+// similar size. This avoids cudaFree(), which implicitly synchronizes the
+// device, in the inner loop (e.g. when minibatch sizes vary and matrices get
+// resized). Reuse is safe w.r.t. ordering because a block is preferably
+// handed out again on the stream (t_stream) that it was freed on, so a
+// kernel using a recycled block is queued after the kernels that used it
+// before. A block of another stream (e.g. of another thread, see
+// SharedComputeStreams) is only taken after making the current stream wait
+// for the work issued to that stream so far.
+//
+// Cached memory is only returned to the driver if an allocation fails, or
+// upon ReleaseCachedMemory().
+//
+// While a CUDA graph is captured (see ComputeGraph), the stream ordering
+// above does not hold: the graph re-runs its kernels on each launch, long
+// after the host code freed their memory. So each block that is allocated
+// or freed during the capture belongs to the graph until it is released
+// (ReleaseGraphBlocks()); blocks freed during the capture are only handed
+// out again within the same capture, and blocks freed later are held back.
+// -----------------------------------------------------------------------
+
+#pragma warning(push)
+#pragma warning(disable : 4251) // needs to have dll-interface to be used by clients of... (std::map etc.)
+
+class MATH_API CUDACachingMemAllocator : public MemAllocator
+{
+public:
+    struct Statistics
+    {
+        size_t m_numMallocs = 0;       // number of Malloc() calls
+        size_t m_numCacheHits = 0;     // Malloc() calls served from the cache
+        size_t m_numDeviceMallocs = 0; // actual cudaMalloc() calls
+        size_t m_numDeviceFrees = 0;   // actual cudaFree() calls
+        size_t m_bytesRequested = 0;   // sum of requested sizes of blocks currently handed out
+        size_t m_bytesInUse = 0;       // sum of (bucketed) sizes of blocks currently handed out
+        size_t m_peakBytesInUse = 0;   // high-water mark of m_bytesInUse
+        size_t m_bytesCached = 0;      // bytes sitting in the free list
+        size_t m_peakBytesReserved = 0; // high-water mark of m_bytesInUse + m_bytesCached, i.e. what we hold from the driver
+
+        double HitRate() const
+        {
+            return m_numMallocs ? (double) m_numCacheHits / m_numMallocs : 0.0;
+        }
+        // fraction of handed-out memory that was not asked for (due to bucket rounding and best-fit reuse)
+        double Fragmentation() const
+        {
+            return m_bytesInUse ? 1.0 - (double) m_bytesRequested / m_bytesInUse : 0.0;
+        }
+    };
+
+    CUDACachingMemAllocator(int deviceId);
+
+    int GetDeviceId() const;
+    void* Malloc(size_t size) override; // note: Malloc(0) returns nullptr
+    void Free(void* p) override;
+
+    // return all cached (free) blocks to the driver
+    void ReleaseCachedMemory();
+
+    // graph capture (see above); EndGraphCapture() returns the blocks that the graph uses, to be passed to ReleaseGraphBlocks()
+    void BeginGraphCapture();
+    std::vector<void*> EndGraphCapture();
+    void ReleaseGraphBlocks(const std::vector<void*>& blocks);
+
+    Statistics GetStatistics() const;
+    void PrintStatistics() const;
+
+    // per-device singleton used by TracingGPUMemoryAllocator
+    static CUDACachingMemAllocator& ForDevice(int deviceId);
+
+    // caching is on by default; if disabled, TracingGPUMemoryAllocator calls cudaMalloc/cudaFree directly
+    static void SetEnabled(bool enabled);
+    static bool IsEnabled();
+
+    // print statistics (and optionally release the cache) of all devices that have been used
+    static void PrintStatisticsForAllDevices();
+    static void ReleaseCachedMemoryForAllDevices();
+
+    // bucket size a request of 'size' bytes is rounded up to
+    static size_t RoundUp(size_t size);
+
+private:
+    struct FreeBlock
+    {
+        void* m_p;
+        cudaStream_t m_stream; // the current stream when the block was freed
+    };
+    typedef std::multimap<size_t, FreeBlock> FreeBlocks; // [bucket size] -> block
+
+    void* DeviceMalloc(size_t size);
+    void ReleaseCachedMemoryNoLock();
+    // best fit in 'freeBlocks' for 'bucketSize', preferring blocks of the current stream; end() if none
+    FreeBlocks::iterator FindFreeBlock(FreeBlocks& freeBlocks, size_t bucketSize);
+    void WaitForStreamOf(const FreeBlock& block);
+
+    static const int MaxGpus = 16;
+    static bool s_enabled;
+
+    int m_deviceId;
+    mutable std::mutex m_mutex;
+    FreeBlocks m_freeBlocks;
+    std::unordered_map<void*, std::pair<size_t, size_t>> m_usedBlocks; // block -> (bucket size, requested size)
+    Statistics m_stats;
+
+    bool m_capturing;
+    FreeBlocks m_captureFreeBlocks;                     // blocks freed during the current capture
+    std::vector<void*> m_captureBlocks;                 // blocks allocated or freed during the current capture
+    std::unordered_map<void*, size_t> m_graphRefCounts; // block -> number of graphs that use it
+    std::unordered_map<void*, std::pair<size_t, cudaStream_t>> m_heldBlocks; // freed block still used by a graph -> (bucket size, stream)
+    cudaEvent_t m_streamEvent;                          // for WaitForStreamOf(), created on first use
+};
+
+#pragma warning(pop)
+
+} } }
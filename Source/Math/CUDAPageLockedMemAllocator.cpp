@@ -30,6 +30,18 @@ void CUDAPageLockedMemAllocator::Free(void* p, int deviceId)
     cudaFreeHost(p) || "Free in CUDAPageLockedMemAllocator failed";
 }
 
+void CUDAPageLockedMemAllocator::Register(void* p, size_t size, int deviceId)
+{
+    cudaSetDevice(deviceId);
+    cudaHostRegister(p, size, cudaHostRegisterPortable) || "Register in CUDAPageLockedMemAllocator failed";
+}
+
+void CUDAPageLockedMemAllocator::Unregister(void* p, int deviceId)
+{
+    cudaSetDevice(deviceId);
+    cudaHostUnregister(p) || "Unregister in CUDAPageLockedMemAllocator failed";
+}
+
 void* CUDAPageLockedMemAllocator::Malloc(size_t size)
 {
     return Malloc(size, m_deviceID);
@@ -72,5 +84,13 @@ void CUDAPageLockedMemAllocator::Free(void*)
 void CUDAPageLockedMemAllocator::Free(void*, int)
 {
 }
+
+void CUDAPageLockedMemAllocator::Register(void*, size_t, int)
+{
+}
+
+void CUDAPageLockedMemAllocator::Unregister(void*, int)
+{
+}
 #endif
 } } }
@@ -25,6 +25,10 @@ public:
     static void* Malloc(size_t size, int deviceId);
     static void Free(void* p, int deviceId);
 
+    // page-lock memory that was allocated otherwise, e.g. the buffer of a CPU matrix, for fast asynchronous copies
+    static void Register(void* p, size_t size, int deviceId);
+    static void Unregister(void* p, int deviceId);
+
 private:
     int m_deviceID;
 };
@@ -17,6 +17,7 @@
 #include "Basics.h"
 #include <string>
 #include <stdint.h>
+#include <string.h>
 
 #define DEVICEID_TYPE int
 // and the following magic values
@@ -37,6 +38,75 @@
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
+// conversion to and from IEEE half precision (round to nearest even), for the compressed gradients and matrices stored in half precision
+inline uint16_t FloatToHalf(float value)
+{
+    uint32_t f;
+    memcpy(&f, &value, sizeof(f));
+    uint32_t sign = (f >> 16) & 0x8000;
+    uint32_t absf = f & 0x7fffffff;
+
+    if (absf >= 0x7f800000) // Inf or NaN
+        return (uint16_t) (sign | 0x7c00 | ((absf > 0x7f800000) ? 0x200 : 0));
+    if (absf >= 0x477ff000) // rounds to a value beyond the largest half
+        return (uint16_t) (sign | 0x7c00);
+    if (absf < 0x38800000) // denormal half, or zero
+    {
+        // add the implicit bit, and shift the mantissa into place with rounding to nearest even
+        uint32_t shift = 126 - (absf >> 23);
+        if (shift > 24)
+            return (uint16_t) sign;
+        uint32_t mantissa = (absf & 0x7fffff) | 0x800000;
+        uint32_t half = mantissa >> shift;
+        uint32_t rest = mantissa & ((1u << shift) - 1);
+        uint32_t halfway = 1u << (shift - 1);
+        if ((rest > halfway) || ((rest == halfway) && (half & 1)))
+            half++;
+        return (uint16_t) (sign | half);
+    }
+
+    // normal half: rebias the exponent, round the mantissa to nearest even (a carry correctly increments the exponent)
+    uint32_t half = ((absf - 0x38000000) >> 13);
+    uint32_t rest = absf & 0x1fff;
+    if ((rest > 0x1000) || ((rest == 0x1000) && (half & 1)))
+        half++;
+    return (uint16_t) (sign | half);
+}
+
+inline float HalfToFloat(uint16_t half)
+{
+    uint32_t sign = ((uint32_t) half & 0x8000) << 16;
+    uint32_t exponent = (half >> 10) & 0x1f;
+    uint32_t mantissa = half & 0x3ff;
+    uint32_t f;
+    if (exponent == 0x1f) // Inf or NaN
+    {
+        f = sign | 0x7f800000 | (mantissa << 13);
+    }
+    else if (exponent != 0)
+    {
+        f = sign | ((exponent + 112) << 23) | (mantissa << 13);
+    }
+    else if (mantissa == 0)
+    {
+        f = sign;
+    }
+    else // denormal half, which is a normal float
+    {
+        exponent = 113;
+        while ((mantissa & 0x400) == 0)
+        {
+            mantissa <<= 1;
+            exponent--;
+        }
+        f = sign | (exponent << 23) | ((mantissa & 0x3ff) << 13);
+    }
+
+    float value;
+    memcpy(&value, &f, sizeof(value));
+    return value;
+}
+
 class MATH_API TracingGPUMemoryAllocator
 {
 private:
@@ -62,6 +132,82 @@ private:
     static std::pair<size_t, size_t> GetFreeAndTotalMemoryInMBs(int deviceId);
 };
 
+// -----------------------------------------------------------------------
+// GPUMathOptions -- process-wide switches for the GPU math libraries
+//  - half-precision GEMM: float GEMMs (and cuDNN convolutions) may round their inputs to fp16
+//    to run on tensor cores (Volta and later), accumulating in fp32. Matrices are still stored
+//    in fp32, so this does not change what the model holds, only the precision of the products.
+//    Use together with loss scaling in SGD to keep small gradients from flushing to zero.
+//  - convolution algorithm cache file: if set, cuDNN convolution algorithms picked by the
+//    auto-tuner are persisted there and reused by later runs on the same hardware.
+//  - logging of implicit device syncs (debugging): the GPU functions that return a host value
+//    or copy to the host, and so wait for the device, log each call with its call stack. Any
+//    such call during forward or backward propagation serializes the host and the GPU.
+//  - count of host transfers: the functions that copy between the host and the device count
+//    each call, so that a CUDA graph capture (ComputeGraph) can tell whether the captured
+//    code depended on host data.
+//  - runtime-compiled tensor kernels: elementwise tensor ops and fused ElementWiseProgram ops
+//    that keep running on the same operation and shape get a kernel generated for exactly that
+//    case and compiled with NVRTC (GPUTensorJit.h). If a cache directory is set, the compiled
+//    kernels are kept there and reused by later runs on the same hardware.
+// -----------------------------------------------------------------------
+
+class MATH_API GPUMathOptions
+{
+private:
+    static bool m_useHalfPrecisionGemm;
+    static std::wstring m_convolutionAlgoCacheFile;
+    static bool m_logImplicitDeviceSyncs;
+    static size_t m_numHostTransfers;
+    static bool m_jitTensorKernels;
+    static std::wstring m_jitKernelCacheDir;
+
+    static void LogImplicitDeviceSync(const char* operation);
+
+public:
+    static void SetUseHalfPrecisionGemm(bool enabled) { m_useHalfPrecisionGemm = enabled; }
+    static bool UseHalfPrecisionGemm() { return m_useHalfPrecisionGemm; }
+
+    static void SetConvolutionAlgoCacheFile(const std::wstring& path) { m_convolutionAlgoCacheFile = path; }
+    static const std::wstring& GetConvolutionAlgoCacheFile() { return m_convolutionAlgoCacheFile; }
+
+    static void SetLogImplicitDeviceSyncs(bool enabled) { m_logImplicitDeviceSyncs = enabled; }
+    static bool LogImplicitDeviceSyncs() { return m_logImplicitDeviceSyncs; }
+    // called by the functions that wait for the device
+    static void NoteImplicitDeviceSync(const char* operation)
+    {
+        m_numHostTransfers++;
+        if (m_logImplicitDeviceSyncs)
+            LogImplicitDeviceSync(operation);
+    }
+    // called by the functions that copy from the host to the device
+    static void NoteHostTransfer() { m_numHostTransfers++; }
+    static size_t GetNumHostTransfers() { return m_numHostTransfers; }
+
+    static void SetJitTensorKernels(bool enabled) { m_jitTensorKernels = enabled; }
+    static bool JitTensorKernels() { return m_jitTensorKernels; }
+
+    static void SetJitKernelCacheDir(const std::wstring& path) { m_jitKernelCacheDir = path; }
+    static const std::wstring& GetJitKernelCacheDir() { return m_jitKernelCacheDir; }
+};
+
+// -----------------------------------------------------------------------
+// PeerAccess -- the table of the pairs of GPUs that can copy to each other directly (over NVLink or PCIe)
+//
+// DetectPeers() queries all pairs once, when the device is selected. The access of a pair is only enabled when a
+// matrix is first copied between them (EnableBetween()): enabling it creates a CUDA context on the peer, which a
+// process that uses a single GPU should not pay for on all the GPUs of the machine. Copies between two GPUs without
+// peer access still work, the driver stages them through host memory.
+// -----------------------------------------------------------------------
+
+class MATH_API PeerAccess
+{
+public:
+    static void DetectPeers();
+    // enables the access of each device to the other if they are peers; returns false if copies must go through the host
+    static bool EnableBetween(DEVICEID_TYPE deviceA, DEVICEID_TYPE deviceB);
+};
+
 // -----------------------------------------------------------------------
 // ElementWiseOperator -- This enum represents which function to apply.
 // This is shared between all matrix types and tensors.
@@ -168,6 +314,124 @@ enum ElementWiseOperator
     Macro(Cond);                \
     Macro(Clip);
 
+// -----------------------------------------------------------------------
+// ElementWiseProgram -- a short sequence of ElementWiseOperators that is
+// evaluated per element in a single tensor operation.
+// This is used to fuse chains of elementwise operations, so that intermediate
+// results live in registers rather than global memory.
+// Registers [0..MaxInputs) hold the input values; instruction i writes to
+// register MaxInputs + i. The result is that of the last instruction.
+// It is passed by value to CUDA kernels, so it must remain a POD.
+// -----------------------------------------------------------------------
+
+struct ElementWiseProgram
+{
+    static const int MaxInputs = 4;
+    static const int MaxInstructions = 12;
+    static const int MaxRegisters = MaxInputs + MaxInstructions;
+
+    struct Instruction
+    {
+        ElementWiseOperator op;
+        unsigned char numArgs;
+        unsigned char args[3]; // register indices
+    };
+
+    int m_numInputs;
+    int m_numInstructions;
+    Instruction m_instructions[MaxInstructions];
+
+    void Clear()
+    {
+        m_numInputs = 0;
+        m_numInstructions = 0;
+    }
+
+    // number of operands of op, or 0 if not supported
+    static int GetNumArgs(ElementWiseOperator op)
+    {
+#define CaseNumArgs(oper, n)            \
+    case ElementWiseOperator::op##oper: \
+        return n
+#define CaseNumArgs1(oper) CaseNumArgs(oper, 1)
+#define CaseNumArgs2(oper) CaseNumArgs(oper, 2)
+#define CaseNumArgs3(oper) CaseNumArgs(oper, 3)
+        switch (op)
+        {
+            ForAllUnaryOps(CaseNumArgs1);
+            ForAllBinaryOps(CaseNumArgs2);
+            ForAllTernaryOps(CaseNumArgs3);
+        default:
+            return 0;
+        }
+#undef CaseNumArgs3
+#undef CaseNumArgs2
+#undef CaseNumArgs1
+#undef CaseNumArgs
+    }
+
+    // append an instruction and return the register that receives its result
+    int Append(ElementWiseOperator op, int numArgs, const int* args)
+    {
+        if (m_numInstructions >= MaxInstructions)
+            LogicError("ElementWiseProgram: Too many instructions.");
+        if (numArgs != GetNumArgs(op))
+            LogicError("ElementWiseProgram: Opcode %d does not take %d arguments.", (int) op, numArgs);
+        const int resultRegister = MaxInputs + m_numInstructions;
+        Instruction& instr = m_instructions[m_numInstructions];
+        instr.op = op;
+        instr.numArgs = (unsigned char) numArgs;
+        for (int i = 0; i < 3; i++)
+        {
+            const int arg = i < numArgs ? args[i] : 0; // unused args read register 0, which always exists
+            if (i < numArgs && (arg < 0 || arg >= resultRegister || (arg < MaxInputs && arg >= m_numInputs)))
+                LogicError("ElementWiseProgram: Invalid register %d.", arg);
+            instr.args[i] = (unsigned char) arg;
+        }
+        m_numInstructions++;
+        return resultRegister;
+    }
+};
+
+// -----------------------------------------------------------------------
+// FusedSGDBatch -- one SGD step for several dense parameters at once
+//
+// This is what SGD::UpdateWeightsS() does for momentum SGD and FSAdaGrad,
+// with gradient clipping by truncation or by the global norm of all
+// gradients, and L2/L1 regularization, as a single pass over the elements
+// of up to MaxTensors parameters of one device (see Matrix::FusedSGDUpdate()
+// and FusedSGDUpdateElement() in TensorOps.h). The gradients are read but
+// not modified. It is passed by value to CUDA kernels, so it must remain a POD.
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+struct FusedSGDBatch
+{
+    static const int MaxTensors = 24;
+
+    struct Tensor
+    {
+        ElemType* m_value;
+        const ElemType* m_gradient;
+        ElemType* m_smoothedGradient; // FSAdaGrad: the average of the squared gradients, followed by the momentum
+        size_t m_numElements;
+        ElemType m_learnRatePerSample;
+        ElemType m_adaMul;      // FSAdaGrad only
+        ElemType m_L1Threshold; // learning rate * L1RegWeight * actualMBSize, 0 for none
+    };
+
+    bool m_isFSAdagrad; // else momentum SGD
+    bool m_useNesterovMomentum;
+    ElemType m_momentum;            // per minibatch
+    ElemType m_adaWeight;           // FSAdaGrad only
+    ElemType m_truncationThreshold; // clippingThresholdPerSample * actualMBSize, or infinity
+    ElemType m_maxGradientNorm;     // the same for clipping by the norm of all gradients together, or infinity
+    const ElemType* m_gradientSquaredNorm; // the squared norm of all gradients of all batches, on the device; null unless clipping by it
+    ElemType m_L2Weight;            // L2RegWeight * actualMBSize, 0 for none
+    int m_numTensors;
+    Tensor m_tensors[MaxTensors];
+};
+
 // -----------------------------------------------------------------------
 // various enums to describe
 // -----------------------------------------------------------------------
@@ -209,6 +473,22 @@ enum MatrixFlags
     matrixFlagSetValueOnDevice = 1 << bitPosSetValueOnDevice, // SetValue() call has a buffer that is already on the device
 };
 
+// -----------------------------------------------------------------------
+// MatrixObjectRecycler -- thread-local free lists for the objects of the matrix types below
+//
+// Each column slice of a Matrix (ColumnSlice(), AsReference(), and thus each ValueFor() and TensorView)
+// creates a new such object that points into the buffer of the sliced one, and deletes it soon after.
+// In recurrent loops that happens for every node at every time step. Reusing the memory of these objects
+// keeps the heap out of that path. The buffers they point to are not affected.
+// -----------------------------------------------------------------------
+
+class MATH_API MatrixObjectRecycler
+{
+public:
+    static void* Allocate(size_t size);
+    static void Free(void* p, size_t size);
+};
+
 // -----------------------------------------------------------------------
 // BaseMatrix -- base class for all matrix types (CPU, GPU) x (dense, sparse)
 // -----------------------------------------------------------------------
@@ -217,6 +497,16 @@ template <class ElemType>
 class BaseMatrix
 {
 public:
+    // objects are allocated through MatrixObjectRecycler (note: deleted through the derived type, there is no virtual destructor)
+    static void* operator new(size_t size)
+    {
+        return MatrixObjectRecycler::Allocate(size);
+    }
+    static void operator delete(void* p, size_t size)
+    {
+        MatrixObjectRecycler::Free(p, size);
+    }
+
     MatrixFormat GetFormat() const
     {
         return m_format;
@@ -0,0 +1,55 @@
+#include "stdafx.h"
+#include "Basics.h"
+#include "ComputeEventTimer.h"
+#include "GPUMatrix.h"
+
+#pragma comment(lib, "cudart.lib")
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+ComputeEventTimer::ComputeEventTimer(DEVICEID_TYPE deviceId)
+    : m_deviceId(deviceId)
+{
+    if (deviceId < 0)
+        InvalidArgument("ComputeEventTimer: needs a GPU device.");
+}
+
+ComputeEventTimer::~ComputeEventTimer()
+{
+    // errors are ignored, the destructor may run while an exception is propagated
+    PrepareDevice(m_deviceId);
+    for (auto& event : m_events)
+    {
+        if (event != nullptr)
+            cudaEventDestroy(event);
+    }
+}
+
+void ComputeEventTimer::Record(size_t event)
+{
+    PrepareDevice(m_deviceId);
+
+    if (event >= m_events.size())
+        m_events.resize(event + 1, nullptr);
+    if (m_events[event] == nullptr)
+        CUDA_CALL(cudaEventCreate(&m_events[event])); // with timing, unlike the events of ComputeStreamPool
+    CUDA_CALL(cudaEventRecord(m_events[event], GetStream()));
+}
+
+float ComputeEventTimer::ElapsedMilliseconds(size_t fromEvent, size_t toEvent)
+{
+    if (fromEvent >= m_events.size() || toEvent >= m_events.size() || m_events[fromEvent] == nullptr || m_events[toEvent] == nullptr)
+        LogicError("ComputeEventTimer::ElapsedMilliseconds: event %d or %d was never recorded.", (int) fromEvent, (int) toEvent);
+
+    float milliseconds = 0;
+    CUDA_CALL(cudaEventSynchronize(m_events[toEvent]));
+    CUDA_CALL(cudaEventElapsedTime(&milliseconds, m_events[fromEvent], m_events[toEvent]));
+    return milliseconds;
+}
+
+void ComputeEventTimer::Synchronize(size_t event)
+{
+    if (event < m_events.size() && m_events[event] != nullptr)
+        CUDA_CALL(cudaEventSynchronize(m_events[event]));
+}
+} } }
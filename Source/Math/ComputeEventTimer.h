@@ -0,0 +1,50 @@
+#pragma once
+
+#include "Basics.h"
+#include "CommonMatrix.h"
+#include <vector>
+
+#ifdef _WIN32
+#ifndef MATH_API
+#ifdef MATH_EXPORTS
+#define MATH_API __declspec(dllexport)
+#else
+#define MATH_API __declspec(dllimport)
+#endif
+#endif /* MATH_API */
+#else  // no DLLs in Linux
+#define MATH_API
+#endif
+
+typedef struct CUevent_st* cudaEvent_t;
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Times the work issued to the GPU with CUDA events, without synchronizing while the work is issued.
+// Record(e) records the position of the current stream (see SetStream()) in event slot e. Once the work is issued,
+// ElapsedMilliseconds() waits for the later event and returns the GPU time between the two.
+class MATH_API ComputeEventTimer
+{
+public:
+    ComputeEventTimer(DEVICEID_TYPE deviceId);
+    ~ComputeEventTimer();
+
+    // Disallow copy and move construction and assignment
+    DISABLE_COPY_AND_MOVE(ComputeEventTimer);
+
+    DEVICEID_TYPE GetDeviceId() const { return m_deviceId; }
+
+    void Record(size_t event);
+    float ElapsedMilliseconds(size_t fromEvent, size_t toEvent);
+
+    // waits on the host for the work before the event; an event that was never recorded has no work to wait for
+    void Synchronize(size_t event);
+
+private:
+    DEVICEID_TYPE m_deviceId;
+
+#ifndef CPUONLY
+    std::vector<cudaEvent_t> m_events; // event slots, created on first use
+#endif // !CPUONLY
+};
+} } }
@@ -0,0 +1,130 @@
+#include "stdafx.h"
+#include "Basics.h"
+#include "ComputeGraph.h"
+#include "CUDACachingMemAllocator.h"
+#include "GPUMatrix.h"
+
+#pragma comment(lib, "cudart.lib")
+
+// cudaStreamCaptureModeRelaxed came with CUDA 10.1. We need it since the caching allocator may call cudaMalloc() during a capture.
+#define CUDA_GRAPHS_SUPPORTED (CUDART_VERSION >= 10010)
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+bool ComputeGraph::IsSupported()
+{
+#if CUDA_GRAPHS_SUPPORTED
+    return CUDACachingMemAllocator::IsEnabled();
+#else
+    return false;
+#endif
+}
+
+ComputeGraph::ComputeGraph(DEVICEID_TYPE deviceId)
+    : m_deviceId(deviceId), m_stream(nullptr), m_callerStream(nullptr), m_event(nullptr), m_graph(nullptr), m_graphExec(nullptr), m_numHostTransfersBeforeCapture(0)
+{
+    if (deviceId < 0)
+        InvalidArgument("ComputeGraph: needs a GPU device.");
+    if (!IsSupported())
+        RuntimeError("ComputeGraph: CUDA graphs need CUDA 10.1 or later, and the caching GPU memory allocator.");
+
+    PrepareDevice(m_deviceId);
+
+    // not cudaStreamNonBlocking: an operation on the legacy default stream during the capture, which would not be part of the graph,
+    // then syncs with the capturing stream, which fails the capture
+    CUDA_CALL(cudaStreamCreate(&m_stream));
+    CUDA_CALL(cudaEventCreateWithFlags(&m_event, cudaEventDisableTiming));
+}
+
+ComputeGraph::~ComputeGraph()
+{
+    // errors are ignored, the destructor may run while an exception is propagated
+    PrepareDevice(m_deviceId);
+#if CUDA_GRAPHS_SUPPORTED
+    if (m_graphExec != nullptr)
+        cudaGraphExecDestroy(m_graphExec);
+    if (m_graph != nullptr)
+        cudaGraphDestroy(m_graph);
+#endif
+    // Each launch was followed by a wait of the caller's stream, so work issued there later that reuses these blocks comes after it.
+    CUDACachingMemAllocator::ForDevice(m_deviceId).ReleaseGraphBlocks(m_blocks);
+    cudaEventDestroy(m_event);
+    cudaStreamDestroy(m_stream);
+}
+
+bool ComputeGraph::IsCaptured() const
+{
+    return m_graphExec != nullptr;
+}
+
+void ComputeGraph::BeginCapture()
+{
+#if CUDA_GRAPHS_SUPPORTED
+    if (m_graph != nullptr)
+        LogicError("ComputeGraph::BeginCapture: The graph was captured already.");
+
+    PrepareDevice(m_deviceId);
+
+    // the captured work reads what the caller's stream computed before
+    m_callerStream = GetStream();
+    CUDA_CALL(cudaEventRecord(m_event, m_callerStream));
+    CUDA_CALL(cudaStreamWaitEvent(m_stream, m_event, 0 /*flags 'must be 0'*/));
+
+    CUDA_CALL(cudaStreamBeginCapture(m_stream, cudaStreamCaptureModeRelaxed));
+    CUDACachingMemAllocator::ForDevice(m_deviceId).BeginGraphCapture();
+    m_numHostTransfersBeforeCapture = GPUMathOptions::GetNumHostTransfers();
+    SetStream(m_stream);
+#else
+    NOT_IMPLEMENTED;
+#endif
+}
+
+bool ComputeGraph::EndCapture()
+{
+#if CUDA_GRAPHS_SUPPORTED
+    PrepareDevice(m_deviceId);
+
+    SetStream(m_callerStream);
+    m_blocks = CUDACachingMemAllocator::ForDevice(m_deviceId).EndGraphCapture();
+
+    cudaGraph_t graph = nullptr;
+    cudaError_t rc = cudaStreamEndCapture(m_stream, &graph);
+    if (rc != cudaSuccess)
+        cudaGetLastError(); // an operation that cannot be captured invalidated the capture; clear the error state
+    if (rc != cudaSuccess || GPUMathOptions::GetNumHostTransfers() != m_numHostTransfersBeforeCapture)
+    {
+        if (graph != nullptr)
+            cudaGraphDestroy(graph);
+        // nothing will write to the freed blocks
+        CUDACachingMemAllocator::ForDevice(m_deviceId).ReleaseGraphBlocks(m_blocks);
+        m_blocks.clear();
+        return false;
+    }
+
+    m_graph = graph;
+    CUDA_CALL(cudaGraphInstantiate(&m_graphExec, m_graph, nullptr, nullptr, 0));
+    return true;
+#else
+    return false;
+#endif
+}
+
+void ComputeGraph::Launch()
+{
+#if CUDA_GRAPHS_SUPPORTED
+    if (m_graphExec == nullptr)
+        LogicError("ComputeGraph::Launch: The graph was not captured.");
+
+    PrepareDevice(m_deviceId);
+
+    cudaStream_t callerStream = GetStream();
+    CUDA_CALL(cudaEventRecord(m_event, callerStream));
+    CUDA_CALL(cudaStreamWaitEvent(m_stream, m_event, 0));
+    CUDA_CALL(cudaGraphLaunch(m_graphExec, m_stream));
+    CUDA_CALL(cudaEventRecord(m_event, m_stream));
+    CUDA_CALL(cudaStreamWaitEvent(callerStream, m_event, 0));
+#else
+    NOT_IMPLEMENTED;
+#endif
+}
+} } }
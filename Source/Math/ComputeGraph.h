@@ -0,0 +1,72 @@
+#pragma once
+
+#include "Basics.h"
+#include "CommonMatrix.h"
+#include <vector>
+
+#ifdef _WIN32
+#ifndef MATH_API
+#ifdef MATH_EXPORTS
+#define MATH_API __declspec(dllexport)
+#else
+#define MATH_API __declspec(dllimport)
+#endif
+#endif /* MATH_API */
+#else  // no DLLs in Linux
+#define MATH_API
+#endif
+
+typedef struct CUstream_st* cudaStream_t;
+typedef struct CUevent_st* cudaEvent_t;
+typedef struct CUgraph_st* cudaGraph_t;
+typedef struct CUgraphExec_st* cudaGraphExec_t;
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// A CUDA graph of the GPU work that a piece of host code issues, for running that work again without the host code.
+// Between BeginCapture() and EndCapture(), the current stream (see SetStream()) is a private stream whose work is recorded
+// into the graph instead of being run. Launch() then runs the recorded work, as often as needed. Each launch repeats the
+// kernels with the arguments they had during the capture: the same device buffers, sizes and scalars. It is up to the caller
+// to only launch the graph where the host code would have issued the same work again.
+//  - Transfers between host and device are not part of the graph (and would have read or written the wrong data during the
+//    capture). If the host code makes any (see GPUMathOptions::GetNumHostTransfers()), the capture fails.
+//  - Work on the legacy default stream is not part of the graph either, and fails the capture.
+//  - Device memory that the host code allocates or frees during the capture is kept for the graph, since each launch writes
+//    to it again (see CUDACachingMemAllocator::BeginGraphCapture()). It is returned when the graph is destructed.
+// Requires CUDA 10.1 and the caching GPU memory allocator, see IsSupported().
+class MATH_API ComputeGraph
+{
+public:
+    ComputeGraph(DEVICEID_TYPE deviceId);
+    ~ComputeGraph();
+
+    // Disallow copy and move construction and assignment
+    DISABLE_COPY_AND_MOVE(ComputeGraph);
+
+    static bool IsSupported();
+
+    DEVICEID_TYPE GetDeviceId() const { return m_deviceId; }
+
+    void BeginCapture();
+    // returns false if the captured work cannot be launched; in either case, it has not run yet
+    // Must also be called if the host code throws, to end the capture.
+    bool EndCapture();
+    bool IsCaptured() const;
+
+    // runs the captured work, after the work issued to the current stream so far, and before the work issued to it later
+    void Launch();
+
+private:
+    DEVICEID_TYPE m_deviceId;
+
+#ifndef CPUONLY
+    cudaStream_t m_stream;       // the work is captured on and launched on this stream
+    cudaStream_t m_callerStream; // current stream at BeginCapture()
+    cudaEvent_t m_event;
+    cudaGraph_t m_graph;
+    cudaGraphExec_t m_graphExec;
+    size_t m_numHostTransfersBeforeCapture;
+    std::vector<void*> m_blocks; // device memory that was freed during the capture
+#endif // !CPUONLY
+};
+} } }
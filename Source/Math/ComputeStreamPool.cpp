@@ -0,0 +1,189 @@
+#include "stdafx.h"
+#include "Basics.h"
+#include "ComputeStreamPool.h"
+#include "GPUMatrix.h"
+#include <map>
+#include <mutex>
+#include <condition_variable>
+
+#pragma comment(lib, "cudart.lib")
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+ComputeStreamPool::ComputeStreamPool(DEVICEID_TYPE deviceId, size_t numStreams, bool nonBlocking)
+    : m_deviceId(deviceId), m_numStreams(numStreams), m_mainStream(nullptr)
+{
+    if (deviceId < 0 || numStreams == 0)
+        InvalidArgument("ComputeStreamPool: needs a GPU device and at least one stream.");
+
+    PrepareDevice(m_deviceId);
+
+    // by default not cudaStreamNonBlocking: the many operations on the legacy default stream must keep ordering against the pool
+    m_streams.resize(m_numStreams + 1);
+    for (auto& stream : m_streams)
+        CUDA_CALL(cudaStreamCreateWithFlags(&stream, nonBlocking ? cudaStreamNonBlocking : cudaStreamDefault));
+    CUDA_CALL(cudaEventCreateWithFlags(&m_forkEvent, cudaEventDisableTiming));
+}
+
+ComputeStreamPool::~ComputeStreamPool()
+{
+    // errors are ignored, the destructor may run while an exception is propagated
+    PrepareDevice(m_deviceId);
+    for (auto& event : m_events)
+    {
+        if (event != nullptr)
+            cudaEventDestroy(event);
+    }
+    cudaEventDestroy(m_forkEvent);
+    for (auto& stream : m_streams)
+        cudaStreamDestroy(stream);
+}
+
+void ComputeStreamPool::Fork()
+{
+    PrepareDevice(m_deviceId);
+
+    m_mainStream = GetStream();
+    CUDA_CALL(cudaEventRecord(m_forkEvent, m_mainStream));
+    for (auto& stream : m_streams)
+        CUDA_CALL(cudaStreamWaitEvent(stream, m_forkEvent, 0 /*flags 'must be 0'*/));
+}
+
+void ComputeStreamPool::Join()
+{
+    PrepareDevice(m_deviceId);
+
+    // reuse the fork event: cudaStreamWaitEvent() takes the state of the event at the time of the call
+    for (auto& stream : m_streams)
+    {
+        CUDA_CALL(cudaEventRecord(m_forkEvent, stream));
+        CUDA_CALL(cudaStreamWaitEvent(m_mainStream, m_forkEvent, 0));
+    }
+    SetStream(m_mainStream);
+}
+
+void ComputeStreamPool::Use(size_t stream)
+{
+    if (stream >= m_numStreams)
+        LogicError("ComputeStreamPool::Use: stream index %d out of range.", (int) stream);
+    SetStream(m_streams[stream]);
+}
+
+void ComputeStreamPool::UseCollectStream()
+{
+    SetStream(m_streams[m_numStreams]);
+}
+
+void ComputeStreamPool::UseMainStream()
+{
+    SetStream(m_mainStream);
+}
+
+void ComputeStreamPool::Record(size_t event)
+{
+    PrepareDevice(m_deviceId);
+
+    if (event >= m_events.size())
+        m_events.resize(event + 1, nullptr);
+    if (m_events[event] == nullptr)
+        CUDA_CALL(cudaEventCreateWithFlags(&m_events[event], cudaEventDisableTiming));
+    CUDA_CALL(cudaEventRecord(m_events[event], GetStream()));
+}
+
+void ComputeStreamPool::Wait(size_t event)
+{
+    if (event >= m_events.size() || m_events[event] == nullptr)
+        LogicError("ComputeStreamPool::Wait: event %d was never recorded.", (int) event);
+    CUDA_CALL(cudaStreamWaitEvent(GetStream(), m_events[event], 0));
+}
+
+// -----------------------------------------------------------------------
+// SharedComputeStreams
+// -----------------------------------------------------------------------
+
+static size_t s_maxSharedStreams = 0;
+static std::mutex s_sharedStreamsMutex;
+static std::condition_variable s_sharedStreamReleased;
+
+struct SharedDeviceStreams
+{
+    SharedDeviceStreams() : m_numCreated(0) { }
+    std::vector<cudaStream_t> m_free;
+    size_t m_numCreated;
+};
+static std::map<DEVICEID_TYPE, SharedDeviceStreams> s_sharedStreams; // (the streams live until the process ends)
+static thread_local cudaStream_t t_sharedStream = nullptr; // taken by an outer Scope of this thread
+
+void SharedComputeStreams::SetMaxStreams(size_t maxStreams)
+{
+    {
+        std::lock_guard<std::mutex> lock(s_sharedStreamsMutex);
+        s_maxSharedStreams = maxStreams;
+    }
+    s_sharedStreamReleased.notify_all(); // a larger limit may let waiting threads create a stream
+}
+
+size_t SharedComputeStreams::GetMaxStreams()
+{
+    std::lock_guard<std::mutex> lock(s_sharedStreamsMutex);
+    return s_maxSharedStreams;
+}
+
+cudaStream_t SharedComputeStreams::Current()
+{
+    return t_sharedStream;
+}
+
+cudaStream_t SharedComputeStreams::Acquire(DEVICEID_TYPE deviceId)
+{
+    std::unique_lock<std::mutex> lock(s_sharedStreamsMutex);
+    auto& streams = s_sharedStreams[deviceId];
+    s_sharedStreamReleased.wait(lock, [&]() { return s_maxSharedStreams == 0 || !streams.m_free.empty() || streams.m_numCreated < s_maxSharedStreams; });
+    if (s_maxSharedStreams == 0)
+        return nullptr;
+    if (!streams.m_free.empty())
+    {
+        cudaStream_t stream = streams.m_free.back();
+        streams.m_free.pop_back();
+        return stream;
+    }
+    cudaStream_t stream;
+    CUDA_CALL(cudaStreamCreateWithFlags(&stream, cudaStreamDefault)); // blocking, see header
+    streams.m_numCreated++;
+    return stream;
+}
+
+void SharedComputeStreams::Release(DEVICEID_TYPE deviceId, cudaStream_t stream)
+{
+    {
+        std::lock_guard<std::mutex> lock(s_sharedStreamsMutex);
+        s_sharedStreams[deviceId].m_free.push_back(stream);
+    }
+    s_sharedStreamReleased.notify_one();
+}
+
+SharedComputeStreams::Scope::Scope(DEVICEID_TYPE deviceId)
+    : m_deviceId(deviceId), m_stream(nullptr), m_prevStream(GetStream())
+{
+    if (m_deviceId < 0 || t_sharedStream != nullptr)
+        return;
+    PrepareDevice(m_deviceId);
+    m_stream = Acquire(m_deviceId);
+    if (m_stream != nullptr)
+    {
+        SetStream(m_stream);
+        t_sharedStream = m_stream;
+    }
+}
+
+SharedComputeStreams::Scope::~Scope()
+{
+    if (m_stream == nullptr)
+        return;
+    // errors are ignored, the destructor may run while an exception is propagated; the stream is returned either way
+    cudaStreamSynchronize(m_stream);
+    SetStream(m_prevStream);
+    t_sharedStream = nullptr;
+    Release(m_deviceId, m_stream);
+}
+} } }
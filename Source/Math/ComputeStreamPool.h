@@ -0,0 +1,106 @@
+#pragma once
+
+#include "Basics.h"
+#include "CommonMatrix.h"
+#include <vector>
+
+#ifdef _WIN32
+#ifndef MATH_API
+#ifdef MATH_EXPORTS
+#define MATH_API __declspec(dllexport)
+#else
+#define MATH_API __declspec(dllimport)
+#endif
+#endif /* MATH_API */
+#else  // no DLLs in Linux
+#define MATH_API
+#endif
+
+typedef struct CUstream_st* cudaStream_t;
+typedef struct CUevent_st* cudaEvent_t;
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// A small set of CUDA streams on one GPU, for running independent parts of the network concurrently.
+// All GPU operations go to the current stream (see SetStream()). Between Fork() and Join(), Use() selects one of the
+// streams of the pool as the current stream, and the order between them is expressed by waiting on recorded events:
+//  - Fork() makes all streams of the pool wait for the work issued so far to the current stream, the main stream
+//  - Record(e) records the position of the current stream in event slot e; Wait(e) makes the current stream wait for it
+//  - Join() makes the main stream wait for all work issued to the pool, and makes it the current stream again
+// The streams are blocking streams, so operations that are not stream-ordered (e.g. cudaMemcpy()) still synchronize with them.
+// With nonBlocking, they are not, and their work also overlaps with that on the legacy default stream; only stream-ordered
+// operations may then be issued to them.
+class MATH_API ComputeStreamPool
+{
+public:
+    ComputeStreamPool(DEVICEID_TYPE deviceId, size_t numStreams, bool nonBlocking = false);
+    ~ComputeStreamPool();
+
+    // Disallow copy and move construction and assignment
+    DISABLE_COPY_AND_MOVE(ComputeStreamPool);
+
+    DEVICEID_TYPE GetDeviceId() const { return m_deviceId; }
+    size_t GetNumStreams() const { return m_numStreams; }
+
+    void Fork();
+    void Join();
+    void Use(size_t stream);
+
+    // The collect stream does no work of its own, it only waits for events. So an event recorded on it, or on the work that
+    // is issued to it, comes after everything it has waited for since Fork(), across all streams of the pool.
+    void UseCollectStream();
+
+    // makes the main stream of the last Fork() the current stream again, without waiting for the pool
+    void UseMainStream();
+
+    void Record(size_t event);
+    void Wait(size_t event);
+
+private:
+    DEVICEID_TYPE m_deviceId;
+    size_t m_numStreams;
+
+#ifndef CPUONLY
+    cudaStream_t m_mainStream; // current stream at Fork()
+    std::vector<cudaStream_t> m_streams; // [m_numStreams] is the collect stream
+    std::vector<cudaEvent_t> m_events;   // event slots, created on first use
+    cudaEvent_t m_forkEvent;
+#endif // !CPUONLY
+};
+
+// Streams of a GPU that are lent to the threads of a process for one request at a time, e.g. to the evaluators that serve
+// several models on one GPU. By default all of them issue their work to the legacy default stream, and run one after the other.
+// A Scope takes a stream that no other thread uses, makes it the current stream, and on exit waits for the work issued to it
+// (so the results are ready for the caller) before returning it. At most SetMaxStreams() streams per device are created; when
+// all are taken, a Scope waits for one. The cuBLAS and cuDNN handles and the cuDNN workspace are kept per stream, so they are
+// shared by all requests but never used by two threads at once. The streams are blocking streams, so work that still goes to
+// the legacy default stream (e.g. cudaMemcpy()) keeps its order against them.
+class MATH_API SharedComputeStreams
+{
+public:
+    // 0 (default) disables the streams: a Scope leaves the current stream unchanged
+    static void SetMaxStreams(size_t maxStreams);
+    static size_t GetMaxStreams();
+
+    // the stream that the calling thread took (in an outer Scope), or nullptr
+    static cudaStream_t Current();
+
+    class MATH_API Scope
+    {
+    public:
+        Scope(DEVICEID_TYPE deviceId); // (no-op for the CPU)
+        ~Scope();
+
+        DISABLE_COPY_AND_MOVE(Scope);
+
+    private:
+        DEVICEID_TYPE m_deviceId;
+        cudaStream_t m_stream; // nullptr if none was taken
+        cudaStream_t m_prevStream;
+    };
+
+private:
+    static cudaStream_t Acquire(DEVICEID_TYPE deviceId);
+    static void Release(DEVICEID_TYPE deviceId, cudaStream_t stream);
+};
+} } }
@@ -15,10 +15,11 @@ void ConvolutionEngine<ElemType>::Forward(const Tensor4D& inT, const Mat& in, co
 {
     assert(inT.w() * inT.h() * inT.c() == in.GetNumRows());
     assert(inT.n() == in.GetNumCols());
-    assert(filterT.k() == filter.GetNumRows());
-    assert(filterT.w() * filterT.h() * filterT.c() == filter.GetNumCols());
-    assert(inT.c() == filterT.c());
+    assert(filterT.k() == (m_quantizedFilter ? m_quantizedFilter->GetNumRows() : filter.GetNumRows()));
+    assert(filterT.w() * filterT.h() * filterT.c() == (m_quantizedFilter ? m_quantizedFilter->GetNumCols() : filter.GetNumCols()));
+    assert(inT.c() == filterT.c() * convDesc.groups());
     assert(outT.c() == filterT.k());
+    assert(filterT.k() % convDesc.groups() == 0);
     assert(outT.w() * outT.h() * outT.c() == out.GetNumRows());
     assert(outT.n() == out.GetNumCols());
 
@@ -35,7 +36,7 @@ void ConvolutionEngine<ElemType>::BackwardData(const Tensor4D& srcGradT, const M
     assert(filterT.k() == filter.GetNumRows());
     assert(filterT.w() * filterT.h() * filterT.c() == filter.GetNumCols());
     assert(srcGradT.c() == filterT.k());
-    assert(gradT.c() == filterT.c());
+    assert(gradT.c() == filterT.c() * convDesc.groups());
     assert(gradT.w() * gradT.h() * gradT.c() == grad.GetNumRows());
     assert(gradT.n() == grad.GetNumCols());
 
@@ -52,7 +53,7 @@ void ConvolutionEngine<ElemType>::BackwardFilter(const Tensor4D& srcGradT, const
     assert(inT.w() * inT.h() * inT.c() == in.GetNumRows());
     assert(inT.n() == in.GetNumCols());
     assert(srcGradT.c() == filterT.k());
-    assert(inT.c() == filterT.c());
+    assert(inT.c() == filterT.c() * convDesc.groups());
     assert(filterT.k() == filter.GetNumRows());
     assert(filterT.w() * filterT.h() * filterT.c() == filter.GetNumCols());
 
@@ -63,7 +64,7 @@ void ConvolutionEngine<ElemType>::BackwardFilter(const Tensor4D& srcGradT, const
 template <class ElemType>
 void ConvolutionEngine<ElemType>::NormalizeBatch(const Tensor4D& inT, const Mat& in, const Tensor4D& scaleBiasT, const Mat& scale, const Mat& bias,
                                                  bool spatial, double expAvgFactor, Mat& runMean, Mat& runInvStdDev, Mat& out,
-                                                 double epsilon, Mat& saveMean, Mat& saveInvStdDev)
+                                                 double epsilon, Mat& saveMean, Mat& saveInvStdDev, bool relu)
 {
     const size_t crowIn = inT.w() * inT.h() * inT.c();
     if (spatial)
@@ -101,12 +102,12 @@ void ConvolutionEngine<ElemType>::NormalizeBatch(const Tensor4D& inT, const Mat&
 #endif
 
     EnsureCompatibleBatchNorm(spatial);
-    NormalizeBatchCore(inT, in, scaleBiasT, scale, bias, spatial, expAvgFactor, runMean, runInvStdDev, out, epsilon, saveMean, saveInvStdDev);
+    NormalizeBatchCore(inT, in, scaleBiasT, scale, bias, spatial, expAvgFactor, runMean, runInvStdDev, out, epsilon, saveMean, saveInvStdDev, relu);
 }
 
 template <class ElemType>
 void ConvolutionEngine<ElemType>::NormalizeBatchInference(const Tensor4D& inT, const Mat& in, const Tensor4D& scaleBiasT, const Mat& scale, const Mat& bias,
-                                                          bool spatial, const Mat& runMean, const Mat& runInvStdDev, Mat& out)
+                                                          bool spatial, const Mat& runMean, const Mat& runInvStdDev, Mat& out, bool relu)
 {
     const size_t crowIn = inT.w() * inT.h() * inT.c();
 
@@ -141,13 +142,13 @@ void ConvolutionEngine<ElemType>::NormalizeBatchInference(const Tensor4D& inT, c
 #endif
 
     EnsureCompatibleBatchNorm(spatial);
-    NormalizeBatchInferenceCore(inT, in, scaleBiasT, scale, bias, spatial, runMean, runInvStdDev, out);
+    NormalizeBatchInferenceCore(inT, in, scaleBiasT, scale, bias, spatial, runMean, runInvStdDev, out, relu);
 }
 
 template <class ElemType>
 void ConvolutionEngine<ElemType>::BackwardNormalizeBatch(const Tensor4D& inT, const Mat& in, const Mat& srcGrad, Mat& grad,
                                                          const Tensor4D& scaleBiasT, const Mat& scale, bool spatial, const Mat& saveMean, const Mat& saveInvStdDev,
-                                                         Mat& scaleGrad, Mat& biasGrad)
+                                                         Mat& scaleGrad, Mat& biasGrad, const Mat* reluOut)
 {
     const size_t crowIn = inT.w() * inT.h() * inT.c();
 
@@ -174,12 +175,13 @@ void ConvolutionEngine<ElemType>::BackwardNormalizeBatch(const Tensor4D& inT, co
     assert(scaleGrad.GetNumCols() == scale.GetNumCols());
     assert(biasGrad.GetNumRows() == scale.GetNumRows());
     assert(biasGrad.GetNumCols() == scale.GetNumCols());
+    assert(reluOut == nullptr || (reluOut->GetNumRows() == crowIn && reluOut->GetNumCols() == inT.n()));
 #ifndef _DEBUG
     UNUSED(crowIn); // crowIn used only in asserts.
 #endif
 
     EnsureCompatibleBatchNorm(spatial);
-    BackwardNormalizeBatchCore(inT, in, srcGrad, grad, scaleBiasT, scale, spatial, saveMean, saveInvStdDev, scaleGrad, biasGrad);
+    BackwardNormalizeBatchCore(inT, in, srcGrad, grad, scaleBiasT, scale, spatial, saveMean, saveInvStdDev, scaleGrad, biasGrad, reluOut);
 }
 
 //------------------------------------------------------------------
@@ -197,13 +199,15 @@ public:
 
 public:
     DefaultConvolutionEngine(DEVICEID_TYPE deviceId, ImageLayoutKind imageLayout, size_t maxTempMemSizeInSamples, BatchNormImpl bnImpl)
-        : Base(deviceId, imageLayout), m_ones(deviceId), m_maxTempMemSizeInSamples(maxTempMemSizeInSamples), m_bnImpl(bnImpl)
+        : Base(deviceId, imageLayout), m_ones(deviceId), m_maxTempMemSizeInSamples(maxTempMemSizeInSamples), m_bnImpl(bnImpl),
+          m_gpuSparseOpt(false), m_gpuSparse1D(false), m_workspaceHoldsPackedInput(false)
     {
     }
 
 protected:
     using Base::m_deviceId;
     using Base::m_imageLayout;
+    using Base::m_quantizedFilter;
 
     void EnsureCompatible() override
     {
@@ -211,6 +215,12 @@ protected:
             RuntimeError("Default convolution engine currently supports only HWC/legacy layout.");
     }
 
+    // the int8 product is only implemented on the CPU, which is where the dense path is taken
+    bool SupportsQuantizedFilter() const override
+    {
+        return m_deviceId == CPUDEVICE;
+    }
+
     void ForwardCore(const Tensor4D& inT, const Mat& in, const Filter& filterT, const Mat& filter, const ConvDesc& convDesc,
                  const Tensor4D& outT, Mat& out, Mat& workspace) override
     {
@@ -223,7 +233,7 @@ protected:
         size_t batchSize = inT.n();
         size_t maxTempMemSizeInSamples = (m_maxTempMemSizeInSamples == 0 ? batchSize : m_maxTempMemSizeInSamples);
 
-        assert(filter.GetNumCols() == packedInputRows && filter.GetNumRows() == outT.c());
+        assert(m_quantizedFilter || (filter.GetNumCols() == packedInputRows && filter.GetNumRows() == outT.c()));
         UNUSED(packedInputRows);
 
         // GPU and 1-dimensional image
@@ -236,6 +246,33 @@ protected:
 
         out.SwitchToMatrixType(MatrixType::DENSE, MatrixFormat::matrixFormatDense, false);
 
+        // Grouped and depthwise convolutions have their own kernels on both devices, which neither unroll the input
+        // nor use the workspace. Unrolling would multiply the packed input of each group with a small slice of the filter.
+        m_workspaceHoldsPackedInput = false;
+        if (convDesc.groups() != 1)
+        {
+            if (m_quantizedFilter)
+                LogicError("Int8 quantized filters are not supported for grouped convolution.");
+            m_gpuSparseOpt = m_gpuSparse1D = false;
+            out.AssignGroupedConvolutionResult(DenseOf(in), filter,
+                                               inT.w(), inT.h(), inT.c(),
+                                               outT.w(), outT.h(), outT.c(),
+                                               filterT.w(), filterT.h(), convDesc.wStride(), convDesc.hStride(),
+                                               convDesc.padding(), convDesc.groups());
+            return;
+        }
+
+        // [Scenario 0] Dense on the CPU: convolve directly, without unrolling the input into the workspace.
+        if (m_deviceId == CPUDEVICE && in.GetMatrixType() == MatrixType::DENSE && !m_quantizedFilter)
+        {
+            out.AssignConvolutionResult(in, filter,
+                                        inT.w(), inT.h(), inT.c(),
+                                        outT.w(), outT.h(), outT.c(),
+                                        filterT.w(), filterT.h(), convDesc.wStride(), convDesc.hStride(),
+                                        convDesc.padding());
+            return;
+        }
+
         // Reshaping is only necessary if we are going to use the unpacking trick
         if (m_gpuSparseOpt)
             out.Reshape(outT.c() * outT.w(), outT.h() * batchSize);
@@ -244,6 +281,7 @@ protected:
 
         size_t subBatchSize = min(batchSize, maxTempMemSizeInSamples);
         size_t numSubBatches = (batchSize + subBatchSize - 1) / subBatchSize;
+        m_workspaceHoldsPackedInput = numSubBatches == 1 && !m_gpuSparseOpt;
 
         for (size_t i = 0; i < numSubBatches; i++)
         {
@@ -284,7 +322,10 @@ protected:
 
                 // workspace.Resize(packedInputRows, packedInputColsPerSample * smallBatchSize);
                 // BUGBUG: This ^^ destroys the content of the matrix. Also it seems not to change the size. Does it? Should this be a Reshape()?
-                Mat::Multiply(filter, false, workspace, false, outputSubBatch);
+                if (m_quantizedFilter)
+                    m_quantizedFilter->Multiply(workspace, outputSubBatch);
+                else
+                    Mat::Multiply(filter, false, workspace, false, outputSubBatch);
             }
         }
 
@@ -305,6 +346,16 @@ protected:
 
         size_t batchSize = srcGradT.n();
 
+        if (convDesc.groups() != 1)
+        {
+            grad.AddGroupedConvolutionGradientOfInput(srcGrad, filter,
+                                                      gradT.w(), gradT.h(), gradT.c(),
+                                                      srcGradT.w(), srcGradT.h(), srcGradT.c(),
+                                                      filterT.w(), filterT.h(), convDesc.wStride(), convDesc.hStride(),
+                                                      convDesc.padding(), convDesc.groups());
+            return;
+        }
+
         size_t maxTempMemSizeInSamples = (m_maxTempMemSizeInSamples == 0 ? batchSize : m_maxTempMemSizeInSamples);
 
         // Create slice which is the same as full matrix so we can reshape it.
@@ -347,6 +398,16 @@ protected:
 
         size_t batchSize = inT.n();
 
+        if (convDesc.groups() != 1)
+        {
+            filter.AddGroupedConvolutionGradientOfFilter(srcGrad, DenseOf(in),
+                                                         inT.w(), inT.h(), inT.c(),
+                                                         srcGradT.w(), srcGradT.h(), srcGradT.c(),
+                                                         filterT.w(), filterT.h(), convDesc.wStride(), convDesc.hStride(),
+                                                         convDesc.padding(), convDesc.groups());
+            return;
+        }
+
         size_t maxTempMemSizeInSamples = (m_maxTempMemSizeInSamples == 0 ? batchSize : m_maxTempMemSizeInSamples);
 
         // const Matrix<ElemType> & weightMatrix = input0;
@@ -359,7 +420,7 @@ protected:
         size_t subBatchSize = min(batchSize, maxTempMemSizeInSamples);
         size_t numSubBatches = (batchSize + subBatchSize - 1) / subBatchSize;
 
-        if (numSubBatches == 1 && allowReuse && !m_gpuSparseOpt) // reuse packed input from evaluation step if it's not changed by either subbatch or recurrent steps.
+        if (numSubBatches == 1 && allowReuse && m_workspaceHoldsPackedInput) // reuse packed input from evaluation step if it's not changed by either subbatch or recurrent steps.
             // REVIEW alexeyk: the following makes an assumption that data in workspace was filled by Forward call and remained unchanged. Find way to enforce/verify that.
             Matrix<ElemType>::MultiplyAndAdd(srcGradTmp, false, workspace, true, filter);
         else
@@ -420,79 +481,234 @@ protected:
             InvalidArgument("This engine batch normalization currently supports only CHW data layout for convolutional nodes.");
     }
 
+    // Batch normalization on the CPU. Each statistic (a row, or with 'spatial' a feature map of w*h rows) is reduced over all
+    // columns. The rows of a block of statistics are contiguous in each column, so the reductions first sum each row over the
+    // columns (the inner loops run over contiguous rows and are vectorized), then the rows of each statistic.
+    static size_t NumStatisticsPerBlock(size_t spatialSize)
+    {
+        return max((size_t) 1, (size_t) 64 / spatialSize);
+    }
+
     void NormalizeBatchCore(const Tensor4D& inT, const Mat& in, const Tensor4D& scaleBiasT, const Mat& scale, const Mat& bias,
-                        bool spatial, double expAvgFactor, Mat& runMean, Mat& runInvStdDev, Mat& out, double epsilon, Mat& saveMean, Mat& saveInvStdDev) override
+                        bool spatial, double expAvgFactor, Mat& runMean, Mat& runInvStdDev, Mat& out, double epsilon, Mat& saveMean, Mat& saveInvStdDev, bool relu) override
     {
-        UNUSED(inT);
-        UNUSED(in);
         UNUSED(scaleBiasT);
-        UNUSED(scale);
-        UNUSED(bias);
-        UNUSED(out);
-        UNUSED(spatial);
-        UNUSED(expAvgFactor);
-        UNUSED(runMean);
-        UNUSED(runInvStdDev);
-        UNUSED(epsilon);
-        UNUSED(saveMean);
-        UNUSED(saveInvStdDev);
-        RuntimeError("Not yet implemented.");
+        const size_t vectorSize = in.GetNumRows();
+        const size_t batchSize = in.GetNumCols();
+        const size_t spatialSize = spatial ? inT.w() * inT.h() : 1;
+        const size_t numStats = vectorSize / spatialSize;
+        const size_t statsPerBlock = NumStatisticsPerBlock(spatialSize);
+        const double m = (double) batchSize * spatialSize;
+        const ElemType* x = in.BufferPointer();
+        ElemType* y = out.BufferPointer();
+
+#pragma omp parallel for
+        for (long block = 0; block < (long) ((numStats + statsPerBlock - 1) / statsPerBlock); block++)
+        {
+            const size_t stat0 = block * statsPerBlock;
+            const size_t stat1 = min(stat0 + statsPerBlock, numStats);
+            const size_t row0 = stat0 * spatialSize;
+            const size_t numRows = (stat1 - stat0) * spatialSize;
+
+            // mean, then the variance around it
+            std::vector<double> rowSum(numRows, 0);
+            for (size_t j = 0; j < batchSize; j++)
+            {
+                const ElemType* px = x + j * vectorSize + row0;
+                for (size_t i = 0; i < numRows; i++)
+                    rowSum[i] += px[i];
+            }
+            std::vector<ElemType> rowMean(numRows);
+            for (size_t s = stat0; s < stat1; s++)
+            {
+                double sum = 0;
+                for (size_t i = (s - stat0) * spatialSize; i < (s - stat0 + 1) * spatialSize; i++)
+                    sum += rowSum[i];
+                saveMean(s, 0) = (ElemType) (sum / m);
+                std::fill(rowMean.begin() + (s - stat0) * spatialSize, rowMean.begin() + (s - stat0 + 1) * spatialSize, saveMean(s, 0));
+            }
+            std::fill(rowSum.begin(), rowSum.end(), 0);
+            for (size_t j = 0; j < batchSize; j++)
+            {
+                const ElemType* px = x + j * vectorSize + row0;
+                for (size_t i = 0; i < numRows; i++)
+                    rowSum[i] += (px[i] - rowMean[i]) * (px[i] - rowMean[i]);
+            }
+
+            // y = a * x + b, with a = scale * invStdDev and b = bias - a * mean
+            std::vector<ElemType> a(numRows), b(numRows);
+            for (size_t s = stat0; s < stat1; s++)
+            {
+                double sqrSum = 0;
+                for (size_t i = (s - stat0) * spatialSize; i < (s - stat0 + 1) * spatialSize; i++)
+                    sqrSum += rowSum[i];
+                const ElemType mean = saveMean(s, 0);
+                const ElemType invStdDev = (ElemType) (1.0 / sqrt(sqrSum / m + epsilon));
+                saveInvStdDev(s, 0) = invStdDev;
+                runMean(s, 0) = expAvgFactor == 1 ? mean : (ElemType) (expAvgFactor * mean + (1.0 - expAvgFactor) * runMean(s, 0));
+                runInvStdDev(s, 0) = expAvgFactor == 1 ? invStdDev : (ElemType) (expAvgFactor * invStdDev + (1.0 - expAvgFactor) * runInvStdDev(s, 0));
+                std::fill(a.begin() + (s - stat0) * spatialSize, a.begin() + (s - stat0 + 1) * spatialSize, scale(s, 0) * invStdDev);
+                std::fill(b.begin() + (s - stat0) * spatialSize, b.begin() + (s - stat0 + 1) * spatialSize, bias(s, 0) - scale(s, 0) * invStdDev * mean);
+            }
+            ApplyAffine(x, y, vectorSize, batchSize, row0, numRows, a, b, relu);
+        }
+    }
+
+    // y = a * x + b for the given rows of all columns, optionally followed by max(0, .)
+    static void ApplyAffine(const ElemType* x, ElemType* y, size_t vectorSize, size_t batchSize, size_t row0, size_t numRows,
+                            const std::vector<ElemType>& a, const std::vector<ElemType>& b, bool relu)
+    {
+        for (size_t j = 0; j < batchSize; j++)
+        {
+            const ElemType* px = x + j * vectorSize + row0;
+            ElemType* py = y + j * vectorSize + row0;
+            if (relu)
+            {
+                for (size_t i = 0; i < numRows; i++)
+                    py[i] = max((ElemType) 0, a[i] * px[i] + b[i]);
+            }
+            else
+            {
+                for (size_t i = 0; i < numRows; i++)
+                    py[i] = a[i] * px[i] + b[i];
+            }
+        }
     }
 
     void NormalizeBatchInferenceCore(const Tensor4D& inT, const Mat& in, const Tensor4D& scaleBiasT, const Mat& scale, const Mat& bias,
-                                 bool spatial, const Mat& runMean, const Mat& runInvStdDev, Mat& out) override
+                                 bool spatial, const Mat& runMean, const Mat& runInvStdDev, Mat& out, bool relu) override
     {
         UNUSED(scaleBiasT);
-        if (spatial)
+        const size_t vectorSize = in.GetNumRows();
+        const size_t batchSize = in.GetNumCols();
+        const size_t spatialSize = spatial ? inT.w() * inT.h() : 1;
+        const size_t numStats = vectorSize / spatialSize;
+        const size_t statsPerBlock = NumStatisticsPerBlock(spatialSize);
+        const ElemType* x = in.BufferPointer();
+        ElemType* y = out.BufferPointer();
+
+#pragma omp parallel for
+        for (long block = 0; block < (long) ((numStats + statsPerBlock - 1) / statsPerBlock); block++)
         {
-            size_t spatialSize = inT.w() * inT.h();
+            const size_t stat0 = block * statsPerBlock;
+            const size_t stat1 = min(stat0 + statsPerBlock, numStats);
+            const size_t numRows = (stat1 - stat0) * spatialSize;
+            std::vector<ElemType> a(numRows), b(numRows);
+            for (size_t s = stat0; s < stat1; s++)
+            {
+                const ElemType as = scale(s, 0) * runInvStdDev(s, 0);
+                std::fill(a.begin() + (s - stat0) * spatialSize, a.begin() + (s - stat0 + 1) * spatialSize, as);
+                std::fill(b.begin() + (s - stat0) * spatialSize, b.begin() + (s - stat0 + 1) * spatialSize, bias(s, 0) - as * runMean(s, 0));
+            }
+            ApplyAffine(x, y, vectorSize, batchSize, stat0 * spatialSize, numRows, a, b, relu);
+        }
+    }
+
+    // dScale = sum dy * xHat, dBias = sum dy, grad += scale * invStdDev * (dy - (xHat * dScale + dBias) / m), where xHat = (x - mean) * invStdDev
+    // and, with reluOut, dy = srcGrad where reluOut > 0 and 0 elsewhere
+    void BackwardNormalizeBatchCore(const Tensor4D& inT, const Mat& in, const Mat& srcGrad, Mat& grad,
+                                const Tensor4D& scaleBiasT, const Mat& scale, bool spatial, const Mat& saveMean, const Mat& saveInvStdDev,
+                                Mat& scaleGrad, Mat& biasGrad, const Mat* reluOut) override
+    {
+        UNUSED(scaleBiasT);
+        const size_t vectorSize = in.GetNumRows();
+        const size_t batchSize = in.GetNumCols();
+        const size_t spatialSize = spatial ? inT.w() * inT.h() : 1;
+        const size_t numStats = vectorSize / spatialSize;
+        const size_t statsPerBlock = NumStatisticsPerBlock(spatialSize);
+        const ElemType m = (ElemType) (batchSize * spatialSize);
+        const ElemType* x = in.BufferPointer();
+        const ElemType* dyAll = srcGrad.BufferPointer();
+        const ElemType* yAll = reluOut ? reluOut->BufferPointer() : nullptr;
+        ElemType* dx = grad.BufferPointer();
+
 #pragma omp parallel for
-            for (long icol = 0; icol < out.GetNumCols(); icol++)
+        for (long block = 0; block < (long) ((numStats + statsPerBlock - 1) / statsPerBlock); block++)
+        {
+            const size_t stat0 = block * statsPerBlock;
+            const size_t stat1 = min(stat0 + statsPerBlock, numStats);
+            const size_t row0 = stat0 * spatialSize;
+            const size_t numRows = (stat1 - stat0) * spatialSize;
+
+            std::vector<ElemType> mean(numRows), invStdDev(numRows);
+            for (size_t s = stat0; s < stat1; s++)
+            {
+                std::fill(mean.begin() + (s - stat0) * spatialSize, mean.begin() + (s - stat0 + 1) * spatialSize, saveMean(s, 0));
+                std::fill(invStdDev.begin() + (s - stat0) * spatialSize, invStdDev.begin() + (s - stat0 + 1) * spatialSize, saveInvStdDev(s, 0));
+            }
+
+            std::vector<ElemType> dy(numRows);
+            auto loadGradient = [&](size_t j)
+            {
+                const ElemType* pdy = dyAll + j * vectorSize + row0;
+                if (yAll)
+                {
+                    const ElemType* py = yAll + j * vectorSize + row0;
+                    for (size_t i = 0; i < numRows; i++)
+                        dy[i] = py[i] > 0 ? pdy[i] : 0;
+                }
+                else
+                    std::copy(pdy, pdy + numRows, dy.begin());
+            };
+
+            std::vector<double> rowDs(numRows, 0), rowDb(numRows, 0);
+            for (size_t j = 0; j < batchSize; j++)
             {
-                for (long irow = 0; irow < out.GetNumRows(); irow++)
+                loadGradient(j);
+                const ElemType* px = x + j * vectorSize + row0;
+                for (size_t i = 0; i < numRows; i++)
                 {
-                    size_t imap = irow / spatialSize;
-                    out(irow, icol) = scale(imap, 0) * (in(irow, icol) - runMean(imap, 0)) * runInvStdDev(imap, 0) + bias(imap, 0);
+                    rowDs[i] += dy[i] * (px[i] - mean[i]) * invStdDev[i];
+                    rowDb[i] += dy[i];
                 }
             }
-        }
-        else
-        {
-#pragma omp parallel for
-            for (long icol = 0; icol < out.GetNumCols(); icol++)
+            std::vector<ElemType> ds(numRows), db(numRows), a(numRows);
+            for (size_t s = stat0; s < stat1; s++)
             {
-                for (long irow = 0; irow < out.GetNumRows(); irow++)
+                double sumDs = 0, sumDb = 0;
+                for (size_t i = (s - stat0) * spatialSize; i < (s - stat0 + 1) * spatialSize; i++)
                 {
-                    out(irow, icol) = scale(irow, 0) * (in(irow, icol) - runMean(irow, 0)) * runInvStdDev(irow, 0) + bias(irow, 0);
+                    sumDs += rowDs[i];
+                    sumDb += rowDb[i];
+                }
+                scaleGrad(s, 0) = (ElemType) sumDs;
+                biasGrad(s, 0) = (ElemType) sumDb;
+                std::fill(ds.begin() + (s - stat0) * spatialSize, ds.begin() + (s - stat0 + 1) * spatialSize, (ElemType) sumDs);
+                std::fill(db.begin() + (s - stat0) * spatialSize, db.begin() + (s - stat0 + 1) * spatialSize, (ElemType) sumDb);
+                std::fill(a.begin() + (s - stat0) * spatialSize, a.begin() + (s - stat0 + 1) * spatialSize, scale(s, 0) * saveInvStdDev(s, 0));
+            }
+            for (size_t j = 0; j < batchSize; j++)
+            {
+                loadGradient(j);
+                const ElemType* px = x + j * vectorSize + row0;
+                ElemType* pdx = dx + j * vectorSize + row0;
+                for (size_t i = 0; i < numRows; i++)
+                {
+                    ElemType xHat = (px[i] - mean[i]) * invStdDev[i];
+                    pdx[i] += a[i] * (dy[i] - (xHat * ds[i] + db[i]) / m);
                 }
             }
         }
     }
 
-    void BackwardNormalizeBatchCore(const Tensor4D& inT, const Mat& in, const Mat& srcGrad, Mat& grad,
-                                const Tensor4D& scaleBiasT, const Mat& scale, bool spatial, const Mat& saveMean, const Mat& saveInvStdDev,
-                                Mat& scaleGrad, Mat& biasGrad) override
+private:
+    // the grouped convolution kernels read dense inputs; sparse ones are converted, as in scenario 3 of ForwardCore()
+    static Mat DenseOf(const Mat& in)
     {
-        UNUSED(inT);
-        UNUSED(in);
-        UNUSED(srcGrad);
-        UNUSED(grad);
-        UNUSED(scaleBiasT);
-        UNUSED(scale);
-        UNUSED(scaleGrad);
-        UNUSED(biasGrad);
-        UNUSED(spatial);
-        UNUSED(saveMean);
-        UNUSED(saveInvStdDev);
-        RuntimeError("Not yet implemented.");
+        if (in.GetMatrixType() == MatrixType::DENSE)
+            return in.AsReference();
+        Mat dense(in.GetDeviceId());
+        dense.SetValue(in, in.GetFormat());
+        dense.SwitchToMatrixType(MatrixType::DENSE, MatrixFormat::matrixFormatDense, true);
+        return dense;
     }
 
-private:
     size_t m_maxTempMemSizeInSamples;
     BatchNormImpl m_bnImpl;
     Mat m_ones;
     bool m_gpuSparseOpt;
     bool m_gpuSparse1D;
+    bool m_workspaceHoldsPackedInput; // the last Forward() left the unrolled input of all samples in the workspace
 };
 
 template class ConvolutionEngine<float>;
@@ -545,7 +761,7 @@ public:
 
 public:
     DefaultPoolingEngine(DEVICEID_TYPE deviceId, ImageLayoutKind imageLayout)
-        : Base(deviceId, imageLayout)
+        : Base(deviceId, imageLayout), m_argmaxInput(nullptr)
     {
     }
 
@@ -563,9 +779,12 @@ protected:
     {
         if (poolDesc.kind() == PoolDesc::PoolKind::Max)
         {
+            // on the CPU, the maxima are recorded for the backward pass of the same input
             out.AssignMaxPoolingResult(in, inT.c(), inT.w(), inT.h(), inT.w() * inT.h() * inT.c(),
                                        outT.w(), outT.h(), outT.w() * outT.h() * outT.c(),
-                                       poolDesc.w(), poolDesc.h(), poolDesc.wStride(), poolDesc.hStride());
+                                       poolDesc.w(), poolDesc.h(), poolDesc.wStride(), poolDesc.hStride(),
+                                       &m_argmax);
+            m_argmaxInput = m_argmax.empty() ? nullptr : in.BufferPointer();
         }
         else if (poolDesc.kind() == PoolDesc::PoolKind::Average)
         {
@@ -579,7 +798,11 @@ protected:
 
     void BackwardCore(const Tensor4D& outT, const Mat& out, const Mat& srcGrad, const PoolDesc& poolDesc, const Tensor4D& inT, const Mat& in, Mat& grad) override
     {
-        if (poolDesc.kind() == PoolDesc::PoolKind::Max)
+        if (poolDesc.kind() == PoolDesc::PoolKind::Max && HasArgmaxOf(in, out))
+        {
+            grad.AddMaxPoolingGradientAtArgmax(srcGrad, m_argmax, inT.c(), inT.w() * inT.h() * inT.c(), outT.w() * outT.h() * outT.c());
+        }
+        else if (poolDesc.kind() == PoolDesc::PoolKind::Max)
         {
             grad.AddMaxPoolingGradient(srcGrad, in, out,
                                        inT.c(), inT.w(), inT.h(), inT.w() * inT.h() * inT.c(),
@@ -595,6 +818,17 @@ protected:
         else
             InvalidArgument("Pooling type %d is not supported.", (int)poolDesc.kind());
     }
+
+private:
+    // The recorded maxima are only used for the input of the last forward pass, e.g. not for the frames of a loop.
+    bool HasArgmaxOf(const Mat& in, const Mat& out) const
+    {
+        return m_argmaxInput != nullptr && m_argmaxInput == in.BufferPointer() && in.GetCurrentMatrixLocation() == CurrentDataLocation::CPU &&
+               m_argmax.size() == out.GetNumElements();
+    }
+
+    std::vector<int> m_argmax; // [output element] input row of its maximum, from the last ForwardCore() on the CPU
+    const ElemType* m_argmaxInput;
 };
 
 template class PoolingEngine<float>;
@@ -629,9 +863,9 @@ public:
     }
 
     ConvDescPtr CreateConvDescriptor(const Tensor4D& /*inT*/, const Filter& /*filterT*/,
-                                     size_t wStride, size_t hStride, bool padding) override
+                                     size_t wStride, size_t hStride, bool padding, size_t groups = 1) override
     {
-        return std::make_unique<ConvDesc>(wStride, hStride, padding);
+        return std::make_unique<ConvDesc>(wStride, hStride, padding, groups);
     }
 
     PoolDescPtr CreatePoolDescriptor(typename PoolDesc::PoolKind kind, size_t w, size_t h, size_t wStride, size_t hStride, size_t wPad, size_t hPad) override
@@ -17,7 +17,9 @@
 #endif
 
 #include "Matrix.h"
+#include "Int8QuantizedMatrix.h"
 #include "TensorShape.h" // for ImageLayoutKind
+#include <memory>
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -132,13 +134,20 @@ public:
     {
         return m_padding;
     }
+    // Number of groups the channels are split into; each output channel only sees the input channels of its group,
+    // so the filter has c() == input channels / groups. groups == input channels is a depthwise convolution.
+    size_t groups() const
+    {
+        return m_groups;
+    }
 
 public:
-    ConvolutionDescriptor(size_t wStride = 1, size_t hStride = 1, bool padding = false)
+    ConvolutionDescriptor(size_t wStride = 1, size_t hStride = 1, bool padding = false, size_t groups = 1)
     {
         m_wStride = wStride;
         m_hStride = hStride;
         m_padding = padding;
+        m_groups = groups;
     }
 
 public:
@@ -151,6 +160,7 @@ private:
     size_t m_wStride;
     size_t m_hStride;
     bool m_padding;
+    size_t m_groups;
 };
 
 // PoolingDescriptor describes properties specific to convolution application.
@@ -250,22 +260,36 @@ public:
     void BackwardFilter(const Tensor4D& srcGradT, const Mat& srcGrad, const Tensor4D& inT, const Mat& in, const ConvDesc& convDesc,
                         const Filter& filterT, Mat& filter, bool allowReuse, Mat& workspace);
 
+    // With relu = true, the output is max(0, BN(in)), as if a RectifiedLinear followed.
     void NormalizeBatch(const Tensor4D& inT, const Mat& in, const Tensor4D& scaleBiasT, const Mat& scale, const Mat& bias,
                         bool spatial, double expAvgFactor, Mat& runMean, Mat& runInvStdDev, Mat& out,
-                        double epsilon, Mat& saveMean, Mat& saveInvStdDev);
+                        double epsilon, Mat& saveMean, Mat& saveInvStdDev, bool relu = false);
 
     void NormalizeBatchInference(const Tensor4D& inT, const Mat& in, const Tensor4D& scaleBiasT, const Mat& scale, const Mat& bias,
-                                 bool spatial, const Mat& runMean, const Mat& runInvStdDev, Mat& out);
+                                 bool spatial, const Mat& runMean, const Mat& runInvStdDev, Mat& out, bool relu = false);
 
+    // If reluOut is given, srcGrad is the gradient of max(0, BN(in)), whose value is reluOut; it is masked by reluOut > 0 on the fly.
     void BackwardNormalizeBatch(const Tensor4D& inT, const Mat& in, const Mat& srcGrad, Mat& grad,
                                 const Tensor4D& scaleBiasT, const Mat& scale, bool spatial, const Mat& saveMean, const Mat& saveInvStdDev,
-                                Mat& scaleGrad, Mat& biasGrad);
+                                Mat& scaleGrad, Mat& biasGrad, const Mat* reluOut = nullptr);
+
+    // For inference: makes Forward() multiply with an int8 copy of the filter, ignoring its 'filter' argument.
+    // Returns false if the engine does not support this.
+    bool SetQuantizedFilter(const std::shared_ptr<Int8QuantizedMatrix<ElemType>>& filter)
+    {
+        if (!SupportsQuantizedFilter())
+            return false;
+        m_quantizedFilter = filter;
+        return true;
+    }
 
     DISABLE_COPY_AND_MOVE(ConvolutionEngine);
 
 protected:
     virtual void EnsureCompatible() = 0;
 
+    virtual bool SupportsQuantizedFilter() const { return false; }
+
     virtual void ForwardCore(const Tensor4D& inT, const Mat& in, const Filter& filterT, const Mat& filter, const ConvDesc& convDesc,
                              const Tensor4D& outT, Mat& out, Mat& workspace) = 0;
 
@@ -279,19 +303,20 @@ protected:
 
     virtual void NormalizeBatchCore(const Tensor4D& inT, const Mat& in, const Tensor4D& scaleBiasT, const Mat& scale, const Mat& bias,
                                     bool spatial, double expAvgFactor, Mat& runMean, Mat& runInvStdDev, Mat& out,
-                                    double epsilon, Mat& saveMean, Mat& saveInvStdDev) = 0;
+                                    double epsilon, Mat& saveMean, Mat& saveInvStdDev, bool relu) = 0;
 
     // REVIEW alexeyk: roll into NormalizeBatchCore.
     virtual void NormalizeBatchInferenceCore(const Tensor4D& inT, const Mat& in, const Tensor4D& scaleBiasT, const Mat& scale, const Mat& bias,
-                                             bool spatial, const Mat& runMean, const Mat& runInvStdDev, Mat& out) = 0;
+                                             bool spatial, const Mat& runMean, const Mat& runInvStdDev, Mat& out, bool relu) = 0;
 
     virtual void BackwardNormalizeBatchCore(const Tensor4D& inT, const Mat& in, const Mat& srcGrad, Mat& grad,
                                             const Tensor4D& scaleBiasT, const Mat& scale, bool spatial, const Mat& saveMean, const Mat& saveInvStdDev,
-                                            Mat& scaleGrad, Mat& biasGrad) = 0;
+                                            Mat& scaleGrad, Mat& biasGrad, const Mat* reluOut) = 0;
 
 protected:
     DEVICEID_TYPE m_deviceId;
     ImageLayoutKind m_imageLayout;
+    std::shared_ptr<Int8QuantizedMatrix<ElemType>> m_quantizedFilter;
 };
 
 template <class ElemType>
@@ -354,7 +379,7 @@ public:
     virtual Tensor4DPtr CreateTensor(size_t w, size_t h, size_t c, size_t n) = 0;
     virtual FilterPtr CreateFilter(size_t w, size_t h, size_t c, size_t k) = 0;
     virtual ConvDescPtr CreateConvDescriptor(const Tensor4D& inT, const Filter& filterT,
-                                             size_t wStride, size_t hStride, bool padding) = 0;
+                                             size_t wStride, size_t hStride, bool padding, size_t groups = 1) = 0;
     virtual PoolDescPtr CreatePoolDescriptor(PoolDesc::PoolKind kind, size_t w, size_t h, size_t wStride, size_t hStride, size_t wPad, size_t hPad) = 0;
     // virtual Tensor4DPtr CreateLrnDescriptor() = 0;
 
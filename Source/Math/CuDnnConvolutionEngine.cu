@@ -6,8 +6,10 @@
 #include "stdafx.h"
 #include "CuDnnConvolutionEngine.h"
 #include "GPUMatrix.h"
+#include "ComputeStreamPool.h" // for SharedComputeStreams
 #ifdef USE_CUDNN
 #include <cudnn.h>
+#include <mutex>
 #include "CuDnnConvolutionEngine.cuh"
 
 template <>
@@ -108,6 +110,9 @@ public:
 
     void setN(size_t newN) override
     {
+        // the nodes set the minibatch size before each call; the descriptor only changes with it
+        if (newN == n())
+            return;
         ConvolutionTensor4D::setN(newN);
         CUDNN_CALL(cudnnSetTensor4dDescriptor(m_tensor, TENSOR_FORMAT, m_dataType,
                                               static_cast<int>(n()), static_cast<int>(c()), static_cast<int>(h()), static_cast<int>(w())));
@@ -152,14 +157,29 @@ private:
 class CuDnnConvolutionDescriptor : public ConvolutionDescriptor
 {
 public:
-    CuDnnConvolutionDescriptor(size_t wStride, size_t hStride, size_t wPad, size_t hPad)
-        : ConvolutionDescriptor(wStride, hStride, wPad > 0 || hPad > 0), m_conv(nullptr)
+    CuDnnConvolutionDescriptor(size_t wStride, size_t hStride, size_t wPad, size_t hPad, size_t groups)
+        : ConvolutionDescriptor(wStride, hStride, wPad > 0 || hPad > 0, groups), m_conv(nullptr)
     {
+#if CUDNN_VERSION < 7000
+        if (groups != 1)
+            RuntimeError("Grouped convolution requires cuDNN 7 or later.");
+#endif
         CUDNN_CALL(cudnnCreateConvolutionDescriptor(&m_conv));
         CUDNN_CALL(cudnnSetConvolution2dDescriptor(m_conv,
                                                    static_cast<int>(hPad), static_cast<int>(wPad),
                                                    static_cast<int>(hStride), static_cast<int>(wStride),
                                                    1, 1, CUDNN_CROSS_CORRELATION));
+#if CUDNN_VERSION >= 7000
+        // with float data, tensor cores are only used if cuDNN may round the inputs to fp16 (cuDNN 7.2 and later)
+        if (GPUMathOptions::UseHalfPrecisionGemm())
+#if CUDNN_VERSION >= 7200
+            CUDNN_CALL(cudnnSetConvolutionMathType(m_conv, CUDNN_TENSOR_OP_MATH_ALLOW_CONVERSION));
+#else
+            CUDNN_CALL(cudnnSetConvolutionMathType(m_conv, CUDNN_TENSOR_OP_MATH));
+#endif
+        if (groups != 1)
+            CUDNN_CALL(cudnnSetConvolutionGroupCount(m_conv, static_cast<int>(groups)));
+#endif
     }
 
 public:
@@ -267,6 +287,198 @@ const float Consts<float>::Zero = 0;
 template <>
 const double Consts<double>::Zero = 0;
 
+// -----------------------------------------------------------------------
+// CuDnnConvolutionAlgoCache -- process-wide memo of auto-tuned convolution algorithms
+// Benchmarking all cuDNN algorithms is expensive, and networks typically contain many convolutions
+// of the same geometry (and engines get recreated, e.g. for evaluation), so measured winners are
+// kept per key (direction, device, tensor/filter/convolution geometry, workspace limit).
+// If GPUMathOptions::GetConvolutionAlgoCacheFile() is set, entries are loaded from that file on first
+// use and each newly tuned entry is appended to it, so restarted jobs can skip the auto-tuner.
+// -----------------------------------------------------------------------
+
+class CuDnnConvolutionAlgoCache
+{
+public:
+    struct Entry
+    {
+        int algo;
+        size_t memory;
+        int noWorkspaceAlgo;
+    };
+
+    static std::string MakeKey(const char* direction, DEVICEID_TYPE deviceId, size_t elemSize, const ConvolutionTensor4D& inT,
+                               const ConvolutionFilter& filterT, const ConvolutionDescriptor& convDesc, size_t maxMem)
+    {
+        cudaDeviceProp props = {0};
+        CUDA_CALL(cudaGetDeviceProperties(&props, deviceId));
+        // The device is identified by its properties rather than its ordinal so that file entries remain valid on other
+        // machines with the same hardware. All fields are separated by ':' and the key contains no white space.
+        char buf[512];
+        sprintf(buf, "%s:sm%d%d:mp%d:cudnn%d:tc%d:e%d:w%dh%dc%dn%d:fw%dh%dc%dk%d:s%dx%d:p%d:g%d:m%llu",
+                direction, props.major, props.minor, props.multiProcessorCount, (int) CUDNN_VERSION, GPUMathOptions::UseHalfPrecisionGemm() ? 1 : 0, (int) elemSize,
+                (int) inT.w(), (int) inT.h(), (int) inT.c(), (int) inT.n(),
+                (int) filterT.w(), (int) filterT.h(), (int) filterT.c(), (int) filterT.k(),
+                (int) convDesc.wStride(), (int) convDesc.hStride(), convDesc.padding() ? 1 : 0, (int) convDesc.groups(),
+                (unsigned long long) (maxMem == (std::numeric_limits<size_t>::max)() ? 0 : maxMem));
+        return buf;
+    }
+
+    static bool Find(const std::string& key, Entry& entry)
+    {
+        std::lock_guard<std::mutex> lock(Mutex());
+        LoadIfNeeded();
+        auto iter = Entries().find(key);
+        if (iter == Entries().end())
+            return false;
+        entry = iter->second;
+        return true;
+    }
+
+    static void Add(const std::string& key, const Entry& entry)
+    {
+        std::lock_guard<std::mutex> lock(Mutex());
+        LoadIfNeeded();
+        Entries()[key] = entry;
+        const auto& path = GPUMathOptions::GetConvolutionAlgoCacheFile();
+        if (path.empty())
+            return;
+        // a cache that cannot be written is not an error, we merely lose the benefit on restart
+        FILE* f = _wfopen(path.c_str(), L"a");
+        if (f == nullptr)
+        {
+            fprintf(stderr, "CuDnnConvolutionAlgoCache: Could not open '%ls' for writing, auto-tuning results will not be persisted.\n", path.c_str());
+            return;
+        }
+        fprintf(f, "%s %d %llu %d\n", key.c_str(), entry.algo, (unsigned long long) entry.memory, entry.noWorkspaceAlgo);
+        fclose(f);
+    }
+
+private:
+    static void LoadIfNeeded()
+    {
+        static bool loaded = false;
+        if (loaded)
+            return;
+        loaded = true;
+        const auto& path = GPUMathOptions::GetConvolutionAlgoCacheFile();
+        if (path.empty())
+            return;
+        FILE* f = _wfopen(path.c_str(), L"r");
+        if (f == nullptr) // not created yet
+            return;
+        char key[512];
+        Entry entry;
+        unsigned long long memory;
+        size_t numEntries = 0;
+        while (fscanf(f, "%511s %d %llu %d", key, &entry.algo, &memory, &entry.noWorkspaceAlgo) == 4)
+        {
+            entry.memory = (size_t) memory;
+            Entries()[key] = entry;
+            numEntries++;
+        }
+        fclose(f);
+        fprintf(stderr, "CuDnnConvolutionAlgoCache: Loaded %d convolution algorithms from '%ls'.\n", (int) numEntries, path.c_str());
+    }
+
+    static std::map<std::string, Entry>& Entries()
+    {
+        static std::map<std::string, Entry> entries;
+        return entries;
+    }
+    static std::mutex& Mutex()
+    {
+        static std::mutex mutex;
+        return mutex;
+    }
+};
+
+// -----------------------------------------------------------------------
+// CuDnnDeviceResources -- the cuDNN handle and convolution workspace shared by all engines on a device
+// Each engine used to create its own handle and resize a workspace matrix of its node before each call.
+// Instead, there is one handle per device (and per shared stream that threads hold, see SharedComputeStreams,
+// as these threads run concurrently), bound to the current stream when it is requested, and one
+// workspace arena per device and stream, which grows to the largest requirement of any convolution
+// (after the first minibatch it has reached it, and no longer changes). Work on one stream is serialized,
+// so the convolutions on it can share the arena; nodes that run concurrently use other streams.
+// The resources live until the process ends, as the CUDA runtime may be shut down before static destructors run.
+// -----------------------------------------------------------------------
+
+class CuDnnDeviceResources
+{
+public:
+    static cudnnHandle_t Handle(DEVICEID_TYPE deviceId)
+    {
+        std::lock_guard<std::mutex> lock(Mutex());
+        auto& handle = Handles()[std::make_pair(deviceId, SharedComputeStreams::Current())];
+        cudaStream_t stream = GetStream();
+        if (handle.m_cudnn == nullptr)
+        {
+            PrepareDevice(deviceId);
+            CUDNN_CALL(cudnnCreate(&handle.m_cudnn));
+            CUDNN_CALL(cudnnSetStream(handle.m_cudnn, stream));
+            handle.m_stream = stream;
+        }
+        else if (handle.m_stream != stream)
+        {
+            CUDNN_CALL(cudnnSetStream(handle.m_cudnn, stream));
+            handle.m_stream = stream;
+        }
+        return handle.m_cudnn;
+    }
+
+    // a workspace of at least 'size' bytes for the current stream
+    static void* Workspace(DEVICEID_TYPE deviceId, size_t size)
+    {
+        if (size == 0)
+            return nullptr;
+        std::lock_guard<std::mutex> lock(Mutex());
+        cudaStream_t stream = GetStream();
+        auto& workspace = Workspaces()[std::make_pair(deviceId, stream)];
+        if (workspace.m_size < size)
+        {
+            if (workspace.m_data != nullptr)
+            {
+                // earlier convolutions on the stream may still use the old buffer
+                CUDA_CALL(cudaStreamSynchronize(stream));
+                TracingGPUMemoryAllocator::Free<char>(deviceId, workspace.m_data);
+            }
+            workspace.m_data = TracingGPUMemoryAllocator::Allocate<char>(deviceId, size);
+            workspace.m_size = size;
+        }
+        return workspace.m_data;
+    }
+
+private:
+    struct BoundHandle
+    {
+        BoundHandle() : m_cudnn(nullptr), m_stream(nullptr) { }
+        cudnnHandle_t m_cudnn;
+        cudaStream_t m_stream; // last one set on the handle
+    };
+    struct Arena
+    {
+        Arena() : m_data(nullptr), m_size(0) { }
+        char* m_data;
+        size_t m_size; // in bytes
+    };
+
+    static std::map<std::pair<DEVICEID_TYPE, cudaStream_t>, BoundHandle>& Handles()
+    {
+        static std::map<std::pair<DEVICEID_TYPE, cudaStream_t>, BoundHandle> handles;
+        return handles;
+    }
+    static std::map<std::pair<DEVICEID_TYPE, cudaStream_t>, Arena>& Workspaces()
+    {
+        static std::map<std::pair<DEVICEID_TYPE, cudaStream_t>, Arena> workspaces;
+        return workspaces;
+    }
+    static std::mutex& Mutex()
+    {
+        static std::mutex mutex;
+        return mutex;
+    }
+};
+
 template <typename ElemType>
 class CuDnnConvolutionEngine : public ConvolutionEngine<ElemType>
 {
@@ -278,20 +490,8 @@ public:
     using typename Base::ConvDesc;
 
     CuDnnConvolutionEngine(DEVICEID_TYPE deviceId, ImageLayoutKind imageLayout, size_t maxTempMemSizeInSamples, BatchNormImpl bnImpl)
-        : Base(deviceId, imageLayout), m_maxTempMemSizeInSamples(maxTempMemSizeInSamples), m_bnImpl(bnImpl), m_stream(GetStream()), m_cudnn(nullptr)
+        : Base(deviceId, imageLayout), m_maxTempMemSizeInSamples(maxTempMemSizeInSamples), m_bnImpl(bnImpl), m_cudnn(nullptr)
     {
-        CUDNN_CALL(cudnnCreate(&m_cudnn));
-        CUDNN_CALL(cudnnSetStream(m_cudnn, m_stream));
-    }
-
-    ~CuDnnConvolutionEngine()
-    {
-        if (m_cudnn != nullptr)
-        {
-            // TODO: Check for error code and throw if !std::uncaught_exception()
-            cudnnDestroy(m_cudnn);
-            m_cudnn = nullptr;
-        }
     }
 
 protected:
@@ -306,20 +506,21 @@ protected:
             RuntimeError("cuDNN convolution engine supports GPU devices only.");
     }
 
+    // The workspace matrix of the node is not used, see CuDnnDeviceResources.
     void ForwardCore(const Tensor4D& inT, const Mat& in, const Filter& filterT, const Mat& filter, const ConvDesc& convDesc,
-                     const Tensor4D& outT, Mat& out, Mat& workspace) override
+                     const Tensor4D& outT, Mat& out, Mat& /*workspace*/) override
     {
-        // Find best algo and allocate temp buffer, if needed.
+        m_cudnn = CuDnnDeviceResources::Handle(m_deviceId);
+        // Find best algo and get the temp buffer, if needed.
         auto finder = [&](int& calgo, cudnnConvolutionFwdAlgoPerf_t algoPerf[MaxAlgoCount]) -> cudnnStatus_t
         {
             return cudnnFindConvolutionForwardAlgorithm(m_cudnn, t(inT), f(filterT), cd(convDesc), t(outT), MaxAlgoCount, &calgo, algoPerf);
         };
-        FindBestAlgo(t(inT), m_fwdAlgo, finder);
-        if (m_fwdAlgo.Algo.memory > 0)
-            workspace.Resize((m_fwdAlgo.Algo.memory + sizeof(ElemType) - 1) / sizeof(ElemType), 1);
+        FindBestAlgo("fwd", t(inT), f(filterT), convDesc, t(inT), m_fwdAlgo, finder);
+        void* workspace = CuDnnDeviceResources::Workspace(m_deviceId, m_fwdAlgo.Algo.memory);
         // Perform forward convolution operation.
         auto err = cudnnConvolutionForward(m_cudnn, &C::One, t(inT), ptr(in), f(filterT), ptr(filter), cd(convDesc),
-                                           m_fwdAlgo.Algo.algo, ptr(workspace), m_fwdAlgo.Algo.memory, &C::Zero, t(outT), ptr(out));
+                                           m_fwdAlgo.Algo.algo, workspace, m_fwdAlgo.Algo.memory, &C::Zero, t(outT), ptr(out));
         // There might be a case where cuDNN fails due to workspace being too small, try using no-workspace algo instead.
         // REVIEW alexeyk: NVIDIA is currently reviewing this issue.
         if (CUDNN_STATUS_INVALID_VALUE == err && m_fwdAlgo.Algo.memory > 0)
@@ -334,35 +535,35 @@ protected:
     }
 
     void BackwardDataCore(const Tensor4D& srcGradT, const Mat& srcGrad, const Filter& filterT, const Mat& filter, const ConvDesc& convDesc,
-                          const Tensor4D& gradT, Mat& grad, Mat& workspace) override
+                          const Tensor4D& gradT, Mat& grad, Mat& /*workspace*/) override
     {
-        // Find best algo and allocate temp buffer, if needed.
+        m_cudnn = CuDnnDeviceResources::Handle(m_deviceId);
+        // Find best algo and get the temp buffer, if needed.
         auto finder = [&](int& calgo, cudnnConvolutionBwdDataAlgoPerf_t algoPerf[MaxAlgoCount]) -> cudnnStatus_t
         {
             return cudnnFindConvolutionBackwardDataAlgorithm(m_cudnn, f(filterT), t(srcGradT), cd(convDesc), t(gradT), MaxAlgoCount, &calgo, algoPerf);
         };
-        FindBestAlgo(t(srcGradT), m_backDataAlgo, finder);
-        if (m_backDataAlgo.Algo.memory > 0)
-            workspace.Resize((m_backDataAlgo.Algo.memory + sizeof(ElemType) - 1) / sizeof(ElemType), 1);
+        FindBestAlgo("bwdData", t(gradT), f(filterT), convDesc, t(srcGradT), m_backDataAlgo, finder);
+        void* workspace = CuDnnDeviceResources::Workspace(m_deviceId, m_backDataAlgo.Algo.memory);
         // Compute gradients with respect to the output tensor (data).
         CUDNN_CALL(cudnnConvolutionBackwardData(m_cudnn, &C::One, f(filterT), ptr(filter), t(srcGradT), ptr(srcGrad), cd(convDesc), m_backDataAlgo.Algo.algo,
-                                                ptr(workspace), m_backDataAlgo.Algo.memory, &C::One, t(gradT), ptr(grad)));
+                                                workspace, m_backDataAlgo.Algo.memory, &C::One, t(gradT), ptr(grad)));
     }
 
     void BackwardFilterCore(const Tensor4D& srcGradT, const Mat& srcGrad, const Tensor4D& inT, const Mat& in, const ConvDesc& convDesc,
-                            const Filter& filterT, Mat& filter, bool /*allowReuse*/, Mat& workspace) override
+                            const Filter& filterT, Mat& filter, bool /*allowReuse*/, Mat& /*workspace*/) override
     {
-        // Find best algo and allocate temp buffer, if needed.
+        m_cudnn = CuDnnDeviceResources::Handle(m_deviceId);
+        // Find best algo and get the temp buffer, if needed.
         auto finder = [&](int& calgo, cudnnConvolutionBwdFilterAlgoPerf_t algoPerf[MaxAlgoCount]) -> cudnnStatus_t
         {
             return cudnnFindConvolutionBackwardFilterAlgorithm(m_cudnn, t(inT), t(srcGradT), cd(convDesc), f(filterT), MaxAlgoCount, &calgo, algoPerf);
         };
-        FindBestAlgo(t(inT), m_backFiltAlgo, finder);
-        if (m_backFiltAlgo.Algo.memory > 0)
-            workspace.Resize((m_backFiltAlgo.Algo.memory + sizeof(ElemType) - 1) / sizeof(ElemType), 1);
+        FindBestAlgo("bwdFilter", t(inT), f(filterT), convDesc, t(inT), m_backFiltAlgo, finder);
+        void* workspace = CuDnnDeviceResources::Workspace(m_deviceId, m_backFiltAlgo.Algo.memory);
         // Compute gradients with respect to the output tensor (data).
         CUDNN_CALL(cudnnConvolutionBackwardFilter(m_cudnn, &C::One, t(inT), ptr(in), t(srcGradT), ptr(srcGrad), cd(convDesc), m_backFiltAlgo.Algo.algo,
-                                                  ptr(workspace), m_backFiltAlgo.Algo.memory, &C::One, f(filterT), ptr(filter)));
+                                                  workspace, m_backFiltAlgo.Algo.memory, &C::One, f(filterT), ptr(filter)));
     }
 
     void EnsureCompatibleBatchNorm(bool spatial) override
@@ -375,8 +576,9 @@ protected:
 
     void NormalizeBatchCore(const Tensor4D& inT, const Mat& in, const Tensor4D& scaleBiasT, const Mat& scale, const Mat& bias,
                             bool spatial, double expAvgFactor, Mat& runMean, Mat& runInvStdDev, Mat& out,
-                            double epsilon, Mat& saveMean, Mat& saveInvStdDev) override
+                            double epsilon, Mat& saveMean, Mat& saveInvStdDev, bool relu) override
     {
+        m_cudnn = CuDnnDeviceResources::Handle(m_deviceId);
         if (m_bnImpl == BatchNormImpl::CuDnn)
         {
             cudnnBatchNormMode_t mode = spatial ? CUDNN_BATCHNORM_SPATIAL : CUDNN_BATCHNORM_PER_ACTIVATION;
@@ -385,31 +587,37 @@ protected:
             CUDNN_CALL(cudnnBatchNormalizationForwardTraining(m_cudnn, mode, &C::One, &C::Zero, t(inT), ptr(in), t(inT), ptr(out),
                 t(scaleBiasT), ptr(scale), ptr(bias), expAvgFactor, ptr(runMean), ptr(runInvStdDev), 
                 epsilon, ptr(saveMean), ptr(saveInvStdDev)));
+            // cuDNN has no fused activation for batch normalization, so the ReLU is a separate in-place pass.
+            if (relu)
+                out.InplaceTruncateBottom(0);
         }
         else if (m_bnImpl == BatchNormImpl::Cntk)
         {
             epsilon = std::max(epsilon, 1e-9);
             CUDA_CALL(BatchNormalizationForwardTraining(inT, spatial, ptr(in), ptr(out), ptr(scale), ptr(bias),
                                                         expAvgFactor, ptr(runMean), ptr(runInvStdDev),
-                                                        epsilon, ptr(saveMean), ptr(saveInvStdDev), m_stream));
+                                                        epsilon, ptr(saveMean), ptr(saveInvStdDev), relu, GetStream()));
         }
         else
             RuntimeError("Provided batch norm implementation (%d) is not supported.", m_bnImpl);
     }
 
     void NormalizeBatchInferenceCore(const Tensor4D& inT, const Mat& in, const Tensor4D& scaleBiasT, const Mat& scale, const Mat& bias,
-                                     bool spatial, const Mat& runMean, const Mat& runInvStdDev, Mat& out) override
+                                     bool spatial, const Mat& runMean, const Mat& runInvStdDev, Mat& out, bool relu) override
     {
+        m_cudnn = CuDnnDeviceResources::Handle(m_deviceId);
         if (m_bnImpl == BatchNormImpl::CuDnn)
         {
             cudnnBatchNormMode_t mode = spatial ? CUDNN_BATCHNORM_SPATIAL : CUDNN_BATCHNORM_PER_ACTIVATION;
             CUDNN_CALL(cudnnBatchNormalizationForwardInference(m_cudnn, mode, &C::One, &C::Zero, t(inT), ptr(in), t(inT), ptr(out),
                                                                t(scaleBiasT), ptr(scale), ptr(bias), ptr(runMean), ptr(runInvStdDev), CUDNN_BN_MIN_EPSILON));
+            if (relu)
+                out.InplaceTruncateBottom(0);
         }
         else if (m_bnImpl == BatchNormImpl::Cntk)
         {
             CUDA_CALL(BatchNormalizationForwardInference(inT, spatial, ptr(in), ptr(out), ptr(scale), ptr(bias),
-                                                         ptr(runMean), ptr(runInvStdDev), m_stream));
+                                                         ptr(runMean), ptr(runInvStdDev), relu, GetStream()));
         }
         else
             RuntimeError("Provided batch norm implementation (%d) is not supported.", m_bnImpl);
@@ -417,17 +625,26 @@ protected:
 
     void BackwardNormalizeBatchCore(const Tensor4D& inT, const Mat& in, const Mat& srcGrad, Mat& grad,
                                     const Tensor4D& scaleBiasT, const Mat& scale, bool spatial, const Mat& saveMean, const Mat& saveInvStdDev,
-                                    Mat& scaleGrad, Mat& biasGrad) override
+                                    Mat& scaleGrad, Mat& biasGrad, const Mat* reluOut) override
     {
+        m_cudnn = CuDnnDeviceResources::Handle(m_deviceId);
         if (m_bnImpl == BatchNormImpl::CuDnn)
         {
             cudnnBatchNormMode_t mode = spatial ? CUDNN_BATCHNORM_SPATIAL : CUDNN_BATCHNORM_PER_ACTIVATION;
+            // with a fused ReLU, cuDNN gets the gradient of the ReLU input
+            Mat reluGrad(m_deviceId);
+            if (reluOut != nullptr)
+            {
+                reluGrad.AssignLinearRectifierDerivativeOf(*reluOut);
+                reluGrad.ElementMultiplyWith(srcGrad);
+            }
+            const Mat& bnGrad = reluOut != nullptr ? reluGrad : srcGrad;
 // REVIEW alexeyk: remove once Philly is upgraded to prod version.
 #if CUDNN_PATCHLEVEL >= 7
-            CUDNN_CALL(cudnnBatchNormalizationBackward(m_cudnn, mode, &C::One, &C::One, &C::One, &C::One, t(inT), ptr(in), t(inT), ptr(srcGrad), t(inT), ptr(grad),
+            CUDNN_CALL(cudnnBatchNormalizationBackward(m_cudnn, mode, &C::One, &C::One, &C::One, &C::One, t(inT), ptr(in), t(inT), ptr(bnGrad), t(inT), ptr(grad),
                                                        t(scaleBiasT), ptr(scale), ptr(scaleGrad), ptr(biasGrad), CUDNN_BN_MIN_EPSILON, ptr(saveMean), ptr(saveInvStdDev)));
 #else
-            CUDNN_CALL(cudnnBatchNormalizationBackward(m_cudnn, mode, &C::One, &C::One, t(inT), ptr(in), t(inT), ptr(srcGrad), t(inT), ptr(grad),
+            CUDNN_CALL(cudnnBatchNormalizationBackward(m_cudnn, mode, &C::One, &C::One, t(inT), ptr(in), t(inT), ptr(bnGrad), t(inT), ptr(grad),
                 t(scaleBiasT), ptr(scale), ptr(scaleGrad), ptr(biasGrad), CUDNN_BN_MIN_EPSILON, ptr(saveMean), ptr(saveInvStdDev)));
 #endif
 
@@ -435,7 +652,7 @@ protected:
         else if (m_bnImpl == BatchNormImpl::Cntk)
         {
             CUDA_CALL(BatchNormalizationBackward(inT, spatial, ptr(in), ptr(srcGrad), ptr(grad), ptr(scale), ptr(scaleGrad), ptr(biasGrad),
-                                                 ptr(saveMean), ptr(saveInvStdDev), m_stream));
+                                                 ptr(saveMean), ptr(saveInvStdDev), reluOut != nullptr ? ptr(*reluOut) : nullptr, GetStream()));
         }
         else
             RuntimeError("Provided batch norm implementation (%d) is not supported.", m_bnImpl);
@@ -444,17 +661,36 @@ protected:
 private:
     static const int MaxAlgoCount = 10;
 
+    // 'inT' is the input-shaped tensor of the convolution (for backward data, the gradient w.r.t. the input) and,
+    // together with the filter and convolution descriptor, determines the key in the algorithm cache.
+    // 't' is the tensor that determines the workspace limit.
     template <typename TAlgo, typename TFinder>
-    void FindBestAlgo(const CuDnnTensor4D& t, TAlgo& algo, TFinder finder)
+    void FindBestAlgo(const char* direction, const CuDnnTensor4D& inT, const CuDnnFilter& filterT, const ConvDesc& convDesc,
+                      const CuDnnTensor4D& t, TAlgo& algo, TFinder finder)
     {
         if (!algo.NeedAutotuning(t))
             return;
         using CuDnnAlgoT = decltype(TAlgo::Algo);
+        using CuDnnAlgoIdT = decltype(CuDnnAlgoT::algo);
+        size_t maxMem = m_maxTempMemSizeInSamples == 0 ? (std::numeric_limits<size_t>::max)() : t.w() * t.h() * t.c() * m_maxTempMemSizeInSamples * sizeof(ElemType);
+
+        // Reuse an earlier measurement of the same configuration, if any.
+        auto key = CuDnnConvolutionAlgoCache::MakeKey(direction, m_deviceId, sizeof(ElemType), inT, filterT, convDesc, maxMem);
+        CuDnnConvolutionAlgoCache::Entry entry;
+        if (CuDnnConvolutionAlgoCache::Find(key, entry))
+        {
+            algo.CurMBSize = t.n();
+            algo.Algo.algo = (CuDnnAlgoIdT) entry.algo;
+            algo.Algo.memory = entry.memory;
+            algo.Algo.status = CUDNN_STATUS_SUCCESS;
+            algo.NoWorkspaceAlgo = (CuDnnAlgoIdT) entry.noWorkspaceAlgo;
+            return;
+        }
+
         CuDnnAlgoT algoPerf[MaxAlgoCount];
         int calgo = 0;
         CUDNN_CALL(finder(calgo, algoPerf));
         assert(calgo > 0);
-        size_t maxMem = m_maxTempMemSizeInSamples == 0 ? (std::numeric_limits<size_t>::max)() : t.w() * t.h() * t.c() * m_maxTempMemSizeInSamples * sizeof(ElemType);
         auto res = std::find_if(algoPerf, algoPerf + calgo,
             [=](const CuDnnAlgoT& cur)
             {
@@ -476,6 +712,11 @@ private:
         }
         else
             algo.NoWorkspaceAlgo = (*res).algo;
+
+        entry.algo = (int) algo.Algo.algo;
+        entry.memory = algo.Algo.memory;
+        entry.noWorkspaceAlgo = (int) algo.NoWorkspaceAlgo;
+        CuDnnConvolutionAlgoCache::Add(key, entry);
     }
 
 private:
@@ -513,8 +754,7 @@ private:
     // REVIEW alexeyk: currently limit is set once in ctor though in CNTK it can be, theoretically, changed in runtime.
     size_t m_maxTempMemSizeInSamples;
     BatchNormImpl m_bnImpl;
-    cudnnHandle_t m_cudnn;
-    cudaStream_t m_stream;
+    cudnnHandle_t m_cudnn; // shared, bound to the current stream at the start of each call
     ConvAlgoInfo<cudnnConvolutionFwdAlgoPerf_t> m_fwdAlgo;
     ConvAlgoInfo<cudnnConvolutionBwdDataAlgoPerf_t> m_backDataAlgo;
     ConvAlgoInfo<cudnnConvolutionBwdFilterAlgoPerf_t> m_backFiltAlgo;
@@ -531,20 +771,8 @@ public:
 
 public:
     CuDnnPoolingEngine(DEVICEID_TYPE deviceId, ImageLayoutKind imageLayout)
-        : Base(deviceId, imageLayout), m_cudnn(nullptr)
+        : Base(deviceId, imageLayout)
     {
-        CUDNN_CALL(cudnnCreate(&m_cudnn));
-        CUDNN_CALL(cudnnSetStream(m_cudnn, GetStream()));
-    }
-
-    ~CuDnnPoolingEngine()
-    {
-        if (m_cudnn != nullptr)
-        {
-            // TODO: Check for error code and throw if !std::uncaught_exception()
-            cudnnDestroy(m_cudnn);
-            m_cudnn = nullptr;
-        }
     }
 
 protected:
@@ -561,19 +789,17 @@ protected:
 
     void ForwardCore(const Tensor4D& inT, const Mat& in, const PoolDesc& poolDesc, const Tensor4D& outT, Mat& out) override
     {
-        CUDNN_CALL(cudnnPoolingForward(m_cudnn, p(poolDesc), &C::One, t(inT), ptr(in), &C::Zero, t(outT), ptr(out)));
+        CUDNN_CALL(cudnnPoolingForward(CuDnnDeviceResources::Handle(m_deviceId), p(poolDesc), &C::One, t(inT), ptr(in), &C::Zero, t(outT), ptr(out)));
     }
 
     void BackwardCore(const Tensor4D& outT, const Mat& out, const Mat& srcGrad, const PoolDesc& poolDesc, const Tensor4D& inT, const Mat& in, Mat& grad) override
     {
-        CUDNN_CALL(cudnnPoolingBackward(m_cudnn, p(poolDesc), &C::One, t(outT), ptr(out), t(outT), ptr(srcGrad),
+        CUDNN_CALL(cudnnPoolingBackward(CuDnnDeviceResources::Handle(m_deviceId), p(poolDesc), &C::One, t(outT), ptr(out), t(outT), ptr(srcGrad),
                                         t(inT), ptr(in), &C::One, t(inT), ptr(grad)));
     }
 
 private:
     using C = Consts<ElemType>;
-
-    cudnnHandle_t m_cudnn;
 };
 
 template <class ElemType>
@@ -614,11 +840,11 @@ typename CuDnnConvolutionEngineFactory<double>::FilterPtr CuDnnConvolutionEngine
 
 template <class ElemType>
 typename CuDnnConvolutionEngineFactory<ElemType>::ConvDescPtr CuDnnConvolutionEngineFactory<ElemType>::CreateConvDescriptor(
-    const Tensor4D& /*inT*/, const Filter& filterT, size_t wStride, size_t hStride, bool padding)
+    const Tensor4D& /*inT*/, const Filter& filterT, size_t wStride, size_t hStride, bool padding, size_t groups)
 {
     size_t wPad = padding ? filterT.w() / 2 : 0;
     size_t hPad = padding ? filterT.h() / 2 : 0;
-    return std::make_unique<CuDnnConvolutionDescriptor>(wStride, hStride, wPad, hPad);
+    return std::make_unique<CuDnnConvolutionDescriptor>(wStride, hStride, wPad, hPad, groups);
 }
 
 template <class ElemType>
@@ -658,7 +884,7 @@ typename CuDnnConvolutionEngineFactory<ElemType>::FilterPtr CuDnnConvolutionEngi
 
 template <class ElemType>
 typename CuDnnConvolutionEngineFactory<ElemType>::ConvDescPtr CuDnnConvolutionEngineFactory<ElemType>::CreateConvDescriptor(
-    const Tensor4D&, const Filter&, size_t, size_t, bool)
+    const Tensor4D&, const Filter&, size_t, size_t, bool, size_t)
 {
     RuntimeError("The code is compiled without USE_CUDNN macro.");
 }
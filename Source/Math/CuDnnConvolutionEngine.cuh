@@ -107,6 +107,20 @@ namespace Microsoft { namespace MSR { namespace CNTK {
         *(reinterpret_cast<float4*>(dst)) = v;
     }
 
+    // Gradient of a ReLU fused into batch normalization: dy is zeroed where the ReLU output y is not positive.
+    template <int U, typename T>
+    __device__ __forceinline__ void MaskReluGradient(const T* y, T dy[U])
+    {
+        T yCur[U];
+        LoadValues<U>(y, yCur);
+#pragma unroll
+        for (int i = 0; i < U; i++)
+        {
+            if (yCur[i] <= 0)
+                dy[i] = 0;
+        }
+    }
+
     template <typename T>
     __device__ __forceinline__ T Shuffle(T input, int srcLane)
     {
@@ -522,11 +536,12 @@ namespace Microsoft { namespace MSR { namespace CNTK {
     // It also updates runMean and runInvStdDev with running mean/var computed over all minibatches. 
     // These values are used in inference/evaluation phase.
     // The *Inference function computes outputs based on pre-computed mean and inv stddev.
+    // With 'relu', both apply max(0, .) to the outputs as they are stored, so a following ReLU needs no pass of its own.
     //--------------------------------------------------------------------
 
     template <int BlockDimX, int BlockDimY, bool Spatial, int U, typename ElemType>
     __global__ void kNormalizeBatchTraining(int vectorSize, int spatialSize, int batchSize, const ElemType* x, ElemType* y,
-        const ElemType* bnScale, const ElemType* bnBias, const ElemType* batchMean, const ElemType* batchInvStdDev)
+        const ElemType* bnScale, const ElemType* bnBias, const ElemType* batchMean, const ElemType* batchInvStdDev, bool relu)
     {
         static_assert(BlockDimX * U == CUB_PTX_WARP_THREADS, "BlockDimX * U must be equal to warp size (32).");
         static_assert((BlockDimX * BlockDimY % CUB_PTX_WARP_THREADS) == 0, "Block size must be a multiple of warp size (32).");
@@ -595,6 +610,8 @@ namespace Microsoft { namespace MSR { namespace CNTK {
             for (int k = 0; k < U; k++)
             {
                 val[k] = scale[k] * (val[k] - mean[k]) * invStdDev[k] + bias[k];
+                if (relu && val[k] < 0)
+                    val[k] = 0;
             }
             StoreValues<U>(val, pdst);
         }
@@ -605,7 +622,7 @@ namespace Microsoft { namespace MSR { namespace CNTK {
     {
         template <typename ElemType>
         static void Call(size_t vectorSize, size_t spatialSize, size_t batchSize, bool spatial, const ElemType* x, ElemType* y,
-            const ElemType* bnScale, const ElemType* bnBias, const ElemType* batchMean, const ElemType* batchInvStdDev, cudaStream_t stream)
+            const ElemType* bnScale, const ElemType* bnBias, const ElemType* batchMean, const ElemType* batchInvStdDev, bool relu, cudaStream_t stream)
         {
             assert((vectorSize % U) == 0);
 
@@ -618,13 +635,13 @@ namespace Microsoft { namespace MSR { namespace CNTK {
             {
                 kNormalizeBatchTraining<BlockDimX, BlockDimY, true, U><<<gdim, bdim, 0, stream>>>(
                     static_cast<int>(vectorSize), static_cast<int>(spatialSize), static_cast<int>(batchSize), x, y, bnScale, bnBias,
-                    batchMean, batchInvStdDev);
+                    batchMean, batchInvStdDev, relu);
             }
             else
             {
                 kNormalizeBatchTraining<BlockDimX, BlockDimY, false, U><<<gdim, bdim, 0, stream>>>(
                     static_cast<int>(vectorSize), static_cast<int>(spatialSize), static_cast<int>(batchSize), x, y, bnScale, bnBias,
-                    batchMean, batchInvStdDev);
+                    batchMean, batchInvStdDev, relu);
             }
         }
     };
@@ -633,7 +650,7 @@ namespace Microsoft { namespace MSR { namespace CNTK {
     template <typename ElemType>
     cudaError_t BatchNormalizationForwardTraining(const Tensor4D& t, bool spatial, const ElemType* x, ElemType* y,
                                                   const ElemType* bnScale, const ElemType* bnBias, double expAvgFactor, ElemType* runMean, ElemType* runInvStdDev,
-                                                  double epsilon, ElemType* saveMean, ElemType* saveInvStdDev, cudaStream_t stream)
+                                                  double epsilon, ElemType* saveMean, ElemType* saveInvStdDev, bool relu, cudaStream_t stream)
     {
         assert(nullptr != x);
         assert(nullptr != y);
@@ -669,13 +686,13 @@ namespace Microsoft { namespace MSR { namespace CNTK {
                 return err;
         }
         Call<NormalizeBatchTraining, ElemType>(spatial ? spatialSize : vectorSize, vectorSize, spatialSize, batchSize,
-                                               spatial, x, y, bnScale, bnBias, saveMean, saveInvStdDev, stream);
+                                               spatial, x, y, bnScale, bnBias, saveMean, saveInvStdDev, relu, stream);
         return GetLastCudaError();
     }
 
     template <typename ElemType>
     cudaError_t BatchNormalizationForwardInference(const Tensor4D& t, bool spatial, const ElemType* x, ElemType* y, const ElemType* bnScale,
-                                                   const ElemType* bnBias, const ElemType* runMean, const ElemType* runInvStdDev, cudaStream_t stream)
+                                                   const ElemType* bnBias, const ElemType* runMean, const ElemType* runInvStdDev, bool relu, cudaStream_t stream)
     {
         assert(nullptr != x);
         assert(nullptr != y);
@@ -691,7 +708,7 @@ namespace Microsoft { namespace MSR { namespace CNTK {
         assert(0 < batchSize  && batchSize  <= std::numeric_limits<int>::max());
 
         Call<NormalizeBatchTraining, ElemType>(spatial ? spatialSize : vectorSize, vectorSize, spatialSize, batchSize,
-                                               spatial, x, y, bnScale, bnBias, runMean, runInvStdDev, stream);
+                                               spatial, x, y, bnScale, bnBias, runMean, runInvStdDev, relu, stream);
         return GetLastCudaError();
     }
 
@@ -699,12 +716,13 @@ namespace Microsoft { namespace MSR { namespace CNTK {
     // Backpropagation
     // BatchNormalizationBackward back-propagates derivatives of batch normalization function
     // with respect to the inputs and scale and bias parameters.
+    // If 'y' is not null, it is the output of a ReLU fused into the forward pass, and dy is taken as the gradient of that output.
     // All tensor dimensions and assumptions are the same as in case of forward propagation.
     //--------------------------------------------------------------------
 
     template <int BlockDimX, int BlockDimY, int U, typename ElemType>
-    __global__ void kComputeScaleAndBiasGradients(int vectorSize, int batchSize, const ElemType* x, const ElemType* dy, ElemType* dScale, ElemType* dBias,
-                                                  const ElemType* saveMean, const ElemType* saveInvStdDev)
+    __global__ void kComputeScaleAndBiasGradients(int vectorSize, int batchSize, const ElemType* x, const ElemType* dy, const ElemType* y,
+                                                  ElemType* dScale, ElemType* dBias, const ElemType* saveMean, const ElemType* saveInvStdDev)
     {
         static_assert(BlockDimX * U == CUB_PTX_WARP_THREADS, "BlockDimX * U must be equal to warp size (32).");
         static_assert((BlockDimX * BlockDimY % CUB_PTX_WARP_THREADS) == 0, "Block size must be a multiple of warp size (32).");
@@ -762,11 +780,13 @@ namespace Microsoft { namespace MSR { namespace CNTK {
             ElemType curdY[U];
             LoadValues<U>(px, curX);
             LoadValues<U>(pdy, curdY);
+            if (y != nullptr)
+                MaskReluGradient<U>(y + (pdy - dy), curdY);
 #pragma unroll
             for (int k = 0; k < U; k++)
             {
-                ds[k] += pdy[k] * (curX[k] - mean[k]) * invStdDev[k];
-                db[k] += pdy[k];
+                ds[k] += curdY[k] * (curX[k] - mean[k]) * invStdDev[k];
+                db[k] += curdY[k];
             }
         }
 
@@ -807,7 +827,7 @@ namespace Microsoft { namespace MSR { namespace CNTK {
     }
 
     template <int BlockDimX, int BlockDimY, int U, typename ElemType>
-    __global__ void kComputeSpatialScaleAndBiasGradients(int vectorSize, int spatialSize, int batchSize, const ElemType* x, const ElemType* dy, 
+    __global__ void kComputeSpatialScaleAndBiasGradients(int vectorSize, int spatialSize, int batchSize, const ElemType* x, const ElemType* dy, const ElemType* y,
                                                          ElemType* dScale, ElemType* dBias, const ElemType* saveMean, const ElemType* saveInvStdDev)
     {
         static_assert(BlockDimX * U == CUB_PTX_WARP_THREADS, "BlockDimX * U must be equal to warp size (32).");
@@ -870,11 +890,13 @@ namespace Microsoft { namespace MSR { namespace CNTK {
                 ElemType curdY[U];
                 LoadValues<U>(px, curX);
                 LoadValues<U>(pdy, curdY);
+                if (y != nullptr)
+                    MaskReluGradient<U>(y + (pdy - dy), curdY);
 #pragma unroll
                 for (int k = 0; k < U; k++)
                 {
-                    ds[k] += pdy[k] * (curX[k] - mean) * invStdDev;
-                    db[k] += pdy[k];
+                    ds[k] += curdY[k] * (curX[k] - mean) * invStdDev;
+                    db[k] += curdY[k];
                 }
             }
         }
@@ -896,7 +918,7 @@ namespace Microsoft { namespace MSR { namespace CNTK {
     struct ComputeScaleAndBiasGradients
     {
         template <typename ElemType>
-        static void Call(size_t vectorSize, size_t batchSize, const ElemType* x, const ElemType* dy,
+        static void Call(size_t vectorSize, size_t batchSize, const ElemType* x, const ElemType* dy, const ElemType* y,
             ElemType* dScale, ElemType* dBias, const ElemType* saveMean, const ElemType* saveInvStdDev, cudaStream_t stream)
         {
             assert((vectorSize % U) == 0);
@@ -906,7 +928,7 @@ namespace Microsoft { namespace MSR { namespace CNTK {
             // Create a grid that has uses striding in y-dimension to cover whole minibatch.
             auto gdim = dim3(static_cast<unsigned int>(RoundUpToMultiple(vectorSize, BlockDimX * U)));
             kComputeScaleAndBiasGradients<BlockDimX, BlockDimY, U><<<gdim, bdim, 0, stream>>>(
-                static_cast<int>(vectorSize), static_cast<int>(batchSize), x, dy, dScale, dBias, saveMean, saveInvStdDev);
+                static_cast<int>(vectorSize), static_cast<int>(batchSize), x, dy, y, dScale, dBias, saveMean, saveInvStdDev);
         }
     };
 
@@ -914,7 +936,7 @@ namespace Microsoft { namespace MSR { namespace CNTK {
     struct ComputeSpatialScaleAndBiasGradients
     {
         template <typename ElemType>
-        static void Call(size_t vectorSize, size_t spatialSize, size_t batchSize, const ElemType* x, const ElemType* dy,
+        static void Call(size_t vectorSize, size_t spatialSize, size_t batchSize, const ElemType* x, const ElemType* dy, const ElemType* y,
             ElemType* dScale, ElemType* dBias, const ElemType* saveMean, const ElemType* saveInvStdDev, cudaStream_t stream)
         {
             assert((spatialSize % U) == 0);
@@ -926,12 +948,12 @@ namespace Microsoft { namespace MSR { namespace CNTK {
             // Create a grid that has uses striding in y-dimension to cover whole minibatch.
             auto gdim = dim3(static_cast<unsigned int>(vectorSize / spatialSize));
             kComputeSpatialScaleAndBiasGradients<BlockDimX, BlockDimY, U><<<gdim, bdim, 0, stream>>>(
-                static_cast<int>(vectorSize), static_cast<int>(spatialSize), static_cast<int>(batchSize), x, dy, dScale, dBias, saveMean, saveInvStdDev);
+                static_cast<int>(vectorSize), static_cast<int>(spatialSize), static_cast<int>(batchSize), x, dy, y, dScale, dBias, saveMean, saveInvStdDev);
         }
     };
 
     template <int BlockDimX, int BlockDimY, bool Spatial, int U, typename ElemType>
-    __global__ void kBackpropagateBatchNormGradients(int vectorSize, int spatialSize, int batchSize, const ElemType* x, const ElemType* dy, ElemType* dx,
+    __global__ void kBackpropagateBatchNormGradients(int vectorSize, int spatialSize, int batchSize, const ElemType* x, const ElemType* dy, const ElemType* y, ElemType* dx,
                                                      const ElemType* bnScale, const ElemType* dScale, const ElemType* dBias,
                                                      const ElemType* saveMean, const ElemType* saveInvStdDev)
     {
@@ -991,6 +1013,8 @@ namespace Microsoft { namespace MSR { namespace CNTK {
             ElemType dxCur[U];
             LoadValues<U>(px, xCur);
             LoadValues<U>(pdy, dyCur);
+            if (y != nullptr)
+                MaskReluGradient<U>(y + (pdy - dy), dyCur);
             LoadValues<U>(pdx, dxCur);
             // From the BN paper, dL/dxi is a sum of three terms: dL/dxi = t1 + t2 + t3
             // After simplifcation, they become the following:
@@ -1014,7 +1038,7 @@ namespace Microsoft { namespace MSR { namespace CNTK {
     struct BackpropagateBatchNormGradients
     {
         template <typename ElemType>
-        static void Call(size_t vectorSize, size_t spatialSize, size_t batchSize, bool spatial, const ElemType* x, const ElemType* dy, ElemType* dx,
+        static void Call(size_t vectorSize, size_t spatialSize, size_t batchSize, bool spatial, const ElemType* x, const ElemType* dy, const ElemType* y, ElemType* dx,
                          const ElemType* bnScale, const ElemType* dScale, const ElemType* dBias, const ElemType* saveMean, const ElemType* saveInvStdDev, cudaStream_t stream)
         {
             assert((vectorSize % U) == 0);
@@ -1026,19 +1050,20 @@ namespace Microsoft { namespace MSR { namespace CNTK {
             if (spatial)
             {
                 kBackpropagateBatchNormGradients<BlockDimX, BlockDimY, true, U><<<gdim, bdim, 0, stream>>>(
-                    static_cast<int>(vectorSize), static_cast<int>(spatialSize), static_cast<int>(batchSize), x, dy, dx, bnScale, dScale, dBias, saveMean, saveInvStdDev);
+                    static_cast<int>(vectorSize), static_cast<int>(spatialSize), static_cast<int>(batchSize), x, dy, y, dx, bnScale, dScale, dBias, saveMean, saveInvStdDev);
             }
             else
             {
                 kBackpropagateBatchNormGradients<BlockDimX, BlockDimY, false, U><<<gdim, bdim, 0, stream>>>(
-                    static_cast<int>(vectorSize), static_cast<int>(spatialSize), static_cast<int>(batchSize), x, dy, dx, bnScale, dScale, dBias, saveMean, saveInvStdDev);
+                    static_cast<int>(vectorSize), static_cast<int>(spatialSize), static_cast<int>(batchSize), x, dy, y, dx, bnScale, dScale, dBias, saveMean, saveInvStdDev);
             }
         }
     };
 
     template <typename ElemType>
     cudaError_t BatchNormalizationBackward(const Tensor4D& t, bool spatial, const ElemType* x, const ElemType* dy, ElemType* dx, const ElemType* bnScale,
-                                           ElemType* dScale, ElemType* dBias, const ElemType* saveMean, const ElemType* saveInvStdDev, cudaStream_t stream)
+                                           ElemType* dScale, ElemType* dBias, const ElemType* saveMean, const ElemType* saveInvStdDev,
+                                           const ElemType* y, cudaStream_t stream)
     {
         assert(nullptr != x);
         assert(nullptr != dy);
@@ -1057,7 +1082,7 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 
         if (spatial)
         {
-            Call<ComputeSpatialScaleAndBiasGradients, ElemType>(spatialSize, vectorSize, spatialSize, batchSize, x, dy, dScale, dBias, 
+            Call<ComputeSpatialScaleAndBiasGradients, ElemType>(spatialSize, vectorSize, spatialSize, batchSize, x, dy, y, dScale, dBias,
                                                                 saveMean, saveInvStdDev, stream);
             cudaError_t err = GetLastCudaError();
             if (cudaSuccess != err)
@@ -1065,14 +1090,14 @@ namespace Microsoft { namespace MSR { namespace CNTK {
         }
         else
         {
-            Call<ComputeScaleAndBiasGradients, ElemType>(vectorSize, vectorSize, batchSize, x, dy, dScale, dBias, 
+            Call<ComputeScaleAndBiasGradients, ElemType>(vectorSize, vectorSize, batchSize, x, dy, y, dScale, dBias,
                                                          saveMean, saveInvStdDev, stream);
             cudaError_t err = GetLastCudaError();
             if (cudaSuccess != err)
                 return err;
         }
         Call<BackpropagateBatchNormGradients, ElemType>(spatial ? spatialSize : vectorSize, vectorSize, spatialSize, batchSize, spatial, 
-                                                        x, dy, dx, bnScale, dScale, dBias, saveMean, saveInvStdDev, stream);
+                                                        x, dy, y, dx, bnScale, dScale, dBias, saveMean, saveInvStdDev, stream);
         return GetLastCudaError();
     }
 } } }
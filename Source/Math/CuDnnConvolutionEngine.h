@@ -30,7 +30,7 @@ public:
     Tensor4DPtr CreateTensor(size_t w, size_t h, size_t c, size_t n) override;
     FilterPtr CreateFilter(size_t w, size_t h, size_t c, size_t k) override;
     ConvDescPtr CreateConvDescriptor(const Tensor4D& inT, const Filter& filterT,
-                                     size_t wStride, size_t hStride, bool padding) override;
+                                     size_t wStride, size_t hStride, bool padding, size_t groups = 1) override;
     PoolDescPtr CreatePoolDescriptor(typename PoolDesc::PoolKind kind, size_t w, size_t h, size_t wStride, size_t hStride, size_t wPad, size_t hPad) override;
 
     ConvEnginePtr CreateConvEngine(DEVICEID_TYPE deviceId, ImageLayoutKind imageLayout, size_t maxTempMemSizeInSamples, BatchNormImpl bnImpl) override;
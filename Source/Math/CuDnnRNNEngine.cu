@@ -0,0 +1,458 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+#include "CuDnnRNNEngine.h"
+#include "GPUMatrix.h"
+#include <numeric>
+#ifdef USE_CUDNN
+#include <cudnn.h>
+
+template <>
+const char* CudaErrString<cudnnStatus_t>(cudnnStatus_t x); // defined in CuDnnConvolutionEngine.cu
+#endif
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+template <class ElemType>
+bool CuDnnRNNEngineFactory<ElemType>::IsSupported(DEVICEID_TYPE deviceId)
+{
+#if defined(USE_CUDNN) && CUDNN_VERSION >= 5000
+    cudaDeviceProp props = {0};
+    return cudaGetDeviceProperties(&props, deviceId) == cudaSuccess && props.major >= 3;
+#else
+    UNUSED(deviceId);
+    return false;
+#endif
+}
+
+#if defined(USE_CUDNN) && CUDNN_VERSION >= 5000
+
+// dst[:, j] = src[:, map[j]]
+template <class ElemType>
+__global__ void kGatherColumns(const ElemType* src, ElemType* dst, const int* map, int numRows, int numCols)
+{
+    const int i = blockIdx.x * blockDim.x + threadIdx.x;
+    if (i >= numRows * numCols)
+        return;
+    const int row = i % numRows;
+    const int col = i / numRows;
+    dst[i] = src[map[col] * numRows + row];
+}
+
+// dst[:, map[j]] = beta * dst[:, map[j]] + src[:, j]; map is injective, hence no atomics
+template <class ElemType>
+__global__ void kScatterColumns(const ElemType* src, ElemType* dst, const int* map, int numRows, int numCols, ElemType beta)
+{
+    const int i = blockIdx.x * blockDim.x + threadIdx.x;
+    if (i >= numRows * numCols)
+        return;
+    const int row = i % numRows;
+    const int col = i / numRows;
+    ElemType& d = dst[map[col] * numRows + row];
+    d = beta == 0 ? src[i] : beta * d + src[i];
+}
+
+static const int ThreadsPerBlock = 512;
+
+static int NumBlocks(size_t n)
+{
+    return (int) ((n + ThreadsPerBlock - 1) / ThreadsPerBlock);
+}
+
+template <class ElemType>
+static cudnnDataType_t CuDnnDataType()
+{
+    return std::is_same<ElemType, float>::value ? CUDNN_DATA_FLOAT : CUDNN_DATA_DOUBLE;
+}
+
+template <typename ElemType>
+static ElemType* ptr(Matrix<ElemType>& src)
+{
+    return src.BufferPointer();
+}
+template <typename ElemType>
+static const ElemType* ptr(const Matrix<ElemType>& src)
+{
+    return src.BufferPointer();
+}
+
+// -----------------------------------------------------------------------
+// CuDnnRNNEngine -- RNN stack using cuDNN's fused RNN kernels
+// cuDNN expects time-major packed input where sequences are sorted by decreasing length, so the
+// minibatch is gathered into that order for the call and scattered back afterwards.
+// Parameters are kept in the canonical layout of RNNAttributes (which is what the CPU engine uses, too),
+// and copied into cuDNN's opaque parameter blob for each minibatch.
+// With cuDNN v6+ on Pascal or later, the persistent RNN algorithm is used, which keeps the recurrent
+// weights in on-chip memory across time steps; it falls back to the standard algorithm if the
+// configuration is not supported by it.
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+class CuDnnRNNEngine : public RNNEngine<ElemType>
+{
+public:
+    using Base = RNNEngine<ElemType>;
+    using typename Base::Mat;
+
+    CuDnnRNNEngine(DEVICEID_TYPE deviceId, const RNNAttributes& attributes)
+        : Base(deviceId, attributes), m_cudnn(nullptr), m_rnnDesc(nullptr), m_dropoutDesc(nullptr), m_wDesc(nullptr), m_dwDesc(nullptr),
+          m_hDesc(nullptr), m_usePersistentAlgo(false), m_descInputDim(0), m_maxBatch(0), m_columnMap(nullptr), m_columnMapCapacity(0),
+          m_numFrames(0), m_workspaceBytes(0), m_reserveBytes(0),
+          m_x(deviceId), m_y(deviceId), m_dx(deviceId), m_dy(deviceId), m_w(deviceId), m_dw(deviceId), m_workspace(deviceId), m_reserve(deviceId)
+    {
+        CUDNN_CALL(cudnnCreate(&m_cudnn));
+        CUDNN_CALL(cudnnSetStream(m_cudnn, GetStream()));
+        CUDNN_CALL(cudnnCreateRNNDescriptor(&m_rnnDesc));
+        CUDNN_CALL(cudnnCreateDropoutDescriptor(&m_dropoutDesc));
+        CUDNN_CALL(cudnnSetDropoutDescriptor(m_dropoutDesc, m_cudnn, 0.0f, nullptr, 0, 0));
+        CUDNN_CALL(cudnnCreateFilterDescriptor(&m_wDesc));
+        CUDNN_CALL(cudnnCreateFilterDescriptor(&m_dwDesc));
+        CUDNN_CALL(cudnnCreateTensorDescriptor(&m_hDesc));
+
+#if CUDNN_VERSION >= 6000
+        cudaDeviceProp props = {0};
+        m_usePersistentAlgo = std::is_same<ElemType, float>::value &&
+                              cudaGetDeviceProperties(&props, deviceId) == cudaSuccess && props.major >= 6;
+#endif
+    }
+
+    ~CuDnnRNNEngine()
+    {
+        // TODO: Check for error code and throw if !std::uncaught_exception()
+        for (auto desc : m_xDesc)
+            cudnnDestroyTensorDescriptor(desc);
+        for (auto desc : m_yDesc)
+            cudnnDestroyTensorDescriptor(desc);
+        if (m_columnMap != nullptr)
+            TracingGPUMemoryAllocator::Free<int>(m_deviceId, m_columnMap);
+        cudnnDestroyTensorDescriptor(m_hDesc);
+        cudnnDestroyFilterDescriptor(m_dwDesc);
+        cudnnDestroyFilterDescriptor(m_wDesc);
+        cudnnDestroyDropoutDescriptor(m_dropoutDesc);
+        cudnnDestroyRNNDescriptor(m_rnnDesc);
+        cudnnDestroy(m_cudnn);
+    }
+
+protected:
+    using Base::m_deviceId;
+    using Base::m_attributes;
+    using Base::m_inputDim;
+
+    // a contiguous piece of the parameters that maps to a cuDNN linear layer matrix or bias
+    struct ParameterPiece
+    {
+        size_t canonicalOffset;
+        size_t cudnnOffset;
+        size_t size;
+    };
+
+    void SetRNNDescriptor()
+    {
+        const cudnnRNNMode_t mode = m_attributes.m_kind == RNNCellKind::LSTM    ? CUDNN_LSTM
+                                  : m_attributes.m_kind == RNNCellKind::GRU     ? CUDNN_GRU
+                                  : m_attributes.m_kind == RNNCellKind::RNNTanh ? CUDNN_RNN_TANH
+                                                                                : CUDNN_RNN_RELU;
+        const cudnnDirectionMode_t direction = m_attributes.m_bidirectional ? CUDNN_BIDIRECTIONAL : CUDNN_UNIDIRECTIONAL;
+#if CUDNN_VERSION >= 6000
+        CUDNN_CALL(cudnnSetRNNDescriptor_v6(m_cudnn, m_rnnDesc, (int) m_attributes.m_hiddenSize, (int) m_attributes.m_numLayers, m_dropoutDesc,
+                                            CUDNN_LINEAR_INPUT, direction, mode,
+                                            m_usePersistentAlgo ? CUDNN_RNN_ALGO_PERSIST_STATIC : CUDNN_RNN_ALGO_STANDARD, CuDnnDataType<ElemType>()));
+#else
+        CUDNN_CALL(cudnnSetRNNDescriptor(m_rnnDesc, (int) m_attributes.m_hiddenSize, (int) m_attributes.m_numLayers, m_dropoutDesc,
+                                         CUDNN_LINEAR_INPUT, direction, mode, CuDnnDataType<ElemType>()));
+#endif
+    }
+
+    static void SetTensorDescriptor(cudnnTensorDescriptor_t desc, size_t n, size_t c, size_t h)
+    {
+        int dims[3] = { (int) n, (int) c, (int) h };
+        int strides[3] = { (int) (c * h), (int) h, 1 };
+        CUDNN_CALL(cudnnSetTensorNdDescriptor(desc, CuDnnDataType<ElemType>(), 3, dims, strides));
+    }
+
+    // set up the time-major packing of the minibatch, and the per-step tensor descriptors
+    void PrepareLayout(const RNNMinibatchLayout& layout)
+    {
+        const size_t numSeqs = layout.m_numParallelSequences;
+
+        // cuDNN requires the batch size to be non-increasing over time steps
+        auto sequences = layout.m_sequences;
+        std::stable_sort(sequences.begin(), sequences.end(), [](const RNNMinibatchLayout::Sequence& a, const RNNMinibatchLayout::Sequence& b)
+        {
+            return a.tEnd - a.tBegin > b.tEnd - b.tBegin;
+        });
+        const size_t maxLength = sequences.empty() ? 0 : sequences.front().tEnd - sequences.front().tBegin;
+
+        std::vector<int> columnMap;
+        m_batchSizes.clear();
+        for (size_t tau = 0; tau < maxLength; tau++)
+        {
+            size_t batchSize = 0;
+            for (const auto& seq : sequences)
+            {
+                if (seq.tBegin + tau >= seq.tEnd)
+                    break;
+                columnMap.push_back((int) ((seq.tBegin + tau) * numSeqs + seq.s));
+                batchSize++;
+            }
+            m_batchSizes.push_back(batchSize);
+        }
+        m_numFrames = columnMap.size();
+
+        if (m_numFrames > m_columnMapCapacity)
+        {
+            if (m_columnMap != nullptr)
+                TracingGPUMemoryAllocator::Free<int>(m_deviceId, m_columnMap);
+            m_columnMap = TracingGPUMemoryAllocator::Allocate<int>(m_deviceId, m_numFrames);
+            m_columnMapCapacity = m_numFrames;
+        }
+        if (m_numFrames > 0)
+            CUDA_CALL(cudaMemcpyAsync(m_columnMap, columnMap.data(), m_numFrames * sizeof(int), cudaMemcpyHostToDevice, GetStream()));
+
+        while (m_xDesc.size() < maxLength)
+        {
+            cudnnTensorDescriptor_t xDesc, yDesc;
+            CUDNN_CALL(cudnnCreateTensorDescriptor(&xDesc));
+            CUDNN_CALL(cudnnCreateTensorDescriptor(&yDesc));
+            m_xDesc.push_back(xDesc);
+            m_yDesc.push_back(yDesc);
+        }
+        m_seqLength = (int) maxLength;
+        for (size_t tau = 0; tau < maxLength; tau++)
+        {
+            SetTensorDescriptor(m_xDesc[tau], m_batchSizes[tau], m_inputDim, 1);
+            SetTensorDescriptor(m_yDesc[tau], m_batchSizes[tau], m_attributes.GetOutputDim(), 1);
+        }
+        m_maxBatch = maxLength > 0 ? m_batchSizes.front() : 0;
+        SetTensorDescriptor(m_hDesc, m_attributes.m_numLayers * m_attributes.GetNumDirections(), m_maxBatch, m_attributes.m_hiddenSize);
+    }
+
+    // (re-)create the parameter descriptor and the mapping between canonical and cuDNN parameters
+    void PrepareParameters()
+    {
+        if (m_descInputDim == m_inputDim && !m_pieces.empty())
+            return;
+
+        // the parameter size only depends on the input dimension, so any batch size will do
+        cudnnTensorDescriptor_t xDesc;
+        CUDNN_CALL(cudnnCreateTensorDescriptor(&xDesc));
+        SetTensorDescriptor(xDesc, 1, m_inputDim, 1);
+
+        size_t paramBytes;
+        CUDNN_CALL(cudnnGetRNNParamsSize(m_cudnn, m_rnnDesc, xDesc, &paramBytes, CuDnnDataType<ElemType>()));
+        const size_t numParams = paramBytes / sizeof(ElemType);
+        int dims[3] = { (int) numParams, 1, 1 };
+        CUDNN_CALL(cudnnSetFilterNdDescriptor(m_wDesc, CuDnnDataType<ElemType>(), CUDNN_TENSOR_NCHW, 3, dims));
+        CUDNN_CALL(cudnnSetFilterNdDescriptor(m_dwDesc, CuDnnDataType<ElemType>(), CUDNN_TENSOR_NCHW, 3, dims));
+        m_w.Resize(1, numParams);
+        m_dw.Resize(1, numParams);
+
+        cudnnFilterDescriptor_t linLayerDesc;
+        CUDNN_CALL(cudnnCreateFilterDescriptor(&linLayerDesc));
+        auto addPiece = [&](size_t canonicalOffset, void* linLayerPtr)
+        {
+            cudnnDataType_t dataType;
+            cudnnTensorFormat_t format;
+            int nbDims;
+            int linLayerDims[3];
+            CUDNN_CALL(cudnnGetFilterNdDescriptor(linLayerDesc, 3, &dataType, &format, &nbDims, linLayerDims));
+            const size_t size = std::accumulate(linLayerDims, linLayerDims + nbDims, (size_t) 1, std::multiplies<size_t>());
+            m_pieces.push_back(ParameterPiece{ canonicalOffset, (size_t) (static_cast<ElemType*>(linLayerPtr) - ptr(m_w)), size });
+        };
+
+        m_pieces.clear();
+        const size_t numGates = m_attributes.GetNumGates();
+        for (size_t layer = 0; layer < m_attributes.m_numLayers; layer++)
+        {
+            const size_t layerInputDim = m_attributes.GetLayerInputDim(layer, m_inputDim);
+            for (size_t dir = 0; dir < m_attributes.GetNumDirections(); dir++)
+            {
+                const int pseudoLayer = (int) (layer * m_attributes.GetNumDirections() + dir);
+                const size_t blockOffset = m_attributes.GetParameterBlockOffset(layer, dir, m_inputDim);
+                // cuDNN's linear layer ids: 0..G-1 apply to the input, G..2G-1 to the recurrent state
+                for (size_t id = 0; id < 2 * numGates; id++)
+                {
+                    void* linLayerPtr;
+                    CUDNN_CALL(cudnnGetRNNLinLayerMatrixParams(m_cudnn, m_rnnDesc, pseudoLayer, xDesc, m_wDesc, ptr(m_w), (int) id, linLayerDesc, &linLayerPtr));
+                    addPiece(blockOffset + (id < numGates ? m_attributes.GetInputWeightsOffset(id, layerInputDim)
+                                                          : m_attributes.GetRecurrentWeightsOffset(id - numGates, layerInputDim)), linLayerPtr);
+                    CUDNN_CALL(cudnnGetRNNLinLayerBiasParams(m_cudnn, m_rnnDesc, pseudoLayer, xDesc, m_wDesc, ptr(m_w), (int) id, linLayerDesc, &linLayerPtr));
+                    addPiece(blockOffset + (id < numGates ? m_attributes.GetInputBiasOffset(id, layerInputDim)
+                                                          : m_attributes.GetRecurrentBiasOffset(id - numGates, layerInputDim)), linLayerPtr);
+                }
+            }
+        }
+        cudnnDestroyFilterDescriptor(linLayerDesc);
+        cudnnDestroyTensorDescriptor(xDesc);
+        m_descInputDim = m_inputDim;
+    }
+
+    void CopyParametersToCuDnn(const Mat& weights)
+    {
+        const Mat canonical = weights.Reshaped(1, weights.GetNumElements());
+        for (const auto& piece : m_pieces)
+            m_w.ColumnSlice(piece.cudnnOffset, piece.size).SetValue(canonical.ColumnSlice(piece.canonicalOffset, piece.size));
+    }
+
+    void AddParametersFromCuDnn(const Mat& dw, Mat& weightsGrad)
+    {
+        Mat canonical = weightsGrad.Reshaped(1, weightsGrad.GetNumElements());
+        for (const auto& piece : m_pieces)
+        {
+            Mat dst = canonical.ColumnSlice(piece.canonicalOffset, piece.size);
+            dst += dw.ColumnSlice(piece.cudnnOffset, piece.size);
+        }
+    }
+
+    void Gather(const Mat& src, Mat& dst)
+    {
+        dst.Resize(src.GetNumRows(), m_numFrames);
+        const size_t n = src.GetNumRows() * m_numFrames;
+        kGatherColumns<ElemType><<<NumBlocks(n), ThreadsPerBlock, 0, GetStream()>>>(ptr(src), ptr(dst), m_columnMap, (int) src.GetNumRows(), (int) m_numFrames);
+        CUDA_CALL(cudaGetLastError());
+    }
+
+    void Scatter(const Mat& src, Mat& dst, ElemType beta)
+    {
+        const size_t n = src.GetNumRows() * m_numFrames;
+        kScatterColumns<ElemType><<<NumBlocks(n), ThreadsPerBlock, 0, GetStream()>>>(ptr(src), ptr(dst), m_columnMap, (int) src.GetNumRows(), (int) m_numFrames, beta);
+        CUDA_CALL(cudaGetLastError());
+    }
+
+    static void ResizeBytes(Mat& m, size_t bytes)
+    {
+        m.Resize((bytes + sizeof(ElemType) - 1) / sizeof(ElemType), 1);
+    }
+
+    cudnnStatus_t TryForward(bool isTraining)
+    {
+        CUDNN_CALL(cudnnGetRNNWorkspaceSize(m_cudnn, m_rnnDesc, m_seqLength, m_xDesc.data(), &m_workspaceBytes));
+        ResizeBytes(m_workspace, m_workspaceBytes);
+        if (isTraining)
+        {
+            CUDNN_CALL(cudnnGetRNNTrainingReserveSize(m_cudnn, m_rnnDesc, m_seqLength, m_xDesc.data(), &m_reserveBytes));
+            ResizeBytes(m_reserve, m_reserveBytes);
+            return cudnnRNNForwardTraining(m_cudnn, m_rnnDesc, m_seqLength, m_xDesc.data(), ptr(m_x),
+                                           m_hDesc, nullptr, m_hDesc, nullptr, m_wDesc, ptr(m_w),
+                                           m_yDesc.data(), ptr(m_y), m_hDesc, nullptr, m_hDesc, nullptr,
+                                           ptr(m_workspace), m_workspaceBytes, ptr(m_reserve), m_reserveBytes);
+        }
+        else
+        {
+            return cudnnRNNForwardInference(m_cudnn, m_rnnDesc, m_seqLength, m_xDesc.data(), ptr(m_x),
+                                            m_hDesc, nullptr, m_hDesc, nullptr, m_wDesc, ptr(m_w),
+                                            m_yDesc.data(), ptr(m_y), m_hDesc, nullptr, m_hDesc, nullptr,
+                                            ptr(m_workspace), m_workspaceBytes);
+        }
+    }
+
+    void ForwardCore(const Mat& in, const Mat& weights, Mat& out, const RNNMinibatchLayout& layout, bool isTraining) override
+    {
+        if (m_descInputDim == 0)
+            SetRNNDescriptor();
+        PrepareParameters();
+        PrepareLayout(layout);
+
+        out.SetValue(0);
+        if (m_numFrames == 0)
+            return;
+
+        CopyParametersToCuDnn(weights);
+        Gather(in, m_x);
+        m_y.Resize(m_attributes.GetOutputDim(), m_numFrames);
+
+        cudnnStatus_t status = TryForward(isTraining);
+        if (status == CUDNN_STATUS_NOT_SUPPORTED && m_usePersistentAlgo)
+        {
+            // the persistent kernels have limits on hidden size and batch size; use the standard ones from now on
+            m_usePersistentAlgo = false;
+            SetRNNDescriptor();
+            m_pieces.clear();
+            PrepareParameters();
+            CopyParametersToCuDnn(weights);
+            status = TryForward(isTraining);
+        }
+        CUDNN_CALL(status);
+
+        Scatter(m_y, out, 0);
+    }
+
+    void BackwardDataCore(const Mat& /*out*/, const Mat& outGrad, const Mat& /*weights*/, Mat& inGrad) override
+    {
+        if (m_numFrames == 0)
+            return;
+
+        Gather(outGrad, m_dy);
+        m_dx.Resize(m_inputDim, m_numFrames);
+        CUDNN_CALL(cudnnRNNBackwardData(m_cudnn, m_rnnDesc, m_seqLength, m_yDesc.data(), ptr(m_y), m_yDesc.data(), ptr(m_dy),
+                                        m_hDesc, nullptr, m_hDesc, nullptr, m_wDesc, ptr(m_w), m_hDesc, nullptr, m_hDesc, nullptr,
+                                        m_xDesc.data(), ptr(m_dx), m_hDesc, nullptr, m_hDesc, nullptr,
+                                        ptr(m_workspace), m_workspaceBytes, ptr(m_reserve), m_reserveBytes));
+        Scatter(m_dx, inGrad, 1);
+    }
+
+    void BackwardWeightsCore(const Mat& /*in*/, const Mat& /*out*/, Mat& weightsGrad) override
+    {
+        if (m_numFrames == 0)
+            return;
+
+        // cuDNN accumulates into dw
+        m_dw.SetValue(0);
+        CUDNN_CALL(cudnnRNNBackwardWeights(m_cudnn, m_rnnDesc, m_seqLength, m_xDesc.data(), ptr(m_x), m_hDesc, nullptr,
+                                           m_yDesc.data(), ptr(m_y), ptr(m_workspace), m_workspaceBytes,
+                                           m_dwDesc, ptr(m_dw), ptr(m_reserve), m_reserveBytes));
+        AddParametersFromCuDnn(m_dw, weightsGrad);
+    }
+
+private:
+    cudnnHandle_t m_cudnn;
+    cudnnRNNDescriptor_t m_rnnDesc;
+    cudnnDropoutDescriptor_t m_dropoutDesc;
+    cudnnFilterDescriptor_t m_wDesc;
+    cudnnFilterDescriptor_t m_dwDesc;
+    cudnnTensorDescriptor_t m_hDesc; // initial/final states; we pass null pointers, i.e. zero initial state
+    std::vector<cudnnTensorDescriptor_t> m_xDesc;
+    std::vector<cudnnTensorDescriptor_t> m_yDesc;
+    bool m_usePersistentAlgo;
+
+    size_t m_descInputDim;
+    std::vector<ParameterPiece> m_pieces;
+
+    size_t m_maxBatch;
+    int m_seqLength;
+    std::vector<size_t> m_batchSizes;
+    int* m_columnMap; // packed column -> minibatch column
+    size_t m_columnMapCapacity;
+    size_t m_numFrames;
+
+    size_t m_workspaceBytes;
+    size_t m_reserveBytes;
+
+    Mat m_x, m_y, m_dx, m_dy; // packed
+    Mat m_w, m_dw;            // in cuDNN's parameter layout
+    Mat m_workspace;
+    Mat m_reserve;
+};
+
+template <class ElemType>
+std::unique_ptr<RNNEngine<ElemType>> CuDnnRNNEngineFactory<ElemType>::CreateEngine(DEVICEID_TYPE deviceId, const RNNAttributes& attributes)
+{
+    return std::make_unique<CuDnnRNNEngine<ElemType>>(deviceId, attributes);
+}
+
+#else
+
+template <class ElemType>
+std::unique_ptr<RNNEngine<ElemType>> CuDnnRNNEngineFactory<ElemType>::CreateEngine(DEVICEID_TYPE, const RNNAttributes&)
+{
+    RuntimeError("The code is compiled without USE_CUDNN macro or with cuDNN older than v5.");
+}
+
+#endif
+
+template class CuDnnRNNEngineFactory<float>;
+template class CuDnnRNNEngineFactory<double>;
+} } }
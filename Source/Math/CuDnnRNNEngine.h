@@ -0,0 +1,21 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include "RNNEngine.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+template <class ElemType>
+class CuDnnRNNEngineFactory
+{
+public:
+    static std::unique_ptr<RNNEngine<ElemType>> CreateEngine(DEVICEID_TYPE deviceId, const RNNAttributes& attributes);
+
+    // requires cuDNN v5 or later
+    static bool IsSupported(DEVICEID_TYPE deviceId);
+};
+} } }
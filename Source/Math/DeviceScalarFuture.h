@@ -0,0 +1,88 @@
+// DeviceScalarFuture.h -- reads a value computed on the device back to the host, without waiting where it is requested
+
+#pragma once
+
+#include "Basics.h"
+#include "Matrix.h"
+#include "CUDAPageLockedMemAllocator.h"
+#include "ComputeEventTimer.h"
+#include <memory>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// -----------------------------------------------------------------------
+// DeviceScalarFuture -- the first element of a matrix, e.g. a 1x1 result of AssignSumOfElements() or AssignMatrixNormInfOf()
+//
+// Start() issues the copy to page-locked host memory on the current stream; Get() waits for it the first time it is
+// called. Between the two, the host keeps issuing work, instead of waiting for the device like Get00Element() does.
+// On the CPU, Start() copies the value right away.
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+class DeviceScalarFuture
+{
+public:
+    DeviceScalarFuture(DEVICEID_TYPE deviceId)
+        : m_deviceId(deviceId), m_value(nullptr), m_isStarted(false), m_isReady(false)
+    {
+        if (m_deviceId >= 0)
+        {
+            m_copyDone.reset(new ComputeEventTimer(m_deviceId));
+            m_value = (ElemType*) CUDAPageLockedMemAllocator::Malloc(sizeof(ElemType), m_deviceId);
+        }
+        else
+            m_value = new ElemType(0);
+    }
+
+    ~DeviceScalarFuture()
+    {
+        if (m_deviceId >= 0)
+        {
+            m_copyDone->Synchronize(0);
+            CUDAPageLockedMemAllocator::Free(m_value, m_deviceId);
+        }
+        else
+            delete m_value;
+    }
+
+    // Disallow copy and move construction and assignment
+    DISABLE_COPY_AND_MOVE(DeviceScalarFuture);
+
+    void Start(const Matrix<ElemType>& scalar)
+    {
+        if (scalar.GetDeviceId() != m_deviceId)
+            LogicError("DeviceScalarFuture::Start: The matrix is on device %d, the future was made for device %d.", (int) scalar.GetDeviceId(), (int) m_deviceId);
+
+        // a pending copy must complete before the buffer is written again
+        if (m_copyDone)
+            m_copyDone->Synchronize(0);
+        scalar.CopyToHostAsync(m_value, 1);
+        if (m_copyDone)
+            m_copyDone->Record(0);
+        m_isStarted = true;
+        m_isReady = !m_copyDone;
+    }
+
+    bool IsStarted() const { return m_isStarted; }
+
+    ElemType Get()
+    {
+        if (!m_isStarted)
+            LogicError("DeviceScalarFuture::Get: Start() was not called.");
+        if (!m_isReady)
+        {
+            m_copyDone->Synchronize(0);
+            m_isReady = true;
+        }
+        return *m_value;
+    }
+
+private:
+    DEVICEID_TYPE m_deviceId;
+    std::unique_ptr<ComputeEventTimer> m_copyDone; // event 0: the end of the copy; null on the CPU
+    ElemType* m_value;                             // page-locked on a GPU
+    bool m_isStarted;
+    bool m_isReady;
+};
+
+} } }
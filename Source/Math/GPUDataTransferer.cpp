@@ -85,6 +85,7 @@ GPUDataTransferer<ElemType>::GPUDataTransferer(int deviceId, bool useConcurrentS
     // Note: Do NOT use cudaEventBlockingSync (which supposedly yields the process)--it will totally break cudaEventSynchronize(), causing it to take 50 or 100 ms randomly.
     cudaEventCreateWithFlags(&m_fetchCompleteEvent, cudaEventDisableTiming) || "cudaEventCreateWithFlags failed";
     cudaEventCreateWithFlags(&m_assignCompleteEvent, cudaEventDisableTiming) || "cudaEventCreateWithFlags failed";
+    cudaEventCreateWithFlags(&m_syncPointEvent, cudaEventDisableTiming) || "cudaEventCreateWithFlags failed";
 
 #pragma warning(disable : 4127)
     if (useConcurrentStreams && (m_fetchStream == NULL))
@@ -99,6 +100,7 @@ GPUDataTransferer<ElemType>::~GPUDataTransferer()
 {
     // BUGBUG: we don't destroy our streams (they are static variables); we need a static destructor, I am too lazy now
     // TODO: Check for error code and throw if !std::uncaught_exception()
+    cudaEventDestroy(m_syncPointEvent);
     cudaEventDestroy(m_assignCompleteEvent);
     cudaEventDestroy(m_fetchCompleteEvent);
 }
@@ -137,6 +139,55 @@ void GPUDataTransferer<ElemType>::WaitForCopyCPUToGPUAsync()
     SyncEvent(m_assignCompleteEvent);
 }
 
+template <class ElemType>
+void GPUDataTransferer<ElemType>::RecordComputeStreamSyncPoint()
+{
+    PrepareDevice(m_deviceId);
+
+    cudaEventRecord(m_syncPointEvent, GetStream()) || "cudaEventRecord failed";
+}
+
+template <class ElemType>
+void GPUDataTransferer<ElemType>::WaitForSyncPointOnAssignStreamAsync()
+{
+    PrepareDevice(m_deviceId);
+
+    // Note: waiting for an event that was never recorded returns immediately.
+    cudaStreamWaitEvent(m_assignStream, m_syncPointEvent, 0 /*flags 'must be 0'*/) || "cudaStreamWaitEvent failed";
+}
+
+template <class ElemType>
+void GPUDataTransferer<ElemType>::WaitForSyncPointOnFetchStreamAsync()
+{
+    PrepareDevice(m_deviceId);
+
+    cudaStreamWaitEvent(m_fetchStream, m_syncPointEvent, 0 /*flags 'must be 0'*/) || "cudaStreamWaitEvent failed";
+}
+
+template <class ElemType>
+void GPUDataTransferer<ElemType>::WaitForCopyGPUToCPUOnComputeStreamAsync()
+{
+    PrepareDevice(m_deviceId);
+
+    cudaStreamWaitEvent(GetStream(), m_fetchCompleteEvent, 0 /*flags 'must be 0'*/) || "cudaStreamWaitEvent failed";
+}
+
+template <class ElemType>
+void GPUDataTransferer<ElemType>::WaitForCopyCPUToGPUOnComputeStreamAsync()
+{
+    PrepareDevice(m_deviceId);
+
+    cudaStreamWaitEvent(GetStream(), m_assignCompleteEvent, 0 /*flags 'must be 0'*/) || "cudaStreamWaitEvent failed";
+}
+
+template <class ElemType>
+void GPUDataTransferer<ElemType>::WaitForCopyGPUToCPUOnAssignStreamAsync()
+{
+    PrepareDevice(m_deviceId);
+
+    cudaStreamWaitEvent(m_assignStream, m_fetchCompleteEvent, 0 /*flags 'must be 0'*/) || "cudaStreamWaitEvent failed";
+}
+
 //explicit
 template class GPUDataTransferer<float>;
 template class GPUDataTransferer<double>;
@@ -37,6 +37,18 @@ public:
     void CopyCPUToGPUAsync(ElemType* cpuBuffer, size_t numElements, ElemType* gpuBuffer);
     void WaitForCopyCPUToGPUAsync();
 
+    // Records the current position of the compute stream, e.g. after the last use of a buffer that is going to be overwritten.
+    void RecordComputeStreamSyncPoint();
+    // Makes the following copies on the assign stream wait until the compute stream has passed the recorded sync point.
+    void WaitForSyncPointOnAssignStreamAsync();
+    // Same for the fetch stream, e.g. before copying a value to the CPU that the compute stream has just computed.
+    void WaitForSyncPointOnFetchStreamAsync();
+
+    // Make the compute stream (or the assign stream) wait for the last copy, without blocking the CPU.
+    void WaitForCopyGPUToCPUOnComputeStreamAsync();
+    void WaitForCopyCPUToGPUOnComputeStreamAsync();
+    void WaitForCopyGPUToCPUOnAssignStreamAsync();
+
 #ifndef CPUONLY
     static cudaStream_t GetFetchStream();
 #endif // !CPUONLY
@@ -53,6 +65,7 @@ private:
 
     mutable cudaEvent_t m_fetchCompleteEvent;
     mutable cudaEvent_t m_assignCompleteEvent;
+    mutable cudaEvent_t m_syncPointEvent;
 #endif // !CPUONLY
 
     int m_deviceId;
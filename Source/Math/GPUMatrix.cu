@@ -14,6 +14,8 @@
 #include "GPUSparseMatrix.h"
 #include "GPUTensor.h"
 #include "CommonMatrix.h"
+#include "CUDACachingMemAllocator.h"
+#include "ComputeStreamPool.h" // for SharedComputeStreams
 #define TENSOR_OPS_DECL __device__ __host__
 #include "TensorOps.h"
 #include "device_launch_parameters.h"
@@ -23,7 +25,10 @@
 #include <curand_kernel.h>
 #include "cublas_v2.h"
 #include <assert.h>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <vector>
 
 #pragma comment(lib, "cudart.lib") // instruct linker to reference these libs
 #pragma comment(lib, "cublas.lib")
@@ -157,11 +162,16 @@ AllocatedElemType* TracingGPUMemoryAllocator::Allocate(int deviceId, size_t numE
 template <typename AllocatedElemType>
 void TracingGPUMemoryAllocator::Free(int deviceId, AllocatedElemType* bufferPtr, bool ignoreCUDARetCode /*= false*/)
 {
-    PrepareDevice(deviceId);
-    if (ignoreCUDARetCode)
-        cudaFree((void*) bufferPtr);
+    if (CUDACachingMemAllocator::IsEnabled())
+        CUDACachingMemAllocator::ForDevice(deviceId).Free((void*) bufferPtr); // returns it to the cache; no device synchronization
     else
-        CUDA_CALL(cudaFree((void*) bufferPtr));
+    {
+        PrepareDevice(deviceId);
+        if (ignoreCUDARetCode)
+            cudaFree((void*) bufferPtr);
+        else
+            CUDA_CALL(cudaFree((void*) bufferPtr));
+    }
 
     if (IsTraceEnabled())
     {
@@ -176,6 +186,9 @@ AllocatedElemType* TracingGPUMemoryAllocator::AllocateNoTrace(int deviceId, size
 {
     AllocatedElemType* deviceBufferPtr;
 
+    if (CUDACachingMemAllocator::IsEnabled())
+        return (AllocatedElemType*) CUDACachingMemAllocator::ForDevice(deviceId).Malloc(sizeof(AllocatedElemType) * numElements);
+
     PrepareDevice(deviceId);
     CUDA_CALL(cudaMalloc((void**) &deviceBufferPtr, sizeof(AllocatedElemType) * numElements));
 
@@ -205,6 +218,102 @@ void PrepareDevice(DEVICEID_TYPE deviceId)
     currentDevice = deviceId;
 }
 
+#pragma region PeerAccess
+
+// [a * numDevices + b] whether device b is a peer of device a, and whether a was enabled to access it
+enum class PeerState : char
+{
+    notPeer,
+    peer,
+    enabled
+};
+static std::vector<PeerState> s_peerStates;
+static int s_numDevices = -1;
+static std::mutex s_peerAccessMutex;
+
+static void DetectPeersLocked()
+{
+    if (s_numDevices >= 0)
+        return;
+    int numDevices = 0;
+    CUDA_CALL(cudaGetDeviceCount(&numDevices));
+    s_peerStates.assign(numDevices * numDevices, PeerState::notPeer);
+    for (int a = 0; a < numDevices; a++)
+    {
+        for (int b = 0; b < numDevices; b++)
+        {
+            int canAccessPeer = false;
+            if (a != b)
+                CUDA_CALL(cudaDeviceCanAccessPeer(&canAccessPeer, a, b));
+            if (canAccessPeer)
+                s_peerStates[a * numDevices + b] = PeerState::peer;
+        }
+    }
+    s_numDevices = numDevices;
+}
+
+void PeerAccess::DetectPeers()
+{
+    std::lock_guard<std::mutex> lock(s_peerAccessMutex);
+    DetectPeersLocked();
+}
+
+bool PeerAccess::EnableBetween(DEVICEID_TYPE deviceA, DEVICEID_TYPE deviceB)
+{
+    std::lock_guard<std::mutex> lock(s_peerAccessMutex);
+    DetectPeersLocked();
+    if (deviceA < 0 || deviceB < 0 || deviceA >= s_numDevices || deviceB >= s_numDevices)
+        InvalidArgument("PeerAccess::EnableBetween: invalid GPU device pair (%d, %d).", (int) deviceA, (int) deviceB);
+
+    bool isPeer = true;
+    int currentDevice;
+    CUDA_CALL(cudaGetDevice(&currentDevice));
+    for (auto device : {std::make_pair(deviceA, deviceB), std::make_pair(deviceB, deviceA)})
+    {
+        PeerState& state = s_peerStates[device.first * s_numDevices + device.second];
+        if (state == PeerState::peer)
+        {
+            PrepareDevice(device.first);
+            cudaError_t cudaStatus = cudaDeviceEnablePeerAccess(device.second, 0 /*flags 'must be 0'*/);
+            if (cudaStatus == cudaErrorPeerAccessAlreadyEnabled)
+                cudaGetLastError(); // clear it, it was enabled outside of this table
+            else
+                CUDA_CALL(cudaStatus);
+            state = PeerState::enabled;
+        }
+        isPeer = isPeer && state == PeerState::enabled;
+    }
+    PrepareDevice((DEVICEID_TYPE) currentDevice);
+    return isPeer;
+}
+
+// copies between two GPUs, ordered after the work issued so far to the current streams of both, and before the work issued to them later
+void CopyBetweenDevicesAsync(void* dst, DEVICEID_TYPE dstDevice, const void* src, DEVICEID_TYPE srcDevice, size_t numBytes)
+{
+    PeerAccess::EnableBetween(dstDevice, srcDevice);
+
+    cudaEvent_t sourceReady, copied;
+    PrepareDevice(srcDevice);
+    CUDA_CALL(cudaEventCreateWithFlags(&sourceReady, cudaEventDisableTiming));
+    CUDA_CALL(cudaEventRecord(sourceReady, t_stream));
+
+    PrepareDevice(dstDevice);
+    CUDA_CALL(cudaStreamWaitEvent(t_stream, sourceReady, 0));
+    CUDA_CALL(cudaMemcpyPeerAsync(dst, dstDevice, src, srcDevice, numBytes, t_stream));
+    CUDA_CALL(cudaEventCreateWithFlags(&copied, cudaEventDisableTiming));
+    CUDA_CALL(cudaEventRecord(copied, t_stream));
+
+    // the source may be freed or overwritten after this
+    PrepareDevice(srcDevice);
+    CUDA_CALL(cudaStreamWaitEvent(t_stream, copied, 0));
+    CUDA_CALL(cudaEventDestroy(sourceReady)); // resources are released once the events completed
+
+    PrepareDevice(dstDevice);
+    CUDA_CALL(cudaEventDestroy(copied));
+}
+
+#pragma endregion PeerAccess
+
 #pragma region DeviceBoundNumber class
 
 template <class ElemType>
@@ -279,6 +388,7 @@ DEVICEID_TYPE GPUMatrix<ElemType>::PrepareDevice(DEVICEID_TYPE deviceId /*=-1*/)
 template <class ElemType>
 ElemType* GPUMatrix<ElemType>::CopyToArray() const
 {
+    GPUMathOptions::NoteImplicitDeviceSync("GPUMatrix::CopyToArray");
     size_t numElements = GetNumElements();
     if (numElements != 0)
     {
@@ -298,6 +408,7 @@ ElemType* GPUMatrix<ElemType>::CopyToArray() const
 template <class ElemType>
 size_t GPUMatrix<ElemType>::CopyToArray(ElemType*& arrayCopyTo, size_t& currentArraySize) const
 {
+    GPUMathOptions::NoteImplicitDeviceSync("GPUMatrix::CopyToArray");
     size_t numElements = GetNumElements();
 
     if (numElements > currentArraySize)
@@ -319,6 +430,7 @@ size_t GPUMatrix<ElemType>::CopyToArray(ElemType*& arrayCopyTo, size_t& currentA
 template <typename ElemType>
 void GPUMatrix<ElemType>::CopySection(size_t numRows, size_t numCols, ElemType* dst, size_t colStride) const
 {
+    GPUMathOptions::NoteImplicitDeviceSync("GPUMatrix::CopySection");
     CUBLAS_CALL(cublasGetMatrix((int) numRows, (int) numCols, sizeof(ElemType),
                                 m_pArray, (int) GetNumRows(), dst, (int) colStride));
 }
@@ -338,32 +450,7 @@ void GPUMatrix<ElemType>::ChangeDeviceTo(DEVICEID_TYPE to_id)
 
     // check to make sure we have something to copy (on init we often have zero sized allocations)
     if (m_elemSizeAllocated > 0)
-    {
-        // first try peer access
-        int canAccessPeer = false;
-        CUDA_CALL(cudaDeviceCanAccessPeer(&canAccessPeer, to_id, m_computeDevice));
-        if (canAccessPeer)
-        {
-            cudaError_t cudaStatus = cudaDeviceEnablePeerAccess(m_computeDevice, 0);
-            if (cudaStatus != cudaErrorPeerAccessAlreadyEnabled)
-            {
-                CUDA_CALL(cudaStatus);
-            }
-            CUDA_CALL(cudaMemcpyPeer(d_dst, to_id, m_pArray, m_computeDevice, sizeof(ElemType) * m_numRows * m_numCols));
-        }
-        else
-        {
-            // peer access didn't work, just copy normal
-            // make this more efficient by keeping some buffers available for each copy
-            ElemType* h_dst = NULL;
-            PrepareDevice();
-            CUDA_CALL(cudaMallocHost((void**) &h_dst, sizeof(ElemType) * m_numRows * m_numCols));
-            CUDA_CALL(cudaMemcpy(h_dst, m_pArray, sizeof(ElemType) * m_numRows * m_numCols, cudaMemcpyDeviceToHost));
-            PrepareDevice((DEVICEID_TYPE) to_id);
-            CUDA_CALL(cudaMemcpy(d_dst, h_dst, sizeof(ElemType) * m_numRows * m_numCols, cudaMemcpyHostToDevice));
-            CUDA_CALL(cudaFreeHost(h_dst));
-        }
-    }
+        CopyBetweenDevicesAsync(d_dst, to_id, m_pArray, m_computeDevice, sizeof(ElemType) * m_numRows * m_numCols);
 
     TracingGPUMemoryAllocator::Free<ElemType>(m_computeDevice, m_pArray);
     m_pArray = d_dst;
@@ -638,6 +725,51 @@ void GPUMatrix<ElemType>::CopyColumnsStrided(const GPUMatrix<ElemType>& fromMatr
     }
 }
 
+// this(:,j) = beta * this(:,j) + alpha * a(:,idx(j)); a negative index leaves beta * this(:,j)
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::DoGatherColumnsOf(ElemType beta, const GPUMatrix<ElemType>& idx, const GPUMatrix<ElemType>& a, ElemType alpha)
+{
+    if (idx.GetNumRows() != 1)
+        InvalidArgument("DoGatherColumnsOf: The index must be a row vector.");
+    if (beta)
+        VerifySize(a.GetNumRows(), idx.GetNumCols());
+    else
+        Resize(a.GetNumRows(), idx.GetNumCols());
+
+    CUDA_LONG N = (CUDA_LONG) GetNumElements();
+    if (N == 0)
+        return *this;
+    int blocksPerGrid = (int) ceil(1.0 * N / GridDim::maxThreadsPerBlock);
+    PrepareDevice();
+    SyncGuard syncGuard;
+    _doGatherColumnsOf<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(m_pArray, beta, idx.m_pArray, a.m_pArray, alpha, (CUDA_LONG) m_numRows, (CUDA_LONG) m_numCols);
+    return *this;
+}
+
+// this(:,idx(j)) = beta * this(:,idx(j)) + alpha * a(:,j), and beta * this elsewhere; a negative index drops the column
+// The indices must not repeat.
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::DoScatterColumnsOf(ElemType beta, const GPUMatrix<ElemType>& idx, const GPUMatrix<ElemType>& a, ElemType alpha)
+{
+    if (idx.GetNumRows() != 1 || idx.GetNumCols() != a.GetNumCols())
+        InvalidArgument("DoScatterColumnsOf: The index must be a row vector with one entry per column of the input.");
+    if (GetNumRows() != a.GetNumRows())
+        InvalidArgument("DoScatterColumnsOf: The number of rows of the input (%d) does not match that of the target (%d).", (int) a.GetNumRows(), (int) GetNumRows());
+    if (beta == 0)
+        SetValue(0);
+    else if (beta != 1)
+        *this *= beta;
+
+    CUDA_LONG N = (CUDA_LONG) a.GetNumElements();
+    if (N == 0)
+        return *this;
+    int blocksPerGrid = (int) ceil(1.0 * N / GridDim::maxThreadsPerBlock);
+    PrepareDevice();
+    SyncGuard syncGuard;
+    _doScatterColumnsOf<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(m_pArray, idx.m_pArray, a.m_pArray, alpha, (CUDA_LONG) a.GetNumRows(), (CUDA_LONG) a.GetNumCols());
+    return *this;
+}
+
 //for each column of a, we assign all rows of a to this starting from startIndex
 template <class ElemType>
 GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignToRowSliceValuesOf(const GPUMatrix<ElemType>& a, const size_t startIndex, const size_t numRows)
@@ -855,6 +987,7 @@ GPUMatrix<ElemType> GPUMatrix<ElemType>::Transpose() const
 }
 
 // GetCublasHandle - get a cublas handle for the given GPU, should only need one per GPU
+// (and one per shared stream, see SharedComputeStreams: the threads that hold one run concurrently, and must not rebind each other's handle)
 // computeDevice - The compute device for which the cublas handle is desired
 // returns: cublas handle
 // NOTE: we currently don't bother to ever free the CUBLAS handle, it will be freed automatically by CUDA when the process ends
@@ -867,10 +1000,25 @@ cublasHandle_t GPUMatrix<ElemType>::GetCublasHandle(int computeDevice /*=-1*/)
 
     if (computeDevice < 0 || computeDevice >= MaxGpus)
         LogicError("GetCublasHandle: Maximum GPU exceeded");
-    cublasHandle_t cuHandle = s_cuHandle[computeDevice];
-    if (cuHandle == NULL)
+    cublasHandle_t cuHandle;
+    cudaStream_t sharedStream = SharedComputeStreams::Current();
+    if (sharedStream == nullptr)
     {
-        s_cuHandle[computeDevice] = cuHandle = _initCUBLAS<ElemType>(computeDevice);
+        cuHandle = s_cuHandle[computeDevice];
+        if (cuHandle == NULL)
+        {
+            s_cuHandle[computeDevice] = cuHandle = _initCUBLAS<ElemType>(computeDevice);
+        }
+    }
+    else
+    {
+        static std::mutex sharedStreamHandlesMutex;
+        static std::map<std::pair<int, cudaStream_t>, cublasHandle_t> sharedStreamHandles;
+        std::lock_guard<std::mutex> lock(sharedStreamHandlesMutex);
+        cublasHandle_t& handle = sharedStreamHandles[std::make_pair(computeDevice, sharedStream)];
+        if (handle == NULL)
+            handle = _initCUBLAS<ElemType>(computeDevice);
+        cuHandle = handle;
     }
     CUBLAS_CALL(cublasSetStream(cuHandle, t_stream));
 
@@ -987,6 +1135,7 @@ void GPUMatrix<ElemType>::SetColumn(const ElemType* colPointer, size_t colInd)
         LogicError("SetValue: Matrix is empty.");
     if (colPointer == NULL)
         return;
+    GPUMathOptions::NoteHostTransfer();
     CUDA_CALL(cudaMemcpy(m_pArray + LocateColumn(colInd), colPointer, sizeof(ElemType) * m_numRows, cudaMemcpyHostToDevice));
 }
 
@@ -1013,6 +1162,24 @@ void GPUMatrix<ElemType>::SetValue(const GPUMatrix<ElemType>& deepCopyFrom)
         CUDA_CALL(cudaMemcpy(m_pArray, deepCopyFrom.m_pArray, cpSize * sizeof(ElemType), cudaMemcpyDeviceToDevice));
 }
 
+// Copies a matrix on another GPU without moving it, for the edges of a network that is placed on multiple GPUs.
+// The copy is asynchronous: on this device it waits for the work queued on the source device so far,
+// and the work queued on the source device afterwards waits for the copy, so the source may be overwritten then.
+template <class ElemType>
+void GPUMatrix<ElemType>::SetValueFromOtherDevice(const GPUMatrix<ElemType>& deepCopyFrom)
+{
+    if (deepCopyFrom.m_computeDevice == m_computeDevice)
+        return SetValue(deepCopyFrom);
+
+    Resize(deepCopyFrom.GetNumRows(), deepCopyFrom.GetNumCols());
+    m_format = deepCopyFrom.m_format;
+    size_t cpSize = deepCopyFrom.GetNumRows() * deepCopyFrom.GetNumCols();
+    if (cpSize == 0)
+        return;
+
+    CopyBetweenDevicesAsync(m_pArray, m_computeDevice, deepCopyFrom.m_pArray, deepCopyFrom.m_computeDevice, cpSize * sizeof(ElemType));
+}
+
 template <class ElemType>
 void GPUMatrix<ElemType>::SetValue(const size_t numRows, const size_t numCols, int deviceId, ElemType* pArray, size_t matrixFlags)
 {
@@ -1055,6 +1222,8 @@ void GPUMatrix<ElemType>::SetValue(const size_t numRows, const size_t numCols, i
         PrepareDevice();
         if (pArray != NULL)
         {
+            if (!(matrixFlags & matrixFlagSetValueOnDevice))
+                GPUMathOptions::NoteHostTransfer();
             if (!(matrixFlags & matrixFormatRowMajor))
             {
                 CUDA_CALL(cudaMemcpy(m_pArray, pArray, sizeof(ElemType) * GetNumElements(), (matrixFlags & matrixFlagSetValueOnDevice) ? cudaMemcpyDeviceToDevice : cudaMemcpyHostToDevice));
@@ -1172,6 +1341,25 @@ void GPUMatrix<ElemType>::SetUniformRandomMask(const ElemType maskRate, const El
     _setMaskAndScale<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(m_pArray, N, maskRate, scaleValue);
 }
 
+// [this] = beta * [this] + a .* mask, the mask from the counter-based generator (see Matrix::ScaleAndAddDropoutOf()), generated in the kernel
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::ScaleAndAddDropoutOf(const ElemType beta, const GPUMatrix<ElemType>& a, const ElemType maskRate, const ElemType scaleValue, unsigned long seed, size_t counterOffset)
+{
+    if (a.IsEmpty())
+        LogicError("ScaleAndAddDropoutOf: Matrix is empty.");
+    if (beta == 0)
+        Resize(a.GetNumRows(), a.GetNumCols());
+    else if (!(a.GetNumRows() == GetNumRows() && a.GetNumCols() == GetNumCols()))
+        InvalidArgument("ScaleAndAddDropoutOf: The input matrix dimensions do not match [this].");
+
+    CUDA_LONG N = (CUDA_LONG) GetNumElements();
+    int blocksPerGrid = (int) ceil(1.0 * N / GridDim::maxThreadsPerBlock);
+    a.PrepareDevice();
+    SyncGuard syncGuard;
+    _scaleAndAddDropoutOf<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(m_pArray, a.m_pArray, N, beta, maskRate, scaleValue, (uint64_t) seed, (uint64_t) counterOffset);
+    return *this;
+}
+
 template <class ElemType>
 ElemType GPUMatrix<ElemType>::Adagrad(GPUMatrix<ElemType>& gradients, const bool needAveMultiplier)
 {
@@ -1238,6 +1426,61 @@ void GPUMatrix<ElemType>::FSAdagrad(GPUMatrix<ElemType>& gradients,
                                                                          learnRatePerSample, momentum, adaWeight, adaMul);
 }
 
+template <class ElemType>
+void GPUMatrix<ElemType>::Adam(GPUMatrix<ElemType>& gradients,
+                               GPUMatrix<ElemType>* functionValues,
+                               ElemType learnRate,
+                               ElemType beta1,
+                               ElemType beta2,
+                               ElemType epsilon,
+                               ElemType biasCorrection)
+{
+    size_t numColsNeeded = 2 * gradients.GetNumCols();
+
+    if (IsEmpty() || (GetNumCols() < numColsNeeded))
+    {
+        Resize(gradients.GetNumRows(), numColsNeeded);
+        SetValue(0.0);
+    }
+
+    assert((GetNumRows() == gradients.GetNumRows()) && (GetNumCols() == numColsNeeded));
+
+    size_t n = gradients.GetNumElements();
+    int blocksPerGrid = (n + GridDim::maxThreadsPerBlock - 1) / GridDim::maxThreadsPerBlock;
+    PrepareDevice();
+    SyncGuard syncGuard;
+    _adam<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(n, gradients.m_pArray, m_pArray, m_pArray + n, functionValues ? functionValues->m_pArray : nullptr,
+                                                                                 learnRate, beta1, beta2, epsilon, biasCorrection);
+}
+
+// one launch for all tensors of the batch; the batch and the block table are kernel arguments, so nothing is copied beforehand
+template <class ElemType>
+/*static*/ void GPUMatrix<ElemType>::FusedSGDUpdate(DEVICEID_TYPE deviceId, const FusedSGDBatch<ElemType>& batch)
+{
+    FusedSGDBlocks<ElemType> blocks;
+    CUDA_LONG blocksPerGrid = blocks.Assign(batch);
+    if (blocksPerGrid == 0)
+        return;
+
+    PrepareDevice(deviceId);
+    SyncGuard syncGuard;
+    _fusedSGDUpdate<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(batch, blocks);
+}
+
+// adds the sum of the squared gradient elements of the batch to the device value *sumOfSquares, without waiting for it
+template <class ElemType>
+/*static*/ void GPUMatrix<ElemType>::FusedSGDSquaredNorm(DEVICEID_TYPE deviceId, const FusedSGDBatch<ElemType>& batch, ElemType* sumOfSquares)
+{
+    FusedSGDBlocks<ElemType> blocks;
+    CUDA_LONG blocksPerGrid = blocks.Assign(batch);
+    if (blocksPerGrid == 0)
+        return;
+
+    PrepareDevice(deviceId);
+    SyncGuard syncGuard;
+    _fusedSGDSquaredNorm<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(batch, blocks, sumOfSquares);
+}
+
 template <class ElemType>
 ElemType GPUMatrix<ElemType>::RmsProp(GPUMatrix<ElemType>& gradients,
                                       ElemType RMS_GAMMA,
@@ -1378,9 +1621,22 @@ size_t GPUMatrix<ElemType>::LocateColumn(const size_t col) const
     return col * m_numRows; // matrix in column-wise storage
 }
 
+template <class ElemType>
+void GPUMatrix<ElemType>::CopyToHostAsync(ElemType* dst, size_t numElements) const
+{
+    if (numElements > GetNumElements())
+        InvalidArgument("CopyToHostAsync: %d elements requested from a matrix of %d.", (int) numElements, (int) GetNumElements());
+    if (numElements == 0)
+        return;
+
+    PrepareDevice();
+    CUDA_CALL(cudaMemcpyAsync(dst, m_pArray, sizeof(ElemType) * numElements, cudaMemcpyDeviceToHost, t_stream));
+}
+
 template <class ElemType>
 ElemType GPUMatrix<ElemType>::Get00Element() const
 {
+    GPUMathOptions::NoteImplicitDeviceSync("GPUMatrix::Get00Element");
     ElemType res = 0;
     CUDA_CALL(cudaMemcpy(&res, m_pArray, sizeof(ElemType), cudaMemcpyDeviceToHost));
     return res;
@@ -1840,6 +2096,261 @@ void GPUMatrix<ElemType>::AssignNCEDerivative(GPUMatrix<ElemType>& tmp, const GP
         inputIndex);
 }
 
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::InplaceSampleFromCDF(const GPUMatrix<ElemType>& cdf)
+{
+    if (cdf.IsEmpty())
+        LogicError("InplaceSampleFromCDF: the distribution is empty.");
+
+    PrepareDevice();
+    CUDA_LONG N = (CUDA_LONG) GetNumElements();
+    if (N == 0)
+        return *this;
+    int blocksPerGrid = (int) ceil(1.0 * N / GridDim::maxThreadsPerBlock);
+    SyncGuard syncGuard;
+    _inplaceSampleFromCDF<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(GetArray(), N, cdf.BufferPointer(), (CUDA_LONG) cdf.GetNumElements());
+    return *this;
+}
+
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignSampledSoftmaxLogits(const GPUMatrix<ElemType>& trueLogits, const GPUMatrix<ElemType>& sampledLogits,
+                                                                     const GPUMatrix<ElemType>& candidateBiases, const GPUMatrix<ElemType>& candidateIds)
+{
+    const size_t numSamples = sampledLogits.GetNumRows();
+    Resize(numSamples + 1, sampledLogits.GetNumCols());
+    CUDA_LONG N = (CUDA_LONG) GetNumElements();
+    if (N == 0)
+        return *this;
+
+    PrepareDevice();
+    int blocksPerGrid = (int) ceil(1.0 * N / GridDim::maxThreadsPerBlock);
+    SyncGuard syncGuard;
+    _assignSampledSoftmaxLogits<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(GetArray(), trueLogits.BufferPointer(), sampledLogits.BufferPointer(),
+                                                                                                      candidateBiases.BufferPointer(), candidateIds.BufferPointer(), (CUDA_LONG) numSamples, N);
+    return *this;
+}
+
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignAliasSamplesOf(const GPUMatrix<ElemType>& uniforms, const GPUMatrix<ElemType>& aliasProbs, const GPUMatrix<ElemType>& aliases)
+{
+    Resize(1, uniforms.GetNumCols());
+    CUDA_LONG N = (CUDA_LONG) GetNumElements();
+    if (N == 0)
+        return *this;
+
+    PrepareDevice();
+    int blocksPerGrid = (int) ceil(1.0 * N / GridDim::maxThreadsPerBlock);
+    SyncGuard syncGuard;
+    _assignAliasSamples<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(GetArray(), uniforms.BufferPointer(), aliasProbs.BufferPointer(), aliases.BufferPointer(),
+                                                                                              (CUDA_LONG) aliasProbs.GetNumElements(), N);
+    return *this;
+}
+
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignNCELossOf(const GPUMatrix<ElemType>& labelIds, const GPUMatrix<ElemType>& noiseIds, const GPUMatrix<ElemType>& hidden, const GPUMatrix<ElemType>& weights,
+                                                          const GPUMatrix<ElemType>& bias, const GPUMatrix<ElemType>& logNoiseCounts, GPUMatrix<ElemType>& scoreGradients)
+{
+    const CUDA_LONG numNoise = (CUDA_LONG) noiseIds.GetNumElements();
+    const CUDA_LONG numCols = (CUDA_LONG) hidden.GetNumCols();
+    Resize(1, numCols);
+    scoreGradients.Resize(numNoise + 1, numCols);
+    if (numCols == 0)
+        return *this;
+
+    PrepareDevice();
+    SyncGuard syncGuard;
+    // a block per frame, with a group of NCE_GROUP_SIZE threads per score
+    _assignNCELoss<ElemType><<<(int) min(numCols, (CUDA_LONG) 65535), dim3(NCE_GROUP_SIZE, NCE_GROUPS_PER_BLOCK), 0, t_stream>>>(GetArray(), scoreGradients.GetArray(),
+        labelIds.BufferPointer(), noiseIds.BufferPointer(), hidden.BufferPointer(), weights.BufferPointer(), bias.BufferPointer(), logNoiseCounts.BufferPointer(),
+        numNoise, (CUDA_LONG) hidden.GetNumRows(), numCols);
+    return *this;
+}
+
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AddNCEHiddenGradientOf(const GPUMatrix<ElemType>& scoreGradients, const GPUMatrix<ElemType>& labelIds, const GPUMatrix<ElemType>& noiseIds,
+                                                                 const GPUMatrix<ElemType>& weights)
+{
+    const CUDA_LONG dim = (CUDA_LONG) GetNumRows();
+    const CUDA_LONG numCols = (CUDA_LONG) GetNumCols();
+    if (dim == 0 || numCols == 0)
+        return *this;
+
+    PrepareDevice();
+    SyncGuard syncGuard;
+    dim3 blocksPerGrid((unsigned int) ceil(1.0 * dim / GridDim::maxThreadsPerBlock), (unsigned int) min(numCols, (CUDA_LONG) 65535));
+    _addNCEHiddenGradient<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(GetArray(), scoreGradients.BufferPointer(), labelIds.BufferPointer(), noiseIds.BufferPointer(),
+                                                                                                weights.BufferPointer(), (CUDA_LONG) noiseIds.GetNumElements(), dim, numCols);
+    return *this;
+}
+
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignGMMLogLikelihoodOf(const GPUMatrix<ElemType>& logPrior, const GPUMatrix<ElemType>& mean, const GPUMatrix<ElemType>& logStddev, const GPUMatrix<ElemType>& feature,
+                                                                   GPUMatrix<ElemType>& posterior, GPUMatrix<ElemType>& normedDeviation, GPUMatrix<ElemType>& normedDeviationVectors)
+{
+    const size_t numComponents = logPrior.GetNumRows();
+    const size_t featureDim = feature.GetNumRows();
+    const size_t numSamples = feature.GetNumCols();
+    Resize(1, numSamples);
+    posterior.Resize(numComponents, numSamples);
+    normedDeviation.Resize(numComponents, numSamples);
+    normedDeviationVectors.Resize(numComponents * featureDim, numSamples);
+    if (numSamples == 0)
+        return *this;
+
+    PrepareDevice();
+    // one thread per sample; parameters with a single column are shared by all samples (stride 0)
+    int blocksPerGrid = (int) ceil(1.0 * numSamples / GridDim::maxThreadsPerBlock);
+    SyncGuard syncGuard;
+    _assignGMMLogLikelihood<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(GetArray(),
+                                                                                                  logPrior.BufferPointer(), (CUDA_LONG)(logPrior.GetNumCols() == 1 ? 0 : numComponents),
+                                                                                                  mean.BufferPointer(), (CUDA_LONG)(mean.GetNumCols() == 1 ? 0 : numComponents * featureDim),
+                                                                                                  logStddev.BufferPointer(), (CUDA_LONG)(logStddev.GetNumCols() == 1 ? 0 : numComponents),
+                                                                                                  feature.BufferPointer(), posterior.GetArray(), normedDeviation.GetArray(), normedDeviationVectors.GetArray(),
+                                                                                                  (CUDA_LONG) numComponents, (CUDA_LONG) featureDim, (CUDA_LONG) numSamples);
+    return *this;
+}
+
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AddGMMLogLikelihoodGradient(const size_t inputIndex, const GPUMatrix<ElemType>& gradient, const GPUMatrix<ElemType>& logPrior,
+                                                                      const GPUMatrix<ElemType>& posterior, const GPUMatrix<ElemType>& normedDeviation, const GPUMatrix<ElemType>& normedDeviationVectors)
+{
+    const size_t numComponents = posterior.GetNumRows();
+    const size_t numSamples = posterior.GetNumCols();
+    const bool sumOverSamples = GetNumCols() != numSamples;
+    CUDA_LONG N = (CUDA_LONG)(sumOverSamples ? GetNumRows() : GetNumElements());
+    if (N == 0 || numSamples == 0)
+        return *this;
+
+    PrepareDevice();
+    int blocksPerGrid = (int) ceil(1.0 * N / GridDim::maxThreadsPerBlock);
+    SyncGuard syncGuard;
+    _addGMMLogLikelihoodGradient<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(GetArray(), (CUDA_LONG) inputIndex, gradient.BufferPointer(),
+                                                                                                       logPrior.BufferPointer(), (CUDA_LONG)(logPrior.GetNumCols() == 1 ? 0 : numComponents),
+                                                                                                       posterior.BufferPointer(), normedDeviation.BufferPointer(), normedDeviationVectors.BufferPointer(),
+                                                                                                       (CUDA_LONG) numComponents, (CUDA_LONG)(normedDeviationVectors.GetNumRows() / numComponents),
+                                                                                                       (CUDA_LONG) GetNumRows(), (CUDA_LONG) numSamples, sumOverSamples, N);
+    return *this;
+}
+
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignCrossEntropyWithSoftmaxOf(const GPUMatrix<ElemType>& labels, const GPUMatrix<ElemType>& logits, GPUMatrix<ElemType>& logSumExp)
+{
+    const size_t numCols = logits.GetNumCols();
+    Resize(1, 1);
+    SetValue((ElemType) 0);
+    logSumExp.Resize(1, numCols);
+    if (numCols == 0)
+        return *this;
+
+    PrepareDevice();
+    // one block per column, the criterion of all columns is accumulated atomically
+    SyncGuard syncGuard;
+    _assignCrossEntropyWithSoftmax<ElemType><<<(int) numCols, 512, 0, t_stream>>>(GetArray(), logSumExp.GetArray(), labels.BufferPointer(), logits.BufferPointer(),
+                                                                                 (CUDA_LONG) logits.GetNumRows());
+    return *this;
+}
+
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AddCrossEntropyWithSoftmaxGradient(const size_t inputIndex, const GPUMatrix<ElemType>& gradient, const GPUMatrix<ElemType>& labels,
+                                                                             const GPUMatrix<ElemType>& logits, const GPUMatrix<ElemType>& logSumExp)
+{
+    CUDA_LONG N = (CUDA_LONG) GetNumElements();
+    if (N == 0)
+        return *this;
+
+    PrepareDevice();
+    int blocksPerGrid = (int) ceil(1.0 * N / GridDim::maxThreadsPerBlock);
+    SyncGuard syncGuard;
+    _addCrossEntropyWithSoftmaxGradient<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(GetArray(), inputIndex == 0, gradient.BufferPointer(), labels.BufferPointer(),
+                                                                                                              logits.BufferPointer(), logSumExp.BufferPointer(), (CUDA_LONG) GetNumRows(), N);
+    return *this;
+}
+
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignViterbiPathOf(const GPUMatrix<ElemType>& posScores, const GPUMatrix<ElemType>& pairScores, const GPUMatrix<ElemType>& sequences, const size_t numParallelSequences,
+                                                              const int startLabel, const int endLabel, GPUMatrix<ElemType>& alpha, GPUMatrix<ElemType>& backtrace)
+{
+    const size_t numLabels = posScores.GetNumRows();
+    const size_t numCols = posScores.GetNumCols();
+    Resize(numLabels, numCols);
+    SetValue((ElemType) 0);
+    alpha.Resize(numLabels, numCols);
+    backtrace.Resize(numLabels, numCols);
+    const size_t numSequences = sequences.GetNumCols();
+    if (numSequences == 0 || numLabels == 0)
+        return *this;
+
+    PrepareDevice();
+    // one block per sequence, its threads share the labels of each frame
+    int threadsPerBlock = (int) min(numLabels, (size_t) GridDim::maxThreadsPerBlock);
+    SyncGuard syncGuard;
+    _assignViterbiPath<ElemType><<<(int) numSequences, threadsPerBlock, 0, t_stream>>>(GetArray(), alpha.GetArray(), backtrace.GetArray(),
+                                                                                      posScores.BufferPointer(), pairScores.BufferPointer(), sequences.BufferPointer(),
+                                                                                      (CUDA_LONG) numParallelSequences, (CUDA_LONG) numLabels, startLabel, endLabel);
+    return *this;
+}
+
+// blocks along x per class bucket of the class-based products; they stride over the tiles of their bucket
+static const int c_classBasedBlocksPerBucket = 32;
+
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignClassBasedCrossEntropyWithSoftmaxOf(const GPUMatrix<ElemType>& labels, const GPUMatrix<ElemType>& input, const GPUMatrix<ElemType>& weight,
+                                                                                   const GPUMatrix<ElemType>& classLogSoftmax, const GPUMatrix<ElemType>& buckets, const GPUMatrix<ElemType>& frames,
+                                                                                   const size_t maxClassSize, GPUMatrix<ElemType>& softmax)
+{
+    softmax.Resize(maxClassSize, labels.GetNumCols());
+    Resize(1, 1);
+    SetValue((ElemType) 0);
+    const size_t numBuckets = buckets.GetNumCols();
+    const size_t numFrames = frames.GetNumCols();
+    if (numFrames == 0)
+        return *this;
+
+    PrepareDevice();
+    // the logits of all classes as one grouped product, then the softmax of each frame over the words of its class
+    SyncGuard syncGuard;
+    dim3 grid(c_classBasedBlocksPerBucket, (unsigned int) numBuckets);
+    dim3 block(CLASS_BASED_TILE_DIM, CLASS_BASED_TILE_DIM);
+    _classBasedLogits<ElemType><<<grid, block, 0, t_stream>>>(softmax.GetArray(), input.BufferPointer(), weight.BufferPointer(), buckets.BufferPointer(), frames.BufferPointer(),
+                                                              (CUDA_LONG) input.GetNumRows(), (CUDA_LONG) maxClassSize);
+    int blocksPerGrid = (int) min(numFrames, (size_t) 65535);
+    _classBasedSoftmax<ElemType><<<blocksPerGrid, 128, 0, t_stream>>>(GetArray(), softmax.GetArray(), labels.BufferPointer(), classLogSoftmax.BufferPointer(), frames.BufferPointer(),
+                                                                      (CUDA_LONG) numFrames, (CUDA_LONG) maxClassSize, (CUDA_LONG) classLogSoftmax.GetNumRows());
+    return *this;
+}
+
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AddClassBasedCrossEntropyWithSoftmaxGradient(const size_t inputIndex, const GPUMatrix<ElemType>& gradient, const GPUMatrix<ElemType>& labels,
+                                                                                      const GPUMatrix<ElemType>& input, const GPUMatrix<ElemType>& weight, const GPUMatrix<ElemType>& classLogSoftmax,
+                                                                                      const GPUMatrix<ElemType>& buckets, const GPUMatrix<ElemType>& frames, const GPUMatrix<ElemType>& softmax)
+{
+    const size_t numBuckets = buckets.GetNumCols();
+    const size_t numFrames = frames.GetNumCols();
+    if (numFrames == 0)
+        return *this;
+
+    PrepareDevice();
+    SyncGuard syncGuard;
+    dim3 grid(c_classBasedBlocksPerBucket, (unsigned int) numBuckets);
+    dim3 block(CLASS_BASED_TILE_DIM, CLASS_BASED_TILE_DIM);
+    const CUDA_LONG dim = (CUDA_LONG) input.GetNumRows();
+    const CUDA_LONG maxClassSize = (CUDA_LONG) softmax.GetNumRows();
+    if (inputIndex == 1)
+        _addClassBasedInputGradient<ElemType><<<grid, block, 0, t_stream>>>(GetArray(), gradient.BufferPointer(), labels.BufferPointer(), weight.BufferPointer(), softmax.BufferPointer(),
+                                                                            buckets.BufferPointer(), frames.BufferPointer(), dim, maxClassSize);
+    else if (inputIndex == 2)
+        _addClassBasedWeightGradient<ElemType><<<grid, block, 0, t_stream>>>(GetArray(), gradient.BufferPointer(), labels.BufferPointer(), input.BufferPointer(), softmax.BufferPointer(),
+                                                                             buckets.BufferPointer(), frames.BufferPointer(), dim, maxClassSize);
+    else
+    {
+        CUDA_LONG N = (CUDA_LONG)(classLogSoftmax.GetNumRows() * numFrames);
+        int blocksPerGrid = (int) ceil(1.0 * N / GridDim::maxThreadsPerBlock);
+        _addClassBasedClassGradient<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(GetArray(), gradient.BufferPointer(), labels.BufferPointer(), classLogSoftmax.BufferPointer(),
+                                                                                                          frames.BufferPointer(), (CUDA_LONG) classLogSoftmax.GetNumRows(), N);
+    }
+    return *this;
+}
+
 template <class ElemType>
 void GPUMatrix<ElemType>::AssignSoftmaxSum(const GPUMatrix<ElemType>& a, GPUMatrix<ElemType>& c)
 {
@@ -1892,6 +2403,38 @@ void GPUMatrix<ElemType>::AssignNCEUnnormalizedEval(const GPUMatrix<ElemType>& a
 DEF_ELEMWISE_INPLACE_FUNC(Tanh)
 DEF_ELEMWISE_ASSIGN_FUNC(Tanh)
 
+// softmax or log softmax of each column of 'a' into 'us', which may be the same matrix
+// The launch follows the column height: a warp per column for short columns, up to a block per column for tall ones,
+// and columns of large vocabularies are split over several blocks, whose partial (max, sum) pairs a second kernel merges.
+template <class ElemType>
+static void AssignColumnwiseSoftmax(const GPUMatrix<ElemType>& a, GPUMatrix<ElemType>& us, const bool isLog)
+{
+    const CUDA_LONG numRows = (CUDA_LONG) a.GetNumRows();
+    const CUDA_LONG numCols = (CUDA_LONG) a.GetNumCols();
+    const CUDA_LONG elementsPerThread = 16; // rows per thread before more threads share a column
+    const CUDA_LONG rowsPerBlock = 8192;    // rows per block of the split columns
+    const CUDA_LONG minRowsToSplit = 65536; // columns at least this tall are split over blocks
+    const CUDA_LONG maxColsToSplit = 65535; // the columns are the grid's y dimension then
+    SyncGuard syncGuard;
+    if (numRows >= minRowsToSplit && numCols <= maxColsToSplit)
+    {
+        const CUDA_LONG blocksPerColumn = (numRows + rowsPerBlock - 1) / rowsPerBlock;
+        GPUMatrix<ElemType> partials(blocksPerColumn, 2 * numCols, a.GetComputeDeviceId());
+        dim3 grid(blocksPerColumn, numCols);
+        _columnwiseSoftmaxPartials<ElemType><<<grid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(a.BufferPointer(), partials.BufferPointer(), numCols, numRows, rowsPerBlock);
+        _assignColumnwiseSoftmaxFromPartials<ElemType><<<grid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(a.BufferPointer(), us.BufferPointer(), partials.BufferPointer(), numCols, numRows, rowsPerBlock, isLog);
+    }
+    else
+    {
+        int threadsPerColumn = 32; // a warp
+        while (threadsPerColumn < GridDim::maxThreadsPerBlock && threadsPerColumn * elementsPerThread < numRows)
+            threadsPerColumn *= 2;
+        const CUDA_LONG columnsPerBlock = GridDim::maxThreadsPerBlock / threadsPerColumn;
+        const CUDA_LONG blocksPerGrid = (numCols + columnsPerBlock - 1) / columnsPerBlock;
+        _assignColumnwiseSoftmaxOf<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(a.BufferPointer(), us.BufferPointer(), numCols, numRows, threadsPerColumn, isLog);
+    }
+}
+
 template <class ElemType>
 GPUMatrix<ElemType>& GPUMatrix<ElemType>::InplaceLogSoftmax(const bool isColWise)
 {
@@ -1900,12 +2443,7 @@ GPUMatrix<ElemType>& GPUMatrix<ElemType>::InplaceLogSoftmax(const bool isColWise
 
     PrepareDevice();
     if (isColWise)
-    {
-        CUDA_LONG N = (CUDA_LONG) GetNumCols(); // one kernel per column
-        int blocksPerGrid = (int) ceil(N * 1.0 / GridDim::maxThreadsPerBlock);
-        SyncGuard syncGuard;
-        _logSoftMaxColWise<<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(m_pArray, (CUDA_LONG) m_numCols, (CUDA_LONG) m_numRows);
-    }
+        AssignColumnwiseSoftmax(*this, *this, true);
     else
     {
         CUDA_LONG N = (CUDA_LONG) GetNumRows(); // one kernel per column
@@ -1923,10 +2461,7 @@ GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignLogSoftmaxOf(const GPUMatrix<Ele
     if (isColWise)
     {
         PrepareDevice();
-        CUDA_LONG N = (CUDA_LONG) GetNumCols();
-        CUDA_LONG M = (CUDA_LONG) GetNumRows();
-        SyncGuard syncGuard;
-        _assignColumnwiseLogSoftmaxOf<<<N, 512, 0, t_stream>>>(a.m_pArray, m_pArray, N, M);
+        AssignColumnwiseSoftmax(a, *this, true);
     }
     else
     {
@@ -1936,6 +2471,52 @@ GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignLogSoftmaxOf(const GPUMatrix<Ele
     return *this;
 }
 
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::InplaceSoftmax(const bool isColWise)
+{
+    return AssignSoftmaxOf(*this, isColWise);
+}
+
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignSoftmaxOf(const GPUMatrix<ElemType>& a, const bool isColWise)
+{
+    if (a.IsEmpty())
+        LogicError("AssignSoftmaxOf: Matrix a is empty.");
+    if (!isColWise)
+        return AssignLogSoftmaxOf(a, isColWise).InplaceExp();
+
+    Resize(a.GetNumRows(), a.GetNumCols());
+    PrepareDevice();
+    AssignColumnwiseSoftmax(a, *this, false);
+    return *this;
+}
+
+// column-wise softmax of scale * a over the first numValidRows(0,j) rows of each column j; the other rows are 0
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignMaskedSoftmaxOf(const GPUMatrix<ElemType>& a, ElemType scale, const GPUMatrix<ElemType>& numValidRows)
+{
+    if (numValidRows.GetNumRows() != 1 || numValidRows.GetNumCols() != a.GetNumCols())
+        InvalidArgument("AssignMaskedSoftmaxOf: numValidRows must be a row vector with one entry per column.");
+
+    if (this != &a)
+        Resize(a.GetNumRows(), a.GetNumCols());
+    const CUDA_LONG numRows = (CUDA_LONG) a.GetNumRows();
+    const CUDA_LONG numCols = (CUDA_LONG) a.GetNumCols();
+    if (numRows * numCols == 0)
+        return *this;
+
+    const CUDA_LONG elementsPerThread = 16; // as in AssignColumnwiseSoftmax()
+    int threadsPerColumn = 32;
+    while (threadsPerColumn < GridDim::maxThreadsPerBlock && threadsPerColumn * elementsPerThread < numRows)
+        threadsPerColumn *= 2;
+    const CUDA_LONG columnsPerBlock = GridDim::maxThreadsPerBlock / threadsPerColumn;
+    const CUDA_LONG blocksPerGrid = (numCols + columnsPerBlock - 1) / columnsPerBlock;
+    PrepareDevice();
+    SyncGuard syncGuard;
+    _assignColumnwiseMaskedSoftmaxOf<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(a.m_pArray, m_pArray, numValidRows.m_pArray, scale, numCols, numRows, threadsPerColumn);
+    return *this;
+}
+
 template <class ElemType>
 GPUMatrix<ElemType>& GPUMatrix<ElemType>::InplaceHardmax(const bool isColWise)
 {
@@ -2076,6 +2657,7 @@ GPUMatrix<ElemType>& GPUMatrix<ElemType>::SetToZeroIfAbsLessThan(const ElemType
 template <class ElemType>
 ElemType GPUMatrix<ElemType>::SumOfAbsElements() const
 {
+    GPUMathOptions::NoteImplicitDeviceSync("GPUMatrix::SumOfAbsElements");
     if (IsEmpty())
         LogicError("SumOfAbsElements: Matrix is empty");
 
@@ -2097,6 +2679,7 @@ ElemType GPUMatrix<ElemType>::SumOfAbsElements() const
 template <class ElemType>
 ElemType GPUMatrix<ElemType>::SumOfElements() const
 {
+    GPUMathOptions::NoteImplicitDeviceSync("GPUMatrix::SumOfElements");
     if (IsEmpty())
         LogicError("SumOfElements: Matrix is empty");
 
@@ -2121,7 +2704,7 @@ GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignSumOfElements(const GPUMatrix<El
     PrepareDevice();
     SyncGuard syncGuard;
     // WARNING: THIS kernel is not the most efficient way!
-    _reductionSumAndAssign<ElemType><<<1, 1024>>>(m_pArray, a.m_pArray, (CUDA_LONG) a.GetNumElements(), (CUDA_LONG) GetNumElements());
+    _reductionSumAndAssign<ElemType><<<1, 1024, 0, t_stream>>>(m_pArray, a.m_pArray, (CUDA_LONG) a.GetNumElements(), (CUDA_LONG) GetNumElements());
     return (*this);
 }
 
@@ -2142,6 +2725,7 @@ DeviceBoundNumber<ElemType> GPUMatrix<ElemType>::Sum_AsDeviceBoundNum() const
 template <class ElemType>
 ElemType GPUMatrix<ElemType>::Max() const
 {
+    GPUMathOptions::NoteImplicitDeviceSync("GPUMatrix::Max");
     cublasHandle_t cuHandle = GetCublasHandle(GetComputeDeviceId());
     ElemType res;
     if (sizeof(ElemType) == sizeof(float))
@@ -2428,6 +3012,7 @@ GPUMatrix<ElemType>& GPUMatrix<ElemType>::AddWithScaleOf(ElemType alpha, const G
 template <class ElemType>
 ElemType GPUMatrix<ElemType>::FrobeniusNorm() const
 {
+    GPUMathOptions::NoteImplicitDeviceSync("GPUMatrix::FrobeniusNorm");
     if (IsEmpty())
         LogicError("FrobeniusNorm: Matrix is empty.");
 
@@ -2460,6 +3045,7 @@ GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignFrobeniusNormOf(const GPUMatrix<
 template <class ElemType>
 ElemType GPUMatrix<ElemType>::MatrixNormInf() const
 {
+    GPUMathOptions::NoteImplicitDeviceSync("GPUMatrix::MatrixNormInf");
     if (IsEmpty())
         LogicError("MatrixNorm1: Matrix is empty.");
 
@@ -2484,6 +3070,7 @@ ElemType GPUMatrix<ElemType>::MatrixNorm1() const
 template <class ElemType>
 ElemType GPUMatrix<ElemType>::MatrixNorm0() const
 {
+    GPUMathOptions::NoteImplicitDeviceSync("GPUMatrix::MatrixNorm0");
     if (IsEmpty())
         LogicError("MatrixNorm0: Matrix is empty.");
 
@@ -2496,6 +3083,73 @@ ElemType GPUMatrix<ElemType>::MatrixNorm0() const
     return h_nz;
 }
 
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignMatrixNormInfOf(const GPUMatrix<ElemType>& a)
+{
+    if (a.IsEmpty())
+        LogicError("AssignMatrixNormInfOf: Matrix a is empty.");
+    if (this == &a)
+        LogicError("AssignMatrixNormInfOf: The result cannot be the input.");
+
+    Resize(1, 1);
+
+    PrepareDevice();
+    // WARNING: THIS kernel is not the most efficient way!
+    _reductionMatrixNormInf<ElemType><<<1, 1024, 0, t_stream>>>(a.m_pArray, m_pArray, (CUDA_LONG) a.GetNumElements());
+
+    return *this;
+}
+
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignMatrixNorm1Of(const GPUMatrix<ElemType>& a)
+{
+    if (a.IsEmpty())
+        LogicError("AssignMatrixNorm1Of: Matrix a is empty.");
+    if (this == &a)
+        LogicError("AssignMatrixNorm1Of: The result cannot be the input.");
+
+    Resize(1, 1);
+
+    // asum with the result in device memory, like Scale() with a device alpha
+    cublasHandle_t cuHandle = GetCublasHandle(a.GetComputeDeviceId());
+    cublasSetPointerMode(cuHandle, CUBLAS_POINTER_MODE_DEVICE);
+    if (sizeof(ElemType) == sizeof(float))
+    {
+        CUBLAS_CALL(cublasSasum(cuHandle, (CUDA_LONG) a.GetNumElements(), reinterpret_cast<float*>(a.m_pArray), 1, reinterpret_cast<float*>(m_pArray)));
+    }
+    else
+    {
+        CUBLAS_CALL(cublasDasum(cuHandle, (CUDA_LONG) a.GetNumElements(), reinterpret_cast<double*>(a.m_pArray), 1, reinterpret_cast<double*>(m_pArray)));
+    }
+    cublasSetPointerMode(cuHandle, CUBLAS_POINTER_MODE_HOST);
+
+    return *this;
+}
+
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignIsEqualTo(const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b, const ElemType threshold /*= 1e-8*/)
+{
+    if (a.IsEmpty() || b.IsEmpty())
+        LogicError("AssignIsEqualTo: one of the input matrices is empty.");
+    if (this == &a || this == &b)
+        LogicError("AssignIsEqualTo: The result cannot be an input.");
+
+    Resize(1, 1);
+
+    PrepareDevice();
+    if (a.GetNumRows() != b.GetNumRows() || a.GetNumCols() != b.GetNumCols())
+    {
+        CUDA_CALL(cudaMemsetAsync(m_pArray, 0, sizeof(ElemType), t_stream));
+        return *this;
+    }
+    _setValue<ElemType><<<1, 1, 0, t_stream>>>(m_pArray, (ElemType) 1, 1);
+    CUDA_LONG N = (CUDA_LONG) a.GetNumElements();
+    int blocksPerGrid = (int) ceil(1.0 * N / GridDim::maxThreadsPerBlock);
+    _areEqual<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(a.m_pArray, b.m_pArray, N, threshold, m_pArray);
+
+    return *this;
+}
+
 template <class ElemType>
 GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignSignOf(const GPUMatrix<ElemType>& a)
 {
@@ -2715,6 +3369,27 @@ GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignNumOfDiff(const GPUMatrix<ElemTy
     return *this;
 }
 
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignNumOfTopKErrorsOf(const GPUMatrix<ElemType>& labels, const GPUMatrix<ElemType>& predictions, const size_t topK)
+{
+    Resize(1, 1);
+    SetValue(0);
+    const CUDA_LONG numRows = (CUDA_LONG) predictions.GetNumRows();
+    const CUDA_LONG numCols = (CUDA_LONG) predictions.GetNumCols();
+    if (numCols == 0)
+        return *this;
+
+    PrepareDevice();
+    // a block per column, with no more threads than rows
+    int threadsPerBlock = 32;
+    while (threadsPerBlock < numRows && threadsPerBlock < GridDim::maxThreadsPerBlock)
+        threadsPerBlock *= 2;
+    SyncGuard syncGuard;
+    _assignNumOfTopKErrors<ElemType><<<(int) min(numCols, (CUDA_LONG) 65535), threadsPerBlock, 0, t_stream>>>(GetArray(), labels.BufferPointer(), predictions.BufferPointer(),
+                                                                                                             numRows, numCols, (CUDA_LONG) topK);
+    return *this;
+}
+
 #pragma endregion Member BLAS Functions
 
 #pragma region Other helper functions
@@ -2795,6 +3470,80 @@ GPUMatrix<ElemType>& GPUMatrix<ElemType>::UnpackConvolutionInput(GPUMatrix<ElemT
     return inputSubBatch;
 }
 
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignGroupedConvolutionResult(const GPUMatrix<ElemType>& inputBatch, const GPUMatrix<ElemType>& filter,
+                                                                         const size_t inputWidth, const size_t inputHeight, const size_t inputChannels,
+                                                                         const size_t outputWidth, const size_t outputHeight, const size_t outputChannels,
+                                                                         const size_t kernelWidth, const size_t kernelHeight, const size_t horizontalSubsample, const size_t verticalSubsample,
+                                                                         const bool zeroPadding, const size_t groups)
+{
+    const size_t batchSize = inputBatch.GetNumCols();
+    Resize(outputWidth * outputHeight * outputChannels, batchSize);
+    if (IsEmpty())
+        return *this;
+
+    int numThreadPerBlock = GridDim::maxThreadsPerBlock;
+    int blocksPerGrid = (int) ((GetNumElements() + numThreadPerBlock - 1) / numThreadPerBlock);
+
+    PrepareDevice();
+    SyncGuard syncGuard;
+    _assignGroupedConvolutionResult<<<blocksPerGrid, numThreadPerBlock, 0, t_stream>>>(m_pArray, inputBatch.m_pArray, filter.m_pArray, (CUDA_LONG) batchSize,
+                                                                                       inputWidth, inputHeight, inputChannels,
+                                                                                       outputWidth, outputHeight, outputChannels,
+                                                                                       kernelWidth, kernelHeight, horizontalSubsample, verticalSubsample,
+                                                                                       zeroPadding ? kernelWidth / 2 : 0, zeroPadding ? kernelHeight / 2 : 0,
+                                                                                       inputChannels / groups, outputChannels / groups);
+
+    return *this;
+}
+
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AddGroupedConvolutionGradientOfInput(const GPUMatrix<ElemType>& outputGradientBatch, const GPUMatrix<ElemType>& filter,
+                                                                               const size_t inputWidth, const size_t inputHeight, const size_t inputChannels,
+                                                                               const size_t outputWidth, const size_t outputHeight, const size_t outputChannels,
+                                                                               const size_t kernelWidth, const size_t kernelHeight, const size_t horizontalSubsample, const size_t verticalSubsample,
+                                                                               const bool zeroPadding, const size_t groups)
+{
+    if (IsEmpty())
+        return *this;
+
+    int numThreadPerBlock = GridDim::maxThreadsPerBlock;
+    int blocksPerGrid = (int) ((GetNumElements() + numThreadPerBlock - 1) / numThreadPerBlock);
+
+    PrepareDevice();
+    SyncGuard syncGuard;
+    _addGroupedConvolutionGradientOfInput<<<blocksPerGrid, numThreadPerBlock, 0, t_stream>>>(m_pArray, outputGradientBatch.m_pArray, filter.m_pArray, (CUDA_LONG) GetNumCols(),
+                                                                                             inputWidth, inputHeight, inputChannels,
+                                                                                             outputWidth, outputHeight, outputChannels,
+                                                                                             kernelWidth, kernelHeight, horizontalSubsample, verticalSubsample,
+                                                                                             zeroPadding ? kernelWidth / 2 : 0, zeroPadding ? kernelHeight / 2 : 0,
+                                                                                             inputChannels / groups, outputChannels / groups);
+
+    return *this;
+}
+
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AddGroupedConvolutionGradientOfFilter(const GPUMatrix<ElemType>& outputGradientBatch, const GPUMatrix<ElemType>& inputBatch,
+                                                                                const size_t inputWidth, const size_t inputHeight, const size_t inputChannels,
+                                                                                const size_t outputWidth, const size_t outputHeight, const size_t outputChannels,
+                                                                                const size_t kernelWidth, const size_t kernelHeight, const size_t horizontalSubsample, const size_t verticalSubsample,
+                                                                                const bool zeroPadding, const size_t groups)
+{
+    if (IsEmpty())
+        return *this;
+
+    PrepareDevice();
+    SyncGuard syncGuard;
+    _addGroupedConvolutionGradientOfFilter<<<(int) GetNumElements(), GridDim::maxThreadsPerBlock, 0, t_stream>>>(m_pArray, outputGradientBatch.m_pArray, inputBatch.m_pArray, (CUDA_LONG) inputBatch.GetNumCols(),
+                                                                                                                 inputWidth, inputHeight, inputChannels,
+                                                                                                                 outputWidth, outputHeight, outputChannels,
+                                                                                                                 kernelWidth, kernelHeight, horizontalSubsample, verticalSubsample,
+                                                                                                                 zeroPadding ? kernelWidth / 2 : 0, zeroPadding ? kernelHeight / 2 : 0,
+                                                                                                                 inputChannels / groups, outputChannels / groups);
+
+    return *this;
+}
+
 template <class ElemType>
 GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignMaxPoolingResult(const GPUMatrix<ElemType>& inputBatch, const size_t channels,
                                                                  const size_t inputWidth, const size_t inputHeight, const size_t inputSizePerSample,
@@ -2896,12 +3645,58 @@ GPUMatrix<ElemType>& GPUMatrix<ElemType>::AddAveragePoolingGradient(const GPUMat
 // float/double overloads of cublasSgemm()/cublasDgemm()
 static cublasStatus_t cublas_gemm(cublasHandle_t handle, cublasOperation_t transa, cublasOperation_t transb, int m, int n, int k, const float* alpha, const float* A, int lda, const float* B, int ldb, const float* beta, float* C, int ldc)
 {
+#if CUDART_VERSION >= 9000
+    if (GPUMathOptions::UseHalfPrecisionGemm())
+    {
+#if CUDART_VERSION >= 11000
+        // CUDA 11 selects the rounding of A and B to fp16 by the compute type; the tensor-op math mode is deprecated
+        return cublasGemmEx(handle, transa, transb, m, n, k, alpha, A, CUDA_R_32F, lda, B, CUDA_R_32F, ldb, beta, C, CUDA_R_32F, ldc,
+                            CUBLAS_COMPUTE_32F_FAST_16F, CUBLAS_GEMM_DEFAULT);
+#else
+        // tensor-op math allows cuBLAS to round A and B to fp16 and use tensor cores; accumulation and C stay fp32
+        CUBLAS_CALL(cublasSetMathMode(handle, CUBLAS_TENSOR_OP_MATH));
+        cublasStatus_t status = cublasGemmEx(handle, transa, transb, m, n, k, alpha, A, CUDA_R_32F, lda, B, CUDA_R_32F, ldb, beta, C, CUDA_R_32F, ldc,
+                                             CUDA_R_32F, CUBLAS_GEMM_DEFAULT_TENSOR_OP);
+        CUBLAS_CALL(cublasSetMathMode(handle, CUBLAS_DEFAULT_MATH));
+        return status;
+#endif
+    }
+#endif
     return cublasSgemm(handle, transa, transb, m, n, k, alpha, A, lda, B, ldb, beta, C, ldc);
 }
 static cublasStatus_t cublas_gemm(cublasHandle_t handle, cublasOperation_t transa, cublasOperation_t transb, int m, int n, int k, const double* alpha, const double* A, int lda, const double* B, int ldb, const double* beta, double* C, int ldc)
 {
     return cublasDgemm(handle, transa, transb, m, n, k, alpha, A, lda, B, ldb, beta, C, ldc);
 }
+#if CUDART_VERSION >= 8000
+// float/double overloads of cublasSgemmStridedBatched()/cublasDgemmStridedBatched()
+static cublasStatus_t cublas_gemmStridedBatched(cublasHandle_t handle, cublasOperation_t transa, cublasOperation_t transb, int m, int n, int k, const float* alpha,
+                                                const float* A, int lda, long long strideA, const float* B, int ldb, long long strideB, const float* beta, float* C, int ldc, long long strideC, int batchCount)
+{
+#if CUDART_VERSION >= 9000
+    if (GPUMathOptions::UseHalfPrecisionGemm())
+    {
+        // same as cublas_gemm(): fp16 products on tensor cores, fp32 accumulation
+#if CUDART_VERSION >= 11000
+        return cublasGemmStridedBatchedEx(handle, transa, transb, m, n, k, alpha, A, CUDA_R_32F, lda, strideA, B, CUDA_R_32F, ldb, strideB, beta, C, CUDA_R_32F, ldc, strideC,
+                                          batchCount, CUBLAS_COMPUTE_32F_FAST_16F, CUBLAS_GEMM_DEFAULT);
+#else
+        CUBLAS_CALL(cublasSetMathMode(handle, CUBLAS_TENSOR_OP_MATH));
+        cublasStatus_t status = cublasGemmStridedBatchedEx(handle, transa, transb, m, n, k, alpha, A, CUDA_R_32F, lda, strideA, B, CUDA_R_32F, ldb, strideB, beta, C, CUDA_R_32F, ldc, strideC,
+                                                           batchCount, CUDA_R_32F, CUBLAS_GEMM_DEFAULT_TENSOR_OP);
+        CUBLAS_CALL(cublasSetMathMode(handle, CUBLAS_DEFAULT_MATH));
+        return status;
+#endif
+    }
+#endif
+    return cublasSgemmStridedBatched(handle, transa, transb, m, n, k, alpha, A, lda, strideA, B, ldb, strideB, beta, C, ldc, strideC, batchCount);
+}
+static cublasStatus_t cublas_gemmStridedBatched(cublasHandle_t handle, cublasOperation_t transa, cublasOperation_t transb, int m, int n, int k, const double* alpha,
+                                                const double* A, int lda, long long strideA, const double* B, int ldb, long long strideB, const double* beta, double* C, int ldc, long long strideC, int batchCount)
+{
+    return cublasDgemmStridedBatched(handle, transa, transb, m, n, k, alpha, A, lda, strideA, B, ldb, strideB, beta, C, ldc, strideC, batchCount);
+}
+#endif
 static cublasStatus_t cublas_axpy(cublasHandle_t handle, int n, const float* alpha, const float* x, int incx, float* y, int incy)
 {
     return cublasSaxpy(handle, n, alpha, x, incx, y, incy);
@@ -2941,6 +3736,49 @@ void GPUMatrix<ElemType>::MultiplyAndWeightedAdd(ElemType alpha, const GPUMatrix
     c.m_numCols = n;
 }
 
+// batch of products of the same shape: c[i] = alpha * op(a[i]) * op(b[i]) + beta * c[i], where each matrix holds its numBatches matrices side by side
+template <class ElemType>
+void GPUMatrix<ElemType>::BatchedMultiplyAndWeightedAdd(ElemType alpha, const GPUMatrix<ElemType>& a, const bool transposeA, const GPUMatrix<ElemType>& b, const bool transposeB,
+                                                        ElemType beta, GPUMatrix<ElemType>& c, size_t numBatches)
+{
+    a.PrepareDevice();
+    if ((a.GetComputeDeviceId() != b.GetComputeDeviceId()) || (b.GetComputeDeviceId() != c.GetComputeDeviceId())) // different GPUs
+        InvalidArgument("All matrices must be on the same GPU");
+    if (numBatches == 0 || a.m_numCols % numBatches != 0 || b.m_numCols % numBatches != 0)
+        InvalidArgument("BatchedMultiplyAndWeightedAdd: The number of columns of a and b must be multiples of the number of batches.");
+
+    cublasHandle_t cuHandle = GetCublasHandle(b.GetComputeDeviceId());
+    cublasOperation_t transA = transposeA ? CUBLAS_OP_T : CUBLAS_OP_N;
+    cublasOperation_t transB = transposeB ? CUBLAS_OP_T : CUBLAS_OP_N;
+    size_t aCols = a.m_numCols / numBatches;
+    size_t bCols = b.m_numCols / numBatches;
+    int m = int(transposeA ? aCols : a.m_numRows);
+    int n = int(transposeB ? b.m_numRows : bCols);
+    int k = int(transposeA ? a.m_numRows : aCols);
+    int l = int(transposeB ? bCols : b.m_numRows);
+
+    if (beta == 0)
+        c.Resize(m, n * numBatches);
+    else
+        c.VerifySize(m, n * numBatches); // Can't resize if beta != 0
+
+    if (!(m > 0 && k > 0 && l > 0 && n > 0))
+        RuntimeError("!(m>0 && k>0 && l>0 && n>0)"); // converting from size_t to int may cause overflow
+    if (k != l)
+        RuntimeError("matrix dim mismatch in BatchedMultiplyAndWeightedAdd");
+    long long strideA = (long long) a.m_numRows * aCols;
+    long long strideB = (long long) b.m_numRows * bCols;
+    long long strideC = (long long) m * n;
+#if CUDART_VERSION >= 8000
+    CUBLAS_CALL(cublas_gemmStridedBatched(cuHandle, transA, transB, m, n, k, &alpha, a.m_pArray, (int) a.m_numRows, strideA, b.m_pArray, (int) b.m_numRows, strideB,
+                                          &beta, c.m_pArray, (int) c.m_numRows, strideC, (int) numBatches));
+#else
+    for (size_t i = 0; i < numBatches; i++)
+        CUBLAS_CALL(cublas_gemm(cuHandle, transA, transB, m, n, k, &alpha, a.m_pArray + i * strideA, (int) a.m_numRows, b.m_pArray + i * strideB, (int) b.m_numRows,
+                                &beta, c.m_pArray + i * strideC, (int) c.m_numRows));
+#endif
+}
+
 template <class ElemType>
 void GPUMatrix<ElemType>::Multiply1x1AndWeightedAdd(ElemType alpha, const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b, ElemType beta, GPUMatrix<ElemType>& c)
 {
@@ -3427,6 +4265,7 @@ void GPUMatrix<ElemType>::InnerProduct(const GPUMatrix<ElemType>& a, const GPUMa
 template <class ElemType>
 ElemType GPUMatrix<ElemType>::InnerProductOfMatrices(const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b)
 {
+    GPUMathOptions::NoteImplicitDeviceSync("GPUMatrix::InnerProductOfMatrices");
     if (a.IsEmpty() || b.IsEmpty())
         LogicError("InnerProductOfMatrices:  one of the input matrices is empty.");
 
@@ -3514,6 +4353,7 @@ void GPUMatrix<ElemType>::ElementWisePower(ElemType alpha, const GPUMatrix<ElemT
 template <class ElemType>
 bool GPUMatrix<ElemType>::AreEqual(const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b, const ElemType threshold /*= 1e-8*/)
 {
+    GPUMathOptions::NoteImplicitDeviceSync("GPUMatrix::AreEqual");
     if (a.IsEmpty() || b.IsEmpty())
         LogicError("AreEqual: one of the input matrices is empty.");
 
@@ -3553,6 +4393,7 @@ void GPUMatrix<ElemType>::TensorShuffleScaleAndAdd(ElemType keepWeight, const GP
 template <class ElemType>
 bool GPUMatrix<ElemType>::HasElement(const GPUMatrix<ElemType>& a, const ElemType v)
 {
+    GPUMathOptions::NoteImplicitDeviceSync("GPUMatrix::HasElement");
     if (a.IsEmpty())
         LogicError("HasElement: the input matrix is empty.");
 
@@ -3753,6 +4594,85 @@ void GPUMatrix<ElemType>::InnerProductWithShiftNeg(const GPUMatrix<ElemType>& a,
     }
 }
 
+// this(m,j) = cos(a(:,j), b(:,s)) with s = j in row 0 and s = (j + shift + m - 1) % n below, and the inverse column norms of a and b
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignCosDistanceWithShiftNegOf(const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b, size_t shift, size_t negNumber,
+                                                                          GPUMatrix<ElemType>& invNormA, GPUMatrix<ElemType>& invNormB)
+{
+    if (a.GetNumRows() != b.GetNumRows() || a.GetNumCols() != b.GetNumCols())
+        InvalidArgument("AssignCosDistanceWithShiftNegOf: Matrices a and b should have the same dimensions.");
+
+    const CUDA_LONG numRows = (CUDA_LONG) a.GetNumRows();
+    const CUDA_LONG numCols = (CUDA_LONG) a.GetNumCols();
+    Resize(negNumber + 1, numCols);
+    invNormA.Resize(1, numCols);
+    invNormB.Resize(1, numCols);
+    if (numRows * numCols == 0)
+        return *this;
+
+    const CUDA_LONG elementsPerThread = 16; // as in AssignColumnwiseSoftmax()
+    int threadsPerColumn = 32;
+    while (threadsPerColumn < GridDim::maxThreadsPerBlock && threadsPerColumn * elementsPerThread < numRows)
+        threadsPerColumn *= 2;
+    const CUDA_LONG columnsPerBlock = GridDim::maxThreadsPerBlock / threadsPerColumn;
+    const CUDA_LONG blocksPerGrid = (numCols + columnsPerBlock - 1) / columnsPerBlock;
+    PrepareDevice();
+    SyncGuard syncGuard;
+    _assignCosDistanceWithShiftNegOf<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(m_pArray, invNormA.m_pArray, invNormB.m_pArray, a.m_pArray, b.m_pArray,
+                                                                                                            numRows, numCols, (CUDA_LONG) shift, (CUDA_LONG) negNumber + 1, threadsPerColumn);
+    return *this;
+}
+
+// this += the gradient of value = AssignCosDistanceWithShiftNegOf(a, b, shift, ...) w.r.t. a, or w.r.t. b if rightInput
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AddCosDistanceWithShiftNegGradientOf(const GPUMatrix<ElemType>& gradient, const GPUMatrix<ElemType>& value,
+                                                                               const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b,
+                                                                               const GPUMatrix<ElemType>& invNormA, const GPUMatrix<ElemType>& invNormB, size_t shift, bool rightInput)
+{
+    const CUDA_LONG numRows = (CUDA_LONG) a.GetNumRows();
+    const CUDA_LONG numCols = (CUDA_LONG) a.GetNumCols();
+    const CUDA_LONG numPairs = (CUDA_LONG) value.GetNumRows();
+    if (GetNumRows() != numRows || GetNumCols() != numCols || gradient.GetNumRows() != numPairs || gradient.GetNumCols() != numCols)
+        InvalidArgument("AddCosDistanceWithShiftNegGradientOf: The dimensions of the gradient, the value, and the target do not match.");
+
+    CUDA_LONG N = numRows * numCols;
+    if (N == 0)
+        return *this;
+    int blocksPerGrid = (int) ceil(1.0 * N / GridDim::maxThreadsPerBlock);
+    PrepareDevice();
+    SyncGuard syncGuard;
+    _addCosDistanceWithShiftNegGradientOf<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(m_pArray, gradient.m_pArray, value.m_pArray, a.m_pArray, b.m_pArray,
+                                                                                                                 invNormA.m_pArray, invNormB.m_pArray, numRows, numCols, (CUDA_LONG) shift, numPairs, rightInput);
+    return *this;
+}
+
+// this(:,j) = the crop of the staged image j, scaled to width x height, flipped if requested and minus the mean;
+// see CPUMatrix::AssignAugmentedImagesOf() for the layout of the staged images
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignAugmentedImagesOf(const GPUMatrix<ElemType>& staged, const GPUMatrix<ElemType>& mean, size_t stagingWidth, size_t stagingHeight,
+                                                                  size_t channels, size_t width, size_t height, bool transposeToCHW)
+{
+    const size_t stagingSize = stagingWidth * stagingHeight * channels;
+    const size_t outputSize = width * height * channels;
+    if (staged.GetNumRows() != stagingSize + 5)
+        InvalidArgument("AssignAugmentedImagesOf: The staged images have %d rows, %d expected.", (int) staged.GetNumRows(), (int) stagingSize + 5);
+    if (!mean.IsEmpty() && mean.GetNumElements() != outputSize)
+        InvalidArgument("AssignAugmentedImagesOf: The mean has %d elements, %d expected.", (int) mean.GetNumElements(), (int) outputSize);
+
+    const CUDA_LONG numCols = (CUDA_LONG) staged.GetNumCols();
+    Resize(outputSize, numCols);
+    CUDA_LONG N = (CUDA_LONG) outputSize * numCols;
+    if (N == 0)
+        return *this;
+    int blocksPerGrid = (int) ceil(1.0 * N / GridDim::maxThreadsPerBlock);
+    PrepareDevice();
+    SyncGuard syncGuard;
+    _assignAugmentedImagesOf<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(m_pArray, staged.m_pArray, mean.IsEmpty() ? nullptr : mean.m_pArray,
+                                                                                                     (CUDA_LONG) stagingWidth, (CUDA_LONG) stagingHeight, (CUDA_LONG) channels,
+                                                                                                     (CUDA_LONG) width, (CUDA_LONG) height, numCols, transposeToCHW);
+    return *this;
+}
+
 template <class ElemType>
 GPUMatrix<ElemType>& GPUMatrix<ElemType>::GetARowByIndex(const GPUMatrix<ElemType>& a, const size_t m)
 {
@@ -3868,6 +4788,7 @@ GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignSequenceError(const ElemType hsm
 template <class ElemType>
 ElemType GPUMatrix<ElemType>::LogAddSumOfElements() const
 {
+    GPUMathOptions::NoteImplicitDeviceSync("GPUMatrix::LogAddSumOfElements");
     if (this->IsEmpty())
         LogicError("SumOfElements: Matrix is empty");
 
@@ -3961,6 +4882,44 @@ void GPUMatrix<ElemType>::RCRFTransGrdCompute(const GPUMatrix<ElemType>& lbls,
     TracingGPUMemoryAllocator::Free<ElemType>(alpha.GetComputeDeviceId(), d_zeta);
 };
 
+// CTC forward-backward, see Matrix::AssignCTCPosteriors(). Each sequence is one thread block.
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignCTCPosteriors(const GPUMatrix<ElemType>& logProbs, const GPUMatrix<ElemType>& stateLabels, const GPUMatrix<ElemType>& sequences,
+                                                              size_t numParallelSequences, GPUMatrix<ElemType>& alpha, GPUMatrix<ElemType>& beta, GPUMatrix<ElemType>& logLikelihoods)
+{
+    const size_t numLabels = logProbs.GetNumRows();
+    const size_t numSequences = sequences.GetNumCols();
+    const size_t maxStates = stateLabels.GetNumRows();
+    if (numParallelSequences == 0 || logProbs.GetNumCols() % numParallelSequences != 0 || sequences.GetNumRows() != 4 || stateLabels.GetNumCols() != numSequences)
+        InvalidArgument("AssignCTCPosteriors: The dimensions of the inputs do not match.");
+    const size_t numTimeSteps = logProbs.GetNumCols() / numParallelSequences;
+
+    // the sequence table is tiny; check it on the host so that the kernel can trust it
+    std::unique_ptr<ElemType[]> seq(sequences.CopyToArray());
+    for (size_t n = 0; n < numSequences; n++)
+    {
+        const size_t s = (size_t) seq[4 * n], tBegin = (size_t) seq[4 * n + 1], numFrames = (size_t) seq[4 * n + 2], numStates = (size_t) seq[4 * n + 3];
+        if (s >= numParallelSequences || tBegin + numFrames > numTimeSteps || numFrames == 0 || numStates == 0 || numStates > maxStates)
+            InvalidArgument("AssignCTCPosteriors: Sequence %d is out of bounds.", (int) n);
+    }
+
+    Resize(numLabels, logProbs.GetNumCols());
+    SetValue(0);
+    alpha.Resize(maxStates, numSequences * numTimeSteps);
+    beta.Resize(maxStates, numSequences * numTimeSteps);
+    logLikelihoods.Resize(1, numSequences);
+    if (numSequences == 0)
+        return *this;
+
+    PrepareDevice();
+    int threadsPerBlock = (int) min((size_t) GridDim::maxThreadsPerBlock, (maxStates + 31) / 32 * 32);
+    SyncGuard syncGuard;
+    _assignCTCPosteriors<ElemType><<<(int) numSequences, threadsPerBlock, 0, t_stream>>>(m_pArray, logProbs.m_pArray, stateLabels.m_pArray, sequences.m_pArray,
+                                                                                           alpha.m_pArray, beta.m_pArray, logLikelihoods.m_pArray,
+                                                                                           (CUDA_LONG) numLabels, (CUDA_LONG) numParallelSequences, (CUDA_LONG) numTimeSteps, (CUDA_LONG) maxStates);
+    return *this;
+}
+
 // -----------------------------------------------------------------------
 // TensorView entry points from Matrix.cpp
 // -----------------------------------------------------------------------
@@ -4033,6 +4992,11 @@ void GPUMatrix<ElemType>::TensorOp(ElemType beta, const GPUMatrix<ElemType>& a,
         return;
     }
 
+    // special case: input and output have different stride-1 dimensions (a transpose, e.g. TransposeDimensionsNode)
+    // The regular kernel would read or write with a large stride; this goes through shared-memory tiles instead.
+    else if (reducingOpDims.size() == 0 && CanLaunchTiledTensorOp(regularOpDims, regularStrides))
+        return LaunchTiledTensorOp<ElemType>(beta, a.m_pArray + offsets[0], m_pArray + offsets[1], alpha, op, regularOpDims, regularStrides);
+
     // TODO: Add a special case for tensor bias reduction. cudnn is ~7% faster on Image/QuickE2E.
 
     // regular case
@@ -4067,6 +5031,18 @@ void GPUMatrix<ElemType>::TensorOp(ElemType beta, const GPUMatrix<ElemType>& a,
     return TensorOpN<ElemType, 4>(beta, array<ElemType*, 4>{a.m_pArray, b.m_pArray, c.m_pArray, m_pArray}, alpha, op, offsets, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
 }
 
+// perform a fused sequence of elementwise ops ('program') on a, b, c, and d giving 'this', in a single kernel launch
+template <class ElemType>
+void GPUMatrix<ElemType>::TensorOp(ElemType beta, const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b, const GPUMatrix<ElemType>& c, const GPUMatrix<ElemType>& d, ElemType alpha, const ElementWiseProgram& program,
+                                   const array<size_t, 5>& offsets,
+                                   const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, 5>& regularStrides)
+{
+    a.PrepareDevice();
+    if (a.GetComputeDeviceId() != GetComputeDeviceId() || b.GetComputeDeviceId() != GetComputeDeviceId() || c.GetComputeDeviceId() != GetComputeDeviceId() || d.GetComputeDeviceId() != GetComputeDeviceId())
+        InvalidArgument("All matrices must be on the same GPU");
+    return ElementWiseProgramOpN<ElemType>(beta, array<ElemType*, 5>{a.m_pArray, b.m_pArray, c.m_pArray, d.m_pArray, m_pArray}, alpha, program, offsets, regularOpDims, regularStrides);
+}
+
 // =======================================================================
 // explicit instantiations business
 // =======================================================================
@@ -87,6 +87,7 @@ public:
 // -----------------------------------------------------------------------
 
 void PrepareDevice(DEVICEID_TYPE deviceId);
+void CopyBetweenDevicesAsync(void* dst, DEVICEID_TYPE dstDevice, const void* src, DEVICEID_TYPE srcDevice, size_t numBytes);
 
 template <class ElemType>
 class MATH_API GPUMatrix : public BaseMatrix<ElemType>
@@ -163,6 +164,9 @@ public:
 
     void CopyColumnsStrided(const GPUMatrix<ElemType>& fromMatrix, size_t numCols, size_t srcNumColsStride, size_t destNumColsStride);
 
+    GPUMatrix<ElemType>& DoGatherColumnsOf(ElemType beta, const GPUMatrix<ElemType>& idx, const GPUMatrix<ElemType>& a, ElemType alpha);
+    GPUMatrix<ElemType>& DoScatterColumnsOf(ElemType beta, const GPUMatrix<ElemType>& idx, const GPUMatrix<ElemType>& a, ElemType alpha);
+
     GPUMatrix<ElemType> Diagonal() const;
 
     size_t BufferSize() const
@@ -176,6 +180,9 @@ public:
 
     ElemType Adagrad(GPUMatrix<ElemType>& gradients, const bool needAveMultiplier);
     void FSAdagrad(GPUMatrix<ElemType>& gradients, GPUMatrix<ElemType>& functionValues, ElemType learnRatePerSample, ElemType momentum, ElemType adaWeight, ElemType adaMul);
+    void Adam(GPUMatrix<ElemType>& gradients, GPUMatrix<ElemType>* functionValues, ElemType learnRate, ElemType beta1, ElemType beta2, ElemType epsilon, ElemType biasCorrection);
+    static void FusedSGDUpdate(DEVICEID_TYPE deviceId, const FusedSGDBatch<ElemType>& batch);
+    static void FusedSGDSquaredNorm(DEVICEID_TYPE deviceId, const FusedSGDBatch<ElemType>& batch, ElemType* sumOfSquares);
     ElemType RmsProp(GPUMatrix<ElemType>& gradients, ElemType RMS_GAMMA, ElemType RMS_WGT_INC, ElemType RMS_WGT_MAX, ElemType RMS_WGT_DEC, ElemType RMS_WGT_MIN, const bool needAveMultiplier);
 
     void Reshape(const size_t numRows, const size_t numCols);
@@ -190,6 +197,8 @@ public:
         LogicError("GPUMatrix doesn't support this");
     }
     ElemType Get00Element() const;
+    // copies the first numElements elements, in column-major order, asynchronously on the current stream; dst should be page-locked
+    void CopyToHostAsync(ElemType* dst, size_t numElements) const;
 
     void SetValue(const ElemType v);
     void SetValue(const ElemType* d_v); // d_v is pointer to the the value in GPU memory
@@ -199,6 +208,7 @@ public:
     void MaskColumnsValue(const GPUMatrix<char>& columnsMask, ElemType val);
 
     void SetValue(const GPUMatrix<ElemType>& deepCopyFrom);
+    void SetValueFromOtherDevice(const GPUMatrix<ElemType>& deepCopyFrom); // asynchronous copy from another GPU
     void SetValue(const size_t numRows, const size_t numCols, int deviceId, ElemType* pArray, size_t matrixFlags = matrixFlagNormal);
 
     void SetDiagonalValue(const ElemType v);
@@ -206,6 +216,7 @@ public:
     void SetUniformRandomValue(const ElemType low, const ElemType high, unsigned long seed = USE_TIME_BASED_SEED);
     void SetGaussianRandomValue(const ElemType mean, const ElemType sigma, unsigned long seed = USE_TIME_BASED_SEED);
     void SetUniformRandomMask(const ElemType maskRate, const ElemType scaleValue, unsigned long seed = USE_TIME_BASED_SEED);
+    GPUMatrix<ElemType>& ScaleAndAddDropoutOf(const ElemType beta, const GPUMatrix<ElemType>& a, const ElemType maskRate, const ElemType scaleValue, unsigned long seed, size_t counterOffset);
 
     GPUMatrix<ElemType> Transpose() const;
     GPUMatrix<ElemType>& AssignTransposeOf(const GPUMatrix<ElemType>& a);
@@ -272,6 +283,10 @@ public:
     GPUMatrix<ElemType>& InplaceLogSoftmax(const bool isColWise);
     GPUMatrix<ElemType>& AssignLogSoftmaxOf(const GPUMatrix<ElemType>& a, const bool isColWise);
 
+    GPUMatrix<ElemType>& InplaceSoftmax(const bool isColWise);
+    GPUMatrix<ElemType>& AssignSoftmaxOf(const GPUMatrix<ElemType>& a, const bool isColWise);
+    GPUMatrix<ElemType>& AssignMaskedSoftmaxOf(const GPUMatrix<ElemType>& a, ElemType scale, const GPUMatrix<ElemType>& numValidRows);
+
     GPUMatrix<ElemType>& InplaceHardmax(const bool isColWise);
     GPUMatrix<ElemType>& AssignHardmaxOf(const GPUMatrix<ElemType>& a, const bool isColWise);
 
@@ -337,6 +352,10 @@ public:
     ElemType MatrixNormInf() const;
     ElemType MatrixNorm1() const;
     ElemType MatrixNorm0() const; // number of non-zero elemets
+    // 1x1 results that stay on the device (see Matrix)
+    GPUMatrix<ElemType>& AssignMatrixNormInfOf(const GPUMatrix<ElemType>& a);
+    GPUMatrix<ElemType>& AssignMatrixNorm1Of(const GPUMatrix<ElemType>& a);
+    GPUMatrix<ElemType>& AssignIsEqualTo(const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b, const ElemType threshold = 1e-8);
     GPUMatrix<ElemType>& AssignSignOf(const GPUMatrix<ElemType>& a);
     GPUMatrix<ElemType>& AddSignOf(const GPUMatrix<ElemType>& a);
 
@@ -357,6 +376,7 @@ public:
     void VectorMin(GPUMatrix<ElemType>& minIndexes, GPUMatrix<ElemType>& minValues, const bool isColWise) const;
 
     GPUMatrix<ElemType>& AssignNumOfDiff(const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b, bool searchInCol = false);
+    GPUMatrix<ElemType>& AssignNumOfTopKErrorsOf(const GPUMatrix<ElemType>& labels, const GPUMatrix<ElemType>& predictions, const size_t topK);
 
     GPUMatrix<ElemType>& AssignInnerProductOfMatrices(const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b);
 
@@ -366,6 +386,39 @@ public:
     void AssignNCEUnnormalizedEval(const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b, GPUMatrix<ElemType>& c);
     void AssignSoftmaxSum(const GPUMatrix<ElemType>& a, GPUMatrix<ElemType>& softmax);
 
+    // sampled softmax, see Matrix<ElemType>::InplaceSampleFromCDF() and Matrix<ElemType>::AssignSampledSoftmaxLogits()
+    GPUMatrix<ElemType>& InplaceSampleFromCDF(const GPUMatrix<ElemType>& cdf);
+    GPUMatrix<ElemType>& AssignSampledSoftmaxLogits(const GPUMatrix<ElemType>& trueLogits, const GPUMatrix<ElemType>& sampledLogits,
+                                                    const GPUMatrix<ElemType>& candidateBiases, const GPUMatrix<ElemType>& candidateIds);
+
+    // NCE with noise drawn on the device, see Matrix<ElemType>::AssignAliasSamplesOf(), Matrix<ElemType>::AssignNCELossOf() and Matrix<ElemType>::AddNCEHiddenGradientOf()
+    GPUMatrix<ElemType>& AssignAliasSamplesOf(const GPUMatrix<ElemType>& uniforms, const GPUMatrix<ElemType>& aliasProbs, const GPUMatrix<ElemType>& aliases);
+    GPUMatrix<ElemType>& AssignNCELossOf(const GPUMatrix<ElemType>& labelIds, const GPUMatrix<ElemType>& noiseIds, const GPUMatrix<ElemType>& hidden, const GPUMatrix<ElemType>& weights,
+                                 const GPUMatrix<ElemType>& bias, const GPUMatrix<ElemType>& logNoiseCounts, GPUMatrix<ElemType>& scoreGradients);
+    GPUMatrix<ElemType>& AddNCEHiddenGradientOf(const GPUMatrix<ElemType>& scoreGradients, const GPUMatrix<ElemType>& labelIds, const GPUMatrix<ElemType>& noiseIds, const GPUMatrix<ElemType>& weights);
+
+    // GMM log-likelihood, see Matrix<ElemType>::AssignGMMLogLikelihoodOf() and Matrix<ElemType>::AddGMMLogLikelihoodGradient()
+    GPUMatrix<ElemType>& AssignGMMLogLikelihoodOf(const GPUMatrix<ElemType>& logPrior, const GPUMatrix<ElemType>& mean, const GPUMatrix<ElemType>& logStddev, const GPUMatrix<ElemType>& feature,
+                                                  GPUMatrix<ElemType>& posterior, GPUMatrix<ElemType>& normedDeviation, GPUMatrix<ElemType>& normedDeviationVectors);
+    GPUMatrix<ElemType>& AddGMMLogLikelihoodGradient(const size_t inputIndex, const GPUMatrix<ElemType>& gradient, const GPUMatrix<ElemType>& logPrior,
+                                                     const GPUMatrix<ElemType>& posterior, const GPUMatrix<ElemType>& normedDeviation, const GPUMatrix<ElemType>& normedDeviationVectors);
+
+    // fused softmax cross entropy, see Matrix<ElemType>::AssignCrossEntropyWithSoftmaxOf() and Matrix<ElemType>::AddCrossEntropyWithSoftmaxGradient()
+    GPUMatrix<ElemType>& AssignCrossEntropyWithSoftmaxOf(const GPUMatrix<ElemType>& labels, const GPUMatrix<ElemType>& logits, GPUMatrix<ElemType>& logSumExp);
+    GPUMatrix<ElemType>& AddCrossEntropyWithSoftmaxGradient(const size_t inputIndex, const GPUMatrix<ElemType>& gradient, const GPUMatrix<ElemType>& labels,
+                                                            const GPUMatrix<ElemType>& logits, const GPUMatrix<ElemType>& logSumExp);
+
+    // Viterbi decoding, see Matrix<ElemType>::AssignViterbiPathOf()
+    GPUMatrix<ElemType>& AssignViterbiPathOf(const GPUMatrix<ElemType>& posScores, const GPUMatrix<ElemType>& pairScores, const GPUMatrix<ElemType>& sequences, const size_t numParallelSequences,
+                                             const int startLabel, const int endLabel, GPUMatrix<ElemType>& alpha, GPUMatrix<ElemType>& backtrace);
+
+    // class-based softmax cross entropy, see Matrix<ElemType>::AssignClassBasedCrossEntropyWithSoftmaxOf() and Matrix<ElemType>::AddClassBasedCrossEntropyWithSoftmaxGradient()
+    GPUMatrix<ElemType>& AssignClassBasedCrossEntropyWithSoftmaxOf(const GPUMatrix<ElemType>& labels, const GPUMatrix<ElemType>& input, const GPUMatrix<ElemType>& weight, const GPUMatrix<ElemType>& classLogSoftmax,
+                                                                   const GPUMatrix<ElemType>& buckets, const GPUMatrix<ElemType>& frames, const size_t maxClassSize, GPUMatrix<ElemType>& softmax);
+    GPUMatrix<ElemType>& AddClassBasedCrossEntropyWithSoftmaxGradient(const size_t inputIndex, const GPUMatrix<ElemType>& gradient, const GPUMatrix<ElemType>& labels, const GPUMatrix<ElemType>& input,
+                                                                      const GPUMatrix<ElemType>& weight, const GPUMatrix<ElemType>& classLogSoftmax, const GPUMatrix<ElemType>& buckets,
+                                                                      const GPUMatrix<ElemType>& frames, const GPUMatrix<ElemType>& softmax);
+
     void Print(const char* matrixName, size_t rowStart, size_t rowEnd, size_t colStart, size_t colEnd) const;
     void Print(const char* matrixName = NULL) const; // print whole matrix. can be expensive
 
@@ -379,6 +432,21 @@ public:
                                                 const size_t outputWidth, const size_t outputHeight, const size_t outputChannels,
                                                 const size_t kernelWidth, const size_t kernelHeight, const size_t horizontalSubsample, const size_t verticalSubsample,
                                                 bool zeroPadding = false) const;
+    GPUMatrix<ElemType>& AssignGroupedConvolutionResult(const GPUMatrix<ElemType>& inputBatch, const GPUMatrix<ElemType>& filter,
+                                                        const size_t inputWidth, const size_t inputHeight, const size_t inputChannels,
+                                                        const size_t outputWidth, const size_t outputHeight, const size_t outputChannels,
+                                                        const size_t kernelWidth, const size_t kernelHeight, const size_t horizontalSubsample, const size_t verticalSubsample,
+                                                        const bool zeroPadding, const size_t groups);
+    GPUMatrix<ElemType>& AddGroupedConvolutionGradientOfInput(const GPUMatrix<ElemType>& outputGradientBatch, const GPUMatrix<ElemType>& filter,
+                                                              const size_t inputWidth, const size_t inputHeight, const size_t inputChannels,
+                                                              const size_t outputWidth, const size_t outputHeight, const size_t outputChannels,
+                                                              const size_t kernelWidth, const size_t kernelHeight, const size_t horizontalSubsample, const size_t verticalSubsample,
+                                                              const bool zeroPadding, const size_t groups);
+    GPUMatrix<ElemType>& AddGroupedConvolutionGradientOfFilter(const GPUMatrix<ElemType>& outputGradientBatch, const GPUMatrix<ElemType>& inputBatch,
+                                                               const size_t inputWidth, const size_t inputHeight, const size_t inputChannels,
+                                                               const size_t outputWidth, const size_t outputHeight, const size_t outputChannels,
+                                                               const size_t kernelWidth, const size_t kernelHeight, const size_t horizontalSubsample, const size_t verticalSubsample,
+                                                               const bool zeroPadding, const size_t groups);
     GPUMatrix<ElemType>& AssignMaxPoolingResult(const GPUMatrix<ElemType>& inputBatch, const size_t channels,
                                                 const size_t inputWidth, const size_t inputHeight, const size_t inputSizePerSample,
                                                 const size_t outputWidth, const size_t outputHeight, const size_t outputSizePerSample,
@@ -401,6 +469,7 @@ public:
 public:
     // static BLAS functions
     static void MultiplyAndWeightedAdd(ElemType alpha, const GPUMatrix<ElemType>& a, const bool transposeA, const GPUMatrix<ElemType>& b, const bool transposeB, ElemType beta, GPUMatrix<ElemType>& c);
+    static void BatchedMultiplyAndWeightedAdd(ElemType alpha, const GPUMatrix<ElemType>& a, const bool transposeA, const GPUMatrix<ElemType>& b, const bool transposeB, ElemType beta, GPUMatrix<ElemType>& c, size_t numBatches);
     static void MultiplyAndAdd(const GPUMatrix<ElemType>& a, const bool transposeA, const GPUMatrix<ElemType>& b, const bool transposeB, GPUMatrix<ElemType>& c);
     static void Multiply(const GPUMatrix<ElemType>& a, const bool transposeA, const GPUMatrix<ElemType>& b, const bool transposeB, GPUMatrix<ElemType>& c);
     static void Multiply(const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b, GPUMatrix<ElemType>& c);
@@ -441,6 +510,10 @@ public:
                   const std::array<size_t, 4>& offsets,
                   const SmallVector<size_t>& regularOpDims, const std::array<SmallVector<ptrdiff_t>, 4>& regularStrides,
                   const SmallVector<size_t>& reducingOpDims, const std::array<SmallVector<ptrdiff_t>, 4>& reducingStrides);
+    // fused sequence of elementwise ops over up to 4 inputs (unused inputs are passed as any valid matrix); no reduction
+    void TensorOp(ElemType beta, const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b, const GPUMatrix<ElemType>& c, const GPUMatrix<ElemType>& d, ElemType alpha, const ElementWiseProgram& program,
+                  const std::array<size_t, 5>& offsets,
+                  const SmallVector<size_t>& regularOpDims, const std::array<SmallVector<ptrdiff_t>, 5>& regularStrides);
 
     static void CreateCurandObject(unsigned long seed, const char* caller);
     static void ResetCurandObject(unsigned long seed, const char* caller);
@@ -459,6 +532,13 @@ public:
 public:
     GPUMatrix<ElemType>& AssignElementProductOfWithShiftNeg(const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b, const size_t shift, const size_t nt);
     static void InnerProductWithShiftNeg(const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b, GPUMatrix<ElemType>& c, const size_t shift, const size_t nt);
+    GPUMatrix<ElemType>& AssignCosDistanceWithShiftNegOf(const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b, size_t shift, size_t negNumber,
+                                                         GPUMatrix<ElemType>& invNormA, GPUMatrix<ElemType>& invNormB);
+    GPUMatrix<ElemType>& AddCosDistanceWithShiftNegGradientOf(const GPUMatrix<ElemType>& gradient, const GPUMatrix<ElemType>& value,
+                                                              const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b,
+                                                              const GPUMatrix<ElemType>& invNormA, const GPUMatrix<ElemType>& invNormB, size_t shift, bool rightInput);
+    GPUMatrix<ElemType>& AssignAugmentedImagesOf(const GPUMatrix<ElemType>& staged, const GPUMatrix<ElemType>& mean, size_t stagingWidth, size_t stagingHeight,
+                                                 size_t channels, size_t width, size_t height, bool transposeToCHW);
     GPUMatrix<ElemType>& GetARowByIndex(const GPUMatrix<ElemType>& a, const size_t m);
     static void ConductRowElementMultiplyWithShift(const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b, GPUMatrix<ElemType>& c, const size_t shift, const bool isafixed);
 
@@ -477,10 +557,19 @@ public:
                                     const int startLbl, // the time 0 start symbol in the output layer
                                     const int shift);
 
+    // CTC forward-backward, see Matrix::AssignCTCPosteriors()
+    GPUMatrix<ElemType>& AssignCTCPosteriors(const GPUMatrix<ElemType>& logProbs, const GPUMatrix<ElemType>& stateLabels, const GPUMatrix<ElemType>& sequences,
+                                             size_t numParallelSequences, GPUMatrix<ElemType>& alpha, GPUMatrix<ElemType>& beta, GPUMatrix<ElemType>& logLikelihoods);
+
 public:
+    // "BMATA" is the variant with the elements in an aligned block (see File::PutAlignedBlock()),
+    // "BMATH" the one with the elements in half precision (see File::WritesHalfMatrices())
     friend File& operator>>(File& stream, GPUMatrix<ElemType>& us)
     {
-        stream.GetMarker(fileMarkerBeginSection, std::wstring(L"BMAT"));
+        std::wstring section;
+        stream >> section;
+        if (section != L"BMAT" && section != L"BMATA" && section != L"BMATH")
+            RuntimeError("section name mismatch %ls != BMAT", section.c_str());
         size_t elsize;
         stream >> elsize;
         if (sizeof(ElemType) != elsize)
@@ -489,9 +578,37 @@ public:
         size_t numRows, numCols;
         int format;
         stream >> matrixNameDummy >> format >> numRows >> numCols;
+        if (section == L"BMATA" && stream.MapsAlignedBlocks())
+        {
+            // copied to the GPU straight from the mapped pages, without a private copy in host memory
+            ElemType* mapped = (ElemType*) stream.MapAlignedBlock(numRows * numCols * sizeof(ElemType));
+            stream.GetMarker(fileMarkerEndSection, std::wstring(L"EMAT"));
+            us.SetValue(numRows, numCols, us.GetComputeDeviceId(), mapped, matrixFlagNormal | format);
+            return stream;
+        }
+        if (section == L"BMATA" && stream.TransfersBlocksInParallel())
+        {
+            // sized now, copied to the GPU by File::FinishAlignedBlocks()
+            us.Resize(numRows, numCols);
+            stream.GetAlignedBlock(numRows * numCols * sizeof(ElemType), [&us, numRows, numCols, format](void* buffer)
+                                   {
+                                       us.SetValue(numRows, numCols, us.GetComputeDeviceId(), (ElemType*) buffer, matrixFlagNormal | format);
+                                   });
+            stream.GetMarker(fileMarkerEndSection, std::wstring(L"EMAT"));
+            return stream;
+        }
         ElemType* d_array = new ElemType[numRows * numCols];
-        for (size_t i = 0; i < numRows * numCols; ++i)
-            stream >> d_array[i];
+        if (section == L"BMATA")
+            stream.GetAlignedBlock(d_array, numRows * numCols * sizeof(ElemType));
+        else if (section == L"BMATH")
+        {
+            std::vector<uint16_t> halves(numRows * numCols);
+            stream.GetArray(halves.data(), halves.size());
+            for (size_t i = 0; i < halves.size(); i++)
+                d_array[i] = (ElemType) HalfToFloat(halves[i]);
+        }
+        else
+            stream.GetArray(d_array, numRows * numCols);
         stream.GetMarker(fileMarkerEndSection, std::wstring(L"EMAT"));
         us.SetValue(numRows, numCols, us.GetComputeDeviceId(), d_array, matrixFlagNormal | format);
         delete[] d_array;
@@ -499,7 +616,9 @@ public:
     }
     friend File& operator<<(File& stream, const GPUMatrix<ElemType>& us)
     {
-        stream.PutMarker(fileMarkerBeginSection, std::wstring(L"BMAT"));
+        bool half = stream.WritesHalfMatrices();
+        bool aligned = !half && stream.WritesAlignedBlocks();
+        stream.PutMarker(fileMarkerBeginSection, std::wstring(half ? L"BMATH" : aligned ? L"BMATA" : L"BMAT"));
         stream << sizeof(ElemType);
 
         // TODO: This is now ignored on input, so we can should change to an empty string. This might break parsing, and must be tested first
@@ -508,11 +627,30 @@ public:
         stream << s << format;
 
         stream << us.m_numRows << us.m_numCols;
-        ElemType* pArray = us.CopyToArray();
-        for (size_t i = 0; i < us.GetNumElements(); ++i)
-            stream << pArray[i];
-        
-        delete[] pArray;
+        if (aligned)
+        {
+            // with File::TransfersBlocksInParallel(), copied from the GPU by File::FinishAlignedBlocks()
+            stream.PutAlignedBlock(us.GetNumElements() * sizeof(ElemType), [&us](void* buffer)
+                                   {
+                                       ElemType* pArray = (ElemType*) buffer;
+                                       size_t numElements = us.GetNumElements();
+                                       us.CopyToArray(pArray, numElements);
+                                   });
+        }
+        else
+        {
+            ElemType* pArray = us.CopyToArray();
+            if (half)
+            {
+                std::vector<uint16_t> halves(us.GetNumElements());
+                for (size_t i = 0; i < halves.size(); i++)
+                    halves[i] = FloatToHalf((float) pArray[i]);
+                stream.PutArray(halves.data(), halves.size());
+            }
+            else
+                stream.PutArray(pArray, us.GetNumElements());
+            delete[] pArray;
+        }
 
         stream.PutMarker(fileMarkerEndSection, std::wstring(L"EMAT"));
         return stream;
@@ -14,6 +14,8 @@
 #include "CommonMatrix.h"
 #include "GPUMatrix.h"
 #include "TensorOps.h" // for exp_() etc.
+#define PHILOX_DECL __device__ __host__
+#include "PhiloxRandom.h"
 #include "device_functions.h"
 #include <cuda_runtime.h>
 #include <assert.h>
@@ -397,6 +399,36 @@ __global__ void _copyColumnsStrided(ElemType* dest, ElemType* src, CUDA_LONG N,
     dest[(denseColIdx * destNumColsStride * numRows) + rowIdx] = src[(denseColIdx * srcNumColsStride * numRows) + rowIdx];
 }
 
+// us(:,j) = beta * us(:,j) + alpha * a(:,idx(j)), see GPUMatrix::DoGatherColumnsOf()
+template <class ElemType>
+__global__ void _doGatherColumnsOf(ElemType* us, const ElemType beta, const ElemType* idx, const ElemType* a, const ElemType alpha, const CUDA_LONG numRows, const CUDA_LONG numCols)
+{
+    CUDA_LONG id = blockDim.x * blockIdx.x + threadIdx.x;
+    if (id >= numRows * numCols)
+        return;
+    CUDA_LONG j = id / numRows;
+    CUDA_LONG i = id - j * numRows;
+    const CUDA_LONG jIn = (CUDA_LONG) idx[j];
+    ElemType v = beta ? beta * us[id] : 0;
+    if (jIn >= 0)
+        v += alpha * a[IDX2C(i, jIn, numRows)];
+    us[id] = v;
+}
+
+// us(:,idx(j)) += alpha * a(:,j), see GPUMatrix::DoScatterColumnsOf()
+template <class ElemType>
+__global__ void _doScatterColumnsOf(ElemType* us, const ElemType* idx, const ElemType* a, const ElemType alpha, const CUDA_LONG numRows, const CUDA_LONG numCols)
+{
+    CUDA_LONG id = blockDim.x * blockIdx.x + threadIdx.x;
+    if (id >= numRows * numCols)
+        return;
+    CUDA_LONG j = id / numRows;
+    CUDA_LONG i = id - j * numRows;
+    const CUDA_LONG jOut = (CUDA_LONG) idx[j];
+    if (jOut >= 0)
+        us[IDX2C(i, jOut, numRows)] += alpha * a[id];
+}
+
 template <class ElemType>
 __global__ void _assignToRowSliceValuesOf(ElemType* dest, ElemType* src, const CUDA_LONG N, const CUDA_LONG startIndex, const CUDA_LONG destRows, const CUDA_LONG srcRows)
 {
@@ -760,216 +792,193 @@ __global__ void _elemInverse(
         us[id] = 1 / us[id];
 }
 
+// online softmax normalizer: merge the (max, sum of exp(x - max)) pair of one range of a column into that of another
+// A single element x is the pair (x, 1), so accumulating an element costs one exp().
 template <class ElemType>
-__global__ void _logSoftMaxColWise(
-    ElemType* a,
-    const CUDA_LONG m_numCols,
-    const CUDA_LONG m_numRows) // ld
+__device__ __forceinline__ void _mergeMaxAndSumExp(ElemType& maxV, ElemType& sum, const ElemType otherMax, const ElemType otherSum)
 {
-    int col_id = blockDim.x * blockIdx.x + threadIdx.x;
-    if (col_id >= m_numCols)
+    if (otherSum == 0)
         return;
-
-    __shared__ ElemType maxV[GridDim::maxThreadsPerBlock];
-    __shared__ ElemType Sum[GridDim::maxThreadsPerBlock];
-    maxV[threadIdx.x] = a[IDX2C(0, col_id, m_numRows)];
-    Sum[threadIdx.x] = 0;
-
-    for (CUDA_LONG i = 0; i < m_numRows; ++i)
-    {
-        if (a[IDX2C(i, col_id, m_numRows)] > maxV[threadIdx.x])
-        {
-            maxV[threadIdx.x] = a[IDX2C(i, col_id, m_numRows)];
-        }
-    }
-
-    for (CUDA_LONG i = 0; i < m_numRows; ++i)
+    if (sum == 0)
     {
-        ElemType tmp = a[IDX2C(i, col_id, m_numRows)] - maxV[threadIdx.x];
-        Sum[threadIdx.x] += (sizeof(ElemType) == sizeof(float) ? expf(tmp) : exp(tmp));
+        maxV = otherMax;
+        sum = otherSum;
     }
-    Sum[threadIdx.x] = maxV[threadIdx.x] + (sizeof(ElemType) == sizeof(float) ? logf(Sum[threadIdx.x]) : log(Sum[threadIdx.x]));
-    for (CUDA_LONG i = 0; i < m_numRows; ++i)
+    else if (otherMax > maxV)
     {
-        a[IDX2C(i, col_id, m_numRows)] -= Sum[threadIdx.x];
+        sum = sum * exp_(maxV - otherMax) + otherSum;
+        maxV = otherMax;
     }
+    else
+        sum += otherSum * exp_(otherMax - maxV);
 }
 
-//template<class ElemType>
-//__global__ void _assignColumnwiseSoftmaxOf(
-//    const ElemType *a,
-//    ElemType* us,
-//    const CUDA_LONG m_numCols,
-//    const CUDA_LONG m_numRows) // thead per column
-//{
-//    int col_id = blockDim.x * blockIdx.x + threadIdx.x;
-//    if (col_id>=m_numCols)
-//        return;
-//
-//    __shared__ ElemType maxV[GridDim::maxThreadsPerBlock];
-//    __shared__ ElemType Sum[GridDim::maxThreadsPerBlock];
-//    maxV[threadIdx.x]=a[IDX2C(0,col_id,m_numRows)];
-//    Sum[threadIdx.x]=0;
-//
-//    for (CUDA_LONG i=0;i<m_numRows;++i)
-//    {
-//        if (a[IDX2C(i,col_id,m_numRows)]>maxV[threadIdx.x])
-//        {
-//            maxV[threadIdx.x]=a[IDX2C(i,col_id,m_numRows)];
-//        }
-//    }
-//
-//    for (CUDA_LONG i=0;i<m_numRows;++i)
-//    {
-//        if (sizeof(ElemType)==sizeof(float))
-//        {
-//            us[IDX2C(i,col_id,m_numRows)] = expf(a[IDX2C(i,col_id,m_numRows)]-maxV[threadIdx.x]);
-//        }
-//        else
-//        {
-//            us[IDX2C(i,col_id,m_numRows)] = exp(a[IDX2C(i,col_id,m_numRows)]-maxV[threadIdx.x]);
-//        }
-//        Sum[threadIdx.x] +=  us[IDX2C(i,col_id,m_numRows)];
-//    }
-//
-//    for (CUDA_LONG i=0;i<m_numRows;++i)
-//    {
-//        us[IDX2C(i,col_id,m_numRows)] /= Sum[threadIdx.x] ;
-//    }
-//}
-
-// each block processes one column. There must be 512 threads in a block
+// softmax or log softmax of each column, in a single read of the input for the max and the sum of exp() together
+// 'threadsPerColumn' (a power of 2, at most GridDim::maxThreadsPerBlock) threads share a column, so that short columns
+// take one warp each and a block processes GridDim::maxThreadsPerBlock / threadsPerColumn columns.
+// This works in place, since all threads of a column have read it before any of them writes.
 template <class ElemType>
-__global__ void _assignColumnwiseLogSoftmaxOf(
+__global__ void _assignColumnwiseSoftmaxOf(
     const ElemType* a,
     ElemType* us,
-    const CUDA_LONG m_numCols,
-    const CUDA_LONG m_numRows)
+    const CUDA_LONG numCols,
+    const CUDA_LONG numRows,
+    const int threadsPerColumn,
+    const bool isLog)
 {
-    // We first find max per column
-    __shared__ ElemType colMax[1];
-    __shared__ ElemType partials[512];
-    colMax[0] = -10000000;
-    partials[threadIdx.x] = -10000000;
-
-    for (int i = threadIdx.x; i < m_numRows; i += 512)
-    {
-        partials[threadIdx.x] = max(partials[threadIdx.x], a[IDX2C(i, blockIdx.x, m_numRows)]);
-    }
-    __syncthreads();
-
-    if (threadIdx.x < 256)
-    {
-        partials[threadIdx.x] = max(partials[threadIdx.x + 256], partials[threadIdx.x]);
-    }
-    __syncthreads();
-
-    if (threadIdx.x < 128)
-    {
-        partials[threadIdx.x] = max(partials[threadIdx.x + 128], partials[threadIdx.x]);
-    }
-    __syncthreads();
+    __shared__ ElemType partialMax[GridDim::maxThreadsPerBlock];
+    __shared__ ElemType partialSum[GridDim::maxThreadsPerBlock];
 
-    if (threadIdx.x < 64)
-    {
-        partials[threadIdx.x] = max(partials[threadIdx.x + 64], partials[threadIdx.x]);
-    }
-    __syncthreads();
+    const int lane = threadIdx.x % threadsPerColumn;
+    const CUDA_LONG col = blockIdx.x * (GridDim::maxThreadsPerBlock / threadsPerColumn) + threadIdx.x / threadsPerColumn;
 
-    if (threadIdx.x < 32)
+    ElemType maxV = 0;
+    ElemType sum = 0;
+    if (col < numCols)
     {
-        partials[threadIdx.x] = max(partials[threadIdx.x + 32], partials[threadIdx.x]);
+        for (CUDA_LONG i = lane; i < numRows; i += threadsPerColumn)
+            _mergeMaxAndSumExp(maxV, sum, a[IDX2C(i, col, numRows)], (ElemType) 1);
     }
+    partialMax[threadIdx.x] = maxV;
+    partialSum[threadIdx.x] = sum;
     __syncthreads();
 
-    if (threadIdx.x < 16)
+    for (int stride = threadsPerColumn / 2; stride > 0; stride /= 2)
     {
-        partials[threadIdx.x] = max(partials[threadIdx.x + 16], partials[threadIdx.x]);
+        if (lane < stride)
+        {
+            _mergeMaxAndSumExp(maxV, sum, partialMax[threadIdx.x + stride], partialSum[threadIdx.x + stride]);
+            partialMax[threadIdx.x] = maxV;
+            partialSum[threadIdx.x] = sum;
+        }
+        __syncthreads();
     }
-    __syncthreads();
 
-    if (threadIdx.x < 8)
+    if (col >= numCols)
+        return;
+    const ElemType logSum = partialMax[threadIdx.x - lane] + log_(partialSum[threadIdx.x - lane]);
+    for (CUDA_LONG i = lane; i < numRows; i += threadsPerColumn)
     {
-        partials[threadIdx.x] = max(partials[threadIdx.x + 8], partials[threadIdx.x]);
+        const ElemType x = a[IDX2C(i, col, numRows)] - logSum;
+        us[IDX2C(i, col, numRows)] = isLog ? x : exp_(x);
     }
-    __syncthreads();
+}
 
-    if (threadIdx.x < 4)
-    {
-        partials[threadIdx.x] = max(partials[threadIdx.x + 4], partials[threadIdx.x]);
-    }
-    __syncthreads();
+// softmax of scale * a over the first numValidRows[col] rows of each column, 0 in the others, with the threads of a column as
+// in _assignColumnwiseSoftmaxOf(); see GPUMatrix::AssignMaskedSoftmaxOf()
+template <class ElemType>
+__global__ void _assignColumnwiseMaskedSoftmaxOf(
+    const ElemType* a,
+    ElemType* us,
+    const ElemType* numValidRows,
+    const ElemType scale,
+    const CUDA_LONG numCols,
+    const CUDA_LONG numRows,
+    const int threadsPerColumn)
+{
+    __shared__ ElemType partialMax[GridDim::maxThreadsPerBlock];
+    __shared__ ElemType partialSum[GridDim::maxThreadsPerBlock];
 
-    if (threadIdx.x == 0)
-    {
-        colMax[0] = max(max(partials[0], partials[1]), max(partials[2], partials[3]));
-    }
-    partials[threadIdx.x] = 0.0f;
-    __syncthreads();
+    const int lane = threadIdx.x % threadsPerColumn;
+    const CUDA_LONG col = blockIdx.x * (GridDim::maxThreadsPerBlock / threadsPerColumn) + threadIdx.x / threadsPerColumn;
+    const CUDA_LONG numValid = col < numCols ? min(numRows, (CUDA_LONG) numValidRows[col]) : 0;
 
-    // Now start finding sums
-    __shared__ ElemType colSum[1];
-    colSum[0] = 0.0f;
-    for (int i = threadIdx.x; i < m_numRows; i += 512)
-    {
-        ElemType tmp = a[IDX2C(i, blockIdx.x, m_numRows)] - colMax[0];
-        us[IDX2C(i, blockIdx.x, m_numRows)] = tmp;
-        partials[threadIdx.x] += (sizeof(ElemType) == sizeof(float)) ? expf(tmp) : exp(tmp);
-    }
+    ElemType maxV = 0;
+    ElemType sum = 0;
+    for (CUDA_LONG i = lane; i < numValid; i += threadsPerColumn)
+        _mergeMaxAndSumExp(maxV, sum, scale * a[IDX2C(i, col, numRows)], (ElemType) 1);
+    partialMax[threadIdx.x] = maxV;
+    partialSum[threadIdx.x] = sum;
     __syncthreads();
 
-    if (threadIdx.x < 256)
+    for (int stride = threadsPerColumn / 2; stride > 0; stride /= 2)
     {
-        partials[threadIdx.x] += partials[threadIdx.x + 256];
+        if (lane < stride)
+        {
+            _mergeMaxAndSumExp(maxV, sum, partialMax[threadIdx.x + stride], partialSum[threadIdx.x + stride]);
+            partialMax[threadIdx.x] = maxV;
+            partialSum[threadIdx.x] = sum;
+        }
+        __syncthreads();
     }
-    __syncthreads();
 
-    if (threadIdx.x < 128)
-    {
-        partials[threadIdx.x] += partials[threadIdx.x + 128];
-    }
-    __syncthreads();
+    if (col >= numCols)
+        return;
+    const ElemType logSum = partialMax[threadIdx.x - lane] + log_(partialSum[threadIdx.x - lane]);
+    for (CUDA_LONG i = lane; i < numRows; i += threadsPerColumn)
+        us[IDX2C(i, col, numRows)] = i < numValid ? exp_(scale * a[IDX2C(i, col, numRows)] - logSum) : 0;
+}
 
-    if (threadIdx.x < 64)
-    {
-        partials[threadIdx.x] += partials[threadIdx.x + 64];
-    }
-    __syncthreads();
+// softmax of very tall columns, first kernel: block (b, j) reduces rows [b * rowsPerBlock, (b + 1) * rowsPerBlock)
+// of column j to its (max, sum of exp()) pair, stored as partials(b, j) and partials(b, numCols + j)
+template <class ElemType>
+__global__ void _columnwiseSoftmaxPartials(
+    const ElemType* a,
+    ElemType* partials,
+    const CUDA_LONG numCols,
+    const CUDA_LONG numRows,
+    const CUDA_LONG rowsPerBlock)
+{
+    __shared__ ElemType partialMax[GridDim::maxThreadsPerBlock];
+    __shared__ ElemType partialSum[GridDim::maxThreadsPerBlock];
 
-    if (threadIdx.x < 32)
-    {
-        partials[threadIdx.x] += partials[threadIdx.x + 32];
-    }
+    const CUDA_LONG col = blockIdx.y;
+    const CUDA_LONG end = min(numRows, (CUDA_LONG)(blockIdx.x + 1) * rowsPerBlock);
+    ElemType maxV = 0;
+    ElemType sum = 0;
+    for (CUDA_LONG i = blockIdx.x * rowsPerBlock + threadIdx.x; i < end; i += GridDim::maxThreadsPerBlock)
+        _mergeMaxAndSumExp(maxV, sum, a[IDX2C(i, col, numRows)], (ElemType) 1);
+    partialMax[threadIdx.x] = maxV;
+    partialSum[threadIdx.x] = sum;
     __syncthreads();
 
-    if (threadIdx.x < 16)
+    for (int stride = GridDim::maxThreadsPerBlock / 2; stride > 0; stride /= 2)
     {
-        partials[threadIdx.x] += partials[threadIdx.x + 16];
+        if (threadIdx.x < stride)
+        {
+            _mergeMaxAndSumExp(maxV, sum, partialMax[threadIdx.x + stride], partialSum[threadIdx.x + stride]);
+            partialMax[threadIdx.x] = maxV;
+            partialSum[threadIdx.x] = sum;
+        }
+        __syncthreads();
     }
-    __syncthreads();
 
-    if (threadIdx.x < 8)
+    if (threadIdx.x == 0)
     {
-        partials[threadIdx.x] += partials[threadIdx.x + 8];
+        partials[IDX2C(blockIdx.x, col, gridDim.x)] = maxV;
+        partials[IDX2C(blockIdx.x, numCols + col, gridDim.x)] = sum;
     }
-    __syncthreads();
+}
 
-    if (threadIdx.x < 4)
-    {
-        partials[threadIdx.x] += partials[threadIdx.x + 4];
-    }
-    __syncthreads();
+// softmax of very tall columns, second kernel: block (b, j) merges the partials of column j and writes its rows of it
+template <class ElemType>
+__global__ void _assignColumnwiseSoftmaxFromPartials(
+    const ElemType* a,
+    ElemType* us,
+    const ElemType* partials,
+    const CUDA_LONG numCols,
+    const CUDA_LONG numRows,
+    const CUDA_LONG rowsPerBlock,
+    const bool isLog)
+{
+    __shared__ ElemType logSum;
 
+    const CUDA_LONG col = blockIdx.y;
     if (threadIdx.x == 0)
     {
-        colSum[0] = partials[0] + partials[1] + partials[2] + partials[3];
-        colSum[0] = (sizeof(ElemType) == sizeof(float)) ? logf(colSum[0]) : log(colSum[0]);
+        ElemType maxV = 0;
+        ElemType sum = 0;
+        for (CUDA_LONG b = 0; b < gridDim.x; b++)
+            _mergeMaxAndSumExp(maxV, sum, partials[IDX2C(b, col, gridDim.x)], partials[IDX2C(b, numCols + col, gridDim.x)]);
+        logSum = maxV + log_(sum);
     }
     __syncthreads();
 
-    for (int i = threadIdx.x; i < m_numRows; i += 512)
+    const CUDA_LONG end = min(numRows, (CUDA_LONG)(blockIdx.x + 1) * rowsPerBlock);
+    for (CUDA_LONG i = blockIdx.x * rowsPerBlock + threadIdx.x; i < end; i += GridDim::maxThreadsPerBlock)
     {
-        us[IDX2C(i, blockIdx.x, m_numRows)] -= colSum[0];
+        const ElemType x = a[IDX2C(i, col, numRows)] - logSum;
+        us[IDX2C(i, col, numRows)] = isLog ? x : exp_(x);
     }
 }
 
@@ -1194,13 +1203,14 @@ __global__ void _setToZeroIfAbsLessThan(
     }
 }
 
-template <class ElemType>
+// d_res[0] must be 1 (true) before, it is cleared if any element differs
+template <class ElemType, class ResultType>
 __global__ void _areEqual(
     const ElemType* a,
     const ElemType* b,
     const CUDA_LONG N,
     const ElemType threshold,
-    long* d_res)
+    ResultType* d_res)
 {
     CUDA_LONG id = blockDim.x * blockIdx.x + threadIdx.x;
     if (id >= N)
@@ -1442,6 +1452,99 @@ __global__ void _fsadagrad(CUDA_LONG size, ElemType* grad, ElemType* smoothAda,
     }
 }
 
+// see CPUMatrix<ElemType>::Adam(); without 'val', the gradients are replaced by the update direction
+template <class ElemType>
+__global__ void _adam(CUDA_LONG size, ElemType* grad, ElemType* smoothMom, ElemType* smoothSqr, ElemType* val,
+                      ElemType lr, ElemType beta1, ElemType beta2, ElemType epsilon, ElemType biasCorrection)
+{
+    CUDA_LONG idx = blockIdx.x * blockDim.x + threadIdx.x;
+    CUDA_LONG stride = blockDim.x * gridDim.x;
+    for (; idx < size; idx += stride)
+    {
+        ElemType g = grad[idx];
+        ElemType mom = beta1 * smoothMom[idx] + (1 - beta1) * g;
+        ElemType sqr = beta2 * smoothSqr[idx] + (1 - beta2) * g * g;
+        smoothMom[idx] = mom;
+        smoothSqr[idx] = sqr;
+        ElemType direction = biasCorrection * mom / (sqrt_(sqr) + epsilon);
+        if (val)
+            val[idx] -= lr * direction;
+        else
+            grad[idx] = direction;
+    }
+}
+
+// the blocks of a _fusedSGDUpdate() launch: tensor t of the batch is processed by blocks [m_firstBlock[t], m_firstBlock[t + 1])
+template <class ElemType>
+struct FusedSGDBlocks
+{
+    static const CUDA_LONG ElementsPerBlock = 4 * GridDim::maxThreadsPerBlock;
+    CUDA_LONG m_firstBlock[FusedSGDBatch<ElemType>::MaxTensors + 1];
+
+    // returns the number of blocks
+    CUDA_LONG Assign(const FusedSGDBatch<ElemType>& batch)
+    {
+        CUDA_LONG numBlocks = 0;
+        for (int t = 0; t < batch.m_numTensors; t++)
+        {
+            m_firstBlock[t] = numBlocks;
+            numBlocks += (CUDA_LONG) ((batch.m_tensors[t].m_numElements + ElementsPerBlock - 1) / ElementsPerBlock);
+        }
+        for (int t = batch.m_numTensors; t <= FusedSGDBatch<ElemType>::MaxTensors; t++)
+            m_firstBlock[t] = numBlocks;
+        return numBlocks;
+    }
+
+    __device__ int TensorOfBlock(CUDA_LONG block) const
+    {
+        int t = 0;
+        while (block >= m_firstBlock[t + 1])
+            t++;
+        return t;
+    }
+};
+
+template <class ElemType>
+__global__ void _fusedSGDUpdate(const FusedSGDBatch<ElemType> batch, const FusedSGDBlocks<ElemType> blocks)
+{
+    const CUDA_LONG block = blockIdx.x;
+    const int t = blocks.TensorOfBlock(block);
+    const typename FusedSGDBatch<ElemType>::Tensor& tensor = batch.m_tensors[t];
+
+    CUDA_LONG begin = (block - blocks.m_firstBlock[t]) * FusedSGDBlocks<ElemType>::ElementsPerBlock;
+    CUDA_LONG end = min(begin + FusedSGDBlocks<ElemType>::ElementsPerBlock, (CUDA_LONG) tensor.m_numElements);
+    for (CUDA_LONG idx = begin + threadIdx.x; idx < end; idx += blockDim.x)
+        FusedSGDUpdateElement(batch, tensor, idx);
+}
+
+// each block reduces the squares of its chunk in shared memory and adds them to *sumOfSquares
+template <class ElemType>
+__global__ void _fusedSGDSquaredNorm(const FusedSGDBatch<ElemType> batch, const FusedSGDBlocks<ElemType> blocks, ElemType* sumOfSquares)
+{
+    __shared__ ElemType partialSums[GridDim::maxThreadsPerBlock];
+
+    const CUDA_LONG block = blockIdx.x;
+    const int t = blocks.TensorOfBlock(block);
+    const typename FusedSGDBatch<ElemType>::Tensor& tensor = batch.m_tensors[t];
+
+    CUDA_LONG begin = (block - blocks.m_firstBlock[t]) * FusedSGDBlocks<ElemType>::ElementsPerBlock;
+    CUDA_LONG end = min(begin + FusedSGDBlocks<ElemType>::ElementsPerBlock, (CUDA_LONG) tensor.m_numElements);
+    ElemType sum = 0;
+    for (CUDA_LONG idx = begin + threadIdx.x; idx < end; idx += blockDim.x)
+        sum += tensor.m_gradient[idx] * tensor.m_gradient[idx];
+    partialSums[threadIdx.x] = sum;
+    __syncthreads();
+
+    for (CUDA_LONG s = blockDim.x / 2; s > 0; s /= 2)
+    {
+        if (threadIdx.x < s)
+            partialSums[threadIdx.x] += partialSums[threadIdx.x + s];
+        __syncthreads();
+    }
+    if (threadIdx.x == 0)
+        atomicAdd(sumOfSquares, partialSums[0]);
+}
+
 template <class ElemType>
 __global__ void _rmsprop_init(
     ElemType* avars, ElemType* signs, ElemType* steps,
@@ -1537,6 +1640,26 @@ __global__ void _setMaskAndScale(
     a[id] = a[id] <= maskRate ? 0 : scaleValue;
 }
 
+// us = beta * us + a .* mask; each thread regenerates the mask of its element from (seed, counterOffset + id)
+template <class ElemType>
+__global__ void _scaleAndAddDropoutOf(
+    ElemType* us,
+    const ElemType* a,
+    const CUDA_LONG N,
+    const ElemType beta,
+    const ElemType maskRate,
+    const ElemType scaleValue,
+    const uint64_t seed,
+    const uint64_t counterOffset)
+{
+    CUDA_LONG id = blockDim.x * blockIdx.x + threadIdx.x;
+    if (id >= N)
+        return;
+    const ElemType u = (ElemType) PhiloxUniform(seed, counterOffset + id);
+    const ElemType value = u <= maskRate ? 0 : scaleValue * a[id];
+    us[id] = beta == 0 ? value : beta * us[id] + value;
+}
+
 template <class ElemType>
 __global__ void _vectorSum(
     ElemType* c,       // output
@@ -1806,6 +1929,143 @@ __global__ void _unpackConvolutionInput(const ElemType* packedMatrix, ElemType*
     inputSubBatch[id + sample * inputDim] = currentInputValue;
 }
 
+// Grouped convolution in the layouts of _assignPackedConvolutionInput(): output channel k belongs to group k / outputsPerGroup
+// and sees the channelsPerGroup input channels of that group. The filter is [outputChannels x kernelSize * channelsPerGroup],
+// its column of input channel ci within the group and kernel element (posxInKernel, posyInKernel) is
+// ci * kernelSize + posxInKernel + posyInKernel * kernelHeight. Adjacent threads handle adjacent channels, so that the
+// accesses of a depthwise convolution (one input channel per group) are coalesced.
+template <class ElemType>
+__global__ void _assignGroupedConvolutionResult(ElemType* outputBatch, const ElemType* inputBatch, const ElemType* filter, const CUDA_LONG batchSize,
+                                                const CUDA_LONG inputWidth, const CUDA_LONG inputHeight, const CUDA_LONG inputChannels,
+                                                const CUDA_LONG outputWidth, const CUDA_LONG outputHeight, const CUDA_LONG outputChannels,
+                                                const CUDA_LONG kernelWidth, const CUDA_LONG kernelHeight, const CUDA_LONG horizontalSubsample, const CUDA_LONG verticalSubsample,
+                                                const CUDA_LONG horizontalPad, const CUDA_LONG verticalPad, const CUDA_LONG channelsPerGroup, const CUDA_LONG outputsPerGroup)
+{
+    const CUDA_LONG outputIndex = blockIdx.x * blockDim.x + threadIdx.x;
+    const CUDA_LONG outputSizePerSample = outputWidth * outputHeight * outputChannels;
+    const CUDA_LONG sample = outputIndex / outputSizePerSample;
+    if (sample >= batchSize)
+        return;
+
+    const CUDA_LONG outputIndexWithinSample = outputIndex % outputSizePerSample;
+    const CUDA_LONG y = outputIndexWithinSample / (outputHeight * outputChannels);   // wcol
+    const CUDA_LONG nXK = outputIndexWithinSample % (outputHeight * outputChannels); // channel + wrow*channels
+    const CUDA_LONG x = nXK / outputChannels;                                        // wrow
+    const CUDA_LONG k = nXK % outputChannels;                                        // output channel
+
+    const CUDA_LONG kernelSize = kernelWidth * kernelHeight;
+    const ElemType* in = inputBatch + sample * inputWidth * inputHeight * inputChannels + (k / outputsPerGroup) * channelsPerGroup;
+    ElemType sum = 0;
+    for (CUDA_LONG posyInKernel = 0; posyInKernel < kernelWidth; posyInKernel++)
+    {
+        const CUDA_LONG inputCol = y * horizontalSubsample + posyInKernel - horizontalPad;
+        if (inputCol < 0 || inputCol >= inputWidth)
+            continue;
+        for (CUDA_LONG posxInKernel = 0; posxInKernel < kernelHeight; posxInKernel++)
+        {
+            const CUDA_LONG inputRow = x * verticalSubsample + posxInKernel - verticalPad;
+            if (inputRow < 0 || inputRow >= inputHeight)
+                continue;
+            const ElemType* inPos = in + (inputRow + inputCol * inputHeight) * inputChannels;
+            const ElemType* w = filter + (posxInKernel + posyInKernel * kernelHeight) * outputChannels + k;
+            for (CUDA_LONG ci = 0; ci < channelsPerGroup; ci++)
+                sum += inPos[ci] * w[ci * kernelSize * outputChannels];
+        }
+    }
+    outputBatch[outputIndex] = sum;
+}
+
+// inputGradientBatch += the gradient of _assignGroupedConvolutionResult() w.r.t. its input; one thread per input element
+// gathers from the output positions whose windows contain it
+template <class ElemType>
+__global__ void _addGroupedConvolutionGradientOfInput(ElemType* inputGradientBatch, const ElemType* outputGradientBatch, const ElemType* filter, const CUDA_LONG batchSize,
+                                                      const CUDA_LONG inputWidth, const CUDA_LONG inputHeight, const CUDA_LONG inputChannels,
+                                                      const CUDA_LONG outputWidth, const CUDA_LONG outputHeight, const CUDA_LONG outputChannels,
+                                                      const CUDA_LONG kernelWidth, const CUDA_LONG kernelHeight, const CUDA_LONG horizontalSubsample, const CUDA_LONG verticalSubsample,
+                                                      const CUDA_LONG horizontalPad, const CUDA_LONG verticalPad, const CUDA_LONG channelsPerGroup, const CUDA_LONG outputsPerGroup)
+{
+    const CUDA_LONG inputIndex = blockIdx.x * blockDim.x + threadIdx.x;
+    const CUDA_LONG inputSizePerSample = inputWidth * inputHeight * inputChannels;
+    const CUDA_LONG sample = inputIndex / inputSizePerSample;
+    if (sample >= batchSize)
+        return;
+
+    const CUDA_LONG inputIndexWithinSample = inputIndex % inputSizePerSample;
+    const CUDA_LONG y = inputIndexWithinSample / (inputHeight * inputChannels);   // col in input
+    const CUDA_LONG nXC = inputIndexWithinSample % (inputHeight * inputChannels); // channel + row*channels
+    const CUDA_LONG x = nXC / inputChannels;                                      // row in input
+    const CUDA_LONG c = nXC % inputChannels;                                      // channel
+    const CUDA_LONG firstOutput = (c / channelsPerGroup) * outputsPerGroup;
+    const CUDA_LONG ci = c % channelsPerGroup;
+
+    const CUDA_LONG kernelSize = kernelWidth * kernelHeight;
+    const ElemType* outGrad = outputGradientBatch + sample * outputWidth * outputHeight * outputChannels + firstOutput;
+    ElemType sum = 0;
+    for (CUDA_LONG posyInKernel = 0; posyInKernel < kernelWidth; posyInKernel++)
+    {
+        const CUDA_LONG ny = y + horizontalPad - posyInKernel;
+        if (ny < 0 || ny % horizontalSubsample != 0 || ny / horizontalSubsample >= outputWidth)
+            continue;
+        for (CUDA_LONG posxInKernel = 0; posxInKernel < kernelHeight; posxInKernel++)
+        {
+            const CUDA_LONG nx = x + verticalPad - posxInKernel;
+            if (nx < 0 || nx % verticalSubsample != 0 || nx / verticalSubsample >= outputHeight)
+                continue;
+            const ElemType* og = outGrad + (nx / verticalSubsample + (ny / horizontalSubsample) * outputHeight) * outputChannels;
+            const ElemType* w = filter + (ci * kernelSize + posxInKernel + posyInKernel * kernelHeight) * outputChannels + firstOutput;
+            for (CUDA_LONG kk = 0; kk < outputsPerGroup; kk++)
+                sum += og[kk] * w[kk];
+        }
+    }
+    inputGradientBatch[inputIndex] += sum;
+}
+
+// filterGradient += the gradient of _assignGroupedConvolutionResult() w.r.t. its filter; each block reduces one filter
+// element over all output positions of all samples
+template <class ElemType>
+__global__ void _addGroupedConvolutionGradientOfFilter(ElemType* filterGradient, const ElemType* outputGradientBatch, const ElemType* inputBatch, const CUDA_LONG batchSize,
+                                                       const CUDA_LONG inputWidth, const CUDA_LONG inputHeight, const CUDA_LONG inputChannels,
+                                                       const CUDA_LONG outputWidth, const CUDA_LONG outputHeight, const CUDA_LONG outputChannels,
+                                                       const CUDA_LONG kernelWidth, const CUDA_LONG kernelHeight, const CUDA_LONG horizontalSubsample, const CUDA_LONG verticalSubsample,
+                                                       const CUDA_LONG horizontalPad, const CUDA_LONG verticalPad, const CUDA_LONG channelsPerGroup, const CUDA_LONG outputsPerGroup)
+{
+    __shared__ ElemType partialSums[GridDim::maxThreadsPerBlock];
+
+    const CUDA_LONG filterIndex = blockIdx.x;
+    const CUDA_LONG k = filterIndex % outputChannels;
+    const CUDA_LONG col = filterIndex / outputChannels;
+    const CUDA_LONG kernelSize = kernelWidth * kernelHeight;
+    const CUDA_LONG c = (k / outputsPerGroup) * channelsPerGroup + col / kernelSize;
+    const CUDA_LONG posxInKernel = (col % kernelSize) % kernelHeight;
+    const CUDA_LONG posyInKernel = (col % kernelSize) / kernelHeight;
+
+    const CUDA_LONG positions = outputWidth * outputHeight;
+    ElemType sum = 0;
+    for (CUDA_LONG j = threadIdx.x; j < batchSize * positions; j += blockDim.x)
+    {
+        const CUDA_LONG sample = j / positions;
+        const CUDA_LONG wrow = (j % positions) % outputHeight;
+        const CUDA_LONG wcol = (j % positions) / outputHeight;
+        const CUDA_LONG inputCol = wcol * horizontalSubsample + posyInKernel - horizontalPad;
+        const CUDA_LONG inputRow = wrow * verticalSubsample + posxInKernel - verticalPad;
+        if (inputCol < 0 || inputCol >= inputWidth || inputRow < 0 || inputRow >= inputHeight)
+            continue;
+        sum += outputGradientBatch[(sample * positions + wrow + wcol * outputHeight) * outputChannels + k] *
+               inputBatch[sample * inputWidth * inputHeight * inputChannels + (inputRow + inputCol * inputHeight) * inputChannels + c];
+    }
+    partialSums[threadIdx.x] = sum;
+    __syncthreads();
+
+    for (CUDA_LONG s = blockDim.x / 2; s > 0; s /= 2)
+    {
+        if (threadIdx.x < s)
+            partialSums[threadIdx.x] += partialSums[threadIdx.x + s];
+        __syncthreads();
+    }
+    if (threadIdx.x == 0)
+        filterGradient[filterIndex] += partialSums[0];
+}
+
 template <class ElemType>
 __global__ void _assignMaxPoolingResult(ElemType* outputBatch, const ElemType* inputBatch, const CUDA_LONG batchSize, const CUDA_LONG channels,
                                         const CUDA_LONG inputWidth, const CUDA_LONG inputHeight, const CUDA_LONG inputSizePerSample,
@@ -3038,19 +3298,117 @@ __global__ void _determineBlockIds(
         blockId2Col[blockIndex] = index;
 }
 
-// backward pass from hidden layer to feature weight
+//called after _determineBlockIds, before sorting the nonzeros of a CSC matrix by the block of their row
+//each thread handles one column; the entries are numbered from the start of the first column, which handles column slices
+//blockKeys: [entry] block id of the row of the entry
+//entryIds: [entry] the entry itself, the payload of the sort
+//entryCols: [entry] the column of the entry
+__global__ void _sparseCSCEntriesByBlock(
+    const GPUSPARSE_INDEX_TYPE* rhsRows, const GPUSPARSE_INDEX_TYPE* rhsCols, const size_t numColsRhs, const GPUSPARSE_INDEX_TYPE* col2blockIds,
+    GPUSPARSE_INDEX_TYPE* blockKeys, GPUSPARSE_INDEX_TYPE* entryIds, GPUSPARSE_INDEX_TYPE* entryCols)
+{
+    const CUDA_LONG col = blockIdx.x * blockDim.x + threadIdx.x;
+    if (col >= numColsRhs)
+        return;
+
+    const CUDA_LONG base = rhsCols[0];
+    for (CUDA_LONG p = rhsCols[col]; p < rhsCols[col + 1]; p++)
+    {
+        blockKeys[p - base] = col2blockIds[rhsRows[p]];
+        entryIds[p - base] = p - base;
+        entryCols[p - base] = col;
+    }
+}
+
+//called on the entries sorted by _sparseCSCEntriesByBlock keys: blockStarts[b] is the first entry of block b, blockStarts[numBlocks] == nnz
+//each block has at least one entry, since blocks are only allocated for rows with values
+__global__ void _determineBlockStarts(
+    const GPUSPARSE_INDEX_TYPE* sortedBlockKeys, const size_t nnz, const size_t numBlocks, GPUSPARSE_INDEX_TYPE* blockStarts)
+{
+    const CUDA_LONG index = blockIdx.x * blockDim.x + threadIdx.x;
+    if (index > nnz)
+        return;
+
+    if (index == nnz)
+        blockStarts[numBlocks] = nnz;
+    else if (index == 0 || sortedBlockKeys[index] != sortedBlockKeys[index - 1])
+        blockStarts[sortedBlockKeys[index]] = index;
+}
+
+//converts the number of values of each column of a CSC matrix into its column offsets, in place: colOffsets[1..numCols] are the counts
+//one block of BlockSize threads; each thread sums a contiguous chunk of columns, and the chunk sums are scanned across the block
+template <int BlockSize>
+__global__ void _columnCountsToCSCOffsets(GPUSPARSE_INDEX_TYPE* colOffsets, const CUDA_LONG numCols)
+{
+    const CUDA_LONG chunk = (numCols + BlockSize - 1) / BlockSize;
+    const CUDA_LONG begin = min(numCols, (CUDA_LONG) threadIdx.x * chunk) + 1;
+    const CUDA_LONG end = min(numCols, (CUDA_LONG) (threadIdx.x + 1) * chunk) + 1;
+
+    GPUSPARSE_INDEX_TYPE chunkSum = 0;
+    for (CUDA_LONG j = begin; j < end; j++)
+        chunkSum += colOffsets[j];
+
+    using BlockScanT = cub::BlockScan<GPUSPARSE_INDEX_TYPE, BlockSize>;
+    __shared__ typename BlockScanT::TempStorage tmp;
+    GPUSPARSE_INDEX_TYPE offset;
+    BlockScanT(tmp).ExclusiveSum(chunkSum, offset);
+
+    for (CUDA_LONG j = begin; j < end; j++)
+    {
+        offset += colOffsets[j];
+        colOffsets[j] = offset;
+    }
+    if (threadIdx.x == 0)
+        colOffsets[0] = 0;
+}
+
+// backward pass from hidden layer to feature weight, segment-reduce version of _denseMulSparseCSCTransposeToSparseBlockCol2
 //result (sparse BlockCol)= alpha * (lhs (dense) X rhs^T (sparse CSC)
-//assume resultValues are 0-initialized
+//the nonzeros of rhs are grouped by result block (rhs row), see _determineBlockStarts; each CUDA block computes one result
+//column, each thread sums the rows lhsRow, lhsRow + blockDim.x, ..., so every result value is written once, without atomics
+//resultValues need not be initialized
 template <class ElemType>
-__global__ void _denseMulSparseCSCTransposeToSparseBlockCol2(
+__global__ void _denseMulSparseCSCTransposeToSparseBlockColSegmented(
     const ElemType alpha,
     const ElemType* lhsValues,
     const size_t numRowsLhs,
-    const size_t numColsRhs,
     const ElemType* rhsNZValues,
-    const GPUSPARSE_INDEX_TYPE* rhsRows,
     const GPUSPARSE_INDEX_TYPE* rhsCols,
-    const GPUSPARSE_INDEX_TYPE* col2blockIds,
+    const GPUSPARSE_INDEX_TYPE* sortedEntryIds,
+    const GPUSPARSE_INDEX_TYPE* entryCols,
+    const GPUSPARSE_INDEX_TYPE* blockStarts,
+    ElemType* resultValues)
+{
+    const CUDA_LONG resultCol = blockIdx.x;
+    const CUDA_LONG start = blockStarts[resultCol];
+    const CUDA_LONG end = blockStarts[resultCol + 1];
+    const CUDA_LONG base = rhsCols[0];
+
+    for (CUDA_LONG lhsRow = threadIdx.x; lhsRow < numRowsLhs; lhsRow += blockDim.x) // resultRow == lhsRow
+    {
+        ElemType sum = 0;
+        for (CUDA_LONG s = start; s < end; s++)
+        {
+            CUDA_LONG entry = sortedEntryIds[s];
+            sum += lhsValues[IDX2C(lhsRow, entryCols[entry], numRowsLhs)] * rhsNZValues[base + entry]; // lhsCol == rhsCol
+        }
+        resultValues[IDX2C(lhsRow, resultCol, numRowsLhs)] = alpha * sum;
+    }
+}
+
+// backward pass from hidden layer to feature weight
+//result (sparse BlockCol)= alpha * (lhs (dense) X rhs^T (sparse CSC)
+//assume resultValues are 0-initialized
+template <class ElemType>
+__global__ void _denseMulSparseCSCTransposeToSparseBlockCol2(
+    const ElemType alpha,
+    const ElemType* lhsValues,
+    const size_t numRowsLhs,
+    const size_t numColsRhs,
+    const ElemType* rhsNZValues,
+    const GPUSPARSE_INDEX_TYPE* rhsRows,
+    const GPUSPARSE_INDEX_TYPE* rhsCols,
+    const GPUSPARSE_INDEX_TYPE* col2blockIds,
     ElemType* resultValues)
 {
     const CUDA_LONG index = blockIdx.x * blockDim.x + threadIdx.x;
@@ -3518,6 +3876,669 @@ __global__ void _assignSoftmaxSum(
         c[0] = -partials[0];
 }
 
+// see CPUMatrix<ElemType>::InplaceSampleFromCDF(): the first class k with cdf[k] > a[id], by binary search
+template <class ElemType>
+__global__ void _inplaceSampleFromCDF(
+    ElemType* a,
+    const CUDA_LONG N,
+    const ElemType* cdf,
+    const CUDA_LONG numClasses)
+{
+    CUDA_LONG id = blockDim.x * blockIdx.x + threadIdx.x;
+    if (id >= N)
+        return;
+    const ElemType u = a[id];
+    CUDA_LONG lo = 0;
+    CUDA_LONG hi = numClasses - 1; // the last class if the cdf falls short of 1 by rounding
+    while (lo < hi)
+    {
+        CUDA_LONG mid = (lo + hi) / 2;
+        if (cdf[mid] > u)
+            hi = mid;
+        else
+            lo = mid + 1;
+    }
+    a[id] = (ElemType) lo;
+}
+
+// see CPUMatrix<ElemType>::AssignSampledSoftmaxLogits()
+template <class ElemType>
+__global__ void _assignSampledSoftmaxLogits(
+    ElemType* us,
+    const ElemType* trueLogits,
+    const ElemType* sampledLogits,
+    const ElemType* candidateBiases,
+    const ElemType* candidateIds,
+    const CUDA_LONG numSamples,
+    const CUDA_LONG N) // (numSamples + 1) * number of columns
+{
+    CUDA_LONG id = blockDim.x * blockIdx.x + threadIdx.x;
+    if (id >= N)
+        return;
+    const CUDA_LONG i = id % (numSamples + 1);
+    const CUDA_LONG t = id / (numSamples + 1);
+    if (i == 0)
+        us[id] = trueLogits[t] + candidateBiases[numSamples + t];
+    else if (candidateIds[i - 1] == candidateIds[numSamples + t]) // an accidental hit of the label
+        us[id] = (ElemType) -1e30;
+    else
+        us[id] = sampledLogits[IDX2C(i - 1, t, numSamples)] + candidateBiases[i - 1];
+}
+
+// see CPUMatrix<ElemType>::AssignAliasSamplesOf()
+template <class ElemType>
+__global__ void _assignAliasSamples(
+    ElemType* us,
+    const ElemType* uniforms, // [2 x N]
+    const ElemType* aliasProbs,
+    const ElemType* aliases,
+    const CUDA_LONG numClasses,
+    const CUDA_LONG N)
+{
+    CUDA_LONG id = blockDim.x * blockIdx.x + threadIdx.x;
+    if (id >= N)
+        return;
+    CUDA_LONG k = (CUDA_LONG)(uniforms[2 * id] * numClasses);
+    if (k >= numClasses)
+        k = numClasses - 1;
+    us[id] = uniforms[2 * id + 1] < aliasProbs[k] ? (ElemType) k : aliases[k];
+}
+
+// NCE loss of frame t, see Matrix<ElemType>::AssignNCELossOf()
+// Each score is the dot product of the hidden vector with the column of the weights of its word, gathered by a group of
+// NCE_GROUP_SIZE threads (threadIdx.x) and reduced in shared memory; the NCE_GROUPS_PER_BLOCK groups (threadIdx.y) of a block
+// take the scores of the frame in turn.
+#define NCE_GROUP_SIZE 32
+#define NCE_GROUPS_PER_BLOCK 4
+template <class ElemType>
+__global__ void _assignNCELoss(
+    ElemType* us,             // [1 x T]
+    ElemType* scoreGradients, // [(K+1) x T]
+    const ElemType* labelIds,
+    const ElemType* noiseIds,
+    const ElemType* hidden,
+    const ElemType* weights,
+    const ElemType* bias,
+    const ElemType* logNoiseCounts,
+    const CUDA_LONG numNoise,
+    const CUDA_LONG dim,
+    const CUDA_LONG numCols)
+{
+    __shared__ ElemType partials[NCE_GROUPS_PER_BLOCK][NCE_GROUP_SIZE];
+    __shared__ ElemType losses[NCE_GROUPS_PER_BLOCK];
+
+    for (CUDA_LONG t = blockIdx.x; t < numCols; t += gridDim.x)
+    {
+        const ElemType* h = hidden + IDX2C(0, t, dim);
+        ElemType loss = 0;
+        for (CUDA_LONG j0 = 0; j0 <= numNoise; j0 += NCE_GROUPS_PER_BLOCK)
+        {
+            const CUDA_LONG j = j0 + threadIdx.y;
+            const CUDA_LONG w = j > numNoise ? 0 : (CUDA_LONG)(j == 0 ? labelIds[t] : noiseIds[j - 1]);
+            ElemType dot = 0;
+            if (j <= numNoise)
+            {
+                const ElemType* e = weights + IDX2C(0, w, dim);
+                for (CUDA_LONG d = threadIdx.x; d < dim; d += NCE_GROUP_SIZE)
+                    dot += h[d] * e[d];
+            }
+            partials[threadIdx.y][threadIdx.x] = dot;
+            __syncthreads();
+            for (int stride = NCE_GROUP_SIZE / 2; stride > 0; stride /= 2)
+            {
+                if (threadIdx.x < stride)
+                    partials[threadIdx.y][threadIdx.x] += partials[threadIdx.y][threadIdx.x + stride];
+                __syncthreads();
+            }
+            if (threadIdx.x == 0 && j <= numNoise)
+            {
+                const ElemType s = partials[threadIdx.y][0] + bias[w] - logNoiseCounts[w];
+                const ElemType z = j == 0 ? -s : s; // softplus(-s) for the label, softplus(s) for the noise
+                loss += (z > 0 ? z : 0) + log_(1 + exp_(-fabs_(z)));
+                const ElemType sigmoid = 1 / (1 + exp_(-s));
+                scoreGradients[IDX2C(j, t, numNoise + 1)] = j == 0 ? sigmoid - 1 : sigmoid;
+            }
+            __syncthreads();
+        }
+        if (threadIdx.x == 0)
+            losses[threadIdx.y] = loss;
+        __syncthreads();
+        if (threadIdx.x == 0 && threadIdx.y == 0)
+        {
+            ElemType sum = 0;
+            for (int g = 0; g < NCE_GROUPS_PER_BLOCK; g++)
+                sum += losses[g];
+            us[t] = sum;
+        }
+        __syncthreads();
+    }
+}
+
+// us(d, t) += sum_j scoreGradients(j, t) weights(d, w) over the label and noise words w of frame t; a thread per d, blockIdx.y strides over the frames
+template <class ElemType>
+__global__ void _addNCEHiddenGradient(
+    ElemType* us, // [D x T]
+    const ElemType* scoreGradients,
+    const ElemType* labelIds,
+    const ElemType* noiseIds,
+    const ElemType* weights,
+    const CUDA_LONG numNoise,
+    const CUDA_LONG dim,
+    const CUDA_LONG numCols)
+{
+    const CUDA_LONG d = blockDim.x * blockIdx.x + threadIdx.x;
+    if (d >= dim)
+        return;
+    for (CUDA_LONG t = blockIdx.y; t < numCols; t += gridDim.y)
+    {
+        const ElemType* g = scoreGradients + IDX2C(0, t, numNoise + 1);
+        ElemType sum = g[0] * weights[IDX2C(d, (CUDA_LONG) labelIds[t], dim)];
+        for (CUDA_LONG j = 0; j < numNoise; j++)
+            sum += g[j + 1] * weights[IDX2C(d, (CUDA_LONG) noiseIds[j], dim)];
+        us[IDX2C(d, t, dim)] += sum;
+    }
+}
+
+// GMM log-likelihood of sample t, see Matrix<ElemType>::AssignGMMLogLikelihoodOf()
+// The *Stride arguments are 0 for parameters shared by all samples.
+template <class ElemType>
+__global__ void _assignGMMLogLikelihood(
+    ElemType* us, // [1 x T]
+    const ElemType* logPrior, const CUDA_LONG priorStride,
+    const ElemType* mean, const CUDA_LONG meanStride,
+    const ElemType* logStddev, const CUDA_LONG stddevStride,
+    const ElemType* feature,
+    ElemType* posterior,
+    ElemType* normedDeviation,
+    ElemType* normedDeviationVectors,
+    const CUDA_LONG numComponents,
+    const CUDA_LONG featureDim,
+    const CUDA_LONG numSamples)
+{
+    CUDA_LONG t = blockDim.x * blockIdx.x + threadIdx.x;
+    if (t >= numSamples)
+        return;
+    const ElemType* x = feature + t * featureDim;
+    ElemType* logLikelihoods = posterior + t * numComponents;
+    const ElemType logNormalizer = (ElemType) 0.5 * featureDim * log_((ElemType) 6.283185307179586);
+    ElemType maxLogLikelihood = logLikelihoods[0]; // set in the first iteration
+    for (CUDA_LONG c = 0; c < numComponents; c++)
+    {
+        const ElemType* mu = mean + t * meanStride + c * featureDim;
+        ElemType* deviation = normedDeviationVectors + (t * numComponents + c) * featureDim;
+        const ElemType logSigma = logStddev[t * stddevStride + c];
+        const ElemType invVariance = exp_(-2 * logSigma);
+        ElemType sqrDistance = 0;
+        for (CUDA_LONG i = 0; i < featureDim; i++)
+        {
+            const ElemType d = x[i] - mu[i];
+            sqrDistance += d * d;
+            deviation[i] = d * invVariance;
+        }
+        normedDeviation[t * numComponents + c] = sqrDistance * invVariance;
+        logLikelihoods[c] = logPrior[t * priorStride + c] - sqrDistance * invVariance / 2 - featureDim * logSigma - logNormalizer;
+        if (c == 0 || logLikelihoods[c] > maxLogLikelihood)
+            maxLogLikelihood = logLikelihoods[c];
+    }
+    ElemType sum = 0;
+    for (CUDA_LONG c = 0; c < numComponents; c++)
+        sum += exp_(logLikelihoods[c] - maxLogLikelihood);
+    const ElemType logSum = maxLogLikelihood + log_(sum);
+    for (CUDA_LONG c = 0; c < numComponents; c++)
+        logLikelihoods[c] = exp_(logLikelihoods[c] - logSum);
+    us[t] = logSum;
+}
+
+// us += gradient of the GMM log-likelihood w.r.t. input 'inputIndex', see Matrix<ElemType>::AddGMMLogLikelihoodGradient()
+// One thread per element of 'us', or per row if 'us' is a single column that sums over all samples.
+template <class ElemType>
+__global__ void _addGMMLogLikelihoodGradient(
+    ElemType* us,
+    const CUDA_LONG inputIndex,
+    const ElemType* gradient, // [1 x T]
+    const ElemType* logPrior, const CUDA_LONG priorStride,
+    const ElemType* posterior,
+    const ElemType* normedDeviation,
+    const ElemType* normedDeviationVectors,
+    const CUDA_LONG numComponents,
+    const CUDA_LONG featureDim,
+    const CUDA_LONG numRows,
+    const CUDA_LONG numSamples,
+    const bool sumOverSamples,
+    const CUDA_LONG N)
+{
+    CUDA_LONG id = blockDim.x * blockIdx.x + threadIdx.x;
+    if (id >= N)
+        return;
+    const CUDA_LONG r = id % numRows;
+    const CUDA_LONG tBegin = sumOverSamples ? 0 : id / numRows;
+    const CUDA_LONG tEnd = sumOverSamples ? numSamples : tBegin + 1;
+    ElemType sum = 0;
+    for (CUDA_LONG t = tBegin; t < tEnd; t++)
+    {
+        const ElemType* post = posterior + t * numComponents;
+        const ElemType* deviation = normedDeviationVectors + t * numComponents * featureDim;
+        ElemType value;
+        if (inputIndex == 0) // unnormed prior, through the softmax
+            value = post[r] - exp_(logPrior[t * priorStride + r]);
+        else if (inputIndex == 1) // mean
+            value = post[r / featureDim] * deviation[r];
+        else if (inputIndex == 2) // logStddev
+            value = post[r] * (normedDeviation[t * numComponents + r] - featureDim);
+        else // feature
+        {
+            value = 0;
+            for (CUDA_LONG c = 0; c < numComponents; c++)
+                value -= post[c] * deviation[c * featureDim + r];
+        }
+        sum += gradient[t] * value;
+    }
+    us[id] += sum;
+}
+
+// softmax cross entropy of one column per block (512 threads), see Matrix<ElemType>::AssignCrossEntropyWithSoftmaxOf()
+// Each thread keeps a running maximum and the sum of exponentials relative to it; the pairs are then merged.
+template <class ElemType>
+__global__ void _assignCrossEntropyWithSoftmax(
+    ElemType* us,        // [1 x 1], must be zero
+    ElemType* logSumExp, // [1 x T]
+    const ElemType* labels,
+    const ElemType* logits,
+    const CUDA_LONG numRows)
+{
+    __shared__ ElemType partialMax[512];
+    __shared__ ElemType partialSum[512];
+    __shared__ ElemType partialLabelDot[512];
+    __shared__ ElemType partialLabelSum[512];
+
+    ElemType maxValue = (ElemType) LZERO;
+    ElemType sum = 0;
+    ElemType labelDot = 0;
+    ElemType labelSum = 0;
+    for (CUDA_LONG i = threadIdx.x; i < numRows; i += blockDim.x)
+    {
+        const ElemType x = logits[IDX2C(i, blockIdx.x, numRows)];
+        const ElemType y = labels[IDX2C(i, blockIdx.x, numRows)];
+        if (x > maxValue)
+        {
+            sum *= exp_(maxValue - x);
+            maxValue = x;
+        }
+        sum += exp_(x - maxValue);
+        if (y != 0)
+        {
+            labelDot += y * x;
+            labelSum += y;
+        }
+    }
+    partialMax[threadIdx.x] = maxValue;
+    partialSum[threadIdx.x] = sum;
+    partialLabelDot[threadIdx.x] = labelDot;
+    partialLabelSum[threadIdx.x] = labelSum;
+    __syncthreads();
+
+    for (CUDA_LONG stride = blockDim.x / 2; stride > 0; stride /= 2)
+    {
+        if (threadIdx.x < stride)
+        {
+            const ElemType otherMax = partialMax[threadIdx.x + stride];
+            const ElemType newMax = max(partialMax[threadIdx.x], otherMax);
+            partialSum[threadIdx.x] = partialSum[threadIdx.x] * exp_(partialMax[threadIdx.x] - newMax) + partialSum[threadIdx.x + stride] * exp_(otherMax - newMax);
+            partialMax[threadIdx.x] = newMax;
+            partialLabelDot[threadIdx.x] += partialLabelDot[threadIdx.x + stride];
+            partialLabelSum[threadIdx.x] += partialLabelSum[threadIdx.x + stride];
+        }
+        __syncthreads();
+    }
+
+    if (threadIdx.x == 0)
+    {
+        const ElemType lse = partialMax[0] + log_(partialSum[0]);
+        logSumExp[blockIdx.x] = lse;
+        if (partialLabelSum[0] != 0)
+            atomicAdd(us, partialLabelSum[0] * lse - partialLabelDot[0]);
+    }
+}
+
+// us += gradient of the softmax cross entropy w.r.t. the labels or the logits, see Matrix<ElemType>::AddCrossEntropyWithSoftmaxGradient()
+template <class ElemType>
+__global__ void _addCrossEntropyWithSoftmaxGradient(
+    ElemType* us,
+    const bool gradientOfLabels,
+    const ElemType* gradient, // [1 x 1]
+    const ElemType* labels,
+    const ElemType* logits,
+    const ElemType* logSumExp, // [1 x T]
+    const CUDA_LONG numRows,
+    const CUDA_LONG N)
+{
+    CUDA_LONG id = blockDim.x * blockIdx.x + threadIdx.x;
+    if (id >= N)
+        return;
+    const ElemType logSoftmax = logits[id] - logSumExp[id / numRows];
+    if (gradientOfLabels)
+        us[id] -= gradient[0] * logSoftmax;
+    else
+        us[id] += gradient[0] * (exp_(logSoftmax) - labels[id]);
+}
+
+// Viterbi decoding of one sequence per block, see Matrix<ElemType>::AssignViterbiPathOf()
+// 'us' must be zero; the threads of the block compute the labels of a frame in parallel, then the first thread traces the best path back.
+template <class ElemType>
+__global__ void _assignViterbiPath(
+    ElemType* us,        // [K x (T*S)] one-hot best paths
+    ElemType* alpha,     // [K x (T*S)]
+    ElemType* backtrace, // [K x (T*S)]
+    const ElemType* posScores,
+    const ElemType* pairScores, // [K x K]
+    const ElemType* sequences,  // [3 x N] (s, tBegin, tEnd)
+    const CUDA_LONG numParallelSequences,
+    const CUDA_LONG numLabels,
+    const int startLabel,
+    const int endLabel)
+{
+    const CUDA_LONG s = (CUDA_LONG) sequences[3 * blockIdx.x];
+    const CUDA_LONG tBegin = (CUDA_LONG) sequences[3 * blockIdx.x + 1];
+    const CUDA_LONG tEnd = (CUDA_LONG) sequences[3 * blockIdx.x + 2];
+    if (tEnd <= tBegin)
+        return;
+
+    for (CUDA_LONG t = tBegin; t < tEnd; t++)
+    {
+        const CUDA_LONG col = t * numParallelSequences + s;
+        for (CUDA_LONG k = threadIdx.x; k < numLabels; k += blockDim.x)
+        {
+            ElemType best = (ElemType) LZERO;
+            CUDA_LONG bestLabel = 0;
+            if (t == tBegin)
+            {
+                bestLabel = startLabel < 0 ? k : startLabel;
+                if (bestLabel == k)
+                    best = 0;
+            }
+            else
+            {
+                for (CUDA_LONG j = 0; j < numLabels; j++)
+                {
+                    const ElemType score = alpha[IDX2C(j, col - numParallelSequences, numLabels)] + pairScores[IDX2C(k, j, numLabels)];
+                    if (score > best)
+                    {
+                        best = score;
+                        bestLabel = j;
+                    }
+                }
+            }
+            alpha[IDX2C(k, col, numLabels)] = best + posScores[IDX2C(k, col, numLabels)];
+            backtrace[IDX2C(k, col, numLabels)] = (ElemType) bestLabel;
+        }
+        __syncthreads(); // frame t is complete
+    }
+    if (threadIdx.x != 0)
+        return;
+
+    CUDA_LONG col = (tEnd - 1) * numParallelSequences + s;
+    CUDA_LONG label = endLabel;
+    if (label < 0)
+    {
+        label = 0;
+        for (CUDA_LONG k = 1; k < numLabels; k++)
+            if (alpha[IDX2C(k, col, numLabels)] > alpha[IDX2C(label, col, numLabels)])
+                label = k;
+    }
+    us[IDX2C(label, col, numLabels)] = 1;
+    for (CUDA_LONG t = tEnd - 1; t > tBegin; t--, col -= numParallelSequences)
+    {
+        label = (CUDA_LONG) backtrace[IDX2C(label, col, numLabels)];
+        us[IDX2C(label, col - numParallelSequences, numLabels)] = 1;
+    }
+}
+
+// class-based softmax cross entropy, see Matrix<ElemType>::AssignClassBasedCrossEntropyWithSoftmaxOf()
+// The products between the words [wordBegin, wordEnd) of a class and the frames of its bucket are computed in tiles of
+// CLASS_BASED_TILE_DIM x CLASS_BASED_TILE_DIM threads held in shared memory. blockIdx.y is the bucket, and the blocks along x
+// stride over the tiles of their bucket, so that all classes of a minibatch take one launch. Each frame belongs to one bucket
+// and each word to one class, so no two blocks write the same output.
+#define CLASS_BASED_TILE_DIM 16
+
+// gradient of the criterion w.r.t. the logit of word k of the class of frame t: softmax - labels
+template <class ElemType>
+__device__ __forceinline__ ElemType _classBasedLogitGradient(const ElemType gradient, const ElemType* softmax, const ElemType* labels,
+                                                             const CUDA_LONG k, const CUDA_LONG t, const CUDA_LONG maxClassSize, const CUDA_LONG wordBegin)
+{
+    const bool isWord = k == (CUDA_LONG) labels[IDX2C(0, t, 4)] - wordBegin;
+    return gradient * (softmax[IDX2C(k, t, maxClassSize)] - (isWord ? 1 : 0));
+}
+
+// logits(k, t) = weight(:, wordBegin + k)^T input(:, t) for the frames t of each bucket
+template <class ElemType>
+__global__ void _classBasedLogits(
+    ElemType* logits, // [maxClassSize x T]
+    const ElemType* input,
+    const ElemType* weight,
+    const ElemType* buckets, // [4 x B]
+    const ElemType* frames,  // [1 x N]
+    const CUDA_LONG dim,
+    const CUDA_LONG maxClassSize)
+{
+    __shared__ ElemType weightTile[CLASS_BASED_TILE_DIM][CLASS_BASED_TILE_DIM + 1]; // [word][d]
+    __shared__ ElemType inputTile[CLASS_BASED_TILE_DIM][CLASS_BASED_TILE_DIM + 1];  // [frame][d]
+
+    const CUDA_LONG wordBegin = (CUDA_LONG) buckets[IDX2C(0, blockIdx.y, 4)];
+    const CUDA_LONG numWords = (CUDA_LONG) buckets[IDX2C(1, blockIdx.y, 4)] - wordBegin;
+    const CUDA_LONG frameBegin = (CUDA_LONG) buckets[IDX2C(2, blockIdx.y, 4)];
+    const CUDA_LONG numFrames = (CUDA_LONG) buckets[IDX2C(3, blockIdx.y, 4)] - frameBegin;
+    const CUDA_LONG wordTiles = (numWords + CLASS_BASED_TILE_DIM - 1) / CLASS_BASED_TILE_DIM;
+    const CUDA_LONG numTiles = wordTiles * ((numFrames + CLASS_BASED_TILE_DIM - 1) / CLASS_BASED_TILE_DIM);
+    for (CUDA_LONG tile = blockIdx.x; tile < numTiles; tile += gridDim.x)
+    {
+        const CUDA_LONG k0 = (tile % wordTiles) * CLASS_BASED_TILE_DIM;
+        const CUDA_LONG n0 = (tile / wordTiles) * CLASS_BASED_TILE_DIM;
+        const CUDA_LONG kLoad = k0 + threadIdx.y;
+        const CUDA_LONG nLoad = n0 + threadIdx.y;
+        const CUDA_LONG tLoad = nLoad < numFrames ? (CUDA_LONG) frames[frameBegin + nLoad] : 0;
+        ElemType sum = 0;
+        for (CUDA_LONG d0 = 0; d0 < dim; d0 += CLASS_BASED_TILE_DIM)
+        {
+            const CUDA_LONG d = d0 + threadIdx.x;
+            weightTile[threadIdx.y][threadIdx.x] = kLoad < numWords && d < dim ? weight[IDX2C(d, wordBegin + kLoad, dim)] : 0;
+            inputTile[threadIdx.y][threadIdx.x] = nLoad < numFrames && d < dim ? input[IDX2C(d, tLoad, dim)] : 0;
+            __syncthreads();
+            for (int i = 0; i < CLASS_BASED_TILE_DIM; i++)
+                sum += weightTile[threadIdx.x][i] * inputTile[threadIdx.y][i];
+            __syncthreads();
+        }
+        const CUDA_LONG k = k0 + threadIdx.x;
+        const CUDA_LONG n = n0 + threadIdx.y;
+        if (k < numWords && n < numFrames)
+            logits[IDX2C(k, (CUDA_LONG) frames[frameBegin + n], maxClassSize)] = sum;
+    }
+}
+
+// softmax over the words of the class of each frame, in place, one frame per block; the criterion of all frames is accumulated atomically
+template <class ElemType>
+__global__ void _classBasedSoftmax(
+    ElemType* us,      // [1 x 1], must be zero
+    ElemType* softmax, // [maxClassSize x T], holding the logits
+    const ElemType* labels,
+    const ElemType* classLogSoftmax,
+    const ElemType* frames,
+    const CUDA_LONG numFrames,
+    const CUDA_LONG maxClassSize,
+    const CUDA_LONG numClasses)
+{
+    __shared__ ElemType partialMax[GridDim::maxThreadsPerBlock];
+    __shared__ ElemType partialSum[GridDim::maxThreadsPerBlock];
+
+    for (CUDA_LONG n = blockIdx.x; n < numFrames; n += gridDim.x)
+    {
+        const CUDA_LONG t = (CUDA_LONG) frames[n];
+        const CUDA_LONG wordBegin = (CUDA_LONG) labels[IDX2C(2, t, 4)];
+        const CUDA_LONG numWords = (CUDA_LONG) labels[IDX2C(3, t, 4)] - wordBegin;
+        ElemType* y = softmax + IDX2C(0, t, maxClassSize);
+
+        ElemType maxV = 0;
+        ElemType sum = 0;
+        for (CUDA_LONG k = threadIdx.x; k < numWords; k += blockDim.x)
+            _mergeMaxAndSumExp(maxV, sum, y[k], (ElemType) 1);
+        partialMax[threadIdx.x] = maxV;
+        partialSum[threadIdx.x] = sum;
+        __syncthreads();
+        for (int stride = blockDim.x / 2; stride > 0; stride /= 2)
+        {
+            if (threadIdx.x < stride)
+            {
+                _mergeMaxAndSumExp(maxV, sum, partialMax[threadIdx.x + stride], partialSum[threadIdx.x + stride]);
+                partialMax[threadIdx.x] = maxV;
+                partialSum[threadIdx.x] = sum;
+            }
+            __syncthreads();
+        }
+
+        const ElemType logSum = partialMax[0] + log_(partialSum[0]);
+        if (threadIdx.x == 0)
+        {
+            const ElemType wordLogSoftmax = y[(CUDA_LONG) labels[IDX2C(0, t, 4)] - wordBegin] - logSum;
+            atomicAdd(us, -wordLogSoftmax - classLogSoftmax[IDX2C((CUDA_LONG) labels[IDX2C(1, t, 4)], t, numClasses)]);
+        }
+        __syncthreads();
+        for (CUDA_LONG k = threadIdx.x; k < numWords; k += blockDim.x)
+            y[k] = exp_(y[k] - logSum);
+        __syncthreads();
+    }
+}
+
+// us(:, t) += sum_k weight(:, wordBegin + k) gradient(k, t) for the frames t of each bucket
+template <class ElemType>
+__global__ void _addClassBasedInputGradient(
+    ElemType* us, // [D x T]
+    const ElemType* gradient,
+    const ElemType* labels,
+    const ElemType* weight,
+    const ElemType* softmax,
+    const ElemType* buckets,
+    const ElemType* frames,
+    const CUDA_LONG dim,
+    const CUDA_LONG maxClassSize)
+{
+    __shared__ ElemType weightTile[CLASS_BASED_TILE_DIM][CLASS_BASED_TILE_DIM + 1];   // [word][d]
+    __shared__ ElemType gradientTile[CLASS_BASED_TILE_DIM][CLASS_BASED_TILE_DIM + 1]; // [frame][word]
+
+    const CUDA_LONG wordBegin = (CUDA_LONG) buckets[IDX2C(0, blockIdx.y, 4)];
+    const CUDA_LONG numWords = (CUDA_LONG) buckets[IDX2C(1, blockIdx.y, 4)] - wordBegin;
+    const CUDA_LONG frameBegin = (CUDA_LONG) buckets[IDX2C(2, blockIdx.y, 4)];
+    const CUDA_LONG numFrames = (CUDA_LONG) buckets[IDX2C(3, blockIdx.y, 4)] - frameBegin;
+    const CUDA_LONG dimTiles = (dim + CLASS_BASED_TILE_DIM - 1) / CLASS_BASED_TILE_DIM;
+    const CUDA_LONG numTiles = dimTiles * ((numFrames + CLASS_BASED_TILE_DIM - 1) / CLASS_BASED_TILE_DIM);
+    for (CUDA_LONG tile = blockIdx.x; tile < numTiles; tile += gridDim.x)
+    {
+        const CUDA_LONG d = (tile % dimTiles) * CLASS_BASED_TILE_DIM + threadIdx.x;
+        const CUDA_LONG n = (tile / dimTiles) * CLASS_BASED_TILE_DIM + threadIdx.y;
+        const CUDA_LONG t = n < numFrames ? (CUDA_LONG) frames[frameBegin + n] : 0;
+        ElemType sum = 0;
+        for (CUDA_LONG k0 = 0; k0 < numWords; k0 += CLASS_BASED_TILE_DIM)
+        {
+            const CUDA_LONG kWeight = k0 + threadIdx.y;
+            const CUDA_LONG kGradient = k0 + threadIdx.x;
+            weightTile[threadIdx.y][threadIdx.x] = kWeight < numWords && d < dim ? weight[IDX2C(d, wordBegin + kWeight, dim)] : 0;
+            gradientTile[threadIdx.y][threadIdx.x] = n < numFrames && kGradient < numWords ? _classBasedLogitGradient(gradient[0], softmax, labels, kGradient, t, maxClassSize, wordBegin) : 0;
+            __syncthreads();
+            for (int i = 0; i < CLASS_BASED_TILE_DIM; i++)
+                sum += weightTile[i][threadIdx.x] * gradientTile[threadIdx.y][i];
+            __syncthreads();
+        }
+        if (d < dim && n < numFrames)
+            us[IDX2C(d, t, dim)] += sum;
+    }
+}
+
+// us(:, wordBegin + k) += sum_t input(:, t) gradient(k, t) over the frames t of each bucket
+template <class ElemType>
+__global__ void _addClassBasedWeightGradient(
+    ElemType* us, // [D x V]
+    const ElemType* gradient,
+    const ElemType* labels,
+    const ElemType* input,
+    const ElemType* softmax,
+    const ElemType* buckets,
+    const ElemType* frames,
+    const CUDA_LONG dim,
+    const CUDA_LONG maxClassSize)
+{
+    __shared__ ElemType inputTile[CLASS_BASED_TILE_DIM][CLASS_BASED_TILE_DIM + 1];    // [frame][d]
+    __shared__ ElemType gradientTile[CLASS_BASED_TILE_DIM][CLASS_BASED_TILE_DIM + 1]; // [frame][word]
+
+    const CUDA_LONG wordBegin = (CUDA_LONG) buckets[IDX2C(0, blockIdx.y, 4)];
+    const CUDA_LONG numWords = (CUDA_LONG) buckets[IDX2C(1, blockIdx.y, 4)] - wordBegin;
+    const CUDA_LONG frameBegin = (CUDA_LONG) buckets[IDX2C(2, blockIdx.y, 4)];
+    const CUDA_LONG numFrames = (CUDA_LONG) buckets[IDX2C(3, blockIdx.y, 4)] - frameBegin;
+    const CUDA_LONG dimTiles = (dim + CLASS_BASED_TILE_DIM - 1) / CLASS_BASED_TILE_DIM;
+    const CUDA_LONG numTiles = dimTiles * ((numWords + CLASS_BASED_TILE_DIM - 1) / CLASS_BASED_TILE_DIM);
+    for (CUDA_LONG tile = blockIdx.x; tile < numTiles; tile += gridDim.x)
+    {
+        const CUDA_LONG d0 = (tile % dimTiles) * CLASS_BASED_TILE_DIM;
+        const CUDA_LONG k0 = (tile / dimTiles) * CLASS_BASED_TILE_DIM;
+        ElemType sum = 0;
+        for (CUDA_LONG n0 = 0; n0 < numFrames; n0 += CLASS_BASED_TILE_DIM)
+        {
+            const CUDA_LONG nLoad = n0 + threadIdx.y;
+            const CUDA_LONG tLoad = nLoad < numFrames ? (CUDA_LONG) frames[frameBegin + nLoad] : 0;
+            const CUDA_LONG d = d0 + threadIdx.x;
+            const CUDA_LONG k = k0 + threadIdx.x;
+            inputTile[threadIdx.y][threadIdx.x] = nLoad < numFrames && d < dim ? input[IDX2C(d, tLoad, dim)] : 0;
+            gradientTile[threadIdx.y][threadIdx.x] = nLoad < numFrames && k < numWords ? _classBasedLogitGradient(gradient[0], softmax, labels, k, tLoad, maxClassSize, wordBegin) : 0;
+            __syncthreads();
+            for (int i = 0; i < CLASS_BASED_TILE_DIM; i++)
+                sum += inputTile[i][threadIdx.x] * gradientTile[i][threadIdx.y];
+            __syncthreads();
+        }
+        const CUDA_LONG d = d0 + threadIdx.x;
+        const CUDA_LONG k = k0 + threadIdx.y;
+        if (d < dim && k < numWords)
+            us[IDX2C(d, wordBegin + k, dim)] += sum;
+    }
+}
+
+// us(c, t) += gradient * (class softmax - labels) for the frames t, one thread per (class, frame)
+template <class ElemType>
+__global__ void _addClassBasedClassGradient(
+    ElemType* us, // [C x T]
+    const ElemType* gradient,
+    const ElemType* labels,
+    const ElemType* classLogSoftmax,
+    const ElemType* frames,
+    const CUDA_LONG numClasses,
+    const CUDA_LONG N)
+{
+    CUDA_LONG id = blockDim.x * blockIdx.x + threadIdx.x;
+    if (id >= N)
+        return;
+    const CUDA_LONG c = id % numClasses;
+    const CUDA_LONG t = (CUDA_LONG) frames[id / numClasses];
+    const bool isClass = c == (CUDA_LONG) labels[IDX2C(1, t, 4)];
+    us[IDX2C(c, t, numClasses)] += gradient[0] * (exp_(classLogSoftmax[IDX2C(c, t, numClasses)]) - (isClass ? 1 : 0));
+}
+
+// the CSC arrays of a [numRows x N] matrix with a single 1 in each column j, in row ids[j]
+template <class ElemType>
+__global__ void _assignOneHotColumns(
+    const ElemType* ids,
+    const CUDA_LONG N,
+    const CUDA_LONG numRows,
+    ElemType* values,
+    GPUSPARSE_INDEX_TYPE* rowIndices,
+    GPUSPARSE_INDEX_TYPE* colStarts)
+{
+    CUDA_LONG j = blockDim.x * blockIdx.x + threadIdx.x;
+    if (j >= N)
+        return;
+    CUDA_LONG row = (CUDA_LONG) ids[j];
+    values[j] = 1;
+    rowIndices[j] = (GPUSPARSE_INDEX_TYPE) (row < 0 ? 0 : row >= numRows ? numRows - 1 : row);
+    colStarts[j] = (GPUSPARSE_INDEX_TYPE) j;
+    if (j == N - 1)
+        colStarts[N] = (GPUSPARSE_INDEX_TYPE) N;
+}
+
 template <class ElemType>
 __global__ void _assignNoiseContrastiveEstimation(
     const ElemType* val,
@@ -3847,6 +4868,89 @@ __global__ void _normalGradForSparseBlock(
     lhsValues[index] = rhs[IDX2C(row, col, numRows)];
 }
 
+// lazy updates of the columns of block-column gradients, see Matrix::LazyNormalGrad(); one thread per element of the blocks
+// The state c has numRows + 1 rows, the last one holds the step of the last update of each column. It is only advanced
+// by _lazySparseSetSteps() afterwards, since all threads of a column read it.
+template <class ElemType>
+__global__ void _lazyNormalGradForSparseBlock(
+    const size_t step,
+    const size_t numRows,
+    const size_t numBlocks,
+    const ElemType* gradients, // block values
+    const GPUSPARSE_INDEX_TYPE* blockIds,
+    ElemType* c,
+    ElemType* functionValues,
+    const ElemType learnRate,
+    const ElemType momentum,
+    const ElemType l2Weight)
+{
+    const CUDA_LONG index = blockIdx.x * blockDim.x + threadIdx.x;
+    const CUDA_LONG blockId = index / numRows;
+    if (blockId >= numBlocks)
+        return;
+    const size_t row = index - numRows * blockId;
+    const size_t col = blockIds[blockId];
+    size_t numSkipped = LazyNumSkippedSteps(c[IDX2C(numRows, col, numRows + 1)], step);
+    LazyNormalGradElement(c[IDX2C(row, col, numRows + 1)], functionValues[IDX2C(row, col, numRows)], gradients[index], learnRate, momentum, l2Weight, numSkipped);
+}
+
+template <class ElemType>
+__global__ void _lazyAdagradMultipliersForSparseBlock(
+    const size_t numRows,
+    const size_t numBlocks,
+    const ElemType* gradients,
+    const GPUSPARSE_INDEX_TYPE* blockIds,
+    const ElemType* c,
+    const ElemType* functionValues,
+    const ElemType l2Weight,
+    ElemType* multipliers)
+{
+    const CUDA_LONG index = blockIdx.x * blockDim.x + threadIdx.x;
+    const CUDA_LONG blockId = index / numRows;
+    if (blockId >= numBlocks)
+        return;
+    const size_t row = index - numRows * blockId;
+    const size_t col = blockIds[blockId];
+    multipliers[index] = LazyAdagradMultiplier(c[IDX2C(row, col, numRows + 1)], functionValues[IDX2C(row, col, numRows)], gradients[index], l2Weight);
+}
+
+template <class ElemType>
+__global__ void _lazyAdagradForSparseBlock(
+    const size_t step,
+    const size_t numRows,
+    const size_t numBlocks,
+    const ElemType* gradients,
+    const GPUSPARSE_INDEX_TYPE* blockIds,
+    ElemType* c,
+    ElemType* functionValues,
+    const ElemType learnRate,
+    const ElemType l2Weight)
+{
+    const CUDA_LONG index = blockIdx.x * blockDim.x + threadIdx.x;
+    const CUDA_LONG blockId = index / numRows;
+    if (blockId >= numBlocks)
+        return;
+    const size_t row = index - numRows * blockId;
+    const size_t col = blockIds[blockId];
+    size_t numSkipped = LazyNumSkippedSteps(c[IDX2C(numRows, col, numRows + 1)], step);
+    LazyAdagradElement(c[IDX2C(row, col, numRows + 1)], functionValues[IDX2C(row, col, numRows)], gradients[index], learnRate, l2Weight, numSkipped);
+}
+
+// one thread per block
+template <class ElemType>
+__global__ void _lazySparseSetSteps(
+    const size_t step,
+    const size_t numRows,
+    const size_t numBlocks,
+    const GPUSPARSE_INDEX_TYPE* blockIds,
+    ElemType* c)
+{
+    const CUDA_LONG blockId = blockIdx.x * blockDim.x + threadIdx.x;
+    if (blockId >= numBlocks)
+        return;
+    c[IDX2C(numRows, (size_t) blockIds[blockId], numRows + 1)] = (ElemType) step;
+}
+
 //This function should be called with 1024 threads per block and 1 block
 //THIS IS NOT THE MOST EFFICIENT IMPLEMENTATION!!!
 template <class ElemType>
@@ -4484,6 +5588,168 @@ __global__ void _innerProductWithShiftNeg(
     c[IDX2C(idx, idy, NTPlusOne)] = sum;
 }
 
+// sum of v over the threadsPerColumn lanes of a column, returned to all of them; all threads of the block must call it
+template <class ElemType>
+__device__ ElemType _sumOverColumnLanes(ElemType v, ElemType* partial, const int lane, const int threadsPerColumn)
+{
+    partial[threadIdx.x] = v;
+    __syncthreads();
+    for (int stride = threadsPerColumn / 2; stride > 0; stride /= 2)
+    {
+        if (lane < stride)
+            partial[threadIdx.x] += partial[threadIdx.x + stride];
+        __syncthreads();
+    }
+    v = partial[threadIdx.x - lane];
+    __syncthreads();
+    return v;
+}
+
+// us(m,j) = cos(a(:,j), b(:,s)), s = j for m = 0 and (j + shift + m - 1) % numCols otherwise, with the threads of a column as
+// in _assignColumnwiseSoftmaxOf(); the norms of the partners are summed along with the dot products; see GPUMatrix::AssignCosDistanceWithShiftNegOf()
+template <class ElemType>
+__global__ void _assignCosDistanceWithShiftNegOf(
+    ElemType* us,
+    ElemType* invNormA,
+    ElemType* invNormB,
+    const ElemType* a,
+    const ElemType* b,
+    const CUDA_LONG numRows,
+    const CUDA_LONG numCols,
+    const CUDA_LONG shift,
+    const CUDA_LONG numPairs,
+    const int threadsPerColumn)
+{
+    __shared__ ElemType partial[GridDim::maxThreadsPerBlock];
+
+    const int lane = threadIdx.x % threadsPerColumn;
+    const CUDA_LONG col = blockIdx.x * (GridDim::maxThreadsPerBlock / threadsPerColumn) + threadIdx.x / threadsPerColumn;
+    const bool isValid = col < numCols;
+
+    ElemType sum = 0;
+    for (CUDA_LONG i = lane; isValid && i < numRows; i += threadsPerColumn)
+        sum += a[IDX2C(i, col, numRows)] * a[IDX2C(i, col, numRows)];
+    const ElemType invNormACol = 1 / sqrt_(_sumOverColumnLanes(sum, partial, lane, threadsPerColumn));
+
+    for (CUDA_LONG m = 0; m < numPairs; m++)
+    {
+        const CUDA_LONG s = isValid ? (m == 0 ? col : (col + shift + m - 1) % numCols) : 0;
+        ElemType dot = 0;
+        sum = 0;
+        for (CUDA_LONG i = lane; isValid && i < numRows; i += threadsPerColumn)
+        {
+            const ElemType bi = b[IDX2C(i, s, numRows)];
+            dot += a[IDX2C(i, col, numRows)] * bi;
+            sum += bi * bi;
+        }
+        dot = _sumOverColumnLanes(dot, partial, lane, threadsPerColumn);
+        const ElemType invNormBS = 1 / sqrt_(_sumOverColumnLanes(sum, partial, lane, threadsPerColumn));
+        if (isValid && lane == 0)
+        {
+            us[IDX2C(m, col, numPairs)] = dot * invNormACol * invNormBS;
+            if (m == 0)
+            {
+                invNormA[col] = invNormACol;
+                invNormB[col] = invNormBS;
+            }
+        }
+    }
+}
+
+// us(i,k) += d value(m,j) / d x(i,k) * gradient(m,j), summed over the pairs (m,j) that use column k of x = a, or of x = b if rightInput,
+// one thread per element; see GPUMatrix::AddCosDistanceWithShiftNegGradientOf()
+template <class ElemType>
+__global__ void _addCosDistanceWithShiftNegGradientOf(
+    ElemType* us,
+    const ElemType* gradient,
+    const ElemType* value,
+    const ElemType* a,
+    const ElemType* b,
+    const ElemType* invNormA,
+    const ElemType* invNormB,
+    const CUDA_LONG numRows,
+    const CUDA_LONG numCols,
+    const CUDA_LONG shift,
+    const CUDA_LONG numPairs,
+    const bool rightInput)
+{
+    CUDA_LONG id = blockDim.x * blockIdx.x + threadIdx.x;
+    if (id >= numRows * numCols)
+        return;
+    const CUDA_LONG k = id / numRows;
+    const CUDA_LONG i = id - k * numRows;
+    const ElemType x = rightInput ? b[id] : a[id];
+    const ElemType invNormX = rightInput ? invNormB[k] : invNormA[k];
+
+    ElemType sum = 0;
+    for (CUDA_LONG m = 0; m < numPairs; m++)
+    {
+        const CUDA_LONG d = m == 0 ? 0 : (shift + m - 1) % numCols;
+        const CUDA_LONG j = rightInput ? (k + numCols - d) % numCols : k;
+        const CUDA_LONG s = rightInput ? k : (k + d) % numCols;
+        const ElemType g = gradient[IDX2C(m, j, numPairs)];
+        const ElemType y = rightInput ? a[IDX2C(i, j, numRows)] : b[IDX2C(i, s, numRows)];
+        sum += g * (invNormA[j] * invNormB[s] * y - value[IDX2C(m, j, numPairs)] * invNormX * invNormX * x);
+    }
+    us[id] += sum;
+}
+
+// one thread per output element; see GPUMatrix::AssignAugmentedImagesOf()
+template <class ElemType>
+__global__ void _assignAugmentedImagesOf(
+    ElemType* us,
+    const ElemType* staged,
+    const ElemType* mean, // nullptr if no mean is subtracted
+    const CUDA_LONG stagingWidth,
+    const CUDA_LONG stagingHeight,
+    const CUDA_LONG channels,
+    const CUDA_LONG width,
+    const CUDA_LONG height,
+    const CUDA_LONG numCols,
+    const bool transposeToCHW)
+{
+    const CUDA_LONG outputSize = width * height * channels;
+    CUDA_LONG id = blockDim.x * blockIdx.x + threadIdx.x;
+    if (id >= outputSize * numCols)
+        return;
+    const CUDA_LONG j = id / outputSize;
+    const CUDA_LONG e = id - j * outputSize;
+    CUDA_LONG x, y, c;
+    if (transposeToCHW)
+    {
+        x = e % width;
+        y = (e / width) % height;
+        c = e / (width * height);
+    }
+    else
+    {
+        c = e % channels;
+        x = (e / channels) % width;
+        y = e / (channels * width);
+    }
+
+    const CUDA_LONG stagingSize = stagingWidth * stagingHeight * channels;
+    const ElemType* image = staged + j * (stagingSize + 5);
+    const ElemType* crop = image + stagingSize;
+    const CUDA_LONG xs = crop[4] != 0 ? width - 1 - x : x;
+    ElemType u = crop[0] + (xs + (ElemType) 0.5) * crop[2] / width - (ElemType) 0.5;
+    ElemType v = crop[1] + (y + (ElemType) 0.5) * crop[3] / height - (ElemType) 0.5;
+    u = min(max(u, (ElemType) 0), (ElemType)(stagingWidth - 1));
+    v = min(max(v, (ElemType) 0), (ElemType)(stagingHeight - 1));
+    const CUDA_LONG u0 = (CUDA_LONG) u;
+    const CUDA_LONG v0 = (CUDA_LONG) v;
+    const CUDA_LONG u1 = min(u0 + 1, stagingWidth - 1);
+    const CUDA_LONG v1 = min(v0 + 1, stagingHeight - 1);
+    const ElemType fu = u - u0;
+    const ElemType fv = v - v0;
+
+    ElemType value = (1 - fv) * ((1 - fu) * image[(v0 * stagingWidth + u0) * channels + c] + fu * image[(v0 * stagingWidth + u1) * channels + c]) +
+                     fv * ((1 - fu) * image[(v1 * stagingWidth + u0) * channels + c] + fu * image[(v1 * stagingWidth + u1) * channels + c]);
+    if (mean != nullptr)
+        value -= mean[(y * width + x) * channels + c];
+    us[id] = value;
+}
+
 template <class ElemType>
 __global__ void _getARowByIndex(
     ElemType* us,
@@ -4847,6 +6113,85 @@ __global__ void _rcrfTransGrdCompute(
     }
 };
 
+// CTC forward-backward (see GPUMatrix::AssignCTCPosteriors()): one thread block per sequence, whose threads take the states
+// of each frame and step through the frames together. The recursions are those of CTCForwardBackward() in CPUMatrix.cpp.
+template <class ElemType>
+__global__ void _assignCTCPosteriors(ElemType* posteriors, const ElemType* logProbs, const ElemType* stateLabels, const ElemType* sequences,
+                                     ElemType* alpha, ElemType* beta, ElemType* logLikelihoods,
+                                     const CUDA_LONG numLabels, const CUDA_LONG numParallelSequences, const CUDA_LONG numTimeSteps, const CUDA_LONG maxStates)
+{
+    const CUDA_LONG n = blockIdx.x;
+    const CUDA_LONG s = (CUDA_LONG) sequences[4 * n];
+    const CUDA_LONG firstColumn = (CUDA_LONG) sequences[4 * n + 1] * numParallelSequences + s;
+    const CUDA_LONG numFrames = (CUDA_LONG) sequences[4 * n + 2];
+    const CUDA_LONG numStates = (CUDA_LONG) sequences[4 * n + 3];
+    const ElemType* labels = stateLabels + n * maxStates;
+    ElemType* a = alpha + n * numTimeSteps * maxStates;
+    ElemType* b = beta + n * numTimeSteps * maxStates;
+
+    for (CUDA_LONG t = 0; t < numFrames; t++)
+    {
+        const ElemType* y = logProbs + (firstColumn + t * numParallelSequences) * numLabels;
+        for (CUDA_LONG q = threadIdx.x; q < numStates; q += blockDim.x)
+        {
+            ElemType v;
+            if (t == 0)
+                v = q < 2 ? 0 : (ElemType) LZERO;
+            else
+            {
+                const ElemType* prev = a + (t - 1) * maxStates;
+                v = prev[q];
+                if (q >= 1)
+                    v = LogAdd(v, prev[q - 1]);
+                if (q >= 2 && q % 2 == 1 && labels[q] != labels[q - 2])
+                    v = LogAdd(v, prev[q - 2]);
+            }
+            a[t * maxStates + q] = v + y[(CUDA_LONG) labels[q]];
+        }
+        __syncthreads();
+    }
+    for (CUDA_LONG t = numFrames - 1; t >= 0; t--)
+    {
+        for (CUDA_LONG q = threadIdx.x; q < numStates; q += blockDim.x)
+        {
+            ElemType v;
+            if (t + 1 == numFrames)
+                v = q + 2 >= numStates ? 0 : (ElemType) LZERO;
+            else
+            {
+                const ElemType* y = logProbs + (firstColumn + (t + 1) * numParallelSequences) * numLabels;
+                const ElemType* next = b + (t + 1) * maxStates;
+                v = next[q] + y[(CUDA_LONG) labels[q]];
+                if (q + 1 < numStates)
+                    v = LogAdd(v, next[q + 1] + y[(CUDA_LONG) labels[q + 1]]);
+                if (q + 2 < numStates && q % 2 == 1 && labels[q] != labels[q + 2])
+                    v = LogAdd(v, next[q + 2] + y[(CUDA_LONG) labels[q + 2]]);
+            }
+            b[t * maxStates + q] = v;
+        }
+        __syncthreads();
+    }
+
+    const ElemType* last = a + (numFrames - 1) * maxStates;
+    const ElemType logZ = numStates >= 2 ? LogAdd(last[numStates - 1], last[numStates - 2]) : last[0];
+    if (threadIdx.x == 0)
+        logLikelihoods[n] = logZ < (ElemType) LSMALL ? 0 : logZ;
+
+    // states of a frame may share a label, hence the atomic adds
+    for (CUDA_LONG t = 0; t < numFrames; t++)
+    {
+        const CUDA_LONG j = firstColumn + t * numParallelSequences;
+        if (logZ < (ElemType) LSMALL) // too few frames for the labels: the posteriors are the softmax, i.e. no gradient
+        {
+            for (CUDA_LONG k = threadIdx.x; k < numLabels; k += blockDim.x)
+                posteriors[j * numLabels + k] = exp_(logProbs[j * numLabels + k]);
+            continue;
+        }
+        for (CUDA_LONG q = threadIdx.x; q < numStates; q += blockDim.x)
+            atomicAdd(&posteriors[j * numLabels + (CUDA_LONG) labels[q]], exp_(a[t * maxStates + q] + b[t * maxStates + q] - logZ));
+    }
+}
+
 template <class ElemType>
 __global__ void _reductionLogAddSum(
     const ElemType* data,
@@ -4979,6 +6324,75 @@ __global__ void _assignNumOfDiffCol(const ElemType* a, const ElemType* b, ElemTy
         *c = res;
 }
 
+// see Matrix<ElemType>::AssignNumOfTopKErrorsOf(): a block per column finds the label as the first maximum of the label column, then
+// counts the predictions that rank before the label's; the column is an error if there are topK of them
+template <class ElemType>
+__global__ void _assignNumOfTopKErrors(
+    ElemType* us, // [1 x 1], must be zero
+    const ElemType* labels,
+    const ElemType* predictions,
+    const CUDA_LONG numRows,
+    const CUDA_LONG numCols,
+    const CUDA_LONG topK)
+{
+    __shared__ ElemType partialMax[GridDim::maxThreadsPerBlock];
+    __shared__ CUDA_LONG partialIndex[GridDim::maxThreadsPerBlock];
+
+    for (CUDA_LONG t = blockIdx.x; t < numCols; t += gridDim.x)
+    {
+        const ElemType* label = labels + IDX2C(0, t, numRows);
+        const ElemType* prediction = predictions + IDX2C(0, t, numRows);
+
+        // the first maximum of the label column; the threads beyond the rows start out with row 0
+        CUDA_LONG index = threadIdx.x < numRows ? threadIdx.x : 0;
+        ElemType maxV = label[index];
+        for (CUDA_LONG i = threadIdx.x + blockDim.x; i < numRows; i += blockDim.x)
+        {
+            if (label[i] > maxV)
+            {
+                maxV = label[i];
+                index = i;
+            }
+        }
+        partialMax[threadIdx.x] = maxV;
+        partialIndex[threadIdx.x] = index;
+        __syncthreads();
+        for (int stride = blockDim.x / 2; stride > 0; stride /= 2)
+        {
+            if (threadIdx.x < stride)
+            {
+                const ElemType otherMax = partialMax[threadIdx.x + stride];
+                const CUDA_LONG otherIndex = partialIndex[threadIdx.x + stride];
+                if (otherMax > partialMax[threadIdx.x] || (otherMax == partialMax[threadIdx.x] && otherIndex < partialIndex[threadIdx.x]))
+                {
+                    partialMax[threadIdx.x] = otherMax;
+                    partialIndex[threadIdx.x] = otherIndex;
+                }
+            }
+            __syncthreads();
+        }
+        const CUDA_LONG labelIndex = partialIndex[0];
+        const ElemType labelPrediction = prediction[labelIndex];
+        __syncthreads();
+
+        // the rank of the label among the predictions
+        CUDA_LONG rank = 0;
+        for (CUDA_LONG i = threadIdx.x; i < numRows; i += blockDim.x)
+            rank += prediction[i] > labelPrediction || (prediction[i] == labelPrediction && i < labelIndex);
+        partialIndex[threadIdx.x] = rank;
+        __syncthreads();
+        for (int stride = blockDim.x / 2; stride > 0; stride /= 2)
+        {
+            if (threadIdx.x < stride)
+                partialIndex[threadIdx.x] += partialIndex[threadIdx.x + stride];
+            __syncthreads();
+        }
+        if (threadIdx.x == 0 && partialIndex[0] >= topK)
+            atomicAdd(us, (ElemType) 1);
+        __syncthreads();
+    }
+}
+
 template <class ElemType>
 __global__ void _maskColumnsValue(ElemType* a, const char* columnsMask, CUDA_LONG numCols, CUDA_LONG numRows, ElemType val)
 {
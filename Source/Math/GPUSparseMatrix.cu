@@ -401,30 +401,7 @@ void GPUSparseMatrix<ElemType>::ChangeDeviceTo(DEVICEID_TYPE to_id)
     {
         ElemType* d_dst = reinterpret_cast<ElemType*>(TracingGPUMemoryAllocator::Allocate<char>(to_id, m_totalBufferSizeAllocated));
 
-        // first try peer access
-        int canAccessPeer = false;
-        CUDA_CALL(cudaDeviceCanAccessPeer(&canAccessPeer, to_id, m_computeDevice));
-        if (canAccessPeer)
-        {
-            cudaError_t cudaStatus = cudaDeviceEnablePeerAccess(m_computeDevice, 0);
-            if (cudaStatus != cudaErrorPeerAccessAlreadyEnabled)
-            {
-                CUDA_CALL(cudaStatus);
-            }
-            CUDA_CALL(cudaMemcpyPeer(d_dst, to_id, m_pArray, m_computeDevice, m_totalBufferSizeAllocated));
-        }
-        else
-        {
-            // peer access didn't work, just copy normal
-            // make this more efficient by keeping some buffers available for each copy
-            ElemType* h_dst = NULL;
-            PrepareDevice();
-            CUDA_CALL(cudaMallocHost((void**) &h_dst, m_totalBufferSizeAllocated));
-            CUDA_CALL(cudaMemcpy(h_dst, m_pArray, m_totalBufferSizeAllocated, cudaMemcpyDeviceToHost));
-            PrepareDevice((DEVICEID_TYPE) to_id);
-            CUDA_CALL(cudaMemcpy(d_dst, h_dst, m_totalBufferSizeAllocated, cudaMemcpyHostToDevice));
-            CUDA_CALL(cudaFreeHost(h_dst));
-        }
+        CopyBetweenDevicesAsync(d_dst, to_id, m_pArray, m_computeDevice, m_totalBufferSizeAllocated);
 
         TracingGPUMemoryAllocator::Free<ElemType>(m_computeDevice, m_pArray);
         m_pArray = d_dst;
@@ -850,6 +827,36 @@ void GPUSparseMatrix<ElemType>::SetMatrixFromCSCFormat(const CPUSPARSE_INDEX_TYP
     }
 }
 
+// like SetMatrixFromCSCFormat(), from the number of values of each column: the column offsets are computed on the device
+// The host arrays are copied asynchronously on the current stream. They should be page-locked, and must not be changed
+// until the copies have completed (see SparseStagingBuffer).
+template <class ElemType>
+void GPUSparseMatrix<ElemType>::SetMatrixFromCSCColumnCounts(const CPUSPARSE_INDEX_TYPE* h_colCounts, const CPUSPARSE_INDEX_TYPE* h_Row, const ElemType* h_Val,
+                                                             const size_t nz, const size_t numRows, const size_t numCols)
+{
+    static_assert(sizeof(CPUSPARSE_INDEX_TYPE) == sizeof(GPUSPARSE_INDEX_TYPE), "SetMatrixFromCSCColumnCounts: the host indices are copied as they are.");
+
+    if (!OwnBuffer())
+        LogicError("Cannot Set since the buffer is managed externally.");
+
+    if (h_colCounts == nullptr || (nz > 0 && (h_Row == nullptr || h_Val == nullptr)))
+        LogicError("SetMatrixFromCSCColumnCounts: nullptr passed in.");
+
+    PrepareDevice();
+    m_format = matrixFormatSparseCSC;
+    Resize(numRows, numCols, nz, true, false);
+    SetNzCount(nz);
+
+    if (nz > 0)
+    {
+        CUDA_CALL(cudaMemcpyAsync(BufferPointer(), h_Val, NzSize(), cudaMemcpyHostToDevice, t_stream));
+        CUDA_CALL(cudaMemcpyAsync(RowLocation(), h_Row, RowSize(), cudaMemcpyHostToDevice, t_stream));
+    }
+    if (numCols > 0)
+        CUDA_CALL(cudaMemcpyAsync(ColLocation() + 1, h_colCounts, sizeof(GPUSPARSE_INDEX_TYPE) * numCols, cudaMemcpyHostToDevice, t_stream));
+    _columnCountsToCSCOffsets<GridDim::maxThreadsPerBlock><<<1, GridDim::maxThreadsPerBlock, 0, t_stream>>>(ColLocation(), (CUDA_LONG) numCols);
+}
+
 // this function will allocate memory while the caller needs to release it
 template <class ElemType>
 void GPUSparseMatrix<ElemType>::GetMatrixFromCSCFormat(GPUSPARSE_INDEX_TYPE*& h_CSCCol, GPUSPARSE_INDEX_TYPE*& h_Row, ElemType*& h_Val, size_t& numElemAllocated, size_t& nz, size_t& numRows, size_t& numCols) const
@@ -892,6 +899,68 @@ void GPUSparseMatrix<ElemType>::GetMatrixFromCSCFormat(GPUSPARSE_INDEX_TYPE*& h_
     }
 }
 
+template <class ElemType>
+void GPUSparseMatrix<ElemType>::SetMatrixFromBlockColFormat(const size_t* h_ColIds, const ElemType* h_Val, const size_t numBlocks, const size_t numRows, const size_t numCols)
+{
+    if (!OwnBuffer())
+        LogicError("Cannot Set since the buffer is managed externally.");
+
+    if (numBlocks > numCols)
+        InvalidArgument("SetMatrixFromBlockColFormat: %d blocks exceed the %d columns of the matrix.", (int) numBlocks, (int) numCols);
+
+    Resize(numRows, numCols, numRows * numBlocks, matrixFormatSparseBlockCol, true, false);
+    m_blockSize = numBlocks;
+    SetNzCount(numRows * numBlocks);
+    if (numBlocks == 0)
+        return;
+
+    PrepareDevice();
+    CUDA_CALL(cudaMemcpy(BufferPointer(), h_Val, NzSize(), cudaMemcpyHostToDevice));
+
+    std::vector<GPUSPARSE_INDEX_TYPE> colIds(h_ColIds, h_ColIds + numBlocks);
+    CUDA_CALL(cudaMemcpy(BlockId2ColOrRow(), colIds.data(), sizeof(GPUSPARSE_INDEX_TYPE) * numBlocks, cudaMemcpyHostToDevice));
+}
+
+template <class ElemType>
+void GPUSparseMatrix<ElemType>::GetMatrixFromBlockColFormat(std::vector<size_t>& colIds, std::vector<ElemType>& values) const
+{
+    if (m_format != matrixFormatSparseBlockCol)
+        LogicError("GetMatrixFromBlockColFormat: the matrix is not in block column format.");
+
+    colIds.resize(m_blockSize);
+    values.resize(m_blockSize * m_numRows);
+    if (m_blockSize == 0)
+        return;
+
+    PrepareDevice();
+    std::vector<GPUSPARSE_INDEX_TYPE> deviceColIds(m_blockSize);
+    CUDA_CALL(cudaMemcpy(deviceColIds.data(), BlockId2ColOrRow(), sizeof(GPUSPARSE_INDEX_TYPE) * m_blockSize, cudaMemcpyDeviceToHost));
+    CUDA_CALL(cudaMemcpy(values.data(), BufferPointer(), sizeof(ElemType) * values.size(), cudaMemcpyDeviceToHost));
+    std::copy(deviceColIds.begin(), deviceColIds.end(), colIds.begin());
+}
+
+template <class ElemType>
+void GPUSparseMatrix<ElemType>::AssignOneHotColumnsOf(const GPUMatrix<ElemType>& ids, const size_t numRows)
+{
+    if (!OwnBuffer())
+        LogicError("Cannot Set since the buffer is managed externally.");
+    if (numRows == 0)
+        InvalidArgument("AssignOneHotColumnsOf: the matrix needs at least one row.");
+
+    const size_t numCols = ids.GetNumElements();
+    SetComputeDeviceId(PrepareDevice(ids.GetComputeDeviceId()));
+    Resize(numRows, numCols, numCols, matrixFormatSparseCSC, true, false);
+    SetNzCount(numCols);
+    if (numCols == 0)
+        return;
+
+    CUDA_LONG N = (CUDA_LONG) numCols;
+    int blocksPerGrid = (int) ceil(1.0 * N / GridDim::maxThreadsPerBlock);
+    SyncGuard syncGuard;
+    _assignOneHotColumns<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(ids.BufferPointer(), N, (CUDA_LONG) numRows,
+                                                                                               BufferPointer(), RowLocation(), ColLocation());
+}
+
 #pragma endregion Constructors and Destructor
 
 #pragma region Static BLAS Functions
@@ -1149,20 +1218,51 @@ void GPUSparseMatrix<ElemType>::MultiplyAndAdd(ElemType alpha, const GPUMatrix<E
             size_t nnz = m * c.m_blockSize;
             c.Resize(m, n, nnz, true, true); // we need to keep the col2blockid and blockid2col info when resizing.
             c.m_nz = nnz;
-            CUDA_CALL(cudaMemset(c.BufferPointer(), 0, sizeof(ElemType) * (c.m_elemSizeAllocated)));
-
-            LONG64 N = (LONG64) lhs.GetNumElements(); // here we process for each row in lhs and each column in rhs (==columns in lhs)
-            blocksPerGrid = (int) ceil(((double) N) / GridDim::maxThreadsPerBlock);
-            _denseMulSparseCSCTransposeToSparseBlockCol2<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(
+            if (c.m_blockSize == 0)
+                return;
+
+            // Group the nonzeros of rhs by their row, i.e. by result column, with a radix sort of their block ids.
+            // Each result column is then the sum over its group of the lhs columns, computed once per value, instead of
+            // an atomic scatter-add into a cleared result.
+            size_t rhsNZ = rhs.m_nz;
+            int numKeyBits = 1;
+            while (numKeyBits < 32 && ((size_t) 1 << numKeyBits) < c.m_blockSize)
+                numKeyBits++;
+            size_t sortTempBytes = 0;
+            CUDA_CALL(cub::DeviceRadixSort::SortPairs(nullptr, sortTempBytes, (GPUSPARSE_INDEX_TYPE*) nullptr, (GPUSPARSE_INDEX_TYPE*) nullptr,
+                                                      (GPUSPARSE_INDEX_TYPE*) nullptr, (GPUSPARSE_INDEX_TYPE*) nullptr, (int) rhsNZ, 0, numKeyBits, t_stream));
+            size_t sortTempCount = (sortTempBytes + sizeof(GPUSPARSE_INDEX_TYPE) - 1) / sizeof(GPUSPARSE_INDEX_TYPE);
+            // keys, sorted keys, entry ids, sorted entry ids, entry columns, block starts, sort temp storage
+            GPUSPARSE_INDEX_TYPE* sortBuffer = TracingGPUMemoryAllocator::Allocate<GPUSPARSE_INDEX_TYPE>(lhs.GetComputeDeviceId(), 5 * rhsNZ + c.m_blockSize + 1 + sortTempCount);
+            GPUSPARSE_INDEX_TYPE* blockKeys = sortBuffer;
+            GPUSPARSE_INDEX_TYPE* sortedBlockKeys = blockKeys + rhsNZ;
+            GPUSPARSE_INDEX_TYPE* entryIds = sortedBlockKeys + rhsNZ;
+            GPUSPARSE_INDEX_TYPE* sortedEntryIds = entryIds + rhsNZ;
+            GPUSPARSE_INDEX_TYPE* entryCols = sortedEntryIds + rhsNZ;
+            GPUSPARSE_INDEX_TYPE* blockStarts = entryCols + rhsNZ;
+            void* sortTemp = blockStarts + c.m_blockSize + 1;
+
+            blocksPerGrid = (int) ceil(((double) l) / GridDim::maxThreadsPerBlock);
+            _sparseCSCEntriesByBlock<<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(
+                rhs.RowLocation(), rhs.ColLocation(), l, c.ColOrRow2BlockId(), blockKeys, entryIds, entryCols);
+            CUDA_CALL(cub::DeviceRadixSort::SortPairs(sortTemp, sortTempBytes, blockKeys, sortedBlockKeys, entryIds, sortedEntryIds, (int) rhsNZ, 0, numKeyBits, t_stream));
+            blocksPerGrid = (int) ceil(((double) rhsNZ + 1) / GridDim::maxThreadsPerBlock);
+            _determineBlockStarts<<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(sortedBlockKeys, rhsNZ, c.m_blockSize, blockStarts);
+
+            // one CUDA block per result column, as many threads as lhs rows (rounded up to a warp)
+            int threadsPerBlock = std::min((int) GridDim::maxThreadsPerBlock, (m + 31) / 32 * 32);
+            _denseMulSparseCSCTransposeToSparseBlockColSegmented<ElemType><<<(int) c.m_blockSize, threadsPerBlock, 0, t_stream>>>(
                 alpha,
                 lhs.BufferPointer(),
                 m,
-                l,
                 rhs.BufferPointer(),
-                rhs.RowLocation(),
                 rhs.ColLocation(),
-                c.ColOrRow2BlockId(),
+                sortedEntryIds,
+                entryCols,
+                blockStarts,
                 c.BufferPointer());
+
+            TracingGPUMemoryAllocator::Free<GPUSPARSE_INDEX_TYPE>(lhs.GetComputeDeviceId(), sortBuffer);
         }
         else
         {
@@ -1381,20 +1481,83 @@ ElemType GPUSparseMatrix<ElemType>::Adagrad(GPUMatrix<ElemType>& c, const bool n
     }
 }
 
+// lazy updates of the columns of block-column gradients, see Matrix::LazyNormalGrad()
+// c has one more row than this, which holds the step of the last update of each column.
+template <class ElemType>
+void GPUSparseMatrix<ElemType>::LazyNormalGrad(size_t step, GPUMatrix<ElemType>& c, GPUMatrix<ElemType>& functionValues, const ElemType learnRatePerSample, const ElemType momentum, const ElemType l2Weight)
+{
+    if (m_format != matrixFormatSparseBlockCol)
+        RuntimeError("GPUSparseMatrix::LazyNormalGrad() only supports the block column format.");
+    if (m_blockSize == 0)
+        return;
+
+    SyncGuard syncGuard;
+    LONG64 N = (LONG64) GetNumNZElements();
+    int blocksPerGrid = (int) ceil(((double) N) / GridDim::maxThreadsPerBlock);
+    _lazyNormalGradForSparseBlock<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock>>>(
+        step, GetNumRows(), m_blockSize, BufferPointer(), BlockId2ColOrRow(),
+        c.BufferPointer(), functionValues.BufferPointer(), learnRatePerSample, momentum, l2Weight);
+    blocksPerGrid = (int) ceil(((double) m_blockSize) / GridDim::maxThreadsPerBlock);
+    _lazySparseSetSteps<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock>>>(step, GetNumRows(), m_blockSize, BlockId2ColOrRow(), c.BufferPointer());
+}
+
+template <class ElemType>
+void GPUSparseMatrix<ElemType>::LazyAdagrad(size_t step, GPUMatrix<ElemType>& c, GPUMatrix<ElemType>& functionValues, const ElemType learnRatePerSample, const ElemType l2Weight, const bool needAveMultiplier)
+{
+    if (m_format != matrixFormatSparseBlockCol)
+        RuntimeError("GPUSparseMatrix::LazyAdagrad() only supports the block column format.");
+    if (m_blockSize == 0)
+        return;
+
+    SyncGuard syncGuard;
+    LONG64 N = (LONG64) GetNumNZElements();
+    int blocksPerGrid = (int) ceil(((double) N) / GridDim::maxThreadsPerBlock);
+    ElemType aveMultiplier = 1;
+    if (needAveMultiplier)
+    {
+        GPUMatrix<ElemType> multipliers(1, N, GetComputeDeviceId());
+        _lazyAdagradMultipliersForSparseBlock<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock>>>(
+            GetNumRows(), m_blockSize, BufferPointer(), BlockId2ColOrRow(),
+            c.BufferPointer(), functionValues.BufferPointer(), l2Weight, multipliers.BufferPointer());
+        aveMultiplier = multipliers.SumOfAbsElements() / N;
+    }
+
+    _lazyAdagradForSparseBlock<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock>>>(
+        step, GetNumRows(), m_blockSize, BufferPointer(), BlockId2ColOrRow(),
+        c.BufferPointer(), functionValues.BufferPointer(), learnRatePerSample / aveMultiplier, l2Weight);
+    blocksPerGrid = (int) ceil(((double) m_blockSize) / GridDim::maxThreadsPerBlock);
+    _lazySparseSetSteps<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock>>>(step, GetNumRows(), m_blockSize, BlockId2ColOrRow(), c.BufferPointer());
+}
+
 // sparse X dense = dense
+// The sparse matrix can be CSR or CSC. The arrays of a CSC matrix are those of its transpose in CSR format,
+// so a CSC matrix is multiplied as the CSR matrix a' with the opposite transposition, without a format conversion.
 template <class ElemType>
 void GPUSparseMatrix<ElemType>::MultiplyAndWeightedAdd(ElemType alpha, const GPUSparseMatrix<ElemType>& a, const bool transposeA,
                                                        const GPUMatrix<ElemType>& b, const bool transposeD, ElemType beta, GPUMatrix<ElemType>& c)
 {
-    if (a.m_format != matrixFormatSparseCSR)
+    if (a.m_format != matrixFormatSparseCSR && a.m_format != matrixFormatSparseCSC)
         NOT_IMPLEMENTED;
 
     if (transposeD)
         NOT_IMPLEMENTED;
 
-    if (a.GetComputeDeviceId() != b.GetComputeDeviceId() || (b.GetComputeDeviceId() != a.GetComputeDeviceId()))
+    if (a.GetComputeDeviceId() != b.GetComputeDeviceId() || (b.GetComputeDeviceId() != c.GetComputeDeviceId()))
         RuntimeError("MultiplyAndWeightedAdd: All matrices must be on the same GPU");
 
+    bool isCSC = a.m_format == matrixFormatSparseCSC;
+    int m = (int) (isCSC ? a.GetNumCols() : a.GetNumRows()); // dimensions of the CSR matrix
+    int n = (int) b.GetNumCols();
+    int k = (int) (isCSC ? a.GetNumRows() : a.GetNumCols());
+    bool transposeCSR = transposeA != isCSC;
+    if ((int) b.GetNumRows() != (transposeCSR ? m : k))
+        InvalidArgument("GPUSparseMatrix::MultiplyAndWeightedAdd: The inner dimensions of a and b must match.");
+
+    if (beta == 0)
+        c.Resize(transposeCSR ? k : m, n);
+    else
+        c.VerifySize(transposeCSR ? k : m, n); // Can't resize if beta != 0
+
     a.PrepareDevice();
     cusparseHandle_t cusparseHandle = 0;
     CUSPARSE_CALL(cusparseCreate(&cusparseHandle));
@@ -1402,24 +1565,23 @@ void GPUSparseMatrix<ElemType>::MultiplyAndWeightedAdd(ElemType alpha, const GPU
     CUSPARSE_CALL(cusparseCreateMatDescr(&descr));
     cusparseSetMatType(descr, CUSPARSE_MATRIX_TYPE_GENERAL);
     cusparseSetMatIndexBase(descr, CUSPARSE_INDEX_BASE_ZERO);
-    cusparseOperation_t oper = transposeA ? CUSPARSE_OPERATION_TRANSPOSE : CUSPARSE_OPERATION_NON_TRANSPOSE;
+    cusparseOperation_t oper = transposeCSR ? CUSPARSE_OPERATION_TRANSPOSE : CUSPARSE_OPERATION_NON_TRANSPOSE;
 
-    int m = (int) a.GetNumRows();
-    int n = (int) b.GetNumCols();
-    assert(n == (int) c.GetNumCols());
-    int k = (int) a.GetNumCols();
+    // compressed and uncompressed indices; in CSR format, RowLocation() is the compressed one
+    const GPUSPARSE_INDEX_TYPE* compressedIndex = isCSC ? a.ColLocation() : a.RowLocation();
+    const GPUSPARSE_INDEX_TYPE* uncompressedIndex = isCSC ? a.RowLocation() : a.ColLocation();
 
     SyncGuard syncGuard;
     if (sizeof(ElemType) == sizeof(float))
     {
         CUSPARSE_CALL(cusparseScsrmm(cusparseHandle, oper, m, n, k, (int) a.GetNumElemAllocated(), reinterpret_cast<float*>(&alpha), descr, reinterpret_cast<const float*>(a.BufferPointer()),
-                                     a.RowLocation(), a.ColLocation(), reinterpret_cast<float*>(b.BufferPointer()),
+                                     compressedIndex, uncompressedIndex, reinterpret_cast<float*>(b.BufferPointer()),
                                      (int) b.GetNumRows(), reinterpret_cast<float*>(&beta), reinterpret_cast<float*>(c.BufferPointer()), (int) c.GetNumRows()));
     }
     else
     {
         CUSPARSE_CALL(cusparseDcsrmm(cusparseHandle, oper, m, n, k, (int) a.GetNumElemAllocated(), reinterpret_cast<double*>(&alpha), descr, reinterpret_cast<const double*>(a.BufferPointer()),
-                                     a.RowLocation(), a.ColLocation(), reinterpret_cast<double*>(b.BufferPointer()),
+                                     compressedIndex, uncompressedIndex, reinterpret_cast<double*>(b.BufferPointer()),
                                      (int) b.GetNumRows(), reinterpret_cast<double*>(&beta), reinterpret_cast<double*>(c.BufferPointer()), (int) c.GetNumRows()));
     }
     CUSPARSE_CALL(cusparseDestroy(cusparseHandle));
@@ -262,12 +262,23 @@ public:
                                 const size_t nz, const size_t numRows, const size_t numCols, const bool IsOnDevice = false, const DEVICEID_TYPE devId = -1);
     void SetMatrixFromCSCFormat(const CPUSPARSE_INDEX_TYPE* h_CSCCol, const CPUSPARSE_INDEX_TYPE* h_Row, const ElemType* h_Val,
                                 const size_t nz, const size_t numRows, const size_t numCols, const bool IsOnDevice = false, const DEVICEID_TYPE devId = -1);
+    // Sets sparse matrix in CSC format from the number of values of each column, asynchronously from page-locked memory
+    void SetMatrixFromCSCColumnCounts(const CPUSPARSE_INDEX_TYPE* h_colCounts, const CPUSPARSE_INDEX_TYPE* h_Row, const ElemType* h_Val,
+                                      const size_t nz, const size_t numRows, const size_t numCols);
 
     // Gets sparse matrix in CSR format. this acts as deep copy. All passed pointers must be NULL. the function will allocate memory itself.
     void GetMatrixFromCSRFormat(CPUSPARSE_INDEX_TYPE*& h_CSRRow, CPUSPARSE_INDEX_TYPE*& h_Col, ElemType*& h_Val, size_t& numElemAllocated, size_t& nz, size_t& numRows, size_t& numCols) const;
 
     void GetMatrixFromCSCFormat(CPUSPARSE_INDEX_TYPE*& h_CSCCol, CPUSPARSE_INDEX_TYPE*& h_Row, ElemType*& h_Val, size_t& numElemAllocated, size_t& nz, size_t& numRows, size_t& numCols) const;
 
+    // block column format: the ids of the 'numBlocks' columns that have values, and the values of these columns, all in host memory
+    // Only BlockId2ColOrRow() is set, which is what the operations on block column matrices use.
+    void SetMatrixFromBlockColFormat(const size_t* h_ColIds, const ElemType* h_Val, const size_t numBlocks, const size_t numRows, const size_t numCols);
+    void GetMatrixFromBlockColFormat(std::vector<size_t>& colIds, std::vector<ElemType>& values) const;
+
+    // CSC with a 1 in each column j, in row ids[j]; built on the device
+    void AssignOneHotColumnsOf(const GPUMatrix<ElemType>& ids, const size_t numRows);
+
     void ConvertToSparseFormat(MatrixFormat newFormat);
     void ConvertToSparseFormat(MatrixFormat newFormat, GPUSparseMatrix<ElemType>& outMatrix) const;
 
@@ -333,6 +344,8 @@ public:
 
     void NormalGrad(GPUMatrix<ElemType>& c, const ElemType momentum);
     ElemType Adagrad(GPUMatrix<ElemType>& c, const bool needAveMultiplier);
+    void LazyNormalGrad(size_t step, GPUMatrix<ElemType>& c, GPUMatrix<ElemType>& functionValues, const ElemType learnRatePerSample, const ElemType momentum, const ElemType l2Weight);
+    void LazyAdagrad(size_t step, GPUMatrix<ElemType>& c, GPUMatrix<ElemType>& functionValues, const ElemType learnRatePerSample, const ElemType l2Weight, const bool needAveMultiplier);
 
     static void Multiply(const GPUSparseMatrix<ElemType>& S, const GPUMatrix<ElemType>& D, GPUMatrix<ElemType>& C);
     static void Multiply(const GPUMatrix<ElemType>& D, const GPUSparseMatrix<ElemType>& S, GPUMatrix<ElemType>& C);
@@ -10,6 +10,7 @@
 #ifndef CPUONLY
 
 #include "GPUTensor.h"
+#include "GPUTensorJit.h"
 #include "GPUMatrix.h"
 #include "GPUMatrixCUDAKernels.cuh"
 #include "CommonMatrix.h"
@@ -265,6 +266,71 @@ struct TensorOpReduce<ElemType, N, M, /*m=*/-1>
     }
 };
 
+// -----------------------------------------------------------------------
+// sum over the threads of a block, for the parallel reduction
+// -----------------------------------------------------------------------
+
+#if __CUDA_ARCH__ >= 300 // shuffles need sm_30
+// shift a value down by 'offset' lanes within a warp
+static __device__ float ShuffleDown(float val, int offset)
+{
+#if CUDART_VERSION >= 9000
+    return __shfl_down_sync(0xffffffff, val, offset);
+#else
+    return __shfl_down(val, offset);
+#endif
+}
+
+static __device__ double ShuffleDown(double val, int offset)
+{
+#if CUDART_VERSION >= 9000
+    return __shfl_down_sync(0xffffffff, val, offset);
+#else
+    // shuffles before CUDA 9 only move 32 bits
+    int hi = __shfl_down(__double2hiint(val), offset);
+    int lo = __shfl_down(__double2loint(val), offset);
+    return __hiloint2double(hi, lo);
+#endif
+}
+#endif
+
+// sum 'sum' over all threads of the block; the result is valid in thread 0 only
+// The block size must be a multiple of the warp size (32), since all lanes of each warp take part in the shuffles.
+template <class ElemType>
+static __device__ ElemType BlockReduceSum(ElemType sum, CUDA_LONG tid, CUDA_LONG tids)
+{
+#if __CUDA_ARCH__ >= 300
+    // reduce within each warp through registers, then the per-warp sums within the first warp
+    __shared__ ElemType warpSums[GridDim::maxThreadsPerBlock / 32];
+    for (int offset = 16; offset > 0; offset >>= 1)
+        sum += ShuffleDown(sum, offset);
+    if (tid % 32 == 0)
+        warpSums[tid / 32] = sum;
+    __syncthreads();
+    if (tid < 32)
+    {
+        sum = tid < tids / 32 ? warpSums[tid] : 0;
+        for (int offset = 16; offset > 0; offset >>= 1)
+            sum += ShuffleDown(sum, offset);
+    }
+    return sum;
+#else
+    // no shuffles before sm_30    --cf https://docs.nvidia.com/cuda/samples/6_Advanced/reduction/doc/reduction.pdf
+    __shared__ ElemType accumulators[GridDim::maxThreadsPerBlock /*tids*/];
+    accumulators[tid] = sum;
+    __syncthreads();
+    static_assert(GridDim::maxThreadsPerBlock <= 512, "GridDim::maxThreadsPerBlock too large, need to add manually unrolled steps");
+    for (CUDA_LONG i = 256; i; i >>= 1)
+    {
+        if (tid < i && tid + i < tids)
+            accumulators[tid] += accumulators[tid + i];
+        if (0 + i < tids)
+            __syncthreads(); // sync if condition true for at least one thread
+    }
+    return accumulators[0];
+#endif
+}
+
 // -----------------------------------------------------------------------
 // function to compute one constituent of the value for a given output location (this version has reduction done outside)
 // -----------------------------------------------------------------------
@@ -404,7 +470,6 @@ struct TensorOpElement<ElemType, N, M, K, /*parallelReduce=*/true, /*k=*/-1>
                                    const FixedArray<C_unsigned_int, M>& reducingOpDims, const FixedMatrix<C_int, N, M>& reducingStrides, CUDA_LONG reductionBegin, CUDA_LONG reductionChunkSize)
     {
         CUDA_LONG reductionBlock = blockIdx.z; // block index  --larger reductions are split into blocks
-        CUDA_LONG reductionBlocks = gridDim.z; // number of blocks
         CUDA_LONG tid = threadIdx.x;           // thread index
         CUDA_LONG tids = blockDim.x;           // out of how many threads  --note: last block is partial
 
@@ -426,40 +491,22 @@ struct TensorOpElement<ElemType, N, M, K, /*parallelReduce=*/true, /*k=*/-1>
             sum += val;
         }
 
-        // reduce    --cf https://docs.nvidia.com/cuda/samples/6_Advanced/reduction/doc/reduction.pdf
-        __shared__ ReduceElemType accumulators[GridDim::maxThreadsPerBlock /*tids*/];
-        accumulators[tid] = sum;
-        __syncthreads();
-        static_assert(GridDim::maxThreadsPerBlock <= 512, "GridDim::maxThreadsPerBlock too large, need to add manually unrolled steps");
-        for (CUDA_LONG i = 256; i; i >>= 1)
-        {
-            if (tid < i && tid + i < tids)
-                accumulators[tid] += accumulators[tid + i];
-            if (0 + i < tids)
-                __syncthreads(); // sync if condition true for at least one thread
-            // TODO: use volatile* and then we can skip the __syncthreads() for the last 32 values. See Amit's allreduce() function implementation in MatrixQuantizer_kernel.cu.
-        }
+        // reduce over the threads of the block
+        sum = BlockReduceSum<ReduceElemType>(sum, tid, tids);
 
         // now set final value to output coordinate
+        // With multiple reduction blocks, the output is the buffer of partial sums of this block (the caller passes alpha = 1, beta = 0).
         if (tid == 0)
         {
-            ElemType val = (ElemType) accumulators[0];
+            ElemType val = (ElemType) sum;
             // scale
             val *= alpha;
             // combine with previous value in target matrix, then write it out
             auto* pout = pointers[pointers.size() - 1];
-            if (reductionBlocks > 1) // multiple blocks: need to use atomicAdd()
-            {
-                // in this case, outer calling code must pass beta = 1
-                val = atomicAdd(pout, val);
-            }
-            else
-            {
-                if (beta != 0)
-                    val += beta * *pout;
-                // save
-                *pout = val;
-            }
+            if (beta != 0)
+                val += beta * *pout;
+            // save
+            *pout = val;
         }
     }
 };
@@ -514,6 +561,8 @@ __global__ void _launchTensorOpWithReduction(ElemType beta, FixedArray<ElemType*
                                              FixedArray<C_unsigned_int, M> reducingOpDims, FixedMatrix<C_int, N, M> reducingStrides, CUDA_LONG reductionBegin, CUDA_LONG reductionChunkSize)
 {
     CUDA_LONG id = gridDim.x * blockIdx.y + blockIdx.x; // input dimensions are Y dimension of blocks in this case, so we can use thread dim for shared-memory/parallelization
+    // if the reduction is split over blocks (Z), the output is a [numElements x gridDim.z] buffer of partial sums
+    pointers[N - 1] += (CUDA_LONG) blockIdx.z * numElements;
     if (id < numElements)                               // note: we have __syncthread() calls but only entire blocks in sync, so this is OK
         TensorOpElement<ElemType, N, M, K, true, K - 1>::Compute(id, beta, pointers, alpha, op, regularOpStrides, regularStrides, reducingOpDims, reducingStrides, reductionBegin, reductionChunkSize);
 }
@@ -544,32 +593,47 @@ static void LaunchTensorOpWithReduction(ElemType beta, array<ElemType*, N> point
 
     // do some optimization for reductions
     // Cases:
-    //  - #output elements >= GPU procs  -->  use one proc per element, do reduction in inner loop
-    //  - reduction dimension fits into a single kernel  -->  launch it that way
-    //  - reduction dimension requires multiple kernels  -->  use atomic add, to avoid temp mem alloc
-    //     - PlusNode: reducing to a bias for small matrices
+    //  - #output elements fill the GPU, or reductions are short  -->  use one thread per element, do reduction in inner loop
+    //  - otherwise  -->  one block per output element, its threads reduce in parallel (warp shuffles, then across warps)
+    //     - PlusNode: reducing to a bias, e.g. 4096 bias values over a 4096-column minibatch
     //     - ScaleNode: big elementwise product reduced to a scalar (dot product)
-    //     - E.g. 3072 GPU procs:
-    //       If >= 3072 reduced output values must be computed, just loop inside.
-    //       If less, and reduction per value does not fit into a single proc,
-    //       then we break it into procs, say, 24.
-    //       This way we will need 24 atomicAdd()s of 3072/24 = 128 values.
-    //       If reduction is along stride=1, then we'd have 24 atomicAdd()s of 32 coalesced writes.
-    //       Does not sound scary at all.
-    //       Precondition: matrix cannot at the same time participate in reduction and operation.
+    //  - if the output elements alone do not give enough blocks to fill the GPU,
+    //    the reduction is also split into chunks over blocks (Z), and combined in a second pass:
+    //     - pass 1 writes the [NN x #chunks] partial sums into a temp buffer
+    //     - pass 2 reduces them over the chunks with one thread per output element, and applies alpha and beta
+    //    E.g. 3072 GPU procs and a dot product: the first pass runs 24 blocks, the second sums 24 values.
+    //    Unlike atomicAdd(), this is deterministic, and works for any beta.
+    //    Precondition: matrix cannot at the same time participate in reduction and operation.
     C_size_t reductionDim = 1; // number of elements to reduce over
     for (C_size_t k = 0; k < reducingOpDimVector.size(); k++)
         reductionDim *= (C_size_t) reducingOpDimVector[k];
     let& props = GridDim::GetDeviceProps();
     GridDim grid(NN);
-    if (reductionDim > 1 && grid.m_blocksPerGrid < props.multiProcessorCount /*    && NN == 10 && reductionDim <= GridDim::maxThreadsPerBlock*/)
+    let numThreadsToFill = props.multiProcessorCount * props.maxThreadsPerMultiProcessor; // threads that the GPU runs at once
+    let warpSize = (C_size_t) props.warpSize;
+    if (reductionDim > 1 && (grid.m_blocksPerGrid < props.multiProcessorCount || (NN < numThreadsToFill && reductionDim >= warpSize)))
     {
         // we are reducing and are underutilizing the multiprocs we have: get more parallelism by doing reduction in parallel
         // Change of strategy: All NN elements get their own block. Reduction gets split over blocks as well.
 
+        // threads of a block stride over their chunk; whole warps, since all lanes take part in the shuffles
+        let numThreadsFor = [warpSize](C_size_t chunkSize)
+        {
+            return (CUDA_LONG) min(CeilDiv(chunkSize, warpSize) * warpSize, (C_size_t) GridDim::maxThreadsPerBlock);
+        };
+        CUDA_LONG numThreadsX = numThreadsFor(reductionDim); // any that's over will be done by looping inside the kernel
+
         // By how much do we underutilize?
-        // We increase #blocks by that factor by breaking reduction into that many chunks.
-        let numReductionChunks = CeilDiv(props.multiProcessorCount, NN);
+        // We increase #blocks by that factor by breaking reduction into that many chunks,
+        // but keep enough elements per thread in each chunk to amortize the second pass.
+        const C_size_t minElementsPerThread = 4;
+        let numBlocksToFill = (C_size_t) props.multiProcessorCount * max(props.maxThreadsPerMultiProcessor / numThreadsX, 1);
+        C_size_t numReductionChunks = CeilDiv(numBlocksToFill, (C_size_t) NN);
+        numReductionChunks = min(numReductionChunks, max(reductionDim / (numThreadsX * minElementsPerThread), (C_size_t) 1));
+        numReductionChunks = min(numReductionChunks, (C_size_t) props.maxGridSize[2]);
+        let reductionChunkSize = CeilDiv(reductionDim, numReductionChunks);
+        numReductionChunks = CeilDiv(reductionDim, reductionChunkSize); // no empty chunks
+        numThreadsX = numThreadsFor(reductionChunkSize);
 
         // NN may be too large for a single dimension
         let blockXOverBy = CeilDiv(NN, props.maxGridSize[0]);
@@ -580,20 +644,41 @@ static void LaunchTensorOpWithReduction(ElemType beta, array<ElemType*, N> point
         //  - X, Y: such that X*Y covers NN
         //  - Z: reduction chunks
 
-        // reduction goes into thread dim X
-        let reductionChunkSize = CeilDiv(reductionDim, numReductionChunks);
-        let numThreadsX = min(reductionChunkSize, GridDim::maxThreadsPerBlock); // any that's over will be done by looping inside the kernel
-
-        if (beta == 1 || numBlocksZ == 1)
+        if (numBlocksZ == 1)
         {
-            _launchTensorOpWithReduction<ElemType, N, M, K><<<dim3(numBlocksX, numBlocksY, numBlocksZ), numThreadsX, numThreadsX * sizeof(ReduceElemType), t_stream>>>(beta, pointers, alpha, op, regularOpStrides, regularStrides, NN, reducingOpDims, reducingStrides, 0, reductionChunkSize);
+            _launchTensorOpWithReduction<ElemType, N, M, K><<<dim3(numBlocksX, numBlocksY, 1), numThreadsX, 0, t_stream>>>(beta, pointers, alpha, op, regularOpStrides, regularStrides, NN, reducingOpDims, reducingStrides, 0, reductionChunkSize);
         }
         else
         {
-            // We need more than one chunk, we will use atomicAdd().
-            // First reset/pre-multiply input; then do the remaining chunks using atomicAdd().
-            _launchTensorOpWithReduction<ElemType, N, M, K><<<dim3(numBlocksX, numBlocksY, 1), numThreadsX, numThreadsX * sizeof(ReduceElemType), t_stream>>>(beta, pointers, alpha, op, regularOpStrides, regularStrides, NN, reducingOpDims, reducingStrides, 0, reductionChunkSize);
-            _launchTensorOpWithReduction<ElemType, N, M, K><<<dim3(numBlocksX, numBlocksY, numBlocksZ - 1), numThreadsX, numThreadsX * sizeof(ReduceElemType), t_stream>>>(/*beta=*/1, pointers, alpha, op, regularOpStrides, regularStrides, NN, reducingOpDims, reducingStrides, reductionChunkSize, reductionChunkSize);
+            // the partial sums are laid out like the output elements (linear index), one plane per chunk
+            SmallVector<ptrdiff_t> partialStrideVector;
+            for (C_size_t k = 0; k < regularOpStrideVector.size(); k++)
+                partialStrideVector.push_back((ptrdiff_t) regularOpStrideVector[k]);
+            int deviceId;
+            CUDA_CALL(cudaGetDevice(&deviceId));
+            ElemType* partials = TracingGPUMemoryAllocator::Allocate<ElemType>(deviceId, (size_t) NN * numReductionChunks);
+
+            // pass 1: partial sums of each chunk, unscaled
+            array<ElemType*, N> partialPointerVector = pointerVector;
+            partialPointerVector[N - 1] = partials;
+            array<SmallVector<ptrdiff_t>, N> partialRegularStrideVectors = regularStrideVectors;
+            partialRegularStrideVectors[N - 1] = partialStrideVector;
+            FixedArray<ElemType*, N> partialPointers(partialPointerVector);
+            FixedMatrix<C_int, N, K> partialRegularStrides(partialRegularStrideVectors);
+            _launchTensorOpWithReduction<ElemType, N, M, K><<<dim3(numBlocksX, numBlocksY, numBlocksZ), numThreadsX, 0, t_stream>>>(/*beta=*/0, partialPointers, /*alpha=*/1, op, regularOpStrides, partialRegularStrides, NN, reducingOpDims, reducingStrides, 0, reductionChunkSize);
+
+            // pass 2: copy-reduce over the chunks into the output  --adjacent threads read adjacent partial sums
+            array<ElemType*, 2> combinePointerVector = {partials, pointerVector[N - 1]};
+            array<SmallVector<ptrdiff_t>, 2> combineRegularStrideVectors = {partialStrideVector, regularStrideVectors[N - 1]};
+            array<SmallVector<ptrdiff_t>, 2> combineReducingStrideVectors = {SmallVector<ptrdiff_t>(1, (ptrdiff_t) NN), SmallVector<ptrdiff_t>(1, 0)};
+            FixedArray<ElemType*, 2> combinePointers(combinePointerVector);
+            FixedMatrix<C_int, 2, K> combineRegularStrides(combineRegularStrideVectors);
+            FixedArray<C_unsigned_int, 1> combineReducingOpDims(SmallVector<size_t>(1, numReductionChunks));
+            FixedMatrix<C_int, 2, 1> combineReducingStrides(combineReducingStrideVectors);
+            _launchTensorOp<ElemType, 2, 1, K><<<grid.m_blocksPerGrid, grid.m_threadsPerBlock, 0, t_stream>>>(beta, combinePointers, alpha, ElementWiseOperator::opCopy, regularOpStrides, combineRegularStrides, grid.m_N, combineReducingOpDims, combineReducingStrides);
+
+            // with the caching allocator this does not synchronize; the buffer is only reused by work queued after pass 2
+            TracingGPUMemoryAllocator::Free<ElemType>(deviceId, partials);
         }
     }
     else
@@ -669,6 +754,231 @@ void LaunchUnaryTensorOp(ElemType beta, const ElemType* pa, ElemType* pb, ElemTy
     }
 }
 
+// -----------------------------------------------------------------------
+// kernel and launch  --tiled unary, for transposes
+// -----------------------------------------------------------------------
+
+// If the stride-1 dimension of the output is not the one of the input (e.g. TransposeDimensionsNode, or stacking along
+// an inner axis), the regular kernel reads or writes with a large stride. This kernel instead reads a tile along the input's
+// stride-1 dimension 'i', and writes it along the output's stride-1 dimension 'j', through shared memory.
+// The remaining (up to 2) dimensions are batch dimensions, strided over by the Z dimension of the grid.
+static const CUDA_LONG tiledTensorOpTileDim = 32;   // tile is this many elements along both i and j
+static const CUDA_LONG tiledTensorOpBlockRows = 8;  // threads per block are tileDim x blockRows, each thread does tileDim/blockRows elements
+static const CUDA_LONG tiledTensorOpMinDim = 16;    // below this, most of a tile would be empty; the regular kernel is better then
+
+template <class ElemType>
+__global__ void _launchTiledTensorOp(ElemType beta, FixedArray<ElemType*, 2> pointers, ElemType alpha, ElementWiseOperator op,
+                                     CUDA_LONG dimI, CUDA_LONG dimJ, CUDA_LONG inStrideJ, CUDA_LONG outStrideI,
+                                     FixedArray<C_unsigned_int, 2> batchDims, FixedMatrix<C_int, 2, 2> batchStrides, CUDA_LONG numBatches)
+{
+    __shared__ ElemType tile[tiledTensorOpTileDim][tiledTensorOpTileDim + 1]; // +1 avoids bank conflicts when reading it transposed
+    const CUDA_LONG i0 = blockIdx.x * tiledTensorOpTileDim;
+    const CUDA_LONG j0 = blockIdx.y * tiledTensorOpTileDim;
+    for (CUDA_LONG batch = blockIdx.z; batch < numBatches; batch += gridDim.z)
+    {
+        // apply the batch index to the pointers
+        CUDA_LONG index0 = batch % batchDims[0];
+        CUDA_LONG index1 = batch / batchDims[0];
+        const ElemType* pin = pointers[0] + index0 * batchStrides(0, 0) + index1 * batchStrides(0, 1);
+        ElemType* pout = pointers[1] + index0 * batchStrides(1, 0) + index1 * batchStrides(1, 1);
+
+        // read the tile along i, and apply the op
+        FixedArray<ElemType*, 2> elementPointers = pointers;
+        for (CUDA_LONG r = threadIdx.y; r < tiledTensorOpTileDim; r += tiledTensorOpBlockRows)
+        {
+            CUDA_LONG i = i0 + threadIdx.x;
+            CUDA_LONG j = j0 + r;
+            if (i < dimI && j < dimJ)
+            {
+                elementPointers[0] = const_cast<ElemType*>(pin) + i + j * inStrideJ;
+                tile[r][threadIdx.x] = TensorOps<ElemType>::Compute(elementPointers, op);
+            }
+        }
+        __syncthreads();
+
+        // write it along j
+        for (CUDA_LONG r = threadIdx.y; r < tiledTensorOpTileDim; r += tiledTensorOpBlockRows)
+        {
+            CUDA_LONG i = i0 + r;
+            CUDA_LONG j = j0 + threadIdx.x;
+            if (i < dimI && j < dimJ)
+            {
+                ElemType val = tile[threadIdx.x][r];
+                // scale
+                val *= alpha;
+                // combine with previous value in target matrix, then write it out
+                ElemType* p = pout + j + i * outStrideI;
+                if (beta != 0)
+                    val += beta * *p;
+                *p = val;
+            }
+        }
+        __syncthreads(); // before the tile is overwritten by the next batch
+    }
+}
+
+// determines the dimensions of the tiled kernel: i = stride-1 dimension of the input, j = of the output
+// Returns false if the regular kernel should be used.
+static bool GetTiledTensorOpDims(const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, 2>& regularStrides, size_t& i, size_t& j)
+{
+    size_t dims = regularOpDims.size();
+    if (dims < 2 || dims > 4)
+        return false;
+    i = dims;
+    j = dims;
+    for (size_t k = 0; k < dims; k++)
+    {
+        if (regularStrides[1][k] == 0) // output must not be broadcasting
+            return false;
+        if (regularStrides[0][k] == 1 && i == dims)
+            i = k;
+        if (regularStrides[1][k] == 1 && j == dims)
+            j = k;
+    }
+    return i < dims && j < dims && i != j &&
+           regularOpDims[i] >= tiledTensorOpMinDim && regularOpDims[j] >= tiledTensorOpMinDim &&
+           CeilDiv((CUDA_LONG) regularOpDims[j], tiledTensorOpTileDim) <= GridDim::GetDeviceProps().maxGridSize[1];
+}
+
+bool CanLaunchTiledTensorOp(const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, 2>& regularStrides)
+{
+    size_t i, j;
+    return GetTiledTensorOpDims(regularOpDims, regularStrides, i, j);
+}
+
+template <class ElemType>
+void LaunchTiledTensorOp(ElemType beta, const ElemType* pa, ElemType* pb, ElemType alpha, ElementWiseOperator op,
+                         const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, 2>& regularStrides)
+{
+    size_t i, j;
+    if (!GetTiledTensorOpDims(regularOpDims, regularStrides, i, j))
+        LogicError("LaunchTiledTensorOp: Not a transposing tensor operation.");
+
+    // the other dimensions are batch dimensions, padded to 2
+    SmallVector<size_t> batchDimVector;
+    array<SmallVector<ptrdiff_t>, 2> batchStrideVectors;
+    CUDA_LONG numBatches = 1;
+    for (size_t k = 0; k < regularOpDims.size(); k++)
+    {
+        if (k == i || k == j)
+            continue;
+        batchDimVector.push_back(regularOpDims[k]);
+        for (size_t n = 0; n < 2; n++)
+            batchStrideVectors[n].push_back(regularStrides[n][k]);
+        numBatches *= (CUDA_LONG) regularOpDims[k];
+    }
+    while (batchDimVector.size() < 2)
+    {
+        batchDimVector.push_back(1);
+        for (size_t n = 0; n < 2; n++)
+            batchStrideVectors[n].push_back(0);
+    }
+    FixedArray<ElemType*, 2> pointers(array<ElemType*, 2>{const_cast<ElemType*>(pa), pb});
+    FixedArray<C_unsigned_int, 2> batchDims(batchDimVector);
+    FixedMatrix<C_int, 2, 2> batchStrides(batchStrideVectors);
+
+    let& props = GridDim::GetDeviceProps();
+    CUDA_LONG dimI = (CUDA_LONG) regularOpDims[i];
+    CUDA_LONG dimJ = (CUDA_LONG) regularOpDims[j];
+    dim3 blocks(CeilDiv(dimI, tiledTensorOpTileDim), CeilDiv(dimJ, tiledTensorOpTileDim), min(numBatches, (CUDA_LONG) props.maxGridSize[2]));
+    dim3 threads(tiledTensorOpTileDim, tiledTensorOpBlockRows);
+    SyncGuard syncGuard;
+    _launchTiledTensorOp<ElemType><<<blocks, threads, 0, t_stream>>>(beta, pointers, alpha, op, dimI, dimJ, (CUDA_LONG) regularStrides[0][j], (CUDA_LONG) regularStrides[1][i],
+                                                                    batchDims, batchStrides, numBatches);
+}
+
+// -----------------------------------------------------------------------
+// kernel and launch  --fused elementwise program (no reduction)
+// -----------------------------------------------------------------------
+
+// Evaluates an entire ElementWiseProgram per output element. Intermediate values stay in registers.
+template <class ElemType, C_int K>
+__global__ void _launchElementWiseProgram(ElemType beta, FixedArray<ElemType*, ElementWiseProgram::MaxInputs + 1> pointers, ElemType alpha, ElementWiseProgram program,
+                                          FixedArray<C_unsigned_int, K> regularOpStrides, FixedMatrix<C_int, ElementWiseProgram::MaxInputs + 1, K> regularStrides, CUDA_LONG numElements)
+{
+    const C_size_t N = ElementWiseProgram::MaxInputs + 1;
+    CUDA_LONG id = GridDim::GetLinearThreadId();
+    if (id >= numElements)
+        return;
+    // map id (location on grid) to the element location in each tensor
+    for (C_int k = K - 1; k >= 0; k--)
+    {
+        C_size_t stride = regularOpStrides[(C_size_t) k];
+        C_size_t index = id / stride; // this dimension
+        id = id % stride;             // remaining dimensions inside this
+        for (C_size_t i = 0; i < N; i++)
+            pointers[i] += index * regularStrides(i, (C_size_t) k);
+    }
+    // fetch the inputs and run the program
+    ElemType inputs[ElementWiseProgram::MaxInputs];
+    for (C_int i = 0; i < ElementWiseProgram::MaxInputs; i++)
+        inputs[i] = i < program.m_numInputs ? *(pointers[i]) : 0;
+    ElemType val = EvaluateElementWiseProgram(program, inputs);
+    // scale
+    val *= alpha;
+    // combine with previous value in target matrix, then write it out
+    auto* pout = pointers[N - 1];
+    if (beta != 0)
+        val += beta * *pout;
+    *pout = val;
+}
+
+template <class ElemType, C_int K>
+static void LaunchElementWiseProgram(ElemType beta, array<ElemType*, ElementWiseProgram::MaxInputs + 1> pointerVector, ElemType alpha, const ElementWiseProgram& program,
+                                     const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, ElementWiseProgram::MaxInputs + 1>& regularStrideVectors)
+{
+    // copy all parameters to CUDA-compatible data structures
+    FixedArray<ElemType*, ElementWiseProgram::MaxInputs + 1> pointers(pointerVector);
+    SmallVector<C_size_t> regularOpStrideVector; // kernel needs the strides for converting thread index back to multi-dimensional tensor index
+    C_size_t numElements = 1;
+    for (C_size_t k = 0; k < regularOpDims.size(); k++)
+    {
+        regularOpStrideVector.push_back(numElements);
+        numElements *= (C_size_t) regularOpDims[k];
+    }
+    FixedArray<C_unsigned_int, K> regularOpStrides(regularOpStrideVector);
+    FixedMatrix<C_int, ElementWiseProgram::MaxInputs + 1, K> regularStrides(regularStrideVectors);
+
+    // launch the kernel
+    CUDA_LONG NN = (CUDA_LONG) numElements; // linear space identifying each individual output element
+    SyncGuard syncGuard;
+    GridDim grid(NN);
+    _launchElementWiseProgram<ElemType, K><<<grid.m_blocksPerGrid, grid.m_threadsPerBlock, 0, t_stream>>>(beta, pointers, alpha, program, regularOpStrides, regularStrides, grid.m_N);
+}
+
+// fused elementwise program with any number of dimensions (up to 4)
+template <class ElemType>
+void ElementWiseProgramOpN(ElemType beta, array<ElemType*, ElementWiseProgram::MaxInputs + 1> pointers, ElemType alpha, const ElementWiseProgram& program,
+                           const array<size_t, ElementWiseProgram::MaxInputs + 1>& offsets,
+                           const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, ElementWiseProgram::MaxInputs + 1>& regularStrides)
+{
+    const size_t N = ElementWiseProgram::MaxInputs + 1;
+    for (size_t i = 0; i < N; i++)
+        pointers[i] += offsets[i];
+    if (GPUTensorJit::ElementWiseProgramOp(beta, pointers, alpha, program, regularOpDims, regularStrides))
+        return;
+    switch (regularOpDims.size())
+    {
+    case 4:
+        return LaunchElementWiseProgram<ElemType, 4>(beta, pointers, alpha, program, regularOpDims, regularStrides);
+    case 3:
+        return LaunchElementWiseProgram<ElemType, 3>(beta, pointers, alpha, program, regularOpDims, regularStrides);
+    case 2:
+        return LaunchElementWiseProgram<ElemType, 2>(beta, pointers, alpha, program, regularOpDims, regularStrides);
+    case 1:
+        return LaunchElementWiseProgram<ElemType, 1>(beta, pointers, alpha, program, regularOpDims, regularStrides);
+    case 0: // scalar: treat as a single 1-dimensional element, since FixedArray<T, 0> cannot be indexed
+    {
+        array<SmallVector<ptrdiff_t>, N> scalarStrides;
+        for (size_t i = 0; i < N; i++)
+            scalarStrides[i].push_back(0);
+        return LaunchElementWiseProgram<ElemType, 1>(beta, pointers, alpha, program, SmallVector<size_t>(1, 1), scalarStrides);
+    }
+    default:
+        LogicError("ElementWiseProgramOp: %d non-flattened input dimensions are not supported.", (C_int) regularOpDims.size());
+    }
+}
+
 // -----------------------------------------------------------------------
 // map runtime parameters N to template parameters
 // -----------------------------------------------------------------------
@@ -703,6 +1013,9 @@ void TensorOpN(ElemType beta, array<ElemType*, N> pointers, ElemType alpha, Elem
 {
     for (C_size_t i = 0; i < N; i++) // N = a small constant, this will be unrolled
         pointers[i] += offsets[i];
+    // a kernel compiled for this op and shape, if enabled and hot (reductions always use the template kernels)
+    if (reducingOpDims.empty() && GPUTensorJit::TensorOp(beta, pointers, alpha, op, regularOpDims, regularStrides))
+        return;
     size_t dims = regularOpDims.size();
     switch (dims)
     {
@@ -750,9 +1063,21 @@ template void TensorOpN<double, 4>(double beta, array<double*, 4> pointers, doub
                                    const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, 4>& regularStrides,
                                    const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, 4>& reducingStrides);
 
+template void ElementWiseProgramOpN<float>(float beta, array<float*, ElementWiseProgram::MaxInputs + 1> pointers, float alpha, const ElementWiseProgram& program,
+                                           const array<size_t, ElementWiseProgram::MaxInputs + 1>& offsets,
+                                           const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, ElementWiseProgram::MaxInputs + 1>& regularStrides);
+template void ElementWiseProgramOpN<double>(double beta, array<double*, ElementWiseProgram::MaxInputs + 1> pointers, double alpha, const ElementWiseProgram& program,
+                                            const array<size_t, ElementWiseProgram::MaxInputs + 1>& offsets,
+                                            const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, ElementWiseProgram::MaxInputs + 1>& regularStrides);
+
 template void LaunchUnaryTensorOp(float beta, const float* pa, float* pb, float alpha, ElementWiseOperator op, size_t regularOpDim);
 template void LaunchUnaryTensorOp(double beta, const double* pa, double* pb, double alpha, ElementWiseOperator op, size_t regularOpDim);
 
+template void LaunchTiledTensorOp(float beta, const float* pa, float* pb, float alpha, ElementWiseOperator op,
+                                  const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, 2>& regularStrides);
+template void LaunchTiledTensorOp(double beta, const double* pa, double* pb, double alpha, ElementWiseOperator op,
+                                  const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, 2>& regularStrides);
+
 }}}
 
 #endif // CPUONLY
@@ -23,6 +23,18 @@ void TensorOpN(ElemType beta, array<ElemType*, N> pointers, ElemType alpha, Elem
                const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, N>& regularStrides,
                const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, N>& reducingStrides);
 
+template <class ElemType>
+void ElementWiseProgramOpN(ElemType beta, array<ElemType*, ElementWiseProgram::MaxInputs + 1> pointers, ElemType alpha, const ElementWiseProgram& program,
+                           const array<size_t, ElementWiseProgram::MaxInputs + 1>& offsets,
+                           const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, ElementWiseProgram::MaxInputs + 1>& regularStrides);
+
 template <class ElemType>
 void LaunchUnaryTensorOp(ElemType beta, const ElemType* pa, ElemType* pb, ElemType alpha, ElementWiseOperator op, size_t regularOpDim);
+
+// unary op whose input and output have different stride-1 dimensions (a transpose), through shared-memory tiles
+bool CanLaunchTiledTensorOp(const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, 2>& regularStrides);
+
+template <class ElemType>
+void LaunchTiledTensorOp(ElemType beta, const ElemType* pa, ElemType* pb, ElemType alpha, ElementWiseOperator op,
+                         const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, 2>& regularStrides);
 } } }
@@ -0,0 +1,479 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// GPUTensorJit.cpp -- elementwise tensor kernels compiled at runtime for the operation and shape they run on
+//
+
+#include "stdafx.h"
+#include "Basics.h"
+#include "GPUTensorJit.h"
+#include "GPUMatrix.h" // for GetStream(), SyncGuard, CUDA_CALL
+#include <cuda.h>
+#include <nvrtc.h>
+#include <climits>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#pragma comment(lib, "cudart.lib")
+#pragma comment(lib, "cuda.lib")
+#pragma comment(lib, "nvrtc.lib")
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// -----------------------------------------------------------------------
+// source code of the generated kernels
+// -----------------------------------------------------------------------
+
+#define JitStr_(x) #x
+#define JitStr(x) JitStr_(x)
+
+#define JitConstant(x) "#define " #x " " JitStr(x) "\n"
+#define JitUnaryMathFn(x)                                                   \
+    "__device__ __forceinline__ float " #x "_(float f) { return " #x "f(f); }\n" \
+    "__device__ __forceinline__ double " #x "_(double f) { return " #x "(f); }\n"
+#define JitFn(signature, body) "template <class T> __device__ __forceinline__ T " signature " { " body " }\n"
+#define JitUnaryOp(op, expr) JitFn("Op" #op "(T a)", "return " #expr ";")
+#define JitBinaryOp(op, expr) JitFn("Op" #op "(T a, T b)", "return " #expr ";")
+#define JitTernaryOp(op, expr) JitFn("Op" #op "(T a, T b, T c)", "return " #expr ";")
+
+// A copy of the definitions in TensorOps.h, which we cannot include into the program that NVRTC compiles.
+// The expressions must be kept the same, so that both kinds of kernels compute the same results.
+static const char* s_jitPrelude =
+    JitConstant(EPS_IN_INVERSE)
+    JitConstant(EPS_IN_LOG)
+    JitConstant(LOG_OF_EPS_IN_LOG)
+    JitConstant(LZERO)
+    JitConstant(MINLOGEXP)
+    JitConstant(LSMALL)
+
+    JitUnaryMathFn(exp)
+    JitUnaryMathFn(log)
+    JitUnaryMathFn(tanh)
+    JitUnaryMathFn(sqrt)
+    JitUnaryMathFn(fabs)
+    JitUnaryMathFn(cos)
+    JitUnaryMathFn(sin)
+
+    JitFn("Sigmoid(T z)", "T e = exp_(-z); return 1 / (e + 1);")
+    JitFn("Sqr(T z)", "return z * z;")
+    JitFn("Sqrt(T z)", "return sqrt_(z > 0 ? z : 0);")
+    JitFn("ClippedLog(T z)", "return z < EPS_IN_LOG ? LOG_OF_EPS_IN_LOG : log_(z);")
+    JitFn("ClippedQuotient(T a, T b)", "if (fabs(b) < EPS_IN_INVERSE) b = b > 0 ? EPS_IN_INVERSE : -EPS_IN_INVERSE; return a / b;")
+    JitFn("LogAdd(T x, T y)", "if (x < y) { T temp = x; x = y; y = temp; } T diff = y - x; "
+                              "if (diff < (T) MINLOGEXP) return (x < (T) LSMALL) ? (T) LZERO : x; "
+                              "return x + log_((T) 1.0 + exp_(diff));")
+
+    JitUnaryOp(Copy, a)
+    JitUnaryOp(Negate, -a)
+    JitUnaryOp(Not, !a)
+    JitUnaryOp(Abs, fabs_(a))
+    JitUnaryOp(Sigmoid, Sigmoid(a))
+    JitUnaryOp(Tanh, tanh_(a))
+    JitUnaryOp(Sqr, Sqr(a))
+    JitUnaryOp(Sqrt, Sqrt(a))
+    JitUnaryOp(Exp, exp_(a))
+    JitUnaryOp(Log, ClippedLog(a))
+    JitUnaryOp(LinearRectifier, a > 0 ? a : 0)
+    JitUnaryOp(Cosine, cos_(a))
+
+    JitBinaryOp(Sum, a + b)
+    JitBinaryOp(Difference, a - b)
+    JitBinaryOp(ElementwiseProduct, a * b)
+    JitBinaryOp(ElementwiseQuotient, ClippedQuotient(a, b))
+    JitBinaryOp(LogSum, LogAdd(a, b))
+    JitBinaryOp(Max, a > b ? a : b)
+    JitBinaryOp(Min, a < b ? a : b)
+    JitBinaryOp(EQ, a == b)
+    JitBinaryOp(NE, a != b)
+    JitBinaryOp(GT, a > b)
+    JitBinaryOp(LT, a < b)
+    JitBinaryOp(GE, a >= b)
+    JitBinaryOp(LE, a <= b)
+    JitBinaryOp(And, (float) ((!!a) && (!!b)))
+    JitBinaryOp(Or, (float) ((!!a) || (!!b)))
+    JitBinaryOp(Xor, (float) ((!!a) ^ (!!b)))
+    JitBinaryOp(MaskNegative, b >= 0 ? a : 0)
+    JitBinaryOp(ElementwiseProductWithSigmoidDerivativeFromOutput, a * (b * (1 - b)))
+    JitBinaryOp(ElementwiseProductWithTanhDerivativeFromOutput, a * (1 - b * b))
+    JitBinaryOp(ElementwiseProductWithLinearRectifierDerivativeFromOutput, b > 0 ? a : 0)
+    JitBinaryOp(ElementwiseProductWithLogDerivativeFromOutput, a * exp_(-b))
+    JitBinaryOp(ElementwiseProductWithCosDerivative, a * -sin_(b))
+    JitBinaryOp(SqrOfDifference, Sqr(a - b))
+
+    JitTernaryOp(Cond, a ? b : c)
+    JitTernaryOp(Clip, a < b ? b : (a > c ? c : a));
+
+// name of the function that implements 'op' in the prelude, or nullptr if there is none
+static const char* JitOpName(ElementWiseOperator op)
+{
+#define CaseJitOpName(oper)             \
+    case ElementWiseOperator::op##oper: \
+        return "Op" #oper
+    switch (op)
+    {
+        ForAllUnaryOps(CaseJitOpName);
+        ForAllBinaryOps(CaseJitOpName);
+        ForAllTernaryOps(CaseJitOpName);
+    default:
+        return nullptr;
+    }
+#undef CaseJitOpName
+}
+
+// Generates a kernel that computes out = alpha * <body> (+ beta * out) for each element. The last operand is the output,
+// the others are the inputs, which 'body' reads as a0, a1, ... It must define 'val'. All dimensions but the outermost, and
+// all strides, are constants in the code.
+static std::string GenerateJitSource(bool isDouble, bool hasBeta, size_t numOperands, const SmallVector<size_t>& regularOpDims,
+                                     const SmallVector<ptrdiff_t>* const* regularStrides, const std::string& body)
+{
+    const size_t rank = regularOpDims.size();
+    std::string source = s_jitPrelude;
+    source += isDouble ? "typedef double T;\n" : "typedef float T;\n";
+    source += "extern \"C\" __global__ void jitTensorKernel(const T beta, const T alpha, const unsigned int numElements";
+    for (size_t i = 0; i < numOperands; i++)
+        source += msra::strfun::strprintf(i + 1 < numOperands ? ", const T* p%d" : ", T* p%d", (int) i);
+    source += ")\n{\n"
+              "    unsigned int id = blockIdx.x * blockDim.x + threadIdx.x;\n"
+              "    if (id >= numElements)\n"
+              "        return;\n";
+
+    // map the thread index to the index in each dimension, with constant divisors
+    std::vector<size_t> opStrides(rank, 1);
+    for (size_t k = 1; k < rank; k++)
+        opStrides[k] = opStrides[k - 1] * regularOpDims[k - 1];
+    for (size_t k = rank; k-- > 1;)
+        source += msra::strfun::strprintf("    const unsigned int i%d = id / %lluu;\n"
+                                          "    id -= i%d * %lluu;\n",
+                                          (int) k, (unsigned long long) opStrides[k], (int) k, (unsigned long long) opStrides[k]);
+
+    // element offset in each operand; dimensions along which an operand is broadcast do not appear
+    std::vector<std::string> offsets(numOperands);
+    for (size_t i = 0; i < numOperands; i++)
+    {
+        for (size_t k = 0; k < rank; k++)
+        {
+            const ptrdiff_t stride = (*regularStrides[i])[k];
+            if (stride == 0)
+                continue;
+            if (!offsets[i].empty())
+                offsets[i] += " + ";
+            if (k == 0) // (the remaining 'id' is the index in the innermost dimension)
+                offsets[i] += msra::strfun::strprintf("(long long) id * %lld", (long long) stride);
+            else
+                offsets[i] += msra::strfun::strprintf("(long long) i%d * %lld", (int) k, (long long) stride);
+        }
+        if (offsets[i].empty())
+            offsets[i] = "0";
+    }
+
+    for (size_t i = 0; i + 1 < numOperands; i++)
+        source += msra::strfun::strprintf("    const T a%d = p%d[%s];\n", (int) i, (int) i, offsets[i].c_str());
+    source += body;
+    const int out = (int) numOperands - 1;
+    source += "    T result = val * alpha;\n";
+    if (hasBeta)
+        source += msra::strfun::strprintf("    result += beta * p%d[%s];\n", out, offsets[out].c_str());
+    source += msra::strfun::strprintf("    p%d[%s] = result;\n}\n", out, offsets[out].c_str());
+    return source;
+}
+
+// -----------------------------------------------------------------------
+// compilation and the caches
+// -----------------------------------------------------------------------
+
+// 64-bit FNV-1a, which unlike std::hash gives the same file names with all compilers
+static unsigned long long JitHash(const std::string& s)
+{
+    unsigned long long hash = 14695981039346656037ull;
+    for (char c : s)
+    {
+        hash ^= (unsigned char) c;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+static bool ReadJitCacheFile(const std::wstring& path, std::string& ptx)
+{
+    FILE* f = _wfopen(path.c_str(), L"rb");
+    if (f == nullptr) // not compiled yet
+        return false;
+    fseek(f, 0, SEEK_END);
+    const long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    ptx.assign(size > 0 ? (size_t) size : 0, '\0');
+    const bool ok = size > 0 && fread(&ptx[0], 1, ptx.size(), f) == ptx.size();
+    fclose(f);
+    return ok;
+}
+
+static void WriteJitCacheFile(const std::wstring& path, const std::string& ptx)
+{
+    // a cache that cannot be written is not an error, we merely lose the benefit on restart
+    FILE* f = _wfopen(path.c_str(), L"wb");
+    if (f == nullptr)
+    {
+        fprintf(stderr, "GPUTensorJit: Could not open '%ls' for writing, the compiled kernel will not be persisted.\n", path.c_str());
+        return;
+    }
+    fwrite(ptx.data(), 1, ptx.size(), f);
+    fclose(f);
+}
+
+static bool CompileJitSource(const std::string& source, const char* archOption, std::string& ptx)
+{
+    nvrtcProgram program;
+    if (nvrtcCreateProgram(&program, source.c_str(), "jitTensorKernel.cu", 0, nullptr, nullptr) != NVRTC_SUCCESS)
+        return false;
+    const char* options[] = { archOption, "--std=c++11" };
+    const nvrtcResult rc = nvrtcCompileProgram(program, sizeof(options) / sizeof(*options), options);
+    if (rc != NVRTC_SUCCESS)
+    {
+        size_t logSize = 0;
+        std::string log;
+        if (nvrtcGetProgramLogSize(program, &logSize) == NVRTC_SUCCESS && logSize > 0)
+        {
+            log.assign(logSize, '\0');
+            nvrtcGetProgramLog(program, &log[0]);
+        }
+        fprintf(stderr, "GPUTensorJit: Compilation failed (%s), using the template kernel instead:\n%s\n", nvrtcGetErrorString(rc), log.c_str());
+        nvrtcDestroyProgram(&program);
+        return false;
+    }
+    size_t ptxSize = 0;
+    const bool ok = nvrtcGetPTXSize(program, &ptxSize) == NVRTC_SUCCESS && ptxSize > 0 &&
+                    (ptx.assign(ptxSize, '\0'), nvrtcGetPTX(program, &ptx[0]) == NVRTC_SUCCESS);
+    nvrtcDestroyProgram(&program);
+    return ok;
+}
+
+// compiles the source (or loads it from the cache directory) for the current device; nullptr if that fails
+static CUfunction LoadJitKernel(const std::string& source)
+{
+    int deviceId, major, minor, nvrtcMajor, nvrtcMinor;
+    CUDA_CALL(cudaGetDevice(&deviceId));
+    CUDA_CALL(cudaDeviceGetAttribute(&major, cudaDevAttrComputeCapabilityMajor, deviceId));
+    CUDA_CALL(cudaDeviceGetAttribute(&minor, cudaDevAttrComputeCapabilityMinor, deviceId));
+    if (nvrtcVersion(&nvrtcMajor, &nvrtcMinor) != NVRTC_SUCCESS)
+        return nullptr;
+    char archOption[64];
+    sprintf(archOption, "--gpu-architecture=compute_%d%d", major, minor);
+
+    std::wstring cacheFile;
+    const auto& cacheDir = GPUMathOptions::GetJitKernelCacheDir();
+    if (!cacheDir.empty())
+    {
+        const auto hash = JitHash(source + archOption + msra::strfun::strprintf(" nvrtc%d.%d", nvrtcMajor, nvrtcMinor));
+        cacheFile = msra::strfun::wstrprintf(L"%ls/tensorKernel_%016llx.ptx", cacheDir.c_str(), hash);
+    }
+
+    // the driver API works on the context that the runtime API made current for this thread, which it creates on first use
+    CUDA_CALL(cudaFree(nullptr));
+
+    std::string ptx;
+    CUmodule module = nullptr;
+    if (!cacheFile.empty() && ReadJitCacheFile(cacheFile, ptx) && cuModuleLoadData(&module, ptx.c_str()) != CUDA_SUCCESS)
+        module = nullptr; // e.g. a file that another process is still writing; compile it ourselves then
+    if (module == nullptr)
+    {
+        if (!CompileJitSource(source, archOption, ptx) || cuModuleLoadData(&module, ptx.c_str()) != CUDA_SUCCESS)
+            return nullptr;
+        if (!cacheFile.empty())
+            WriteJitCacheFile(cacheFile, ptx);
+    }
+    CUfunction function = nullptr;
+    if (cuModuleGetFunction(&function, module, "jitTensorKernel") != CUDA_SUCCESS)
+        return nullptr;
+    return function; // (the module is never unloaded)
+}
+
+struct JitKernel
+{
+    size_t m_numCalls = 0;
+    CUfunction m_function = nullptr;
+    bool m_failed = false;
+};
+
+static const size_t MaxNumJitKernels = 4096; // beyond this, new cases use the template kernels
+
+static std::mutex& JitMutex()
+{
+    static std::mutex mutex;
+    return mutex;
+}
+static std::unordered_map<std::string, JitKernel>& JitKernels()
+{
+    static std::unordered_map<std::string, JitKernel> kernels;
+    return kernels;
+}
+
+template <class T>
+static void AppendToKey(std::string& key, T value)
+{
+    key.append((const char*) &value, sizeof(value));
+}
+
+// Launches the kernel for 'key', compiling it first once it is hot. 'getBody' is only called for compilation.
+// 'pointers' and 'regularStrides' have one entry per operand, the output last.
+template <class ElemType, class GetBody>
+static bool LaunchJitKernel(std::string& key, const GetBody& getBody, ElemType beta, ElemType alpha, size_t numOperands, ElemType* const* pointers,
+                            const SmallVector<size_t>& regularOpDims, const SmallVector<ptrdiff_t>* const* regularStrides)
+{
+    size_t numElements = 1;
+    for (size_t k = 0; k < regularOpDims.size(); k++)
+        numElements *= regularOpDims[k];
+    if (numElements == 0 || numElements > (size_t) INT_MAX) // (as the template kernels, we index with 32 bits)
+        return false;
+
+    // the key identifies the generated code: everything but the extent of the outermost dimension, the pointers and the scalars
+    int deviceId;
+    CUDA_CALL(cudaGetDevice(&deviceId));
+    AppendToKey(key, deviceId);
+    AppendToKey(key, (char) sizeof(ElemType));
+    AppendToKey(key, (char) (beta != 0));
+    AppendToKey(key, regularOpDims.size());
+    for (size_t k = 0; k + 1 < regularOpDims.size(); k++)
+        AppendToKey(key, regularOpDims[k]);
+    for (size_t i = 0; i < numOperands; i++)
+        for (size_t k = 0; k < regularOpDims.size(); k++)
+            AppendToKey(key, (*regularStrides[i])[k]);
+
+    CUfunction function;
+    {
+        std::lock_guard<std::mutex> lock(JitMutex());
+        auto& kernels = JitKernels();
+        auto iter = kernels.find(key);
+        if (iter == kernels.end())
+        {
+            if (kernels.size() >= MaxNumJitKernels)
+                return false;
+            iter = kernels.insert(std::make_pair(key, JitKernel())).first;
+        }
+        auto& kernel = iter->second;
+        if (kernel.m_function == nullptr)
+        {
+            if (kernel.m_failed || ++kernel.m_numCalls < GPUTensorJit::MinCallsBeforeCompile)
+                return false;
+            kernel.m_function = LoadJitKernel(GenerateJitSource(sizeof(ElemType) == sizeof(double), beta != 0, numOperands, regularOpDims, regularStrides, getBody()));
+            kernel.m_failed = kernel.m_function == nullptr;
+            if (kernel.m_failed)
+                return false;
+        }
+        function = kernel.m_function;
+    }
+
+    unsigned int numElementsArg = (unsigned int) numElements;
+    void* args[3 + ElementWiseProgram::MaxInputs + 1] = { &beta, &alpha, &numElementsArg };
+    for (size_t i = 0; i < numOperands; i++)
+        args[3 + i] = (void*) &pointers[i];
+    const unsigned int threadsPerBlock = 512;
+    const unsigned int numBlocks = (unsigned int) ((numElements + threadsPerBlock - 1) / threadsPerBlock);
+    SyncGuard syncGuard;
+    const CUresult rc = cuLaunchKernel(function, numBlocks, 1, 1, threadsPerBlock, 1, 1, 0, (CUstream) GetStream(), args, nullptr);
+    if (rc != CUDA_SUCCESS)
+    {
+        const char* message = nullptr;
+        cuGetErrorString(rc, &message);
+        RuntimeError("GPUTensorJit: Kernel launch failed: %s", message ? message : "unknown error");
+    }
+    return true;
+}
+
+// -----------------------------------------------------------------------
+// GPUTensorJit
+// -----------------------------------------------------------------------
+
+template <class ElemType, size_t N>
+/*static*/ bool GPUTensorJit::TensorOp(ElemType beta, const std::array<ElemType*, N>& pointers, ElemType alpha, ElementWiseOperator op,
+                                       const SmallVector<size_t>& regularOpDims, const std::array<SmallVector<ptrdiff_t>, N>& regularStrides)
+{
+    if (!GPUMathOptions::JitTensorKernels())
+        return false;
+    const char* opName = JitOpName(op);
+    if (opName == nullptr || ElementWiseProgram::GetNumArgs(op) != (int) N - 1)
+        return false;
+
+    const auto getBody = [opName]()
+    {
+        std::string body = std::string("    const T val = ") + opName + "(";
+        for (size_t i = 0; i + 1 < N; i++)
+            body += msra::strfun::strprintf(i == 0 ? "a%d" : ", a%d", (int) i);
+        return body + ");\n";
+    };
+    std::string key(1, 'o');
+    AppendToKey(key, op);
+    const SmallVector<ptrdiff_t>* strides[N];
+    for (size_t i = 0; i < N; i++)
+        strides[i] = &regularStrides[i];
+    return LaunchJitKernel(key, getBody, beta, alpha, N, pointers.data(), regularOpDims, strides);
+}
+
+template <class ElemType>
+/*static*/ bool GPUTensorJit::ElementWiseProgramOp(ElemType beta, const std::array<ElemType*, ElementWiseProgram::MaxInputs + 1>& pointers, ElemType alpha, const ElementWiseProgram& program,
+                                                   const SmallVector<size_t>& regularOpDims, const std::array<SmallVector<ptrdiff_t>, ElementWiseProgram::MaxInputs + 1>& regularStrides)
+{
+    if (!GPUMathOptions::JitTensorKernels() || program.m_numInstructions == 0)
+        return false;
+
+    // each instruction becomes one statement; registers below MaxInputs are the inputs
+    const auto getBody = [&program]()
+    {
+        const auto reg = [](int r)
+        {
+            return msra::strfun::strprintf(r < ElementWiseProgram::MaxInputs ? "a%d" : "r%d", r);
+        };
+        std::string body;
+        for (int i = 0; i < program.m_numInstructions; i++)
+        {
+            const auto& instr = program.m_instructions[i];
+            body += msra::strfun::strprintf("    const T r%d = %s(", ElementWiseProgram::MaxInputs + i, JitOpName(instr.op));
+            for (int j = 0; j < instr.numArgs; j++)
+                body += (j > 0 ? ", " : "") + reg(instr.args[j]);
+            body += ");\n";
+        }
+        return body + msra::strfun::strprintf("    const T val = r%d;\n", ElementWiseProgram::MaxInputs + program.m_numInstructions - 1);
+    };
+    std::string key(1, 'p');
+    AppendToKey(key, program.m_numInputs);
+    for (int i = 0; i < program.m_numInstructions; i++)
+    {
+        const auto& instr = program.m_instructions[i];
+        AppendToKey(key, instr.op);
+        for (int j = 0; j < instr.numArgs; j++)
+            AppendToKey(key, instr.args[j]);
+    }
+
+    // only the inputs that the program uses are operands of the kernel
+    const size_t numOperands = program.m_numInputs + 1;
+    ElemType* operandPointers[ElementWiseProgram::MaxInputs + 1];
+    const SmallVector<ptrdiff_t>* strides[ElementWiseProgram::MaxInputs + 1];
+    for (size_t i = 0; i < numOperands; i++)
+    {
+        const size_t j = i + 1 < numOperands ? i : ElementWiseProgram::MaxInputs;
+        operandPointers[i] = pointers[j];
+        strides[i] = &regularStrides[j];
+    }
+    return LaunchJitKernel(key, getBody, beta, alpha, numOperands, operandPointers, regularOpDims, strides);
+}
+
+template bool GPUTensorJit::TensorOp<float, 2>(float beta, const std::array<float*, 2>& pointers, float alpha, ElementWiseOperator op,
+                                               const SmallVector<size_t>& regularOpDims, const std::array<SmallVector<ptrdiff_t>, 2>& regularStrides);
+template bool GPUTensorJit::TensorOp<float, 3>(float beta, const std::array<float*, 3>& pointers, float alpha, ElementWiseOperator op,
+                                               const SmallVector<size_t>& regularOpDims, const std::array<SmallVector<ptrdiff_t>, 3>& regularStrides);
+template bool GPUTensorJit::TensorOp<float, 4>(float beta, const std::array<float*, 4>& pointers, float alpha, ElementWiseOperator op,
+                                               const SmallVector<size_t>& regularOpDims, const std::array<SmallVector<ptrdiff_t>, 4>& regularStrides);
+template bool GPUTensorJit::TensorOp<double, 2>(double beta, const std::array<double*, 2>& pointers, double alpha, ElementWiseOperator op,
+                                                const SmallVector<size_t>& regularOpDims, const std::array<SmallVector<ptrdiff_t>, 2>& regularStrides);
+template bool GPUTensorJit::TensorOp<double, 3>(double beta, const std::array<double*, 3>& pointers, double alpha, ElementWiseOperator op,
+                                                const SmallVector<size_t>& regularOpDims, const std::array<SmallVector<ptrdiff_t>, 3>& regularStrides);
+template bool GPUTensorJit::TensorOp<double, 4>(double beta, const std::array<double*, 4>& pointers, double alpha, ElementWiseOperator op,
+                                                const SmallVector<size_t>& regularOpDims, const std::array<SmallVector<ptrdiff_t>, 4>& regularStrides);
+
+template bool GPUTensorJit::ElementWiseProgramOp<float>(float beta, const std::array<float*, ElementWiseProgram::MaxInputs + 1>& pointers, float alpha, const ElementWiseProgram& program,
+                                                        const SmallVector<size_t>& regularOpDims, const std::array<SmallVector<ptrdiff_t>, ElementWiseProgram::MaxInputs + 1>& regularStrides);
+template bool GPUTensorJit::ElementWiseProgramOp<double>(double beta, const std::array<double*, ElementWiseProgram::MaxInputs + 1>& pointers, double alpha, const ElementWiseProgram& program,
+                                                         const SmallVector<size_t>& regularOpDims, const std::array<SmallVector<ptrdiff_t>, ElementWiseProgram::MaxInputs + 1>& regularStrides);
+} } }
@@ -0,0 +1,55 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// GPUTensorJit.h -- elementwise tensor kernels compiled at runtime for the operation and shape they run on
+//
+
+#pragma once
+
+#include "CommonMatrix.h"
+#include "TensorShape.h" // for SmallVector
+#include <array>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// -----------------------------------------------------------------------
+// GPUTensorJit -- runtime-specialized kernels for elementwise tensor ops
+//
+// The template kernels of GPUTensor.cu take the op as a runtime argument and
+// switch on it per element, and loop over the dimensions with strides that
+// are kernel arguments. For an op that keeps running on the same shape, we
+// instead generate a kernel in which the op (or the whole ElementWiseProgram)
+// is inlined and the dimensions and strides are constants, so that index
+// math is done with constant divisors and broadcast operands cost nothing.
+// The source is compiled with NVRTC and loaded through the driver API.
+//
+// Only ops without reduction go through here. A kernel is compiled once the
+// same case has been seen MinCallsBeforeCompile times, so that shapes that
+// occur only once do not pay for a compilation. The extent of the outermost
+// dimension is not part of the kernel, so a changing minibatch size does not
+// cause recompilation.
+//
+// The compiled kernels are kept per device for the lifetime of the process.
+// If GPUMathOptions::GetJitKernelCacheDir() is set, the PTX is also stored
+// there, keyed by a hash of the source, compute capability and NVRTC version.
+//
+// Each function returns false if it did not launch anything (disabled, not
+// hot yet, unsupported op, or compilation failed); the caller then launches
+// the template kernel. A failed compilation is logged once and not retried.
+// -----------------------------------------------------------------------
+
+class GPUTensorJit
+{
+public:
+    static const size_t MinCallsBeforeCompile = 3;
+
+    template <class ElemType, size_t N>
+    static bool TensorOp(ElemType beta, const std::array<ElemType*, N>& pointers, ElemType alpha, ElementWiseOperator op,
+                         const SmallVector<size_t>& regularOpDims, const std::array<SmallVector<ptrdiff_t>, N>& regularStrides);
+
+    template <class ElemType>
+    static bool ElementWiseProgramOp(ElemType beta, const std::array<ElemType*, ElementWiseProgram::MaxInputs + 1>& pointers, ElemType alpha, const ElementWiseProgram& program,
+                                     const SmallVector<size_t>& regularOpDims, const std::array<SmallVector<ptrdiff_t>, ElementWiseProgram::MaxInputs + 1>& regularStrides);
+};
+} } }
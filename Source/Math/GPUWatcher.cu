@@ -9,8 +9,16 @@
 #ifndef CPUONLY
 
 #include "GPUWatcher.h"
+#include "CUDACachingMemAllocator.h"
 #include <cuda.h>
 #include <cuda_runtime.h>
+#include <nvml.h>
+#pragma comment(lib, "nvml.lib")
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 
 int GPUWatcher::GetGPUIdWithTheMostFreeMemory()
 {
@@ -53,12 +61,157 @@ size_t GPUWatcher::GetFreeMemoryOnCUDADevice(int devId)
         return free;
 }
 
+// The samples are summed up in a GPUTelemetrySummary, and averaged when it is taken.
+struct GPUWatcher::Sampler
+{
+    int m_deviceId;
+    nvmlDevice_t m_device;
+    std::chrono::milliseconds m_interval;
+
+    std::mutex m_mutex; // protects everything below
+    std::condition_variable m_stopRequested;
+    bool m_stop = false;
+    GPUTelemetrySummary m_sums;
+    size_t m_numThrottledSamples = 0;
+
+    std::thread m_thread;
+
+    void Run()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (!m_stop)
+        {
+            lock.unlock();
+            Sample();
+            lock.lock();
+            m_stopRequested.wait_for(lock, m_interval, [this]() { return m_stop; });
+        }
+    }
+
+    // A query that fails leaves its value out of the sample; they only fail if the GPU does not support them.
+    void Sample()
+    {
+        nvmlUtilization_t utilization = {};
+        nvmlMemory_t memory = {};
+        unsigned int txKBPerSecond = 0, rxKBPerSecond = 0, smClockMHz = 0;
+        unsigned long long throttleReasons = 0;
+        nvmlDeviceGetUtilizationRates(m_device, &utilization);
+        nvmlDeviceGetMemoryInfo(m_device, &memory);
+        nvmlDeviceGetPcieThroughput(m_device, NVML_PCIE_UTIL_TX_BYTES, &txKBPerSecond);
+        nvmlDeviceGetPcieThroughput(m_device, NVML_PCIE_UTIL_RX_BYTES, &rxKBPerSecond);
+        nvmlDeviceGetClockInfo(m_device, NVML_CLOCK_SM, &smClockMHz);
+        nvmlDeviceGetCurrentClocksThrottleReasons(m_device, &throttleReasons);
+        // an idle GPU, or one running at the clocks the user set, is not held back
+        throttleReasons &= ~(unsigned long long) (nvmlClocksThrottleReasonGpuIdle | nvmlClocksThrottleReasonApplicationsClocksSetting);
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_sums.m_numSamples++;
+        m_sums.m_averageUtilization += utilization.gpu;
+        m_sums.m_averageMemoryUtilization += utilization.memory;
+        m_sums.m_peakMemoryUsed = std::max(m_sums.m_peakMemoryUsed, (size_t) memory.used);
+        m_sums.m_totalMemory = (size_t) memory.total;
+        m_sums.m_averagePcieTxMBPerSecond += txKBPerSecond / 1024.0;
+        m_sums.m_averagePcieRxMBPerSecond += rxKBPerSecond / 1024.0;
+        m_sums.m_averageSmClockMHz += smClockMHz;
+        if (throttleReasons != 0)
+        {
+            m_numThrottledSamples++;
+            m_sums.m_throttleReasons |= throttleReasons;
+        }
+    }
+};
+
 GPUWatcher::GPUWatcher(void)
 {
 }
 
 GPUWatcher::~GPUWatcher(void)
 {
+    StopSampling();
+}
+
+bool GPUWatcher::StartSampling(int deviceId, size_t intervalMs)
+{
+    StopSampling();
+
+    // NVML and CUDA number the devices differently; the PCI bus id is common to both.
+    char pciBusId[32];
+    if (cudaDeviceGetPCIBusId(pciBusId, sizeof(pciBusId), deviceId) != cudaSuccess)
+    {
+        return false;
+    }
+    if (nvmlInit() != NVML_SUCCESS)
+    {
+        return false;
+    }
+    nvmlDevice_t device;
+    if (nvmlDeviceGetHandleByPciBusId(pciBusId, &device) != NVML_SUCCESS)
+    {
+        nvmlShutdown();
+        return false;
+    }
+
+    m_sampler.reset(new Sampler());
+    m_sampler->m_deviceId = deviceId;
+    m_sampler->m_device = device;
+    m_sampler->m_interval = std::chrono::milliseconds(std::max(intervalMs, (size_t) 1));
+    Sampler* sampler = m_sampler.get();
+    sampler->m_thread = std::thread([sampler]() { sampler->Run(); });
+    return true;
+}
+
+void GPUWatcher::StopSampling()
+{
+    if (!m_sampler)
+    {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_sampler->m_mutex);
+        m_sampler->m_stop = true;
+    }
+    m_sampler->m_stopRequested.notify_all();
+    m_sampler->m_thread.join();
+    m_sampler.reset();
+    nvmlShutdown(); // NVML counts its initializations, so this does not affect other users such as BestGpu
+}
+
+GPUTelemetrySummary GPUWatcher::TakeSummary()
+{
+    GPUTelemetrySummary summary;
+    if (!m_sampler)
+    {
+        return summary;
+    }
+
+    size_t numThrottledSamples;
+    {
+        std::lock_guard<std::mutex> lock(m_sampler->m_mutex);
+        summary = m_sampler->m_sums;
+        numThrottledSamples = m_sampler->m_numThrottledSamples;
+        m_sampler->m_sums = GPUTelemetrySummary();
+        m_sampler->m_numThrottledSamples = 0;
+    }
+
+    if (summary.m_numSamples > 0)
+    {
+        double numSamples = (double) summary.m_numSamples;
+        summary.m_averageUtilization /= numSamples;
+        summary.m_averageMemoryUtilization /= numSamples;
+        summary.m_averagePcieTxMBPerSecond /= numSamples;
+        summary.m_averagePcieRxMBPerSecond /= numSamples;
+        summary.m_averageSmClockMHz /= numSamples;
+        summary.m_throttledFraction = numThrottledSamples / numSamples;
+    }
+
+    if (Microsoft::MSR::CNTK::CUDACachingMemAllocator::IsEnabled())
+    {
+        auto statistics = Microsoft::MSR::CNTK::CUDACachingMemAllocator::ForDevice(m_sampler->m_deviceId).GetStatistics();
+        summary.m_allocatorPeakBytesInUse = statistics.m_peakBytesInUse;
+        summary.m_allocatorPeakBytesReserved = statistics.m_peakBytesReserved;
+    }
+    return summary;
 }
 
 #endif // CPUONLY
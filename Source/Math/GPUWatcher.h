@@ -6,6 +6,27 @@
 #pragma once
 
 #include "GPUMatrix.h"
+#include <memory>
+
+// Summary of the samples a GPUWatcher took since the last call to TakeSummary().
+struct GPUTelemetrySummary
+{
+    size_t m_numSamples = 0;
+    double m_averageUtilization = 0;          // percent of the time a kernel was running
+    double m_averageMemoryUtilization = 0;    // percent of the time the device memory was read or written
+    size_t m_peakMemoryUsed = 0;              // bytes in use on the device, by all processes
+    size_t m_totalMemory = 0;
+    size_t m_allocatorPeakBytesInUse = 0;     // high-water marks of the CUDACachingMemAllocator of the device, since the start
+    size_t m_allocatorPeakBytesReserved = 0;
+    double m_averagePcieTxMBPerSecond = 0;    // host-bound PCIe traffic
+    double m_averagePcieRxMBPerSecond = 0;    // device-bound PCIe traffic
+    double m_averageSmClockMHz = 0;
+    double m_throttledFraction = 0;           // of the samples in which the SM clock was throttled, for other reasons than idleness
+    unsigned long long m_throttleReasons = 0; // the nvmlClocksThrottleReason bits of those samples
+};
+
+#pragma warning(push)
+#pragma warning(disable : 4251) // needs to have dll-interface to be used by clients of... (std::unique_ptr)
 
 class MATH_API GPUWatcher
 {
@@ -14,4 +35,18 @@ public:
     static int GetGPUIdWithTheMostFreeMemory();
     GPUWatcher(void);
     ~GPUWatcher(void);
+
+    // Samples the device with NVML every 'intervalMs' milliseconds on a background thread, until StopSampling().
+    // Returns false if NVML does not know the device.
+    bool StartSampling(int deviceId, size_t intervalMs);
+    void StopSampling();
+
+    // Summarizes the samples since the last call, and starts a new summary.
+    GPUTelemetrySummary TakeSummary();
+
+private:
+    struct Sampler;
+    std::unique_ptr<Sampler> m_sampler;
 };
+
+#pragma warning(pop)
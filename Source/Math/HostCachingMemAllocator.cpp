@@ -0,0 +1,239 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// HostCachingMemAllocator.cpp -- size-bucketed caching allocator for aligned host memory
+//
+
+#include "stdafx.h"
+#include "Basics.h"
+#include "HostCachingMemAllocator.h"
+#include "CUDACachingMemAllocator.h" // for RoundUp()
+#include "HostMemoryPlacement.h"
+#include <algorithm>
+#ifdef _WIN32
+#include <malloc.h>
+#else
+#include <stdlib.h>
+#include <sys/mman.h>
+#endif
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+bool HostCachingMemAllocator::s_enabled = true;
+HostCachingMemAllocator::HugePages HostCachingMemAllocator::s_hugePages = HostCachingMemAllocator::HugePages::none;
+
+void HostCachingMemAllocator::SetEnabled(bool enabled)
+{
+    if (!enabled && s_enabled)
+        Instance().ReleaseCachedMemory();
+    s_enabled = enabled;
+}
+
+bool HostCachingMemAllocator::IsEnabled()
+{
+    return s_enabled;
+}
+
+void HostCachingMemAllocator::SetHugePages(const std::wstring& mode)
+{
+    if (mode.empty() || mode == L"none")
+        s_hugePages = HugePages::none;
+    else if (mode == L"transparent")
+        s_hugePages = HugePages::transparent;
+    else if (mode == L"explicit")
+        s_hugePages = HugePages::explicitPool;
+    else
+        InvalidArgument("Invalid value '%ls' for hugePages parameter. Allowed are 'none', 'transparent', and 'explicit'.", mode.c_str());
+#ifdef _WIN32
+    if (s_hugePages != HugePages::none)
+        fprintf(stderr, "HostCachingMemAllocator: Huge pages are not supported on Windows, ignoring hugePages = %ls.\n", mode.c_str());
+    s_hugePages = HugePages::none;
+#endif
+}
+
+HostCachingMemAllocator::HugePages HostCachingMemAllocator::GetHugePages()
+{
+    return s_hugePages;
+}
+
+// same buckets as for GPU memory, but at least one cache line, and whole huge pages if the block gets them
+size_t HostCachingMemAllocator::RoundUp(size_t size)
+{
+    size_t bucketSize = CUDACachingMemAllocator::RoundUp(size);
+    if (bucketSize >= HugePageSize && s_hugePages != HugePages::none)
+        bucketSize = (bucketSize + HugePageSize - 1) / HugePageSize * HugePageSize;
+    return bucketSize;
+}
+
+HostCachingMemAllocator& HostCachingMemAllocator::Instance()
+{
+    // Note: intentionally never destructed, since static Matrix objects may free their memory after it during process exit.
+    static HostCachingMemAllocator* allocator = new HostCachingMemAllocator();
+    return *allocator;
+}
+
+HostCachingMemAllocator::HostCachingMemAllocator()
+{
+}
+
+HostCachingMemAllocator::Statistics HostCachingMemAllocator::GetStatistics() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats;
+}
+
+void HostCachingMemAllocator::PrintStatistics() const
+{
+    let stats = GetStatistics();
+    const double MB = 1024.0 * 1024.0;
+    fprintf(stderr, "CPU memory cache statistics: %d allocations, %.2f%% cache hits, %d system allocations (%d with huge pages), %d system frees; "
+                    "in use = %.1f MB (peak %.1f MB), cached = %.1f MB, peak reserved = %.1f MB, fragmentation = %.2f%%\n",
+            (int) stats.m_numMallocs, 100.0 * stats.HitRate(), (int) stats.m_numSystemMallocs, (int) stats.m_numHugePageBlocks, (int) stats.m_numSystemFrees,
+            stats.m_bytesInUse / MB, stats.m_peakBytesInUse / MB, stats.m_bytesCached / MB, stats.m_peakBytesReserved / MB, 100.0 * stats.Fragmentation());
+}
+
+void* HostCachingMemAllocator::SystemMalloc(size_t size, bool& isMapped)
+{
+    isMapped = false;
+    void* p = nullptr;
+#ifdef _WIN32
+    p = _aligned_malloc(size, Alignment);
+#else
+    if (size >= HugePageSize && s_hugePages != HugePages::none)
+    {
+#ifdef MAP_HUGETLB
+        if (s_hugePages == HugePages::explicitPool)
+        {
+            p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            if (p != MAP_FAILED)
+            {
+                isMapped = true;
+                m_stats.m_numHugePageBlocks++;
+                return p;
+            }
+            p = nullptr; // pool exhausted (or not configured): fall back to transparent huge pages
+        }
+#endif
+        if (posix_memalign(&p, HugePageSize, size) != 0)
+            return nullptr;
+#ifdef MADV_HUGEPAGE
+        madvise(p, size, MADV_HUGEPAGE); // (only a hint; fails if transparent huge pages are disabled in the kernel)
+#endif
+        m_stats.m_numHugePageBlocks++;
+    }
+    else if (posix_memalign(&p, Alignment, size) != 0)
+        return nullptr;
+#endif
+    return p;
+}
+
+void HostCachingMemAllocator::SystemFree(void* p, size_t size, bool isMapped)
+{
+#ifdef _WIN32
+    UNUSED(size);
+    UNUSED(isMapped);
+    _aligned_free(p);
+#else
+    if (isMapped)
+        munmap(p, size);
+    else
+        free(p);
+#endif
+    m_stats.m_numSystemFrees++;
+}
+
+void HostCachingMemAllocator::ReleaseCachedMemoryNoLock()
+{
+    for (auto& freeBlock : m_freeBlocks)
+    {
+        auto iter = m_blocks.find(freeBlock.second);
+        SystemFree(freeBlock.second, iter->second.m_size, iter->second.m_isMapped);
+        m_blocks.erase(iter);
+    }
+    m_freeBlocks.clear();
+    m_stats.m_bytesCached = 0;
+}
+
+void* HostCachingMemAllocator::Malloc(size_t size)
+{
+    if (size == 0)
+        return nullptr;
+
+    const size_t bucketSize = RoundUp(size);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stats.m_numMallocs++;
+
+    // best fit among cached blocks; we accept a somewhat larger block (up to 1.5 x the bucket size)
+    // rather than holding on to more memory
+    void* p = nullptr;
+    size_t blockSize = bucketSize;
+    auto iter = s_enabled ? m_freeBlocks.lower_bound(bucketSize) : m_freeBlocks.end();
+    if (iter != m_freeBlocks.end() && iter->first <= bucketSize + bucketSize / 2)
+    {
+        p = iter->second;
+        blockSize = iter->first;
+        m_freeBlocks.erase(iter);
+        m_stats.m_bytesCached -= blockSize;
+        m_stats.m_numCacheHits++;
+    }
+    else
+    {
+        bool isMapped;
+        p = SystemMalloc(bucketSize, isMapped);
+        if (p == nullptr && m_stats.m_bytesCached > 0)
+        {
+            // out of memory: give the cached blocks back to the system and try once more
+            ReleaseCachedMemoryNoLock();
+            p = SystemMalloc(bucketSize, isMapped);
+        }
+        if (p == nullptr)
+            RuntimeError("HostCachingMemAllocator: Allocation of %d bytes failed.", (int) bucketSize);
+        m_stats.m_numSystemMallocs++;
+        m_blocks[p] = Block{bucketSize, 0, isMapped};
+
+        // no page of a fresh block has been touched yet
+        HostMemoryPlacement::PlaceOnNode(p, bucketSize);
+    }
+
+    m_blocks[p].m_requested = size;
+    m_stats.m_bytesInUse += blockSize;
+    m_stats.m_bytesRequested += size;
+    m_stats.m_peakBytesInUse = std::max(m_stats.m_peakBytesInUse, m_stats.m_bytesInUse);
+    m_stats.m_peakBytesReserved = std::max(m_stats.m_peakBytesReserved, m_stats.m_bytesInUse + m_stats.m_bytesCached);
+    return p;
+}
+
+void HostCachingMemAllocator::Free(void* p)
+{
+    if (p == nullptr)
+        return;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto iter = m_blocks.find(p);
+    if (iter == m_blocks.end())
+        LogicError("HostCachingMemAllocator: Attempted to free a block (%p) that was not allocated by this allocator.", p);
+
+    const size_t blockSize = iter->second.m_size;
+    m_stats.m_bytesInUse -= blockSize;
+    m_stats.m_bytesRequested -= iter->second.m_requested;
+
+    if (s_enabled)
+    {
+        m_freeBlocks.insert(std::make_pair(blockSize, p));
+        m_stats.m_bytesCached += blockSize;
+    }
+    else
+    {
+        SystemFree(p, blockSize, iter->second.m_isMapped);
+        m_blocks.erase(iter);
+    }
+}
+
+void HostCachingMemAllocator::ReleaseCachedMemory()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    ReleaseCachedMemoryNoLock();
+}
+} } }
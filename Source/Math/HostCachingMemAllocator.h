@@ -0,0 +1,152 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// HostCachingMemAllocator.h -- size-bucketed caching allocator for aligned host memory
+//
+
+#pragma once
+
+#include "MemAllocator.h"
+#include <map>
+#include <unordered_map>
+#include <mutex>
+#include <string>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+#ifdef _WIN32
+#ifdef MATH_EXPORTS
+#define MATH_API __declspec(dllexport)
+#else
+#define MATH_API __declspec(dllimport)
+#endif
+#else // no DLLs on Linux
+#define MATH_API
+#endif
+
+// -----------------------------------------------------------------------
+// HostCachingMemAllocator -- process-wide caching allocator for the arrays
+// of CPUMatrix and CPUSparseMatrix
+//
+// The host counterpart of CUDACachingMemAllocator, with the same buckets.
+// When minibatch sizes vary, matrices get resized all the time. Freed blocks
+// are kept in a free list and handed out again for requests of a similar
+// size, instead of going through malloc/free, which for large arrays means
+// mmap/munmap and page faults on every first touch.
+//
+// All blocks are aligned to Alignment bytes (a cache line, and the width of
+// an AVX-512 register). Blocks of at least HugePageSize bytes can be backed
+// by huge pages, see SetHugePages():
+//  - 'transparent': the blocks are aligned to huge pages and marked with
+//    madvise(MADV_HUGEPAGE), so the kernel backs them with huge pages where
+//    it can;
+//  - 'explicit': the blocks are mapped from the preallocated huge page pool
+//    (MAP_HUGETLB, see /proc/sys/vm/nr_hugepages), falling back to
+//    'transparent' when the pool is exhausted.
+// Huge pages are only implemented on Linux.
+//
+// Cached memory is only returned to the system upon ReleaseCachedMemory(),
+// or when an allocation fails.
+// -----------------------------------------------------------------------
+
+#pragma warning(push)
+#pragma warning(disable : 4251) // needs to have dll-interface to be used by clients of... (std::map etc.)
+
+class MATH_API HostCachingMemAllocator : public MemAllocator
+{
+public:
+    static const size_t Alignment = 64;
+    static const size_t HugePageSize = 2 * 1024 * 1024;
+
+    enum class HugePages
+    {
+        none,
+        transparent,
+        explicitPool
+    };
+
+    struct Statistics
+    {
+        size_t m_numMallocs = 0;        // number of Malloc() calls
+        size_t m_numCacheHits = 0;      // Malloc() calls served from the cache
+        size_t m_numSystemMallocs = 0;  // actual allocations from the system
+        size_t m_numSystemFrees = 0;    // actual releases to the system
+        size_t m_numHugePageBlocks = 0; // system allocations that asked for huge pages
+        size_t m_bytesRequested = 0;    // sum of requested sizes of blocks currently handed out
+        size_t m_bytesInUse = 0;        // sum of (bucketed) sizes of blocks currently handed out
+        size_t m_peakBytesInUse = 0;    // high-water mark of m_bytesInUse
+        size_t m_bytesCached = 0;       // bytes sitting in the free list
+        size_t m_peakBytesReserved = 0; // high-water mark of m_bytesInUse + m_bytesCached, i.e. what we hold from the system
+
+        double HitRate() const
+        {
+            return m_numMallocs ? (double) m_numCacheHits / m_numMallocs : 0.0;
+        }
+        // fraction of handed-out memory that was not asked for (due to bucket rounding and best-fit reuse)
+        double Fragmentation() const
+        {
+            return m_bytesInUse ? 1.0 - (double) m_bytesRequested / m_bytesInUse : 0.0;
+        }
+    };
+
+    void* Malloc(size_t size) override; // note: Malloc(0) returns nullptr
+    void Free(void* p) override;
+
+    // typed helpers for the matrix classes; the elements are not initialized
+    template <class T>
+    static T* NewArray(size_t n)
+    {
+        return (T*) Instance().Malloc(n * sizeof(T));
+    }
+    template <class T>
+    static void DeleteArray(T* p)
+    {
+        Instance().Free(p);
+    }
+
+    // return all cached (free) blocks to the system
+    void ReleaseCachedMemory();
+
+    Statistics GetStatistics() const;
+    void PrintStatistics() const;
+
+    static HostCachingMemAllocator& Instance();
+
+    // Caching is on by default. If disabled, blocks are still aligned (and use huge pages), but go back to the system when freed.
+    static void SetEnabled(bool enabled);
+    static bool IsEnabled();
+
+    // 'none' (default), 'transparent', or 'explicit', see above
+    static void SetHugePages(const std::wstring& mode);
+    static HugePages GetHugePages();
+
+    // bucket size a request of 'size' bytes is rounded up to
+    static size_t RoundUp(size_t size);
+
+private:
+    HostCachingMemAllocator();
+
+    struct Block
+    {
+        size_t m_size;      // bucket size
+        size_t m_requested; // requested size while handed out
+        bool m_isMapped;    // from the huge page pool, to be released with munmap()
+    };
+
+    void* SystemMalloc(size_t size, bool& isMapped);
+    void SystemFree(void* p, size_t size, bool isMapped);
+    void ReleaseCachedMemoryNoLock();
+
+    static bool s_enabled;
+    static HugePages s_hugePages;
+
+    mutable std::mutex m_mutex;
+    std::multimap<size_t, void*> m_freeBlocks;      // [bucket size] -> block
+    std::unordered_map<void*, Block> m_blocks;      // all blocks we hold from the system, handed out or not
+    Statistics m_stats;
+};
+
+#pragma warning(pop)
+
+} } }
@@ -0,0 +1,218 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// HostMemoryPlacement.cpp -- NUMA placement of host memory and CPU threads
+//
+
+#include "stdafx.h"
+#include "Basics.h"
+#include "HostMemoryPlacement.h"
+#include "CPUMatrix.h" // for SetNumThreads()
+#include "BestGpu.h"   // for CPUONLY
+#include <vector>
+#ifndef CPUONLY
+#include <cuda_runtime_api.h>
+#endif
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#endif
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+bool HostMemoryPlacement::s_followDevice = false;
+int HostMemoryPlacement::s_node = HostMemoryPlacement::NoNode;
+
+#ifndef _WIN32
+// reads a sysfs list like "0-13,28-41"; returns an empty list if the file does not exist
+static std::vector<int> ReadSysfsList(const std::string& path)
+{
+    std::vector<int> values;
+    FILE* f = fopen(path.c_str(), "r");
+    if (f == nullptr)
+        return values;
+    char buf[4096] = {};
+    if (fgets(buf, sizeof(buf), f) != nullptr)
+    {
+        for (char* p = buf; *p != '\0' && *p != '\n';)
+        {
+            int first = (int) strtol(p, &p, 10);
+            int last = first;
+            if (*p == '-')
+                last = (int) strtol(p + 1, &p, 10);
+            for (int v = first; v <= last; v++)
+                values.push_back(v);
+            if (*p == ',')
+                p++;
+            else
+                break;
+        }
+    }
+    fclose(f);
+    return values;
+}
+
+static std::vector<int> GetCoresOfNode(int node)
+{
+    return ReadSysfsList("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+}
+#endif
+
+void HostMemoryPlacement::SetMode(const std::wstring& mode)
+{
+    s_followDevice = false;
+    if (mode.empty() || mode == L"none")
+        SetNode(NoNode);
+    else if (mode == L"auto")
+        s_followDevice = true;
+    else
+    {
+        wchar_t* end = nullptr;
+        long node = wcstol(mode.c_str(), &end, 10);
+        if (*end != L'\0' || node < 0)
+            InvalidArgument("Invalid value '%ls' for numaNode parameter. Allowed are 'none', 'auto', and a node number.", mode.c_str());
+        SetNode((int) node);
+    }
+}
+
+void HostMemoryPlacement::OnDeviceSelected(DEVICEID_TYPE deviceId)
+{
+    if (!s_followDevice || deviceId < 0)
+        return;
+    s_followDevice = false; // the device cannot change later on
+
+    int node = GetNodeOfDevice(deviceId);
+    if (node == NoNode)
+    {
+        fprintf(stderr, "HostMemoryPlacement: Could not determine the NUMA node of DeviceId = %d. Host memory and threads are not placed.\n", (int) deviceId);
+        return;
+    }
+    SetNode(node);
+}
+
+void HostMemoryPlacement::SetNode(int node)
+{
+    if (node != NoNode && node >= GetNumNodes())
+        InvalidArgument("HostMemoryPlacement: NUMA node %d does not exist, there are %d nodes.", node, GetNumNodes());
+    s_node = node;
+    if (node == NoNode)
+        return;
+
+    BindCurrentThread();
+
+#ifdef _OPENMP
+    // More OpenMP threads than cores on the node would compete for them.
+#ifdef _WIN32
+    GROUP_AFFINITY affinity = {};
+    GetNumaNodeProcessorMaskEx((USHORT) node, &affinity);
+    int numCores = 0;
+    for (KAFFINITY mask = affinity.Mask; mask != 0; mask &= mask - 1)
+        numCores++;
+#else
+    int numCores = (int) GetCoresOfNode(node).size();
+#endif
+    if (numCores > 0 && omp_get_max_threads() > numCores)
+        CPUMatrix<float /*any will do*/>::SetNumThreads(numCores);
+
+    // The OpenMP threads that exist already did not inherit the affinity of this thread.
+#pragma omp parallel
+    BindCurrentThread();
+
+    fprintf(stderr, "Placing host memory and %d CPU threads on NUMA node %d.\n", omp_get_max_threads(), node);
+#else
+    fprintf(stderr, "Placing host memory and CPU threads on NUMA node %d.\n", node);
+#endif
+}
+
+int HostMemoryPlacement::GetNode()
+{
+    return s_node;
+}
+
+int HostMemoryPlacement::GetNumNodes()
+{
+#ifdef _WIN32
+    ULONG highestNode = 0;
+    if (!GetNumaHighestNodeNumber(&highestNode))
+        return 1;
+    return (int) highestNode + 1;
+#else
+    auto nodes = ReadSysfsList("/sys/devices/system/node/online");
+    return nodes.empty() ? 1 : nodes.back() + 1;
+#endif
+}
+
+int HostMemoryPlacement::GetNodeOfDevice(DEVICEID_TYPE deviceId)
+{
+#if defined(CPUONLY) || defined(_WIN32)
+    // (On Windows, this would need the SetupAPI. Use a node number instead of 'auto'.)
+    UNUSED(deviceId);
+    return NoNode;
+#else
+    if (deviceId < 0)
+        return NoNode;
+    char busId[64] = {};
+    if (cudaDeviceGetPCIBusId(busId, sizeof(busId), deviceId) != cudaSuccess)
+    {
+        cudaGetLastError(); // clear the error state
+        return NoNode;
+    }
+    for (char* p = busId; *p != '\0'; p++) // sysfs spells the hex digits in lower case
+        *p = (char) tolower(*p);
+    auto nodes = ReadSysfsList(std::string("/sys/bus/pci/devices/") + busId + "/numa_node");
+    if (nodes.empty() || nodes[0] < 0) // -1 on machines without NUMA
+        return NoNode;
+    return nodes[0];
+#endif
+}
+
+void HostMemoryPlacement::BindCurrentThread()
+{
+    if (s_node == NoNode)
+        return;
+#ifdef _WIN32
+    GROUP_AFFINITY affinity = {};
+    if (GetNumaNodeProcessorMaskEx((USHORT) s_node, &affinity))
+        SetThreadGroupAffinity(GetCurrentThread(), &affinity, nullptr);
+#else
+    cpu_set_t cores;
+    CPU_ZERO(&cores);
+    for (int core : GetCoresOfNode(s_node))
+        if (core < CPU_SETSIZE)
+            CPU_SET(core, &cores);
+    if (CPU_COUNT(&cores) > 0)
+        pthread_setaffinity_np(pthread_self(), sizeof(cores), &cores); // (failure just leaves the thread where it was)
+#endif
+}
+
+void HostMemoryPlacement::PlaceOnNode(void* p, size_t numBytes)
+{
+    if (s_node == NoNode || numBytes < MinPlacedBytes)
+        return;
+#ifdef _WIN32
+    UNUSED(p);
+#else
+    const size_t pageSize = (size_t) sysconf(_SC_PAGESIZE);
+    size_t begin = ((size_t) p + pageSize - 1) / pageSize * pageSize;
+    size_t end = ((size_t) p + numBytes) / pageSize * pageSize;
+    if (begin >= end)
+        return;
+
+    // MPOL_PREFERRED from <numaif.h>: take pages from the node, or from other nodes if the node is out of memory
+    const int mpolPreferred = 1;
+    unsigned long nodeMask[1024 / (8 * sizeof(unsigned long))] = {};
+    if (s_node >= 8 * sizeof(nodeMask))
+        return;
+    nodeMask[s_node / (8 * sizeof(unsigned long))] = 1ul << (s_node % (8 * sizeof(unsigned long)));
+    syscall(SYS_mbind, (void*) begin, end - begin, mpolPreferred, nodeMask, 8 * sizeof(nodeMask) + 1, 0); // (failure leaves the pages to first touch)
+#endif
+}
+} } }
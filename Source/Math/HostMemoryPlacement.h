@@ -0,0 +1,77 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// HostMemoryPlacement.h -- NUMA placement of host memory and CPU threads
+//
+
+#pragma once
+
+#include "CommonMatrix.h" // for DEVICEID_TYPE
+#include <string>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+#ifdef _WIN32
+#ifdef MATH_EXPORTS
+#define MATH_API __declspec(dllexport)
+#else
+#define MATH_API __declspec(dllimport)
+#endif
+#else // no DLLs on Linux
+#define MATH_API
+#endif
+
+// -----------------------------------------------------------------------
+// HostMemoryPlacement -- keeps host memory and CPU threads on one NUMA node
+//
+// On multi-socket machines, a GPU hangs off the PCIe root of one socket.
+// Host buffers on the other socket's memory, and threads on its cores, pay
+// for the inter-socket link on every host-to-device copy and on every CPU
+// math operation. Once a node is selected, the calling thread and the
+// OpenMP threads are restricted to the node's cores, and threads created
+// afterwards inherit that. Large host arrays (CPUMatrix, reader buffers)
+// are given a preference for the node's memory, see PlaceOnNode().
+// Other memory ends up on the node too, since the OS places a page where
+// it is first touched.
+//
+// Placement is off by default. SetMode() takes the 'numaNode' config
+// parameter: 'none', 'auto' (the node of the GPU that is selected later,
+// see OnDeviceSelected()), or a node number.
+//
+// Memory placement is only implemented on Linux (through the mbind system
+// call, so that there is no dependency on libnuma). On Windows, only the
+// threads are bound, and pages are placed by first touch.
+// -----------------------------------------------------------------------
+
+class MATH_API HostMemoryPlacement
+{
+public:
+    static const int NoNode = -1;
+
+    static void SetMode(const std::wstring& mode);
+    // called when the compute device has been determined
+    static void OnDeviceSelected(DEVICEID_TYPE deviceId);
+
+    // selects the node and binds the calling thread and the OpenMP threads to it; NoNode turns placement off
+    static void SetNode(int node);
+    static int GetNode();
+
+    static int GetNumNodes();
+    // the node that the GPU is attached to, or NoNode if not known
+    static int GetNodeOfDevice(DEVICEID_TYPE deviceId);
+
+    // Restricts the calling thread to the cores of the selected node. To be called first thing by
+    // long-lived worker threads that may have been created by a thread that was not bound.
+    static void BindCurrentThread();
+
+    // Lets the pages of [p, p + numBytes) that have not been touched yet prefer the memory of the selected node.
+    // Only whole pages are affected, and only for arrays of at least MinPlacedBytes; smaller ones share pages with other allocations.
+    static void PlaceOnNode(void* p, size_t numBytes);
+    static const size_t MinPlacedBytes = 1024 * 1024;
+
+private:
+    static bool s_followDevice; // 'auto': take the node of the selected GPU
+    static int s_node;
+};
+} } }
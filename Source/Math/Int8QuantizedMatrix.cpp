@@ -0,0 +1,104 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+#include "Int8QuantizedMatrix.h"
+#include "CPUVectorKernels.h"
+#include <math.h>
+#include <algorithm>
+#include <memory>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// quantizes 'n' values to [-127, 127] with a common scale, which is returned
+template <class ElemType>
+static ElemType QuantizeToInt8(const ElemType* in, int8_t* out, size_t n)
+{
+    ElemType maxAbs = 0;
+    for (size_t i = 0; i < n; i++)
+        maxAbs = std::max(maxAbs, (ElemType) fabs(in[i]));
+    if (maxAbs == 0)
+    {
+        std::fill(out, out + n, (int8_t) 0);
+        return 0;
+    }
+    const ElemType scale = maxAbs / 127;
+    const ElemType invScale = 1 / scale;
+    for (size_t i = 0; i < n; i++)
+        out[i] = (int8_t) std::max((ElemType) -127, std::min((ElemType) 127, (ElemType) floor(in[i] * invScale + (ElemType) 0.5)));
+    return scale;
+}
+
+template <class ElemType>
+Int8QuantizedMatrix<ElemType>::Int8QuantizedMatrix(const Matrix<ElemType>& weights)
+    : m_numRows(weights.GetNumRows()), m_numCols(weights.GetNumCols())
+{
+    if (weights.GetMatrixType() != MatrixType::DENSE)
+        InvalidArgument("Int8QuantizedMatrix: Only dense matrices can be quantized.");
+
+    // W is column-major; gather each row so that it is contiguous
+    std::unique_ptr<ElemType[]> columnMajor(weights.CopyToArray());
+    std::vector<ElemType> rowMajor(m_numRows * m_numCols);
+    for (size_t k = 0; k < m_numCols; k++)
+        for (size_t i = 0; i < m_numRows; i++)
+            rowMajor[i * m_numCols + k] = columnMajor[k * m_numRows + i];
+
+    m_values.resize(m_numRows * m_numCols);
+    m_scales.resize(m_numRows);
+#pragma omp parallel for
+    for (long i = 0; i < (long) m_numRows; i++)
+        m_scales[i] = QuantizeToInt8(rowMajor.data() + i * m_numCols, m_values.data() + i * m_numCols, m_numCols);
+}
+
+template <class ElemType>
+void Int8QuantizedMatrix<ElemType>::Multiply(const Matrix<ElemType>& in, Matrix<ElemType>& out) const
+{
+    if (out.GetDeviceId() != CPUDEVICE || out.GetMatrixType() != MatrixType::DENSE)
+        LogicError("Int8QuantizedMatrix::Multiply: The output must be a dense CPU matrix.");
+    if (in.GetNumRows() != m_numCols || out.GetNumRows() != m_numRows || out.GetNumCols() != in.GetNumCols())
+        InvalidArgument("Int8QuantizedMatrix::Multiply: Dimensions [%d x %d] * [%d x %d] -> [%d x %d] do not match.",
+                        (int) m_numRows, (int) m_numCols, (int) in.GetNumRows(), (int) in.GetNumCols(), (int) out.GetNumRows(), (int) out.GetNumCols());
+
+    const size_t numSamples = in.GetNumCols();
+    // sparse input (e.g. one-hot features) is densified first, since it is quantized anyway
+    Matrix<ElemType> inCopy(CPUDEVICE);
+    const Matrix<ElemType>* pIn = &in;
+    if (in.GetDeviceId() != CPUDEVICE || in.GetMatrixType() != MatrixType::DENSE)
+    {
+        inCopy = Matrix<ElemType>(in, CPUDEVICE);
+        inCopy.SwitchToMatrixType(MatrixType::DENSE, MatrixFormat::matrixFormatDense, true);
+        pIn = &inCopy;
+    }
+    const ElemType* inData = pIn->BufferPointer();
+    ElemType* outData = out.BufferPointer();
+
+    // quantize the input per column
+    std::vector<int8_t> inValues(m_numCols * numSamples);
+    std::vector<ElemType> inScales(numSamples);
+#pragma omp parallel for
+    for (long j = 0; j < (long) numSamples; j++)
+        inScales[j] = QuantizeToInt8(inData + j * m_numCols, inValues.data() + j * m_numCols, m_numCols);
+
+    // blocks of weight rows are kept in cache while sweeping over all samples
+    auto dot = CPUVectorKernels::Get().DotInt8;
+    const size_t rowBlockSize = std::max((size_t) 1, (size_t) 65536 / std::max(m_numCols, (size_t) 1));
+    const long numRowBlocks = (long) ((m_numRows + rowBlockSize - 1) / rowBlockSize);
+#pragma omp parallel for
+    for (long b = 0; b < numRowBlocks; b++)
+    {
+        const size_t rowBegin = b * rowBlockSize;
+        const size_t rowEnd = std::min(m_numRows, rowBegin + rowBlockSize);
+        for (size_t j = 0; j < numSamples; j++)
+        {
+            const int8_t* inColumn = inValues.data() + j * m_numCols;
+            for (size_t i = rowBegin; i < rowEnd; i++)
+                outData[j * m_numRows + i] = m_scales[i] * inScales[j] * (ElemType) dot(m_values.data() + i * m_numCols, inColumn, m_numCols);
+        }
+    }
+}
+
+template class Int8QuantizedMatrix<float>;
+template class Int8QuantizedMatrix<double>;
+} } }
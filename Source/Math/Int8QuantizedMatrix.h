@@ -0,0 +1,53 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#ifdef _WIN32
+#ifdef MATH_EXPORTS
+#define MATH_API __declspec(dllexport)
+#else
+#define MATH_API __declspec(dllimport)
+#endif
+#else // no DLLs on Linux
+#define MATH_API
+#endif
+
+#include "Matrix.h"
+#include <stdint.h>
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// -----------------------------------------------------------------------
+// Int8QuantizedMatrix -- a weight matrix quantized to int8, for inference on the CPU
+// Each row i of the [M x K] matrix W (i.e. each output channel) is stored as int8 values q(i, k) with
+// a scale s(i) = max_k |W(i, k)| / 127, such that W(i, k) ~= s(i) * q(i, k).
+// Multiply() quantizes each column of its input the same way, computes the products with int32
+// accumulation, and dequantizes the result. Unlike QuantizedMatrix (for 1-bit SGD), the
+// quantization is symmetric, so that the products need no correction terms.
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+class MATH_API Int8QuantizedMatrix
+{
+public:
+    // 'weights' must be a dense matrix; it may live on any device
+    explicit Int8QuantizedMatrix(const Matrix<ElemType>& weights);
+
+    size_t GetNumRows() const { return m_numRows; }
+    size_t GetNumCols() const { return m_numCols; }
+    size_t GetSizeInBytes() const { return m_values.size() * sizeof(int8_t) + m_scales.size() * sizeof(ElemType); }
+
+    // out = W * in, with in: [K x N] and out: [M x N]; 'out' must be a dense CPU matrix of the right size
+    void Multiply(const Matrix<ElemType>& in, Matrix<ElemType>& out) const;
+
+private:
+    size_t m_numRows;
+    size_t m_numCols;
+    std::vector<int8_t> m_values;   // row i of W at [i * m_numCols, (i + 1) * m_numCols)
+    std::vector<ElemType> m_scales; // one per row
+};
+} } }
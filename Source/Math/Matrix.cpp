@@ -845,6 +845,41 @@ void Matrix<ElemType>::CopyColumnsStrided(const Matrix<ElemType>& fromMatrix, si
                             NOT_IMPLEMENTED);
 }
 
+template <class ElemType>
+Matrix<ElemType>& Matrix<ElemType>::DoGatherColumnsOf(ElemType beta, const Matrix<ElemType>& idx, const Matrix<ElemType>& a, ElemType alpha)
+{
+    DecideAndMoveToRightDevice(a, idx, *this);
+    if (a.GetMatrixType() != MatrixType::DENSE || idx.GetMatrixType() != MatrixType::DENSE)
+        NOT_IMPLEMENTED;
+    SwitchToMatrixType(MatrixType::DENSE, matrixFormatDense, beta != 0);
+
+    DISPATCH_MATRIX_ON_FLAG(&a,
+                            this,
+                            m_CPUMatrix->DoGatherColumnsOf(beta, *idx.m_CPUMatrix, *a.m_CPUMatrix, alpha),
+                            m_GPUMatrix->DoGatherColumnsOf(beta, *idx.m_GPUMatrix, *a.m_GPUMatrix, alpha),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+
+    return *this;
+}
+
+template <class ElemType>
+Matrix<ElemType>& Matrix<ElemType>::DoScatterColumnsOf(ElemType beta, const Matrix<ElemType>& idx, const Matrix<ElemType>& a, ElemType alpha)
+{
+    DecideAndMoveToRightDevice(a, idx, *this);
+    if (GetMatrixType() != MatrixType::DENSE || a.GetMatrixType() != MatrixType::DENSE || idx.GetMatrixType() != MatrixType::DENSE)
+        NOT_IMPLEMENTED;
+
+    DISPATCH_MATRIX_ON_FLAG(&a,
+                            this,
+                            m_CPUMatrix->DoScatterColumnsOf(beta, *idx.m_CPUMatrix, *a.m_CPUMatrix, alpha),
+                            m_GPUMatrix->DoScatterColumnsOf(beta, *idx.m_GPUMatrix, *a.m_GPUMatrix, alpha),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+
+    return *this;
+}
+
 template <class ElemType>
 Matrix<ElemType> Matrix<ElemType>::Diagonal() const
 {
@@ -1027,6 +1062,20 @@ ElemType Matrix<ElemType>::Get00Element() const
                             NOT_IMPLEMENTED);
 }
 
+template <class ElemType>
+void Matrix<ElemType>::CopyToHostAsync(ElemType* dst, size_t numElements) const
+{
+    if (numElements > GetNumElements())
+        InvalidArgument("CopyToHostAsync: %d elements requested from a matrix of %d.", (int) numElements, (int) GetNumElements());
+
+    DISPATCH_MATRIX_ON_FLAG(this,
+                            nullptr,
+                            memcpy(dst, m_CPUMatrix->BufferPointer(), sizeof(ElemType) * numElements),
+                            m_GPUMatrix->CopyToHostAsync(dst, numElements),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+}
+
 template <class ElemType>
 const ElemType Matrix<ElemType>::operator()(const size_t row, const size_t col) const
 {
@@ -1211,6 +1260,28 @@ void Matrix<ElemType>::SetValue(const Matrix<ElemType>& deepCopyFrom, const Matr
                             m_GPUSparseMatrix->SetValue(*deepCopyFrom.m_GPUSparseMatrix));
 }
 
+// deep copy of a matrix on another device, onto the device of this matrix
+// Unlike SetValue(), this moves neither matrix, which is needed where a network is placed on multiple devices.
+// Between dense GPU matrices the copy is asynchronous, otherwise it goes through a temporary copy.
+template <class ElemType>
+void Matrix<ElemType>::SetValueFromOtherDevice(const Matrix<ElemType>& deepCopyFrom)
+{
+    if (deepCopyFrom.GetDeviceId() == GetDeviceId())
+        return SetValue(deepCopyFrom);
+
+    if (GetDeviceId() != CPUDEVICE && deepCopyFrom.GetDeviceId() != CPUDEVICE && deepCopyFrom.GetMatrixType() == MatrixType::DENSE)
+    {
+        SwitchToMatrixType(MatrixType::DENSE, matrixFormatDense, false);
+        m_GPUMatrix->SetValueFromOtherDevice(*deepCopyFrom.m_GPUMatrix);
+        SetDataLocation(CurrentDataLocation::GPU, MatrixType::DENSE);
+        return;
+    }
+
+    Matrix<ElemType> copy(deepCopyFrom);
+    copy.TransferToDeviceIfNotThere(GetDeviceId(), true);
+    SetValue(copy);
+}
+
 template <class ElemType>
 void Matrix<ElemType>::SetValue(const size_t numRows, const size_t numCols, int deviceId, ElemType* pArray, const size_t matrixFlags)
 {
@@ -1249,6 +1320,51 @@ void Matrix<ElemType>::SetMatrixFromCSCFormat(const CPUSPARSE_INDEX_TYPE* h_CSCC
                             m_GPUSparseMatrix->SetMatrixFromCSCFormat(h_CSCCol, h_Row, h_Val, nz, numRows, numCols));
 }
 
+template <class ElemType>
+void Matrix<ElemType>::SetMatrixFromCSCColumnCounts(const CPUSPARSE_INDEX_TYPE* h_colCounts, const CPUSPARSE_INDEX_TYPE* h_Row, const ElemType* h_Val,
+                                                    const size_t nz, const size_t numRows, const size_t numCols)
+{
+    if (GetMatrixType() == MatrixType::SPARSE && GetCurrentMatrixLocation() == CPU)
+    {
+        vector<CPUSPARSE_INDEX_TYPE> colOffsets(numCols + 1, 0);
+        for (size_t j = 0; j < numCols; j++)
+            colOffsets[j + 1] = colOffsets[j] + h_colCounts[j];
+        if ((size_t) colOffsets[numCols] != nz)
+            InvalidArgument("SetMatrixFromCSCColumnCounts: The column counts add up to %d values instead of %d.", (int) colOffsets[numCols], (int) nz);
+        m_CPUSparseMatrix->SetMatrixFromCSCFormat(colOffsets.data(), h_Row, h_Val, nz, numRows, numCols);
+        return;
+    }
+
+    DISPATCH_MATRIX_ON_FLAG(this,
+                            this,
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED,
+                            m_GPUSparseMatrix->SetMatrixFromCSCColumnCounts(h_colCounts, h_Row, h_Val, nz, numRows, numCols));
+}
+
+template <class ElemType>
+void Matrix<ElemType>::SetMatrixFromBlockColFormat(const size_t* h_ColIds, const ElemType* h_Val, const size_t numBlocks, const size_t numRows, const size_t numCols)
+{
+    DISPATCH_MATRIX_ON_FLAG(this,
+                            this,
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED,
+                            m_CPUSparseMatrix->SetMatrixFromBlockColFormat(h_ColIds, h_Val, numBlocks, numRows, numCols),
+                            m_GPUSparseMatrix->SetMatrixFromBlockColFormat(h_ColIds, h_Val, numBlocks, numRows, numCols));
+}
+
+template <class ElemType>
+void Matrix<ElemType>::GetMatrixFromBlockColFormat(std::vector<size_t>& colIds, std::vector<ElemType>& values) const
+{
+    DISPATCH_MATRIX_ON_FLAG(this,
+                            nullptr,
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED,
+                            m_CPUSparseMatrix->GetMatrixFromBlockColFormat(colIds, values),
+                            m_GPUSparseMatrix->GetMatrixFromBlockColFormat(colIds, values));
+}
+
 template <class ElemType>
 void Matrix<ElemType>::SetDiagonalValue(const ElemType v)
 {
@@ -1373,6 +1489,34 @@ void Matrix<ElemType>::SetUniformRandomMask(const ElemType maskRate, const ElemT
                             NOT_IMPLEMENTED);
 }
 
+// [this] = beta * [this] + a .* mask, where element i of the mask is 0 with probability maskRate and scaleValue otherwise.
+// The mask is element counterOffset + i of the Philox sequence for 'seed'. Since it is a function of (seed, index),
+// it is never stored: forward and backward of a dropout regenerate it, e.g. with counterOffset = first column * rows for a column slice.
+// If beta is 0, [this] is not read.
+template <class ElemType>
+Matrix<ElemType>& Matrix<ElemType>::ScaleAndAddDropoutOf(const ElemType beta, const Matrix<ElemType>& a, const ElemType maskRate, const ElemType scaleValue, unsigned long seed, size_t counterOffset)
+{
+    if (a.IsEmpty())
+        LogicError("ScaleAndAddDropoutOf: Matrix is empty.");
+
+    if (beta != 0 && !(a.GetNumRows() == GetNumRows() && a.GetNumCols() == GetNumCols()))
+        InvalidArgument("ScaleAndAddDropoutOf: The input matrix dimensions do not match [this].");
+
+    DecideAndMoveToRightDevice(a, *this);
+
+    if (a.GetMatrixType() != GetMatrixType())
+        NOT_IMPLEMENTED;
+
+    DISPATCH_MATRIX_ON_FLAG(this,
+                            this,
+                            m_CPUMatrix->ScaleAndAddDropoutOf(beta, *a.m_CPUMatrix, maskRate, scaleValue, seed, counterOffset),
+                            m_GPUMatrix->ScaleAndAddDropoutOf(beta, *a.m_GPUMatrix, maskRate, scaleValue, seed, counterOffset),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+
+    return *this;
+}
+
 template <class ElemType>
 void Matrix<ElemType>::NormalGrad(Matrix<ElemType>& gradients,
                                   Matrix<ElemType>& functionValues,
@@ -1451,18 +1595,27 @@ ElemType Matrix<ElemType>::Adagrad(Matrix<ElemType>& gradients, const bool needA
                             SetDataLocation(GPU));
 }
 
+// the adaWeight and adaMul of one FSAdagrad() call
+// This advances the running frame count, so it is called once per parameter and minibatch.
 template <class ElemType>
-void Matrix<ElemType>::FSAdagrad(size_t mbSize, Matrix<ElemType>& gradients, Matrix<ElemType>& functionValues, const ElemType learnRatePerSample, const ElemType momentum)
+static ElemType FSAdagradMultiplier(size_t mbSize, ElemType& adagradkeepweight)
 {
     // TODO: The values of 'adagradT' and 'targetadagradavdenom' are currently hardcoded constants taken from DBN (empirically determined).
     // These should be made configurable if needed
     const size_t adagradT = 2 * 3600 * 100;
     const ElemType targetadagradavdenom = 0.0025; // 1/400 magic constant
-    const ElemType adagradkeepweight = static_cast<ElemType>(exp(-1.0 * mbSize / adagradT));
+    adagradkeepweight = static_cast<ElemType>(exp(-1.0 * mbSize / adagradT));
 
     static ElemType aggadagradsqrframes = 0;
     aggadagradsqrframes = adagradkeepweight * aggadagradsqrframes + (1.0f - adagradkeepweight) * mbSize;
-    const ElemType targetadagradavdenom_x_sqrtadagradsqrframes = static_cast<ElemType>(targetadagradavdenom * sqrt(aggadagradsqrframes));
+    return static_cast<ElemType>(targetadagradavdenom * sqrt(aggadagradsqrframes));
+}
+
+template <class ElemType>
+void Matrix<ElemType>::FSAdagrad(size_t mbSize, Matrix<ElemType>& gradients, Matrix<ElemType>& functionValues, const ElemType learnRatePerSample, const ElemType momentum)
+{
+    ElemType adagradkeepweight;
+    const ElemType targetadagradavdenom_x_sqrtadagradsqrframes = FSAdagradMultiplier(mbSize, adagradkeepweight);
 
     DISPATCH_MATRIX_ON_FLAG(&gradients,
                             &gradients,
@@ -1474,6 +1627,195 @@ void Matrix<ElemType>::FSAdagrad(size_t mbSize, Matrix<ElemType>& gradients, Mat
                             NOT_IMPLEMENTED);
 }
 
+template <class ElemType>
+void Matrix<ElemType>::Adam(size_t step, Matrix<ElemType>& gradients, Matrix<ElemType>& functionValues, const ElemType learnRate, const ElemType beta1, const ElemType beta2, const ElemType epsilon)
+{
+    DecideAndMoveToRightDevice(*this, gradients, functionValues);
+
+    const double biasCorrection2 = sqrt(1 - pow((double) beta2, (double) step));
+    const ElemType biasCorrection = (ElemType) (biasCorrection2 / (1 - pow((double) beta1, (double) step)));
+    const ElemType correctedEpsilon = (ElemType) (epsilon * biasCorrection2);
+
+    DISPATCH_MATRIX_ON_FLAG(&gradients,
+                            &gradients,
+                            m_CPUMatrix->Adam(*gradients.m_CPUMatrix, functionValues.m_CPUMatrix, learnRate, beta1, beta2, correctedEpsilon, biasCorrection);
+                            SetDataLocation(CPU),
+                            m_GPUMatrix->Adam(*gradients.m_GPUMatrix, functionValues.m_GPUMatrix, learnRate, beta1, beta2, correctedEpsilon, biasCorrection);
+                            SetDataLocation(GPU),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+    functionValues.SetDataLocation(GetCurrentMatrixLocation(), DENSE);
+}
+
+template <class ElemType>
+void Matrix<ElemType>::AdamDirection(size_t step, Matrix<ElemType>& gradients, const ElemType beta1, const ElemType beta2, const ElemType epsilon)
+{
+    DecideAndMoveToRightDevice(*this, gradients);
+
+    const double biasCorrection2 = sqrt(1 - pow((double) beta2, (double) step));
+    const ElemType biasCorrection = (ElemType) (biasCorrection2 / (1 - pow((double) beta1, (double) step)));
+    const ElemType correctedEpsilon = (ElemType) (epsilon * biasCorrection2);
+
+    DISPATCH_MATRIX_ON_FLAG(&gradients,
+                            &gradients,
+                            m_CPUMatrix->Adam(*gradients.m_CPUMatrix, nullptr, 0, beta1, beta2, correctedEpsilon, biasCorrection);
+                            SetDataLocation(CPU),
+                            m_GPUMatrix->Adam(*gradients.m_GPUMatrix, nullptr, 0, beta1, beta2, correctedEpsilon, biasCorrection);
+                            SetDataLocation(GPU),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+}
+
+// the state of LazyNormalGrad() and LazyAdagrad(): a smoothed gradient of the shape of the parameter is kept, and the
+// columns count as updated in the previous step
+template <class ElemType>
+static void InitLazySparseState(Matrix<ElemType>& state, const Matrix<ElemType>& gradients, size_t step)
+{
+    const size_t numRows = gradients.GetNumRows();
+    const size_t numCols = gradients.GetNumCols();
+    if (state.GetNumRows() == numRows + 1 && state.GetNumCols() == numCols)
+        return;
+
+    Matrix<ElemType> newState(numRows + 1, numCols, gradients.GetDeviceId());
+    newState.SetValue(0);
+    if (state.GetNumRows() == numRows && state.GetNumCols() == numCols)
+        newState.AssignToRowSliceValuesOf(state, 0, numRows);
+    Matrix<ElemType> lastSteps(1, numCols, gradients.GetDeviceId());
+    lastSteps.SetValue((ElemType) (step - 1));
+    newState.AssignToRowSliceValuesOf(lastSteps, numRows, 1);
+    state.SetValue(newState);
+}
+
+template <class ElemType>
+void Matrix<ElemType>::LazyNormalGrad(size_t step, Matrix<ElemType>& gradients, Matrix<ElemType>& functionValues, const ElemType learnRatePerSample, const ElemType momentum, const ElemType l2Weight)
+{
+    DecideAndMoveToRightDevice(*this, gradients, functionValues);
+    InitLazySparseState(*this, gradients, step);
+
+    DISPATCH_MATRIX_ON_FLAG(&gradients,
+                            nullptr,
+                            LogicError("LazyNormalGrad: The gradients must be sparse."),
+                            LogicError("LazyNormalGrad: The gradients must be sparse."),
+                            gradients.m_CPUSparseMatrix->LazyNormalGrad(step, *m_CPUMatrix, *functionValues.m_CPUMatrix, learnRatePerSample, momentum, l2Weight);
+                            SetDataLocation(CPU);
+                            functionValues.SetDataLocation(CPU),
+                            gradients.m_GPUSparseMatrix->LazyNormalGrad(step, *m_GPUMatrix, *functionValues.m_GPUMatrix, learnRatePerSample, momentum, l2Weight);
+                            SetDataLocation(GPU);
+                            functionValues.SetDataLocation(GPU));
+}
+
+template <class ElemType>
+void Matrix<ElemType>::LazyAdagrad(size_t step, Matrix<ElemType>& gradients, Matrix<ElemType>& functionValues, const ElemType learnRatePerSample, const ElemType l2Weight, const bool needAveMultiplier)
+{
+    DecideAndMoveToRightDevice(*this, gradients, functionValues);
+    InitLazySparseState(*this, gradients, step);
+
+    DISPATCH_MATRIX_ON_FLAG(&gradients,
+                            nullptr,
+                            LogicError("LazyAdagrad: The gradients must be sparse."),
+                            LogicError("LazyAdagrad: The gradients must be sparse."),
+                            gradients.m_CPUSparseMatrix->LazyAdagrad(step, *m_CPUMatrix, *functionValues.m_CPUMatrix, learnRatePerSample, l2Weight, needAveMultiplier);
+                            SetDataLocation(CPU);
+                            functionValues.SetDataLocation(CPU),
+                            gradients.m_GPUSparseMatrix->LazyAdagrad(step, *m_GPUMatrix, *functionValues.m_GPUMatrix, learnRatePerSample, l2Weight, needAveMultiplier);
+                            SetDataLocation(GPU);
+                            functionValues.SetDataLocation(GPU));
+}
+
+// The results equal those of SGD::UpdateWeightsS() for each parameter in turn, except that the gradients are left unchanged.
+// With clipping by the global norm, the squared norm is summed on the device into 'gradientSquaredNorm', and each element
+// of the update reads it from there, so the host does not wait for it.
+template <class ElemType>
+/*static*/ void Matrix<ElemType>::FusedSGDUpdate(const FusedSGDBatch<ElemType>& options, size_t mbSize,
+                                                 const std::vector<Matrix<ElemType>*>& values, const std::vector<const Matrix<ElemType>*>& gradients, const std::vector<Matrix<ElemType>*>& smoothedGradients,
+                                                 const std::vector<double>& learnRatesPerSample, double L1RegWeight, Matrix<ElemType>* gradientSquaredNorm)
+{
+    if (gradients.size() != values.size() || smoothedGradients.size() != values.size() || learnRatesPerSample.size() != values.size())
+        InvalidArgument("FusedSGDUpdate: The numbers of values, gradients, smoothed gradients, and learning rates differ.");
+    if (values.empty())
+        return;
+
+    const DEVICEID_TYPE deviceId = values[0]->GetDeviceId();
+    const CurrentDataLocation location = deviceId < 0 ? CurrentDataLocation::CPU : CurrentDataLocation::GPU;
+
+    std::vector<FusedSGDBatch<ElemType>> batches;
+    FusedSGDBatch<ElemType> batch = options;
+    batch.m_numTensors = 0;
+    batch.m_gradientSquaredNorm = nullptr;
+    for (size_t i = 0; i < values.size(); i++)
+    {
+        Matrix<ElemType>& value = *values[i];
+        const Matrix<ElemType>& gradient = *gradients[i];
+        Matrix<ElemType>& smoothedGradient = *smoothedGradients[i];
+        if (value.GetMatrixType() != DENSE || gradient.GetMatrixType() != DENSE || smoothedGradient.GetMatrixType() != DENSE)
+            InvalidArgument("FusedSGDUpdate: Only dense matrices are supported.");
+        if (value.GetDeviceId() != deviceId || gradient.GetDeviceId() != deviceId || smoothedGradient.GetDeviceId() != deviceId)
+            InvalidArgument("FusedSGDUpdate: All matrices must be on the same device.");
+        if (value.GetNumRows() != gradient.GetNumRows() || value.GetNumCols() != gradient.GetNumCols())
+            InvalidArgument("FusedSGDUpdate: A parameter and its gradient differ in dimensions.");
+
+        typename FusedSGDBatch<ElemType>::Tensor& tensor = batch.m_tensors[batch.m_numTensors];
+        tensor.m_numElements = value.GetNumElements();
+        tensor.m_learnRatePerSample = (ElemType) learnRatesPerSample[i];
+        tensor.m_L1Threshold = (ElemType) (learnRatesPerSample[i] * L1RegWeight * mbSize);
+        if (options.m_isFSAdagrad)
+        {
+            // same layout and initialization as FSAdagrad()
+            if (smoothedGradient.IsEmpty() || smoothedGradient.GetNumCols() < 2 * gradient.GetNumCols())
+            {
+                smoothedGradient.Resize(gradient.GetNumRows(), 2 * gradient.GetNumCols());
+                smoothedGradient.SetValue(0);
+            }
+            tensor.m_adaMul = FSAdagradMultiplier(mbSize, batch.m_adaWeight);
+        }
+        else
+        {
+            if (smoothedGradient.GetNumElements() != tensor.m_numElements)
+                InvalidArgument("FusedSGDUpdate: A parameter and its smoothed gradient differ in dimensions.");
+            tensor.m_adaMul = 0;
+        }
+        tensor.m_value = value.BufferPointer();
+        tensor.m_gradient = gradient.BufferPointer();
+        tensor.m_smoothedGradient = smoothedGradient.BufferPointer();
+        value.SetDataLocation(location, DENSE);
+        smoothedGradient.SetDataLocation(location, DENSE);
+
+        if (tensor.m_numElements > 0)
+            batch.m_numTensors++;
+        if (batch.m_numTensors == FusedSGDBatch<ElemType>::MaxTensors || (i + 1 == values.size() && batch.m_numTensors > 0))
+        {
+            batches.push_back(batch);
+            batch.m_numTensors = 0;
+        }
+    }
+
+    if (options.m_maxGradientNorm != std::numeric_limits<ElemType>::infinity())
+    {
+        if (gradientSquaredNorm == nullptr)
+            InvalidArgument("FusedSGDUpdate: Clipping by the global norm needs a matrix for the norm.");
+        gradientSquaredNorm->TransferToDeviceIfNotThere(deviceId, true);
+        gradientSquaredNorm->Resize(1, 1);
+        gradientSquaredNorm->SetValue(0);
+        ElemType* squaredNorm = gradientSquaredNorm->BufferPointer();
+        for (auto& b : batches)
+        {
+            if (deviceId < 0)
+                CPUMatrix<ElemType>::FusedSGDSquaredNorm(b, squaredNorm);
+            else
+                GPUMatrix<ElemType>::FusedSGDSquaredNorm(deviceId, b, squaredNorm);
+            b.m_gradientSquaredNorm = squaredNorm;
+        }
+    }
+
+    for (const auto& b : batches)
+    {
+        if (deviceId < 0)
+            CPUMatrix<ElemType>::FusedSGDUpdate(b);
+        else
+            GPUMatrix<ElemType>::FusedSGDUpdate(deviceId, b);
+    }
+}
+
 template <class ElemType>
 ElemType Matrix<ElemType>::RmsProp(Matrix<ElemType>& gradients,
                                    ElemType RMS_GAMMA,
@@ -2441,6 +2783,29 @@ Matrix<ElemType>& Matrix<ElemType>::AssignNumOfDiff(const Matrix<ElemType>& a, c
 
     return *this;
 }
+
+template <class ElemType>
+Matrix<ElemType>& Matrix<ElemType>::AssignNumOfTopKErrorsOf(const Matrix<ElemType>& labels, const Matrix<ElemType>& predictions, const size_t topK)
+{
+    if (labels.GetNumRows() != predictions.GetNumRows() || labels.GetNumCols() != predictions.GetNumCols())
+        InvalidArgument("AssignNumOfTopKErrorsOf: the dimensions of the labels [%d x %d] and the predictions [%d x %d] do not match.",
+                        (int) labels.GetNumRows(), (int) labels.GetNumCols(), (int) predictions.GetNumRows(), (int) predictions.GetNumCols());
+    if (topK == 0 || topK > predictions.GetNumRows())
+        InvalidArgument("AssignNumOfTopKErrorsOf: topK (%d) must be between 1 and the number of rows (%d).", (int) topK, (int) predictions.GetNumRows());
+    if (labels.GetMatrixType() != MatrixType::DENSE || predictions.GetMatrixType() != MatrixType::DENSE)
+        NOT_IMPLEMENTED;
+
+    DecideAndMoveToRightDevice(predictions, labels, *this);
+    SwitchToMatrixType(MatrixType::DENSE, matrixFormatDense, false);
+
+    DISPATCH_MATRIX_ON_FLAG(&predictions,
+                            this,
+                            m_CPUMatrix->AssignNumOfTopKErrorsOf(*labels.m_CPUMatrix, *predictions.m_CPUMatrix, topK),
+                            m_GPUMatrix->AssignNumOfTopKErrorsOf(*labels.m_GPUMatrix, *predictions.m_GPUMatrix, topK),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+    return *this;
+}
 //[this]=tanh([this]) element wise
 template <class ElemType>
 Matrix<ElemType>& Matrix<ElemType>::InplaceTanh()
@@ -2503,6 +2868,55 @@ Matrix<ElemType>& Matrix<ElemType>::AssignLogSoftmaxOf(const Matrix<ElemType>& a
     return *this;
 }
 
+template <class ElemType>
+Matrix<ElemType>& Matrix<ElemType>::InplaceSoftmax(const bool isColWise)
+{
+    DISPATCH_MATRIX_ON_FLAG(this,
+                            this,
+                            m_CPUMatrix->InplaceSoftmax(isColWise),
+                            m_GPUMatrix->InplaceSoftmax(isColWise),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+
+    return *this;
+}
+
+template <class ElemType>
+Matrix<ElemType>& Matrix<ElemType>::AssignSoftmaxOf(const Matrix<ElemType>& a, const bool isColWise)
+{
+    if (a.IsEmpty())
+        LogicError("AssignSoftmaxOf: Matrix a is empty.");
+    DecideAndMoveToRightDevice(a, *this);
+    SwitchToMatrixType(a.GetMatrixType(), a.GetFormat(), false);
+
+    DISPATCH_MATRIX_ON_FLAG(&a,
+                            this,
+                            m_CPUMatrix->AssignSoftmaxOf(*a.m_CPUMatrix, isColWise),
+                            m_GPUMatrix->AssignSoftmaxOf(*a.m_GPUMatrix, isColWise),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+
+    return *this;
+}
+
+template <class ElemType>
+Matrix<ElemType>& Matrix<ElemType>::AssignMaskedSoftmaxOf(const Matrix<ElemType>& a, ElemType scale, const Matrix<ElemType>& numValidRows)
+{
+    DecideAndMoveToRightDevice(a, numValidRows, *this);
+    if (a.GetMatrixType() != MatrixType::DENSE || numValidRows.GetMatrixType() != MatrixType::DENSE)
+        NOT_IMPLEMENTED;
+    SwitchToMatrixType(MatrixType::DENSE, matrixFormatDense, false);
+
+    DISPATCH_MATRIX_ON_FLAG(&a,
+                            this,
+                            m_CPUMatrix->AssignMaskedSoftmaxOf(*a.m_CPUMatrix, scale, *numValidRows.m_CPUMatrix),
+                            m_GPUMatrix->AssignMaskedSoftmaxOf(*a.m_GPUMatrix, scale, *numValidRows.m_GPUMatrix),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+
+    return *this;
+}
+
 //[this]=softmax([this]) element wise
 template <class ElemType>
 Matrix<ElemType>& Matrix<ElemType>::InplaceHardmax(const bool isColWise)
@@ -3315,22 +3729,18 @@ ElemType Matrix<ElemType>::MatrixNorm0() const
 }
 
 template <class ElemType>
-Matrix<ElemType>& Matrix<ElemType>::AssignSignOf(const Matrix<ElemType>& a)
+Matrix<ElemType>& Matrix<ElemType>::AssignMatrixNormInfOf(const Matrix<ElemType>& a)
 {
     if (a.IsEmpty())
-        LogicError("AssignSignOf: Matrix a is empty.");
+        LogicError("AssignMatrixNormInfOf: Matrix a is empty.");
 
     DecideAndMoveToRightDevice(a, *this);
-    // WARNING: a and this must have same type
-    if (!(GetMatrixType() == a.GetMatrixType()))
-        NOT_IMPLEMENTED;
-
     SwitchToMatrixType(a.GetMatrixType(), a.GetFormat(), false);
 
     DISPATCH_MATRIX_ON_FLAG(&a,
                             this,
-                            m_CPUMatrix->AssignSignOf(*a.m_CPUMatrix),
-                            m_GPUMatrix->AssignSignOf(*a.m_GPUMatrix),
+                            m_CPUMatrix->AssignMatrixNormInfOf(*a.m_CPUMatrix),
+                            m_GPUMatrix->AssignMatrixNormInfOf(*a.m_GPUMatrix),
                             NOT_IMPLEMENTED,
                             NOT_IMPLEMENTED);
 
@@ -3338,51 +3748,114 @@ Matrix<ElemType>& Matrix<ElemType>::AssignSignOf(const Matrix<ElemType>& a)
 }
 
 template <class ElemType>
-Matrix<ElemType>& Matrix<ElemType>::AddSignOf(const Matrix<ElemType>& a)
+Matrix<ElemType>& Matrix<ElemType>::AssignMatrixNorm1Of(const Matrix<ElemType>& a)
 {
     if (a.IsEmpty())
-        LogicError("AddSignOf: Matrix a is empty.");
+        LogicError("AssignMatrixNorm1Of: Matrix a is empty.");
 
     DecideAndMoveToRightDevice(a, *this);
-    if (!(GetMatrixType() == a.GetMatrixType()))
-        NOT_IMPLEMENTED;
+    SwitchToMatrixType(a.GetMatrixType(), a.GetFormat(), false);
 
     DISPATCH_MATRIX_ON_FLAG(&a,
                             this,
-                            m_CPUMatrix->AddSignOf(*a.m_CPUMatrix),
-                            m_GPUMatrix->AddSignOf(*a.m_GPUMatrix),
+                            m_CPUMatrix->AssignMatrixNorm1Of(*a.m_CPUMatrix),
+                            m_GPUMatrix->AssignMatrixNorm1Of(*a.m_GPUMatrix),
                             NOT_IMPLEMENTED,
                             NOT_IMPLEMENTED);
 
     return *this;
 }
 
-//I decided to use Matrix<ElemType>& maxIndexes instead of integer vector because the result may be used to do additional calculation
 template <class ElemType>
-void Matrix<ElemType>::VectorMax(Matrix<ElemType>& maxIndexes, Matrix<ElemType>& maxValues, const bool isColWise) const
+Matrix<ElemType>& Matrix<ElemType>::AssignIsEqualTo(const Matrix<ElemType>& a, const Matrix<ElemType>& b, const ElemType threshold /*= 1e-8*/)
 {
-    if (IsEmpty())
-        LogicError("VectorMax: Matrix is empty.");
+    if (a.IsEmpty() || b.IsEmpty())
+        LogicError("AssignIsEqualTo: one of the input matrices is empty.");
 
-    DecideAndMoveToRightDevice(*this, maxIndexes, maxValues);
-    maxIndexes.SwitchToMatrixType(GetMatrixType(), GetFormat(), false);
-    maxValues.SwitchToMatrixType(GetMatrixType(), GetFormat(), false);
+    DecideAndMoveToRightDevice(a, b, *this);
+    if (a.GetMatrixType() != b.GetMatrixType())
+        NOT_IMPLEMENTED;
+    SwitchToMatrixType(a.GetMatrixType(), a.GetFormat(), false);
 
-    DISPATCH_MATRIX_ON_FLAG(this,
-                            &maxValues,
-                            m_CPUMatrix->VectorMax(*maxIndexes.m_CPUMatrix, *maxValues.m_CPUMatrix, isColWise);
-                            maxIndexes.SetDataLocation(CPU, DENSE),
-                            m_GPUMatrix->VectorMax(*maxIndexes.m_GPUMatrix, *maxValues.m_GPUMatrix, isColWise);
-                            maxIndexes.SetDataLocation(GPU, DENSE),
+    DISPATCH_MATRIX_ON_FLAG(&a,
+                            this,
+                            m_CPUMatrix->AssignIsEqualTo(*a.m_CPUMatrix, *b.m_CPUMatrix, threshold),
+                            m_GPUMatrix->AssignIsEqualTo(*a.m_GPUMatrix, *b.m_GPUMatrix, threshold),
                             NOT_IMPLEMENTED,
                             NOT_IMPLEMENTED);
+
+    return *this;
 }
 
 template <class ElemType>
-void Matrix<ElemType>::VectorMax(Matrix<ElemType>& maxIndexes, Matrix<ElemType>& maxValues, const bool isColWise, int topK) const
+Matrix<ElemType>& Matrix<ElemType>::AssignSignOf(const Matrix<ElemType>& a)
 {
-    if (IsEmpty())
-        LogicError("VectorMax: Matrix is empty.");
+    if (a.IsEmpty())
+        LogicError("AssignSignOf: Matrix a is empty.");
+
+    DecideAndMoveToRightDevice(a, *this);
+    // WARNING: a and this must have same type
+    if (!(GetMatrixType() == a.GetMatrixType()))
+        NOT_IMPLEMENTED;
+
+    SwitchToMatrixType(a.GetMatrixType(), a.GetFormat(), false);
+
+    DISPATCH_MATRIX_ON_FLAG(&a,
+                            this,
+                            m_CPUMatrix->AssignSignOf(*a.m_CPUMatrix),
+                            m_GPUMatrix->AssignSignOf(*a.m_GPUMatrix),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+
+    return *this;
+}
+
+template <class ElemType>
+Matrix<ElemType>& Matrix<ElemType>::AddSignOf(const Matrix<ElemType>& a)
+{
+    if (a.IsEmpty())
+        LogicError("AddSignOf: Matrix a is empty.");
+
+    DecideAndMoveToRightDevice(a, *this);
+    if (!(GetMatrixType() == a.GetMatrixType()))
+        NOT_IMPLEMENTED;
+
+    DISPATCH_MATRIX_ON_FLAG(&a,
+                            this,
+                            m_CPUMatrix->AddSignOf(*a.m_CPUMatrix),
+                            m_GPUMatrix->AddSignOf(*a.m_GPUMatrix),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+
+    return *this;
+}
+
+//I decided to use Matrix<ElemType>& maxIndexes instead of integer vector because the result may be used to do additional calculation
+template <class ElemType>
+void Matrix<ElemType>::VectorMax(Matrix<ElemType>& maxIndexes, Matrix<ElemType>& maxValues, const bool isColWise) const
+{
+    if (IsEmpty())
+        LogicError("VectorMax: Matrix is empty.");
+
+    DecideAndMoveToRightDevice(*this, maxIndexes, maxValues);
+    maxIndexes.SwitchToMatrixType(GetMatrixType(), GetFormat(), false);
+    maxValues.SwitchToMatrixType(GetMatrixType(), GetFormat(), false);
+
+    DISPATCH_MATRIX_ON_FLAG(this,
+                            &maxValues,
+                            m_CPUMatrix->VectorMax(*maxIndexes.m_CPUMatrix, *maxValues.m_CPUMatrix, isColWise);
+                            maxIndexes.SetDataLocation(CPU, DENSE),
+                            m_GPUMatrix->VectorMax(*maxIndexes.m_GPUMatrix, *maxValues.m_GPUMatrix, isColWise);
+                            maxIndexes.SetDataLocation(GPU, DENSE),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+}
+
+template <class ElemType>
+void Matrix<ElemType>::VectorMax(Matrix<ElemType>& maxIndexes, Matrix<ElemType>& maxValues, const bool isColWise, int topK) const
+{
+    if (IsEmpty())
+        LogicError("VectorMax: Matrix is empty.");
 
     DecideAndMoveToRightDevice(*this, maxIndexes, maxValues);
     maxIndexes.SwitchToMatrixType(GetMatrixType(), GetFormat(), false);
@@ -3561,6 +4034,10 @@ void Matrix<ElemType>::_transferFromDeviceToDevice(int from_id, int to_id, bool
         fprintf(stderr, "WARNING: The same matrix with dim [%lu, %lu] has been transferred between different devices for %d times.\n", (unsigned long) GetNumRows(), (unsigned long) GetNumCols(), NUM_DEVICE_CHANGED_WARN);
     }
 
+    // copies between the host and a GPU wait for the device; copies between GPUs do not
+    if ((from_id == CPUDEVICE || to_id == CPUDEVICE) && !emptyTransfer && !IsEmpty())
+        GPUMathOptions::NoteImplicitDeviceSync(from_id == CPUDEVICE ? "Matrix::TransferFromDeviceToDevice (from the CPU)" : "Matrix::TransferFromDeviceToDevice (to the CPU)");
+
     if (m_matrixType == MatrixType::SPARSE)
     {
         if (from_id == CPUDEVICE) // from CPU to GPU
@@ -3803,21 +4280,159 @@ Matrix<ElemType>& Matrix<ElemType>::UnpackConvolutionInput(Matrix<ElemType>& inp
     return inputSubBatch;
 }
 
+template <class ElemType>
+Matrix<ElemType>& Matrix<ElemType>::AssignConvolutionResult(const Matrix<ElemType>& inputBatch, const Matrix<ElemType>& filter,
+                                                            const size_t inputWidth, const size_t inputHeight, const size_t inputChannels,
+                                                            const size_t outputWidth, const size_t outputHeight, const size_t outputChannels,
+                                                            const size_t kernelWidth, const size_t kernelHeight, const size_t horizontalSubsample, const size_t verticalSubsample,
+                                                            const bool zeroPadding)
+{
+    DecideAndMoveToRightDevice(inputBatch, filter, *this);
+    SwitchToMatrixType(MatrixType::DENSE, MatrixFormat::matrixFormatDense, false);
+
+    DISPATCH_MATRIX_ON_FLAG(&inputBatch,
+                            this,
+                            m_CPUMatrix->AssignConvolutionResult(*(inputBatch.m_CPUMatrix), *(filter.m_CPUMatrix),
+                                                                 inputWidth, inputHeight, inputChannels,
+                                                                 outputWidth, outputHeight, outputChannels,
+                                                                 kernelWidth, kernelHeight, horizontalSubsample, verticalSubsample,
+                                                                 zeroPadding),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+
+    return *this;
+}
+
+static void VerifyGroupedConvolutionDims(const char* function, const size_t inputRows, const size_t filterRows, const size_t filterCols,
+                                         const size_t inputWidth, const size_t inputHeight, const size_t inputChannels, const size_t outputChannels,
+                                         const size_t kernelWidth, const size_t kernelHeight, const size_t groups)
+{
+    if (groups == 0 || inputChannels % groups != 0 || outputChannels % groups != 0)
+        InvalidArgument("%s: The numbers of input (%d) and output (%d) channels must be multiples of the number of groups (%d).",
+                        function, (int) inputChannels, (int) outputChannels, (int) groups);
+    if (inputRows != inputWidth * inputHeight * inputChannels)
+        InvalidArgument("%s: The input has %d rows instead of %d.", function, (int) inputRows, (int) (inputWidth * inputHeight * inputChannels));
+    if (filterRows != outputChannels || filterCols != kernelWidth * kernelHeight * (inputChannels / groups))
+        InvalidArgument("%s: Kernel dimensions and weight matrix dimensions don't match.", function);
+}
+
+template <class ElemType>
+Matrix<ElemType>& Matrix<ElemType>::AssignGroupedConvolutionResult(const Matrix<ElemType>& inputBatch, const Matrix<ElemType>& filter,
+                                                                   const size_t inputWidth, const size_t inputHeight, const size_t inputChannels,
+                                                                   const size_t outputWidth, const size_t outputHeight, const size_t outputChannels,
+                                                                   const size_t kernelWidth, const size_t kernelHeight, const size_t horizontalSubsample, const size_t verticalSubsample,
+                                                                   const bool zeroPadding, const size_t groups)
+{
+    VerifyGroupedConvolutionDims("AssignGroupedConvolutionResult", inputBatch.GetNumRows(), filter.GetNumRows(), filter.GetNumCols(),
+                                 inputWidth, inputHeight, inputChannels, outputChannels, kernelWidth, kernelHeight, groups);
+    if (this == &inputBatch || this == &filter)
+        InvalidArgument("AssignGroupedConvolutionResult: The result cannot be an argument.");
+
+    DecideAndMoveToRightDevice(inputBatch, filter, *this);
+    SwitchToMatrixType(MatrixType::DENSE, MatrixFormat::matrixFormatDense, false);
+
+    DISPATCH_MATRIX_ON_FLAG(&inputBatch,
+                            this,
+                            m_CPUMatrix->AssignGroupedConvolutionResult(*(inputBatch.m_CPUMatrix), *(filter.m_CPUMatrix),
+                                                                        inputWidth, inputHeight, inputChannels,
+                                                                        outputWidth, outputHeight, outputChannels,
+                                                                        kernelWidth, kernelHeight, horizontalSubsample, verticalSubsample,
+                                                                        zeroPadding, groups),
+                            m_GPUMatrix->AssignGroupedConvolutionResult(*(inputBatch.m_GPUMatrix), *(filter.m_GPUMatrix),
+                                                                        inputWidth, inputHeight, inputChannels,
+                                                                        outputWidth, outputHeight, outputChannels,
+                                                                        kernelWidth, kernelHeight, horizontalSubsample, verticalSubsample,
+                                                                        zeroPadding, groups),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+
+    return *this;
+}
+
+template <class ElemType>
+Matrix<ElemType>& Matrix<ElemType>::AddGroupedConvolutionGradientOfInput(const Matrix<ElemType>& outputGradientBatch, const Matrix<ElemType>& filter,
+                                                                         const size_t inputWidth, const size_t inputHeight, const size_t inputChannels,
+                                                                         const size_t outputWidth, const size_t outputHeight, const size_t outputChannels,
+                                                                         const size_t kernelWidth, const size_t kernelHeight, const size_t horizontalSubsample, const size_t verticalSubsample,
+                                                                         const bool zeroPadding, const size_t groups)
+{
+    VerifyGroupedConvolutionDims("AddGroupedConvolutionGradientOfInput", GetNumRows(), filter.GetNumRows(), filter.GetNumCols(),
+                                 inputWidth, inputHeight, inputChannels, outputChannels, kernelWidth, kernelHeight, groups);
+    if (outputGradientBatch.GetNumRows() != outputWidth * outputHeight * outputChannels || outputGradientBatch.GetNumCols() != GetNumCols())
+        InvalidArgument("AddGroupedConvolutionGradientOfInput: The output gradient dimensions don't match.");
+
+    DecideAndMoveToRightDevice(outputGradientBatch, filter, *this);
+
+    DISPATCH_MATRIX_ON_FLAG(this,
+                            this,
+                            m_CPUMatrix->AddGroupedConvolutionGradientOfInput(*(outputGradientBatch.m_CPUMatrix), *(filter.m_CPUMatrix),
+                                                                              inputWidth, inputHeight, inputChannels,
+                                                                              outputWidth, outputHeight, outputChannels,
+                                                                              kernelWidth, kernelHeight, horizontalSubsample, verticalSubsample,
+                                                                              zeroPadding, groups),
+                            m_GPUMatrix->AddGroupedConvolutionGradientOfInput(*(outputGradientBatch.m_GPUMatrix), *(filter.m_GPUMatrix),
+                                                                              inputWidth, inputHeight, inputChannels,
+                                                                              outputWidth, outputHeight, outputChannels,
+                                                                              kernelWidth, kernelHeight, horizontalSubsample, verticalSubsample,
+                                                                              zeroPadding, groups),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+
+    return *this;
+}
+
+template <class ElemType>
+Matrix<ElemType>& Matrix<ElemType>::AddGroupedConvolutionGradientOfFilter(const Matrix<ElemType>& outputGradientBatch, const Matrix<ElemType>& inputBatch,
+                                                                          const size_t inputWidth, const size_t inputHeight, const size_t inputChannels,
+                                                                          const size_t outputWidth, const size_t outputHeight, const size_t outputChannels,
+                                                                          const size_t kernelWidth, const size_t kernelHeight, const size_t horizontalSubsample, const size_t verticalSubsample,
+                                                                          const bool zeroPadding, const size_t groups)
+{
+    VerifyGroupedConvolutionDims("AddGroupedConvolutionGradientOfFilter", inputBatch.GetNumRows(), GetNumRows(), GetNumCols(),
+                                 inputWidth, inputHeight, inputChannels, outputChannels, kernelWidth, kernelHeight, groups);
+    if (outputGradientBatch.GetNumRows() != outputWidth * outputHeight * outputChannels || outputGradientBatch.GetNumCols() != inputBatch.GetNumCols())
+        InvalidArgument("AddGroupedConvolutionGradientOfFilter: The output gradient dimensions don't match.");
+
+    DecideAndMoveToRightDevice(outputGradientBatch, inputBatch, *this);
+
+    DISPATCH_MATRIX_ON_FLAG(this,
+                            this,
+                            m_CPUMatrix->AddGroupedConvolutionGradientOfFilter(*(outputGradientBatch.m_CPUMatrix), *(inputBatch.m_CPUMatrix),
+                                                                               inputWidth, inputHeight, inputChannels,
+                                                                               outputWidth, outputHeight, outputChannels,
+                                                                               kernelWidth, kernelHeight, horizontalSubsample, verticalSubsample,
+                                                                               zeroPadding, groups),
+                            m_GPUMatrix->AddGroupedConvolutionGradientOfFilter(*(outputGradientBatch.m_GPUMatrix), *(inputBatch.m_GPUMatrix),
+                                                                               inputWidth, inputHeight, inputChannels,
+                                                                               outputWidth, outputHeight, outputChannels,
+                                                                               kernelWidth, kernelHeight, horizontalSubsample, verticalSubsample,
+                                                                               zeroPadding, groups),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+
+    return *this;
+}
+
 template <class ElemType>
 Matrix<ElemType>& Matrix<ElemType>::AssignMaxPoolingResult(const Matrix<ElemType>& inputBatch, const size_t channels,
                                                            const size_t inputWidth, const size_t inputHeight, const size_t inputSizePerSample,
                                                            const size_t outputWidth, const size_t outputHeight, const size_t outputSizePerSample,
-                                                           const size_t windowWidth, const size_t windowHeight, const size_t horizontalSubsample, const size_t verticalSubsample)
+                                                           const size_t windowWidth, const size_t windowHeight, const size_t horizontalSubsample, const size_t verticalSubsample,
+                                                           std::vector<int>* argmax)
 {
     DecideAndMoveToRightDevice(inputBatch, *this);
     SwitchToMatrixType(inputBatch.GetMatrixType(), inputBatch.GetFormat(), false);
+    if (argmax)
+        argmax->clear();
 
     DISPATCH_MATRIX_ON_FLAG(&inputBatch,
                             this,
                             m_CPUMatrix->AssignMaxPoolingResult(*(inputBatch.m_CPUMatrix), channels,
                                                                 inputWidth, inputHeight, inputSizePerSample,
                                                                 outputWidth, outputHeight, outputSizePerSample,
-                                                                windowWidth, windowHeight, horizontalSubsample, verticalSubsample),
+                                                                windowWidth, windowHeight, horizontalSubsample, verticalSubsample,
+                                                                argmax),
                             m_GPUMatrix->AssignMaxPoolingResult(*(inputBatch.m_GPUMatrix), channels,
                                                                 inputWidth, inputHeight, inputSizePerSample,
                                                                 outputWidth, outputHeight, outputSizePerSample,
@@ -3858,6 +4473,25 @@ Matrix<ElemType>& Matrix<ElemType>::AddMaxPoolingGradient(const Matrix<ElemType>
     return *this;
 }
 
+template <class ElemType>
+Matrix<ElemType>& Matrix<ElemType>::AddMaxPoolingGradientAtArgmax(const Matrix<ElemType>& outputGradientBatch, const std::vector<int>& argmax,
+                                                                  const size_t channels, const size_t inputSizePerSample, const size_t outputSizePerSample)
+{
+    DecideAndMoveToRightDevice(*this, outputGradientBatch);
+
+    if (!(GetMatrixType() == MatrixType::DENSE && outputGradientBatch.GetMatrixType() == MatrixType::DENSE))
+        NOT_IMPLEMENTED;
+
+    DISPATCH_MATRIX_ON_FLAG(this,
+                            this,
+                            m_CPUMatrix->AddMaxPoolingGradientAtArgmax(*(outputGradientBatch.m_CPUMatrix), argmax, channels, inputSizePerSample, outputSizePerSample),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+
+    return *this;
+}
+
 template <class ElemType>
 Matrix<ElemType>& Matrix<ElemType>::AssignAveragePoolingResult(const Matrix<ElemType>& inputBatch, const size_t channels,
                                                                const size_t inputWidth, const size_t inputHeight, const size_t inputSizePerSample,
@@ -3908,6 +4542,309 @@ Matrix<ElemType>& Matrix<ElemType>::AssignNceUnnormalizedEval(const Matrix<ElemT
     return *this;
 }
 
+template <class ElemType>
+Matrix<ElemType>& Matrix<ElemType>::InplaceSampleFromCDF(const Matrix<ElemType>& cdf)
+{
+    DecideAndMoveToRightDevice(*this, cdf);
+
+    DISPATCH_MATRIX_ON_FLAG(this,
+                            this,
+                            m_CPUMatrix->InplaceSampleFromCDF(*cdf.m_CPUMatrix),
+                            m_GPUMatrix->InplaceSampleFromCDF(*cdf.m_GPUMatrix),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+    return *this;
+}
+
+template <class ElemType>
+void Matrix<ElemType>::AssignOneHotColumnsOf(const Matrix<ElemType>& ids, const size_t numRows)
+{
+    if (ids.GetMatrixType() != MatrixType::DENSE)
+        NOT_IMPLEMENTED;
+
+    DecideAndMoveToRightDevice(ids, *this);
+    SwitchToMatrixType(MatrixType::SPARSE, matrixFormatSparseCSC, false);
+
+    DISPATCH_MATRIX_ON_FLAG(this,
+                            this,
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED,
+                            m_CPUSparseMatrix->AssignOneHotColumnsOf(*ids.m_CPUMatrix, numRows),
+                            m_GPUSparseMatrix->AssignOneHotColumnsOf(*ids.m_GPUMatrix, numRows));
+}
+
+template <class ElemType>
+Matrix<ElemType>& Matrix<ElemType>::AssignSampledSoftmaxLogits(const Matrix<ElemType>& trueLogits, const Matrix<ElemType>& sampledLogits,
+                                                               const Matrix<ElemType>& candidateBiases, const Matrix<ElemType>& candidateIds)
+{
+    const size_t numSamples = sampledLogits.GetNumRows();
+    const size_t numCols = sampledLogits.GetNumCols();
+    if (trueLogits.GetNumElements() != numCols || candidateBiases.GetNumElements() != numSamples + numCols || candidateIds.GetNumElements() != numSamples + numCols)
+        InvalidArgument("AssignSampledSoftmaxLogits: the dimensions of the inputs do not match %d samples for %d columns.", (int) numSamples, (int) numCols);
+
+    DecideAndMoveToRightDevice(sampledLogits, trueLogits, candidateBiases, candidateIds);
+    DecideAndMoveToRightDevice(sampledLogits, *this);
+    SwitchToMatrixType(MatrixType::DENSE, matrixFormatDense, false);
+
+    DISPATCH_MATRIX_ON_FLAG(&sampledLogits,
+                            this,
+                            m_CPUMatrix->AssignSampledSoftmaxLogits(*trueLogits.m_CPUMatrix, *sampledLogits.m_CPUMatrix, *candidateBiases.m_CPUMatrix, *candidateIds.m_CPUMatrix),
+                            m_GPUMatrix->AssignSampledSoftmaxLogits(*trueLogits.m_GPUMatrix, *sampledLogits.m_GPUMatrix, *candidateBiases.m_GPUMatrix, *candidateIds.m_GPUMatrix),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+    return *this;
+}
+
+template <class ElemType>
+Matrix<ElemType>& Matrix<ElemType>::AssignAliasSamplesOf(const Matrix<ElemType>& uniforms, const Matrix<ElemType>& aliasProbs, const Matrix<ElemType>& aliases)
+{
+    if (uniforms.GetNumRows() != 2 || aliasProbs.IsEmpty() || aliases.GetNumElements() != aliasProbs.GetNumElements())
+        InvalidArgument("AssignAliasSamplesOf: expected [2 x N] uniform values and an alias table of two [1 x V] vectors.");
+    if (this == &uniforms)
+        InvalidArgument("AssignAliasSamplesOf: cannot sample in place.");
+
+    DecideAndMoveToRightDevice(uniforms, aliasProbs, aliases);
+    DecideAndMoveToRightDevice(uniforms, *this);
+    SwitchToMatrixType(MatrixType::DENSE, matrixFormatDense, false);
+
+    DISPATCH_MATRIX_ON_FLAG(&uniforms,
+                            this,
+                            m_CPUMatrix->AssignAliasSamplesOf(*uniforms.m_CPUMatrix, *aliasProbs.m_CPUMatrix, *aliases.m_CPUMatrix),
+                            m_GPUMatrix->AssignAliasSamplesOf(*uniforms.m_GPUMatrix, *aliasProbs.m_GPUMatrix, *aliases.m_GPUMatrix),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+    return *this;
+}
+
+template <class ElemType>
+Matrix<ElemType>& Matrix<ElemType>::AssignNCELossOf(const Matrix<ElemType>& labelIds, const Matrix<ElemType>& noiseIds, const Matrix<ElemType>& hidden, const Matrix<ElemType>& weights,
+                                                    const Matrix<ElemType>& bias, const Matrix<ElemType>& logNoiseCounts, Matrix<ElemType>& scoreGradients)
+{
+    const size_t numClasses = weights.GetNumCols();
+    if (hidden.GetNumRows() != weights.GetNumRows() || labelIds.GetNumElements() != hidden.GetNumCols() || noiseIds.IsEmpty() ||
+        bias.GetNumElements() != numClasses || logNoiseCounts.GetNumElements() != numClasses)
+        InvalidArgument("AssignNCELossOf: the dimensions of the labels [%d x %d], hidden [%d x %d], weights [%d x %d], bias [%d x %d] and noise counts [%d x %d] do not match.",
+                        (int) labelIds.GetNumRows(), (int) labelIds.GetNumCols(), (int) hidden.GetNumRows(), (int) hidden.GetNumCols(), (int) weights.GetNumRows(), (int) weights.GetNumCols(),
+                        (int) bias.GetNumRows(), (int) bias.GetNumCols(), (int) logNoiseCounts.GetNumRows(), (int) logNoiseCounts.GetNumCols());
+
+    DecideAndMoveToRightDevice(hidden, weights, labelIds, noiseIds);
+    DecideAndMoveToRightDevice(hidden, bias, logNoiseCounts, scoreGradients);
+    DecideAndMoveToRightDevice(hidden, *this);
+    SwitchToMatrixType(MatrixType::DENSE, matrixFormatDense, false);
+    scoreGradients.SwitchToMatrixType(MatrixType::DENSE, matrixFormatDense, false);
+
+    DISPATCH_MATRIX_ON_FLAG(&hidden,
+                            this,
+                            m_CPUMatrix->AssignNCELossOf(*labelIds.m_CPUMatrix, *noiseIds.m_CPUMatrix, *hidden.m_CPUMatrix, *weights.m_CPUMatrix, *bias.m_CPUMatrix, *logNoiseCounts.m_CPUMatrix, *scoreGradients.m_CPUMatrix),
+                            m_GPUMatrix->AssignNCELossOf(*labelIds.m_GPUMatrix, *noiseIds.m_GPUMatrix, *hidden.m_GPUMatrix, *weights.m_GPUMatrix, *bias.m_GPUMatrix, *logNoiseCounts.m_GPUMatrix, *scoreGradients.m_GPUMatrix),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+    return *this;
+}
+
+template <class ElemType>
+Matrix<ElemType>& Matrix<ElemType>::AddNCEHiddenGradientOf(const Matrix<ElemType>& scoreGradients, const Matrix<ElemType>& labelIds, const Matrix<ElemType>& noiseIds, const Matrix<ElemType>& weights)
+{
+    if (GetNumRows() != weights.GetNumRows() || GetNumCols() != labelIds.GetNumElements() || scoreGradients.GetNumCols() != GetNumCols() ||
+        scoreGradients.GetNumRows() != noiseIds.GetNumElements() + 1)
+        InvalidArgument("AddNCEHiddenGradientOf: the dimensions of the gradient [%d x %d], the score gradients [%d x %d] and the weights [%d x %d] do not match.",
+                        (int) GetNumRows(), (int) GetNumCols(), (int) scoreGradients.GetNumRows(), (int) scoreGradients.GetNumCols(), (int) weights.GetNumRows(), (int) weights.GetNumCols());
+
+    DecideAndMoveToRightDevice(*this, scoreGradients, labelIds, noiseIds);
+    DecideAndMoveToRightDevice(*this, weights);
+
+    DISPATCH_MATRIX_ON_FLAG(this,
+                            this,
+                            m_CPUMatrix->AddNCEHiddenGradientOf(*scoreGradients.m_CPUMatrix, *labelIds.m_CPUMatrix, *noiseIds.m_CPUMatrix, *weights.m_CPUMatrix),
+                            m_GPUMatrix->AddNCEHiddenGradientOf(*scoreGradients.m_GPUMatrix, *labelIds.m_GPUMatrix, *noiseIds.m_GPUMatrix, *weights.m_GPUMatrix),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+    return *this;
+}
+
+template <class ElemType>
+Matrix<ElemType>& Matrix<ElemType>::AssignGMMLogLikelihoodOf(const Matrix<ElemType>& logPrior, const Matrix<ElemType>& mean, const Matrix<ElemType>& logStddev, const Matrix<ElemType>& feature,
+                                                             Matrix<ElemType>& posterior, Matrix<ElemType>& normedDeviation, Matrix<ElemType>& normedDeviationVectors)
+{
+    const size_t numComponents = logPrior.GetNumRows();
+    const size_t numSamples = feature.GetNumCols();
+    auto isShared = [numSamples](const Matrix<ElemType>& m) { return m.GetNumCols() == 1 || m.GetNumCols() == numSamples; };
+    if (logStddev.GetNumRows() != numComponents || mean.GetNumRows() != numComponents * feature.GetNumRows() || !isShared(logPrior) || !isShared(mean) || !isShared(logStddev))
+        InvalidArgument("AssignGMMLogLikelihoodOf: the dimensions of the mixture parameters do not match %d components of dimension %d for %d samples.",
+                        (int) numComponents, (int) feature.GetNumRows(), (int) numSamples);
+
+    DecideAndMoveToRightDevice(feature, logPrior, mean, logStddev);
+    DecideAndMoveToRightDevice(feature, *this, posterior, normedDeviation);
+    DecideAndMoveToRightDevice(feature, normedDeviationVectors);
+    SwitchToMatrixType(MatrixType::DENSE, matrixFormatDense, false);
+
+    DISPATCH_MATRIX_ON_FLAG(&feature,
+                            this,
+                            m_CPUMatrix->AssignGMMLogLikelihoodOf(*logPrior.m_CPUMatrix, *mean.m_CPUMatrix, *logStddev.m_CPUMatrix, *feature.m_CPUMatrix,
+                                                                  *posterior.m_CPUMatrix, *normedDeviation.m_CPUMatrix, *normedDeviationVectors.m_CPUMatrix),
+                            m_GPUMatrix->AssignGMMLogLikelihoodOf(*logPrior.m_GPUMatrix, *mean.m_GPUMatrix, *logStddev.m_GPUMatrix, *feature.m_GPUMatrix,
+                                                                  *posterior.m_GPUMatrix, *normedDeviation.m_GPUMatrix, *normedDeviationVectors.m_GPUMatrix),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+    return *this;
+}
+
+template <class ElemType>
+Matrix<ElemType>& Matrix<ElemType>::AddGMMLogLikelihoodGradient(const size_t inputIndex, const Matrix<ElemType>& gradient, const Matrix<ElemType>& logPrior,
+                                                                const Matrix<ElemType>& posterior, const Matrix<ElemType>& normedDeviation, const Matrix<ElemType>& normedDeviationVectors)
+{
+    const size_t numComponents = posterior.GetNumRows();
+    const size_t numSamples = posterior.GetNumCols();
+    if (inputIndex > 3)
+        InvalidArgument("AddGMMLogLikelihoodGradient: the GMM log-likelihood only has four inputs.");
+    if (gradient.GetNumElements() != numSamples || normedDeviation.GetNumRows() != numComponents || normedDeviationVectors.GetNumRows() % numComponents != 0)
+        InvalidArgument("AddGMMLogLikelihoodGradient: the dimensions of the statistics do not match %d components for %d samples.", (int) numComponents, (int) numSamples);
+    const size_t expectedRows = inputIndex == 1 ? normedDeviationVectors.GetNumRows() : inputIndex == 3 ? normedDeviationVectors.GetNumRows() / numComponents : numComponents;
+    if (GetNumRows() != expectedRows || (GetNumCols() != numSamples && (GetNumCols() != 1 || inputIndex == 3)))
+        InvalidArgument("AddGMMLogLikelihoodGradient: the gradient of input %d must be [%d x %d]%s.", (int) inputIndex, (int) expectedRows, (int) numSamples, inputIndex == 3 ? "" : " or a single column");
+
+    DecideAndMoveToRightDevice(posterior, gradient, logPrior, *this);
+    DecideAndMoveToRightDevice(posterior, normedDeviation, normedDeviationVectors);
+
+    DISPATCH_MATRIX_ON_FLAG(this,
+                            this,
+                            m_CPUMatrix->AddGMMLogLikelihoodGradient(inputIndex, *gradient.m_CPUMatrix, *logPrior.m_CPUMatrix,
+                                                                     *posterior.m_CPUMatrix, *normedDeviation.m_CPUMatrix, *normedDeviationVectors.m_CPUMatrix),
+                            m_GPUMatrix->AddGMMLogLikelihoodGradient(inputIndex, *gradient.m_GPUMatrix, *logPrior.m_GPUMatrix,
+                                                                     *posterior.m_GPUMatrix, *normedDeviation.m_GPUMatrix, *normedDeviationVectors.m_GPUMatrix),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+    return *this;
+}
+
+template <class ElemType>
+Matrix<ElemType>& Matrix<ElemType>::AssignCrossEntropyWithSoftmaxOf(const Matrix<ElemType>& labels, const Matrix<ElemType>& logits, Matrix<ElemType>& logSumExp)
+{
+    if (labels.GetNumRows() != logits.GetNumRows() || labels.GetNumCols() != logits.GetNumCols())
+        InvalidArgument("AssignCrossEntropyWithSoftmaxOf: labels [%d x %d] and logits [%d x %d] must have the same dimensions.",
+                        (int) labels.GetNumRows(), (int) labels.GetNumCols(), (int) logits.GetNumRows(), (int) logits.GetNumCols());
+    if (labels.GetMatrixType() != MatrixType::DENSE || logits.GetMatrixType() != MatrixType::DENSE)
+        NOT_IMPLEMENTED;
+
+    DecideAndMoveToRightDevice(logits, labels, logSumExp, *this);
+    SwitchToMatrixType(MatrixType::DENSE, matrixFormatDense, false);
+    logSumExp.SwitchToMatrixType(MatrixType::DENSE, matrixFormatDense, false);
+
+    DISPATCH_MATRIX_ON_FLAG(&logits,
+                            this,
+                            m_CPUMatrix->AssignCrossEntropyWithSoftmaxOf(*labels.m_CPUMatrix, *logits.m_CPUMatrix, *logSumExp.m_CPUMatrix),
+                            m_GPUMatrix->AssignCrossEntropyWithSoftmaxOf(*labels.m_GPUMatrix, *logits.m_GPUMatrix, *logSumExp.m_GPUMatrix),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+    return *this;
+}
+
+template <class ElemType>
+Matrix<ElemType>& Matrix<ElemType>::AddCrossEntropyWithSoftmaxGradient(const size_t inputIndex, const Matrix<ElemType>& gradient, const Matrix<ElemType>& labels,
+                                                                       const Matrix<ElemType>& logits, const Matrix<ElemType>& logSumExp)
+{
+    if (inputIndex > 1)
+        InvalidArgument("AddCrossEntropyWithSoftmaxGradient: the softmax cross entropy only has two inputs.");
+    if (GetNumRows() != logits.GetNumRows() || GetNumCols() != logits.GetNumCols() || labels.GetNumRows() != logits.GetNumRows() || labels.GetNumCols() != logits.GetNumCols() ||
+        logSumExp.GetNumElements() != logits.GetNumCols() || gradient.GetNumElements() != 1)
+        InvalidArgument("AddCrossEntropyWithSoftmaxGradient: the dimensions of the gradient, labels and logits do not match.");
+    if (GetMatrixType() != MatrixType::DENSE || labels.GetMatrixType() != MatrixType::DENSE || logits.GetMatrixType() != MatrixType::DENSE)
+        NOT_IMPLEMENTED;
+
+    DecideAndMoveToRightDevice(*this, labels, logits);
+    DecideAndMoveToRightDevice(*this, gradient, logSumExp);
+
+    DISPATCH_MATRIX_ON_FLAG(this,
+                            this,
+                            m_CPUMatrix->AddCrossEntropyWithSoftmaxGradient(inputIndex, *gradient.m_CPUMatrix, *labels.m_CPUMatrix, *logits.m_CPUMatrix, *logSumExp.m_CPUMatrix),
+                            m_GPUMatrix->AddCrossEntropyWithSoftmaxGradient(inputIndex, *gradient.m_GPUMatrix, *labels.m_GPUMatrix, *logits.m_GPUMatrix, *logSumExp.m_GPUMatrix),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+    return *this;
+}
+
+template <class ElemType>
+Matrix<ElemType>& Matrix<ElemType>::AssignViterbiPathOf(const Matrix<ElemType>& posScores, const Matrix<ElemType>& pairScores, const Matrix<ElemType>& sequences, const size_t numParallelSequences,
+                                                        const int startLabel, const int endLabel, Matrix<ElemType>& alpha, Matrix<ElemType>& backtrace)
+{
+    const size_t numLabels = posScores.GetNumRows();
+    if (pairScores.GetNumRows() != numLabels || pairScores.GetNumCols() != numLabels || sequences.GetNumRows() != 3 || numParallelSequences == 0 ||
+        posScores.GetNumCols() % numParallelSequences != 0 || startLabel >= (int) numLabels || endLabel >= (int) numLabels)
+        InvalidArgument("AssignViterbiPathOf: the dimensions of the scores and sequences do not match %d labels.", (int) numLabels);
+
+    DecideAndMoveToRightDevice(posScores, pairScores, sequences, *this);
+    DecideAndMoveToRightDevice(posScores, alpha, backtrace);
+    SwitchToMatrixType(MatrixType::DENSE, matrixFormatDense, false);
+
+    DISPATCH_MATRIX_ON_FLAG(&posScores,
+                            this,
+                            m_CPUMatrix->AssignViterbiPathOf(*posScores.m_CPUMatrix, *pairScores.m_CPUMatrix, *sequences.m_CPUMatrix, numParallelSequences,
+                                                             startLabel, endLabel, *alpha.m_CPUMatrix, *backtrace.m_CPUMatrix),
+                            m_GPUMatrix->AssignViterbiPathOf(*posScores.m_GPUMatrix, *pairScores.m_GPUMatrix, *sequences.m_GPUMatrix, numParallelSequences,
+                                                             startLabel, endLabel, *alpha.m_GPUMatrix, *backtrace.m_GPUMatrix),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+    return *this;
+}
+
+template <class ElemType>
+Matrix<ElemType>& Matrix<ElemType>::AssignClassBasedCrossEntropyWithSoftmaxOf(const Matrix<ElemType>& labels, const Matrix<ElemType>& input, const Matrix<ElemType>& weight,
+                                                                              const Matrix<ElemType>& classLogSoftmax, const Matrix<ElemType>& buckets, const Matrix<ElemType>& frames,
+                                                                              const size_t maxClassSize, Matrix<ElemType>& softmax)
+{
+    const size_t numCols = labels.GetNumCols();
+    if (labels.GetNumRows() != 4 || input.GetNumCols() != numCols || classLogSoftmax.GetNumCols() != numCols || input.GetNumRows() != weight.GetNumRows() ||
+        buckets.GetNumRows() != 4 || frames.GetNumRows() != 1)
+        InvalidArgument("AssignClassBasedCrossEntropyWithSoftmaxOf: the dimensions of the labels [%d x %d], input [%d x %d], weight [%d x %d] and class log softmax [%d x %d] do not match.",
+                        (int) labels.GetNumRows(), (int) numCols, (int) input.GetNumRows(), (int) input.GetNumCols(), (int) weight.GetNumRows(), (int) weight.GetNumCols(),
+                        (int) classLogSoftmax.GetNumRows(), (int) classLogSoftmax.GetNumCols());
+
+    DecideAndMoveToRightDevice(input, labels, weight, classLogSoftmax);
+    DecideAndMoveToRightDevice(input, buckets, frames, softmax);
+    DecideAndMoveToRightDevice(input, *this);
+    SwitchToMatrixType(MatrixType::DENSE, matrixFormatDense, false);
+    softmax.SwitchToMatrixType(MatrixType::DENSE, matrixFormatDense, false);
+
+    DISPATCH_MATRIX_ON_FLAG(&input,
+                            this,
+                            m_CPUMatrix->AssignClassBasedCrossEntropyWithSoftmaxOf(*labels.m_CPUMatrix, *input.m_CPUMatrix, *weight.m_CPUMatrix, *classLogSoftmax.m_CPUMatrix,
+                                                                                   *buckets.m_CPUMatrix, *frames.m_CPUMatrix, maxClassSize, *softmax.m_CPUMatrix),
+                            m_GPUMatrix->AssignClassBasedCrossEntropyWithSoftmaxOf(*labels.m_GPUMatrix, *input.m_GPUMatrix, *weight.m_GPUMatrix, *classLogSoftmax.m_GPUMatrix,
+                                                                                   *buckets.m_GPUMatrix, *frames.m_GPUMatrix, maxClassSize, *softmax.m_GPUMatrix),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+    return *this;
+}
+
+template <class ElemType>
+Matrix<ElemType>& Matrix<ElemType>::AddClassBasedCrossEntropyWithSoftmaxGradient(const size_t inputIndex, const Matrix<ElemType>& gradient, const Matrix<ElemType>& labels,
+                                                                                 const Matrix<ElemType>& input, const Matrix<ElemType>& weight, const Matrix<ElemType>& classLogSoftmax,
+                                                                                 const Matrix<ElemType>& buckets, const Matrix<ElemType>& frames, const Matrix<ElemType>& softmax)
+{
+    if (inputIndex < 1 || inputIndex > 3)
+        InvalidArgument("AddClassBasedCrossEntropyWithSoftmaxGradient: there is only a gradient w.r.t. the input, the weight and the class logits.");
+    const Matrix<ElemType>& target = inputIndex == 1 ? input : inputIndex == 2 ? weight : classLogSoftmax;
+    if (GetNumRows() != target.GetNumRows() || GetNumCols() != target.GetNumCols() || gradient.GetNumElements() != 1 || softmax.GetNumCols() != labels.GetNumCols())
+        InvalidArgument("AddClassBasedCrossEntropyWithSoftmaxGradient: the dimensions of the gradient [%d x %d] and of input %d [%d x %d] do not match.",
+                        (int) GetNumRows(), (int) GetNumCols(), (int) inputIndex, (int) target.GetNumRows(), (int) target.GetNumCols());
+    if (GetMatrixType() != MatrixType::DENSE)
+        NOT_IMPLEMENTED;
+
+    DecideAndMoveToRightDevice(*this, labels, input, weight);
+    DecideAndMoveToRightDevice(*this, classLogSoftmax, buckets, frames);
+    DecideAndMoveToRightDevice(*this, gradient, softmax);
+
+    DISPATCH_MATRIX_ON_FLAG(this,
+                            this,
+                            m_CPUMatrix->AddClassBasedCrossEntropyWithSoftmaxGradient(inputIndex, *gradient.m_CPUMatrix, *labels.m_CPUMatrix, *input.m_CPUMatrix, *weight.m_CPUMatrix,
+                                                                                      *classLogSoftmax.m_CPUMatrix, *buckets.m_CPUMatrix, *frames.m_CPUMatrix, *softmax.m_CPUMatrix),
+                            m_GPUMatrix->AddClassBasedCrossEntropyWithSoftmaxGradient(inputIndex, *gradient.m_GPUMatrix, *labels.m_GPUMatrix, *input.m_GPUMatrix, *weight.m_GPUMatrix,
+                                                                                      *classLogSoftmax.m_GPUMatrix, *buckets.m_GPUMatrix, *frames.m_GPUMatrix, *softmax.m_GPUMatrix),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+    return *this;
+}
+
 template <class ElemType>
 Matrix<ElemType>& Matrix<ElemType>::AssignNoiseContrastiveEstimation(const Matrix<ElemType>& a, const Matrix<ElemType>& b, const Matrix<ElemType>& c, const Matrix<ElemType>& bias, Matrix<ElemType>& tmp)
 {
@@ -4034,8 +4971,13 @@ void Matrix<ElemType>::MultiplyAndWeightedAdd(ElemType alpha, const Matrix<ElemT
     if (c.GetDeviceId() < 0) // CPU
     {
         if (a.GetMatrixType() == MatrixType::SPARSE)
-            NOT_IMPLEMENTED;
-        if (b.GetMatrixType() == MatrixType::SPARSE)
+        {
+            if (b.GetMatrixType() != MatrixType::DENSE || c.GetMatrixType() != MatrixType::DENSE)
+                NOT_IMPLEMENTED;
+            CPUSparseMatrix<ElemType>::MultiplyAndWeightedAdd(alpha, *a.m_CPUSparseMatrix, transposeA, *b.m_CPUMatrix, transposeB, beta, *c.m_CPUMatrix);
+            c.SetDataLocation(CPU, DENSE);
+        }
+        else if (b.GetMatrixType() == MatrixType::SPARSE)
         {
             if (c.GetMatrixType() == MatrixType::DENSE)
             {
@@ -4066,8 +5008,11 @@ void Matrix<ElemType>::MultiplyAndWeightedAdd(ElemType alpha, const Matrix<ElemT
         }
         else if (a.m_matrixType == MatrixType::SPARSE && b.m_matrixType == c.m_matrixType && b.m_matrixType == MatrixType::DENSE) // Sparse*Dense+Dense
         {
-            GPUMatrix<ElemType> second = transposeB ? b.m_GPUMatrix->Transpose() : *b.m_GPUMatrix;
-            GPUSparseMatrix<ElemType>::MultiplyAndWeightedAdd(alpha, *a.m_GPUSparseMatrix, transposeA, second, false, beta, *c.m_GPUMatrix);
+            // (only a transposed b is copied)
+            if (transposeB)
+                GPUSparseMatrix<ElemType>::MultiplyAndWeightedAdd(alpha, *a.m_GPUSparseMatrix, transposeA, b.m_GPUMatrix->Transpose(), false, beta, *c.m_GPUMatrix);
+            else
+                GPUSparseMatrix<ElemType>::MultiplyAndWeightedAdd(alpha, *a.m_GPUSparseMatrix, transposeA, *b.m_GPUMatrix, false, beta, *c.m_GPUMatrix);
             c.SetDataLocation(GPU, DENSE);
         }
         else if (a.m_matrixType == MatrixType::DENSE && b.m_matrixType == MatrixType::SPARSE && c.m_matrixType == MatrixType::DENSE) // Dense*Sparse + Dense
@@ -4132,6 +5077,26 @@ void Matrix<ElemType>::MultiplyAndWeightedAdd(ElemType alpha, const Matrix<ElemT
     }
 }
 
+/// <summary>Batch of matrix-matrix multiplies of the same shape: c[i] = alpha * op(a[i]) * op(b[i]) + beta*c[i] for i = 0..numBatches-1</summary>
+/// Each of a, b, c holds its matrices side by side, i.e. [i] is the i-th slice of GetNumCols()/numBatches columns
+/// (e.g. per head or per sequence). Dense matrices only.
+template <class ElemType>
+/*static*/ void Matrix<ElemType>::BatchedMultiplyAndWeightedAdd(ElemType alpha, const Matrix<ElemType>& a, const bool transposeA, const Matrix<ElemType>& b, const bool transposeB,
+                                                                ElemType beta, Matrix<ElemType>& c, size_t numBatches)
+{
+    DecideAndMoveToRightDevice(a, b, c);
+    if (a.GetMatrixType() != MatrixType::DENSE || b.GetMatrixType() != MatrixType::DENSE)
+        NOT_IMPLEMENTED;
+    c.SwitchToMatrixType(MatrixType::DENSE, matrixFormatDense, false);
+
+    DISPATCH_MATRIX_ON_FLAG(&c,
+                            &c,
+                            CPUMatrix<ElemType>::BatchedMultiplyAndWeightedAdd(alpha, *a.m_CPUMatrix, transposeA, *b.m_CPUMatrix, transposeB, beta, *c.m_CPUMatrix, numBatches),
+                            GPUMatrix<ElemType>::BatchedMultiplyAndWeightedAdd(alpha, *a.m_GPUMatrix, transposeA, *b.m_GPUMatrix, transposeB, beta, *c.m_GPUMatrix, numBatches),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+}
+
 template <class ElemType>
 /*static*/ void Matrix<ElemType>::Multiply1x1AndWeightedAdd(ElemType alpha, const Matrix<ElemType>& a, const Matrix<ElemType>& b, ElemType beta, Matrix<ElemType>& c)
 {
@@ -4208,6 +5173,138 @@ void Matrix<ElemType>::ConvolveAndWeightedAdd(ElemType alpha, const Matrix<ElemT
     }
 }
 
+/// <summary>Dense layer: c = activation(op(a) * b + bias), with bias added to each column</summary>
+/// <param name="a">Input matrix (weights)</param>
+/// <param name="transposeA">Whether matrix a is transposed</param>
+/// <param name="b">Input matrix</param>
+/// <param name="bias">Column vector with as many elements as op(a) has rows</param>
+/// <param name="activation">opLinearRectifier, opSigmoid or opTanh</param>
+/// <param name="c">Resulting matrix</param>
+/// On the CPU, bias and activation are applied to blocks of the product while they are in the cache.
+/// On the GPU, they are applied in a single elementwise pass after the GEMM.
+template <class ElemType>
+/*static*/ void Matrix<ElemType>::MultiplyAndAddBiasActivation(const Matrix<ElemType>& a, const bool transposeA, const Matrix<ElemType>& b, const Matrix<ElemType>& bias,
+                                                               ElementWiseOperator activation, Matrix<ElemType>& c)
+{
+    DecideAndMoveToRightDevice(a, b, c);
+    bias._transferToDevice(c.GetDeviceId());
+
+    if (c.GetDeviceId() < 0 && a.GetMatrixType() == MatrixType::DENSE && b.GetMatrixType() == MatrixType::DENSE && bias.GetMatrixType() == MatrixType::DENSE)
+    {
+        c.SwitchToMatrixType(MatrixType::DENSE, matrixFormatDense, false);
+        CPUMatrix<ElemType>::MultiplyAndAddBiasActivation(*a.m_CPUMatrix, transposeA, *b.m_CPUMatrix, *bias.m_CPUMatrix, activation, *c.m_CPUMatrix);
+        c.SetDataLocation(CPU, DENSE);
+    }
+    else
+    {
+        MultiplyAndWeightedAdd(1, a, transposeA, b, false, 0, c);
+        c.AddBiasActivation(bias, activation);
+    }
+}
+
+template <class ElemType>
+void Matrix<ElemType>::AddBiasActivation(const Matrix<ElemType>& bias, ElementWiseOperator activation)
+{
+    if (GetMatrixType() != DENSE || bias.GetMatrixType() != DENSE)
+        NOT_IMPLEMENTED;
+    if (bias.GetNumElements() != GetNumRows())
+        InvalidArgument("AddBiasActivation: The bias has %d elements, but the matrix has %d rows.", (int) bias.GetNumElements(), (int) GetNumRows());
+    if (activation != ElementWiseOperator::opLinearRectifier && activation != ElementWiseOperator::opSigmoid && activation != ElementWiseOperator::opTanh)
+        InvalidArgument("AddBiasActivation: Activation %d is not supported, only opLinearRectifier, opSigmoid and opTanh.", (int) activation);
+
+    DecideAndMoveToRightDevice(*this, bias);
+
+    if (GetDeviceId() < 0)
+    {
+        m_CPUMatrix->AddBiasActivation(*bias.m_CPUMatrix, activation);
+        return;
+    }
+
+    // one elementwise program over [rows x cols] with the bias broadcast along the columns
+    ElementWiseProgram program;
+    program.Clear();
+    program.m_numInputs = 2;
+    const int sumArgs[2] = {0, 1};
+    const int sum = program.Append(ElementWiseOperator::opSum, 2, sumArgs);
+    program.Append(activation, 1, &sum);
+
+    SmallVector<size_t> dims;
+    dims.push_back(GetNumRows());
+    dims.push_back(GetNumCols());
+    SmallVector<ptrdiff_t> denseStrides, biasStrides;
+    denseStrides.push_back(1);
+    denseStrides.push_back((ptrdiff_t) GetNumRows());
+    biasStrides.push_back(1);
+    biasStrides.push_back(0);
+    const array<SmallVector<ptrdiff_t>, 5> strides = {denseStrides, biasStrides, denseStrides, denseStrides, denseStrides}; // (the last two inputs are unused)
+    TensorOp(0, *this, bias, *this, *this, 1, program, array<size_t, 5>{{0, 0, 0, 0, 0}}, dims, strides);
+}
+
+/// <summary>Gradient of MultiplyAndAddBiasActivation() w.r.t. the product and the bias, computed from its output</summary>
+/// <param name="outputGradient">Gradient of the output c</param>
+/// <param name="output">The output c</param>
+/// <param name="activation">Activation that was applied</param>
+/// <param name="productBeta">Scalar for the existing product gradient</param>
+/// <param name="productGradient">Gradient of op(a) * b, receives outputGradient .* activation'</param>
+/// <param name="biasBeta">Scalar for the existing bias gradient</param>
+/// <param name="biasGradient">Gradient of the bias, receives the row sums of the product gradient</param>
+/// On the CPU, both are computed in one pass. On the GPU, they are two elementwise kernels that read the same inputs.
+template <class ElemType>
+/*static*/ void Matrix<ElemType>::BackpropBiasActivation(const Matrix<ElemType>& outputGradient, const Matrix<ElemType>& output, ElementWiseOperator activation,
+                                                         ElemType productBeta, Matrix<ElemType>& productGradient, ElemType biasBeta, Matrix<ElemType>& biasGradient)
+{
+    if (outputGradient.GetMatrixType() != DENSE || output.GetMatrixType() != DENSE || productGradient.GetMatrixType() != DENSE || biasGradient.GetMatrixType() != DENSE)
+        NOT_IMPLEMENTED;
+    DecideAndMoveToRightDevice(outputGradient, output, productGradient, biasGradient);
+
+    if (output.GetDeviceId() < 0)
+    {
+        CPUMatrix<ElemType>::BackpropBiasActivation(*outputGradient.m_CPUMatrix, *output.m_CPUMatrix, activation, productBeta, *productGradient.m_CPUMatrix, biasBeta, *biasGradient.m_CPUMatrix);
+        return;
+    }
+
+    ElementWiseOperator derivativeOp;
+    switch (activation)
+    {
+    case ElementWiseOperator::opLinearRectifier: derivativeOp = ElementWiseOperator::opElementwiseProductWithLinearRectifierDerivativeFromOutput; break;
+    case ElementWiseOperator::opSigmoid:         derivativeOp = ElementWiseOperator::opElementwiseProductWithSigmoidDerivativeFromOutput; break;
+    case ElementWiseOperator::opTanh:            derivativeOp = ElementWiseOperator::opElementwiseProductWithTanhDerivativeFromOutput; break;
+    default:
+        InvalidArgument("BackpropBiasActivation: Activation %d is not supported, only opLinearRectifier, opSigmoid and opTanh.", (int) activation);
+    }
+
+    const size_t rows = output.GetNumRows(), cols = output.GetNumCols();
+    if (productBeta == 0)
+        productGradient.Resize(rows, cols);
+    if (biasBeta == 0)
+        biasGradient.Resize(rows, 1);
+    if (outputGradient.GetNumRows() != rows || outputGradient.GetNumCols() != cols || productGradient.GetNumRows() != rows || productGradient.GetNumCols() != cols)
+        InvalidArgument("BackpropBiasActivation: The gradients have a different size than the output.");
+    if (biasGradient.GetNumElements() != rows)
+        InvalidArgument("BackpropBiasActivation: The bias gradient has %d elements, but the output has %d rows.", (int) biasGradient.GetNumElements(), (int) rows);
+
+    SmallVector<size_t> dims, rowDims, colDims, noDims;
+    dims.push_back(rows);
+    dims.push_back(cols);
+    rowDims.push_back(rows);
+    colDims.push_back(cols);
+    SmallVector<ptrdiff_t> denseStrides, rowStrides, colStrides, biasColStrides, noStrides;
+    denseStrides.push_back(1);
+    denseStrides.push_back((ptrdiff_t) rows);
+    rowStrides.push_back(1);
+    colStrides.push_back((ptrdiff_t) rows);
+    biasColStrides.push_back(0);
+
+    // productGradient = productBeta * productGradient + outputGradient .* activation'
+    productGradient.TensorOp(productBeta, outputGradient, output, 1, derivativeOp, array<size_t, 3>{{0, 0, 0}},
+                             dims, array<SmallVector<ptrdiff_t>, 3>{{denseStrides, denseStrides, denseStrides}},
+                             noDims, array<SmallVector<ptrdiff_t>, 3>{{noStrides, noStrides, noStrides}});
+    // biasGradient = biasBeta * biasGradient + the same, summed over the columns (recomputed rather than read back, since productBeta may be nonzero)
+    biasGradient.TensorOp(biasBeta, outputGradient, output, 1, derivativeOp, array<size_t, 3>{{0, 0, 0}},
+                          rowDims, array<SmallVector<ptrdiff_t>, 3>{{rowStrides, rowStrides, rowStrides}},
+                          colDims, array<SmallVector<ptrdiff_t>, 3>{{colStrides, colStrides, biasColStrides}});
+}
+
 /// <summary>Matrix-scalar multiply with col-major matrices: c = alpha * a + c</summary>
 /// if a is a column vector, add to all columns of c
 /// if a is a row vector, add to all rows of c
@@ -4835,6 +5932,76 @@ void Matrix<ElemType>::InnerProductWithShiftNeg(const Matrix<ElemType>& a, const
                             NOT_IMPLEMENTED);
 }
 
+template <class ElemType>
+Matrix<ElemType>& Matrix<ElemType>::AssignCosDistanceWithShiftNegOf(const Matrix<ElemType>& a, const Matrix<ElemType>& b, size_t shift, size_t negNumber,
+                                                                    Matrix<ElemType>& invNormA, Matrix<ElemType>& invNormB)
+{
+    if (a.IsEmpty() || b.IsEmpty())
+        LogicError("AssignCosDistanceWithShiftNegOf: One of the input matrices is empty.");
+
+    DecideAndMoveToRightDevice(a, b, *this);
+    invNormA._transferToDevice(a.GetDeviceId());
+    invNormB._transferToDevice(a.GetDeviceId());
+    if (a.GetMatrixType() != MatrixType::DENSE || b.GetMatrixType() != MatrixType::DENSE)
+        NOT_IMPLEMENTED;
+    SwitchToMatrixType(MatrixType::DENSE, matrixFormatDense, false);
+    invNormA.SwitchToMatrixType(MatrixType::DENSE, matrixFormatDense, false);
+    invNormB.SwitchToMatrixType(MatrixType::DENSE, matrixFormatDense, false);
+
+    DISPATCH_MATRIX_ON_FLAG(&a,
+                            this,
+                            m_CPUMatrix->AssignCosDistanceWithShiftNegOf(*a.m_CPUMatrix, *b.m_CPUMatrix, shift, negNumber, *invNormA.m_CPUMatrix, *invNormB.m_CPUMatrix),
+                            m_GPUMatrix->AssignCosDistanceWithShiftNegOf(*a.m_GPUMatrix, *b.m_GPUMatrix, shift, negNumber, *invNormA.m_GPUMatrix, *invNormB.m_GPUMatrix),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+
+    return *this;
+}
+
+template <class ElemType>
+Matrix<ElemType>& Matrix<ElemType>::AddCosDistanceWithShiftNegGradientOf(const Matrix<ElemType>& gradient, const Matrix<ElemType>& value,
+                                                                         const Matrix<ElemType>& a, const Matrix<ElemType>& b,
+                                                                         const Matrix<ElemType>& invNormA, const Matrix<ElemType>& invNormB, size_t shift, bool rightInput)
+{
+    DecideAndMoveToRightDevice(gradient, value, a, b);
+    DecideAndMoveToRightDevice(a, invNormA, invNormB, *this);
+    if (GetMatrixType() != MatrixType::DENSE || a.GetMatrixType() != MatrixType::DENSE || b.GetMatrixType() != MatrixType::DENSE)
+        NOT_IMPLEMENTED;
+
+    DISPATCH_MATRIX_ON_FLAG(&a,
+                            this,
+                            m_CPUMatrix->AddCosDistanceWithShiftNegGradientOf(*gradient.m_CPUMatrix, *value.m_CPUMatrix, *a.m_CPUMatrix, *b.m_CPUMatrix,
+                                                                              *invNormA.m_CPUMatrix, *invNormB.m_CPUMatrix, shift, rightInput),
+                            m_GPUMatrix->AddCosDistanceWithShiftNegGradientOf(*gradient.m_GPUMatrix, *value.m_GPUMatrix, *a.m_GPUMatrix, *b.m_GPUMatrix,
+                                                                              *invNormA.m_GPUMatrix, *invNormB.m_GPUMatrix, shift, rightInput),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+
+    return *this;
+}
+
+template <class ElemType>
+Matrix<ElemType>& Matrix<ElemType>::AssignAugmentedImagesOf(const Matrix<ElemType>& staged, const Matrix<ElemType>& mean, size_t stagingWidth, size_t stagingHeight,
+                                                            size_t channels, size_t width, size_t height, bool transposeToCHW)
+{
+    if (staged.IsEmpty())
+        LogicError("AssignAugmentedImagesOf: The staged images are empty.");
+
+    DecideAndMoveToRightDevice(staged, mean, *this);
+    if (staged.GetMatrixType() != MatrixType::DENSE || mean.GetMatrixType() != MatrixType::DENSE)
+        NOT_IMPLEMENTED;
+    SwitchToMatrixType(MatrixType::DENSE, matrixFormatDense, false);
+
+    DISPATCH_MATRIX_ON_FLAG(&staged,
+                            this,
+                            m_CPUMatrix->AssignAugmentedImagesOf(*staged.m_CPUMatrix, *mean.m_CPUMatrix, stagingWidth, stagingHeight, channels, width, height, transposeToCHW),
+                            m_GPUMatrix->AssignAugmentedImagesOf(*staged.m_GPUMatrix, *mean.m_GPUMatrix, stagingWidth, stagingHeight, channels, width, height, transposeToCHW),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+
+    return *this;
+}
+
 template <class ElemType>
 Matrix<ElemType>& Matrix<ElemType>::GetARowByIndex(const Matrix<ElemType>& a, size_t index)
 {
@@ -4964,6 +6131,29 @@ void Matrix<ElemType>::RCRFTransGrdCompute(const Matrix<ElemType>& lbls,
                             NOT_IMPLEMENTED);
 }
 
+template <class ElemType>
+Matrix<ElemType>& Matrix<ElemType>::AssignCTCPosteriors(const Matrix<ElemType>& logProbs, const Matrix<ElemType>& stateLabels, const Matrix<ElemType>& sequences,
+                                                        size_t numParallelSequences, Matrix<ElemType>& alpha, Matrix<ElemType>& beta, Matrix<ElemType>& logLikelihoods)
+{
+    DecideAndMoveToRightDevice(logProbs, stateLabels, sequences, *this);
+    alpha._transferToDevice(logProbs.GetDeviceId());
+    beta._transferToDevice(logProbs.GetDeviceId());
+    logLikelihoods._transferToDevice(logProbs.GetDeviceId());
+
+    if (logProbs.GetMatrixType() != MatrixType::DENSE || stateLabels.GetMatrixType() != MatrixType::DENSE || sequences.GetMatrixType() != MatrixType::DENSE)
+        NOT_IMPLEMENTED;
+
+    DISPATCH_MATRIX_ON_FLAG(&logProbs,
+                            this,
+                            m_CPUMatrix->AssignCTCPosteriors(*logProbs.m_CPUMatrix, *stateLabels.m_CPUMatrix, *sequences.m_CPUMatrix, numParallelSequences,
+                                                             *alpha.m_CPUMatrix, *beta.m_CPUMatrix, *logLikelihoods.m_CPUMatrix),
+                            m_GPUMatrix->AssignCTCPosteriors(*logProbs.m_GPUMatrix, *stateLabels.m_GPUMatrix, *sequences.m_GPUMatrix, numParallelSequences,
+                                                             *alpha.m_GPUMatrix, *beta.m_GPUMatrix, *logLikelihoods.m_GPUMatrix),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+    return *this;
+}
+
 template <class ElemType>
 Matrix<ElemType>& Matrix<ElemType>::DropFrame(const Matrix<ElemType>& label, const Matrix<ElemType>& gamma, const ElemType& threshhold)
 {
@@ -5073,6 +6263,24 @@ void Matrix<ElemType>::TensorOp(ElemType beta, const Matrix<ElemType>& a, const
                             NOT_IMPLEMENTED);
 }
 
+template <class ElemType>
+void Matrix<ElemType>::TensorOp(ElemType beta, const Matrix<ElemType>& a, const Matrix<ElemType>& b, const Matrix<ElemType>& c, const Matrix<ElemType>& d, ElemType alpha, const ElementWiseProgram& program,
+                                const array<size_t, 5>& offsets,
+                                const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, 5>& regularStrides)
+{
+    VerifyIsDense(*this) && VerifyIsDense(a) && VerifyIsDense(b) && VerifyIsDense(c) && VerifyIsDense(d);
+
+    DecideAndMoveToRightDevice(*this, a, b, c);
+    d._transferToDevice(GetDeviceId());
+
+    DISPATCH_MATRIX_ON_FLAG(this,
+                            this,
+                            m_CPUMatrix->TensorOp(beta, *a.m_CPUMatrix, *b.m_CPUMatrix, *c.m_CPUMatrix, *d.m_CPUMatrix, alpha, program, offsets, regularOpDims, regularStrides),
+                            m_GPUMatrix->TensorOp(beta, *a.m_GPUMatrix, *b.m_GPUMatrix, *c.m_GPUMatrix, *d.m_GPUMatrix, alpha, program, offsets, regularOpDims, regularStrides),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+}
+
 template class Matrix<float>;
 template class Matrix<double>;
 
@@ -175,6 +175,12 @@ public:
 
     void CopyColumnsStrided(const Matrix<ElemType>& fromMatrix, size_t numCols, size_t srcNumColsStride, size_t destNumColsStride);
 
+    // column gather and scatter with a [1 x N] index of columns; a negative index is a column without a source or a target
+    //  - gather: this(:,j) = beta * this(:,j) + alpha * a(:,idx(j)), this being [a.rows x N]
+    //  - scatter: this(:,idx(j)) = beta * this(:,idx(j)) + alpha * a(:,j), for a [rows x N]; the indices must not repeat
+    Matrix<ElemType>& DoGatherColumnsOf(ElemType beta, const Matrix<ElemType>& idx, const Matrix<ElemType>& a, ElemType alpha);
+    Matrix<ElemType>& DoScatterColumnsOf(ElemType beta, const Matrix<ElemType>& idx, const Matrix<ElemType>& a, ElemType alpha);
+
     Matrix<ElemType> Diagonal() const;
     Matrix<ElemType> AssignDiagonalValuesTo(Matrix<ElemType>& diag) const;
     void ShiftBy(int numShift);
@@ -183,6 +189,24 @@ public:
     void NormalGrad(Matrix<ElemType>& gradients, Matrix<ElemType>& functionValues, const ElemType learnRatePerSample, const ElemType momentum, const bool useNAG);
     ElemType Adagrad(Matrix<ElemType>& gradients, const bool needAveMultiplier);
     void FSAdagrad(size_t mbSize, Matrix<ElemType>& gradients, Matrix<ElemType>& functionValues, const ElemType learnRatePerSample, const ElemType momentum);
+    // Adam with bias correction; 'step' counts from 1. This matrix holds the first moments, followed by the second moments.
+    void Adam(size_t step, Matrix<ElemType>& gradients, Matrix<ElemType>& functionValues, const ElemType learnRate, const ElemType beta1, const ElemType beta2, const ElemType epsilon);
+    // the same, but the gradients are replaced by the update direction instead of updating the values (for LAMB)
+    void AdamDirection(size_t step, Matrix<ElemType>& gradients, const ElemType beta1, const ElemType beta2, const ElemType epsilon);
+    // Momentum SGD and AdaGrad for block-sparse gradients that only touch the columns present in the gradients, e.g. of an
+    // embedding. This matrix has one more row than the parameter, which holds the step of the last update of each column;
+    // 'step' counts from 1. A column first gets the updates it missed since then, which only consist of the L2 term, so the
+    // result equals an update of all columns in every step, as long as the hyperparameters do not change in between.
+    // With 'needAveMultiplier', LazyAdagrad() divides the learning rate by the average multiplier of the present elements,
+    // like SGD does for Adagrad().
+    void LazyNormalGrad(size_t step, Matrix<ElemType>& gradients, Matrix<ElemType>& functionValues, const ElemType learnRatePerSample, const ElemType momentum, const ElemType l2Weight);
+    void LazyAdagrad(size_t step, Matrix<ElemType>& gradients, Matrix<ElemType>& functionValues, const ElemType learnRatePerSample, const ElemType l2Weight, const bool needAveMultiplier);
+    // momentum SGD or FSAdaGrad for several dense parameters of one device at once, see FusedSGDBatch (CommonMatrix.h)
+    // 'options' gives the scalars except m_adaWeight; the tensors are those of values[i], gradients[i], smoothedGradients[i].
+    // If options.m_maxGradientNorm is finite, 'gradientSquaredNorm' receives the squared global norm of the gradients (1 x 1).
+    static void FusedSGDUpdate(const FusedSGDBatch<ElemType>& options, size_t mbSize,
+                               const std::vector<Matrix<ElemType>*>& values, const std::vector<const Matrix<ElemType>*>& gradients, const std::vector<Matrix<ElemType>*>& smoothedGradients,
+                               const std::vector<double>& learnRatesPerSample, double L1RegWeight, Matrix<ElemType>* gradientSquaredNorm = nullptr);
     ElemType RmsProp(Matrix<ElemType>& gradients, ElemType RMS_GAMMA, ElemType RMS_WGT_INC, ElemType RMS_WGT_MAX, ElemType RMS_WGT_DEC, ElemType RMS_WGT_MIN, const bool needAveMultiplier);
 
     void Resize(const size_t numRows, const size_t numCols, const size_t numNZElemToReserve = 10000, bool growOnly = true); // by default we only reallocate if need to grow
@@ -223,10 +247,14 @@ public:
     ElemType& operator()(const size_t row, const size_t col);
     ElemType GetValue(const size_t row, const size_t col) const { return operator()(row, col); } // use this for reading on non-const objects to avoid inefficiency
     ElemType Get00Element() const;
+    // copies the first numElements elements of a dense matrix, in column-major order, to host memory, without waiting
+    // for the GPU: the copy is issued on the current stream, and dst (page-locked) must not be read before it completed
+    void CopyToHostAsync(ElemType* dst, size_t numElements) const;
 
     void SetValue(const ElemType v);
     void SetValue(const DeviceBoundNumber<ElemType>& db_number);
     void SetValue(const Matrix<ElemType>& deepCopyFrom, const MatrixFormat format = matrixFormatSparseCSR); // BUGBUG: default for 'format' is unexpected
+    void SetValueFromOtherDevice(const Matrix<ElemType>& deepCopyFrom); // deep copy onto the device of this matrix, neither matrix is moved
     void SetValue(const size_t numRows, const size_t numCols, int deviceId, ElemType* pArray, const size_t matrixFlags = matrixFlagNormal);
     void SetValue(const size_t rIdx, const size_t cIdx, ElemType val); // set matrix sparsely
     void SetValue(const size_t numRows, const size_t numCols, std::initializer_list<ElemType> l)
@@ -242,6 +270,12 @@ public:
     }
     void SetMatrixFromCSCFormat(const CPUSPARSE_INDEX_TYPE* h_CSCCol, const CPUSPARSE_INDEX_TYPE* h_Row, const ElemType* h_Val,
                                 const size_t nz, const size_t numRows, const size_t numCols);
+    // the same from the number of values of each column; the column offsets are computed where the matrix is (see SparseStagingBuffer)
+    void SetMatrixFromCSCColumnCounts(const CPUSPARSE_INDEX_TYPE* h_colCounts, const CPUSPARSE_INDEX_TYPE* h_Row, const ElemType* h_Val,
+                                      const size_t nz, const size_t numRows, const size_t numCols);
+    // sparse block column matrices (e.g. the gradients of embeddings): the ids of the columns that have values, and their values column by column
+    void SetMatrixFromBlockColFormat(const size_t* h_ColIds, const ElemType* h_Val, const size_t numBlocks, const size_t numRows, const size_t numCols);
+    void GetMatrixFromBlockColFormat(std::vector<size_t>& colIds, std::vector<ElemType>& values) const;
 
     void MaskColumnsValue(const Matrix<char>& columnsMask, ElemType val);
 
@@ -254,6 +288,8 @@ public:
     void SetUniformRandomValue(const ElemType low, const ElemType high, unsigned long seed = USE_TIME_BASED_SEED);
     void SetGaussianRandomValue(const ElemType mean, const ElemType sigma, unsigned long seed = USE_TIME_BASED_SEED);
     void SetUniformRandomMask(const ElemType maskRate, const ElemType scaleValue, unsigned long seed = USE_TIME_BASED_SEED);
+    // [this] = beta * [this] + a .* mask, with a dropout mask drawn from a counter-based generator, see PhiloxRandom.h
+    Matrix<ElemType>& ScaleAndAddDropoutOf(const ElemType beta, const Matrix<ElemType>& a, const ElemType maskRate, const ElemType scaleValue, unsigned long seed, size_t counterOffset);
     void AddGaussianRandomValue(const ElemType mean, const ElemType sigma, unsigned long seed = USE_TIME_BASED_SEED);
     Matrix<ElemType>& AssignNoiseContrastiveEstimation(const Matrix<ElemType>& a, const Matrix<ElemType>& b, const Matrix<ElemType>& c, const Matrix<ElemType>& bias, Matrix<ElemType>& tmp);
 
@@ -261,6 +297,71 @@ public:
     Matrix<ElemType>& AssignSoftmaxSum(const Matrix<ElemType>& a, const Matrix<ElemType>& softmax);
     Matrix<ElemType>& AssignNceUnnormalizedEval(const Matrix<ElemType>& a, const Matrix<ElemType>& b, const Matrix<ElemType>& c, const Matrix<ElemType>& bias);
 
+    // sampled softmax
+    // replaces uniform random values in [0, 1) by class ids drawn from the cumulative distribution 'cdf' of the classes
+    Matrix<ElemType>& InplaceSampleFromCDF(const Matrix<ElemType>& cdf);
+    // sparse CSC [numRows x N] with a 1 in each column j, in row ids[j], for the N elements of 'ids'
+    void AssignOneHotColumnsOf(const Matrix<ElemType>& ids, const size_t numRows);
+    // [(S+1) x T] logits of the true class (row 0) and of the S shared samples (rows 1..S), with the log expected counts
+    // already subtracted in 'candidateBiases'. The candidates are the S samples followed by the T labels, 'candidateIds'
+    // and 'candidateBiases' are [1 x (S+T)]; trueLogits is [1 x T], sampledLogits [S x T]. Samples that hit the label
+    // of their column are masked with a large negative logit.
+    Matrix<ElemType>& AssignSampledSoftmaxLogits(const Matrix<ElemType>& trueLogits, const Matrix<ElemType>& sampledLogits,
+                                                 const Matrix<ElemType>& candidateBiases, const Matrix<ElemType>& candidateIds);
+
+    // noise contrastive estimation with the noise drawn on the device
+    // this [1 x N] = class ids drawn with the alias method from the [2 x N] 'uniforms' in [0, 1): the first row picks the bucket k of the
+    // V classes, the second keeps k if it is below aliasProbs[k] and takes aliases[k] otherwise. 'aliasProbs' and 'aliases' are [1 x V].
+    Matrix<ElemType>& AssignAliasSamplesOf(const Matrix<ElemType>& uniforms, const Matrix<ElemType>& aliasProbs, const Matrix<ElemType>& aliases);
+    // this [1 x T] = NCE loss of each frame, softplus(-s(0,t)) + sum_j softplus(s(j,t)), for the scores s [(K+1) x T] of the label (row 0) and of the
+    // K noise samples shared by all frames (rows 1..K): s(j,t) = hidden(:,t)^T weights(:,w) + bias(w) - logNoiseCounts(w) of their word w, with the
+    // columns of 'weights' [D x V] gathered by the ids. 'labelIds' is [1 x T], 'noiseIds' [1 x K], 'bias' and 'logNoiseCounts' (the log of K times the
+    // noise probability) [1 x V]. 'scoreGradients' [(K+1) x T] receives the derivatives of the loss w.r.t. the scores, sigmoid(s) - 1 for the label
+    // and sigmoid(s) for the noise.
+    Matrix<ElemType>& AssignNCELossOf(const Matrix<ElemType>& labelIds, const Matrix<ElemType>& noiseIds, const Matrix<ElemType>& hidden, const Matrix<ElemType>& weights,
+                                      const Matrix<ElemType>& bias, const Matrix<ElemType>& logNoiseCounts, Matrix<ElemType>& scoreGradients);
+    // this [D x T] += sum_j scoreGradients(j,t) weights(:,w) over the label and the noise words w of frame t, the gradient w.r.t. the hidden input of the above
+    Matrix<ElemType>& AddNCEHiddenGradientOf(const Matrix<ElemType>& scoreGradients, const Matrix<ElemType>& labelIds, const Matrix<ElemType>& noiseIds, const Matrix<ElemType>& weights);
+
+    // Gaussian mixture with one shared stddev per component, K components over D-dim features, T samples
+    // [1 x T] log-likelihood log sum_c prior_c N(x | mean_c, stddev_c^2 I) of each sample, evaluated with log-sum-exp
+    // in a single pass that also yields the [K x T] 'posterior', the [K x T] 'normedDeviation' ||x-mean_c||^2/stddev_c^2 and
+    // the [KD x T] 'normedDeviationVectors' (x-mean_c)/stddev_c^2 for the gradient. 'logPrior' [K], 'mean' [KD] and
+    // 'logStddev' [K] have either one column shared by all samples or T columns; 'feature' is [D x T].
+    Matrix<ElemType>& AssignGMMLogLikelihoodOf(const Matrix<ElemType>& logPrior, const Matrix<ElemType>& mean, const Matrix<ElemType>& logStddev, const Matrix<ElemType>& feature,
+                                               Matrix<ElemType>& posterior, Matrix<ElemType>& normedDeviation, Matrix<ElemType>& normedDeviationVectors);
+    // this += gradient of the log-likelihood w.r.t. input 'inputIndex' (0=unnormed prior, 1=mean, 2=logStddev, 3=feature) scaled by the [1 x T] 'gradient',
+    // from the statistics kept by AssignGMMLogLikelihoodOf(); a single-column 'this' receives the sum over all samples
+    Matrix<ElemType>& AddGMMLogLikelihoodGradient(const size_t inputIndex, const Matrix<ElemType>& gradient, const Matrix<ElemType>& logPrior,
+                                                  const Matrix<ElemType>& posterior, const Matrix<ElemType>& normedDeviation, const Matrix<ElemType>& normedDeviationVectors);
+
+    // softmax cross entropy of the columns of 'logits' [K x T] w.r.t. dense 'labels' [K x T] without materializing the softmax:
+    // this [1 x 1] = -sum_t sum_i labels(i,t) (logits(i,t) - logSumExp(t)), where 'logSumExp' [1 x T] receives log sum_i exp(logits(i,t)),
+    // found in one pass over each column with a running maximum. Zero labels do not contribute, so gap columns must have zero labels.
+    Matrix<ElemType>& AssignCrossEntropyWithSoftmaxOf(const Matrix<ElemType>& labels, const Matrix<ElemType>& logits, Matrix<ElemType>& logSumExp);
+    // this += gradient of the above, scaled by the [1 x 1] 'gradient', w.r.t. the labels (inputIndex 0) or the logits (inputIndex 1, i.e. softmax - labels)
+    Matrix<ElemType>& AddCrossEntropyWithSoftmaxGradient(const size_t inputIndex, const Matrix<ElemType>& gradient, const Matrix<ElemType>& labels,
+                                                         const Matrix<ElemType>& logits, const Matrix<ElemType>& logSumExp);
+
+    // Viterbi decoding of all sequences of a minibatch at once. 'posScores' [K x (T*S)] holds the label scores of frame t of parallel sequence s
+    // in column t*S+s, 'pairScores' [K x K] the transition scores (k, j) from label j to label k. 'sequences' [3 x N] lists (s, tBegin, tEnd) of each
+    // sequence. The first frame of a sequence is constrained to 'startLabel' and its last frame to 'endLabel', unless these are negative.
+    // 'this' receives the one-hot best path of each sequence (gaps are 0); 'alpha' and 'backtrace' [K x (T*S)] the best scores and backpointers.
+    Matrix<ElemType>& AssignViterbiPathOf(const Matrix<ElemType>& posScores, const Matrix<ElemType>& pairScores, const Matrix<ElemType>& sequences, const size_t numParallelSequences,
+                                          const int startLabel, const int endLabel, Matrix<ElemType>& alpha, Matrix<ElemType>& backtrace);
+
+    // class-based softmax cross entropy. 'labels' [4 x T] holds, per frame, the word id, its class id, and the first and the end word id of the class;
+    // the words of a class are the columns of 'weight' [D x V] in that range. The non-gap frames are processed grouped by class: 'frames' [1 x N] lists
+    // their columns sorted by class, and 'buckets' [4 x B] the (first word, end word, first entry, end entry into 'frames') of each class that occurs.
+    // The word logits input(:,t)^T weight(:,words of the class) of all classes are one grouped matrix product, each class bucket being one product.
+    // this [1 x 1] = -sum_t (log softmax(logits)(word) + classLogSoftmax(class, t)); 'softmax' [maxClassSize x T] receives the word posteriors.
+    Matrix<ElemType>& AssignClassBasedCrossEntropyWithSoftmaxOf(const Matrix<ElemType>& labels, const Matrix<ElemType>& input, const Matrix<ElemType>& weight, const Matrix<ElemType>& classLogSoftmax,
+                                                                const Matrix<ElemType>& buckets, const Matrix<ElemType>& frames, const size_t maxClassSize, Matrix<ElemType>& softmax);
+    // this += gradient of the above, scaled by the [1 x 1] 'gradient', w.r.t. the input (inputIndex 1), the weight (2), or the class logits (3)
+    Matrix<ElemType>& AddClassBasedCrossEntropyWithSoftmaxGradient(const size_t inputIndex, const Matrix<ElemType>& gradient, const Matrix<ElemType>& labels, const Matrix<ElemType>& input,
+                                                                   const Matrix<ElemType>& weight, const Matrix<ElemType>& classLogSoftmax, const Matrix<ElemType>& buckets,
+                                                                   const Matrix<ElemType>& frames, const Matrix<ElemType>& softmax);
+
     Matrix<ElemType> Transpose(); // This method doesn't change state of Matrix. It should be a const function
     Matrix<ElemType>& AssignTransposeOf(const Matrix<ElemType>& a);
 
@@ -327,6 +428,12 @@ public:
     Matrix<ElemType>& InplaceLogSoftmax(const bool isColWise);
     Matrix<ElemType>& AssignLogSoftmaxOf(const Matrix<ElemType>& a, const bool isColWise);
 
+    Matrix<ElemType>& InplaceSoftmax(const bool isColWise);
+    Matrix<ElemType>& AssignSoftmaxOf(const Matrix<ElemType>& a, const bool isColWise);
+    // column-wise softmax of scale * a over the first numValidRows(0,j) rows of each column j, the other rows being 0
+    // (e.g. attention weights over the keys of a sequence, with the keys padded to the longest sequence)
+    Matrix<ElemType>& AssignMaskedSoftmaxOf(const Matrix<ElemType>& a, ElemType scale, const Matrix<ElemType>& numValidRows);
+
     Matrix<ElemType>& InplaceHardmax(const bool isColWise);
     Matrix<ElemType>& AssignHardmaxOf(const Matrix<ElemType>& a, const bool isColWise);
 
@@ -411,6 +518,11 @@ public:
     ElemType MatrixNormInf() const;
     ElemType MatrixNorm1() const;
     ElemType MatrixNorm0() const; // number of non-zero elemets
+    // Stream-ordered variants of the above, and of IsEqualTo(): the 1x1 result stays on the device of a, so the host does
+    // not wait for it. Read it later, e.g. with DeviceScalarFuture, or use it in further matrix operations.
+    Matrix<ElemType>& AssignMatrixNormInfOf(const Matrix<ElemType>& a);
+    Matrix<ElemType>& AssignMatrixNorm1Of(const Matrix<ElemType>& a);
+    Matrix<ElemType>& AssignIsEqualTo(const Matrix<ElemType>& a, const Matrix<ElemType>& b, const ElemType threshold = 1e-8); // 1 if equal, else 0
     Matrix<ElemType>& AssignSignOf(const Matrix<ElemType>& a);
     Matrix<ElemType>& AddSignOf(const Matrix<ElemType>& a);
     void VectorMax(Matrix<ElemType>& maxIndexes, Matrix<ElemType>& maxValues, const bool isColWise) const;
@@ -418,6 +530,10 @@ public:
     void VectorMin(Matrix<ElemType>& minIndexes, Matrix<ElemType>& minValues, const bool isColWise) const;
 
     Matrix<ElemType>& AssignNumOfDiff(const Matrix<ElemType>& a, const Matrix<ElemType>& b, bool searchInCol = false);
+    // this [1 x 1] = number of columns whose label, the first maximum of the column of 'labels', is not among the 'topK' largest values of the
+    // same column of 'predictions'; ties rank by row index, so that with topK = 1 this counts the columns whose first maxima differ.
+    // Each column is read once and no index matrices are materialized. All-zero columns (gaps) are never errors.
+    Matrix<ElemType>& AssignNumOfTopKErrorsOf(const Matrix<ElemType>& labels, const Matrix<ElemType>& predictions, const size_t topK);
 
     Matrix<ElemType>& AssignInnerProductOfMatrices(const Matrix<ElemType>& a, const Matrix<ElemType>& b); // this method will resize(1,1) first
 
@@ -437,15 +553,42 @@ public:
                                              const size_t outputWidth, const size_t outputHeight, const size_t outputChannels,
                                              const size_t kernelWidth, const size_t kernelHeight, const size_t horizontalSubsample, const size_t verticalSubsample,
                                              const bool zeroPadding = false) const;
+    // convolution without unrolling the input, CPU only; same layouts and result as AssignPackedConvolutionInput() and Multiply()
+    Matrix<ElemType>& AssignConvolutionResult(const Matrix<ElemType>& inputBatch, const Matrix<ElemType>& filter,
+                                              const size_t inputWidth, const size_t inputHeight, const size_t inputChannels,
+                                              const size_t outputWidth, const size_t outputHeight, const size_t outputChannels,
+                                              const size_t kernelWidth, const size_t kernelHeight, const size_t horizontalSubsample, const size_t verticalSubsample,
+                                              const bool zeroPadding = false);
+    // grouped convolution, e.g. depthwise with groups == inputChannels, in the layouts of AssignConvolutionResult(): output channel k
+    // only sees the inputChannels / groups input channels of its group k / (outputChannels / groups), and the filter is
+    // [outputChannels x kernelWidth * kernelHeight * inputChannels / groups]. The gradients are added to this.
+    Matrix<ElemType>& AssignGroupedConvolutionResult(const Matrix<ElemType>& inputBatch, const Matrix<ElemType>& filter,
+                                                     const size_t inputWidth, const size_t inputHeight, const size_t inputChannels,
+                                                     const size_t outputWidth, const size_t outputHeight, const size_t outputChannels,
+                                                     const size_t kernelWidth, const size_t kernelHeight, const size_t horizontalSubsample, const size_t verticalSubsample,
+                                                     const bool zeroPadding, const size_t groups);
+    Matrix<ElemType>& AddGroupedConvolutionGradientOfInput(const Matrix<ElemType>& outputGradientBatch, const Matrix<ElemType>& filter,
+                                                           const size_t inputWidth, const size_t inputHeight, const size_t inputChannels,
+                                                           const size_t outputWidth, const size_t outputHeight, const size_t outputChannels,
+                                                           const size_t kernelWidth, const size_t kernelHeight, const size_t horizontalSubsample, const size_t verticalSubsample,
+                                                           const bool zeroPadding, const size_t groups);
+    Matrix<ElemType>& AddGroupedConvolutionGradientOfFilter(const Matrix<ElemType>& outputGradientBatch, const Matrix<ElemType>& inputBatch,
+                                                            const size_t inputWidth, const size_t inputHeight, const size_t inputChannels,
+                                                            const size_t outputWidth, const size_t outputHeight, const size_t outputChannels,
+                                                            const size_t kernelWidth, const size_t kernelHeight, const size_t horizontalSubsample, const size_t verticalSubsample,
+                                                            const bool zeroPadding, const size_t groups);
     Matrix<ElemType>& AssignMaxPoolingResult(const Matrix<ElemType>& inputBatch, const size_t channels,
                                              const size_t inputWidth, const size_t inputHeight, const size_t inputSizePerSample,
                                              const size_t outputWidth, const size_t outputHeight, const size_t outputSizePerSample,
-                                             const size_t windowWidth, const size_t windowHeight, const size_t horizontalSubsample, const size_t verticalSubsample);
+                                             const size_t windowWidth, const size_t windowHeight, const size_t horizontalSubsample, const size_t verticalSubsample,
+                                             std::vector<int>* argmax = nullptr); // argmax: CPU only, left empty on the GPU
     Matrix<ElemType>& AddMaxPoolingGradient(const Matrix<ElemType>& outputGradientBatch, const Matrix<ElemType>& inputBatch, const Matrix<ElemType>& outputBatch,
                                             const size_t channels,
                                             const size_t inputWidth, const size_t inputHeight, const size_t inputSizePerSample,
                                             const size_t outputWidth, const size_t outputHeight, const size_t outputSizePerSample,
                                             const size_t windowWidth, const size_t windowHeight, const size_t horizontalSubsample, const size_t verticalSubsample);
+    Matrix<ElemType>& AddMaxPoolingGradientAtArgmax(const Matrix<ElemType>& outputGradientBatch, const std::vector<int>& argmax,
+                                                    const size_t channels, const size_t inputSizePerSample, const size_t outputSizePerSample);
     Matrix<ElemType>& AssignAveragePoolingResult(const Matrix<ElemType>& inputBatch, const size_t channels,
                                                  const size_t inputWidth, const size_t inputHeight, const size_t inputSizePerSample,
                                                  const size_t outputWidth, const size_t outputHeight, const size_t outputSizePerSample,
@@ -473,8 +616,16 @@ public:
     static void Multiply(const Matrix<ElemType>& a, const bool transposeA, const Matrix<ElemType>& b, const bool transposeB, Matrix<ElemType>& c);
     static void Multiply(const Matrix<ElemType>& a, const Matrix<ElemType>& b, Matrix<ElemType>& c);
     static void Multiply1x1AndWeightedAdd(ElemType alpha, const Matrix<ElemType>& a, const Matrix<ElemType>& b, ElemType beta, Matrix<ElemType>& c);
+    static void BatchedMultiplyAndWeightedAdd(ElemType alpha, const Matrix<ElemType>& a, const bool transposeA, const Matrix<ElemType>& b, const bool transposeB, ElemType beta, Matrix<ElemType>& c, size_t numBatches); // strided-batched SGEMM
     static void ConvolveAndWeightedAdd(ElemType alpha, const Matrix<ElemType>& a, const bool transposeA, const Matrix<ElemType>& b, const bool transposeB, ElemType beta, Matrix<ElemType>& c, size_t numChannels, size_t horizontalSubsample, bool padding, bool channelwise);
 
+    // dense layer: c = activation(op(a) * b + bias), where bias is a column vector and activation is opLinearRectifier, opSigmoid or opTanh
+    static void MultiplyAndAddBiasActivation(const Matrix<ElemType>& a, const bool transposeA, const Matrix<ElemType>& b, const Matrix<ElemType>& bias, ElementWiseOperator activation, Matrix<ElemType>& c);
+    void AddBiasActivation(const Matrix<ElemType>& bias, ElementWiseOperator activation); // this = activation(this + bias), in place
+    // and its gradient: with g = outputGradient .* activation'(from output), productGradient = productBeta * productGradient + g and biasGradient = biasBeta * biasGradient + rowsum(g)
+    static void BackpropBiasActivation(const Matrix<ElemType>& outputGradient, const Matrix<ElemType>& output, ElementWiseOperator activation,
+                                       ElemType productBeta, Matrix<ElemType>& productGradient, ElemType biasBeta, Matrix<ElemType>& biasGradient);
+
     static void ScaleAndAdd(ElemType alpha, const Matrix<ElemType>& a, Matrix<ElemType>& c);
     static void ScaleAndAdd(ElemType alpha, const Matrix<ElemType>& a, ElemType beta, Matrix<ElemType>& c);
     static void AddScaledDifference(const ElemType alpha, const Matrix<ElemType>& a, const Matrix<ElemType>& b, Matrix<ElemType>& c);
@@ -511,6 +662,10 @@ public:
                   const std::array<size_t, 4>& offsets,
                   const SmallVector<size_t>& regularOpDims, const std::array<SmallVector<ptrdiff_t>, 4>& regularStrides,
                   const SmallVector<size_t>& reducingOpDims, const std::array<SmallVector<ptrdiff_t>, 4>& reducingStrides);
+    // fused sequence of elementwise ops over up to 4 inputs (unused inputs are passed as any valid matrix); no reduction
+    void TensorOp(ElemType beta, const Matrix<ElemType>& a, const Matrix<ElemType>& b, const Matrix<ElemType>& c, const Matrix<ElemType>& d, ElemType alpha, const ElementWiseProgram& program,
+                  const std::array<size_t, 5>& offsets,
+                  const SmallVector<size_t>& regularOpDims, const std::array<SmallVector<ptrdiff_t>, 5>& regularStrides);
 
 public:
     void Read(File& stream);
@@ -521,6 +676,15 @@ public:
     Matrix<ElemType>& AssignElementProductOfWithShiftNeg(const Matrix<ElemType>& a, const Matrix<ElemType>& b, size_t shift, size_t negnumber);
     Matrix<ElemType>& AssignInnerProductOfWithShiftNeg(const Matrix<ElemType>& a, const Matrix<ElemType>& b, const bool isColWise, size_t shift, size_t negnumber);
     static void InnerProductWithShiftNeg(const Matrix<ElemType>& a, const Matrix<ElemType>& b, Matrix<ElemType>& c, const bool isColWise, size_t shift, size_t negnumber);
+    // column-wise cosine distances of a with b and with negNumber shifted copies of b, fused with the inverse norms, and their gradient
+    Matrix<ElemType>& AssignCosDistanceWithShiftNegOf(const Matrix<ElemType>& a, const Matrix<ElemType>& b, size_t shift, size_t negNumber,
+                                                      Matrix<ElemType>& invNormA, Matrix<ElemType>& invNormB);
+    Matrix<ElemType>& AddCosDistanceWithShiftNegGradientOf(const Matrix<ElemType>& gradient, const Matrix<ElemType>& value,
+                                                           const Matrix<ElemType>& a, const Matrix<ElemType>& b,
+                                                           const Matrix<ElemType>& invNormA, const Matrix<ElemType>& invNormB, size_t shift, bool rightInput);
+    // crops, flips and bilinearly scales each column of staged images to width x height and subtracts the mean; see DeviceImageAugmentation in the readers
+    Matrix<ElemType>& AssignAugmentedImagesOf(const Matrix<ElemType>& staged, const Matrix<ElemType>& mean, size_t stagingWidth, size_t stagingHeight,
+                                              size_t channels, size_t width, size_t height, bool transposeToCHW);
     Matrix<ElemType>& GetARowByIndex(const Matrix<ElemType>& a, size_t index);
     static void ConductRowElementMultiplyWithShift(const Matrix<ElemType>& a, const Matrix<ElemType>& b, Matrix<ElemType>& c, size_t shift, bool bFirstmatrixfixed);
     Matrix<ElemType>& AssignElementProductOfWithShift(const Matrix<ElemType>& a, const Matrix<ElemType>& b, size_t shift);
@@ -538,6 +702,16 @@ public:
                                     const int startLbl, // the time 0 start symbol in the output layer
                                     const int shift);
 
+    // CTC forward-backward of the sequences of a minibatch, all sequences at once and in log space (see CTCWithSoftmaxNode):
+    //  - logProbs [P x T*S]: the log-softmax of the network output; column t * S + s is frame t of parallel sequence s
+    //  - stateLabels [maxStates x N]: column n holds the labels of the 2L+1 states of sequence n: blank, l_1, blank, ..., l_L, blank
+    //  - sequences [4 x N]: the parallel sequence, first frame, number of frames and number of states of each sequence
+    // Assigns the [P x T*S] label posteriors of each frame (0 outside the sequences), and log p(labels | input) of each sequence
+    // to 'logLikelihoods' [1 x N]. A sequence with too few frames for its labels gets 0, and the softmax as posteriors, so that
+    // it has no gradient. 'alpha' and 'beta' [maxStates x N*T] are workspaces.
+    Matrix<ElemType>& AssignCTCPosteriors(const Matrix<ElemType>& logProbs, const Matrix<ElemType>& stateLabels, const Matrix<ElemType>& sequences,
+                                          size_t numParallelSequences, Matrix<ElemType>& alpha, Matrix<ElemType>& beta, Matrix<ElemType>& logLikelihoods);
+
     template <typename T>
     friend class MatrixQuantizer;
 
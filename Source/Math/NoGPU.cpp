@@ -13,8 +13,12 @@
 #include "GPUSparseMatrix.h"
 #include "MatrixQuantizerGPU.h"
 #include "CuDnnConvolutionEngine.h"
+#include "CuDnnRNNEngine.h"
 #include "TensorShape.h"
 #include "GPUDataTransferer.h"
+#include "ComputeStreamPool.h"
+#include "ComputeEventTimer.h"
+#include "ComputeGraph.h"
 
 #pragma warning(disable : 4100) // unreferenced formal parameter, which is OK since all functions in here are dummies; disabling this allows to copy-paste prototypes here when we add new functions
 #pragma warning(disable : 4702) // unreachable code, which we get from the NOT_IMPLEMENTED macro which is OK
@@ -175,6 +179,12 @@ void GPUSparseMatrix<ElemType>::SetMatrixFromCSCFormat(const CPUSPARSE_INDEX_TYP
 {
 }
 
+template <class ElemType>
+void GPUSparseMatrix<ElemType>::SetMatrixFromCSCColumnCounts(const CPUSPARSE_INDEX_TYPE* h_colCounts, const CPUSPARSE_INDEX_TYPE* h_Row, const ElemType* h_Val,
+                                                             const size_t nz, const size_t numRows, const size_t numCols)
+{
+}
+
 // forward pass from feature to hidden layer
 template <class ElemType>
 void GPUSparseMatrix<ElemType>::MultiplyAndWeightedAdd(ElemType alpha, const GPUMatrix<ElemType>& lhs, const bool transposeA,
@@ -211,6 +221,14 @@ ElemType GPUSparseMatrix<ElemType>::Adagrad(GPUMatrix<ElemType>& c, const bool n
 {
     return 1;
 }
+template <class ElemType>
+void GPUSparseMatrix<ElemType>::LazyNormalGrad(size_t step, GPUMatrix<ElemType>& c, GPUMatrix<ElemType>& functionValues, const ElemType learnRatePerSample, const ElemType momentum, const ElemType l2Weight)
+{
+}
+template <class ElemType>
+void GPUSparseMatrix<ElemType>::LazyAdagrad(size_t step, GPUMatrix<ElemType>& c, GPUMatrix<ElemType>& functionValues, const ElemType learnRatePerSample, const ElemType l2Weight, const bool needAveMultiplier)
+{
+}
 //template<class ElemType>
 //void GPUSparseMatrix<ElemType>::FSAdagrad(CPUMatrix<ElemType>& gradients, CPUMatrix<ElemType>&, ElemType, ElemType, ElemType, ElemType) { }
 
@@ -639,6 +657,21 @@ void GPUSparseMatrix<ElemType>::GetMatrixFromCSCFormat(CPUSPARSE_INDEX_TYPE*& h_
 {
 }
 
+template <class ElemType>
+void GPUSparseMatrix<ElemType>::SetMatrixFromBlockColFormat(const size_t* h_ColIds, const ElemType* h_Val, const size_t numBlocks, const size_t numRows, const size_t numCols)
+{
+}
+
+template <class ElemType>
+void GPUSparseMatrix<ElemType>::GetMatrixFromBlockColFormat(std::vector<size_t>& colIds, std::vector<ElemType>& values) const
+{
+}
+
+template <class ElemType>
+void GPUSparseMatrix<ElemType>::AssignOneHotColumnsOf(const GPUMatrix<ElemType>& ids, const size_t numRows)
+{
+}
+
 template <class ElemType>
 void GPUSparseMatrix<ElemType>::ConvertToSparseFormat(MatrixFormat newFormat)
 {
@@ -949,11 +982,28 @@ template <class ElemType>
 void GPUMatrix<ElemType>::CopyColumnsStrided(const GPUMatrix<ElemType>& fromMatrix, size_t numCols, size_t srcNumColsStride, size_t destNumColsStride)
 {
 }
+
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::DoGatherColumnsOf(ElemType beta, const GPUMatrix<ElemType>& idx, const GPUMatrix<ElemType>& a, ElemType alpha)
+{
+    return *this;
+}
+
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::DoScatterColumnsOf(ElemType beta, const GPUMatrix<ElemType>& idx, const GPUMatrix<ElemType>& a, ElemType alpha)
+{
+    return *this;
+}
 template <class ElemType>
 void GPUMatrix<ElemType>::SetValue(const GPUMatrix<ElemType>& deepCopyFrom)
 {
 }
 
+template <class ElemType>
+void GPUMatrix<ElemType>::SetValueFromOtherDevice(const GPUMatrix<ElemType>& deepCopyFrom)
+{
+}
+
 template <class ElemType>
 void GPUMatrix<ElemType>::SetValue(const size_t numRows, const size_t numCols, int deviceId, ElemType* pArray, size_t matrixFlags)
 {
@@ -986,6 +1036,12 @@ void GPUMatrix<ElemType>::SetUniformRandomMask(const ElemType maskRate, const El
 {
 }
 
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::ScaleAndAddDropoutOf(const ElemType beta, const GPUMatrix<ElemType>& a, const ElemType maskRate, const ElemType scaleValue, unsigned long seed, size_t counterOffset)
+{
+    return *this;
+}
+
 template <class ElemType>
 ElemType GPUMatrix<ElemType>::Adagrad(GPUMatrix<ElemType>& gradients, const bool needAveMultiplier)
 {
@@ -996,6 +1052,21 @@ void GPUMatrix<ElemType>::FSAdagrad(GPUMatrix<ElemType>& gradients, GPUMatrix<El
 {
 }
 
+template <class ElemType>
+void GPUMatrix<ElemType>::Adam(GPUMatrix<ElemType>& gradients, GPUMatrix<ElemType>* functionValues, ElemType learnRate, ElemType beta1, ElemType beta2, ElemType epsilon, ElemType biasCorrection)
+{
+}
+
+template <class ElemType>
+void GPUMatrix<ElemType>::FusedSGDUpdate(DEVICEID_TYPE deviceId, const FusedSGDBatch<ElemType>& batch)
+{
+}
+
+template <class ElemType>
+void GPUMatrix<ElemType>::FusedSGDSquaredNorm(DEVICEID_TYPE deviceId, const FusedSGDBatch<ElemType>& batch, ElemType* sumOfSquares)
+{
+}
+
 template <class ElemType>
 ElemType GPUMatrix<ElemType>::RmsProp(GPUMatrix<ElemType>& gradients, ElemType RMS_GAMMA, ElemType RMS_WGT_INC, ElemType RMS_WGT_MAX, ElemType RMS_WGT_DEC, ElemType RMS_WGT_MIN, const bool needAveMultiplier)
 {
@@ -1041,6 +1112,11 @@ ElemType GPUMatrix<ElemType>::Get00Element() const
     ElemType res = 0;
     return res;
 }
+
+template <class ElemType>
+void GPUMatrix<ElemType>::CopyToHostAsync(ElemType* /*dst*/, size_t /*numElements*/) const
+{
+}
 #pragma endregion Basic Operators
 
 #pragma region Member BLAS Functions
@@ -1271,6 +1347,24 @@ GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignLogSoftmaxOf(const GPUMatrix<Ele
     return *this;
 }
 
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::InplaceSoftmax(const bool isColWise)
+{
+    return *this;
+}
+
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignSoftmaxOf(const GPUMatrix<ElemType>& /*a*/, const bool isColWise)
+{
+    return *this;
+}
+
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignMaskedSoftmaxOf(const GPUMatrix<ElemType>& /*a*/, ElemType /*scale*/, const GPUMatrix<ElemType>& /*numValidRows*/)
+{
+    return *this;
+}
+
 template <class ElemType>
 GPUMatrix<ElemType>& GPUMatrix<ElemType>::InplaceHardmax(const bool isColWise)
 {
@@ -1469,6 +1563,28 @@ void GPUMatrix<ElemType>::InnerProductWithShiftNeg(const GPUMatrix<ElemType>& a,
 {
 }
 
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignCosDistanceWithShiftNegOf(const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b, size_t shift, size_t negNumber,
+                                                                          GPUMatrix<ElemType>& invNormA, GPUMatrix<ElemType>& invNormB)
+{
+    return (*this);
+}
+
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AddCosDistanceWithShiftNegGradientOf(const GPUMatrix<ElemType>& gradient, const GPUMatrix<ElemType>& value,
+                                                                               const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b,
+                                                                               const GPUMatrix<ElemType>& invNormA, const GPUMatrix<ElemType>& invNormB, size_t shift, bool rightInput)
+{
+    return (*this);
+}
+
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignAugmentedImagesOf(const GPUMatrix<ElemType>& staged, const GPUMatrix<ElemType>& mean, size_t stagingWidth, size_t stagingHeight,
+                                                                  size_t channels, size_t width, size_t height, bool transposeToCHW)
+{
+    return (*this);
+}
+
 template <class ElemType>
 void GPUMatrix<ElemType>::ConductRowElementMultiplyWithShift(const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b, GPUMatrix<ElemType>& c, const size_t shift, const bool isafixed)
 {
@@ -1610,6 +1726,24 @@ ElemType GPUMatrix<ElemType>::MatrixNorm0() const
     return ElemType(0);
 }
 
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignMatrixNormInfOf(const GPUMatrix<ElemType>& /*a*/)
+{
+    return *this;
+}
+
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignMatrixNorm1Of(const GPUMatrix<ElemType>& /*a*/)
+{
+    return *this;
+}
+
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignIsEqualTo(const GPUMatrix<ElemType>& /*a*/, const GPUMatrix<ElemType>& /*b*/, const ElemType /*threshold*/)
+{
+    return *this;
+}
+
 template <class ElemType>
 GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignSignOf(const GPUMatrix<ElemType>& /*a*/)
 {
@@ -1643,6 +1777,12 @@ GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignNumOfDiff(const GPUMatrix<ElemTy
     return *this;
 }
 
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignNumOfTopKErrorsOf(const GPUMatrix<ElemType>& /*labels*/, const GPUMatrix<ElemType>& /*predictions*/, const size_t /*topK*/)
+{
+    return *this;
+}
+
 #pragma endregion Member BLAS Functions
 
 #pragma region Other helper functions
@@ -1678,6 +1818,36 @@ GPUMatrix<ElemType>& GPUMatrix<ElemType>::UnpackConvolutionInput(GPUMatrix<ElemT
     return inputSubBatch;
 }
 
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignGroupedConvolutionResult(const GPUMatrix<ElemType>& inputBatch, const GPUMatrix<ElemType>& filter,
+                                                                         const size_t inputWidth, const size_t inputHeight, const size_t inputChannels,
+                                                                         const size_t outputWidth, const size_t outputHeight, const size_t outputChannels,
+                                                                         const size_t kernelWidth, const size_t kernelHeight, const size_t horizontalSubsample, const size_t verticalSubsample,
+                                                                         const bool zeroPadding, const size_t groups)
+{
+    return *this;
+}
+
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AddGroupedConvolutionGradientOfInput(const GPUMatrix<ElemType>& outputGradientBatch, const GPUMatrix<ElemType>& filter,
+                                                                               const size_t inputWidth, const size_t inputHeight, const size_t inputChannels,
+                                                                               const size_t outputWidth, const size_t outputHeight, const size_t outputChannels,
+                                                                               const size_t kernelWidth, const size_t kernelHeight, const size_t horizontalSubsample, const size_t verticalSubsample,
+                                                                               const bool zeroPadding, const size_t groups)
+{
+    return *this;
+}
+
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AddGroupedConvolutionGradientOfFilter(const GPUMatrix<ElemType>& outputGradientBatch, const GPUMatrix<ElemType>& inputBatch,
+                                                                                const size_t inputWidth, const size_t inputHeight, const size_t inputChannels,
+                                                                                const size_t outputWidth, const size_t outputHeight, const size_t outputChannels,
+                                                                                const size_t kernelWidth, const size_t kernelHeight, const size_t horizontalSubsample, const size_t verticalSubsample,
+                                                                                const bool zeroPadding, const size_t groups)
+{
+    return *this;
+}
+
 template <class ElemType>
 GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignMaxPoolingResult(const GPUMatrix<ElemType>& inputBatch, const size_t channels,
                                                                  const size_t inputWidth, const size_t inputHeight, const size_t inputSizePerSample,
@@ -1725,6 +1895,11 @@ void GPUMatrix<ElemType>::MultiplyAndWeightedAdd(ElemType alpha, const GPUMatrix
 {
 }
 template <class ElemType>
+void GPUMatrix<ElemType>::BatchedMultiplyAndWeightedAdd(ElemType alpha, const GPUMatrix<ElemType>& /*a*/, const bool transposeA, const GPUMatrix<ElemType>& /*b*/, const bool transposeB,
+                                                        ElemType beta, GPUMatrix<ElemType>& c, size_t numBatches)
+{
+}
+template <class ElemType>
 void GPUMatrix<ElemType>::Multiply1x1AndWeightedAdd(ElemType alpha, const GPUMatrix<ElemType>& lhs, const GPUMatrix<ElemType>& rhs, ElemType beta, GPUMatrix<ElemType>& c)
 {
 }
@@ -1894,6 +2069,12 @@ void GPUMatrix<ElemType>::TensorOp(ElemType beta, const GPUMatrix<ElemType>& a,
                                    const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, 4>& reducingStrides)
 {
 }
+template <class ElemType>
+void GPUMatrix<ElemType>::TensorOp(ElemType beta, const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b, const GPUMatrix<ElemType>& c, const GPUMatrix<ElemType>& d, ElemType alpha, const ElementWiseProgram& program,
+                                   const array<size_t, 5>& offsets,
+                                   const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, 5>& regularStrides)
+{
+}
 
 template <class ElemType>
 void GPUMatrix<ElemType>::CreateCurandObject(unsigned long seed, const char* caller)
@@ -1971,6 +2152,13 @@ void GPUMatrix<ElemType>::RCRFTransGrdCompute(const GPUMatrix<ElemType>& lbls,
 {
 }
 
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignCTCPosteriors(const GPUMatrix<ElemType>& logProbs, const GPUMatrix<ElemType>& stateLabels, const GPUMatrix<ElemType>& sequences,
+                                                              size_t numParallelSequences, GPUMatrix<ElemType>& alpha, GPUMatrix<ElemType>& beta, GPUMatrix<ElemType>& logLikelihoods)
+{
+    return *this;
+}
+
 template <class ElemType>
 void GPUMatrix<ElemType>::AssignNoiseContrastiveEstimation(const GPUMatrix<ElemType>& a,
                                                            const GPUMatrix<ElemType>& b, const GPUMatrix<ElemType>& bias, size_t sampleCount, GPUMatrix<ElemType>& tmp, GPUMatrix<ElemType>& c)
@@ -1988,6 +2176,89 @@ void GPUMatrix<ElemType>::AssignSoftmaxSum(const GPUMatrix<ElemType>& a, GPUMatr
 {
 }
 
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::InplaceSampleFromCDF(const GPUMatrix<ElemType>& cdf)
+{
+    return *this;
+}
+
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignSampledSoftmaxLogits(const GPUMatrix<ElemType>& trueLogits, const GPUMatrix<ElemType>& sampledLogits,
+                                                                     const GPUMatrix<ElemType>& candidateBiases, const GPUMatrix<ElemType>& candidateIds)
+{
+    return *this;
+}
+
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignAliasSamplesOf(const GPUMatrix<ElemType>& uniforms, const GPUMatrix<ElemType>& aliasProbs, const GPUMatrix<ElemType>& aliases)
+{
+    return *this;
+}
+
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignNCELossOf(const GPUMatrix<ElemType>& labelIds, const GPUMatrix<ElemType>& noiseIds, const GPUMatrix<ElemType>& hidden, const GPUMatrix<ElemType>& weights,
+                                                          const GPUMatrix<ElemType>& bias, const GPUMatrix<ElemType>& logNoiseCounts, GPUMatrix<ElemType>& scoreGradients)
+{
+    return *this;
+}
+
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AddNCEHiddenGradientOf(const GPUMatrix<ElemType>& scoreGradients, const GPUMatrix<ElemType>& labelIds, const GPUMatrix<ElemType>& noiseIds,
+                                                                 const GPUMatrix<ElemType>& weights)
+{
+    return *this;
+}
+
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignGMMLogLikelihoodOf(const GPUMatrix<ElemType>& logPrior, const GPUMatrix<ElemType>& mean, const GPUMatrix<ElemType>& logStddev, const GPUMatrix<ElemType>& feature,
+                                                                   GPUMatrix<ElemType>& posterior, GPUMatrix<ElemType>& normedDeviation, GPUMatrix<ElemType>& normedDeviationVectors)
+{
+    return *this;
+}
+
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AddGMMLogLikelihoodGradient(const size_t inputIndex, const GPUMatrix<ElemType>& gradient, const GPUMatrix<ElemType>& logPrior,
+                                                                      const GPUMatrix<ElemType>& posterior, const GPUMatrix<ElemType>& normedDeviation, const GPUMatrix<ElemType>& normedDeviationVectors)
+{
+    return *this;
+}
+
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignCrossEntropyWithSoftmaxOf(const GPUMatrix<ElemType>& labels, const GPUMatrix<ElemType>& logits, GPUMatrix<ElemType>& logSumExp)
+{
+    return *this;
+}
+
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AddCrossEntropyWithSoftmaxGradient(const size_t inputIndex, const GPUMatrix<ElemType>& gradient, const GPUMatrix<ElemType>& labels,
+                                                                             const GPUMatrix<ElemType>& logits, const GPUMatrix<ElemType>& logSumExp)
+{
+    return *this;
+}
+
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignViterbiPathOf(const GPUMatrix<ElemType>& posScores, const GPUMatrix<ElemType>& pairScores, const GPUMatrix<ElemType>& sequences, const size_t numParallelSequences,
+                                                              const int startLabel, const int endLabel, GPUMatrix<ElemType>& alpha, GPUMatrix<ElemType>& backtrace)
+{
+    return *this;
+}
+
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignClassBasedCrossEntropyWithSoftmaxOf(const GPUMatrix<ElemType>& labels, const GPUMatrix<ElemType>& input, const GPUMatrix<ElemType>& weight,
+                                                                                   const GPUMatrix<ElemType>& classLogSoftmax, const GPUMatrix<ElemType>& buckets, const GPUMatrix<ElemType>& frames,
+                                                                                   const size_t maxClassSize, GPUMatrix<ElemType>& softmax)
+{
+    return *this;
+}
+
+template <class ElemType>
+GPUMatrix<ElemType>& GPUMatrix<ElemType>::AddClassBasedCrossEntropyWithSoftmaxGradient(const size_t inputIndex, const GPUMatrix<ElemType>& gradient, const GPUMatrix<ElemType>& labels,
+                                                                                      const GPUMatrix<ElemType>& input, const GPUMatrix<ElemType>& weight, const GPUMatrix<ElemType>& classLogSoftmax,
+                                                                                      const GPUMatrix<ElemType>& buckets, const GPUMatrix<ElemType>& frames, const GPUMatrix<ElemType>& softmax)
+{
+    return *this;
+}
+
 template <class ElemType>
 void GPUMatrix<ElemType>::AssignNCEUnnormalizedEval(const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b, GPUMatrix<ElemType>& c)
 {
@@ -2079,8 +2350,181 @@ void GPUDataTransferer<ElemType>::WaitForCopyCPUToGPUAsync()
 {
 }
 
+template <class ElemType>
+void GPUDataTransferer<ElemType>::RecordComputeStreamSyncPoint()
+{
+}
+
+template <class ElemType>
+void GPUDataTransferer<ElemType>::WaitForSyncPointOnAssignStreamAsync()
+{
+}
+
+template <class ElemType>
+void GPUDataTransferer<ElemType>::WaitForSyncPointOnFetchStreamAsync()
+{
+}
+
+template <class ElemType>
+void GPUDataTransferer<ElemType>::WaitForCopyGPUToCPUOnComputeStreamAsync()
+{
+}
+
+template <class ElemType>
+void GPUDataTransferer<ElemType>::WaitForCopyCPUToGPUOnComputeStreamAsync()
+{
+}
+
+template <class ElemType>
+void GPUDataTransferer<ElemType>::WaitForCopyGPUToCPUOnAssignStreamAsync()
+{
+}
+
 #pragma endregion GPUDataTransferer functions
 
+#pragma region ComputeStreamPool functions
+
+ComputeStreamPool::ComputeStreamPool(DEVICEID_TYPE deviceId, size_t numStreams, bool)
+    : m_deviceId(deviceId), m_numStreams(numStreams)
+{
+}
+
+ComputeStreamPool::~ComputeStreamPool()
+{
+}
+
+void ComputeStreamPool::Fork()
+{
+}
+
+void ComputeStreamPool::Join()
+{
+}
+
+void ComputeStreamPool::Use(size_t)
+{
+}
+
+void ComputeStreamPool::UseCollectStream()
+{
+}
+
+void ComputeStreamPool::UseMainStream()
+{
+}
+
+void ComputeStreamPool::Record(size_t)
+{
+}
+
+void ComputeStreamPool::Wait(size_t)
+{
+}
+
+void SharedComputeStreams::SetMaxStreams(size_t)
+{
+}
+
+size_t SharedComputeStreams::GetMaxStreams()
+{
+    return 0;
+}
+
+cudaStream_t SharedComputeStreams::Current()
+{
+    return nullptr;
+}
+
+SharedComputeStreams::Scope::Scope(DEVICEID_TYPE deviceId)
+    : m_deviceId(deviceId), m_stream(nullptr), m_prevStream(nullptr)
+{
+}
+
+SharedComputeStreams::Scope::~Scope()
+{
+}
+
+#pragma endregion ComputeStreamPool functions
+
+#pragma region ComputeGraph functions
+
+ComputeGraph::ComputeGraph(DEVICEID_TYPE deviceId)
+    : m_deviceId(deviceId)
+{
+}
+
+ComputeGraph::~ComputeGraph()
+{
+}
+
+bool ComputeGraph::IsSupported()
+{
+    return false;
+}
+
+void ComputeGraph::BeginCapture()
+{
+}
+
+bool ComputeGraph::EndCapture()
+{
+    return false;
+}
+
+bool ComputeGraph::IsCaptured() const
+{
+    return false;
+}
+
+void ComputeGraph::Launch()
+{
+}
+
+#pragma endregion ComputeGraph functions
+
+#pragma region PeerAccess functions
+
+void PeerAccess::DetectPeers()
+{
+}
+
+bool PeerAccess::EnableBetween(DEVICEID_TYPE deviceA, DEVICEID_TYPE deviceB)
+{
+    return false;
+}
+
+void CopyBetweenDevicesAsync(void* dst, DEVICEID_TYPE dstDevice, const void* src, DEVICEID_TYPE srcDevice, size_t numBytes)
+{
+}
+
+#pragma endregion PeerAccess functions
+
+#pragma region ComputeEventTimer functions
+
+ComputeEventTimer::ComputeEventTimer(DEVICEID_TYPE deviceId)
+    : m_deviceId(deviceId)
+{
+}
+
+ComputeEventTimer::~ComputeEventTimer()
+{
+}
+
+void ComputeEventTimer::Record(size_t)
+{
+}
+
+float ComputeEventTimer::ElapsedMilliseconds(size_t, size_t)
+{
+    return 0;
+}
+
+void ComputeEventTimer::Synchronize(size_t)
+{
+}
+
+#pragma endregion ComputeEventTimer functions
+
 template class GPUMatrix<char>;
 template class GPUMatrix<float>;
 template class GPUMatrix<double>;
@@ -2114,7 +2558,7 @@ typename CuDnnConvolutionEngineFactory<ElemType>::FilterPtr CuDnnConvolutionEngi
 
 template <class ElemType>
 typename CuDnnConvolutionEngineFactory<ElemType>::ConvDescPtr CuDnnConvolutionEngineFactory<ElemType>::CreateConvDescriptor(
-    const Tensor4D&, const Filter&, size_t, size_t, bool)
+    const Tensor4D&, const Filter&, size_t, size_t, bool, size_t)
 {
     RuntimeError("The code is compiled with CPUONLY macro.");
 }
@@ -2147,6 +2591,21 @@ bool CuDnnConvolutionEngineFactory<ElemType>::IsSupported(DEVICEID_TYPE)
 template class CuDnnConvolutionEngineFactory<float>;
 template class CuDnnConvolutionEngineFactory<double>;
 
+template <class ElemType>
+std::unique_ptr<RNNEngine<ElemType>> CuDnnRNNEngineFactory<ElemType>::CreateEngine(DEVICEID_TYPE, const RNNAttributes&)
+{
+    RuntimeError("The code is compiled with CPUONLY macro.");
+}
+
+template <class ElemType>
+bool CuDnnRNNEngineFactory<ElemType>::IsSupported(DEVICEID_TYPE)
+{
+    return false;
+}
+
+template class CuDnnRNNEngineFactory<float>;
+template class CuDnnRNNEngineFactory<double>;
+
 CudaTimer::~CudaTimer()
 {
 }
@@ -2176,6 +2635,10 @@ size_t GPUWatcher::GetFreeMemoryOnCUDADevice(int /*devId*/)
     return 0;
 }
 
+struct GPUWatcher::Sampler
+{
+};
+
 GPUWatcher::GPUWatcher(void)
 {
 }
@@ -2184,4 +2647,18 @@ GPUWatcher::~GPUWatcher(void)
 {
 }
 
+bool GPUWatcher::StartSampling(int /*deviceId*/, size_t /*intervalMs*/)
+{
+    return false;
+}
+
+void GPUWatcher::StopSampling()
+{
+}
+
+GPUTelemetrySummary GPUWatcher::TakeSummary()
+{
+    return GPUTelemetrySummary();
+}
+
 #endif // CPUONLY
@@ -0,0 +1,89 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+#include "PackedWeightMatrix.h"
+#include "CPUVectorKernels.h"
+#include <algorithm>
+#include <memory>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+static const size_t PanelRows = CPUVectorKernels::PackedPanelRows;
+
+// c = panel * b for the first 'rows' rows of a panel, with the SIMD kernel for float
+static void PanelGemm(const CPUVectorKernels& kernels, size_t rows, size_t n, size_t k, const float* panel, const float* b, size_t ldb, float* c, size_t ldc)
+{
+    kernels.PackedPanelGemm(rows, n, k, panel, b, ldb, c, ldc);
+}
+static void PanelGemm(const CPUVectorKernels&, size_t rows, size_t n, size_t k, const double* panel, const double* b, size_t ldb, double* c, size_t ldc)
+{
+    for (size_t j = 0; j < n; j++)
+    {
+        double sums[PanelRows] = {};
+        for (size_t p = 0; p < k; p++)
+            for (size_t i = 0; i < PanelRows; i++)
+                sums[i] += panel[p * PanelRows + i] * b[p + j * ldb];
+        for (size_t i = 0; i < rows; i++)
+            c[i + j * ldc] = sums[i];
+    }
+}
+
+template <class ElemType>
+PackedWeightMatrix<ElemType>::PackedWeightMatrix(const Matrix<ElemType>& weights)
+    : m_numRows(weights.GetNumRows()), m_numCols(weights.GetNumCols())
+{
+    if (weights.GetMatrixType() != MatrixType::DENSE)
+        InvalidArgument("PackedWeightMatrix: Only dense matrices can be packed.");
+
+    std::unique_ptr<ElemType[]> columnMajor(weights.CopyToArray());
+    const size_t numPanels = (m_numRows + PanelRows - 1) / PanelRows;
+    m_values.assign(numPanels * PanelRows * m_numCols, (ElemType) 0);
+    for (size_t k = 0; k < m_numCols; k++)
+        for (size_t i = 0; i < m_numRows; i++)
+            m_values[(i / PanelRows) * PanelRows * m_numCols + k * PanelRows + i % PanelRows] = columnMajor[k * m_numRows + i];
+}
+
+template <class ElemType>
+void PackedWeightMatrix<ElemType>::Multiply(const Matrix<ElemType>& in, Matrix<ElemType>& out) const
+{
+    if (out.GetDeviceId() != CPUDEVICE || out.GetMatrixType() != MatrixType::DENSE)
+        LogicError("PackedWeightMatrix::Multiply: The output must be a dense CPU matrix.");
+    if (in.GetNumRows() != m_numCols || out.GetNumRows() != m_numRows || out.GetNumCols() != in.GetNumCols())
+        InvalidArgument("PackedWeightMatrix::Multiply: Dimensions [%d x %d] * [%d x %d] -> [%d x %d] do not match.",
+                        (int) m_numRows, (int) m_numCols, (int) in.GetNumRows(), (int) in.GetNumCols(), (int) out.GetNumRows(), (int) out.GetNumCols());
+
+    Matrix<ElemType> inCopy(CPUDEVICE);
+    const Matrix<ElemType>* pIn = &in;
+    if (in.GetDeviceId() != CPUDEVICE || in.GetMatrixType() != MatrixType::DENSE)
+    {
+        inCopy = Matrix<ElemType>(in, CPUDEVICE);
+        inCopy.SwitchToMatrixType(MatrixType::DENSE, MatrixFormat::matrixFormatDense, true);
+        pIn = &inCopy;
+    }
+    const ElemType* inData = pIn->BufferPointer();
+    ElemType* outData = out.BufferPointer();
+
+    // Work items are a panel times a tile of input columns. A tile of 64 columns of K values stays in cache
+    // while consecutive panels are multiplied with it.
+    const auto& kernels = CPUVectorKernels::Get();
+    const size_t numSamples = in.GetNumCols();
+    const size_t tileSize = 64;
+    const size_t numPanels = (m_numRows + PanelRows - 1) / PanelRows;
+    const size_t numTiles = (numSamples + tileSize - 1) / tileSize;
+#pragma omp parallel for schedule(static) if (numPanels * numSamples * m_numCols >= 64 * 1024)
+    for (long item = 0; item < (long) (numPanels * numTiles); item++)
+    {
+        const size_t panel = item % numPanels;
+        const size_t tileBegin = (item / numPanels) * tileSize;
+        const size_t rowBegin = panel * PanelRows;
+        PanelGemm(kernels, std::min(m_numRows - rowBegin, PanelRows), std::min(numSamples - tileBegin, tileSize), m_numCols,
+                  m_values.data() + panel * PanelRows * m_numCols, inData + tileBegin * m_numCols, m_numCols, outData + tileBegin * m_numRows + rowBegin, m_numRows);
+    }
+}
+
+template class PackedWeightMatrix<float>;
+template class PackedWeightMatrix<double>;
+} } }
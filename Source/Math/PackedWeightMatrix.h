@@ -0,0 +1,51 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#ifdef _WIN32
+#ifdef MATH_EXPORTS
+#define MATH_API __declspec(dllexport)
+#else
+#define MATH_API __declspec(dllimport)
+#endif
+#else // no DLLs on Linux
+#define MATH_API
+#endif
+
+#include "Matrix.h"
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// -----------------------------------------------------------------------
+// PackedWeightMatrix -- a constant weight matrix packed once for the GEMMs of inference on the CPU
+// A BLAS GEMM copies its operands into blocks of its own layout on every call, which for the
+// small minibatches of evaluation costs a good part of the product. Here the [M x K] matrix W is
+// stored in that layout up front: panels of CPUVectorKernels::PackedPanelRows rows, each holding
+// the panel's values of column k contiguously for k = 0..K-1 (the last panel is zero-padded).
+// Multiply() then streams each panel once per tile of columns of its input.
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+class MATH_API PackedWeightMatrix
+{
+public:
+    // 'weights' must be a dense matrix; it may live on any device
+    explicit PackedWeightMatrix(const Matrix<ElemType>& weights);
+
+    size_t GetNumRows() const { return m_numRows; }
+    size_t GetNumCols() const { return m_numCols; }
+    size_t GetSizeInBytes() const { return m_values.size() * sizeof(ElemType); }
+
+    // out = W * in, with in: [K x N] and out: [M x N]; 'out' must be a dense CPU matrix of the right size
+    void Multiply(const Matrix<ElemType>& in, Matrix<ElemType>& out) const;
+
+private:
+    size_t m_numRows;
+    size_t m_numCols;
+    std::vector<ElemType> m_values; // W(i, k) at [(i / P) * P * K + k * P + i % P], with P = CPUVectorKernels::PackedPanelRows
+};
+} } }
@@ -0,0 +1,62 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// Counter-based random numbers (Philox4x32-10, Salmon et al., "Parallel Random Numbers: As Easy as 1, 2, 3", SC 2011).
+// A random number is a pure function of (key, counter), so element i of a random sequence can be computed
+// without the elements before it, on any thread and as often as needed--e.g. a dropout mask can be regenerated
+// in the backward pass instead of being stored.
+//
+
+#pragma once
+
+#include <stdint.h>
+
+#pragma push_macro("PHILOX_DECL")
+#ifndef PHILOX_DECL // to make these accessible to CUDA kernels, say '#define PHILOX_DECL __device__ __host__'
+#define PHILOX_DECL
+#endif
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// the four 32-bit words of Philox4x32-10 for a 64-bit key and a 64-bit counter
+static inline PHILOX_DECL void Philox4x32(uint64_t key, uint64_t counter, uint32_t out[4])
+{
+    uint32_t c0 = (uint32_t) counter, c1 = (uint32_t) (counter >> 32), c2 = 0, c3 = 0;
+    uint32_t k0 = (uint32_t) key, k1 = (uint32_t) (key >> 32);
+    for (int round = 0; round < 10; round++)
+    {
+        uint64_t p0 = (uint64_t) 0xD2511F53 * c0;
+        uint64_t p1 = (uint64_t) 0xCD9E8D57 * c2;
+        uint32_t n0 = (uint32_t) (p1 >> 32) ^ c1 ^ k0;
+        uint32_t n2 = (uint32_t) (p0 >> 32) ^ c3 ^ k1;
+        c1 = (uint32_t) p1;
+        c3 = (uint32_t) p0;
+        c0 = n0;
+        c2 = n2;
+        k0 += 0x9E3779B9; // the Weyl sequence of the key schedule
+        k1 += 0xBB67AE85;
+    }
+    out[0] = c0;
+    out[1] = c1;
+    out[2] = c2;
+    out[3] = c3;
+}
+
+// one word as a uniform number in [0,1), with 24 bits
+static inline PHILOX_DECL float PhiloxWordToUniform(uint32_t word)
+{
+    return (word >> 8) * (1.0f / 16777216.0f);
+}
+
+// element 'index' of the uniform sequence for 'key'; each block of four elements comes from one Philox4x32() call
+static inline PHILOX_DECL float PhiloxUniform(uint64_t key, uint64_t index)
+{
+    uint32_t words[4];
+    Philox4x32(key, index >> 2, words);
+    return PhiloxWordToUniform(words[index & 3]);
+}
+
+}}}
+
+#pragma pop_macro("PHILOX_DECL")
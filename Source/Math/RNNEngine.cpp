@@ -0,0 +1,550 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+#include "RNNEngine.h"
+#include "CuDnnRNNEngine.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+template <class ElemType>
+void RNNEngine<ElemType>::Forward(const Mat& in, const Mat& weights, Mat& out, const RNNMinibatchLayout& layout, bool isTraining)
+{
+    if (in.GetNumCols() != layout.GetNumCols() || out.GetNumCols() != layout.GetNumCols())
+        InvalidArgument("RNNEngine: Input and output must have one column per frame of the minibatch layout.");
+    if (out.GetNumRows() != m_attributes.GetOutputDim())
+        InvalidArgument("RNNEngine: Output dimension %d does not match the expected %d.", (int) out.GetNumRows(), (int) m_attributes.GetOutputDim());
+    if (weights.GetNumElements() != m_attributes.GetNumParameters(in.GetNumRows()))
+        InvalidArgument("RNNEngine: Weights have %d elements, but %d are expected.", (int) weights.GetNumElements(), (int) m_attributes.GetNumParameters(in.GetNumRows()));
+
+    m_inputDim = in.GetNumRows();
+    m_layout = layout;
+    m_isTraining = isTraining;
+    m_isBackwardDataDone = false;
+    ForwardCore(in, weights, out, layout, isTraining);
+}
+
+template <class ElemType>
+void RNNEngine<ElemType>::BackwardData(const Mat& out, const Mat& outGrad, const Mat& weights, Mat& inGrad)
+{
+    if (!m_isTraining)
+        LogicError("RNNEngine: BackwardData() requires a preceding Forward() in training mode.");
+    assert(outGrad.GetNumRows() == out.GetNumRows() && outGrad.GetNumCols() == out.GetNumCols());
+    assert(inGrad.GetNumRows() == m_inputDim && inGrad.GetNumCols() == m_layout.GetNumCols());
+
+    BackwardDataCore(out, outGrad, weights, inGrad);
+    m_isBackwardDataDone = true;
+}
+
+template <class ElemType>
+void RNNEngine<ElemType>::BackwardWeights(const Mat& in, const Mat& out, Mat& weightsGrad)
+{
+    if (!m_isBackwardDataDone)
+        LogicError("RNNEngine: BackwardWeights() requires a preceding BackwardData().");
+    assert(in.GetNumRows() == m_inputDim && in.GetNumCols() == m_layout.GetNumCols());
+    assert(weightsGrad.GetNumElements() == m_attributes.GetNumParameters(m_inputDim));
+
+    BackwardWeightsCore(in, out, weightsGrad);
+}
+
+// -----------------------------------------------------------------------
+// DefaultRNNEngine -- RNN stack composed from Matrix operations
+// The input projections of all frames are computed with one GEMM per gate ("batched GEMM over time"),
+// and only the recurrent part R h_prev is computed step by step, for all parallel sequences at once.
+// Per layer, direction, and frame, the engine keeps the gate activations (and cell states) for backprop.
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+class DefaultRNNEngine : public RNNEngine<ElemType>
+{
+public:
+    using Base = RNNEngine<ElemType>;
+    using typename Base::Mat;
+
+public:
+    DefaultRNNEngine(DEVICEID_TYPE deviceId, const RNNAttributes& attributes)
+        : Base(deviceId, attributes),
+          m_activations(deviceId), m_layerOutputs(deviceId), m_gradients(deviceId), m_validColumns(deviceId),
+          m_hp(deviceId), m_cp(deviceId), m_dh(deviceId), m_dc(deviceId), m_dhRecurrent(deviceId), m_dcRecurrent(deviceId),
+          m_tmp1(deviceId), m_tmp2(deviceId), m_dOutputs(deviceId), m_maskedInput(deviceId), m_ones(deviceId)
+    {
+        m_carryMasks[0] = make_shared<Mat>(deviceId);
+        m_carryMasks[1] = make_shared<Mat>(deviceId);
+        m_dLayer[0] = make_shared<Mat>(deviceId);
+        m_dLayer[1] = make_shared<Mat>(deviceId);
+    }
+
+protected:
+    using Base::m_deviceId;
+    using Base::m_attributes;
+    using Base::m_inputDim;
+    using Base::m_layout;
+
+    // number of [hiddenSize x numCols] blocks per layer and direction
+    size_t NumActivationBlocks() const
+    {
+        switch (m_attributes.m_kind)
+        {
+        case RNNCellKind::LSTM: return 6; // i, f, c~, o, c, h
+        case RNNCellKind::GRU:  return 5; // r, z, h~, R_h h_prev + bR_h, h
+        default:            return 1; // h
+        }
+    }
+    size_t NumGradientBlocks() const
+    {
+        // gradients w.r.t. the gate pre-activations, plus h_prev (masked)
+        // GRU needs one more, for the recurrent part of h~
+        return m_attributes.GetNumGates() + (m_attributes.m_kind == RNNCellKind::GRU ? 1 : 0) + 1;
+    }
+    size_t HiddenBlockIndex() const { return NumActivationBlocks() - 1; }
+    size_t PrevHiddenGradientBlockIndex() const { return NumGradientBlocks() - 1; }
+
+    size_t NumCols() const { return m_layout.GetNumCols(); }
+    size_t NumSeqs() const { return m_layout.m_numParallelSequences; }
+
+    Mat ActivationBlock(size_t layer, size_t dir, size_t k) const
+    {
+        const size_t index = (layer * m_attributes.GetNumDirections() + dir) * NumActivationBlocks() + k;
+        return m_activations.ColumnSlice(index * NumCols(), NumCols());
+    }
+    Mat GradientBlock(size_t layer, size_t dir, size_t k) const
+    {
+        const size_t index = (layer * m_attributes.GetNumDirections() + dir) * NumGradientBlocks() + k;
+        return m_gradients.ColumnSlice(index * NumCols(), NumCols());
+    }
+    // output of all but the last layer (the last one is written to 'out')
+    Mat LayerOutput(size_t layer) const
+    {
+        const size_t numDirs = m_attributes.GetNumDirections();
+        return m_layerOutputs.ColumnSlice(layer * numDirs * NumCols(), numDirs * NumCols()).Reshaped(m_attributes.GetOutputDim(), NumCols());
+    }
+
+    // views into the parameter vector, viewed as [hiddenSize x numParameters / hiddenSize]
+    Mat ParameterView(const Mat& weights) const
+    {
+        return weights.Reshaped(m_attributes.m_hiddenSize, weights.GetNumElements() / m_attributes.m_hiddenSize);
+    }
+    size_t BlockColumn(size_t layer, size_t dir) const
+    {
+        return m_attributes.GetParameterBlockOffset(layer, dir, m_inputDim) / m_attributes.m_hiddenSize;
+    }
+    // input weights as [layerInputDim x hiddenSize] (i.e. transposed)
+    Mat InputWeights(const Mat& view, size_t layer, size_t dir, size_t gate) const
+    {
+        const size_t inDim = m_attributes.GetLayerInputDim(layer, m_inputDim);
+        const size_t col = BlockColumn(layer, dir) + m_attributes.GetInputWeightsOffset(gate, inDim) / m_attributes.m_hiddenSize;
+        return view.ColumnSlice(col, inDim).Reshaped(inDim, m_attributes.m_hiddenSize);
+    }
+    // recurrent weights as [hiddenSize x hiddenSize] (transposed)
+    Mat RecurrentWeights(const Mat& view, size_t layer, size_t dir, size_t gate) const
+    {
+        const size_t inDim = m_attributes.GetLayerInputDim(layer, m_inputDim);
+        const size_t col = BlockColumn(layer, dir) + m_attributes.GetRecurrentWeightsOffset(gate, inDim) / m_attributes.m_hiddenSize;
+        return view.ColumnSlice(col, m_attributes.m_hiddenSize);
+    }
+    Mat InputBias(const Mat& view, size_t layer, size_t dir, size_t gate) const
+    {
+        const size_t inDim = m_attributes.GetLayerInputDim(layer, m_inputDim);
+        return view.ColumnSlice(BlockColumn(layer, dir) + m_attributes.GetInputBiasOffset(gate, inDim) / m_attributes.m_hiddenSize, 1);
+    }
+    Mat RecurrentBias(const Mat& view, size_t layer, size_t dir, size_t gate) const
+    {
+        const size_t inDim = m_attributes.GetLayerInputDim(layer, m_inputDim);
+        return view.ColumnSlice(BlockColumn(layer, dir) + m_attributes.GetRecurrentBiasOffset(gate, inDim) / m_attributes.m_hiddenSize, 1);
+    }
+
+    // set up the masks for the current layout
+    //  - m_validColumns: 0 for gaps
+    //  - m_carryMasks[dir]: 1 where the frame has a predecessor within its sequence in the direction of the recurrence
+    void PrepareMasks()
+    {
+        const size_t numSeqs = NumSeqs();
+        std::vector<char> valid(NumCols(), 0);
+        std::vector<ElemType> carry[2] = { std::vector<ElemType>(NumCols(), 0), std::vector<ElemType>(NumCols(), 0) };
+        for (const auto& seq : m_layout.m_sequences)
+        {
+            for (size_t t = seq.tBegin; t < seq.tEnd; t++)
+            {
+                const size_t j = t * numSeqs + seq.s;
+                valid[j] = 1;
+                carry[0][j] = t > seq.tBegin ? 1 : 0;
+                carry[1][j] = t + 1 < seq.tEnd ? 1 : 0;
+            }
+        }
+        m_validColumns.SetValue(1, NumCols(), m_deviceId, valid.data());
+        for (size_t dir = 0; dir < 2; dir++)
+            m_carryMasks[dir]->SetValue(1, NumCols(), m_deviceId, carry[dir].data());
+    }
+
+    // copy h or c of the preceding frame into 'prev', masked by whether there is one
+    void GetPrevious(Mat& prev, const Mat& block, size_t dir, size_t t) const
+    {
+        const size_t numSeqs = NumSeqs();
+        if ((dir == 0 && t == 0) || (dir == 1 && t + 1 == m_layout.m_numTimeSteps))
+        {
+            prev.Resize(m_attributes.m_hiddenSize, numSeqs);
+            prev.SetValue(0);
+            return;
+        }
+        const size_t tPrev = dir == 0 ? t - 1 : t + 1;
+        prev.SetValue(block.ColumnSlice(tPrev * numSeqs, numSeqs));
+        prev.RowElementMultiplyWith(m_carryMasks[dir]->ColumnSlice(t * numSeqs, numSeqs));
+    }
+
+    // grad .*= y .* (1 - y)
+    static void MultiplyBySigmoidDerivative(Mat& grad, const Mat& y, Mat& tmp)
+    {
+        tmp.AssignDifferenceOf(1, y);
+        tmp.ElementMultiplyWith(y);
+        grad.ElementMultiplyWith(tmp);
+    }
+    // grad .*= 1 - y .* y
+    static void MultiplyByTanhDerivative(Mat& grad, const Mat& y, Mat& tmp)
+    {
+        tmp.AssignElementProductOf(y, y);
+        tmp.AssignDifferenceOf(1, tmp);
+        grad.ElementMultiplyWith(tmp);
+    }
+
+    void ForwardCore(const Mat& in, const Mat& weights, Mat& out, const RNNMinibatchLayout& /*layout*/, bool /*isTraining*/) override
+    {
+        const size_t numLayers = m_attributes.m_numLayers;
+        const size_t numDirs = m_attributes.GetNumDirections();
+        const size_t hiddenSize = m_attributes.m_hiddenSize;
+
+        PrepareMasks();
+        m_activations.Resize(hiddenSize, numLayers * numDirs * NumActivationBlocks() * NumCols());
+        m_layerOutputs.Resize(hiddenSize, (numLayers - 1) * numDirs * NumCols());
+
+        const Mat view = ParameterView(weights);
+        for (size_t layer = 0; layer < numLayers; layer++)
+        {
+            const Mat layerInput = layer == 0 ? in.AsReference() : LayerOutput(layer - 1);
+            Mat layerOutput = layer + 1 == numLayers ? out.AsReference() : LayerOutput(layer);
+            for (size_t dir = 0; dir < numDirs; dir++)
+            {
+                ForwardLayer(layerInput, view, layer, dir);
+                layerOutput.AssignToRowSliceValuesOf(ActivationBlock(layer, dir, HiddenBlockIndex()), dir * hiddenSize, hiddenSize);
+            }
+        }
+    }
+
+    void ForwardLayer(const Mat& x, const Mat& view, size_t layer, size_t dir)
+    {
+        const RNNCellKind kind = m_attributes.m_kind;
+        const size_t numGates = m_attributes.GetNumGates();
+        const size_t numSeqs = NumSeqs();
+        const size_t numTimeSteps = m_layout.m_numTimeSteps;
+
+        // input projections for all frames at once
+        // Gap columns are zeroed, so that they stay finite (the minibatch may have NaNs in gaps) and get masked away below.
+        for (size_t g = 0; g < numGates; g++)
+        {
+            Mat a = ActivationBlock(layer, dir, g);
+            Mat::MultiplyAndWeightedAdd(1, InputWeights(view, layer, dir, g), true, x, false, 0, a);
+            a.MaskColumnsValue(m_validColumns, 0);
+            Mat::ScaleAndAdd(1, InputBias(view, layer, dir, g), a);
+            if (!(kind == RNNCellKind::GRU && g == 2)) // GRU: the recurrent bias of h~ is applied inside the reset gate
+                Mat::ScaleAndAdd(1, RecurrentBias(view, layer, dir, g), a);
+        }
+
+        // recurrence
+        const Mat h = ActivationBlock(layer, dir, HiddenBlockIndex());
+        for (size_t step = 0; step < numTimeSteps; step++)
+        {
+            const size_t t = dir == 0 ? step : numTimeSteps - 1 - step;
+            auto frame = [&](size_t k) { return ActivationBlock(layer, dir, k).ColumnSlice(t * numSeqs, numSeqs); };
+            GetPrevious(m_hp, h, dir, t);
+            if (kind == RNNCellKind::LSTM)
+            {
+                Mat gi = frame(0), gf = frame(1), gc = frame(2), go = frame(3), c = frame(4), ht = frame(5);
+                for (size_t g = 0; g < 4; g++)
+                {
+                    Mat a = frame(g);
+                    Mat::MultiplyAndWeightedAdd(1, RecurrentWeights(view, layer, dir, g), true, m_hp, false, 1, a);
+                }
+                gi.InplaceSigmoid();
+                gf.InplaceSigmoid();
+                gc.InplaceTanh();
+                go.InplaceSigmoid();
+                GetPrevious(m_cp, ActivationBlock(layer, dir, 4), dir, t);
+                c.AssignElementProductOf(gf, m_cp);
+                c.AddElementProductOf(gi, gc);
+                ht.AssignTanhOf(c);
+                ht.ElementMultiplyWith(go);
+            }
+            else if (kind == RNNCellKind::GRU)
+            {
+                Mat gr = frame(0), gz = frame(1), gn = frame(2), rh = frame(3), ht = frame(4);
+                for (size_t g = 0; g < 2; g++)
+                {
+                    Mat a = frame(g);
+                    Mat::MultiplyAndWeightedAdd(1, RecurrentWeights(view, layer, dir, g), true, m_hp, false, 1, a);
+                }
+                gr.InplaceSigmoid();
+                gz.InplaceSigmoid();
+                Mat::MultiplyAndWeightedAdd(1, RecurrentWeights(view, layer, dir, 2), true, m_hp, false, 0, rh);
+                Mat::ScaleAndAdd(1, RecurrentBias(view, layer, dir, 2), rh);
+                gn.AddElementProductOf(gr, rh);
+                gn.InplaceTanh();
+                // h = h~ + z .* (h_prev - h~)
+                ht.AssignDifferenceOf(m_hp, gn);
+                ht.ElementMultiplyWith(gz);
+                ht += gn;
+            }
+            else
+            {
+                Mat ht = frame(0);
+                Mat::MultiplyAndWeightedAdd(1, RecurrentWeights(view, layer, dir, 0), true, m_hp, false, 1, ht);
+                if (kind == RNNCellKind::RNNTanh)
+                    ht.InplaceTanh();
+                else
+                    ht.InplaceTruncateBottom(0);
+            }
+        }
+        ActivationBlock(layer, dir, HiddenBlockIndex()).MaskColumnsValue(m_validColumns, 0);
+    }
+
+    void BackwardDataCore(const Mat& /*out*/, const Mat& outGrad, const Mat& weights, Mat& inGrad) override
+    {
+        const size_t numLayers = m_attributes.m_numLayers;
+        const size_t numDirs = m_attributes.GetNumDirections();
+        const size_t hiddenSize = m_attributes.m_hiddenSize;
+
+        m_gradients.Resize(hiddenSize, numLayers * numDirs * NumGradientBlocks() * NumCols());
+
+        const Mat view = ParameterView(weights);
+        for (size_t layer = numLayers; layer-- > 0;)
+        {
+            // gradient w.r.t. this layer's output, and where to put the gradient w.r.t. its input
+            const Mat layerOutputGrad = layer + 1 == numLayers ? outGrad.AsReference() : m_dLayer[layer % 2]->AsReference();
+            Mat* layerInputGrad = &inGrad;
+            if (layer > 0)
+            {
+                layerInputGrad = m_dLayer[(layer - 1) % 2].get();
+                layerInputGrad->Resize(m_attributes.GetOutputDim(), NumCols());
+                layerInputGrad->SetValue(0);
+            }
+            for (size_t dir = 0; dir < numDirs; dir++)
+            {
+                m_dOutputs.AssignRowSliceValuesOf(layerOutputGrad, dir * hiddenSize, hiddenSize);
+                m_dOutputs.MaskColumnsValue(m_validColumns, 0);
+                BackwardLayer(view, layer, dir);
+
+                // gradient w.r.t. the layer input, again for all frames at once
+                for (size_t g = 0; g < m_attributes.GetNumGates(); g++)
+                    Mat::MultiplyAndWeightedAdd(1, InputWeights(view, layer, dir, g), false, GradientBlock(layer, dir, g), false, 1, *layerInputGrad);
+            }
+        }
+    }
+
+    void BackwardLayer(const Mat& view, size_t layer, size_t dir)
+    {
+        const RNNCellKind kind = m_attributes.m_kind;
+        const size_t numSeqs = NumSeqs();
+        const size_t numTimeSteps = m_layout.m_numTimeSteps;
+
+        // h_prev of every frame, masked; kept for BackwardWeights()
+        Mat hp = GradientBlock(layer, dir, PrevHiddenGradientBlockIndex());
+        ShiftIntoPrevious(hp, ActivationBlock(layer, dir, HiddenBlockIndex()), dir);
+        if (kind == RNNCellKind::LSTM)
+        {
+            m_cp.Resize(m_attributes.m_hiddenSize, NumCols());
+            ShiftIntoPrevious(m_cp, ActivationBlock(layer, dir, 4), dir);
+        }
+
+        // walk the recurrence backwards
+        for (size_t step = 0; step < numTimeSteps; step++)
+        {
+            const size_t t = dir == 0 ? numTimeSteps - 1 - step : step;
+            auto frame = [&](size_t k) { return ActivationBlock(layer, dir, k).ColumnSlice(t * numSeqs, numSeqs); };
+            auto gradFrame = [&](size_t k) { return GradientBlock(layer, dir, k).ColumnSlice(t * numSeqs, numSeqs); };
+            const Mat hpt = hp.ColumnSlice(t * numSeqs, numSeqs);
+            const Mat carry = m_carryMasks[dir]->ColumnSlice(t * numSeqs, numSeqs);
+
+            // total gradient w.r.t. h: from the output, and from the successor frame
+            m_dh.SetValue(m_dOutputs.ColumnSlice(t * numSeqs, numSeqs));
+            if (step > 0)
+                m_dh += m_dhRecurrent;
+
+            if (kind == RNNCellKind::LSTM)
+            {
+                const Mat gi = frame(0), gf = frame(1), gc = frame(2), go = frame(3), c = frame(4);
+                Mat dai = gradFrame(0), daf = gradFrame(1), dac = gradFrame(2), dao = gradFrame(3);
+                const Mat cpt = m_cp.ColumnSlice(t * numSeqs, numSeqs);
+
+                // o
+                m_tmp1.AssignTanhOf(c);
+                dao.AssignElementProductOf(m_dh, m_tmp1);
+                MultiplyBySigmoidDerivative(dao, go, m_tmp2);
+                // c
+                m_dc.AssignElementProductOf(m_dh, go);
+                MultiplyByTanhDerivative(m_dc, m_tmp1, m_tmp2);
+                if (step > 0)
+                    m_dc += m_dcRecurrent;
+                // i, c~, f
+                dai.AssignElementProductOf(m_dc, gc);
+                MultiplyBySigmoidDerivative(dai, gi, m_tmp2);
+                dac.AssignElementProductOf(m_dc, gi);
+                MultiplyByTanhDerivative(dac, gc, m_tmp2);
+                daf.AssignElementProductOf(m_dc, cpt);
+                MultiplyBySigmoidDerivative(daf, gf, m_tmp2);
+                // into the preceding frame
+                m_dcRecurrent.AssignElementProductOf(m_dc, gf);
+                m_dcRecurrent.RowElementMultiplyWith(carry);
+                for (size_t g = 0; g < 4; g++)
+                    Mat::MultiplyAndWeightedAdd(1, RecurrentWeights(view, layer, dir, g), false, gradFrame(g), false, g == 0 ? 0 : 1, m_dhRecurrent);
+            }
+            else if (kind == RNNCellKind::GRU)
+            {
+                const Mat gr = frame(0), gz = frame(1), gn = frame(2), rh = frame(3);
+                Mat dar = gradFrame(0), daz = gradFrame(1), dan = gradFrame(2), drh = gradFrame(3);
+
+                // h~
+                m_tmp1.AssignDifferenceOf(1, gz);
+                dan.AssignElementProductOf(m_dh, m_tmp1);
+                MultiplyByTanhDerivative(dan, gn, m_tmp2);
+                // z
+                m_tmp1.AssignDifferenceOf(hpt, gn);
+                daz.AssignElementProductOf(m_dh, m_tmp1);
+                MultiplyBySigmoidDerivative(daz, gz, m_tmp2);
+                // r and the recurrent part of h~
+                drh.AssignElementProductOf(dan, gr);
+                dar.AssignElementProductOf(dan, rh);
+                MultiplyBySigmoidDerivative(dar, gr, m_tmp2);
+                // into the preceding frame
+                m_dhRecurrent.AssignElementProductOf(m_dh, gz);
+                Mat::MultiplyAndWeightedAdd(1, RecurrentWeights(view, layer, dir, 0), false, dar, false, 1, m_dhRecurrent);
+                Mat::MultiplyAndWeightedAdd(1, RecurrentWeights(view, layer, dir, 1), false, daz, false, 1, m_dhRecurrent);
+                Mat::MultiplyAndWeightedAdd(1, RecurrentWeights(view, layer, dir, 2), false, drh, false, 1, m_dhRecurrent);
+            }
+            else
+            {
+                const Mat ht = frame(0);
+                Mat da = gradFrame(0);
+                da.SetValue(m_dh);
+                if (kind == RNNCellKind::RNNTanh)
+                    MultiplyByTanhDerivative(da, ht, m_tmp2);
+                else
+                {
+                    m_tmp2.AssignLinearRectifierDerivativeOf(ht);
+                    da.ElementMultiplyWith(m_tmp2);
+                }
+                Mat::MultiplyAndWeightedAdd(1, RecurrentWeights(view, layer, dir, 0), false, da, false, 0, m_dhRecurrent);
+            }
+            m_dhRecurrent.RowElementMultiplyWith(carry);
+        }
+    }
+
+    // prev[:, frame] = block[:, preceding frame in the direction of recurrence], or 0 if none
+    void ShiftIntoPrevious(Mat& prev, const Mat& block, size_t dir) const
+    {
+        const size_t numSeqs = NumSeqs();
+        const size_t numShifted = NumCols() - numSeqs;
+        prev.SetValue(0);
+        if (numShifted > 0)
+        {
+            Mat dst = prev.ColumnSlice(dir == 0 ? numSeqs : 0, numShifted);
+            dst.SetValue(block.ColumnSlice(dir == 0 ? 0 : numSeqs, numShifted));
+        }
+        prev.RowElementMultiplyWith(*m_carryMasks[dir]);
+    }
+
+    void BackwardWeightsCore(const Mat& in, const Mat& /*out*/, Mat& weightsGrad) override
+    {
+        const RNNCellKind kind = m_attributes.m_kind;
+        const size_t numLayers = m_attributes.m_numLayers;
+        const size_t numDirs = m_attributes.GetNumDirections();
+
+        // the minibatch may contain NaNs in gaps, which would leak into the weight gradient
+        const Mat* input0 = &in;
+        if (NumGaps() > 0)
+        {
+            m_maskedInput.SetValue(in);
+            m_maskedInput.MaskColumnsValue(m_validColumns, 0);
+            input0 = &m_maskedInput;
+        }
+
+        m_ones.Resize(NumCols(), 1);
+        m_ones.SetValue(1);
+
+        Mat view = ParameterView(weightsGrad);
+        for (size_t layer = 0; layer < numLayers; layer++)
+        {
+            const Mat layerInput = layer == 0 ? input0->AsReference() : LayerOutput(layer - 1);
+            for (size_t dir = 0; dir < numDirs; dir++)
+            {
+                const Mat hp = GradientBlock(layer, dir, PrevHiddenGradientBlockIndex());
+                for (size_t g = 0; g < m_attributes.GetNumGates(); g++)
+                {
+                    const Mat da = GradientBlock(layer, dir, g);
+                    const Mat daRecurrent = kind == RNNCellKind::GRU && g == 2 ? GradientBlock(layer, dir, 3) : da.AsReference(); // GRU: R_h h_prev + bR_h is gated by r
+
+                    Mat dW = InputWeights(view, layer, dir, g);
+                    Mat::MultiplyAndWeightedAdd(1, layerInput, false, da, true, 1, dW);
+                    Mat dR = RecurrentWeights(view, layer, dir, g);
+                    Mat::MultiplyAndWeightedAdd(1, hp, false, daRecurrent, true, 1, dR);
+                    Mat dbW = InputBias(view, layer, dir, g);
+                    Mat::MultiplyAndWeightedAdd(1, da, false, m_ones, false, 1, dbW);
+                    Mat dbR = RecurrentBias(view, layer, dir, g);
+                    Mat::MultiplyAndWeightedAdd(1, daRecurrent, false, m_ones, false, 1, dbR);
+                }
+            }
+        }
+    }
+
+    size_t NumGaps() const
+    {
+        size_t numFrames = 0;
+        for (const auto& seq : m_layout.m_sequences)
+            numFrames += seq.tEnd - seq.tBegin;
+        return NumCols() - numFrames;
+    }
+
+private:
+    Mat m_activations;  // [hiddenSize x (layers * dirs * NumActivationBlocks() * numCols)]
+    Mat m_layerOutputs; // [hiddenSize x ((layers - 1) * dirs * numCols)]
+    Mat m_gradients;    // [hiddenSize x (layers * dirs * NumGradientBlocks() * numCols)]
+    Matrix<char> m_validColumns;
+    shared_ptr<Mat> m_carryMasks[2];
+    // per-frame temporaries [hiddenSize x numParallelSequences]
+    Mat m_hp, m_cp, m_dh, m_dc, m_dhRecurrent, m_dcRecurrent, m_tmp1, m_tmp2;
+    Mat m_dOutputs;          // gradient w.r.t. the output of one direction of a layer
+    shared_ptr<Mat> m_dLayer[2]; // gradient w.r.t. the outputs of the hidden layers (alternating)
+    Mat m_maskedInput;
+    Mat m_ones;
+};
+
+template <class ElemType>
+std::unique_ptr<RNNEngine<ElemType>> RNNEngine<ElemType>::Create(DEVICEID_TYPE deviceId, const RNNAttributes& attributes, RNNEngineKind engineKind)
+{
+    if (attributes.m_hiddenSize == 0 || attributes.m_numLayers == 0)
+        InvalidArgument("RNNEngine: hidden size and number of layers must be positive.");
+
+    if (engineKind == RNNEngineKind::Auto)
+    {
+        if (deviceId >= 0 && CuDnnRNNEngineFactory<ElemType>::IsSupported(deviceId))
+            return Create(deviceId, attributes, RNNEngineKind::CuDnn);
+        else
+            return Create(deviceId, attributes, RNNEngineKind::Cntk);
+    }
+    else if (engineKind == RNNEngineKind::CuDnn)
+    {
+        if (deviceId >= 0 && CuDnnRNNEngineFactory<ElemType>::IsSupported(deviceId))
+            return CuDnnRNNEngineFactory<ElemType>::CreateEngine(deviceId, attributes);
+        RuntimeError("cuDNN RNN engine is not supported, check the device id and whether the code was compiled with cuDNN v5 or later.");
+    }
+    else if (engineKind == RNNEngineKind::Cntk)
+    {
+        return std::make_unique<DefaultRNNEngine<ElemType>>(deviceId, attributes);
+    }
+
+    RuntimeError("Not supported RNN engine type: %d.", (int) engineKind);
+}
+
+template class RNNEngine<float>;
+template class RNNEngine<double>;
+
+} } }
@@ -0,0 +1,204 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#ifdef _WIN32
+#ifdef MATH_EXPORTS
+#define MATH_API __declspec(dllexport)
+#else
+#define MATH_API __declspec(dllimport)
+#endif
+#else // no DLLs on Linux
+#define MATH_API
+#endif
+
+#include "Matrix.h"
+#include <string>
+#include <vector>
+#include <memory>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// -----------------------------------------------------------------------
+// RNNCellKind -- recurrent cell types of an RNN stack
+// The values and gate orders follow cuDNN's cudnnRNNMode_t:
+//  - LSTM: gates (i, f, c~, o); c = f .* c_prev + i .* c~; h = o .* tanh(c)
+//  - GRU:  gates (r, z, h~);    h~ = tanh(W_h x + r .* (R_h h_prev + bR_h) + bW_h); h = (1 - z) .* h~ + z .* h_prev
+//  - RNNTanh/RNNReLU: h = f(W x + R h_prev + bW + bR)
+// -----------------------------------------------------------------------
+
+enum class RNNCellKind : int
+{
+    RNNReLU = 0,
+    RNNTanh = 1,
+    LSTM = 2,
+    GRU = 3
+};
+
+static inline RNNCellKind RNNCellKindFrom(const std::wstring& s)
+{
+    if (s == L"lstm")
+        return RNNCellKind::LSTM;
+    else if (s == L"gru")
+        return RNNCellKind::GRU;
+    else if (s == L"rnnTanh")
+        return RNNCellKind::RNNTanh;
+    else if (s == L"rnnReLU")
+        return RNNCellKind::RNNReLU;
+    else
+        InvalidArgument("RNNCellKindFrom: Unknown recurrent op '%ls'; must be one of 'lstm', 'gru', 'rnnTanh', 'rnnReLU'.", s.c_str());
+}
+
+static inline std::wstring ToString(RNNCellKind kind)
+{
+    switch (kind)
+    {
+    case RNNCellKind::LSTM:    return L"lstm";
+    case RNNCellKind::GRU:     return L"gru";
+    case RNNCellKind::RNNTanh: return L"rnnTanh";
+    case RNNCellKind::RNNReLU: return L"rnnReLU";
+    default: LogicError("ToString: Invalid RNNCellKind %d.", (int) kind);
+    }
+}
+
+// -----------------------------------------------------------------------
+// RNNAttributes -- describes a stack of recurrent layers and its parameter layout
+// All parameters live in a single vector. For each layer and each direction (forward first) there is a block of
+//  - for each gate g: input weights W_g, stored row-major [hiddenSize x layerInputDim]
+//  - for each gate g: recurrent weights R_g, stored row-major [hiddenSize x hiddenSize]
+//  - for each gate g: input bias bW_g [hiddenSize]
+//  - for each gate g: recurrent bias bR_g [hiddenSize]
+// Row-major storage is what cuDNN uses for its linear layers, so blocks can be copied without transposition.
+// Since every piece is a multiple of hiddenSize, the whole vector can be viewed as a [hiddenSize x N] matrix,
+// in which every piece is a column range.
+// -----------------------------------------------------------------------
+
+struct RNNAttributes
+{
+    RNNCellKind m_kind;
+    size_t m_hiddenSize;
+    size_t m_numLayers;
+    bool m_bidirectional;
+
+    RNNAttributes(RNNCellKind kind = RNNCellKind::LSTM, size_t hiddenSize = 0, size_t numLayers = 1, bool bidirectional = false)
+        : m_kind(kind), m_hiddenSize(hiddenSize), m_numLayers(numLayers), m_bidirectional(bidirectional)
+    {
+    }
+
+    size_t GetNumDirections() const { return m_bidirectional ? 2 : 1; }
+    size_t GetNumGates() const { return m_kind == RNNCellKind::LSTM ? 4 : m_kind == RNNCellKind::GRU ? 3 : 1; }
+    size_t GetOutputDim() const { return m_hiddenSize * GetNumDirections(); }
+    size_t GetLayerInputDim(size_t layer, size_t inputDim) const { return layer == 0 ? inputDim : GetOutputDim(); }
+
+    // offsets and sizes below are in elements
+    size_t GetParameterBlockSize(size_t layer, size_t inputDim) const
+    {
+        return GetNumGates() * m_hiddenSize * (GetLayerInputDim(layer, inputDim) + m_hiddenSize + 2);
+    }
+    size_t GetParameterBlockOffset(size_t layer, size_t direction, size_t inputDim) const
+    {
+        size_t offset = 0;
+        for (size_t l = 0; l < layer; l++)
+            offset += GetNumDirections() * GetParameterBlockSize(l, inputDim);
+        return offset + direction * GetParameterBlockSize(layer, inputDim);
+    }
+    size_t GetNumParameters(size_t inputDim) const
+    {
+        return GetParameterBlockOffset(m_numLayers, 0, inputDim);
+    }
+    // within a block
+    size_t GetInputWeightsOffset(size_t gate, size_t layerInputDim) const     { return gate * m_hiddenSize * layerInputDim; }
+    size_t GetRecurrentWeightsOffset(size_t gate, size_t layerInputDim) const { return GetNumGates() * m_hiddenSize * layerInputDim + gate * m_hiddenSize * m_hiddenSize; }
+    size_t GetInputBiasOffset(size_t gate, size_t layerInputDim) const        { return GetNumGates() * m_hiddenSize * (layerInputDim + m_hiddenSize) + gate * m_hiddenSize; }
+    size_t GetRecurrentBiasOffset(size_t gate, size_t layerInputDim) const    { return GetInputBiasOffset(GetNumGates() + gate, layerInputDim); }
+
+    bool operator==(const RNNAttributes& other) const
+    {
+        return m_kind == other.m_kind && m_hiddenSize == other.m_hiddenSize && m_numLayers == other.m_numLayers && m_bidirectional == other.m_bidirectional;
+    }
+    bool operator!=(const RNNAttributes& other) const { return !(*this == other); }
+};
+
+// -----------------------------------------------------------------------
+// RNNMinibatchLayout -- the sequences of a minibatch, as a plain description the Math library can use
+// Data is stored with one column per frame at index t * m_numParallelSequences + s. Columns not
+// covered by any sequence are gaps. Sequences are clipped to the minibatch, i.e. the recurrence
+// starts from a zero state at the first frame of each sequence within the minibatch.
+// -----------------------------------------------------------------------
+
+struct RNNMinibatchLayout
+{
+    struct Sequence
+    {
+        size_t s;      // parallel-sequence index
+        size_t tBegin; // first frame
+        size_t tEnd;   // one past the last frame
+    };
+
+    size_t m_numParallelSequences;
+    size_t m_numTimeSteps;
+    std::vector<Sequence> m_sequences;
+
+    RNNMinibatchLayout()
+        : m_numParallelSequences(0), m_numTimeSteps(0)
+    {
+    }
+    size_t GetNumCols() const { return m_numParallelSequences * m_numTimeSteps; }
+};
+
+enum class RNNEngineKind
+{
+    Auto,
+    CuDnn,
+    Cntk // batched GEMM over time, composed from Matrix operations; works on CPU and GPU
+};
+
+// -----------------------------------------------------------------------
+// RNNEngine -- computes a stack of recurrent layers over entire sequences
+// Usage per minibatch: Forward(), then (when training) BackwardData() and BackwardWeights() in this order.
+// The engine keeps whatever it needs between these calls (activations, cuDNN reserve space).
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+class MATH_API RNNEngine
+{
+public:
+    using Mat = Matrix<ElemType>;
+
+public:
+    RNNEngine(DEVICEID_TYPE deviceId, const RNNAttributes& attributes)
+        : m_deviceId(deviceId), m_attributes(attributes), m_inputDim(0), m_isTraining(false), m_isBackwardDataDone(false)
+    {
+    }
+    virtual ~RNNEngine() = default;
+
+    // in: [inputDim x T*S], out: [outputDim x T*S]; gap columns of 'out' are set to 0
+    void Forward(const Mat& in, const Mat& weights, Mat& out, const RNNMinibatchLayout& layout, bool isTraining);
+    // adds the input gradient to 'inGrad'
+    void BackwardData(const Mat& out, const Mat& outGrad, const Mat& weights, Mat& inGrad);
+    // adds the weight gradient to 'weightsGrad'; must follow BackwardData()
+    void BackwardWeights(const Mat& in, const Mat& out, Mat& weightsGrad);
+
+    const RNNAttributes& GetAttributes() const { return m_attributes; }
+
+    static std::unique_ptr<RNNEngine<ElemType>> Create(DEVICEID_TYPE deviceId, const RNNAttributes& attributes, RNNEngineKind engineKind);
+
+    DISABLE_COPY_AND_MOVE(RNNEngine);
+
+protected:
+    virtual void ForwardCore(const Mat& in, const Mat& weights, Mat& out, const RNNMinibatchLayout& layout, bool isTraining) = 0;
+    virtual void BackwardDataCore(const Mat& out, const Mat& outGrad, const Mat& weights, Mat& inGrad) = 0;
+    virtual void BackwardWeightsCore(const Mat& in, const Mat& out, Mat& weightsGrad) = 0;
+
+protected:
+    DEVICEID_TYPE m_deviceId;
+    RNNAttributes m_attributes;
+    size_t m_inputDim;           // of the last Forward()
+    RNNMinibatchLayout m_layout; // of the last Forward()
+    bool m_isTraining;           // of the last Forward()
+    bool m_isBackwardDataDone;
+};
+} } }
@@ -0,0 +1,157 @@
+// SparseStagingBuffer.h -- a sparse minibatch appended column by column on the host, and transferred to its matrix at once
+
+#pragma once
+
+#include "Basics.h"
+#include "Matrix.h"
+#include "CUDAPageLockedMemAllocator.h"
+#include "ComputeEventTimer.h"
+#include <memory>
+#include <string.h>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// -----------------------------------------------------------------------
+// SparseStagingBuffer -- the (values, row indices, column counts) of a CSC minibatch, in one staging allocation
+//
+// A reader appends the samples of a minibatch as columns, and TransferTo() sets the matrix from it. Nothing like the
+// CSC column offsets is built on the host: each column only adds its count, and the offsets are computed where the
+// matrix is (see Matrix::SetMatrixFromCSCColumnCounts()). For a matrix on a GPU, the allocation is page-locked and
+// copied asynchronously on the current stream; Clear() waits for that copy before the next minibatch is appended.
+// The allocation grows as needed, so it need not be sized for the densest possible minibatch.
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+class SparseStagingBuffer
+{
+public:
+    SparseStagingBuffer(DEVICEID_TYPE deviceId)
+        : m_deviceId(deviceId), m_buffer(nullptr), m_maxNZ(0), m_maxNumCols(0), m_nz(0), m_numCols(0)
+    {
+        if (m_deviceId >= 0)
+            m_transferDone.reset(new ComputeEventTimer(m_deviceId));
+    }
+
+    ~SparseStagingBuffer()
+    {
+        if (m_transferDone)
+            m_transferDone->Synchronize(0);
+        FreeBuffer(m_buffer);
+    }
+
+    // Disallow copy and move construction and assignment
+    DISABLE_COPY_AND_MOVE(SparseStagingBuffer);
+
+    DEVICEID_TYPE GetDeviceId() const { return m_deviceId; }
+    size_t GetNumCols() const { return m_numCols; }
+    size_t GetNumNZ() const { return m_nz; }
+
+    // starts a new minibatch, once the previous one has been copied to the device
+    void Clear()
+    {
+        if (m_transferDone)
+            m_transferDone->Synchronize(0);
+        m_nz = 0;
+        m_numCols = 0;
+    }
+
+    // appends a column with nnz values
+    void AppendColumn(const ElemType* values, const CPUSPARSE_INDEX_TYPE* rowIndices, size_t nnz)
+    {
+        Reserve(m_numCols + 1, m_nz + nnz);
+        memcpy(Values() + m_nz, values, sizeof(ElemType) * nnz);
+        memcpy(RowIndices() + m_nz, rowIndices, sizeof(CPUSPARSE_INDEX_TYPE) * nnz);
+        ColCounts()[m_numCols] = (CPUSPARSE_INDEX_TYPE) nnz;
+        m_nz += nnz;
+        m_numCols++;
+    }
+
+    // appends numCols columns given in CSC format: the values of column j are [colStarts[j], colStarts[j + 1])
+    void AppendColumns(const ElemType* values, const CPUSPARSE_INDEX_TYPE* rowIndices, const CPUSPARSE_INDEX_TYPE* colStarts, size_t numCols)
+    {
+        size_t nnz = colStarts[numCols] - colStarts[0];
+        Reserve(m_numCols + numCols, m_nz + nnz);
+        memcpy(Values() + m_nz, values + colStarts[0], sizeof(ElemType) * nnz);
+        memcpy(RowIndices() + m_nz, rowIndices + colStarts[0], sizeof(CPUSPARSE_INDEX_TYPE) * nnz);
+        for (size_t j = 0; j < numCols; j++)
+            ColCounts()[m_numCols + j] = colStarts[j + 1] - colStarts[j];
+        m_nz += nnz;
+        m_numCols += numCols;
+    }
+
+    // sets the matrix, numRows x GetNumCols(), in CSC format
+    void TransferTo(Matrix<ElemType>& matrix, size_t numRows)
+    {
+        if (matrix.GetDeviceId() != m_deviceId)
+            LogicError("SparseStagingBuffer::TransferTo: The matrix is on device %d, the staging buffer was made for device %d.", (int) matrix.GetDeviceId(), (int) m_deviceId);
+
+        if (matrix.GetMatrixType() != MatrixType::SPARSE || matrix.GetFormat() != matrixFormatSparseCSC)
+            matrix.SwitchToMatrixType(MatrixType::SPARSE, matrixFormatSparseCSC, false);
+
+        // CPUSparseMatrix reads the arrays, which need not be allocated for an empty minibatch
+        Reserve(1, 1);
+        matrix.SetMatrixFromCSCColumnCounts(ColCounts(), RowIndices(), Values(), m_nz, numRows, m_numCols);
+        if (m_transferDone)
+            m_transferDone->Record(0);
+    }
+
+private:
+    // layout of the allocation: values [m_maxNZ], row indices [m_maxNZ], column counts [m_maxNumCols]
+    ElemType* Values() const { return (ElemType*) m_buffer; }
+    CPUSPARSE_INDEX_TYPE* RowIndices() const { return (CPUSPARSE_INDEX_TYPE*) (m_buffer + sizeof(ElemType) * m_maxNZ); }
+    CPUSPARSE_INDEX_TYPE* ColCounts() const { return RowIndices() + m_maxNZ; }
+
+    static size_t BufferSize(size_t maxNumCols, size_t maxNZ) { return (sizeof(ElemType) + sizeof(CPUSPARSE_INDEX_TYPE)) * maxNZ + sizeof(CPUSPARSE_INDEX_TYPE) * maxNumCols; }
+
+    void Reserve(size_t numCols, size_t nz)
+    {
+        if (numCols <= m_maxNumCols && nz <= m_maxNZ)
+            return;
+
+        // grow by half, so that appending stays linear
+        size_t maxNumCols = max(numCols, m_maxNumCols + m_maxNumCols / 2);
+        size_t maxNZ = max(nz, m_maxNZ + m_maxNZ / 2);
+        char* buffer = AllocateBuffer(BufferSize(maxNumCols, maxNZ));
+        if (m_buffer != nullptr)
+        {
+            memcpy(buffer, Values(), sizeof(ElemType) * m_nz);
+            memcpy(buffer + sizeof(ElemType) * maxNZ, RowIndices(), sizeof(CPUSPARSE_INDEX_TYPE) * m_nz);
+            memcpy(buffer + (sizeof(ElemType) + sizeof(CPUSPARSE_INDEX_TYPE)) * maxNZ, ColCounts(), sizeof(CPUSPARSE_INDEX_TYPE) * m_numCols);
+            // a pending copy may still read the old allocation
+            if (m_transferDone)
+                m_transferDone->Synchronize(0);
+            FreeBuffer(m_buffer);
+        }
+        m_buffer = buffer;
+        m_maxNumCols = maxNumCols;
+        m_maxNZ = maxNZ;
+    }
+
+    char* AllocateBuffer(size_t size) const
+    {
+        char* buffer = (char*) (m_deviceId >= 0 ? CUDAPageLockedMemAllocator::Malloc(size, m_deviceId) : malloc(size));
+        if (buffer == nullptr)
+            RuntimeError("SparseStagingBuffer: Failed to allocate %d bytes.", (int) size);
+        return buffer;
+    }
+
+    void FreeBuffer(char* buffer) const
+    {
+        if (buffer == nullptr)
+            return;
+        if (m_deviceId >= 0)
+            CUDAPageLockedMemAllocator::Free(buffer, m_deviceId);
+        else
+            free(buffer);
+    }
+
+    DEVICEID_TYPE m_deviceId;
+    std::unique_ptr<ComputeEventTimer> m_transferDone; // event 0: the end of the last copy; null on the CPU
+    char* m_buffer;
+    size_t m_maxNZ;
+    size_t m_maxNumCols;
+    size_t m_nz;
+    size_t m_numCols;
+};
+
+} } }
@@ -0,0 +1,114 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// TaskScheduler.cpp -- process-wide thread pool for the background work of readers and gradient aggregation
+//
+
+#include "stdafx.h"
+#include "Basics.h"
+#include "TaskScheduler.h"
+#include "CPUMatrix.h" // for SetNumThreads()
+#include <algorithm>
+#include <thread>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+TaskScheduler& TaskScheduler::Instance()
+{
+    // Note: intentionally never destructed; the workers wait for tasks until the process ends.
+    static TaskScheduler* scheduler = new TaskScheduler();
+    return *scheduler;
+}
+
+TaskScheduler::TaskScheduler()
+    : m_numWorkers(0)
+{
+    m_budgets[(int) TaskClass::compute] = 1;
+    m_budgets[(int) TaskClass::aggregation] = 1;
+    m_budgets[(int) TaskClass::prefetch] = 2;
+    std::fill(m_numRunning, m_numRunning + NumTaskClasses, 0);
+}
+
+int TaskScheduler::SetBudgets(int numComputeThreads, size_t numAggregationThreads, size_t numPrefetchThreads)
+{
+    if (numAggregationThreads == 0 || numPrefetchThreads == 0)
+        InvalidArgument("TaskScheduler: numAggregationThreads and numPrefetchThreads must be at least 1.");
+
+    if (numComputeThreads == 0)
+    {
+        int numCores = (int) std::thread::hardware_concurrency();
+        numComputeThreads = std::max(1, numCores - (int) (numAggregationThreads + numPrefetchThreads));
+    }
+    numComputeThreads = CPUMatrix<float /*any will do*/>::SetNumThreads(numComputeThreads);
+
+    auto& scheduler = Instance();
+    {
+        std::lock_guard<std::mutex> lock(scheduler.m_mutex);
+        scheduler.m_budgets[(int) TaskClass::compute] = std::max(1, numComputeThreads);
+        scheduler.m_budgets[(int) TaskClass::aggregation] = numAggregationThreads;
+        scheduler.m_budgets[(int) TaskClass::prefetch] = numPrefetchThreads;
+    }
+    scheduler.m_workAvailable.notify_all(); // a larger budget may let queued tasks run
+    return numComputeThreads;
+}
+
+size_t TaskScheduler::GetBudget(TaskClass taskClass) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_budgets[(int) taskClass];
+}
+
+size_t TaskScheduler::NextTaskClass() const
+{
+    for (size_t i = 0; i < NumTaskClasses; i++)
+    {
+        if (!m_queues[i].empty() && m_numRunning[i] < m_budgets[i])
+            return i;
+    }
+    return NumTaskClasses;
+}
+
+void TaskScheduler::Enqueue(TaskClass taskClass, std::function<void()>&& task)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_queues[(int) taskClass].push_back(std::move(task));
+
+        // one worker per core of the budgets, started when needed
+        size_t numTasks = 0, numWorkersNeeded = 0;
+        for (size_t i = 0; i < NumTaskClasses; i++)
+        {
+            numTasks += m_queues[i].size() + m_numRunning[i];
+            numWorkersNeeded += m_budgets[i];
+        }
+        if (m_numWorkers < std::min(numTasks, numWorkersNeeded))
+        {
+            std::thread([this]() { RunWorker(); }).detach();
+            m_numWorkers++;
+        }
+    }
+    m_workAvailable.notify_one();
+}
+
+void TaskScheduler::RunWorker()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    for (;;)
+    {
+        m_workAvailable.wait(lock, [this]() { return NextTaskClass() != NumTaskClasses; });
+        size_t i = NextTaskClass();
+        auto task = std::move(m_queues[i].front());
+        m_queues[i].pop_front();
+        m_numRunning[i]++;
+
+        lock.unlock();
+        task(); // (a packaged_task, which stores its exceptions in the future)
+        lock.lock();
+
+        m_numRunning[i]--;
+        // a task of this class may have waited for the budget
+        m_workAvailable.notify_one();
+    }
+}
+} } }
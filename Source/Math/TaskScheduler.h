@@ -0,0 +1,105 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// TaskScheduler.h -- process-wide thread pool for the background work of readers and gradient aggregation
+//
+
+#pragma once
+
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+#ifdef _WIN32
+#ifdef MATH_EXPORTS
+#define MATH_API __declspec(dllexport)
+#else
+#define MATH_API __declspec(dllimport)
+#endif
+#else // no DLLs on Linux
+#define MATH_API
+#endif
+
+// in order of priority
+enum class TaskClass : int
+{
+    compute = 0,
+    aggregation = 1,
+    prefetch = 2
+};
+
+// -----------------------------------------------------------------------
+// TaskScheduler -- one pool of worker threads for all background tasks
+//
+// Readers prefetching minibatches, gradient aggregation and the OpenMP and
+// BLAS threads of CPU math used to each bring their own threads, and
+// together they took more cores than there are. Now each class of work has
+// a budget of cores (SetBudgets()): the OpenMP and BLAS thread count is the
+// compute budget, and at most 'budget' tasks of the other classes run at
+// the same time. A free worker takes the oldest task of the most important
+// class that is below its budget.
+//
+// There are as many workers as the budgets add up to, so a class below its
+// budget always finds a worker: a task may wait for tasks of other classes
+// (or for the main thread) without deadlocking, but not for later tasks of
+// its own class.
+//
+// Unlike that of std::async(), the destructor of the returned std::future
+// does not wait for the task. Owners of a pending task have to wait for it
+// before they destruct what it uses.
+//
+// Workers are reused, so a task must not rely on thread-local state being
+// fresh (e.g. the current device: call Matrix::SetDevice() first).
+// -----------------------------------------------------------------------
+
+#pragma warning(push)
+#pragma warning(disable : 4251) // needs to have dll-interface to be used by clients of... (std::deque etc.)
+
+class MATH_API TaskScheduler
+{
+public:
+    static TaskScheduler& Instance();
+
+    // Sets the number of cores of each class. 'numComputeThreads' becomes the number of OpenMP and BLAS threads
+    // (see CPUMatrix::SetNumThreads()); 0 means the cores that the other classes leave, and negative values are
+    // relative to the number of cores. Returns the number of compute threads.
+    static int SetBudgets(int numComputeThreads, size_t numAggregationThreads, size_t numPrefetchThreads);
+    size_t GetBudget(TaskClass taskClass) const;
+
+    template <class F>
+    auto Submit(TaskClass taskClass, F&& f) -> std::future<decltype(f())>
+    {
+        typedef decltype(f()) Result;
+        auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(f));
+        auto future = task->get_future();
+        Enqueue(taskClass, [task]() { (*task)(); });
+        return future;
+    }
+
+    static const size_t NumTaskClasses = 3;
+
+private:
+    TaskScheduler();
+
+    void Enqueue(TaskClass taskClass, std::function<void()>&& task);
+    void RunWorker();
+    // the class whose oldest task is to run next, or NumTaskClasses if none may run
+    size_t NextTaskClass() const;
+
+    mutable std::mutex m_mutex; // protects everything below
+    std::condition_variable m_workAvailable;
+    std::deque<std::function<void()>> m_queues[NumTaskClasses];
+    size_t m_budgets[NumTaskClasses];
+    size_t m_numRunning[NumTaskClasses];
+    size_t m_numWorkers;
+};
+
+#pragma warning(pop)
+
+} } }
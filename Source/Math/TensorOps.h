@@ -243,6 +243,225 @@ DefBinaryOp(SqrOfDifference, Sqr(a - b));
 DefTernaryOp(Cond, a ? b : c);
 DefTernaryOp(Clip, a < b ? b : (a > c ? c : a));
 #pragma pop_macro("DefTernaryOp")
+
+// -----------------------------------------------------------------------
+// ElementWiseProgram interpreter
+//
+// Computes the value of a fused sequence of elementwise ops (CommonMatrix.h)
+// for one element. 'inputs' has ElementWiseProgram::MaxInputs entries.
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+DECL ElemType EvaluateElementWiseProgram(const ElementWiseProgram& program, const ElemType* inputs)
+{
+    ElemType regs[ElementWiseProgram::MaxRegisters];
+    for (int i = 0; i < ElementWiseProgram::MaxInputs; i++)
+        regs[i] = inputs[i];
+    for (int i = 0; i < program.m_numInstructions; i++)
+    {
+        const ElementWiseProgram::Instruction& instr = program.m_instructions[i];
+        ElemType a = regs[instr.args[0]];
+        ElemType b = regs[instr.args[1]];
+        ElemType c = regs[instr.args[2]];
+        ElemType val;
+#pragma push_macro("CaseUnaryProgramOp")
+#pragma push_macro("CaseBinaryProgramOp")
+#pragma push_macro("CaseTernaryProgramOp")
+#define CaseUnaryProgramOp(oper)        \
+    case ElementWiseOperator::op##oper: \
+        val = Op##oper(a);              \
+        break
+#define CaseBinaryProgramOp(oper)       \
+    case ElementWiseOperator::op##oper: \
+        val = Op##oper(a, b);           \
+        break
+#define CaseTernaryProgramOp(oper)      \
+    case ElementWiseOperator::op##oper: \
+        val = Op##oper(a, b, c);        \
+        break
+        switch (instr.op)
+        {
+            ForAllUnaryOps(CaseUnaryProgramOp);
+            ForAllBinaryOps(CaseBinaryProgramOp);
+            ForAllTernaryOps(CaseTernaryProgramOp);
+        default:
+            val = 0; // (failure--ElementWiseProgram::Append() does not let unknown ops through)
+        }
+#pragma pop_macro("CaseTernaryProgramOp")
+#pragma pop_macro("CaseBinaryProgramOp")
+#pragma pop_macro("CaseUnaryProgramOp")
+        regs[ElementWiseProgram::MaxInputs + i] = val;
+    }
+    return regs[ElementWiseProgram::MaxInputs + program.m_numInstructions - 1];
+}
+
+// -----------------------------------------------------------------------
+// FusedSGDBatch update (CommonMatrix.h)
+//
+// Updates element i of one tensor of the batch, in the order of
+// SGD::UpdateWeightsS(): clipping, L2, the update, L1.
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+DECL void FusedSGDUpdateElement(const FusedSGDBatch<ElemType>& batch, const typename FusedSGDBatch<ElemType>::Tensor& tensor, size_t i)
+{
+    ElemType g = tensor.m_gradient[i];
+    ElemType val = tensor.m_value[i];
+
+    if (g > batch.m_truncationThreshold)
+        g = batch.m_truncationThreshold;
+    else if (g < -batch.m_truncationThreshold)
+        g = -batch.m_truncationThreshold;
+
+    if (batch.m_gradientSquaredNorm != nullptr)
+    {
+        ElemType norm = sqrt_(*batch.m_gradientSquaredNorm);
+        if (norm > batch.m_maxGradientNorm)
+            g *= batch.m_maxGradientNorm / norm;
+    }
+
+    if (batch.m_L2Weight > 0)
+        g += batch.m_L2Weight * val;
+
+    const ElemType lr = tensor.m_learnRatePerSample;
+    const ElemType mom = batch.m_momentum;
+    if (batch.m_isFSAdagrad)
+    {
+        ElemType* smoothAda = tensor.m_smoothedGradient;
+        ElemType* smoothMom = tensor.m_smoothedGradient + tensor.m_numElements;
+        ElemType adaSqr = batch.m_adaWeight * smoothAda[i] + (1.0f - batch.m_adaWeight) * g * g;
+        smoothAda[i] = adaSqr;
+        if (adaSqr != 0.0f)
+        {
+            ElemType w = tensor.m_adaMul * ((ElemType) 1.0 / sqrt_(adaSqr));
+            if (w > 10.0f)
+                w = 10.0f;
+            g *= w;
+        }
+
+        if (mom > 0.0f)
+        {
+            g = mom * smoothMom[i] + (1.0f - mom) * g;
+            smoothMom[i] = g;
+        }
+
+        val -= lr * g;
+    }
+    else
+    {
+        ElemType smooth = (1 - mom) * lr * g + mom * tensor.m_smoothedGradient[i];
+        tensor.m_smoothedGradient[i] = smooth;
+        if (!batch.m_useNesterovMomentum)
+            val -= smooth;
+        else
+        {
+            val -= mom * smooth;
+            val -= (1 - mom) * lr * g;
+        }
+    }
+
+    const ElemType l1 = tensor.m_L1Threshold;
+    if (l1 > 0)
+    {
+        if (val > l1)
+            val -= l1;
+        else if (val < -l1)
+            val += l1;
+        else
+            val = 0;
+    }
+
+    tensor.m_value[i] = val;
+}
+
+// -----------------------------------------------------------------------
+// lazy update of a column of a block-sparse gradient (Matrix::LazyNormalGrad(), Matrix::LazyAdagrad())
+//
+// Updates one element of the column, after first applying the 'numSkipped' updates the column missed since its
+// last update, in which its gradient was only the L2 term. These take the current learning rate, momentum and L2 weight.
+// -----------------------------------------------------------------------
+
+// the number of updates a column missed, from the step of its last update as kept in the state
+template <class ElemType>
+DECL size_t LazyNumSkippedSteps(const ElemType lastStep, size_t step)
+{
+    size_t last = (size_t) lastStep;
+    return step > last + 1 ? step - last - 1 : 0;
+}
+
+// momentum SGD as for sparse gradients in Matrix::NormalGrad(): smoothed = momentum * smoothed + (1 - momentum) * g, value -= lr * smoothed
+template <class ElemType>
+DECL void LazyNormalGradElement(ElemType& smoothed, ElemType& value, ElemType g, const ElemType lr, const ElemType momentum, const ElemType l2Weight, size_t numSkipped)
+{
+    // A missed update is linear in (smoothed, value), so all of them are the numSkipped-th power of its 2 x 2 matrix a,
+    // taken by repeated squaring.
+    ElemType a00 = momentum, a01 = (1 - momentum) * l2Weight;
+    ElemType a10 = -lr * momentum, a11 = 1 - lr * (1 - momentum) * l2Weight;
+    ElemType p00 = 1, p01 = 0, p10 = 0, p11 = 1;
+    for (size_t n = numSkipped; n > 0; n >>= 1)
+    {
+        if (n & 1) // p = p * a
+        {
+            ElemType t00 = p00 * a00 + p01 * a10;
+            ElemType t01 = p00 * a01 + p01 * a11;
+            ElemType t10 = p10 * a00 + p11 * a10;
+            ElemType t11 = p10 * a01 + p11 * a11;
+            p00 = t00;
+            p01 = t01;
+            p10 = t10;
+            p11 = t11;
+        }
+        // a = a * a
+        ElemType t00 = a00 * a00 + a01 * a10;
+        ElemType t01 = a00 * a01 + a01 * a11;
+        ElemType t10 = a10 * a00 + a11 * a10;
+        ElemType t11 = a10 * a01 + a11 * a11;
+        a00 = t00;
+        a01 = t01;
+        a10 = t10;
+        a11 = t11;
+    }
+    ElemType s = p00 * smoothed + p01 * value;
+    ElemType v = p10 * smoothed + p11 * value;
+
+    g += l2Weight * v;
+    s = momentum * s + (1 - momentum) * g;
+    smoothed = s;
+    value = v - lr * s;
+}
+
+// the multiplier of the element for SGD's normWithAveMultiplier, before the missed updates
+template <class ElemType>
+DECL ElemType LazyAdagradMultiplier(ElemType smoothed, ElemType value, ElemType g, const ElemType l2Weight)
+{
+    const ElemType floor = 1e-16f;
+    g += l2Weight * value;
+    return 1 / sqrt_(smoothed + g * g + floor);
+}
+
+// AdaGrad as in Matrix::Adagrad(): smoothed += g * g, value -= lr * g / sqrt(smoothed). The missed updates are not
+// linear, so they are taken one by one; there are none without L2.
+template <class ElemType>
+DECL void LazyAdagradElement(ElemType& smoothed, ElemType& value, ElemType g, const ElemType lr, const ElemType l2Weight, size_t numSkipped)
+{
+    const ElemType floor = 1e-16f;
+    ElemType s = smoothed;
+    ElemType v = value;
+    if (l2Weight > 0)
+    {
+        for (size_t n = 0; n < numSkipped; n++)
+        {
+            ElemType d = l2Weight * v;
+            s += d * d;
+            v -= lr * d / sqrt_(s + floor);
+        }
+    }
+
+    g += l2Weight * v;
+    s += g * g;
+    smoothed = s;
+    value = v - lr * g / sqrt_(s + floor);
+}
 }
 }
 }
@@ -283,6 +283,32 @@ void TensorView<ElemType>::DoTernaryOpOf(ElemType beta, const TensorView& a, con
     GetSOB().TensorOp(beta, a.GetSOB(), b.GetSOB(), c.GetSOB(), alpha, op, offsets, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
 }
 
+template <class ElemType>
+void TensorView<ElemType>::DoElementWiseProgramOf(ElemType beta, const vector<TensorView>& inputs, ElemType alpha, const ElementWiseProgram& program)
+{
+    const size_t N = ElementWiseProgram::MaxInputs + 1;
+    static_assert(N == 5, "DoElementWiseProgramOf: The code below assumes ElementWiseProgram::MaxInputs == 4.");
+    if (inputs.empty() || inputs.size() > ElementWiseProgram::MaxInputs || inputs.size() != (size_t) program.m_numInputs)
+        InvalidArgument("DoElementWiseProgramOf: Program expects %d inputs but got %d.", (int) program.m_numInputs, (int) inputs.size());
+    if (program.m_numInstructions == 0)
+        InvalidArgument("DoElementWiseProgramOf: Empty program.");
+
+    // unused input slots are filled with the first input; they are never read
+    array<const TensorView*, N - 1> args;
+    for (size_t i = 0; i < N - 1; i++)
+        args[i] = &inputs[i < inputs.size() ? i : 0];
+
+    array<size_t, N> offsets;
+    array<SmallVector<ptrdiff_t>, N> regularStrides, reducingStrides;
+    SmallVector<size_t> regularOpDims, reducingOpDims;
+    PrepareTensorOperands<ElemType, N>(array<TensorShape, N>{args[0]->GetShape(), args[1]->GetShape(), args[2]->GetShape(), args[3]->GetShape(), GetShape()}, offsets, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+
+    if (reducingOpDims.size() > 0)
+        InvalidArgument("DoElementWiseProgramOf: Reduction is not supported by fused elementwise operations.");
+
+    GetSOB().TensorOp(beta, args[0]->GetSOB(), args[1]->GetSOB(), args[2]->GetSOB(), args[3]->GetSOB(), alpha, program, offsets, regularOpDims, regularStrides);
+}
+
 // simple test function for testing stuff
 // Call as: Microsoft::MSR::CNTK::TensorView<float>::Test();
 template <class ElemType>
@@ -372,10 +398,11 @@ static string MatrixProductFormat(const TensorShape& shapeA, bool transA, const
 
 // flatten a tensor into a 2D tensor, where splitPoint is the first index to go into the second dimension
 // The tensor must be flattenable this way, i.e. each of the two index ranges must be dense.
-static void FlattenToMatrix(TensorShape& shape, bool trans, size_t splitPoint)
+// The last batchRank dimensions always go into the second dimension, so that the batch matrices end up side by side.
+static void FlattenToMatrix(TensorShape& shape, bool trans, size_t splitPoint, size_t batchRank = 0)
 {
     if (trans)
-        splitPoint = shape.GetRank() - splitPoint;
+        splitPoint = shape.GetRank() - batchRank - splitPoint;
     // check & print meaningful error message
     SmallVector<bool> dimsToDrop(shape.GetRank(), false);
     for (size_t k = 1; k < shape.GetRank(); k++)
@@ -437,28 +464,46 @@ Matrix/*ref*/<ElemType> TensorView<ElemType>::AsMatrix() const
 }
 
 template <class ElemType>
-void TensorView<ElemType>::DoMatrixProductOf(ElemType beta, bool transC, const TensorView& a, bool transA, const TensorView& b, bool transB, ElemType alpha)
+void TensorView<ElemType>::DoMatrixProductOf(ElemType beta, bool transC, const TensorView& a, bool transA, const TensorView& b, bool transB, ElemType alpha, size_t batchRank)
 {
     // determine integration dimension offset
     auto shapeA = a.m_shape;
     auto shapeB = b.m_shape;
     auto shapeC =   m_shape;
-    if (shapeA.GetRank() + shapeB.GetRank() < shapeC.GetRank())
+    // trailing batch dimensions must be the same in all three
+    if (shapeA.GetRank() < batchRank || shapeB.GetRank() < batchRank || shapeC.GetRank() < batchRank)
+        InvalidArgument("DoMatrixProductOf: Ranks %s must not be less than the batch rank %d.", MatrixProductFormat(shapeA, transA, shapeB, transB, shapeC, transC).c_str(), (int)batchRank);
+    size_t numBatches = 1;
+    for (size_t k = 0; k < batchRank; k++)
+    {
+        let dim = shapeC[shapeC.GetRank() - batchRank + k];
+        if (shapeA[shapeA.GetRank() - batchRank + k] != dim || shapeB[shapeB.GetRank() - batchRank + k] != dim)
+            InvalidArgument("DoMatrixProductOf: Batch dimensions %s mismatch.", MatrixProductFormat(shapeA, transA, shapeB, transB, shapeC, transC).c_str());
+        numBatches *= dim;
+    }
+    let rankA = shapeA.GetRank() - batchRank; // ranks of the batch matrices
+    let rankB = shapeB.GetRank() - batchRank;
+    let rankC = shapeC.GetRank() - batchRank;
+    if (rankA + rankB < rankC)
         InvalidArgument("DoMatrixProductOf: Ranks %s don't match, output must have a non-reduced output dimension.", MatrixProductFormat(shapeA, transA, shapeB, transB, shapeC, transC).c_str());
-    let removedDims = shapeA.GetRank() + shapeB.GetRank() - shapeC.GetRank();
+    let removedDims = rankA + rankB - rankC;
     let numReducedDims = removedDims / 2;
     if (numReducedDims * 2 != removedDims)
         InvalidArgument("DoMatrixProductOf: Ranks %s mismatch.", MatrixProductFormat(shapeA, transA, shapeB, transB, shapeC, transC).c_str());
-    let firstReducedDim = shapeA.GetRank() - numReducedDims;
+    let firstReducedDim = rankA - numReducedDims;
     // flatten. This updates shapeA etc.
-    FlattenToMatrix(shapeA, transA, firstReducedDim);
-    FlattenToMatrix(shapeB, transB, numReducedDims);
-    FlattenToMatrix(shapeC, transC, firstReducedDim);
+    // With batch dimensions, each becomes a [rows x (cols * numBatches)] matrix.
+    FlattenToMatrix(shapeA, transA, firstReducedDim, batchRank);
+    FlattenToMatrix(shapeB, transB, numReducedDims,  batchRank);
+    FlattenToMatrix(shapeC, transC, firstReducedDim, batchRank);
     // check dimensions
-    // shapeX[transX] and shapeX[1-transX] are row and column dim, respectively, or swapped if transposed
-    if (shapeA[transA]   != shapeC[transC]   || // output dim
-        shapeB[1-transB] != shapeC[1-transC] || // input dim
-        shapeA[1-transA] != shapeB[transB])     // reduction dim
+    // dimsX[transX] and dimsX[1-transX] are row and column dim of each batch matrix, respectively, or swapped if transposed
+    size_t dimsA[2] = { shapeA[0], shapeA[1] / numBatches };
+    size_t dimsB[2] = { shapeB[0], shapeB[1] / numBatches };
+    size_t dimsC[2] = { shapeC[0], shapeC[1] / numBatches };
+    if (dimsA[transA]   != dimsC[transC]   || // output dim
+        dimsB[1-transB] != dimsC[1-transC] || // input dim
+        dimsA[1-transA] != dimsB[transB])     // reduction dim
     {
         InvalidArgument("DoMatrixProductOf: Flattened tensor dimensions %s mismatch.", MatrixProductFormat(shapeA, transA, shapeB, transB, shapeC, transC).c_str());
     }
@@ -467,7 +512,14 @@ void TensorView<ElemType>::DoMatrixProductOf(ElemType beta, bool transC, const T
     let  B = b.Reshaped(shapeB).AsMatrix();
     auto C =   Reshaped(shapeC).AsMatrix();
     // and go
-    if (!transC)
+    if (numBatches > 1)
+    {
+        if (!transC)
+            Matrix<ElemType>::BatchedMultiplyAndWeightedAdd(alpha, A, transA, B, transB, beta, C, numBatches);
+        else
+            Matrix<ElemType>::BatchedMultiplyAndWeightedAdd(alpha, B, !transB, A, !transA, beta, C, numBatches);
+    }
+    else if (!transC)
         Matrix<ElemType>::MultiplyAndWeightedAdd(alpha, A, transA, B, transB, beta, C);
     else // C' = A * B  <==>  C = (A * B)' = B' * A'
         Matrix<ElemType>::MultiplyAndWeightedAdd(alpha, B, !transB, A, !transA, beta, C);
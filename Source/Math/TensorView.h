@@ -125,19 +125,27 @@ public:
     void DoBinaryOpOf (ElemType beta, const TensorView& a, const TensorView& b,                      ElemType alpha, ElementWiseOperator op);
     void DoTernaryOpOf(ElemType beta, const TensorView& a, const TensorView& b, const TensorView& c, ElemType alpha, ElementWiseOperator op);
 
+    // fused elementwise operation: evaluate 'program' (a sequence of elementwise ops, see ElementWiseProgram) over
+    // up to ElementWiseProgram::MaxInputs inputs in a single pass, i.e. c := beta * c + alpha * program(inputs...)
+    // Inputs may broadcast, but reduction is not supported.
+    void DoElementWiseProgramOf(ElemType beta, const std::vector<TensorView>& inputs, ElemType alpha, const ElementWiseProgram& program);
+
     // -------------------------------------------------------------------
     // matrix product -- GEMM for flattened tensors
     // Result goes into 'this', and can optionally be added to the existing value.
     // [I x J x K x L] * [K x L x M x N] -> [I x J x M x N] reducing over (K,L)
     // Reduction range is inferred from tensor ranks.
     // [I x J], [K x L], and [M x N] must each be dense.
+    // With batchRank > 0, the last batchRank dimensions of all three are batch dimensions, and the product is done for each batch index:
+    // [I x J x K x B] * [K x M x B] -> [I x J x M x B] for batchRank = 1 (e.g. per-head or per-sequence products).
+    // This is a single strided-batched GEMM; the batch dimensions must be dense with the matrix dimensions.
     // Being a matrix product, the output cannot be in-place.
     // If beta == 0, c is not read out, i.e. it can be uninitialized or contain NaNs.
     // -------------------------------------------------------------------
 
-    void DoMatrixProductOf    (ElemType beta, bool transC, const TensorView& a, bool transA, const TensorView& b, bool transB, ElemType alpha);
-    void AssignMatrixProductOf(               bool transC, const TensorView& a, bool transA, const TensorView& b, bool transB, ElemType alpha = 1.0f) { DoMatrixProductOf(0,    transC, a, transA, b, transB, alpha); }
-    void AddMatrixProductOf   (               bool transC, const TensorView& a, bool transA, const TensorView& b, bool transB, ElemType alpha = 1.0f) { DoMatrixProductOf(1.0f, transC, a, transA, b, transB, alpha); }
+    void DoMatrixProductOf    (ElemType beta, bool transC, const TensorView& a, bool transA, const TensorView& b, bool transB, ElemType alpha, size_t batchRank = 0);
+    void AssignMatrixProductOf(               bool transC, const TensorView& a, bool transA, const TensorView& b, bool transB, ElemType alpha = 1.0f, size_t batchRank = 0) { DoMatrixProductOf(0,    transC, a, transA, b, transB, alpha, batchRank); }
+    void AddMatrixProductOf   (               bool transC, const TensorView& a, bool transA, const TensorView& b, bool transB, ElemType alpha = 1.0f, size_t batchRank = 0) { DoMatrixProductOf(1.0f, transC, a, transA, b, transB, alpha, batchRank); }
 
     Matrix/*ref*/<ElemType> AsMatrix() const;
 
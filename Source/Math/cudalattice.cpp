@@ -128,6 +128,26 @@ private:
                                            dynamic_cast<vectorbaseimpl<floatvector, vectorref<float>> &>(edgeacscores));
     }
 
+    void packlattice(const edgeinfowithscoresvector &edges, const nodeinfovector &nodes, const aligninfovector &aligns,
+                     const uintvector &alignoffsets, const sizetvector &backptroffsets, const size_t edgeoffset, const size_t nodeoffset,
+                     const size_t alignoffset, const size_t frameoffset, const unsigned int alignbase, const size_t backptrbase,
+                     edgeinfowithscoresvector &packededges, nodeinfovector &packednodes, aligninfovector &packedaligns,
+                     uintvector &packedalignoffsets, sizetvector &packedbackptroffsets)
+    {
+        ondevice no(deviceid);
+        latticefunctionsops::packlattice(dynamic_cast<const vectorbaseimpl<edgeinfowithscoresvector, vectorref<msra::lattices::edgeinfowithscores>> &>(edges),
+                                         dynamic_cast<const vectorbaseimpl<nodeinfovector, vectorref<msra::lattices::nodeinfo>> &>(nodes),
+                                         dynamic_cast<const vectorbaseimpl<aligninfovector, vectorref<msra::lattices::aligninfo>> &>(aligns),
+                                         dynamic_cast<const vectorbaseimpl<uintvector, vectorref<unsigned int>> &>(alignoffsets),
+                                         dynamic_cast<const vectorbaseimpl<sizetvector, vectorref<size_t>> &>(backptroffsets),
+                                         edgeoffset, nodeoffset, alignoffset, frameoffset, alignbase, backptrbase,
+                                         dynamic_cast<vectorbaseimpl<edgeinfowithscoresvector, vectorref<msra::lattices::edgeinfowithscores>> &>(packededges),
+                                         dynamic_cast<vectorbaseimpl<nodeinfovector, vectorref<msra::lattices::nodeinfo>> &>(packednodes),
+                                         dynamic_cast<vectorbaseimpl<aligninfovector, vectorref<msra::lattices::aligninfo>> &>(packedaligns),
+                                         dynamic_cast<vectorbaseimpl<uintvector, vectorref<unsigned int>> &>(packedalignoffsets),
+                                         dynamic_cast<vectorbaseimpl<sizetvector, vectorref<size_t>> &>(packedbackptroffsets));
+    }
+
     void forwardbackwardlattice(const size_t *batchsizeforward, const size_t *batchsizebackward,
                                 const size_t numlaunchforward, const size_t numlaunchbackward,
                                 const size_t spalignunitid, const size_t silalignunitid,
@@ -163,6 +183,46 @@ private:
                                                     logEframescorrecttotal, totalfwscore);
     }
 
+    void forwardbackwardlatticebatch(const size_t *batchsizeforward, const size_t *batchsizebackward,
+                                     const size_t numlaunchforward, const size_t numlaunchbackward,
+                                     const uintvector &forwardorder, const uintvector &backwardorder,
+                                     const uintvector &edgelattices, const uintvector &latticenodeoffsets,
+                                     const size_t spalignunitid, const size_t silalignunitid,
+                                     const floatvector &edgeacscores, const edgeinfowithscoresvector &edges,
+                                     const nodeinfovector &nodes, const aligninfovector &aligns,
+                                     const ushortvector &alignments, const uintvector &alignoffsets,
+                                     doublevector &logpps, doublevector &logalphas, doublevector &logbetas,
+                                     const float lmf, const float wp, const float amf, const float boostingfactor, const bool returnEframescorrect,
+                                     const ushortvector &uids, const ushortvector &senone2classmap, doublevector &logaccalphas,
+                                     doublevector &logaccbetas, doublevector &logframescorrectedge,
+                                     doublevector &logEframescorrect, doublevector &latticetotals)
+    {
+        ondevice no(deviceid);
+        latticefunctionsops::forwardbackwardlatticebatch(batchsizeforward, batchsizebackward, numlaunchforward, numlaunchbackward,
+                                                         dynamic_cast<const vectorbaseimpl<uintvector, vectorref<unsigned int>> &>(forwardorder),
+                                                         dynamic_cast<const vectorbaseimpl<uintvector, vectorref<unsigned int>> &>(backwardorder),
+                                                         dynamic_cast<const vectorbaseimpl<uintvector, vectorref<unsigned int>> &>(edgelattices),
+                                                         dynamic_cast<const vectorbaseimpl<uintvector, vectorref<unsigned int>> &>(latticenodeoffsets),
+                                                         spalignunitid, silalignunitid,
+                                                         dynamic_cast<const vectorbaseimpl<floatvector, vectorref<float>> &>(edgeacscores),
+                                                         dynamic_cast<const vectorbaseimpl<edgeinfowithscoresvector, vectorref<msra::lattices::edgeinfowithscores>> &>(edges),
+                                                         dynamic_cast<const vectorbaseimpl<nodeinfovector, vectorref<msra::lattices::nodeinfo>> &>(nodes),
+                                                         dynamic_cast<const vectorbaseimpl<aligninfovector, vectorref<msra::lattices::aligninfo>> &>(aligns),
+                                                         dynamic_cast<const vectorbaseimpl<ushortvector, vectorref<unsigned short>> &>(alignments),
+                                                         dynamic_cast<const vectorbaseimpl<uintvector, vectorref<unsigned int>> &>(alignoffsets),
+                                                         dynamic_cast<vectorbaseimpl<doublevector, vectorref<double>> &>(logpps),
+                                                         dynamic_cast<vectorbaseimpl<doublevector, vectorref<double>> &>(logalphas),
+                                                         dynamic_cast<vectorbaseimpl<doublevector, vectorref<double>> &>(logbetas),
+                                                         lmf, wp, amf, boostingfactor, returnEframescorrect,
+                                                         dynamic_cast<const vectorbaseimpl<ushortvector, vectorref<unsigned short>> &>(uids),
+                                                         dynamic_cast<const vectorbaseimpl<ushortvector, vectorref<unsigned short>> &>(senone2classmap),
+                                                         dynamic_cast<vectorbaseimpl<doublevector, vectorref<double>> &>(logaccalphas),
+                                                         dynamic_cast<vectorbaseimpl<doublevector, vectorref<double>> &>(logaccbetas),
+                                                         dynamic_cast<vectorbaseimpl<doublevector, vectorref<double>> &>(logframescorrectedge),
+                                                         dynamic_cast<vectorbaseimpl<doublevector, vectorref<double>> &>(logEframescorrect),
+                                                         dynamic_cast<vectorbaseimpl<doublevector, vectorref<double>> &>(latticetotals));
+    }
+
     void sMBRerrorsignal(const ushortvector &alignstateids,
                          const uintvector &alignoffsets,
                          const edgeinfowithscoresvector &edges, const nodeinfovector &nodes,
@@ -183,6 +243,28 @@ private:
                                              logEframescorrecttotal, dengammasMatrixRef, dengammasbufMatrixRef);
     }
 
+    void sMBRerrorsignalbatch(const ushortvector &alignstateids, const uintvector &alignoffsets,
+                              const edgeinfowithscoresvector &edges, const nodeinfovector &nodes,
+                              const uintvector &edgelattices, const doublevector &logpps, const float amf,
+                              const doublevector &logEframescorrect, const doublevector &latticetotals,
+                              Microsoft::MSR::CNTK::Matrix<float> &dengammas, Microsoft::MSR::CNTK::Matrix<float> &dengammasbuf)
+    {
+        ondevice no(deviceid);
+
+        matrixref<float> dengammasMatrixRef = tomatrixref(dengammas);
+        matrixref<float> dengammasbufMatrixRef = tomatrixref(dengammasbuf);
+        latticefunctionsops::sMBRerrorsignalbatch(dynamic_cast<const vectorbaseimpl<ushortvector, vectorref<unsigned short>> &>(alignstateids),
+                                                  dynamic_cast<const vectorbaseimpl<uintvector, vectorref<unsigned int>> &>(alignoffsets),
+                                                  dynamic_cast<const vectorbaseimpl<edgeinfowithscoresvector, vectorref<msra::lattices::edgeinfowithscores>> &>(edges),
+                                                  dynamic_cast<const vectorbaseimpl<nodeinfovector, vectorref<msra::lattices::nodeinfo>> &>(nodes),
+                                                  dynamic_cast<const vectorbaseimpl<uintvector, vectorref<unsigned int>> &>(edgelattices),
+                                                  dynamic_cast<const vectorbaseimpl<doublevector, vectorref<double>> &>(logpps),
+                                                  amf,
+                                                  dynamic_cast<const vectorbaseimpl<doublevector, vectorref<double>> &>(logEframescorrect),
+                                                  dynamic_cast<const vectorbaseimpl<doublevector, vectorref<double>> &>(latticetotals),
+                                                  dengammasMatrixRef, dengammasbufMatrixRef);
+    }
+
     void mmierrorsignal(const ushortvector &alignstateids, const uintvector &alignoffsets,
                         const edgeinfowithscoresvector &edges, const nodeinfovector &nodes,
                         const doublevector &logpps, Microsoft::MSR::CNTK::Matrix<float> &dengammas)
@@ -212,6 +294,13 @@ private:
                                              dynamic_cast<const vectorbaseimpl<doublevector, vectorref<double>> &>(logqs),
                                              logaccMatrixRef);
     }
+
+    void pruneedges(const doublevector &logpps, const double logppthreshold, ushortvector &keepedges)
+    {
+        ondevice no(deviceid);
+        latticefunctionsops::pruneedges(dynamic_cast<const vectorbaseimpl<doublevector, vectorref<double>> &>(logpps), logppthreshold,
+                                        dynamic_cast<vectorbaseimpl<ushortvector, vectorref<unsigned short>> &>(keepedges));
+    }
 };
 
 latticefunctions *newlatticefunctions(size_t deviceid)
@@ -87,6 +87,11 @@ struct latticefunctions : public vectorbase<msra::lattices::empty>
                                const edgeinfowithscoresvector& edges, const aligninfovector& aligns,
                                const uintvector& alignoffsets, ushortvector& backptrstorage, const sizetvector& backptroffsets,
                                ushortvector& alignresult, floatvector& edgeacscores) = 0; // output
+    virtual void packlattice(const edgeinfowithscoresvector& edges, const nodeinfovector& nodes, const aligninfovector& aligns,
+                             const uintvector& alignoffsets, const sizetvector& backptroffsets, const size_t edgeoffset, const size_t nodeoffset,
+                             const size_t alignoffset, const size_t frameoffset, const unsigned int alignbase, const size_t backptrbase,
+                             edgeinfowithscoresvector& packededges, nodeinfovector& packednodes, aligninfovector& packedaligns,
+                             uintvector& packedalignoffsets, sizetvector& packedbackptroffsets) = 0;
     virtual void forwardbackwardlattice(const size_t* batchsizeforward, const size_t* batchsizebackward,
                                         const size_t numlaunchforward, const size_t numlaunchbackward,
                                         const size_t spalignunitid, const size_t silalignunitid,
@@ -99,16 +104,36 @@ struct latticefunctions : public vectorbase<msra::lattices::empty>
                                         doublevector& logaccalphas, doublevector& logaccbetas,
                                         doublevector& logframescorrectedge, doublevector& logEframescorrect,
                                         doublevector& Eframescorrectbuf, double& logEframescorrecttotal, double& totalfwscore) = 0;
+    virtual void forwardbackwardlatticebatch(const size_t* batchsizeforward, const size_t* batchsizebackward,
+                                             const size_t numlaunchforward, const size_t numlaunchbackward,
+                                             const uintvector& forwardorder, const uintvector& backwardorder,
+                                             const uintvector& edgelattices, const uintvector& latticenodeoffsets,
+                                             const size_t spalignunitid, const size_t silalignunitid,
+                                             const floatvector& edgeacscores, const edgeinfowithscoresvector& edges,
+                                             const nodeinfovector& nodes, const aligninfovector& aligns,
+                                             const ushortvector& alignoutput, const uintvector& alignoffsets,
+                                             doublevector& logpps, doublevector& logalphas, doublevector& logbetas,
+                                             const float lmf, const float wp, const float amf, const float boostingfactor, const bool returnEframescorrect,
+                                             const ushortvector& uids, const ushortvector& senone2classmap,
+                                             doublevector& logaccalphas, doublevector& logaccbetas,
+                                             doublevector& logframescorrectedge, doublevector& logEframescorrect,
+                                             doublevector& latticetotals) = 0;
     virtual void sMBRerrorsignal(const ushortvector& alignstateids, const uintvector& alignoffsets,
                                  const edgeinfowithscoresvector& edges, const nodeinfovector& nodes,
                                  const doublevector& logpps, const float amf, const doublevector& logEframescorrect,
                                  const double logEframescorrecttotal, Microsoft::MSR::CNTK::Matrix<float>& dengammas, Microsoft::MSR::CNTK::Matrix<float>& dengammasbuf) = 0;
+    virtual void sMBRerrorsignalbatch(const ushortvector& alignstateids, const uintvector& alignoffsets,
+                                      const edgeinfowithscoresvector& edges, const nodeinfovector& nodes,
+                                      const uintvector& edgelattices, const doublevector& logpps, const float amf,
+                                      const doublevector& logEframescorrect, const doublevector& latticetotals,
+                                      Microsoft::MSR::CNTK::Matrix<float>& dengammas, Microsoft::MSR::CNTK::Matrix<float>& dengammasbuf) = 0;
     virtual void mmierrorsignal(const ushortvector& alignstateids, const uintvector& alignoffsets,
                                 const edgeinfowithscoresvector& edges, const nodeinfovector& nodes,
                                 const doublevector& logpps, Microsoft::MSR::CNTK::Matrix<float>& dengammas) = 0;
     virtual void stateposteriors(const ushortvector& alignstateids, const uintvector& alignoffsets,
                                  const edgeinfowithscoresvector& edges, const nodeinfovector& nodes,
                                  const doublevector& logqs, Microsoft::MSR::CNTK::Matrix<float>& logacc) = 0;
+    virtual void pruneedges(const doublevector& logpps, const double logppthreshold, ushortvector& keepedges) = 0;
 };
 
 // ---------------------------------------------------------------------------
@@ -200,7 +200,7 @@ __global__ void forwardlatticej(const size_t batchsize, const size_t startindex,
     const size_t j = msra::lattices::latticefunctionskernels::shuffle(threadIdx.x, blockDim.x, threadIdx.y, blockDim.y, blockIdx.x, gridDim.x, shufflemode);
     if (j < batchsize) // note: will cause issues if we ever use __synctreads()
     {
-        msra::lattices::latticefunctionskernels::forwardlatticej(j + startindex, edgeacscores, spalignunitid, silalignunitid, edges, nodes, aligns, alignments, alignmentoffsets,
+        msra::lattices::latticefunctionskernels::forwardlatticej(j + startindex, edgeacscores, spalignunitid, silalignunitid, edges, nodes, 0, nodes.size() - 1, aligns, alignments, alignmentoffsets,
                                                                  logalphas, lmf, wp, amf, boostingfactor, uids, senone2classmap, returnEframescorrect, logframescorrectedge, logaccalphas);
     }
 }
@@ -220,7 +220,7 @@ __global__ void backwardlatticej(const size_t batchsize, const size_t startindex
     if (j < batchsize) // note: will cause issues if we ever use __synctreads()
     {
         msra::lattices::latticefunctionskernels::backwardlatticej(j + startindex, edgeacscores, spalignunitid, silalignunitid,
-                                                                  edges, nodes, aligns, totalfwscore, logpps, logalphas, logbetas,
+                                                                  edges, nodes, 0, nodes.size() - 1, aligns, totalfwscore, logpps, logalphas, logbetas,
                                                                   lmf, wp, amf, boostingfactor, returnEframescorrect,
                                                                   logframescorrectedge, logaccalphas,
                                                                   logEframescorrect, logaccbetas);
@@ -326,6 +326,226 @@ void latticefunctionsops::forwardbackwardlattice(const size_t *batchsizeforward,
     }
 }
 
+// -----------------------------------------------------------------------
+// packlattice -- copy a lattice that is cached on the device into the packed lattice of a minibatch
+// Node, alignment and frame indices are offset as in lattice::forwardbackwardbatch(); the offsets
+// arrays have one extra element, which the next lattice overwrites with the same value.
+// -----------------------------------------------------------------------
+
+__global__ void packlatticej(const vectorref<msra::lattices::edgeinfowithscores> edges, const vectorref<msra::lattices::nodeinfo> nodes,
+                             const vectorref<msra::lattices::aligninfo> aligns, const vectorref<unsigned int> alignoffsets,
+                             const vectorref<size_t> backptroffsets, const size_t edgeoffset, const size_t nodeoffset,
+                             const size_t alignoffset, const size_t frameoffset, const unsigned int alignbase, const size_t backptrbase,
+                             vectorref<msra::lattices::edgeinfowithscores> packededges, vectorref<msra::lattices::nodeinfo> packednodes,
+                             vectorref<msra::lattices::aligninfo> packedaligns, vectorref<unsigned int> packedalignoffsets,
+                             vectorref<size_t> packedbackptroffsets)
+{
+    const size_t j = threadIdx.x + (blockIdx.x * blockDim.x);
+    if (j < edges.size())
+    {
+        msra::lattices::edgeinfowithscores e = edges[j];
+        e.S = e.S + nodeoffset;
+        e.E = e.E + nodeoffset;
+        e.firstalign = e.firstalign + alignoffset;
+        packededges[edgeoffset + j] = e;
+    }
+    if (j < nodes.size())
+    {
+        msra::lattices::nodeinfo n = nodes[j];
+        n.t = (unsigned short) (n.t + frameoffset);
+        packednodes[nodeoffset + j] = n;
+    }
+    if (j < aligns.size())
+        packedaligns[alignoffset + j] = aligns[j];
+    if (j < alignoffsets.size())
+    {
+        packedalignoffsets[edgeoffset + j] = alignbase + alignoffsets[j];
+        packedbackptroffsets[edgeoffset + j] = backptrbase + backptroffsets[j];
+    }
+}
+
+void latticefunctionsops::packlattice(const vectorref<msra::lattices::edgeinfowithscores> &edges, const vectorref<msra::lattices::nodeinfo> &nodes,
+                                      const vectorref<msra::lattices::aligninfo> &aligns, const vectorref<unsigned int> &alignoffsets,
+                                      const vectorref<size_t> &backptroffsets, const size_t edgeoffset, const size_t nodeoffset,
+                                      const size_t alignoffset, const size_t frameoffset, const unsigned int alignbase, const size_t backptrbase,
+                                      vectorref<msra::lattices::edgeinfowithscores> &packededges, vectorref<msra::lattices::nodeinfo> &packednodes,
+                                      vectorref<msra::lattices::aligninfo> &packedaligns, vectorref<unsigned int> &packedalignoffsets,
+                                      vectorref<size_t> &packedbackptroffsets) const
+{
+    size_t n = alignoffsets.size(); // = #edges + 1
+    if (n < nodes.size())
+        n = nodes.size();
+    if (n < aligns.size())
+        n = aligns.size();
+    packlatticej<<<dim3((unsigned int) ((n + 255) / 256)), 256, 0, GetCurrentStream()>>>(edges, nodes, aligns, alignoffsets, backptroffsets,
+                                                                                         edgeoffset, nodeoffset, alignoffset, frameoffset, alignbase, backptrbase,
+                                                                                         packededges, packednodes, packedaligns, packedalignoffsets, packedbackptroffsets);
+    checklaunch("packlatticej");
+}
+
+// -----------------------------------------------------------------------
+// forwardbackwardlatticebatch -- forward-backward over the lattices of a minibatch, packed into one node and edge array
+// Lattice l owns the nodes [latticenodeoffsets[l], latticenodeoffsets[l+1]); edgelattices[j] is the lattice of edge j.
+// Launch i processes the i-th data-independent batch of edges of every lattice at once, as listed in forwardorder
+// (resp. backwardorder). The per-lattice totals stay on the device, in latticetotals[4 * l + k], with
+// k = 0: forward score, 1: backward score, 2: forward frames-correct, 3: backward frames-correct (logEframescorrecttotal).
+// -----------------------------------------------------------------------
+
+__global__ void setlatticeinitialtokensj(const vectorref<unsigned int> latticenodeoffsets, vectorref<double> logalphas, vectorref<double> logbetas)
+{
+    const size_t l = threadIdx.x + (blockIdx.x * blockDim.x);
+    if (l + 1 < latticenodeoffsets.size())
+    {
+        logalphas[latticenodeoffsets[l]] = 0.0;
+        logbetas[latticenodeoffsets[l + 1] - 1] = 0.0;
+    }
+}
+
+__global__ void forwardlatticebatchj(const size_t batchsize, const size_t startindex, const vectorref<unsigned int> forwardorder,
+                                     const vectorref<unsigned int> edgelattices, const vectorref<unsigned int> latticenodeoffsets,
+                                     const vectorref<float> edgeacscores, const size_t spalignunitid, const size_t silalignunitid,
+                                     vectorref<msra::lattices::edgeinfowithscores> edges, vectorref<msra::lattices::nodeinfo> nodes,
+                                     const vectorref<msra::lattices::aligninfo> aligns, vectorref<unsigned short> alignments,
+                                     vectorref<unsigned int> alignmentoffsets, vectorref<double> logalphas, float lmf, float wp, float amf,
+                                     const float boostingfactor, const vectorref<unsigned short> uids, const vectorref<unsigned short> senone2classmap,
+                                     const bool returnEframescorrect, vectorref<double> logframescorrectedge, vectorref<double> logaccalphas)
+{
+    const size_t shufflemode = 1;
+    const size_t k = msra::lattices::latticefunctionskernels::shuffle(threadIdx.x, blockDim.x, threadIdx.y, blockDim.y, blockIdx.x, gridDim.x, shufflemode);
+    if (k < batchsize)
+    {
+        const size_t j = forwardorder[k + startindex];
+        const size_t l = edgelattices[j];
+        msra::lattices::latticefunctionskernels::forwardlatticej(j, edgeacscores, spalignunitid, silalignunitid, edges, nodes,
+                                                                 latticenodeoffsets[l], latticenodeoffsets[l + 1] - 1, aligns, alignments, alignmentoffsets,
+                                                                 logalphas, lmf, wp, amf, boostingfactor, uids, senone2classmap, returnEframescorrect, logframescorrectedge, logaccalphas);
+    }
+}
+
+__global__ void backwardlatticebatchj(const size_t batchsize, const size_t startindex, const vectorref<unsigned int> backwardorder,
+                                      const vectorref<unsigned int> edgelattices, const vectorref<unsigned int> latticenodeoffsets,
+                                      const vectorref<float> edgeacscores, const size_t spalignunitid, const size_t silalignunitid,
+                                      vectorref<msra::lattices::edgeinfowithscores> edges, vectorref<msra::lattices::nodeinfo> nodes,
+                                      vectorref<msra::lattices::aligninfo> aligns, const vectorref<double> latticetotals,
+                                      vectorref<double> logpps, vectorref<double> logalphas, vectorref<double> logbetas,
+                                      float lmf, float wp, float amf, const float boostingfactor, const bool returnEframescorrect,
+                                      vectorref<double> logframescorrectedge, vectorref<double> logaccalphas,
+                                      vectorref<double> logEframescorrect, vectorref<double> logaccbetas)
+{
+    const size_t tpb = blockDim.x * blockDim.y; // total #threads in a block
+    const size_t kinblock = threadIdx.x + threadIdx.y * blockDim.x;
+    const size_t k = kinblock + blockIdx.x * tpb;
+    if (k < batchsize)
+    {
+        const size_t j = backwardorder[k + startindex];
+        const size_t l = edgelattices[j];
+        msra::lattices::latticefunctionskernels::backwardlatticej(j, edgeacscores, spalignunitid, silalignunitid,
+                                                                  edges, nodes, latticenodeoffsets[l], latticenodeoffsets[l + 1] - 1, aligns,
+                                                                  latticetotals[4 * l], logpps, logalphas, logbetas,
+                                                                  lmf, wp, amf, boostingfactor, returnEframescorrect,
+                                                                  logframescorrectedge, logaccalphas,
+                                                                  logEframescorrect, logaccbetas);
+    }
+}
+
+// the total forward scores are read at the end node of each lattice, the total backward scores at its start node
+__global__ void latticetotalsj(const vectorref<unsigned int> latticenodeoffsets, const bool forward, const bool returnEframescorrect,
+                               const vectorref<double> logscores, const vectorref<double> logaccscores, vectorref<double> latticetotals)
+{
+    const size_t l = threadIdx.x + (blockIdx.x * blockDim.x);
+    if (l + 1 < latticenodeoffsets.size())
+    {
+        const size_t node = forward ? latticenodeoffsets[l + 1] - 1 : latticenodeoffsets[l];
+        const size_t k = forward ? 0 : 1;
+        latticetotals[4 * l + k] = logscores[node];
+        latticetotals[4 * l + k + 2] = returnEframescorrect ? logaccscores[node] - logscores[node] : LOGZERO;
+    }
+}
+
+// a lattice without any path gets no edge posteriors, so that it contributes nothing to the error signal
+__global__ void clearfailedlatticesj(const vectorref<unsigned int> edgelattices, const vectorref<double> latticetotals, vectorref<double> logpps)
+{
+    const size_t j = threadIdx.x + (blockIdx.x * blockDim.x);
+    if (j < logpps.size() && latticetotals[4 * edgelattices[j]] < LOGZERO / 2)
+        logpps[j] = LOGZERO;
+}
+
+void latticefunctionsops::forwardbackwardlatticebatch(const size_t *batchsizeforward, const size_t *batchsizebackward,
+                                                      const size_t numlaunchforward, const size_t numlaunchbackward,
+                                                      const vectorref<unsigned int> &forwardorder, const vectorref<unsigned int> &backwardorder,
+                                                      const vectorref<unsigned int> &edgelattices, const vectorref<unsigned int> &latticenodeoffsets,
+                                                      const size_t spalignunitid, const size_t silalignunitid,
+                                                      const vectorref<float> &edgeacscores,
+                                                      const vectorref<msra::lattices::edgeinfowithscores> &edges,
+                                                      const vectorref<msra::lattices::nodeinfo> &nodes,
+                                                      const vectorref<msra::lattices::aligninfo> &aligns,
+                                                      const vectorref<unsigned short> &alignments,
+                                                      const vectorref<unsigned int> &aligmentoffsets,
+                                                      vectorref<double> &logpps, vectorref<double> &logalphas, vectorref<double> &logbetas,
+                                                      const float lmf, const float wp, const float amf, const float boostingfactor,
+                                                      const bool returnEframescorrect, const vectorref<unsigned short> &uids,
+                                                      const vectorref<unsigned short> &senone2classmap, vectorref<double> &logaccalphas,
+                                                      vectorref<double> &logaccbetas, vectorref<double> &logframescorrectedge,
+                                                      vectorref<double> &logEframescorrect, vectorref<double> &latticetotals) const
+{
+    // initialize log{,acc}(alhas/betas)
+    dim3 t(32, 8);
+    const size_t tpb = t.x * t.y;
+    dim3 b((unsigned int) ((logalphas.size() + tpb - 1) / tpb));
+
+    setvaluej<<<b, t, 0, GetCurrentStream()>>>(logalphas, LOGZERO, logalphas.size());
+    checklaunch("setvaluej");
+    setvaluej<<<b, t, 0, GetCurrentStream()>>>(logbetas, LOGZERO, logalphas.size());
+    checklaunch("setvaluej");
+    if (returnEframescorrect)
+    {
+        setvaluej<<<b, t, 0, GetCurrentStream()>>>(logaccalphas, LOGZERO, logalphas.size());
+        checklaunch("setvaluej");
+        setvaluej<<<b, t, 0, GetCurrentStream()>>>(logaccbetas, LOGZERO, logalphas.size());
+        checklaunch("setvaluej");
+    }
+    // set the initial tokens of each lattice to probability 1 (0 in log)
+    const size_t numlattices = latticenodeoffsets.size() - 1;
+    dim3 bl((unsigned int) ((numlattices + 31) / 32));
+    setlatticeinitialtokensj<<<bl, 32, 0, GetCurrentStream()>>>(latticenodeoffsets, logalphas, logbetas);
+    checklaunch("setlatticeinitialtokensj");
+
+    // forward pass
+    size_t startindex = 0;
+    for (size_t i = 0; i < numlaunchforward; i++)
+    {
+        dim3 b((unsigned int) ((batchsizeforward[i] + tpb - 1) / tpb));
+        forwardlatticebatchj<<<b, t, 0, GetCurrentStream()>>>(batchsizeforward[i], startindex, forwardorder, edgelattices, latticenodeoffsets,
+                                                              edgeacscores, spalignunitid, silalignunitid, edges, nodes, aligns,
+                                                              alignments, aligmentoffsets, logalphas, lmf, wp, amf,
+                                                              boostingfactor, uids, senone2classmap, returnEframescorrect,
+                                                              logframescorrectedge, logaccalphas);
+        checklaunch("forwardlatticebatchj");
+        startindex += batchsizeforward[i];
+    }
+    latticetotalsj<<<bl, 32, 0, GetCurrentStream()>>>(latticenodeoffsets, true /*forward*/, returnEframescorrect, logalphas, logaccalphas, latticetotals);
+    checklaunch("latticetotalsj");
+
+    // backward pass; the order lists each launch front to back
+    startindex = 0;
+    for (size_t i = 0; i < numlaunchbackward; i++)
+    {
+        dim3 b((unsigned int) ((batchsizebackward[i] + tpb - 1) / tpb));
+        backwardlatticebatchj<<<b, t, 0, GetCurrentStream()>>>(batchsizebackward[i], startindex, backwardorder, edgelattices, latticenodeoffsets,
+                                                               edgeacscores, spalignunitid, silalignunitid, edges, nodes, aligns,
+                                                               latticetotals, logpps, logalphas, logbetas,
+                                                               lmf, wp, amf, boostingfactor, returnEframescorrect, logframescorrectedge,
+                                                               logaccalphas, logEframescorrect, logaccbetas);
+        checklaunch("backwardlatticebatchj");
+        startindex += batchsizebackward[i];
+    }
+    latticetotalsj<<<bl, 32, 0, GetCurrentStream()>>>(latticenodeoffsets, false /*forward*/, returnEframescorrect, logbetas, logaccbetas, latticetotals);
+    checklaunch("latticetotalsj");
+
+    clearfailedlatticesj<<<dim3((unsigned int) ((logpps.size() + 255) / 256)), 256, 0, GetCurrentStream()>>>(edgelattices, latticetotals, logpps);
+    checklaunch("clearfailedlatticesj");
+}
+
 // -----------------------------------------------------------------------
 // sMBRerrorsignal -- accumulate difference of logEframescorrect and logEframescorrecttotal into errorsignal
 // -----------------------------------------------------------------------
@@ -343,6 +563,22 @@ __global__ void sMBRerrorsignalj(const vectorref<unsigned short> alignstateids,
     }
 }
 
+// sMBRerrorsignalbatchj -- as sMBRerrorsignalj, with the logEframescorrecttotal of the lattice of each edge
+__global__ void sMBRerrorsignalbatchj(const vectorref<unsigned short> alignstateids, const vectorref<unsigned int> alignoffsets,
+                                      const vectorref<msra::lattices::edgeinfowithscores> edges, const vectorref<msra::lattices::nodeinfo> nodes,
+                                      const vectorref<unsigned int> edgelattices, vectorref<double> logpps, const float amf,
+                                      const vectorref<double> logEframescorrect, const vectorref<double> latticetotals,
+                                      matrixref<float> errorsignal, matrixref<float> errorsignalneg)
+{
+    const size_t shufflemode = 1;
+    const size_t j = msra::lattices::latticefunctionskernels::shuffle(threadIdx.x, blockDim.x, threadIdx.y, blockDim.y, blockIdx.x, gridDim.x, shufflemode);
+    if (j < edges.size())
+    {
+        const double logEframescorrecttotal = latticetotals[4 * edgelattices[j] + 3];
+        msra::lattices::latticefunctionskernels::sMBRerrorsignalj(j, alignstateids, alignoffsets, edges, nodes, logpps, amf, logEframescorrect, logEframescorrecttotal, errorsignal, errorsignalneg);
+    }
+}
+
 // -----------------------------------------------------------------------
 // stateposteriors --accumulate a per-edge quantity into the states that the edge is aligned with
 // -----------------------------------------------------------------------
@@ -433,6 +669,31 @@ void latticefunctionsops::sMBRerrorsignal(const vectorref<unsigned short> &align
 #endif
 }
 
+void latticefunctionsops::sMBRerrorsignalbatch(const vectorref<unsigned short> &alignstateids, const vectorref<unsigned int> &alignoffsets,
+                                               const vectorref<msra::lattices::edgeinfowithscores> &edges, const vectorref<msra::lattices::nodeinfo> &nodes,
+                                               const vectorref<unsigned int> &edgelattices, const vectorref<double> &logpps, const float amf,
+                                               const vectorref<double> &logEframescorrect, const vectorref<double> &latticetotals,
+                                               matrixref<float> &errorsignal, matrixref<float> &errorsignalauxbuf) const
+{
+    const size_t numedges = edges.size();
+    dim3 t(32, 8);
+    const size_t tpb = t.x * t.y;
+    dim3 b((unsigned int) ((numedges + tpb - 1) / tpb));
+
+    setvaluei<<<dim3((((unsigned int) errorsignal.rows()) + 31) / 32), 32, 0, GetCurrentStream()>>>(errorsignal, LOGZERO);
+    checklaunch("setvaluei");
+    setvaluei<<<dim3((((unsigned int) errorsignalauxbuf.rows()) + 31) / 32), 32, 0, GetCurrentStream()>>>(errorsignalauxbuf, LOGZERO);
+    checklaunch("setvaluei");
+    sMBRerrorsignalbatchj<<<b, t, 0, GetCurrentStream()>>>(alignstateids, alignoffsets, edges, nodes, edgelattices, logpps, amf, logEframescorrect, latticetotals, errorsignal, errorsignalauxbuf);
+    checklaunch("sMBRerrorsignalbatch");
+
+    setunseeni<<<dim3((((unsigned int) errorsignal.rows()) + 31) / 32), 32, 0, GetCurrentStream()>>>(errorsignal, errorsignalauxbuf);
+    checklaunch("setunseenj");
+
+    errorcomputationi<<<dim3((((unsigned int) errorsignal.rows()) + 31) / 32), 32, 0, GetCurrentStream()>>>(errorsignal, errorsignalauxbuf, amf);
+    checklaunch("errorcomputationj");
+}
+
 void latticefunctionsops::mmierrorsignal(const vectorref<unsigned short> &alignstateids, const vectorref<unsigned int> &alignoffsets,
                                          const vectorref<msra::lattices::edgeinfowithscores> &edges, const vectorref<msra::lattices::nodeinfo> &nodes,
                                          const vectorref<double> &logpps, matrixref<float> &errorsignal) const
@@ -451,5 +712,24 @@ void latticefunctionsops::mmierrorsignal(const vectorref<unsigned short> &aligns
     expfi<<<dim3((((unsigned int) errorsignal.rows()) + 31) / 32), 32, 0, GetCurrentStream()>>>(errorsignal);
     checklaunch("expfi");
 }
+
+// -----------------------------------------------------------------------
+// pruneedges -- mark the edges whose posterior is within the beam, for lattice::prune()
+// Only the flags are read back, not the posteriors.
+// -----------------------------------------------------------------------
+
+__global__ void pruneedgesj(const vectorref<double> logpps, const double logppthreshold, vectorref<unsigned short> keepedges)
+{
+    const size_t j = threadIdx.x + (blockIdx.x * blockDim.x);
+    if (j < logpps.size())
+        keepedges[j] = logpps[j] >= logppthreshold ? 1 : 0;
+}
+
+void latticefunctionsops::pruneedges(const vectorref<double> &logpps, const double logppthreshold, vectorref<unsigned short> &keepedges) const
+{
+    const size_t numedges = logpps.size();
+    pruneedgesj<<<dim3((unsigned int) ((numedges + 255) / 256)), 256, 0, GetCurrentStream()>>>(logpps, logppthreshold, keepedges);
+    checklaunch("pruneedgesj");
+}
 };
 };
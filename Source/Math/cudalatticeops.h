@@ -39,6 +39,14 @@ protected:
                        vectorref<unsigned short>& backptrstorage, const vectorref<size_t>& backptroffsets,
                        vectorref<unsigned short>& alignresult, vectorref<float>& edgeacscores) const; // output
 
+    void packlattice(const vectorref<msra::lattices::edgeinfowithscores>& edges, const vectorref<msra::lattices::nodeinfo>& nodes,
+                     const vectorref<msra::lattices::aligninfo>& aligns, const vectorref<unsigned int>& alignoffsets,
+                     const vectorref<size_t>& backptroffsets, const size_t edgeoffset, const size_t nodeoffset,
+                     const size_t alignoffset, const size_t frameoffset, const unsigned int alignbase, const size_t backptrbase,
+                     vectorref<msra::lattices::edgeinfowithscores>& packededges, vectorref<msra::lattices::nodeinfo>& packednodes,
+                     vectorref<msra::lattices::aligninfo>& packedaligns, vectorref<unsigned int>& packedalignoffsets,
+                     vectorref<size_t>& packedbackptroffsets) const;
+
     void forwardbackwardlattice(const size_t* batchsizeforward, const size_t* batchsizebackward,
                                 const size_t numlaunchforward, const size_t numlaunchbackward,
                                 const size_t spalignunitid, const size_t silalignunitid,
@@ -53,11 +61,34 @@ protected:
                                 vectorref<double>& logframescorrectedge, vectorref<double>& logEframescorrect, vectorref<double>& Eframescorrectbuf,
                                 double& logEframescorrecttotal, double& totalfwscore) const;
 
+    // the lattices of a minibatch packed into one, see forwardbackwardlatticebatch in cudalatticeops.cu.h
+    void forwardbackwardlatticebatch(const size_t* batchsizeforward, const size_t* batchsizebackward,
+                                     const size_t numlaunchforward, const size_t numlaunchbackward,
+                                     const vectorref<unsigned int>& forwardorder, const vectorref<unsigned int>& backwardorder,
+                                     const vectorref<unsigned int>& edgelattices, const vectorref<unsigned int>& latticenodeoffsets,
+                                     const size_t spalignunitid, const size_t silalignunitid,
+                                     const vectorref<float>& edgeacscores, const vectorref<msra::lattices::edgeinfowithscores>& edges,
+                                     const vectorref<msra::lattices::nodeinfo>& nodes,
+                                     const vectorref<msra::lattices::aligninfo>& aligns, const vectorref<unsigned short>& aligments,
+                                     const vectorref<unsigned int>& aligmentoffsets,
+                                     vectorref<double>& logpps, vectorref<double>& logalphas, vectorref<double>& logbetas,
+                                     const float lmf, const float wp, const float amf, const float boostingfactor, const bool returnEframescorrect,
+                                     const vectorref<unsigned short>& uids, const vectorref<unsigned short>& senone2classmap,
+                                     vectorref<double>& logaccalphas, vectorref<double>& logaccbetas,
+                                     vectorref<double>& logframescorrectedge, vectorref<double>& logEframescorrect,
+                                     vectorref<double>& latticetotals) const;
+
     void sMBRerrorsignal(const vectorref<unsigned short>& alignstateids, const vectorref<unsigned int>& alignoffsets,
                          const vectorref<msra::lattices::edgeinfowithscores>& edges, const vectorref<msra::lattices::nodeinfo>& nodes,
                          const vectorref<double>& logpps, const float amf, const vectorref<double>& logEframescorrect, const double logEframescorrecttotal,
                          matrixref<float>& errorsignal, matrixref<float>& errorsignalneg) const;
 
+    void sMBRerrorsignalbatch(const vectorref<unsigned short>& alignstateids, const vectorref<unsigned int>& alignoffsets,
+                              const vectorref<msra::lattices::edgeinfowithscores>& edges, const vectorref<msra::lattices::nodeinfo>& nodes,
+                              const vectorref<unsigned int>& edgelattices, const vectorref<double>& logpps, const float amf,
+                              const vectorref<double>& logEframescorrect, const vectorref<double>& latticetotals,
+                              matrixref<float>& errorsignal, matrixref<float>& errorsignalneg) const;
+
     void mmierrorsignal(const vectorref<unsigned short>& alignstateids, const vectorref<unsigned int>& alignoffsets,
                         const vectorref<msra::lattices::edgeinfowithscores>& edges, const vectorref<msra::lattices::nodeinfo>& nodes,
                         const vectorref<double>& logpps, matrixref<float>& errorsignal) const;
@@ -65,6 +96,8 @@ protected:
     void stateposteriors(const vectorref<unsigned short>& alignstateids, const vectorref<unsigned int>& alignoffsets,
                          const vectorref<msra::lattices::edgeinfowithscores>& edges, const vectorref<msra::lattices::nodeinfo>& nodes,
                          const vectorref<double>& logqs, matrixref<float>& logacc) const;
+
+    void pruneedges(const vectorref<double>& logpps, const double logppthreshold, vectorref<unsigned short>& keepedges) const;
 };
 };
 };
@@ -654,10 +654,13 @@ struct latticefunctionskernels
 
     // Phase 1 of forwardbackward algorithm
     // returnEframescorrect means sMBR mode
+    // firstnode/lastnode are the start and end nodes of the lattice of edge j; they differ from 0 and nodes.size()-1 when
+    // the lattices of a minibatch are packed into one node array (the silence channel is still at + nodes.size())
     template <typename edgeinforvector, typename nodeinfovector, typename aligninfovector, typename ushortvector, typename uintvector, typename floatvector, typename doublevector>
     static inline __device__ void forwardlatticej(const size_t j, const floatvector &edgeacscores,
                                                   const size_t /*spalignunitid --unused*/, const size_t silalignunitid,
-                                                  const edgeinforvector &edges, const nodeinfovector &nodes, const aligninfovector &aligns,
+                                                  const edgeinforvector &edges, const nodeinfovector &nodes,
+                                                  const size_t firstnode, const size_t lastnode, const aligninfovector &aligns,
                                                   const ushortvector &alignments, const uintvector &alignmentoffsets,
                                                   doublevector &logalphas, float lmf, float wp, float amf, const float boostingfactor,
                                                   const ushortvector &uids, const ushortvector senone2classmap, const bool returnEframescorrect,
@@ -732,7 +735,7 @@ struct latticefunctionskernels
 
 #ifdef FORBID_INVALID_SIL_PATHS
         // silence edge or second speech edge
-        if ((isaddedsil && e.E != nodes.size() - 1) || (forbidinvalidsilpath && e.S != 0))
+        if ((isaddedsil && e.E != lastnode) || (forbidinvalidsilpath && e.S != firstnode))
         {
             const size_t S = (size_t)(!isaddedsil ? e.S + nodes.size() : e.S); // second speech edge comes from special 'silence state' node
             const size_t E = (size_t)(isaddedsil ? e.E + nodes.size() : e.E);  // silence edge goes into special 'silence state' node
@@ -756,6 +759,7 @@ struct latticefunctionskernels
     static inline __device__ void backwardlatticej(size_t j, const floatvector &edgeacscores,
                                                    const size_t /*spalignunitid --unused*/, const size_t /*silalignunitid --unused*/,
                                                    const edgeinforvector &edges, const nodeinfovector &nodes,
+                                                   const size_t firstnode, const size_t lastnode,
                                                    const aligninfovector & /*aligns -- unused*/, const double totalfwscore, doublevector &logpps,
                                                    doublevector &logalphas, doublevector &logbetas, float lmf, float wp,
                                                    float amf, const float boostingfactor, const bool returnEframescorrect,
@@ -837,7 +841,7 @@ struct latticefunctionskernels
         double logEframescorrectj2 = LOGZERO;
 
         // silence edge or second speech edge
-        if ((isaddedsil && e.E != nodes.size() - 1) || (forbidinvalidsilpath && e.S != 0))
+        if ((isaddedsil && e.E != lastnode) || (forbidinvalidsilpath && e.S != firstnode))
         {
             const size_t S = (size_t)(!isaddedsil ? e.S + nodes.size() : e.S); // second speech edge comes from special 'silence state' node
             const size_t E = (size_t)(isaddedsil ? e.E + nodes.size() : e.E);  // silence edge goes into special 'silence state' node
@@ -882,6 +886,8 @@ struct latticefunctionskernels
         }
 #else
         nodes;
+        firstnode;
+        lastnode;
 #endif
 
         // write back return values
@@ -9,7 +9,16 @@
 #include "DataReader.h"
 #include "BinaryReader.h"
 #include <limits.h>
+#include <float.h>
 #include <stdint.h>
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/file.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#endif
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -27,6 +36,8 @@ DWORD LODWORD(size_t size)
 // fileName - file to read or create (if it doesn't exist)
 // options - file options, (fileOptionsReadWrite and fileOptionsRead are accepted)
 // size - size of the file to map, will expand/contract existing files to given size. zero means keep current size
+#ifdef _WIN32
+
 BinaryFile::BinaryFile(std::wstring fileName, FileOptions options, size_t size)
 {
 
@@ -103,6 +114,91 @@ BinaryFile::~BinaryFile()
     CloseHandle(m_hndFile);
 }
 
+#else
+
+BinaryFile::BinaryFile(std::wstring fileName, FileOptions options, size_t size)
+    : m_fd(-1), m_fileMapping(nullptr)
+{
+    m_viewAlignment = (size_t) sysconf(_SC_PAGESIZE);
+    m_writeFile = options == fileOptionsReadWrite;
+    m_name = fileName;
+    m_maxViewSize = 0x10000000; // 256MB initial max size
+
+    if (m_writeFile)
+    {
+        // Write under a temporary name, and only while no other process writes the same file.
+        // The lock goes away with the process, so a crashed writer leaves a .partial file that the next writer reuses.
+        m_writeName = fileName + L".partial";
+        m_fd = open(msra::strfun::utf8(m_writeName).c_str(), O_RDWR | O_CREAT, 0644);
+        if (m_fd == -1)
+            RuntimeError("Unable to Open/Create file %ls, error %d", m_writeName.c_str(), errno);
+        if (flock(m_fd, LOCK_EX | LOCK_NB) == -1)
+        {
+            close(m_fd);
+            RuntimeError("Unable to create file %ls, another process is writing it", fileName.c_str());
+        }
+        if (ftruncate(m_fd, size) == -1)
+        {
+            close(m_fd);
+            RuntimeError("Unable to set the size of file %ls to %d bytes, error %d", m_writeName.c_str(), (int) size, errno);
+        }
+        m_mappedSize = size;
+        // if writing the file, the inital size of the file is zero
+        m_filePositionMax = 0;
+        return;
+    }
+
+    m_fd = open(msra::strfun::utf8(fileName).c_str(), O_RDONLY);
+    if (m_fd == -1)
+        RuntimeError("Unable to Open/Create file %ls, error %d", fileName.c_str(), errno);
+    struct stat sb;
+    if (fstat(m_fd, &sb) == -1)
+    {
+        close(m_fd);
+        RuntimeError("Unable to Retrieve file size for file %ls", fileName.c_str());
+    }
+    if (size == 0 || size > (size_t) sb.st_size)
+        size = (size_t) sb.st_size;
+    m_filePositionMax = size;
+    m_mappedSize = size;
+
+    // map the whole file once; MAP_SHARED read-only pages come straight from the page cache, which all readers share
+    if (size > 0)
+    {
+        void* mapping = mmap(nullptr, size, PROT_READ, MAP_SHARED, m_fd, 0);
+        if (mapping == MAP_FAILED)
+        {
+            close(m_fd);
+            RuntimeError("Unable to map file %ls, error %d", fileName.c_str(), errno);
+        }
+        m_fileMapping = (char*) mapping;
+    }
+}
+
+// Destructor - destroy the BinaryFile
+BinaryFile::~BinaryFile()
+{
+    for (auto iter = m_views.begin(); iter != m_views.end();)
+    {
+        // the view
+        iter = ReleaseView(iter, true);
+    }
+    if (m_fileMapping)
+        munmap(m_fileMapping, m_mappedSize);
+
+    // if we are writing the file, truncate to actual size, and publish it under its name while we still hold the lock
+    if (m_writeFile)
+    {
+        bool written = ftruncate(m_fd, m_filePositionMax) == 0 && fsync(m_fd) == 0 &&
+                       rename(msra::strfun::utf8(m_writeName).c_str(), msra::strfun::utf8(m_name).c_str()) == 0;
+        if (!written)
+            fprintf(stderr, "BinaryFile: Unable to complete file %ls, error %d\n", m_name.c_str(), errno);
+    }
+    close(m_fd);
+}
+
+#endif
+
 void BinaryFile::SetFilePositionMax(size_t filePositionMax)
 {
     m_filePositionMax = filePositionMax;
@@ -145,7 +241,7 @@ vector<ViewPosition>::iterator BinaryFile::FindDataView(void* data)
     auto iter = m_views.begin();
     for (; iter != m_views.end(); ++iter)
     {
-        byte* viewBegin = (byte*) iter->view;
+        char* viewBegin = (char*) iter->view;
         if (viewBegin <= data && viewBegin + iter->size > data)
             break;
     }
@@ -192,10 +288,18 @@ vector<ViewPosition>::iterator BinaryFile::ReleaseView(vector<ViewPosition>::ite
     }
     else
     {
+#ifdef _WIN32
         if (m_writeFile)
             FlushViewOfFile(iter->view, iter->size);
         bool ret = UnmapViewOfFile(iter->view) != FALSE;
         ret;
+#else
+        if (m_writeFile) // views of a file that is read are parts of m_fileMapping
+        {
+            msync(iter->view, iter->size, MS_ASYNC);
+            munmap(iter->view, iter->size);
+        }
+#endif
         iter = m_views.erase(iter);
     }
     return iter;
@@ -207,6 +311,7 @@ vector<ViewPosition>::iterator BinaryFile::ReleaseView(vector<ViewPosition>::ite
 // returns - pointer to the view
 void* BinaryFile::GetView(size_t filePosition, size_t size)
 {
+#ifdef _WIN32
     void* pBuf = MapViewOfFile(m_hndMapped,                                  // handle to map object
                                m_writeFile ? FILE_MAP_WRITE : FILE_MAP_READ, // get correct permissions
                                HIDWORD(filePosition),
@@ -218,6 +323,19 @@ void* BinaryFile::GetView(size_t filePosition, size_t size)
         sprintf_s(message, "Unable to map file %ls @ %lld, error %x", m_name.c_str(), filePosition, GetLastError());
         RuntimeError(message);
     }
+#else
+    if (filePosition + size > m_mappedSize)
+        RuntimeError("Unable to map file %ls @ %d, %d bytes are beyond its mapped size %d", m_name.c_str(), (int) filePosition, (int) size, (int) m_mappedSize);
+    void* pBuf;
+    if (!m_writeFile) // a view of the file that is read costs nothing, it points into the mapping of the whole file
+        pBuf = m_fileMapping + filePosition;
+    else
+    {
+        pBuf = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, filePosition);
+        if (pBuf == MAP_FAILED)
+            RuntimeError("Unable to map file %ls @ %d, error %d", m_name.c_str(), (int) filePosition, errno);
+    }
+#endif
     m_views.push_back(ViewPosition(pBuf, filePosition, size));
 
     // update file position max if neccesary
@@ -304,7 +422,7 @@ void* BinaryFile::EnsureMapped(void* data, size_t size)
     auto viewPos = FindDataView(data);
     if (viewPos != m_views.end())
     {
-        int64_t offset = (byte*) data - (byte*) viewPos->view;
+        int64_t offset = (char*) data - (char*) viewPos->view;
         int64_t dataEnd = offset + size;
 
         // if our end of data is beyond the size of the view, need to reallocate
@@ -313,7 +431,7 @@ void* BinaryFile::EnsureMapped(void* data, size_t size)
             // TODO: this view change only accomidates this request
             size_t filePosition = viewPos->filePosition;
             ReleaseView(viewPos);
-            byte* view = (byte*) GetView(filePosition, dataEnd);
+            char* view = (char*) GetView(filePosition, dataEnd);
             data = view + offset;
         }
     }
@@ -349,11 +467,7 @@ SectionFile::SectionFile(std::wstring fileName, FileOptions options, size_t size
 
     // check for a file header
     if (!m_fileSection->ValidateHeader(m_writeFile))
-    {
-        char message[128];
-        sprintf_s(message, "Invalid File format for binary file %ls", fileName.c_str());
-        RuntimeError(message);
-    }
+        RuntimeError("Invalid File format for binary file %ls", fileName.c_str());
 }
 
 // SectionFile Destructor
@@ -390,7 +504,7 @@ void Section::InitHeader(SectionType type, std::string description, SectionData
     m_sectionHeader->flags = flagNone;                                                  // bit flags, dependent on sectionType
     m_sectionHeader->elementsCount = 0;                                                 // number of total elements stored
     memset(m_sectionHeader->nameDescription, 0, descriptionSize);                       // clear out the string buffer to all zeros first
-    strcpy_s(m_sectionHeader->nameDescription, description.c_str());                    // name and description of section contents in this format (name: description) (string, with extra bytes zeroed out, at least one null terminator required)
+    strcpy_s(m_sectionHeader->nameDescription, descriptionSize, description.c_str());   // name and description of section contents in this format (name: description) (string, with extra bytes zeroed out, at least one null terminator required)
     m_sectionHeader->size = sectionHeaderMin;                                           // size of this section (including header)
     m_sectionHeader->sizeAll = sectionHeaderMin;                                        // size of this section (including header and all sub-sections)
     m_sectionHeader->sectionFilePosition[0] = 0;                                        // sub-section file offsets (if needed), assumed to be in File Position order
@@ -497,11 +611,7 @@ Section* Section::ReadSection(size_t index, MappingType mapping, size_t sizeElem
 
     // make sure the header is valid
     if (!section->ValidateHeader())
-    {
-        char message[256];
-        sprintf_s(message, "Invalid header in file %ls, in header %s\n", m_file->GetName().c_str(), section->GetName().c_str());
-        RuntimeError(message);
-    }
+        RuntimeError("Invalid header in file %ls, in header %ls\n", m_file->GetName().c_str(), section->GetName().c_str());
 
     // setup the element mapping and pointers as needed
     section->EnsureElements(0, sizeElements);
@@ -701,7 +811,7 @@ void* Section::EnsureMapped(void* dataStart, size_t size)
         // Element Window is mapped separately so won't no need to remap
         if (m_mappingType != mappingElementWindow)
         {
-            int64_t offset = (byte*) view - (byte*) dataStart;
+            int64_t offset = (char*) view - (char*) dataStart;
             m_sectionHeader = (SectionHeader*) ((char*) m_sectionHeader + offset);
             m_elementBuffer = (char*) m_sectionHeader + m_sectionHeader->sizeHeader;
             RemapHeader(m_sectionHeader, m_filePosition);
@@ -1221,7 +1331,7 @@ void SectionStats::InitCompute(const ConfigArray& compute)
     {
         std::string name = compute[i];
         auto stat = GetElement<NumericStatistics>(i);
-        strcpy_s(stat->statistic, name.c_str());
+        strcpy_s(stat->statistic, sizeof(stat->statistic), name.c_str());
         stat->value = 0.0;
     }
 
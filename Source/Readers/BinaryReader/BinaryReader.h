@@ -127,11 +127,21 @@ struct ViewPosition
 // BinaryFile - class that will read/write a Binary file to a local or network path
 // for local paths, the disk file will be memory mapped for best performance
 // if a network path is used, it still works fine, but consistency between processes is not guaranteed
+// On POSIX systems, a file opened for reading is mapped once, read-only and shared, so all processes that read it
+// share its pages in the page cache, and views are just pointers into that mapping. A file opened for writing is
+// written under the name "<name>.partial" while its writer holds an exclusive lock on it, and renamed when complete,
+// so readers never see a partially written file and concurrent writers of the same file fail instead of corrupting it.
 class BinaryFile
 {
 protected:
+#ifdef _WIN32
     HANDLE m_hndFile;         // handle to the file
     HANDLE m_hndMapped;       // handle to the mapped file object
+#else
+    int m_fd;                 // file descriptor
+    char* m_fileMapping;      // when reading: the mapping of the whole file, of which all views are a part
+    std::wstring m_writeName; // when writing: the name of the file being written, renamed to m_name when complete
+#endif
     size_t m_mappedSize;      // size of mapped file (zero for size of file being read)
     size_t m_maxViewSize;     // maximum size we want a single view to contain
     size_t m_viewAlignment;   // address alignment required by views
@@ -0,0 +1,141 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+#include "ChunkedBinaryReader.h"
+#include "Config.h"
+#include "ChunkedBinaryDeserializer.h"
+#include "ChunkedBinaryStreamDeserializer.h"
+#include "BlockRandomizer.h"
+#include "NoRandomizer.h"
+#include "ShuffleBufferRandomizer.h"
+#include "SampleModePacker.h"
+#include "SequencePacker.h"
+#include "SyntheticDataDeserializer.h"
+#include "StringUtil.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+ChunkedBinaryReader::ChunkedBinaryReader(MemoryProviderPtr provider,
+                                         const ConfigParameters& config)
+    : m_provider(provider),
+      m_frameMode(config(L"frameMode", true)),
+      m_bucketingWindow(config(L"bucketingWindow", (size_t)0)),
+      m_timeStepSlack(config(L"timeStepSlack", 0.0))
+{
+    ElementType elementType;
+    std::string precision = config.Find("precision", "float");
+    if (AreEqualIgnoreCase(precision, "float"))
+    {
+        elementType = ElementType::tfloat;
+    }
+    else if (AreEqualIgnoreCase(precision, "double"))
+    {
+        elementType = ElementType::tdouble;
+    }
+    else
+    {
+        RuntimeError("Not supported precision '%s'. Expected 'double' or 'float'.", precision.c_str());
+    }
+
+    std::string randomize = config(L"randomize", "auto");
+    if (!AreEqualIgnoreCase(randomize, "auto") && !AreEqualIgnoreCase(randomize, "none"))
+    {
+        RuntimeError("'randomize' parameter must be set to 'auto' or 'none'");
+    }
+
+    std::vector<StreamDescriptionPtr> streams;
+    if (config.Exists(L"stream"))
+    {
+        // Streaming mode: the data is read once from a file, a pipe, stdin ("-") or the output of a command ("command|").
+        std::wstring source = config(L"stream");
+        auto deserializer = std::make_shared<ChunkedBinaryStreamDeserializer>(source, elementType);
+        // The buffer size is given in sequences.
+        size_t bufferSize = AreEqualIgnoreCase(randomize, "auto") ? config(L"shuffleBufferSize", (size_t)10000) : 1;
+        m_randomizer = std::make_shared<ShuffleBufferRandomizer>(deserializer, bufferSize);
+        streams = deserializer->GetStreamDescriptions();
+    }
+    else
+    {
+        // Synthetic data instead of a file, to measure the throughput of the network without I/O.
+        IDataDeserializerPtr deserializer;
+        if (config.Exists(L"synthetic"))
+        {
+            deserializer = std::make_shared<SyntheticDataDeserializer>(config(L"synthetic"), elementType);
+        }
+        else
+        {
+            std::wstring path = config(L"file");
+            deserializer = std::make_shared<ChunkedBinaryDeserializer>(CreateByteSource(path, config), elementType);
+        }
+        streams = deserializer->GetStreamDescriptions();
+        if (AreEqualIgnoreCase(randomize, "auto"))
+        {
+            // The window is given in samples; by default the whole corpus is randomized.
+            size_t randomizationWindow = config(L"randomizationWindow", SIZE_MAX);
+            int verbosity = config(L"verbosity", 0);
+            // With localChunkRandomization every worker only keeps the index of the chunks it reads.
+            auto distributionMode = config(L"localChunkRandomization", false)
+                ? BlockRandomizer::DistributionMode::local_chunks
+                : BlockRandomizer::DistributionMode::sequences_strides;
+            m_randomizer = std::make_shared<BlockRandomizer>(verbosity, randomizationWindow, deserializer, distributionMode);
+        }
+        else
+        {
+            m_randomizer = std::make_shared<NoRandomizer>(deserializer);
+        }
+    }
+    m_randomizer->Initialize(nullptr, config);
+
+    // The packer unpacks sparse streams, so all output streams are dense.
+    for (const auto& stream : streams)
+    {
+        StreamDescriptionPtr output = std::make_shared<StreamDescription>(*stream);
+        output->m_storageType = StorageType::dense;
+        m_streams.push_back(output);
+    }
+}
+
+std::vector<StreamDescriptionPtr> ChunkedBinaryReader::GetStreamDescriptions()
+{
+    assert(!m_streams.empty());
+    return m_streams;
+}
+
+void ChunkedBinaryReader::StartEpoch(const EpochConfiguration& config)
+{
+    if (config.m_totalEpochSizeInSamples <= 0)
+    {
+        RuntimeError("Unsupported minibatch size '%d'.", (int)config.m_totalEpochSizeInSamples);
+    }
+
+    m_randomizer->StartEpoch(config);
+    if (m_frameMode)
+    {
+        m_packer = std::make_shared<SampleModePacker>(
+            m_provider,
+            m_randomizer,
+            config.m_minibatchSizeInSamples,
+            m_streams);
+    }
+    else
+    {
+        m_packer = std::make_shared<SequencePacker>(
+            m_provider,
+            m_randomizer,
+            config.m_minibatchSizeInSamples,
+            m_streams,
+            m_bucketingWindow,
+            (unsigned int)config.m_epochIndex,
+            m_timeStepSlack);
+    }
+}
+
+Minibatch ChunkedBinaryReader::ReadMinibatch()
+{
+    assert(m_packer != nullptr);
+    return m_packer->ReadMinibatch();
+}
+} } }
@@ -0,0 +1,63 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include "Reader.h"
+#include "Packer.h"
+#include "Transformer.h"
+#include "MemoryProvider.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Reader for chunked binary corpus files, as written by the "convertToChunkedBinary" action.
+// Connects the ChunkedBinaryDeserializer with a randomizer and the packer.
+// The "file" can also be read remotely, through "rangeReadCommand", and be cached in "localCacheDir" (see CreateByteSource()).
+// With "stream" instead of "file" the data is read once from a stream written by ChunkedBinaryStreamWriter,
+// and shuffled in a buffer of "shuffleBufferSize" sequences; epochs without a size end with the stream.
+// Such a stream can be the share of one worker process that "convertToChunkedBinary" with "numberOfOutputs"
+// writes into a named pipe, so that the data is read and randomized only once per machine.
+// With a "synthetic" section instead, the data is generated by the SyntheticDataDeserializer.
+// Sparse streams are delivered as dense minibatches.
+// With frameMode=false, whole sequences are packed by the SequencePacker; this needs randomize=auto, since the
+// other randomizers only support frame mode corpora (sequences of a single sample).
+// "bucketingWindow" and "timeStepSlack" are passed to the SequencePacker, to reduce the gaps between sequences.
+class ChunkedBinaryReader : public Reader
+{
+public:
+    ChunkedBinaryReader(MemoryProviderPtr provider,
+                        const ConfigParameters& parameters);
+
+    // Description of streams that this reader provides.
+    std::vector<StreamDescriptionPtr> GetStreamDescriptions() override;
+
+    // Starts a new epoch with the provided configuration.
+    void StartEpoch(const EpochConfiguration& config) override;
+
+    // Reads a single minibatch.
+    Minibatch ReadMinibatch() override;
+
+private:
+    // All streams this reader provides.
+    std::vector<StreamDescriptionPtr> m_streams;
+
+    // Randomizer over the deserializer.
+    TransformerPtr m_randomizer;
+
+    // Packer.
+    PackerPtr m_packer;
+
+    // Memory provider (TODO: this will possibly change in the near future.)
+    MemoryProviderPtr m_provider;
+
+    // Whether samples (SampleModePacker) or whole sequences (SequencePacker) are packed.
+    bool m_frameMode;
+
+    // Length bucketing and time step slack of the SequencePacker.
+    size_t m_bucketingWindow;
+    double m_timeStepSlack;
+};
+
+}}}
@@ -0,0 +1,37 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// DataReader.cpp : Defines the exported functions for the DLL application.
+//
+
+#include "stdafx.h"
+#include "Basics.h"
+
+#define DATAREADER_EXPORTS
+#include "DataReader.h"
+#include "Config.h"
+#include "ReaderShim.h"
+#include "ChunkedBinaryReader.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Factory methods for the reader.
+// TODO: Must be removed when SGD is moved to an untyped matrix.
+// The memory provider is chosen by the ReaderShim, depending on the device the minibatches are copied to.
+auto factory = [](const ConfigParameters& parameters, MemoryProviderPtr memoryProvider) -> ReaderPtr
+{
+    return std::make_shared<ChunkedBinaryReader>(memoryProvider, parameters);
+};
+
+extern "C" DATAREADER_API void GetReaderF(IDataReader** preader)
+{
+    *preader = new ReaderShim<float>(factory);
+}
+
+extern "C" DATAREADER_API void GetReaderD(IDataReader** preader)
+{
+    *preader = new ReaderShim<double>(factory);
+}
+
+}}}
@@ -0,0 +1,15 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// dllmain.cpp : Defines the entry point for the DLL application.
+//
+#include "stdafx.h"
+
+BOOL APIENTRY DllMain(HMODULE /*hModule*/,
+                      DWORD /*ul_reason_for_call*/,
+                      LPVOID /*lpReserved*/
+                      )
+{
+    return TRUE;
+}
@@ -9,6 +9,7 @@
 #define DATAREADER_EXPORTS // creating the exports here
 #include "DataReader.h"
 #include "DSSMReader.h"
+#include "TaskScheduler.h"
 #ifdef LEAKDETECT
 #include <vld.h> // leak detection
 #endif
@@ -171,8 +172,11 @@ void DSSMReader<ElemType>::InitFromConfig(const ConfigRecordType& readerConfig)
     m_labelIdMax = m_labelDim = 0;
     m_partialMinibatch = m_endReached = false;
     m_labelType = labelCategory;
-    m_readNextSample = 0;
+    m_readNextSample = m_readEndSample = 0;
     m_traceLevel = readerConfig(L"traceLevel", 0);
+    // minibatches are read from the mapped files by background tasks, this many ahead of GetMinibatch()
+    int prefetchDepth = readerConfig(L"prefetchDepth", 2);
+    m_prefetchDepth = prefetchDepth > 0 ? prefetchDepth : 0;
 
     if (readerConfig.Exists(L"randomize"))
     {
@@ -234,6 +238,7 @@ void DSSMReader<ElemType>::InitFromConfig(const ConfigRecordType& readerConfig)
 template <class ElemType>
 DSSMReader<ElemType>::~DSSMReader()
 {
+    CancelPrefetch();
     ReleaseMemory();
 }
 
@@ -279,6 +284,8 @@ size_t RoundUp(size_t value, size_t size)
 template <class ElemType>
 void DSSMReader<ElemType>::StartMinibatchLoop(size_t mbSize, size_t epoch, size_t requestedEpochSamples)
 {
+    CancelPrefetch();
+
     size_t mbStartSample = m_epoch * m_epochSize;
     if (m_totalSamples == 0)
     {
@@ -290,11 +297,10 @@ void DSSMReader<ElemType>::StartMinibatchLoop(size_t mbSize, size_t epoch, size_
 
     // reset the next read sample
     m_readNextSample = 0;
+    m_readEndSample = m_totalSamples;
     m_epochStartSample = m_mbStartSample = mbStartSample;
     m_mbSize = mbSize;
     m_epochSize = requestedEpochSamples;
-    dssm_queryInput.SetupEpoch(mbSize);
-    dssm_docInput.SetupEpoch(mbSize);
     if (m_epochSize > (size_t) dssm_queryInput.numRows)
     {
         m_epochSize = (size_t) dssm_queryInput.numRows;
@@ -307,6 +313,20 @@ void DSSMReader<ElemType>::StartMinibatchLoop(size_t mbSize, size_t epoch, size_
     m_mbStartSample = epoch * m_epochSize;
 }
 
+// StartDistributedMinibatchLoop - Startup a minibatch loop over one of 'numSubsets' contiguous slices of the dataset
+// Each subset reads minibatches of mbSize / numSubsets samples, so that the subsets together read minibatches of about 'mbSize' samples.
+// Since the slices are in order, the outputs of the subsets, concatenated in the order of 'subsetNum', are in the order of the dataset.
+template <class ElemType>
+void DSSMReader<ElemType>::StartDistributedMinibatchLoop(size_t mbSize, size_t epoch, size_t subsetNum, size_t numSubsets, size_t requestedEpochSamples)
+{
+    if (subsetNum >= numSubsets)
+        InvalidArgument("DSSMReader: subset %d out of range for %d subsets.", (int) subsetNum, (int) numSubsets);
+
+    StartMinibatchLoop(max(mbSize / numSubsets, (size_t) 1), epoch, requestedEpochSamples);
+    m_readNextSample = m_totalSamples * subsetNum / numSubsets;
+    m_readEndSample = m_totalSamples * (subsetNum + 1) / numSubsets;
+}
+
 // function to store the LabelType in an ElemType
 // required for string labels, which can't be stored in ElemType arrays
 template <class ElemType>
@@ -315,6 +335,64 @@ void DSSMReader<ElemType>::StoreLabel(ElemType& labelStore, const LabelType& lab
     labelStore = (ElemType) m_mapLabelToId[labelValue];
 }
 
+// ReadMinibatch - read the features of the minibatch starting at 'firstSample', of mb.numSamples samples, into 'mb'
+// This only reads the mapped files, so several minibatches can be read at once on background tasks.
+template <class ElemType>
+void DSSMReader<ElemType>::ReadMinibatch(size_t firstSample, bool readQuery, bool readDoc, PreparedMinibatch& mb) const
+{
+    mb.hasQuery = readQuery;
+    mb.hasDoc = readDoc;
+    if (readQuery)
+        dssm_queryInput.Read_Batch(firstSample, mb.numSamples, mb.query);
+    if (readDoc)
+        dssm_docInput.Read_Batch(firstSample, mb.numSamples, mb.doc);
+}
+
+// Prefetch - start reading the next minibatches of the subset, until m_prefetchDepth of them are being read ahead
+// Each minibatch is read by its own task, into the buffers of a consumed one. The tasks run on the TaskScheduler,
+// so at most numPrefetchThreads of them at the same time.
+template <class ElemType>
+void DSSMReader<ElemType>::Prefetch(bool readQuery, bool readDoc)
+{
+    if (m_prefetched.empty())
+        m_prefetchNextSample = m_readNextSample;
+    while (m_prefetched.size() < m_prefetchDepth && m_prefetchNextSample < m_readEndSample)
+    {
+        PreparedMinibatch mb;
+        if (!m_recycled.empty())
+        {
+            mb = std::move(m_recycled.back());
+            m_recycled.pop_back();
+        }
+        size_t firstSample = m_prefetchNextSample;
+        mb.numSamples = min(m_mbSize, m_readEndSample - firstSample);
+        m_prefetchNextSample += mb.numSamples;
+        m_prefetched.push_back(TaskScheduler::Instance().Submit(TaskClass::prefetch, std::bind([this, firstSample, readQuery, readDoc](PreparedMinibatch& mb)
+                                                                                               {
+                                                                                                   ReadMinibatch(firstSample, readQuery, readDoc, mb);
+                                                                                                   return std::move(mb);
+                                                                                               },
+                                                                                               std::move(mb))));
+    }
+}
+
+// CancelPrefetch - wait for the minibatches being read ahead, and drop them
+template <class ElemType>
+void DSSMReader<ElemType>::CancelPrefetch()
+{
+    for (auto& pending : m_prefetched)
+    {
+        try
+        {
+            m_recycled.push_back(pending.get());
+        }
+        catch (...) // a failed read is reported when its minibatch is asked for, which it no longer will be
+        {
+        }
+    }
+    m_prefetched.clear();
+}
+
 // GetMinibatch - Get the next minibatch (features and labels)
 // matrices - [in] a map with named matrix types (i.e. 'features', 'labels') mapped to the corresponding matrix,
 //             [out] each matrix resized if necessary containing data.
@@ -322,33 +400,62 @@ void DSSMReader<ElemType>::StoreLabel(ElemType& labelStore, const LabelType& lab
 template <class ElemType>
 bool DSSMReader<ElemType>::GetMinibatch(StreamMinibatchInputs& matrices)
 {
-    if (m_readNextSample >= m_totalSamples)
+    if (m_readNextSample >= m_readEndSample)
     {
         return false;
     }
     // In my unit test example, the input matrices contain 5: N, S, fD, fQ and labels
     // Both N and S serve as a pre-set constant values, no need to change them
     // In this node, we only need to fill in these matrices: fD, fQ, labels
-    Matrix<ElemType>& featuresQ = matrices.GetInputMatrix<ElemType>(m_featuresNameQuery);
-    Matrix<ElemType>& featuresD = matrices.GetInputMatrix<ElemType>(m_featuresNameDoc);
-    Matrix<ElemType>& labels    = matrices.GetInputMatrix<ElemType>(m_labelsName); // will change this part later.  TODO: How?
+    // Each of them is optional, e.g. when only the query tower of a model is evaluated.
+    // The features are read ahead by background tasks (see Prefetch()), so that the training thread only copies them into the matrices.
+    bool readQuery = matrices.HasInput(m_featuresNameQuery);
+    bool readDoc = matrices.HasInput(m_featuresNameDoc);
+    PreparedMinibatch mb;
+    Prefetch(readQuery, readDoc);
+    if (!m_prefetched.empty())
+    {
+        mb = m_prefetched.front().get();
+        m_prefetched.pop_front();
+    }
+    else // no read-ahead
+    {
+        mb.numSamples = min(m_mbSize, m_readEndSample - m_readNextSample);
+        ReadMinibatch(m_readNextSample, readQuery, readDoc, mb);
+    }
+    // the inputs asked for have changed since the minibatch was read ahead
+    if ((readQuery && !mb.hasQuery) || (readDoc && !mb.hasDoc))
+        ReadMinibatch(m_readNextSample, readQuery, readDoc, mb);
 
-    size_t actualMBSize = (m_readNextSample + m_mbSize > m_totalSamples) ? m_totalSamples - m_readNextSample : m_mbSize;
+    size_t actualMBSize = mb.numSamples;
+    m_pMBLayout->InitAsFrameMode(actualMBSize);
+
+    if (readQuery)
+    {
+        Matrix<ElemType>& featuresQ = matrices.GetInputMatrix<ElemType>(m_featuresNameQuery);
+        featuresQ.SwitchToMatrixType(MatrixType::SPARSE, MatrixFormat::matrixFormatSparseCSC, false);
+        dssm_queryInput.Fill(featuresQ, mb.query);
+    }
+    if (readDoc)
+    {
+        Matrix<ElemType>& featuresD = matrices.GetInputMatrix<ElemType>(m_featuresNameDoc);
+        featuresD.SwitchToMatrixType(MatrixType::SPARSE, MatrixFormat::matrixFormatSparseCSC, false);
+        dssm_docInput.Fill(featuresD, mb.doc);
+    }
+    m_readNextSample += actualMBSize;
 
-    featuresQ.SwitchToMatrixType(MatrixType::SPARSE, MatrixFormat::matrixFormatSparseCSC, false);
-    featuresD.SwitchToMatrixType(MatrixType::SPARSE, MatrixFormat::matrixFormatSparseCSC, false);
+    // the buffers of this minibatch are reused to read the next one
+    m_recycled.push_back(std::move(mb));
+    Prefetch(readQuery, readDoc);
+    if (!matrices.HasInput(m_labelsName))
+        return true;
+    Matrix<ElemType>& labels = matrices.GetInputMatrix<ElemType>(m_labelsName); // will change this part later.  TODO: How?
 
     /*
     featuresQ.Resize(dssm_queryInput.numRows, actualMBSize);
     featuresD.Resize(dssm_docInput.numRows, actualMBSize);
     */
 
-    // fprintf(stderr, "featuresQ\n");
-    dssm_queryInput.Next_Batch(featuresQ, m_readNextSample, actualMBSize, read_order);
-    // fprintf(stderr, "\n\n\nfeaturesD\n");
-    dssm_docInput.Next_Batch(featuresD, m_readNextSample, actualMBSize, read_order);
-    // fprintf(stderr, "\n\n\n\n\n");
-    m_readNextSample += actualMBSize;
     /*
                 featuresQ.Print("featuresQ");
                 fprintf(stderr, "\n");
@@ -462,7 +569,6 @@ void DSSM_BinaryInput<ElemType>::Init(wstring fileName, size_t dim)
 {
 
     m_dim = dim;
-    mbSize = 0;
     /*
     m_hndl = CreateFileA(fileName.c_str(), GENERIC_READ,
         FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
@@ -529,100 +635,39 @@ void DSSM_BinaryInput<ElemType>::Init(wstring fileName, size_t dim)
                                     0);
     data_buffer = (char*) data_orig + data_padding;
 }
+// Read_Batch - copy the samples [cur, cur + numToRead) into 'batch', as CSC arrays
+// Each sample is stored as [int32 nnz][ElemType values[nnz]][int32 rowIndices[nnz]] at its offset.
 template <class ElemType>
-bool DSSM_BinaryInput<ElemType>::SetupEpoch(size_t minibatchSize)
+void DSSM_BinaryInput<ElemType>::Read_Batch(size_t cur, size_t numToRead, DSSM_SparseBatch<ElemType>& batch) const
 {
-    if (values == NULL || mbSize < minibatchSize)
-    {
-        if (values != NULL)
-        {
-            free(values);
-            free(colIndices);
-            free(rowIndices);
-        }
+    batch.colIndices.resize(numToRead + 1);
+    batch.values.clear();
+    batch.rowIndices.clear();
 
-        values = (ElemType*) malloc(sizeof(ElemType) * MAX_BUFFER * minibatchSize);
-        colIndices = (int32_t*) malloc(sizeof(int32_t) * (minibatchSize + 1));
-        rowIndices = (int32_t*) malloc(sizeof(int32_t) * MAX_BUFFER * minibatchSize);
-        // fprintf(stderr, "values  size: %d",sizeof(ElemType)*MAX_BUFFER*minibatchSize);
-        // fprintf(stderr, "colindi size: %d",sizeof(int32_t)*MAX_BUFFER*(1+minibatchSize));
-        // fprintf(stderr, "rowindi size: %d",sizeof(int32_t)*MAX_BUFFER*minibatchSize);
-    }
-    if (minibatchSize > mbSize)
+    int32_t cur_index = 0;
+    for (size_t c = 0; c < numToRead; c++, cur++)
     {
-        mbSize = minibatchSize;
+        const char* sample = (const char*) data_buffer + offsets[cur];
+        batch.colIndices[c] = cur_index;
+        int32_t nnz = *(const int32_t*) sample;
+        const ElemType* values = (const ElemType*) (sample + sizeof(int32_t));
+        const int32_t* rowIndices = (const int32_t*) (sample + sizeof(int32_t) + sizeof(ElemType) * nnz);
+        batch.values.insert(batch.values.end(), values, values + nnz);
+        batch.rowIndices.insert(batch.rowIndices.end(), rowIndices, rowIndices + nnz);
+        cur_index += nnz;
     }
-
-    return true;
+    batch.colIndices[numToRead] = cur_index;
 }
+
 template <class ElemType>
-bool DSSM_BinaryInput<ElemType>::Next_Batch(Matrix<ElemType>& matrices, size_t cur, size_t numToRead, int* /*ordering*/)
+void DSSM_BinaryInput<ElemType>::Fill(Matrix<ElemType>& matrix, const DSSM_SparseBatch<ElemType>& batch) const
 {
-    /*
-    int devId = matrices.GetDeviceId();
-    matrices.TransferFromDeviceToDevice(devId, -1);
-    */
-
-    int32_t cur_index = 0;
-
-    for (int c = 0; c < numToRead; c++, cur++)
-    {
-        // int64_t cur_offset = offsets[ordering[cur]];
-        int64_t cur_offset = offsets[cur];
-        // int64_t cur_offset = offsets[ordering[c]];
-        // int32_t nnz;
-        colIndices[c] = cur_index;
-        int32_t nnz = *(int32_t*) ((char*) data_buffer + cur_offset);
-        // memcpy(&nnz, (char*)data_buffer + cur_offset, sizeof(int32_t));
-        memcpy(values + cur_index, (char*) data_buffer + cur_offset + sizeof(int32_t), sizeof(ElemType) * nnz);
-        memcpy(rowIndices + cur_index, (char*) data_buffer + cur_offset + sizeof(int32_t) + sizeof(ElemType) * nnz, sizeof(int32_t) * nnz);
-        /**
-        fprintf(stderr, "%4d (%3d, %6d): ", c, nnz, cur_index + nnz);
-        for (int i = 0; i < nnz; i++)
-        {
-            fprintf(stderr, "%d:%.f ", rowIndices[cur_index+i], values[cur_index+i]);
-            // matrices.SetValue(rowIndices[cur_index + i], c, values[cur_index + i]);
-        }
-        fprintf(stderr, "\n");
-        **/
-
-        cur_index += nnz;
-    }
-    colIndices[numToRead] = cur_index;
-    /*
-    int col = 0;
-    for (int c = 0; c < cur_index; c++)
-    {
-        if (colIndices[col] == c)
-        {
-            fprintf(stderr, "\n%4d: ", col);
-            col++;
-        }
-        fprintf(stderr, "%d:%.f ", rowIndices[c], values[c]);
-    }
-    */
-    /*
-    fprintf(stderr, "\nXXXX nnz: %d\n", cur_index);
-    fprintf(stderr, "XXXX max values read: %d vs %d\n", sizeof(ElemType)*cur_index, sizeof(ElemType)*MAX_BUFFER*numToRead);
-    fprintf(stderr, "XXXX max indices read: %d vs %d\n", sizeof(int32_t)*cur_index, sizeof(int32_t)*MAX_BUFFER*numToRead);
-    fprintf(stderr, "XXXX sizeof(int32_t) = %d, sizeof(int) = %d\n", sizeof(int32_t), sizeof(int));
-    */
-    /*
-        values = (ElemType*)malloc(sizeof(ElemType)*MAX_BUFFER*minibatchSize);
-        colIndices = (int32_t*)malloc(sizeof(int32_t)*MAX_BUFFER*(minibatchSize+1));
-        rowIndices = (int32_t*)malloc(sizeof(int32_t)*MAX_BUFFER*minibatchSize);
-        */
-
-    matrices.SetMatrixFromCSCFormat(colIndices, rowIndices, values, cur_index, m_dim, numToRead);
-    // matrices.Print("actual values");
-    // exit(1);
-    /*
-    matrices.SwitchToMatrixType(MatrixType::DENSE, MatrixFormat::matrixFormatDense);
-    matrices.Print("featuresQ");
-    exit(1);
-    matrices.TransferFromDeviceToDevice(-1,devId);
-    */
-    return true;
+    size_t numCols = batch.colIndices.size() - 1;
+    size_t nnz = batch.colIndices[numCols];
+    // CPUSparseMatrix reads the arrays, which are empty for a minibatch without values
+    ElemType noValue = 0;
+    int32_t noRowIndex = 0;
+    matrix.SetMatrixFromCSCFormat(batch.colIndices.data(), nnz ? batch.rowIndices.data() : &noRowIndex, nnz ? batch.values.data() : &noValue, nnz, m_dim, numCols);
 }
 
 template <class ElemType>
@@ -641,18 +686,6 @@ void DSSM_BinaryInput<ElemType>::Dispose()
     {
         free(offsets); // = (ElemType*)malloc(sizeof(float)* 230 * 1024);
     }
-    if (values != NULL)
-    {
-        free(values); // = (ElemType*)malloc(sizeof(float)* 230 * 1024);
-    }
-    if (rowIndices != NULL)
-    {
-        free(rowIndices); // = (int*)malloc(sizeof(float)* 230 * 1024);
-    }
-    if (colIndices != NULL)
-    {
-        free(colIndices); // = (int*)malloc(sizeof(float)* 230 * 1024);
-    }
 }
 
 template <class ElemType>
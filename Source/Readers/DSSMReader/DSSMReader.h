@@ -12,6 +12,8 @@
 #include <string>
 #include <map>
 #include <vector>
+#include <deque>
+#include <future>
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -23,6 +25,15 @@ enum LabelKind
     labelOther = 3,      // some other type of label
 };
 
+// the CSC arrays of a range of samples of one input
+template <class ElemType>
+struct DSSM_SparseBatch
+{
+    std::vector<ElemType> values;
+    std::vector<int32_t> rowIndices;
+    std::vector<int32_t> colIndices;
+};
+
 template <class ElemType>
 class DSSM_BinaryInput
 {
@@ -42,13 +53,8 @@ private:
     void* data_buffer;
 
     size_t m_dim;
-    size_t mbSize;
-    size_t MAX_BUFFER = 300;
 
-    ElemType* values;    // = (ElemType*)malloc(sizeof(float)* 230 * 1024);
-    int64_t* offsets;    // = (int*)malloc(sizeof(int)* 230 * 1024);
-    int32_t* colIndices; // = (int*)malloc(sizeof(int)* (batchsize + 1));
-    int32_t* rowIndices; // = (int*)malloc(sizeof(int)* MAX_BUFFER * batchsize);
+    int64_t* offsets; // = (int*)malloc(sizeof(int)* 230 * 1024);
 
 public:
     int64_t numRows;
@@ -58,8 +64,9 @@ public:
     DSSM_BinaryInput();
     ~DSSM_BinaryInput();
     void Init(std::wstring fileName, size_t dim);
-    bool SetupEpoch(size_t minibatchSize);
-    bool Next_Batch(Matrix<ElemType>& matrices, size_t cur, size_t numToRead, int* ordering);
+    // reads the samples [cur, cur + numToRead) from the mapped file; this may run on any thread
+    void Read_Batch(size_t cur, size_t numToRead, DSSM_SparseBatch<ElemType>& batch) const;
+    void Fill(Matrix<ElemType>& matrix, const DSSM_SparseBatch<ElemType>& batch) const;
     void Dispose();
 };
 
@@ -78,6 +85,20 @@ private:
     DSSM_BinaryInput<ElemType> dssm_queryInput;
     DSSM_BinaryInput<ElemType> dssm_docInput;
 
+    // a minibatch, read ahead of GetMinibatch() by a background task
+    struct PreparedMinibatch
+    {
+        size_t numSamples;
+        bool hasQuery;
+        bool hasDoc;
+        DSSM_SparseBatch<ElemType> query;
+        DSSM_SparseBatch<ElemType> doc;
+    };
+    size_t m_prefetchDepth;                                  // number of minibatches read ahead, each by its own task; 0 reads in GetMinibatch()
+    size_t m_prefetchNextSample;                             // first sample of the next minibatch to read ahead
+    std::deque<std::future<PreparedMinibatch>> m_prefetched; // the minibatches being read ahead, in order
+    std::vector<PreparedMinibatch> m_recycled;               // consumed minibatches, whose buffers the next reads reuse
+
     size_t m_mbSize;                 // size of minibatch requested
     LabelIdType m_labelIdMax;        // maximum label ID we have encountered so far
     LabelIdType m_labelDim;          // maximum label ID we will ever see (used for array dimensions)
@@ -89,6 +110,7 @@ private:
     size_t m_randomizeRange;         // randomization range
     size_t m_featureCount;           // feature count
     size_t m_readNextSample;         // next sample to read
+    size_t m_readEndSample;          // end of the samples to read (of the subset, with distributed reading)
     bool m_labelFirst;               // the label is the first element in a line
     bool m_partialMinibatch;         // a partial minibatch is allowed
     LabelKind m_labelType;           // labels are categories, create mapping table
@@ -134,6 +156,9 @@ private:
     size_t RecordsToRead(size_t mbStartSample, bool tail = false);
     void ReleaseMemory();
     void WriteLabelFile();
+    void ReadMinibatch(size_t firstSample, bool readQuery, bool readDoc, PreparedMinibatch& mb) const;
+    void Prefetch(bool readQuery, bool readDoc);
+    void CancelPrefetch();
 
     virtual bool ReadRecord(size_t readSample);
 
@@ -150,7 +175,7 @@ public:
     }
     virtual void Destroy();
     DSSMReader()
-        : m_pMBLayout(make_shared<MBLayout>())
+        : m_pMBLayout(make_shared<MBLayout>()), m_prefetchDepth(2), m_prefetchNextSample(0)
     {
         m_qfeaturesBuffer = NULL;
         m_dfeaturesBuffer = NULL;
@@ -158,6 +183,11 @@ public:
     }
     virtual ~DSSMReader();
     virtual void StartMinibatchLoop(size_t mbSize, size_t epoch, size_t requestedEpochSamples = requestDataSize);
+    virtual bool SupportsDistributedMBRead() const override
+    {
+        return true;
+    }
+    virtual void StartDistributedMinibatchLoop(size_t mbSize, size_t epoch, size_t subsetNum, size_t numSubsets, size_t requestedEpochSamples = requestDataSize) override;
     virtual bool GetMinibatch(StreamMinibatchInputs& matrices);
 
     size_t GetNumParallelSequences()
@@ -168,7 +198,6 @@ public:
     void CopyMBLayoutTo(MBLayoutPtr pMBLayout)
     {
         pMBLayout->CopyFrom(m_pMBLayout);
-        NOT_IMPLEMENTED;
     }
 
     virtual const std::map<LabelIdType, LabelType>& GetLabelMapping(const std::wstring& sectionName);
@@ -6,9 +6,15 @@
 #include "DataDeserializer.h"
 #include "../HTKMLFReader/htkfeatio.h"
 #include "ssematrix.h"
+#include "MemoryMappedFile.h"
+#include "PipelineStatistics.h"
+#include <functional>
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
+// Returns the memory mapping of an archive, given its physical path.
+typedef std::function<MemoryMappedFilePtr(const std::wstring&)> ArchiveMapper;
+
 // Class represents a description of an HTK chunk.
 // It is only used internally by the HTK deserializer.
 // Can exist without associated data and provides methods for requiring/releasing chunk data.
@@ -24,6 +30,11 @@ class ChunkDescription
     // Size of m_firstFrames should be equal to the number of utterances.
     std::vector<size_t> m_firstFrames;
 
+    // If the chunk is served from memory-mapped archives instead of m_frames: the first frame of each utterance inside the mapping,
+    // and the mapping it belongs to.
+    mutable std::vector<const float*> m_mappedFrames;
+    mutable std::vector<MemoryMappedFilePtr> m_mappedArchives;
+
     // Total number of frames in this chunk
     size_t m_totalFrames;
 
@@ -66,7 +77,7 @@ public:
     // Returns frames of a given utterance.
     msra::dbn::matrixstripe GetUtteranceFrames(size_t index) const
     {
-        if (!IsInRam())
+        if (m_frames.empty())
         {
             LogicError("GetUtteranceFrames was called when data have not yet been paged in.");
         }
@@ -76,10 +87,32 @@ public:
         return msra::dbn::matrixstripe(m_frames, ts, n);
     }
 
+    // Returns true if the frames are served from memory-mapped archives, without a copy in m_frames.
+    bool IsMapped() const
+    {
+        return !m_mappedFrames.empty();
+    }
+
+    // Returns the frames of a given utterance as a view into the memory mapping, one column of 'featureDimension' values per frame.
+    const float* GetMappedUtteranceFrames(size_t index) const
+    {
+        assert(IsMapped());
+        return m_mappedFrames[index];
+    }
+
+    // Returns the mapping that contains the frames of a given utterance.
+    const MemoryMappedFilePtr& GetMappedArchive(size_t index) const
+    {
+        assert(IsMapped());
+        return m_mappedArchives[index];
+    }
+
     // Pages-in the data for this chunk.
     // this function supports retrying since we read from the unreliable network, i.e. do not return in a broken state
     // We pass in the feature info variables to check that that data being read has expected properties.
-    void RequireData(const string& featureKind, size_t featureDimension, unsigned int samplePeriod, int verbosity = 0) const
+    // If 'mapArchive' is given, the frames are served from memory-mapped archives if they are stored as raw floats;
+    // otherwise they are read into memory.
+    void RequireData(const string& featureKind, size_t featureDimension, unsigned int samplePeriod, int verbosity = 0, const ArchiveMapper& mapArchive = nullptr) const
     {
         if (GetNumberOfUtterances() == 0)
         {
@@ -91,6 +124,16 @@ public:
             LogicError("Cannot page-in data that is already in memory.");
         }
 
+        // nothing is paged in until the mapping succeeded, so there is nothing to release on failure
+        if (mapArchive && TryMapData(featureKind, featureDimension, samplePeriod, mapArchive))
+        {
+            if (verbosity)
+            {
+                fprintf(stderr, "RequireData: %d utterances mapped\n", (int)m_utteranceSet.size());
+            }
+            return;
+        }
+
         try
         {
             // feature reader (we reinstantiate it for each block, i.e. we reopen the file actually)
@@ -105,6 +148,8 @@ public:
                 auto framesWrapper = GetUtteranceFrames(i);
                 reader.read(m_utteranceSet[i]->GetPath(), featureKind, samplePeriod, framesWrapper);
             }
+            // mapped archives are paged in on access, so only the frames that are read count
+            AddPipelineBytesRead(m_totalFrames * featureDimension * sizeof(float));
 
             if (verbosity)
             {
@@ -133,13 +178,55 @@ public:
 
         // release frames
         m_frames.resize(0, 0);
+        m_mappedFrames.clear();
+        m_mappedArchives.clear();
     }
 
     private:
         // test if data is in memory at the moment
         bool IsInRam() const
         {
-            return !m_frames.empty();
+            return !m_frames.empty() || IsMapped();
+        }
+
+        // Sets up views into the mapped archives for all utterances.
+        // Returns false, leaving the chunk unmapped, if some utterance is not stored as raw floats.
+        bool TryMapData(const string& featureKind, size_t featureDimension, unsigned int samplePeriod, const ArchiveMapper& mapArchive) const
+        {
+            // only reads the file headers; if they are in the same archive, htkfeatreader will not reopen the file
+            msra::asr::htkfeatreader reader;
+            std::vector<const float*> mappedFrames;
+            std::vector<MemoryMappedFilePtr> mappedArchives;
+            mappedFrames.reserve(m_utteranceSet.size());
+            mappedArchives.reserve(m_utteranceSet.size());
+            foreach_index(i, m_utteranceSet)
+            {
+                const auto& path = m_utteranceSet[i]->GetPath();
+                uint64_t byteOffset;
+                size_t numberOfFrames;
+                if (!reader.getrawframelocation(path, featureKind, samplePeriod, byteOffset, numberOfFrames))
+                {
+                    return false;
+                }
+
+                if (numberOfFrames != GetUtteranceNumberOfFrames(i))
+                {
+                    LogicError("RequireData: utterance '%ls' has %d frames instead of %d.", ((wstring)path).c_str(), (int)numberOfFrames, (int)GetUtteranceNumberOfFrames(i));
+                }
+
+                MemoryMappedFilePtr archive = mapArchive(path.physicallocation());
+                if (byteOffset + numberOfFrames * featureDimension * sizeof(float) > archive->GetSize())
+                {
+                    RuntimeError("RequireData: utterance '%ls' exceeds the end of archive '%ls'.", ((wstring)path).c_str(), archive->GetPath().c_str());
+                }
+
+                mappedFrames.push_back(reinterpret_cast<const float*>(archive->GetData() + byteOffset));
+                mappedArchives.push_back(std::move(archive));
+            }
+
+            m_mappedFrames.swap(mappedFrames);
+            m_mappedArchives.swap(mappedArchives);
+            return true;
         }
 };
 
@@ -13,15 +13,15 @@
 #include "Config.h"
 #include "ReaderShim.h"
 #include "HTKMLFReader.h"
-#include "HeapMemoryProvider.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
 // Factory methods for the reader.
 // TODO: Must be removed when SGD is moved to an untyped matrix.
-auto factory = [](const ConfigParameters& parameters) -> ReaderPtr
+// The memory provider is chosen by the ReaderShim, depending on the device the minibatches are copied to.
+auto factory = [](const ConfigParameters& parameters, MemoryProviderPtr memoryProvider) -> ReaderPtr
 {
-    return std::make_shared<HTKMLFReader>(std::make_shared<HeapMemoryProvider>(), parameters);
+    return std::make_shared<HTKMLFReader>(memoryProvider, parameters);
 };
 
 extern "C" DATAREADER_API void GetReaderF(IDataReader** preader)
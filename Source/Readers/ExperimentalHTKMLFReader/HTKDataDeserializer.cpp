@@ -7,7 +7,10 @@
 #include "HTKDataDeserializer.h"
 #include "ConfigHelper.h"
 #include "Basics.h"
+#include "fileutil.h"
 #include <numeric>
+#include <random>
+#include <sys/stat.h>
 
 // TODO: This will be removed when dependency on old code is eliminated.
 // Currently this fixes the linking.
@@ -20,13 +23,69 @@ std::vector<std::wstring> htkfeatreader::parsedpath::archivePathStringVector;
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
+// Layout of the index of a script file (see TryLoadIndexCache()):
+//   IndexCacheHeader, IndexCacheString per archive, IndexCacheUtterance per line of the script file,
+//   then the UTF-8 strings: the script file path, the path prefix, the archive paths and the logical paths.
+static const uint64_t c_htkIndexCacheMagic = 0x31584449534b5448ull; // "HTKSIDX1"
+
+struct IndexCacheHeader
+{
+    uint64_t m_magic;
+    uint64_t m_scpSize;
+    uint64_t m_scpTime;
+    uint64_t m_numberOfUtterances;
+    uint64_t m_numberOfArchives;
+    uint64_t m_stringsSize;
+    uint64_t m_scpPathLength; // the first string
+    uint64_t m_prefixPathLength; // the second string
+};
+
+// A range of the strings.
+struct IndexCacheString
+{
+    uint64_t m_offset;
+    uint64_t m_length;
+};
+
+struct IndexCacheUtterance
+{
+    uint64_t m_firstFrame;
+    uint64_t m_lastFrame;
+    uint64_t m_logicalPathOffset;
+    uint32_t m_logicalPathLength;
+    uint32_t m_archive; // index into the archives of the index, not a global archive path index
+    uint32_t m_flags;
+    uint32_t m_reserved;
+};
+
+static const uint32_t c_inArchive = 1;
+static const uint32_t c_idxFormat = 2;
+
+// Gets the size and the modification time of the file, which identify the version of the script file the index belongs to.
+static bool GetFileStamp(const std::wstring& path, uint64_t& size, uint64_t& time)
+{
+#ifdef _WIN32
+    struct _stat64 s;
+    if (_wstat64(path.c_str(), &s) != 0)
+        return false;
+#else
+    struct stat s;
+    if (stat(msra::strfun::utf8(path).c_str(), &s) != 0)
+        return false;
+#endif
+    size = static_cast<uint64_t>(s.st_size);
+    time = static_cast<uint64_t>(s.st_mtime);
+    return true;
+}
+
 HTKDataDeserializer::HTKDataDeserializer(
     CorpusDescriptorPtr corpus,
     const ConfigParameters& feature,
     const std::wstring& featureName)
     : m_ioFeatureDimension(0),
       m_samplePeriod(0),
-      m_verbosity(0)
+      m_verbosity(0),
+      m_useMemoryMapping(false)
 {
     bool frameMode = feature.Find("frameMode", "true");
     if (!frameMode)
@@ -38,22 +97,53 @@ HTKDataDeserializer::HTKDataDeserializer(
 
     config.CheckFeatureType();
 
-    std::vector<std::wstring> featureFiles = config.GetFeaturePaths();
+    // With useIndexCache, the parsed script file is kept in '<scpFile>.cntkindex', which is mapped by later runs.
+    // Failing to write it only costs parsing the script file again.
+    std::vector<msra::asr::htkfeatreader::parsedpath> featurePaths;
+    const bool useIndexCache = feature(L"useIndexCache", false);
+    const std::wstring scpPath = feature(L"scpFile");
+    const std::wstring prefixPath = feature(L"prefixPathInSCP", L"");
+    const std::wstring cachePath = scpPath + L".cntkindex";
+    uint64_t scpSize = 0;
+    uint64_t scpTime = 0;
+    const bool canCache = useIndexCache && GetFileStamp(scpPath, scpSize, scpTime);
+    if (!canCache || !TryLoadIndexCache(cachePath, scpPath, prefixPath, scpSize, scpTime, featurePaths))
+    {
+        std::vector<std::wstring> featureFiles = config.GetFeaturePaths();
+        featurePaths.reserve(featureFiles.size());
+        for (const auto& featureFile : featureFiles)
+        {
+            featurePaths.push_back(msra::asr::htkfeatreader::parsedpath(featureFile));
+        }
+
+        if (canCache)
+        {
+            SaveIndexCache(cachePath, scpPath, prefixPath, scpSize, scpTime, featurePaths);
+        }
+    }
 
     auto context = config.GetContextWindow();
     m_elementType = config.GetElementType();
     m_dimension = config.GetFeatureDimension();
     m_dimension = m_dimension * (1 + context.first + context.second);
 
-    size_t numSequences = featureFiles.size();
+    size_t numSequences = featurePaths.size();
 
     m_augmentationWindow = config.GetContextWindow();
 
+    // Frames that need no augmentation can be served directly from the mapped archives, without copying them.
+    m_useMemoryMapping = feature(L"useMemoryMapping", false);
+    if (m_useMemoryMapping && (m_augmentationWindow.first != 0 || m_augmentationWindow.second != 0))
+    {
+        fprintf(stderr, "HTKDataDeserializer::HTKDataDeserializer: ignoring useMemoryMapping for feature '%ls', since it has a context window.\n", featureName.c_str());
+        m_useMemoryMapping = false;
+    }
+
     m_utterances.reserve(numSequences);
     size_t totalFrames = 0;
-    foreach_index (i, featureFiles)
+    foreach_index (i, featurePaths)
     {
-        UtteranceDescription description(std::move(msra::asr::htkfeatreader::parsedpath(featureFiles[i])));
+        UtteranceDescription description(std::move(featurePaths[i]));
         size_t numberOfFrames = description.GetNumberOfFrames();
         description.m_id = i;
 
@@ -135,6 +225,7 @@ HTKDataDeserializer::HTKDataDeserializer(
         }
 
         std::wstring key = m_utterances[i].GetKey();
+        m_keyToFirstFrame[key] = m_frames.size();
         for (size_t k = 0; k < m_utterances[i].m_numberOfSamples; ++k)
         {
             Frame f(&m_utterances[i]);
@@ -152,6 +243,8 @@ HTKDataDeserializer::HTKDataDeserializer(
     }
 
     m_weakChunks.resize(m_chunks.size());
+    m_chunkLocks.reset(new std::mutex[m_chunks.size()]);
+    m_chunkUsers.resize(m_chunks.size(), 0);
 
     StreamDescriptionPtr stream = std::make_shared<StreamDescription>();
     stream->m_id = 0;
@@ -168,6 +261,187 @@ HTKDataDeserializer::HTKDataDeserializer(
         fprintf(stderr, "HTKDataDeserializer::HTKDataDeserializer: determined feature kind as %d-dimensional '%s' with frame shift %.1f ms\n",
             (int)m_dimension, m_featureKind.c_str(), m_samplePeriod / 1e4);
     });
+
+    // A larger configured dimension means the frames are augmented with their neighbors.
+    if (m_useMemoryMapping && m_ioFeatureDimension != m_dimension)
+    {
+        fprintf(stderr, "HTKDataDeserializer::HTKDataDeserializer: ignoring useMemoryMapping for feature '%ls', since its dimension %d differs from the dimension %d in the archive.\n",
+            featureName.c_str(), (int)m_dimension, (int)m_ioFeatureDimension);
+        m_useMemoryMapping = false;
+    }
+}
+
+bool HTKDataDeserializer::TryLoadIndexCache(const std::wstring& cachePath, const std::wstring& scpPath, const std::wstring& prefixPath, uint64_t scpSize, uint64_t scpTime,
+                                            std::vector<msra::asr::htkfeatreader::parsedpath>& paths)
+{
+    if (!fexists(cachePath))
+    {
+        return false;
+    }
+
+    MemoryMappedFilePtr file;
+    try
+    {
+        file = std::make_shared<MemoryMappedFile>(cachePath);
+    }
+    catch (const std::exception& e)
+    {
+        fprintf(stderr, "HTKDataDeserializer: cannot map the index '%ls', reading the script file: %s\n", cachePath.c_str(), e.what());
+        return false;
+    }
+
+    const char* data = file->GetData();
+    const size_t size = file->GetSize();
+    if (size < sizeof(IndexCacheHeader))
+    {
+        return false;
+    }
+
+    const auto& header = *reinterpret_cast<const IndexCacheHeader*>(data);
+    if (header.m_magic != c_htkIndexCacheMagic || header.m_scpSize != scpSize || header.m_scpTime != scpTime ||
+        header.m_numberOfArchives > size / sizeof(IndexCacheString) || header.m_numberOfUtterances > size / sizeof(IndexCacheUtterance))
+    {
+        return false;
+    }
+
+    const size_t tablesSize = sizeof(IndexCacheHeader) + header.m_numberOfArchives * sizeof(IndexCacheString) + header.m_numberOfUtterances * sizeof(IndexCacheUtterance);
+    if (tablesSize > size || size - tablesSize != header.m_stringsSize)
+    {
+        return false;
+    }
+
+    const auto* archives = reinterpret_cast<const IndexCacheString*>(data + sizeof(IndexCacheHeader));
+    const auto* utterances = reinterpret_cast<const IndexCacheUtterance*>(archives + header.m_numberOfArchives);
+    const char* strings = data + tablesSize;
+    auto getString = [&](uint64_t offset, uint64_t length, std::string& value)
+    {
+        if (offset > header.m_stringsSize || length > header.m_stringsSize - offset)
+        {
+            return false;
+        }
+        value.assign(strings + offset, static_cast<size_t>(length));
+        return true;
+    };
+
+    // the same script file may be read with different prefixes, or moved with its time stamp, which changes "..." paths
+    std::string value;
+    if (!getString(0, header.m_scpPathLength, value) || value != msra::strfun::utf8(scpPath) ||
+        !getString(header.m_scpPathLength, header.m_prefixPathLength, value) || value != msra::strfun::utf8(prefixPath))
+    {
+        return false;
+    }
+
+    std::vector<unsigned int> archivePathIndices(static_cast<size_t>(header.m_numberOfArchives));
+    for (size_t i = 0; i < archivePathIndices.size(); ++i)
+    {
+        if (!getString(archives[i].m_offset, archives[i].m_length, value))
+        {
+            return false;
+        }
+        archivePathIndices[i] = msra::asr::htkfeatreader::parsedpath::getarchivepathidx(msra::strfun::utf16(value));
+    }
+
+    paths.reserve(static_cast<size_t>(header.m_numberOfUtterances));
+    for (size_t i = 0; i < header.m_numberOfUtterances; ++i)
+    {
+        const auto& utterance = utterances[i];
+        if (utterance.m_archive >= header.m_numberOfArchives || !getString(utterance.m_logicalPathOffset, utterance.m_logicalPathLength, value))
+        {
+            paths.clear();
+            return false;
+        }
+        paths.push_back(msra::asr::htkfeatreader::parsedpath(std::move(value), archivePathIndices[utterance.m_archive],
+                                                             static_cast<size_t>(utterance.m_firstFrame), static_cast<size_t>(utterance.m_lastFrame),
+                                                             (utterance.m_flags & c_inArchive) != 0, (utterance.m_flags & c_idxFormat) != 0));
+    }
+
+    fprintf(stderr, "Reading script file %ls from its index %ls ... %d entries\n", scpPath.c_str(), cachePath.c_str(), (int)paths.size());
+    return true;
+}
+
+void HTKDataDeserializer::SaveIndexCache(const std::wstring& cachePath, const std::wstring& scpPath, const std::wstring& prefixPath, uint64_t scpSize, uint64_t scpTime,
+                                         const std::vector<msra::asr::htkfeatreader::parsedpath>& paths) const
+{
+    std::string strings = msra::strfun::utf8(scpPath);
+    IndexCacheHeader header = {};
+    header.m_magic = c_htkIndexCacheMagic;
+    header.m_scpSize = scpSize;
+    header.m_scpTime = scpTime;
+    header.m_numberOfUtterances = paths.size();
+    header.m_scpPathLength = strings.size();
+    strings += msra::strfun::utf8(prefixPath);
+    header.m_prefixPathLength = strings.size() - header.m_scpPathLength;
+
+    // the archives of these paths, by their global index
+    std::vector<IndexCacheString> archives;
+    std::map<unsigned int, uint32_t> archiveIndices;
+    std::vector<IndexCacheUtterance> utterances(paths.size());
+    for (size_t i = 0; i < paths.size(); ++i)
+    {
+        const auto& path = paths[i];
+        auto archive = archiveIndices.find(path.archivepathidx());
+        if (archive == archiveIndices.end())
+        {
+            const std::string archivePath = msra::strfun::utf8(path.physicallocation());
+            archives.push_back(IndexCacheString{ strings.size(), archivePath.size() });
+            strings += archivePath;
+            archive = archiveIndices.insert(std::make_pair(path.archivepathidx(), static_cast<uint32_t>(archives.size() - 1))).first;
+        }
+
+        auto& utterance = utterances[i];
+        utterance.m_firstFrame = path.firstframe();
+        utterance.m_lastFrame = path.lastframe();
+        utterance.m_logicalPathOffset = strings.size();
+        utterance.m_logicalPathLength = static_cast<uint32_t>(path.logicalpathutf8().size());
+        utterance.m_archive = archive->second;
+        utterance.m_flags = (path.inarchive() ? c_inArchive : 0) | (path.idxformat() ? c_idxFormat : 0);
+        utterance.m_reserved = 0;
+        strings += path.logicalpathutf8();
+    }
+    header.m_numberOfArchives = archives.size();
+    header.m_stringsSize = strings.size();
+
+    // Written under a temporary name and renamed, since all ranks of a job may write it at the same time.
+    const std::wstring temporaryPath = cachePath + L".tmp" + std::to_wstring(std::random_device()());
+    try
+    {
+        FILE* f = fopenOrDie(temporaryPath, L"wb");
+        try
+        {
+            fwriteOrDie(&header, sizeof(header), 1, f);
+            if (!archives.empty())
+            {
+                fwriteOrDie(archives.data(), sizeof(IndexCacheString), archives.size(), f);
+            }
+            if (!utterances.empty())
+            {
+                fwriteOrDie(utterances.data(), sizeof(IndexCacheUtterance), utterances.size(), f);
+            }
+            fwriteOrDie(strings.data(), 1, strings.size(), f);
+        }
+        catch (...)
+        {
+            fclose(f);
+            throw;
+        }
+        fcloseOrDie(f);
+
+        // a stale index, e.g. of an earlier version of the script file, is replaced (rename() does not replace on Windows)
+        if (fexists(cachePath))
+        {
+            _wunlink(cachePath.c_str());
+        }
+        renameOrDie(temporaryPath, cachePath);
+        fprintf(stderr, "HTKDataDeserializer: wrote the index of script file %ls to %ls\n", scpPath.c_str(), cachePath.c_str());
+    }
+    catch (const std::exception& e)
+    {
+        fprintf(stderr, "WARNING: Could not write the index of script file %ls to %ls: %s\n", scpPath.c_str(), cachePath.c_str(), e.what());
+        if (fexists(temporaryPath))
+        {
+            _wunlink(temporaryPath.c_str());
+        }
+    }
 }
 
 const SequenceDescriptions& HTKDataDeserializer::GetSequenceDescriptions() const
@@ -208,6 +482,7 @@ private:
 
 // Represets a chunk data in memory. Given up to the randomizer.
 // It is up to the randomizer to decide when to release a particular chunk.
+// Created under the lock of the chunk (see GetChunk()).
 class HTKDataDeserializer::HTKChunk : public Chunk
 {
     HTKDataDeserializer* m_parent;
@@ -215,14 +490,34 @@ class HTKDataDeserializer::HTKChunk : public Chunk
 public:
     HTKChunk(HTKDataDeserializer* parent, size_t chunkId) : m_parent(parent), m_chunkId(chunkId)
     {
+        // the data are still in memory if the previous HTKChunk of this chunk has not released them yet
+        if (m_parent->m_chunkUsers[chunkId]++ != 0)
+        {
+            return;
+        }
+
         auto& chunkDescription = m_parent->m_chunks[chunkId];
 
         // possibly distributed read
         // making several attempts
-        msra::util::attempt(5, [&]()
+        ArchiveMapper mapArchive;
+        if (m_parent->m_useMemoryMapping)
         {
-            chunkDescription.RequireData(m_parent->m_featureKind, m_parent->m_ioFeatureDimension, m_parent->m_samplePeriod, m_parent->m_verbosity);
-        });
+            mapArchive = [this](const std::wstring& path) { return m_parent->GetMappedArchive(path); };
+        }
+
+        try
+        {
+            msra::util::attempt(5, [&]()
+            {
+                chunkDescription.RequireData(m_parent->m_featureKind, m_parent->m_ioFeatureDimension, m_parent->m_samplePeriod, m_parent->m_verbosity, mapArchive);
+            });
+        }
+        catch (...)
+        {
+            m_parent->m_chunkUsers[chunkId]--;
+            throw;
+        }
     }
 
     virtual std::vector<SequenceDataPtr> GetSequence(size_t sequenceId) override
@@ -232,36 +527,46 @@ public:
 
     ~HTKChunk()
     {
-        auto& chunkDescription = m_parent->m_chunks[m_chunkId];
-        chunkDescription.ReleaseData();
+        std::lock_guard<std::mutex> lock(m_parent->m_chunkLocks[m_chunkId]);
+        if (--m_parent->m_chunkUsers[m_chunkId] == 0)
+        {
+            auto& chunkDescription = m_parent->m_chunks[m_chunkId];
+            chunkDescription.ReleaseData();
+        }
     }
 };
 
 ChunkPtr HTKDataDeserializer::GetChunk(size_t chunkId)
 {
-    if (!m_weakChunks[chunkId].expired())
+    std::lock_guard<std::mutex> lock(m_chunkLocks[chunkId]);
+    ChunkPtr chunk = m_weakChunks[chunkId].lock();
+    if (chunk != nullptr)
     {
-        return m_weakChunks[chunkId].lock();
+        return chunk;
     }
 
-    auto chunk = std::make_shared<HTKChunk>(this, chunkId);
+    chunk = std::make_shared<HTKChunk>(this, chunkId);
     m_weakChunks[chunkId] = chunk;
     return chunk;
-};
+}
 
-struct HTKSequenceData : DenseSequenceData
+MemoryMappedFilePtr HTKDataDeserializer::GetMappedArchive(const std::wstring& path)
 {
-    msra::dbn::matrix m_buffer;
-
-    ~HTKSequenceData()
+    std::lock_guard<std::mutex> lock(m_mappedArchivesMutex);
+    MemoryMappedFilePtr archive = m_mappedArchives[path].lock();
+    if (!archive)
     {
-        msra::dbn::matrixstripe frame(m_buffer, 0, m_buffer.cols());
-        if (m_data != &frame(0, 0))
-        {
-            delete[] reinterpret_cast<double*>(m_data);
-            m_data = nullptr;
-        }
+        archive = std::make_shared<MemoryMappedFile>(path);
+        m_mappedArchives[path] = archive;
     }
+    return archive;
+}
+
+struct HTKSequenceData : DenseSequenceData
+{
+    msra::dbn::matrix m_buffer;
+    std::vector<double> m_doubleBuffer; // holds the data if it was converted to double
+    MemoryMappedFilePtr m_archive;      // keeps the data valid if it points into a mapped archive
 };
 
 typedef std::shared_ptr<HTKSequenceData> HTKSequenceDataPtr;
@@ -272,6 +577,11 @@ std::vector<SequenceDataPtr> HTKDataDeserializer::GetSequenceById(size_t id)
     UtteranceDescription* utterance = frame.m_utterence;
 
     const auto& chunkDescription = m_chunks[utterance->m_chunkId];
+    if (chunkDescription.IsMapped())
+    {
+        return GetMappedSequence(chunkDescription, utterance->GetIndexInsideChunk(), frame);
+    }
+
     auto utteranceFrames = chunkDescription.GetUtteranceFrames(utterance->GetIndexInsideChunk());
 
     // wrapper that allows m[j].size() and m[j][i] as required by augmentneighbors()
@@ -302,23 +612,54 @@ std::vector<SequenceDataPtr> HTKDataDeserializer::GetSequenceById(size_t id)
     else
     {
         assert(m_elementType == ElementType::tdouble);
-        double *doubleBuffer = new double[dimensions];
         const float *floatBuffer = &stripe(0, 0);
+        result->m_doubleBuffer.assign(floatBuffer, floatBuffer + dimensions);
+        result->m_data = result->m_doubleBuffer.data();
+    }
 
-        for (size_t i = 0; i < dimensions; i++)
-        {
-            doubleBuffer[i] = floatBuffer[i];
-        }
+    return std::vector<SequenceDataPtr>(1, result);
+}
 
-        result->m_data = doubleBuffer;
+// Serves a frame without augmentation straight from the mapped archive.
+std::vector<SequenceDataPtr> HTKDataDeserializer::GetMappedSequence(const ChunkDescription& chunkDescription, size_t utteranceIndex, const Frame& frame)
+{
+    assert(m_dimension == m_ioFeatureDimension);
+    HTKSequenceDataPtr result = std::make_shared<HTKSequenceData>();
+    result->m_numberOfSamples = frame.m_numberOfSamples;
+    result->m_archive = chunkDescription.GetMappedArchive(utteranceIndex);
+
+    const float* floatBuffer = chunkDescription.GetMappedUtteranceFrames(utteranceIndex) + frame.m_frameIndex * m_dimension;
+    if (m_elementType == ElementType::tfloat)
+    {
+        result->m_data = const_cast<float*>(floatBuffer);
+    }
+    else
+    {
+        assert(m_elementType == ElementType::tdouble);
+        result->m_doubleBuffer.assign(floatBuffer, floatBuffer + m_dimension);
+        result->m_data = result->m_doubleBuffer.data();
     }
 
     return std::vector<SequenceDataPtr>(1, result);
 }
 
-const SequenceDescription* HTKDataDeserializer::GetSequenceDescriptionByKey(const KeyType&)
+static SequenceDescription s_InvalidSequence { 0, 0, 0, false };
+
+const SequenceDescription* HTKDataDeserializer::GetSequenceDescriptionByKey(const KeyType& key)
 {
-    LogicError("HTKDataDeserializer::GetSequenceDescriptionByKey: currently not implemented. Supported only as a primary deserializer.");
+    auto firstFrame = m_keyToFirstFrame.find(key.major);
+    if (firstFrame == m_keyToFirstFrame.end())
+    {
+        return &s_InvalidSequence;
+    }
+
+    size_t index = firstFrame->second + key.minor;
+    if (index >= m_frames.size() || m_frames[index].m_utterence != m_frames[firstFrame->second].m_utterence)
+    {
+        return &s_InvalidSequence;
+    }
+
+    return m_sequences[index];
 }
 
 size_t HTKDataDeserializer::GetTotalNumberOfChunks()
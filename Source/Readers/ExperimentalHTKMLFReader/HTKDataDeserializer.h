@@ -10,6 +10,9 @@
 #include "CorpusDescriptor.h"
 #include "UtteranceDescription.h"
 #include "ChunkDescription.h"
+#include <map>
+#include <memory>
+#include <mutex>
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -29,6 +32,7 @@ public:
     virtual const SequenceDescriptions& GetSequenceDescriptions() const override;
 
     // Retrieves sequence description by its key. Used for deserializers that are not in "primary"/"driving" mode.
+    // The key of a frame is the key of its utterance and its index in the utterance.
     virtual const SequenceDescription* GetSequenceDescriptionByKey(const KeyType& key) override;
 
     // Retrieves total number of chunks this deserializer can produce.
@@ -55,6 +59,17 @@ private:
 
     class HTKChunk;
     std::vector<SequenceDataPtr> GetSequenceById(size_t id);
+    std::vector<SequenceDataPtr> GetMappedSequence(const ChunkDescription& chunkDescription, size_t utteranceIndex, const Frame& frame);
+
+    // Returns the mapping of an archive, mapping it if no chunk holds it at the moment.
+    MemoryMappedFilePtr GetMappedArchive(const std::wstring& path);
+
+    // Index of the parsed script file, so that later runs do not read and parse it again.
+    // It is valid for the script file of the given size and modification time, and the same path prefix.
+    bool TryLoadIndexCache(const std::wstring& cachePath, const std::wstring& scpPath, const std::wstring& prefixPath, uint64_t scpSize, uint64_t scpTime,
+                           std::vector<msra::asr::htkfeatreader::parsedpath>& paths);
+    void SaveIndexCache(const std::wstring& cachePath, const std::wstring& scpPath, const std::wstring& prefixPath, uint64_t scpSize, uint64_t scpTime,
+                        const std::vector<msra::asr::htkfeatreader::parsedpath>& paths) const;
 
     // Dimension of features.
     size_t m_dimension;
@@ -75,6 +90,15 @@ private:
     // Weak pointers on existing chunks.
     std::vector<std::weak_ptr<Chunk>> m_weakChunks;
 
+    // Chunks are requested concurrently (by the prefetch threads of the randomizer, and by several bundled chunks that share an inner chunk),
+    // so each chunk is created and paged in/out under its own lock. Its data stay in memory as long as any HTKChunk of it exists,
+    // which also covers a chunk being requested again while its last HTKChunk is still being destroyed.
+    std::unique_ptr<std::mutex[]> m_chunkLocks;
+    std::vector<size_t> m_chunkUsers;
+
+    // First frame of each valid utterance by its key, for the lookup of sequences by key.
+    std::map<std::wstring, size_t> m_keyToFirstFrame;
+
     // Augmentation window.
     std::pair<size_t, size_t> m_augmentationWindow;
 
@@ -87,6 +111,13 @@ private:
     unsigned int m_samplePeriod;
     size_t m_ioFeatureDimension;
     std::string m_featureKind;
+
+    // Whether chunks are served from memory-mapped archives, if the archives allow it.
+    bool m_useMemoryMapping;
+
+    // Mapped archives by physical path; they are unmapped when the last chunk that uses them is released.
+    std::mutex m_mappedArchivesMutex;
+    std::map<std::wstring, std::weak_ptr<MemoryMappedFile>> m_mappedArchives;
 };
 
 typedef std::shared_ptr<HTKDataDeserializer> HTKDataDeserializerPtr;
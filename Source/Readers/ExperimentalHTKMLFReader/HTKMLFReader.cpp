@@ -38,7 +38,6 @@ std::vector<IDataDeserializerPtr> CreateDeserializers(const ConfigParameters& re
         auto deserializer = std::make_shared<HTKDataDeserializer>(corpus, readerConfig(featureName), featureName);
         featureDeserializers.push_back(deserializer);
     }
-    assert(featureDeserializers.size() == 1);
 
     for (const auto& labelName : labelNames)
     {
@@ -48,6 +47,7 @@ std::vector<IDataDeserializerPtr> CreateDeserializers(const ConfigParameters& re
     }
     assert(labelDeserializers.size() == 1);
 
+    // The first feature deserializer drives the bundler; the others are looked up by the keys of its frames.
     std::vector<IDataDeserializerPtr> deserializers;
     deserializers.insert(deserializers.end(), featureDeserializers.begin(), featureDeserializers.end());
     deserializers.insert(deserializers.end(), labelDeserializers.begin(), labelDeserializers.end());
@@ -67,7 +67,7 @@ HTKMLFReader::HTKMLFReader(MemoryProviderPtr provider,
 
     size_t window = config.GetRandomizationWindow();
     auto deserializers = CreateDeserializers(readerConfig);
-    assert(deserializers.size() == 2);
+    assert(deserializers.size() >= 2);
 
     auto bundler = std::make_shared<Bundler>(readerConfig, deserializers[0], deserializers);
 
@@ -78,7 +78,11 @@ HTKMLFReader::HTKMLFReader(MemoryProviderPtr provider,
     }
 
     int verbosity = readerConfig(L"verbosity", 2);
-    m_randomizer = std::make_shared<BlockRandomizer>(verbosity, window, bundler, BlockRandomizer::DistributionMode::chunk_modulus, true /* useLegacyRandomization */);
+    // With localChunkRandomization every worker only keeps the index of the chunks it reads.
+    auto distributionMode = readerConfig(L"localChunkRandomization", false)
+        ? BlockRandomizer::DistributionMode::local_chunks
+        : BlockRandomizer::DistributionMode::chunk_modulus;
+    m_randomizer = std::make_shared<BlockRandomizer>(verbosity, window, bundler, distributionMode, true /* useLegacyRandomization */);
     m_randomizer->Initialize(nullptr, readerConfig);
 
     // Create output stream descriptions (all dense)
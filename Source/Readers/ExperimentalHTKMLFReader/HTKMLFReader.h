@@ -36,7 +36,7 @@ private:
     std::vector<StreamDescriptionPtr> m_streams;
 
     // Packer.
-    SampleModePackerPtr m_packer;
+    PackerPtr m_packer;
 
     // Seed for the random generator.
     unsigned int m_seed;
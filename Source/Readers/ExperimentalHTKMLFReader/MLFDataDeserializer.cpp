@@ -168,6 +168,7 @@ ChunkPtr MLFDataDeserializer::GetChunk(size_t chunkId)
 {
     UNUSED(chunkId);
     assert(chunkId == 0);
+    // All labels are in memory and the chunk has no state, so chunks can be requested concurrently.
     return std::make_shared<MLFChunk>(this);
 }
 
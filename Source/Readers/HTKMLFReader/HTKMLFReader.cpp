@@ -433,14 +433,25 @@ void HTKMLFReader<ElemType>::PrepareForTrainingOrTesting(const ConfigRecordType&
 
     // load a unigram if needed (this is used for MMI training)
     msra::lm::CSymbolSet unigramsymbols;
-    std::unique_ptr<msra::lm::CMGramLM> unigram;
+    std::unique_ptr<msra::lm::ILM> unigram;
     size_t silencewordid = SIZE_MAX;
     size_t startwordid = SIZE_MAX;
     size_t endwordid = SIZE_MAX;
     if (unigrampath != L"")
     {
-        unigram.reset(new msra::lm::CMGramLM());
-        unigram->read(unigrampath, unigramsymbols, false /*filterVocabulary--false will build the symbol map*/, 1 /*maxM--unigram only*/);
+        // a binary LM (see the "convertToBinaryLM" command) is mapped rather than parsed
+        if (msra::lm::CMGramLMImage::isimage(unigrampath))
+        {
+            auto image = new msra::lm::CMGramLMImage();
+            unigram.reset(image);
+            image->read(unigrampath, unigramsymbols, false /*filterVocabulary--false will build the symbol map*/, 1 /*maxM--unigram only*/);
+        }
+        else
+        {
+            auto lm = new msra::lm::CMGramLM();
+            unigram.reset(lm);
+            lm->read(unigrampath, unigramsymbols, false /*filterVocabulary--false will build the symbol map*/, 1 /*maxM--unigram only*/);
+        }
         silencewordid = unigramsymbols["!silence"]; // give this an id (even if not in the LM vocabulary)
         startwordid = unigramsymbols["<s>"];
         endwordid = unigramsymbols["</s>"];
@@ -481,6 +492,8 @@ void HTKMLFReader<ElemType>::PrepareForTrainingOrTesting(const ConfigRecordType&
     //    statelistpath = readerConfig(L"statelist");
 
     double htktimetoframe = 100000.0; // default is 10ms
+    // with cacheMLF, the parsed labels are kept in '<mlf>.cache' next to each MLF, which is read instead while it is up to date
+    bool cacheMLF = readerConfig(L"cacheMLF", false);
     // std::vector<msra::asr::htkmlfreader<msra::asr::htkmlfentry,msra::lattices::lattice::htkmlfwordsequence>> labelsmulti;
     std::vector<std::map<std::wstring, std::vector<msra::asr::htkmlfentry>>> labelsmulti;
     // std::vector<std::wstring> pagepath;
@@ -488,7 +501,7 @@ void HTKMLFReader<ElemType>::PrepareForTrainingOrTesting(const ConfigRecordType&
     {
         const msra::lm::CSymbolSet* wordmap = unigram ? &unigramsymbols : NULL;
         msra::asr::htkmlfreader<msra::asr::htkmlfentry, msra::lattices::lattice::htkmlfwordsequence>
-        labels(mlfpathsmulti[i], restrictmlftokeys, statelistpaths[i], wordmap, (map<string, size_t>*) NULL, htktimetoframe); // label MLF
+        labels(mlfpathsmulti[i], restrictmlftokeys, statelistpaths[i], wordmap, (map<string, size_t>*) NULL, htktimetoframe, cacheMLF); // label MLF
         // get the temp file name for the page file
 
         // Make sure 'msra::asr::htkmlfreader' type has a move constructor
@@ -507,7 +520,11 @@ void HTKMLFReader<ElemType>::PrepareForTrainingOrTesting(const ConfigRecordType&
 
         // now get the frame source. This has better randomization and doesn't create temp files
         bool minimizeReaderMemoryFootprint = readerConfig(L"minimizeReaderMemoryFootprint", true);
-        m_frameSource.reset(new msra::dbn::minibatchutterancesourcemulti(infilesmulti, labelsmulti, m_featDims, m_labelDims, numContextLeft, numContextRight, randomize, *m_lattices, m_latticeMap, m_frameMode, minimizeReaderMemoryFootprint, m_expandToUtt));
+        // number of minibatches whose chunks are paged in ahead on a background thread, 0 to page only when needed
+        size_t pagingLookahead = readerConfig(L"pagingLookahead", (size_t) 2);
+        // keep chunks of compressed (_C) feature files in memory as stored, at half the size, and decompress them into each minibatch
+        bool keepCompressedFeatures = readerConfig(L"keepCompressedFeatures", true);
+        m_frameSource.reset(new msra::dbn::minibatchutterancesourcemulti(infilesmulti, labelsmulti, m_featDims, m_labelDims, numContextLeft, numContextRight, randomize, *m_lattices, m_latticeMap, m_frameMode, minimizeReaderMemoryFootprint, m_expandToUtt, pagingLookahead, keepCompressedFeatures));
         m_frameSource->setverbosity(m_verbosity);
     }
     else if (EqualCI(readMethod, L"rollingWindow"))
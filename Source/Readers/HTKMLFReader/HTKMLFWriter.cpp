@@ -12,6 +12,7 @@
 #include "Basics.h"
 
 #include "htkfeatio.h" // for reading HTK features
+#include "htkfeatwriterpool.h"
 #include "ssematrix.h"
 
 #define DATAWRITER_EXPORTS // creating the exports here
@@ -95,11 +96,19 @@ void HTKMLFWriter<ElemType>::InitFromConfig(const ConfigRecordType& writerConfig
     }
     outputFileIndex = 0;
     sampPeriod = 100000;
+
+    // output files are written on background threads, holding at most maxQueuedMB of outputs that are not written yet
+    // (writerThreads=0 writes each file before SaveData() returns)
+    size_t writerThreads = writerConfig(L"writerThreads", (size_t) 2);
+    size_t maxQueuedMB = writerConfig(L"maxQueuedMB", (size_t) 256);
+    m_writerPool = std::make_shared<msra::asr::htkfeatwriterpool>(writerThreads, maxQueuedMB * 1024 * 1024);
 }
 
 template <class ElemType>
 void HTKMLFWriter<ElemType>::Destroy()
 {
+    // the last outputs may still be queued (called from a destructor, hence no exceptions)
+    m_writerPool.reset();
     delete[] m_tempArray;
     m_tempArray = nullptr;
     m_tempArraySize = 0;
@@ -134,6 +143,10 @@ bool HTKMLFWriter<ElemType>::SaveData(size_t /*recordStart*/, const std::map<std
 
     outputFileIndex++;
 
+    // after the last file, report write errors while we still can
+    if (outputFileIndex == outputFiles[0].size())
+        m_writerPool->flush();
+
     return true;
 }
 
@@ -153,17 +166,8 @@ void HTKMLFWriter<ElemType>::Save(std::wstring& outputFile, Matrix<ElemType>& ou
         }
     }
 
-    const size_t nansinf = output.countnaninf();
-    if (nansinf > 0)
-        fprintf(stderr, "chunkeval: %d NaNs or INF detected in '%ls' (%d frames)\n", (int) nansinf, outputFile.c_str(), (int) output.cols());
-    // save it
-    msra::files::make_intermediate_dirs(outputFile);
-    msra::util::attempt(5, [&]()
-                        {
-                            msra::asr::htkfeatwriter::write(outputFile, "USER", this->sampPeriod, output);
-                        });
-
     fprintf(stderr, "evaluate: writing %d frames of %ls\n", (int) output.cols(), outputFile.c_str());
+    m_writerPool->write(outputFile, this->sampPeriod, output);
 }
 
 template <class ElemType>
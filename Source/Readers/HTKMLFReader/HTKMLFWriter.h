@@ -8,8 +8,11 @@
 #include "DataWriter.h"
 #include "ScriptableObjects.h"
 #include <map>
+#include <memory>
 #include <vector>
 
+namespace msra { namespace asr { class htkfeatwriterpool; } }
+
 namespace Microsoft { namespace MSR { namespace CNTK {
 
 template <class ElemType>
@@ -28,6 +31,7 @@ private:
     void Save(std::wstring& outputFile, Matrix<ElemType>& outputData);
     ElemType* m_tempArray;
     size_t m_tempArraySize;
+    std::shared_ptr<msra::asr::htkfeatwriterpool> m_writerPool; // writes the files while the next minibatch is evaluated
 
     enum OutputTypes
     {
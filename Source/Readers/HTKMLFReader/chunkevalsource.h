@@ -7,6 +7,7 @@
 //#include <objbase.h>
 #include "Basics.h"    // for attempt()
 #include "htkfeatio.h" // for reading HTK features
+#include "htkfeatwriterpool.h"
 #include "minibatchsourcehelpers.h"
 #ifndef __unix__
 #include "ssematrix.h" // TODO: why can it not be removed for Windows as well? At least needs a comment here.
@@ -32,6 +33,7 @@ class chunkevalsource // : public numamodelmanager
     size_t vdim;                            // input dimension
     size_t udim;                            // output dimension
     bool minibatchready;
+    msra::asr::htkfeatwriterpool writer;    // writes the output files in the background
     void operator=(const chunkevalsource &);
 
 private:
@@ -56,18 +58,9 @@ private:
             const wstring &outfile = outpaths[k];
             unsigned int sampperiod = sampperiods[k];
             size_t n = numframes[k];
-            msra::files::make_intermediate_dirs(outfile);
             fprintf(stderr, "saveandflush: writing %d frames to %ls\n", (int) n, outfile.c_str());
-            msra::dbn::matrixstripe thispred(pred, firstframe, n);
-            // some sanity check for the data we've written
-            const size_t nansinf = thispred.countnaninf();
-            if (nansinf > 0)
-                fprintf(stderr, "chunkeval: %d NaNs or INF detected in '%ls' (%d frames)\n", (int) nansinf, outfile.c_str(), (int) thispred.cols());
-            // save it
-            msra::util::attempt(5, [&]()
-                                {
-                                    msra::asr::htkfeatwriter::write(outfile, "USER", sampperiod, thispred);
-                                });
+            msra::dbn::matrix thispred(msra::dbn::matrixstripe(pred, firstframe, n)); // (a copy, written while the next chunk is evaluated)
+            writer.write(outfile, sampperiod, thispred);
             firstframe += n;
         }
         assert(firstframe == framesinblock);
@@ -78,8 +71,9 @@ private:
     }
 
 public:
-    chunkevalsource(size_t numinput, size_t numoutput, size_t chunksize)
-        : vdim(numinput), udim(numoutput), chunksize(chunksize)
+    // With numwriterthreads > 0, writetofiles() returns once the output is queued, up to maxqueuedbytes (see htkfeatwriterpool).
+    chunkevalsource(size_t numinput, size_t numoutput, size_t chunksize, size_t numwriterthreads = 0, size_t maxqueuedbytes = 256 * 1024 * 1024)
+        : vdim(numinput), udim(numoutput), chunksize(chunksize), writer(numwriterthreads, maxqueuedbytes)
     {
         frames.reserve(chunksize * 2);
         feat.resize(vdim, chunksize); // initialize to size chunksize
@@ -118,6 +112,12 @@ public:
         saveandflush(pred);
     }
 
+    // wait until the output files queued so far are written
+    void flushoutput()
+    {
+        writer.flush();
+    }
+
     msra::dbn::matrix chunkofframes()
     {
         assert(minibatchready);
@@ -157,6 +157,7 @@ class chunkevalsourcemulti // : public numamodelmanager
     std::vector<size_t> vdims;                                // input dimension
     std::vector<size_t> udims;                                // output dimension
     bool minibatchready;
+    msra::asr::htkfeatwriterpool writer;                      // writes the output files in the background
 
     void operator=(const chunkevalsourcemulti &);
 
@@ -185,18 +186,9 @@ private:
             const wstring &outfile = outpaths[index][k];
             unsigned int sampperiod = sampperiods[index][k];
             size_t n = numframes[k];
-            msra::files::make_intermediate_dirs(outfile);
             fprintf(stderr, "saveandflush: writing %d frames to %ls\n", (int) n, outfile.c_str());
-            msra::dbn::matrixstripe thispred(pred, firstframe, n);
-            // some sanity check for the data we've written
-            const size_t nansinf = thispred.countnaninf();
-            if (nansinf > 0)
-                fprintf(stderr, "chunkeval: %d NaNs or INF detected in '%ls' (%d frames)\n", (int) nansinf, outfile.c_str(), (int) thispred.cols());
-            // save it
-            msra::util::attempt(5, [&]()
-                                {
-                                    msra::asr::htkfeatwriter::write(outfile, "USER", sampperiod, thispred);
-                                });
+            msra::dbn::matrix thispred(msra::dbn::matrixstripe(pred, firstframe, n)); // (a copy, written while the next chunk is evaluated)
+            writer.write(outfile, sampperiod, thispred);
             firstframe += n;
         }
         assert(firstframe == framesinblock);
@@ -206,8 +198,8 @@ private:
     }
 
 public:
-    chunkevalsourcemulti(std::vector<size_t> vdims, std::vector<size_t> udims, size_t chunksize)
-        : vdims(vdims), udims(udims), chunksize(chunksize)
+    chunkevalsourcemulti(std::vector<size_t> vdims, std::vector<size_t> udims, size_t chunksize, size_t numwriterthreads = 0, size_t maxqueuedbytes = 256 * 1024 * 1024)
+        : vdims(vdims), udims(udims), chunksize(chunksize), writer(numwriterthreads, maxqueuedbytes)
     {
 
         foreach_index (i, vdims)
@@ -266,6 +258,12 @@ public:
         saveandflush(pred, index);
     }
 
+    // wait until the output files queued so far are written
+    void flushoutput()
+    {
+        writer.flush();
+    }
+
     msra::dbn::matrix chunkofframes(size_t index)
     {
         assert(minibatchready);
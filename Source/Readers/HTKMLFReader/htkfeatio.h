@@ -16,6 +16,9 @@
 #include <regex>
 #include <set>
 #include <unordered_map>
+#include <queue>
+#include <thread>
+#include <exception>
 #include <stdint.h>
 #include <limits.h>
 #include <wchar.h>
@@ -423,21 +426,40 @@ public:
                 }
             }
 
+            archivePathIdx = getarchivepathidx(archivepath);
+            logicalpath = msra::strfun::utf8(localLogicalpath);
+        }
+
+        // constructor from the parts of a path that was parsed before, e.g. stored in an index of the script file
+        // 'archivepathidx' is from getarchivepathidx().
+        parsedpath(std::string&& logicalpathutf8, unsigned int archivepathidx, size_t first, size_t last, bool inarchive, bool idxformat)
+            : logicalpath(std::move(logicalpathutf8)), archivePathIdx(archivepathidx), s(first), e(last), isarchive(inarchive), isidxformat(idxformat)
+        {
+            if (archivePathIdx >= archivePathStringVector.size())
+                LogicError("parsedpath: invalid archive path index %d", (int) archivePathIdx);
+        }
+
+        // index of an archive path, shared by all paths into the same archive
+        static unsigned int getarchivepathidx(const wstring& archivepath)
+        {
             auto iter = archivePathStringMap.find(archivepath);
             if (iter != archivePathStringMap.end())
-            {
-                archivePathIdx = iter->second;
-            }
-            else
-            {
-                archivePathIdx = (unsigned int)archivePathStringMap.size();
-                archivePathStringMap[archivepath] = archivePathIdx;
-                archivePathStringVector.push_back(archivepath);
-            }
+                return iter->second;
 
-            logicalpath = msra::strfun::utf8(localLogicalpath);
+            unsigned int idx = (unsigned int) archivePathStringMap.size();
+            archivePathStringMap[archivepath] = idx;
+            archivePathStringVector.push_back(archivepath);
+            return idx;
         }
 
+        // the parts of the path, for storing it without the need to parse it again
+        const std::string& logicalpathutf8() const { return logicalpath; }
+        unsigned int archivepathidx() const { return archivePathIdx; }
+        size_t firstframe() const { return s; }
+        size_t lastframe() const { return e; }
+        bool inarchive() const { return isarchive; }
+        bool idxformat() const { return isidxformat; }
+
         // get the physical path for 'make' test
         wstring physicallocation() const
         {
@@ -630,6 +652,19 @@ public:
         featperiod = this->featperiod;
     }
 
+    // get the location of the frames of a feature file inside its physical file, for reading them from a memory mapping
+    // Returns false if the stored values cannot be used as they are, i.e. they are compressed, in idx format, or need byte swapping.
+    bool getrawframelocation(const parsedpath& ppath, const string& kindstr, const unsigned int period, uint64_t& byteoffset, size_t& frames)
+    {
+        frames = open(ppath);
+        if (kindstr != featkind || period != featperiod)
+            LogicError("getrawframelocation: attempting to mixing different feature kinds");
+        if (compressed || isidxformat || needbyteswapping || addEnergy || vecbytesize != featdim * sizeof(float))
+            return false;
+        byteoffset = physicaldatastart + (ppath.isarchive ? ppath.s : 0) * vecbytesize;
+        return true;
+    }
+
     // called to add energy as we read
     void AddEnergy(size_t energyElements)
     {
@@ -744,6 +779,44 @@ public:
             throw;
         }
     }
+    // read an entire utterance of a compressed (_C) file as its stored 16-bit values, into an already allocated array of
+    // featdim x 'framecount' values (column-major); 'a' and 'b' receive the values to decompress them, v[k] = (stored[k] + b[k]) / a[k]
+    // Returns false without reading if the file is not stored compressed, or needs energy elements added.
+    bool readcompressed(const parsedpath& ppath, const string& kindstr, const unsigned int period, short* frames, size_t framecount, vector<float>& a, vector<float>& b, bool needsExpansion = false)
+    {
+        // open the file and check dimensions
+        size_t numframes = open(ppath);
+        if (kindstr != featkind || period != featperiod)
+            LogicError("readcompressed: attempting to mixing different feature kinds");
+        if (!compressed || isidxformat || addEnergy)
+            return false;
+        if (needsExpansion ? numframes != 1 : numframes != framecount)
+            LogicError("readcompressed: stripe read called with wrong dimensions");
+
+        try
+        {
+            for (size_t t = 0; t < numframes; t++)
+            {
+                if (curframe >= this->numframes)
+                    RuntimeError("htkfeatreader:attempted to read beyond end");
+                freadOrDie(tmp, featdim, f);
+                if (needbyteswapping)
+                    msra::util::byteswap(tmp);
+                memcpy(frames + t * featdim, tmp.data(), featdim * sizeof(short));
+                curframe++;
+            }
+            for (size_t t = numframes; t < framecount; t++) // copy first frame to all the frames in the stripe
+                memcpy(frames + t * featdim, frames, featdim * sizeof(short));
+        }
+        catch (...)
+        {
+            close();
+            throw;
+        }
+        a = this->a;
+        b = this->b;
+        return true;
+    }
     // read an entire utterance into a virgen, allocatable matrix
     // Matrix type needs to have operator(i,j) and resize(n,m)
     template <class MATRIX>
@@ -863,6 +936,7 @@ class htkmlfreader : public map<wstring, vector<ENTRY>> // [key][i] the data
 {
     wstring curpath;                                 // for error messages
     unordered_map<std::string, size_t> statelistmap; // for state <=> index
+    wstring statelistpath;                           // (for validating the MLF cache)
     map<wstring, WORDSEQUENCE> wordsequences;        // [key] word sequences (if we are building word entries as well, for MMI)
     std::unordered_map<std::string, size_t> symmap;
 
@@ -898,7 +972,7 @@ class htkmlfreader : public map<wstring, vector<ENTRY>> // [key][i] the data
     void parseentry(const vector<std::string>& lines, size_t line, const set<wstring>& restricttokeys,
                     const WORDSYMBOLTABLE* wordmap, const UNITSYMBOLTABLE* unitmap,
                     vector<typename WORDSEQUENCE::word>& wordseqbuffer, vector<typename WORDSEQUENCE::aligninfo>& alignseqbuffer,
-                    const double htkTimeToFrame)
+                    const double htkTimeToFrame, map<wstring, vector<ENTRY>>& labels, map<wstring, WORDSEQUENCE>& words)
     {
         size_t idx = 0;
         string filename = lines[idx++];
@@ -931,7 +1005,7 @@ class htkmlfreader : public map<wstring, vector<ENTRY>> // [key][i] the data
         if (!restricttokeys.empty() && restricttokeys.find(key) == restricttokeys.end())
             return;
 
-        vector<ENTRY>& entries = (*this)[key]; // this creates a new entry
+        vector<ENTRY>& entries = labels[key]; // this creates a new entry
         if (!entries.empty())
             malformed(msra::strfun::strprintf("duplicate entry '%ls'", key.c_str()));
         entries.resize(e - s);
@@ -994,7 +1068,7 @@ class htkmlfreader : public map<wstring, vector<ENTRY>> // [key][i] the data
             // if (sentstart < 0 || sentend < 0 || silence < 0)
             //    LogicError("parseentry: word map must contain !silence, !sent_start, and !sent_end");
             // implant
-            auto& wordsequence = wordsequences[key]; // this creates the map entry
+            auto& wordsequence = words[key];    // this creates the map entry
             wordsequence.words = wordseqbuffer;      // makes a copy
             wordsequence.align = alignseqbuffer;
         }
@@ -1025,7 +1099,7 @@ public:
     }; // to satisfy a template, never used... :(
 
     // constructor reads multiple MLF files
-    htkmlfreader(const vector<wstring>& paths, const set<wstring>& restricttokeys, const wstring& stateListPath = L"", const double htkTimeToFrame = 100000.0)
+    htkmlfreader(const vector<wstring>& paths, const set<wstring>& restricttokeys, const wstring& stateListPath = L"", const double htkTimeToFrame = 100000.0, bool usecache = false)
     {
         // read state list
         if (stateListPath != L"")
@@ -1033,13 +1107,13 @@ public:
 
         // read MLF(s) --note: there can be multiple, so this is a loop
         foreach_index (i, paths)
-            read(paths[i], restricttokeys, (nullmap * /*to satisfy C++ template resolution*/) NULL, (map<string, size_t>*) NULL, htkTimeToFrame);
+            read(paths[i], restricttokeys, (nullmap * /*to satisfy C++ template resolution*/) NULL, (map<string, size_t>*) NULL, htkTimeToFrame, usecache);
     }
 
     // alternate constructor that optionally also reads word alignments (for MMI training); triggered by providing a 'wordmap'
     // (We cannot use an optional arg in the constructor aboe because it interferes with teh template resolution.)
     template <typename WORDSYMBOLTABLE, typename UNITSYMBOLTABLE>
-    htkmlfreader(const vector<wstring>& paths, const set<wstring>& restricttokeys, const wstring& stateListPath, const WORDSYMBOLTABLE* wordmap, const UNITSYMBOLTABLE* unitmap, const double htkTimeToFrame)
+    htkmlfreader(const vector<wstring>& paths, const set<wstring>& restricttokeys, const wstring& stateListPath, const WORDSYMBOLTABLE* wordmap, const UNITSYMBOLTABLE* unitmap, const double htkTimeToFrame, bool usecache = false)
     {
         // read state list
         if (stateListPath != L"")
@@ -1047,7 +1121,7 @@ public:
 
         // read MLF(s) --note: there can be multiple, so this is a loop
         foreach_index (i, paths)
-            read(paths[i], restricttokeys, wordmap, unitmap, htkTimeToFrame);
+            read(paths[i], restricttokeys, wordmap, unitmap, htkTimeToFrame, usecache);
     }
 
     // phone boundary
@@ -1063,8 +1137,11 @@ public:
     }
 
     // note: this function is not designed to be pretty but to be fast
+    // The file is split into sections at entry boundaries, which are parsed in parallel and then merged in one ordered pass.
+    // With 'usecache', the entries are also written to '<path>.cache', and read from there instead while it is newer than
+    // the MLF and the state list (not if word sequences are read as well, or only some keys).
     template <typename WORDSYMBOLTABLE, typename UNITSYMBOLTABLE>
-    void read(const wstring& path, const set<wstring>& restricttokeys, const WORDSYMBOLTABLE* wordmap, const UNITSYMBOLTABLE* unitmap, const double htkTimeToFrame)
+    void read(const wstring& path, const set<wstring>& restricttokeys, const WORDSYMBOLTABLE* wordmap, const UNITSYMBOLTABLE* unitmap, const double htkTimeToFrame, bool usecache = false)
     {
         if (!restricttokeys.empty() && this->size() >= restricttokeys.size()) // no need to even read the file if we are there (we support multiple files)
             return;
@@ -1072,10 +1149,156 @@ public:
         fprintf(stderr, "htkmlfreader: reading MLF file %ls ...", path.c_str());
         curpath = path; // for error messages only
 
+        // determine the sections
+        uint64_t datasize;
+        std::vector<uint64_t> sectionbounds;
+        {
+            auto_file_ptr f(fopenOrDie(path, L"rb"));
+            std::string headerLine = fgetline(f);
+            if (headerLine != "#!MLF!#")
+                malformed("header missing");
+            uint64_t datastart = fgetpos(f);
+            datasize = filesize(f);
+            sectionbounds.push_back(datastart);
+            // when looking for only some keys, we stop reading when we have them, which needs a single section
+            const size_t numsections = restricttokeys.empty() ? getnumsections(datasize - datastart) : 1;
+            for (size_t k = 1; k < numsections; k++)
+            {
+                uint64_t bound = findentryboundary(f, datastart + (datasize - datastart) * k / numsections, datasize);
+                if (bound > sectionbounds.back() && bound < datasize)
+                    sectionbounds.push_back(bound);
+            }
+            sectionbounds.push_back(datasize);
+        }
+
+        map<wstring, vector<ENTRY>> filelabels;
+        const bool cacheable = usecache && !wordmap && restricttokeys.empty();
+        const wstring cachepath = path + L".cache";
+        if (cacheable && msra::files::fuptodate(cachepath, path) && (statelistpath.empty() || msra::files::fuptodate(cachepath, statelistpath)) &&
+            readcache(cachepath, datasize, htkTimeToFrame, filelabels))
+        {
+            fprintf(stderr, " (from cache %ls)", cachepath.c_str());
+        }
+        else
+        {
+            // parse the sections
+            const size_t numsections = sectionbounds.size() - 1;
+            std::vector<map<wstring, vector<ENTRY>>> sectionlabels(numsections);
+            std::vector<map<wstring, WORDSEQUENCE>> sectionwords(numsections);
+            std::vector<std::exception_ptr> errors(numsections);
+            std::vector<std::thread> threads;
+            for (size_t k = 0; k < numsections; k++)
+            {
+                threads.push_back(std::thread([&, k]()
+                                              {
+                                                  try
+                                                  {
+                                                      readsection(path, sectionbounds[k], sectionbounds[k + 1], restricttokeys, wordmap, unitmap, htkTimeToFrame, sectionlabels[k], sectionwords[k]);
+                                                  }
+                                                  catch (...)
+                                                  {
+                                                      errors[k] = std::current_exception();
+                                                  }
+                                              }));
+            }
+            for (auto& thread : threads)
+                thread.join();
+            for (const auto& error : errors)
+            {
+                if (error)
+                    std::rethrow_exception(error);
+            }
+            mergesections(filelabels, sectionlabels);
+            mergesections(wordsequences, sectionwords);
+            if (cacheable)
+                writecache(cachepath, datasize, htkTimeToFrame, filelabels);
+        }
+
+        std::vector<map<wstring, vector<ENTRY>>> files(1);
+        files[0].swap(filelabels);
+        mergesections(*this, files);
+
+        curpath.clear();
+        fprintf(stderr, " total %lu entries\n", this->size());
+    }
+
+private:
+    // number of sections to parse an MLF in, in parallel
+    static size_t getnumsections(uint64_t datasize)
+    {
+        const uint64_t minsectionsize = 16 * 1024 * 1024; // smaller ones are not worth a thread
+        size_t numsections = std::max(std::thread::hardware_concurrency(), 1u);
+        numsections = std::min(numsections, (size_t) 16);
+        return (size_t) std::max(std::min((uint64_t) numsections, datasize / minsectionsize), (uint64_t) 1);
+    }
+
+    // find the first entry boundary at or after 'pos', i.e. the position right after a line that consists of a single dot
+    // Returns 'end' if there is none.
+    static uint64_t findentryboundary(FILE* f, uint64_t pos, uint64_t end)
+    {
+        fsetpos(f, pos);
+        bool atlinestart = false; // we may have landed in the middle of a line
+        for (int c = getc(f); c != EOF && pos < end; c = getc(f))
+        {
+            pos++; // (now the position after c)
+            if (c == '\n' || c == '\r')
+            {
+                atlinestart = true;
+                continue;
+            }
+            if (atlinestart && c == '.')
+            {
+                int next = getc(f);
+                if (next == EOF || next == '\n' || next == '\r')
+                    return pos;
+                ungetc(next, f);
+            }
+            atlinestart = false;
+        }
+        return end;
+    }
+
+    // move the entries of all sections into 'target' (which may have entries already), in one ordered pass
+    template <class VALUE>
+    void mergesections(map<wstring, VALUE>& target, std::vector<map<wstring, VALUE>>& sections)
+    {
+        typedef typename map<wstring, VALUE>::iterator iterator;
+        typedef std::pair<iterator, iterator> head; // [next, end) of a section
+        auto later = [](const head& a, const head& b)
+        {
+            return b.first->first < a.first->first;
+        };
+        std::priority_queue<head, std::vector<head>, decltype(later)> heads(later);
+        map<wstring, VALUE> merged;
+        if (!target.empty())
+            heads.push(head(target.begin(), target.end()));
+        for (auto& section : sections)
+        {
+            if (!section.empty())
+                heads.push(head(section.begin(), section.end()));
+        }
+        while (!heads.empty())
+        {
+            head next = heads.top();
+            heads.pop();
+            if (!merged.empty() && !(merged.rbegin()->first < next.first->first))
+                malformed(msra::strfun::strprintf("duplicate entry '%ls'", next.first->first.c_str()));
+            merged.insert(merged.end(), std::make_pair(next.first->first, std::move(next.first->second)));
+            if (++next.first != next.second)
+                heads.push(next);
+        }
+        sections.clear();
+        target.swap(merged);
+    }
+
+    // parse the entries in the byte range [begin, end) of an MLF file, which starts and ends at entry boundaries
+    template <typename WORDSYMBOLTABLE, typename UNITSYMBOLTABLE>
+    void readsection(const wstring& path, uint64_t begin, uint64_t end, const set<wstring>& restricttokeys, const WORDSYMBOLTABLE* wordmap, const UNITSYMBOLTABLE* unitmap,
+                     const double htkTimeToFrame, map<wstring, vector<ENTRY>>& labels, map<wstring, WORDSEQUENCE>& words)
+    {
         auto_file_ptr f(fopenOrDie(path, L"rb"));
-        std::string headerLine = fgetline(f);
-        if (headerLine != "#!MLF!#")
-            malformed("header missing");
+        fsetpos(f, begin);
+        uint64_t remaining = end - begin;
 
         // Read the file in blocks and parse MLF entries
         std::vector<typename WORDSEQUENCE::word> wordsequencebuffer;
@@ -1084,13 +1307,15 @@ public:
         std::vector<char> currBlockBuf(readBlockSize + 1);
         size_t currLineNum = 1;
         std::vector<string> currMLFLines;
-        bool reachedEOF = (feof(f) != 0);
+        bool reachedEOF = (remaining == 0);
         char* nextReadPtr = currBlockBuf.data();
         size_t nextReadSize = readBlockSize;
         while (!reachedEOF)
         {
-            size_t numBytesRead = fread(nextReadPtr, sizeof(char), nextReadSize, f);
-            reachedEOF = (numBytesRead != nextReadSize);
+            size_t toRead = (size_t) std::min((uint64_t) nextReadSize, remaining);
+            size_t numBytesRead = fread(nextReadPtr, sizeof(char), toRead, f);
+            remaining -= numBytesRead;
+            reachedEOF = (numBytesRead != toRead) || (remaining == 0);
             if (ferror(f))
                 RuntimeError("error reading from file: %s", strerror(errno));
 
@@ -1107,9 +1332,9 @@ public:
                 currMLFLines.push_back(mlfLine);
                 if ((mlfLine[0] == '.') && (mlfLine[1] == 0)) // utterance end delimiter: a single dot on a line
                 {
-                    if (restricttokeys.empty() || (this->size() < restricttokeys.size()))
+                    if (restricttokeys.empty() || (this->size() + labels.size() < restricttokeys.size()))
                     {
-                        parseentry(currMLFLines, currLineNum - currMLFLines.size(), restricttokeys, wordmap, unitmap, wordsequencebuffer, alignsequencebuffer, htkTimeToFrame);
+                        parseentry(currMLFLines, currLineNum - currMLFLines.size(), restricttokeys, wordmap, unitmap, wordsequencebuffer, alignsequencebuffer, htkTimeToFrame, labels, words);
                     }
 
                     currMLFLines.clear();
@@ -1117,6 +1342,12 @@ public:
             };
 
             char* prevLine = strtok_s(currBlockBuf.data(), delim, &context);
+            if (!prevLine) // only line breaks
+            {
+                nextReadPtr = currBlockBuf.data();
+                nextReadSize = readBlockSize;
+                continue;
+            }
             for (char* currLine = strtok_s(NULL, delim, &context); currLine; currLine = strtok_s(NULL, delim, &context))
             {
                 consumeMLFLine(prevLine);
@@ -1126,13 +1357,14 @@ public:
             // The last line read from the block may be a full line or part of a line
             // We can tell by whether the terminating NULL for this line is the NULL
             // we inserted after reading from the file
+            // At the end of the section, it is a full line even without a line break.
             size_t prevLineLen = strlen(prevLine);
-            if ((prevLine + prevLineLen) == (nextReadPtr + numBytesRead))
+            if (!reachedEOF && (prevLine + prevLineLen) == (nextReadPtr + numBytesRead))
             {
                 // This is not a full line, but just a truncated part of a line.
                 // Lets copy this to the start of the currBlockBuf and read new data
                 // from there on
-                strcpy_s(currBlockBuf.data(), currBlockBuf.size(), prevLine);
+                memmove(currBlockBuf.data(), prevLine, prevLineLen + 1);
                 nextReadPtr = currBlockBuf.data() + prevLineLen;
                 nextReadSize = readBlockSize - prevLineLen;
             }
@@ -1147,16 +1379,90 @@ public:
 
         if (!currMLFLines.empty())
             malformed("unexpected end in mid-utterance");
+    }
 
-        curpath.clear();
-        fprintf(stderr, " total %lu entries\n", this->size());
+    // binary cache of the entries of an MLF file
+    // format: "MLFC", version, MLF size, htkTimeToFrame, #states, sizeof(ENTRY), #keys; then per key: UTF-8 key length and chars, #entries, entries
+    static const unsigned int cacheversion = 1;
+
+    bool readcache(const wstring& cachepath, uint64_t datasize, double htkTimeToFrame, map<wstring, vector<ENTRY>>& labels) const
+    {
+        try
+        {
+            auto_file_ptr f(fopenOrDie(cachepath, L"rb"));
+            char magic[4];
+            freadOrDie(magic, sizeof(magic), 1, f);
+            uint64_t header[5]; // version, MLF size, #states, sizeof(ENTRY), #keys
+            double timetoframe;
+            freadOrDie(&header[0], sizeof(header[0]), 2, f);
+            freadOrDie(&timetoframe, sizeof(timetoframe), 1, f);
+            freadOrDie(&header[2], sizeof(header[0]), 3, f);
+            if (memcmp(magic, "MLFC", 4) != 0 || header[0] != cacheversion || header[1] != datasize || timetoframe != htkTimeToFrame ||
+                header[2] != statelistmap.size() || header[3] != sizeof(ENTRY))
+                return false; // written for something else: parse again
+            std::string key;
+            for (uint64_t i = 0; i < header[4]; i++)
+            {
+                unsigned int keylength, numentries;
+                freadOrDie(&keylength, sizeof(keylength), 1, f);
+                key.resize(keylength);
+                if (keylength > 0)
+                    freadOrDie(&key[0], 1, keylength, f);
+                freadOrDie(&numentries, sizeof(numentries), 1, f);
+                auto& entries = labels.insert(labels.end(), std::make_pair(msra::strfun::utf16(key), vector<ENTRY>(numentries)))->second;
+                if (numentries > 0)
+                    freadOrDie(entries.data(), sizeof(ENTRY), numentries, f);
+            }
+            return true;
+        }
+        catch (const std::exception& e) // a broken cache is not fatal
+        {
+            fprintf(stderr, "\nhtkmlfreader: ignoring MLF cache %ls: %s\n", cachepath.c_str(), e.what());
+            labels.clear();
+            return false;
+        }
     }
 
+    void writecache(const wstring& cachepath, uint64_t datasize, double htkTimeToFrame, const map<wstring, vector<ENTRY>>& labels) const
+    {
+        // written under a temporary name, so that an interrupted write is never taken for a cache
+        const wstring temppath = cachepath + L".tmp";
+        try
+        {
+            {
+                auto_file_ptr f(fopenOrDie(temppath, L"wb"));
+                fwriteOrDie("MLFC", 1, 4, f);
+                uint64_t header[5] = {cacheversion, datasize, statelistmap.size(), sizeof(ENTRY), labels.size()};
+                fwriteOrDie(&header[0], sizeof(header[0]), 2, f);
+                fwriteOrDie(&htkTimeToFrame, sizeof(htkTimeToFrame), 1, f);
+                fwriteOrDie(&header[2], sizeof(header[0]), 3, f);
+                for (const auto& label : labels)
+                {
+                    const std::string key = msra::strfun::utf8(label.first);
+                    unsigned int keylength = (unsigned int) key.size(), numentries = (unsigned int) label.second.size();
+                    fwriteOrDie(&keylength, sizeof(keylength), 1, f);
+                    fwriteOrDie(key.data(), 1, keylength, f);
+                    fwriteOrDie(&numentries, sizeof(numentries), 1, f);
+                    fwriteOrDie(label.second.data(), sizeof(ENTRY), numentries, f);
+                }
+                fflushOrDie(f);
+            }
+            renameOrDie(temppath, cachepath);
+        }
+        catch (const std::exception& e) // e.g. no write permission next to the MLF
+        {
+            fprintf(stderr, "\nhtkmlfreader: could not write MLF cache %ls: %s\n", cachepath.c_str(), e.what());
+        }
+    }
+
+public:
+
     // read state list, index is from 0
     void readstatelist(const wstring& stateListPath = L"")
     {
         if (stateListPath != L"")
         {
+            statelistpath = stateListPath;
             vector<char> buffer; // buffer owns the characters--don't release until done
             vector<char*> lines = readlines(stateListPath, buffer);
             size_t index;
@@ -0,0 +1,174 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// htkfeatwriterpool.h -- writing HTK feature files on background threads, while the next chunk is evaluated
+//
+#pragma once
+
+#include "Basics.h"    // for attempt()
+#include "htkfeatio.h" // for htkfeatwriter
+#include "ssematrix.h"
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+namespace msra { namespace asr {
+
+// writes one evaluation output file, as all writers of evaluation output do
+static inline void writeevaloutput(const std::wstring& outfile, unsigned int sampperiod, const msra::dbn::matrix& pred)
+{
+    // some sanity check for the data we've written
+    const size_t nansinf = pred.countnaninf();
+    if (nansinf > 0)
+        fprintf(stderr, "chunkeval: %d NaNs or INF detected in '%ls' (%d frames)\n", (int) nansinf, outfile.c_str(), (int) pred.cols());
+    // save it
+    msra::files::make_intermediate_dirs(outfile);
+    msra::util::attempt(5, [&]()
+                        {
+                            msra::asr::htkfeatwriter::write(outfile, "USER", sampperiod, pred);
+                        });
+}
+
+// ---------------------------------------------------------------------------
+// htkfeatwriterpool -- a queue of output files, written by a pool of threads
+//
+// write() hands a matrix over and returns right away, unless the queue already holds 'maxqueuedbytes' of matrices; then
+// it waits for the writers to catch up, which bounds the memory. Errors of the writers are thrown by the next write()
+// or flush(). With 0 threads, write() writes right away.
+// ---------------------------------------------------------------------------
+
+class htkfeatwriterpool
+{
+    struct job
+    {
+        std::wstring path;
+        unsigned int sampperiod;
+        msra::dbn::matrix feat;
+    };
+
+    const size_t maxqueuedbytes;
+    std::vector<std::thread> threads;
+    std::mutex mutex;
+    std::condition_variable workavailable; // a job was queued, or we are stopping
+    std::condition_variable jobdone;       // a job was written, i.e. there is space in the queue, and maybe all are done
+    std::deque<job> jobs;
+    size_t queuedbytes; // of the matrices in 'jobs' and being written
+    size_t numpending;  // jobs queued or being written
+    bool stopping;
+    std::exception_ptr error; // first error of a writer
+
+    static size_t bytesof(const msra::dbn::matrix& feat)
+    {
+        return feat.rows() * feat.cols() * sizeof(float);
+    }
+
+    void runwriter()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        for (;;)
+        {
+            workavailable.wait(lock, [this]()
+                               {
+                                   return stopping || !jobs.empty();
+                               });
+            if (jobs.empty()) // stopping
+                return;
+            job j = std::move(jobs.front());
+            jobs.pop_front();
+            lock.unlock();
+            std::exception_ptr jobError;
+            try
+            {
+                writeevaloutput(j.path, j.sampperiod, j.feat);
+            }
+            catch (...)
+            {
+                jobError = std::current_exception();
+            }
+            lock.lock();
+            if (jobError && !error)
+                error = jobError;
+            queuedbytes -= bytesof(j.feat);
+            numpending--;
+            jobdone.notify_all();
+        }
+    }
+
+    void rethrowerror() // (call with the lock held)
+    {
+        if (error)
+        {
+            std::exception_ptr e = error;
+            error = nullptr;
+            std::rethrow_exception(e);
+        }
+    }
+
+    htkfeatwriterpool(const htkfeatwriterpool&);
+    void operator=(const htkfeatwriterpool&);
+
+public:
+    htkfeatwriterpool(size_t numthreads, size_t maxqueuedbytes)
+        : maxqueuedbytes(maxqueuedbytes), queuedbytes(0), numpending(0), stopping(false)
+    {
+        for (size_t k = 0; k < numthreads; k++)
+            threads.push_back(std::thread([this]()
+                                          {
+                                              runwriter();
+                                          }));
+    }
+
+    // the queued files are still written; errors are only reported
+    ~htkfeatwriterpool()
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        workavailable.notify_all();
+        for (auto& thread : threads)
+            thread.join();
+        if (error)
+            fprintf(stderr, "~htkfeatwriterpool: an output file could not be written\n");
+    }
+
+    // queue a file to be written; takes over the content of 'feat'
+    void write(const std::wstring& path, unsigned int sampperiod, msra::dbn::matrix& feat)
+    {
+        if (threads.empty())
+        {
+            writeevaloutput(path, sampperiod, feat);
+            return;
+        }
+        const size_t bytes = bytesof(feat);
+        std::unique_lock<std::mutex> lock(mutex);
+        // a single matrix larger than the limit is written once the queue is empty
+        jobdone.wait(lock, [&]()
+                     {
+                         return error || numpending == 0 || queuedbytes + bytes <= maxqueuedbytes;
+                     });
+        rethrowerror();
+        jobs.push_back(job());
+        jobs.back().path = path;
+        jobs.back().sampperiod = sampperiod;
+        jobs.back().feat.swap(feat);
+        queuedbytes += bytes;
+        numpending++;
+        workavailable.notify_one();
+    }
+
+    // wait until all queued files are written
+    void flush()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        jobdone.wait(lock, [this]()
+                     {
+                         return numpending == 0;
+                     });
+        rethrowerror();
+    }
+};
+} }
@@ -91,7 +91,7 @@ static size_t tryfind(const MAPTYPE &map, const KEYTYPE &key, VALTYPE deflt)
 /*static*/ void archive::build(const std::vector<std::wstring> &infiles, const std::wstring &outpath,
                                const std::unordered_map<std::string, size_t> &modelsymmap,
                                const msra::asr::htkmlfreader<msra::asr::htkmlfentry, msra::lattices::lattice::htkmlfwordsequence> &labels, // non-empty: build numer lattices
-                               const msra::lm::CMGramLM &unigram, const msra::lm::CSymbolSet &unigramsymbols)                              // for numer lattices
+                               const msra::lm::ILM &unigram, const msra::lm::CSymbolSet &unigramsymbols)                              // for numer lattices
 {
     const bool numermode = !labels.empty(); // if labels are passed then we shall convert the MLFs to lattices, and 'infiles' are regular keys
 
@@ -394,6 +394,7 @@ void lattice::dedup()
 //  - check consistency (read only; don't write out)
 //  - dump to stdout
 //  - merge two lattices (for merging numer into denom lattices)
+//  - with 'compacted', write the V3 format (expanded edges and alignments, read in place from a memory-mapped archive)
 // Input path is an actual TOC path, output is the stem (.TOC will be added). --yes, not nice, maybe fix it later
 // Example command:
 // convertlatticearchive --latticetocs dummy c:\smbrdebug\sw20_small.den.lats.toc.10 -w c:\smbrdebug\sw20_small.den.lats.converted --cdphonetying c:\smbrdebug\combined.tying --statelist c:\smbrdebug\swb300h.9304.aligned.statelist --transprobs c:\smbrdebug\MMF.9304.transprobs
@@ -403,7 +404,7 @@ void lattice::dedup()
 //  - empty ("") -> don't output, just check the format
 //  - dash ("-") -> dump lattice to stdout instead
 /*static*/ void archive::convert(const std::wstring &intocpath, const std::wstring &intocpath2, const std::wstring &outpath,
-                                 const msra::asr::simplesenonehmm &hset)
+                                 const msra::asr::simplesenonehmm &hset, const bool compacted)
 {
     const auto &modelsymmap = hset.getsymmap();
 
@@ -490,7 +491,13 @@ void lattice::dedup()
         {
             // write to archive
             uint64_t offset = fgetpos(f);
-            L.fwrite(f);
+            if (compacted)
+            {
+                L.rebuildedges(false); // V3 stores the expanded form, which forward-backward uses
+                L.fwritecompacted(f);
+            }
+            else
+                L.fwrite(f);
             fflushOrDie(f);
 
             // write reference to TOC file   --note: TOC file is a headerless UTF8 file; so don't use fprintf %ls format (default code page)
@@ -652,7 +659,7 @@ void lattice::fromhtklattice(const wstring &path, const std::unordered_map<std::
 // The lattice is expected to be freshly constructed (I did not bother to check).
 void lattice::frommlf(const wstring &key, const std::unordered_map<std::string, size_t> &unitmap,
                       const msra::asr::htkmlfreader<msra::asr::htkmlfentry, lattice::htkmlfwordsequence> &labels,
-                      const msra::lm::CMGramLM &unigram, const msra::lm::CSymbolSet &unigramsymbols)
+                      const msra::lm::ILM &unigram, const msra::lm::CSymbolSet &unigramsymbols)
 {
     const auto &transcripts = labels.allwordtranscripts(); // (TODO: we could just pass the transcripts map--does not really matter)
 
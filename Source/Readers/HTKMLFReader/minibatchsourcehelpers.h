@@ -9,6 +9,7 @@
 
 #include "Basics.h"
 #include <stdio.h>
+#include <string.h>
 #include <vector>
 #include <algorithm>
 #ifndef __unix__
@@ -23,9 +24,28 @@ namespace msra { namespace dbn {
 // augmentneighbors() -- augmenting features with their neighbor frames
 // ---------------------------------------------------------------------------
 
+// copy between contiguous arrays of the same element type
+// memcpy() picks the widest vector instructions of the CPU at runtime, which the element-wise loop does not get.
+template <class T>
+static void copyelements(const T* in, size_t n, T* out)
+{
+    memcpy(out, in, n * sizeof(T));
+}
+
 // implant a sub-vector into a vector, for use in augmentneighbors
+// This overload is taken if both vectors are contiguous arrays of the same type (std::vector, array_ref, matrix columns).
 template <class INV, class OUTV>
-static void copytosubvector(const INV& inv, size_t subvecindex, OUTV& outv)
+static auto copytosubvector(const INV& inv, size_t subvecindex, OUTV& outv, int) -> decltype(copyelements(&inv[0], inv.size(), &outv[0]))
+{
+    size_t subdim = inv.size();
+    assert(outv.size() % subdim == 0);
+    if (subdim > 0)
+        copyelements(&inv[0], subdim, &outv[subvecindex * subdim]);
+}
+
+// element-wise version, e.g. for frames that are decompressed as they are read
+template <class INV, class OUTV>
+static void copytosubvector(const INV& inv, size_t subvecindex, OUTV& outv, long)
 {
     size_t subdim = inv.size();
     assert(outv.size() % subdim == 0);
@@ -34,6 +54,12 @@ static void copytosubvector(const INV& inv, size_t subvecindex, OUTV& outv)
         outv[k + k0] = inv[k];
 }
 
+template <class INV, class OUTV>
+static void copytosubvector(const INV& inv, size_t subvecindex, OUTV& outv)
+{
+    copytosubvector(inv, subvecindex, outv, 0);
+}
+
 // compute the augmentation extent (how many frames added on each side)
 static size_t augmentationextent(size_t featdim /*augment from*/, size_t modeldim /*to*/)
 {
@@ -9,6 +9,7 @@
 
 #include "Basics.h"
 #include "fileutil.h" // for opening/reading the ARPA file
+#include "MemoryMappedFile.h" // for using a binary LM image in place
 #include <vector>
 #include <string>
 #include <unordered_map>
@@ -24,6 +25,9 @@ namespace msra { namespace lm {
 class ILM // generic interface -- mostly the score() function
 {
 public:
+    virtual ~ILM()
+    {
+    }
     virtual double score(const int *mgram, int m) const = 0;
     virtual bool oov(int w) const = 0; // needed for perplexity calculation
     // ... TODO (?): return true/false to indicate whether anything changed.
@@ -269,6 +273,12 @@ public:
         const std::vector<unsigned char> &base = *this;
         return base.empty();
     }
+    // the 3-byte values, e.g. for writing them out
+    const unsigned char *bytes() const
+    {
+        const std::vector<unsigned char> &base = *this;
+        return base.data();
+    }
 
     // a reference to a 3-byte int (not a naked pointer as we cannot just assign to it)
     template <class T>
@@ -485,6 +495,16 @@ public:
         ::swap(idmax, other.idmax);
     }
 
+    // raw levels, for writing a binary image (see CMGramLMImage)
+    const int24_vector &levelids(int m) const
+    {
+        return ids[m];
+    }
+    const std::vector<index_t> &levelfirsts(int m) const
+    {
+        return firsts[m];
+    }
+
     // --- id mapping
 
     // test whether a word id is known in this model
@@ -1109,6 +1129,10 @@ public:
             sz += size(m);
         return sz;
     }
+    const std::vector<DATATYPE> &level(int m) const
+    {
+        return data[m];
+    }
     void clear()
     {
         data.clear();
@@ -1166,6 +1190,7 @@ protected:
     mgram_data<float> logP; // [M+1][i] probabilities
     mgram_data<float> logB; // [M][i] back-off weights (stored for histories only)
     friend class CMGramLMIterator;
+    friend class CMGramLMImage; // for write()
 
     // diagnostics of previous score() call
     mutable int longestMGramFound;   // longest m-gram (incl. predicted token) found
@@ -1964,4 +1989,436 @@ public:
     }
 };
 
+// ===========================================================================
+// CMGramLMImage -- a read-only M-gram LM in a binary file with quantized scores, used in place from a memory mapping
+// ===========================================================================
+
+// The image holds the arrays of mgram_map as they are (3-byte ids and 'firsts' per level), and replaces logP and logB
+// by 8-bit codes into a codebook of 256 values per order. The codebooks are equally populated bins of the sorted
+// values (disabled entries such as <s>, with logP < -98, keep one exact code). Loading only maps the file and builds
+// the vocabulary mapping, so all processes on a machine share the same pages. score() keeps no state and may be
+// called from any number of threads without locking.
+// Layout (sections aligned to 8 bytes):
+//  - "MGLM", version, M, #words, #m-grams [M+1] (uint64)
+//  - symbols by LM id: byte offsets [#words+1], zero-terminated strings; the ids by sorted symbol [#words]
+//  - ids [m=1..M], 3 bytes each; firsts [m=0..M-1], uint32 [#m-grams + 1]
+//  - logP [m=0..M]: codebook float [256], codes [#m-grams]; logB [m=0..M-1] likewise
+// Write one with CMGramLMImage::write() from an LM read from an ARPA file (CNTK command "convertToBinaryLM").
+
+class CMGramLMImage : public ILM
+{
+    typedef unsigned int index_t;
+    static const index_t nindex = (index_t) -1;
+    static const int numcodes = 256;
+    static const unsigned int version = 1;
+
+    struct level
+    {
+        const unsigned char *ids;    // [#m-grams * 3]
+        const unsigned int *firsts;  // [#m-grams + 1], for m < M
+        const float *logPcodebook;   // [numcodes]
+        const unsigned char *logP;   // [#m-grams]
+        const float *logBcodebook;   // [numcodes], for m < M
+        const unsigned char *logB;   // [#m-grams], for m < M
+        size_t size;
+    };
+
+    std::shared_ptr<Microsoft::MSR::CNTK::MemoryMappedFile> mapping;
+    int M;                             // may be lower than that of the file (maxM)
+    std::vector<level> levels;         // [m]
+    const unsigned int *symboloffsets; // [#words+1]
+    const char *symbolchars;
+    const unsigned int *sortedids;     // [#words]
+    int numwords;
+    std::vector<index_t> level1lookup; // id -> index in level 1
+    std::vector<int> w2id;             // user space -> LM id
+
+    static void fail(const char *msg)
+    {
+        RuntimeError("CMGramLMImage::%s", msg);
+    }
+
+    // walks the sections of the mapped file
+    class cursor
+    {
+        const char *begin, *p, *end;
+
+    public:
+        cursor(const char *begin, const char *end)
+            : begin(begin), p(begin), end(end)
+        {
+        }
+        template <class T>
+        const T *get(size_t count)
+        {
+            if ((size_t) (end - p) < sizeof(T) * count)
+                fail("read: the image is truncated");
+            const T *result = (const T *) p;
+            p += sizeof(T) * count;
+            return result;
+        }
+        void align()
+        {
+            p = begin + (p - begin + 7) / 8 * 8;
+        }
+    };
+
+    // writes the sections, keeping track of the alignment
+    class writer
+    {
+        FILE *f;
+        size_t offset;
+
+    public:
+        writer(FILE *f)
+            : f(f), offset(0)
+        {
+        }
+        void put(const void *p, size_t bytes)
+        {
+            if (bytes > 0)
+                fwriteOrDie(p, 1, bytes, f);
+            offset += bytes;
+        }
+        template <class T>
+        void put(const T &value)
+        {
+            put(&value, sizeof(value));
+        }
+        void align()
+        {
+            static const char zeros[8] = {0};
+            put(zeros, (8 - offset % 8) % 8);
+        }
+    };
+
+    // equally populated bins by rank; code 0 is kept for disabled entries if there are any
+    static void quantize(const std::vector<float> &values, std::vector<float> &codebook, std::vector<unsigned char> &codes)
+    {
+        const size_t n = values.size();
+        std::vector<index_t> order(n);
+        for (size_t k = 0; k < n; k++)
+            order[k] = (index_t) k;
+        std::sort(order.begin(), order.end(), [&values](index_t a, index_t b)
+                  {
+                      return values[a] < values[b];
+                  });
+        size_t numdisabled = 0;
+        while (numdisabled < n && values[order[numdisabled]] < -98.0f)
+            numdisabled++;
+        const size_t firstcode = numdisabled > 0 ? 1 : 0;
+        const size_t numbins = numcodes - firstcode;
+
+        std::vector<double> sums(numcodes, 0.0);
+        std::vector<size_t> counts(numcodes, 0);
+        codes.resize(n);
+        for (size_t k = 0; k < n; k++)
+        {
+            size_t code = k < numdisabled ? 0 : firstcode + (k - numdisabled) * numbins / (n - numdisabled);
+            codes[order[k]] = (unsigned char) code;
+            sums[code] += values[order[k]];
+            counts[code]++;
+        }
+        codebook.resize(numcodes);
+        for (int code = 0; code < numcodes; code++)
+            codebook[code] = counts[code] > 0 ? (float) (sums[code] / counts[code]) : 0.0f;
+    }
+
+    static void writequantized(writer &w, const std::vector<float> &values)
+    {
+        std::vector<float> codebook;
+        std::vector<unsigned char> codes;
+        quantize(values, codebook, codes);
+        w.put(codebook.data(), sizeof(float) * codebook.size());
+        w.put(codes.data(), codes.size());
+        w.align();
+    }
+
+    inline int map(int w) const
+    {
+        if (w < 0 || w >= (int) w2id.size())
+            return -1;
+        else
+            return w2id[w];
+    }
+
+    inline const char *symbol(int id) const
+    {
+        return symbolchars + symboloffsets[id];
+    }
+
+    int symboltoid(const char *word) const
+    {
+        int beg = 0;
+        int end = numwords;
+        while (beg < end)
+        {
+            int i = (beg + end) / 2;
+            int id = (int) sortedids[i];
+            int cmp = strcmp(word, symbol(id));
+            if (cmp == 0)
+                return id;
+            else if (cmp < 0)
+                end = i;
+            else
+                beg = i + 1;
+        }
+        return -1;
+    }
+
+    static inline int id24(const unsigned char *p)
+    {
+        return (((((signed char) p[2]) << 8) + p[1]) << 8) + p[0];
+    }
+
+    // like mgram_map::find_child()
+    inline index_t find_child(int m, index_t i, int id) const
+    {
+        if (id < 0)
+            return nindex;
+        if (m == 0)
+            return (size_t) id < level1lookup.size() ? level1lookup[id] : nindex;
+        index_t beg = levels[m].firsts[i];
+        index_t end = levels[m].firsts[i + 1];
+        const unsigned char *ids = levels[m + 1].ids;
+        while (beg < end)
+        {
+            index_t k = (beg + end) / 2;
+            int v = id24(ids + 3 * (size_t) k);
+            if (id == v)
+                return k;
+            else if (id < v)
+                end = k;
+            else
+                beg = k + 1;
+        }
+        return nindex;
+    }
+
+    inline float logP(int m, index_t i) const
+    {
+        return levels[m].logPcodebook[levels[m].logP[i]];
+    }
+    inline float logB(int m, index_t i) const
+    {
+        return levels[m].logBcodebook[levels[m].logB[i]];
+    }
+
+public:
+    CMGramLMImage()
+        : M(-1), symboloffsets(NULL), symbolchars(NULL), sortedids(NULL), numwords(0)
+    {
+    }
+
+    // test whether a file is an LM image rather than an ARPA file
+    static bool isimage(const std::wstring &pathname)
+    {
+        auto_file_ptr f(fopenOrDie(pathname, L"rbS"));
+        char tag[4];
+        return fread(tag, sizeof(tag), 1, f) == 1 && memcmp(tag, "MGLM", sizeof(tag)) == 0;
+    }
+
+    // write the image of an LM that was read from an ARPA file
+    static void write(const CMGramLM &lm, const std::wstring &pathname)
+    {
+        if (lm.M < 1 || lm.lmSymbols.empty())
+            RuntimeError("write: the LM must be read from an ARPA file first");
+        auto_file_ptr f(fopenOrDie(pathname, L"wbS"));
+        writer w(f);
+        const int M = lm.M;
+        const unsigned int numwords = (unsigned int) lm.lmSymbols.size();
+
+        w.put("MGLM", 4);
+        w.put((unsigned int) version);
+        w.put((unsigned int) M);
+        w.put(numwords);
+        for (int m = 0; m <= M; m++)
+            w.put((unsigned long long) lm.map.size(m));
+        w.align();
+
+        // symbols
+        std::vector<unsigned int> offsets(numwords + 1, 0);
+        for (unsigned int id = 0; id < numwords; id++)
+            offsets[id + 1] = offsets[id] + (unsigned int) strlen(lm.idToSymbol(id)) + 1;
+        w.put(offsets.data(), sizeof(unsigned int) * offsets.size());
+        for (unsigned int id = 0; id < numwords; id++)
+            w.put(lm.idToSymbol(id), strlen(lm.idToSymbol(id)) + 1);
+        w.align();
+        std::vector<unsigned int> sortedids(numwords);
+        for (unsigned int i = 0; i < numwords; i++)
+            sortedids[i] = (unsigned int) lm.lmSymbols[i].id;
+        w.put(sortedids.data(), sizeof(unsigned int) * sortedids.size());
+        w.align();
+
+        // the map
+        for (int m = 1; m <= M; m++)
+        {
+            w.put(lm.map.levelids(m).bytes(), 3 * lm.map.levelids(m).size());
+            w.align();
+        }
+        for (int m = 0; m < M; m++)
+        {
+            const auto &firsts = lm.map.levelfirsts(m);
+            if (firsts.size() != (size_t) lm.map.size(m) + 1)
+                LogicError("write: inconsistent map at level %d", m);
+            w.put(firsts.data(), sizeof(firsts[0]) * firsts.size());
+            w.align();
+        }
+
+        // the scores
+        for (int m = 0; m <= M; m++)
+            writequantized(w, lm.logP.level(m));
+        for (int m = 0; m < M; m++)
+            writequantized(w, lm.logB.level(m));
+        fflushOrDie(f);
+    }
+
+    // map an image; like CMGramLM::read(), the symbols may be added to 'userSymMap', which defines the space of score()
+    // If 'filterVocabulary', words not in 'userSymMap' are OOVs (the image is not modified by this).
+    template <class SYMMAP>
+    void read(const std::wstring &pathname, SYMMAP &userSymMap, bool filterVocabulary, int maxM = INT_MAX)
+    {
+        mapping = std::make_shared<Microsoft::MSR::CNTK::MemoryMappedFile>(pathname);
+        const char *data = mapping->GetData();
+        cursor c(data, data + mapping->GetSize());
+
+        if (memcmp(c.get<char>(4), "MGLM", 4) != 0)
+            RuntimeError("read: not a binary LM file: %ls", pathname.c_str());
+        if (*c.get<unsigned int>(1) != version)
+            RuntimeError("read: unsupported version of the binary LM file: %ls", pathname.c_str());
+        const int fileM = (int) *c.get<unsigned int>(1);
+        numwords = (int) *c.get<unsigned int>(1);
+        const unsigned long long *sizes = c.get<unsigned long long>(fileM + 1);
+        c.align();
+
+        symboloffsets = c.get<unsigned int>(numwords + 1);
+        symbolchars = c.get<char>(symboloffsets[numwords]);
+        c.align();
+        sortedids = c.get<unsigned int>(numwords);
+        c.align();
+
+        levels.assign(fileM + 1, level());
+        for (int m = 0; m <= fileM; m++)
+            levels[m].size = (size_t) sizes[m];
+        for (int m = 1; m <= fileM; m++)
+        {
+            levels[m].ids = c.get<unsigned char>(3 * levels[m].size);
+            c.align();
+        }
+        for (int m = 0; m < fileM; m++)
+        {
+            levels[m].firsts = c.get<unsigned int>(levels[m].size + 1);
+            c.align();
+        }
+        for (int m = 0; m <= fileM; m++)
+        {
+            levels[m].logPcodebook = c.get<float>(numcodes);
+            levels[m].logP = c.get<unsigned char>(levels[m].size);
+            c.align();
+        }
+        for (int m = 0; m < fileM; m++)
+        {
+            levels[m].logBcodebook = c.get<float>(numcodes);
+            levels[m].logB = c.get<unsigned char>(levels[m].size);
+            c.align();
+        }
+        M = min(fileM, maxM);
+        levels.resize(M + 1);
+
+        level1lookup.assign(numwords, (index_t) nindex);
+        for (index_t i = 0; i < levels[1].size; i++)
+        {
+            int id = id24(levels[1].ids + 3 * (size_t) i);
+            if (id < 0 || id >= numwords)
+                RuntimeError("read: invalid word id in binary LM file: %ls", pathname.c_str());
+            level1lookup[id] = i;
+        }
+
+        // establish mapping of word ids from user to LM space
+        if (!filterVocabulary)
+        {
+            for (int id = 0; id < numwords; id++)
+                userSymMap.sym2id(symbol(id));
+        }
+        w2id.resize(userSymMap.size());
+        for (int w = 0; w < (int) userSymMap.size(); w++)
+            w2id[w] = symboltoid(userSymMap.id2sym(w));
+
+        fprintf(stderr, "read: mapped %ls", pathname.c_str());
+        for (int m = 1; m <= M; m++)
+            fprintf(stderr, ", %d %d-grams", (int) levels[m].size, m);
+        fprintf(stderr, "\n");
+    }
+
+    // like CMGramLM::score(), on the quantized scores
+    virtual double score(const int *mgram, int m) const
+    {
+        if (m > M)
+        {
+            mgram += m - M;
+            m = M;
+        }
+        double totalLogB = 0.0; // accumulated back-off
+        for (;; mgram++, m--)
+        {
+            if (m == 0)
+                return totalLogB + logP(0, 0); // zerogram
+
+            // look up the history
+            index_t i = 0;
+            int n;
+            for (n = 1; n < m; n++)
+            {
+                i = find_child(n - 1, i, map(mgram[n - 1]));
+                if (i == nindex)
+                    break;
+            }
+            if (n < m) // history not found -> fall back
+                continue;
+
+            // full m-gram found -> return it
+            index_t i_m = find_child(m - 1, i, map(mgram[m - 1]));
+            if (i_m != nindex)
+                return totalLogB + logP(m, i_m);
+
+            // history found but predicted word not -> back-off
+            totalLogB += logB(m - 1, i);
+        }
+    }
+
+    virtual bool oov(int w) const
+    {
+        return map(w) < 0;
+    }
+
+    virtual void adapt(const int *, size_t)
+    {
+    } // this LM does not adapt
+
+    virtual IIter *iter(int, int) const
+    {
+        RuntimeError("iter: a binary LM cannot be iterated, use the ARPA file");
+    }
+
+    virtual int order() const
+    {
+        return M;
+    }
+
+    virtual size_t size(int m) const
+    {
+        return levels[m].size;
+    }
+
+    // not tracked: score() keeps no state, such that it can be called concurrently
+    virtual int getLastLongestHistoryFound() const
+    {
+        return -1;
+    }
+    virtual int getLastLongestMGramFound() const
+    {
+        return -1;
+    }
+};
+
 }; }; // namespace
@@ -13,6 +13,10 @@
 #include "minibatchsourcehelpers.h"
 #include "minibatchiterator.h"
 #include "unordered_set"
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 
 namespace msra { namespace dbn {
 
@@ -85,6 +89,48 @@ class minibatchutterancesourcemulti : public minibatchsource
     // Make sure type 'utterancedesc' has a move constructor
     static_assert(std::is_move_constructible<utterancedesc>::value, "Type 'utterancedesc' should be move constructible!");
 
+    // the frames of an utterance kept as stored in a compressed (_C) file, viewed as a vector of column vectors (as required by augmentneighbors())
+    // Values are decompressed as they are copied into the minibatch, in the same way as htkfeatreader does when reading floats.
+    class compressedframesasvectorofvectors
+    {
+        const short *frames; // featdim x numframes, column-major
+        size_t featdim;
+        size_t numframes;
+        const float *a, *b; // [featdim] decompression
+    public:
+        class compressedframe
+        {
+            const short *v;
+            size_t featdim;
+            const float *a, *b;
+        public:
+            compressedframe(const short *v, size_t featdim, const float *a, const float *b)
+                : v(v), featdim(featdim), a(a), b(b)
+            {
+            }
+            size_t size() const
+            {
+                return featdim;
+            }
+            float operator[](size_t k) const
+            {
+                return (v[k] + b[k]) / a[k];
+            }
+        };
+        compressedframesasvectorofvectors(const short *frames, size_t featdim, size_t numframes, const float *a, const float *b)
+            : frames(frames), featdim(featdim), numframes(numframes), a(a), b(b)
+        {
+        }
+        size_t size() const
+        {
+            return numframes;
+        }
+        compressedframe operator[](size_t t) const
+        {
+            return compressedframe(frames + t * featdim, featdim, a, b);
+        }
+    };
+
     struct utterancechunkdata // data for a chunk of utterances
     {
         std::vector<utterancedesc> utteranceset; // utterances in this set
@@ -95,6 +141,9 @@ class minibatchutterancesourcemulti : public minibatchsource
 
         std::vector<size_t> firstframes;                                            // [utteranceindex] first frame for given utterance
         mutable msra::dbn::matrix frames;                                           // stores all frames consecutively (mutable since this is a cache)
+        mutable std::vector<short> compressedframes;                                // or, if all of the chunk is stored compressed (_C), the stored values, featdim per frame
+        mutable std::vector<size_t> decompressionindices;                           // [utteranceindex] index into decompressiona/b[] (utterances of an archive share them)
+        mutable std::vector<std::vector<float>> decompressiona, decompressionb;
         size_t totalframes;                                                         // total #frames for all utterances in this chunk
         mutable std::vector<shared_ptr<const latticesource::latticepair>> lattices; // (may be empty if none)
 
@@ -125,10 +174,20 @@ class minibatchutterancesourcemulti : public minibatchsource
         {
             if (!isinram())
                 LogicError("getutteranceframes: called when data have not been paged in");
+            if (iscompressed())
+                LogicError("getutteranceframes: called when data are kept compressed");
             const size_t ts = firstframes[i];
             const size_t n = numframes(i);
             return msra::dbn::matrixstripe(frames, ts, n);
         }
+        compressedframesasvectorofvectors getcompressedutteranceframes(size_t i) const // same for a chunk that is kept compressed
+        {
+            if (!iscompressed())
+                LogicError("getcompressedutteranceframes: called when data have not been paged in compressed");
+            const size_t featdim = decompressiona[decompressionindices[i]].size();
+            return compressedframesasvectorofvectors(compressedframes.data() + firstframes[i] * featdim, featdim, numframes(i),
+                                                     decompressiona[decompressionindices[i]].data(), decompressionb[decompressionindices[i]].data());
+        }
         shared_ptr<const latticesource::latticepair> getutterancelattice(size_t i) const // return the frame set for a given utterance
         {
             if (!isinram())
@@ -140,11 +199,17 @@ class minibatchutterancesourcemulti : public minibatchsource
         // test if data is in memory at the moment
         bool isinram() const
         {
-            return !frames.empty();
+            return !frames.empty() || iscompressed();
+        }
+        // test if the frames are kept as stored in compressed files
+        bool iscompressed() const
+        {
+            return !compressedframes.empty();
         }
         // page in data for this chunk
         // We pass in the feature info variables by ref which will be filled lazily upon first read
-        void requiredata(string &featkind, size_t &featdim, unsigned int &sampperiod, const latticesource &latticesource, int verbosity = 0) const
+        // With 'keepcompressed', a chunk that is stored compressed (_C) is kept in memory like that, at half the size.
+        void requiredata(string &featkind, size_t &featdim, unsigned int &sampperiod, const latticesource &latticesource, int verbosity = 0, bool keepcompressed = false) const
         {
             if (numutterances() == 0)
                 LogicError("requiredata: cannot page in virgin block");
@@ -160,18 +225,23 @@ class minibatchutterancesourcemulti : public minibatchsource
                     fprintf(stderr, "requiredata: determined feature kind as %d-dimensional '%s' with frame shift %.1f ms\n", (int) featdim, featkind.c_str(), sampperiod / 1e4);
                 }
                 // read all utterances; if they are in the same archive, htkfeatreader will be efficient in not closing the file
-                frames.resize(featdim, totalframes);
+                if (!keepcompressed || !readcompressedframes(reader, featkind, featdim, sampperiod))
+                {
+                    frames.resize(featdim, totalframes);
+                    foreach_index (i, utteranceset)
+                    {
+                        // fprintf (stderr, ".");
+                        // read features for this file
+                        auto uttframes = getutteranceframes(i);                                                    // matrix stripe for this utterance (currently unfilled)
+                        reader.read(utteranceset[i].parsedpath, (const string &)featkind, sampperiod, uttframes, utteranceset[i].needsExpansion);  // note: file info here used for checkuing only
+                    }
+                }
+                // page in lattice data
                 if (!latticesource.empty())
-                    lattices.resize(utteranceset.size());
-                foreach_index (i, utteranceset)
                 {
-                    // fprintf (stderr, ".");
-                    // read features for this file
-                    auto uttframes = getutteranceframes(i);                                                    // matrix stripe for this utterance (currently unfilled)
-                    reader.read(utteranceset[i].parsedpath, (const string &)featkind, sampperiod, uttframes, utteranceset[i].needsExpansion);  // note: file info here used for checkuing only
-                    // page in lattice data
-                    if (!latticesource.empty())
-                        latticesource.getlattices(utteranceset[i].key(), lattices[i], uttframes.cols());
+                    lattices.resize(utteranceset.size());
+                    foreach_index (i, utteranceset)
+                        latticesource.getlattices(utteranceset[i].key(), lattices[i], numframes(i));
                 }
                 // fprintf (stderr, "\n");
                 if (verbosity)
@@ -183,6 +253,36 @@ class minibatchutterancesourcemulti : public minibatchsource
                 throw;
             }
         }
+        // read the stored values of all utterances, if all of them are in compressed files
+        // Returns false, with nothing kept, otherwise.
+        bool readcompressedframes(msra::asr::htkfeatreader &reader, const string &featkind, size_t featdim, unsigned int sampperiod) const
+        {
+            compressedframes.resize(featdim * totalframes);
+            decompressionindices.resize(utteranceset.size());
+            std::vector<float> a, b;
+            foreach_index (i, utteranceset)
+            {
+                if (!reader.readcompressed(utteranceset[i].parsedpath, featkind, sampperiod, compressedframes.data() + firstframes[i] * featdim, numframes(i), a, b, utteranceset[i].needsExpansion))
+                {
+                    releasecompressedframes();
+                    return false;
+                }
+                if (decompressiona.empty() || a != decompressiona.back() || b != decompressionb.back())
+                {
+                    decompressiona.push_back(a);
+                    decompressionb.push_back(b);
+                }
+                decompressionindices[i] = decompressiona.size() - 1;
+            }
+            return true;
+        }
+        void releasecompressedframes() const
+        {
+            std::vector<short>().swap(compressedframes);
+            decompressionindices.clear();
+            decompressiona.clear();
+            decompressionb.clear();
+        }
         // page out data for this chunk
         void releasedata() const
         {
@@ -192,6 +292,7 @@ class minibatchutterancesourcemulti : public minibatchsource
                 LogicError("releasedata: called when data is not memory");
             // release frames
             frames.resize(0, 0);
+            releasecompressedframes();
             // release lattice data
             lattices.clear();
         }
@@ -252,6 +353,33 @@ class minibatchutterancesourcemulti : public minibatchsource
     };
     std::vector<std::vector<chunk>> randomizedchunks; // utterance chunks after being brought into random order (we randomize within a rolling window over them)
     size_t chunksinram;                               // (for diagnostics messages)
+
+    // background paging
+    // With paginglookahead > 0, the chunks that the next 'paginglookahead' minibatches will need are paged in on a
+    // background thread while the current ones are processed, and chunks that leave the window are paged out there.
+    // The resident set is the chunk window of the current minibatch plus that of the last look-ahead minibatch.
+    // The state is kept per chunk of allchunks[][] (the same index for all feature sets), since a chunk stays in RAM
+    // across sweeps. While a chunk is queued for or being paged by the thread, the main thread does not touch its data.
+    enum chunkpagingstate
+    {
+        notinram,
+        loadqueued,
+        loading, // by either thread
+        inram,
+        releasequeued,
+        releasing
+    };
+    const size_t paginglookahead;                      // in minibatches; 0 means paging only when a chunk is needed
+    std::vector<chunkpagingstate> chunkpagingstates;  // [allchunks index]
+    std::deque<size_t> pagingqueue;                    // allchunks indices; entries whose state has changed since are skipped
+    bool stoppaging;
+    std::mutex pagingmutex;                            // protects the four above and chunksinram
+    std::condition_variable pagingwork;                // pagingqueue or stoppaging changed
+    std::condition_variable pagingdone;                // a chunk left the 'loading' or 'releasing' state
+    std::mutex pagingiomutex;                          // serializes requiredata() calls, the lattice source is not thread-safe
+    std::thread pagingthread;                          // started with the first look-ahead request
+
+    const bool keepcompressedfeatures; // keep chunks of compressed (_C) feature files in 16 bits, decompress them into the minibatch
     struct utteranceref                               // describes the underlying random utterance associated with an utterance position
     {
         size_t chunkindex;     // lives in this chunk (index into randomizedchunks[])
@@ -841,8 +969,8 @@ public:
     // This mode requires utterances with time stamps.
     minibatchutterancesourcemulti(const std::vector<std::vector<wstring>> &infiles, const std::vector<map<wstring, std::vector<msra::asr::htkmlfentry>>> &labels,
                                   std::vector<size_t> vdim, std::vector<size_t> udim, std::vector<size_t> leftcontext, std::vector<size_t> rightcontext, size_t randomizationrange,
-                                  const latticesource &lattices, const map<wstring, msra::lattices::lattice::htkmlfwordsequence> &allwordtranscripts, const bool framemode, bool minimizeMemoryFootprint, std::vector<bool> expandToUtt)
-                                  : vdim(vdim), leftcontext(leftcontext), rightcontext(rightcontext), sampperiod(0), featdim(0), randomizationrange(randomizationrange), currentsweep(SIZE_MAX), lattices(lattices), allwordtranscripts(allwordtranscripts), framemode(framemode), chunksinram(0), timegetbatch(0), verbosity(2), m_generatePhoneBoundaries(!lattices.empty()), m_frameRandomizer(randomizedchunks, minimizeMemoryFootprint), expandToUtt(expandToUtt)
+                                  const latticesource &lattices, const map<wstring, msra::lattices::lattice::htkmlfwordsequence> &allwordtranscripts, const bool framemode, bool minimizeMemoryFootprint, std::vector<bool> expandToUtt, size_t paginglookahead = 0, bool keepcompressedfeatures = false)
+                                  : vdim(vdim), leftcontext(leftcontext), rightcontext(rightcontext), sampperiod(0), featdim(0), randomizationrange(randomizationrange), currentsweep(SIZE_MAX), lattices(lattices), allwordtranscripts(allwordtranscripts), framemode(framemode), chunksinram(0), paginglookahead(paginglookahead), stoppaging(false), keepcompressedfeatures(keepcompressedfeatures), timegetbatch(0), verbosity(2), m_generatePhoneBoundaries(!lattices.empty()), m_frameRandomizer(randomizedchunks, minimizeMemoryFootprint), expandToUtt(expandToUtt)
     // [v-hansu] change framemode (lattices.empty()) into framemode (false) to run utterance mode without lattice
     // you also need to change another line, search : [v-hansu] comment out to run utterance mode without lattice
     {
@@ -1163,6 +1291,20 @@ public:
                     (int) numutterances, (int) thisallchunks.size(), numutterances / (double) thisallchunks.size(), _totalframes / (double) thisallchunks.size());
             // Now utterances are stored exclusively in allchunks[]. They are never referred to by a sequential utterance id at this point, only by chunk/within-chunk index.
         }
+        chunkpagingstates.assign(allchunks[0].size(), notinram);
+    }
+
+    ~minibatchutterancesourcemulti()
+    {
+        if (pagingthread.joinable())
+        {
+            {
+                std::lock_guard<std::mutex> lock(pagingmutex);
+                stoppaging = true;
+            }
+            pagingwork.notify_all();
+            pagingthread.join(); // (finishes the chunk it is paging)
+        }
     }
 
 private:
@@ -1395,9 +1537,147 @@ private:
         return sweep;
     }
 
+    // index into allchunks[m] of a randomized chunk, the same for all feature sets
+    size_t allchunkindex(size_t k) const
+    {
+        return randomizedchunks[0][k].uttchunkdata - allchunks[0].begin();
+    }
+
+    // page in a chunk of allchunks[][] for all feature sets
+    // 'numattempts' > 1 retries reading from the network.
+    void pageinchunk(size_t j, size_t numattempts)
+    {
+        std::lock_guard<std::mutex> lock(pagingiomutex);
+        try
+        {
+            foreach_index (m, allchunks)
+            {
+                const auto &chunkdata = allchunks[m][j];
+                msra::util::attempt((int) numattempts, [&]()
+                                    {
+                                        chunkdata.requiredata(featkind[m], featdim[m], sampperiod[m], this->lattices, verbosity, keepcompressedfeatures);
+                                    });
+            }
+        }
+        catch (...) // do not leave some feature sets in RAM
+        {
+            pageoutchunk(j);
+            throw;
+        }
+    }
+
+    void pageoutchunk(size_t j)
+    {
+        foreach_index (m, allchunks)
+        {
+            if (allchunks[m][j].isinram())
+                allchunks[m][j].releasedata();
+        }
+    }
+
+    // the background paging thread
+    void runpagingthread()
+    {
+        std::unique_lock<std::mutex> lock(pagingmutex);
+        for (;;)
+        {
+            pagingwork.wait(lock, [&]()
+                            {
+                                return stoppaging || !pagingqueue.empty();
+                            });
+            if (stoppaging)
+                return;
+            const size_t j = pagingqueue.front();
+            pagingqueue.pop_front();
+            auto &state = chunkpagingstates[j];
+            if (state == loadqueued)
+            {
+                state = loading;
+                lock.unlock();
+                bool loaded = true;
+                try
+                {
+                    pageinchunk(j, 1);
+                }
+                catch (const std::exception &e) // the main thread reads the chunk again when it needs it
+                {
+                    fprintf(stderr, "runpagingthread: failed to page in chunk %d, will retry when needed: %s\n", (int) j, e.what());
+                    loaded = false;
+                }
+                catch (...)
+                {
+                    fprintf(stderr, "runpagingthread: failed to page in chunk %d, will retry when needed\n", (int) j);
+                    loaded = false;
+                }
+                lock.lock();
+                state = loaded ? inram : notinram;
+                if (loaded)
+                    chunksinram++;
+                if (loaded && verbosity)
+                    fprintf(stderr, "runpagingthread: paged in chunk %d, %d resident in RAM\n", (int) j, (int) chunksinram);
+                pagingdone.notify_all();
+            }
+            else if (state == releasequeued)
+            {
+                state = releasing;
+                lock.unlock();
+                pageoutchunk(j);
+                lock.lock();
+                state = notinram;
+                chunksinram--;
+                if (verbosity)
+                    fprintf(stderr, "runpagingthread: paged out chunk %d, %d resident in RAM\n", (int) j, (int) chunksinram);
+                pagingdone.notify_all();
+            }
+        }
+    }
+
+    void queuepaging(size_t j, chunkpagingstate state) // (called with pagingmutex held)
+    {
+        chunkpagingstates[j] = state;
+        pagingqueue.push_back(j);
+        if (!pagingthread.joinable())
+            pagingthread = std::thread([this]()
+                                       {
+                                           runpagingthread();
+                                       });
+        pagingwork.notify_one();
+    }
+
+    // helper to request a chunk ahead of time, to be paged in on the background thread
+    void prefetchrandomizedchunk(size_t k)
+    {
+        // the first read determines the feature kind, which requiredata() writes
+        foreach_index (m, featdim)
+        {
+            if (featdim[m] == 0)
+                return;
+        }
+        const size_t j = allchunkindex(k);
+        std::lock_guard<std::mutex> lock(pagingmutex);
+        auto &state = chunkpagingstates[j];
+        if (state == notinram)
+            queuepaging(j, loadqueued);
+        else if (state == releasequeued) // still here: cancel the release
+            state = inram;
+    }
+
     // helper to page out a chunk with log message
     void releaserandomizedchunk(size_t k)
     {
+        if (paginglookahead > 0)
+        {
+            const size_t j = allchunkindex(k);
+            std::lock_guard<std::mutex> lock(pagingmutex);
+            auto &state = chunkpagingstates[j];
+            if (state == inram)
+                queuepaging(j, releasequeued);
+            else if (state == loadqueued) // not started: cancel the request
+                state = notinram;
+            // a chunk that is being paged in is paged out by a later call
+            return;
+        }
+
         size_t numreleased = 0;
         foreach_index (m, randomizedchunks)
         {
@@ -1432,6 +1712,44 @@ private:
         if (chunkindex < windowbegin || chunkindex >= windowend)
             LogicError("requirerandomizedchunk: requested utterance outside in-memory chunk range");
 
+        if (paginglookahead > 0)
+        {
+            const size_t j = allchunkindex(chunkindex);
+            std::unique_lock<std::mutex> lock(pagingmutex);
+            pagingdone.wait(lock, [&]()
+                            {
+                                return chunkpagingstates[j] != loading && chunkpagingstates[j] != releasing;
+                            });
+            auto &state = chunkpagingstates[j];
+            if (state == inram || state == releasequeued) // (a queued page-out is cancelled)
+            {
+                state = inram;
+                return false;
+            }
+            // not in RAM, or its request not started yet (the thread will skip it): page it in here instead of waiting
+            if (verbosity)
+                fprintf(stderr, "requirerandomizedchunk: paging in randomized chunk %d (frame range [%d..%d]), %d resident in RAM\n",
+                        (int) chunkindex, (int) randomizedchunks[0][chunkindex].globalts, (int) (randomizedchunks[0][chunkindex].globalte() - 1), (int) (chunksinram + 1));
+            state = loading;
+            lock.unlock();
+            try
+            {
+                pageinchunk(j, 5); // (reading from network)
+            }
+            catch (...)
+            {
+                lock.lock();
+                state = notinram;
+                pagingdone.notify_all();
+                throw;
+            }
+            lock.lock();
+            state = inram;
+            chunksinram++;
+            pagingdone.notify_all();
+            return true;
+        }
+
         foreach_index (m, randomizedchunks)
         {
             auto &chunk = randomizedchunks[m][chunkindex];
@@ -1451,7 +1769,7 @@ private:
                     fprintf(stderr, "feature set %d: requirerandomizedchunk: paging in randomized chunk %d (frame range [%d..%d]), %d resident in RAM\n", m, (int) chunkindex, (int) chunk.globalts, (int) (chunk.globalte() - 1), (int) (chunksinram + 1));
                 msra::util::attempt(5, [&]() // (reading from network)
                                     {
-                                        chunkdata.requiredata(featkind[m], featdim[m], sampperiod[m], this->lattices, verbosity);
+                                        chunkdata.requiredata(featkind[m], featdim[m], sampperiod[m], this->lattices, verbosity, keepcompressedfeatures);
                                     });
             }
             chunksinram++;
@@ -1483,6 +1801,25 @@ private:
         }
     };
 
+    // copy frame t of an utterance of feature set i, with its neighbor frames, into column j of 'feat'
+    template <class FRAMES>
+    void augmentframe(const FRAMES &uttframevectors, size_t i, size_t t, msra::dbn::matrix &feat, size_t j) const
+    {
+        const std::vector<char> noboundaryflags; // dummy
+        size_t leftextent, rightextent;
+        // page in the needed range of frames
+        if (leftcontext[i] == 0 && rightcontext[i] == 0)
+        {
+            leftextent = rightextent = augmentationextent(uttframevectors[t].size(), vdim[i]);
+        }
+        else
+        {
+            leftextent = leftcontext[i];
+            rightextent = rightcontext[i];
+        }
+        augmentneighbors(uttframevectors, noboundaryflags, t, leftextent, rightextent, feat, j);
+    }
+
     size_t chunkforframepos(const size_t t) const // find chunk for a given frame position
     {
         // inspect chunk of first feature stream only
@@ -1529,8 +1866,7 @@ public:
         const size_t sweep = lazyrandomization(globalts);
 
         size_t mbframes = 0;
-        const std::vector<char> noboundaryflags; // dummy
-        if (!framemode)                          // regular utterance mode
+        if (!framemode) // regular utterance mode
         {
             // find utterance position for globalts
             // There must be a precise match; it is not possible to specify frames that are not on boundaries.
@@ -1552,13 +1888,21 @@ public:
             // We are a little more blunt for now: Free all outside the range, and page in only what is touched. We could save some loop iterations.
             const size_t windowbegin = positionchunkwindows[spos].windowbegin();
             const size_t windowend = positionchunkwindows[epos - 1].windowend();
+            // With background paging, the chunk windows of the next minibatches (assumed to be of the same size) are kept as well.
+            size_t lookaheadepos = epos;
+            for (size_t lookaheadframes = 0; lookaheadepos < numutterances && lookaheadframes < paginglookahead * framesrequested; lookaheadepos++)
+                lookaheadframes += randomizedutterancerefs[lookaheadepos].numframes;
+            const size_t retainend = lookaheadepos > epos ? max(windowend, positionchunkwindows[lookaheadepos - 1].windowend()) : windowend;
             for (size_t k = 0; k < windowbegin; k++)
                 releaserandomizedchunk(k);
-            for (size_t k = windowend; k < randomizedchunks[0].size(); k++)
+            for (size_t k = retainend; k < randomizedchunks[0].size(); k++)
                 releaserandomizedchunk(k);
             for (size_t pos = spos; pos < epos; pos++)
                 if ((randomizedutterancerefs[pos].chunkindex % numsubsets) == subsetnum)
                     readfromdisk |= requirerandomizedchunk(randomizedutterancerefs[pos].chunkindex, windowbegin, windowend); // (window range passed in for checking only)
+            for (size_t pos = epos; pos < lookaheadepos; pos++)
+                if ((randomizedutterancerefs[pos].chunkindex % numsubsets) == subsetnum)
+                    prefetchrandomizedchunk(randomizedutterancerefs[pos].chunkindex);
 
             // Note that the above loop loops over all chunks incl. those that we already should have.
             // This has an effect, e.g., if 'numsubsets' has changed (we will fill gaps).
@@ -1627,28 +1971,24 @@ public:
                     const auto &chunk = randomizedchunks[i][uttref.chunkindex];
                     const auto &chunkdata = chunk.getchunkdata();
                     assert((numsubsets > 1) || (uttref.globalts == globalts + tspos));
-                    auto uttframes = chunkdata.getutteranceframes(uttref.utteranceindex());
-                    matrixasvectorofvectors uttframevectors(uttframes); // (wrapper that allows m[j].size() and m[j][i] as required by augmentneighbors())
-                    n = uttframevectors.size();
+                    n = chunkdata.numframes(uttref.utteranceindex());
                     sentendmark[i].push_back(n + tspos);
-                    assert(n == uttframes.cols() && uttref.numframes == n && chunkdata.numframes(uttref.utteranceindex()) == n);
+                    assert(uttref.numframes == n);
 
                     // copy the frames and class labels
-                    for (size_t t = 0; t < n; t++) // t = time index into source utterance
+                    if (chunkdata.iscompressed())
                     {
-                        size_t leftextent, rightextent;
-                        // page in the needed range of frames
-                        if (leftcontext[i] == 0 && rightcontext[i] == 0)
-                        {
-                            leftextent = rightextent = augmentationextent(uttframevectors[t].size(), vdim[i]);
-                        }
-                        else
-                        {
-                            leftextent = leftcontext[i];
-                            rightextent = rightcontext[i];
-                        }
-                        augmentneighbors(uttframevectors, noboundaryflags, t, leftextent, rightextent, feat[i], t + tspos);
-                        // augmentneighbors(uttframevectors, noboundaryflags, t, feat[i], t + tspos);
+                        const auto uttframevectors = chunkdata.getcompressedutteranceframes(uttref.utteranceindex());
+                        for (size_t t = 0; t < n; t++) // t = time index into source utterance
+                            augmentframe(uttframevectors, i, t, feat[i], t + tspos);
+                    }
+                    else
+                    {
+                        auto uttframes = chunkdata.getutteranceframes(uttref.utteranceindex());
+                        matrixasvectorofvectors uttframevectors(uttframes); // (wrapper that allows m[j].size() and m[j][i] as required by augmentneighbors())
+                        assert(n == uttframes.cols());
+                        for (size_t t = 0; t < n; t++) // t = time index into source utterance
+                            augmentframe(uttframevectors, i, t, feat[i], t + tspos);
                     }
 
                     // copy the frames and class labels
@@ -1712,13 +2052,23 @@ public:
             if (verbosity > 0)
                 fprintf(stderr, "getbatch: getting randomized frames [%d..%d] (%d frames out of %d requested) in sweep %d; chunks [%d..%d] -> chunk window [%d..%d)\n",
                         (int) globalts, (int) globalte, (int) mbframes, (int) framesrequested, (int) sweep, (int) firstchunk, (int) lastchunk, (int) windowbegin, (int) windowend);
+            // with background paging, the window of the frames of the next minibatches is kept as well, and paged in ahead
+            size_t retainend = windowend;
+            if (paginglookahead > 0 && globalte < sweepte)
+            {
+                const size_t lookaheadglobalte = min(globalte + paginglookahead * framesrequested, sweepte);
+                retainend = max(windowend, randomizedchunks[0][chunkforframepos(lookaheadglobalte - 1)].windowend);
+            }
             // release all data outside, and page in all data inside
             for (size_t k = 0; k < windowbegin; k++)
                 releaserandomizedchunk(k);
             for (size_t k = windowbegin; k < windowend; k++)
                 if ((k % numsubsets) == subsetnum)                                     // in MPI mode, we skip chunks this way
                     readfromdisk |= requirerandomizedchunk(k, windowbegin, windowend); // (window range passed in for checking only, redundant here)
-            for (size_t k = windowend; k < randomizedchunks[0].size(); k++)
+            for (size_t k = windowend; k < retainend; k++)
+                if ((k % numsubsets) == subsetnum)
+                    prefetchrandomizedchunk(k);
+            for (size_t k = retainend; k < randomizedchunks[0].size(); k++)
                 releaserandomizedchunk(k);
 
             // determine the true #frames we return--it is less than mbframes in the case of MPI/data-parallel sub-set mode
@@ -1778,27 +2128,18 @@ public:
                 {
                     const auto &chunk = randomizedchunks[i][frameref.chunkindex];
                     const auto &chunkdata = chunk.getchunkdata();
-                    auto uttframes = chunkdata.getutteranceframes(frameref.utteranceindex());
-                    matrixasvectorofvectors uttframevectors(uttframes); // (wrapper that allows m[.].size() and m[.][.] as required by augmentneighbors())
-                    const size_t n = uttframevectors.size();
-                    assert(n == uttframes.cols() && chunkdata.numframes(frameref.utteranceindex()) == n);
-                    n;
 
                     // copy frame and class labels
                     const size_t t = frameref.frameindex();
-
-                    size_t leftextent, rightextent;
-                    // page in the needed range of frames
-                    if (leftcontext[i] == 0 && rightcontext[i] == 0)
-                    {
-                        leftextent = rightextent = augmentationextent(uttframevectors[t].size(), vdim[i]);
-                    }
+                    if (chunkdata.iscompressed())
+                        augmentframe(chunkdata.getcompressedutteranceframes(frameref.utteranceindex()), i, t, feat[i], currmpinodeframecount);
                     else
                     {
-                        leftextent = leftcontext[i];
-                        rightextent = rightcontext[i];
+                        auto uttframes = chunkdata.getutteranceframes(frameref.utteranceindex());
+                        matrixasvectorofvectors uttframevectors(uttframes); // (wrapper that allows m[.].size() and m[.][.] as required by augmentneighbors())
+                        assert(uttframevectors.size() == uttframes.cols() && chunkdata.numframes(frameref.utteranceindex()) == uttframevectors.size());
+                        augmentframe(uttframevectors, i, t, feat[i], currmpinodeframecount);
                     }
-                    augmentneighbors(uttframevectors, noboundaryflags, t, leftextent, rightextent, feat[i], currmpinodeframecount);
 
                     if (issupervised() && i == 0)
                     {
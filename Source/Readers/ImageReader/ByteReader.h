@@ -10,6 +10,9 @@
 #include <zip.h>
 #include <unordered_map>
 #include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
 #include "ConcStack.h"
 #endif
 
@@ -22,33 +25,66 @@ public:
     virtual ~ByteReader() = default;
 
     virtual void Register(size_t seqId, const std::string& path) = 0;
-    virtual cv::Mat Read(size_t seqId, const std::string& path) = 0;
+
+    // Reads and decodes the image. If 'minimumSide' is not 0, the image may be decoded at a reduced size,
+    // as long as its shorter side is at least 'minimumSide' pixels (see DecodeImage).
+    virtual cv::Mat Read(size_t seqId, const std::string& path, size_t minimumSide) = 0;
 
     DISABLE_COPY_AND_MOVE(ByteReader);
 };
 
+// Decodes an image from memory. If 'minimumSide' is not 0 and the image is a JPEG, it is decoded at 1/2, 1/4 or 1/8
+// of its size, whichever is the smallest with the shorter side still being at least 'minimumSide' pixels long.
+// Reduced size decoding requires OpenCV 3.1 or later, otherwise the image is always decoded in full size.
+cv::Mat DecodeImage(const unsigned char* data, size_t size, size_t minimumSide);
+
 class FileByteReader : public ByteReader
 {
 public:
     void Register(size_t, const std::string&) override {}
-    cv::Mat Read(size_t seqId, const std::string& path) override;
+    cv::Mat Read(size_t seqId, const std::string& path, size_t minimumSide) override;
 };
 
 #ifdef USE_ZIP
+// Reads images from a zip archive.
+// The names, indices and sizes of all entries are read once and cached on disk next to the archive
+// (<archive>.cntkindex, keyed by the size and modification time of the archive), so that subsequent runs do
+// not have to go through the central directory. Entries are read through a small pool of zip handles,
+// so that several threads can read concurrently.
 class ZipByteReader : public ByteReader
 {
 public:
     ZipByteReader(const std::string& zipPath);
 
+    // Not thread safe, all sequences have to be registered before reading.
     void Register(size_t seqId, const std::string& path) override;
-    cv::Mat Read(size_t seqId, const std::string& path) override;
+    cv::Mat Read(size_t seqId, const std::string& path, size_t minimumSide) override;
 
 private:
     using ZipPtr = std::unique_ptr<zip_t, void(*)(zip_t*)>;
     ZipPtr OpenZip();
 
+    // Takes a handle from the pool. A new handle is opened if all handles are in use and the pool is not full yet,
+    // otherwise waits until a handle is returned.
+    ZipPtr AcquireZip();
+    void ReleaseZip(ZipPtr zip);
+
+    // Entry index and uncompressed size by entry name.
+    using EntryMap = std::unordered_map<std::string, std::pair<zip_uint64_t, zip_uint64_t>>;
+    void LoadEntries();
+    bool TryLoadCachedEntries(const std::string& cachePath, uint64_t archiveSize, uint64_t archiveTime);
+    void SaveCachedEntries(const std::string& cachePath, uint64_t archiveSize, uint64_t archiveTime) const;
+
     std::string m_zipPath;
-    conc_stack<ZipPtr> m_zips;
+
+    std::mutex m_zipsLock;
+    std::condition_variable m_zipReleased;
+    std::vector<ZipPtr> m_zips;
+    size_t m_numberOfOpenZips;
+
+    EntryMap m_entries;
+    bool m_entriesLoaded;
+
     std::unordered_map<size_t, std::pair<zip_uint64_t, zip_uint64_t>> m_seqIdToIndex;
     conc_stack<std::vector<unsigned char>> m_workspace;
 };
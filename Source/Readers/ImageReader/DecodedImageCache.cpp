@@ -0,0 +1,67 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+#include "DecodedImageCache.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+static size_t GetImageBytes(const cv::Mat& image)
+{
+    return image.total() * image.elemSize();
+}
+
+DecodedImageCache::DecodedImageCache(size_t capacityInBytes)
+    : m_capacity(capacityInBytes), m_size(0)
+{
+}
+
+bool DecodedImageCache::TryGet(size_t seqId, cv::Mat& image)
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+    auto entry = m_entryBySeqId.find(seqId);
+    if (entry == m_entryBySeqId.end())
+    {
+        return false;
+    }
+
+    m_entries.splice(m_entries.begin(), m_entries, entry->second);
+    image = entry->second->m_image;
+    return true;
+}
+
+void DecodedImageCache::Add(size_t seqId, const cv::Mat& image)
+{
+    size_t bytes = GetImageBytes(image);
+    if (bytes > m_capacity)
+    {
+        return;
+    }
+
+    // The cache keeps its own continuous copy, so that the caller can keep using its image.
+    cv::Mat cached = image.clone();
+
+    std::lock_guard<std::mutex> lock(m_lock);
+    if (m_entryBySeqId.find(seqId) != m_entryBySeqId.end())
+    {
+        // Decoded concurrently on another thread.
+        return;
+    }
+
+    while (m_size + bytes > m_capacity)
+    {
+        assert(!m_entries.empty());
+        const auto& evicted = m_entries.back();
+        m_size -= GetImageBytes(evicted.m_image);
+        m_entryBySeqId.erase(evicted.m_seqId);
+        m_entries.pop_back();
+    }
+
+    m_entries.push_front(Entry{ seqId, cached });
+    m_entryBySeqId[seqId] = m_entries.begin();
+    m_size += bytes;
+}
+
+}}}
@@ -0,0 +1,53 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+#include <opencv2/core/mat.hpp>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include "Basics.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Keeps decoded images in memory across epochs, so that an image is read and decoded only once as long as
+// the decoded images fit into the memory budget. Images are kept as decoded (8 bits per channel), before
+// they are converted to the element type of the stream and augmented. When the budget is exceeded, the least
+// recently used images are evicted. Thread safe.
+class DecodedImageCache
+{
+public:
+    explicit DecodedImageCache(size_t capacityInBytes);
+
+    // Gets the image of the sequence if it is cached. The image shares its data with the cache, so it must not
+    // be modified in place.
+    bool TryGet(size_t seqId, cv::Mat& image);
+
+    // Adds the image of the sequence. Images larger than the whole budget are not cached.
+    void Add(size_t seqId, const cv::Mat& image);
+
+    size_t GetCapacity() const
+    {
+        return m_capacity;
+    }
+
+private:
+    DISABLE_COPY_AND_MOVE(DecodedImageCache);
+
+    struct Entry
+    {
+        size_t m_seqId;
+        cv::Mat m_image;
+    };
+    using EntryList = std::list<Entry>;
+
+    std::mutex m_lock;
+    EntryList m_entries; // the most recently used first
+    std::unordered_map<size_t, EntryList::iterator> m_entryBySeqId;
+    size_t m_capacity;
+    size_t m_size; // of the cached images in bytes
+};
+
+}}}
@@ -4,6 +4,8 @@
 //
 
 #include "stdafx.h"
+#include <algorithm>
+#include <cmath>
 #include "ImageConfigHelper.h"
 #include "StringUtil.h"
 
@@ -29,7 +31,7 @@ namespace Microsoft { namespace MSR { namespace CNTK {
     }
 
     ImageConfigHelper::ImageConfigHelper(const ConfigParameters& config)
-        : m_dataFormat(CHW)
+        : m_dataFormat(CHW), m_minimumDecodedImageSide(0), m_augmentOnDevice(false), m_decodedImageCacheSize(0), m_decodedImageCacheSide(0)
     {
         std::vector<std::string> featureNames = GetSectionsWithParameter(config, "width");
         std::vector<std::string> labelNames = GetSectionsWithParameter(config, "labelDim");
@@ -58,6 +60,30 @@ namespace Microsoft { namespace MSR { namespace CNTK {
             RuntimeError("ImageReader does not support the sample format '%s', only 'nchw' and 'nhwc' are supported.", mbFmt.c_str());
         }
 
+        // JPEG images can be decoded at 1/2, 1/4 or 1/8 of their size, which is considerably faster when
+        // the images are much larger than the network input.
+        if (featureSection(L"reducedSizeDecoding", false))
+        {
+            floatargvector cropRatio = featureSection(L"cropRatio", "1.0");
+            if (!(0 < cropRatio[0] && cropRatio[0] <= 1.0))
+            {
+                RuntimeError("Invalid cropRatio value, must be > 0 and <= 1.");
+            }
+
+            m_minimumDecodedImageSide = static_cast<size_t>(std::ceil(std::max(w, h) / cropRatio[0]));
+        }
+
+        m_augmentOnDevice = featureSection(L"augmentOnDevice", false);
+
+        // Datasets that fit into memory once decoded do not have to be decoded again every epoch.
+        // Images can be cached at a reduced size to fit more of them, augmentations still apply per epoch.
+        m_decodedImageCacheSize = featureSection(L"decodedImageCacheSizeMB", (size_t) 0) * 1024 * 1024;
+        m_decodedImageCacheSide = featureSection(L"decodedImageCacheSide", (size_t) 0);
+        if (m_decodedImageCacheSide > 0 && m_decodedImageCacheSide < std::max(w, h))
+        {
+            RuntimeError("decodedImageCacheSide must be at least the larger of width and height.");
+        }
+
         auto features = std::make_shared<StreamDescription>();
         features->m_id = 0;
         features->m_name = msra::strfun::utf16(featureSection.ConfigName());
@@ -46,6 +46,32 @@ public:
         return m_randomize;
     }
 
+    // Minimum length of the shorter image side after decoding, so that the smallest crop still covers the
+    // requested width and height. 0 if images have to be decoded in full size.
+    size_t GetMinimumDecodedImageSide() const
+    {
+        return m_minimumDecodedImageSide;
+    }
+
+    // Memory budget in bytes for keeping decoded images across epochs, 0 if images are decoded every epoch.
+    size_t GetDecodedImageCacheSize() const
+    {
+        return m_decodedImageCacheSize;
+    }
+
+    // Length the shorter side of images is reduced to before they are cached, 0 to cache them as decoded.
+    size_t GetDecodedImageCacheSide() const
+    {
+        return m_decodedImageCacheSide;
+    }
+
+    // Whether the images are cropped, scaled and mean subtracted on the device of the input matrix
+    // instead of on the CPU, see DeviceStagingTransformer.
+    bool ShouldAugmentOnDevice() const
+    {
+        return m_augmentOnDevice;
+    }
+
 private:
     ImageConfigHelper(const ImageConfigHelper&) = delete;
     ImageConfigHelper& operator=(const ImageConfigHelper&) = delete;
@@ -55,6 +81,10 @@ private:
     ImageLayoutKind m_dataFormat;
     int m_cpuThreadCount;
     bool m_randomize;
+    size_t m_minimumDecodedImageSide;
+    bool m_augmentOnDevice;
+    size_t m_decodedImageCacheSize;
+    size_t m_decodedImageCacheSide;
 };
 
 typedef std::shared_ptr<ImageConfigHelper> ImageConfigHelperPtr;
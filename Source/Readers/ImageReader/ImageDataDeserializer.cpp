@@ -4,9 +4,16 @@
 //
 
 #include "stdafx.h"
+#include <fstream>
 #include <opencv2/opencv.hpp>
 #include "ImageDataDeserializer.h"
 #include "ImageConfigHelper.h"
+#include "PipelineStatistics.h"
+
+// Reduced size decoding (IMREAD_REDUCED_*) is available since OpenCV 3.1.
+#if CV_VERSION_MAJOR > 3 || (CV_VERSION_MAJOR == 3 && CV_VERSION_MINOR >= 1)
+#define HAS_REDUCED_SIZE_DECODING
+#endif
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -116,6 +123,20 @@ ImageDataDeserializer::ImageDataDeserializer(const ConfigParameters& config)
     feature->m_storageType = StorageType::dense;
 
     m_featureElementType = feature->m_elementType;
+    m_minimumDecodedImageSide = configHelper.GetMinimumDecodedImageSide();
+#ifndef HAS_REDUCED_SIZE_DECODING
+    if (m_minimumDecodedImageSide > 0)
+    {
+        fprintf(stderr, "WARNING: reducedSizeDecoding requires OpenCV 3.1 or later, images are decoded in full size.\n");
+    }
+#endif
+
+    m_decodedImageCacheSide = configHelper.GetDecodedImageCacheSide();
+    if (configHelper.GetDecodedImageCacheSize() > 0)
+    {
+        m_decodedImageCache = std::make_unique<DecodedImageCache>(configHelper.GetDecodedImageCacheSize());
+    }
+
     size_t labelDimension = label->m_sampleLayout->GetDim(0);
 
     if (label->m_elementType == ElementType::tfloat)
@@ -247,19 +268,173 @@ void ImageDataDeserializer::RegisterByteReader(size_t seqId, const std::string&
 }
 
 cv::Mat ImageDataDeserializer::ReadImage(size_t seqId, const std::string& path)
+{
+    cv::Mat image;
+    if (!m_decodedImageCache)
+    {
+        return ReadAndDecodeImage(seqId, path);
+    }
+
+    if (m_decodedImageCache->TryGet(seqId, image))
+    {
+        return image;
+    }
+
+    image = ReadAndDecodeImage(seqId, path);
+    if (!image.data)
+    {
+        return image;
+    }
+
+    if (m_decodedImageCacheSide > 0)
+    {
+        int shorterSide = std::min(image.rows, image.cols);
+        if (shorterSide > static_cast<int>(m_decodedImageCacheSide))
+        {
+            PipelineStageTimer timer(PipelineStage::decode);
+            double scale = static_cast<double>(m_decodedImageCacheSide) / shorterSide;
+            cv::resize(image, image, cv::Size(), scale, scale, cv::INTER_AREA);
+        }
+    }
+
+    m_decodedImageCache->Add(seqId, image);
+    return image;
+}
+
+cv::Mat ImageDataDeserializer::ReadAndDecodeImage(size_t seqId, const std::string& path)
 {
     assert(!path.empty());
 
     ImageDataDeserializer::SeqReaderMap::const_iterator r;
     if (m_readers.empty() || (r = m_readers.find(seqId)) == m_readers.end())
-        return m_defaultReader.Read(seqId, path);
-    return (*r).second->Read(seqId, path);
+        return m_defaultReader.Read(seqId, path, m_minimumDecodedImageSide);
+    return (*r).second->Read(seqId, path, m_minimumDecodedImageSide);
 }
 
-cv::Mat FileByteReader::Read(size_t, const std::string& path)
+cv::Mat FileByteReader::Read(size_t, const std::string& path, size_t minimumSide)
 {
     assert(!path.empty());
 
-    return cv::imread(path, cv::IMREAD_COLOR);
+    if (minimumSide == 0)
+    {
+        // The file is read by the decoder, so its time counts as decoding.
+        PipelineStageTimer timer(PipelineStage::decode);
+        return cv::imread(path, cv::IMREAD_COLOR);
+    }
+
+    // The size of the image is needed before decoding, so read the whole file.
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file)
+    {
+        // Empty image, reported by the caller.
+        return cv::Mat();
+    }
+
+    std::vector<unsigned char> contents(static_cast<size_t>(file.tellg()));
+    file.seekg(0);
+    if (contents.empty() || !file.read(reinterpret_cast<char*>(contents.data()), contents.size()))
+    {
+        return cv::Mat();
+    }
+    AddPipelineBytesRead(contents.size());
+
+    return DecodeImage(contents.data(), contents.size(), minimumSide);
+}
+
+#ifdef HAS_REDUCED_SIZE_DECODING
+// Gets the image size from the start of frame segment of a JPEG image, without decoding the image.
+static bool TryGetJpegImageSize(const unsigned char* data, size_t size, size_t& width, size_t& height)
+{
+    // The image has to start with the SOI marker.
+    if (size < 4 || data[0] != 0xFF || data[1] != 0xD8)
+    {
+        return false;
+    }
+
+    size_t position = 2;
+    while (position + 4 <= size)
+    {
+        if (data[position] != 0xFF)
+        {
+            return false;
+        }
+
+        unsigned char marker = data[position + 1];
+        if (marker == 0xFF)
+        {
+            // Fill byte.
+            position++;
+            continue;
+        }
+
+        if (marker == 0x01 || (0xD0 <= marker && marker <= 0xD8))
+        {
+            // Markers without a segment.
+            position += 2;
+            continue;
+        }
+
+        if (marker == 0xD9 || marker == 0xDA)
+        {
+            // End of image or start of scan before the frame header.
+            return false;
+        }
+
+        size_t length = (static_cast<size_t>(data[position + 2]) << 8) | data[position + 3];
+        if (length < 2)
+        {
+            return false;
+        }
+
+        // SOF0-SOF15, except for DHT (C4), JPG (C8) and DAC (CC).
+        if (0xC0 <= marker && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC)
+        {
+            // Marker, length, precision, height and width.
+            if (position + 9 > size)
+            {
+                return false;
+            }
+
+            height = (static_cast<size_t>(data[position + 5]) << 8) | data[position + 6];
+            width = (static_cast<size_t>(data[position + 7]) << 8) | data[position + 8];
+            return width > 0 && height > 0;
+        }
+
+        position += 2 + length;
+    }
+
+    return false;
+}
+#endif
+
+cv::Mat DecodeImage(const unsigned char* data, size_t size, size_t minimumSide)
+{
+    PipelineStageTimer timer(PipelineStage::decode);
+    int flags = cv::IMREAD_COLOR;
+#ifdef HAS_REDUCED_SIZE_DECODING
+    size_t width = 0;
+    size_t height = 0;
+    if (minimumSide > 0 && TryGetJpegImageSize(data, size, width, height))
+    {
+        // The decoder scales in the DCT domain, so reduced images are decoded much faster.
+        size_t shorterSide = std::min(width, height);
+        if (shorterSide >= 8 * minimumSide)
+        {
+            flags = cv::IMREAD_REDUCED_COLOR_8;
+        }
+        else if (shorterSide >= 4 * minimumSide)
+        {
+            flags = cv::IMREAD_REDUCED_COLOR_4;
+        }
+        else if (shorterSide >= 2 * minimumSide)
+        {
+            flags = cv::IMREAD_REDUCED_COLOR_2;
+        }
+    }
+#else
+    UNUSED(minimumSide);
+#endif
+
+    return cv::imdecode(cv::Mat(1, static_cast<int>(size), CV_8UC1, const_cast<unsigned char*>(data)), flags);
 }
 }}}
@@ -8,6 +8,7 @@
 #include "DataDeserializerBase.h"
 #include "Config.h"
 #include "ByteReader.h"
+#include "DecodedImageCache.h"
 #include <unordered_map>
 
 namespace Microsoft { namespace MSR { namespace CNTK {
@@ -60,12 +61,20 @@ private:
     using PathReaderMap = std::unordered_map<std::string, std::shared_ptr<ByteReader>>;
     void RegisterByteReader(size_t seqId, const std::string& path, PathReaderMap& knownReaders);
     cv::Mat ReadImage(size_t seqId, const std::string& path);
+    cv::Mat ReadAndDecodeImage(size_t seqId, const std::string& path);
+
+    // Minimum length of the shorter side of decoded images, 0 for decoding in full size.
+    size_t m_minimumDecodedImageSide;
 
     // REVIEW alexeyk: can potentially use vector instead of map. Need to handle default reader and resizing though.
     using SeqReaderMap = std::unordered_map<size_t, std::shared_ptr<ByteReader>>;
     SeqReaderMap m_readers;
 
     FileByteReader m_defaultReader;
+
+    // Decoded images kept across epochs, null if images are decoded every epoch.
+    std::unique_ptr<DecodedImageCache> m_decodedImageCache;
+    size_t m_decodedImageCacheSide;
 };
 
 }}}
@@ -17,7 +17,7 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 
 ImageReader::ImageReader(MemoryProviderPtr provider,
                          const ConfigParameters& config)
-    : m_seed(0), m_provider(provider)
+    : m_seed(0), m_provider(provider), m_threadCount(0)
 {
     // In the future, deserializers and transformers will be dynamically loaded
     // from external libraries based on the configuration/brain script.
@@ -28,10 +28,10 @@ ImageReader::ImageReader(MemoryProviderPtr provider,
     m_streams = configHelper.GetStreams();
     assert(m_streams.size() == 2);
 
-    int threadCount = configHelper.GetCpuThreadCount();
-    if (threadCount > 0)
+    m_threadCount = configHelper.GetCpuThreadCount();
+    if (m_threadCount > 0)
     {
-        omp_set_num_threads(threadCount);
+        omp_set_num_threads(m_threadCount);
     }
 
     auto deserializer = std::make_shared<ImageDataDeserializer>(config);
@@ -48,6 +48,15 @@ ImageReader::ImageReader(MemoryProviderPtr provider,
 
     randomizer->Initialize(nullptr, config);
 
+    if (configHelper.ShouldAugmentOnDevice())
+    {
+        // The feature stream changes to staged images that are only augmented in ReaderShim.
+        m_transformer = std::make_shared<DeviceStagingTransformer>();
+        m_transformer->Initialize(randomizer, config);
+        m_streams = m_transformer->GetStreamDescriptions();
+        return;
+    }
+
     auto cropper = std::make_shared<CropTransformer>();
     cropper->Initialize(randomizer, config);
 
@@ -91,6 +100,15 @@ void ImageReader::StartEpoch(const EpochConfiguration& config)
 Minibatch ImageReader::ReadMinibatch()
 {
     assert(m_packer != nullptr);
+
+    // Images are decoded and transformed in parallel on the calling thread's OpenMP team.
+    // The number of threads is a per thread setting, and with prefetching minibatches are read on a different
+    // thread than the one that created the reader, so it is set again here.
+    if (m_threadCount > 0)
+    {
+        omp_set_num_threads(m_threadCount);
+    }
+
     return m_packer->ReadMinibatch();
 }
 } } }
@@ -37,13 +37,16 @@ private:
     TransformerPtr m_transformer;
 
     // Packer.
-    SampleModePackerPtr m_packer;
+    PackerPtr m_packer;
 
     // Seed for the random generator.
     unsigned int m_seed;
 
     // Memory provider (TODO: this will possibly change in the near future.)
     MemoryProviderPtr m_provider;
+
+    // Number of OpenMP threads used for decoding and transforming images, 0 for the default.
+    int m_threadCount;
 };
 
 }}}
@@ -5,11 +5,11 @@
 
 #include "stdafx.h"
 #include <algorithm>
+#include <cmath>
 #include <unordered_map>
 #include <random>
 #include "ImageTransformers.h"
 #include "Config.h"
-#include "ConcStack.h"
 #include "ImageConfigHelper.h"
 #include "StringUtil.h"
 #include "ElementTypeUtils.h"
@@ -24,6 +24,14 @@ struct ImageSequenceData : DenseSequenceData
     SequenceDataPtr m_original;
 };
 
+// The class represents a sequence that owns an internal data buffer.
+// Passed from the TransposeTransformer and the DeviceStagingTransformer.
+// TODO: Trasposition potentially could be done in place.
+struct DenseSequenceWithBuffer : DenseSequenceData
+{
+    std::vector<char> m_buffer;
+};
+
 void ImageTransformerBase::Initialize(TransformerPtr next,
                                       const ConfigParameters &readerConfig)
 {
@@ -39,10 +47,23 @@ void ImageTransformerBase::Initialize(TransformerPtr next,
     std::copy(inputStreams.begin(), inputStreams.end(), m_outputStreams.begin());
 }
 
+std::mt19937 ImageTransformerBase::CreateRandomGenerator(size_t sequencePosition, unsigned int salt) const
+{
+    uint64_t position = sequencePosition;
+    std::seed_seq seed{
+        m_seed,
+        static_cast<unsigned int>(GetEpochIndex()),
+        static_cast<unsigned int>(position),
+        static_cast<unsigned int>(position >> 32),
+        salt};
+    return std::mt19937(seed);
+}
+
 SequenceDataPtr
 ImageTransformerBase::Apply(SequenceDataPtr sequence,
                             const StreamDescription &inputStream,
-                            const StreamDescription & /*outputStream*/)
+                            const StreamDescription & /*outputStream*/,
+                            size_t sequencePosition)
 {
     assert(inputStream.m_storageType == StorageType::dense);
     auto inputSequence = static_cast<const DenseSequenceData&>(*sequence.get());
@@ -68,7 +89,7 @@ ImageTransformerBase::Apply(SequenceDataPtr sequence,
     auto result = std::make_shared<ImageSequenceData>();
     int type = CV_MAKETYPE(typeId, channels);
     cv::Mat buffer = cv::Mat(rows, columns, type, inputSequence.m_data);
-    Apply(buffer);
+    Apply(buffer, sequencePosition);
     if (!buffer.isContinuous())
     {
         buffer = buffer.clone();
@@ -131,14 +152,22 @@ void CropTransformer::InitFromConfig(const ConfigParameters &config)
     }
 }
 
-void CropTransformer::Apply(cv::Mat &mat)
+void CropTransformer::Apply(cv::Mat &mat, size_t sequencePosition)
 {
-    auto seed = GetSeed();
-    auto rng = m_rngs.pop_or_create(
-        [seed]()
-        {
-            return std::make_unique<std::mt19937>(seed);
-        });
+    cv::Rect rect;
+    bool flip;
+    DrawCrop(mat.rows, mat.cols, sequencePosition, rect, flip);
+
+    mat = mat(rect);
+    if (flip)
+    {
+        cv::flip(mat, mat, 1);
+    }
+}
+
+void CropTransformer::DrawCrop(int rows, int cols, size_t sequencePosition, cv::Rect &rect, bool &flip)
+{
+    auto rng = CreateRandomGenerator(sequencePosition, 1);
 
     double ratio = 1;
     switch (m_jitterType)
@@ -153,7 +182,7 @@ void CropTransformer::Apply(cv::Mat &mat)
         }
         else
         {
-            ratio = UniRealT(m_cropRatioMin, m_cropRatioMax)(*rng);
+            ratio = UniRealT(m_cropRatioMin, m_cropRatioMax)(rng);
             assert(m_cropRatioMin <= ratio && ratio < m_cropRatioMax);
         }
         break;
@@ -161,13 +190,8 @@ void CropTransformer::Apply(cv::Mat &mat)
         RuntimeError("Jitter type currently not implemented.");
     }
 
-    mat = mat(GetCropRect(m_cropType, mat.rows, mat.cols, ratio, *rng));
-    if (m_hFlip && std::bernoulli_distribution()(*rng))
-    {
-        cv::flip(mat, mat, 1);
-    }
-
-    m_rngs.push(std::move(rng));
+    rect = GetCropRect(m_cropType, rows, cols, ratio, rng);
+    flip = m_hFlip && std::bernoulli_distribution()(rng);
 }
 
 CropTransformer::CropType
@@ -291,7 +315,7 @@ void ScaleTransformer::InitFromConfig(const ConfigParameters &config)
         m_interp.push_back(cv::INTER_LINEAR);
 }
 
-void ScaleTransformer::Apply(cv::Mat &mat)
+void ScaleTransformer::Apply(cv::Mat &mat, size_t sequencePosition)
 {
     // If matrix has not been converted to the right type, do it now as rescaling
     // requires floating point type.
@@ -301,22 +325,18 @@ void ScaleTransformer::Apply(cv::Mat &mat)
         mat.convertTo(mat, m_dataType);
     }
 
-    auto seed = GetSeed();
-    auto rng = m_rngs.pop_or_create(
-        [seed]()
-        {
-            return std::make_unique<std::mt19937>(seed);
-        });
-
-
-    auto index = UniIntT(0, static_cast<int>(m_interp.size()) - 1)(*rng);
     assert(m_interp.size() > 0);
+    int index = 0;
+    if (m_interp.size() > 1)
+    {
+        auto rng = CreateRandomGenerator(sequencePosition, 2);
+        index = UniIntT(0, static_cast<int>(m_interp.size()) - 1)(rng);
+    }
+
     cv::resize(
         mat, mat,
         cv::Size(static_cast<int>(m_imgWidth), static_cast<int>(m_imgHeight)), 0,
         0, m_interp[index]);
-
-    m_rngs.push(std::move(rng));
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -338,10 +358,14 @@ void MeanTransformer::Initialize(TransformerPtr next,
 
 void MeanTransformer::InitFromConfig(const ConfigParameters &config)
 {
+    m_meanImg = LoadMeanImage(config);
+}
+
+cv::Mat MeanTransformer::LoadMeanImage(const ConfigParameters &config)
+{
+    cv::Mat meanImg;
     std::wstring meanFile = config(L"meanFile", L"");
-    if (meanFile.empty())
-        m_meanImg.release();
-    else
+    if (!meanFile.empty())
     {
         cv::FileStorage fs;
         // REVIEW alexeyk: this sort of defeats the purpose of using wstring at
@@ -349,7 +373,7 @@ void MeanTransformer::InitFromConfig(const ConfigParameters &config)
         fs.open(msra::strfun::utf8(meanFile).c_str(), cv::FileStorage::READ);
         if (!fs.isOpened())
             RuntimeError("Could not open file: %ls", meanFile.c_str());
-        fs["MeanImg"] >> m_meanImg;
+        fs["MeanImg"] >> meanImg;
         int cchan;
         fs["Channel"] >> cchan;
         int crow;
@@ -357,14 +381,15 @@ void MeanTransformer::InitFromConfig(const ConfigParameters &config)
         int ccol;
         fs["Col"] >> ccol;
         if (cchan * crow * ccol !=
-            m_meanImg.channels() * m_meanImg.rows * m_meanImg.cols)
+            meanImg.channels() * meanImg.rows * meanImg.cols)
             RuntimeError("Invalid data in file: %ls", meanFile.c_str());
         fs.release();
-        m_meanImg = m_meanImg.reshape(cchan, crow);
+        meanImg = meanImg.reshape(cchan, crow);
     }
+    return meanImg;
 }
 
-void MeanTransformer::Apply(cv::Mat &mat)
+void MeanTransformer::Apply(cv::Mat &mat, size_t /*sequencePosition*/)
 {
     assert(m_meanImg.size() == cv::Size(0, 0) ||
            (m_meanImg.size() == mat.size() &&
@@ -407,7 +432,8 @@ void TransposeTransformer::Initialize(TransformerPtr next,
 SequenceDataPtr
 TransposeTransformer::Apply(SequenceDataPtr inputSequence,
                             const StreamDescription &inputStream,
-                            const StreamDescription &outputStream)
+                            const StreamDescription &outputStream,
+                            size_t /*sequencePosition*/)
 {
     if (inputStream.m_elementType == ElementType::tdouble)
     {
@@ -422,14 +448,6 @@ TransposeTransformer::Apply(SequenceDataPtr inputSequence,
     RuntimeError("Unsupported type");
 }
 
-// The class represents a sequence that owns an internal data buffer.
-// Passed from the TransposeTransformer.
-// TODO: Trasposition potentially could be done in place.
-struct DenseSequenceWithBuffer : DenseSequenceData
-{
-    std::vector<char> m_buffer;
-};
-
 template <class TElemType>
 SequenceDataPtr
 TransposeTransformer::TypedApply(SequenceDataPtr sequence,
@@ -470,4 +488,129 @@ TransposeTransformer::TypedApply(SequenceDataPtr sequence,
     return result;
 }
 
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void DeviceStagingTransformer::Initialize(TransformerPtr next,
+                                          const ConfigParameters &readerConfig)
+{
+    CropTransformer::Initialize(next, readerConfig);
+
+    ImageConfigHelper config(readerConfig);
+    size_t featureStreamId = config.GetFeatureStreamId();
+    const auto &inputStreams = GetInputStreams();
+    const auto &feature = inputStreams[featureStreamId];
+    ConfigParameters featureConfig = readerConfig(feature->m_name);
+
+    m_augmentation = std::make_shared<DeviceImageAugmentation>();
+    m_augmentation->m_width = featureConfig(L"width");
+    m_augmentation->m_height = featureConfig(L"height");
+    m_augmentation->m_channels = featureConfig(L"channels");
+    m_augmentation->m_transposeToCHW = config.GetDataFormat() == CHW;
+    if (m_augmentation->GetOutputSampleSize() == 0)
+    {
+        RuntimeError("Invalid image dimensions.");
+    }
+
+    // By default the staging image is just large enough for the smallest crop of a square image
+    // to cover the requested width and height.
+    double cropRatio = GetMinimumCropRatio();
+    m_augmentation->m_stagingWidth = featureConfig(L"stagingWidth", static_cast<size_t>(std::ceil(m_augmentation->m_width / cropRatio)));
+    m_augmentation->m_stagingHeight = featureConfig(L"stagingHeight", static_cast<size_t>(std::ceil(m_augmentation->m_height / cropRatio)));
+    if (m_augmentation->m_stagingWidth == 0 || m_augmentation->m_stagingHeight == 0)
+    {
+        RuntimeError("Invalid staging image dimensions.");
+    }
+
+    cv::Mat meanImg = MeanTransformer::LoadMeanImage(featureConfig);
+    if (!meanImg.empty())
+    {
+        if (meanImg.cols != static_cast<int>(m_augmentation->m_width) ||
+            meanImg.rows != static_cast<int>(m_augmentation->m_height) ||
+            meanImg.channels() != static_cast<int>(m_augmentation->m_channels))
+        {
+            RuntimeError("The mean image does not match the image dimensions.");
+        }
+
+        meanImg.convertTo(meanImg, CV_MAKETYPE(CV_32F, meanImg.channels()));
+        assert(meanImg.isContinuous());
+        const float *mean = meanImg.ptr<float>();
+        m_augmentation->m_mean.assign(mean, mean + m_augmentation->GetOutputSampleSize());
+    }
+
+    m_outputStreams.resize(inputStreams.size());
+    std::copy(inputStreams.begin(), inputStreams.end(), m_outputStreams.begin());
+
+    auto stagedStream = std::make_shared<StreamDescription>(*feature);
+    stagedStream->m_sampleLayout = std::make_shared<TensorShape>(m_augmentation->GetStagedSampleSize());
+    stagedStream->m_deviceAugmentation = m_augmentation;
+    m_outputStreams[featureStreamId] = stagedStream;
+}
+
+SequenceDataPtr
+DeviceStagingTransformer::Apply(SequenceDataPtr inputSequence,
+                                const StreamDescription &inputStream,
+                                const StreamDescription &outputStream,
+                                size_t sequencePosition)
+{
+    assert(inputStream.m_storageType == StorageType::dense);
+    if (inputStream.m_elementType == ElementType::tdouble)
+    {
+        return TypedApply<double>(inputSequence, outputStream, sequencePosition);
+    }
+
+    if (inputStream.m_elementType == ElementType::tfloat)
+    {
+        return TypedApply<float>(inputSequence, outputStream, sequencePosition);
+    }
+
+    RuntimeError("Unsupported type");
+}
+
+template <class TElemType>
+SequenceDataPtr
+DeviceStagingTransformer::TypedApply(SequenceDataPtr sequence,
+                                     const StreamDescription &outputStream,
+                                     size_t sequencePosition)
+{
+    auto inputSequence = static_cast<const DenseSequenceData&>(*sequence.get());
+    assert(inputSequence.m_numberOfSamples == 1);
+    ImageDimensions dimensions(*inputSequence.m_sampleLayout, HWC);
+    int columns = static_cast<int>(dimensions.m_width);
+    int rows = static_cast<int>(dimensions.m_height);
+    int channels = static_cast<int>(dimensions.m_numChannels);
+    if (channels != static_cast<int>(m_augmentation->m_channels))
+    {
+        RuntimeError("The image has %d channels, %d expected.", channels, static_cast<int>(m_augmentation->m_channels));
+    }
+
+    // The crop is drawn on the decoded image, so it is the same as the one of the CropTransformer.
+    cv::Rect rect;
+    bool flip;
+    DrawCrop(rows, columns, sequencePosition, rect, flip);
+
+    auto result = std::make_shared<DenseSequenceWithBuffer>();
+    result->m_buffer.resize(outputStream.m_sampleLayout->GetNumElements() * sizeof(TElemType));
+    TElemType* typedBuffer = reinterpret_cast<TElemType*>(result->m_buffer.data());
+
+    int type = CV_MAKETYPE(cv::DataType<TElemType>::depth, channels);
+    cv::Mat image(rows, columns, type, inputSequence.m_data);
+    cv::Mat staging(static_cast<int>(m_augmentation->m_stagingHeight), static_cast<int>(m_augmentation->m_stagingWidth), type, typedBuffer);
+    cv::resize(image, staging, staging.size(), 0, 0, cv::INTER_LINEAR);
+    assert(staging.data == reinterpret_cast<uchar*>(typedBuffer));
+
+    double scaleX = static_cast<double>(m_augmentation->m_stagingWidth) / columns;
+    double scaleY = static_cast<double>(m_augmentation->m_stagingHeight) / rows;
+    TElemType* parameters = typedBuffer + m_augmentation->GetStagedSampleSize() - DeviceImageAugmentation::kDeviceAugmentationParameterCount;
+    parameters[0] = static_cast<TElemType>(rect.x * scaleX);
+    parameters[1] = static_cast<TElemType>(rect.y * scaleY);
+    parameters[2] = static_cast<TElemType>(rect.width * scaleX);
+    parameters[3] = static_cast<TElemType>(rect.height * scaleY);
+    parameters[4] = flip ? 1 : 0;
+
+    result->m_sampleLayout = outputStream.m_sampleLayout;
+    result->m_data = result->m_buffer.data();
+    result->m_numberOfSamples = inputSequence.m_numberOfSamples;
+    return result;
+}
+
 }}}
@@ -10,7 +10,6 @@
 #include <opencv2/opencv.hpp>
 
 #include "Transformer.h"
-#include "ConcStack.h"
 #include "TransformerBase.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
@@ -47,13 +46,20 @@ protected:
     using UniRealT = std::uniform_real_distribution<double>;
     using UniIntT = std::uniform_int_distribution<int>;
 
+    // Creates a random generator for the sequence at the given position of the current epoch.
+    // The generator only depends on the seed, the epoch and the sequence position, so the jitter
+    // is reproducible no matter on which thread the sequence is transformed.
+    // Transformers pass different salts to get independent random streams for the same sequence.
+    std::mt19937 CreateRandomGenerator(size_t sequencePosition, unsigned int salt) const;
+
     // Applies transformation to the sequence.
     SequenceDataPtr Apply(SequenceDataPtr inputSequence,
                           const StreamDescription &inputStream,
-                          const StreamDescription &outputStream) override;
+                          const StreamDescription &outputStream,
+                          size_t sequencePosition) override;
 
     // The only function that should be redefined by the inherited classes.
-    virtual void Apply(cv::Mat &from) = 0;
+    virtual void Apply(cv::Mat &from, size_t sequencePosition) = 0;
 
 private:
     std::vector<StreamDescriptionPtr> m_outputStreams;
@@ -70,7 +76,16 @@ public:
                             const ConfigParameters &readerConfig) override;
 
 protected:
-    virtual void Apply(cv::Mat &mat) override;
+    virtual void Apply(cv::Mat &mat, size_t sequencePosition) override;
+
+    // Draws the crop rectangle and whether to flip it horizontally for the sequence at the given position,
+    // given the size of its image.
+    void DrawCrop(int rows, int cols, size_t sequencePosition, cv::Rect &rect, bool &flip);
+
+    double GetMinimumCropRatio() const
+    {
+        return m_cropRatioMin;
+    }
 
 private:
     enum class CropType
@@ -92,7 +107,6 @@ private:
     cv::Rect GetCropRect(CropType type, int crow, int ccol, double cropRatio,
                          std::mt19937 &rng);
 
-    conc_stack<std::unique_ptr<std::mt19937>> m_rngs;
     CropType m_cropType;
     double m_cropRatioMin;
     double m_cropRatioMax;
@@ -110,13 +124,12 @@ public:
 
 private:
     void InitFromConfig(const ConfigParameters &config);
-    virtual void Apply(cv::Mat &mat) override;
+    virtual void Apply(cv::Mat &mat, size_t sequencePosition) override;
 
     using StrToIntMapT = std::unordered_map<std::string, int>;
     StrToIntMapT m_interpMap;
     std::vector<int> m_interp;
 
-    conc_stack<std::unique_ptr<std::mt19937>> m_rngs;
     int m_dataType;
     size_t m_imgWidth;
     size_t m_imgHeight;
@@ -130,13 +143,47 @@ public:
     virtual void Initialize(TransformerPtr next,
                             const ConfigParameters &readerConfig) override;
 
+    // Loads the mean image from the 'meanFile' of the config, returns an empty image if there is none.
+    static cv::Mat LoadMeanImage(const ConfigParameters &config);
+
 private:
-    virtual void Apply(cv::Mat &mat) override;
+    virtual void Apply(cv::Mat &mat, size_t sequencePosition) override;
     void InitFromConfig(const ConfigParameters &config);
 
     cv::Mat m_meanImg;
 };
 
+// Replaces crop, scale, mean and transpose transformations when the images are augmented on the device.
+// Each image is only resized to the staging size on the host; the crop and flip drawn as by the
+// CropTransformer are appended to it, see DeviceImageAugmentation. ReaderShim then crops, scales,
+// flips and subtracts the mean of the whole minibatch on the device of the input matrix.
+class DeviceStagingTransformer : public CropTransformer
+{
+public:
+    virtual void Initialize(TransformerPtr next,
+                            const ConfigParameters &readerConfig) override;
+
+protected:
+    virtual const std::vector<StreamDescriptionPtr>& GetOutputStreams() const override
+    {
+        return m_outputStreams;
+    }
+
+    SequenceDataPtr Apply(SequenceDataPtr inputSequence,
+                          const StreamDescription &inputStream,
+                          const StreamDescription &outputStream,
+                          size_t sequencePosition) override;
+
+private:
+    template <class TElement>
+    SequenceDataPtr TypedApply(SequenceDataPtr inputSequence,
+                               const StreamDescription &outputStream,
+                               size_t sequencePosition);
+
+    std::vector<StreamDescriptionPtr> m_outputStreams;
+    DeviceImageAugmentationPtr m_augmentation;
+};
+
 // Transpose transformation from HWC to CHW.
 class TransposeTransformer : public TransformerBase
 {
@@ -157,7 +204,8 @@ protected:
 
     SequenceDataPtr Apply(SequenceDataPtr inputSequence,
                           const StreamDescription &inputStream,
-                          const StreamDescription &outputStream) override;
+                          const StreamDescription &outputStream,
+                          size_t sequencePosition) override;
 
 private:
     template <class TElement>
@@ -4,13 +4,23 @@
 //
 
 #include "stdafx.h"
+#include <fstream>
+#include <sys/types.h>
+#include <sys/stat.h>
 #include <opencv2/opencv.hpp>
 #include "ByteReader.h"
+#include "PipelineStatistics.h"
 
 #ifdef USE_ZIP
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
+// Maximum number of zip handles per archive. Every handle holds its own copy of the central directory,
+// which is large for archives with millions of images, and reading an entry is cheap compared to decoding it.
+static const size_t c_maxZipHandles = 4;
+
+static const uint64_t c_zipIndexCacheMagic = 0x315844494e49505aull; // "ZIPINDX1"
+
 std::string GetZipError(int err)
 {
     zip_error_t error;
@@ -20,8 +30,37 @@ std::string GetZipError(int err)
     return errS;
 }
 
+// Gets the size and the modification time of the file, which identify the version of the archive the cached index belongs to.
+static bool GetFileStamp(const std::string& path, uint64_t& size, uint64_t& time)
+{
+#ifdef _WIN32
+    struct _stat64 s;
+    if (_stat64(path.c_str(), &s) != 0)
+        return false;
+#else
+    struct stat s;
+    if (stat(path.c_str(), &s) != 0)
+        return false;
+#endif
+    size = static_cast<uint64_t>(s.st_size);
+    time = static_cast<uint64_t>(s.st_mtime);
+    return true;
+}
+
+template <class T>
+static bool ReadValue(std::istream& stream, T& value)
+{
+    return !!stream.read(reinterpret_cast<char*>(&value), sizeof(value));
+}
+
+template <class T>
+static void WriteValue(std::ostream& stream, const T& value)
+{
+    stream.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
 ZipByteReader::ZipByteReader(const std::string& zipPath)
-    : m_zipPath(zipPath)
+    : m_zipPath(zipPath), m_numberOfOpenZips(0), m_entriesLoaded(false)
 {
     assert(!m_zipPath.empty());
 }
@@ -44,19 +83,165 @@ ZipByteReader::ZipPtr ZipByteReader::OpenZip()
     });
 }
 
+ZipByteReader::ZipPtr ZipByteReader::AcquireZip()
+{
+    {
+        std::unique_lock<std::mutex> lock(m_zipsLock);
+        m_zipReleased.wait(lock, [this]() { return !m_zips.empty() || m_numberOfOpenZips < c_maxZipHandles; });
+        if (!m_zips.empty())
+        {
+            auto zip = std::move(m_zips.back());
+            m_zips.pop_back();
+            return zip;
+        }
+        m_numberOfOpenZips++;
+    }
+
+    // Opening reads the whole central directory, so it is done outside of the lock.
+    try
+    {
+        return OpenZip();
+    }
+    catch (...)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_zipsLock);
+            m_numberOfOpenZips--;
+        }
+        m_zipReleased.notify_one();
+        throw;
+    }
+}
+
+void ZipByteReader::ReleaseZip(ZipPtr zip)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_zipsLock);
+        m_zips.push_back(std::move(zip));
+    }
+    m_zipReleased.notify_one();
+}
+
+void ZipByteReader::LoadEntries()
+{
+    assert(!m_entriesLoaded);
+    m_entriesLoaded = true;
+
+    std::string cachePath = m_zipPath + ".cntkindex";
+    uint64_t archiveSize = 0;
+    uint64_t archiveTime = 0;
+    bool canCache = GetFileStamp(m_zipPath, archiveSize, archiveTime);
+    if (canCache && TryLoadCachedEntries(cachePath, archiveSize, archiveTime))
+    {
+        return;
+    }
+
+    auto zipFile = AcquireZip();
+    zip_int64_t numberOfEntries = zip_get_num_entries(zipFile.get(), 0);
+    m_entries.reserve(static_cast<size_t>(numberOfEntries));
+    for (zip_int64_t i = 0; i < numberOfEntries; ++i)
+    {
+        zip_stat_t stat;
+        zip_stat_init(&stat);
+        int err = zip_stat_index(zipFile.get(), static_cast<zip_uint64_t>(i), 0, &stat);
+        if (ZIP_ER_OK != err)
+            RuntimeError("Failed to get info of entry %d in %s, zip library error: %s", (int)i, m_zipPath.c_str(),
+                         GetZipError(zip_error_code_zip(zip_get_error(zipFile.get()))).c_str());
+
+        if ((stat.valid & ZIP_STAT_NAME) && (stat.valid & ZIP_STAT_SIZE))
+            m_entries[stat.name] = std::make_pair(stat.index, stat.size);
+    }
+    ReleaseZip(std::move(zipFile));
+
+    if (canCache)
+    {
+        SaveCachedEntries(cachePath, archiveSize, archiveTime);
+    }
+}
+
+bool ZipByteReader::TryLoadCachedEntries(const std::string& cachePath, uint64_t archiveSize, uint64_t archiveTime)
+{
+    std::ifstream file(cachePath, std::ios::binary);
+    if (!file)
+        return false;
+
+    uint64_t magic, size, time, numberOfEntries;
+    if (!ReadValue(file, magic) || magic != c_zipIndexCacheMagic ||
+        !ReadValue(file, size) || size != archiveSize ||
+        !ReadValue(file, time) || time != archiveTime ||
+        !ReadValue(file, numberOfEntries))
+    {
+        return false;
+    }
+
+    m_entries.reserve(static_cast<size_t>(numberOfEntries));
+    std::string name;
+    for (uint64_t i = 0; i < numberOfEntries; ++i)
+    {
+        zip_uint64_t index, entrySize;
+        uint32_t nameLength;
+        // Zip entry names are at most 64K long.
+        if (!ReadValue(file, index) || !ReadValue(file, entrySize) || !ReadValue(file, nameLength) || nameLength > 0xFFFF)
+        {
+            m_entries.clear();
+            return false;
+        }
+
+        name.resize(nameLength);
+        if (nameLength > 0 && !file.read(&name[0], nameLength))
+        {
+            m_entries.clear();
+            return false;
+        }
+
+        m_entries[name] = std::make_pair(index, entrySize);
+    }
+
+    return true;
+}
+
+void ZipByteReader::SaveCachedEntries(const std::string& cachePath, uint64_t archiveSize, uint64_t archiveTime) const
+{
+    // The cache is optional, e.g. the directory of the archive may be read only.
+    std::ofstream file(cachePath, std::ios::binary | std::ios::trunc);
+    if (file)
+    {
+        WriteValue(file, c_zipIndexCacheMagic);
+        WriteValue(file, archiveSize);
+        WriteValue(file, archiveTime);
+        WriteValue(file, static_cast<uint64_t>(m_entries.size()));
+        for (const auto& entry : m_entries)
+        {
+            WriteValue(file, entry.second.first);
+            WriteValue(file, entry.second.second);
+            WriteValue(file, static_cast<uint32_t>(entry.first.size()));
+            file.write(entry.first.data(), entry.first.size());
+        }
+        file.flush();
+    }
+
+    if (!file)
+    {
+        fprintf(stderr, "WARNING: Could not write the zip index cache %s.\n", cachePath.c_str());
+        file.close();
+        remove(cachePath.c_str());
+    }
+}
+
 void ZipByteReader::Register(size_t seqId, const std::string& path)
 {
-    auto zipFile = m_zips.pop_or_create([this]() { return OpenZip(); });
-    zip_stat_t stat;
-    zip_stat_init(&stat);
-    int err = zip_stat(zipFile.get(), path.c_str(), 0, &stat);
-    if (ZIP_ER_OK != err)
-        RuntimeError("Failed to get file info of %s, zip library error: %s", path.c_str(), GetZipError(err).c_str());
-    m_seqIdToIndex[seqId] = std::make_pair(stat.index, stat.size);
-    m_zips.push(std::move(zipFile));
+    if (!m_entriesLoaded)
+    {
+        LoadEntries();
+    }
+
+    auto entry = m_entries.find(path);
+    if (entry == m_entries.end())
+        RuntimeError("Failed to get file info of %s, the file does not exist in %s", path.c_str(), m_zipPath.c_str());
+    m_seqIdToIndex[seqId] = entry->second;
 }
 
-cv::Mat ZipByteReader::Read(size_t seqId, const std::string& path)
+cv::Mat ZipByteReader::Read(size_t seqId, const std::string& path, size_t minimumSide)
 {
     // Find index of the file in .zip file.
     auto r = m_seqIdToIndex.find(seqId);
@@ -69,10 +254,17 @@ cv::Mat ZipByteReader::Read(size_t seqId, const std::string& path)
     auto contents = m_workspace.pop_or_create([size]() { return vector<unsigned char>(size); });
     if (contents.size() < size)
         contents.resize(size);
-    auto zipFile = m_zips.pop_or_create([this]() { return OpenZip(); });
     {
+        // Returns the handle to the pool also if reading fails.
+        struct PooledZip
+        {
+            ZipByteReader& m_reader;
+            ZipPtr m_zip;
+            ~PooledZip() { m_reader.ReleaseZip(std::move(m_zip)); }
+        } zipFile{ *this, AcquireZip() };
+
         std::unique_ptr<zip_file_t, void(*)(zip_file_t*)> file(
-            zip_fopen_index(zipFile.get(), index, 0),
+            zip_fopen_index(zipFile.m_zip.get(), index, 0),
             [](zip_file_t* f)
             {
                 assert(f != nullptr);
@@ -86,7 +278,7 @@ cv::Mat ZipByteReader::Read(size_t seqId, const std::string& path)
         if (nullptr == file)
         {
             RuntimeError("Could not open file %s in the zip file, sequence id = %lu, zip library error: %s",
-                         path.c_str(), (long)seqId, GetZipError(zip_error_code_zip(zip_get_error(zipFile.get()))).c_str());
+                         path.c_str(), (long)seqId, GetZipError(zip_error_code_zip(zip_get_error(zipFile.m_zip.get()))).c_str());
         }
         assert(contents.size() >= size);
         zip_uint64_t bytesRead = zip_fread(file.get(), contents.data(), size);
@@ -96,14 +288,14 @@ cv::Mat ZipByteReader::Read(size_t seqId, const std::string& path)
             RuntimeError("Bytes read %lu != expected %lu while reading file %s",
                          (long)bytesRead, (long)size, path.c_str());
         }
+        AddPipelineBytesRead(size);
     }
-    m_zips.push(std::move(zipFile));
 
-    cv::Mat img = cv::imdecode(cv::Mat(1, (int)size, CV_8UC1, contents.data()), cv::IMREAD_COLOR);
+    cv::Mat img = DecodeImage(contents.data(), size, minimumSide);
     assert(nullptr != img.data);
     m_workspace.push(std::move(contents));
     return img;
 }
 }}}
 
-#endif
\ No newline at end of file
+#endif
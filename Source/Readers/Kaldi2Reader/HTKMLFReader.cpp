@@ -174,6 +174,8 @@ void HTKMLFReader<ElemType>::PrepareForSequenceTraining(const ConfigRecordType&
     acousticScale = denlatConfig(L"acousticScale", 0.2);
     lmScale = denlatConfig(L"lmScale", 1.0);
     oneSilenceClass = denlatConfig(L"oneSilenceClass", true);
+    // the derivatives of the utterances completed by a minibatch are computed on this many threads
+    int numThreads = denlatConfig(L"numThreads", 4);
 
     // Processes "alignments" section.
     const ConfigRecordType& aliConfig = readerConfig(L"alignments");
@@ -216,7 +218,7 @@ void HTKMLFReader<ElemType>::PrepareForSequenceTraining(const ConfigRecordType&
     m_seqTrainDeriv = new KaldiSequenceTrainingDerivative<ElemType>(
         denlatRspecifier, aliRspecifier, transModelFilename,
         silencePhoneStr, m_seqTrainCriterion, oldAcousticScale,
-        acousticScale, lmScale, oneSilenceClass);
+        acousticScale, lmScale, oneSilenceClass, numThreads);
 
     // Initializes derivative buffering.
     m_doMinibatchBuffering = true;
@@ -316,7 +318,10 @@ void HTKMLFReader<ElemType>::PrepareForTrainingOrTesting(const ConfigRecordType&
         m_featureNameToIdMap[featureNames[i]] = iFeat;
         assert(iFeat == m_featureIdToNameMap.size());
         m_featureIdToNameMap.push_back(featureNames[i]);
-        scriptpaths.push_back(new msra::asr::FeatureSection(thisFeature(L"scpFile"), thisFeature(L"rx"), thisFeature(L"featureTransform", L"")));
+        // plain scp: or ark: tables are read in-process, and then the utterances of a chunk by 'numLoadThreads' threads
+        scriptpaths.push_back(new msra::asr::FeatureSection(thisFeature(L"scpFile"), thisFeature(L"rx"), thisFeature(L"featureTransform", L""),
+                                                            thisFeature(L"cmvnRx", L""), thisFeature(L"utt2spk", L""), thisFeature(L"normVars", false),
+                                                            thisFeature(L"nativeIO", true), thisFeature(L"numLoadThreads", 4)));
         m_featureNameToDimMap[featureNames[i]] = m_featDims[i];
 
         m_featuresBufferMultiIO.push_back(NULL);
@@ -627,7 +632,9 @@ void HTKMLFReader<ElemType>::PrepareForWriting(const ConfigRecordType& readerCon
         m_featureNameToIdMap[featureNames[i]] = iFeat;
         assert(iFeat == m_featureIdToNameMap.size());
         m_featureIdToNameMap.push_back(featureNames[i]);
-        scriptpaths.push_back(new msra::asr::FeatureSection(thisFeature("scpFile"), thisFeature("rx"), thisFeature("featureTransform", "")));
+        scriptpaths.push_back(new msra::asr::FeatureSection(thisFeature("scpFile"), thisFeature("rx"), thisFeature("featureTransform", ""),
+                                                            thisFeature("cmvnRx", ""), thisFeature("utt2spk", ""), thisFeature("normVars", "false"),
+                                                            thisFeature("nativeIO", "true")));
         m_featureNameToDimMap[featureNames[i]] = realDims[i];
 
         m_featuresBufferMultiIO.push_back(NULL);
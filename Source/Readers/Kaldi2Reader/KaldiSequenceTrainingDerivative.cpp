@@ -11,7 +11,7 @@ KaldiSequenceTrainingDerivative<ElemType>::KaldiSequenceTrainingDerivative(
     const wstring& transModelFilename, const wstring& silencePhoneStr,
     const wstring& trainCriterion,
     ElemType oldAcousticScale, ElemType acousticScale,
-    ElemType lmScale, bool oneSilenceClass)
+    ElemType lmScale, bool oneSilenceClass, int numThreads)
 {
     using namespace msra::asr;
     assert(denlatRspecifier != L"");
@@ -26,6 +26,7 @@ KaldiSequenceTrainingDerivative<ElemType>::KaldiSequenceTrainingDerivative(
     m_lmScale = lmScale;
     m_trainCriterion = trainCriterion;
     m_oneSilenceClass = oneSilenceClass;
+    m_numThreads = numThreads > 0 ? numThreads : 1;
     if (!kaldi::SplitStringToIntegers(toStr(silencePhoneStr),
                                       ":", false, &m_silencePhones))
     {
@@ -52,8 +53,6 @@ bool KaldiSequenceTrainingDerivative<ElemType>::ComputeDerivative(
     Matrix<ElemType>* derivative,
     ElemType* objective)
 {
-    std::string uttIDStr = msra::asr::toStr(uttID);
-
     // Sanity check.
     if (m_transModel.NumPdfs() != logLikelihood.GetNumRows())
     {
@@ -63,18 +62,91 @@ bool KaldiSequenceTrainingDerivative<ElemType>::ComputeDerivative(
                      (int) m_transModel.NumPdfs());
     }
 
+    std::vector<int32> ali;
+    kaldi::CompactLattice clat;
+    ReadResources(uttID, logLikelihood.GetNumCols(), &ali, &clat);
+    ComputeDerivativeFromResources(uttID, logLikelihood, ali, clat,
+                                   derivative, objective);
+    return true;
+}
+
+template <class ElemType>
+void KaldiSequenceTrainingDerivative<ElemType>::ComputeDerivatives(
+    const std::vector<wstring>& uttIDs,
+    const std::vector<const Matrix<ElemType>*>& logLikelihoods,
+    const std::vector<Matrix<ElemType>*>& derivatives,
+    const std::vector<ElemType*>& objectives)
+{
+    if (m_numThreads == 1 || uttIDs.size() < 2)
+    {
+        for (size_t i = 0; i < uttIDs.size(); ++i)
+        {
+            ComputeDerivative(uttIDs[i], *logLikelihoods[i], derivatives[i],
+                              objectives[i]);
+        }
+        return;
+    }
+
+    std::vector<std::vector<int32>> alis(uttIDs.size());
+    std::vector<kaldi::CompactLattice> clats(uttIDs.size());
+    for (size_t i = 0; i < uttIDs.size(); ++i)
+    {
+        if (m_transModel.NumPdfs() != logLikelihoods[i]->GetNumRows())
+        {
+            RuntimeError("Number of labels in logLikelihood does not match that"
+                         " in the Kaldi model for utterance %S: %d v.s. %d\n",
+                         uttIDs[i].c_str(), (int) logLikelihoods[i]->GetNumRows(),
+                         (int) m_transModel.NumPdfs());
+        }
+        ReadResources(uttIDs[i], logLikelihoods[i]->GetNumCols(),
+                      &alis[i], &clats[i]);
+    }
+
+    // The first error is rethrown once all threads are done.
+    std::exception_ptr error;
+#pragma omp parallel for num_threads(m_numThreads) schedule(dynamic)
+    for (int i = 0; i < (int) uttIDs.size(); ++i)
+    {
+        try
+        {
+            ComputeDerivativeFromResources(uttIDs[i], *logLikelihoods[i],
+                                           alis[i], clats[i], derivatives[i],
+                                           objectives[i]);
+        }
+        catch (...)
+        {
+#pragma omp critical
+            if (!error)
+            {
+                error = std::current_exception();
+            }
+        }
+    }
+    if (error)
+    {
+        std::rethrow_exception(error);
+    }
+}
+
+template <class ElemType>
+void KaldiSequenceTrainingDerivative<ElemType>::ReadResources(
+    const wstring& uttID, size_t numFrames,
+    std::vector<int32>* ali, kaldi::CompactLattice* clat)
+{
+    std::string uttIDStr = msra::asr::toStr(uttID);
+
     // Reads alignment.
     if (!m_aliReader->HasKey(uttIDStr))
     {
         RuntimeError("Alignment not found for utterance %s\n",
                      uttIDStr.c_str());
     }
-    const std::vector<int32> ali = m_aliReader->Value(uttIDStr);
-    if (ali.size() != logLikelihood.GetNumCols())
+    *ali = m_aliReader->Value(uttIDStr);
+    if (ali->size() != numFrames)
     {
         RuntimeError("Number of frames in logLikelihood does not match that"
                      " in the alignment for utterance %S: %d v.s. %d\n",
-                     uttID.c_str(), (int) logLikelihood.GetNumCols(), (int) ali.size());
+                     uttID.c_str(), (int) numFrames, (int) ali->size());
     }
 
     // Reads denominator lattice.
@@ -83,7 +155,19 @@ bool KaldiSequenceTrainingDerivative<ElemType>::ComputeDerivative(
         RuntimeError("Denominator lattice not found for utterance %S\n",
                      uttID.c_str());
     }
-    kaldi::CompactLattice clat = m_denlatReader->Value(uttIDStr);
+    *clat = m_denlatReader->Value(uttIDStr);
+}
+
+template <class ElemType>
+void KaldiSequenceTrainingDerivative<ElemType>::ComputeDerivativeFromResources(
+    const wstring& uttID,
+    const Matrix<ElemType>& logLikelihood,
+    const std::vector<int32>& ali,
+    const kaldi::CompactLattice& clatIn,
+    Matrix<ElemType>* derivative,
+    ElemType* objective) const
+{
+    kaldi::CompactLattice clat = clatIn;
     fst::CreateSuperFinal(&clat); /* One final state with weight One() */
     kaldi::Lattice lat;
     fst::ConvertLattice(clat, &lat);
@@ -137,14 +221,12 @@ bool KaldiSequenceTrainingDerivative<ElemType>::ComputeDerivative(
 
     // Uses "expected error rate" instead of "expected accuracy".
     *objective = logLikelihood.GetNumCols() - *objective;
-
-    return true;
 }
 
 template <class ElemType>
 void KaldiSequenceTrainingDerivative<ElemType>::ConvertPosteriorToDerivative(
     const kaldi::Posterior& post,
-    Matrix<ElemType>* derivative)
+    Matrix<ElemType>* derivative) const
 {
     kaldi::Posterior pdfPost;
     kaldi::ConvertPosteriorToPdfs(m_transModel, post, &pdfPost);
@@ -14,6 +14,7 @@ class KaldiSequenceTrainingDerivative : public UtteranceDerivativeComputationInt
 {
 private:
     bool m_oneSilenceClass;
+    int m_numThreads;
     wstring m_trainCriterion;
     ElemType m_oldAcousticScale;
     ElemType m_acousticScale;
@@ -29,7 +30,22 @@ private:
                                 kaldi::Lattice* lat) const;
 
     void ConvertPosteriorToDerivative(const kaldi::Posterior& post,
-                                      Matrix<ElemType>* derivative);
+                                      Matrix<ElemType>* derivative) const;
+
+    // Reads the alignment and the denominator lattice of the utterance. The
+    // Kaldi table readers are not thread-safe, so this is done serially.
+    void ReadResources(const wstring& uttID, size_t numFrames,
+                       std::vector<kaldi::int32>* ali,
+                       kaldi::CompactLattice* clat);
+
+    // Computes the derivative and objective from the resources read by
+    // ReadResources(). This uses no reader, so it can run on several threads.
+    void ComputeDerivativeFromResources(const wstring& uttID,
+                                        const Matrix<ElemType>& logLikelihood,
+                                        const std::vector<kaldi::int32>& ali,
+                                        const kaldi::CompactLattice& clat,
+                                        Matrix<ElemType>* derivative,
+                                        ElemType* objective) const;
 
 public:
     // Constructor.
@@ -41,7 +57,8 @@ public:
                                     ElemType oldAcousticScale,
                                     ElemType acousticScale,
                                     ElemType lmScale,
-                                    bool oneSilenceClass);
+                                    bool oneSilenceClass,
+                                    int numThreads = 1);
 
     // Destructor.
     ~KaldiSequenceTrainingDerivative();
@@ -51,6 +68,13 @@ public:
                            Matrix<ElemType>* derivative,
                            ElemType* objective);
 
+    // Reads the resources of the utterances serially, then computes their
+    // derivatives on up to <m_numThreads> threads.
+    void ComputeDerivatives(const std::vector<wstring>& uttIDs,
+                            const std::vector<const Matrix<ElemType>*>& logLikelihoods,
+                            const std::vector<Matrix<ElemType>*>& derivatives,
+                            const std::vector<ElemType*>& objectives) override;
+
     bool HasResourceForDerivative(const wstring& uttID) const;
 };
 } } }
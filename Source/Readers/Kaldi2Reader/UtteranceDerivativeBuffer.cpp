@@ -98,6 +98,13 @@ bool UtteranceDerivativeBuffer<ElemType>::SetLikelihood(
             logLikelihood.GetDeviceId(), CPUDEVICE, true, false, false);
     }
 
+    // Utterances that are complete with this minibatch; their derivatives are
+    // computed together below.
+    std::vector<wstring> completeUttIDs;
+    std::vector<const Matrix<ElemType>*> completeLogLikelihoods;
+    std::vector<Matrix<ElemType>*> completeDerivatives;
+    std::vector<ElemType*> completeObjectives;
+
     size_t currentMBSize = pMBLayout->GetNumTimeSteps();
     for (size_t i = 0; i < uttInfo.size(); ++i)
     {
@@ -126,31 +133,42 @@ bool UtteranceDerivativeBuffer<ElemType>::SetLikelihood(
                 size_t numFrames = uttInfoInMinibatch[i][j].second.second;
                 assert(m_uttPool[uttID].progress + numFrames <= m_uttPool[uttID].uttLength);
 
-                // Sets the likelihood.
+                // Sets the likelihood, column by column of the CPU matrices.
+                UtteranceDerivativeUnit& unit = m_uttPool[uttID];
+                const ElemType* src = logLikelihood.BufferPointer();
+                ElemType* dst = unit.logLikelihood.BufferPointer();
                 for (size_t k = 0; k < numFrames; ++k)
                 {
-                    m_uttPool[uttID].logLikelihood.SetColumn(
-                        logLikelihood.ColumnSlice(
-                            (startFrame + k) * m_numUttsPerMinibatch + i, 1),
-                        m_uttPool[uttID].progress + k);
+                    memcpy(dst + (unit.progress + k) * m_dimension,
+                           src + ((startFrame + k) * m_numUttsPerMinibatch + i) * m_dimension,
+                           sizeof(ElemType) * m_dimension);
                 }
 
-                m_uttPool[uttID].progress += numFrames;
-                if (m_uttPool[uttID].progress == m_uttPool[uttID].uttLength)
+                unit.progress += numFrames;
+                if (unit.progress == unit.uttLength)
                 {
-                    m_derivativeInterface->ComputeDerivative(
-                        uttID,
-                        m_uttPool[uttID].logLikelihood,
-                        &m_uttPool[uttID].derivative,
-                        &m_uttPool[uttID].objective);
-                    m_uttPool[uttID].hasDerivative = true;
-                    m_uttPool[uttID].progress = 0;
-                    m_uttReady[m_uttPool[uttID].streamID] = true;
+                    completeUttIDs.push_back(uttID);
+                    completeLogLikelihoods.push_back(&unit.logLikelihood);
+                    completeDerivatives.push_back(&unit.derivative);
+                    completeObjectives.push_back(&unit.objective);
                 }
             }
         }
     }
 
+    // Computes the derivatives; the computation may run in parallel (see
+    // KaldiSequenceTrainingDerivative::ComputeDerivatives()).
+    m_derivativeInterface->ComputeDerivatives(
+        completeUttIDs, completeLogLikelihoods,
+        completeDerivatives, completeObjectives);
+    for (size_t k = 0; k < completeUttIDs.size(); ++k)
+    {
+        UtteranceDerivativeUnit& unit = m_uttPool[completeUttIDs[k]];
+        unit.hasDerivative = true;
+        unit.progress = 0;
+        m_uttReady[unit.streamID] = true;
+    }
+
     // Checks if we are ready to provide derivatives.
     m_needLikelihood = false;
     for (size_t i = 0; i < m_uttReady.size(); ++i)
@@ -161,6 +179,7 @@ bool UtteranceDerivativeBuffer<ElemType>::SetLikelihood(
             break;
         }
     }
+    return true;
 }
 
 // Suppose we have a, b, c 3 streams, the <derivativesOut> should be in the
@@ -203,12 +222,13 @@ bool UtteranceDerivativeBuffer<ElemType>::GetDerivative(
             size_t startFrame = uttInfoInMinibatch[i][j].second.first;
             size_t startFrameInUtt = m_uttPool[uttID].progress;
             size_t numFrames = uttInfoInMinibatch[i][j].second.second;
+            const ElemType* src = m_uttPool[uttID].derivative.BufferPointer();
+            ElemType* dst = derivatives.BufferPointer();
             for (size_t k = 0; k < numFrames; ++k)
             {
-                derivatives.SetColumn(
-                    m_uttPool[uttID].derivative.ColumnSlice(
-                        startFrameInUtt + k, 1),
-                    (startFrame + k) * m_numUttsPerMinibatch + i);
+                memcpy(dst + ((startFrame + k) * m_numUttsPerMinibatch + i) * m_dimension,
+                       src + (startFrameInUtt + k) * m_dimension,
+                       sizeof(ElemType) * m_dimension);
             }
             m_currentObj += m_uttPool[uttID].objective * numFrames / m_uttPool[uttID].uttLength;
             m_uttPool[uttID].progress += numFrames;
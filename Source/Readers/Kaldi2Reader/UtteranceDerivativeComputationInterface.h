@@ -17,6 +17,19 @@ public:
                                    Matrix<ElemType>* /*derivative*/,
                                    ElemType* /*objective*/) = 0;
 
+    // Computes derivatives and objectives of several utterances. This computes
+    // them one after the other; implementations may compute them in parallel.
+    virtual void ComputeDerivatives(const std::vector<wstring>& uttIDs,
+                                    const std::vector<const Matrix<ElemType>*>& logLikelihoods,
+                                    const std::vector<Matrix<ElemType>*>& derivatives,
+                                    const std::vector<ElemType*>& objectives)
+    {
+        for (size_t i = 0; i < uttIDs.size(); ++i)
+        {
+            ComputeDerivative(uttIDs[i], *logLikelihoods[i], derivatives[i], objectives[i]);
+        }
+    }
+
     // Returns true if we have resources to comptue the derivative, otherwise
     // returns false.
     virtual bool HasResourceForDerivative(const wstring& /*uttID*/) const = 0;
@@ -22,6 +22,7 @@
 //#include <iostream>
 
 #include "htkfeatio_utils.h"
+#include "kaldinativeio.h"
 #include "kaldi.h"
 
 namespace msra { namespace asr {
@@ -32,24 +33,39 @@ public:
     wstring scpFile;
     string rx;
     string feature_transform;
+    int load_threads; // number of threads that read the utterances of a chunk, if they can be read in parallel
 
 private:
     kaldi::RandomAccessBaseFloatMatrixReader *feature_reader;
+    std::unique_ptr<kaldinativetable> native_reader; // set instead of feature_reader if 'rx' is a plain scp: or ark: table
+    std::unique_ptr<kaldicmvn> cmvn;                 // CMVN applied to the features as read, before the feature transform
     kaldi::nnet1::Nnet nnet_transf;
     kaldi::CuMatrix<kaldi::BaseFloat> feats_transf;
     kaldi::Matrix<kaldi::BaseFloat> buf;
+    std::vector<float> native_buf;
 
 public:
-    FeatureSection(wstring scpFile, wstring rx_file, wstring feature_transform)
+    // cmvn_rx_file is a text file with the rspecifier of the CMVN statistics, as rx_file is for the features;
+    // the statistics are per speaker if an utt2spk file is given, else per utterance.
+    // With native_io, plain 'scp:' and 'ark:' tables are read in-process instead of by Kaldi's table readers.
+    FeatureSection(wstring scpFile, wstring rx_file, wstring feature_transform,
+                   wstring cmvn_rx_file = L"", wstring utt2spk_file = L"", bool norm_vars = false, bool native_io = true, int load_threads = 1)
+        : load_threads(load_threads), feature_reader(nullptr)
     {
         this->scpFile = scpFile;
         this->rx = trimmed(fileToStr(toStr(rx_file)));
         this->feature_transform = toStr(feature_transform);
 
-        feature_reader = new kaldi::RandomAccessBaseFloatMatrixReader(rx);
+        if (native_io)
+            native_reader = kaldinativetable::open(rx);
+        if (!native_reader)
+            feature_reader = new kaldi::RandomAccessBaseFloatMatrixReader(rx);
 
         // std::wcout << "Kaldi2Reader: created feature reader " << feature_reader << " [" << rx.c_str() << "]" << std::endl;
 
+        if (!cmvn_rx_file.empty())
+            cmvn.reset(new kaldicmvn(trimmed(fileToStr(toStr(cmvn_rx_file))), utt2spk_file, norm_vars));
+
         if (this->feature_transform == "NO_FEATURE_TRANSFORM")
         {
             this->feature_transform = "";
@@ -65,22 +81,38 @@ public:
     {
         string key = toStr(wkey);
 
-        if (!feature_reader->HasKey(key))
+        if (native_reader)
         {
-            fprintf(stderr, "Missing features for: %s", key.c_str());
-            throw std::runtime_error(msra::strfun::strprintf("Missing features for: %s", key.c_str()));
+            size_t rows, cols;
+            native_reader->read(key, native_buf, rows, cols);
+            buf.Resize(rows, cols);
+            for (size_t r = 0; r < rows; r++)
+                std::copy(&native_buf[r * cols], &native_buf[r * cols] + cols, buf.RowData(r));
         }
-
-        const kaldi::Matrix<kaldi::BaseFloat> &value = feature_reader->Value(key);
-
-        if (this->feature_transform.empty())
+        else
         {
+            if (!feature_reader->HasKey(key))
+            {
+                fprintf(stderr, "Missing features for: %s", key.c_str());
+                throw std::runtime_error(msra::strfun::strprintf("Missing features for: %s", key.c_str()));
+            }
+
+            const kaldi::Matrix<kaldi::BaseFloat> &value = feature_reader->Value(key);
             buf.Resize(value.NumRows(), value.NumCols());
             buf.CopyFromMat(value);
         }
-        else
+
+        if (cmvn)
         {
-            nnet_transf.Feedforward(kaldi::CuMatrix<kaldi::BaseFloat>(value), &feats_transf);
+            std::vector<float> offset, scale;
+            cmvn->getnormalization(key, buf.NumCols(), offset, scale);
+            for (size_t r = 0; r < buf.NumRows(); r++)
+                kaldicmvn::apply(buf.RowData(r), buf.RowData(r), buf.NumCols(), &offset[0], &scale[0]);
+        }
+
+        if (!this->feature_transform.empty())
+        {
+            nnet_transf.Feedforward(kaldi::CuMatrix<kaldi::BaseFloat>(buf), &feats_transf);
             buf.Resize(feats_transf.NumRows(), feats_transf.NumCols());
             feats_transf.CopyToMat(&buf);
         }
@@ -88,6 +120,37 @@ public:
         return buf;
     }
 
+    // true if readinto() can be used: the features are read in-process and need no feature transform
+    bool canreadinto() const
+    {
+        return native_reader && this->feature_transform.empty();
+    }
+
+    // reads an utterance straight into the columns of 'feat' (one per frame), with CMVN applied on the way
+    // Unlike read(), this uses no state of this object, so several threads can read at once, each with its own 'tmp'.
+    template <class MATRIX>
+    void readinto(const wstring &wkey, MATRIX &feat, std::vector<float> &tmp) const
+    {
+        string key = toStr(wkey);
+        size_t rows, cols;
+        native_reader->read(key, tmp, rows, cols);
+        if (rows != feat.cols() || cols != feat.rows())
+            throw std::logic_error(msra::strfun::strprintf("readinto: features of %s are %d x %d, expected %d x %d",
+                                                           key.c_str(), (int) rows, (int) cols, (int) feat.cols(), (int) feat.rows()));
+        if (cmvn)
+        {
+            std::vector<float> offset, scale;
+            cmvn->getnormalization(key, cols, offset, scale);
+            for (size_t r = 0; r < rows; r++)
+                kaldicmvn::apply(&tmp[r * cols], &feat(0, r), cols, &offset[0], &scale[0]);
+        }
+        else
+        {
+            for (size_t r = 0; r < rows; r++)
+                std::copy(&tmp[r * cols], &tmp[r * cols] + cols, &feat(0, r));
+        }
+    }
+
     ~FeatureSection()
     {
         // std::wcout << "Kaldi2Reader: deleted feature reader " << feature_reader << std::endl;
@@ -263,6 +326,8 @@ class htkfeatreader : protected htkfeatio
     // File handle and feature type information is stored in the underlying htkfeatio object.
     // TODO make this nicer
 
+    std::vector<float> nativebuf; // features as read by FeatureSection::readinto(), before they are copied into the matrix
+
 public:
     // parser for complex a=b[s,e] syntax
     struct parsedpath
@@ -346,6 +411,14 @@ public:
         // read vectors from file and push to our target structure
         try
         {
+            if (ppath.featuresection->canreadinto())
+            {
+                if (feat.cols() != numframes)
+                    throw std::logic_error("read: stripe read called with wrong dimensions");
+                ppath.featuresection->readinto(ppath, feat, nativebuf);
+                return;
+            }
+
             kaldi::Matrix<kaldi::BaseFloat> &kaldifeat = ppath.featuresection->read(ppath);
             size_t featdim = kaldifeat.NumCols();
 
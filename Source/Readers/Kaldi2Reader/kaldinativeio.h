@@ -0,0 +1,407 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// kaldinativeio.h -- reading Kaldi feature tables and applying CMVN in-process, without Kaldi's table readers
+//
+
+#pragma once
+
+#include "Basics.h"
+#include "basetypes.h"
+#include "fileutil.h"
+#include "htkfeatio_utils.h"
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <fstream>
+#include <unordered_map>
+#include <stdint.h>
+#include <math.h>
+
+namespace msra { namespace asr {
+
+// ===========================================================================
+// kaldinativetable -- random access to the matrices of a Kaldi table given by a plain 'scp:' or 'ark:' rspecifier
+//
+// Kaldi's table readers run piped rspecifiers ('ark:copy-feats ... |') as shell pipelines and read them through a pipe.
+// This reads the binary matrix objects from the archives directly: an 'scp:' table gives the archive offset of each
+// matrix, an 'ark:' table is indexed by scanning it once. Matrices may be float, double or compressed (tokens FM, DM,
+// CM, CM2, CM3). After construction, nothing is changed by reading, so several threads can read at once.
+// ===========================================================================
+
+class kaldinativetable
+{
+    struct location
+    {
+        string path;
+        uint64_t offset; // of the object, i.e. of its binary marker "\0B"
+    };
+    unordered_map<string, location> index;
+
+    // the header of a matrix object; the data follows it
+    struct matrixheader
+    {
+        string token;
+        size_t rows;
+        size_t cols;
+        float minvalue; // compressed matrices: range of the values
+        float range;
+    };
+
+    static void malformed(const string &path, const char *what)
+    {
+        throw std::runtime_error(msra::strfun::strprintf("kaldinativetable: %s in %s", what, path.c_str()));
+    }
+
+    static string readtoken(FILE *f, const string &path)
+    {
+        string token;
+        for (int c = fgetc(f); c != ' '; c = fgetc(f))
+        {
+            if (c == EOF || c == '\n' || token.size() > 16)
+                malformed(path, "malformed object token");
+            token.push_back((char) c);
+        }
+        return token;
+    }
+
+    // Kaldi's binary int32: its size as a byte, then its value
+    static size_t readint32(FILE *f, const string &path)
+    {
+        char size = (char) fgetc(f);
+        int32_t value;
+        if (size != sizeof(value))
+            malformed(path, "unexpected integer size");
+        freadOrDie(&value, sizeof(value), 1, f);
+        if (value < 0)
+            malformed(path, "negative matrix dimension");
+        return (size_t) value;
+    }
+
+    static matrixheader readheader(FILE *f, const string &path)
+    {
+        if (fgetc(f) != '\0' || fgetc(f) != 'B')
+            malformed(path, "not a binary object (text archives are not supported)");
+        matrixheader header;
+        header.token = readtoken(f, path);
+        header.minvalue = header.range = 0;
+        if (header.token == "FM" || header.token == "DM")
+        {
+            header.rows = readint32(f, path);
+            header.cols = readint32(f, path);
+        }
+        else if (header.token == "CM" || header.token == "CM2" || header.token == "CM3")
+        {
+            struct
+            {
+                float minvalue;
+                float range;
+                int32_t rows;
+                int32_t cols;
+            } global;
+            freadOrDie(&global, sizeof(global), 1, f);
+            if (global.rows < 0 || global.cols < 0)
+                malformed(path, "negative matrix dimension");
+            header.minvalue = global.minvalue;
+            header.range = global.range;
+            header.rows = global.rows;
+            header.cols = global.cols;
+        }
+        else
+            malformed(path, ("unsupported object type " + header.token).c_str());
+        return header;
+    }
+
+    static uint64_t datasize(const matrixheader &header)
+    {
+        const uint64_t n = (uint64_t) header.rows * header.cols;
+        if (header.token == "FM")
+            return n * sizeof(float);
+        else if (header.token == "DM")
+            return n * sizeof(double);
+        else if (header.token == "CM") // per column: 4 uint16 percentiles, then one byte per value
+            return header.cols * 4 * sizeof(uint16_t) + n;
+        else if (header.token == "CM2")
+            return n * sizeof(uint16_t);
+        else // CM3
+            return n;
+    }
+
+    // the value of a byte of a 'CM' column, from the column's percentiles 0, 25, 75, 100 (as in Kaldi's CompressedMatrix)
+    static float chartofloat(float p0, float p25, float p75, float p100, unsigned char value)
+    {
+        if (value <= 64)
+            return p0 + (p25 - p0) * value * (1 / 64.0f);
+        else if (value <= 192)
+            return p25 + (p75 - p25) * (value - 64) * (1 / 128.0f);
+        else
+            return p75 + (p100 - p75) * (value - 192) * (1 / 63.0f);
+    }
+
+    // decodes the data following 'header' into 'rowmajor' (rows x cols, Kaldi's layout)
+    template <class ELEM>
+    static void readdata(FILE *f, const string &path, const matrixheader &header, std::vector<ELEM> &rowmajor)
+    {
+        const size_t rows = header.rows, cols = header.cols;
+        rowmajor.resize(rows * cols);
+        if (rows * cols == 0)
+            return;
+        if (header.token == "FM" || header.token == "DM")
+        {
+            if ((header.token == "FM") == (sizeof(ELEM) == sizeof(float)))
+                freadOrDie(&rowmajor[0], sizeof(ELEM), rows * cols, f);
+            else if (header.token == "FM")
+            {
+                std::vector<float> data(rows * cols);
+                freadOrDie(&data[0], sizeof(float), data.size(), f);
+                std::copy(data.begin(), data.end(), rowmajor.begin());
+            }
+            else
+            {
+                std::vector<double> data(rows * cols);
+                freadOrDie(&data[0], sizeof(double), data.size(), f);
+                std::copy(data.begin(), data.end(), rowmajor.begin());
+            }
+            return;
+        }
+
+        std::vector<unsigned char> data((size_t) datasize(header));
+        freadOrDie(&data[0], 1, data.size(), f);
+        const float minvalue = header.minvalue, range = header.range;
+        if (header.token == "CM") // column headers, then the bytes column by column
+        {
+            const uint16_t *percentiles = (const uint16_t *) &data[0];
+            const unsigned char *bytes = &data[cols * 4 * sizeof(uint16_t)];
+            for (size_t j = 0; j < cols; j++, percentiles += 4, bytes += rows)
+            {
+                float p[4];
+                for (size_t k = 0; k < 4; k++)
+                    p[k] = minvalue + range * (1 / 65535.0f) * percentiles[k];
+                for (size_t i = 0; i < rows; i++)
+                    rowmajor[i * cols + j] = (ELEM) chartofloat(p[0], p[1], p[2], p[3], bytes[i]);
+            }
+        }
+        else if (header.token == "CM2") // uint16 over [minvalue, minvalue + range], row by row
+        {
+            const uint16_t *values = (const uint16_t *) &data[0];
+            const float step = range * (1 / 65535.0f);
+            for (size_t k = 0; k < rows * cols; k++)
+                rowmajor[k] = (ELEM) (minvalue + step * values[k]);
+        }
+        else // CM3: bytes over [minvalue, minvalue + range], row by row
+        {
+            const float step = range * (1 / 255.0f);
+            for (size_t k = 0; k < rows * cols; k++)
+                rowmajor[k] = (ELEM) (minvalue + step * data[k]);
+        }
+    }
+
+    // splits a Kaldi extended filename 'path:offset'; returns false for anything but a plain file, e.g. a command or a range
+    static bool parsescpentry(const string &rxfilename, location &loc)
+    {
+        if (rxfilename.empty() || rxfilename == "-" || rxfilename.back() == '|' || rxfilename.back() == ']')
+            return false;
+        loc.path = rxfilename;
+        loc.offset = 0;
+        size_t colon = rxfilename.rfind(':');
+        if (colon != string::npos && colon + 1 < rxfilename.size() && rxfilename.find_first_not_of("0123456789", colon + 1) == string::npos)
+        {
+            loc.path = rxfilename.substr(0, colon);
+            loc.offset = strtoull(rxfilename.c_str() + colon + 1, nullptr, 10);
+        }
+        return true;
+    }
+
+    void indexscp(const string &scppath)
+    {
+        std::ifstream scp(scppath.c_str());
+        if (!scp)
+            throw std::runtime_error(msra::strfun::strprintf("kaldinativetable: cannot open %s", scppath.c_str()));
+        string line;
+        while (std::getline(scp, line))
+        {
+            line = trimmed(line);
+            if (line.empty())
+                continue;
+            size_t space = line.find_first_of(" \t");
+            if (space == string::npos)
+                malformed(scppath, "line without an rxfilename");
+            location loc;
+            if (!parsescpentry(trimmed(line.substr(space + 1)), loc))
+                throw std::invalid_argument("kaldinativetable: entries of the scp file are not plain archive offsets");
+            index[line.substr(0, space)] = loc;
+        }
+    }
+
+    void indexark(const string &arkpath)
+    {
+        FILE *f = fopenOrDie(arkpath, "rb");
+        try
+        {
+            for (int c = fgetc(f); c != EOF; c = fgetc(f))
+            {
+                ungetc(c, f);
+                string key = readtoken(f, arkpath);
+                location loc = {arkpath, fgetpos(f)};
+                matrixheader header = readheader(f, arkpath);
+                fsetpos(f, fgetpos(f) + datasize(header)); // skip the data
+                index[key] = loc;
+            }
+        }
+        catch (...)
+        {
+            fclose(f);
+            throw;
+        }
+        fclose(f);
+    }
+
+    kaldinativetable()
+    {
+    }
+
+public:
+    // returns null if 'rspecifier' is not a plain 'scp:' or 'ark:' table (e.g. a pipe), which only Kaldi's readers can read
+    static std::unique_ptr<kaldinativetable> open(const string &rspecifier)
+    {
+        const string spec = trimmed(rspecifier);
+        size_t colon = spec.find(':');
+        if (colon == string::npos)
+            return nullptr;
+        vector<string> options = msra::strfun::split(spec.substr(0, colon), ",");
+        const string path = trimmed(spec.substr(colon + 1));
+        if (options.empty() || path.empty() || path == "-" || path.back() == '|')
+            return nullptr;
+        for (size_t k = 1; k < options.size(); k++) // options such as 's' and 'cs' only matter for sequential reading
+        {
+            if (options[k] == "t")
+                return nullptr;
+        }
+
+        std::unique_ptr<kaldinativetable> table(new kaldinativetable());
+        if (options[0] == "scp")
+        {
+            try
+            {
+                table->indexscp(path);
+            }
+            catch (const std::invalid_argument &)
+            {
+                return nullptr;
+            }
+        }
+        else if (options[0] == "ark")
+            table->indexark(path);
+        else
+            return nullptr;
+        return table;
+    }
+
+    bool haskey(const string &key) const
+    {
+        return index.find(key) != index.end();
+    }
+
+    // reads the matrix 'key' into 'rowmajor', in Kaldi's layout (one row per frame)
+    template <class ELEM>
+    void read(const string &key, std::vector<ELEM> &rowmajor, size_t &rows, size_t &cols) const
+    {
+        auto entry = index.find(key);
+        if (entry == index.end())
+            throw std::runtime_error(msra::strfun::strprintf("Missing features for: %s", key.c_str()));
+        const location &loc = entry->second;
+        FILE *f = fopenOrDie(loc.path, "rb");
+        try
+        {
+            fsetpos(f, loc.offset);
+            matrixheader header = readheader(f, loc.path);
+            readdata(f, loc.path, header, rowmajor);
+            rows = header.rows;
+            cols = header.cols;
+        }
+        catch (...)
+        {
+            fclose(f);
+            throw;
+        }
+        fclose(f);
+    }
+};
+
+// ===========================================================================
+// kaldicmvn -- cepstral mean and variance normalization as done by Kaldi's apply-cmvn
+//
+// The statistics of each speaker (or, without an utt2spk map, of each utterance) are a 2 x (dim + 1) matrix:
+// the sums of the values and the count in the first row, the sums of their squares in the second.
+// ===========================================================================
+
+class kaldicmvn
+{
+    std::unique_ptr<kaldinativetable> stats;
+    unordered_map<string, string> utt2spk;
+    bool normvars;
+
+public:
+    kaldicmvn(const string &statsrspecifier, const wstring &utt2spkfile, bool normvars)
+        : normvars(normvars)
+    {
+        stats = kaldinativetable::open(statsrspecifier);
+        if (!stats)
+            throw std::runtime_error(msra::strfun::strprintf("kaldicmvn: the CMVN statistics must be a plain 'scp:' or 'ark:' table, not '%s'", statsrspecifier.c_str()));
+        if (!utt2spkfile.empty())
+        {
+            std::ifstream in(msra::strfun::utf8(utt2spkfile).c_str());
+            if (!in)
+                throw std::runtime_error(msra::strfun::strprintf("kaldicmvn: cannot open %ls", utt2spkfile.c_str()));
+            string utt, spk;
+            while (in >> utt >> spk)
+                utt2spk[utt] = spk;
+        }
+    }
+
+    // the normalization of an utterance of 'dim' dimensions: each value x becomes x * scale[d] + offset[d]
+    void getnormalization(const string &uttkey, size_t dim, std::vector<float> &offset, std::vector<float> &scale) const
+    {
+        string statskey = uttkey;
+        if (!utt2spk.empty())
+        {
+            auto spk = utt2spk.find(uttkey);
+            if (spk == utt2spk.end())
+                throw std::runtime_error(msra::strfun::strprintf("kaldicmvn: no speaker for utterance %s in utt2spk", uttkey.c_str()));
+            statskey = spk->second;
+        }
+        std::vector<double> s;
+        size_t rows, cols;
+        stats->read(statskey, s, rows, cols);
+        if (rows != 2 || cols != dim + 1)
+            throw std::runtime_error(msra::strfun::strprintf("kaldicmvn: statistics of %s are %d x %d, expected 2 x %d", statskey.c_str(), (int) rows, (int) cols, (int) dim + 1));
+        const double count = s[dim];
+        if (count < 1.0)
+            throw std::runtime_error(msra::strfun::strprintf("kaldicmvn: insufficient statistics for %s (count %f)", statskey.c_str(), count));
+
+        offset.resize(dim);
+        scale.resize(dim);
+        for (size_t d = 0; d < dim; d++)
+        {
+            double mean = s[d] / count;
+            double sc = 1.0;
+            if (normvars)
+            {
+                double var = s[cols + d] / count - mean * mean;
+                sc = 1.0 / sqrt(var < 1.0e-20 ? 1.0e-20 : var);
+            }
+            scale[d] = (float) sc;
+            offset[d] = (float) (-mean * sc);
+        }
+    }
+
+    // normalizes one frame; a plain loop over contiguous arrays, which the compiler vectorizes
+    static void apply(const float *in, float *out, size_t dim, const float *offset, const float *scale)
+    {
+        for (size_t d = 0; d < dim; d++)
+            out[d] = in[d] * scale[d] + offset[d];
+    }
+};
+} }
@@ -150,15 +150,51 @@ class minibatchutterancesourcemulti : public minibatchsource
                 frames.resize(featdim, totalframes);
                 if (!latticesource.empty())
                     lattices.resize(utteranceset.size());
-                foreach_index (i, utteranceset)
+                // Features read in-process (see FeatureSection::readinto()) are read by several threads, each into its utterance's
+                // columns; the lattices are read afterwards.
+                const msra::asr::FeatureSection *featuresection = utteranceset[0].parsedpath.featuresection;
+                if (featuresection->canreadinto() && featuresection->load_threads > 1 && utteranceset.size() > 1)
                 {
-                    // fprintf (stderr, ".");
-                    // read features for this file
-                    auto uttframes = getutteranceframes(i);                                                           // matrix stripe for this utterance (currently unfilled)
-                    reader.readNoAlloc(utteranceset[i].parsedpath, (const string &) featkind, sampperiod, uttframes); // note: file info here used for checkuing only
-                    // page in lattice data
+                    std::exception_ptr error;
+#pragma omp parallel num_threads(featuresection->load_threads)
+                    {
+                        msra::asr::htkfeatreader threadreader;
+#pragma omp for schedule(dynamic)
+                        for (int i = 0; i < (int) utteranceset.size(); i++)
+                        {
+                            try
+                            {
+                                auto uttframes = getutteranceframes(i);
+                                threadreader.readNoAlloc(utteranceset[i].parsedpath, (const string &) featkind, sampperiod, uttframes);
+                            }
+                            catch (...)
+                            {
+#pragma omp critical
+                                if (!error)
+                                    error = std::current_exception();
+                            }
+                        }
+                    }
+                    if (error)
+                        std::rethrow_exception(error);
                     if (!latticesource.empty())
-                        latticesource.getlattices(utteranceset[i].key(), lattices[i], uttframes.cols());
+                    {
+                        foreach_index (i, utteranceset)
+                            latticesource.getlattices(utteranceset[i].key(), lattices[i], numframes(i));
+                    }
+                }
+                else
+                {
+                    foreach_index (i, utteranceset)
+                    {
+                        // fprintf (stderr, ".");
+                        // read features for this file
+                        auto uttframes = getutteranceframes(i);                                                           // matrix stripe for this utterance (currently unfilled)
+                        reader.readNoAlloc(utteranceset[i].parsedpath, (const string &) featkind, sampperiod, uttframes); // note: file info here used for checkuing only
+                        // page in lattice data
+                        if (!latticesource.empty())
+                            latticesource.getlattices(utteranceset[i].key(), lattices[i], uttframes.cols());
+                    }
                 }
                 // fprintf (stderr, "\n");
                 if (verbosity)
@@ -0,0 +1,101 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// LMBinaryCorpus.h - a text corpus converted to word ids once, and memory-mapped by BatchSequenceReader
+//
+#pragma once
+
+#include "Basics.h"
+#include "fileutil.h"
+#include "MemoryMappedFile.h"
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// -----------------------------------------------------------------------
+// LMBinaryCorpus -- the sentences of a corpus as int32 word ids, with an index of where each sentence begins
+//
+// File layout:
+//     header:    "LMCORPUS", version (uint32), vocabulary size (uint32), #tokens (uint64), #sentences (uint64)
+//     sentences: uint64 [#sentences + 1], the first token of each sentence, and #tokens
+//     tokens:    int32 [#tokens], all sentences concatenated
+// The word ids are only valid for the vocabulary the corpus was written with, hence its size is stored to detect a
+// changed mapping.
+// -----------------------------------------------------------------------
+
+class LMBinaryCorpus
+{
+    struct Header
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t vocabularySize;
+        uint64_t numTokens;
+        uint64_t numSentences;
+    };
+    static const uint32_t s_version = 1;
+
+public:
+    // maps a corpus file; fails if it is not one
+    explicit LMBinaryCorpus(const std::wstring& path)
+        : m_file(std::make_shared<MemoryMappedFile>(path))
+    {
+        if (m_file->GetSize() < sizeof(Header))
+            RuntimeError("LMBinaryCorpus: '%ls' is too small for a binary corpus.", path.c_str());
+        const Header& header = *(const Header*) m_file->GetData();
+        if (memcmp(header.magic, "LMCORPUS", sizeof(header.magic)) != 0 || header.version != s_version)
+            RuntimeError("LMBinaryCorpus: '%ls' is not a binary corpus of version %d.", path.c_str(), (int) s_version);
+        m_vocabularySize = header.vocabularySize;
+        m_numSentences = (size_t) header.numSentences;
+        if (m_file->GetSize() != sizeof(Header) + sizeof(uint64_t) * (header.numSentences + 1) + sizeof(int32_t) * header.numTokens)
+            RuntimeError("LMBinaryCorpus: '%ls' is truncated.", path.c_str());
+        m_sentenceBegins = (const uint64_t*) (m_file->GetData() + sizeof(Header));
+        m_tokens = (const int32_t*) (m_sentenceBegins + header.numSentences + 1);
+    }
+
+    size_t GetVocabularySize() const { return m_vocabularySize; }
+    size_t GetNumSentences() const { return m_numSentences; }
+    size_t GetNumTokens() const { return (size_t) m_sentenceBegins[m_numSentences]; }
+
+    // the words of all sentences, concatenated; sentence s is [GetSentenceBegin(s), GetSentenceBegin(s + 1))
+    const int32_t* GetTokens() const { return m_tokens; }
+    size_t GetSentenceBegin(size_t s) const { return (size_t) m_sentenceBegins[s]; }
+
+    // writes a corpus; 'sentenceBegins' has #sentences + 1 entries, the last one being tokens.size()
+    // It is written under a temporary name first, so that an interrupted conversion does not leave a corpus behind.
+    static void Write(const std::wstring& path, size_t vocabularySize, const std::vector<int32_t>& tokens, const std::vector<uint64_t>& sentenceBegins)
+    {
+        if (sentenceBegins.empty() || sentenceBegins.back() != tokens.size())
+            LogicError("LMBinaryCorpus::Write: The sentence index does not end at the number of tokens.");
+
+        Header header;
+        memcpy(header.magic, "LMCORPUS", sizeof(header.magic));
+        header.version = s_version;
+        header.vocabularySize = (uint32_t) vocabularySize;
+        header.numTokens = tokens.size();
+        header.numSentences = sentenceBegins.size() - 1;
+
+        const std::wstring tempPath = path + L".tmp";
+        {
+            auto_file_ptr f(fopenOrDie(tempPath, L"wb"));
+            fwriteOrDie(&header, sizeof(header), 1, f);
+            fwriteOrDie(sentenceBegins.data(), sizeof(uint64_t), sentenceBegins.size(), f);
+            fwriteOrDie(tokens.data(), sizeof(int32_t), tokens.size(), f);
+            fflushOrDie(f);
+        }
+        renameOrDie(tempPath, path);
+    }
+
+private:
+    MemoryMappedFilePtr m_file;
+    size_t m_vocabularySize;
+    size_t m_numSentences;
+    const uint64_t* m_sentenceBegins; // [m_numSentences + 1]
+    const int32_t* m_tokens;
+};
+
+} } }
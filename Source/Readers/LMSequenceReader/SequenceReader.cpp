@@ -1569,10 +1569,131 @@ void BatchSequenceReader<ElemType>::InitFromConfig(const ConfigRecordType& reade
     const LabelInfo& labelOut = m_labelInfo[labelInfoOut];
     m_parser.ParseInit(pathName.c_str(), m_featureDim, labelIn.dim, labelOut.dim, labelIn.beginSequence, labelIn.endSequence, labelOut.beginSequence, labelOut.endSequence);
 
+    // binary corpus: converted from 'file' once, and rewritten whenever it is older than the text or the vocabulary used for it
+    std::wstring corpusPath = readerConfig(L"binaryCorpus", L"");
+    if (!corpusPath.empty())
+    {
+        std::vector<std::wstring> sourcePaths(1, pathName);
+        std::wstring wClassFile = readerConfig(L"wordclass", L"");
+        if (!wClassFile.empty())
+            sourcePaths.push_back(wClassFile);
+        if (!labelIn.mapName.empty() && labelIn.fileToWrite.empty()) // a mapping file that was read
+            sourcePaths.push_back(labelIn.mapName);
+        InitBinaryCorpus(corpusPath, sourcePaths);
+    }
+
     mRequestedNumParallelSequences = readerConfig(L"nbruttsineachrecurrentiter", (size_t) 1); // 0 indicates auto-fill mbSize
     // TODO: ^^ This should depend on the sequences themselves.
 }
 
+// map the binary corpus, converting the text file (sourcePaths[0]) first if needed
+// The conversion reads the text in cache blocks like GetMinibatchData() does, and maps each token as that does for the
+// input, except that a token that matches the end symbol is mapped to it regardless of case, as it is for the output.
+template <class ElemType>
+void BatchSequenceReader<ElemType>::InitBinaryCorpus(const std::wstring& corpusPath, const std::vector<std::wstring>& sourcePaths)
+{
+    LabelInfo& labelIn = m_labelInfo[labelInfoIn];
+    const LabelInfo& labelOut = m_labelInfo[labelInfoOut];
+    if (labelIn.type != labelCategory || (labelOut.type != labelNextWord && labelOut.type != labelNone))
+        InvalidArgument("BatchSequenceReader: A binaryCorpus requires input labels of type 'category' and output labels of type 'nextWord' or 'none'.");
+    if (labelIn.mapLabelToId.empty()) // the ids must be known before the corpus is read
+        InvalidArgument("BatchSequenceReader: A binaryCorpus requires a word class file or an existing labelMappingFile.");
+
+    bool upToDate = fexists(corpusPath);
+    for (const auto& sourcePath : sourcePaths)
+        upToDate = upToDate && msra::files::fuptodate(corpusPath, sourcePath);
+    if (upToDate)
+    {
+        m_corpus.reset(new LMBinaryCorpus(corpusPath));
+        if (m_corpus->GetVocabularySize() != labelIn.numIds)
+            upToDate = false;
+    }
+
+    if (!upToDate)
+    {
+        m_corpus.reset();
+        fprintf(stderr, "LMSequenceReader: Converting '%ls' to binary corpus '%ls'...", sourcePaths[0].c_str(), corpusPath.c_str()), fflush(stderr);
+
+        LMBatchSequenceParser<ElemType, LabelType> parser;
+        parser.ParseInit(sourcePaths[0].c_str(), m_featureDim, labelIn.dim, labelOut.dim, labelIn.beginSequence, labelIn.endSequence, labelOut.beginSequence, labelOut.endSequence);
+        std::vector<int32_t> tokens;
+        std::vector<uint64_t> sentenceBegins(1, 0);
+        std::vector<LabelType> labels;
+        std::vector<ElemType> numbers;
+        for (;;)
+        {
+            std::vector<SequencePosition> seqPos;
+            labels.clear();
+            parser.mSentenceIndex2SentenceInfo.clear();
+            if (parser.Parse(m_cacheBlockSize, &labels, &numbers, &seqPos) == 0)
+                break;
+            for (const auto& sentence : parser.mSentenceIndex2SentenceInfo)
+            {
+                for (size_t i = 0; i < sentence.sLen; i++)
+                {
+                    const auto& labelValue = labels[sentence.sBegin + i];
+                    tokens.push_back((int32_t) GetIdFromLabel(EqualCI(labelValue, labelIn.endSequence) ? labelIn.endSequence : labelValue, labelIn));
+                }
+                sentenceBegins.push_back(tokens.size());
+            }
+        }
+        LMBinaryCorpus::Write(corpusPath, labelIn.numIds, tokens, sentenceBegins);
+        m_corpus.reset(new LMBinaryCorpus(corpusPath));
+        fprintf(stderr, " done.\n");
+    }
+    fprintf(stderr, "LMSequenceReader: Binary corpus '%ls' with %d sentences, %d tokens.\n", corpusPath.c_str(), (int) m_corpus->GetNumSentences(), (int) m_corpus->GetNumTokens());
+}
+
+// append the next cache block of the binary corpus to mSentenceIndex2SentenceInfo[], in corpus order, instead of m_parser.Parse()
+// Like Parse(), this takes sentences until m_cacheBlockSize tokens are reached; sBegin is the position in the corpus.
+template <class ElemType>
+size_t BatchSequenceReader<ElemType>::ReadCorpusBlock()
+{
+    size_t numRead = 0;
+    size_t numTokens = 0;
+    for (; numTokens < m_cacheBlockSize && m_corpusNextSentence < m_corpus->GetNumSentences(); m_corpusNextSentence++, numRead++)
+    {
+        SentenceInfo sentence;
+        sentence.sBegin = m_corpus->GetSentenceBegin(m_corpusNextSentence);
+        sentence.sLen = m_corpus->GetSentenceBegin(m_corpusNextSentence + 1) - sentence.sBegin;
+        m_parser.mSentenceIndex2SentenceInfo.push_back(sentence);
+        numTokens += sentence.sLen;
+    }
+    return numRead;
+}
+
+// build the word-to-class table and the word range of each class, once (cf. GetClassInfo())
+// so that a label column is a lookup into flat arrays
+template <class ElemType>
+void BatchSequenceReader<ElemType>::InitClassLookup()
+{
+    if (!m_wordClass.empty())
+        return;
+
+    m_wordClass.resize(nwords);
+    m_classRange.assign(2 * m_classSize, 0);
+    int prvcls = -1;
+    for (size_t j = 0; j < nwords; j++)
+    {
+        int clsidx = idx4class[(int) j];
+        m_wordClass[j] = clsidx;
+        if (clsidx > prvcls)
+        {
+            if (prvcls >= 0)
+                m_classRange[2 * prvcls + 1] = (ElemType) j;
+            prvcls = clsidx;
+            m_classRange[2 * prvcls] = (ElemType) j;
+        }
+        else if (clsidx < prvcls)
+        {
+            // nwords is larger than the actual number of words
+            LogicError("LMSequenceReader::InitClassLookup probably the number of words specified is larger than the actual number of words. Check network builder and data reader. ");
+        }
+    }
+    if (prvcls >= 0)
+        m_classRange[2 * prvcls + 1] = (ElemType) nwords;
+}
+
 template <class ElemType>
 void BatchSequenceReader<ElemType>::Reset()
 {
@@ -1670,6 +1791,7 @@ void BatchSequenceReader<ElemType>::StartMinibatchLoop(size_t mbSize, size_t epo
     m_idx2clsRead = false;
 
     m_parser.ParseReset();
+    m_corpusNextSentence = 0;
 
     Reset();
 }
@@ -1782,7 +1904,7 @@ bool BatchSequenceReader<ElemType>::GetMinibatchData(size_t& /*out*/ firstPosInS
 
         std::vector<SequencePosition> seqPos;
         fprintf(stderr, "LMSequenceReader: Reading epoch data..."), fflush(stderr);
-        mNumRead = m_parser.Parse(m_cacheBlockSize, &m_labelTemp, &m_featureTemp, &seqPos);
+        mNumRead = m_corpus ? ReadCorpusBlock() : m_parser.Parse(m_cacheBlockSize, &m_labelTemp, &m_featureTemp, &seqPos);
         fprintf(stderr, " %d sequences read.\n", (int) mNumRead);
         firstPosInSentence = mLastPosInSentence;
         if (mNumRead == 0)
@@ -1827,6 +1949,18 @@ bool BatchSequenceReader<ElemType>::GetMinibatchData(size_t& /*out*/ firstPosInS
             size_t seq = mToProcess[k];
             size_t pos = m_parser.mSentenceIndex2SentenceInfo[seq].sBegin + i;
 
+            // from the binary corpus: the ids are there already, and the output is the next word
+            if (m_corpus)
+            {
+                const int32_t* tokens = m_corpus->GetTokens() + pos;
+                m_featureData.push_back((ElemType) tokens[0]);
+                if (labelOut.type != labelNone)
+                    m_labelIdData.push_back((LabelIdType) tokens[1]);
+                m_totalSamples++;
+                m_epochSamplesReturned++;
+                continue;
+            }
+
             // labelIn should be a category label
             const auto& labelValue = m_labelTemp[pos];
             pos++; // consume it
@@ -1948,7 +2082,16 @@ bool BatchSequenceReader<ElemType>::GetMinibatch(StreamMinibatchInputs& matrices
     // we always copy it to cpu first and then convert to gpu if gpu is desired.
     size_t featureDim = m_labelInfo[labelInfoIn].dim;
     auto iter = matrices.find(m_featuresName);
-    if (iter != matrices.end()) // (if not found then feature matrix is not requested this time)
+    if (iter != matrices.end() && matrices.GetInputMatrix<ElemType>(iter->first).GetMatrixType() == MatrixType::SPARSE)
+    {
+        // sparse: only the ids go to where the matrix is, which expands them to one-hot columns there
+        Matrix<ElemType>& features = matrices.GetInputMatrix<ElemType>(iter->first);
+        if (!m_featureIds || m_featureIds->GetDeviceId() != features.GetDeviceId())
+            m_featureIds.reset(new Matrix<ElemType>(features.GetDeviceId()));
+        m_featureIds->SetValue(1, actualmbsize, features.GetDeviceId(), m_featureData.data());
+        features.AssignOneHotColumnsOf(*m_featureIds, featureDim);
+    }
+    else if (iter != matrices.end()) // (if not found then feature matrix is not requested this time)
     {
         Matrix<ElemType>& features = matrices.GetInputMatrix<ElemType>(iter->first);
 
@@ -1983,7 +2126,7 @@ bool BatchSequenceReader<ElemType>::GetMinibatch(StreamMinibatchInputs& matrices
     if (readerMode == ReaderMode::Class)
     {
         GetInputToClass(matrices);
-        GetClassInfo();
+        InitClassLookup();
     }
 
     // get labels
@@ -2089,87 +2232,82 @@ void BatchSequenceReader<ElemType>::GetLabelOutput(StreamMinibatchInputs& matric
     if (!matrices.HasInput(m_labelsName[labelInfoOut]))
         return;
 
-    size_t j = 0;
     Matrix<ElemType>& labels = matrices.GetInputMatrix<ElemType>(m_labelsName[labelInfoOut]);
+    size_t numRows;
     if (readerMode == ReaderMode::NCE)
-        labels.Resize(2 * (m_noiseSampleSize + 1), actualmbsize);
+        numRows = 2 * (m_noiseSampleSize + 1);
     else if (readerMode == ReaderMode::Class)
-        labels.Resize(4, actualmbsize, false);
+        numRows = 4;
     else
-        labels.Resize(1, actualmbsize, false);
+        numRows = 1;
 
-    // move to CPU since element-wise operation is expensive on GPU
-    int curDevId = labels.GetDeviceId();
-    labels.TransferFromDeviceToDevice(curDevId, CPUDEVICE, true, false, false);
-    assert(labels.GetCurrentMatrixLocation() == CPU);
+    // the columns are filled on the host, then set at once (rows that a mode does not use are 0)
+    m_labelValues.assign(numRows * actualmbsize, 0);
 
     ElemType epsilon = (ElemType) 1e-6; // avoid all zero, although this is almost impossible.
 
+    size_t j = 0;
     for (size_t jSample = mbStartSample; j < actualmbsize; ++j, ++jSample)
     {
+        ElemType* column = &m_labelValues[j * numRows];
+
         // get the token
         LabelIdType wrd = m_labelIdData[jSample];
 
         // write sample value into output
         // This writes an index into a row vector. Which is wrong, we want a sparse one-hot vector.
-        labels.SetValue(0, j, (ElemType) wrd);
+        column[0] = (ElemType) wrd;
 
         if (readerMode == ReaderMode::NCE)
         {
-            labels.SetValue(1, j, (ElemType) m_noiseSampler.logprob(wrd));
+            column[1] = (ElemType) m_noiseSampler.logprob(wrd);
             for (size_t noiseid = 0; noiseid < m_noiseSampleSize; noiseid++)
             {
                 int wid = m_noiseSampler.sample();
-                labels.SetValue(2 * (noiseid + 1), j, (ElemType) wid);
-                labels.SetValue(2 * (noiseid + 1) + 1, j, -(ElemType) m_noiseSampler.logprob(wid));
+                column[2 * (noiseid + 1)] = (ElemType) wid;
+                column[2 * (noiseid + 1) + 1] = -(ElemType) m_noiseSampler.logprob(wid);
             }
         }
         else if (readerMode == ReaderMode::Class)
         {
-            int clsidx = idx4class[wrd];
             if (m_classSize > 0)
             {
-                labels.SetValue(1, j, (ElemType) clsidx);
+                if (wrd >= m_wordClass.size())
+                    LogicError("LMSequenceReader::GetLabelOutput word %d is outside the vocabulary of %d words.", (int) wrd, (int) m_wordClass.size());
+                int clsidx = m_wordClass[wrd];
+                column[1] = (ElemType) clsidx;
 
                 // save the [begining ending_indx) of the class
-                size_t lft = (size_t) (*m_classInfoLocal)(0, clsidx);
-                size_t rgt = (size_t) (*m_classInfoLocal)(1, clsidx);
+                size_t lft = (size_t) m_classRange[2 * clsidx];
+                size_t rgt = (size_t) m_classRange[2 * clsidx + 1];
                 if (wrd < lft || lft > rgt || wrd >= rgt)
                 {
                     LogicError("LMSequenceReader::GetLabelOutput word %d should be at least equal to or larger than its class's left index %d; right index %d of its class should be larger or equal to left index %d of its class; word index %d should be smaller than its class's right index %d.\n",
                                (int) wrd, (int) lft, (int) rgt, (int) lft, (int) wrd, (int) rgt);
                 }
-                labels.SetValue(2, j, (*m_classInfoLocal)(0, clsidx)); // begining index of the class
-                labels.SetValue(3, j, (*m_classInfoLocal)(1, clsidx)); // end index of the class
+                column[2] = m_classRange[2 * clsidx];     // begining index of the class
+                column[3] = m_classRange[2 * clsidx + 1]; // end index of the class
             }
         }
         else if (readerMode == ReaderMode::Softmax)
         {
             if (wrd == 0)
-                labels.SetValue(0, j, epsilon + (ElemType) wrd);
+                column[0] = epsilon + (ElemType) wrd;
         }
         else if (readerMode == ReaderMode::Unnormalize)
         {
-            labels.SetValue(0, j, -(ElemType) wrd);
+            column[0] = -(ElemType) wrd;
             if (wrd == 0)
-                labels.SetValue(0, j, -epsilon - (ElemType) wrd);
+                column[0] = -epsilon - (ElemType) wrd;
         }
-
-#if 0   // This is fragile--if a line does not end with </s>, we will never get out of here. Instead, this is now set in GetMinibatchData().
-        // keep track of sentence ends. mSentenceEnd is read only in DataEnd(), which will then reset mProcessed[].
-        if (j == actualmbsize - 1) // if last entry then set mSentenceEnd to whether the word is the sentence-end symbol
-        {
-            // find numeric index of sentence-end token
-            LabelInfo& labelIn = m_labelInfo[(m_labelInfo[labelInfoOut].type == labelNextWord) ? labelInfoIn : labelInfoOut]; // m_labelInfo[labelInfoIn]; <-- This is what it was before, which triggered a bug and I think is wrong wrd comes from m_labelIdData, which is the output.
-            LabelIdType endSequenceIndex = GetIdFromLabel(labelIn.endSequence, labelIn);
-
-            mSentenceEnd = (wrd == (int)endSequenceIndex);
-        }
-#endif
     }
-    // send it back to where it came from
+
+    // set it on the CPU and send it back to where it came from
     // Note: This may leave this object in BOTH locations, which is desirable for
     // class-based models which access the information on the CPU.
+    int curDevId = labels.GetDeviceId();
+    labels.TransferFromDeviceToDevice(curDevId, CPUDEVICE, true, true /*emptyTransfer: all values are set below*/, false);
+    labels.SetValue(numRows, actualmbsize, CPUDEVICE, m_labelValues.data());
     labels.TransferFromDeviceToDevice(CPUDEVICE, curDevId, false, false, false);
 }
 
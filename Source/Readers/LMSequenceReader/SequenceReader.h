@@ -11,7 +11,9 @@
 #include "DataWriter.h"
 #include "Config.h"
 #include "SequenceParser.h"
+#include "LMBinaryCorpus.h"
 #include "RandomOrdering.h"
+#include <memory>
 #include <string>
 #include <map>
 #include <vector>
@@ -374,6 +376,17 @@ private:
 
     MBLayoutPtr m_pMBLayout;
 
+    // with 'binaryCorpus', the word ids come from a memory-mapped corpus instead of the parser (see LMBinaryCorpus.h)
+    std::unique_ptr<LMBinaryCorpus> m_corpus;
+    size_t m_corpusNextSentence;                   // first sentence of the next cache block
+
+    // class lookup for the labels, built once from idx4class
+    std::vector<int> m_wordClass;                  // [word id] class
+    std::vector<ElemType> m_classRange;            // [2 * class + 0/1] [first word, end word) of the class
+
+    std::vector<ElemType> m_labelValues;           // the label matrix, filled on the host and set at once
+    std::unique_ptr<Matrix<ElemType>> m_featureIds; // [1 x #tokens] m_featureData where the features are, to expand a sparse one-hot matrix there
+
 public:
     LMBatchSequenceParser<ElemType, LabelType> m_parser;
     BatchSequenceReader()
@@ -384,6 +397,7 @@ public:
         mLastPosInSentence = 0;
         mNumRead = 0;
         mSentenceEnd = false;
+        m_corpusNextSentence = 0;
     }
 
     template <class ConfigRecordType>
@@ -398,6 +412,9 @@ public:
     }
 private:
     void Reset();
+    void InitBinaryCorpus(const std::wstring& corpusPath, const std::vector<std::wstring>& sourcePaths);
+    size_t ReadCorpusBlock();
+    void InitClassLookup();
     size_t DetermineSequencesToProcess();
     bool GetMinibatchData(size_t& firstPosInSentence);
     void GetLabelOutput(StreamMinibatchInputs& matrices, size_t m_mbStartSample, size_t actualmbsize);
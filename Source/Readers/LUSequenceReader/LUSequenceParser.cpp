@@ -44,8 +44,218 @@ template class LUSequenceParser<double, double>;
 template class LUSequenceParser<double, std::string>;
 template class LUSequenceParser<double, std::wstring>;
 
+// token-id cache file layout: header, then one record per line of the data file
+//  - int n: number of input tokens, or -1 for a blank line and -2 for a line with less than two tokens
+//  - int[n] input token ids, int output label id, int end-of-sequence flag (only if n >= 0)
+static const int tokenCacheMagic = 0x4354554c; // 'LUTC'
+static const int tokenCacheVersion = 1;
+static const long tokenCacheHeaderSize = 2 * sizeof(int) + sizeof(uint64_t);
+
+template <class NumType, class LabelType>
+void BatchLUSequenceParser<NumType, LabelType>::SetTokenCache(const std::wstring& cacheFileName, uint64_t vocabularyKey)
+{
+    mCacheFileName = cacheFileName;
+    if (mCacheFileName.empty())
+        return;
+
+    // ids also depend on how unknown words and sequence ends are recognized, and on the data file itself
+    uint64_t key = vocabularyKey;
+    for (const wstring* s : {&mUnkStr, &m_endSequenceOut, &m_endTag})
+    {
+        for (wchar_t c : *s)
+            key = (key ^ (uint64_t) c) * 1099511628211ull;
+        key = (key ^ 0xffff) * 1099511628211ull;
+    }
+    mCacheKey = key ^ (uint64_t) filesize64(mFileName.c_str());
+
+    if (OpenTokenCache())
+    {
+        mFile.close();
+        fprintf(stderr, "BatchLUSequenceParser: Reading token ids from cache %ls\n", mCacheFileName.c_str());
+    }
+    else
+        BeginTokenCache();
+}
+
+// open an up-to-date token cache for reading and position it at the first record
+template <class NumType, class LabelType>
+bool BatchLUSequenceParser<NumType, LabelType>::OpenTokenCache()
+{
+    if (mCacheFileName.empty() || !fexists(mCacheFileName) || !msra::files::fuptodate(mCacheFileName, mFileName))
+        return false;
+
+    FILE* f = fopenOrDie(mCacheFileName, L"rb");
+    int header[2];
+    uint64_t key;
+    if (fread(header, sizeof(header), 1, f) != 1 || fread(&key, sizeof(key), 1, f) != 1 ||
+        header[0] != tokenCacheMagic || header[1] != tokenCacheVersion || key != mCacheKey)
+    {
+        fprintf(stderr, "BatchLUSequenceParser: Token cache %ls does not match the data or vocabulary, rebuilding it\n", mCacheFileName.c_str());
+        fclose(f);
+        return false;
+    }
+    mCacheIn = f;
+    return true;
+}
+
+// start recording the token ids of a pass that begins at the start of mFile
+template <class NumType, class LabelType>
+void BatchLUSequenceParser<NumType, LabelType>::BeginTokenCache()
+{
+    if (mCacheFileName.empty())
+        return;
+    mCacheOut = fopenOrDie(mCacheFileName + L".tmp", L"wb");
+    fputint(mCacheOut, tokenCacheMagic);
+    fputint(mCacheOut, tokenCacheVersion);
+    fwriteOrDie(&mCacheKey, sizeof(mCacheKey), 1, mCacheOut);
+}
+
+// drop a partial recording, e.g. when a pass is restarted before it reached the end of the data
+template <class NumType, class LabelType>
+void BatchLUSequenceParser<NumType, LabelType>::AbandonTokenCache()
+{
+    if (!mCacheOut)
+        return;
+    fclose(mCacheOut);
+    mCacheOut = NULL;
+    unlinkOrDie(mCacheFileName + L".tmp");
+}
+
+// a pass over mFile reached its end: publish the recording
+template <class NumType, class LabelType>
+void BatchLUSequenceParser<NumType, LabelType>::FinishTokenCache()
+{
+    if (!mCacheOut)
+        return;
+    fflushOrDie(mCacheOut);
+    fclose(mCacheOut);
+    mCacheOut = NULL;
+    if (fexists(mCacheFileName))
+        unlinkOrDie(mCacheFileName);
+    renameOrDie(mCacheFileName + L".tmp", mCacheFileName);
+    fprintf(stderr, "BatchLUSequenceParser: Wrote token ids to cache %ls\n", mCacheFileName.c_str());
+}
+
+template <class NumType, class LabelType>
+void BatchLUSequenceParser<NumType, LabelType>::ParseReset()
+{
+    AbandonTokenCache();
+    if (mCacheIn)
+    {
+        fseekOrDie(mCacheIn, tokenCacheHeaderSize);
+        return;
+    }
+    if (OpenTokenCache()) // the previous pass has just written it
+    {
+        mFile.close();
+        return;
+    }
+
+    mFile.close();
+#ifdef __unix__
+    mFile.open(ws2s(mFileName), wifstream::in);
+#else
+    mFile.open(mFileName, wifstream::in);
+#endif
+    if (!mFile.good())
+        RuntimeError("cannot open file %ls", mFileName.c_str());
+    BeginTokenCache();
+}
+
+// ReadLine - get the next line of the data as token ids, from the cache or by tokenizing the text
 template <class NumType, class LabelType>
-long BatchLUSequenceParser<NumType, LabelType>::Parse(size_t recordsRequested, std::vector<long> *labels, std::vector<vector<long>> *input, std::vector<SequencePosition> *seqPos, const map<wstring, long> &inputlabel2id, const map<wstring, long> &outputlabel2id, bool canMultiplePassData)
+typename BatchLUSequenceParser<NumType, LabelType>::LineKind BatchLUSequenceParser<NumType, LabelType>::ReadLine(const LUVocabulary& inputVocabulary, const LUVocabulary& outputVocabulary,
+                                                                                                                vector<long>& inputIds, long& labelId, bool& endOfSequence)
+{
+    if (mCacheIn)
+    {
+        int n;
+        if (fread(&n, sizeof(n), 1, mCacheIn) != 1)
+            return lineEnd;
+        if (n < 0)
+            return n == -1 ? lineBlank : lineShort;
+        mCacheRecord.resize(n + 2);
+        freadOrDie(mCacheRecord, mCacheRecord.size(), mCacheIn);
+        inputIds.assign(mCacheRecord.begin(), mCacheRecord.begin() + n);
+        labelId = mCacheRecord[n];
+        endOfSequence = mCacheRecord[n + 1] != 0;
+        return lineTokens;
+    }
+
+    if (!mFile.good())
+        return lineEnd;
+    wstring& ch = mLine;
+    getline(mFile, ch);
+    trim(ch);
+    if (mFile.eof())
+    {
+        FinishTokenCache();
+        return lineEnd;
+    }
+
+    LineKind kind = lineTokens;
+    mTokens.clear();
+    if (ch.length() == 0)
+        kind = lineBlank;
+    else
+    {
+        // split at blanks without creating strings; words are looked up in place
+        for (size_t pos = ch.find_first_not_of(L" \n\r\t"); pos != wstring::npos;)
+        {
+            size_t end = ch.find_first_of(L" \n\r\t", pos);
+            if (end == wstring::npos)
+                end = ch.length();
+            mTokens.push_back(make_pair(pos, end));
+            pos = ch.find_first_not_of(L" \n\r\t", end);
+        }
+        if (mTokens.size() < 2)
+            kind = lineShort;
+    }
+
+    if (kind == lineTokens)
+    {
+        inputIds.resize(mTokens.size() - 1);
+        for (size_t i = 0; i < inputIds.size(); i++)
+        {
+            inputIds[i] = inputVocabulary.Find(ch.data() + mTokens[i].first, mTokens[i].second - mTokens[i].first);
+            if (inputIds[i] < 0)
+            {
+                inputIds[i] = inputVocabulary.Find(mUnkStr);
+                if (inputIds[i] < 0)
+                    LogicError("cannot find item %ls and unk str %ls in input label", ch.substr(mTokens[i].first, mTokens[i].second - mTokens[i].first).c_str(), mUnkStr.c_str());
+            }
+        }
+        const auto& last = mTokens.back();
+        labelId = outputVocabulary.Find(ch.data() + last.first, last.second - last.first);
+        if (labelId < 0)
+        {
+            labelId = outputVocabulary.Find(mUnkStr);
+            if (labelId < 0)
+                LogicError("cannot find item %ls and unk str %ls in output label", ch.substr(last.first, last.second - last.first).c_str(), mUnkStr.c_str());
+        }
+        endOfSequence = ch.compare(last.first, last.second - last.first, m_endSequenceOut) == 0 ||
+                        // below is for backward support
+                        ch.compare(mTokens[0].first, mTokens[0].second - mTokens[0].first, m_endTag) == 0;
+    }
+
+    if (mCacheOut)
+    {
+        if (kind == lineTokens)
+        {
+            mCacheRecord.assign(1, (int) inputIds.size());
+            mCacheRecord.insert(mCacheRecord.end(), inputIds.begin(), inputIds.end());
+            mCacheRecord.push_back((int) labelId);
+            mCacheRecord.push_back(endOfSequence ? 1 : 0);
+            fwriteOrDie(mCacheRecord, mCacheOut);
+        }
+        else
+            fputint(mCacheOut, kind == lineBlank ? -1 : -2);
+    }
+    return kind;
+}
+
+template <class NumType, class LabelType>
+long BatchLUSequenceParser<NumType, LabelType>::Parse(size_t recordsRequested, std::vector<long> *labels, std::vector<vector<long>> *input, std::vector<SequencePosition> *seqPos, const LUVocabulary &inputVocabulary, const LUVocabulary &outputVocabulary, bool canMultiplePassData)
 {
     fprintf(stderr, "BatchLUSequenceParser: Parsing input data...\n");
 
@@ -60,13 +270,13 @@ long BatchLUSequenceParser<NumType, LabelType>::Parse(size_t recordsRequested, s
     bool bAtEOS = false; // whether the reader is at the end of sentence position
     SequencePosition sequencePositionLast(0, 0, 0);
 
-    wstring ch;
-    while (lineCount < recordsRequested && mFile.good())
+    vector<long> vtmp;
+    long labelId;
+    bool endOfSequence;
+    while (lineCount < recordsRequested)
     {
-        getline(mFile, ch);
-        ch = trim(ch); // TODO: operates in-place, so no need to assign back
-
-        if (mFile.eof())
+        LineKind kind = ReadLine(inputVocabulary, outputVocabulary, vtmp, labelId, endOfSequence);
+        if (kind == lineEnd)
         {
             if (canMultiplePassData)
             {
@@ -77,9 +287,7 @@ long BatchLUSequenceParser<NumType, LabelType>::Parse(size_t recordsRequested, s
                 break;
         }
 
-        std::vector<wstring> vstr;
-        bool bBlankLine = (ch.length() == 0);
-        if (bBlankLine && !bAtEOS && input->size() > 0 && labels->size() > 0)
+        if (kind == lineBlank && !bAtEOS && input->size() > 0 && labels->size() > 0)
         {
             AddOneItem(labels, input, seqPos, lineCount, recordCount, orgRecordCount, sequencePositionLast);
             bAtEOS = true;
@@ -89,38 +297,13 @@ long BatchLUSequenceParser<NumType, LabelType>::Parse(size_t recordsRequested, s
         // got a token
         tokenCount++;
 
-        vstr = SplitString(ch, L" \n\r\t");
-        if (vstr.size() < 2)
+        if (kind != lineTokens)
             continue;
 
         bAtEOS = false;
-        vector<long> vtmp;
-        for (size_t i = 0; i < vstr.size() - 1; i++)
-        {
-            if (inputlabel2id.find(vstr[i]) == inputlabel2id.end())
-            {
-                if (inputlabel2id.find(mUnkStr) == inputlabel2id.end())
-                {
-                    LogicError("cannot find item %ls and unk str %ls in input label", vstr[i].c_str(), mUnkStr.c_str());
-                }
-                vtmp.push_back(inputlabel2id.find(mUnkStr)->second);
-            }
-            else
-                vtmp.push_back(inputlabel2id.find(vstr[i])->second);
-        }
-        if (outputlabel2id.find(vstr[vstr.size() - 1]) == outputlabel2id.end())
-        {
-            if (outputlabel2id.find(mUnkStr) == outputlabel2id.end())
-                LogicError("cannot find item %ls and unk str %ls in output label", vstr[vstr.size() - 1].c_str(), mUnkStr.c_str());
-            labels->push_back(outputlabel2id.find(mUnkStr)->second);
-        }
-        else
-            labels->push_back(outputlabel2id.find(vstr[vstr.size() - 1])->second);
+        labels->push_back(labelId);
         input->push_back(vtmp);
-        if ((vstr[vstr.size() - 1] == m_endSequenceOut ||
-             // below is for backward support
-             vstr[0] == m_endTag) &&
-            input->size() > 0 && labels->size() > 0)
+        if (endOfSequence && input->size() > 0 && labels->size() > 0)
         {
             AddOneItem(labels, input, seqPos, lineCount, recordCount, orgRecordCount, sequencePositionLast);
             bAtEOS = true;
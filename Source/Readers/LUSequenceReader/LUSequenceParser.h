@@ -16,6 +16,7 @@
 #include <stdint.h>
 #include "Platform.h"
 #include "DataReader.h"
+#include "LUVocabulary.h"
 
 using namespace std;
 
@@ -143,6 +144,30 @@ public:
     std::wstring mFileName;
     vector<SentenceInfo> mSentenceIndex2SentenceInfo;
 
+private:
+    // token-id cache, see SetTokenCache()
+    std::wstring mCacheFileName;
+    uint64_t mCacheKey;
+    FILE* mCacheIn;                         // if not NULL, lines are read from the cache instead of mFile
+    FILE* mCacheOut;                        // if not NULL, the pass over mFile is being recorded into mCacheFileName + ".tmp"
+    std::vector<int> mCacheRecord;          // scratch buffer for one cache record
+    std::wstring mLine;                     // scratch buffer for the current line of mFile
+    std::vector<std::pair<size_t, size_t>> mTokens; // scratch buffer: [begin, end) of the tokens of the current line
+
+    // what ReadLine() found
+    enum LineKind
+    {
+        lineEnd,    // end of the data
+        lineBlank,  // empty line, ends a sequence
+        lineShort,  // line with less than two tokens, ignored
+        lineTokens, // input tokens followed by an output label
+    };
+    LineKind ReadLine(const LUVocabulary& inputVocabulary, const LUVocabulary& outputVocabulary, vector<long>& inputIds, long& labelId, bool& endOfSequence);
+    bool OpenTokenCache();
+    void BeginTokenCache();
+    void AbandonTokenCache();
+    void FinishTokenCache();
+
 public:
     using LUSequenceParser<NumType, LabelType>::m_dimFeatures;
     using LUSequenceParser<NumType, LabelType>::m_dimLabelsIn;
@@ -159,10 +184,16 @@ public:
     using LUSequenceParser<NumType, LabelType>::m_labels;
     using LUSequenceParser<NumType, LabelType>::m_beginSequence;
     using LUSequenceParser<NumType, LabelType>::m_endSequence;
-    BatchLUSequenceParser(){};
+    BatchLUSequenceParser()
+        : mCacheKey(0), mCacheIn(NULL), mCacheOut(NULL)
+    {
+    }
     ~BatchLUSequenceParser()
     {
         mFile.close();
+        if (mCacheIn)
+            fclose(mCacheIn);
+        AbandonTokenCache();
     }
 
     void ParseInit(LPCWSTR fileName, size_t dimLabelsIn, size_t dimLabelsOut, wstring beginSequenceIn, wstring endSequenceIn, wstring beginSequenceOut, wstring endSequenceOut, wstring unkstr = "<UNK>")
@@ -183,6 +214,12 @@ public:
 
         mUnkStr = unkstr;
 
+        AbandonTokenCache();
+        if (mCacheIn)
+            fclose(mCacheIn);
+        mCacheIn = NULL;
+        mCacheFileName.clear();
+
         mFile.close();
 #ifdef __unix__
         mFile.open(ws2s(fileName), wifstream::in);
@@ -193,17 +230,14 @@ public:
             RuntimeError("cannot open file %ls", fileName);
     }
 
-    void ParseReset()
-    {
-        mFile.close();
-#ifdef __unix__
-        mFile.open(ws2s(mFileName), wifstream::in);
-#else
-        mFile.open(mFileName, wifstream::in);
-#endif
-        if (!mFile.good())
-            RuntimeError("cannot open file %ls", mFileName.c_str());
-    }
+    // SetTokenCache - keep the token ids of the data in a binary file next to it
+    // The first complete pass over the data file writes the token ids of all lines to cacheFileName;
+    // all later passes, including those of later runs, read them from there instead of tokenizing the text again.
+    // The cache is only used if it is newer than the data file and was written with the same vocabularies.
+    // vocabularyKey - fingerprint of the input and output vocabularies
+    void SetTokenCache(const std::wstring& cacheFileName, uint64_t vocabularyKey);
+
+    void ParseReset();
 
     void AddOneItem(std::vector<long>* labels, std::vector<vector<long>>* input, std::vector<SequencePosition>* seqPos, long& lineCount,
                     long& recordCount, long orgRecordCount, SequencePosition& sequencePositionLast)
@@ -228,7 +262,7 @@ public:
     // numbers - pointer to vector to return the numbers
     // seqPos - pointers to the other two arrays showing positions of each sequence
     // returns - number of records actually read, if the end of file is reached the return value will be < requested records
-    long Parse(size_t recordsRequested, std::vector<long>* labels, std::vector<vector<long>>* input, std::vector<SequencePosition>* seqPos, const map<wstring, long>& inputlabel2id, const map<wstring, long>& outputlabel2id, bool mAllowMultPassData = false);
+    long Parse(size_t recordsRequested, std::vector<long>* labels, std::vector<vector<long>>* input, std::vector<SequencePosition>* seqPos, const LUVocabulary& inputVocabulary, const LUVocabulary& outputVocabulary, bool mAllowMultPassData = false);
 };
 }
 }
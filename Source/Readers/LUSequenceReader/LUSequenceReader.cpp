@@ -26,9 +26,7 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 template <class ElemType>
 long LUSequenceReader<ElemType>::GetIdFromLabel(const LabelType& labelValue, LabelInfo& labelInfo)
 {
-    auto found = labelInfo.word4idx.find(labelValue);
-
-    return found->second;
+    return labelInfo.vocabulary->Find(labelValue);
 }
 
 template <class ElemType>
@@ -41,69 +39,6 @@ BatchLUSequenceReader<ElemType>::~BatchLUSequenceReader()
     };
 }
 
-template <class ElemType>
-void BatchLUSequenceReader<ElemType>::ReadLabelInfo(const wstring& vocfile,
-                                                    map<wstring, long>& word4idx,
-                                                    bool readClass,
-                                                    map<wstring, long>& word4cls,
-                                                    map<long, wstring>& idx4word,
-                                                    map<long, long>& idx4class,
-                                                    int& mNbrCls)
-{
-    wifstream vin;
-#ifdef _MSC_VER
-    vin.open(vocfile, wifstream::in);
-#else
-    vin.open(wtocharpath(vocfile), wifstream::in);
-#endif
-    if (!vin.good())
-        LogicError("LUSequenceReader cannot open %ls\n", vocfile.c_str());
-
-    const wstring wstr = L" \n\r\t";
-    long b = 0;
-    this->nwords = 0;
-    int prevcls = -1;
-
-    mNbrCls = 0;
-    wstring strtmp;
-    while (vin.good())
-    {
-        getline(vin, strtmp);
-        strtmp = trim(strtmp); // TODO: operates in-place, so no need to re-assign to itself
-        if (strtmp.length() == 0)
-            break;
-        if (readClass)
-        {
-            vector<wstring> wordandcls = SplitString(strtmp, wstr);
-            long cls = _wtoi(wordandcls[1].c_str());
-            word4cls[wordandcls[0]] = cls;
-
-            idx4class[b] = cls;
-
-            if (idx4class[b] != prevcls)
-            {
-                if (idx4class[b] < prevcls)
-                    LogicError("LUSequenceReader: the word list needs to be grouped into classes and the classes indices need to be ascending.");
-                prevcls = idx4class[b];
-            }
-
-            word4idx[wordandcls[0]] = b;
-            idx4word[b++] = wordandcls[0];
-            if (mNbrCls < cls)
-                mNbrCls = cls;
-        }
-        else
-        {
-            word4idx[strtmp] = b;
-            idx4word[b++] = strtmp;
-        }
-        this->nwords++;
-    }
-
-    if (readClass)
-        mNbrCls++;
-}
-
 template <class ElemType>
 void BatchLUSequenceReader<ElemType>::GetClassInfo(LabelInfo& lblInfo)
 {
@@ -129,7 +64,7 @@ void BatchLUSequenceReader<ElemType>::GetClassInfo(LabelInfo& lblInfo)
     int prvcls = -1;
     for (size_t j = 0; j < this->nwords; j++)
     {
-        clsidx = lblInfo.idx4class[(long) j];
+        clsidx = lblInfo.vocabulary->ClassOf((long) j);
         if (prvcls != clsidx)
         {
             if (prvcls >= 0)
@@ -167,12 +102,7 @@ int LUSequenceReader<ElemType>::GetSentenceEndIdFromOutputLabel()
 {
     LabelInfo& featIn = m_labelInfo[labelInfoOut];
 
-    auto found = featIn.word4idx.find(featIn.endSequence);
-
-    if (found != featIn.word4idx.end())
-        return (int) found->second;
-    else
-        return -1; // not found
+    return (int) featIn.vocabulary->Find(featIn.endSequence); // -1 if not found
 }
 #endif
 
@@ -268,34 +198,6 @@ void LUSequenceReader<ElemType>::LoadLabelFile(const std::wstring& filePath, std
     }
 }
 
-template <class ElemType>
-void LUSequenceReader<ElemType>::ChangeMaping(const map<LabelType, LabelType>& maplist,
-                                              const LabelType& unkstr,
-                                              map<LabelType, LabelIdType>& word4idx)
-{
-    auto punk = word4idx.find(unkstr);
-    for (auto ptr = word4idx.begin(); ptr != word4idx.end(); ptr++)
-    {
-        LabelType wrd = ptr->first;
-        LabelIdType idx = -1;
-        if (maplist.find(wrd) != maplist.end())
-        {
-            LabelType mpp = maplist.find(wrd)->second;
-            idx = word4idx[mpp];
-        }
-        else
-        {
-            if (punk == word4idx.end())
-            {
-                RuntimeError("check unk list is missing ");
-            }
-            idx = punk->second;
-        }
-
-        word4idx[wrd] = idx;
-    }
-}
-
 template <class ElemType>
 template <class ConfigRecordType>
 void BatchLUSequenceReader<ElemType>::InitFromConfig(const ConfigRecordType& readerConfig)
@@ -384,16 +286,17 @@ void BatchLUSequenceReader<ElemType>::InitFromConfig(const ConfigRecordType& rea
                 std::wstring wClassFile = labelConfig(L"token", L"");
                 if (wClassFile != L"")
                 {
-                    ReadLabelInfo(wClassFile, m_labelInfo[index].word4idx,
-                                  m_labelInfo[index].readerMode == ReaderMode::Class,
-                                  m_labelInfo[index].word4cls,
-                                  m_labelInfo[index].idx4word, m_labelInfo[index].idx4class, m_labelInfo[index].mNbrClasses);
+                    // with useWordMap, each word takes the id of its 'wordmap' entry, and words without one that of mUnkStr
+                    m_labelInfo[index].vocabulary = LUVocabulary::Load(wClassFile, m_labelInfo[index].readerMode == ReaderMode::Class,
+                                                                       m_labelInfo[index].busewordmap ? &mWordMapping : nullptr, mWordMappingFn, mUnkStr);
+                    m_labelInfo[index].mNbrClasses = m_labelInfo[index].vocabulary->NumClasses();
+                    this->nwords = (long) m_labelInfo[index].vocabulary->Size();
 
                     GetClassInfo(m_labelInfo[index]);
                 }
-                if (m_labelInfo[index].busewordmap)
-                    ChangeMaping(mWordMapping, mUnkStr, m_labelInfo[index].word4idx);
-                m_labelInfo[index].dim = (long) m_labelInfo[index].idx4word.size();
+                else
+                    m_labelInfo[index].vocabulary = make_shared<LUVocabulary>();
+                m_labelInfo[index].dim = (long) m_labelInfo[index].vocabulary->Size();
             }
         }
     }
@@ -419,6 +322,10 @@ void BatchLUSequenceReader<ElemType>::InitFromConfig(const ConfigRecordType& rea
     fprintf(stderr, "BatchLUSequenceReader: Input file is %ls\n", pathName.c_str());
     m_parser.ParseInit(pathName.c_str(), labelIn.dim, labelOut.dim, labelIn.beginSequence, labelIn.endSequence, labelOut.beginSequence, labelOut.endSequence, mUnkStr);
 
+    // optionally keep the token ids in a binary file, so that only the first pass over the data tokenizes it
+    wstring tokenCache = readerConfig(L"tokenCache", L"");
+    m_parser.SetTokenCache(tokenCache, labelIn.vocabulary->Fingerprint() * 1099511628211ull ^ labelOut.vocabulary->Fingerprint());
+
     mRequestedNumParallelSequences = readerConfig(L"nbruttsineachrecurrentiter", (size_t) 1);
 
     mRandomize = false;
@@ -652,7 +559,7 @@ bool BatchLUSequenceReader<ElemType>::EnsureDataAvailable(size_t /*mbStartSample
         {
             Reset();
 
-            mNumRead = m_parser.Parse(CACHE_BLOCK_SIZE, &m_labelTemp, &m_featureTemp, &seqPos, featIn.word4idx, labelIn.word4idx, mAllowMultPassData);
+            mNumRead = m_parser.Parse(CACHE_BLOCK_SIZE, &m_labelTemp, &m_featureTemp, &seqPos, *featIn.vocabulary, *labelIn.vocabulary, mAllowMultPassData);
             if (mNumRead == 0)
             {
                 fprintf(stderr, "EnsureDataAvailable: No more data.\n");
@@ -939,7 +846,7 @@ size_t BatchLUSequenceReader<ElemType>::GetLabelOutput(StreamMinibatchInputs& ma
             labels.SetValue(0, j, (ElemType) wrd);
 
             long clsidx = -1;
-            clsidx = labelInfo.idx4class[wrd];
+            clsidx = labelInfo.vocabulary->ClassOf(wrd);
 
             labels.SetValue(1, j, (ElemType) clsidx);
             // save the [beginning ending_indx) of the class
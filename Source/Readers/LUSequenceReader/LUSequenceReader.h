@@ -120,9 +120,8 @@ protected:
     // we have two one for input and one for output
     struct LabelInfo
     {
-        LabelKind type; // labels are categories, create mapping table
-        map<LabelType, LabelIdType> word4idx;
-        map<LabelIdType, LabelType> idx4word;
+        LabelKind type;                                 // labels are categories, create mapping table
+        std::shared_ptr<const LUVocabulary> vocabulary; // word-to-id mapping, shared with all other sections that use the same token file
         long dim;                // maximum label ID we will ever see (used for array dimensions)
         LabelType beginSequence; // starting sequence string (i.e. <s>)
         LabelType endSequence;   // ending sequence string (i.e. </s>)
@@ -140,8 +139,6 @@ protected:
         $ 26
         where the first column is the word and the second column is the class id, base 0
         */
-        map<wstring, long> word4cls;
-        map<long, long> idx4class;
         Matrix<ElemType>* m_id2classLocal;  // CPU version
         Matrix<ElemType>* m_classInfoLocal; // CPU version
         int mNbrClasses;
@@ -170,9 +167,6 @@ protected:
 public:
     void Init(const ConfigParameters&){};
     void Init(const ScriptableObjects::IConfigRecord&){};
-    void ChangeMaping(const map<LabelType, LabelType>& maplist,
-                      const LabelType& unkstr,
-                      map<LabelType, LabelIdType>& word4idx);
 
     void Destroy(){};
 
@@ -242,7 +236,6 @@ public:
     using LUSequenceReader<ElemType>::LoadLabelFile;
     using LUSequenceReader<ElemType>::ReleaseMemory;
     using LUSequenceReader<ElemType>::LMSetupEpoch;
-    using LUSequenceReader<ElemType>::ChangeMaping;
     using LUSequenceReader<ElemType>::GetIdFromLabel;
     using LUSequenceReader<ElemType>::InitCache;
     using LUSequenceReader<ElemType>::mRandomize;
@@ -328,13 +321,6 @@ public:
 
 public:
     void GetClassInfo(LabelInfo& lblInfo);
-    void ReadLabelInfo(const wstring& vocfile,
-                       map<wstring, long>& word4idx,
-                       bool readClass,
-                       map<wstring, long>& word4cls,
-                       map<long, wstring>& idx4word,
-                       map<long, long>& idx4class,
-                       int& mNbrCls);
 
     template <class ConfigRecordType>
     void LoadWordMapping(const ConfigRecordType& config);
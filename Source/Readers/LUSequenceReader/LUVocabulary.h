@@ -0,0 +1,221 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// LUVocabulary.h -- interned word-to-id table for the LUSequenceReader
+//
+
+#pragma once
+
+#include "Basics.h"
+#include "fileutil.h"
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <fstream>
+#include <stdint.h>
+#include <string.h>
+#include <wchar.h>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// LUVocabulary -- word-to-id mapping of one token file
+// All words are stored back to back in a single string pool and found through an open-addressing hash table
+// that holds indices into it, so a lookup neither allocates nor walks a tree of std::wstring nodes.
+// An instance is immutable once loaded; Load() hands out one shared instance per token file (and word mapping),
+// so all sections and readers that name the same file use the same table, from any thread.
+class LUVocabulary
+{
+    std::wstring m_pool;           // all words, concatenated
+    std::vector<size_t> m_offsets; // [entry] start of the word in m_pool; [entry + 1] is its end
+    std::vector<long> m_ids;       // [entry] id that the word maps to
+    std::vector<int> m_slots;      // hash table of entry indices, -1 = empty; size is a power of two
+    std::vector<long> m_classes;   // [id] class of the word with this id (class mode only)
+    size_t m_numLines;             // number of lines in the token file, i.e. the label dimension
+    int m_numClasses;
+    uint64_t m_fingerprint;        // hash over all words and ids, used to validate token-id caches
+
+    static uint64_t Hash(const wchar_t* word, size_t len, uint64_t h = 14695981039346656037ull)
+    {
+        for (size_t i = 0; i < len; i++)
+            h = (h ^ (uint64_t) word[i]) * 1099511628211ull; // FNV-1a
+        return h;
+    }
+
+    size_t WordLength(size_t entry) const
+    {
+        return m_offsets[entry + 1] - m_offsets[entry];
+    }
+
+    // find the hash-table slot of a word, or the empty slot where it would go
+    size_t FindSlot(const wchar_t* word, size_t len) const
+    {
+        const size_t mask = m_slots.size() - 1;
+        for (size_t slot = (size_t) Hash(word, len) & mask;; slot = (slot + 1) & mask)
+        {
+            int entry = m_slots[slot];
+            if (entry < 0 || (WordLength(entry) == len && wmemcmp(m_pool.data() + m_offsets[entry], word, len) == 0))
+                return slot;
+        }
+    }
+
+    void Rehash(size_t numSlots)
+    {
+        m_slots.assign(numSlots, -1);
+        for (size_t entry = 0; entry + 1 < m_offsets.size(); entry++)
+            m_slots[FindSlot(m_pool.data() + m_offsets[entry], WordLength(entry))] = (int) entry;
+    }
+
+    // add a word or, if it is already known, change its id (a later line of the token file wins, as with a map)
+    void Add(const std::wstring& word, long id)
+    {
+        if (2 * (m_ids.size() + 1) > m_slots.size())
+            Rehash(m_slots.empty() ? 1024 : 2 * m_slots.size());
+        size_t slot = FindSlot(word.data(), word.size());
+        if (m_slots[slot] >= 0)
+        {
+            m_ids[m_slots[slot]] = id;
+            return;
+        }
+        m_slots[slot] = (int) m_ids.size();
+        m_pool.append(word);
+        m_offsets.push_back(m_pool.size());
+        m_ids.push_back(id);
+    }
+
+    // apply a 'wordmap': every word takes the id of the word it is mapped to, and all other words become unkStr
+    void ApplyWordMapping(const std::map<std::wstring, std::wstring>& wordMapping, const std::wstring& unkStr)
+    {
+        const std::vector<long> original = m_ids;
+        const long unkId = Find(unkStr);
+        for (size_t entry = 0; entry < m_ids.size(); entry++)
+        {
+            auto mapped = wordMapping.find(std::wstring(m_pool, m_offsets[entry], WordLength(entry)));
+            long target = mapped != wordMapping.end() ? FindEntry(mapped->second) : -1;
+            if (target >= 0)
+                m_ids[entry] = original[target];
+            else if (unkId < 0)
+                RuntimeError("check unk list is missing ");
+            else
+                m_ids[entry] = unkId;
+        }
+    }
+
+    long FindEntry(const std::wstring& word) const
+    {
+        if (m_slots.empty())
+            return -1;
+        return m_slots[FindSlot(word.data(), word.size())];
+    }
+
+    void ReadTokenFile(const std::wstring& vocfile, bool readClass)
+    {
+        std::wifstream vin;
+#ifdef _MSC_VER
+        vin.open(vocfile, std::wifstream::in);
+#else
+        vin.open(wtocharpath(vocfile), std::wifstream::in);
+#endif
+        if (!vin.good())
+            LogicError("LUSequenceReader cannot open %ls\n", vocfile.c_str());
+
+        m_offsets.assign(1, 0);
+        long prevcls = -1;
+        std::wstring strtmp;
+        while (vin.good())
+        {
+            getline(vin, strtmp);
+            trim(strtmp);
+            if (strtmp.length() == 0)
+                break;
+            const long id = (long) m_numLines++;
+            if (readClass)
+            {
+                std::vector<std::wstring> wordandcls = SplitString(strtmp, L" \n\r\t");
+                long cls = _wtoi(wordandcls[1].c_str());
+                if (cls != prevcls)
+                {
+                    if (cls < prevcls)
+                        LogicError("LUSequenceReader: the word list needs to be grouped into classes and the classes indices need to be ascending.");
+                    prevcls = cls;
+                }
+                m_classes.push_back(cls);
+                if (m_numClasses < cls)
+                    m_numClasses = cls;
+                Add(wordandcls[0], id);
+            }
+            else
+                Add(strtmp, id);
+        }
+        if (readClass)
+            m_numClasses++;
+    }
+
+public:
+    LUVocabulary()
+        : m_numLines(0), m_numClasses(0), m_fingerprint(0)
+    {
+    }
+
+    // Load - get the vocabulary of a token file, one word per line (followed by its class id if readClass)
+    // wordMapping - if not NULL, the 'wordmap' of the reader (see ApplyWordMapping()); wordMappingFn names it for sharing
+    static std::shared_ptr<const LUVocabulary> Load(const std::wstring& vocfile, bool readClass,
+                                                    const std::map<std::wstring, std::wstring>* wordMapping, const std::wstring& wordMappingFn, const std::wstring& unkStr)
+    {
+        static std::mutex s_lock;
+        static std::map<std::wstring, std::weak_ptr<const LUVocabulary>> s_loaded;
+
+        std::wstring key = vocfile + (readClass ? L"|class" : L"|plain");
+        if (wordMapping)
+            key += L"|" + wordMappingFn + L"|" + unkStr;
+
+        std::lock_guard<std::mutex> lock(s_lock);
+        auto vocabulary = s_loaded[key].lock();
+        if (vocabulary)
+            return vocabulary;
+
+        auto loaded = std::make_shared<LUVocabulary>();
+        loaded->ReadTokenFile(vocfile, readClass);
+        if (wordMapping)
+            loaded->ApplyWordMapping(*wordMapping, unkStr);
+        uint64_t h = Hash(loaded->m_pool.data(), loaded->m_pool.size());
+        for (size_t entry = 0; entry < loaded->m_ids.size(); entry++)
+            h = (h ^ (uint64_t) loaded->m_offsets[entry + 1]) * 1099511628211ull ^ (uint64_t) loaded->m_ids[entry];
+        loaded->m_fingerprint = h;
+        s_loaded[key] = loaded;
+        return loaded;
+    }
+
+    // Find - id of a word, or -1 if it is not in the vocabulary
+    long Find(const wchar_t* word, size_t len) const
+    {
+        if (m_slots.empty())
+            return -1;
+        int entry = m_slots[FindSlot(word, len)];
+        return entry < 0 ? -1 : m_ids[entry];
+    }
+    long Find(const std::wstring& word) const
+    {
+        return Find(word.data(), word.size());
+    }
+
+    size_t Size() const
+    {
+        return m_numLines;
+    }
+    int NumClasses() const
+    {
+        return m_numClasses;
+    }
+    long ClassOf(long id) const
+    {
+        return m_classes[id];
+    }
+    uint64_t Fingerprint() const
+    {
+        return m_fingerprint;
+    }
+};
+} } }
@@ -15,6 +15,7 @@
 #include <ctime>
 #include <time.h>
 #include "CUDAPageLockedMemAllocator.h"
+#include "TaskScheduler.h"
 #include <chrono>
 #include <thread>
 #ifndef _WIN32
@@ -39,7 +40,7 @@ DWORD LODWORD(size_t size)
 
 template <class ElemType>
 DenseBinaryMatrix<ElemType>::DenseBinaryMatrix(wstring name, int deviceID, size_t numRows, size_t numCols)
-    : BinaryMatrix<ElemType>(name, deviceID, numRows, numCols)
+    : BinaryMatrix<ElemType>(name, deviceID, numRows, numCols), m_viewValues(nullptr)
 {
     // this->m_values = (ElemType*)malloc(sizeof(ElemType)*numRows*numCols);
     this->m_values = (ElemType*) CUDAPageLockedMemAllocator::Malloc(sizeof(ElemType) * numRows * numCols, deviceID);
@@ -49,6 +50,7 @@ template <class ElemType>
 void DenseBinaryMatrix<ElemType>::Clear()
 {
     this->m_numRows = 0;
+    m_viewValues = nullptr;
 }
 
 template <class ElemType>
@@ -65,7 +67,7 @@ void DenseBinaryMatrix<ElemType>::Dispose()
 template <class ElemType>
 void DenseBinaryMatrix<ElemType>::Fill(Matrix<ElemType>* matrix)
 {
-    matrix->SetValue(this->m_maxNumCols, this->m_numRows, matrix->GetDeviceId(), this->m_values, matrixFlagNormal);
+    matrix->SetValue(this->m_maxNumCols, this->m_numRows, matrix->GetDeviceId(), m_viewValues ? m_viewValues : this->m_values, matrixFlagNormal);
 #if DEBUG
     matrix->Print("testname");
 #endif
@@ -101,7 +103,8 @@ void DenseBinaryMatrix<ElemType>::AddValues(void* values, size_t numRows)
 
 template <class ElemType>
 SparseBinaryMatrix<ElemType>::SparseBinaryMatrix(wstring name, int deviceId, size_t numRows, size_t numCols)
-    : BinaryMatrix<ElemType>(name, deviceId, numRows, numCols), m_rowIndices(nullptr), m_colIndices(nullptr), m_nnz(0), m_maxNNz(0)
+    : BinaryMatrix<ElemType>(name, deviceId, numRows, numCols), m_rowIndices(nullptr), m_colIndices(nullptr), m_nnz(0), m_maxNNz(0),
+      m_viewValues(nullptr), m_viewRowIndices(nullptr), m_viewColIndices(nullptr)
 {
     // m_colIndices = (int32_t*)malloc(sizeof(int32_t)*(numRows + 1));
     m_colIndices = (int32_t*) CUDAPageLockedMemAllocator::Malloc(sizeof(int32_t) * (numRows + 1), deviceId);
@@ -191,6 +194,9 @@ void SparseBinaryMatrix<ElemType>::Clear()
 {
     m_numRows = 0;
     m_nnz = 0;
+    m_viewValues = nullptr;
+    m_viewRowIndices = nullptr;
+    m_viewColIndices = nullptr;
 }
 
 template <class ElemType>
@@ -218,7 +224,10 @@ void SparseBinaryMatrix<ElemType>::AddRowIndices(void* rowIndices, size_t nnz)
 template <class ElemType>
 void SparseBinaryMatrix<ElemType>::Fill(Matrix<ElemType>* matrix)
 {
-    matrix->SetMatrixFromCSCFormat(m_colIndices, m_rowIndices, this->m_values, this->m_nnz, this->m_maxNumCols, this->m_numRows);
+    if (m_viewValues)
+        matrix->SetMatrixFromCSCFormat(m_viewColIndices, m_viewRowIndices, m_viewValues, this->m_nnz, this->m_maxNumCols, this->m_numRows);
+    else
+        matrix->SetMatrixFromCSCFormat(m_colIndices, m_rowIndices, this->m_values, this->m_nnz, this->m_maxNumCols, this->m_numRows);
 #if DEBUG
     matrix->Print("testname");
 #endif
@@ -226,7 +235,7 @@ void SparseBinaryMatrix<ElemType>::Fill(Matrix<ElemType>* matrix)
 
 template <class ElemType>
 SparseBinaryInput<ElemType>::SparseBinaryInput(std::wstring fileName)
-    : m_fileName(fileName), m_readOrder(nullptr), m_readOrderLength(0), m_randomize(false), m_tempValues(nullptr), m_tempValuesSize(0), m_offsets(nullptr), m_offsetsStart(0), m_startMB(0), m_endMB(0)
+    : m_fileName(fileName), m_readOrder(nullptr), m_readOrderLength(0), m_randomize(false), m_tempValues(nullptr), m_tempValuesSize(0), m_offsets(nullptr), m_offsetsStart(0), m_startMB(0), m_endMB(0), m_viewBuffer(nullptr)
 {
     std::string name = msra::strfun::utf8(m_fileName);
     m_inFile.open(name, ifstream::binary | ifstream::in);
@@ -540,7 +549,7 @@ void SparseBinaryInput<ElemType>::ReadMinibatches(size_t* read_order, size_t num
 }
 
 template <class ElemType>
-size_t SparseBinaryInput<ElemType>::ReadMinibatch(void* data_buffer, std::map<std::wstring, shared_ptr<BinaryMatrix<ElemType>>>& matrices)
+size_t SparseBinaryInput<ElemType>::ReadMinibatch(void* data_buffer, std::map<std::wstring, shared_ptr<BinaryMatrix<ElemType>>>& matrices, bool asView)
 {
 
     // fprintf(stderr, "start read minibatch.\n");
@@ -582,6 +591,11 @@ size_t SparseBinaryInput<ElemType>::ReadMinibatch(void* data_buffer, std::map<st
         if (findMat != matrices.end())
         {
             auto mat = findMat->second;
+            if (asView)
+            {
+                mat->SetView(vals, rowIndices, colIndices, nnz, curMBSize);
+                continue;
+            }
             mat->ResizeArrays(nnz);
             mat->AddValues(vals, nnz);
             mat->AddRowIndices(rowIndices, nnz);
@@ -605,6 +619,11 @@ size_t SparseBinaryInput<ElemType>::ReadMinibatch(void* data_buffer, std::map<st
         if (findMat != matrices.end())
         {
             auto mat = findMat->second;
+            if (asView)
+            {
+                mat->SetView(vals, nullptr, nullptr, 0, curMBSize);
+                continue;
+            }
             mat->AddValues(vals, curMBSize);
 #ifdef DEBUG
             mat->Print("labels");
@@ -620,6 +639,12 @@ size_t SparseBinaryInput<ElemType>::FillMatrices(std::map<std::wstring, shared_p
 
     // fprintf(stderr, "start fill matrices\n");
     size_t curSize = 0;
+    // the matrices of the last minibatch have been filled from it by now
+    if (m_viewBuffer != nullptr)
+    {
+        m_dataToProduce.push(m_viewBuffer);
+        m_viewBuffer = nullptr;
+    }
     for (auto mat : matrices)
     {
         mat.second->SetMaxRows(m_mbSize);
@@ -637,6 +662,16 @@ size_t SparseBinaryInput<ElemType>::FillMatrices(std::map<std::wstring, shared_p
         // fprintf(stderr, "start read mb\tIt took me %d clicks (%f seconds).\n", start_w, ((float)start_w) / CLOCKS_PER_SEC);
         // start_w = in_w;
         // fprintf(stderr, "start read mb\n");
+        // A minibatch that is a single stored one is not copied: the matrices are filled from the arrays of the read buffer,
+        // which are laid out in CSC format already. The buffer is kept until the next call.
+        int32_t bufferMBSize = *(int32_t*) data_buffer;
+        if (curSize == 0 && (bufferMBSize + m_microBatchSize > m_mbSize || m_nextMB + 1 >= m_epochSize))
+        {
+            curSize = ReadMinibatch(data_buffer, matrices, true);
+            m_nextMB++;
+            m_viewBuffer = data_buffer;
+            break;
+        }
         curSize += ReadMinibatch(data_buffer, matrices);
         // fprintf(stderr, "end read mb\n");
         m_nextMB++;
@@ -713,6 +748,9 @@ void LibSVMBinaryReader<ElemType>::Destroy()
 template <class ElemType>
 LibSVMBinaryReader<ElemType>::~LibSVMBinaryReader()
 {
+    // a prefetch still in flight fills m_dataMatrices
+    if (m_pendingAsyncGetMinibatch.valid())
+        m_pendingAsyncGetMinibatch.wait();
     Destroy();
 }
 
@@ -793,7 +831,7 @@ bool LibSVMBinaryReader<ElemType>::GetMinibatch(StreamMinibatchInputs& matrices)
         {
             // fprintf(stderr, "not valid\n");
             CheckDataMatrices(matrices);
-            m_pendingAsyncGetMinibatch = std::async(std::launch::async, [this]()
+            m_pendingAsyncGetMinibatch = TaskScheduler::Instance().Submit(TaskClass::prefetch, [this]()
                                                     {
                                                         return m_dataInput->FillMatrices(m_dataMatrices);
                                                     });
@@ -830,7 +868,7 @@ bool LibSVMBinaryReader<ElemType>::GetMinibatch(StreamMinibatchInputs& matrices)
         if (matrices.HasInput(L"DSSMLabel"))
             DoDSSMMatrix(matrices.GetInputMatrix<ElemType>(L"DSSMLabel"), actualMBSize);
 
-        m_pendingAsyncGetMinibatch = std::async(std::launch::async, [this]()
+        m_pendingAsyncGetMinibatch = TaskScheduler::Instance().Submit(TaskClass::prefetch, [this]()
         {
             // CheckDataMatrices(matrices);
             return m_dataInput->FillMatrices(m_dataMatrices);
@@ -75,6 +75,9 @@ public:
     }
     virtual void ResizeArrays(size_t) = 0;
     virtual void SetMaxRows(size_t maxRows) = 0;
+    // the next Fill() takes the arrays of a read buffer as they are, instead of values added to this matrix
+    // The buffer must not be reused until then (see SparseBinaryInput::FillMatrices()).
+    virtual void SetView(void* values, void* rowIndices, void* colIndices, size_t nnz, size_t numRows) = 0;
 
 protected:
     wstring m_matrixName;
@@ -113,8 +116,14 @@ public:
         NOT_IMPLEMENTED
     }
     virtual void SetMaxRows(size_t maxRows) override;
+    virtual void SetView(void* values, void* /*rowIndices*/, void* /*colIndices*/, size_t /*nnz*/, size_t numRows) override
+    {
+        m_viewValues = (ElemType*) values;
+        this->m_numRows = numRows;
+    }
 
 protected:
+    ElemType* m_viewValues;
 };
 
 template <class ElemType>
@@ -137,12 +146,24 @@ public:
     }
     virtual void ResizeArrays(size_t newMaxNNz) override;
     virtual void SetMaxRows(size_t maxRows) override;
+    virtual void SetView(void* values, void* rowIndices, void* colIndices, size_t nnz, size_t numRows) override
+    {
+        m_viewValues = (ElemType*) values;
+        m_viewRowIndices = (int32_t*) rowIndices;
+        m_viewColIndices = (int32_t*) colIndices;
+        m_nnz = nnz;
+        m_numRows = numRows;
+    }
 
 protected:
     int32_t* m_rowIndices;
     int32_t* m_colIndices;
     size_t m_nnz;
     size_t m_maxNNz;
+
+    ElemType* m_viewValues;
+    int32_t* m_viewRowIndices;
+    int32_t* m_viewColIndices;
 };
 
 template <class ElemType>
@@ -154,7 +175,7 @@ public:
     void Init(std::map<std::wstring, std::wstring> rename);
     void StartDistributedMinibatchLoop(size_t mbSize, size_t subsetNum, size_t numSubsets);
     void ReadMinibatches(size_t* read_order, size_t numToRead);
-    size_t ReadMinibatch(void* data_buffer, std::map<std::wstring, shared_ptr<BinaryMatrix<ElemType>>>& matrices);
+    size_t ReadMinibatch(void* data_buffer, std::map<std::wstring, shared_ptr<BinaryMatrix<ElemType>>>& matrices, bool asView = false);
     size_t FillMatrices(std::map<std::wstring, shared_ptr<BinaryMatrix<ElemType>>>& matrices);
     size_t GetMBSize()
     {
@@ -223,6 +244,7 @@ private:
 #endif
     BlockingQueue<void*> m_dataToProduce;
     BlockingQueue<void*> m_dataToConsume;
+    void* m_viewBuffer; // the read buffer of the last minibatch, if its matrices are views of it (see FillMatrices())
 };
 
 template <class ElemType>
@@ -11,7 +11,10 @@
 #include <iostream>
 
 #include "DataReader.h"
+#include "PipelineStatistics.h"
+#include "ElementTypeUtils.h"
 #include <random>
+#include <limits>
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -62,9 +65,9 @@ bool BlockRandomizer::TimelineIsValidForRandomization(const SequenceDescriptions
     return it == timeline.end();
 }
 
-void BlockRandomizer::RandomizeChunks()
+std::vector<size_t> BlockRandomizer::GetRandomizedChunkIndices(size_t sweep) const
 {
-    // Create vector of chunk indices and shuffle them using current sweep as seed
+    // Create vector of chunk indices and shuffle them using the sweep as seed
     std::vector<size_t> randomizedChunkIndices;
     randomizedChunkIndices.reserve(m_numChunks);
     for (size_t i = 0; i < m_numChunks; i++)
@@ -74,13 +77,32 @@ void BlockRandomizer::RandomizeChunks()
 
     if (m_useLegacyRandomization)
     {
-        RandomShuffle(randomizedChunkIndices, m_sweep);
+        RandomShuffle(randomizedChunkIndices, sweep);
     }
     else
     {
-        std::mt19937 m_rng((int)m_sweep);
+        std::mt19937 m_rng((int)sweep);
         std::shuffle(randomizedChunkIndices.begin(), randomizedChunkIndices.end(), m_rng);
     }
+    return randomizedChunkIndices;
+}
+
+void BlockRandomizer::RandomizeChunks()
+{
+    const std::vector<size_t> randomizedChunkIndices = GetRandomizedChunkIndices(m_sweep);
+
+    // The chunk cache evicts by the order in which the chunks are needed, up to the end of the next sweep.
+    if (m_chunkCacheBytes > 0)
+    {
+        const std::vector<size_t> nextSweepChunkIndices = GetRandomizedChunkIndices(m_sweep + 1);
+        m_chunkPositionInSweep.resize(m_numChunks);
+        m_chunkPositionInNextSweep.resize(m_numChunks);
+        for (size_t position = 0; position < m_numChunks; position++)
+        {
+            m_chunkPositionInSweep[randomizedChunkIndices[position]] = position;
+            m_chunkPositionInNextSweep[nextSweepChunkIndices[position]] = position;
+        }
+    }
 
     // Place randomized chunks on global time line
     m_randomizedChunks.clear();
@@ -150,15 +172,20 @@ size_t BlockRandomizer::GetChunkIndexForSequencePosition(size_t sequencePosition
     return result - m_randomizedChunks.begin() - 1;
 }
 
-bool BlockRandomizer::IsValidForPosition(size_t targetPosition, const SequenceDescription& seqDesc) const
+bool BlockRandomizer::IsValidForPosition(size_t targetPosition, const RandomizedSequence& sequence) const
 {
     const auto& chunk = m_randomizedChunks[GetChunkIndexForSequencePosition(targetPosition)];
-    return chunk.m_windowBegin <= seqDesc.m_chunkId && seqDesc.m_chunkId < chunk.m_windowEnd;
+    return chunk.m_windowBegin <= sequence.m_chunkId && sequence.m_chunkId < chunk.m_windowEnd;
+}
+
+size_t BlockRandomizer::GetTimelineIndex(const RandomizedSequence& sequence) const
+{
+    const auto& chunk = m_randomizedChunks[sequence.m_chunkId];
+    return m_chunkInformation[chunk.m_originalChunkIndex].m_sequencePositionStart + sequence.m_indexInChunk;
 }
 
 void BlockRandomizer::Randomize()
 {
-    const auto& timeline = m_deserializer->GetSequenceDescriptions();
     RandomizeChunks();
 
     // Set up m_randomTimeline, shuffled by chunks.
@@ -167,14 +194,13 @@ void BlockRandomizer::Randomize()
     for (size_t chunkId = 0; chunkId < m_numChunks; chunkId++)
     {
         auto originalChunkIndex = m_randomizedChunks[chunkId].m_originalChunkIndex;
+        size_t numberOfSequences = m_chunkInformation[originalChunkIndex + 1].m_sequencePositionStart -
+                                   m_chunkInformation[originalChunkIndex].m_sequencePositionStart;
+        assert(chunkId <= std::numeric_limits<uint32_t>::max() && numberOfSequences <= std::numeric_limits<uint32_t>::max());
 
-        for (size_t sequencePosition = m_chunkInformation[originalChunkIndex].m_sequencePositionStart;
-             sequencePosition < m_chunkInformation[originalChunkIndex + 1].m_sequencePositionStart;
-             sequencePosition++)
+        for (size_t indexInChunk = 0; indexInChunk < numberOfSequences; indexInChunk++)
         {
-            SequenceDescription randomizedSeqDesc = *timeline[sequencePosition];
-            randomizedSeqDesc.m_chunkId = chunkId;
-            m_randomTimeline.push_back(randomizedSeqDesc);
+            m_randomTimeline.push_back(RandomizedSequence{ (uint32_t)indexInChunk, (uint32_t)chunkId });
         }
     }
     assert(m_randomTimeline.size() == m_numSequences);
@@ -281,60 +307,131 @@ BlockRandomizer::BlockRandomizer(int verbosity,
     m_sweep(SIZE_MAX),
     m_sequencePositionInSweep(SIZE_MAX),
     m_samplePositionInEpoch(SIZE_MAX),
-    m_epochSize(SIZE_MAX)
+    m_epochSize(SIZE_MAX),
+    m_numSequences(0),
+    m_numChunks(0),
+    m_numSamples(0),
+    m_totalNumberOfSamples(0),
+    m_frameMode(true),
+    m_timelineWorkerRank(SIZE_MAX),
+    m_timelineNumberOfWorkers(SIZE_MAX),
+    m_prefetchChunks(0),
+    m_prefetchBytes(0),
+    m_chunkCacheBytes(0),
+    m_cachedBytes(0)
 {
     assert(deserializer != nullptr);
-    const SequenceDescriptions& timeline = m_deserializer->GetSequenceDescriptions();
-    assert(TimelineIsValidForRandomization(timeline));
+    assert(TimelineIsValidForRandomization(m_deserializer->GetSequenceDescriptions()));
 
-    if (timeline.size() == 0)
+    // With local chunks the chunk information depends on the worker, which is known at the start of the epoch.
+    if (m_distributionMode != DistributionMode::local_chunks)
     {
-        m_numSequences = 0;
-        m_numChunks = 0;
+        BuildChunkInformation(0, 1);
     }
-    else
+
+    m_streams = m_deserializer->GetStreamDescriptions();
+
+    // Size estimate for the prefetch limit: dense samples are stored in full, sparse ones are assumed to have a single value
+    m_bytesPerSample = 0;
+    for (const auto& stream : m_streams)
     {
-        // TODO let timeline keep this info?
-        m_numSequences = timeline.back()->m_id + 1;
-        m_numChunks = timeline.back()->m_chunkId + 1;
+        const size_t elementSize = GetSizeByType(stream->m_elementType);
+        if (stream->m_storageType == StorageType::dense && stream->m_sampleLayout != nullptr)
+            m_bytesPerSample += stream->m_sampleLayout->GetNumElements() * elementSize;
+        else
+            m_bytesPerSample += elementSize + sizeof(size_t);
     }
+}
 
-    // Generate additional information about physical chunks
-    assert(m_chunkInformation.size() == 0);
-    m_chunkInformation.reserve(m_numChunks + 1);
-    m_chunkInformation.insert(m_chunkInformation.begin(),
-        m_numChunks + 1,
-        ChunkInformation{ SIZE_MAX, SIZE_MAX });
+void BlockRandomizer::BuildChunkInformation(size_t workerRank, size_t numberOfWorkers)
+{
+    const SequenceDescriptions& timeline = m_deserializer->GetSequenceDescriptions();
+    const bool localChunks = m_distributionMode == DistributionMode::local_chunks;
 
-    size_t maxNumberOfSamples = 0;
+    m_chunkInformation.clear();
+    m_chunkIds.clear();
+    m_localTimeline.clear();
 
+    size_t maxNumberOfSamples = 0;
+    m_numSequences = 0;
     m_numSamples = 0;
+    m_totalNumberOfSamples = 0;
     for (const auto& seqDesc : timeline)
     {
-        // TODO let timeline keep this info?
-        auto& chunkInformation = m_chunkInformation[seqDesc->m_chunkId];
-        chunkInformation.m_sequencePositionStart =
-            min(chunkInformation.m_sequencePositionStart, seqDesc->m_id);
-        chunkInformation.m_samplePositionStart =
-            min(chunkInformation.m_samplePositionStart, m_numSamples);
+        m_totalNumberOfSamples += seqDesc->m_numberOfSamples;
+        if (localChunks && (seqDesc->m_chunkId % numberOfWorkers) != workerRank)
+        {
+            continue;
+        }
+
+        // The timeline is ordered by chunks (see TimelineIsValidForRandomization()).
+        if (m_chunkIds.empty() || m_chunkIds.back() != seqDesc->m_chunkId)
+        {
+            m_chunkInformation.push_back(ChunkInformation{ m_numSequences, m_numSamples });
+            m_chunkIds.push_back(seqDesc->m_chunkId);
+        }
+
+        if (localChunks)
+        {
+            m_localTimeline.push_back(seqDesc);
+        }
+
         maxNumberOfSamples = max(maxNumberOfSamples, seqDesc->m_numberOfSamples);
         m_numSamples += seqDesc->m_numberOfSamples;
+        m_numSequences++;
     }
 
+    if (localChunks && m_numSequences == 0)
+    {
+        RuntimeError("BlockRandomizer: worker %d has no data, the corpus has fewer chunks than the %d workers.",
+                     (int)workerRank, (int)numberOfWorkers);
+    }
+
+    m_numChunks = m_chunkIds.size();
+
     // Add sentinel
-    m_chunkInformation[m_numChunks] = { m_numSequences, m_numSamples };
+    m_chunkInformation.push_back(ChunkInformation{ m_numSequences, m_numSamples });
 
     // Frame mode to the randomizer just means there are only single-sample sequences
     m_frameMode = (maxNumberOfSamples == 1);
 
-    m_streams = m_deserializer->GetStreamDescriptions();
+    m_timelineWorkerRank = workerRank;
+    m_timelineNumberOfWorkers = numberOfWorkers;
+
+    // Randomization has to be redone for the new chunks.
+    m_sweep = SIZE_MAX;
+    m_randomizedChunks.clear();
+    m_randomTimeline.clear();
+    m_chunks.clear();
+    m_cachedChunks.clear();
+    m_cachedBytes = 0;
+}
+
+const SequenceDescriptions& BlockRandomizer::GetTimeline() const
+{
+    return m_distributionMode == DistributionMode::local_chunks ? m_localTimeline : m_deserializer->GetSequenceDescriptions();
 }
 
 void BlockRandomizer::Initialize(TransformerPtr next, const ConfigParameters& readerConfig)
 {
     // Not used for the block randomizer.
     UNUSED(next);
-    UNUSED(readerConfig);
+
+    // Chunks that enter the randomization window next are loaded ahead on 'prefetchThreads' threads,
+    // up to 'prefetchChunks' chunks and, if given, 'prefetchBytes' bytes (estimated from the stream descriptions).
+    // prefetchThreads=0 loads all chunks on demand.
+    const size_t prefetchThreads = readerConfig(L"prefetchThreads", (size_t)2);
+    m_prefetchChunks = readerConfig(L"prefetchChunks", prefetchThreads);
+    m_prefetchBytes = readerConfig(L"prefetchBytes", (size_t)0);
+    m_prefetcher.reset();
+    if (prefetchThreads > 0 && m_prefetchChunks > 0)
+    {
+        m_prefetcher.reset(new ChunkPrefetcher(m_deserializer, prefetchThreads));
+    }
+
+    // Chunks that leave the randomization window are kept up to 'chunkCacheBytes' bytes (estimated as above),
+    // so that corpora that partially fit into memory are not loaded again in every sweep.
+    m_chunkCacheBytes = readerConfig(L"chunkCacheBytes", (size_t)0);
 }
 
 void BlockRandomizer::StartEpoch(const EpochConfiguration& config)
@@ -342,10 +439,16 @@ void BlockRandomizer::StartEpoch(const EpochConfiguration& config)
     m_workerRank = config.m_workerRank;
     m_numberOfWorkers = config.m_numberOfWorkers;
 
+    if (m_distributionMode == DistributionMode::local_chunks &&
+        (m_timelineWorkerRank != m_workerRank || m_timelineNumberOfWorkers != m_numberOfWorkers))
+    {
+        BuildChunkInformation(m_workerRank, m_numberOfWorkers);
+    }
+
     // eldak: check partial minibatches.
     if (config.m_totalEpochSizeInSamples == requestDataSize)
     {
-        m_epochSize = m_numSamples;
+        m_epochSize = m_totalNumberOfSamples;
     }
     else
     {
@@ -355,17 +458,96 @@ void BlockRandomizer::StartEpoch(const EpochConfiguration& config)
     // TODO add some asserts on EpochConfiguration
     m_samplePositionInEpoch = 0;
     size_t timeframe = m_epochSize * config.m_epochIndex;
+    if (m_distributionMode == DistributionMode::local_chunks)
+    {
+        // Position in the local chunks: the stride of this worker of all previous epochs.
+        timeframe = timeframe * (m_workerRank + 1) / m_numberOfWorkers - timeframe * m_workerRank / m_numberOfWorkers;
+    }
     assert(m_frameMode); // TODO !m_frameMode needs fixes
     assert(timeframe != SIZE_MAX); // used as special value for init
     RandomizeForGlobalSamplePosition(timeframe);
+    PrefetchUpcomingChunks();
 };
 
+// Tells the prefetcher about the chunks needed next: those of the current randomization window that are not
+// loaded yet, followed by the chunks that enter the window as the cursor moves on, in that order.
+// The chunks of the next sweep are not known before it is randomized.
+void BlockRandomizer::PrefetchUpcomingChunks()
+{
+    if (!m_prefetcher)
+    {
+        return;
+    }
+
+    std::vector<size_t> upcomingChunks;
+    if (m_sequencePositionInSweep < m_numSequences)
+    {
+        const size_t windowBegin = m_randomizedChunks[GetChunkIndexForSequencePosition(m_sequencePositionInSweep)].m_windowBegin;
+        size_t upcomingBytes = 0;
+        for (size_t chunk = windowBegin; chunk < m_numChunks && upcomingChunks.size() < m_prefetchChunks; chunk++)
+        {
+            if (m_distributionMode == DistributionMode::chunk_modulus && (chunk % m_numberOfWorkers) != m_workerRank)
+                continue;
+
+            const size_t originalChunkIndex = m_chunkIds[m_randomizedChunks[chunk].m_originalChunkIndex];
+            if (m_chunks.find(originalChunkIndex) != m_chunks.end() ||
+                m_cachedChunks.find(m_randomizedChunks[chunk].m_originalChunkIndex) != m_cachedChunks.end())
+                continue;
+
+            // always allow one chunk, even if it is larger than the limit
+            upcomingBytes += m_bytesPerSample * (m_randomizedChunks[chunk + 1].m_info.m_samplePositionStart - m_randomizedChunks[chunk].m_info.m_samplePositionStart);
+            if (m_prefetchBytes > 0 && !upcomingChunks.empty() && upcomingBytes > m_prefetchBytes)
+                break;
+
+            upcomingChunks.push_back(originalChunkIndex);
+        }
+    }
+    m_prefetcher->Prefetch(upcomingChunks);
+}
+
+size_t BlockRandomizer::GetChunkSizeInBytes(size_t chunkIndex) const
+{
+    return m_bytesPerSample * (m_chunkInformation[chunkIndex + 1].m_samplePositionStart - m_chunkInformation[chunkIndex].m_samplePositionStart);
+}
+
+// The randomization of the next sweep is known, so the cache can evict the chunk that is needed last:
+// a chunk that is still ahead of the window in the current sweep is needed at its position in it,
+// any other chunk only at its position in the next sweep.
+void BlockRandomizer::CacheChunk(size_t chunkIndex, const ChunkPtr& chunk)
+{
+    const size_t windowBegin = m_sequencePositionInSweep < m_numSequences ?
+        m_randomizedChunks[GetChunkIndexForSequencePosition(m_sequencePositionInSweep)].m_windowBegin :
+        m_numChunks;
+    auto nextUse = [&](size_t index)
+    {
+        const size_t position = m_chunkPositionInSweep[index];
+        return position >= windowBegin ? position : m_numChunks + m_chunkPositionInNextSweep[index];
+    };
+
+    m_cachedChunks[chunkIndex] = chunk;
+    m_cachedBytes += GetChunkSizeInBytes(chunkIndex);
+    while (m_cachedBytes > m_chunkCacheBytes && !m_cachedChunks.empty())
+    {
+        auto evicted = m_cachedChunks.begin();
+        for (auto candidate = m_cachedChunks.begin(); candidate != m_cachedChunks.end(); ++candidate)
+        {
+            if (nextUse(candidate->first) > nextUse(evicted->first))
+                evicted = candidate;
+        }
+
+        m_cachedBytes -= GetChunkSizeInBytes(evicted->first);
+        m_cachedChunks.erase(evicted);
+    }
+}
+
 bool BlockRandomizer::GetNextSequenceIds(size_t sampleCount, std::vector<size_t>& originalIds, std::unordered_set<size_t>& originalChunks)
 {
     assert(m_frameMode); // TODO !m_frameMode not implemented yet
     assert(originalIds.size() == 0);
     assert(originalChunks.size() == 0);
-    assert(sampleCount <= m_numSamples);
+    assert(m_distributionMode == DistributionMode::local_chunks || sampleCount <= m_numSamples);
+
+    const auto& timeline = GetTimeline();
 
     if (m_samplePositionInEpoch < m_epochSize)
     {
@@ -383,13 +565,13 @@ bool BlockRandomizer::GetNextSequenceIds(size_t sampleCount, std::vector<size_t>
                     break;
                 }
 
-                const auto& seqDesc = m_randomTimeline[m_sequencePositionInSweep];
-                if ((seqDesc.m_chunkId % m_numberOfWorkers) == m_workerRank)
+                const auto& seqDesc = *timeline[GetTimelineIndex(m_randomTimeline[m_sequencePositionInSweep])];
+                if ((m_randomTimeline[m_sequencePositionInSweep].m_chunkId % m_numberOfWorkers) == m_workerRank)
                 {
                     // Got one, collect it (and its window of chunks)
                     originalIds.push_back(seqDesc.m_id);
 
-                    const auto & currentChunk = m_randomizedChunks[GetChunkIndexForSequencePosition(seqDesc.m_id)];
+                    const auto & currentChunk = m_randomizedChunks[GetChunkIndexForSequencePosition(m_sequencePositionInSweep)];
                     const size_t windowBegin = currentChunk.m_windowBegin;
                     const size_t windowEnd = currentChunk.m_windowEnd;
 
@@ -397,7 +579,7 @@ bool BlockRandomizer::GetNextSequenceIds(size_t sampleCount, std::vector<size_t>
                     {
                         if ((chunk % m_numberOfWorkers) == m_workerRank)
                         {
-                            originalChunks.insert(m_randomizedChunks[chunk].m_originalChunkIndex);
+                            originalChunks.insert(m_chunkIds[m_randomizedChunks[chunk].m_originalChunkIndex]);
                         }
                     }
                 }
@@ -407,6 +589,29 @@ bool BlockRandomizer::GetNextSequenceIds(size_t sampleCount, std::vector<size_t>
                 distributedSampleCount++;
             }
         }
+        else if (m_distributionMode == DistributionMode::local_chunks)
+        {
+            // All workers advance by the same number of samples, so that they agree on the end of the epoch,
+            // but every worker takes only its stride of them, from its own chunks.
+            size_t nextSamplePositionInEpoch = std::min(m_epochSize, m_samplePositionInEpoch + sampleCount);
+            size_t distributedSampleCount = nextSamplePositionInEpoch - m_samplePositionInEpoch;
+            size_t localSampleCount = distributedSampleCount * (m_workerRank + 1) / m_numberOfWorkers -
+                                      distributedSampleCount * m_workerRank / m_numberOfWorkers;
+
+            for (size_t i = 0; i < localSampleCount; ++i, ++m_sequencePositionInSweep)
+            {
+                RandomizeIfNewSweepIsEntered();
+                const auto& seqDesc = *timeline[GetTimelineIndex(m_randomTimeline[m_sequencePositionInSweep])];
+                originalIds.push_back(seqDesc.m_id);
+
+                const auto & currentChunk = m_randomizedChunks[GetChunkIndexForSequencePosition(m_sequencePositionInSweep)];
+                for (size_t chunk = currentChunk.m_windowBegin; chunk < currentChunk.m_windowEnd; chunk++)
+                {
+                    originalChunks.insert(m_chunkIds[m_randomizedChunks[chunk].m_originalChunkIndex]);
+                }
+            }
+            m_samplePositionInEpoch = nextSamplePositionInEpoch;
+        }
         else
         {
             assert(m_distributionMode == DistributionMode::sequences_strides);
@@ -421,7 +626,7 @@ bool BlockRandomizer::GetNextSequenceIds(size_t sampleCount, std::vector<size_t>
                 RandomizeIfNewSweepIsEntered(); // TODO return value ignored here?
                 if (strideBegin <= i && i < strideEnd)
                 {
-                    const auto& seqDesc = m_randomTimeline[m_sequencePositionInSweep];
+                    const auto& seqDesc = *timeline[GetTimelineIndex(m_randomTimeline[m_sequencePositionInSweep])];
                     originalIds.push_back(seqDesc.m_id);
 
                     const auto & currentChunk = m_randomizedChunks[GetChunkIndexForSequencePosition(m_sequencePositionInSweep)];
@@ -430,7 +635,7 @@ bool BlockRandomizer::GetNextSequenceIds(size_t sampleCount, std::vector<size_t>
 
                     for (size_t chunk = windowBegin; chunk < windowEnd; chunk++)
                     {
-                        originalChunks.insert(m_randomizedChunks[chunk].m_originalChunkIndex);
+                        originalChunks.insert(m_chunkIds[m_randomizedChunks[chunk].m_originalChunkIndex]);
                     }
                 }
             }
@@ -458,21 +663,50 @@ Sequences BlockRandomizer::GetNextSequences(size_t sampleCount)
     }
 
     // Require and release chunks from the data deserializer
-    for (size_t originalChunkIndex = 0; originalChunkIndex < m_numChunks; originalChunkIndex++)
+    for (size_t chunkIndex = 0; chunkIndex < m_numChunks; chunkIndex++)
     {
+        const size_t originalChunkIndex = m_chunkIds[chunkIndex];
         if (originalChunks.find(originalChunkIndex) != originalChunks.end())
         {
             if (m_chunks.find(originalChunkIndex) == m_chunks.end())
             {
-                m_chunks[originalChunkIndex] = m_deserializer->GetChunk(originalChunkIndex);
+                auto cached = m_cachedChunks.find(chunkIndex);
+                if (cached != m_cachedChunks.end())
+                {
+                    AddPipelineChunk(true);
+                    m_chunks[originalChunkIndex] = cached->second;
+                    m_cachedBytes -= GetChunkSizeInBytes(chunkIndex);
+                    m_cachedChunks.erase(cached);
+                }
+                else if (m_prefetcher)
+                {
+                    m_chunks[originalChunkIndex] = m_prefetcher->GetChunk(originalChunkIndex);
+                }
+                else
+                {
+                    AddPipelineChunk(false);
+                    PipelineStageTimer timer(PipelineStage::chunkLoad);
+                    m_chunks[originalChunkIndex] = m_deserializer->GetChunk(originalChunkIndex);
+                }
             }
         }
         else
         {
-            m_chunks.erase(originalChunkIndex);
+            auto released = m_chunks.find(originalChunkIndex);
+            if (released != m_chunks.end())
+            {
+                if (m_chunkCacheBytes > 0)
+                {
+                    CacheChunk(chunkIndex, released->second);
+                }
+                m_chunks.erase(released);
+            }
         }
     }
 
+    // Start loading what the following calls will need, while the sequences of this call are processed
+    PrefetchUpcomingChunks();
+
     const auto& originalTimeline = m_deserializer->GetSequenceDescriptions();
     result.m_data.resize(m_streams.size(), std::vector<SequenceDataPtr>(originalIds.size()));
 
@@ -10,6 +10,7 @@
 
 #include "Transformer.h"
 #include "DataDeserializer.h"
+#include "ChunkPrefetcher.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -23,7 +24,11 @@ class BlockRandomizer : public Transformer
 public:
     enum class DistributionMode {
         chunk_modulus,
-        sequences_strides
+        sequences_strides,
+        // Every worker owns the chunks whose index modulo the number of workers is its rank, and only keeps
+        // the information on those chunks and their sequences. The chunks of a worker are randomized locally,
+        // with the sweep as seed, and every worker delivers its stride of each minibatch from them.
+        local_chunks
     };
 
     BlockRandomizer(int verbosity,
@@ -57,7 +62,7 @@ private:
     {
         struct ChunkInformation m_info; // sample positions are global // TODO could drop 'global' requirement?
 
-        size_t m_originalChunkIndex;
+        size_t m_originalChunkIndex; // index into m_chunkInformation
 
         // Randomization range (in randomized chunk positions; right-side open)
         size_t m_windowBegin;
@@ -71,12 +76,18 @@ private:
     DistributionMode m_distributionMode;
 
     // Deserializer and information on the original timeline
+    // (with DistributionMode::local_chunks only on the chunks of the worker the information was built for)
     IDataDeserializerPtr m_deserializer;
     size_t m_numSequences;
     size_t m_numChunks;
     size_t m_numSamples;
+    size_t m_totalNumberOfSamples;                    // of the whole corpus, also with local chunks
     bool m_frameMode;                                 // true iff only single-sample sequences
     std::vector<ChunkInformation> m_chunkInformation; // (includes a sentinel)
+    std::vector<size_t> m_chunkIds;                   // deserializer chunk id of each entry of m_chunkInformation
+    SequenceDescriptions m_localTimeline;             // sequences of the local chunks (DistributionMode::local_chunks only)
+    size_t m_timelineWorkerRank;
+    size_t m_timelineNumberOfWorkers;
 
     // Per-epoch configuration
     size_t m_workerRank;
@@ -89,24 +100,56 @@ private:
     size_t m_sweepStartInSamples; // TODO do we need it?
     size_t m_sequencePositionInSweep;
     std::vector<RandomizedChunk> m_randomizedChunks;    // (includes a sentinel)
-    // TODO optimize footprint:
-    //      (do not require full timeline, i.e., Amit's change in original HTKMLFReader)
-    //      (instead of SequenceDescription, use something smaller)
-    std::vector<SequenceDescription> m_randomTimeline;
+
+    // Compact entry of the randomized timeline: in frame mode there is one per frame, so
+    // instead of copying the full SequenceDescription (with its key) we only keep the
+    // randomized chunk the sequence belongs to and its position inside that chunk
+    // (see GetTimelineIndex()), which both fit 32 bits however large the corpus is.
+    struct RandomizedSequence
+    {
+        uint32_t m_indexInChunk;
+        uint32_t m_chunkId;
+    };
+    std::vector<RandomizedSequence> m_randomTimeline;
     std::vector<StreamDescriptionPtr> m_streams;
 
     // Chunks that we currently hold a pointer to
     std::map<size_t, ChunkPtr> m_chunks; // TODO vector? or unordered_map
 
+    // Loading of the chunks that enter the randomization window next, ahead of the cursor (null if disabled)
+    ChunkPrefetcherPtr m_prefetcher;
+    size_t m_prefetchChunks;     // maximum number of chunks loaded ahead
+    size_t m_prefetchBytes;      // maximum estimated size of the chunks loaded ahead, 0 for no limit
+    size_t m_bytesPerSample;     // estimated size of a sample in memory, summed over all streams
+
+    // Chunks that left the randomization window, kept so that later sweeps do not load them again
+    std::map<size_t, ChunkPtr> m_cachedChunks;      // by index into m_chunkInformation
+    size_t m_chunkCacheBytes;                       // maximum estimated size of the cached chunks, 0 disables the cache
+    size_t m_cachedBytes;                           // estimated size of the cached chunks
+    std::vector<size_t> m_chunkPositionInSweep;     // randomized position of each chunk in the current sweep
+    std::vector<size_t> m_chunkPositionInNextSweep; // and in the next one
+
     // Check that timeline has only valid sequences of non-zero length
     // with incrementing IDs and non-decreasing chunk identifiers.
     bool TimelineIsValidForRandomization(const SequenceDescriptions& timeline) const;
 
+    // Builds the chunk information, with DistributionMode::local_chunks only for the chunks of the given worker.
+    void BuildChunkInformation(size_t workerRank, size_t numberOfWorkers);
+
+    // The timeline m_chunkInformation refers to, indexed by sequence position.
+    const SequenceDescriptions& GetTimeline() const;
+
+    // The chunk indices (into m_chunkInformation) in the randomized order of the given sweep.
+    std::vector<size_t> GetRandomizedChunkIndices(size_t sweep) const;
+
     void RandomizeChunks();
 
     size_t GetChunkIndexForSequencePosition(size_t sequencePosition) const;
 
-    bool IsValidForPosition(size_t targetPosition, const SequenceDescription& seqDesc) const;
+    bool IsValidForPosition(size_t targetPosition, const RandomizedSequence& sequence) const;
+
+    // The position of a randomized sequence in GetTimeline().
+    size_t GetTimelineIndex(const RandomizedSequence& sequence) const;
 
     void Randomize();
 
@@ -115,6 +158,13 @@ private:
     bool RandomizeIfNewSweepIsEntered();
 
     bool GetNextSequenceIds(size_t sampleCount, std::vector<size_t>& originalIds, std::unordered_set<size_t>& originalChunks);
+
+    void PrefetchUpcomingChunks();
+
+    size_t GetChunkSizeInBytes(size_t chunkIndex) const;
+
+    // Keeps a chunk that left the randomization window, evicting the cached chunks that are needed last.
+    void CacheChunk(size_t chunkIndex, const ChunkPtr& chunk);
 };
 
 }}}
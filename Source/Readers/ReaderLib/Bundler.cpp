@@ -14,19 +14,37 @@ Bundler::Bundler(
     std::vector<IDataDeserializerPtr> deserializers)
     : m_deserializers(deserializers), m_driver(driver)
 {
-    UNUSED(readerConfig);
     std::vector<StreamDescriptionPtr> streams;
     for (auto d : deserializers)
     {
+        bool isLazy = false;
         for (auto i : d->GetStreamDescriptions())
         {
             StreamDescriptionPtr stream = std::make_shared<StreamDescription>(*i);
             stream->m_id = streams.size();
             streams.push_back(stream);
+
+            std::string name = msra::strfun::utf8(i->m_name);
+            if (readerConfig.Exists(name) && ConfigParameters(readerConfig(name))(L"lazyLoading", false))
+            {
+                isLazy = true;
+            }
         }
+
+        if (isLazy)
+        {
+            // The chunks of the driver define the chunks of the bundler.
+            if (d == driver)
+            {
+                InvalidArgument("Bundler: the streams of the driving deserializer cannot be loaded lazily.");
+            }
+            fprintf(stderr, "Bundler: chunks of deserializer %d are loaded lazily.\n", (int)m_isLazy.size());
+        }
+        m_isLazy.push_back(isLazy);
     }
 
     m_streams = streams;
+    m_lazyChunks.resize(m_deserializers.size());
     CreateSequenceDescriptions();
 }
 
@@ -128,6 +146,11 @@ public:
             m_innerChunks[innerIndex].resize(m_parent->m_deserializers.size());
             for (size_t i = 0; i < m_parent->m_deserializers.size(); ++i)
             {
+                if (m_parent->m_isLazy[i])
+                {
+                    continue;
+                }
+
                 size_t innerChunkId = m_parent->m_sequenceToChunk[i][sequenceId];
                 m_innerChunks[innerIndex][i] = m_parent->m_deserializers[i]->GetChunk(innerChunkId);
             }
@@ -144,7 +167,23 @@ public:
         for (int i = 0; i < chunks.size(); ++i)
         {
             size_t originalSequenceId = m_parent->m_sequenceToSequence[i][sequenceId];
-            auto sequences = chunks[i]->GetSequence(originalSequenceId);
+            if (!m_parent->m_isLazy[i])
+            {
+                auto sequences = chunks[i]->GetSequence(originalSequenceId);
+                result.insert(result.end(), sequences.begin(), sequences.end());
+                continue;
+            }
+
+            // The sequence data keeps the lazily loaded chunk alive for as long as it is used.
+            auto chunk = m_parent->GetLazyChunk(i, m_parent->m_sequenceToChunk[i][sequenceId]);
+            auto sequences = chunk->GetSequence(originalSequenceId);
+            for (auto& sequence : sequences)
+            {
+                if (sequence->m_chunk == nullptr)
+                {
+                    sequence->m_chunk = chunk;
+                }
+            }
             result.insert(result.end(), sequences.begin(), sequences.end());
         }
 
@@ -157,6 +196,71 @@ ChunkPtr Bundler::GetChunk(size_t chunkId)
     return std::make_shared<BundlingChunk>(m_streams.size(), this, chunkId);
 }
 
+// Sequences are retrieved in parallel, so loading happens outside of the lock. The first sequence that needs a chunk
+// publishes a future for it under the lock and loads it; the other sequences that need it in the meantime wait for that future.
+ChunkPtr Bundler::GetLazyChunk(size_t deserializerIndex, size_t chunkId)
+{
+    auto& chunks = m_lazyChunks[deserializerIndex];
+    std::promise<ChunkPtr> loaded;
+    {
+        std::unique_lock<std::mutex> lock(m_lazyChunksLock);
+        auto& entry = chunks[chunkId];
+        ChunkPtr chunk = entry.m_chunk.lock();
+        if (chunk != nullptr)
+        {
+            return chunk;
+        }
+
+        if (entry.m_loading.valid())
+        {
+            std::shared_future<ChunkPtr> loading = entry.m_loading;
+            lock.unlock();
+            return loading.get();
+        }
+
+        entry.m_loading = loaded.get_future().share();
+    }
+
+    ChunkPtr chunk;
+    try
+    {
+        chunk = m_deserializers[deserializerIndex]->GetChunk(chunkId);
+    }
+    catch (...)
+    {
+        // The waiting sequences fail as well; the next request tries again.
+        {
+            std::lock_guard<std::mutex> lock(m_lazyChunksLock);
+            chunks[chunkId].m_loading = std::shared_future<ChunkPtr>();
+        }
+        loaded.set_exception(std::current_exception());
+        throw;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_lazyChunksLock);
+        // The future is dropped, so that only the sequence data keeps the chunk alive.
+        auto& entry = chunks[chunkId];
+        entry.m_chunk = chunk;
+        entry.m_loading = std::shared_future<ChunkPtr>();
+
+        // Forget the chunks that have been released.
+        for (auto i = chunks.begin(); i != chunks.end();)
+        {
+            if (i->second.m_chunk.expired() && !i->second.m_loading.valid())
+            {
+                i = chunks.erase(i);
+            }
+            else
+            {
+                ++i;
+            }
+        }
+    }
+    loaded.set_value(chunk);
+    return chunk;
+}
+
 const SequenceDescriptions& Bundler::GetSequenceDescriptions() const
 {
     return m_sequences;
@@ -5,6 +5,9 @@
 
 #pragma once
 
+#include <future>
+#include <map>
+#include <mutex>
 #include "DataDeserializer.h"
 #include "Config.h"
 
@@ -13,6 +16,10 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 // Class represents an bundler of several deserializers.
 // In case when only a single deserializer is used, the bundler can be omitted and 
 // no performance penalty is paid.
+// Streams whose configuration section sets lazyLoading=true are loaded lazily: the chunk of such a deserializer
+// is only retrieved when a sequence of it is requested, and it is released with the last sequence data
+// that uses it, independently of the chunks of the other deserializers.
+// This saves memory for big auxiliary streams (e.g. lattices), at the cost of reloading chunks that are needed again.
 // TODO: The interface will changed when the timeline will support chunking.
 class Bundler : public IDataDeserializer
 {
@@ -40,6 +47,9 @@ private:
 
     void CreateSequenceDescriptions();
 
+    // Gets a chunk of a lazily loaded deserializer, sharing it while it is used by any sequence.
+    ChunkPtr GetLazyChunk(size_t deserializerIndex, size_t chunkId);
+
     // Exposed bundled streams.
     std::vector<StreamDescriptionPtr> m_streams;
     // Underlying deserializers.
@@ -61,6 +71,19 @@ private:
     // the sequence in m_sequenceDescription where the chunk starts.
     std::vector<size_t> m_chunkOffsets;
 
+    // A lazily loaded chunk: while it is being loaded, the sequences that need it wait for 'm_loading',
+    // so that every chunk is only requested once from its deserializer at a time.
+    struct LazyChunk
+    {
+        std::weak_ptr<Chunk> m_chunk;
+        std::shared_future<ChunkPtr> m_loading;
+    };
+
+    // Whether the chunks of a deserializer are loaded lazily, and its currently loaded chunks.
+    std::vector<bool> m_isLazy;
+    std::vector<std::map<size_t, LazyChunk>> m_lazyChunks;
+    std::mutex m_lazyChunksLock;
+
     friend class BundlingChunk;
 };
 
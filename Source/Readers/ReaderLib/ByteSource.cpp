@@ -0,0 +1,186 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <functional>
+#include <random>
+#include "ByteSource.h"
+#include "fileutil.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+FileByteSource::FileByteSource(const std::wstring& path, bool direct)
+    : m_path(path), m_direct(direct)
+{
+}
+
+void FileByteSource::Read(size_t offset, size_t size, char* buffer)
+{
+    freadBlocksOrDie(m_path, offset, size, buffer, m_direct);
+}
+
+static void ReplaceAll(std::wstring& s, const std::wstring& placeholder, const std::wstring& value)
+{
+    for (size_t pos = s.find(placeholder); pos != std::wstring::npos; pos = s.find(placeholder, pos + value.size()))
+    {
+        s.replace(pos, placeholder.size(), value);
+    }
+}
+
+CommandByteSource::CommandByteSource(const std::wstring& url, const std::wstring& command, size_t retries)
+    : m_url(url), m_command(command), m_retries(retries)
+{
+    if (m_command.find(L"{url}") == std::wstring::npos || m_command.find(L"{first}") == std::wstring::npos || m_command.find(L"{last}") == std::wstring::npos)
+    {
+        InvalidArgument("CommandByteSource: the range read command '%ls' must contain {url}, {first} and {last}.", command.c_str());
+    }
+}
+
+void CommandByteSource::Read(size_t offset, size_t size, char* buffer)
+{
+    if (size == 0)
+    {
+        return;
+    }
+
+    std::wstring command = m_command;
+    ReplaceAll(command, L"{url}", m_url);
+    ReplaceAll(command, L"{first}", std::to_wstring(offset));
+    ReplaceAll(command, L"{last}", std::to_wstring(offset + size - 1));
+
+    for (size_t attempt = 0; attempt <= m_retries; ++attempt)
+    {
+        if (TryRead(command, size, buffer))
+        {
+            return;
+        }
+        fprintf(stderr, "CommandByteSource: reading %d bytes at %llu of '%ls' failed (attempt %d of %d).\n",
+                (int)size, (unsigned long long)offset, m_url.c_str(), (int)attempt + 1, (int)m_retries + 1);
+    }
+
+    RuntimeError("CommandByteSource: cannot read %d bytes at %llu of '%ls' with the command '%ls'.",
+                 (int)size, (unsigned long long)offset, m_url.c_str(), command.c_str());
+}
+
+bool CommandByteSource::TryRead(const std::wstring& command, size_t size, char* buffer)
+{
+#ifdef _WIN32
+    FILE* pipe = _wpopen(command.c_str(), L"rb");
+#else
+    // popen() does not accept 'b', streams are always binary.
+    FILE* pipe = _wpopen(command.c_str(), L"r");
+#endif
+    if (pipe == nullptr)
+    {
+        return false;
+    }
+
+    size_t read = fread(buffer, 1, size, pipe);
+    // The command must not produce more than requested, e.g. if the server ignored the range.
+    bool complete = read == size && fgetc(pipe) == EOF;
+    int status = _pclose(pipe);
+    return complete && status == 0;
+}
+
+CachingByteSource::CachingByteSource(ByteSourcePtr source, const std::wstring& directory, size_t capacity)
+    : m_source(source), m_directory(directory), m_capacity(capacity), m_storedBytes(0)
+{
+    if (m_directory.empty())
+    {
+        InvalidArgument("CachingByteSource: no cache directory given.");
+    }
+    if (m_directory.back() != L'/' && m_directory.back() != L'\\')
+    {
+        m_directory += L'/';
+    }
+    msra::files::make_intermediate_dirs(m_directory);
+
+    // Sources with different names must not share cache files.
+    m_prefix = std::to_wstring(std::hash<std::wstring>()(source->GetName()));
+}
+
+std::wstring CachingByteSource::GetCachePath(size_t offset, size_t size) const
+{
+    return m_directory + m_prefix + L"." + std::to_wstring(offset) + L"." + std::to_wstring(size);
+}
+
+void CachingByteSource::Read(size_t offset, size_t size, char* buffer)
+{
+    const std::wstring path = GetCachePath(offset, size);
+    if (fexists(path))
+    {
+        FileByteSource(path).Read(0, size, buffer);
+        return;
+    }
+
+    m_source->Read(offset, size, buffer);
+
+    if (m_storedBytes.fetch_add(size) + size > m_capacity)
+    {
+        m_storedBytes -= size;
+        return;
+    }
+
+    // Failing to store a range only costs a later fetch, so errors are reported but not thrown.
+    std::wstring temporaryPath = path + L".tmp" + std::to_wstring(std::random_device()());
+    try
+    {
+        FILE* f = fopenOrDie(temporaryPath, L"wb");
+        try
+        {
+            fwriteOrDie(buffer, 1, size, f);
+        }
+        catch (...)
+        {
+            fclose(f);
+            throw;
+        }
+        fcloseOrDie(f);
+
+        // Another reader may have stored the same range meanwhile.
+        if (fexists(path))
+        {
+            unlinkOrDie(temporaryPath);
+        }
+        else
+        {
+            renameOrDie(temporaryPath, path);
+        }
+    }
+    catch (const std::exception& e)
+    {
+        fprintf(stderr, "CachingByteSource: cannot store a range of '%ls' in '%ls': %s\n", GetName().c_str(), m_directory.c_str(), e.what());
+        m_storedBytes -= size;
+        if (fexists(temporaryPath))
+        {
+            _wunlink(temporaryPath.c_str());
+        }
+    }
+}
+
+ByteSourcePtr CreateByteSource(const std::wstring& path, const ConfigParameters& config)
+{
+    ByteSourcePtr source;
+    if (config.Exists(L"rangeReadCommand"))
+    {
+        std::wstring command = config(L"rangeReadCommand");
+        source = std::make_shared<CommandByteSource>(path, command, config(L"rangeReadRetries", (size_t)3));
+    }
+    else
+    {
+        source = std::make_shared<FileByteSource>(path, config(L"directIO", false));
+    }
+
+    if (config.Exists(L"localCacheDir"))
+    {
+        std::wstring directory = config(L"localCacheDir");
+        size_t capacityMB = config(L"localCacheSizeMB", (size_t)0);
+        size_t capacity = capacityMB == 0 ? SIZE_MAX : capacityMB * 1024 * 1024;
+        source = std::make_shared<CachingByteSource>(source, directory, capacity);
+    }
+    return source;
+}
+} } }
@@ -0,0 +1,110 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include <string>
+#include <memory>
+#include <atomic>
+#include "Basics.h"
+#include "Config.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Read-only, random-access source of bytes underneath a deserializer.
+// Deserializers that read whole chunks with a single ranged read can work on any source,
+// be it a local file, remote object storage or a local cache of either.
+class ByteSource
+{
+public:
+    virtual ~ByteSource() {}
+
+    // Reads exactly 'size' bytes at 'offset' into 'buffer', or throws.
+    // Can be called concurrently; the randomizer prefetches several chunks at a time.
+    virtual void Read(size_t offset, size_t size, char* buffer) = 0;
+
+    // Name of the source, for messages and for keying the local cache.
+    virtual const std::wstring& GetName() const = 0;
+};
+
+typedef std::shared_ptr<ByteSource> ByteSourcePtr;
+
+// A local (or network-mounted) file. Every read goes through its own file handle and is
+// issued as concurrent large block reads (see freadBlocksOrDie()); with 'direct' the OS file cache is bypassed.
+class FileByteSource : public ByteSource
+{
+public:
+    explicit FileByteSource(const std::wstring& path, bool direct = false);
+
+    virtual void Read(size_t offset, size_t size, char* buffer) override;
+    virtual const std::wstring& GetName() const override
+    {
+        return m_path;
+    }
+
+private:
+    std::wstring m_path;
+    bool m_direct;
+};
+
+// Range reads through an external command, e.g. for HTTP object storage:
+//     rangeReadCommand = "curl -sfL -r {first}-{last} \"{url}\""
+// {url} is replaced by the source name, {first} and {last} by the inclusive byte range.
+// The command has to write exactly the requested bytes to its standard output and exit with 0.
+// Failed reads are retried up to 'retries' times.
+class CommandByteSource : public ByteSource
+{
+public:
+    CommandByteSource(const std::wstring& url, const std::wstring& command, size_t retries);
+
+    virtual void Read(size_t offset, size_t size, char* buffer) override;
+    virtual const std::wstring& GetName() const override
+    {
+        return m_url;
+    }
+
+private:
+    bool TryRead(const std::wstring& command, size_t size, char* buffer);
+
+    std::wstring m_url;
+    std::wstring m_command;
+    size_t m_retries;
+};
+
+// Keeps the ranges read from another source as files in a local directory (usually on local SSD),
+// so that later epochs and later jobs on the same machine do not fetch them again.
+// Files are written under a temporary name and renamed, so concurrent readers, also from other
+// processes, never see partial data. Once 'capacity' bytes were written by this process, further
+// ranges are read through without being stored; nothing is ever evicted.
+class CachingByteSource : public ByteSource
+{
+public:
+    CachingByteSource(ByteSourcePtr source, const std::wstring& directory, size_t capacity);
+
+    virtual void Read(size_t offset, size_t size, char* buffer) override;
+    virtual const std::wstring& GetName() const override
+    {
+        return m_source->GetName();
+    }
+
+    // File that holds the given range once it was read.
+    std::wstring GetCachePath(size_t offset, size_t size) const;
+
+private:
+    ByteSourcePtr m_source;
+    std::wstring m_directory;
+    std::wstring m_prefix;
+    size_t m_capacity;
+    std::atomic<size_t> m_storedBytes;
+};
+
+// Creates the byte source for 'path' as configured in the reader section:
+//     directIO         - read the file without the OS file cache (default false),
+//     rangeReadCommand - read through CommandByteSource instead of opening 'path' as a file,
+//     rangeReadRetries - number of retries of a failed command (default 3),
+//     localCacheDir    - cache the ranges read in this directory,
+//     localCacheSizeMB - how much this process may write to the cache (default unlimited).
+ByteSourcePtr CreateByteSource(const std::wstring& path, const ConfigParameters& config);
+} } }
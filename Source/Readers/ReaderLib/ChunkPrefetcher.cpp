@@ -0,0 +1,164 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "ChunkPrefetcher.h"
+#include "PipelineStatistics.h"
+#include "HostMemoryPlacement.h"
+#include <algorithm>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+ChunkPrefetcher::ChunkPrefetcher(IDataDeserializerPtr deserializer, size_t numberOfThreads)
+    : m_deserializer(deserializer), m_stop(false)
+{
+    assert(deserializer != nullptr);
+    assert(numberOfThreads > 0);
+    for (size_t i = 0; i < numberOfThreads; i++)
+    {
+        m_workers.push_back(std::thread([this]() { RunWorker(); }));
+    }
+}
+
+ChunkPrefetcher::~ChunkPrefetcher()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_workAvailable.notify_all();
+    for (auto& worker : m_workers)
+    {
+        worker.join();
+    }
+}
+
+std::map<size_t, ChunkPrefetcher::PrefetchedChunk>::iterator ChunkPrefetcher::FindQueuedChunk()
+{
+    for (size_t chunkId : m_order)
+    {
+        auto entry = m_entries.find(chunkId);
+        if (entry != m_entries.end() && entry->second.m_state == ChunkState::queued)
+        {
+            return entry;
+        }
+    }
+    return m_entries.end();
+}
+
+void ChunkPrefetcher::RunWorker()
+{
+    // the loaded chunks are first touched here
+    HostMemoryPlacement::BindCurrentThread();
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    for (;;)
+    {
+        m_workAvailable.wait(lock, [this]() { return m_stop || FindQueuedChunk() != m_entries.end(); });
+        if (m_stop)
+        {
+            return;
+        }
+
+        // Entries that are being loaded are never erased, so the iterator stays valid while unlocked.
+        auto entry = FindQueuedChunk();
+        entry->second.m_state = ChunkState::loading;
+        const size_t chunkId = entry->first;
+
+        lock.unlock();
+        ChunkPtr chunk;
+        std::exception_ptr error;
+        try
+        {
+            PipelineStageTimer timer(PipelineStage::chunkLoad);
+            chunk = m_deserializer->GetChunk(chunkId);
+        }
+        catch (...)
+        {
+            error = std::current_exception();
+        }
+        lock.lock();
+
+        // Hand the only reference over to the entry, so that the chunk is not released on this thread.
+        entry->second.m_chunk = std::move(chunk);
+        entry->second.m_error = error;
+        entry->second.m_state = ChunkState::loaded;
+        m_chunkLoaded.notify_all();
+    }
+}
+
+void ChunkPrefetcher::Prefetch(const std::vector<size_t>& chunkIds)
+{
+    std::vector<ChunkPtr> released;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (auto& entry : m_entries)
+        {
+            entry.second.m_isWanted = false;
+        }
+
+        for (size_t chunkId : chunkIds)
+        {
+            auto entry = m_entries.find(chunkId);
+            if (entry == m_entries.end())
+            {
+                entry = m_entries.insert(std::make_pair(chunkId, PrefetchedChunk{ ChunkState::queued, false, nullptr, nullptr })).first;
+            }
+            entry->second.m_isWanted = true;
+        }
+
+        // Chunks that are not needed anymore are dropped, except those a worker is still busy with.
+        for (auto entry = m_entries.begin(); entry != m_entries.end();)
+        {
+            if (!entry->second.m_isWanted && entry->second.m_state != ChunkState::loading)
+            {
+                released.push_back(std::move(entry->second.m_chunk));
+                entry = m_entries.erase(entry);
+            }
+            else
+            {
+                ++entry;
+            }
+        }
+
+        m_order = chunkIds;
+    }
+    m_workAvailable.notify_all();
+    // 'released' goes out of scope here, outside of the lock
+}
+
+ChunkPtr ChunkPrefetcher::GetChunk(size_t chunkId)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    auto entry = m_entries.find(chunkId);
+    if (entry == m_entries.end() || entry->second.m_state == ChunkState::queued)
+    {
+        // Not started yet; loading it here is faster than waiting for a worker.
+        if (entry != m_entries.end())
+        {
+            m_entries.erase(entry);
+        }
+        lock.unlock();
+        AddPipelineChunk(false);
+        PipelineStageTimer timer(PipelineStage::chunkLoad);
+        return m_deserializer->GetChunk(chunkId);
+    }
+
+    // A chunk that is still being loaded counts as not ready, the randomizer waits for it.
+    AddPipelineChunk(entry->second.m_state == ChunkState::loaded);
+    m_chunkLoaded.wait(lock, [&entry]() { return entry->second.m_state == ChunkState::loaded; });
+    ChunkPtr chunk = std::move(entry->second.m_chunk);
+    std::exception_ptr error = entry->second.m_error;
+    m_entries.erase(entry);
+    lock.unlock();
+
+    if (error)
+    {
+        std::rethrow_exception(error);
+    }
+    return chunk;
+}
+} } }
@@ -0,0 +1,74 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include <vector>
+#include <map>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+
+#include "DataDeserializer.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Loads chunks of a deserializer ahead of time on a pool of worker threads.
+// The randomizer tells which chunks it will need next (Prefetch()), and later takes them over (GetChunk()).
+// Different chunks are loaded in parallel, so the deserializer's GetChunk() must allow concurrent calls for different chunk ids.
+// Chunks are only released on the thread that calls Prefetch() and GetChunk(), never on a worker thread.
+class ChunkPrefetcher
+{
+public:
+    ChunkPrefetcher(IDataDeserializerPtr deserializer, size_t numberOfThreads);
+    ~ChunkPrefetcher();
+
+    // Sets the chunks to load ahead, the most urgent first. This replaces the previous list;
+    // loaded chunks that are not in the list anymore are released.
+    void Prefetch(const std::vector<size_t>& chunkIds);
+
+    // Returns the chunk, waiting for it if it is being loaded, or loading it on the calling thread if it was not started yet.
+    // Afterwards the prefetcher does not hold the chunk anymore.
+    ChunkPtr GetChunk(size_t chunkId);
+
+private:
+    enum class ChunkState
+    {
+        queued,
+        loading,
+        loaded
+    };
+
+    struct PrefetchedChunk
+    {
+        ChunkState m_state;
+        bool m_isWanted;
+        ChunkPtr m_chunk;
+        std::exception_ptr m_error;
+    };
+
+    void RunWorker();
+
+    // Returns the first chunk of m_order that no worker has started, or m_entries.end().
+    std::map<size_t, PrefetchedChunk>::iterator FindQueuedChunk();
+
+    IDataDeserializerPtr m_deserializer;
+
+    std::mutex m_mutex; // protects everything below
+    std::condition_variable m_workAvailable;
+    std::condition_variable m_chunkLoaded;
+    std::map<size_t, PrefetchedChunk> m_entries;
+    std::vector<size_t> m_order; // ids from the last Prefetch() call
+    bool m_stop;
+
+    std::vector<std::thread> m_workers;
+
+    DISABLE_COPY_AND_MOVE(ChunkPrefetcher);
+};
+
+typedef std::unique_ptr<ChunkPrefetcher> ChunkPrefetcherPtr;
+} } }
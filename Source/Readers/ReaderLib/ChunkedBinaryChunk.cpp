@@ -0,0 +1,177 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <algorithm>
+#include "ChunkedBinaryChunk.h"
+#include "ElementTypeUtils.h"
+#include "fileutil.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+void ChunkedBinaryStreamInformation::ReadStreamHeaders(FILE* f, size_t numberOfStreams)
+{
+    ReadStreamHeaders([f](void* buffer, size_t size) { freadOrDie(buffer, 1, size, f); }, numberOfStreams);
+}
+
+void ChunkedBinaryStreamInformation::ReadStreamHeaders(const std::function<void(void*, size_t)>& read, size_t numberOfStreams)
+{
+    for (size_t i = 0; i < numberOfStreams; ++i)
+    {
+        ChunkedBinaryStreamHeader streamHeader;
+        read(&streamHeader, sizeof(streamHeader));
+        std::string name(streamHeader.m_nameLength, '\0');
+        if (!name.empty())
+        {
+            read(&name[0], name.size());
+        }
+
+        auto storageType = static_cast<StorageType>(streamHeader.m_storageType);
+        auto storedElementType = static_cast<ElementType>(streamHeader.m_elementType);
+        if ((storageType != StorageType::dense && storageType != StorageType::sparse_csc) ||
+            (storedElementType != ElementType::tfloat && storedElementType != ElementType::tdouble))
+        {
+            RuntimeError("ChunkedBinaryDeserializer: stream '%s' of '%ls' has an unsupported storage or element type.", name.c_str(), m_source.c_str());
+        }
+
+        auto stream = std::make_shared<StreamDescription>();
+        stream->m_id = i;
+        stream->m_name = msra::strfun::utf16(name);
+        stream->m_storageType = storageType;
+        stream->m_elementType = m_elementType;
+        stream->m_sampleLayout = std::make_shared<TensorShape>(static_cast<size_t>(streamHeader.m_sampleDimension));
+        m_streams.push_back(stream);
+        m_storedElementTypes.push_back(storedElementType);
+    }
+}
+
+// Sequence data for values that had to be converted to the requested element type.
+struct ChunkedBinaryDenseSequenceData : DenseSequenceData
+{
+    std::vector<char> m_buffer;
+};
+
+struct ChunkedBinarySparseSequenceData : SparseSequenceData
+{
+    std::vector<char> m_buffer;
+};
+
+// Returns the values, converting them into 'buffer' if they are stored with a different element type.
+static void* GetValues(char* values, size_t count, ElementType storedType, ElementType type, std::vector<char>& buffer)
+{
+    if (storedType == type)
+    {
+        return values;
+    }
+
+    buffer.resize(count * GetSizeByType(type));
+    if (type == ElementType::tdouble)
+    {
+        const float* source = reinterpret_cast<const float*>(values);
+        std::copy(source, source + count, reinterpret_cast<double*>(buffer.data()));
+    }
+    else
+    {
+        const double* source = reinterpret_cast<const double*>(values);
+        float* target = reinterpret_cast<float*>(buffer.data());
+        for (size_t i = 0; i < count; ++i)
+        {
+            target[i] = static_cast<float>(source[i]);
+        }
+    }
+    return buffer.data();
+}
+
+size_t ChunkedBinaryChunk::Advance(size_t& position, size_t size) const
+{
+    size_t offset = AlignChunkedBinaryOffset(position);
+    if (offset + size > m_data.size() || offset + size < offset)
+    {
+        RuntimeError("ChunkedBinaryDeserializer: a chunk of '%ls' is corrupt.", m_streams.m_source.c_str());
+    }
+    position = offset + size;
+    return offset;
+}
+
+ChunkedBinaryChunk::ChunkedBinaryChunk(const ChunkedBinaryStreamInformation& streams, std::vector<char>&& data, size_t firstSequence, size_t numberOfSequences)
+    : m_streams(streams), m_data(std::move(data)), m_firstSequence(firstSequence), m_numberOfSequences(numberOfSequences)
+{
+    const auto& descriptions = m_streams.m_streams;
+    m_records.reserve(m_numberOfSequences * descriptions.size());
+    size_t position = 0;
+    for (size_t i = 0; i < m_numberOfSequences; ++i)
+    {
+        for (size_t s = 0; s < descriptions.size(); ++s)
+        {
+            ChunkedBinaryRecordHeader header;
+            memcpy(&header, m_data.data() + Advance(position, sizeof(header)), sizeof(header));
+
+            size_t elementSize = GetSizeByType(m_streams.m_storedElementTypes[s]);
+            Record record = {};
+            record.m_numberOfSamples = header.m_numberOfSamples;
+            record.m_numberOfNonZeros = header.m_numberOfNonZeros;
+            if (descriptions[s]->m_storageType == StorageType::dense)
+            {
+                size_t numberOfValues = record.m_numberOfSamples * descriptions[s]->m_sampleLayout->GetNumElements();
+                record.m_valuesOffset = Advance(position, numberOfValues * elementSize);
+            }
+            else
+            {
+                record.m_nonZerosPerSampleOffset = Advance(position, record.m_numberOfSamples * sizeof(uint32_t));
+                record.m_indicesOffset = Advance(position, record.m_numberOfNonZeros * sizeof(int32_t));
+                record.m_valuesOffset = Advance(position, record.m_numberOfNonZeros * elementSize);
+            }
+            m_records.push_back(record);
+        }
+    }
+}
+
+std::vector<SequenceDataPtr> ChunkedBinaryChunk::GetSequence(size_t sequenceId)
+{
+    assert(sequenceId >= m_firstSequence && sequenceId < m_firstSequence + m_numberOfSequences);
+    const auto& descriptions = m_streams.m_streams;
+    const Record* records = &m_records[(sequenceId - m_firstSequence) * descriptions.size()];
+
+    std::vector<SequenceDataPtr> result;
+    result.reserve(descriptions.size());
+    for (size_t s = 0; s < descriptions.size(); ++s)
+    {
+        const Record& record = records[s];
+        char* values = m_data.data() + record.m_valuesOffset;
+        if (descriptions[s]->m_storageType == StorageType::dense)
+        {
+            auto sequence = std::make_shared<ChunkedBinaryDenseSequenceData>();
+            sequence->m_numberOfSamples = record.m_numberOfSamples;
+            sequence->m_sampleLayout = descriptions[s]->m_sampleLayout;
+            sequence->m_data = GetValues(values, record.m_numberOfSamples * descriptions[s]->m_sampleLayout->GetNumElements(),
+                                         m_streams.m_storedElementTypes[s], m_streams.m_elementType, sequence->m_buffer);
+            sequence->m_chunk = shared_from_this();
+            result.push_back(sequence);
+        }
+        else
+        {
+            auto sequence = std::make_shared<ChunkedBinarySparseSequenceData>();
+            const uint32_t* nonZerosPerSample = reinterpret_cast<const uint32_t*>(m_data.data() + record.m_nonZerosPerSampleOffset);
+            const int32_t* indices = reinterpret_cast<const int32_t*>(m_data.data() + record.m_indicesOffset);
+            const int32_t* indicesEnd = indices + record.m_numberOfNonZeros;
+            sequence->m_indices.resize(record.m_numberOfSamples);
+            for (size_t j = 0; j < record.m_numberOfSamples; ++j)
+            {
+                if (nonZerosPerSample[j] > (size_t)(indicesEnd - indices))
+                {
+                    RuntimeError("ChunkedBinaryDeserializer: sequence %d of '%ls' is corrupt.", (int)sequenceId, m_streams.m_source.c_str());
+                }
+                sequence->m_indices[j].assign(indices, indices + nonZerosPerSample[j]);
+                indices += nonZerosPerSample[j];
+            }
+            sequence->m_data = GetValues(values, record.m_numberOfNonZeros, m_streams.m_storedElementTypes[s], m_streams.m_elementType, sequence->m_buffer);
+            sequence->m_chunk = shared_from_this();
+            result.push_back(sequence);
+        }
+    }
+    return result;
+}
+} } }
@@ -0,0 +1,66 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <vector>
+#include "DataDeserializer.h"
+#include "ChunkedBinaryFormat.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Streams of chunked binary data (see ChunkedBinaryFormat.h), shared by the deserializers of files and of streams.
+struct ChunkedBinaryStreamInformation
+{
+    std::wstring m_source;        // name of the file or the stream, for messages
+    ElementType m_elementType;    // element type the values are exposed with
+
+    // Streams as exposed to the upper layers, and the element types they are stored with.
+    std::vector<StreamDescriptionPtr> m_streams;
+    std::vector<ElementType> m_storedElementTypes;
+
+    // Reads the headers of 'numberOfStreams' streams from the current position of 'f'.
+    void ReadStreamHeaders(FILE* f, size_t numberOfStreams);
+
+    // Reads the headers of 'numberOfStreams' streams through 'read', which reads the next bytes of the file.
+    void ReadStreamHeaders(const std::function<void(void*, size_t)>& read, size_t numberOfStreams);
+};
+
+// Records of consecutive sequences in memory (the data of a chunk, or a single sequence of a stream).
+// The offsets of all records are established when it is created, and the sequences point into the buffer.
+class ChunkedBinaryChunk : public Chunk, public std::enable_shared_from_this<ChunkedBinaryChunk>
+{
+public:
+    // 'data' holds the records of the sequences [firstSequence, firstSequence + numberOfSequences).
+    // 'streams' has to outlive the chunk.
+    ChunkedBinaryChunk(const ChunkedBinaryStreamInformation& streams, std::vector<char>&& data, size_t firstSequence, size_t numberOfSequences);
+
+    virtual std::vector<SequenceDataPtr> GetSequence(size_t sequenceId) override;
+
+private:
+    DISABLE_COPY_AND_MOVE(ChunkedBinaryChunk);
+
+    struct Record
+    {
+        size_t m_numberOfSamples;
+        size_t m_numberOfNonZeros;
+        size_t m_nonZerosPerSampleOffset; // sparse only
+        size_t m_indicesOffset;           // sparse only
+        size_t m_valuesOffset;
+    };
+
+    // Returns the aligned offset of an array of 'size' bytes that follows 'position', and moves 'position' behind it.
+    size_t Advance(size_t& position, size_t size) const;
+
+    const ChunkedBinaryStreamInformation& m_streams;
+    std::vector<char> m_data;
+    size_t m_firstSequence;
+    size_t m_numberOfSequences;
+    std::vector<Record> m_records; // sequence-major
+};
+} } }
@@ -0,0 +1,144 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <algorithm>
+#include "ChunkedBinaryDeserializer.h"
+#include "ElementTypeUtils.h"
+#include "PipelineStatistics.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+ChunkedBinaryDeserializer::ChunkedBinaryDeserializer(const std::wstring& path, ElementType elementType)
+    : ChunkedBinaryDeserializer(std::make_shared<FileByteSource>(path), elementType)
+{
+}
+
+ChunkedBinaryDeserializer::ChunkedBinaryDeserializer(ByteSourcePtr source, ElementType elementType)
+    : m_source(source)
+{
+    if (elementType != ElementType::tfloat && elementType != ElementType::tdouble)
+    {
+        InvalidArgument("ChunkedBinaryDeserializer: only float and double elements are supported.");
+    }
+
+    const std::wstring& path = source->GetName();
+    m_streams.m_source = path;
+    m_streams.m_elementType = elementType;
+
+    size_t position = 0;
+    auto read = [&](void* buffer, size_t size)
+    {
+        m_source->Read(position, size, (char*)buffer);
+        position += size;
+    };
+
+    ChunkedBinaryFileHeader header;
+    read(&header, sizeof(header));
+    if (header.m_magic != c_chunkedBinaryMagic)
+    {
+        RuntimeError("ChunkedBinaryDeserializer: '%ls' is not a chunked binary corpus file, or it was not completely written.", path.c_str());
+    }
+
+    if (header.m_version > c_chunkedBinaryVersion)
+    {
+        RuntimeError("ChunkedBinaryDeserializer: '%ls' has version %d, only versions up to %d are supported.",
+                     path.c_str(), (int)header.m_version, (int)c_chunkedBinaryVersion);
+    }
+
+    m_streams.ReadStreamHeaders(read, header.m_numberOfStreams);
+
+    // Chunk index.
+    std::vector<ChunkedBinaryChunkIndexEntry> index(header.m_numberOfChunks);
+    std::vector<uint32_t> sequenceSamples(header.m_numberOfSequences);
+    position = header.m_indexOffset;
+    if (!index.empty())
+    {
+        read(index.data(), sizeof(ChunkedBinaryChunkIndexEntry) * index.size());
+    }
+    if (!sequenceSamples.empty())
+    {
+        read(sequenceSamples.data(), sizeof(uint32_t) * sequenceSamples.size());
+    }
+
+    m_sequenceDescriptions.reserve(sequenceSamples.size());
+    for (size_t chunkId = 0; chunkId < index.size(); ++chunkId)
+    {
+        ChunkInformation chunk = { index[chunkId], m_sequenceDescriptions.size() };
+        if (chunk.m_firstSequence + chunk.m_index.m_numberOfSequences > sequenceSamples.size())
+        {
+            RuntimeError("ChunkedBinaryDeserializer: the chunk index of '%ls' is corrupt.", path.c_str());
+        }
+
+        for (size_t i = 0; i < chunk.m_index.m_numberOfSequences; ++i)
+        {
+            SequenceDescription description;
+            description.m_id = m_sequenceDescriptions.size();
+            description.m_numberOfSamples = sequenceSamples[description.m_id];
+            description.m_chunkId = chunkId;
+            description.m_isValid = true;
+            description.m_key.major = L"";
+            description.m_key.minor = description.m_id;
+            m_sequenceDescriptions.push_back(description);
+        }
+        m_chunks.push_back(chunk);
+    }
+
+    if (m_sequenceDescriptions.size() != sequenceSamples.size())
+    {
+        RuntimeError("ChunkedBinaryDeserializer: the chunk index of '%ls' is corrupt.", path.c_str());
+    }
+
+    m_sequences.reserve(m_sequenceDescriptions.size());
+    for (const auto& description : m_sequenceDescriptions)
+    {
+        m_sequences.push_back(&description);
+    }
+
+    fprintf(stderr, "ChunkedBinaryDeserializer: %d sequences in %d chunks, %d streams in '%ls'\n",
+            (int)m_sequences.size(), (int)m_chunks.size(), (int)m_streams.m_streams.size(), path.c_str());
+}
+
+std::vector<StreamDescriptionPtr> ChunkedBinaryDeserializer::GetStreamDescriptions() const
+{
+    return m_streams.m_streams;
+}
+
+const SequenceDescriptions& ChunkedBinaryDeserializer::GetSequenceDescriptions() const
+{
+    return m_sequences;
+}
+
+const SequenceDescription* ChunkedBinaryDeserializer::GetSequenceDescriptionByKey(const KeyType& key)
+{
+    if (!key.major.empty() || key.minor >= m_sequenceDescriptions.size())
+    {
+        return nullptr;
+    }
+    return &m_sequenceDescriptions[key.minor];
+}
+
+size_t ChunkedBinaryDeserializer::GetTotalNumberOfChunks()
+{
+    return m_chunks.size();
+}
+
+ChunkPtr ChunkedBinaryDeserializer::GetChunk(size_t chunkId)
+{
+    if (chunkId >= m_chunks.size())
+    {
+        LogicError("ChunkedBinaryDeserializer: chunk %d does not exist.", (int)chunkId);
+    }
+
+    // A chunk is read with a single ranged read.
+    const auto& info = m_chunks[chunkId];
+    std::vector<char> data(info.m_index.m_size);
+    m_source->Read(info.m_index.m_offset, data.size(), data.data());
+    AddPipelineBytesRead(data.size());
+
+    return std::make_shared<ChunkedBinaryChunk>(m_streams, std::move(data), info.m_firstSequence, info.m_index.m_numberOfSequences);
+}
+} } }
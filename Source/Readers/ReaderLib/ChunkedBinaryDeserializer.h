@@ -0,0 +1,52 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include "DataDeserializer.h"
+#include "ChunkedBinaryChunk.h"
+#include "ByteSource.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Deserializer for chunked binary corpus files (see ChunkedBinaryFormat.h).
+// Only the headers and the chunk index are read up front; a chunk is read with a single ranged read
+// of its byte source when it is requested, and its sequences point into the chunk buffer.
+// With a remote source the prefetching of the randomizer turns into concurrent range reads of whole chunks.
+// Values are converted to 'elementType' if the file was written with a different precision.
+// Sequence keys are { L"", sequence id }.
+class ChunkedBinaryDeserializer : public IDataDeserializer
+{
+public:
+    ChunkedBinaryDeserializer(const std::wstring& path, ElementType elementType);
+    ChunkedBinaryDeserializer(ByteSourcePtr source, ElementType elementType);
+
+    virtual std::vector<StreamDescriptionPtr> GetStreamDescriptions() const override;
+    virtual const SequenceDescriptions& GetSequenceDescriptions() const override;
+    virtual const SequenceDescription* GetSequenceDescriptionByKey(const KeyType& key) override;
+    virtual size_t GetTotalNumberOfChunks() override;
+
+    // Can be called concurrently for different chunks.
+    virtual ChunkPtr GetChunk(size_t chunkId) override;
+
+private:
+    DISABLE_COPY_AND_MOVE(ChunkedBinaryDeserializer);
+
+    struct ChunkInformation
+    {
+        ChunkedBinaryChunkIndexEntry m_index;
+        size_t m_firstSequence;
+    };
+
+    ByteSourcePtr m_source;
+    ChunkedBinaryStreamInformation m_streams;
+
+    std::vector<ChunkInformation> m_chunks;
+    std::vector<SequenceDescription> m_sequenceDescriptions;
+    SequenceDescriptions m_sequences;
+};
+} } }
@@ -0,0 +1,101 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// ChunkedBinaryFormat.h -- on-disk layout of the chunked binary corpus format, written by ChunkedBinaryWriter and
+// read by ChunkedBinaryDeserializer.
+//
+// A corpus file is laid out as follows (all values little endian):
+//
+//   ChunkedBinaryFileHeader
+//   numberOfStreams x (ChunkedBinaryStreamHeader, followed by nameLength bytes of the UTF-8 stream name)
+//   numberOfChunks x chunk data
+//   chunk index: numberOfChunks x ChunkedBinaryChunkIndexEntry,
+//                followed by numberOfSequences x uint32_t (number of samples of each sequence, in file order)
+//
+// The chunk index is at the end of the file, so that the writer can stream the chunks in one pass; the file header,
+// which points to it, is written last. A file whose magic is not set was not completed.
+//
+// The data of a chunk is a sequence of records, one per sequence and stream (sequence-major). Each record starts with
+// a ChunkedBinaryRecordHeader, followed by
+//   dense:      numberOfSamples * sampleDimension values
+//   sparse_csc: numberOfSamples x uint32_t (number of non-zero values per sample),
+//               numberOfNonZeros x int32_t (row indices), numberOfNonZeros values
+// Every array starts at an 8 byte boundary relative to the beginning of the chunk.
+//
+// The streaming variant of the format, which is read sequentially from a pipe or another unbounded source, is:
+//
+//   ChunkedBinaryStreamingHeader
+//   numberOfStreams x (ChunkedBinaryStreamHeader, followed by nameLength bytes of the UTF-8 stream name)
+//   any number of sequences: uint64_t size in bytes, followed by the records of one sequence as in a chunk
+//   (aligned relative to the beginning of the sequence)
+//
+// The stream ends at the end of the source, or with a sequence size of 0.
+//
+
+#pragma once
+
+#include <cstdint>
+#include "Reader.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+const uint64_t c_chunkedBinaryMagic = 0x004e49424b544e43ull; // "CNTKBIN\0"
+const uint32_t c_chunkedBinaryVersion = 1;
+const uint64_t c_chunkedBinaryStreamingMagic = 0x005254534b544e43ull; // "CNTKSTR\0"
+
+struct ChunkedBinaryFileHeader
+{
+    uint64_t m_magic;
+    uint32_t m_version;
+    uint32_t m_numberOfStreams;
+    uint64_t m_numberOfChunks;
+    uint64_t m_numberOfSequences;
+    uint64_t m_indexOffset; // offset of the chunk index from the beginning of the file
+};
+
+struct ChunkedBinaryStreamingHeader
+{
+    uint64_t m_magic;
+    uint32_t m_version;
+    uint32_t m_numberOfStreams;
+};
+
+// The storage and element types are stored as the values of StorageType and ElementType.
+struct ChunkedBinaryStreamHeader
+{
+    uint32_t m_storageType;
+    uint32_t m_elementType;
+    uint64_t m_sampleDimension;
+    uint32_t m_nameLength; // in bytes
+    uint32_t m_reserved;
+};
+
+struct ChunkedBinaryChunkIndexEntry
+{
+    uint64_t m_offset; // offset of the chunk data from the beginning of the file
+    uint64_t m_size;   // size of the chunk data in bytes
+    uint64_t m_numberOfSequences;
+    uint64_t m_numberOfSamples;
+};
+
+struct ChunkedBinaryRecordHeader
+{
+    uint32_t m_numberOfSamples;
+    uint32_t m_numberOfNonZeros; // 0 for dense streams
+};
+
+static_assert(sizeof(ChunkedBinaryFileHeader) == 40, "Unexpected padding in ChunkedBinaryFileHeader.");
+static_assert(sizeof(ChunkedBinaryStreamingHeader) == 16, "Unexpected padding in ChunkedBinaryStreamingHeader.");
+static_assert(sizeof(ChunkedBinaryStreamHeader) == 24, "Unexpected padding in ChunkedBinaryStreamHeader.");
+static_assert(sizeof(ChunkedBinaryChunkIndexEntry) == 32, "Unexpected padding in ChunkedBinaryChunkIndexEntry.");
+static_assert(sizeof(ChunkedBinaryRecordHeader) == 8, "Unexpected padding in ChunkedBinaryRecordHeader.");
+
+// Offsets of the arrays in a chunk are aligned to this boundary.
+const size_t c_chunkedBinaryAlignment = 8;
+
+inline size_t AlignChunkedBinaryOffset(size_t offset)
+{
+    return (offset + c_chunkedBinaryAlignment - 1) / c_chunkedBinaryAlignment * c_chunkedBinaryAlignment;
+}
+} } }
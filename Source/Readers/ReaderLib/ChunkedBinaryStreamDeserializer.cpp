@@ -0,0 +1,143 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "ChunkedBinaryStreamDeserializer.h"
+#include "fileutil.h"
+#include "PipelineStatistics.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+ChunkedBinaryStreamDeserializer::ChunkedBinaryStreamDeserializer(const std::wstring& source, ElementType elementType)
+    : m_file(nullptr), m_isPipe(false), m_sequencePosition(0)
+{
+    if (elementType != ElementType::tfloat && elementType != ElementType::tdouble)
+    {
+        InvalidArgument("ChunkedBinaryStreamDeserializer: only float and double elements are supported.");
+    }
+
+    if (source.empty())
+    {
+        InvalidArgument("ChunkedBinaryStreamDeserializer: no source given.");
+    }
+
+    m_streams.m_source = source;
+    m_streams.m_elementType = elementType;
+
+    if (source.back() == L'|')
+    {
+        const auto command = source.substr(0, source.size() - 1);
+#ifdef _WIN32
+        m_file = _wpopen(command.c_str(), L"rb");
+#else
+        // popen() does not accept 'b', streams are always binary.
+        m_file = _wpopen(command.c_str(), L"r");
+#endif
+        if (m_file == nullptr)
+        {
+            RuntimeError("ChunkedBinaryStreamDeserializer: error executing the command '%ls': %s", command.c_str(), strerror(errno));
+        }
+        m_isPipe = true;
+    }
+    else
+    {
+        // Also handles "-" for the standard input.
+        m_file = fopenOrDie(source, L"rb");
+    }
+
+    try
+    {
+        ChunkedBinaryStreamingHeader header;
+        freadOrDie(&header, sizeof(header), 1, m_file);
+        if (header.m_magic != c_chunkedBinaryStreamingMagic)
+        {
+            RuntimeError("ChunkedBinaryStreamDeserializer: '%ls' is not a chunked binary stream.", source.c_str());
+        }
+
+        if (header.m_version > c_chunkedBinaryVersion)
+        {
+            RuntimeError("ChunkedBinaryStreamDeserializer: '%ls' has version %d, only versions up to %d are supported.",
+                         source.c_str(), (int)header.m_version, (int)c_chunkedBinaryVersion);
+        }
+
+        m_streams.ReadStreamHeaders(m_file, header.m_numberOfStreams);
+    }
+    catch (...)
+    {
+        Close();
+        throw;
+    }
+
+    fprintf(stderr, "ChunkedBinaryStreamDeserializer: %d streams in '%ls'\n", (int)m_streams.m_streams.size(), source.c_str());
+}
+
+ChunkedBinaryStreamDeserializer::~ChunkedBinaryStreamDeserializer()
+{
+    Close();
+}
+
+void ChunkedBinaryStreamDeserializer::Close()
+{
+    if (m_file == nullptr)
+    {
+        return;
+    }
+
+    if (m_isPipe)
+    {
+        _pclose(m_file);
+    }
+    else if (m_file != stdin)
+    {
+        fclose(m_file);
+    }
+    m_file = nullptr;
+}
+
+std::vector<StreamDescriptionPtr> ChunkedBinaryStreamDeserializer::GetStreamDescriptions() const
+{
+    return m_streams.m_streams;
+}
+
+bool ChunkedBinaryStreamDeserializer::GetNextSequence(std::vector<SequenceDataPtr>& sequence)
+{
+    if (m_file == nullptr)
+    {
+        return false;
+    }
+
+    uint64_t size = 0;
+    if (fread(&size, sizeof(size), 1, m_file) != 1)
+    {
+        if (!feof(m_file))
+        {
+            RuntimeError("ChunkedBinaryStreamDeserializer: error reading from '%ls': %s", m_streams.m_source.c_str(), strerror(errno));
+        }
+        size = 0;
+    }
+
+    if (size == 0)
+    {
+        fprintf(stderr, "ChunkedBinaryStreamDeserializer: end of '%ls' after %d sequences\n", m_streams.m_source.c_str(), (int)m_sequencePosition);
+        Close();
+        return false;
+    }
+
+    // Each sequence of the stream counts as loaded as a chunk of its own.
+    std::vector<char> data(static_cast<size_t>(size));
+    {
+        PipelineStageTimer timer(PipelineStage::chunkLoad);
+        freadOrDie(data.data(), 1, data.size(), m_file);
+    }
+    AddPipelineBytesRead(sizeof(size) + data.size());
+
+    // The sequence keeps its own single-sequence chunk alive.
+    auto chunk = std::make_shared<ChunkedBinaryChunk>(m_streams, std::move(data), m_sequencePosition, 1);
+    sequence = chunk->GetSequence(m_sequencePosition);
+    m_sequencePosition++;
+    return true;
+}
+} } }
@@ -0,0 +1,39 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "DataDeserializer.h"
+#include "ChunkedBinaryChunk.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Deserializer for the streaming variant of the chunked binary format (see ChunkedBinaryFormat.h).
+// The source is a file or a named pipe, "-" for the standard input, or "command|" to read the output of a command,
+// e.g. of a tool that receives the data from a socket.
+// Values are converted to 'elementType' if the stream was written with a different precision.
+class ChunkedBinaryStreamDeserializer : public IStreamingDataDeserializer
+{
+public:
+    ChunkedBinaryStreamDeserializer(const std::wstring& source, ElementType elementType);
+    ~ChunkedBinaryStreamDeserializer();
+
+    virtual std::vector<StreamDescriptionPtr> GetStreamDescriptions() const override;
+    virtual bool GetNextSequence(std::vector<SequenceDataPtr>& sequence) override;
+
+private:
+    DISABLE_COPY_AND_MOVE(ChunkedBinaryStreamDeserializer);
+
+    void Close();
+
+    FILE* m_file; // null after the end of the stream
+    bool m_isPipe;
+    size_t m_sequencePosition;
+    ChunkedBinaryStreamInformation m_streams;
+};
+} } }
@@ -0,0 +1,265 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <algorithm>
+#include "ChunkedBinaryWriter.h"
+#include "ElementTypeUtils.h"
+#include "fileutil.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+static void ValidateChunkedBinaryStreams(const std::vector<StreamDescriptionPtr>& streams, const char* writer)
+{
+    if (streams.empty())
+    {
+        InvalidArgument("%s: at least one stream is required.", writer);
+    }
+
+    for (const auto& stream : streams)
+    {
+        if (stream->m_storageType != StorageType::dense && stream->m_storageType != StorageType::sparse_csc)
+        {
+            InvalidArgument("%s: unsupported storage type of stream '%ls'.", writer, stream->m_name.c_str());
+        }
+
+        if (stream->m_elementType != ElementType::tfloat && stream->m_elementType != ElementType::tdouble)
+        {
+            InvalidArgument("%s: stream '%ls' must have float or double elements.", writer, stream->m_name.c_str());
+        }
+
+        if (stream->m_sampleLayout == nullptr)
+        {
+            InvalidArgument("%s: stream '%ls' has no sample layout.", writer, stream->m_name.c_str());
+        }
+    }
+}
+
+static void WriteChunkedBinaryStreamHeaders(const std::vector<StreamDescriptionPtr>& streams, FILE* f)
+{
+    for (const auto& stream : streams)
+    {
+        std::string name = msra::strfun::utf8(stream->m_name);
+        ChunkedBinaryStreamHeader streamHeader = {};
+        streamHeader.m_storageType = static_cast<uint32_t>(stream->m_storageType);
+        streamHeader.m_elementType = static_cast<uint32_t>(stream->m_elementType);
+        streamHeader.m_sampleDimension = stream->m_sampleLayout->GetNumElements();
+        streamHeader.m_nameLength = static_cast<uint32_t>(name.size());
+        fwriteOrDie(&streamHeader, sizeof(streamHeader), 1, f);
+        fwriteOrDie(name.data(), 1, name.size(), f);
+    }
+}
+
+// Appends 'size' bytes to 'buffer', starting at an aligned offset.
+static void AppendAligned(std::vector<char>& buffer, const void* data, size_t size)
+{
+    size_t offset = AlignChunkedBinaryOffset(buffer.size());
+    buffer.resize(offset + size, 0);
+    if (size > 0)
+    {
+        memcpy(buffer.data() + offset, data, size);
+    }
+}
+
+// Appends the records of a sequence to 'buffer' and returns its number of samples (the maximum over all streams).
+static size_t AppendChunkedBinarySequence(const std::vector<StreamDescriptionPtr>& streams, const std::vector<SequenceDataPtr>& sequence, std::vector<char>& buffer)
+{
+    if (sequence.size() != streams.size())
+    {
+        InvalidArgument("ChunkedBinaryWriter: expected %d streams per sequence, got %d.", (int)streams.size(), (int)sequence.size());
+    }
+
+    size_t numberOfSamples = 0;
+    for (size_t i = 0; i < streams.size(); ++i)
+    {
+        const auto& stream = streams[i];
+        size_t elementSize = GetSizeByType(stream->m_elementType);
+        size_t dimension = stream->m_sampleLayout->GetNumElements();
+
+        ChunkedBinaryRecordHeader record = {};
+        if (stream->m_storageType == StorageType::dense)
+        {
+            const auto& dense = static_cast<const DenseSequenceData&>(*sequence[i]);
+            record.m_numberOfSamples = static_cast<uint32_t>(dense.m_numberOfSamples);
+            AppendAligned(buffer, &record, sizeof(record));
+            AppendAligned(buffer, dense.m_data, dense.m_numberOfSamples * dimension * elementSize);
+        }
+        else
+        {
+            const auto& sparse = static_cast<const SparseSequenceData&>(*sequence[i]);
+            std::vector<uint32_t> nonZerosPerSample;
+            std::vector<int32_t> rowIndices;
+            for (const auto& sample : sparse.m_indices)
+            {
+                nonZerosPerSample.push_back(static_cast<uint32_t>(sample.size()));
+                for (size_t row : sample)
+                {
+                    if (row >= dimension)
+                    {
+                        RuntimeError("ChunkedBinaryWriter: row index %d of stream '%ls' exceeds the dimension %d.", (int)row, stream->m_name.c_str(), (int)dimension);
+                    }
+                    rowIndices.push_back(static_cast<int32_t>(row));
+                }
+            }
+
+            record.m_numberOfSamples = static_cast<uint32_t>(nonZerosPerSample.size());
+            record.m_numberOfNonZeros = static_cast<uint32_t>(rowIndices.size());
+            AppendAligned(buffer, &record, sizeof(record));
+            AppendAligned(buffer, nonZerosPerSample.data(), nonZerosPerSample.size() * sizeof(uint32_t));
+            AppendAligned(buffer, rowIndices.data(), rowIndices.size() * sizeof(int32_t));
+            AppendAligned(buffer, sparse.m_data, rowIndices.size() * elementSize);
+        }
+
+        numberOfSamples = std::max(numberOfSamples, (size_t)record.m_numberOfSamples);
+    }
+    return numberOfSamples;
+}
+
+ChunkedBinaryWriter::ChunkedBinaryWriter(const std::wstring& path, const std::vector<StreamDescriptionPtr>& streams, size_t chunkSizeInBytes)
+    : m_path(path),
+      m_file(nullptr),
+      m_streams(streams),
+      m_chunkSizeInBytes(chunkSizeInBytes),
+      m_currentChunkSequences(0),
+      m_currentChunkSamples(0)
+{
+    ValidateChunkedBinaryStreams(m_streams, "ChunkedBinaryWriter");
+
+    m_file = fopenOrDie(path, L"wb");
+
+    // The header is rewritten by Close(), once the chunk index is known.
+    ChunkedBinaryFileHeader header = {};
+    fwriteOrDie(&header, sizeof(header), 1, m_file);
+    WriteChunkedBinaryStreamHeaders(m_streams, m_file);
+}
+
+ChunkedBinaryWriter::~ChunkedBinaryWriter()
+{
+    // Without Close() the header stays empty, so that the incomplete file is rejected by the deserializer.
+    if (m_file != nullptr)
+    {
+        fclose(m_file);
+    }
+}
+
+void ChunkedBinaryWriter::AddSequence(const std::vector<SequenceDataPtr>& sequence)
+{
+    if (m_file == nullptr)
+    {
+        LogicError("ChunkedBinaryWriter: the file '%ls' is already closed.", m_path.c_str());
+    }
+
+    size_t numberOfSamples = AppendChunkedBinarySequence(m_streams, sequence, m_currentChunk);
+    m_sequenceSamples.push_back(static_cast<uint32_t>(numberOfSamples));
+    m_currentChunkSequences++;
+    m_currentChunkSamples += numberOfSamples;
+
+    if (m_currentChunk.size() >= m_chunkSizeInBytes)
+    {
+        FlushChunk();
+    }
+}
+
+void ChunkedBinaryWriter::FlushChunk()
+{
+    if (m_currentChunkSequences == 0)
+    {
+        return;
+    }
+
+    // Chunks start at aligned file offsets as well.
+    uint64_t offset = fgetpos(m_file);
+    uint64_t alignedOffset = AlignChunkedBinaryOffset(offset);
+    if (alignedOffset != offset)
+    {
+        char padding[c_chunkedBinaryAlignment] = {};
+        fwriteOrDie(padding, 1, (size_t)(alignedOffset - offset), m_file);
+    }
+
+    fwriteOrDie(m_currentChunk.data(), 1, m_currentChunk.size(), m_file);
+
+    ChunkedBinaryChunkIndexEntry entry;
+    entry.m_offset = alignedOffset;
+    entry.m_size = m_currentChunk.size();
+    entry.m_numberOfSequences = m_currentChunkSequences;
+    entry.m_numberOfSamples = m_currentChunkSamples;
+    m_chunks.push_back(entry);
+
+    m_currentChunk.clear();
+    m_currentChunkSequences = 0;
+    m_currentChunkSamples = 0;
+}
+
+void ChunkedBinaryWriter::Close()
+{
+    if (m_file == nullptr)
+    {
+        return;
+    }
+
+    FlushChunk();
+
+    ChunkedBinaryFileHeader header;
+    header.m_magic = c_chunkedBinaryMagic;
+    header.m_version = c_chunkedBinaryVersion;
+    header.m_numberOfStreams = static_cast<uint32_t>(m_streams.size());
+    header.m_numberOfChunks = m_chunks.size();
+    header.m_numberOfSequences = m_sequenceSamples.size();
+    header.m_indexOffset = fgetpos(m_file);
+
+    if (!m_chunks.empty())
+    {
+        fwriteOrDie(m_chunks.data(), sizeof(ChunkedBinaryChunkIndexEntry), m_chunks.size(), m_file);
+        fwriteOrDie(m_sequenceSamples.data(), sizeof(uint32_t), m_sequenceSamples.size(), m_file);
+    }
+
+    fsetpos(m_file, (uint64_t)0);
+    fwriteOrDie(&header, sizeof(header), 1, m_file);
+    fflushOrDie(m_file);
+    fcloseOrDie(m_file);
+    m_file = nullptr;
+}
+
+ChunkedBinaryStreamWriter::ChunkedBinaryStreamWriter(FILE* f, const std::vector<StreamDescriptionPtr>& streams)
+    : m_file(f), m_streams(streams)
+{
+    ValidateChunkedBinaryStreams(m_streams, "ChunkedBinaryStreamWriter");
+
+    ChunkedBinaryStreamingHeader header = {};
+    header.m_magic = c_chunkedBinaryStreamingMagic;
+    header.m_version = c_chunkedBinaryVersion;
+    header.m_numberOfStreams = static_cast<uint32_t>(m_streams.size());
+    fwriteOrDie(&header, sizeof(header), 1, m_file);
+    WriteChunkedBinaryStreamHeaders(m_streams, m_file);
+}
+
+void ChunkedBinaryStreamWriter::AddSequence(const std::vector<SequenceDataPtr>& sequence)
+{
+    if (m_file == nullptr)
+    {
+        LogicError("ChunkedBinaryStreamWriter: the stream is already closed.");
+    }
+
+    m_buffer.clear();
+    AppendChunkedBinarySequence(m_streams, sequence, m_buffer);
+    uint64_t size = m_buffer.size();
+    fwriteOrDie(&size, sizeof(size), 1, m_file);
+    fwriteOrDie(m_buffer.data(), 1, m_buffer.size(), m_file);
+}
+
+void ChunkedBinaryStreamWriter::Close()
+{
+    if (m_file == nullptr)
+    {
+        return;
+    }
+
+    uint64_t endOfStream = 0;
+    fwriteOrDie(&endOfStream, sizeof(endOfStream), 1, m_file);
+    fflushOrDie(m_file);
+    m_file = nullptr;
+}
+} } }
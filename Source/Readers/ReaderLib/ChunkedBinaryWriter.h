@@ -0,0 +1,82 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "DataDeserializer.h"
+#include "ChunkedBinaryFormat.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Writes sequences into a chunked binary corpus file (see ChunkedBinaryFormat.h).
+// Sequences are appended to the current chunk, which is written out once it reaches the requested size.
+// The file is only valid after Close() has been called.
+class ChunkedBinaryWriter
+{
+public:
+    // Supports dense and sparse_csc streams of float or double elements; the stream sample layouts give the dimensions.
+    ChunkedBinaryWriter(const std::wstring& path, const std::vector<StreamDescriptionPtr>& streams, size_t chunkSizeInBytes);
+    ~ChunkedBinaryWriter();
+
+    // Appends a sequence; 'sequence' holds the data of all streams in stream order,
+    // as DenseSequenceData or SparseSequenceData according to the storage type of the stream.
+    void AddSequence(const std::vector<SequenceDataPtr>& sequence);
+
+    // Writes the last chunk and the chunk index, and closes the file.
+    void Close();
+
+    size_t GetNumberOfSequences() const
+    {
+        return m_sequenceSamples.size();
+    }
+
+    size_t GetNumberOfChunks() const
+    {
+        return m_chunks.size();
+    }
+
+private:
+    DISABLE_COPY_AND_MOVE(ChunkedBinaryWriter);
+
+    void FlushChunk();
+
+    std::wstring m_path;
+    FILE* m_file;
+    std::vector<StreamDescriptionPtr> m_streams;
+    size_t m_chunkSizeInBytes;
+
+    std::vector<char> m_currentChunk;
+    size_t m_currentChunkSequences;
+    size_t m_currentChunkSamples;
+
+    std::vector<ChunkedBinaryChunkIndexEntry> m_chunks;
+    std::vector<uint32_t> m_sequenceSamples;
+};
+
+// Writes sequences in the streaming variant of the chunked binary format (see ChunkedBinaryFormat.h), e.g. into
+// a pipe that the ChunkedBinaryStreamDeserializer reads from. Every sequence is written as soon as it is added.
+class ChunkedBinaryStreamWriter
+{
+public:
+    // Writes the stream headers to 'f', which is not owned by the writer. The streams are as for ChunkedBinaryWriter.
+    ChunkedBinaryStreamWriter(FILE* f, const std::vector<StreamDescriptionPtr>& streams);
+
+    // Writes a sequence; 'sequence' holds the data of all streams in stream order (see ChunkedBinaryWriter::AddSequence()).
+    void AddSequence(const std::vector<SequenceDataPtr>& sequence);
+
+    // Writes the end of the stream and flushes it.
+    void Close();
+
+private:
+    DISABLE_COPY_AND_MOVE(ChunkedBinaryStreamWriter);
+
+    FILE* m_file;
+    std::vector<StreamDescriptionPtr> m_streams;
+    std::vector<char> m_buffer;
+};
+} } }
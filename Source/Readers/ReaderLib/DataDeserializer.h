@@ -132,10 +132,31 @@ public:
     virtual size_t GetTotalNumberOfChunks() = 0;
 
     // Retrieves a chunk with data.
+    // Can be called concurrently for different chunks (see ChunkPrefetcher), but not for the same one.
     virtual ChunkPtr GetChunk(size_t chunkId) = 0;
 
     virtual ~IDataDeserializer() {};
 };
 
 typedef std::shared_ptr<IDataDeserializer> IDataDeserializerPtr;
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// Interface of deserializers that read sequences one after another from an unbounded source, i.e. a pipe
+// or a socket, which cannot be indexed up front. The sequences are randomized by the ShuffleBufferRandomizer.
+//////////////////////////////////////////////////////////////////////////////////////////////////
+class IStreamingDataDeserializer
+{
+public:
+    // Describes streams this data deserializer can produce. Streams correspond to network inputs.
+    virtual std::vector<StreamDescriptionPtr> GetStreamDescriptions() const = 0;
+
+    // Reads the next sequence; 'sequence' receives the data of all streams in stream order.
+    // The data stays valid as long as it is referenced. Blocks until a sequence is available,
+    // returns false at the end of the source.
+    virtual bool GetNextSequence(std::vector<SequenceDataPtr>& sequence) = 0;
+
+    virtual ~IStreamingDataDeserializer() {};
+};
+
+typedef std::shared_ptr<IStreamingDataDeserializer> IStreamingDataDeserializerPtr;
 } } }
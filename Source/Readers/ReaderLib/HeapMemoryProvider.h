@@ -7,6 +7,7 @@
 
 #include <algorithm>
 #include "MemoryProvider.h"
+#include "HostMemoryPlacement.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -18,7 +19,9 @@ public:
     virtual void* Alloc(size_t elementSize, size_t numberOfElements) override
     {
         // Currently not alligned.
-        return ::operator new(elementSize * numberOfElements);
+        void* p = ::operator new(elementSize * numberOfElements);
+        HostMemoryPlacement::PlaceOnNode(p, elementSize * numberOfElements);
+        return p;
     }
 
     virtual void Free(void* p) override
@@ -0,0 +1,113 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#include "MemoryMappedFile.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+#ifdef _WIN32
+
+MemoryMappedFile::MemoryMappedFile(const std::wstring& path)
+    : m_path(path), m_data(nullptr), m_size(0), m_fileHandle(INVALID_HANDLE_VALUE), m_mappingHandle(nullptr)
+{
+    m_fileHandle = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (m_fileHandle == INVALID_HANDLE_VALUE)
+    {
+        RuntimeError("MemoryMappedFile: cannot open file '%ls' (error %d).", path.c_str(), (int) GetLastError());
+    }
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(m_fileHandle, &size))
+    {
+        CloseHandle(m_fileHandle);
+        RuntimeError("MemoryMappedFile: cannot get the size of file '%ls' (error %d).", path.c_str(), (int) GetLastError());
+    }
+    m_size = (size_t) size.QuadPart;
+    if (m_size == 0) // empty files cannot be mapped
+    {
+        return;
+    }
+
+    m_mappingHandle = CreateFileMappingW(m_fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    m_data = m_mappingHandle ? (const char*) MapViewOfFile(m_mappingHandle, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    if (!m_data)
+    {
+        int error = (int) GetLastError();
+        if (m_mappingHandle)
+        {
+            CloseHandle(m_mappingHandle);
+        }
+        CloseHandle(m_fileHandle);
+        RuntimeError("MemoryMappedFile: cannot map file '%ls' (error %d).", path.c_str(), error);
+    }
+}
+
+MemoryMappedFile::~MemoryMappedFile()
+{
+    if (m_data)
+    {
+        UnmapViewOfFile(m_data);
+    }
+    if (m_mappingHandle)
+    {
+        CloseHandle(m_mappingHandle);
+    }
+    CloseHandle(m_fileHandle);
+}
+
+#else
+
+MemoryMappedFile::MemoryMappedFile(const std::wstring& path)
+    : m_path(path), m_data(nullptr), m_size(0), m_fileDescriptor(-1)
+{
+    m_fileDescriptor = open(msra::strfun::utf8(path).c_str(), O_RDONLY);
+    if (m_fileDescriptor == -1)
+    {
+        RuntimeError("MemoryMappedFile: cannot open file '%ls'.", path.c_str());
+    }
+
+    struct stat sb;
+    if (fstat(m_fileDescriptor, &sb) == -1)
+    {
+        close(m_fileDescriptor);
+        RuntimeError("MemoryMappedFile: cannot get the size of file '%ls'.", path.c_str());
+    }
+    m_size = (size_t) sb.st_size;
+    if (m_size == 0) // empty files cannot be mapped
+    {
+        return;
+    }
+
+    void* data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, m_fileDescriptor, 0);
+    if (data == MAP_FAILED)
+    {
+        close(m_fileDescriptor);
+        RuntimeError("MemoryMappedFile: cannot map file '%ls'.", path.c_str());
+    }
+    m_data = (const char*) data;
+}
+
+MemoryMappedFile::~MemoryMappedFile()
+{
+    if (m_data)
+    {
+        munmap(const_cast<char*>(m_data), m_size);
+    }
+    close(m_fileDescriptor);
+}
+
+#endif
+} } }
@@ -0,0 +1,53 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include <string>
+#include <memory>
+#include "Basics.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// A read-only mapping of a whole file into memory.
+// The data stays valid for the lifetime of the object; pages are loaded by the OS on first access
+// and can be dropped by the OS again under memory pressure.
+class MemoryMappedFile
+{
+public:
+    explicit MemoryMappedFile(const std::wstring& path);
+    ~MemoryMappedFile();
+
+    const char* GetData() const
+    {
+        return m_data;
+    }
+
+    size_t GetSize() const
+    {
+        return m_size;
+    }
+
+    const std::wstring& GetPath() const
+    {
+        return m_path;
+    }
+
+private:
+    DISABLE_COPY_AND_MOVE(MemoryMappedFile);
+
+    std::wstring m_path;
+    const char* m_data;
+    size_t m_size;
+#ifdef _WIN32
+    void* m_fileHandle;
+    void* m_mappingHandle;
+#else
+    int m_fileDescriptor;
+#endif
+};
+
+typedef std::shared_ptr<MemoryMappedFile> MemoryMappedFilePtr;
+} } }
@@ -8,6 +8,7 @@
 
 #include "NoRandomizer.h"
 #include "DataReader.h"
+#include "PipelineStatistics.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -96,6 +97,8 @@ Sequences NoRandomizer::GetNextSequences(size_t sampleCount)
         auto chunk = m_chunks.find(id);
         if (chunk == m_chunks.end())
         {
+            AddPipelineChunk(false);
+            PipelineStageTimer timer(PipelineStage::chunkLoad);
             chunks[id] = m_deserializer->GetChunk(id);
         }
         else
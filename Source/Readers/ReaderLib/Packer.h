@@ -0,0 +1,25 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include "Reader.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Interface of the packers, which assemble the sequences provided by a transformer into minibatches.
+class Packer
+{
+public:
+    // Returns the next minibatch. Its data can be used until the next call.
+    virtual Minibatch ReadMinibatch() = 0;
+
+    virtual ~Packer()
+    {
+    }
+};
+
+typedef std::shared_ptr<Packer> PackerPtr;
+} } }
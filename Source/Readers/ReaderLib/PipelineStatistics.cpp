@@ -0,0 +1,64 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "PipelineStatistics.h"
+#include <atomic>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Times are kept in ticks of the steady clock, since there is no atomic addition of doubles.
+static std::atomic<long long> s_stageTicks[4];
+static std::atomic<size_t> s_bytesRead(0);
+static std::atomic<size_t> s_chunks(0);
+static std::atomic<size_t> s_readyChunks(0);
+static std::atomic<size_t> s_packedColumns(0);
+static std::atomic<size_t> s_gapColumns(0);
+
+void AddPipelineTime(PipelineStage stage, std::chrono::steady_clock::duration time)
+{
+    s_stageTicks[(size_t)stage] += time.count();
+}
+
+void AddPipelineBytesRead(size_t bytes)
+{
+    s_bytesRead += bytes;
+}
+
+void AddPipelineChunk(bool wasReady)
+{
+    s_chunks++;
+    if (wasReady)
+    {
+        s_readyChunks++;
+    }
+}
+
+void AddPipelinePacking(size_t columns, size_t gapColumns)
+{
+    s_packedColumns += columns;
+    s_gapColumns += gapColumns;
+}
+
+static double TakeSeconds(PipelineStage stage)
+{
+    std::chrono::steady_clock::duration time(s_stageTicks[(size_t)stage].exchange(0));
+    return std::chrono::duration<double>(time).count();
+}
+
+void TakePipelineStatistics(ReaderStatistics& statistics)
+{
+    statistics.m_chunkLoadSeconds += TakeSeconds(PipelineStage::chunkLoad);
+    statistics.m_decodeSeconds += TakeSeconds(PipelineStage::decode);
+    statistics.m_transformSeconds += TakeSeconds(PipelineStage::transform);
+    statistics.m_packSeconds += TakeSeconds(PipelineStage::pack);
+    statistics.m_bytesRead += s_bytesRead.exchange(0);
+    statistics.m_chunks += s_chunks.exchange(0);
+    statistics.m_readyChunks += s_readyChunks.exchange(0);
+    statistics.m_packedColumns += s_packedColumns.exchange(0);
+    statistics.m_gapColumns += s_gapColumns.exchange(0);
+}
+} } }
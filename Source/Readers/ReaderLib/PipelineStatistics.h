@@ -0,0 +1,57 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include <chrono>
+#include "DataReader.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Counters of the stages of the reader pipeline. The stages add to them from any thread, and the ReaderShim
+// takes them for the trainer (see IDataReader::TakeStatistics()).
+// The counters are global to the reader library, so readers that run at the same time, like the training
+// and the cross-validation reader, share them.
+enum class PipelineStage
+{
+    chunkLoad,
+    decode,
+    transform,
+    pack,
+};
+
+void AddPipelineTime(PipelineStage stage, std::chrono::steady_clock::duration time);
+void AddPipelineBytesRead(size_t bytes);
+
+// A randomizer took a chunk; 'wasReady' tells whether the chunk prefetcher had loaded it already.
+void AddPipelineChunk(bool wasReady);
+
+// A packer returned a minibatch of 'columns' columns (parallel sequences times time steps), 'gapColumns' of which are gaps.
+void AddPipelinePacking(size_t columns, size_t gapColumns);
+
+// Adds the stage counters to 'statistics' and resets them.
+void TakePipelineStatistics(ReaderStatistics& statistics);
+
+// Adds the time from its construction to its destruction to a stage.
+class PipelineStageTimer
+{
+public:
+    explicit PipelineStageTimer(PipelineStage stage)
+        : m_stage(stage), m_start(std::chrono::steady_clock::now())
+    {
+    }
+
+    ~PipelineStageTimer()
+    {
+        AddPipelineTime(m_stage, std::chrono::steady_clock::now() - m_start);
+    }
+
+private:
+    DISABLE_COPY_AND_MOVE(PipelineStageTimer);
+
+    PipelineStage m_stage;
+    std::chrono::steady_clock::time_point m_start;
+};
+} } }
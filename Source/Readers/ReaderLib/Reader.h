@@ -46,6 +46,35 @@ enum class StorageType
 
 typedef size_t StreamId;
 
+// Describes how the samples of an image stream are augmented on the device the minibatch is consumed on.
+// Each sample of such a stream is a staging image of m_stagingWidth x m_stagingHeight x m_channels (HWC),
+// followed by kDeviceAugmentationParameterCount parameters: the x and y offset, the width and height of the crop
+// in staging pixels, and the horizontal flip (0 or 1). The crop is scaled to m_width x m_height, the mean is
+// subtracted and the result is written into the input matrix in the stream's output layout.
+struct DeviceImageAugmentation
+{
+    static const size_t kDeviceAugmentationParameterCount = 5;
+
+    size_t m_stagingWidth;
+    size_t m_stagingHeight;
+    size_t m_channels;
+    size_t m_width;
+    size_t m_height;
+    bool m_transposeToCHW;    // the output layout, HWC otherwise
+    std::vector<float> m_mean; // m_width x m_height x m_channels (HWC), empty if no mean is subtracted
+
+    size_t GetStagedSampleSize() const
+    {
+        return m_stagingWidth * m_stagingHeight * m_channels + kDeviceAugmentationParameterCount;
+    }
+
+    size_t GetOutputSampleSize() const
+    {
+        return m_width * m_height * m_channels;
+    }
+};
+typedef std::shared_ptr<DeviceImageAugmentation> DeviceImageAugmentationPtr;
+
 // This class describes a particular stream: its name, element type, storage, etc.
 struct StreamDescription
 {
@@ -55,6 +84,7 @@ struct StreamDescription
     ElementType m_elementType;     // Element type of the stream
     TensorShapePtr m_sampleLayout; // Layout of the sample for the stream
                                    // If not specified - can be specified per sequence
+    DeviceImageAugmentationPtr m_deviceAugmentation; // Set if the samples are augmented on the device, see above
 };
 typedef std::shared_ptr<StreamDescription> StreamDescriptionPtr;
 
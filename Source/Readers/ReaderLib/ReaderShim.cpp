@@ -15,13 +15,37 @@
 #define DATAREADER_EXPORTS // creating the exports here
 #include "DataReader.h"
 #include "ReaderShim.h"
+#include "HeapMemoryProvider.h"
+#include "PipelineStatistics.h"
+#include "HostMemoryPlacement.h"
+#include "TaskScheduler.h"
+#ifndef CPUONLY
+#include "CudaMemoryProvider.h"
+#endif
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
 template <class ElemType>
 ReaderShim<ElemType>::ReaderShim(ReaderFactory factory)
-    : m_layout(make_shared<MBLayout>()), m_factory(factory)
+    : m_layout(make_shared<MBLayout>()), m_factory(factory), m_currentTransferBuffer(0), m_isMinibatchTransferred(false), m_transferDeviceId(-1)
+{
+}
+
+template <class ElemType>
+ReaderShim<ElemType>::~ReaderShim()
+{
+    // a running prefetch task uses this object (and the future does not wait for it by itself)
+    if (m_prefetchTask.valid() && m_launchType == launch::async)
+    {
+        m_prefetchTask.wait();
+    }
+}
+
+// Returns the GPU given by the 'deviceId' parameter, or -1 for the CPU and for 'auto', which is only resolved later.
+static int GetConfiguredGpuId(const ConfigParameters& config)
 {
+    std::string deviceId = config(L"deviceId", "auto");
+    return !deviceId.empty() && isdigit((unsigned char) deviceId[0]) ? atoi(deviceId.c_str()) : -1;
 }
 
 template <class ElemType>
@@ -31,19 +55,42 @@ void ReaderShim<ElemType>::Init(const ConfigParameters& config)
         config(L"nbruttsineachrecurrentiter", ConfigParameters::Array(intargvector(vector<int> { 1 })));
 
     bool prefetch = config(L"prefetch", true);
-    // if prefetch - launching asynchronously,
+    // if prefetch - launching asynchronously on the task scheduler,
     // otherwise deferring - synchronous execution during .get() call
     m_launchType = prefetch ? launch::async : launch::deferred;
 
     auto numSeqsPerMBForAllEpochs = numberOfuttsPerMinibatchForAllEpochs;
     m_layout->Init(numSeqsPerMBForAllEpochs[0], 0);
 
-    m_reader = m_factory(config);
+    // Minibatches that are copied on a separate stream are double buffered on the device by default,
+    // so that the copy of the next minibatch overlaps the computation on the current one. 0 copies synchronously.
+    size_t numberOfTransferBuffers = config(L"numberOfTransferBuffers", (size_t) 2);
+    m_transferBuffers.clear();
+    m_transferBuffers.resize(numberOfTransferBuffers);
+
+    // Pack into page-locked memory if the GPU is already known, so that the copies are truly asynchronous.
+    MemoryProviderPtr memoryProvider;
+#ifndef CPUONLY
+    int gpuId = GetConfiguredGpuId(config);
+    if (gpuId >= 0 && numberOfTransferBuffers > 0)
+    {
+        memoryProvider = std::make_shared<CudaMemoryProvider>(gpuId);
+    }
+#endif
+    if (!memoryProvider)
+    {
+        memoryProvider = std::make_shared<HeapMemoryProvider>();
+    }
+
+    m_reader = m_factory(config, memoryProvider);
     m_streams = m_reader->GetStreamDescriptions();
     for (auto i : m_streams)
     {
         m_nameToStreamId.insert(std::make_pair(i->m_name, i->m_id));
     }
+
+    m_stagedImages.assign(m_streams.size(), nullptr);
+    m_meanImages.assign(m_streams.size(), nullptr);
 }
 
 template <class ElemType>
@@ -67,13 +114,73 @@ void ReaderShim<ElemType>::StartDistributedMinibatchLoop(
     config.m_totalEpochSizeInSamples = requestedEpochSamples;
     config.m_epochIndex = epoch;
 
+    // A minibatch of the previous epoch may still be in flight.
+    if (m_prefetchTask.valid())
+    {
+        m_prefetchTask.wait();
+    }
+
     m_reader->StartEpoch(config);
     m_endOfEpoch = false;
 
-    m_prefetchTask = std::async(m_launchType, [this]()
+    StartPrefetch();
+}
+
+template <class ElemType>
+void ReaderShim<ElemType>::StartPrefetch()
+{
+    auto prefetch = [this]()
+    {
+        // packs the minibatch and copies it to the GPU
+        HostMemoryPlacement::BindCurrentThread();
+        return PrefetchMinibatch();
+    };
+    if (m_launchType == launch::async)
+    {
+        m_prefetchTask = TaskScheduler::Instance().Submit(TaskClass::prefetch, prefetch);
+    }
+    else
+    {
+        m_prefetchTask = std::async(launch::deferred, prefetch);
+    }
+}
+
+template <class ElemType>
+Minibatch ReaderShim<ElemType>::PrefetchMinibatch()
+{
+    Minibatch minibatch = m_reader->ReadMinibatch();
+
+    m_isMinibatchTransferred = false;
+    if (m_transferBuffers.empty() || m_transferDeviceId < 0 || m_transferredStreamIds.empty() || minibatch.m_data.empty())
+    {
+        return minibatch;
+    }
+
+    auto& buffer = m_transferBuffers[m_currentTransferBuffer];
+    if (!buffer.m_transferer)
+    {
+        buffer.m_transferer = std::make_unique<GPUDataTransferer<ElemType>>(m_transferDeviceId, true /*useConcurrentStreams*/);
+        buffer.m_streams.resize(m_streams.size());
+    }
+
+    // The device buffers may still be read by the copy into the input matrices that GetMinibatch() issued for an earlier minibatch.
+    buffer.m_transferer->WaitForSyncPointOnAssignStreamAsync();
+    for (size_t streamId : m_transferredStreamIds)
     {
-        return m_reader->ReadMinibatch();
-    });
+        const auto& stream = minibatch.m_data[streamId];
+        size_t rowNumber = m_streams[streamId]->m_sampleLayout->GetNumElements();
+        size_t columnNumber = stream->m_layout->GetNumCols();
+
+        auto& deviceBuffer = buffer.m_streams[streamId];
+        if (!deviceBuffer)
+        {
+            deviceBuffer = std::make_shared<Matrix<ElemType>>(m_transferDeviceId);
+        }
+        deviceBuffer->Resize(rowNumber, columnNumber);
+        buffer.m_transferer->CopyCPUToGPUAsync(reinterpret_cast<ElemType*>(stream->m_data), rowNumber * columnNumber, deviceBuffer->BufferPointer());
+    }
+    m_isMinibatchTransferred = true;
+    return minibatch;
 }
 
 template <class ElemType>
@@ -97,7 +204,15 @@ bool ReaderShim<ElemType>::GetMinibatch(StreamMinibatchInputs& matrices)
 
     assert(m_prefetchTask.valid());
 
+    // A minibatch that is not ready yet means that the reader is slower than the network.
+    auto waitStart = std::chrono::steady_clock::now();
+    if (m_launchType == launch::async && m_prefetchTask.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+    {
+        m_statistics.m_readyMinibatches++;
+    }
     Minibatch minibatch = m_prefetchTask.get();
+    m_statistics.m_waitSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - waitStart).count();
+    m_statistics.m_minibatches++;
     if (minibatch.m_endOfEpoch)
     {
         m_endOfEpoch = true;
@@ -107,9 +222,15 @@ bool ReaderShim<ElemType>::GetMinibatch(StreamMinibatchInputs& matrices)
         }
     }
 
+    TransferBuffer* transferred = nullptr;
+    if (m_isMinibatchTransferred)
+    {
+        transferred = &m_transferBuffers[m_currentTransferBuffer];
+        transferred->m_transferer->WaitForCopyCPUToGPUAsync();
+    }
+
     if (!minibatch.m_data.empty())
     {
-        // TODO: Use alternating pinned buffer in the packer, do not copy anything, but pack into the pinned memory.
         // Copy returned minibatch to the matrices.
         for (const auto& mx : matrices)
         {
@@ -122,19 +243,85 @@ bool ReaderShim<ElemType>::GetMinibatch(StreamMinibatchInputs& matrices)
             size_t columnNumber = m_layout->GetNumCols();
             size_t rowNumber = m_streams[streamId]->m_sampleLayout->GetNumElements();
 
-            auto* data = reinterpret_cast<const ElemType*>(stream->m_data);
-            matrices.GetInputMatrix<ElemType>(mx.first).SetValue(rowNumber, columnNumber, mx.second->GetDeviceId(), const_cast<ElemType*>(data), matrixFlagNormal);
+            auto& matrix = matrices.GetInputMatrix<ElemType>(mx.first);
+            if (m_streams[streamId]->m_deviceAugmentation)
+            {
+                if (transferred && transferred->m_streams[streamId])
+                {
+                    AugmentOnDevice(streamId, *transferred->m_streams[streamId], matrix);
+                }
+                else
+                {
+                    auto& staged = m_stagedImages[streamId];
+                    if (!staged)
+                    {
+                        staged = std::make_shared<Matrix<ElemType>>(mx.second->GetDeviceId());
+                    }
+
+                    auto* data = reinterpret_cast<const ElemType*>(stream->m_data);
+                    staged->SetValue(rowNumber, columnNumber, mx.second->GetDeviceId(), const_cast<ElemType*>(data), matrixFlagNormal);
+                    AugmentOnDevice(streamId, *staged, matrix);
+                }
+            }
+            else if (transferred && transferred->m_streams[streamId])
+            {
+                // Already on the device; this is a device-to-device copy on the compute stream.
+                matrix.SetValue(*transferred->m_streams[streamId]);
+            }
+            else
+            {
+                auto* data = reinterpret_cast<const ElemType*>(stream->m_data);
+                matrix.SetValue(rowNumber, columnNumber, mx.second->GetDeviceId(), const_cast<ElemType*>(data), matrixFlagNormal);
+            }
         }
     }
 
-    m_prefetchTask = std::async(m_launchType, [this]()
+    if (transferred)
+    {
+        // The transfer buffer can be overwritten as soon as the compute stream has copied it out.
+        transferred->m_transferer->RecordComputeStreamSyncPoint();
+        m_currentTransferBuffer = (m_currentTransferBuffer + 1) % m_transferBuffers.size();
+    }
+    else if (!m_transferBuffers.empty() && deviceId >= 0 && m_transferredStreamIds.empty())
     {
-        return m_reader->ReadMinibatch();
-    });
+        // From now on, copy the streams of the dense input matrices on the transfer stream.
+        m_transferDeviceId = deviceId;
+        for (const auto& mx : matrices)
+        {
+            if (matrices.GetInputMatrix<ElemType>(mx.first).GetMatrixType() == MatrixType::DENSE)
+            {
+                m_transferredStreamIds.push_back(m_nameToStreamId[mx.first]);
+            }
+        }
+    }
+
+    StartPrefetch();
 
     return !minibatch.m_data.empty();
 }
 
+template <class ElemType>
+void ReaderShim<ElemType>::AugmentOnDevice(size_t streamId, const Matrix<ElemType>& staged, Matrix<ElemType>& matrix)
+{
+    const auto& augmentation = *m_streams[streamId]->m_deviceAugmentation;
+
+    // The mean is uploaded once and stays on the device.
+    auto& mean = m_meanImages[streamId];
+    if (!mean)
+    {
+        mean = std::make_shared<Matrix<ElemType>>(matrix.GetDeviceId());
+        if (!augmentation.m_mean.empty())
+        {
+            std::vector<ElemType> meanImage(augmentation.m_mean.begin(), augmentation.m_mean.end());
+            mean->SetValue(meanImage.size(), 1, matrix.GetDeviceId(), meanImage.data(), matrixFlagNormal);
+        }
+    }
+
+    matrix.AssignAugmentedImagesOf(staged, *mean,
+                                   augmentation.m_stagingWidth, augmentation.m_stagingHeight, augmentation.m_channels,
+                                   augmentation.m_width, augmentation.m_height, augmentation.m_transposeToCHW);
+}
+
 template <class ElemType>
 bool ReaderShim<ElemType>::DataEnd() { return false; } // Note: Return value never used.
 
@@ -150,6 +337,15 @@ size_t ReaderShim<ElemType>::GetNumParallelSequences()
     return m_layout->GetNumParallelSequences();
 }
 
+template <class ElemType>
+bool ReaderShim<ElemType>::TakeStatistics(ReaderStatistics& statistics)
+{
+    statistics.Add(m_statistics);
+    m_statistics = ReaderStatistics();
+    TakePipelineStatistics(statistics);
+    return true;
+}
+
 template class ReaderShim<float>;
 template class ReaderShim<double>;
 } } }
@@ -13,17 +13,20 @@
 #include "DataReader.h"
 #include <future>
 #include "Reader.h"
+#include "MemoryProvider.h"
+#include "GPUDataTransferer.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
-typedef ReaderPtr (*ReaderFactory)(const ConfigParameters& parameters);
+// The memory provider is used for the minibatch buffers the reader packs into.
+typedef ReaderPtr (*ReaderFactory)(const ConfigParameters& parameters, MemoryProviderPtr memoryProvider);
 
 template <class ElemType>
 class ReaderShim : public IDataReader
 {
 public:
     explicit ReaderShim(ReaderFactory factory);
-    virtual ~ReaderShim() { }
+    virtual ~ReaderShim();
 
     virtual void Init(const ScriptableObjects::IConfigRecord& /*config*/) override
     {
@@ -52,7 +55,25 @@ public:
 
     virtual size_t GetNumParallelSequences() override;
 
+    // The time GetMinibatch() waited for the prefetched minibatches, and the counters of the pipeline stages.
+    virtual bool TakeStatistics(ReaderStatistics& statistics) override;
+
 private:
+    // Device buffers that a prefetched minibatch is copied into on the transfer stream of the GPUDataTransferer,
+    // while the network still computes on the previous one. They are used round robin.
+    struct TransferBuffer
+    {
+        std::unique_ptr<GPUDataTransferer<ElemType>> m_transferer;
+        std::vector<std::shared_ptr<Matrix<ElemType>>> m_streams; // indexed by stream id
+    };
+
+    // Reads the next minibatch and, if the target device is known, starts copying it to the current transfer buffer.
+    Minibatch PrefetchMinibatch();
+    void StartPrefetch();
+
+    // Augments the staged images of a stream with a DeviceImageAugmentation into the input matrix, on its device.
+    void AugmentOnDevice(size_t streamId, const Matrix<ElemType>& staged, Matrix<ElemType>& matrix);
+
     std::future<Minibatch> m_prefetchTask;
     ReaderPtr m_reader;
     ReaderFactory m_factory;
@@ -63,6 +84,18 @@ private:
     std::map<std::wstring, size_t> m_nameToStreamId;
     std::vector<StreamDescriptionPtr> m_streams;
     launch m_launchType;
+
+    std::vector<TransferBuffer> m_transferBuffers; // empty if the minibatches are copied synchronously
+    size_t m_currentTransferBuffer;
+    bool m_isMinibatchTransferred;              // set by the prefetch task
+    int m_transferDeviceId;                     // the GPU of the input matrices, or -1 while not known
+    std::vector<size_t> m_transferredStreamIds; // the streams of the dense input matrices
+
+    // Indexed by stream id, only set for the streams that are augmented on the device.
+    std::vector<std::shared_ptr<Matrix<ElemType>>> m_stagedImages; // the staged images if they were not transferred
+    std::vector<std::shared_ptr<Matrix<ElemType>>> m_meanImages;   // the device-resident mean, empty if there is none
+
+    ReaderStatistics m_statistics; // of GetMinibatch() since the last TakeStatistics()
 };
 
 }}}
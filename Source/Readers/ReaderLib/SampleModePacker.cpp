@@ -8,6 +8,7 @@
 
 #include "SampleModePacker.h"
 #include "ElementTypeUtils.h"
+#include "PipelineStatistics.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -57,6 +58,7 @@ Minibatch SampleModePacker::ReadMinibatch()
         return minibatch;
     }
 
+    PipelineStageTimer timer(PipelineStage::pack);
     assert(m_streamBuffers.size() == sequences.m_data.size());
 
     // For each sequence iterating thru all the streams with this sequence id and copying to the buffer.
@@ -0,0 +1,402 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#define _CRT_SECURE_NO_WARNINGS
+#define _SCL_SECURE_NO_WARNINGS
+
+#include "SequencePacker.h"
+#include "ElementTypeUtils.h"
+#include "PipelineStatistics.h"
+#include <numeric>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Sequence data that owns a copy of its data.
+struct OwnedDenseSequenceData : DenseSequenceData
+{
+    std::vector<char> m_buffer;
+};
+
+struct OwnedSparseSequenceData : SparseSequenceData
+{
+    std::vector<char> m_buffer;
+};
+
+SequencePacker::SequencePacker(
+    MemoryProviderPtr memoryProvider,
+    TransformerPtr transformer,
+    size_t minibatchSize,
+    const std::vector<StreamDescriptionPtr>& streams,
+    size_t bucketingWindow,
+    unsigned int randomSeed,
+    double timeStepSlack) : m_memoryProvider(memoryProvider),
+                               m_transformer(transformer),
+                               m_outputStreams(streams),
+                               m_minibatchSize(minibatchSize),
+                               m_bucketingWindow(bucketingWindow),
+                               m_timeStepSlack(timeStepSlack),
+                               m_rng(randomSeed),
+                               m_transformerEndOfEpoch(false),
+                               m_nextSequenceId(0)
+{
+    m_inputStreams = m_transformer->GetStreamDescriptions();
+    assert(m_inputStreams.size() == m_outputStreams.size());
+    assert(m_minibatchSize > 0);
+    if (m_timeStepSlack < 0)
+    {
+        InvalidArgument("SequencePacker: timeStepSlack must not be negative.");
+    }
+    for (int i = 0; i < m_outputStreams.size(); ++i)
+    {
+        const auto& stream = m_outputStreams[i];
+        // Input and output should match in everything except for sparse/dense.
+        assert(stream->m_elementType == ElementType::tfloat || stream->m_elementType == ElementType::tdouble);
+        assert(stream->m_storageType == StorageType::dense);
+        assert(stream->m_name == m_inputStreams[i]->m_name);
+        assert(stream->m_id == m_inputStreams[i]->m_id);
+        assert(GetSampleSize(m_inputStreams[i]) == GetSampleSize(stream));
+        UNUSED(stream);
+    }
+
+    m_streamBuffers.resize(m_outputStreams.size());
+    m_streamBufferSizes.resize(m_outputStreams.size(), 0);
+}
+
+Minibatch SequencePacker::ReadMinibatch()
+{
+    if (m_bucketingWindow == 0)
+    {
+        auto sequences = m_transformer->GetNextSequences(m_minibatchSize);
+        std::vector<SequenceStreams> batch(sequences.m_data.empty() ? 0 : sequences.m_data.front().size());
+        for (size_t i = 0; i < batch.size(); ++i)
+        {
+            for (const auto& streamSequences : sequences.m_data)
+            {
+                batch[i].push_back(streamSequences[i]);
+            }
+        }
+        return PackSequences(batch, sequences.m_endOfEpoch);
+    }
+
+    if (m_buckets.empty() && !m_transformerEndOfEpoch)
+    {
+        FillBuckets();
+    }
+
+    if (m_buckets.empty())
+    {
+        return Minibatch(true);
+    }
+
+    std::vector<SequenceStreams> batch = std::move(m_buckets.back());
+    m_buckets.pop_back();
+    return PackSequences(batch, m_transformerEndOfEpoch && m_buckets.empty());
+}
+
+void SequencePacker::FillBuckets()
+{
+    std::vector<SequenceStreams> pool;
+    size_t poolSamples = 0;
+    while (poolSamples < m_bucketingWindow * m_minibatchSize)
+    {
+        auto sequences = m_transformer->GetNextSequences(m_minibatchSize);
+        const size_t numSequences = sequences.m_data.empty() ? 0 : sequences.m_data.front().size();
+        for (size_t i = 0; i < numSequences; ++i)
+        {
+            SequenceStreams sequence;
+            for (size_t streamIndex = 0; streamIndex < sequences.m_data.size(); ++streamIndex)
+            {
+                sequence.push_back(CopySequence(sequences.m_data[streamIndex][i], streamIndex));
+            }
+            poolSamples += GetNumberOfSamples(sequence);
+            pool.push_back(std::move(sequence));
+        }
+
+        if (sequences.m_endOfEpoch)
+        {
+            m_transformerEndOfEpoch = true;
+            break;
+        }
+
+        if (numSequences == 0)
+        {
+            break;
+        }
+    }
+
+    // Sorting by length and cutting the pool into minibatches puts similar lengths together.
+    std::stable_sort(pool.begin(), pool.end(), [this](const SequenceStreams& a, const SequenceStreams& b)
+    {
+        return GetNumberOfSamples(a) < GetNumberOfSamples(b);
+    });
+
+    size_t batchSamples = 0;
+    for (auto& sequence : pool)
+    {
+        size_t numberOfSamples = GetNumberOfSamples(sequence);
+        if (m_buckets.empty() || (batchSamples + numberOfSamples > m_minibatchSize && batchSamples > 0))
+        {
+            m_buckets.push_back(std::vector<SequenceStreams>());
+            batchSamples = 0;
+        }
+        m_buckets.back().push_back(std::move(sequence));
+        batchSamples += numberOfSamples;
+    }
+
+    // Otherwise the minibatches would get longer and longer within the window.
+    std::shuffle(m_buckets.begin(), m_buckets.end(), m_rng);
+}
+
+Minibatch SequencePacker::PackSequences(const std::vector<SequenceStreams>& sequences, bool endOfEpoch)
+{
+    PipelineStageTimer timer(PipelineStage::pack);
+    Minibatch minibatch(endOfEpoch);
+    if (sequences.empty())
+    {
+        return minibatch;
+    }
+
+    // Distribute the sequences over parallel sequences, longest first, each into the first parallel sequence it fits in.
+    std::vector<size_t> lengths;
+    for (const auto& sequence : sequences)
+    {
+        lengths.push_back(GetNumberOfSamples(sequence));
+    }
+
+    std::vector<size_t> order(sequences.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&lengths](size_t a, size_t b)
+    {
+        return lengths[a] > lengths[b];
+    });
+
+    std::vector<size_t> parallelSequenceEnds;
+    std::vector<size_t> parallelSequenceOf(sequences.size());
+    std::vector<size_t> beginTimeOf(sequences.size());
+
+    // The longest sequence sets the shortest possible length. Within the slack, only lengths at which one more
+    // sequence end can line up are worth trying; the first one with the fewest columns wins.
+    const size_t longest = lengths[order.front()];
+    size_t numTimeSteps = longest;
+    size_t numParallelSequences = FitSequences(lengths, order, numTimeSteps, parallelSequenceOf, beginTimeOf, parallelSequenceEnds);
+    const size_t maxTimeSteps = longest + (size_t)(m_timeStepSlack * longest);
+    if (maxTimeSteps > longest && numParallelSequences > 1)
+    {
+        std::vector<size_t> distinctLengths(lengths);
+        std::sort(distinctLengths.begin(), distinctLengths.end());
+        distinctLengths.erase(std::unique(distinctLengths.begin(), distinctLengths.end()), distinctLengths.end());
+
+        std::vector<size_t> candidates;
+        for (size_t a : distinctLengths)
+        {
+            for (size_t b : distinctLengths)
+            {
+                if (a + b > longest && a + b <= maxTimeSteps)
+                {
+                    candidates.push_back(a + b);
+                }
+            }
+        }
+        std::sort(candidates.begin(), candidates.end());
+        candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+
+        size_t bestTimeSteps = numTimeSteps;
+        size_t bestColumns = numParallelSequences * numTimeSteps;
+        for (size_t candidate : candidates)
+        {
+            size_t rows = FitSequences(lengths, order, candidate, parallelSequenceOf, beginTimeOf, parallelSequenceEnds);
+            if (rows * candidate < bestColumns)
+            {
+                bestColumns = rows * candidate;
+                bestTimeSteps = candidate;
+            }
+        }
+        numTimeSteps = bestTimeSteps;
+        numParallelSequences = FitSequences(lengths, order, numTimeSteps, parallelSequenceOf, beginTimeOf, parallelSequenceEnds);
+    }
+
+    const size_t numSamples = std::accumulate(lengths.begin(), lengths.end(), (size_t)0);
+    AddPipelinePacking(numParallelSequences * numTimeSteps, numParallelSequences * numTimeSteps - numSamples);
+
+    auto layout = std::make_shared<MBLayout>();
+    layout->Init(numParallelSequences, numTimeSteps);
+    for (size_t i = 0; i < sequences.size(); ++i)
+    {
+        layout->AddSequence(m_nextSequenceId++, parallelSequenceOf[i], beginTimeOf[i], beginTimeOf[i] + lengths[i]);
+    }
+    for (size_t s = 0; s < numParallelSequences; ++s)
+    {
+        if (parallelSequenceEnds[s] < numTimeSteps)
+        {
+            layout->AddGap(s, parallelSequenceEnds[s], numTimeSteps);
+        }
+    }
+
+    for (size_t streamIndex = 0; streamIndex < m_outputStreams.size(); ++streamIndex)
+    {
+        const size_t size = numParallelSequences * numTimeSteps * GetSampleSize(m_outputStreams[streamIndex]);
+        char* buffer = GetStreamBuffer(streamIndex, size);
+
+        // Gaps are zero.
+        std::fill(buffer, buffer + size, 0);
+        for (size_t i = 0; i < sequences.size(); ++i)
+        {
+            CopySequenceToBuffer(sequences[i][streamIndex], streamIndex, parallelSequenceOf[i], beginTimeOf[i], numParallelSequences, buffer);
+        }
+
+        auto stream = std::make_shared<StreamMinibatch>();
+        stream->m_data = buffer;
+        stream->m_dataSize = size;
+        stream->m_layout = layout;
+        minibatch.m_data.push_back(stream);
+    }
+
+    return minibatch;
+}
+
+size_t SequencePacker::FitSequences(const std::vector<size_t>& lengths, const std::vector<size_t>& order, size_t numTimeSteps,
+                                    std::vector<size_t>& parallelSequenceOf, std::vector<size_t>& beginTimeOf, std::vector<size_t>& parallelSequenceEnds)
+{
+    parallelSequenceEnds.clear();
+    for (size_t i : order)
+    {
+        size_t s = 0;
+        while (s < parallelSequenceEnds.size() && parallelSequenceEnds[s] + lengths[i] > numTimeSteps)
+        {
+            s++;
+        }
+        if (s == parallelSequenceEnds.size())
+        {
+            parallelSequenceEnds.push_back(0);
+        }
+        parallelSequenceOf[i] = s;
+        beginTimeOf[i] = parallelSequenceEnds[s];
+        parallelSequenceEnds[s] += lengths[i];
+    }
+    return parallelSequenceEnds.size();
+}
+
+void SequencePacker::CopySequenceToBuffer(const SequenceDataPtr& sequence, size_t streamIndex, size_t parallelSequence, size_t beginTime, size_t numParallelSequences, char* buffer) const
+{
+    const auto& stream = m_inputStreams[streamIndex];
+    const size_t sampleSize = GetSampleSize(stream);
+    const size_t elementSize = GetSizeByType(stream->m_elementType);
+    auto data = reinterpret_cast<const char*>(sequence->m_data);
+
+    if (stream->m_storageType == StorageType::dense)
+    {
+        const auto& dense = static_cast<const DenseSequenceData&>(*sequence);
+        for (size_t t = 0; t < dense.m_numberOfSamples; ++t)
+        {
+            char* destination = buffer + ((beginTime + t) * numParallelSequences + parallelSequence) * sampleSize;
+            std::copy(data + t * sampleSize, data + (t + 1) * sampleSize, destination);
+        }
+    }
+    else if (stream->m_storageType == StorageType::sparse_csc)
+    {
+        // Sparse data is unpacked to dense; the non-zero values of all samples are stored consecutively.
+        const auto& sparse = static_cast<const SparseSequenceData&>(*sequence);
+        for (size_t t = 0; t < sparse.m_indices.size(); ++t)
+        {
+            char* destination = buffer + ((beginTime + t) * numParallelSequences + parallelSequence) * sampleSize;
+            for (size_t rowIndex : sparse.m_indices[t])
+            {
+                std::copy(data, data + elementSize, destination + rowIndex * elementSize);
+                data += elementSize;
+            }
+        }
+    }
+    else
+    {
+        RuntimeError("Storage type %d is not supported.", (int)stream->m_storageType);
+    }
+}
+
+SequenceDataPtr SequencePacker::CopySequence(const SequenceDataPtr& sequence, size_t streamIndex) const
+{
+    const auto& stream = m_inputStreams[streamIndex];
+    auto data = reinterpret_cast<const char*>(sequence->m_data);
+
+    if (stream->m_storageType == StorageType::dense)
+    {
+        const auto& dense = static_cast<const DenseSequenceData&>(*sequence);
+        auto result = std::make_shared<OwnedDenseSequenceData>();
+        result->m_buffer.assign(data, data + dense.m_numberOfSamples * GetSampleSize(stream));
+        result->m_data = result->m_buffer.data();
+        result->m_sampleLayout = dense.m_sampleLayout;
+        result->m_numberOfSamples = dense.m_numberOfSamples;
+        return result;
+    }
+    else if (stream->m_storageType == StorageType::sparse_csc)
+    {
+        const auto& sparse = static_cast<const SparseSequenceData&>(*sequence);
+        size_t nonZeroCount = 0;
+        for (const auto& indices : sparse.m_indices)
+        {
+            nonZeroCount += indices.size();
+        }
+
+        auto result = std::make_shared<OwnedSparseSequenceData>();
+        result->m_buffer.assign(data, data + nonZeroCount * GetSizeByType(stream->m_elementType));
+        result->m_data = result->m_buffer.data();
+        result->m_indices = sparse.m_indices;
+        return result;
+    }
+    else
+    {
+        RuntimeError("Storage type %d is not supported.", (int)stream->m_storageType);
+    }
+}
+
+size_t SequencePacker::GetNumberOfSamples(const SequenceDataPtr& sequence, size_t streamIndex) const
+{
+    if (m_inputStreams[streamIndex]->m_storageType == StorageType::sparse_csc)
+    {
+        return static_cast<const SparseSequenceData&>(*sequence).m_indices.size();
+    }
+    return static_cast<const DenseSequenceData&>(*sequence).m_numberOfSamples;
+}
+
+size_t SequencePacker::GetNumberOfSamples(const SequenceStreams& sequence) const
+{
+    assert(!sequence.empty());
+    size_t numberOfSamples = GetNumberOfSamples(sequence[0], 0);
+    for (size_t streamIndex = 1; streamIndex < sequence.size(); ++streamIndex)
+    {
+        if (GetNumberOfSamples(sequence[streamIndex], streamIndex) != numberOfSamples)
+        {
+            RuntimeError("SequencePacker: stream '%ls' of a sequence has %d samples, but stream '%ls' has %d.",
+                         m_inputStreams[streamIndex]->m_name.c_str(), (int)GetNumberOfSamples(sequence[streamIndex], streamIndex),
+                         m_inputStreams[0]->m_name.c_str(), (int)numberOfSamples);
+        }
+    }
+    return numberOfSamples;
+}
+
+size_t SequencePacker::GetSampleSize(StreamDescriptionPtr stream) const
+{
+    assert(stream != nullptr);
+    size_t elementSize = GetSizeByType(stream->m_elementType);
+    return stream->m_sampleLayout->GetNumElements() * elementSize;
+}
+
+char* SequencePacker::GetStreamBuffer(size_t streamIndex, size_t size)
+{
+    if (m_streamBufferSizes[streamIndex] < size)
+    {
+        // The previous minibatch is not used anymore at this point.
+        // Growing geometrically avoids reallocating (possibly page-locked) memory for every slightly larger minibatch.
+        size_t newSize = std::max(size, m_streamBufferSizes[streamIndex] + m_streamBufferSizes[streamIndex] / 2);
+        m_streamBuffers[streamIndex] = std::shared_ptr<char>(
+            reinterpret_cast<char*>(m_memoryProvider->Alloc(1, newSize)),
+            [this](char* p)
+            {
+                m_memoryProvider->Free(p);
+            });
+        m_streamBufferSizes[streamIndex] = newSize;
+    }
+    return m_streamBuffers[streamIndex].get();
+}
+} } }
@@ -0,0 +1,82 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include <random>
+#include "Reader.h"
+#include "Packer.h"
+#include "MemoryProvider.h"
+#include "Transformer.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// A packer that packs whole sequences as parallel sequences of an MBLayout.
+// The sequences of a minibatch are distributed over as few parallel sequences as possible, each of them as long as
+// the longest sequence (first fit decreasing); the remaining space is filled with gaps.
+// With length bucketing, the packer reads the sequences of 'bucketingWindow' minibatches ahead, sorts them by length
+// and cuts them into minibatches of similar-length sequences, which are returned in random order. This reduces the gaps,
+// at the cost of minibatches that are less mixed.
+// With 'timeStepSlack' > 0, the parallel sequences may be up to that fraction longer than the longest sequence, if this
+// lets the shorter sequences fill them more densely; the packer picks the length with the fewest columns (gaps included).
+// All streams of a sequence must have the same number of samples.
+class SequencePacker : public Packer
+{
+public:
+    SequencePacker(
+        MemoryProviderPtr memoryProvider,
+        TransformerPtr transformer,
+        size_t minibatchSize,
+        const std::vector<StreamDescriptionPtr>& streams,
+        size_t bucketingWindow = 0,
+        unsigned int randomSeed = 0,
+        double timeStepSlack = 0);
+
+    virtual Minibatch ReadMinibatch() override;
+
+private:
+    // All streams of a single sequence.
+    typedef std::vector<SequenceDataPtr> SequenceStreams;
+
+    // Reads the sequences of the next 'm_bucketingWindow' minibatches and groups them into m_buckets.
+    void FillBuckets();
+
+    // Copies the data of a sequence, so that it stays valid after the next call to GetNextSequences().
+    SequenceDataPtr CopySequence(const SequenceDataPtr& sequence, size_t streamIndex) const;
+
+    size_t GetNumberOfSamples(const SequenceDataPtr& sequence, size_t streamIndex) const;
+    size_t GetNumberOfSamples(const SequenceStreams& sequence) const;
+    size_t GetSampleSize(StreamDescriptionPtr stream) const;
+    // Copies the samples of a sequence into the columns (t * numParallelSequences + parallelSequence) of a zeroed buffer.
+    void CopySequenceToBuffer(const SequenceDataPtr& sequence, size_t streamIndex, size_t parallelSequence, size_t beginTime, size_t numParallelSequences, char* buffer) const;
+    char* GetStreamBuffer(size_t streamIndex, size_t size);
+    // First fit decreasing of the sequences in 'order' into parallel sequences of 'numTimeSteps'; returns the number of parallel sequences.
+    static size_t FitSequences(const std::vector<size_t>& lengths, const std::vector<size_t>& order, size_t numTimeSteps,
+                               std::vector<size_t>& parallelSequenceOf, std::vector<size_t>& beginTimeOf, std::vector<size_t>& parallelSequenceEnds);
+    Minibatch PackSequences(const std::vector<SequenceStreams>& sequences, bool endOfEpoch);
+
+    MemoryProviderPtr m_memoryProvider;
+    TransformerPtr m_transformer;
+    std::vector<StreamDescriptionPtr> m_outputStreams;
+    std::vector<StreamDescriptionPtr> m_inputStreams;
+
+    // Buffers are grown on demand, since the gaps make the size of a minibatch vary.
+    std::vector<std::shared_ptr<char>> m_streamBuffers;
+    std::vector<size_t> m_streamBufferSizes;
+
+    size_t m_minibatchSize;
+    size_t m_bucketingWindow;
+    double m_timeStepSlack;
+    std::mt19937 m_rng;
+
+    // Minibatches grouped by length that still have to be returned, and whether the transformer's epoch has ended.
+    std::vector<std::vector<SequenceStreams>> m_buckets;
+    bool m_transformerEndOfEpoch;
+
+    size_t m_nextSequenceId;
+};
+
+typedef std::shared_ptr<SequencePacker> SequencePackerPtr;
+} } }
@@ -0,0 +1,127 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#define _CRT_SECURE_NO_WARNINGS
+#include <algorithm>
+
+#include "ShuffleBufferRandomizer.h"
+#include "DataReader.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+ShuffleBufferRandomizer::ShuffleBufferRandomizer(IStreamingDataDeserializerPtr deserializer, size_t bufferSize)
+    : m_deserializer(deserializer),
+      m_bufferSize(bufferSize),
+      m_endOfStream(false),
+      m_rng(0),
+      m_samplePositionInEpoch(0)
+{
+    assert(deserializer != nullptr);
+    if (m_bufferSize == 0)
+    {
+        InvalidArgument("ShuffleBufferRandomizer: the buffer size must be at least one sequence.");
+    }
+
+    m_streams = m_deserializer->GetStreamDescriptions();
+    m_buffer.reserve(m_bufferSize);
+}
+
+void ShuffleBufferRandomizer::Initialize(TransformerPtr, const ConfigParameters&)
+{
+}
+
+void ShuffleBufferRandomizer::StartEpoch(const EpochConfiguration& config)
+{
+    // The position in the stream is kept, epochs consume consecutive parts of it.
+    m_config = config;
+    m_samplePositionInEpoch = 0;
+}
+
+bool ShuffleBufferRandomizer::GetNextSequence(std::vector<SequenceDataPtr>& sequence)
+{
+    while (!m_endOfStream && m_buffer.size() < m_bufferSize)
+    {
+        std::vector<SequenceDataPtr> next;
+        if (!m_deserializer->GetNextSequence(next))
+        {
+            m_endOfStream = true;
+            break;
+        }
+        m_buffer.push_back(std::move(next));
+    }
+
+    if (m_buffer.empty())
+    {
+        return false;
+    }
+
+    size_t index = std::uniform_int_distribution<size_t>(0, m_buffer.size() - 1)(m_rng);
+    std::swap(m_buffer[index], m_buffer.back());
+    sequence = std::move(m_buffer.back());
+    m_buffer.pop_back();
+    return true;
+}
+
+Sequences ShuffleBufferRandomizer::GetNextSequences(size_t sampleCount)
+{
+    Sequences result;
+    if (m_config.m_totalEpochSizeInSamples <= m_samplePositionInEpoch)
+    {
+        result.m_endOfEpoch = true;
+        return result;
+    }
+
+    // Sequences of the minibatch of all workers; at least one sequence is taken.
+    size_t maxSampleCount = std::min(sampleCount, m_config.m_totalEpochSizeInSamples - m_samplePositionInEpoch);
+    std::vector<std::vector<SequenceDataPtr>> sequences;
+    size_t samples = 0;
+    while (samples < maxSampleCount)
+    {
+        std::vector<SequenceDataPtr> sequence;
+        if (!GetNextSequence(sequence))
+        {
+            // Without an epoch size, the epoch ends with the stream.
+            m_config.m_totalEpochSizeInSamples = m_samplePositionInEpoch + samples;
+            result.m_endOfEpoch = true;
+            break;
+        }
+
+        size_t numberOfSamples = 0;
+        for (size_t j = 0; j < m_streams.size(); ++j)
+        {
+            size_t streamSamples = m_streams[j]->m_storageType == StorageType::dense
+                ? static_cast<const DenseSequenceData&>(*sequence[j]).m_numberOfSamples
+                : static_cast<const SparseSequenceData&>(*sequence[j]).m_indices.size();
+            numberOfSamples = std::max(numberOfSamples, streamSamples);
+        }
+        samples += numberOfSamples;
+        sequences.push_back(std::move(sequence));
+    }
+
+    m_samplePositionInEpoch += samples;
+    if (m_samplePositionInEpoch >= m_config.m_totalEpochSizeInSamples)
+    {
+        result.m_endOfEpoch = true;
+    }
+
+    size_t start = sequences.size() * m_config.m_workerRank / m_config.m_numberOfWorkers;
+    size_t end = sequences.size() * (m_config.m_workerRank + 1) / m_config.m_numberOfWorkers;
+    if (start == end)
+    {
+        return result;
+    }
+
+    result.m_data.resize(m_streams.size(), std::vector<SequenceDataPtr>(end - start));
+    for (size_t i = start; i < end; ++i)
+    {
+        for (size_t j = 0; j < m_streams.size(); ++j)
+        {
+            result.m_data[j][i - start] = sequences[i][j];
+        }
+    }
+    return result;
+}
+
+} } }
@@ -0,0 +1,52 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include <random>
+#include <vector>
+#include "Transformer.h"
+#include "DataDeserializer.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Randomizer over a streaming deserializer, whose data is read only once and whose size is not known in advance.
+// Sequences are taken at random from a buffer of 'bufferSize' sequences, which is refilled from the stream,
+// so sequences are only shuffled within the buffer. A buffer of size 1 keeps the order of the stream.
+// An epoch ends after the configured number of samples, or with the end of the stream if the epoch size is
+// requestDataSize. The following epoch continues with the rest of the stream.
+// All workers read the complete stream with the same random generator, and each one takes its stride of the sequences
+// of a minibatch, as the other randomizers do.
+class ShuffleBufferRandomizer : public Transformer
+{
+public:
+    ShuffleBufferRandomizer(IStreamingDataDeserializerPtr deserializer, size_t bufferSize);
+
+    virtual void Initialize(TransformerPtr next, const ConfigParameters& readerConfig) override;
+    virtual void StartEpoch(const EpochConfiguration& config) override;
+    virtual Sequences GetNextSequences(size_t sampleCount) override;
+    virtual std::vector<StreamDescriptionPtr> GetStreamDescriptions() const override
+    {
+        return m_streams;
+    }
+
+private:
+    // Refills the buffer and removes a random sequence from it, returns false at the end of the stream.
+    bool GetNextSequence(std::vector<SequenceDataPtr>& sequence);
+
+    IStreamingDataDeserializerPtr m_deserializer;
+    std::vector<StreamDescriptionPtr> m_streams;
+
+    size_t m_bufferSize;
+    std::vector<std::vector<SequenceDataPtr>> m_buffer;
+    bool m_endOfStream;
+    std::mt19937 m_rng;
+
+    // Epoch configuration
+    EpochConfiguration m_config;
+    size_t m_samplePositionInEpoch;
+};
+
+}}}
@@ -0,0 +1,244 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <set>
+#include "SyntheticDataDeserializer.h"
+#include "ElementTypeUtils.h"
+#include "StringUtil.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Appends a value in the element type of the stream.
+static void AppendValue(std::vector<char>& buffer, ElementType elementType, double value)
+{
+    size_t position = buffer.size();
+    buffer.resize(position + GetSizeByType(elementType));
+    if (elementType == ElementType::tfloat)
+    {
+        float f = (float)value;
+        memcpy(buffer.data() + position, &f, sizeof(f));
+    }
+    else
+    {
+        memcpy(buffer.data() + position, &value, sizeof(value));
+    }
+}
+
+// The sequences point into the pool; the chunk keeps it alive as long as they are referenced.
+class SyntheticDataChunk : public Chunk, public std::enable_shared_from_this<SyntheticDataChunk>
+{
+public:
+    SyntheticDataChunk(const std::vector<StreamDescriptionPtr>& streams, std::shared_ptr<const SyntheticDataDeserializer::Pool> pool)
+        : m_streams(streams), m_pool(pool)
+    {
+    }
+
+    virtual std::vector<SequenceDataPtr> GetSequence(size_t sequenceId) override
+    {
+        const auto& poolSequence = (*m_pool)[sequenceId % m_pool->size()];
+        std::vector<SequenceDataPtr> result;
+        result.reserve(m_streams.size());
+        for (size_t s = 0; s < m_streams.size(); ++s)
+        {
+            void* values = const_cast<char*>(poolSequence.m_values[s].data());
+            if (m_streams[s]->m_storageType == StorageType::dense)
+            {
+                auto sequence = std::make_shared<DenseSequenceData>();
+                sequence->m_numberOfSamples = poolSequence.m_numberOfSamples;
+                sequence->m_sampleLayout = m_streams[s]->m_sampleLayout;
+                sequence->m_data = values;
+                sequence->m_chunk = shared_from_this();
+                result.push_back(sequence);
+            }
+            else
+            {
+                auto sequence = std::make_shared<SparseSequenceData>();
+                sequence->m_indices = poolSequence.m_indices[s];
+                sequence->m_data = values;
+                sequence->m_chunk = shared_from_this();
+                result.push_back(sequence);
+            }
+        }
+        return result;
+    }
+
+private:
+    DISABLE_COPY_AND_MOVE(SyntheticDataChunk);
+
+    std::vector<StreamDescriptionPtr> m_streams;
+    std::shared_ptr<const SyntheticDataDeserializer::Pool> m_pool;
+};
+
+SyntheticDataDeserializer::SyntheticDataDeserializer(const ConfigParameters& config, ElementType elementType)
+{
+    if (elementType != ElementType::tfloat && elementType != ElementType::tdouble)
+    {
+        InvalidArgument("SyntheticDataDeserializer: only float and double elements are supported.");
+    }
+
+    size_t poolSize = config(L"poolSize", (size_t)1000);
+    size_t numSequences = config(L"numSequences", (size_t)100000);
+    m_sequencesPerChunk = config(L"sequencesPerChunk", (size_t)10000);
+    size_t sequenceLength = config(L"sequenceLength", (size_t)1);
+    size_t minSequenceLength = config(L"minSequenceLength", sequenceLength);
+    size_t maxSequenceLength = config(L"maxSequenceLength", sequenceLength);
+    unsigned int seed = config(L"seed", (unsigned int)0);
+    if (poolSize == 0 || numSequences == 0 || m_sequencesPerChunk == 0)
+    {
+        InvalidArgument("SyntheticDataDeserializer: poolSize, numSequences and sequencesPerChunk must be positive.");
+    }
+    if (minSequenceLength == 0 || minSequenceLength > maxSequenceLength)
+    {
+        InvalidArgument("SyntheticDataDeserializer: the sequence lengths [%d, %d] are invalid.", (int)minSequenceLength, (int)maxSequenceLength);
+    }
+
+    // Streams, and the non-zeros per sample of the sparse ones.
+    std::vector<size_t> nonZerosPerSample;
+    for (const std::pair<std::string, ConfigParameters>& section : config)
+    {
+        if (!section.second.ExistsCurrent("dim"))
+        {
+            continue;
+        }
+
+        const ConfigParameters& streamConfig = section.second;
+        size_t dim = streamConfig(L"dim");
+        std::string storage = streamConfig(L"storage", "dense");
+        if (dim == 0)
+        {
+            InvalidArgument("SyntheticDataDeserializer: stream '%s' has no dimension.", section.first.c_str());
+        }
+
+        auto stream = std::make_shared<StreamDescription>();
+        stream->m_id = m_streams.size();
+        stream->m_name = msra::strfun::utf16(section.first);
+        stream->m_elementType = elementType;
+        stream->m_sampleLayout = std::make_shared<TensorShape>(dim);
+        if (AreEqualIgnoreCase(storage, "dense"))
+        {
+            stream->m_storageType = StorageType::dense;
+            nonZerosPerSample.push_back(0);
+        }
+        else if (AreEqualIgnoreCase(storage, "sparse"))
+        {
+            stream->m_storageType = StorageType::sparse_csc;
+            double density = streamConfig(L"density", 0.0);
+            size_t nonZeros = (size_t)std::floor(density * dim + 0.5);
+            nonZerosPerSample.push_back(std::min(std::max(nonZeros, (size_t)1), dim));
+        }
+        else
+        {
+            InvalidArgument("SyntheticDataDeserializer: stream '%s' has storage '%s', expected 'dense' or 'sparse'.", section.first.c_str(), storage.c_str());
+        }
+        m_streams.push_back(stream);
+    }
+    if (m_streams.empty())
+    {
+        InvalidArgument("SyntheticDataDeserializer: no streams are configured, a stream is a section with a 'dim'.");
+    }
+
+    // The pool is generated once; its size bounds the memory, whatever the size of the corpus.
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<size_t> length(minSequenceLength, maxSequenceLength);
+    std::uniform_real_distribution<double> value(0.0, 1.0);
+    auto pool = std::make_shared<Pool>(poolSize);
+    for (auto& sequence : *pool)
+    {
+        sequence.m_numberOfSamples = length(rng);
+        sequence.m_values.resize(m_streams.size());
+        sequence.m_indices.resize(m_streams.size());
+        for (size_t s = 0; s < m_streams.size(); ++s)
+        {
+            size_t dim = m_streams[s]->m_sampleLayout->GetNumElements();
+            auto& values = sequence.m_values[s];
+            if (m_streams[s]->m_storageType == StorageType::dense)
+            {
+                values.reserve(sequence.m_numberOfSamples * dim * GetSizeByType(elementType));
+                for (size_t i = 0; i < sequence.m_numberOfSamples * dim; ++i)
+                {
+                    AppendValue(values, elementType, value(rng));
+                }
+                continue;
+            }
+
+            std::uniform_int_distribution<size_t> row(0, dim - 1);
+            sequence.m_indices[s].resize(sequence.m_numberOfSamples);
+            for (auto& indices : sequence.m_indices[s])
+            {
+                std::set<size_t> rows;
+                while (rows.size() < nonZerosPerSample[s])
+                {
+                    rows.insert(row(rng));
+                }
+                indices.assign(rows.begin(), rows.end());
+                for (size_t i = 0; i < indices.size(); ++i)
+                {
+                    AppendValue(values, elementType, 1.0);
+                }
+            }
+        }
+    }
+    m_pool = pool;
+
+    m_sequenceDescriptions.reserve(numSequences);
+    for (size_t i = 0; i < numSequences; ++i)
+    {
+        SequenceDescription description;
+        description.m_id = i;
+        description.m_numberOfSamples = (*m_pool)[i % poolSize].m_numberOfSamples;
+        description.m_chunkId = i / m_sequencesPerChunk;
+        description.m_isValid = true;
+        description.m_key.major = L"";
+        description.m_key.minor = i;
+        m_sequenceDescriptions.push_back(description);
+    }
+    m_sequences.reserve(m_sequenceDescriptions.size());
+    for (const auto& description : m_sequenceDescriptions)
+    {
+        m_sequences.push_back(&description);
+    }
+
+    fprintf(stderr, "SyntheticDataDeserializer: %d sequences in %d chunks, repeating a pool of %d sequences of %d to %d samples, %d streams\n",
+            (int)m_sequences.size(), (int)GetTotalNumberOfChunks(), (int)poolSize, (int)minSequenceLength, (int)maxSequenceLength, (int)m_streams.size());
+}
+
+std::vector<StreamDescriptionPtr> SyntheticDataDeserializer::GetStreamDescriptions() const
+{
+    return m_streams;
+}
+
+const SequenceDescriptions& SyntheticDataDeserializer::GetSequenceDescriptions() const
+{
+    return m_sequences;
+}
+
+const SequenceDescription* SyntheticDataDeserializer::GetSequenceDescriptionByKey(const KeyType& key)
+{
+    if (!key.major.empty() || key.minor >= m_sequenceDescriptions.size())
+    {
+        return nullptr;
+    }
+    return &m_sequenceDescriptions[key.minor];
+}
+
+size_t SyntheticDataDeserializer::GetTotalNumberOfChunks()
+{
+    return (m_sequenceDescriptions.size() + m_sequencesPerChunk - 1) / m_sequencesPerChunk;
+}
+
+ChunkPtr SyntheticDataDeserializer::GetChunk(size_t chunkId)
+{
+    if (chunkId >= GetTotalNumberOfChunks())
+    {
+        LogicError("SyntheticDataDeserializer: chunk %d does not exist.", (int)chunkId);
+    }
+    return std::make_shared<SyntheticDataChunk>(m_streams, m_pool);
+}
+} } }
@@ -0,0 +1,53 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include <memory>
+#include <vector>
+#include "DataDeserializer.h"
+#include "Config.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Deserializer of synthetic data, to measure the compute throughput of a network without the cost of reading its data.
+// The streams are the sections of the config that have a "dim": "dense" streams have values uniform in [0, 1);
+// "sparse" ones have round("density" * dim) non-zeros per sample, at least one, all of value 1 (i.e. by default
+// one-hot). A pool of "poolSize" sequences is generated up front, with lengths uniform in
+// ["minSequenceLength", "maxSequenceLength"] (both "sequenceLength", 1 by default); the "numSequences" sequences of
+// the corpus repeat the pool, in chunks of "sequencesPerChunk". The chunks and sequences point into the pool, so no values
+// are generated or copied when they are requested. All streams of a sequence have the same number of samples.
+// Sequence keys are { L"", sequence id }.
+class SyntheticDataDeserializer : public IDataDeserializer
+{
+public:
+    SyntheticDataDeserializer(const ConfigParameters& config, ElementType elementType);
+
+    virtual std::vector<StreamDescriptionPtr> GetStreamDescriptions() const override;
+    virtual const SequenceDescriptions& GetSequenceDescriptions() const override;
+    virtual const SequenceDescription* GetSequenceDescriptionByKey(const KeyType& key) override;
+    virtual size_t GetTotalNumberOfChunks() override;
+    virtual ChunkPtr GetChunk(size_t chunkId) override;
+
+    // The sequences of the pool; sequence i of the corpus is pool sequence i % pool size.
+    struct PoolSequence
+    {
+        size_t m_numberOfSamples;
+        std::vector<std::vector<char>> m_values;                 // [stream]: the samples of a dense stream, the non-zeros of a sparse one
+        std::vector<std::vector<std::vector<size_t>>> m_indices; // [stream][sample]: the rows of the non-zeros of a sparse stream
+    };
+    typedef std::vector<PoolSequence> Pool;
+
+private:
+    DISABLE_COPY_AND_MOVE(SyntheticDataDeserializer);
+
+    std::vector<StreamDescriptionPtr> m_streams;
+    std::shared_ptr<const Pool> m_pool; // shared with the chunks
+    size_t m_sequencesPerChunk;
+
+    std::vector<SequenceDescription> m_sequenceDescriptions;
+    SequenceDescriptions m_sequences;
+};
+} } }
@@ -5,9 +5,11 @@
 
 #pragma once
 
+#include <algorithm>
 #include <set>
 
 #include "Transformer.h"
+#include "PipelineStatistics.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -26,6 +28,8 @@ public:
     virtual void StartEpoch(const EpochConfiguration &config) override
     {
         assert(m_next != nullptr);
+        m_epochIndex = config.m_epochIndex;
+        m_sequencePosition = 0;
         m_next->StartEpoch(config);
     }
 
@@ -37,31 +41,62 @@ public:
 
     // Gets next sequences up to a maximum count of samples.
     // Sequences contains data for all streams.
+    // Consecutive transformers run as a single stage: the sequences are taken from the first upstream
+    // that is not a TransformerBase, and each sequence passes through the whole chain on one thread.
+    // So there is one parallel loop per minibatch instead of one per transformer and stream, and each
+    // transformation finds the sequence in the cache of the thread that produced it.
     virtual Sequences GetNextSequences(size_t sampleCount) override
     {
         assert(m_next != nullptr);
-        Sequences samples = m_next->GetNextSequences(sampleCount);
+        std::vector<TransformerBase*> chain{ this };
+        Transformer* source = m_next.get();
+        for (auto upstream = dynamic_cast<TransformerBase*>(source); upstream != nullptr; upstream = dynamic_cast<TransformerBase*>(source))
+        {
+            chain.push_back(upstream);
+            source = upstream->m_next.get();
+        }
+        std::reverse(chain.begin(), chain.end());
 
+        Sequences samples = source->GetNextSequences(sampleCount);
         if (samples.m_data.empty())
         {
             return samples;
         }
 
-        const auto &appliedStreamIds = GetAppliedStreamIds();
-        const auto &outputStreams = GetOutputStreams();
+        PipelineStageTimer timer(PipelineStage::transform);
 
-        // TODO: Move parallelization on the outer loop with collapse.
-        for (int j = 0; j < appliedStreamIds.size(); ++j)
+        // The streams any transformer of the chain applies to, the others pass through untouched.
+        std::vector<size_t> streamIds;
+        for (auto transformer : chain)
         {
-            size_t streamId = appliedStreamIds[j];
-            auto& allSamples = samples.m_data[streamId];
+            for (auto streamId : transformer->GetAppliedStreamIds())
+            {
+                if (std::find(streamIds.begin(), streamIds.end(), streamId) == streamIds.end())
+                {
+                    streamIds.push_back(streamId);
+                }
+            }
+        }
 
-#pragma omp parallel for ordered schedule(dynamic)
-            for (int i = 0; i < allSamples.size(); ++i)
+        // The results are stored by index, so the order of the sequences is preserved.
+        const size_t numberOfSequences = samples.m_data.front().size();
+        const int count = static_cast<int>(streamIds.size() * numberOfSequences);
+#pragma omp parallel for schedule(dynamic)
+        for (int k = 0; k < count; ++k)
+        {
+            size_t streamId = streamIds[k / numberOfSequences];
+            size_t i = k % numberOfSequences;
+            auto& sequence = samples.m_data[streamId][i];
+            for (auto transformer : chain)
             {
-                allSamples[i] = Apply(allSamples[i], *m_inputStreams[streamId], *outputStreams[streamId]);
+                sequence = transformer->ApplyToStream(sequence, streamId, i);
             }
         }
+
+        for (auto transformer : chain)
+        {
+            transformer->m_sequencePosition += numberOfSequences;
+        }
         return samples;
     }
 
@@ -77,15 +112,38 @@ protected:
         return m_inputStreams;
     }
 
+    // Index of the current epoch.
+    size_t GetEpochIndex() const
+    {
+        return m_epochIndex;
+    }
+
 private:
+    // Applies the transformation to the i-th sequence of the current minibatch if the stream is transformed.
+    SequenceDataPtr ApplyToStream(const SequenceDataPtr& sequence, size_t streamId, size_t i)
+    {
+        const auto &appliedStreamIds = GetAppliedStreamIds();
+        if (std::find(appliedStreamIds.begin(), appliedStreamIds.end(), streamId) == appliedStreamIds.end())
+        {
+            return sequence;
+        }
+
+        return Apply(sequence, *m_inputStreams[streamId], *GetOutputStreams()[streamId], m_sequencePosition + i);
+    }
+
     // Applies transformation to the sequence.
+    // The sequence position is the index of the sequence in the current epoch; it does not depend on the thread
+    // the sequence is transformed on, so it can be used to make random transformations reproducible.
     virtual SequenceDataPtr Apply(SequenceDataPtr inputSequence,
                                   const StreamDescription &inputStream,
-                                  const StreamDescription &outputStream) = 0;
+                                  const StreamDescription &outputStream,
+                                  size_t sequencePosition) = 0;
 
     TransformerPtr m_next;
     std::vector<StreamId> m_featureStreamIds;
     std::vector<StreamDescriptionPtr> m_inputStreams;
+    size_t m_epochIndex = 0;
+    size_t m_sequencePosition = 0;
 };
 
 }}}
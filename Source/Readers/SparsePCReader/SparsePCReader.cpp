@@ -9,6 +9,7 @@
 #define DATAREADER_EXPORTS // creating the exports here
 #include "DataReader.h"
 #include "SparsePCReader.h"
+#include "fileutil.h"
 #ifdef LEAKDETECT
 #include <vld.h> // leak detection
 #endif
@@ -30,43 +31,24 @@ DWORD LODWORD(size_t size)
     return size & 0xFFFFFFFF;
 }
 
+// The blocked file (see WriteBlockedFile()) starts with a header of six int32: the magic number, the version, the block size,
+// the number of features, sizeof(ElemType), and 0. Each block consists of
+//  - int32 number of samples n, int32 0
+//  - for each feature: int32 nnz, int32 0, ElemType values[nnz], int32 rowIndices[nnz], int32 colStarts[n + 1]
+//  - ElemType labels[n]
+// where each array is padded to a multiple of 8 bytes, so that the arrays of a block can be used as they are mapped.
+static const int32_t s_blockedFileMagic = 0x4b4c4253; // "SBLK"
+static const int32_t s_blockedFileVersion = 1;
+
+static int64_t Align8(int64_t size)
+{
+    return (size + 7) & ~(int64_t) 7;
+}
+
 template <class ElemType>
 SparsePCReader<ElemType>::~SparsePCReader()
 {
-#ifdef SPARSE_PCREADER_USE_WINDOWS_API
-    if (m_filemap != NULL)
-    {
-        UnmapViewOfFile(m_filemap);
-    }
-
-    if (m_dataBuffer != NULL)
-    {
-        UnmapViewOfFile(m_dataBuffer);
-    }
-
-    CloseHandle(m_hndl);
-#else
-    munmap(m_dataBuffer, m_filePositionMax); 
-    close(m_hndl);
-#endif
-    for (int i = 0; i < m_featureCount; i++)
-    {
-        if (m_values[i] != NULL)
-        {
-            free(m_values[i]);
-        }
-
-        if (m_rowIndices[i] != NULL)
-        {
-            free(m_rowIndices[i]);
-        }
-
-        if (m_colIndices[i] != NULL)
-        {
-            free(m_colIndices[i]);
-        }
-    }
-
+    UnmapFile();
     if (m_labelsBuffer != NULL)
     {
         free(m_labelsBuffer);
@@ -95,8 +77,8 @@ void SparsePCReader<ElemType>::InitFromConfig(const ConfigRecordType& readerConf
     m_maxReadData = readerConfig(L"maxReadData", (size_t) 0);
     m_doGradientCheck = readerConfig(L"gradientCheck", false);
     m_returnDense = readerConfig(L"returnDense", false);
-    m_sparsenessFactor = readerConfig(L"sparsenessFactor", (size_t) 50); // We don't expect more than one in 50 input positions to have non-zero values
     m_verificationCode = (int32_t) readerConfig(L"verificationCode", (size_t) 0);
+    m_blockSize = readerConfig(L"blockSize", (size_t) 0);
 
     std::vector<std::wstring> featureNames;
     std::vector<std::wstring> labelNames;
@@ -119,9 +101,7 @@ void SparsePCReader<ElemType>::InitFromConfig(const ConfigRecordType& readerConf
 
     m_featureNames = std::vector<std::wstring>(m_featureCount);
     m_dims = std::vector<size_t>(m_featureCount);
-    m_values = std::vector<ElemType*>(m_featureCount);
-    m_rowIndices = std::vector<int32_t*>(m_featureCount);
-    m_colIndices = std::vector<int32_t*>(m_featureCount);
+    m_featureStaging.resize(m_featureCount);
 
     for (int i = 0; i < m_featureCount; i++)
     {
@@ -136,12 +116,40 @@ void SparsePCReader<ElemType>::InitFromConfig(const ConfigRecordType& readerConf
         m_dims[i] = featureConfig("dim");
     }
 
+    MapFile(m_file);
+    m_dataStart = 0;
+
+    // with a block size, the file is read as blocks of samples, from a copy in the blocked format that is made once
+    if (m_blockSize > 0)
+    {
+        std::wstring blockedFile = msra::strfun::wstrprintf(L"%ls.block%d", m_file.c_str(), (int) m_blockSize);
+        if (!fexists(blockedFile))
+        {
+            fprintf(stderr, "SparsePCReader: Writing the samples of %ls in blocks of %d to %ls\n", m_file.c_str(), (int) m_blockSize, blockedFile.c_str());
+            WriteBlockedFile(blockedFile);
+        }
+        UnmapFile();
+        MapFile(blockedFile);
+
+        const int32_t* header = (const int32_t*) m_dataBuffer;
+        m_dataStart = 6 * sizeof(int32_t);
+        if (m_filePositionMax < m_dataStart || header[0] != s_blockedFileMagic || header[1] != s_blockedFileVersion)
+            RuntimeError("SparsePCReader: %ls is not a blocked file.", blockedFile.c_str());
+        if (header[2] != (int32_t) m_blockSize || header[3] != (int32_t) m_featureCount || header[4] != (int32_t) sizeof(ElemType))
+            RuntimeError("SparsePCReader: %ls was written for %d features and %d-byte values, it does not match the configuration; delete it to have it written again.",
+                         blockedFile.c_str(), (int) header[3], (int) header[4]);
+    }
+}
+
+template <class ElemType>
+void SparsePCReader<ElemType>::MapFile(const std::wstring& fileName)
+{
 #ifdef SPARSE_PCREADER_USE_WINDOWS_API
-    m_hndl = CreateFile(m_file.c_str(), GENERIC_READ,
+    m_hndl = CreateFile(fileName.c_str(), GENERIC_READ,
                         FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
     if (m_hndl == INVALID_HANDLE_VALUE)
     {
-        RuntimeError("Unable to Open/Create file %ls, error %x", m_file.c_str(), GetLastError());
+        RuntimeError("Unable to Open/Create file %ls, error %x", fileName.c_str(), GetLastError());
     }
 
     GetFileSizeEx(m_hndl, (PLARGE_INTEGER) &m_filePositionMax);
@@ -153,23 +161,165 @@ void SparsePCReader<ElemType>::InitFromConfig(const ConfigRecordType& readerConf
                                          LODWORD(0),
                                          0);
 #else
-    m_hndl = open(msra::strfun::utf8(m_file).c_str(), O_RDONLY);
+    m_hndl = open(msra::strfun::utf8(fileName).c_str(), O_RDONLY);
     if (m_hndl == -1)
-        RuntimeError("Unable to Open/Create file %ls", m_file.c_str());
+        RuntimeError("Unable to Open/Create file %ls", fileName.c_str());
     struct stat sb;
     if (fstat(m_hndl, &sb) == -1)
-        RuntimeError("Unable to Retrieve file size for file %ls", m_file.c_str());
+        RuntimeError("Unable to Retrieve file size for file %ls", fileName.c_str());
     m_filePositionMax = sb.st_size;
     m_dataBuffer = (char*) mmap(nullptr, m_filePositionMax, PROT_READ, MAP_PRIVATE, m_hndl, 0);
     if (m_dataBuffer == MAP_FAILED)
     {
         m_dataBuffer = nullptr;
-        RuntimeError("Could not memory map file %ls", m_file.c_str());
+        RuntimeError("Could not memory map file %ls", fileName.c_str());
     }
 
 #endif
 }
 
+template <class ElemType>
+void SparsePCReader<ElemType>::UnmapFile()
+{
+    if (m_dataBuffer == NULL)
+        return;
+#ifdef SPARSE_PCREADER_USE_WINDOWS_API
+    if (m_filemap != NULL)
+    {
+        UnmapViewOfFile(m_filemap);
+    }
+
+    UnmapViewOfFile(m_dataBuffer);
+
+    CloseHandle(m_hndl);
+#else
+    munmap(m_dataBuffer, m_filePositionMax);
+    close(m_hndl);
+#endif
+    m_dataBuffer = NULL;
+}
+
+template <class ElemType>
+template <class AppendFeature>
+int64_t SparsePCReader<ElemType>::ReadSample(int64_t offset, ElemType& label, const AppendFeature& appendFeature) const
+{
+    for (int i = 0; i < m_featureCount; i++)
+    {
+        int32_t nnz = *(int32_t*) ((char*) m_dataBuffer + offset);
+        offset += sizeof(int32_t);
+
+        if (nnz < 0 || nnz > m_dims[i])
+            RuntimeError("Invalid number of values %d for a feature of dimension %d - error in reading data", (int) nnz, (int) m_dims[i]);
+
+        const ElemType* values = (const ElemType*) ((char*) m_dataBuffer + offset);
+        offset += (sizeof(ElemType) * nnz);
+
+        const int32_t* rowIndices = (const int32_t*) ((char*) m_dataBuffer + offset);
+        offset += (sizeof(int32_t) * nnz);
+
+        appendFeature(i, values, rowIndices, (size_t) nnz);
+    }
+
+    label = *(ElemType*) ((char*) m_dataBuffer + offset);
+    offset += sizeof(ElemType);
+
+    if (m_verificationCode != 0)
+    {
+        int32_t verifCode = *(int32_t*) ((char*) m_dataBuffer + offset);
+
+        if (verifCode != m_verificationCode)
+            RuntimeError("Verification code did not match (expected %d) - error in reading data", m_verificationCode);
+
+        offset += sizeof(int32_t);
+    }
+    return offset;
+}
+
+template <class ElemType>
+void SparsePCReader<ElemType>::WriteBlockedFile(const std::wstring& fileName) const
+{
+    std::vector<std::vector<ElemType>> values(m_featureCount);
+    std::vector<std::vector<CPUSPARSE_INDEX_TYPE>> rowIndices(m_featureCount);
+    std::vector<std::vector<CPUSPARSE_INDEX_TYPE>> colStarts(m_featureCount);
+    std::vector<ElemType> labels;
+    const char padding[8] = {0};
+    auto writePadded = [&](const void* data, size_t size, FILE* f)
+    {
+        if (size > 0)
+            fwriteOrDie(data, 1, size, f);
+        fwriteOrDie(padding, 1, Align8(size) - size, f);
+    };
+
+    // written under a temporary name, so that an incomplete file is never taken for the blocked file
+    std::wstring partialFileName = fileName + L".partial";
+    FILE* f = fopenOrDie(partialFileName, L"wb");
+    int32_t header[6] = {s_blockedFileMagic, s_blockedFileVersion, (int32_t) m_blockSize, (int32_t) m_featureCount, (int32_t) sizeof(ElemType), 0};
+    fwriteOrDie(header, sizeof(header), 1, f);
+    for (int64_t offset = 0; offset < m_filePositionMax;)
+    {
+        labels.clear();
+        for (int i = 0; i < m_featureCount; i++)
+        {
+            values[i].clear();
+            rowIndices[i].clear();
+            colStarts[i].assign(1, 0);
+        }
+        while (labels.size() < m_blockSize && offset < m_filePositionMax)
+        {
+            ElemType label;
+            offset = ReadSample(offset, label, [&](int i, const ElemType* sampleValues, const int32_t* sampleRowIndices, size_t nnz)
+            {
+                values[i].insert(values[i].end(), sampleValues, sampleValues + nnz);
+                rowIndices[i].insert(rowIndices[i].end(), sampleRowIndices, sampleRowIndices + nnz);
+                colStarts[i].push_back((CPUSPARSE_INDEX_TYPE) values[i].size());
+            });
+            labels.push_back(label);
+        }
+
+        int32_t blockHeader[2] = {(int32_t) labels.size(), 0};
+        fwriteOrDie(blockHeader, sizeof(blockHeader), 1, f);
+        for (int i = 0; i < m_featureCount; i++)
+        {
+            int32_t featureHeader[2] = {(int32_t) values[i].size(), 0};
+            fwriteOrDie(featureHeader, sizeof(featureHeader), 1, f);
+            writePadded(values[i].data(), sizeof(ElemType) * values[i].size(), f);
+            writePadded(rowIndices[i].data(), sizeof(CPUSPARSE_INDEX_TYPE) * rowIndices[i].size(), f);
+            writePadded(colStarts[i].data(), sizeof(CPUSPARSE_INDEX_TYPE) * colStarts[i].size(), f);
+        }
+        writePadded(labels.data(), sizeof(ElemType) * labels.size(), f);
+    }
+    fcloseOrDie(f);
+    renameOrDie(partialFileName, fileName);
+}
+
+template <class ElemType>
+int64_t SparsePCReader<ElemType>::ReadBlock(int64_t offset, Block& block) const
+{
+    const char* data = (const char*) m_dataBuffer;
+    block.numSamples = *(const int32_t*) (data + offset);
+    offset += 2 * sizeof(int32_t);
+    block.nnz.resize(m_featureCount);
+    block.values.resize(m_featureCount);
+    block.rowIndices.resize(m_featureCount);
+    block.colStarts.resize(m_featureCount);
+    for (int i = 0; i < m_featureCount; i++)
+    {
+        block.nnz[i] = *(const int32_t*) (data + offset);
+        offset += 2 * sizeof(int32_t);
+        block.values[i] = (const ElemType*) (data + offset);
+        offset += Align8(sizeof(ElemType) * block.nnz[i]);
+        block.rowIndices[i] = (const CPUSPARSE_INDEX_TYPE*) (data + offset);
+        offset += Align8(sizeof(CPUSPARSE_INDEX_TYPE) * block.nnz[i]);
+        block.colStarts[i] = (const CPUSPARSE_INDEX_TYPE*) (data + offset);
+        offset += Align8(sizeof(CPUSPARSE_INDEX_TYPE) * (block.numSamples + 1));
+    }
+    block.labels = (const ElemType*) (data + offset);
+    offset += Align8(sizeof(ElemType) * block.numSamples);
+    if (offset > m_filePositionMax)
+        RuntimeError("SparsePCReader: The blocked file is truncated.");
+    return offset;
+}
+
 //StartMinibatchLoop - Startup a minibatch loop
 // mbSize - [in] size of the minibatch (number of Samples, etc.)
 // epoch - [in] epoch number for this loop --ignored
@@ -177,29 +327,21 @@ void SparsePCReader<ElemType>::InitFromConfig(const ConfigRecordType& readerConf
 template <class ElemType>
 void SparsePCReader<ElemType>::StartMinibatchLoop(size_t mbSize, size_t /*epoch*/, size_t /*requestedEpochSamples*/)
 {
-    if (m_values[0] == NULL || m_miniBatchSize != mbSize)
+    if (m_blockSize > 0 && mbSize % m_blockSize != 0)
+        InvalidArgument("SparsePCReader: The minibatch size %d must be a multiple of blockSize (%d).", (int) mbSize, (int) m_blockSize);
+
+    // the sparse features are staged in buffers that grow as needed, see GetMinibatch()
+    if (m_labelsBuffer == NULL || m_miniBatchSize != mbSize)
     {
         m_miniBatchSize = mbSize;
 
-        for (int i = 0; i < m_featureCount; i++)
-        {
-            if (m_values[i] != NULL)
-            {
-                free(m_values[i]);
-                free(m_colIndices[i]);
-                free(m_rowIndices[i]);
-                free(m_labelsBuffer);
-            }
-
-            m_values[i] = (ElemType*) malloc(sizeof(ElemType) * m_dims[i] * m_miniBatchSize / m_sparsenessFactor);
-            m_rowIndices[i] = (int32_t*) malloc(sizeof(int32_t) * m_dims[i] * m_miniBatchSize / m_sparsenessFactor);
-            m_colIndices[i] = (int32_t*) malloc(sizeof(int32_t) * (m_miniBatchSize + 1));
-            m_labelsBuffer = (ElemType*) malloc(sizeof(ElemType) * m_miniBatchSize);
-        }
+        if (m_labelsBuffer != NULL)
+            free(m_labelsBuffer);
+        m_labelsBuffer = (ElemType*) malloc(sizeof(ElemType) * m_miniBatchSize);
     }
 
     // reset the next read sample
-    m_currOffset = 0;
+    m_currOffset = m_dataStart;
 }
 
 // GetMinibatch - Get the next minibatch (features and labels)
@@ -228,64 +370,60 @@ bool SparsePCReader<ElemType>::GetMinibatch(StreamMinibatchInputs& matrices)
             RuntimeError("SparsePCReader only supports single label value per column but the network expected %d.", (int) labels->GetNumRows());
     }
 
-    std::vector<int32_t> currIndex = std::vector<int32_t>(m_featureCount);
-    for (int i = 0; i < m_featureCount; i++)
+    size_t j = 0;
+    const ElemType* labelValues = m_labelsBuffer;
+    if (m_blockSize > 0 && m_blockSize == m_miniBatchSize)
     {
-        currIndex[i] = 0;
+        // the minibatch is a block, whose CSC arrays are set as they are in the mapped file
+        Block block;
+        m_currOffset = ReadBlock(m_currOffset, block);
+        for (int i = 0; i < m_featureCount; i++)
+        {
+            Matrix<ElemType>& features = matrices.GetInputMatrix<ElemType>(m_featureNames[i]);
+            if (features.GetMatrixType() != MatrixType::SPARSE || features.GetFormat() != matrixFormatSparseCSC)
+                features.SwitchToMatrixType(MatrixType::SPARSE, matrixFormatSparseCSC, false);
+            features.SetMatrixFromCSCFormat(block.colStarts[i], block.rowIndices[i], block.values[i], block.nnz[i], m_dims[i], block.numSamples);
+        }
+        j = block.numSamples;
+        labelValues = block.labels;
     }
-
-    size_t j = 0;
-
-    for (j = 0; j < m_miniBatchSize && m_currOffset < m_filePositionMax; j++)
+    else
     {
+        // append the samples to the staging buffers, on the device of the feature matrices (page-locked for a GPU)
         for (int i = 0; i < m_featureCount; i++)
         {
-            m_colIndices[i][j] = currIndex[i];
-
-            int32_t nnz = *(int32_t*) ((char*) m_dataBuffer + m_currOffset);
-            m_currOffset += sizeof(int32_t);
+            DEVICEID_TYPE deviceId = matrices.GetInputMatrix<ElemType>(m_featureNames[i]).GetDeviceId();
+            if (!m_featureStaging[i] || m_featureStaging[i]->GetDeviceId() != deviceId)
+                m_featureStaging[i].reset(new SparseStagingBuffer<ElemType>(deviceId));
+            m_featureStaging[i]->Clear();
+        }
 
-            if (nnz > m_dims[i] / m_sparsenessFactor)
+        if (m_blockSize == 0)
+        {
+            for (j = 0; j < m_miniBatchSize && m_currOffset < m_filePositionMax; j++)
             {
-                RuntimeError("Input data is too dense - not enough memory allocated");
+                m_currOffset = ReadSample(m_currOffset, m_labelsBuffer[j], [this](int i, const ElemType* values, const int32_t* rowIndices, size_t nnz)
+                {
+                    m_featureStaging[i]->AppendColumn(values, rowIndices, nnz);
+                });
             }
-
-            memcpy(m_values[i] + currIndex[i], (char*) m_dataBuffer + m_currOffset, sizeof(ElemType) * nnz);
-            m_currOffset += (sizeof(ElemType) * nnz);
-
-            memcpy(m_rowIndices[i] + currIndex[i], (char*) m_dataBuffer + m_currOffset, sizeof(int32_t) * nnz);
-            m_currOffset += (sizeof(int32_t) * nnz);
-
-            currIndex[i] += nnz;
         }
-
-        ElemType label = *(ElemType*) ((char*) m_dataBuffer + m_currOffset);
-        m_labelsBuffer[j] = label;
-        m_currOffset += sizeof(ElemType);
-
-        if (m_verificationCode != 0)
+        else
         {
-            int32_t verifCode = *(int32_t*) ((char*) m_dataBuffer + m_currOffset);
-
-            if (verifCode != m_verificationCode)
+            // several blocks, each appended as a whole
+            Block block;
+            while (j < m_miniBatchSize && m_currOffset < m_filePositionMax)
             {
-                RuntimeError("Verification code did not match (expected %d) - error in reading data", m_verificationCode);
-                return false;
+                m_currOffset = ReadBlock(m_currOffset, block);
+                for (int i = 0; i < m_featureCount; i++)
+                    m_featureStaging[i]->AppendColumns(block.values[i], block.rowIndices[i], block.colStarts[i], block.numSamples);
+                memcpy(m_labelsBuffer + j, block.labels, sizeof(ElemType) * block.numSamples);
+                j += block.numSamples;
             }
-
-            m_currOffset += sizeof(int32_t);
         }
-    }
 
-    for (int i = 0; i < m_featureCount; i++)
-    {
-        m_colIndices[i][j] = currIndex[i];
-        Matrix<ElemType>& features = matrices.GetInputMatrix<ElemType>(m_featureNames[i]);
-
-        if (features.GetFormat() != MatrixFormat::matrixFormatSparseCSC)
-            features.SwitchToMatrixType(MatrixType::SPARSE, MatrixFormat::matrixFormatSparseCSC, false);
-
-        features.SetMatrixFromCSCFormat(m_colIndices[i], m_rowIndices[i], m_values[i], currIndex[i], m_dims[i], j);
+        for (int i = 0; i < m_featureCount; i++)
+            m_featureStaging[i]->TransferTo(matrices.GetInputMatrix<ElemType>(m_featureNames[i]), m_dims[i]);
     }
 
     if (m_returnDense || m_doGradientCheck)
@@ -298,7 +436,7 @@ bool SparsePCReader<ElemType>::GetMinibatch(StreamMinibatchInputs& matrices)
     {
         labels->Resize(1, j);
         labels->SetValue((ElemType) 0);
-        labels->SetValue(1, j, labels->GetDeviceId(), m_labelsBuffer, 0);
+        labels->SetValue(1, j, labels->GetDeviceId(), const_cast<ElemType*>(labelValues), 0);
     }
 
     // create the MBLayout
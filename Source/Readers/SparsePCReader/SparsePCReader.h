@@ -9,6 +9,8 @@
 #include "DataWriter.h"
 #include "Config.h"
 #include "RandomOrdering.h"
+#include "SparseStagingBuffer.h"
+#include <memory>
 #include <string>
 #include <map>
 #include <vector>
@@ -34,11 +36,9 @@ class SparsePCReader : public IDataReader
     int64_t m_maxReadData; // For early exit during debugging
     bool m_doGradientCheck;
     bool m_returnDense;
-    size_t m_sparsenessFactor;
     int32_t m_verificationCode;
-    std::vector<ElemType*> m_values;
-    std::vector<int32_t*> m_rowIndices;
-    std::vector<int32_t*> m_colIndices;
+    size_t m_blockSize; // samples per block of the blocked file that is read instead of m_file (see WriteBlockedFile()), 0 to read m_file
+    std::vector<std::unique_ptr<SparseStagingBuffer<ElemType>>> m_featureStaging; // [feature], made for the device of the feature matrix
     ElemType* m_labelsBuffer;
     MBLayoutPtr m_pMBLayout;
 
@@ -51,15 +51,42 @@ class SparsePCReader : public IDataReader
     void* m_dataBuffer;
    
     int64_t m_filePositionMax;
+    int64_t m_dataStart; // offset of the first sample, or block
     int64_t m_currOffset;
     int m_traceLevel;
 
     std::map<LabelIdType, LabelType> m_mapIdToLabel;
     std::map<LabelType, LabelIdType> m_mapLabelToId;
 
+    // the CSC arrays of the samples of a block, which point into the mapped file
+    struct Block
+    {
+        size_t numSamples;
+        std::vector<size_t> nnz;                                // [feature]
+        std::vector<const ElemType*> values;                    // [feature]
+        std::vector<const CPUSPARSE_INDEX_TYPE*> rowIndices;    // [feature]
+        std::vector<const CPUSPARSE_INDEX_TYPE*> colStarts;     // [feature], numSamples + 1 offsets
+        const ElemType* labels;
+    };
+
+    void MapFile(const std::wstring& fileName);
+    void UnmapFile();
+
+    // reads the sample at 'offset' of m_file, passing its features to appendFeature(feature, values, rowIndices, nnz)
+    // returns - offset of the next sample
+    template <class AppendFeature>
+    int64_t ReadSample(int64_t offset, ElemType& label, const AppendFeature& appendFeature) const;
+
+    // writes the samples of m_file as blocks of m_blockSize samples, each a CSC matrix per feature
+    void WriteBlockedFile(const std::wstring& fileName) const;
+
+    // reads the block at 'offset' of the blocked file
+    // returns - offset of the next block
+    int64_t ReadBlock(int64_t offset, Block& block) const;
+
 public:
     SparsePCReader()
-        : m_pMBLayout(make_shared<MBLayout>()){};
+        : m_labelsBuffer(nullptr), m_pMBLayout(make_shared<MBLayout>()), m_dataBuffer(nullptr){};
     virtual ~SparsePCReader();
     virtual void Destroy();
     template <class ConfigRecordType>
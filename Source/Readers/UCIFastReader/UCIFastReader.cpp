@@ -9,10 +9,12 @@
 #define DATAREADER_EXPORTS // creating the exports here
 #include "DataReader.h"
 #include "UCIFastReader.h"
+#include "TaskScheduler.h"
 #ifdef LEAKDETECT
 #include <vld.h> // leak detection
 #endif
 #include "fileutil.h" // for fexists()
+#include <omp.h>
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -340,6 +342,12 @@ void UCIFastReader<ElemType>::InitFromConfig(const ConfigRecordType& readerConfi
     m_traceLevel = readerConfig(L"traceLevel", 0);
     m_parser->SetTraceLevel(m_traceLevel);
 
+    // threads that parse lines of plain numbers (0: one per processor, up to 4)
+    int numParseThreads = readerConfig(L"numParseThreads", 0);
+    if (numParseThreads <= 0)
+        numParseThreads = min(omp_get_num_procs(), 4);
+    m_parser->SetNumParseThreads(numParseThreads);
+
     m_prefetchEnabled = readerConfig(L"prefetch", false);
     // set the feature count to at least one (we better have one feature...)
     assert(m_featureCount != 0);
@@ -397,7 +405,8 @@ void UCIFastReader<ElemType>::InitFromConfig(const ConfigRecordType& readerConfi
         fprintf(stderr, "Reading UCI file %ls\n", file.c_str());
 
     // Simple heuristic to ensure buffer size and avoid breaking existing experiments.
-    size_t bufSize = max(dimFeatures * 16, (size_t) 256 * 1024);
+    // The parse threads split the lines of a buffer, so each gets as much as a single thread would.
+    size_t bufSize = max(dimFeatures * 16, (size_t) 256 * 1024) * numParseThreads;
     m_parser->ParseInit(file.c_str(), startFeatures, dimFeatures, startLabels, dimLabels, bufSize);
 
     // if we have labels and labels are categorical values, we need a label Mapping file, it will be a file with one label per line
@@ -546,6 +555,9 @@ void UCIFastReader<ElemType>::InitCache(const ConfigParameters& readerConfig)
 template <class ElemType>
 UCIFastReader<ElemType>::~UCIFastReader()
 {
+    // a prefetch still in flight reads into this object
+    if (m_pendingAsyncGetMinibatch.valid())
+        m_pendingAsyncGetMinibatch.wait();
     ReleaseMemory();
     delete m_cachingReader;
     delete m_cachingWriter;
@@ -805,9 +817,9 @@ bool UCIFastReader<ElemType>::GetMinibatch(StreamMinibatchInputs& matrices)
     {
         Matrix<ElemType>& features = matrices.GetInputMatrix<ElemType>(m_featuresName);
         int deviceId = features.GetDeviceId();
-        m_pendingAsyncGetMinibatch = std::async(std::launch::async, [this, deviceId]()
+        m_pendingAsyncGetMinibatch = TaskScheduler::Instance().Submit(TaskClass::prefetch, [this, deviceId]()
         {
-            // Set the device since this will execute on a new thread
+            // Set the device since this will execute on a worker thread
             Matrix<ElemType>::SetDevice(deviceId);
  
             StreamMinibatchInputs prefetchMatrices;
@@ -10,6 +10,7 @@
 #include "UCIParser.h"
 #include <stdexcept>
 #include <stdint.h>
+#include <string.h>
 
 #if WIN32
 #define ftell64 _ftelli64
@@ -17,6 +18,53 @@
 #define ftell64 ftell
 #endif
 
+// conversion of a number to a numeric label in ParseLine(); string labels keep their text, so the state machine parses them
+template <typename NumType, typename LabelType>
+struct UCILineLabel
+{
+    static const bool supported = true;
+    static LabelType Convert(NumType value)
+    {
+        return (LabelType) value;
+    }
+};
+
+template <typename NumType>
+struct UCILineLabel<NumType, std::string>
+{
+    static const bool supported = false;
+    static std::string Convert(NumType)
+    {
+        return std::string();
+    }
+};
+
+// ParseDigits - parse a run of decimal digits into 'value', and advance 'p' past them
+// returns - number of digits
+static size_t ParseDigits(const char *&p, const char *end, uint64_t &value)
+{
+    const char *begin = p;
+    value = 0;
+    // eight digits at a time, as the bytes of one 64-bit word (little endian: the first digit is the lowest byte)
+    while (end - p >= 8)
+    {
+        uint64_t chunk;
+        memcpy(&chunk, p, 8);
+        if ((chunk & 0xF0F0F0F0F0F0F0F0ull) != 0x3030303030303030ull ||                           // bytes 0x30..0x3F
+            ((chunk + 0x0606060606060606ull) & 0xF0F0F0F0F0F0F0F0ull) != 0x3030303030303030ull) // and not 0x3A..0x3F
+            break;
+        chunk -= 0x3030303030303030ull;
+        chunk = (chunk * 10 + (chunk >> 8)) & 0x00FF00FF00FF00FFull;        // pairs of digits
+        chunk = (chunk * 100 + (chunk >> 16)) & 0x0000FFFF0000FFFFull;      // groups of four
+        chunk = (chunk * 10000 + (chunk >> 32)) & 0x00000000FFFFFFFFull;    // all eight
+        value = value * 100000000 + chunk;
+        p += 8;
+    }
+    for (; p < end && (unsigned char) (*p - '0') <= 9; p++)
+        value = value * 10 + (*p - '0');
+    return p - begin;
+}
+
 // SetState for a particular value
 template <typename NumType, typename LabelType>
 void UCIParser<NumType, LabelType>::SetState(int value, ParseState m_current_state, ParseState next_state)
@@ -265,6 +313,12 @@ void UCIParser<NumType, LabelType>::Init(char customDelimiter, char customDecima
     m_pFile = NULL;
     m_stateTable = new DWORD[AllStateMax * 256];
     SetupStateTables(customDelimiter, customDecimalPoint);
+
+    m_customDelimiter = customDelimiter;
+    m_decimalPoint = customDecimalPoint != 0 ? customDecimalPoint : '.';
+    m_lineParserSupported = UCILineLabel<NumType, LabelType>::supported &&
+                            (customDelimiter == 0 || !strchr("0123456789+-eE\n", customDelimiter));
+    m_numParseThreads = 1;
 }
 
 // Parser destructor
@@ -507,6 +561,282 @@ void UCIParser<NumType, LabelType>::SetTraceLevel(int traceLevel)
     m_traceLevel = traceLevel;
 }
 
+// SetNumParseThreads - Set the number of threads that parse the lines of a buffer
+// numThreads - number of threads, 1 parses on the calling thread only
+template <typename NumType, typename LabelType>
+void UCIParser<NumType, LabelType>::SetNumParseThreads(int numThreads)
+{
+    m_numParseThreads = std::max(numThreads, 1);
+}
+
+// ReadFromLineStart - move the unparsed rest of the buffer to its start, and fill the remainder from the file
+// may only be called at the start of a line
+template <typename NumType, typename LabelType>
+void UCIParser<NumType, LabelType>::ReadFromLineStart()
+{
+    size_t bufferIndex = m_byteCounter - m_bufferStart;
+    size_t bufferEnd = (size_t) min((int64_t) m_bufferSize, m_fileSize - (int64_t) m_bufferStart);
+    size_t saveBytes = bufferEnd - bufferIndex;
+    memmove(m_fileBuffer, m_fileBuffer + bufferIndex, saveBytes);
+    m_bufferStart = m_byteCounter;
+
+    // the file is positioned at the end of the buffer, which is where the saved bytes end now
+    size_t bytesToRead = (size_t) min((int64_t) m_bufferSize, m_fileSize - (int64_t) m_bufferStart) - saveBytes;
+    size_t bytesRead = fread(m_fileBuffer + saveBytes, 1, bytesToRead, m_pFile);
+    if (bytesRead != bytesToRead)
+        RuntimeError("UCIParser::ReadFromLineStart - error reading file");
+}
+
+// CanParseLines - true if the state machine is at the start of a line, with nothing left over from the previous one
+// (the state machine carries a partial number over lines that end in e.g. '1.', which ParseLines() cannot reproduce)
+template <typename NumType, typename LabelType>
+bool UCIParser<NumType, LabelType>::CanParseLines() const
+{
+    bool atLineStart = m_current_state == EndOfLine ||
+                       (m_current_state == Whitespace && m_elementsConvertedThisLine == 0 && m_spaceDelimitedStart == m_byteCounter); // (start of parsing)
+    return m_lineParserSupported && m_parseMode == ParseNormal && atLineStart &&
+           m_numbers != NULL && (m_labels != NULL || m_dimLabels == 0) &&
+           m_partialResult == 0 && m_builtUpNumber == 0 && m_divider == 0 && m_wholeNumberMultiplier == 1 && m_exponentMultiplier == 1;
+}
+
+// ParseNumber - parse a plain number ([-]digits[.digits][(e|E)[+|-]digits], at most 15 digits each)
+// The arithmetic is that of the state machine, with digits that are exact in a double, so that the values are identical.
+// returns - pointer to the character after the number, or NULL if there is no plain number at 'p'
+template <typename NumType, typename LabelType>
+const char *UCIParser<NumType, LabelType>::ParseNumber(const char *p, const char *end, NumType &value) const
+{
+    const size_t maxDigits = 15;
+    double wholeNumberMultiplier = 1;
+    if (p < end && *p == '-')
+    {
+        wholeNumberMultiplier = -1;
+        p++;
+    }
+    uint64_t digits;
+    size_t numDigits = ParseDigits(p, end, digits);
+    if (numDigits == 0 || numDigits > maxDigits)
+        return NULL;
+    double builtUpNumber = (double) digits;
+    double partialResult = 0;
+    double divider = 0;
+
+    if (p < end && *p == m_decimalPoint)
+    {
+        p++;
+        numDigits = ParseDigits(p, end, digits);
+        if (numDigits == 0 || numDigits > maxDigits)
+            return NULL;
+        partialResult = builtUpNumber;
+        builtUpNumber = (double) digits;
+        for (divider = 1; numDigits > 0; numDigits--)
+            divider *= 10;
+    }
+
+    NumType finalResult;
+    if (p < end && (*p == 'e' || *p == 'E'))
+    {
+        p++;
+        double exponentMultiplier = 1;
+        if (p < end && (*p == '-' || *p == '+'))
+        {
+            if (*p == '-')
+                exponentMultiplier = -1;
+            p++;
+        }
+        numDigits = ParseDigits(p, end, digits);
+        if (numDigits == 0 || numDigits > maxDigits)
+            return NULL;
+        if (divider != 0)
+            partialResult += builtUpNumber / divider;
+        else
+            partialResult = builtUpNumber;
+        finalResult = (NumType)(partialResult * pow(10.0, exponentMultiplier * (double) digits));
+    }
+    else if (divider != 0)
+        finalResult = (NumType)(partialResult + (builtUpNumber / divider));
+    else
+        finalResult = (NumType) builtUpNumber;
+
+    value = (NumType)(finalResult * wholeNumberMultiplier);
+    return p;
+}
+
+// ParseLine - parse a line of plain numbers, storing them like DoneWithValue()
+// returns - false if it has anything else, in which case nothing is appended
+template <typename NumType, typename LabelType>
+bool UCIParser<NumType, LabelType>::ParseLine(const char *begin, const char *end, std::vector<NumType> *numbers, std::vector<LabelType> *labels) const
+{
+    size_t numbersSize = numbers->size();
+    size_t labelsSize = labels ? labels->size() : 0;
+    size_t elementsConverted = 0;
+    for (const char *p = begin;;)
+    {
+        while (p < end && IsDelimiter(*p))
+            p++;
+        if (p == end)
+            break;
+
+        NumType value;
+        p = ParseNumber(p, end, value);
+        if (p == NULL || (p < end && !IsDelimiter(*p)))
+        {
+            numbers->resize(numbersSize);
+            if (labels)
+                labels->resize(labelsSize);
+            return false;
+        }
+
+        size_t index = elementsConverted;
+        bool stored = false;
+        if (m_startLabels <= index && index < m_startLabels + m_dimLabels)
+        {
+            labels->push_back(UCILineLabel<NumType, LabelType>::Convert(value));
+            elementsConverted++;
+            stored = true;
+        }
+        if (m_startFeatures <= index && index < m_startFeatures + m_dimFeatures)
+        {
+            numbers->push_back(value);
+            elementsConverted++;
+            stored = true;
+        }
+        if (!stored)
+            elementsConverted++;
+    }
+    return elementsConverted > 0; // (the state machine does not count empty lines)
+}
+
+// ParseLines - parse whole lines of plain numbers in the buffer, in batches of lines that are split over m_numParseThreads threads
+// stops at the first line that is not just plain numbers, which is left to the state machine
+// returns - number of records read
+template <typename NumType, typename LabelType>
+long UCIParser<NumType, LabelType>::ParseLines(size_t recordsRequested)
+{
+    size_t bufferIndex = m_byteCounter - m_bufferStart;
+    size_t bufferEnd = (size_t) min((int64_t) m_bufferSize, m_fileSize - (int64_t) m_bufferStart);
+    const char *buffer = (const char *) m_fileBuffer;
+    const char *lineEnd = (const char *) memchr(buffer + bufferIndex, '\n', bufferEnd - bufferIndex);
+    if (lineEnd == NULL)
+    {
+        // the line continues after the buffer, unless it is longer than the buffer or the last line of the file
+        if (bufferIndex == 0 || m_bufferStart + bufferEnd >= m_fileSize)
+            return 0;
+        ReadFromLineStart();
+        bufferIndex = 0;
+        bufferEnd = (size_t) min((int64_t) m_bufferSize, m_fileSize - (int64_t) m_bufferStart);
+        lineEnd = (const char *) memchr(buffer, '\n', bufferEnd);
+        if (lineEnd == NULL)
+            return 0;
+    }
+
+    // the first line is parsed right away, so that a file that does not consist of plain numbers only costs a line per line
+    size_t numbersSize = m_numbers->size();
+    size_t labelsSize = m_labels ? m_labels->size() : 0;
+    if (!ParseLine(buffer + bufferIndex, lineEnd, m_numbers, m_labels))
+        return 0;
+    size_t numLines = 1;
+    size_t lineStart = lineEnd - buffer + 1;
+
+    // threads only for lines that follow a few lines of plain numbers, so that lines for the state machine rarely waste a batch
+    const size_t minLinesPerThread = 16;
+    const size_t maxLinesPerThread = 256;
+    size_t serialLines = m_numParseThreads <= 1 ? recordsRequested : min(recordsRequested, minLinesPerThread);
+    bool complete = true;
+    for (; numLines < serialLines; numLines++)
+    {
+        lineEnd = (const char *) memchr(buffer + lineStart, '\n', bufferEnd - lineStart);
+        complete = lineEnd != NULL && ParseLine(buffer + lineStart, lineEnd, m_numbers, m_labels);
+        if (!complete)
+            break;
+        lineStart = lineEnd - buffer + 1;
+    }
+
+    if (complete && numLines < recordsRequested)
+    {
+        // batches of lines, each split into a contiguous range of lines per thread, parsed into the thread's own vectors and then appended in order
+        // (batches limit the work that is lost when a line needs the state machine)
+        m_parsedLines.resize(m_numParseThreads);
+        while (complete && numLines < recordsRequested)
+        {
+            m_lineEnds.clear();
+            for (size_t pos = lineStart; numLines + m_lineEnds.size() < recordsRequested && m_lineEnds.size() < maxLinesPerThread * m_numParseThreads;)
+            {
+                lineEnd = (const char *) memchr(buffer + pos, '\n', bufferEnd - pos);
+                if (lineEnd == NULL)
+                    break;
+                pos = lineEnd - buffer + 1;
+                m_lineEnds.push_back(pos - 1);
+            }
+            if (m_lineEnds.empty())
+                break;
+
+            size_t numThreads = std::max(min((size_t) m_numParseThreads, m_lineEnds.size() / minLinesPerThread), (size_t) 1);
+#pragma omp parallel for num_threads((int) numThreads) schedule(static, 1)
+            for (int thread = 0; thread < (int) numThreads; thread++)
+            {
+                ParsedLines &parsed = m_parsedLines[thread];
+                parsed.numbers.clear();
+                parsed.labels.clear();
+                parsed.numLines = 0;
+                size_t first = m_lineEnds.size() * thread / numThreads;
+                size_t last = m_lineEnds.size() * (thread + 1) / numThreads;
+                size_t start = first == 0 ? lineStart : m_lineEnds[first - 1] + 1;
+                for (size_t i = first; i < last; i++, parsed.numLines++)
+                {
+                    if (!ParseLine(buffer + start, buffer + m_lineEnds[i], &parsed.numbers, m_labels ? &parsed.labels : NULL))
+                        break;
+                    start = m_lineEnds[i] + 1;
+                }
+            }
+
+            size_t linesParsed = 0;
+            for (size_t thread = 0; thread < numThreads && complete; thread++)
+            {
+                const ParsedLines &parsed = m_parsedLines[thread];
+                m_numbers->insert(m_numbers->end(), parsed.numbers.begin(), parsed.numbers.end());
+                if (m_labels)
+                    m_labels->insert(m_labels->end(), parsed.labels.begin(), parsed.labels.end());
+                linesParsed += parsed.numLines;
+                // at a line for the state machine, the lines of the threads after it are dropped, and parsed again later
+                complete = parsed.numLines == m_lineEnds.size() * (thread + 1) / numThreads - m_lineEnds.size() * thread / numThreads;
+            }
+            if (linesParsed > 0)
+                lineStart = m_lineEnds[linesParsed - 1] + 1;
+            numLines += linesParsed;
+        }
+    }
+
+    m_totalNumbersConverted += (m_numbers->size() - numbersSize) + (m_labels ? m_labels->size() - labelsSize : 0);
+    m_byteCounter = m_bufferStart + lineStart;
+    m_current_state = EndOfLine; // as after the '\n' of the last line
+    return (long) numLines;
+}
+
+// ReportProgress - print progress dots for a record
+template <typename NumType, typename LabelType>
+void UCIParser<NumType, LabelType>::ReportProgress(long recordCount)
+{
+    // print progress dots
+    if (recordCount % 100 == 0)
+    {
+        if (recordCount % 1000 == 0)
+        {
+            if (recordCount % 10000 == 0)
+            {
+                fprintf(stderr, "#");
+            }
+            else
+            {
+                fprintf(stderr, "+");
+            }
+        }
+        else
+        {
+            fprintf(stderr, ".");
+        }
+    }
+}
+
 // Parse - Parse the data
 // recordsRequested - number of records requested
 // numbers - pointer to vector to return the numbers (must be allocated)
@@ -527,6 +857,23 @@ long UCIParser<NumType, LabelType>::Parse(size_t recordsRequested, std::vector<N
     size_t bufferIndex = m_byteCounter - m_bufferStart;
     while (m_byteCounter < m_fileSize && recordCount < recordsRequested)
     {
+        // at the start of a line, parse whole lines of plain numbers without the state machine
+        if (CanParseLines())
+        {
+            long linesParsed = ParseLines(recordsRequested - recordCount);
+            bufferIndex = m_byteCounter - m_bufferStart;
+            if (linesParsed > 0)
+            {
+                if (m_traceLevel > 1)
+                {
+                    for (long record = recordCount + 1; record <= recordCount + linesParsed; record++)
+                        ReportProgress(record);
+                }
+                recordCount += linesParsed;
+                continue;
+            }
+        }
+
         // check to see if we need to update the buffer
         if (bufferIndex >= m_bufferSize)
         {
@@ -538,14 +885,6 @@ long UCIParser<NumType, LabelType>::Parse(size_t recordsRequested, std::vector<N
 
         ParseState nextState = (ParseState) m_stateTable[(m_current_state << 8) + ch];
 
-        if (nextState <= Exponent)
-        {
-            m_builtUpNumber = m_builtUpNumber * 10 + (ch - '0');
-            // if we are in the decimal portion of a number increase the divider
-            if (nextState == Remainder)
-                m_divider *= 10;
-        }
-
         // only do a test on a state transition
         if (m_current_state != nextState)
         {
@@ -639,27 +978,7 @@ long UCIParser<NumType, LabelType>::Parse(size_t recordsRequested, std::vector<N
             case LineCountEOL:
                 recordCount++; // done with another record
                 if (m_traceLevel > 1)
-                {
-                    // print progress dots
-                    if (recordCount % 100 == 0)
-                    {
-                        if (recordCount % 1000 == 0)
-                        {
-                            if (recordCount % 10000 == 0)
-                            {
-                                fprintf(stderr, "#");
-                            }
-                            else
-                            {
-                                fprintf(stderr, "+");
-                            }
-                        }
-                        else
-                        {
-                            fprintf(stderr, ".");
-                        }
-                    }
-                }
+                    ReportProgress(recordCount);
                 break;
             case LineCountOther:
                 m_spaceDelimitedStart = m_byteCounter;
@@ -667,6 +986,15 @@ long UCIParser<NumType, LabelType>::Parse(size_t recordsRequested, std::vector<N
             }
         }
 
+        // accumulate the digit after the state transition, which may complete the mantissa (e.g. 'e' followed by '5')
+        if (nextState <= Exponent)
+        {
+            m_builtUpNumber = m_builtUpNumber * 10 + (ch - '0');
+            // if we are in the decimal portion of a number increase the divider
+            if (nextState == Remainder)
+                m_divider *= 10;
+        }
+
         m_current_state = nextState;
 
         // move to next character
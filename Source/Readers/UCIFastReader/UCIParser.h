@@ -109,6 +109,20 @@ private:
     std::vector<LabelType> *m_labels; // pointer to vector to append with labels (may be numeric)
     // FUTURE: do we want a vector to collect string labels in the non string label case? (signifies an error)
 
+    // line parser (see ParseLines()), for lines of plain numbers
+    char m_customDelimiter;
+    char m_decimalPoint;
+    bool m_lineParserSupported; // false for string labels, and for delimiters that could be part of a number
+    int m_numParseThreads;
+    std::vector<size_t> m_lineEnds; // buffer indices of the '\n' of the lines that ParseLines() distributes over threads
+    struct ParsedLines
+    {
+        std::vector<NumType> numbers;
+        std::vector<LabelType> labels;
+        size_t numLines;
+    };
+    std::vector<ParsedLines> m_parsedLines; // the output of each thread
+
     // SetState for a particular value
     void SetState(int value, ParseState m_current_state, ParseState next_state);
 
@@ -132,6 +146,34 @@ private:
     // returns - number of records read
     size_t UpdateBuffer();
 
+    // ReadFromLineStart - move the unparsed rest of the buffer to its start, and fill the remainder from the file
+    // may only be called at the start of a line
+    void ReadFromLineStart();
+
+    // CanParseLines - true if the state machine is at the start of a line, with nothing left over from the previous one
+    bool CanParseLines() const;
+
+    // ParseLines - parse whole lines of plain numbers in the buffer, in batches of lines that are split over m_numParseThreads threads
+    // stops at the first line that is not just plain numbers, which is left to the state machine
+    // returns - number of records read
+    long ParseLines(size_t recordsRequested);
+
+    // ParseLine - parse a line of plain numbers
+    // returns - false if it has anything else, in which case nothing is appended
+    bool ParseLine(const char *begin, const char *end, std::vector<NumType> *numbers, std::vector<LabelType> *labels) const;
+
+    // ParseNumber - parse a plain number ([-]digits[.digits][(e|E)[+|-]digits], at most 15 digits each)
+    // returns - pointer to the character after the number, or NULL if there is no plain number at 'p'
+    const char *ParseNumber(const char *p, const char *end, NumType &value) const;
+
+    bool IsDelimiter(char ch) const
+    {
+        return ch == ' ' || ch == '\t' || ch == '\r' || (ch == m_customDelimiter && ch != 0);
+    }
+
+    // ReportProgress - print progress dots for a record
+    void ReportProgress(long recordCount);
+
 public:
     // UCIParser constructor
     UCIParser(char customDelimiter, char customDecimalPoint);
@@ -164,6 +206,10 @@ public:
     // traceLevel - traceLevel, zero means no output, 1 epoch related output, > 1 all output
     void SetTraceLevel(int traceLevel);
 
+    // SetNumParseThreads - Set the number of threads that parse the lines of a buffer
+    // numThreads - number of threads, 1 parses on the calling thread only
+    void SetNumParseThreads(int numThreads);
+
     // ParseInit - Initialize a parse of a file
     // fileName - path to the file to open
     // startFeatures - column (zero based) where features start
@@ -0,0 +1,188 @@
+// CachingDataReader.h -- a reader that records the minibatches of one pass over another reader, and replays them
+
+#pragma once
+
+#include "Basics.h"
+#include "DataReader.h"
+#include "Matrix.h"
+#include "Sequences.h"
+#include <memory>
+#include <string>
+#include <vector>
+#include <map>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// -----------------------------------------------------------------------
+// CachingDataReader -- wraps the training reader for the trials of the learning-rate and minibatch-size searches
+//
+// The searches train repeatedly on the same first samples of an epoch. The first minibatch loop is read from the
+// wrapped reader, and deep copies of the minibatches and their MBLayouts are kept on the device of the input
+// matrices. A later loop with the same parameters replays them instead, without touching the wrapped reader.
+// A loop with other parameters (e.g. another trial minibatch size) is read again, and replaces the recording.
+// Only a loop that was read to its end is replayed. Readers that deliver more than matrices and a layout
+// (lattices for sequence training, the two-forward-pass utterance copies) are passed through, and never replayed.
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+class CachingDataReader : public IDataReader
+{
+public:
+    CachingDataReader(IDataReader* reader)
+        : m_reader(reader), m_replaying(false), m_readerIsDone(false), m_canReplay(true), m_nextMinibatch(0)
+    {
+        m_seed = reader->m_seed;
+        mRequestedNumParallelSequences = reader->mRequestedNumParallelSequences;
+    }
+
+    virtual void Init(const ConfigParameters&) override { LogicError("CachingDataReader: Init() is not supported, it wraps an initialized reader."); }
+    virtual void Init(const ScriptableObjects::IConfigRecord&) override { LogicError("CachingDataReader: Init() is not supported, it wraps an initialized reader."); }
+    virtual void Destroy() override { } // the wrapped reader is owned by the caller
+
+    virtual void StartMinibatchLoop(size_t mbSize, size_t epoch, size_t requestedEpochSamples = requestDataSize) override
+    {
+        if (StartLoop(LoopKey(mbSize, epoch, 0, 1, requestedEpochSamples)))
+            m_reader->StartMinibatchLoop(mbSize, epoch, requestedEpochSamples);
+    }
+
+    virtual bool SupportsDistributedMBRead() const override { return m_reader->SupportsDistributedMBRead(); }
+
+    virtual void StartDistributedMinibatchLoop(size_t mbSize, size_t epoch, size_t subsetNum, size_t numSubsets, size_t requestedEpochSamples = requestDataSize) override
+    {
+        if (StartLoop(LoopKey(mbSize, epoch, subsetNum, numSubsets, requestedEpochSamples)))
+            m_reader->StartDistributedMinibatchLoop(mbSize, epoch, subsetNum, numSubsets, requestedEpochSamples);
+    }
+
+    virtual bool GetMinibatch(StreamMinibatchInputs& matrices) override
+    {
+        if (m_replaying)
+        {
+            if (m_nextMinibatch >= m_minibatches.size())
+                return false;
+            const auto& minibatch = m_minibatches[m_nextMinibatch++];
+            for (const auto& input : minibatch.m_inputs)
+            {
+                auto& matrix = matrices.GetInputMatrix<ElemType>(input.first);
+                matrix.SetValue(*input.second, input.second->GetFormat());
+            }
+            m_currentLayout = minibatch.m_layout;
+            return true;
+        }
+
+        bool wasDataRead = m_reader->GetMinibatch(matrices);
+        if (!wasDataRead)
+        {
+            m_readerIsDone = true;
+            return false;
+        }
+        if (!m_canReplay)
+        {
+            m_currentLayout = nullptr;
+            return true;
+        }
+
+        Minibatch minibatch;
+        for (const auto& input : matrices)
+        {
+            const auto& matrix = matrices.GetInputMatrix<ElemType>(input.first);
+            minibatch.m_inputs[input.first] = make_shared<Matrix<ElemType>>(matrix, matrix.GetDeviceId()); // deep copy
+        }
+        minibatch.m_layout = make_shared<MBLayout>();
+        m_reader->CopyMBLayoutTo(minibatch.m_layout);
+        m_minibatches.push_back(minibatch);
+        m_currentLayout = minibatch.m_layout;
+        return true;
+    }
+
+    virtual void CopyMBLayoutTo(MBLayoutPtr pMBLayout) override
+    {
+        if (m_currentLayout)
+            pMBLayout->CopyFrom(m_currentLayout);
+        else
+            m_reader->CopyMBLayoutTo(pMBLayout);
+    }
+
+    virtual bool DataEnd() override { return m_replaying ? m_nextMinibatch >= m_minibatches.size() : m_reader->DataEnd(); }
+
+    virtual size_t GetNumParallelSequences() override { return m_reader->GetNumParallelSequences(); }
+    virtual void SetNumParallelSequences(const size_t sz) override { m_reader->SetNumParallelSequences(sz); }
+
+    virtual const std::map<LabelIdType, LabelType>& GetLabelMapping(const std::wstring& sectionName) override { return m_reader->GetLabelMapping(sectionName); }
+    virtual void SetLabelMapping(const std::wstring& sectionName, const std::map<LabelIdType, LabelType>& labelMapping) override { m_reader->SetLabelMapping(sectionName, labelMapping); }
+    virtual bool CanReadFor(wstring nodeName) override { return m_reader->CanReadFor(nodeName); }
+
+    // these deliver data besides the matrices and the layout, which is not recorded; a recording that saw them is not replayed
+    virtual bool GetMinibatch4SE(std::vector<shared_ptr<const msra::dbn::latticepair>>& latticeinput, vector<size_t>& uids, vector<size_t>& boundaries, vector<size_t>& extrauttmap) override
+    {
+        DisableReplay();
+        return m_reader->GetMinibatch4SE(latticeinput, uids, boundaries, extrauttmap);
+    }
+    virtual bool GetHmmData(msra::asr::simplesenonehmm* hmm) override { return m_reader->GetHmmData(hmm); }
+    virtual bool GetMinibatchCopy(std::vector<std::vector<std::pair<wstring, size_t>>>& uttInfo, StreamMinibatchInputs& matrices, MBLayoutPtr pMBLayout) override
+    {
+        bool wasDataRead = m_reader->GetMinibatchCopy(uttInfo, matrices, pMBLayout);
+        if (wasDataRead)
+            DisableReplay();
+        return wasDataRead;
+    }
+    virtual bool SetNetOutput(const std::vector<std::vector<std::pair<wstring, size_t>>>& uttInfo, const MatrixBase& outputs, const MBLayoutPtr pMBLayout) override
+    {
+        return m_reader->SetNetOutput(uttInfo, outputs, pMBLayout);
+    }
+
+private:
+    struct LoopKey
+    {
+        LoopKey() : m_mbSize(0), m_epoch(0), m_subsetNum(0), m_numSubsets(0), m_requestedEpochSamples(0) { }
+        LoopKey(size_t mbSize, size_t epoch, size_t subsetNum, size_t numSubsets, size_t requestedEpochSamples)
+            : m_mbSize(mbSize), m_epoch(epoch), m_subsetNum(subsetNum), m_numSubsets(numSubsets), m_requestedEpochSamples(requestedEpochSamples) { }
+        bool operator==(const LoopKey& other) const
+        {
+            return m_mbSize == other.m_mbSize && m_epoch == other.m_epoch && m_subsetNum == other.m_subsetNum &&
+                   m_numSubsets == other.m_numSubsets && m_requestedEpochSamples == other.m_requestedEpochSamples;
+        }
+        size_t m_mbSize, m_epoch, m_subsetNum, m_numSubsets, m_requestedEpochSamples;
+    };
+
+    struct Minibatch
+    {
+        std::map<std::wstring, shared_ptr<Matrix<ElemType>>> m_inputs; // [node name]
+        MBLayoutPtr m_layout;
+    };
+
+    // returns true if the loop must be read from the wrapped reader
+    bool StartLoop(const LoopKey& key)
+    {
+        m_currentLayout = nullptr;
+        m_nextMinibatch = 0;
+        m_replaying = m_canReplay && m_readerIsDone && key == m_key;
+        if (m_replaying)
+            return false;
+
+        // record this loop instead
+        m_minibatches.clear();
+        m_readerIsDone = false;
+        m_key = key;
+        return true;
+    }
+
+    void DisableReplay()
+    {
+        if (m_replaying)
+            LogicError("CachingDataReader: A replayed minibatch loop cannot deliver sequence-training data.");
+        m_canReplay = false;
+        m_minibatches.clear();
+        m_currentLayout = nullptr;
+    }
+
+    IDataReader* m_reader;
+    LoopKey m_key;                       // of the recorded loop
+    std::vector<Minibatch> m_minibatches;
+    bool m_replaying;
+    bool m_readerIsDone;                 // the recorded loop was read to its end
+    bool m_canReplay;
+    size_t m_nextMinibatch;              // when replaying
+    MBLayoutPtr m_currentLayout;         // of the last minibatch returned
+};
+
+} } }
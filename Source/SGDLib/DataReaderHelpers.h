@@ -271,6 +271,7 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 
         size_t m_numParallelSequences; // number of paralle sequence in the cached matrix and MBLayout
         size_t m_numSubminibatches;    // how many subminibatches we are going to use ?
+        bool m_accumulateInPlace;      // the backprop adds the gradients of the subminibatches in the parameters, see AccumulatesInPlace()
 
         std::vector<shared_ptr<ComputationNode<ElemType>>> m_netCriterionNodes;
         std::vector<shared_ptr<ComputationNode<ElemType>>> m_netEvaluationNodes;
@@ -311,18 +312,22 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 
     public:
         SubminibatchDispatcher()
-            : m_MBLayoutCache(nullptr), m_netLatticePtr(nullptr), m_netExtrauttMapPtr(nullptr), m_netUidPtr(nullptr), m_netBoundariesPtr(nullptr)
+            : m_MBLayoutCache(nullptr), m_netLatticePtr(nullptr), m_netExtrauttMapPtr(nullptr), m_netUidPtr(nullptr), m_netBoundariesPtr(nullptr), m_accumulateInPlace(false)
         {
         }
 
+        // With accumulateInPlace, a network without stateful nodes or lattices is not paged: the sub-minibatches
+        // do not need the state of each other, so the gradients are not copied out after each sub-minibatch, the caller
+        // backprops all but the first one with accumulateParameterGradients instead (see AccumulatesInPlace()).
         void Init(ComputationNetworkPtr& net,
                   const std::list<ComputationNodeBasePtr>& learnableNodes,
                   const std::vector<ComputationNodeBasePtr>& criterionNodes,
-                  const std::vector<ComputationNodeBasePtr>& evaluationNodes)
+                  const std::vector<ComputationNodeBasePtr>& evaluationNodes,
+                  bool accumulateInPlace = false)
         {
             m_MBLayoutCache = make_shared<MBLayout>();
-            m_netCriterionAccumulator = make_shared<Matrix<ElemType>>(1, 1, net->GetDeviceId());
-            m_netEvaluationAccumulator = make_shared<Matrix<ElemType>>(1, evaluationNodes.size(), net->GetDeviceId());
+            m_netCriterionAccumulator = make_shared<Matrix<ElemType>>(1, 1, criterionNodes[0]->GetDeviceId());
+            m_netEvaluationAccumulator = make_shared<Matrix<ElemType>>(1, evaluationNodes.size(), criterionNodes[0]->GetDeviceId());
             // remember ptrs to learnable nodes
             for (auto x : learnableNodes)
             {
@@ -368,8 +373,14 @@ namespace Microsoft { namespace MSR { namespace CNTK {
                 m_netBoundariesPtr = nullptr;
                 m_hasLattices = false;
             }
+
+            m_accumulateInPlace = accumulateInPlace && m_netStatefulNodes.empty() && !m_hasLattices;
         }
 
+        // if true, the gradients of the sub-minibatches are accumulated by the backprop itself, in the gradients of the parameters;
+        // then the gradient of a parameter is complete once the backprop of the last sub-minibatch is done with it
+        bool AccumulatesInPlace() const { return m_accumulateInPlace; }
+
         size_t GetMinibatchIntoCache(IDataReader& trainSetDataReader,
                                      ComputationNetwork& net,
                                      StreamMinibatchInputs& inputMatrices,
@@ -413,26 +424,30 @@ namespace Microsoft { namespace MSR { namespace CNTK {
             // we cannot split further; instead, each subsequence become a subminibatch
             size_t actualnumSubminibatches = requestedSubminibatches > nParallelSequences ? nParallelSequences : requestedSubminibatches;
 
-            // 4. third, allocate space for accumulated gradient
-            for (auto& n : m_LearnableNodePtr)
+            // 4. third, allocate space for accumulated gradient (not needed when it is accumulated in place)
+            if (!m_accumulateInPlace)
             {
-                auto node = n.second;
-                if (node->IsParameterUpdateRequired())
+                for (auto& n : m_LearnableNodePtr)
                 {
-                    wstring nodeName = node->GetName();
-                    shared_ptr<ComputationNode<ElemType>> pLearnableNode = node;
-                    auto funvalue = pLearnableNode->Value(); // gradient may not be allocated when this function is first called
-                    size_t nrow = funvalue.GetNumRows();
-                    size_t ncol = funvalue.GetNumCols();
-                    if (m_cachedGradient.find(nodeName) == m_cachedGradient.end())
+                    auto node = n.second;
+                    if (node->IsParameterUpdateRequired())
                     {
-                        // not allocated yet
-                        auto matrixp = make_shared<Matrix<ElemType>>(nrow, ncol, funvalue.GetDeviceId());
-                        matrixp->SetValue(0);
-                        m_cachedGradient.AddInputMatrix(nodeName, matrixp);
+                        wstring nodeName = node->GetName();
+                        shared_ptr<ComputationNode<ElemType>> pLearnableNode = node;
+                        auto funvalue = pLearnableNode->Value(); // gradient may not be allocated when this function is first called
+                        size_t nrow = funvalue.GetNumRows();
+                        size_t ncol = funvalue.GetNumCols();
+                        if (m_cachedGradient.find(nodeName) == m_cachedGradient.end())
+                        {
+                            // not allocated yet
+                            auto matrixp = make_shared<Matrix<ElemType>>(nrow, ncol, funvalue.GetDeviceId());
+                            matrixp->SetValue(0);
+                            m_cachedGradient.AddInputMatrix(nodeName, matrixp);
+                        }
                     }
                 }
             }
+
             // 5. for stateful node
             for (auto x : m_netStatefulNodes)
             {
@@ -524,7 +539,7 @@ namespace Microsoft { namespace MSR { namespace CNTK {
         // TODO: encapsulate it into a destructor? Note: Cannot throw exceptions in destructor.
         void DoneWithCurrentSubMinibatch(size_t iSubminibatch)
         {
-            // accumulate gradient here
+            // accumulate gradient here (unless that is done in place, then m_cachedGradient is empty)
             for (auto x : m_cachedGradient)
             {
                 wstring nodename = x.first;
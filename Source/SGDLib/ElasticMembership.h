@@ -0,0 +1,235 @@
+#pragma once
+
+#include "Basics.h"
+#include "MPIWrapper.h"
+#include "fileutil.h"
+#include <string>
+#include <cstring>
+#include <csignal>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Elastic membership of parallel training: nodes join or leave the job at the boundaries at which SGD asks for
+// IsChangePending() and then calls ChangeMembership(), so that a job on preemptible machines does not have to be restarted.
+// Every node is started on its own (as an MPI singleton) with the same port file. The first one becomes the main node,
+// and the others join it through the MPI port it opened. The files, next to each other:
+//  - <portFile>.lock      claims the job, created by its first node
+//  - <portFile>           the name of the MPI port of the main node, rewritten if the main node leaves
+//  - <portFile>.join<n>   join requests, the main node accepts the new ones at each boundary
+// A node leaves at the next boundary after it received a SIGTERM, which is the notice of a preemption.
+// A node that fails without leaving still takes down the job, MPI does not recover from that.
+class ElasticMembership
+{
+public:
+    ElasticMembership(MPIWrapper* mpi, const std::wstring& portFile)
+        : m_mpi(mpi), m_portFile(portFile), m_isJoining(false), m_nextJoinRequest(0), m_numJoining(0), m_numLeaving(0)
+    {
+        int numProcesses = 0;
+        MPI_Comm_size(MPI_COMM_WORLD, &numProcesses) || MpiFail("ElasticMembership: MPI_Comm_size");
+        if (numProcesses != 1)
+            InvalidArgument("ElasticMembership: the nodes of an elastic job have to be started on their own, not as an MPI job of %d processes.", numProcesses);
+
+        FILE* f = _wfopen(LockFileName().c_str(), L"wx");
+        if (f != nullptr)
+        {
+            fclose(f);
+            OpenPort();
+        }
+        else
+        {
+            fprintf(stderr, "ElasticMembership: '%ls' exists, joining the job of its main node\n", LockFileName().c_str());
+            m_isJoining = true;
+        }
+
+        signal(SIGTERM, &ElasticMembership::OnTerminate);
+    }
+
+    ~ElasticMembership()
+    {
+        ClosePort();
+    }
+
+    // Whether this node still has to join the job, in its first ChangeMembership()
+    bool IsJoining() const
+    {
+        return m_isJoining;
+    }
+
+    // Whether nodes join or leave at this boundary. Collective over all nodes, before ChangeMembership().
+    bool IsChangePending()
+    {
+        if (m_isJoining)
+            return true;
+
+        int changes[2] = {LeaveRequested() ? 1 : 0, 0};
+        if (m_mpi->IsMainNode())
+        {
+            while (fexists(JoinRequestFileName(m_nextJoinRequest + m_numJoining)))
+                m_numJoining++;
+            changes[1] = (int) m_numJoining;
+        }
+        m_mpi->AllReduce(changes, 2);
+        m_numLeaving = changes[0];
+        m_numJoining = changes[1];
+
+        if ((m_numJoining == 0) && (m_numLeaving == m_mpi->NumNodesInUse()))
+        {
+            fprintf(stderr, "ElasticMembership: all nodes are asked to leave, they stay until the end of the job\n");
+            return false;
+        }
+        return (m_numJoining > 0) || (m_numLeaving > 0);
+    }
+
+    // Accepts the joining nodes and removes the leaving ones. Collective over all nodes and the joining ones.
+    // Returns false on the nodes that left, which no longer have a communicator.
+    bool ChangeMembership()
+    {
+        if (m_isJoining)
+        {
+            Join();
+            m_isJoining = false;
+        }
+        else
+        {
+            AcceptNodes(m_numJoining, m_nextJoinRequest + m_numJoining);
+        }
+
+        bool wasMainNode = m_mpi->IsMainNode();
+        if (!m_mpi->RemoveNodes(!LeaveRequested()))
+        {
+            ClosePort();
+            return false;
+        }
+
+        // a new main node takes over the port
+        if (m_mpi->IsMainNode() && !wasMainNode)
+            OpenPort();
+
+        fprintf(stderr, "ElasticMembership: the job now has %d nodes\n", (int) m_mpi->NumNodesInUse());
+        return true;
+    }
+
+    // Removes the files of the job, on the main node at the end of the training.
+    void Finish()
+    {
+        if (!m_mpi->IsMainNode() || m_isJoining)
+            return;
+
+        ClosePort();
+        for (size_t n = 0; n < m_nextJoinRequest; n++)
+            _wunlink(JoinRequestFileName(n).c_str());
+        _wunlink(m_portFile.c_str());
+        _wunlink(LockFileName().c_str());
+    }
+
+    static bool LeaveRequested()
+    {
+        return LeaveRequestedFlag() != 0;
+    }
+
+private:
+    static volatile std::sig_atomic_t& LeaveRequestedFlag()
+    {
+        static volatile std::sig_atomic_t leaveRequested = 0;
+        return leaveRequested;
+    }
+
+    static void OnTerminate(int)
+    {
+        LeaveRequestedFlag() = 1;
+    }
+
+    std::wstring LockFileName() const
+    {
+        return m_portFile + L".lock";
+    }
+
+    std::wstring JoinRequestFileName(size_t n) const
+    {
+        return m_portFile + L".join" + std::to_wstring(n);
+    }
+
+    void OpenPort()
+    {
+        char port[MPI_MAX_PORT_NAME] = {0};
+        MPI_Open_port(MPI_INFO_NULL, port) || MpiFail("ElasticMembership: MPI_Open_port");
+        m_port = port;
+
+        // the joining nodes must not see a partial file
+        std::wstring tempFile = m_portFile + L".tmp";
+        FILE* f = fopenOrDie(tempFile, L"w");
+        fprintf(f, "%s\n", m_port.c_str());
+        fcloseOrDie(f);
+        if (fexists(m_portFile))
+            unlinkOrDie(m_portFile);
+        renameOrDie(tempFile, m_portFile);
+        fprintf(stderr, "ElasticMembership: accepting nodes at port %s\n", m_port.c_str());
+    }
+
+    void ClosePort()
+    {
+        if (m_port.empty())
+            return;
+
+        MPI_Close_port(m_port.c_str()) || MpiFail("ElasticMembership: MPI_Close_port");
+        m_port.clear();
+    }
+
+    // Accepts 'numJoining' nodes. After each of them, the main node tells all nodes, the new one included,
+    // how many are still to be accepted, and the next join request.
+    void AcceptNodes(size_t numJoining, size_t nextJoinRequest)
+    {
+        for (size_t k = 0; k < numJoining; k++)
+        {
+            m_mpi->AcceptNode(m_port.c_str());
+            size_t state[2] = {numJoining - k - 1, nextJoinRequest};
+            m_mpi->Bcast(state, 2, m_mpi->MainNodeRank());
+            nextJoinRequest = state[1];
+        }
+
+        m_nextJoinRequest = nextJoinRequest;
+        m_numJoining = 0;
+    }
+
+    void Join()
+    {
+        if (!fexists(m_portFile))
+            fprintf(stderr, "ElasticMembership: waiting for the port file '%ls'\n", m_portFile.c_str());
+        while (!fexists(m_portFile))
+            Sleep(1000);
+
+        char port[MPI_MAX_PORT_NAME + 1] = {0};
+        FILE* f = fopenOrDie(m_portFile, L"r");
+        if (fgets(port, sizeof(port), f) == nullptr)
+            RuntimeError("ElasticMembership: cannot read the port file '%ls'.", m_portFile.c_str());
+        fcloseOrDie(f);
+        port[strcspn(port, "\r\n")] = 0;
+
+        // claim the next free join request, the main node accepts requests in their order
+        for (size_t n = 0;; n++)
+        {
+            FILE* request = _wfopen(JoinRequestFileName(n).c_str(), L"wx");
+            if (request != nullptr)
+            {
+                fclose(request);
+                break;
+            }
+        }
+
+        fprintf(stderr, "ElasticMembership: joining the job at port %s\n", port);
+        m_mpi->ConnectToNodes(port);
+
+        size_t state[2] = {0, 0};
+        m_mpi->Bcast(state, 2, m_mpi->MainNodeRank());
+        AcceptNodes(state[0], state[1]);
+    }
+
+    MPIWrapper* m_mpi;
+    std::wstring m_portFile;
+    std::string m_port; // empty unless this is the main node
+    bool m_isJoining;
+    size_t m_nextJoinRequest; // first join request that is not accepted yet
+    size_t m_numJoining;      // join requests found after m_nextJoinRequest
+    size_t m_numLeaving;
+};
+} } }
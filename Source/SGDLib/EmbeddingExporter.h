@@ -0,0 +1,270 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include "Basics.h"
+#include "DataReader.h"
+#include "ComputationNetwork.h"
+#include "DataReaderHelpers.h"
+#include "GradientCompressor.h"
+#include "OutputQueue.h"
+#include "fileutil.h"
+#include <vector>
+#include <string>
+#include <thread>
+#include <cmath>
+#include <cstdint>
+#include <unordered_set>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// -----------------------------------------------------------------------
+// EmbeddingExporter -- writes the value of one node (e.g. the query or document tower of a DSSM model)
+// for every sample of a reader into a binary matrix file, one row per sample
+//
+// File format (little endian):
+//  - header: the 8 characters "CNTKEMB1", uint32 element type (see Precision), uint32 dimension,
+//    uint64 number of rows, uint32 subset (MPI rank), uint32 number of subsets
+//  - the rows: 'dimension' elements each; with int8, each row is preceded by its scale as a float,
+//    such that value ~= scale * q
+// With several MPI ranks, each rank writes the rows of its share of the data into "<outputPath>.rank<n>".
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+class EmbeddingExporter
+{
+public:
+    enum class Precision : uint32_t
+    {
+        float32 = 0,
+        float16 = 1,
+        int8 = 2
+    };
+
+    static Precision ParsePrecision(const std::string& precision)
+    {
+        if      (precision == "float32") return Precision::float32;
+        else if (precision == "float16") return Precision::float16;
+        else if (precision == "int8")    return Precision::int8;
+        else InvalidArgument("exportEmbeddings: precision must be 'float32', 'float16' or 'int8'.");
+    }
+
+    // Removes all nodes that the given node does not depend on, and makes it the only output.
+    // Reading then only has to provide the inputs of this node, and evaluation only allocates memory for its subgraph.
+    static ComputationNodeBasePtr PruneNetwork(ComputationNetworkPtr net, const std::wstring& rootName)
+    {
+        ComputationNodeBasePtr root = net->GetNodeFromName(rootName);
+        auto subgraph = root->EnumerateNodes();
+        std::unordered_set<ComputationNodeBasePtr> keep(subgraph.begin(), subgraph.end());
+
+        std::vector<std::wstring> toDelete;
+        for (const auto& node : net->GetAllNodes())
+        {
+            if (keep.find(node) == keep.end())
+                toDelete.push_back(node->NodeName());
+        }
+        for (const auto& nodeName : toDelete)
+            net->DeleteNode(nodeName);
+
+        net->OutputNodes().clear();
+        net->OutputNodes().push_back(root);
+        fprintf(stderr, "exportEmbeddings: Removed %d nodes that '%ls' does not depend on, %d nodes remain.\n", (int) toDelete.size(), rootName.c_str(), (int) keep.size());
+        return root;
+    }
+
+    EmbeddingExporter(ComputationNetworkPtr net)
+        : m_net(net)
+    {
+    }
+
+    // Evaluates 'root' (of a compiled network) for all samples and writes it; returns the number of rows written.
+    // Conversion and writing happen on a background thread, which takes the values of up to 'writeQueueSize' minibatches.
+    size_t Export(IDataReader& dataReader, size_t mbSize, const ComputationNodeBasePtr& root, std::wstring outputPath, Precision precision,
+                  size_t writeQueueSize, size_t numSamples = requestDataSize)
+    {
+        std::vector<ComputationNodeBasePtr> outputNodes{root};
+        const auto& inputNodeList = m_net->InputNodes(root);
+        std::vector<ComputationNodeBasePtr> inputNodes(inputNodeList.begin(), inputNodeList.end());
+
+        // allocate memory for forward computation
+        m_net->AllocateAllMatrices({}, outputNodes, nullptr);
+
+        StreamMinibatchInputs inputMatrices;
+        for (const auto& node : inputNodes)
+            inputMatrices.AddInputMatrix(node->NodeName(), node->ValuePtr());
+
+        // each rank evaluates its share of the data
+        const bool isDistributed = g_mpi != nullptr && g_mpi->NumNodesInUse() > 1;
+        const size_t subset = isDistributed ? g_mpi->CurrentNodeRank() : 0;
+        const size_t numSubsets = isDistributed ? g_mpi->NumNodesInUse() : 1;
+        if (isDistributed)
+            outputPath += msra::strfun::wstrprintf(L".rank%d", (int) subset);
+
+        // Readers that cannot read a subset of the data read all of it, and each rank keeps its share of each minibatch.
+        const bool useDistributedMBReading = isDistributed && dataReader.SupportsDistributedMBRead();
+        if (useDistributedMBReading)
+            dataReader.StartDistributedMinibatchLoop(mbSize, 0, subset, numSubsets, numSamples);
+        else
+            dataReader.StartMinibatchLoop(mbSize, 0, numSamples);
+
+        m_net->StartEvaluateMinibatchLoop(outputNodes);
+
+        File::MakeIntermediateDirs(outputPath);
+        FILE* f = fopenOrDie(outputPath, L"wb");
+        const uint32_t dim = (uint32_t) root->GetSampleMatrixNumRows();
+        WriteHeader(f, precision, dim, 0, subset, numSubsets);
+
+        OutputQueue<Rows> queue(writeQueueSize);
+        size_t numRows = 0;
+        std::thread writerThread([&]()
+        {
+            try
+            {
+                std::vector<char> buffer;
+                Rows rows;
+                while (queue.Pop(rows))
+                {
+                    Convert(rows, dim, precision, buffer);
+                    if (!buffer.empty())
+                        fwriteOrDie(buffer.data(), 1, buffer.size(), f);
+                    numRows += rows.m_numRows;
+                }
+            }
+            catch (...)
+            {
+                queue.Fail(std::current_exception());
+            }
+        });
+
+        size_t numMBsRun = 0;
+        size_t actualMBSize;
+        try
+        {
+            while (DataReaderHelpers::GetMinibatchIntoNetwork<ElemType>(dataReader, m_net, nullptr, useDistributedMBReading, isDistributed, inputMatrices, actualMBSize))
+            {
+                ComputationNetwork::BumpEvalTimeStamp(inputNodes);
+                m_net->ForwardProp(root);
+
+                const Matrix<ElemType>& values = dynamic_pointer_cast<ComputationNode<ElemType>>(root)->Value();
+                if (!queue.Push(GetRows(values, root->GetMBLayout())))
+                    break; // the writer failed
+
+                if (++numMBsRun % 100 == 0)
+                    fprintf(stderr, "exportEmbeddings: %d minibatches evaluated.\n", (int) numMBsRun);
+
+                dataReader.DataEnd();
+            }
+        }
+        catch (...)
+        {
+            queue.Fail(std::current_exception());
+        }
+        queue.Close();
+        writerThread.join();
+        queue.RethrowIfFailed();
+
+        // now that the number of rows is known, complete the header
+        fseekOrDie(f, 0);
+        WriteHeader(f, precision, dim, numRows, subset, numSubsets);
+        fcloseOrDie(f);
+
+        fprintf(stderr, "exportEmbeddings: Written %d rows of dimension %d to %ls\n", (int) numRows, (int) dim, outputPath.c_str());
+        return numRows;
+    }
+
+private:
+    // the samples of one minibatch, in the order of the reader, as the columns of a CPU-side matrix
+    struct Rows
+    {
+        size_t m_numRows;
+        std::vector<ElemType> m_values;
+    };
+
+    static void WriteHeader(FILE* f, Precision precision, uint32_t dim, uint64_t numRows, size_t subset, size_t numSubsets)
+    {
+        fwriteOrDie("CNTKEMB1", 1, 8, f);
+        uint32_t format[2] = {(uint32_t) precision, dim};
+        fwriteOrDie(format, sizeof(format), 1, f);
+        fwriteOrDie(&numRows, sizeof(numRows), 1, f);
+        uint32_t subsets[2] = {(uint32_t) subset, (uint32_t) numSubsets};
+        fwriteOrDie(subsets, sizeof(subsets), 1, f);
+    }
+
+    // copies the non-gap columns, ordered by sequence, then time
+    static Rows GetRows(const Matrix<ElemType>& values, const MBLayoutPtr& pMBLayout)
+    {
+        Rows rows;
+        const size_t dim = values.GetNumRows();
+        std::vector<ElemType> all(values.GetNumElements());
+        if (!all.empty())
+            values.CopySection(values.GetNumRows(), values.GetNumCols(), all.data(), values.GetNumRows());
+        if (!pMBLayout) // no MBLayout: a single sample
+        {
+            rows.m_numRows = all.empty() ? 0 : 1;
+            rows.m_values = std::move(all);
+            return rows;
+        }
+
+        const size_t numParallelSequences = pMBLayout->GetNumParallelSequences();
+        const size_t width = pMBLayout->GetNumTimeSteps();
+        rows.m_numRows = 0;
+        rows.m_values.reserve(all.size());
+        for (const auto& seqInfo : pMBLayout->GetAllSequences())
+        {
+            if (seqInfo.seqId == GAP_SEQUENCE_ID)
+                continue;
+            size_t tBegin = seqInfo.tBegin >= 0 ? seqInfo.tBegin : 0;
+            size_t tEnd = seqInfo.tEnd <= width ? seqInfo.tEnd : width;
+            for (size_t t = tBegin; t < tEnd; t++)
+            {
+                const ElemType* column = all.data() + (t * numParallelSequences + seqInfo.s) * dim;
+                rows.m_values.insert(rows.m_values.end(), column, column + dim);
+                rows.m_numRows++;
+            }
+        }
+        return rows;
+    }
+
+    static void Convert(const Rows& rows, size_t dim, Precision precision, std::vector<char>& buffer)
+    {
+        const ElemType* values = rows.m_values.data();
+        if (precision == Precision::float32)
+        {
+            buffer.resize(rows.m_numRows * dim * sizeof(float));
+            float* out = (float*) buffer.data();
+            for (size_t i = 0; i < rows.m_numRows * dim; i++)
+                out[i] = (float) values[i];
+        }
+        else if (precision == Precision::float16)
+        {
+            buffer.resize(rows.m_numRows * dim * sizeof(uint16_t));
+            uint16_t* out = (uint16_t*) buffer.data();
+            for (size_t i = 0; i < rows.m_numRows * dim; i++)
+                out[i] = FloatToHalf((float) values[i]);
+        }
+        else // int8, symmetric per row
+        {
+            const size_t rowBytes = sizeof(float) + dim;
+            buffer.resize(rows.m_numRows * rowBytes);
+            for (size_t j = 0; j < rows.m_numRows; j++)
+            {
+                const ElemType* row = values + j * dim;
+                char* out = buffer.data() + j * rowBytes;
+                float absMax = 0;
+                for (size_t i = 0; i < dim; i++)
+                    absMax = max(absMax, (float) fabs(row[i]));
+                float scale = absMax > 0 ? absMax / 127 : 1;
+                memcpy(out, &scale, sizeof(scale));
+                int8_t* q = (int8_t*) (out + sizeof(float));
+                for (size_t i = 0; i < dim; i++)
+                    q[i] = (int8_t) floor(row[i] / scale + 0.5f);
+            }
+        }
+    }
+
+    ComputationNetworkPtr m_net;
+};
+
+} } }
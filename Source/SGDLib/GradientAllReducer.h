@@ -0,0 +1,215 @@
+#pragma once
+
+#include "MPIWrapper.h"
+#include "BestGpu.h"
+#include <vector>
+#include <array>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Non-blocking in-place sum of buffers across all nodes.
+// A flat all-reducer issues one MPI_Iallreduce per buffer, or one MPI_Ireduce for a buffer that is only summed onto one node. A hierarchical one uses the two-level communicators of MPIWrapper:
+// the buffers are first reduced onto one leader process per machine over shared memory (or NVLink/PCIe, with a CUDA-aware MPI),
+// only the leaders all-reduce across the machines, and the result is then broadcast from the leaders on every machine.
+// The buffers may be device buffers if MPI is CUDA-aware.
+// All calls have to be made from one thread at a time, and buffers have to be started in the same order on all nodes.
+class GradientAllReducer
+{
+public:
+    GradientAllReducer(MPIWrapper* mpi, bool hierarchical)
+        : m_mpi(mpi), m_hierarchical(hierarchical), m_nodeReduceComm(MPI_COMM_NULL), m_nodeBroadcastComm(MPI_COMM_NULL), m_leaderComm(MPI_COMM_NULL),
+          m_isLeader(true), m_numLocalProcs(1), m_numLeaders(1)
+    {
+        m_numIssued.fill(0);
+        if (!m_hierarchical)
+            return;
+
+        // Non-blocking collectives have to be issued in the same order on every communicator, and the reductions and broadcasts
+        // within the machine progress independently. So they use their own copies of the communicators of MPIWrapper.
+        MPI_Comm_dup(m_mpi->MachineCommunicator(), &m_nodeReduceComm) || MpiFail("GradientAllReducer: MPI_Comm_dup");
+        MPI_Comm_dup(m_mpi->MachineCommunicator(), &m_nodeBroadcastComm) || MpiFail("GradientAllReducer: MPI_Comm_dup");
+        m_isLeader = m_mpi->IsMachineLeader();
+        if (m_isLeader)
+            MPI_Comm_dup(m_mpi->CrossMachineCommunicator(), &m_leaderComm) || MpiFail("GradientAllReducer: MPI_Comm_dup");
+        m_numLocalProcs = m_mpi->NumLocalNodes();
+        m_numLeaders = m_mpi->NumMachines();
+
+        if (m_mpi->IsMainNode())
+            fprintf(stderr, "GradientAllReducer: hierarchical aggregation over %d machines\n", (int) m_numLeaders);
+        // the reduction within the machine is only fast if the GPUs selected there can copy to each other directly
+        const auto& topology = GetLocalDeviceTopology();
+        if (m_isLeader && !topology.m_devices.empty() && !topology.m_allPeers)
+            fprintf(stderr, "GradientAllReducer: WARNING: the GPUs of this machine are not all peers, the reduction within the machine is staged through host memory\n");
+    }
+
+    ~GradientAllReducer()
+    {
+        // Errors are ignored, the destructor may run because of a failed aggregation
+        if (m_leaderComm != MPI_COMM_NULL)
+            MPI_Comm_free(&m_leaderComm);
+        if (m_nodeBroadcastComm != MPI_COMM_NULL)
+            MPI_Comm_free(&m_nodeBroadcastComm);
+        if (m_nodeReduceComm != MPI_COMM_NULL)
+            MPI_Comm_free(&m_nodeReduceComm);
+    }
+
+    // Starts the all-reduce of 'data', and returns its index for Wait().
+    // With a 'root' >= 0, the sum is only needed on that node; the other nodes' buffers are left as they are.
+    template <class ElemType>
+    size_t Start(ElemType* data, size_t numElements, int root = -1)
+    {
+        if ((root >= 0) && m_hierarchical)
+            LogicError("GradientAllReducer: sums onto one node are not supported with hierarchical aggregation.");
+
+        Operation op;
+        op.m_data = data;
+        op.m_numElements = (int) numElements;
+        op.m_root = root;
+        op.m_dataType = MPIWrapper::GetDataType(data);
+        op.m_stage = Stage::None;
+        op.m_request = MPI_REQUEST_NULL;
+        m_ops.push_back(op);
+
+        size_t index = m_ops.size() - 1;
+        Progress(index);
+        return index;
+    }
+
+    // Progresses the started operations, returns whether all of them are complete.
+    bool Test()
+    {
+        bool allComplete = true;
+        for (size_t i = 0; i < m_ops.size(); i++)
+        {
+            if (!Progress(i))
+                allComplete = false;
+        }
+        return allComplete;
+    }
+
+    // Waits for the completion of operation 'index'.
+    void Wait(size_t index)
+    {
+        // Operations complete in order: the stages of every operation are issued after those of the previous one
+        for (size_t i = 0; i <= index; i++)
+        {
+            while (!Progress(i))
+                MPI_Wait(&m_ops[i].m_request, MPI_STATUS_IGNORE) || MpiFail("GradientAllReducer: MPI_Wait");
+        }
+    }
+
+    // Waits for the completion of all operations, and forgets them.
+    void WaitAll()
+    {
+        if (!m_ops.empty())
+            Wait(m_ops.size() - 1);
+
+        m_ops.clear();
+        m_numIssued.fill(0);
+    }
+
+private:
+    enum class Stage : int
+    {
+        None = -1,
+        Reduce = 0,    // within the machine, onto the leader
+        AllReduce = 1, // across the leaders, or across all nodes if not hierarchical
+        Broadcast = 2, // within the machine, from the leader
+        Complete = 3
+    };
+
+    struct Operation
+    {
+        void* m_data;
+        int m_numElements;
+        int m_root; // -1: all nodes
+        MPI_Datatype m_dataType;
+        Stage m_stage; // stage that was issued last
+        MPI_Request m_request;
+    };
+
+    bool IsStageUsed(Stage stage) const
+    {
+        switch (stage)
+        {
+        case Stage::Reduce:
+        case Stage::Broadcast:
+            return m_hierarchical && (m_numLocalProcs > 1);
+        case Stage::AllReduce:
+            return !m_hierarchical || (m_isLeader && (m_numLeaders > 1));
+        default:
+            return true;
+        }
+    }
+
+    Stage NextStage(Stage stage) const
+    {
+        do
+        {
+            stage = (Stage) ((int) stage + 1);
+        } while (!IsStageUsed(stage));
+        return stage;
+    }
+
+    // Issues the next stages of operation 'index' that can be issued, returns whether it is complete.
+    bool Progress(size_t index)
+    {
+        Operation& op = m_ops[index];
+        while (op.m_stage != Stage::Complete)
+        {
+            if (op.m_request != MPI_REQUEST_NULL)
+            {
+                int completed = 0;
+                MPI_Test(&op.m_request, &completed, MPI_STATUS_IGNORE) || MpiFail("GradientAllReducer: MPI_Test");
+                if (!completed)
+                    return false;
+            }
+
+            // The stages are issued in the order of the operations, which then is the same on all nodes
+            Stage next = NextStage(op.m_stage);
+            if ((next != Stage::Complete) && (m_numIssued[(int) next] != index))
+                return false;
+
+            switch (next)
+            {
+            case Stage::Reduce:
+                MPI_Ireduce(m_isLeader ? MPI_IN_PLACE : op.m_data, op.m_data, op.m_numElements, op.m_dataType, MPI_SUM, 0, m_nodeReduceComm, &op.m_request) || MpiFail("GradientAllReducer: MPI_Ireduce");
+                break;
+            case Stage::AllReduce:
+                if (op.m_root >= 0)
+                {
+                    bool isRoot = (op.m_root == (int) m_mpi->CurrentNodeRank());
+                    MPI_Ireduce(isRoot ? MPI_IN_PLACE : op.m_data, op.m_data, op.m_numElements, op.m_dataType, MPI_SUM, op.m_root, m_mpi->Communicator(), &op.m_request) || MpiFail("GradientAllReducer: MPI_Ireduce");
+                    break;
+                }
+                // On Windows this async MPI_Iallreduce call requires MS MPI v7 or higher to be installed
+                MPI_Iallreduce(MPI_IN_PLACE, op.m_data, op.m_numElements, op.m_dataType, MPI_SUM, m_hierarchical ? m_leaderComm : m_mpi->Communicator(), &op.m_request) || MpiFail("GradientAllReducer: MPI_Iallreduce");
+                break;
+            case Stage::Broadcast:
+                MPI_Ibcast(op.m_data, op.m_numElements, op.m_dataType, 0, m_nodeBroadcastComm, &op.m_request) || MpiFail("GradientAllReducer: MPI_Ibcast");
+                break;
+            default:
+                break;
+            }
+
+            if (next != Stage::Complete)
+                m_numIssued[(int) next]++;
+            op.m_stage = next;
+        }
+        return true;
+    }
+
+    MPIWrapper* m_mpi;
+    bool m_hierarchical;
+
+    MPI_Comm m_nodeReduceComm;    // processes on this machine
+    MPI_Comm m_nodeBroadcastComm; // processes on this machine
+    MPI_Comm m_leaderComm;        // one process per machine, MPI_COMM_NULL on the other processes
+    bool m_isLeader;
+    size_t m_numLocalProcs;
+    size_t m_numLeaders;
+
+    std::vector<Operation> m_ops;
+    std::array<size_t, 3> m_numIssued; // number of operations that issued each stage
+};
+} } }
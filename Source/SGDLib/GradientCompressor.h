@@ -0,0 +1,246 @@
+#pragma once
+
+#include "Basics.h"
+#include "ColumnQuantizer.h"
+#include "QuantizedMatrix.h"
+#include <vector>
+#include <memory>
+#include <functional>
+#include <algorithm>
+#include <cstdint>
+#include <cmath>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Lossy compression of a gradient for its exchange between the nodes of data parallel training.
+// The compression works on the host copy of a (column-major) gradient. What a compression drops is kept as a residual,
+// which is added to the gradient of the next call (error feedback), so that nothing gets lost over time.
+// A compressor belongs to one gradient. Compressed data only has to be decompressed by compressors of gradients of the same shape.
+template <class ElemType>
+class IGradientCompressor
+{
+public:
+    virtual ~IGradientCompressor()
+    {
+    }
+
+    // Compresses 'gradient' plus the residual into 'buffer', and keeps the compression error as the new residual.
+    virtual void Compress(const ElemType* gradient, std::vector<char>& buffer) = 0;
+
+    // Adds the values of compressed data (of any node) to 'gradient'.
+    virtual void DecompressAndAdd(const char* data, size_t size, ElemType* gradient) const = 0;
+};
+
+// Creates the compressor of a gradient of the given shape, or returns nullptr to exchange it uncompressed.
+template <class ElemType>
+using GradientCompressorFactory = std::function<std::unique_ptr<IGradientCompressor<ElemType>>(size_t numRows, size_t numCols)>;
+
+// Column-wise quantization to 'numBits' bits with the quantizer of 1-bit SGD (see ColumnQuantizer).
+// The data is an array of QuantizedColumn's.
+template <class ElemType>
+class QuantizingGradientCompressor : public IGradientCompressor<ElemType>
+{
+public:
+    QuantizingGradientCompressor(size_t numRows, size_t numCols, size_t numBits, bool zeroThresholdFor1Bit)
+        : m_numRows(numRows), m_numCols(numCols), m_numBits(numBits), m_zeroThresholdFor1Bit(zeroThresholdFor1Bit), m_residual(numRows * numCols, 0)
+    {
+        if ((numBits == 0) || (numBits > 8 * sizeof(ElemType)) || ((numBits & (numBits - 1)) != 0))
+            InvalidArgument("QuantizingGradientCompressor: the number of bits has to be a power of 2 of at most %d.", (int) (8 * sizeof(ElemType)));
+
+        m_columnSize = QuantizedColumn<ElemType>::QuantizedColumnSize(m_numBits, m_numRows);
+    }
+
+    void Compress(const ElemType* gradient, std::vector<char>& buffer) override
+    {
+        buffer.resize(m_numCols * m_columnSize);
+        const size_t ldNbits = ValueQuantizer<ElemType>::ld(m_numBits);
+        ElemType* residual = m_residual.data();
+        for (size_t j = 0; j < m_numCols; j++)
+        {
+            auto& qcol = *(QuantizedColumn<ElemType>*) (buffer.data() + j * m_columnSize);
+            // Explicit use of 'template' keyword is needed to compile with GCC
+            if (m_zeroThresholdFor1Bit)
+                ColumnQuantizer<ElemType>::template ComputeRangeStatColj<true>(gradient, residual, (long) m_numRows, j, m_numBits, qcol.lower, qcol.upper);
+            else
+                ColumnQuantizer<ElemType>::template ComputeRangeStatColj<false>(gradient, residual, (long) m_numRows, j, m_numBits, qcol.lower, qcol.upper);
+
+            ColumnQuantizer<ElemType> q(ldNbits, qcol.lower, qcol.upper);
+            if (m_zeroThresholdFor1Bit)
+                q.template Quantize<true>(gradient, residual, (long) m_numRows, j, qcol.bits, residual);
+            else
+                q.template Quantize<false>(gradient, residual, (long) m_numRows, j, qcol.bits, residual);
+        }
+    }
+
+    void DecompressAndAdd(const char* data, size_t size, ElemType* gradient) const override
+    {
+        if (size != m_numCols * m_columnSize)
+            LogicError("QuantizingGradientCompressor: the compressed gradient has %d bytes instead of %d.", (int) size, (int) (m_numCols * m_columnSize));
+
+        const size_t ldNbits = ValueQuantizer<ElemType>::ld(m_numBits);
+        for (size_t j = 0; j < m_numCols; j++)
+        {
+            const auto& qcol = *(const QuantizedColumn<ElemType>*) (data + j * m_columnSize);
+            ColumnQuantizer<ElemType> q(ldNbits, qcol.lower, qcol.upper);
+            q.Unquantize(gradient, (long) m_numRows, j, qcol.bits, true);
+        }
+    }
+
+private:
+    size_t m_numRows;
+    size_t m_numCols;
+    size_t m_numBits;
+    bool m_zeroThresholdFor1Bit;
+    size_t m_columnSize; // bytes per quantized column
+    std::vector<ElemType> m_residual;
+};
+
+// Sparsification that only sends the 'ratio' largest values (by magnitude), and keeps the others as the residual.
+// The data is the number of values k (uint32_t), followed by k indices (uint32_t) and k values.
+template <class ElemType>
+class TopKGradientCompressor : public IGradientCompressor<ElemType>
+{
+public:
+    TopKGradientCompressor(size_t numRows, size_t numCols, double ratio)
+        : m_numElements(numRows * numCols), m_residual(numRows * numCols, 0)
+    {
+        if ((ratio <= 0) || (ratio > 1))
+            InvalidArgument("TopKGradientCompressor: the ratio of the values to send has to be in (0, 1].");
+        if (m_numElements > UINT32_MAX)
+            InvalidArgument("TopKGradientCompressor: gradients of %llu elements are too large.", (unsigned long long) m_numElements);
+
+        m_k = std::min(m_numElements, std::max((size_t) 1, (size_t) std::ceil(ratio * m_numElements)));
+        m_order.resize(m_numElements);
+    }
+
+    void Compress(const ElemType* gradient, std::vector<char>& buffer) override
+    {
+        ElemType* values = m_residual.data();
+        for (size_t i = 0; i < m_numElements; i++)
+        {
+            values[i] += gradient[i];
+            m_order[i] = (uint32_t) i;
+        }
+
+        std::nth_element(m_order.begin(), m_order.begin() + (m_k - 1), m_order.end(), [values](uint32_t a, uint32_t b)
+                         {
+                             return std::abs(values[a]) > std::abs(values[b]);
+                         });
+        // ascending indices make the additions cache friendly
+        std::sort(m_order.begin(), m_order.begin() + m_k);
+
+        uint32_t k = (uint32_t) m_k;
+        buffer.resize(sizeof(uint32_t) * (1 + m_k) + sizeof(ElemType) * m_k);
+        char* indices = buffer.data() + sizeof(uint32_t);
+        char* sentValues = indices + sizeof(uint32_t) * m_k;
+        memcpy(buffer.data(), &k, sizeof(k));
+        memcpy(indices, m_order.data(), sizeof(uint32_t) * m_k);
+        for (size_t j = 0; j < m_k; j++)
+        {
+            ElemType& value = values[m_order[j]];
+            memcpy(sentValues + j * sizeof(ElemType), &value, sizeof(ElemType));
+            value = 0;
+        }
+    }
+
+    void DecompressAndAdd(const char* data, size_t size, ElemType* gradient) const override
+    {
+        // the data is not necessarily aligned
+        uint32_t k = 0;
+        if (size >= sizeof(k))
+            memcpy(&k, data, sizeof(k));
+        if ((size < sizeof(k)) || (size != sizeof(uint32_t) * (1 + (size_t) k) + sizeof(ElemType) * k) || (k > m_numElements))
+            LogicError("TopKGradientCompressor: the compressed gradient is corrupt.");
+
+        const char* indices = data + sizeof(uint32_t);
+        const char* values = indices + sizeof(uint32_t) * k;
+        for (size_t j = 0; j < k; j++)
+        {
+            uint32_t index;
+            ElemType value;
+            memcpy(&index, indices + j * sizeof(uint32_t), sizeof(index));
+            memcpy(&value, values + j * sizeof(ElemType), sizeof(value));
+            if (index >= m_numElements)
+                LogicError("TopKGradientCompressor: the compressed gradient is corrupt.");
+            gradient[index] += value;
+        }
+    }
+
+private:
+    size_t m_numElements;
+    size_t m_k;
+    std::vector<ElemType> m_residual;
+    std::vector<uint32_t> m_order;
+};
+
+// Conversion to IEEE half precision (round to nearest even), with the rounding error as the residual.
+template <class ElemType>
+class Float16GradientCompressor : public IGradientCompressor<ElemType>
+{
+public:
+    Float16GradientCompressor(size_t numRows, size_t numCols)
+        : m_numElements(numRows * numCols), m_residual(numRows * numCols, 0)
+    {
+    }
+
+    void Compress(const ElemType* gradient, std::vector<char>& buffer) override
+    {
+        buffer.resize(sizeof(uint16_t) * m_numElements);
+        uint16_t* halves = (uint16_t*) buffer.data();
+        for (size_t i = 0; i < m_numElements; i++)
+        {
+            float value = (float) (gradient[i] + m_residual[i]);
+            halves[i] = FloatToHalf(value);
+            m_residual[i] = (ElemType) (value - HalfToFloat(halves[i]));
+        }
+    }
+
+    void DecompressAndAdd(const char* data, size_t size, ElemType* gradient) const override
+    {
+        if (size != sizeof(uint16_t) * m_numElements)
+            LogicError("Float16GradientCompressor: the compressed gradient has %d bytes instead of %d.", (int) size, (int) (sizeof(uint16_t) * m_numElements));
+
+        for (size_t i = 0; i < m_numElements; i++)
+        {
+            uint16_t half;
+            memcpy(&half, data + i * sizeof(half), sizeof(half));
+            gradient[i] += (ElemType) HalfToFloat(half);
+        }
+    }
+
+private:
+    size_t m_numElements;
+    std::vector<ElemType> m_residual;
+};
+
+enum class GradientCompressionType : int
+{
+    None = 0,
+    Quantization = 1, // to 'numBits' bits per value
+    TopK = 2,         // the 'topKRatio' largest values
+    Float16 = 3,
+};
+
+// Returns a factory of the configured compressors, which leaves gradients of less than 'minNumElements' elements uncompressed.
+template <class ElemType>
+GradientCompressorFactory<ElemType> GetGradientCompressorFactory(GradientCompressionType type, size_t numBits, bool zeroThresholdFor1Bit, double topKRatio, size_t minNumElements)
+{
+    return [=](size_t numRows, size_t numCols) -> std::unique_ptr<IGradientCompressor<ElemType>>
+    {
+        if (numRows * numCols < minNumElements)
+            return nullptr;
+
+        switch (type)
+        {
+        case GradientCompressionType::Quantization:
+            return std::unique_ptr<IGradientCompressor<ElemType>>(new QuantizingGradientCompressor<ElemType>(numRows, numCols, numBits, zeroThresholdFor1Bit));
+        case GradientCompressionType::TopK:
+            return std::unique_ptr<IGradientCompressor<ElemType>>(new TopKGradientCompressor<ElemType>(numRows, numCols, topKRatio));
+        case GradientCompressionType::Float16:
+            return std::unique_ptr<IGradientCompressor<ElemType>>(new Float16GradientCompressor<ElemType>(numRows, numCols));
+        default:
+            return nullptr;
+        }
+    };
+}
+} } }
@@ -2,6 +2,8 @@
 
 #include "DistGradHeader.h"
 #include "MPIWrapper.h"
+#include "GradientCompressor.h"
+#include <algorithm>
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -21,6 +23,34 @@ public:
     // Returns a boolean indicating if any samples were processed
     virtual bool AggregateGradients(const std::vector<Matrix<ElemType>*>& gradients, DistGradHeader* headerCPU, int epochNumber) = 0;
 
+    // Optional overlapping of the aggregation with the backprop. If this returns true, GradientReady() has to be called for
+    // each gradient as soon as the backprop has completed it, and AggregateGradients() with the same gradients finishes the
+    // aggregation. Aggregators that do not support it return false, and do all the work in AggregateGradients().
+    virtual bool BeginOverlappedAggregation(const std::vector<Matrix<ElemType>*>& /*gradients*/, int /*epochNumber*/)
+    {
+        return false;
+    }
+
+    virtual void GradientReady(size_t /*gradientIndex*/)
+    {
+    }
+
+    // Optional compression of the gradients. The factory is asked for a compressor for each gradient when the gradients are
+    // first aggregated; the gradients it returns no compressor for are exchanged as they are. Aggregators that compress
+    // in their own way ignore it.
+    void SetGradientCompressorFactory(const GradientCompressorFactory<ElemType>& factory)
+    {
+        m_compressorFactory = factory;
+    }
+
+    // Optional sharding of the update. Gradient i is only summed onto node owners[i], or onto all nodes for an owner of -1;
+    // the gradients of other owners are undefined after the aggregation. Aggregators that do not support it fail.
+    virtual void SetGradientOwners(const std::vector<int>& owners)
+    {
+        if (std::any_of(owners.begin(), owners.end(), [](int owner) { return owner >= 0; }))
+            LogicError("This gradient aggregator cannot sum the gradients onto their owners only.");
+    }
+
     size_t NumProc()
     {
         return m_mpi->NumNodesInUse();
@@ -38,12 +68,14 @@ public:
 
 protected:
     MPIWrapper* m_mpi;
+    GradientCompressorFactory<ElemType> m_compressorFactory;
 };
 
-#define UsingIDistGradAggregatorMembers           \
-    \
-protected:                                        \
-    using IDistGradAggregator<ElemType>::m_mpi;   \
-    using IDistGradAggregator<ElemType>::NumProc; \
+#define UsingIDistGradAggregatorMembers                       \
+                                                              \
+protected:                                                    \
+    using IDistGradAggregator<ElemType>::m_mpi;               \
+    using IDistGradAggregator<ElemType>::m_compressorFactory; \
+    using IDistGradAggregator<ElemType>::NumProc;             \
     using IDistGradAggregator<ElemType>::MyRank
 } } }
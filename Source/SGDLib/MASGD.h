@@ -11,12 +11,17 @@
 #include "SGD.h"
 #include "Matrix.h"
 #include "MPIWrapper.h"
+#include "GradientAllReducer.h"
+#include "MatrixQuantizerImpl.h"
 #include "TimerUtility.h"
+#include "TaskScheduler.h"
 #include <vector>
 #include <string>
 #include <stdexcept>
 #include <chrono> 
 #include <random>
+#include <future>
+#include <map>
 
 
 namespace Microsoft { namespace MSR { namespace CNTK {
@@ -60,7 +65,8 @@ namespace Microsoft { namespace MSR { namespace CNTK {
         {
             m_Timer.Stop();
         }
-        void OnMAPerformed(size_t localSamplesProcessedSinceLastSync, size_t totalSamplesProcessedSinceLastSync, float secondsOnCommunication)
+        // secondsOnHiddenCommunication: communication that overlapped with the training (async model aggregation)
+        void OnMAPerformed(size_t localSamplesProcessedSinceLastSync, size_t totalSamplesProcessedSinceLastSync, float secondsOnCommunication, float secondsOnHiddenCommunication = 0.0f)
         {
             m_numSyncPerformedInCurrentEpoch++;
             m_totalSamplesProcessedSinceLastReport += totalSamplesProcessedSinceLastSync; 
@@ -70,7 +76,8 @@ namespace Microsoft { namespace MSR { namespace CNTK {
                 ReportMAPerfStats(
                     m_totalSamplesProcessedSinceLastReport, 
                     m_localSamplesProcessedSinceLastReport, 
-                    secondsOnCommunication
+                    secondsOnCommunication,
+                    secondsOnHiddenCommunication
                 );
 
                 m_totalSamplesProcessedSinceLastReport = 0; 
@@ -80,7 +87,8 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 
         void ReportMAPerfStats( size_t totalSamplesProcessedSinceLastReport, 
                                 size_t localSamplesProcessedSinceLastReport, 
-                                float secondOnCommunication)
+                                float secondOnCommunication,
+                                float secondOnHiddenCommunication = 0.0f)
         {
             m_Timer.Stop(); 
             double secondsSinceLastReport = m_Timer.ElapsedSeconds(); 
@@ -93,7 +101,11 @@ namespace Microsoft { namespace MSR { namespace CNTK {
                             "\t\t(model aggregation stats) %d-th sync: totalThroughput = %.2fk samplesPerSecond , throughputPerWorker = %.2fk samplesPerSecond\n";
             fprintf(stderr, prefix.c_str(), m_numSyncPerformedInCurrentEpoch, secondsSinceLastReport, secondOnCommunication, totalSamplesProcessedSinceLastReport, m_numWorkers, localSamplesProcessedSinceLastReport,
                                             m_numSyncPerformedInCurrentEpoch, totalThroughput, throughputPerWorker); 
-
+            if (secondOnHiddenCommunication > 0)
+            {
+                fprintf(stderr, "\t\t(model aggregation stats) %d-th sync: %.2f seconds of exposed comm., %.2f seconds of comm. hidden behind training\n",
+                        (int)m_numSyncPerformedInCurrentEpoch, secondOnCommunication, secondOnHiddenCommunication);
+            }
         }
     };
     // base class for MA-SGD algorithm family 
@@ -107,6 +119,7 @@ namespace Microsoft { namespace MSR { namespace CNTK {
              m_numSyncPerformed(0), 
              m_numWorkers(pMPI->NumNodesInUse()), 
              m_myRank(pMPI->CurrentNodeRank()),
+             m_secondsOnHiddenCommunication(0.0f),
              m_pMPI(pMPI), 
              m_perfReporter(pMPI->CurrentNodeRank(), pMPI->NumNodesInUse())
          {
@@ -138,7 +151,8 @@ namespace Microsoft { namespace MSR { namespace CNTK {
              {
                  m_numSyncPerformed++;
                  ModelAggregationProcessing(samplesSinceLastSync, LearnableNodes, smoothedGradient, totalSamplesProcessed, secondsOnCommunication);
-                 m_perfReporter.OnMAPerformed(samplesSinceLastSync, totalSamplesProcessed, secondsOnCommunication);
+                 m_perfReporter.OnMAPerformed(samplesSinceLastSync, totalSamplesProcessed, secondsOnCommunication, m_secondsOnHiddenCommunication);
+                 m_secondsOnHiddenCommunication = 0.0f;
              }
              
              m_pMPI->WaitAll();             
@@ -158,7 +172,8 @@ namespace Microsoft { namespace MSR { namespace CNTK {
              {
                  m_numSyncPerformed++;
                  ModelAggregationProcessing(samplesSinceLastSync, LearnableNodes, smoothedGradient, totalSamplesProcessed, secondsOnCommunication);
-                 m_perfReporter.OnMAPerformed(samplesSinceLastSync, totalSamplesProcessed, secondsOnCommunication);
+                 m_perfReporter.OnMAPerformed(samplesSinceLastSync, totalSamplesProcessed, secondsOnCommunication, m_secondsOnHiddenCommunication);
+                 m_secondsOnHiddenCommunication = 0.0f;
              }
              return read2Sync;
          }
@@ -281,10 +296,33 @@ namespace Microsoft { namespace MSR { namespace CNTK {
             return node;
         }
 
+        // negotiates the contribution weight of this worker (its share of the samples processed by all workers since the last sync)
+        float NegotiateContribution(size_t samplesSinceLastSync, size_t& totalSamplesProcessed, float& secondsOnCommunication)
+        {
+            int   nTotalSamples = samplesSinceLastSync;
+            Timer commTimer;
+            commTimer.Start();
+            m_pMPI->AllReduce(&nTotalSamples, 1);
+            commTimer.Stop();
+            secondsOnCommunication += (float)commTimer.ElapsedSeconds();
+
+            if (nTotalSamples <= 0)
+            {
+                // prepare for overflow 
+                totalSamplesProcessed = samplesSinceLastSync * m_pMPI->NumNodesInUse();
+                // give an estimated one 
+                return 1.0f / m_pMPI->NumNodesInUse();
+            }
+
+            totalSamplesProcessed = nTotalSamples;
+            return (samplesSinceLastSync + 0.0f) / nTotalSamples;
+        }
+
         std::vector<MAWorkerStatus> m_MAworkerStatus; 
         int                         m_numSyncPerformed; 
         size_t                      m_numWorkers; 
         size_t                      m_myRank;
+        float                       m_secondsOnHiddenCommunication; // of the last sync, set by ModelAggregationProcessing()
         MASGDPerfStats              m_perfReporter;
         MPIWrapper*                 m_pMPI;       // TODO: to use shared_ptr in the future 
         
@@ -296,12 +334,18 @@ namespace Microsoft { namespace MSR { namespace CNTK {
     class BasicModelAveragingSGD : public IMASGD<ElemType>
     {
         typedef IMASGD<ElemType> Base; 
+        typedef shared_ptr<ComputationNode<ElemType>> ComputationNodePtr;
         using Base::m_pMPI;
         using Base::DownCast;
+        using Base::NegotiateContribution;
 
     public:
-        BasicModelAveragingSGD(MPIWrapper* pMPI, size_t reportFreq)
-            :Base(pMPI, reportFreq)
+        // The weighted models are packed into contiguous buffers on their device, of about bucketSizeInBytes each (0: one per device),
+        // so that there are only a few collectives, and the first buffers are unpacked while the later ones are still reduced.
+        // With useDeviceBuffers, GPU buffers are handed to MPI directly, which requires a CUDA-aware MPI; otherwise every buffer
+        // is staged through host memory. With useHierarchicalAllReduce, the models are summed within each machine first (see GradientAllReducer).
+        BasicModelAveragingSGD(MPIWrapper* pMPI, size_t reportFreq, bool useHierarchicalAllReduce = false, size_t bucketSizeInBytes = 0, bool useDeviceBuffers = false)
+            :Base(pMPI, reportFreq), m_bucketSizeInBytes(bucketSizeInBytes), m_useDeviceBuffers(useDeviceBuffers), m_allReducer(pMPI, useHierarchicalAllReduce)
         {}
 
         
@@ -315,58 +359,367 @@ namespace Microsoft { namespace MSR { namespace CNTK {
             //----------------------------------------
             // 1. communicate with other nodes to negotiate  contribution weights
             //----------------------------------------
-            float factor = 0;
-            int   nTotalSamples = samplesSinceLastSync;
-            Timer commTimer; 
             secondsOnCommunication = 0.0f;
+            float factor = NegotiateContribution(samplesSinceLastSync, totalSamplesProcessed, secondsOnCommunication);
+
+            //========================================
+            // 2. pack the weighted models
+            //========================================
+            std::vector<ComputationNodePtr> nodes;
+            for (auto& pBaseNode : learnableNodes)
+            {
+                if (pBaseNode->IsParameterUpdateRequired())
+                    nodes.push_back(DownCast(pBaseNode));
+            }
+            CreateBuckets(nodes);
+
+            for (auto& bucket : m_buckets)
+            {
+                size_t offset = 0;
+                for (auto& pNode : bucket.m_nodes)
+                {
+                    const auto& value = pNode->Value();
+                    size_t nx = value.GetNumElements();
+                    bucket.m_buffer->SetColumnSlice(value.Reshaped(1, nx), offset, nx);
+                    offset += nx;
+                }
+                Matrix<ElemType>::Scale((ElemType)factor, *bucket.m_buffer);
+            }
+
+            //========================================
+            // 3. sum the models of all nodes, and unpack the averages
+            //========================================
+            Timer commTimer;
             commTimer.Start();
-            m_pMPI->AllReduce(&nTotalSamples, 1);
+            std::vector<size_t> allReduceOperations(m_buckets.size());
+            for (size_t i = 0; i < m_buckets.size(); i++)
+            {
+                auto& bucket = m_buckets[i];
+                ElemType* reductionBuffer = bucket.m_buffer->BufferPointer();
+                if (bucket.m_hostBuffer)
+                {
+                    bucket.m_buffer->CopySection(1, bucket.m_numElements, bucket.m_hostBuffer.get(), 1);
+                    reductionBuffer = bucket.m_hostBuffer.get();
+                }
+                else if (bucket.m_buffer->GetDeviceId() >= 0)
+                {
+                    // device buffers are read by MPI directly, once the packing is complete
+                    std::unique_ptr<MatrixComputeStreamEvent> mainStreamSyncEvent(MatrixComputeStreamEvent::Create(bucket.m_buffer->GetDeviceId()));
+                    mainStreamSyncEvent->SynchronizeEvent();
+                }
+                allReduceOperations[i] = m_allReducer.Start(reductionBuffer, bucket.m_numElements);
+            }
+
+            for (size_t i = 0; i < m_buckets.size(); i++)
+            {
+                auto& bucket = m_buckets[i];
+                m_allReducer.Wait(allReduceOperations[i]);
+                if (bucket.m_hostBuffer)
+                    bucket.m_buffer->SetValue(1, bucket.m_numElements, bucket.m_buffer->GetDeviceId(), bucket.m_hostBuffer.get());
+
+                size_t offset = 0;
+                for (auto& pNode : bucket.m_nodes)
+                {
+                    auto& value = pNode->Value();
+                    size_t nx = value.GetNumElements();
+                    value.SetValue(bucket.m_buffer->ColumnSlice(offset, nx).Reshaped(value.GetNumRows(), value.GetNumCols()));
+                    offset += nx;
+                }
+            }
+            m_allReducer.WaitAll();
             commTimer.Stop();
             secondsOnCommunication += (float)commTimer.ElapsedSeconds();
+        }
 
-            if (nTotalSamples <= 0)
+    private:
+        struct ModelBucket
+        {
+            std::vector<ComputationNodePtr> m_nodes;
+            size_t m_numElements;
+            shared_ptr<Matrix<ElemType>> m_buffer; // 1 x m_numElements, on the device of the nodes
+            unique_ptr<ElemType[]> m_hostBuffer;   // to stage a GPU buffer through, without useDeviceBuffers
+        };
+
+        // Assigns the nodes to buckets, in their order, which is the same on all nodes. The buckets are kept as long as the models do not change.
+        void CreateBuckets(const std::vector<ComputationNodePtr>& nodes)
+        {
+            std::vector<std::pair<ComputationNodePtr, size_t>> layout;
+            for (auto& pNode : nodes)
+                layout.push_back(make_pair(pNode, pNode->Value().GetNumElements()));
+            if (layout == m_layout)
+                return;
+
+            m_layout = layout;
+            m_buckets.clear();
+            std::vector<DEVICEID_TYPE> deviceIds;
+            for (auto& pNode : nodes)
             {
-                // prepare for overflow 
-                factor = 1.0f / g_mpi->NumNodesInUse();
-                totalSamplesProcessed = samplesSinceLastSync * m_pMPI->NumNodesInUse();
-                // give an estimated one 
+                DEVICEID_TYPE deviceId = pNode->Value().GetDeviceId();
+                size_t nx = pNode->Value().GetNumElements();
+                bool isFull = (m_bucketSizeInBytes > 0) && !m_buckets.empty() && ((m_buckets.back().m_numElements + nx) * sizeof(ElemType) > m_bucketSizeInBytes);
+                if (m_buckets.empty() || (deviceIds.back() != deviceId) || isFull)
+                {
+                    m_buckets.push_back(ModelBucket());
+                    m_buckets.back().m_numElements = 0;
+                    deviceIds.push_back(deviceId);
+                }
+                m_buckets.back().m_nodes.push_back(pNode);
+                m_buckets.back().m_numElements += nx;
             }
-            else
+
+            for (size_t i = 0; i < m_buckets.size(); i++)
             {
-                factor = (samplesSinceLastSync + 0.0f) / nTotalSamples;
-                totalSamplesProcessed = nTotalSamples;
+                auto& bucket = m_buckets[i];
+                bucket.m_buffer = make_shared<Matrix<ElemType>>(1, bucket.m_numElements, deviceIds[i]);
+                if ((deviceIds[i] >= 0) && !m_useDeviceBuffers)
+                    bucket.m_hostBuffer.reset(new ElemType[bucket.m_numElements]);
             }
+        }
 
-            //========================================
-            // 2. process for each individual node
-            //========================================
+        size_t m_bucketSizeInBytes;
+        bool m_useDeviceBuffers;
+        GradientAllReducer m_allReducer;
+        std::vector<ModelBucket> m_buckets;
+        std::vector<std::pair<ComputationNodePtr, size_t>> m_layout; // nodes and sizes the buckets were created for
+    };
+
+    // Blockwise model update filtering (BMUF, K. Chen and Q. Huo, ICASSP 2016): the average of the local models is treated as
+    // a block-level gradient G = average - W of the global model W, which is then updated with block momentum:
+    //     delta = blockMomentum * delta + blockLearningRate * G,   W = W + delta
+    // The workers continue from W, or from W + blockMomentum * delta with Nesterov block momentum.
+    // With async aggregation, the models are averaged on a background thread from snapshots taken at the sync point, while the
+    // workers continue to train. The update is applied at the next sync point, keeping the local progress made in the meantime.
+    // With a block momentum of 0 and a block learning rate of 1, this is model averaging.
+    template<typename ElemType>
+    class BlockMomentumSGD : public IMASGD<ElemType>
+    {
+        typedef IMASGD<ElemType> Base; 
+        typedef shared_ptr<ComputationNode<ElemType>> ComputationNodePtr;
+        using Base::m_pMPI;
+        using Base::DownCast;
+        using Base::NegotiateContribution;
+        using Base::m_secondsOnHiddenCommunication;
+
+    public:
+        BlockMomentumSGD(MPIWrapper* pMPI, size_t reportFreq, double blockMomentum, double blockLearningRate, bool useNesterovMomentum,
+                         bool resetSGDMomentum, bool useAsyncAggregation, bool useHierarchicalAllReduce)
+            : Base(pMPI, reportFreq), m_blockMomentum((ElemType)blockMomentum), m_blockLearningRate((ElemType)blockLearningRate), m_useNesterovMomentum(useNesterovMomentum),
+              m_resetSGDMomentum(resetSGDMomentum), m_useAsyncAggregation(useAsyncAggregation), m_useHierarchicalAllReduce(useHierarchicalAllReduce),
+              m_isAtEpochEnd(false), m_secondsWaited(0.0f)
+        {
+            fprintf(stderr, "BlockMomentumSGD: block momentum = %.6g, block learning rate = %.6g, Nesterov = %s, %s model aggregation\n",
+                    blockMomentum, blockLearningRate, useNesterovMomentum ? "true" : "false", useAsyncAggregation ? "async" : "sync");
+        }
+
+        ~BlockMomentumSGD()
+        {
+            // let an aggregation that is still in flight (e.g. after an exception) run out
+            if (m_pendingAggregation.valid())
+            {
+                try
+                {
+                    m_pendingAggregation.get();
+                }
+                catch (...)
+                {
+                }
+            }
+        }
+
+        void OnEpochStart(const std::list<ComputationNodeBasePtr>& learnableNodes) override
+        {
+            Base::OnEpochStart(learnableNodes);
+
+            // The models of all workers are the same here, and they may have been reloaded (e.g. by the learning rate control).
+            // The block momentum is kept.
+            for (auto& pBaseNode : learnableNodes)
+            {
+                if (pBaseNode->IsParameterUpdateRequired())
+                    GetState(DownCast(pBaseNode)).m_globalModel->SetValue(DownCast(pBaseNode)->Value());
+            }
+        }
+
+        void OnEpochEnd(const std::list<ComputationNodeBasePtr>& learnableNodes,
+                        std::list<Matrix<ElemType>>&             smoothedGradient,
+                        size_t                                   samplesSinceLastSync) override
+        {
+            // MPI is only used by one thread at a time
+            FinishPendingAggregation(smoothedGradient);
+
+            // the last aggregation of the epoch is synchronous, so that all workers end up with the same model
+            m_isAtEpochEnd = true;
+            Base::OnEpochEnd(learnableNodes, smoothedGradient, samplesSinceLastSync);
+            m_isAtEpochEnd = false;
+        }
+
+        bool OnArrivingAtSyncPoint(const std::list<ComputationNodeBasePtr>& learnableNodes,
+                                   std::list<Matrix<ElemType>>&             smoothedGradient,
+                                   size_t                                   samplesSinceLastSync) override
+        {
+            FinishPendingAggregation(smoothedGradient);
+            return Base::OnArrivingAtSyncPoint(learnableNodes, smoothedGradient, samplesSinceLastSync);
+        }
+
+        void ModelAggregationProcessing(
+            size_t samplesSinceLastSync,                                       /* in */
+            const std::list<ComputationNodeBasePtr>&  learnableNodes,          /* in/out */
+            std::list<Matrix<ElemType>>&              smoothedGradient,        /* in/out */
+            size_t&                                   totalSamplesProcessed,   /* out */
+            float&                                    secondsOnCommunication   /* out */) override
+        {
+            // time spent waiting for the previous async aggregation at this sync point
+            secondsOnCommunication = m_secondsWaited;
+            m_secondsWaited = 0.0f;
+
+            float factor = NegotiateContribution(samplesSinceLastSync, totalSamplesProcessed, secondsOnCommunication);
+
+            // snapshot the local models, and their contributions to the average
+            m_aggregatedStates.clear();
             for (auto& pBaseNode : learnableNodes)
             {
                 if (!pBaseNode->IsParameterUpdateRequired())
                 {
                     continue;
                 }
-                // 2.1 model averaging
                 auto pNode = DownCast(pBaseNode);
-                // 2.1.1. average model from individual models 
-                Matrix<ElemType> mat(pNode->Value()); // pNode->Value returns lvalue, so a deep copy is invoked here
-                // 2.1.2. normalize the weight matrix 
-                Matrix<ElemType>::Scale(factor, mat);
-                // 2.1.3. send weight matrix over MPI nodes; 
-                unique_ptr<ElemType[]> px(mat.CopyToArray());
-                //ElemType* px = mat.CopyToArray();
-                size_t    nx = mat.GetNumElements();
-                // 2.1.4. inplace sum 
-                commTimer.Restart();
-                m_pMPI->AllReduce(px.get(), nx);
-                commTimer.Stop();
-                secondsOnCommunication += (float)commTimer.ElapsedSeconds();
-                // 2.1.5. set value 
-                pNode->Value().SetValue(mat.GetNumRows(), mat.GetNumCols(), mat.GetDeviceId(), px.get());
-                // 2.1.6. clean up 
-                //delete[]px;
+                auto& state = GetState(pNode);
+                state.m_node = pNode;
+                state.m_snapshot->SetValue(pNode->Value());
+                Matrix<ElemType> mat(pNode->Value());
+                Matrix<ElemType>::Scale((ElemType)factor, mat);
+                state.m_contribution.reset(mat.CopyToArray());
+                m_aggregatedStates.push_back(&state);
+            }
+
+            if (m_useAsyncAggregation && !m_isAtEpochEnd)
+            {
+                m_pendingAggregation = TaskScheduler::Instance().Submit(TaskClass::aggregation, [this]() { return SumContributions(); });
+            }
+            else
+            {
+                secondsOnCommunication += SumContributions();
+                ApplyBlockUpdate(smoothedGradient, false /*keepLocalProgress*/);
             }
         }
+
+    private:
+        struct BlockState
+        {
+            ComputationNodePtr m_node;
+            shared_ptr<Matrix<ElemType>> m_globalModel;
+            shared_ptr<Matrix<ElemType>> m_delta;         // block momentum
+            shared_ptr<Matrix<ElemType>> m_snapshot;      // local model at the last sync point
+            unique_ptr<ElemType[]> m_contribution;        // weighted local model, the average after the aggregation
+        };
+
+        BlockState& GetState(const ComputationNodePtr& pNode)
+        {
+            auto& state = m_states[pNode->NodeName()];
+            if (!state.m_globalModel)
+            {
+                const auto& value = pNode->Value();
+                state.m_globalModel = make_shared<Matrix<ElemType>>(value);
+                state.m_delta = make_shared<Matrix<ElemType>>(value.GetNumRows(), value.GetNumCols(), value.GetDeviceId());
+                state.m_delta->SetValue(0);
+                state.m_snapshot = make_shared<Matrix<ElemType>>(value);
+            }
+            return state;
+        }
+
+        // Sums the contributions of all workers, in place; returns the seconds it took.
+        // Only touches host memory, so that it can run on a background thread.
+        float SumContributions()
+        {
+            Timer commTimer;
+            commTimer.Start();
+            for (auto state : m_aggregatedStates)
+            {
+                size_t nx = state->m_snapshot->GetNumElements();
+                if (m_useHierarchicalAllReduce)
+                    m_pMPI->HierarchicalAllReduce(state->m_contribution.get(), nx);
+                else
+                    m_pMPI->AllReduce(state->m_contribution.get(), nx);
+            }
+            commTimer.Stop();
+            return (float)commTimer.ElapsedSeconds();
+        }
+
+        void FinishPendingAggregation(std::list<Matrix<ElemType>>& smoothedGradient)
+        {
+            if (!m_pendingAggregation.valid())
+            {
+                return;
+            }
+
+            Timer waitTimer;
+            waitTimer.Start();
+            float secondsOnAggregation = m_pendingAggregation.get();
+            waitTimer.Stop();
+            m_secondsWaited = (float)waitTimer.ElapsedSeconds();
+            m_secondsOnHiddenCommunication = std::max(0.0f, secondsOnAggregation - m_secondsWaited);
+
+            ApplyBlockUpdate(smoothedGradient, true /*keepLocalProgress*/);
+        }
+
+        // Updates the global models with the averaged models, and moves the local models to the start of the next block.
+        void ApplyBlockUpdate(std::list<Matrix<ElemType>>& smoothedGradient, bool keepLocalProgress)
+        {
+            for (auto state : m_aggregatedStates)
+            {
+                auto& value = state->m_node->Value();
+                Matrix<ElemType>& globalModel = *state->m_globalModel;
+                Matrix<ElemType>& delta = *state->m_delta;
+
+                // block gradient G = average - W
+                Matrix<ElemType> blockGradient(value.GetNumRows(), value.GetNumCols(), value.GetDeviceId());
+                blockGradient.SetValue(value.GetNumRows(), value.GetNumCols(), value.GetDeviceId(), state->m_contribution.get());
+                blockGradient -= globalModel;
+                state->m_contribution.reset();
+
+                // delta = blockMomentum * delta + blockLearningRate * G;  W = W + delta
+                Matrix<ElemType>::ScaleAndAdd(m_blockLearningRate, blockGradient, m_blockMomentum, delta);
+                globalModel += delta;
+
+                // the start of the next block; the final model of an epoch is the global model itself
+                Matrix<ElemType> blockStart(globalModel);
+                if (m_useNesterovMomentum && !m_isAtEpochEnd)
+                {
+                    Matrix<ElemType>::ScaleAndAdd(m_blockMomentum, delta, blockStart);
+                }
+
+                if (keepLocalProgress)
+                {
+                    // value = blockStart + (value - snapshot)
+                    value -= *state->m_snapshot;
+                    value += blockStart;
+                }
+                else
+                {
+                    value.SetValue(blockStart);
+                }
+                state->m_node = nullptr;
+            }
+            m_aggregatedStates.clear();
+
+            if (m_resetSGDMomentum)
+            {
+                for (auto& gradient : smoothedGradient)
+                    gradient.SetValue(0);
+            }
+        }
+
+        ElemType m_blockMomentum;
+        ElemType m_blockLearningRate;
+        bool m_useNesterovMomentum;
+        bool m_resetSGDMomentum;
+        bool m_useAsyncAggregation;
+        bool m_useHierarchicalAllReduce;
+
+        std::map<std::wstring, BlockState> m_states; // by node name, the same order on all workers
+        std::vector<BlockState*> m_aggregatedStates; // of the last sync point
+        std::future<float> m_pendingAggregation;
+        bool m_isAtEpochEnd;
+        float m_secondsWaited;
     };
 
 } } }
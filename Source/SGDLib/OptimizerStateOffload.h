@@ -0,0 +1,159 @@
+// OptimizerStateOffload.h -- keeps the smoothed gradients in host memory and streams them through the GPU for the updates
+
+#pragma once
+
+#include "Basics.h"
+#include "Matrix.h"
+#include "GPUDataTransferer.h"
+#include "CUDAPageLockedMemAllocator.h"
+#include <map>
+#include <memory>
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// -----------------------------------------------------------------------
+// OptimizerStateOffload -- the learner state of the GPU parameters lives in page-locked host memory
+//
+// SGD creates the smoothed gradients as CPU matrices, and the updates of a minibatch run on the GPU as before, each on a
+// device copy of its state. There are two device buffers: while parameter i is updated in one, the state of parameter
+// i+1 is copied into the other on the assign stream of GPUDataTransferer, and the new state of parameter i-1 is copied
+// back on its fetch stream. So the GPU holds the state of two parameters rather than of all, and the copies overlap with
+// the updates. The copies only wait for each other and for the compute stream on the device. Before the host reads or
+// writes the states, e.g. for a checkpoint, it has to call WaitForUpdates().
+// The host matrices are page-locked in place (see CUDAPageLockedMemAllocator::Register()) for as long as the object lives.
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+class OptimizerStateOffload
+{
+public:
+    OptimizerStateOffload(DEVICEID_TYPE deviceId)
+        : m_deviceId(deviceId)
+    {
+        for (size_t b = 0; b < 2; b++)
+        {
+            m_transferers[b].reset(new GPUDataTransferer<ElemType>(deviceId, /*useConcurrentStreams=*/true));
+            m_buffers[b].reset(new Matrix<ElemType>(deviceId));
+        }
+    }
+
+    ~OptimizerStateOffload()
+    {
+        WaitForUpdates();
+        for (const auto& pinned : m_pinned)
+            CUDAPageLockedMemAllocator::Unregister(pinned.second.first, m_deviceId);
+    }
+
+    // Disallow copy and move construction and assignment
+    DISABLE_COPY_AND_MOVE(OptimizerStateOffload);
+
+    // on the main stream, before the updates of a minibatch, with the states in the order of the updates
+    void BeginUpdates(const std::vector<Matrix<ElemType>*>& states)
+    {
+        m_states = states;
+        PinStates();
+        if (!m_states.empty())
+            Prefetch(0);
+    }
+
+    // the device copy of state i, to be passed to the update of its parameter
+    Matrix<ElemType>& BeginUpdate(size_t i)
+    {
+        if (i + 1 < m_states.size())
+            Prefetch(i + 1);
+        m_transferers[i % 2]->WaitForCopyCPUToGPUOnComputeStreamAsync();
+        return *m_buffers[i % 2];
+    }
+
+    // after the update of state i was issued
+    void EndUpdate(size_t i)
+    {
+        Matrix<ElemType>& state = *m_states[i];
+        Matrix<ElemType>& buffer = *m_buffers[i % 2];
+        auto& transferer = *m_transferers[i % 2];
+        if (buffer.GetNumRows() != state.GetNumRows() || buffer.GetNumCols() != state.GetNumCols())
+        {
+            // The first update of some learners widens their state, e.g. Adam keeps two values per weight.
+            // The old host buffer is read by the copy to the device until then.
+            transferer.WaitForCopyCPUToGPUAsync();
+            Unpin(state);
+            state.Resize(buffer.GetNumRows(), buffer.GetNumCols());
+            Pin(state);
+        }
+        transferer.RecordComputeStreamSyncPoint();
+        transferer.WaitForSyncPointOnFetchStreamAsync();
+        if (state.GetNumElements() > 0)
+            transferer.CopyGPUToCPUAsync(buffer.BufferPointer(), state.GetNumElements(), state.BufferPointer());
+    }
+
+    // blocks until the host holds the states of the last updates
+    void WaitForUpdates()
+    {
+        for (size_t b = 0; b < 2; b++)
+            m_transferers[b]->WaitForCopyGPUToCPUAsync();
+    }
+
+private:
+    void Prefetch(size_t i)
+    {
+        Matrix<ElemType>& state = *m_states[i];
+        Matrix<ElemType>& buffer = *m_buffers[i % 2];
+        auto& transferer = *m_transferers[i % 2];
+        // The buffer is free once the state of its previous update is copied back, which waited for that update. The copies
+        // back of both buffers are on the same stream, so this also orders the copy after that of the last minibatch.
+        transferer.WaitForCopyGPUToCPUOnAssignStreamAsync();
+        m_transferers[1 - i % 2]->WaitForCopyGPUToCPUOnAssignStreamAsync();
+        buffer.Resize(state.GetNumRows(), state.GetNumCols());
+        if (state.GetNumElements() > 0)
+            transferer.CopyCPUToGPUAsync(state.BufferPointer(), state.GetNumElements(), buffer.BufferPointer());
+    }
+
+    // Pages of the host matrices are locked where they are now. A matrix that was reallocated since, e.g. by loading a
+    // checkpoint, is unlocked first, all of them before any is locked again, since the old and new buffers may overlap.
+    void PinStates()
+    {
+        std::vector<Matrix<ElemType>*> changed;
+        for (auto* state : m_states)
+        {
+            auto pinned = m_pinned.find(state);
+            bool isPinned = pinned != m_pinned.end() && pinned->second.first == state->BufferPointer() &&
+                            pinned->second.second == state->GetNumElements() * sizeof(ElemType);
+            if (!isPinned)
+                changed.push_back(state);
+        }
+        if (changed.empty())
+            return;
+
+        WaitForUpdates();
+        for (auto* state : changed)
+            Unpin(*state);
+        for (auto* state : changed)
+            Pin(*state);
+    }
+
+    void Pin(Matrix<ElemType>& state)
+    {
+        size_t size = state.GetNumElements() * sizeof(ElemType);
+        if (size == 0)
+            return;
+        CUDAPageLockedMemAllocator::Register(state.BufferPointer(), size, m_deviceId);
+        m_pinned[&state] = std::make_pair((void*) state.BufferPointer(), size);
+    }
+
+    void Unpin(Matrix<ElemType>& state)
+    {
+        auto pinned = m_pinned.find(&state);
+        if (pinned == m_pinned.end())
+            return;
+        CUDAPageLockedMemAllocator::Unregister(pinned->second.first, m_deviceId);
+        m_pinned.erase(pinned);
+    }
+
+    DEVICEID_TYPE m_deviceId;
+    std::unique_ptr<GPUDataTransferer<ElemType>> m_transferers[2]; // [b] copies to and from buffer b
+    std::unique_ptr<Matrix<ElemType>> m_buffers[2];                // [i % 2] device copy of state i
+    std::vector<Matrix<ElemType>*> m_states;                       // of the updates of the current minibatch
+    std::map<Matrix<ElemType>*, std::pair<void*, size_t>> m_pinned; // [host matrix] locked buffer and its size in bytes
+};
+} } }
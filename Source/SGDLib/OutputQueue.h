@@ -0,0 +1,86 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <algorithm>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// -----------------------------------------------------------------------
+// OutputQueue -- bounded queue that hands the outputs of minibatches from the evaluation to a writer thread
+// Push() blocks while the queue is full, so the evaluation can run at most 'capacity' minibatches ahead of the disk.
+// The first failure on either side, reported with Fail(), stops both.
+// -----------------------------------------------------------------------
+
+template <class T>
+class OutputQueue
+{
+public:
+    OutputQueue(size_t capacity)
+        : m_capacity(std::max(capacity, (size_t) 1)), m_closed(false)
+    {
+    }
+
+    // blocks while the queue is full; returns false if the writer has failed
+    bool Push(T&& item)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_cv.wait(lock, [this]() { return m_queue.size() < m_capacity || m_error; });
+        if (m_error)
+            return false;
+        m_queue.push_back(std::move(item));
+        m_cv.notify_all();
+        return true;
+    }
+
+    // blocks until an item is available; returns false after Close() once the queue is empty, or after a failure
+    bool Pop(T& item)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_cv.wait(lock, [this]() { return !m_queue.empty() || m_closed || m_error; });
+        if (m_error || m_queue.empty())
+            return false;
+        item = std::move(m_queue.front());
+        m_queue.pop_front();
+        m_cv.notify_all();
+        return true;
+    }
+
+    void Close()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_closed = true;
+        m_cv.notify_all();
+    }
+
+    void Fail(std::exception_ptr error)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_error)
+            m_error = error;
+        m_cv.notify_all();
+    }
+
+    // call this after the writer thread has been joined
+    void RethrowIfFailed()
+    {
+        if (m_error)
+            std::rethrow_exception(m_error);
+    }
+
+private:
+    const size_t m_capacity;
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::deque<T> m_queue;
+    bool m_closed;
+    std::exception_ptr m_error;
+};
+
+} } }
@@ -0,0 +1,315 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include "MASGD.h"
+#include <cstdint>
+#include <limits>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+    // Asynchronous data-parallel SGD with a parameter server (DataParallelASGD).
+    // Every worker trains its own copy of the model. At each sync point it pushes the change of each learnable parameter since its last
+    // pull, which the server adds to the global model, and pulls the global model back; no worker waits for the others to get there.
+    // The global model is sharded over all workers: each parameter is split into one contiguous slice per worker, which the worker
+    // hosts in an MPI window, and the pushes and pulls are one-sided MPI operations, so the workers are the server processes as well.
+    // Staleness is bounded (stale synchronous parallel): a worker that is more than maxStaleness syncs ahead of the slowest worker
+    // waits, a bound of 0 lets workers at most one sync apart. At the end of every epoch, all workers continue with the same model.
+    template<typename ElemType>
+    class ParameterServerSGD : public IMASGD<ElemType>
+    {
+        typedef IMASGD<ElemType> Base;
+        typedef shared_ptr<ComputationNode<ElemType>> ComputationNodePtr;
+        using Base::m_pMPI;
+        using Base::m_numWorkers;
+        using Base::m_myRank;
+        using Base::m_numSyncPerformed;
+        using Base::m_perfReporter;
+        using Base::DownCast;
+
+    public:
+        ParameterServerSGD(MPIWrapper* pMPI, size_t reportFreq, size_t maxStaleness)
+            : Base(pMPI, reportFreq), m_maxStaleness(maxStaleness), m_shardWindow(MPI_WIN_NULL), m_clockWindow(MPI_WIN_NULL),
+              m_shard(nullptr), m_clocks(nullptr), m_clock(0), m_totalSamplesAtLastSync(0)
+        {
+            fprintf(stderr, "ParameterServerSGD: %d workers, max staleness = %d syncs\n", (int)m_numWorkers, (int)maxStaleness);
+        }
+
+        ~ParameterServerSGD()
+        {
+            // Errors are ignored, the destructor may run because of a failed sync
+            for (MPI_Win* window : {&m_clockWindow, &m_shardWindow})
+            {
+                if (*window != MPI_WIN_NULL)
+                {
+                    MPI_Win_unlock_all(*window);
+                    MPI_Win_free(window);
+                }
+            }
+        }
+
+        void OnEpochStart(const std::list<ComputationNodeBasePtr>& learnableNodes) override
+        {
+            Base::OnEpochStart(learnableNodes);
+            if (m_shardWindow == MPI_WIN_NULL)
+                CreateWindows(learnableNodes);
+
+            // The models of all workers are the same here, and they may have been reloaded (e.g. by the learning rate control).
+            // Every worker writes its slices into its own shard, and restarts its clock.
+            for (auto& state : m_states)
+            {
+                auto& value = state.second.m_node->Value();
+                state.second.m_snapshot->SetValue(value);
+                state.second.m_pushBuffer.reset(value.CopyToArray());
+                size_t begin = SliceBegin(state.second, m_myRank);
+                Accumulate(state.second.m_pushBuffer.get() + begin, SliceBegin(state.second, m_myRank + 1) - begin, m_myRank, state.second.m_windowOffset, MPI_REPLACE);
+            }
+            MPI_Win_flush(m_myRank, m_shardWindow) || MpiFail("ParameterServerSGD: MPI_Win_flush");
+            SetClock(0);
+            m_clock = 0;
+            if (m_pMPI->IsMainNode())
+                AddSamples(0, MPI_REPLACE);
+            m_totalSamplesAtLastSync = 0;
+            m_pMPI->WaitAll(); // no pushes before all shards are written
+        }
+
+        void OnEpochEnd(const std::list<ComputationNodeBasePtr>& learnableNodes,
+                        std::list<Matrix<ElemType>>&             /*smoothedGradient*/,
+                        size_t                                   samplesSinceLastSync) override
+        {
+            float secondsOnCommunication = 0.0f;
+            Timer commTimer;
+            commTimer.Start();
+
+            // the last push of the epoch, then all workers pull the final model
+            Push();
+            SetClock(std::numeric_limits<int64_t>::max()); // done, the others do not wait for this worker
+            AddSamples(samplesSinceLastSync);
+            m_pMPI->WaitAll();
+            Pull();
+
+            commTimer.Stop();
+            secondsOnCommunication += (float)commTimer.ElapsedSeconds();
+            m_numSyncPerformed++;
+            m_perfReporter.OnMAPerformed(samplesSinceLastSync, TotalSamplesSinceLastSync(), secondsOnCommunication);
+
+            m_pMPI->WaitAll();
+            m_perfReporter.OnEpochEnd();
+        }
+
+        // Syncs without waiting for the other workers, safe for the staleness bound.
+        bool OnArrivingAtSyncPoint(const std::list<ComputationNodeBasePtr>& learnableNodes,
+                                   std::list<Matrix<ElemType>>&             smoothedGradient,
+                                   size_t                                   samplesSinceLastSync) override
+        {
+            size_t totalSamplesProcessed = 0;
+            float secondsOnCommunication = 0.0f;
+            m_numSyncPerformed++;
+            ModelAggregationProcessing(samplesSinceLastSync, learnableNodes, smoothedGradient, totalSamplesProcessed, secondsOnCommunication);
+            m_perfReporter.OnMAPerformed(samplesSinceLastSync, totalSamplesProcessed, secondsOnCommunication);
+            return true;
+        }
+
+        void ModelAggregationProcessing(
+            size_t samplesSinceLastSync,                                       /* in */
+            const std::list<ComputationNodeBasePtr>&  /*learnableNodes*/,      /* in/out */
+            std::list<Matrix<ElemType>>&              /*smoothedGradient*/,    /* in/out */
+            size_t&                                   totalSamplesProcessed,   /* out */
+            float&                                    secondsOnCommunication   /* out */) override
+        {
+            Timer commTimer;
+            commTimer.Start();
+
+            // The pull of each parameter is issued right after its push. Accumulate operations of one worker on the same location
+            // are ordered, so the pulled model includes this worker's own update.
+            Push(true /*andPull*/);
+            AddSamples(samplesSinceLastSync);
+            SetClock(++m_clock);
+            WaitForSlowestWorker();
+            totalSamplesProcessed = TotalSamplesSinceLastSync();
+
+            commTimer.Stop();
+            secondsOnCommunication = (float)commTimer.ElapsedSeconds();
+        }
+
+    private:
+        struct ParameterState
+        {
+            ComputationNodePtr m_node;
+            shared_ptr<Matrix<ElemType>> m_snapshot; // local model at the last pull
+            unique_ptr<ElemType[]> m_pushBuffer;      // the change since the last pull
+            unique_ptr<ElemType[]> m_pullBuffer;      // the global model
+            size_t m_numElements;
+            size_t m_windowOffset;                    // of the slices of this parameter, the same in all shards
+        };
+
+        // first element of the slice of 'rank', the slices of all workers are contiguous
+        size_t SliceBegin(const ParameterState& state, size_t rank) const
+        {
+            return state.m_numElements * rank / m_numWorkers;
+        }
+
+        void CreateWindows(const std::list<ComputationNodeBasePtr>& learnableNodes)
+        {
+            for (auto& pBaseNode : learnableNodes)
+            {
+                if (!pBaseNode->IsParameterUpdateRequired())
+                    continue;
+                auto pNode = DownCast(pBaseNode);
+                auto& value = pNode->Value();
+                auto& state = m_states[pNode->NodeName()];
+                state.m_node = pNode;
+                state.m_snapshot = make_shared<Matrix<ElemType>>(value.GetNumRows(), value.GetNumCols(), value.GetDeviceId());
+                state.m_numElements = value.GetNumElements();
+            }
+
+            // every shard holds one slice of each parameter, at the same offsets in all shards
+            size_t shardSize = 0;
+            for (auto& state : m_states)
+            {
+                state.second.m_windowOffset = shardSize;
+                size_t maxSliceSize = 0;
+                for (size_t rank = 0; rank < m_numWorkers; rank++)
+                    maxSliceSize = std::max(maxSliceSize, SliceBegin(state.second, rank + 1) - SliceBegin(state.second, rank));
+                shardSize += maxSliceSize;
+            }
+
+            MPI_Win_allocate((MPI_Aint)(shardSize * sizeof(ElemType)), sizeof(ElemType), MPI_INFO_NULL, m_pMPI->Communicator(), &m_shard, &m_shardWindow) || MpiFail("ParameterServerSGD: MPI_Win_allocate");
+            // the clocks of the workers, and the number of samples processed in this epoch, on the main node
+            size_t numClocks = m_pMPI->IsMainNode() ? m_numWorkers + 1 : 0;
+            MPI_Win_allocate((MPI_Aint)(numClocks * sizeof(int64_t)), sizeof(int64_t), MPI_INFO_NULL, m_pMPI->Communicator(), &m_clocks, &m_clockWindow) || MpiFail("ParameterServerSGD: MPI_Win_allocate");
+            MPI_Win_lock_all(0, m_shardWindow) || MpiFail("ParameterServerSGD: MPI_Win_lock_all");
+            MPI_Win_lock_all(0, m_clockWindow) || MpiFail("ParameterServerSGD: MPI_Win_lock_all");
+
+            fprintf(stderr, "ParameterServerSGD: %d parameters, %.1f MB in the shard of this worker\n", (int)m_states.size(), shardSize * sizeof(ElemType) / 1e6);
+        }
+
+        void Accumulate(ElemType* data, size_t numElements, size_t rank, size_t offset, MPI_Op op)
+        {
+            if (numElements == 0)
+                return;
+            MPI_Datatype dataType = MPIWrapper::GetDataType(data);
+            MPI_Accumulate(data, (int)numElements, dataType, (int)rank, (MPI_Aint)offset, (int)numElements, dataType, op, m_shardWindow) || MpiFail("ParameterServerSGD: MPI_Accumulate");
+        }
+
+        void Fetch(ElemType* data, size_t numElements, size_t rank, size_t offset)
+        {
+            if (numElements == 0)
+                return;
+            // an accumulate operation as well, so that it is atomic with respect to the pushes of the other workers
+            MPI_Datatype dataType = MPIWrapper::GetDataType(data);
+            MPI_Get_accumulate(nullptr, 0, dataType, data, (int)numElements, dataType, (int)rank, (MPI_Aint)offset, (int)numElements, dataType, MPI_NO_OP, m_shardWindow) || MpiFail("ParameterServerSGD: MPI_Get_accumulate");
+        }
+
+        // Adds the change of each parameter since the last pull to the global model, and pulls it if 'andPull'.
+        void Push(bool andPull = false)
+        {
+            for (auto& state : m_states)
+            {
+                auto& value = state.second.m_node->Value();
+                Matrix<ElemType> delta(value);
+                delta -= *state.second.m_snapshot;
+                state.second.m_pushBuffer.reset(delta.CopyToArray());
+                if (andPull)
+                    state.second.m_pullBuffer.reset(new ElemType[state.second.m_numElements]);
+                for (size_t rank = 0; rank < m_numWorkers; rank++)
+                {
+                    size_t begin = SliceBegin(state.second, rank);
+                    size_t numElements = SliceBegin(state.second, rank + 1) - begin;
+                    Accumulate(state.second.m_pushBuffer.get() + begin, numElements, rank, state.second.m_windowOffset, MPI_SUM);
+                    if (andPull)
+                        Fetch(state.second.m_pullBuffer.get() + begin, numElements, rank, state.second.m_windowOffset);
+                }
+            }
+            MPI_Win_flush_all(m_shardWindow) || MpiFail("ParameterServerSGD: MPI_Win_flush_all");
+
+            if (andPull)
+                SetPulledModels();
+        }
+
+        void Pull()
+        {
+            for (auto& state : m_states)
+            {
+                state.second.m_pullBuffer.reset(new ElemType[state.second.m_numElements]);
+                for (size_t rank = 0; rank < m_numWorkers; rank++)
+                {
+                    size_t begin = SliceBegin(state.second, rank);
+                    Fetch(state.second.m_pullBuffer.get() + begin, SliceBegin(state.second, rank + 1) - begin, rank, state.second.m_windowOffset);
+                }
+            }
+            MPI_Win_flush_all(m_shardWindow) || MpiFail("ParameterServerSGD: MPI_Win_flush_all");
+            SetPulledModels();
+        }
+
+        void SetPulledModels()
+        {
+            for (auto& state : m_states)
+            {
+                auto& value = state.second.m_node->Value();
+                value.SetValue(value.GetNumRows(), value.GetNumCols(), value.GetDeviceId(), state.second.m_pullBuffer.get());
+                state.second.m_snapshot->SetValue(value);
+                state.second.m_pushBuffer.reset();
+                state.second.m_pullBuffer.reset();
+            }
+        }
+
+        // Only this worker writes its clock, so replacing it is enough.
+        void SetClock(int64_t clock)
+        {
+            MPI_Accumulate(&clock, 1, MPI_INT64_T, m_pMPI->MainNodeRank(), (MPI_Aint)m_myRank, 1, MPI_INT64_T, MPI_REPLACE, m_clockWindow) || MpiFail("ParameterServerSGD: MPI_Accumulate");
+            MPI_Win_flush(m_pMPI->MainNodeRank(), m_clockWindow) || MpiFail("ParameterServerSGD: MPI_Win_flush");
+        }
+
+        void AddSamples(size_t numSamples, MPI_Op op = MPI_SUM)
+        {
+            int64_t samples = (int64_t)numSamples;
+            MPI_Accumulate(&samples, 1, MPI_INT64_T, m_pMPI->MainNodeRank(), (MPI_Aint)m_numWorkers, 1, MPI_INT64_T, op, m_clockWindow) || MpiFail("ParameterServerSGD: MPI_Accumulate");
+            MPI_Win_flush(m_pMPI->MainNodeRank(), m_clockWindow) || MpiFail("ParameterServerSGD: MPI_Win_flush");
+        }
+
+        void ReadClocks(std::vector<int64_t>& clocks)
+        {
+            clocks.resize(m_numWorkers + 1);
+            MPI_Get_accumulate(nullptr, 0, MPI_INT64_T, clocks.data(), (int)clocks.size(), MPI_INT64_T, m_pMPI->MainNodeRank(), 0, (int)clocks.size(), MPI_INT64_T, MPI_NO_OP, m_clockWindow) || MpiFail("ParameterServerSGD: MPI_Get_accumulate");
+            MPI_Win_flush(m_pMPI->MainNodeRank(), m_clockWindow) || MpiFail("ParameterServerSGD: MPI_Win_flush");
+        }
+
+        // samples processed by all workers since the last sync of this worker
+        size_t TotalSamplesSinceLastSync()
+        {
+            std::vector<int64_t> clocks;
+            ReadClocks(clocks);
+            size_t totalSamples = (size_t)clocks[m_numWorkers];
+            size_t samplesSinceLastSync = totalSamples - std::min(totalSamples, m_totalSamplesAtLastSync);
+            m_totalSamplesAtLastSync = totalSamples;
+            return samplesSinceLastSync;
+        }
+
+        void WaitForSlowestWorker()
+        {
+            std::vector<int64_t> clocks;
+            for (;;)
+            {
+                ReadClocks(clocks);
+                int64_t slowest = *std::min_element(clocks.begin(), clocks.begin() + m_numWorkers);
+                if (m_clock - slowest <= (int64_t)m_maxStaleness)
+                    break;
+                Sleep(1);
+            }
+        }
+
+        size_t m_maxStaleness;
+
+        std::map<std::wstring, ParameterState> m_states; // by node name, the same order on all workers
+        MPI_Win m_shardWindow;
+        MPI_Win m_clockWindow;
+        ElemType* m_shard;   // this worker's slices of the global model
+        int64_t* m_clocks;   // syncs performed by each worker in this epoch, and the samples processed by all, on the main node
+        int64_t m_clock;     // syncs performed by this worker in this epoch
+        size_t m_totalSamplesAtLastSync;
+    };
+
+} } }
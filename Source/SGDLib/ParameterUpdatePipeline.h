@@ -0,0 +1,157 @@
+// ParameterUpdatePipeline.h -- runs the parameter updates on a side stream, overlapped with the next forward prop
+
+#pragma once
+
+#include "Basics.h"
+#include "ComputationNetwork.h"
+#include "ComputeStreamPool.h"
+#include <list>
+#include <set>
+#include <vector>
+#include <unordered_map>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// -----------------------------------------------------------------------
+// ParameterUpdatePipeline -- the updates of one minibatch run while the next one is already computed
+//
+// The update of each parameter is issued to a non-blocking side stream as soon as its gradient is ready (see
+// BeginUpdate()), and its end is recorded in an event of that parameter. Instead of waiting for all updates, the next
+// forward prop makes each top-level node wait only for the updates of the parameters it reads, on the stream it runs
+// on; a recurrent loop waits for all of them. The backprop, which rewrites the gradients, waits for all of them
+// (WaitForUpdates()), and so does the main stream in Join(), before the parameters are read in any other way.
+// Only stream-ordered operations may be issued between BeginUpdate() and EndUpdate(), without temporary matrices
+// and without reading results to the host; an update that does not qualify is issued to the main stream instead.
+// Event slots: 2k is the gradient of parameter k, 2k+1 its update.
+// -----------------------------------------------------------------------
+
+class ParameterUpdatePipeline
+{
+public:
+    // the parameters are indexed in the evaluation order of the criterion, which is the order in which their updates are
+    // needed by the next forward prop
+    ParameterUpdatePipeline(const ComputationNetworkPtr& net, const ComputationNodeBasePtr& criterionNode, const std::list<ComputationNodeBasePtr>& learnableNodes)
+        : m_net(net), m_streamPool(net->GetDeviceId(), 1, true /*nonBlocking*/)
+    {
+        std::set<ComputationNodeBasePtr> learnableNodeSet(learnableNodes.begin(), learnableNodes.end());
+        for (const auto& node : net->GetEvalOrder(criterionNode))
+        {
+            if (learnableNodeSet.find(node) == learnableNodeSet.end())
+                continue;
+            m_parameterIndices[node.get()] = m_parameters.size();
+            m_parameters.push_back(node);
+        }
+        if (m_parameters.size() != learnableNodeSet.size())
+            LogicError("ParameterUpdatePipeline: not all learnable parameters are in the evaluation order of the criterion.");
+        m_isUpdatePending.assign(m_parameters.size(), false);
+
+        m_net->SetNodeForwardPropBegin([this](const ComputationNodeBasePtr& node) { WaitForUpdatesReadBy(node); });
+    }
+
+    ~ParameterUpdatePipeline()
+    {
+        m_net->SetNodeForwardPropBegin(nullptr);
+    }
+
+    // Disallow copy and move construction and assignment
+    DISABLE_COPY_AND_MOVE(ParameterUpdatePipeline);
+
+    const std::vector<ComputationNodeBasePtr>& GetParameters() const { return m_parameters; }
+
+    // index of a parameter, or SIZE_MAX if the node is none
+    size_t GetIndex(const ComputationNodeBasePtr& node) const
+    {
+        auto index = m_parameterIndices.find(node.get());
+        return index != m_parameterIndices.end() ? index->second : SIZE_MAX;
+    }
+
+    // on the main stream, before the updates of a minibatch: they come after the work issued to it so far
+    void BeginUpdates()
+    {
+        m_streamPool.Fork();
+    }
+
+    // makes the side stream the current stream for the update of parameter k
+    // With waitForGradient, the update also waits for the work issued so far to the current stream, e.g. the backprop
+    // that completed the gradient.
+    void BeginUpdate(size_t k, bool waitForGradient)
+    {
+        if (waitForGradient)
+            m_streamPool.Record(2 * k);
+        m_streamPool.Use(0);
+        if (waitForGradient)
+            m_streamPool.Wait(2 * k);
+    }
+
+    // records the end of the update of parameter k, on whichever stream it was issued, and makes the main stream current again
+    void EndUpdate(size_t k)
+    {
+        m_streamPool.Record(2 * k + 1);
+        m_isUpdatePending[k] = true;
+        m_streamPool.UseMainStream();
+    }
+
+    // makes the current stream wait for all updates, e.g. before the backprop rewrites the gradients
+    void WaitForUpdates()
+    {
+        for (size_t k = 0; k < m_parameters.size(); k++)
+        {
+            if (m_isUpdatePending[k])
+                m_streamPool.Wait(2 * k + 1);
+        }
+    }
+
+    // makes the main stream wait for all updates, before the parameters or the learner state are read otherwise
+    void Join()
+    {
+        m_streamPool.Join();
+        m_isUpdatePending.assign(m_parameters.size(), false);
+    }
+
+private:
+    // the updates that the forward prop of a top-level node needs, the parameters it reads directly, through a fused chain or through a fused producer
+    const std::vector<size_t>& GetUpdatesReadBy(const ComputationNodeBasePtr& node)
+    {
+        auto iter = m_updatesReadBy.find(node.get());
+        if (iter != m_updatesReadBy.end())
+            return iter->second;
+
+        auto& updates = m_updatesReadBy[node.get()];
+        if (dynamic_pointer_cast<FlowControlNode>(node)) // a recurrent loop
+        {
+            for (size_t k = 0; k < m_parameters.size(); k++)
+                updates.push_back(k);
+            return updates;
+        }
+        std::vector<ComputationNodeBasePtr> inputs = node->GetInputs();
+        if (node->IsForwardPropFused())
+            inputs.insert(inputs.end(), node->GetElementWiseFusion()->m_inputs.begin(), node->GetElementWiseFusion()->m_inputs.end());
+        if (node->HasFusedProducer())
+            inputs.insert(inputs.end(), node->GetFusedProducer()->GetInputs().begin(), node->GetFusedProducer()->GetInputs().end());
+        for (const auto& input : inputs)
+        {
+            size_t k = GetIndex(input);
+            if (k != SIZE_MAX)
+                updates.push_back(k);
+        }
+        return updates;
+    }
+
+    void WaitForUpdatesReadBy(const ComputationNodeBasePtr& node)
+    {
+        for (size_t k : GetUpdatesReadBy(node))
+        {
+            if (m_isUpdatePending[k])
+                m_streamPool.Wait(2 * k + 1);
+        }
+    }
+
+    ComputationNetworkPtr m_net;
+    ComputeStreamPool m_streamPool;                                           // the side stream
+    std::vector<ComputationNodeBasePtr> m_parameters;                         // in evaluation order
+    std::unordered_map<const ComputationNodeBase*, size_t> m_parameterIndices;
+    std::vector<bool> m_isUpdatePending;                                      // [k] the update of parameter k was issued since the last Join()
+    std::unordered_map<const ComputationNodeBase*, std::vector<size_t>> m_updatesReadBy; // [top-level node]
+};
+
+} } }
@@ -6,7 +6,11 @@
 #include "SGD.h"
 #include "NonlinearityNodes.h"          // for DropoutNode
 #include "SpecialPurposeNodes.h"        // for SequenceWithSoftmaxNode
+#include "InputAndParamNodes.h"         // for LearnableParameter
+#include "TrainingNodes.h"              // for BatchNormalizationNode
+#include "PreComputeNodes.h"           // for MeanInvStdDevNodeBase
 #include "DataReaderHelpers.h"
+#include "CachingDataReader.h"
 #include "MatrixQuantizerImpl.h"
 #ifdef QUANTIZED_GRADIENT_AGGREGATION
 #include "AllReduceDistGradAggregator.h"
@@ -16,6 +20,7 @@
 
 #include <map>
 #include <set>
+#include <chrono>
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -57,7 +62,7 @@ void SGD<ElemType>::Train(function<ComputationNetworkPtr(DEVICEID_TYPE)> createN
     }
 
     // create or load from checkpoint
-    shared_ptr<ComputationNetwork> net = !loadNetworkFromCheckpoint ? createNetworkFn(deviceId) : ComputationNetwork::CreateFromFile<ElemType>(deviceId, modelFileName);
+    shared_ptr<ComputationNetwork> net = !loadNetworkFromCheckpoint ? createNetworkFn(deviceId) : LoadNetwork(deviceId, modelFileName);
 
     // log the device we are computing on
     if (net->GetDeviceId() < 0)
@@ -65,8 +70,9 @@ void SGD<ElemType>::Train(function<ComputationNetworkPtr(DEVICEID_TYPE)> createN
     else
         fprintf(stderr, "\nSGD using GPU %d.\n", (int) net->GetDeviceId());
 
-    // TODO: BUGBUG: if not starting from checkpoint, need to synchronize initial model
-    // strategy should be to run the initializer above on mpiRank==0, and then broadcast parameters.
+    // the initializers of the ranks need not agree, the main node's parameters are the initial model
+    if (!loadNetworkFromCheckpoint && UseStartupBroadcast())
+        BroadcastParameters(net);
 
     startEpoch = max(startEpoch, 0);
     m_needAdaptRegularization = false;
@@ -97,13 +103,13 @@ void SGD<ElemType>::Adapt(wstring origModelFileName, wstring refNodeName,
     {
         wstring modelFileName = GetModelNameForEpoch(int(startEpoch) - 1);
         fprintf(stderr, "Starting from checkpoint. Loading network from '%ls'.\n", modelFileName.c_str());
-        net = ComputationNetwork::CreateFromFile<ElemType>(deviceId, modelFileName);
+        net = LoadNetwork(deviceId, modelFileName);
         networkLoadedFromCheckpoint = true;
     }
     else
     {
         fprintf(stderr, "Load Network From the original model file %ls.\n", origModelFileName.c_str());
-        net = ComputationNetwork::CreateFromFile<ElemType>(deviceId, origModelFileName);
+        net = LoadNetwork(deviceId, origModelFileName);
     }
 
     startEpoch = max(startEpoch, 0);
@@ -113,7 +119,7 @@ void SGD<ElemType>::Adapt(wstring origModelFileName, wstring refNodeName,
     if (m_needAdaptRegularization)
     {
         fprintf(stderr, "Load reference Network From the original model file %ls.\n", origModelFileName.c_str());
-        refNet = ComputationNetwork::CreateFromFile<ElemType>(deviceId, origModelFileName);
+        refNet = LoadNetwork(deviceId, origModelFileName);
     }
 
     ComputationNodeBasePtr refNode;
@@ -128,11 +134,44 @@ void SGD<ElemType>::Adapt(wstring origModelFileName, wstring refNodeName,
     TrainOrAdaptModel(startEpoch, net, networkLoadedFromCheckpoint, refNet, refNode, trainSetDataReader, validationSetDataReader);
 }
 
+// -----------------------------------------------------------------------
+// Benchmark() -- like Train() from scratch, but for the "benchmark" action
+// The epochs continue past maxEpochs until the benchmark is done; there is no validation,
+// no learning-rate adjustment after an epoch, and no model or checkpoint is written.
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+void SGD<ElemType>::Benchmark(function<ComputationNetworkPtr(DEVICEID_TYPE)> createNetworkFn, DEVICEID_TYPE deviceId,
+                              IDataReader* trainSetDataReader,
+                              TrainingBenchmark& benchmark)
+{
+    shared_ptr<ComputationNetwork> net = createNetworkFn(deviceId);
+    if (net->GetDeviceId() < 0)
+        fprintf(stderr, "\nBenchmarking SGD on the CPU.\n");
+    else
+        fprintf(stderr, "\nBenchmarking SGD on GPU %d.\n", (int) net->GetDeviceId());
+
+    benchmark.SetDevice(net->GetDeviceId());
+    m_benchmark = &benchmark;
+    m_needAdaptRegularization = false;
+    try
+    {
+        TrainOrAdaptModel(0, net, /*networkLoadedFromCheckpoint=*/false, net, nullptr, trainSetDataReader, nullptr);
+    }
+    catch (...)
+    {
+        m_benchmark = nullptr;
+        throw;
+    }
+    m_benchmark = nullptr;
+}
+
 // -----------------------------------------------------------------------
 // TrainOrAdaptModel() -- main training end-to-end, given a start model
 // -----------------------------------------------------------------------
 
 static double MomentumPerMB(double momentumPerSample, size_t minibatchSize);
+static void PrintValidationScores(int epoch, size_t maxEpochs, const vector<double>& vScore, bool inBackground);
 
 template <class ElemType>
 void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
@@ -178,6 +217,15 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
     additionalNodesToEvaluate.insert(additionalNodesToEvaluate.end(), preComputeNodesList.cbegin(), preComputeNodesList.cend());
 
     // allocate memory for forward and backward computation
+    net->SetNumComputeStreams(m_numComputeStreams);
+    net->SetRecomputedNodes(m_recomputedNodes);
+    net->SetOffloadedNodes(m_offloadedNodes);
+    net->SetUseComputeGraphs(m_useComputeGraphs);
+    if (m_profileNodes)
+        net->EnableNodeProfiling(m_nodeProfileTraceFile);
+    net->SetSaveCompiledPlan(m_saveCompiledPlan);
+    net->SetSaveAlignedParameters(m_saveAlignedParameters);
+    ComputationNetwork::SetDropoutCounterBasedRNG<ElemType>(net, criterionNodes[0], m_dropoutCounterBasedRNG);
     net->AllocateAllMatrices(evaluationNodes, additionalNodesToEvaluate, criterionNodes[0]);
 
     // get feature and label nodes into an array of matrices that will be passed to GetMinibatch()
@@ -230,12 +278,55 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
     auto& learnableNodes = net->LearnableParameterNodes(criterionNodes[0]);
     std::list<Matrix<ElemType>> smoothedGradients;
 
+    // with model parallelism, the nodes may be placed on different devices
+    // The criterion values are accumulated on the device of the criterion node.
+    for (const auto& node : evaluationNodes)
+    {
+        if (node->GetDeviceId() != criterionNodes[0]->GetDeviceId())
+            InvalidArgument("Evaluation node '%ls' has to be placed on the device of the criterion node '%ls'.", node->NodeName().c_str(), criterionNodes[0]->NodeName().c_str());
+    }
+    if (m_parallelizationMethod == ParallelizationMethod::DataParallelSGD)
+    {
+        for (const auto& node : learnableNodes)
+        {
+            if (node->GetDeviceId() != net->GetDeviceId())
+                InvalidArgument("DataParallelSGD does not support networks that are placed on multiple devices, but '%ls' is placed on another device.", node->NodeName().c_str());
+        }
+    }
+
+    if (m_offloadOptimizerState && net->GetDeviceId() < 0)
+    {
+        fprintf(stderr, "Warning: offloadOptimizerState has no effect for a network on the CPU.\n");
+        m_offloadOptimizerState = false;
+    }
     for (auto nodeIter = learnableNodes.begin(); nodeIter != learnableNodes.end(); nodeIter++)
     {
         ComputationNodePtr node = dynamic_pointer_cast<ComputationNode<ElemType>>(*nodeIter);
+        if (m_offloadOptimizerState && node->GetDeviceId() != net->GetDeviceId())
+            InvalidArgument("offloadOptimizerState does not support networks that are placed on multiple devices, but '%ls' is placed on another device.", node->NodeName().c_str());
         smoothedGradients.push_back(Matrix<ElemType>(node->Value().GetNumRows(),
                                                      node->Value().GetNumCols(),
-                                                     net->GetDeviceId()));
+                                                     m_offloadOptimizerState ? CPUDEVICE : node->GetDeviceId()));
+    }
+    if (m_shardOptimizerState && (m_parallelizationMethod == ParallelizationMethod::DataParallelSGD) && (g_mpi != nullptr) && (g_mpi->NumNodesInUse() > 1))
+    {
+        AssignOptimizerStateOwners(GetGradientOrder(net, criterionNodes[0], learnableNodes), learnableNodes);
+        ReleaseUnownedOptimizerState(smoothedGradients);
+    }
+
+    // the weights that were pruned (as matrix parameters, like in ComputationNetwork::PruneParameters()) stay pruned
+    if (m_maskPrunedWeights)
+    {
+        size_t numMasked = 0, numElements = 0;
+        for (const auto& node : learnableNodes)
+        {
+            auto parameter = dynamic_pointer_cast<LearnableParameter<ElemType>>(node);
+            if (!parameter || parameter->Value().GetNumRows() <= 1 || parameter->Value().GetNumCols() <= 1)
+                continue;
+            numMasked += parameter->SetPruningMaskFromZeros();
+            numElements += parameter->Value().GetNumElements();
+        }
+        fprintf(stderr, "maskPrunedWeights: %d of %d weights of the matrix parameters are pruned and stay 0.\n", (int) numMasked, (int) numElements);
     }
 
     double epochCriterion, avgCriterion, prevCriterion, lrControlCriterion;
@@ -265,16 +356,24 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
     {
         InitDistGradAgg(evaluationNodes.size(), m_traceLevel);
     }
-    else if (m_parallelizationMethod == ParallelizationMethod::ModelAveragingSGD)
+    else if ((m_parallelizationMethod == ParallelizationMethod::ModelAveragingSGD) ||
+             (m_parallelizationMethod == ParallelizationMethod::DataParallelASGD))
     {
         InitModelAggregationHandler(m_syncStatsTrace);
     }
-    
+
+    // a node that joins an elastic job gets the model of the job at the start of its first epoch
+    if (m_elasticMembership && !m_elastic)
+    {
+        m_elastic = make_shared<ElasticMembership>(g_mpi, m_elasticPortFile);
+    }
+    bool isJoining = m_elastic && m_elastic->IsJoining();
 
     // precompute mean and invStdDev nodes and save initial model
     // When no precompute, only save if we did not load the model from a 
     // checkpoint but instead built it from a network description
-    if (PreCompute(net, trainSetDataReader, featureNodes, labelNodes, inputMatrices) || !networkLoadedFromCheckpoint)
+    bool wasPreComputed = PreCompute(net, trainSetDataReader, featureNodes, labelNodes, inputMatrices);
+    if ((wasPreComputed || !networkLoadedFromCheckpoint) && !isJoining && !m_benchmark)
     {
         // Synchronize all ranks before writing the model to ensure that
         // everyone is done loading the model
@@ -294,11 +393,19 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
                                                   /*out*/ learnRatePerSample,
                                                   smoothedGradients,
                                                   /*out*/ prevCriterion,
-                                                  /*out*/ m_prevChosenMinibatchSize);
+                                                  /*out*/ m_prevChosenMinibatchSize,
+                                                  /*fromMainNode=*/true);
         if (learnRateInitialized)
             prevLearnRates[startEpoch % m_numPrevLearnRates] = learnRatePerSample;
     }
 
+    // a mid-epoch checkpoint of the start epoch continues from its minibatch, see TrainOneEpoch()
+    if ((m_numMBsToCheckpoint > 0 || m_minutesToCheckpoint > 0) && !m_elasticMembership && !m_benchmark && startEpoch >= 0 && startEpoch < (int) m_maxEpochs &&
+        LoadMidEpochCheckpoint(net, startEpoch, /*out*/ totalSamplesSeen, smoothedGradients))
+    {
+        learnRateInitialized = true;
+    }
+
     if (m_autoLearnRateSearchType == LearningRateSearchAlgorithm::AdjustAfterEpoch &&
         !learnRateInitialized && m_learningRatesParam.size() <= startEpoch)
     {
@@ -323,11 +430,28 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
     if (isSequenceTrainingCriterion)
     {
         ComputationNetwork::SetSeqParam<ElemType>(net, criterionNodes[0], m_hSmoothingWeight, m_frameDropThresh, m_doReferenceAlign,
-                                                  m_seqGammarCalcAMF, m_seqGammarCalcLMF, m_seqGammarCalcWP, m_seqGammarCalcbMMIFactor, m_seqGammarCalcUsesMBR);
+                                                  m_seqGammarCalcAMF, m_seqGammarCalcLMF, m_seqGammarCalcWP, m_seqGammarCalcbMMIFactor, m_seqGammarCalcUsesMBR,
+                                                  m_seqLatticeCacheSizeMB, m_seqLatticePruneBeam);
+    }
+
+    // the GPU is sampled in the background for the whole training, and summarized per epoch
+    if (m_gpuTelemetry && net->GetDeviceId() >= 0)
+    {
+        m_gpuWatcher.reset(new GPUWatcher());
+        if (!m_gpuWatcher->StartSampling(net->GetDeviceId(), m_gpuTelemetryIntervalMs))
+        {
+            fprintf(stderr, "Warning: gpuTelemetry is ignored, NVML cannot sample GPU %d.\n", (int) net->GetDeviceId());
+            m_gpuWatcher.reset();
+        }
     }
 
+    // the largest (sub-)minibatch that fits into the GPU, now that the parameters and the learner state are allocated
+    if (m_memoryPlanSizing != MemoryPlanSizing::None)
+        PlanMinibatchSizeFromMemory(net, trainSetDataReader, startEpoch, featureNodes, labelNodes, criterionNodes, evaluationNodes, inputMatrices);
+
     // --- MAIN EPOCH LOOP
-    for (int i = startEpoch; i < (int) m_maxEpochs; i++) // TODO: why is this an int, and not a size_t?
+    bool leftElasticJob = false;
+    for (int i = startEpoch; m_benchmark ? !m_benchmark->IsDone() : i < (int) m_maxEpochs; i++) // TODO: why is this an int, and not a size_t?
     {
         // Synchronize all ranks before proceeding to ensure that
         // rank 0 has finished writing the previous model file
@@ -336,6 +460,39 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
             g_mpi->WaitAll();
         }
 
+        // nodes join and leave the elastic job, and continue with the state of its main node
+        if (m_elastic && m_elastic->IsChangePending())
+        {
+            vector<double> trainingState = {(double) i, (double) totalSamplesSeen, learnRatePerSample, prevCriterion, avgCriterion,
+                                            (double) epochsNotCountedInAvgCriterion, learnRateReduced ? 1.0 : 0.0, learnRateInitialized ? 1.0 : 0.0,
+                                            (double) m_prevChosenMinibatchSize, prevDropoutRate, (double) dropOutSeed};
+            trainingState.insert(trainingState.end(), prevLearnRates.begin(), prevLearnRates.end());
+
+            if (!ChangeElasticMembership(learnableNodes, smoothedGradients, trainingState, (int) evaluationNodes.size()))
+            {
+                fprintf(stderr, "SGD: left the elastic training job in epoch %d\n", i + 1);
+                leftElasticJob = true;
+                break;
+            }
+
+            i = (int) trainingState[0];
+            totalSamplesSeen = (size_t) trainingState[1];
+            learnRatePerSample = trainingState[2];
+            prevCriterion = trainingState[3];
+            avgCriterion = trainingState[4];
+            epochsNotCountedInAvgCriterion = (size_t) trainingState[5];
+            learnRateReduced = (trainingState[6] != 0);
+            learnRateInitialized = (trainingState[7] != 0);
+            m_prevChosenMinibatchSize = (size_t) trainingState[8];
+            prevDropoutRate = trainingState[9];
+            dropOutSeed = (unsigned long) trainingState[10];
+            std::copy(trainingState.begin() + 11, trainingState.end(), prevLearnRates.begin());
+            if (i >= (int) m_maxEpochs)
+            {
+                break;
+            }
+        }
+
         Timer timer;
         timer.Start();
 
@@ -343,8 +500,17 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
         ComputationNetwork::SetDropoutRate<ElemType>(net, criterionNodes[0], m_dropoutRates[i], prevDropoutRate, dropOutSeed);
         net->SetBatchNormalizationNodesBelowEvalMode(false, criterionNodes[0]);
 
+        // a resumed epoch continues with the learning rate and minibatch size it was started with
+        bool isResumedEpoch = m_resumeEpochProgress && m_resumeEpochProgress->m_epoch == (size_t) i;
+
         // learning rate adjustment
-        if (m_autoLearnRateSearchType == LearningRateSearchAlgorithm::None || i < m_learningRatesParam.size())
+        if (isResumedEpoch)
+        {
+            learnRatePerSample = m_resumeEpochProgress->m_learnRatePerSample;
+            if (m_autoLearnRateSearchType == LearningRateSearchAlgorithm::SearchBeforeEpoch)
+                prevLearnRates[i % m_numPrevLearnRates] = learnRatePerSample;
+        }
+        else if (m_autoLearnRateSearchType == LearningRateSearchAlgorithm::None || i < m_learningRatesParam.size())
         {
             // BUGBUG: GetNumParallelSequences() returns 1 under certain situations; it seems when restarting from checkpoint
             learnRatePerSample = GetLearningRatePerSample(i /*BUGBUG workaround:*/, trainSetDataReader->GetNumParallelSequences());
@@ -376,7 +542,7 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
         {
             fprintf(stderr, "Learn Rate Per Sample for Epoch[%d] = %.8g is less than minLearnRate %.8g. Training complete.\n",
                     i + 1, learnRatePerSample, m_minLearnRate);
-            if (m_autoLearnRateSearchType != LearningRateSearchAlgorithm::None)
+            if (m_autoLearnRateSearchType != LearningRateSearchAlgorithm::None && !m_benchmark)
             {
                 net->Save(m_modelPath);
             }
@@ -390,7 +556,13 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
         // basis for a set number of epochs.  For epochs after that point, m_mbSize.size(), either
         // we just keep using
         // the last minibatch size, or we use tuning to try and find a better one.
-        if (m_autoAdjustMinibatch && i >= m_mbSize.size())
+        if (isResumedEpoch)
+        {
+            chosenMinibatchSize = m_resumeEpochProgress->m_minibatchSize;
+            if (m_autoAdjustMinibatch && i >= m_mbSize.size())
+                m_prevChosenMinibatchSize = chosenMinibatchSize;
+        }
+        else if (m_autoAdjustMinibatch && i >= m_mbSize.size())
         {
             size_t numFramesToUseInSearch = m_numMiniBatch4LRSearch[i] * m_mbSize[i];
             if (m_epochSize != requestDataSize)
@@ -409,6 +581,11 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
                                                           smoothedGradients, learningRateAdjustmentFactor);
             m_prevChosenMinibatchSize = chosenMinibatchSize;
         }
+        else if (m_memoryPlanMinibatchSize > 0)
+        {
+            // the largest that fits, see PlanMinibatchSizeFromMemory()
+            chosenMinibatchSize = m_memoryPlanMinibatchSize;
+        }
         else
         {
             // use the explicitly set minibatch size
@@ -425,21 +602,28 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
         fprintf(stderr, "\nStarting Epoch %d: learning rate per sample = %f  effective momentum = %f  momentum as time constant = %.1f samples\n",
                 i + 1, learnRatePerSample, MomentumPerMB(momentumPerSample, actualMinibatchSize), momentumAsTimeConstant);
 
-        TrainOneEpoch(net,
-                      refNet,
-                      refNode,
-                      i,
-                      m_epochSize,
-                      trainSetDataReader,
-                      learnRatePerSample,
-                      chosenMinibatchSize,
-                      featureNodes,
-                      labelNodes,
-                      criterionNodes,
-                      evaluationNodes,
-                      inputMatrices,
-                      learnableNodes, smoothedGradients,
-                      epochCriterion, epochEvalErrors, totalSamplesSeen);
+        // the summary of an epoch covers its training only, not the validation and checkpoint of the previous one
+        if (m_gpuWatcher)
+            m_gpuWatcher->TakeSummary();
+
+        size_t epochSamples = TrainOneEpoch(net,
+                                            refNet,
+                                            refNode,
+                                            i,
+                                            m_epochSize,
+                                            trainSetDataReader,
+                                            learnRatePerSample,
+                                            chosenMinibatchSize,
+                                            featureNodes,
+                                            labelNodes,
+                                            criterionNodes,
+                                            evaluationNodes,
+                                            inputMatrices,
+                                            learnableNodes, smoothedGradients,
+                                            epochCriterion, epochEvalErrors, totalSamplesSeen,
+                                            /*prefixMsg=*/"", /*canCheckpointMidEpoch=*/!m_benchmark);
+        if (m_benchmark && epochSamples == 0)
+            RuntimeError("Benchmark: Epoch %d had no samples, the benchmark cannot complete.", i + 1);
 
         timer.Stop();
         double epochTime = timer.ElapsedSeconds();
@@ -493,9 +677,22 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
             }
         }
 
+        if (net->GetNodeProfiler())
+            net->GetNodeProfiler()->PrintSummary(msra::strfun::strprintf("of training epoch %d", i + 1));
+
+        if (m_gpuWatcher)
+            TraceGpuTelemetry(i + 1, net->GetDeviceId());
+
+        // a benchmark only measures the training; the rest of the epoch is about the model
+        if (m_benchmark)
+        {
+            if (std::isnan(epochCriterion))
+                RuntimeError("The training criterion is not a number (NAN).");
+            continue;
+        }
+
         if (validationSetDataReader != trainSetDataReader && validationSetDataReader != nullptr)
         {
-            SimpleEvaluator<ElemType> evalforvalidation(net, g_mpi != nullptr);
             vector<wstring> cvSetTrainAndEvalNodes;
             if (criterionNodes.size() > 0)
             {
@@ -506,14 +703,35 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
                 cvSetTrainAndEvalNodes.push_back(evaluationNodes[0]->NodeName());
             }
 
-                // BUGBUG: We should not use the training MB size. The training MB size is constrained by both convergence and memory. Eval is only constrained by memory.
-            vector<double> vScore = evalforvalidation.Evaluate(validationSetDataReader, cvSetTrainAndEvalNodes, m_mbSize[i]);
-            fprintf(stderr, "Finished Epoch[%2d of %d]: [Validation Set] TrainLossPerSample = %.8g", i + 1, (int) m_maxEpochs, vScore[0]);
-            if (vScore.size() > 1)
+            vector<double> vScore;
+            if (m_asyncValidation)
+            {
+                // The main node validates this epoch's model in the background, and the learning rate is controlled
+                // by the result of the previous epoch. Only the first epoch of a run waits for its own result.
+                int validatedEpoch = i;
+                if (g_mpi == nullptr || g_mpi->IsMainNode())
+                {
+                    bool hasPrevious = WaitForAsyncValidation(vScore, validatedEpoch);
+                    StartAsyncValidation(net, i, validationSetDataReader, cvSetTrainAndEvalNodes, m_mbSize[i]);
+                    if (!hasPrevious)
+                        WaitForAsyncValidation(vScore, validatedEpoch);
+                    PrintValidationScores(validatedEpoch, m_maxEpochs, vScore, /*inBackground=*/true);
+                }
+                if (g_mpi != nullptr && g_mpi->NumNodesInUse() > 1)
+                {
+                    vScore.resize(cvSetTrainAndEvalNodes.size());
+                    g_mpi->Bcast(vScore.data(), vScore.size(), g_mpi->MainNodeRank());
+                }
+            }
+            else
             {
-                fprintf(stderr, "; EvalErrPerSample = %.8g", vScore[1]);
+                SimpleEvaluator<ElemType> evalforvalidation(net, g_mpi != nullptr);
+                // BUGBUG: We should not use the training MB size. The training MB size is constrained by both convergence and memory. Eval is only constrained by memory.
+                vScore = evalforvalidation.Evaluate(validationSetDataReader, cvSetTrainAndEvalNodes, m_mbSize[i]);
+                if (net->GetNodeProfiler())
+                    net->GetNodeProfiler()->PrintSummary(msra::strfun::strprintf("of validation after epoch %d", i + 1));
+                PrintValidationScores(i, m_maxEpochs, vScore, /*inBackground=*/false);
             }
-            fprintf(stderr, "\n");
 
             if (m_useCVSetControlLRIfCVExists)
             {
@@ -529,7 +747,8 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
         }
 
         // broadcast epochCriterion to make sure each processor will have the same learning rate schedule
-        if ((m_parallelizationMethod == ParallelizationMethod::ModelAveragingSGD) && (g_mpi->NumNodesInUse() > 1))
+        if (((m_parallelizationMethod == ParallelizationMethod::ModelAveragingSGD) || (m_parallelizationMethod == ParallelizationMethod::DataParallelASGD)) &&
+            (g_mpi->NumNodesInUse() > 1))
         {
             g_mpi->Bcast(&epochCriterion, 1, g_mpi->MainNodeRank());
             g_mpi->Bcast(&lrControlCriterion, 1, g_mpi->MainNodeRank());
@@ -558,6 +777,7 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
                 {
                     auto bestModelPath = GetModelNameForEpoch(i - m_learnRateAdjustInterval);
                     fprintf(stderr, "Loading previous model with best training-criterion value: %ls.\n", bestModelPath.c_str());
+                    WaitForPendingCheckpoints();
                     net->RereadPersistableParameters<ElemType>(bestModelPath);
                     LoadCheckPointInfo(i - m_learnRateAdjustInterval,
                                        /*out*/ totalSamplesSeen,
@@ -625,6 +845,9 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
             epochsNotCountedInAvgCriterion = 0;
         }
 
+        if (!m_optimizerStateOwners.empty())
+            GatherOptimizerState(smoothedGradients);
+
         // Synchronize all ranks before proceeding to ensure that
         // nobody tries reading the checkpoint file at the same time
         // as rank 0 deleting it below
@@ -636,30 +859,9 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
         // persist model and check-point info
         if ((g_mpi == nullptr) || g_mpi->IsMainNode())
         {
-            SaveCheckPointInfo(i, totalSamplesSeen, learnRatePerSample, smoothedGradients, prevCriterion, chosenMinibatchSize);
-            auto modelName = GetModelNameForEpoch(i);
-            fprintf(stderr, "SGD: Saving checkpoint model '%ls'\n", modelName.c_str());
-            net->Save(modelName);
-            if (!m_keepCheckPointFiles)
-            {
-                // delete previous checkpoint file to save space
-                if (m_autoLearnRateSearchType == LearningRateSearchAlgorithm::AdjustAfterEpoch && m_loadBestModel)
-                {
-                    if (epochsSinceLastLearnRateAdjust != 1)
-                    {
-                        _wunlink(GetCheckPointFileNameForEpoch(i - 1).c_str());
-                    }
-                    if (epochsSinceLastLearnRateAdjust == m_learnRateAdjustInterval)
-                    {
-                        _wunlink(GetCheckPointFileNameForEpoch(i - m_learnRateAdjustInterval).c_str());
-                    }
-                }
-                else
-                {
-                    _wunlink(GetCheckPointFileNameForEpoch(i - 1).c_str());
-                }
-            }
+            SaveCheckpoint(net, i, totalSamplesSeen, learnRatePerSample, smoothedGradients, prevCriterion, chosenMinibatchSize, epochsSinceLastLearnRateAdjust);
         }
+        ReleaseUnownedOptimizerState(smoothedGradients);
 
         if (learnRatePerSample < 1e-12)
         {
@@ -669,13 +871,28 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
     }
     // --- END OF MAIN EPOCH LOOP
 
+    // the validation of the last epoch has no learning rate left to control, it is only reported
+    {
+        vector<double> vScore;
+        int validatedEpoch;
+        if (WaitForAsyncValidation(vScore, validatedEpoch))
+            PrintValidationScores(validatedEpoch, m_maxEpochs, vScore, /*inBackground=*/true);
+    }
+
+    WaitForPendingCheckpoints();
+
     // Synchronize all ranks before proceeding to ensure that
     // rank 0 has finished writing the model file
-    if (g_mpi != nullptr)
+    if ((g_mpi != nullptr) && !leftElasticJob)
     {
         g_mpi->WaitAll();
     }
 
+    if (m_elastic && !leftElasticJob)
+    {
+        m_elastic->Finish();
+    }
+
     // progress tracing for compute cluster management
     ProgressTracing::TraceProgressPercentage(m_maxEpochs, 0.0, true);
     ProgressTracing::TraceTrainLoss(m_lastFinishedEpochTrainLoss);
@@ -718,9 +935,11 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
                                     /*out*/ double& epochCriterion,
                                     /*out*/ std::vector<double>& epochEvalErrors,
                                     /*in/out*/ size_t& totalSamplesSeen,
-                                    std::string prefixMsg)
+                                    std::string prefixMsg,
+                                    bool canCheckpointMidEpoch)
 {
     double totalTimeInMBs = 0; // use double since timer has sub-microsecond time resolution
+    double readerTimeInMBs = 0; // the part of it spent getting the minibatches from the reader
     double epochCriterionLastMBs = 0;
 
     int numSamplesLastMBs = 0;
@@ -731,21 +950,85 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
 
     int numMBsRun = 0;
 
-    // NOTE: the following two local matrices are not used in distGradAgg path
     // assume only one training criterion node for each epoch.
     // The criterion values are accumulated here over the minibatches (without having to pull them off the GPU).
-    Matrix<ElemType> localEpochCriterion(1, 1, net->GetDeviceId());
-    Matrix<ElemType> localEpochEvalErrors(1, epochEvalErrors.size(), net->GetDeviceId());
+    // With gradient aggregation, these are the sums of this node, see readEpochCriteria below.
+    Matrix<ElemType> localEpochCriterion(1, 1, criterionNodes[0]->GetDeviceId());
+    Matrix<ElemType> localEpochEvalErrors(1, epochEvalErrors.size(), criterionNodes[0]->GetDeviceId());
 
     localEpochCriterion.SetValue(0);
     localEpochEvalErrors.SetValue(0);
 
     bool useGradientAggregation = ((m_parallelizationMethod == ParallelizationMethod::DataParallelSGD) &&
                                    (epochNumber >= m_parallelizationStartEpochNum));
-    bool useModelAveraging = ((m_parallelizationMethod == ParallelizationMethod::ModelAveragingSGD) &&
+    // asynchronous SGD with a parameter server syncs like model averaging, without waiting for the other workers
+    bool useModelAveraging = (((m_parallelizationMethod == ParallelizationMethod::ModelAveragingSGD) ||
+                               (m_parallelizationMethod == ParallelizationMethod::DataParallelASGD)) &&
                               (epochNumber >= m_parallelizationStartEpochNum));
     bool useParallelTrain = useGradientAggregation || useModelAveraging;
 
+    // The mid-epoch checkpoints are taken by the main node. With the gradient aggregated in each minibatch, the model
+    // and its learner state are the same on all nodes, and all nodes have read the same number of minibatches.
+    bool checkpointMidEpoch = canCheckpointMidEpoch && (m_numMBsToCheckpoint > 0 || m_minutesToCheckpoint > 0);
+    if (checkpointMidEpoch && (useModelAveraging || m_elastic || (useGradientAggregation && m_bufferedAsyncGradientAggregation)))
+    {
+        fprintf(stderr, "Warning: mid-epoch checkpoints are not supported with model averaging, block momentum, asynchronous SGD, "
+                        "elastic membership or buffered asynchronous gradient aggregation, they are not written in epoch %d.\n", epochNumber + 1);
+        checkpointMidEpoch = false;
+    }
+    // The updates of a minibatch run on a side stream, overlapped with the rest of its backprop (without gradient aggregation)
+    // or with the forward prop of the next minibatch. They are restricted to those that are only stream-ordered device work.
+    unique_ptr<ParameterUpdatePipeline> updatePipeline;
+    vector<Matrix<ElemType>*> pipelinedSmoothedGradients; // [index of the parameter in updatePipeline]
+    if (m_pipelineParameterUpdates)
+    {
+        bool isClippingStreamOrdered = (m_clippingThresholdPerSample == numeric_limits<double>::infinity()) ||
+                                       (m_gradientClippingWithTruncation && !m_gradientClippingWithGlobalNorm);
+        bool isUpdateStreamOrdered = (m_gradType.mType == GradientsUpdateType::None || m_gradType.mType == GradientsUpdateType::Adam) &&
+                                     (m_gradType.mGaussianNoiseInjectStd == 0) && isClippingStreamOrdered;
+        if (net->GetDeviceId() < 0 || !isUpdateStreamOrdered || m_useLossScaling || m_fuseParameterUpdates || m_doGradientCheck || m_maskPrunedWeights ||
+            useModelAveraging || (useGradientAggregation && m_bufferedAsyncGradientAggregation) || !m_optimizerStateOwners.empty() || m_offloadOptimizerState)
+        {
+            fprintf(stderr, "Warning: pipelined parameter updates are only supported on the GPU, for momentum SGD and Adam without noise injection, "
+                            "clipping by norm, loss scaling, fused updates, gradient check, masking of pruned weights, model averaging, buffered "
+                            "asynchronous gradient aggregation, sharded or offloaded optimizer state; the parameters are updated after the backprop in epoch %d.\n", epochNumber + 1);
+        }
+        else
+        {
+            updatePipeline.reset(new ParameterUpdatePipeline(net, criterionNodes[0], learnableNodes));
+            map<ComputationNodeBasePtr, Matrix<ElemType>*> smoothedGradientOf;
+            auto smoothedGradientIter = smoothedGradients.begin();
+            for (auto nodeIter = learnableNodes.begin(); nodeIter != learnableNodes.end(); nodeIter++, smoothedGradientIter++)
+                smoothedGradientOf[*nodeIter] = &*smoothedGradientIter;
+            for (const auto& node : updatePipeline->GetParameters())
+                pipelinedSmoothedGradients.push_back(smoothedGradientOf[node]);
+        }
+    }
+    // the smoothed gradients are in host memory, and copied to the device for the updates
+    unique_ptr<OptimizerStateOffload<ElemType>> optimizerStateOffload;
+    if (m_offloadOptimizerState)
+        optimizerStateOffload.reset(new OptimizerStateOffload<ElemType>(net->GetDeviceId()));
+
+    // issues the update of parameter k of updatePipeline; a sparse gradient is updated on the main stream, its update is not only stream-ordered
+    auto updateWeightsPipelined = [&](size_t k, bool waitForGradient, size_t numSamples)
+    {
+        const auto& node = updatePipeline->GetParameters()[k];
+        bool isDense = dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Gradient().GetMatrixType() == MatrixType::DENSE;
+        if (isDense)
+            updatePipeline->BeginUpdate(k, waitForGradient);
+        UpdateWeights(node, *pipelinedSmoothedGradients[k], learnRatePerSample,
+                      GetMomentumPerSample(epochNumber /*BUGBUG workaround:*/, net->GetMBLayoutPtr()->GetNumParallelSequences()), numSamples,
+                      m_L2RegWeight, m_L1RegWeight,
+                      m_needAveMultiplier, m_useNesterovMomentum);
+        updatePipeline->EndUpdate(k);
+    };
+
+    bool isMainNode = (g_mpi == nullptr) || g_mpi->IsMainNode();
+    EpochProgress epochProgress;
+    epochProgress.m_epoch = epochNumber;
+    epochProgress.m_learnRatePerSample = learnRatePerSample;
+    epochProgress.m_minibatchSize = tunedMBSize;
+
     // MA-related variables
     size_t nSamplesSinceLastModelSync = 0;
     if (useParallelTrain && m_pMASGDHelper)
@@ -756,12 +1039,30 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
 
 
     std::vector<Matrix<ElemType>*> learnParamsGradients;
+    std::unordered_map<ComputationNodeBase*, size_t> learnParamsGradientIndices; // for overlapping the aggregation with the backprop
     if (useGradientAggregation)
     {
         epochCriterion = double(0.0);
         epochEvalErrors.assign(epochEvalErrors.size(), double(0.0));
     }
 
+    // The criteria are only read at the logging interval, the mid-epoch checkpoints and the end of the epoch, so that the
+    // minibatches do not wait for the GPU. With gradient aggregation, they are all-reduced then, all nodes do that at the same minibatch.
+    auto readEpochCriteria = [&]()
+    {
+        epochCriterion = localEpochCriterion.Get00Element();
+        for (size_t i = 0; i < epochEvalErrors.size(); i++)
+            epochEvalErrors[i] = localEpochEvalErrors(0, i);
+        if (useGradientAggregation)
+        {
+            std::vector<double> criteria(1, epochCriterion);
+            criteria.insert(criteria.end(), epochEvalErrors.begin(), epochEvalErrors.end());
+            g_mpi->AllReduce(criteria);
+            epochCriterion = criteria[0];
+            std::copy(criteria.begin() + 1, criteria.end(), epochEvalErrors.begin());
+        }
+    };
+
     Profiler profiler(m_numMBsToCUDAProfile);
 
     // resetting this, so profiling is performed for one epoch only
@@ -780,6 +1081,11 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
         trainSetDataReader->StartMinibatchLoop(tunedMBSize, epochNumber, epochSize);
     }
 
+    // the reader counters are reported per m_numMBsToShowResult minibatches; drop what was counted before this epoch
+    ReaderStatistics discardedReaderStatistics;
+    if (m_showReaderStatistics)
+        trainSetDataReader->TakeStatistics(discardedReaderStatistics);
+
     net->StartEvaluateMinibatchLoop(evaluationNodes);
     net->StartEvaluateMinibatchLoop(criterionNodes);
     if (m_needAdaptRegularization && m_adaptationRegType == AdaptationRegType::KL && refNode)
@@ -793,7 +1099,7 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
     size_t numSubminibatchesNeeded = DataReaderHelpers::GetNumSubminibatchesNeeded<ElemType>(trainSetDataReader, m_maxSamplesInRAM, m_numSubminiBatches, tunedMBSize);
     // this is non-trivial, we need a manager object to handle this
     if (numSubminibatchesNeeded > 1)
-        smbDispatcher.Init(net, learnableNodes, criterionNodes, evaluationNodes);
+        smbDispatcher.Init(net, learnableNodes, criterionNodes, evaluationNodes, m_accumulateSubminibatchesInPlace);
 
     // The following is a special feature only supported by the Kaldi2Reader for more efficient sequence training.
     // This attemps to compute the error signal for the whole utterance, which will
@@ -803,6 +1109,48 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
     // TODO: move the two-forward-pass support out of the reader, make a first-class citizen.
     AttemptUtteranceDerivativeFeatures(net, trainSetDataReader, featureNodes, inputMatrices);
 
+    // Resuming from a mid-epoch checkpoint reads and drops the minibatches it had trained, the same way they were read, so
+    // that the reader continues from the same sample with the same randomization, whichever reader it is.
+    if (canCheckpointMidEpoch && m_resumeEpochProgress && m_resumeEpochProgress->m_epoch == (size_t) epochNumber)
+    {
+        epochProgress = *m_resumeEpochProgress;
+        m_resumeEpochProgress.reset();
+        if (epochProgress.m_epochEvalErrors.size() != epochEvalErrors.size())
+            RuntimeError("The mid-epoch checkpoint has %d evaluation criteria, the network has %d.", (int) epochProgress.m_epochEvalErrors.size(), (int) epochEvalErrors.size());
+
+        fprintf(stderr, "\nSkipping the %d minibatches of epoch %d that were trained before the mid-epoch checkpoint.\n", (int) epochProgress.m_numMBsRun, epochNumber + 1);
+        for (size_t k = 0; k < epochProgress.m_numMBsRun; k++)
+        {
+            size_t actualMBSize = 0;
+            bool wasDataRead = DataReaderHelpers::GetMinibatchIntoNetwork<ElemType>(*trainSetDataReader, net, criterionNodes[0],
+                                                                          useDistributedMBReading, useParallelTrain, *inputMatrices, actualMBSize);
+            if (!wasDataRead && useDistributedMBReading)
+                break; // this node had run out of samples before the checkpoint
+            if (!wasDataRead)
+                RuntimeError("The reader ended after %d of the %d minibatches before the mid-epoch checkpoint; the data or the configuration have changed.",
+                             (int) k, (int) epochProgress.m_numMBsRun);
+            trainSetDataReader->DataEnd();
+            AttemptUtteranceDerivativeFeatures(net, trainSetDataReader, featureNodes, inputMatrices);
+        }
+
+        numMBsRun = (int) epochProgress.m_numMBsRun;
+        totalEpochSamples = epochProgress.m_epochSamples;
+        nSamplesSinceLastModelSync = epochProgress.m_samplesSinceLastModelSync;
+        epochCriterion = epochCriterionLastMBs = epochProgress.m_epochCriterion;
+        epochEvalErrors = epochEvalErrorsLastMBs = epochProgress.m_epochEvalErrors;
+        if (!useGradientAggregation || isMainNode) // the aggregated sums, see readEpochCriteria
+        {
+            localEpochCriterion.SetValue((ElemType) epochCriterion);
+            for (size_t i = 0; i < epochEvalErrors.size(); i++)
+                localEpochEvalErrors.SetValue(0, i, (ElemType) epochEvalErrors[i]);
+        }
+    }
+    else if (checkpointMidEpoch && isMainNode)
+    {
+        DeleteMidEpochCheckpoint(epochNumber); // of an earlier run
+    }
+    auto lastMidEpochCheckpointTime = std::chrono::steady_clock::now();
+
     fprintf(stderr, "\nStarting minibatch loop");
     if (useGradientAggregation)
     {
@@ -823,6 +1171,12 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
             fprintf(stderr, ", with maximum %d samples in RAM", (int) m_maxSamplesInRAM);
         else
             fprintf(stderr, ", with %d subminibatch", (int) numSubminibatchesNeeded);
+        if (smbDispatcher.AccumulatesInPlace())
+            fprintf(stderr, " accumulated in place");
+    }
+    if (updatePipeline)
+    {
+        fprintf(stderr, ", parameter updates are pipelined");
     }
     fprintf(stderr, ".\n");
 
@@ -837,10 +1191,22 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
         // get minibatch
         // TODO: is it guaranteed that the GPU is already completed at this point, is it safe to overwrite the buffers?
         size_t actualMBSize = 0;
+        if (m_benchmark)
+            m_benchmark->BeginMinibatch();
+        auto readerStart = std::chrono::steady_clock::now();
         bool wasDataRead = DataReaderHelpers::GetMinibatchIntoNetwork<ElemType>(*trainSetDataReader, net, criterionNodes[0],
                                                                       useDistributedMBReading, useParallelTrain, *inputMatrices, actualMBSize);
+        readerTimeInMBs += std::chrono::duration<double>(std::chrono::steady_clock::now() - readerStart).count();
         if (!wasDataRead && (!useDistributedMBReading || noMoreSamplesToProcess)) // in case of distributed reading, we do a few more loops until all ranks have completed
             break;                                                                // end of epoch
+        if (m_benchmark)
+        {
+            // the readers copy to the device asynchronously; what is still running when they return is the transfer
+            m_benchmark->EndPhase(TrainingBenchmark::Phase::Reader, /*waitForDevice=*/false);
+            m_benchmark->EndPhase(TrainingBenchmark::Phase::HostToDevice);
+        }
+
+        bool updatedInBackprop = false; // by updatePipeline
 
         // Note: If !wasDataRead then the data that GetMinibatchIntoNetwork() was supposed to full in are undefined.
         // Must not touch them.
@@ -908,13 +1274,53 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
                 // ===========================================================
 
                 net->ForwardProp(criterionNodes[0]);
+                if (m_benchmark)
+                    m_benchmark->EndPhase(TrainingBenchmark::Phase::Forward);
 
                 // ===========================================================
                 // backprop
                 // ===========================================================
 
                 if (learnRatePerSample > 0.01 * m_minLearnRate) // only compute gradient when learning rate is large enough
-                    net->Backprop(criterionNodes[0]);
+                {
+                    // with bucketed gradient aggregation, the buckets are all-reduced while the rest of the backprop is still running
+                    // (with sub-minibatches, only in the last one, and only if they are accumulated in place: then the gradient
+                    // of a parameter is complete when the last backprop is done with it, otherwise only after the paging)
+                    bool accumulateGradients = (ismb > 0) && smbDispatcher.AccumulatesInPlace();
+                    bool gradientsCompleteInBackprop = (actualNumSubminibatches == 1) ||
+                                                       (smbDispatcher.AccumulatesInPlace() && (ismb + 1 == actualNumSubminibatches));
+                    bool overlapAggregation = useGradientAggregation && gradientsCompleteInBackprop && !learnParamsGradients.empty() &&
+                                              m_distGradAgg->BeginOverlappedAggregation(learnParamsGradients, epochNumber);
+                    // without aggregation, a gradient is final once the backprop is done with it, and its update starts right away;
+                    // the update counter is advanced before, Adam takes its step from it
+                    updatedInBackprop = updatePipeline && !useGradientAggregation && (actualNumSubminibatches == 1);
+                    if (updatePipeline)
+                        updatePipeline->WaitForUpdates(); // of the previous minibatch; the backprop rewrites their gradients
+                    if (updatedInBackprop)
+                    {
+                        m_numParameterUpdates++;
+                        updatePipeline->BeginUpdates();
+                        net->Backprop(criterionNodes[0], 1.0, [&](const ComputationNodeBasePtr& node)
+                        {
+                            size_t k = updatePipeline->GetIndex(node);
+                            if (k != SIZE_MAX && node->IsParameterUpdateRequired())
+                                updateWeightsPipelined(k, /*waitForGradient=*/true, actualMBSize);
+                        }, accumulateGradients);
+                    }
+                    else if (overlapAggregation)
+                    {
+                        net->Backprop(criterionNodes[0], m_useLossScaling ? m_lossScale : 1.0, [&](const ComputationNodeBasePtr& node)
+                        {
+                            auto index = learnParamsGradientIndices.find(node.get());
+                            if (index != learnParamsGradientIndices.end())
+                                m_distGradAgg->GradientReady(index->second);
+                        }, accumulateGradients);
+                    }
+                    else
+                        net->Backprop(criterionNodes[0], m_useLossScaling ? m_lossScale : 1.0, nullptr, accumulateGradients);
+                    if (m_benchmark)
+                        m_benchmark->EndPhase(TrainingBenchmark::Phase::Backward);
+                }
 
                 // house-keeping for sub-minibatching
                 if (actualNumSubminibatches > 1)
@@ -931,29 +1337,33 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
         size_t aggregateNumSamples = actualMBSize;
         size_t aggregateNumSamplesWithLabel = numSamplesWithLabel;
 
-        if (!useGradientAggregation)
+        // accumulate criterion values (objective, eval)
+        if (actualMBSize != 0)
         {
-            // accumulate criterion values (objective, eval)
-            if (actualMBSize != 0)
+            assert(wasDataRead);
+            // criteria are in Value()(0,0), we accumulate into another 1x1 Matrix (to avoid having to pull the values off the GPU)
+            Matrix<ElemType>::AddElementToElement(dynamic_pointer_cast<ComputationNode<ElemType>>(criterionNodes[0])->Value(),
+                                                  0, 0, localEpochCriterion, 0, 0);
+            for (size_t i = 0; i < evaluationNodes.size(); i++)
             {
-                assert(wasDataRead);
-                // criteria are in Value()(0,0), we accumulate into another 1x1 Matrix (to avoid having to pull the values off the GPU)
-                Matrix<ElemType>::AddElementToElement(dynamic_pointer_cast<ComputationNode<ElemType>>(criterionNodes[0])->Value(),
-                                                      0, 0, localEpochCriterion, 0, 0);
-                for (size_t i = 0; i < evaluationNodes.size(); i++)
-                {
-                    Matrix<ElemType>::AddElementToElement(dynamic_pointer_cast<ComputationNode<ElemType>>(evaluationNodes[i])->Value(),
-                                                          0, 0, localEpochEvalErrors, 0, i);
-                }
+                Matrix<ElemType>::AddElementToElement(dynamic_pointer_cast<ComputationNode<ElemType>>(evaluationNodes[i])->Value(),
+                                                      0, 0, localEpochEvalErrors, 0, i);
             }
         }
-        else
+
+        if (useGradientAggregation)
         {
             // distributed gradient aggregation
             if (learnParamsGradients.size() == 0)
             {
-                learnParamsGradients.reserve(learnableNodes.size());
-                for (auto nodeIter = learnableNodes.begin(); nodeIter != learnableNodes.end(); nodeIter++)
+                list<ComputationNodeBasePtr> gradientNodes = GetGradientOrder(net, criterionNodes[0], learnableNodes);
+                map<ComputationNodeBasePtr, size_t> learnableNodeIndices;
+                for (const auto& node : learnableNodes)
+                    learnableNodeIndices[node] = learnableNodeIndices.size();
+                vector<int> gradientOwners;
+
+                learnParamsGradients.reserve(gradientNodes.size());
+                for (auto nodeIter = gradientNodes.begin(); nodeIter != gradientNodes.end(); nodeIter++)
                 {
                     ComputationNodePtr node = dynamic_pointer_cast<ComputationNode<ElemType>>(*nodeIter);
                     if (node->IsParameterUpdateRequired())
@@ -968,60 +1378,123 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
                             currParamsGradient->Resize(currParamsValues->GetNumRows(), currParamsValues->GetNumCols());
                         }
 
+                        learnParamsGradientIndices[node.get()] = learnParamsGradients.size();
                         learnParamsGradients.push_back(currParamsGradient);
+                        if (!m_optimizerStateOwners.empty())
+                            gradientOwners.push_back(m_optimizerStateOwners[learnableNodeIndices[node]]);
                     }
                 }
+                if (!m_optimizerStateOwners.empty())
+                    m_distGradAgg->SetGradientOwners(gradientOwners);
             }
 
             // prepare the header
+            // The criteria are not sent with it, they are accumulated on the device, and aggregated by readEpochCriteria.
             m_gradHeader->numEvalNode = evaluationNodes.size();
             m_gradHeader->numSamples = actualMBSize;
             m_gradHeader->numSamplesWithLabel = numSamplesWithLabel;
-            m_gradHeader->criterion = actualMBSize > 0 ? criterionNodes[0]->Get00Element() : 0.0;
+            m_gradHeader->criterion = 0.0;
             for (size_t i = 0; i < evaluationNodes.size(); i++)
-                m_gradHeader->evalErrors[i] = actualMBSize > 0 ? evaluationNodes[i]->Get00Element() : 0.0;
+                m_gradHeader->evalErrors[i] = 0.0;
 
             bool samplesProcessed = m_distGradAgg->AggregateGradients(learnParamsGradients, m_gradHeader, epochNumber);
             noMoreSamplesToProcess = !samplesProcessed;
 
             aggregateNumSamples = m_gradHeader->numSamples;
             aggregateNumSamplesWithLabel = m_gradHeader->numSamplesWithLabel;
-            epochCriterion += m_gradHeader->criterion;
-            for (size_t i = 0; i < epochEvalErrors.size(); i++)
-                epochEvalErrors[i] += m_gradHeader->evalErrors[i];
+            if (m_benchmark)
+                m_benchmark->EndPhase(TrainingBenchmark::Phase::Aggregation);
         }
 
+        // with loss scaling, undo the scaling of the gradients, or skip the update if they overflowed
+        bool gradientsOverflowed = false;
+        if (m_useLossScaling && (aggregateNumSamples > 0) && (learnRatePerSample > m_minLearnRate * 0.01))
+            gradientsOverflowed = !UnscaleGradients(learnableNodes);
+
+        if ((aggregateNumSamples > 0) && (learnRatePerSample > m_minLearnRate * 0.01) && !gradientsOverflowed && !updatedInBackprop)
+            m_numParameterUpdates++;
+
         // update model parameters
-        if ((aggregateNumSamples > 0) && (learnRatePerSample > m_minLearnRate * 0.01))
+        if (updatedInBackprop)
+        {
+            // already issued by the backprop
+        }
+        else if ((aggregateNumSamples > 0) && (learnRatePerSample > m_minLearnRate * 0.01) && !gradientsOverflowed && m_fuseParameterUpdates)
+        {
+            UpdateWeightsFused(learnableNodes, smoothedGradients, learnRatePerSample,
+                               GetMomentumPerSample(epochNumber /*BUGBUG workaround:*/, net->GetMBLayoutPtr()->GetNumParallelSequences()), aggregateNumSamples);
+        }
+        else if ((aggregateNumSamples > 0) && (learnRatePerSample > m_minLearnRate * 0.01) && !gradientsOverflowed && updatePipeline)
+        {
+            // the gradients are complete only now, e.g. after the aggregation; they are updated in the order the next forward prop needs them
+            updatePipeline->BeginUpdates();
+            for (size_t k = 0; k < updatePipeline->GetParameters().size(); k++)
+            {
+                if (updatePipeline->GetParameters()[k]->IsParameterUpdateRequired())
+                    updateWeightsPipelined(k, /*waitForGradient=*/false, aggregateNumSamples);
+            }
+        }
+        else if ((aggregateNumSamples > 0) && (learnRatePerSample > m_minLearnRate * 0.01) && !gradientsOverflowed)
         {
+            if (m_gradientClippingWithGlobalNorm)
+                ClipGradientsByGlobalNorm(learnableNodes, aggregateNumSamples);
+
+            vector<ComputationNodeBasePtr> updatedNodes;
+            vector<Matrix<ElemType>*> updatedSmoothedGradients;
             auto smoothedGradientIter = smoothedGradients.begin();
-            for (auto nodeIter = learnableNodes.begin(); nodeIter != learnableNodes.end(); nodeIter++, smoothedGradientIter++)
+            size_t k = 0;
+            for (auto nodeIter = learnableNodes.begin(); nodeIter != learnableNodes.end(); nodeIter++, smoothedGradientIter++, k++)
             {
-                ComputationNodeBasePtr node = *nodeIter;
-                if (node->IsParameterUpdateRequired())
+                if ((*nodeIter)->IsParameterUpdateRequired() && IsOptimizerStateOwner(k))
                 {
-                    Matrix<ElemType>& smoothedGradient = *smoothedGradientIter;
+                    updatedNodes.push_back(*nodeIter);
+                    updatedSmoothedGradients.push_back(&*smoothedGradientIter);
+                }
+            }
+
+            if (optimizerStateOffload)
+                optimizerStateOffload->BeginUpdates(updatedSmoothedGradients);
+            for (size_t i = 0; i < updatedNodes.size(); i++)
+            {
+                const ComputationNodeBasePtr& node = updatedNodes[i];
+                Matrix<ElemType>& smoothedGradient = optimizerStateOffload ? optimizerStateOffload->BeginUpdate(i) : *updatedSmoothedGradients[i];
 #ifdef _DEBUG
-                    if (smoothedGradient.HasNan("TrainOneEpoch/UpdateWeights(): "))
-                        LogicError("%ls %ls operation has NaNs in smoothedGradient.", node->NodeName().c_str(), node->OperationName().c_str());
+                if (smoothedGradient.HasNan("TrainOneEpoch/UpdateWeights(): "))
+                    LogicError("%ls %ls operation has NaNs in smoothedGradient.", node->NodeName().c_str(), node->OperationName().c_str());
 #endif
-                    UpdateWeights(node, smoothedGradient, learnRatePerSample,
-                                  GetMomentumPerSample(epochNumber /*BUGBUG workaround:*/, net->GetMBLayoutPtr()->GetNumParallelSequences()), aggregateNumSamples,
-                                  m_L2RegWeight, m_L1RegWeight,
-                                  m_needAveMultiplier, m_useNesterovMomentum);
+                UpdateWeights(node, smoothedGradient, learnRatePerSample,
+                              GetMomentumPerSample(epochNumber /*BUGBUG workaround:*/, net->GetMBLayoutPtr()->GetNumParallelSequences()), aggregateNumSamples,
+                              m_L2RegWeight, m_L1RegWeight,
+                              m_needAveMultiplier, m_useNesterovMomentum);
 #ifdef _DEBUG
-                    if (dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Value().HasNan("TrainOneEpoch/UpdateWeights(): "))
-                        LogicError("%ls %ls operation has NaNs in functionValues after parameter update.", node->NodeName().c_str(), node->OperationName().c_str());
+                if (dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Value().HasNan("TrainOneEpoch/UpdateWeights(): "))
+                    LogicError("%ls %ls operation has NaNs in functionValues after parameter update.", node->NodeName().c_str(), node->OperationName().c_str());
 #endif
-                }
+                if (optimizerStateOffload)
+                    optimizerStateOffload->EndUpdate(i);
+            }
+            if (!m_optimizerStateOwners.empty())
+                BroadcastUpdatedParameters(learnableNodes);
+        }
+        if (m_maskPrunedWeights && (aggregateNumSamples > 0) && (learnRatePerSample > m_minLearnRate * 0.01) && !gradientsOverflowed)
+        {
+            for (const auto& node : learnableNodes)
+            {
+                auto parameter = dynamic_pointer_cast<LearnableParameter<ElemType>>(node);
+                if (parameter && node->IsParameterUpdateRequired())
+                    parameter->ApplyPruningMask();
             }
         }
+        if (m_benchmark)
+            m_benchmark->EndPhase(TrainingBenchmark::Phase::Update);
 
         // aggregation by model averaging
         if (useModelAveraging)
         {
             if (nSamplesSinceLastModelSync >= m_nFramesBetweenMASync)
             {
+                if (optimizerStateOffload)
+                    optimizerStateOffload->WaitForUpdates();
                 bool synced = m_pMASGDHelper->OnArrivingAtSyncPoint(learnableNodes, smoothedGradients, nSamplesSinceLastModelSync);
                 if (synced)
                 {
@@ -1033,6 +1506,8 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
             {
                 noMoreSamplesToProcess = !wasDataRead;
             }
+            if (m_benchmark)
+                m_benchmark->EndPhase(TrainingBenchmark::Phase::Aggregation);
         }
 
         timer.Stop();
@@ -1048,19 +1523,12 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
             numMBsRun % m_numMBsToShowResult == 0)
         {
             // get the epoch Values updated
-            if (!useGradientAggregation)
-            {
-                timer.Restart();
-                epochCriterion = localEpochCriterion.Get00Element();
-                for (size_t i = 0; i < epochEvalErrors.size(); i++)
-                {
-                    epochEvalErrors[i] = localEpochEvalErrors(0, i);
-                }
-                timer.Stop();
+            timer.Restart();
+            readEpochCriteria();
+            timer.Stop();
 
-                // Add the last trailing compute
-                totalTimeInMBs += timer.ElapsedSeconds();
-            }
+            // Add the last trailing compute
+            totalTimeInMBs += timer.ElapsedSeconds();
 
             double trainLossPerSample = (numSamplesLastMBs != 0) ? ((epochCriterion - epochCriterionLastMBs) / numSamplesLastMBs) : 0.0;
             bool wasProgressPrinted = false;
@@ -1109,6 +1577,12 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
             string formatString = "TotalTime = " + GeneratePaddedFloatOrExpFormat(0, 4, totalTimeInMBs) + "s; SamplesPerSecond = %.1f\n";
             SGDTrace(stderr, formatString.c_str(), totalTimeInMBs, numSamplesLastMBs / totalTimeInMBs);
 
+            // where the time went in the reader, to tell whether the data or the computation limits the training
+            if (m_showReaderStatistics)
+            {
+                TraceReaderStatistics(prefixMsg, readerTimeInMBs, totalTimeInMBs, trainSetDataReader);
+            }
+
             // progress tracing for compute cluster management
             if (wasProgressPrinted)
             {
@@ -1122,6 +1596,7 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
 
             // reset statistics
             totalTimeInMBs = 0;
+            readerTimeInMBs = 0;
             numSamplesLastMBs = 0;
 
             epochCriterionLastMBs = epochCriterion;
@@ -1154,10 +1629,70 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
         AttemptUtteranceDerivativeFeatures(net, trainSetDataReader, featureNodes, inputMatrices);
 
         profiler.NextSample();
+
+        if (m_benchmark)
+        {
+            m_benchmark->EndMinibatch(aggregateNumSamplesWithLabel);
+            if (m_benchmark->IsDone())
+                break;
+        }
+
+        // All nodes decide together, since they aggregate the criteria for it. The time is that of the main node; it is
+        // broadcast, once per minibatch. No checkpoints are written once no node has samples left.
+        if (checkpointMidEpoch && !noMoreSamplesToProcess)
+        {
+            bool isCheckpointDue = m_numMBsToCheckpoint > 0 && numMBsRun % m_numMBsToCheckpoint == 0;
+            if (m_minutesToCheckpoint > 0)
+            {
+                int isTimeDue = isMainNode &&
+                                std::chrono::duration<double>(std::chrono::steady_clock::now() - lastMidEpochCheckpointTime).count() >= 60 * m_minutesToCheckpoint;
+                if (useGradientAggregation)
+                    g_mpi->Bcast(&isTimeDue, 1, g_mpi->MainNodeRank());
+                isCheckpointDue = isCheckpointDue || isTimeDue;
+            }
+            if (isCheckpointDue)
+                readEpochCriteria();
+            if (isCheckpointDue && updatePipeline)
+                updatePipeline->Join(); // the checkpoint reads the parameters and the learner state
+            if (isCheckpointDue && optimizerStateOffload)
+                optimizerStateOffload->WaitForUpdates();
+            if (isCheckpointDue && !m_optimizerStateOwners.empty())
+                GatherOptimizerState(smoothedGradients);
+            if (isCheckpointDue && isMainNode)
+            {
+                epochProgress.m_numMBsRun = numMBsRun;
+                epochProgress.m_epochSamples = totalEpochSamples;
+                epochProgress.m_epochCriterion = epochCriterion;
+                epochProgress.m_epochEvalErrors = epochEvalErrors;
+                epochProgress.m_samplesSinceLastModelSync = nSamplesSinceLastModelSync;
+                epochProgress.m_lossScale = m_lossScale;
+                epochProgress.m_numMBsSinceLossScaleChange = m_numMBsSinceLossScaleChange;
+                SaveMidEpochCheckpoint(net, totalSamplesSeen, smoothedGradients, epochProgress);
+            }
+            if (isCheckpointDue && !m_optimizerStateOwners.empty())
+                ReleaseUnownedOptimizerState(smoothedGradients);
+            if (isCheckpointDue)
+                lastMidEpochCheckpointTime = std::chrono::steady_clock::now();
+        }
+
+        // Nodes of an elastic job join and leave between epochs. A change that is pending in the middle of the epoch ends the epoch early,
+        // all nodes agree on that since they aggregate the gradients of every minibatch.
+        if (useGradientAggregation && m_elastic && (m_elasticSyncFrequencyInMBs > 0) &&
+            (numMBsRun % m_elasticSyncFrequencyInMBs == 0) && m_elastic->IsChangePending())
+        {
+            fprintf(stderr, "%s Epoch[%2d of %d]-Minibatch[%4d]: ending the epoch early, the nodes of the elastic job change\n",
+                    prefixMsg.c_str(), epochNumber + 1, (int) m_maxEpochs, numMBsRun);
+            break;
+        }
     }
 
     // --- END MAIN MINIBATCH LOOP
 
+    if (updatePipeline)
+        updatePipeline->Join();
+    if (optimizerStateOffload)
+        optimizerStateOffload->WaitForUpdates();
+
     if (useModelAveraging )
     {
         m_pMASGDHelper->OnEpochEnd(learnableNodes, smoothedGradients, nSamplesSinceLastModelSync);
@@ -1167,7 +1702,8 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
     // compute final criterion values
     if (useGradientAggregation)
     {
-        // with parallelization, we have them in regular variables
+        // with parallelization, we aggregate them into regular variables
+        readEpochCriteria();
         epochCriterion /= float(totalEpochSamples);
         for (size_t i = 0; i < epochEvalErrors.size(); i++)
         {
@@ -1223,6 +1759,16 @@ static double MomentumPerMB(double momentumPerSample, size_t minibatchSize)
     return pow(momentumPerSample, minibatchSize);
 }
 
+static void PrintValidationScores(int epoch, size_t maxEpochs, const vector<double>& vScore, bool inBackground)
+{
+    fprintf(stderr, "Finished Epoch[%2d of %d]: [Validation Set%s] TrainLossPerSample = %.8g", epoch + 1, (int) maxEpochs, inBackground ? ", in the background" : "", vScore[0]);
+    if (vScore.size() > 1)
+    {
+        fprintf(stderr, "; EvalErrPerSample = %.8g", vScore[1]);
+    }
+    fprintf(stderr, "\n");
+}
+
 // Get{Train,Eval}CriterionNodes() return a reference that is, unfortunately, dependent on the network.
 // So we hold those inside here. Not very nice. Also not thread-safe. This may go away once we fix sequence-to-sequence models properly.
 // TODO: merge them into one.
@@ -1279,39 +1825,77 @@ bool SGD<ElemType>::PreCompute(ComputationNetworkPtr net,
     // trainSetDataReader->StartMinibatchLoop(m_mbSize[0],  0 , m_epochSize); // only based on one epoch
     // [1/12/2015 erw] to support large dataset, we usually partition whole dataset into several epoch's,
     // so we need to use all the data to do precomputing
-    if (m_useAllDataForPreComputedNode) // using all the data
-        trainSetDataReader->StartMinibatchLoop(m_mbSize[0], 0);
-    else // using only one epoch
-        trainSetDataReader->StartMinibatchLoop(m_mbSize[0], 0, m_epochSize);
-    net->StartEvaluateMinibatchLoop(nodes);
+    size_t numSamples = m_useAllDataForPreComputedNode ? requestDataSize : m_epochSize;
+    if (m_preComputeMaxSamples > 0) // a subset, which is random if the reader randomizes
+        numSamples = min(numSamples, m_preComputeMaxSamples);
+
+    // The MPI ranks can split the data if all nodes can merge their statistics. Otherwise the main node reads all of it
+    // and broadcasts the statistics, or, for other nodes or without the startup broadcast, each rank reads all of it.
+    bool hasMergeableStatistics = true;
+    for (const auto& node : nodes)
+    {
+        if (!dynamic_pointer_cast<MeanInvStdDevNodeBase<ElemType>>(node))
+            hasMergeableStatistics = false;
+    }
+    bool isDistributed = m_distributedPreCompute && g_mpi != nullptr && g_mpi->NumNodesInUse() > 1 && hasMergeableStatistics;
+    bool isBroadcast = !isDistributed && hasMergeableStatistics && UseStartupBroadcast();
 
     // initialize
     for (auto & node : nodes)
         dynamic_pointer_cast<IPreComputeNode>(node)->MarkComputed(false /*begin accumulating*/);
 
-    const size_t numIterationsBeforePrintingProgress = 100;
-    size_t numItersSinceLastPrintOfProgress = 0;
-    size_t actualMBSizeDummy;
-    while (DataReaderHelpers::GetMinibatchIntoNetwork<ElemType>(*trainSetDataReader, net, nullptr, false, false, *inputMatrices, actualMBSizeDummy))
+    // the statistics may come from a previous run with the same reader configuration
+    wstring cacheKey = GetPreComputeCacheKey(nodes, numSamples);
+    if (isBroadcast && !g_mpi->IsMainNode())
     {
-        // TODO: move these into GetMinibatchIntoNetwork()  --but those are passed around; necessary? Can't we get them from 'net'?
-        ComputationNetwork::BumpEvalTimeStamp(featureNodes);
-        ComputationNetwork::BumpEvalTimeStamp(labelNodes);
-
-        net->ForwardProp(nodes);
+        fprintf(stderr, "Precomputing --> Receiving the statistics from the main node.\n");
+    }
+    else if (!m_preComputeCacheFile.empty() && LoadPreComputeCache(nodes, cacheKey, !isBroadcast))
+    {
+        fprintf(stderr, "Precomputing --> Read the statistics from '%ls'.\n", m_preComputeCacheFile.c_str());
+    }
+    else
+    {
+        bool useDistributedMBReading = isDistributed && trainSetDataReader->SupportsDistributedMBRead();
+        if (useDistributedMBReading)
+            trainSetDataReader->StartDistributedMinibatchLoop(m_mbSize[0], 0, g_mpi->CurrentNodeRank(), g_mpi->NumNodesInUse(), numSamples);
+        else
+            trainSetDataReader->StartMinibatchLoop(m_mbSize[0], 0, numSamples);
+        net->StartEvaluateMinibatchLoop(nodes);
 
-        if (ProgressTracing::GetTracingFlag())
+        const size_t numIterationsBeforePrintingProgress = 100;
+        size_t numItersSinceLastPrintOfProgress = 0;
+        size_t actualMBSizeDummy;
+        while (DataReaderHelpers::GetMinibatchIntoNetwork<ElemType>(*trainSetDataReader, net, nullptr, useDistributedMBReading, isDistributed, *inputMatrices, actualMBSizeDummy))
         {
-            numItersSinceLastPrintOfProgress++;
-            if (numItersSinceLastPrintOfProgress >= numIterationsBeforePrintingProgress)
+            // TODO: move these into GetMinibatchIntoNetwork()  --but those are passed around; necessary? Can't we get them from 'net'?
+            ComputationNetwork::BumpEvalTimeStamp(featureNodes);
+            ComputationNetwork::BumpEvalTimeStamp(labelNodes);
+
+            net->ForwardProp(nodes);
+
+            if (ProgressTracing::GetTracingFlag())
             {
-                // TODO: For now just print 0.0 instead of calculating actual progress
-                printf("PROGRESS: %.2f%%\n", 0.0f);
-                numItersSinceLastPrintOfProgress = 0;
+                numItersSinceLastPrintOfProgress++;
+                if (numItersSinceLastPrintOfProgress >= numIterationsBeforePrintingProgress)
+                {
+                    // TODO: For now just print 0.0 instead of calculating actual progress
+                    printf("PROGRESS: %.2f%%\n", 0.0f);
+                    numItersSinceLastPrintOfProgress = 0;
+                }
             }
         }
+
+        if (isDistributed)
+            MergePreComputeStatistics(nodes);
+
+        if (!m_preComputeCacheFile.empty() && (g_mpi == nullptr || g_mpi->IsMainNode()))
+            SavePreComputeCache(nodes, cacheKey);
     }
 
+    if (isBroadcast)
+        BroadcastPreComputeStatistics(nodes);
+
     // finalize
     for (auto & node : nodes)
         dynamic_pointer_cast<IPreComputeNode>(node)->MarkComputed(true /*done accumulating*/);
@@ -1321,38 +1905,231 @@ bool SGD<ElemType>::PreCompute(ComputationNetworkPtr net,
     return true;
 }
 
-// return a reasonable initial learning rate based on the initial mbsize
-template <class ElemType>
-double SGD<ElemType>::SearchForBestLearnRate(ComputationNetworkPtr net,
-                                             ComputationNetworkPtr refNet,
-                                             const ComputationNodeBasePtr& refNode, const int epochNumber,
-                                             const double curLearnRate,
-                                             IDataReader* trainSetDataReader,
-                                             const std::vector<ComputationNodeBasePtr>& featureNodes,
-                                             const std::vector<ComputationNodeBasePtr>& labelNodes,
-                                             const std::vector<ComputationNodeBasePtr>& criterionNodes,
-                                             const std::vector<ComputationNodeBasePtr>& evaluationNodes,
-                                             StreamMinibatchInputs* inputMatrices,
-                                             const std::list<ComputationNodeBasePtr>& learnableNodes,
-                                             std::list<Matrix<ElemType>>& smoothedGradients,
-                                             const bool learnRateInitialized,
-                                             const double largestPrevLearnRatePerSample)
+// the accumulators of a MeanInvStdDevNodeBase, in double precision; 'var' is empty for a MeanNode
+struct PreComputeStatistics
 {
-    double epochCriterion = std::numeric_limits<double>::infinity();
-    double prevCriterion = std::numeric_limits<double>::infinity();
-    vector<double> epochEvalErrors(evaluationNodes.size(), std::numeric_limits<double>::infinity());
+    double m_numSamples;
+    vector<double> m_mean;
+    vector<double> m_var;
+};
 
-    size_t totalSamplesSeen = 0;
-    double bestLearnRatePerSample = curLearnRate;
+template <class ElemType>
+static vector<double> AccumulatorToDoubles(const Matrix<ElemType>& accumulator)
+{
+    vector<ElemType> values(accumulator.GetNumElements());
+    if (!values.empty())
+        accumulator.CopySection(accumulator.GetNumRows(), accumulator.GetNumCols(), values.data(), accumulator.GetNumRows());
+    return vector<double>(values.begin(), values.end());
+}
 
-    size_t numFramesToUseInSearch = m_numMiniBatch4LRSearch[epochNumber] * m_mbSize[epochNumber];
-    if (m_epochSize != requestDataSize)
-    {
-        // ensure the numFramesToUseInSearch does not exceed the total number of frames in the epoch
-        numFramesToUseInSearch = min(numFramesToUseInSearch, m_epochSize);
-    }
+template <class ElemType>
+static void DoublesToAccumulator(const vector<double>& doubles, Matrix<ElemType>& accumulator)
+{
+    if (doubles.size() != accumulator.GetNumElements())
+        LogicError("PreCompute: The statistics have %d values instead of %d.", (int) doubles.size(), (int) accumulator.GetNumElements());
+    vector<ElemType> values(doubles.begin(), doubles.end());
+    if (!values.empty())
+        accumulator.SetValue(accumulator.GetNumRows(), accumulator.GetNumCols(), accumulator.GetDeviceId(), values.data());
+}
 
-    double baseCriterion;
+template <class ElemType>
+static PreComputeStatistics GetPreComputeStatistics(const ComputationNodeBasePtr& nodeBase)
+{
+    auto node = dynamic_pointer_cast<MeanInvStdDevNodeBase<ElemType>>(nodeBase);
+    PreComputeStatistics statistics;
+    statistics.m_numSamples = (double) node->GetNumAccumulatedSamples();
+    statistics.m_mean = AccumulatorToDoubles(node->MeanAccumulator());
+    if (node->VarianceAccumulator())
+        statistics.m_var = AccumulatorToDoubles(*node->VarianceAccumulator());
+    return statistics;
+}
+
+template <class ElemType>
+static void SetPreComputeStatistics(const ComputationNodeBasePtr& nodeBase, const PreComputeStatistics& statistics)
+{
+    auto node = dynamic_pointer_cast<MeanInvStdDevNodeBase<ElemType>>(nodeBase);
+    if (statistics.m_var.empty() != !node->VarianceAccumulator())
+        LogicError("PreCompute: The statistics of %ls do not match its type.", node->NodeName().c_str());
+    node->SetNumAccumulatedSamples((size_t) statistics.m_numSamples);
+    DoublesToAccumulator(statistics.m_mean, node->MeanAccumulator());
+    if (node->VarianceAccumulator())
+        DoublesToAccumulator(statistics.m_var, *node->VarianceAccumulator());
+}
+
+// Merges the statistics that the MPI ranks have accumulated over their shares of the data, with the parallel
+// combination of Chan et al.: n = sum_k n_k, mean = sum_k n_k mean_k / n, var = sum_k n_k (var_k + (mean_k - mean)^2) / n.
+// The variance is summed in a second pass, after the mean is known, so that it does not suffer from cancellation.
+template <class ElemType>
+void SGD<ElemType>::MergePreComputeStatistics(const std::list<ComputationNodeBasePtr>& nodes)
+{
+    for (const auto& node : nodes)
+    {
+        PreComputeStatistics statistics = GetPreComputeStatistics<ElemType>(node);
+        const size_t dim = statistics.m_mean.size();
+
+        vector<double> sums(1 + dim);
+        sums[0] = statistics.m_numSamples;
+        for (size_t j = 0; j < dim; j++)
+            sums[1 + j] = statistics.m_numSamples * statistics.m_mean[j];
+        g_mpi->AllReduce(sums.data(), sums.size());
+
+        PreComputeStatistics merged;
+        merged.m_numSamples = sums[0];
+        merged.m_mean.resize(dim);
+        for (size_t j = 0; j < dim; j++)
+            merged.m_mean[j] = merged.m_numSamples > 0 ? sums[1 + j] / merged.m_numSamples : 0;
+
+        if (!statistics.m_var.empty())
+        {
+            vector<double> sqrSums(dim);
+            for (size_t j = 0; j < dim; j++)
+            {
+                double delta = statistics.m_mean[j] - merged.m_mean[j];
+                sqrSums[j] = statistics.m_numSamples * (statistics.m_var[j] + delta * delta);
+            }
+            g_mpi->AllReduce(sqrSums.data(), sqrSums.size());
+
+            merged.m_var.resize(dim);
+            for (size_t j = 0; j < dim; j++)
+                merged.m_var[j] = merged.m_numSamples > 0 ? sqrSums[j] / merged.m_numSamples : 0;
+        }
+
+        SetPreComputeStatistics<ElemType>(node, merged);
+        fprintf(stderr, "Precomputing --> Merged the statistics of %ls over %d ranks, %.0f samples.\n",
+                node->NodeName().c_str(), (int) g_mpi->NumNodesInUse(), merged.m_numSamples);
+    }
+}
+
+// Gives the other ranks the statistics that the main node has accumulated.
+template <class ElemType>
+void SGD<ElemType>::BroadcastPreComputeStatistics(const std::list<ComputationNodeBasePtr>& nodes)
+{
+    for (const auto& node : nodes)
+    {
+        // the accumulators have the same sizes on all ranks, after MarkComputed(false)
+        PreComputeStatistics statistics = GetPreComputeStatistics<ElemType>(node);
+        g_mpi->Bcast(&statistics.m_numSamples, 1, g_mpi->MainNodeRank());
+        g_mpi->Bcast(statistics.m_mean.data(), statistics.m_mean.size(), g_mpi->MainNodeRank());
+        g_mpi->Bcast(statistics.m_var.data(), statistics.m_var.size(), g_mpi->MainNodeRank());
+        SetPreComputeStatistics<ElemType>(node, statistics);
+    }
+}
+
+// what the cached statistics depend on: the data, and the nodes
+template <class ElemType>
+wstring SGD<ElemType>::GetPreComputeCacheKey(const std::list<ComputationNodeBasePtr>& nodes, size_t numSamples) const
+{
+    wstring key = L"reader=" + m_preComputeCacheKey + msra::strfun::wstrprintf(L"\nnumSamples=%llu\n", (unsigned long long) numSamples);
+    for (const auto& node : nodes)
+        key += node->NodeName() + L":" + node->OperationName() + L":" + msra::strfun::utf16(string(node->GetSampleLayout())) + L"\n";
+    return key;
+}
+
+// The cache holds the accumulators, as they are before MarkComputed(true). With onAllRanks, the main node decides
+// whether it can be used, so that all ranks either read it or compute.
+template <class ElemType>
+bool SGD<ElemType>::LoadPreComputeCache(const std::list<ComputationNodeBasePtr>& nodes, const wstring& key, bool onAllRanks)
+{
+    bool canLoad = false;
+    if (m_preComputeCacheKey.empty())
+    {
+        fprintf(stderr, "Warning: The reader configuration is not known, the precomputed statistics are not cached.\n");
+        return false;
+    }
+    if (g_mpi == nullptr || g_mpi->IsMainNode())
+    {
+        if (fexists(m_preComputeCacheFile.c_str()))
+        {
+            File fstream(m_preComputeCacheFile, FileOptions::fileOptionsBinary | FileOptions::fileOptionsRead);
+            wstring cachedKey;
+            fstream.GetMarker(FileMarker::fileMarkerBeginSection, L"BPreCompute");
+            fstream >> cachedKey;
+            canLoad = (cachedKey == key);
+            if (!canLoad)
+                fprintf(stderr, "Precomputing --> '%ls' is for another configuration, computing again.\n", m_preComputeCacheFile.c_str());
+        }
+    }
+    if (onAllRanks && g_mpi != nullptr && g_mpi->NumNodesInUse() > 1)
+    {
+        int canLoadFlag = canLoad ? 1 : 0;
+        g_mpi->Bcast(&canLoadFlag, 1, g_mpi->MainNodeRank());
+        canLoad = (canLoadFlag != 0);
+    }
+    if (!canLoad)
+        return false;
+
+    File fstream(m_preComputeCacheFile, FileOptions::fileOptionsBinary | FileOptions::fileOptionsRead);
+    wstring cachedKey;
+    fstream.GetMarker(FileMarker::fileMarkerBeginSection, L"BPreCompute");
+    fstream >> cachedKey;
+    if (cachedKey != key)
+        RuntimeError("LoadPreComputeCache: '%ls' has changed while it was read.", m_preComputeCacheFile.c_str());
+    for (const auto& node : nodes)
+    {
+        PreComputeStatistics statistics;
+        fstream >> statistics.m_numSamples >> statistics.m_mean >> statistics.m_var;
+        SetPreComputeStatistics<ElemType>(node, statistics);
+    }
+    fstream.GetMarker(FileMarker::fileMarkerEndSection, L"EPreCompute");
+    return true;
+}
+
+template <class ElemType>
+void SGD<ElemType>::SavePreComputeCache(const std::list<ComputationNodeBasePtr>& nodes, const wstring& key) const
+{
+    if (m_preComputeCacheKey.empty())
+        return;
+
+    // written into a temporary file and renamed, so that a crash does not leave a corrupt cache
+    wstring tempFileName = m_preComputeCacheFile + L".tmp";
+    {
+        File fstream(tempFileName, FileOptions::fileOptionsBinary | FileOptions::fileOptionsWrite);
+        fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BPreCompute");
+        fstream << key;
+        for (const auto& node : nodes)
+        {
+            PreComputeStatistics statistics = GetPreComputeStatistics<ElemType>(node);
+            fstream << statistics.m_numSamples << statistics.m_mean << statistics.m_var;
+        }
+        fstream.PutMarker(FileMarker::fileMarkerEndSection, L"EPreCompute");
+        fstream.Flush();
+    }
+    renameOrDie(tempFileName, m_preComputeCacheFile);
+    fprintf(stderr, "Precomputing --> Wrote the statistics to '%ls'.\n", m_preComputeCacheFile.c_str());
+}
+
+// return a reasonable initial learning rate based on the initial mbsize
+template <class ElemType>
+double SGD<ElemType>::SearchForBestLearnRate(ComputationNetworkPtr net,
+                                             ComputationNetworkPtr refNet,
+                                             const ComputationNodeBasePtr& refNode, const int epochNumber,
+                                             const double curLearnRate,
+                                             IDataReader* trainSetDataReader,
+                                             const std::vector<ComputationNodeBasePtr>& featureNodes,
+                                             const std::vector<ComputationNodeBasePtr>& labelNodes,
+                                             const std::vector<ComputationNodeBasePtr>& criterionNodes,
+                                             const std::vector<ComputationNodeBasePtr>& evaluationNodes,
+                                             StreamMinibatchInputs* inputMatrices,
+                                             const std::list<ComputationNodeBasePtr>& learnableNodes,
+                                             std::list<Matrix<ElemType>>& smoothedGradients,
+                                             const bool learnRateInitialized,
+                                             const double largestPrevLearnRatePerSample)
+{
+    double epochCriterion = std::numeric_limits<double>::infinity();
+    double prevCriterion = std::numeric_limits<double>::infinity();
+    vector<double> epochEvalErrors(evaluationNodes.size(), std::numeric_limits<double>::infinity());
+
+    size_t totalSamplesSeen = 0;
+    double bestLearnRatePerSample = curLearnRate;
+
+    size_t numFramesToUseInSearch = m_numMiniBatch4LRSearch[epochNumber] * m_mbSize[epochNumber];
+    if (m_epochSize != requestDataSize)
+    {
+        // ensure the numFramesToUseInSearch does not exceed the total number of frames in the epoch
+        numFramesToUseInSearch = min(numFramesToUseInSearch, m_epochSize);
+    }
+
+    double baseCriterion;
 
     double minLearnRate = m_minLearnRate * 0.3f;
     double learnRatePerSample = 1.0f / 8.0f / 0.618f / sqrt((double) m_mbSize[epochNumber]);
@@ -1364,6 +2141,7 @@ double SGD<ElemType>::SearchForBestLearnRate(ComputationNetworkPtr net,
     }
 
     int baseModelEpoch = epochNumber - 1;
+    WaitForPendingCheckpoints();
     net->RereadPersistableParameters<ElemType>(GetModelNameForEpoch(baseModelEpoch));
 
     double learnRate = learnRatePerSample;
@@ -1375,6 +2153,14 @@ double SGD<ElemType>::SearchForBestLearnRate(ComputationNetworkPtr net,
                        /*out*/ prevCriterion,
                        /*out*/ dummyMinibatchSize);
 
+    // all trials start from this model, and train on the same minibatches
+    CachingDataReader<ElemType> cachingReader(trainSetDataReader);
+    if (m_searchInMemory)
+    {
+        TakeSearchSnapshot(net, smoothedGradients, totalSamplesSeen);
+        trainSetDataReader = &cachingReader;
+    }
+
     // if model is not changed this is what we will get
     TrainOneMiniEpochAndReloadModel(net, refNet, refNode, epochNumber,
                                     numFramesToUseInSearch, trainSetDataReader, 0, m_mbSize[epochNumber],
@@ -1479,6 +2265,7 @@ double SGD<ElemType>::SearchForBestLearnRate(ComputationNetworkPtr net,
     fprintf(stderr, "Best Learn Rate Per Sample for Epoch[%d] = %.10g  baseCriterion=%.10g\n",
             epochNumber + 1, bestLearnRatePerSample, baseCriterion);
 
+    m_searchSnapshot.reset();
     return bestLearnRatePerSample;
 }
 
@@ -1661,6 +2448,11 @@ size_t SGD<ElemType>::SearchForBestMinibatchSize(ComputationNetworkPtr net,
             lastTriedTrialEpochCriterion = baseCriterion;
             isFirstIteration = false;
 
+            // the first trial has reloaded the start model, the others restore it from memory
+            // The minibatches are not cached, each trial reads them with another minibatch size.
+            if (m_searchInMemory)
+                TakeSearchSnapshot(net, smoothedGradients, totalSamplesSeen);
+
             fprintf(stderr, "AdaptiveMinibatchSearch: Computed BaseCriterion %.10g\n", baseCriterion);
         }
         else if (!std::isnan(epochCriterion) &&
@@ -1688,9 +2480,170 @@ size_t SGD<ElemType>::SearchForBestMinibatchSize(ComputationNetworkPtr net,
                     "EpochCriterion = %.10g vs BaseCriterion = %.10g\n\n",
             (int) lastTriedTrialMinibatchSize, lastTriedTrialEpochCriterion, baseCriterion);
 
+    m_searchSnapshot.reset();
     return lastTriedTrialMinibatchSize;
 }
 
+// PlanMinibatchSizeFromMemory() -- the largest number of samples per forward-backward pass that fits into the GPU
+// The memory plan of AllocateAllMatrices() is linear in the number of samples: a fixed part, e.g. the parameter
+// gradients, and a part per sample, the activations. The parameters and the learner state are allocated when this is
+// called, so they are already missing from the free memory. The size is checked with a dry run of one minibatch; if that
+// runs out of memory after all, e.g. because of padding of sequences, it is retried with 3/4 of the size. All ranks use
+// the same size.
+// This sets m_maxSamplesInRAM, so that larger minibatches are split into sub-minibatches, and with
+// MemoryPlanSizing::Minibatch also the minibatch size of all epochs.
+template <class ElemType>
+void SGD<ElemType>::PlanMinibatchSizeFromMemory(ComputationNetworkPtr net, IDataReader* trainSetDataReader, const int epochNumber,
+                                                const std::vector<ComputationNodeBasePtr>& featureNodes,
+                                                const std::vector<ComputationNodeBasePtr>& labelNodes,
+                                                const std::vector<ComputationNodeBasePtr>& criterionNodes,
+                                                const std::vector<ComputationNodeBasePtr>& evaluationNodes,
+                                                StreamMinibatchInputs* inputMatrices)
+{
+    const DEVICEID_TYPE deviceId = net->GetDeviceId();
+    if (deviceId < 0)
+    {
+        fprintf(stderr, "Warning: memoryPlanSizing is ignored when training on the CPU.\n");
+        return;
+    }
+
+    const size_t fixedBytes = net->GetPlannedMemoryInBytes(deviceId, 0);
+    const size_t bytesPerSample = net->GetPlannedMemoryInBytes(deviceId, 1) - fixedBytes;
+    const size_t freeBytes = GPUWatcher::GetFreeMemoryOnCUDADevice(deviceId);
+    const size_t reservedBytes = m_memoryPlanReserveMB << 20;
+    if (bytesPerSample == 0)
+    {
+        fprintf(stderr, "PlanMinibatchSizeFromMemory: The memory plan does not depend on the minibatch size, keeping the configured sizes.\n");
+        return;
+    }
+    if (freeBytes < fixedBytes + reservedBytes + bytesPerSample)
+        RuntimeError("PlanMinibatchSizeFromMemory: %.1f MB of free memory on GPU %d cannot hold the planned %.1f MB + %.1f KB per sample with %d MB reserved.",
+                     freeBytes / (1024.0 * 1024.0), (int) deviceId, fixedBytes / (1024.0 * 1024.0), bytesPerSample / 1024.0, (int) m_memoryPlanReserveMB);
+    size_t maxSamples = (freeBytes - fixedBytes - reservedBytes) / bytesPerSample;
+
+    // the ranks may have different amounts of free memory
+    const bool isDistributed = g_mpi != nullptr && g_mpi->NumNodesInUse() > 1;
+    if (isDistributed)
+    {
+        vector<double> rankSamples(g_mpi->NumNodesInUse(), 0);
+        rankSamples[g_mpi->CurrentNodeRank()] = (double) maxSamples;
+        g_mpi->AllReduce(rankSamples);
+        maxSamples = (size_t) *min_element(rankSamples.begin(), rankSamples.end());
+    }
+
+    // no need to go beyond the largest minibatch that is computed in one pass
+    // With truncated BPTT, minibatch sizes count the time steps of each parallel sequence.
+    const size_t numParallelSequences = max(trainSetDataReader->GetNumParallelSequences(), (size_t) 1);
+    size_t largestMinibatchSize = m_minibatchSizeTuningMax;
+    if (m_memoryPlanSizing == MemoryPlanSizing::Subminibatches && !m_autoAdjustMinibatch)
+    {
+        largestMinibatchSize = 0;
+        for (size_t i = 0; i < m_mbSize.size(); i++)
+            largestMinibatchSize = max(largestMinibatchSize, (size_t) m_mbSize[i]);
+    }
+    maxSamples = min(maxSamples, largestMinibatchSize * numParallelSequences);
+    if (maxSamples < numParallelSequences)
+        RuntimeError("PlanMinibatchSizeFromMemory: GPU %d does not fit a minibatch of a single time step of %d parallel sequences.", (int) deviceId, (int) numParallelSequences);
+
+    for (size_t attempt = 0;; attempt++)
+    {
+        bool failed = false;
+        try
+        {
+            DryRunMinibatch(net, trainSetDataReader, epochNumber, maxSamples / numParallelSequences,
+                            featureNodes, labelNodes, criterionNodes, evaluationNodes, inputMatrices);
+        }
+        catch (const std::exception& e)
+        {
+            fprintf(stderr, "PlanMinibatchSizeFromMemory: The dry run with %d samples failed: %s\n", (int) maxSamples, e.what());
+            failed = true;
+        }
+        if (isDistributed)
+        {
+            vector<double> numFailed(1, failed ? 1.0 : 0.0);
+            g_mpi->AllReduce(numFailed);
+            failed = numFailed[0] > 0;
+        }
+        if (!failed)
+            break;
+        if (attempt == 3 || maxSamples * 3 / 4 < numParallelSequences)
+            RuntimeError("PlanMinibatchSizeFromMemory: No minibatch size that fits into GPU %d was found.", (int) deviceId);
+        maxSamples = maxSamples * 3 / 4;
+    }
+
+    m_maxSamplesInRAM = min(m_maxSamplesInRAM, maxSamples);
+    fprintf(stderr, "PlanMinibatchSizeFromMemory: %.1f MB free on GPU %d for a plan of %.1f MB + %.1f KB per sample, with %d MB reserved: "
+                    "at most %d samples per forward-backward pass.\n",
+            freeBytes / (1024.0 * 1024.0), (int) deviceId, fixedBytes / (1024.0 * 1024.0), bytesPerSample / 1024.0, (int) m_memoryPlanReserveMB, (int) m_maxSamplesInRAM);
+    if (m_memoryPlanSizing == MemoryPlanSizing::Minibatch)
+    {
+        m_memoryPlanMinibatchSize = m_maxSamplesInRAM / numParallelSequences;
+        if (m_memoryPlanMinibatchSize >= 64)
+            m_memoryPlanMinibatchSize -= m_memoryPlanMinibatchSize % 64;
+        fprintf(stderr, "PlanMinibatchSizeFromMemory: Training with minibatchSize = %d.\n", (int) m_memoryPlanMinibatchSize);
+    }
+    else if (!m_autoAdjustMinibatch)
+    {
+        for (size_t i = 0; i < m_mbSize.size(); i++)
+        {
+            const size_t numSubminibatches = DataReaderHelpers::GetNumSubminibatchesNeeded<ElemType>(trainSetDataReader, m_maxSamplesInRAM, m_numSubminiBatches, m_mbSize[i]);
+            if (numSubminibatches > 1)
+                fprintf(stderr, "PlanMinibatchSizeFromMemory: minibatchSize[%d] = %d is computed in %d sub-minibatches.\n", (int) i, (int) m_mbSize[i], (int) numSubminibatches);
+        }
+    }
+}
+
+// forward and backward pass of one minibatch, without updating the model, see PlanMinibatchSizeFromMemory()
+// Batch normalization updates its running statistics in the forward pass, they are restored afterwards. The reader
+// starts the epoch again in TrainOneEpoch().
+template <class ElemType>
+void SGD<ElemType>::DryRunMinibatch(ComputationNetworkPtr net, IDataReader* trainSetDataReader, const int epochNumber, const size_t minibatchSize,
+                                    const std::vector<ComputationNodeBasePtr>& featureNodes,
+                                    const std::vector<ComputationNodeBasePtr>& labelNodes,
+                                    const std::vector<ComputationNodeBasePtr>& criterionNodes,
+                                    const std::vector<ComputationNodeBasePtr>& evaluationNodes,
+                                    StreamMinibatchInputs* inputMatrices)
+{
+    std::vector<std::pair<ComputationNodeBasePtr, shared_ptr<Matrix<ElemType>>>> statistics; // running mean and inverse standard deviation
+    std::vector<std::pair<ComputationNodeBasePtr, size_t>> batchNormalizationCounts;
+    for (const auto& node : net->GetAllNodes())
+    {
+        if (node->OperationName() != OperationNameOf(BatchNormalizationNode))
+            continue;
+        batchNormalizationCounts.push_back(make_pair(node, node->As<BatchNormalizationNode<ElemType>>()->GetMBCount()));
+        for (size_t i = 3; i < node->GetNumInputs(); i++)
+        {
+            auto saved = make_shared<Matrix<ElemType>>(CPUDEVICE);
+            saved->SetValueFromOtherDevice(node->Input(i)->template As<ComputationNode<ElemType>>()->Value());
+            statistics.push_back(make_pair(node->Input(i), saved));
+        }
+    }
+
+    trainSetDataReader->StartMinibatchLoop(minibatchSize, epochNumber, m_epochSize);
+    net->StartEvaluateMinibatchLoop(evaluationNodes);
+    net->StartEvaluateMinibatchLoop(criterionNodes);
+    size_t actualMBSize = 0;
+    if (DataReaderHelpers::GetMinibatchIntoNetwork<ElemType>(*trainSetDataReader, net, criterionNodes[0], /*useDistributedMBReading=*/false,
+                                                             /*useParallelTrain=*/false, *inputMatrices, actualMBSize) &&
+        actualMBSize > 0)
+    {
+        ComputationNetwork::BumpEvalTimeStamp(featureNodes);
+        ComputationNetwork::BumpEvalTimeStamp(labelNodes);
+        net->ForwardProp(evaluationNodes);
+        net->ForwardProp(criterionNodes[0]);
+        net->Backprop(criterionNodes[0]);
+        criterionNodes[0]->Get00Element(); // waits for the kernels, so that their errors surface here
+        fprintf(stderr, "PlanMinibatchSizeFromMemory: Dry run of a minibatch of %d samples succeeded.\n", (int) actualMBSize);
+    }
+    trainSetDataReader->DataEnd();
+
+    for (const auto& saved : statistics)
+        saved.first->template As<ComputationNode<ElemType>>()->Value().SetValueFromOtherDevice(*saved.second);
+    for (const auto& count : batchNormalizationCounts)
+        count.first->template As<BatchNormalizationNode<ElemType>>()->SetMBCount(count.second);
+    ComputationNetwork::BumpEvalTimeStamp(net->GetAllNodes());
+}
+
 // run training over a small subset of an epoch, for purpose of automatic LR and MB-size tuning
 template <class ElemType>
 void SGD<ElemType>::TrainOneMiniEpochAndReloadModel(ComputationNetworkPtr net,
@@ -1732,7 +2685,14 @@ void SGD<ElemType>::TrainOneMiniEpochAndReloadModel(ComputationNetworkPtr net,
         fprintf(stderr, "AvgLearningRatePerSample = %.8g\n", learnRatePerSample);
     }
 
+    if (m_searchSnapshot)
+    {
+        RestoreSearchSnapshot(net, smoothedGradients, /*out*/ totalSamplesSeen);
+        return;
+    }
+
     int baseModelEpoch = epochNumber - 1;
+    WaitForPendingCheckpoints();
     net->RereadPersistableParameters<ElemType>(GetModelNameForEpoch(baseModelEpoch));
 
     double dummyLearnRate;
@@ -1746,6 +2706,48 @@ void SGD<ElemType>::TrainOneMiniEpochAndReloadModel(ComputationNetworkPtr net,
                        /*out*/ dummyMinibatchSize);
 }
 
+// keep the state that RereadPersistableParameters() and LoadCheckPointInfo() would restore after a trial of a search
+// That is the values of the parameters (including the running statistics of batch normalization, which are parameters
+// as well), the sample counts of batch normalization, and the checkpointed learner state.
+template <class ElemType>
+void SGD<ElemType>::TakeSearchSnapshot(ComputationNetworkPtr net, const std::list<Matrix<ElemType>>& smoothedGradients, size_t totalSamplesSeen)
+{
+    m_searchSnapshot.reset(new SearchSnapshot());
+    for (const auto& node : net->GetAllNodes())
+    {
+        if (node->OperationName() == OperationNameOf(LearnableParameter))
+        {
+            const auto& value = node->As<ComputationNode<ElemType>>()->Value();
+            m_searchSnapshot->m_parameters.push_back(make_pair(node, make_shared<Matrix<ElemType>>(value, value.GetDeviceId())));
+        }
+        else if (node->OperationName() == OperationNameOf(BatchNormalizationNode))
+            m_searchSnapshot->m_batchNormalizationCounts.push_back(make_pair(node, node->As<BatchNormalizationNode<ElemType>>()->GetMBCount()));
+    }
+    for (const auto& smoothedGradient : smoothedGradients)
+        m_searchSnapshot->m_smoothedGradients.emplace_back(smoothedGradient, smoothedGradient.GetDeviceId());
+    m_searchSnapshot->m_totalSamplesSeen = totalSamplesSeen;
+    m_searchSnapshot->m_numParameterUpdates = m_numParameterUpdates;
+}
+
+template <class ElemType>
+void SGD<ElemType>::RestoreSearchSnapshot(ComputationNetworkPtr net, std::list<Matrix<ElemType>>& smoothedGradients, /*out*/ size_t& totalSamplesSeen)
+{
+    for (const auto& parameter : m_searchSnapshot->m_parameters)
+        parameter.first->template As<ComputationNode<ElemType>>()->Value().SetValue(*parameter.second);
+    for (const auto& count : m_searchSnapshot->m_batchNormalizationCounts)
+        count.first->template As<BatchNormalizationNode<ElemType>>()->SetMBCount(count.second);
+    // the parameters were changed in place
+    ComputationNetwork::BumpEvalTimeStamp(net->GetAllNodes());
+
+    if (smoothedGradients.size() != m_searchSnapshot->m_smoothedGradients.size())
+        LogicError("RestoreSearchSnapshot: The number of smoothed gradients has changed during the search.");
+    auto smoothedGradientIter = smoothedGradients.begin();
+    for (const auto& smoothedGradient : m_searchSnapshot->m_smoothedGradients)
+        (smoothedGradientIter++)->SetValue(smoothedGradient);
+    totalSamplesSeen = m_searchSnapshot->m_totalSamplesSeen;
+    m_numParameterUpdates = m_searchSnapshot->m_numParameterUpdates;
+}
+
 // Attemps to compute the error signal for the whole utterance, which will
 // be fed to the neural network as features. Currently it is a workaround
 // for the two-forward-pass sequence and ctc training, which allows
@@ -1812,6 +2814,60 @@ int SGD<ElemType>::SGDTrace(FILE* __restrict __stream, const char* __restrict __
     return result;
 }
 
+template <class ElemType>
+void SGD<ElemType>::TraceReaderStatistics(const std::string& prefixMsg, double readerTime, double totalTime, IDataReader* reader)
+{
+    SGDTrace(stderr, "%s Reader: ReaderTime = %.4gs (%.1f%% of TotalTime)", prefixMsg.c_str(), readerTime, totalTime > 0 ? 100 * readerTime / totalTime : 0.0);
+
+    // the detailed counters are only available from the readers that are built on the reader library
+    ReaderStatistics statistics;
+    if (reader->TakeStatistics(statistics))
+    {
+        SGDTrace(stderr, "; WaitTime = %.4gs; ReadyMinibatches = %.1f%%; ChunkLoadTime = %.4gs; ReadyChunks = %d of %d; MBRead = %.1f; "
+                         "DecodeTime = %.4gs; TransformTime = %.4gs; PackTime = %.4gs",
+                 statistics.m_waitSeconds, statistics.m_minibatches > 0 ? 100.0 * statistics.m_readyMinibatches / statistics.m_minibatches : 0.0,
+                 statistics.m_chunkLoadSeconds, (int) statistics.m_readyChunks, (int) statistics.m_chunks, statistics.m_bytesRead / (1024.0 * 1024.0),
+                 statistics.m_decodeSeconds, statistics.m_transformSeconds, statistics.m_packSeconds);
+        if (statistics.m_packedColumns > 0)
+            SGDTrace(stderr, "; Gaps = %.1f%%", 100.0 * statistics.m_gapColumns / statistics.m_packedColumns);
+    }
+    SGDTrace(stderr, "\n");
+}
+
+template <class ElemType>
+void SGD<ElemType>::TraceGpuTelemetry(int epochNumber, DEVICEID_TYPE deviceId)
+{
+    GPUTelemetrySummary summary = m_gpuWatcher->TakeSummary();
+    if (summary.m_numSamples == 0)
+        return;
+
+    const double MB = 1024.0 * 1024.0;
+    fprintf(stderr, "Finished Epoch[%2d of %d]: GPU %d: Utilization = %.1f%%; MemoryUtilization = %.1f%%; PeakMemoryUsedMB = %.0f of %.0f; "
+                    "AllocatorPeakMB = %.0f in use, %.0f reserved; PcieTxMBPerSecond = %.1f; PcieRxMBPerSecond = %.1f; SmClockMHz = %.0f; Throttled = %.1f%% (reasons 0x%llx)\n",
+            epochNumber, (int) m_maxEpochs, (int) deviceId, summary.m_averageUtilization, summary.m_averageMemoryUtilization,
+            summary.m_peakMemoryUsed / MB, summary.m_totalMemory / MB, summary.m_allocatorPeakBytesInUse / MB, summary.m_allocatorPeakBytesReserved / MB,
+            summary.m_averagePcieTxMBPerSecond, summary.m_averagePcieRxMBPerSecond, summary.m_averageSmClockMHz,
+            100 * summary.m_throttledFraction, summary.m_throttleReasons);
+
+    if (m_gpuTelemetryFile.empty())
+        return;
+
+    // each rank has its own GPU, and its own file
+    wstring path = m_gpuTelemetryFile;
+    if (g_mpi != nullptr && g_mpi->NumNodesInUse() > 1)
+        path += msra::strfun::wstrprintf(L".rank%d", (int) g_mpi->CurrentNodeRank());
+    FILE* f = fopenOrDie(path, L"a");
+    fprintf(f, "{\"epoch\": %d, \"samples\": %d, \"utilization\": %.2f, \"memoryUtilization\": %.2f, \"peakMemoryUsed\": %llu, \"totalMemory\": %llu, "
+               "\"allocatorPeakBytesInUse\": %llu, \"allocatorPeakBytesReserved\": %llu, \"pcieTxMBPerSecond\": %.2f, \"pcieRxMBPerSecond\": %.2f, "
+               "\"smClockMHz\": %.0f, \"throttledFraction\": %.4f, \"throttleReasons\": %llu}\n",
+            epochNumber, (int) summary.m_numSamples, summary.m_averageUtilization, summary.m_averageMemoryUtilization,
+            (unsigned long long) summary.m_peakMemoryUsed, (unsigned long long) summary.m_totalMemory,
+            (unsigned long long) summary.m_allocatorPeakBytesInUse, (unsigned long long) summary.m_allocatorPeakBytesReserved,
+            summary.m_averagePcieTxMBPerSecond, summary.m_averagePcieRxMBPerSecond, summary.m_averageSmClockMHz,
+            summary.m_throttledFraction, summary.m_throttleReasons);
+    fcloseOrDie(f);
+}
+
 template <class ElemType>
 void SGD<ElemType>::InitDistGradAgg(int numEvalNodes, int traceLevel)
 {
@@ -1820,14 +2876,18 @@ void SGD<ElemType>::InitDistGradAgg(int numEvalNodes, int traceLevel)
         if (m_distGradAgg == nullptr)
         {
 #ifdef QUANTIZED_GRADIENT_AGGREGATION
+            if ((m_gradientBucketSizeInBytes > 0) || (m_gradientTransport != GradientTransport::Host) || m_hierarchicalGradientAggregation)
+                fprintf(stderr, "WARNING: gradientBucketSizeInBytes, gradientTransport and hierarchicalGradientAggregation are ignored with quantized gradient aggregation.\n");
+            if ((m_gradientCompression != GradientCompressionType::None) && (m_gradientCompression != GradientCompressionType::Quantization))
+                fprintf(stderr, "WARNING: gradientCompression is ignored with quantized gradient aggregation.\n");
             m_distGradAgg = new AllReduceDistGradAggregator<ElemType>(g_mpi, m_numGradientBits, m_zeroThresholdFor1Bit, true /*useQuantizationForSelfStripe*/, m_bufferedAsyncGradientAggregation, traceLevel, m_syncStatsTrace);
 #else
-            if (m_numGradientBits != (8 * sizeof(ElemType)))
-            {
-                RuntimeError("Gradient quantization is unsupported in CNTK binaries built without quantized gradient aggregation support!");
-            }
-
-            m_distGradAgg = new SimpleDistGradAggregator<ElemType>(g_mpi, m_bufferedAsyncGradientAggregation, m_syncStatsTrace);
+            m_distGradAgg = new SimpleDistGradAggregator<ElemType>(g_mpi, m_bufferedAsyncGradientAggregation, m_syncStatsTrace, m_gradientBucketSizeInBytes,
+                                                                   m_gradientTransport == GradientTransport::CudaAwareMPI, m_hierarchicalGradientAggregation);
+            // Without quantized gradient aggregation, gradientBits are the bits of the quantizing compressor
+            if (m_gradientCompression != GradientCompressionType::None)
+                m_distGradAgg->SetGradientCompressorFactory(GetGradientCompressorFactory<ElemType>(m_gradientCompression, m_numGradientBits, m_zeroThresholdFor1Bit,
+                                                                                                   m_gradientCompressionTopKRatio, m_gradientCompressionMinElements));
 #endif // !QUANTIZED_GRADIENT_AGGREGATION
         }
 
@@ -1841,18 +2901,297 @@ void SGD<ElemType>::InitDistGradAgg(int numEvalNodes, int traceLevel)
 template <class ElemType>
 void SGD<ElemType>::InitModelAggregationHandler(int traceLevel)
 {
-    if (m_parallelizationMethod == ParallelizationMethod::ModelAveragingSGD)
+    if ((m_parallelizationMethod == ParallelizationMethod::DataParallelASGD) && !m_pMASGDHelper)
+    {
+        m_pMASGDHelper = make_shared<ParameterServerSGD<ElemType>>(g_mpi, traceLevel, m_maxStaleness);
+    }
+    else if (m_parallelizationMethod == ParallelizationMethod::ModelAveragingSGD)
+    {
+#ifndef BLOCKWISE_MODEL_UPDATE_FILTERING
+        if (!m_pMASGDHelper && (m_useBlockMomentum || m_asyncModelAggregation))
+        {
+            // without block momentum, this is model averaging with async aggregation
+            double blockMomentum = m_useBlockMomentum ? m_blockMomentum : 0.0;
+            double blockLearningRate = m_useBlockMomentum ? m_blockLearningRate : 1.0;
+            if (blockMomentum < 0)
+                blockMomentum = 1.0 - 1.0 / g_mpi->NumNodesInUse();
+            m_pMASGDHelper = make_shared<BlockMomentumSGD<ElemType>>(g_mpi, traceLevel, blockMomentum, blockLearningRate, m_useNesterovBlockMomentum,
+                                                                     m_useBlockMomentum && m_resetSGDMomentum, m_asyncModelAggregation, m_hierarchicalModelAggregation);
+            if (m_modelTransport != GradientTransport::Host)
+                fprintf(stderr, "WARNING: modelTransport is ignored with block momentum or async model aggregation.\n");
+        }
+        else if (!m_pMASGDHelper)
+        {
+            m_pMASGDHelper = make_shared<BasicModelAveragingSGD<ElemType>>(g_mpi, traceLevel, m_hierarchicalModelAggregation, m_modelBucketSizeInBytes,
+                                                                           m_modelTransport == GradientTransport::CudaAwareMPI);
+        }
+#else
+
+#endif 
+    }
+    
+}
+
+// Changes the nodes of the elastic job at an epoch boundary, and gives the new ones the model and the training state of the main node.
+// The aggregation is recreated for the new number of nodes. Returns false on the nodes that left the job.
+template <class ElemType>
+bool SGD<ElemType>::ChangeElasticMembership(const std::list<ComputationNodeBasePtr>& learnableNodes,
+                                            std::list<Matrix<ElemType>>& smoothedGradients,
+                                            std::vector<double>& trainingState,
+                                            int numEvalNodes)
+{
+    // the aggregation holds the communicators of the old nodes
+    if (m_distGradAgg != nullptr)
+    {
+        delete m_distGradAgg;
+        m_distGradAgg = nullptr;
+    }
+    m_pMASGDHelper.reset();
+
+    if (!m_elastic->ChangeMembership())
+    {
+        return false;
+    }
+
+    g_mpi->Bcast(trainingState.data(), trainingState.size(), g_mpi->MainNodeRank());
+
+    auto smoothedGradientIter = smoothedGradients.begin();
+    for (auto nodeIter = learnableNodes.begin(); nodeIter != learnableNodes.end(); nodeIter++, smoothedGradientIter++)
+    {
+        ComputationNodePtr node = dynamic_pointer_cast<ComputationNode<ElemType>>(*nodeIter);
+        BroadcastMatrix(node->Value());
+        BroadcastMatrix(*smoothedGradientIter);
+    }
+
+    InitDistGradAgg(numEvalNodes, m_traceLevel);
+    InitModelAggregationHandler(m_syncStatsTrace);
+    return true;
+}
+
+template <class ElemType>
+bool SGD<ElemType>::UseStartupBroadcast() const
+{
+    return m_broadcastStartupState && (m_parallelizationMethod != ParallelizationMethod::None) && (g_mpi != nullptr) && (g_mpi->NumNodesInUse() > 1);
+}
+
+// With the startup broadcast, only the main node reads the model file. The other ranks receive its contents and load them
+// from a copy in their local temporary directory (TMPDIR, or TEMP on Windows).
+template <class ElemType>
+ComputationNetworkPtr SGD<ElemType>::LoadNetwork(DEVICEID_TYPE deviceId, const wstring& fileName)
+{
+    if (!UseStartupBroadcast())
+        return ComputationNetwork::CreateFromFile<ElemType>(deviceId, fileName);
+
+    vector<char> contents;
+    size_t size = 0;
+    if (g_mpi->IsMainNode())
+    {
+        size = filesize(fileName.c_str());
+        contents.resize(size);
+        freadBlocksOrDie(fileName, 0, size, contents.data());
+    }
+    g_mpi->Bcast(&size, 1, g_mpi->MainNodeRank());
+    contents.resize(size);
+    g_mpi->Bcast(contents.data(), size, g_mpi->MainNodeRank());
+
+    // the main node reads the file again, from the file cache
+    if (g_mpi->IsMainNode())
+        return ComputationNetwork::CreateFromFile<ElemType>(deviceId, fileName);
+
+#ifdef _WIN32
+    const char* tempDir = getenv("TEMP");
+#else
+    const char* tempDir = getenv("TMPDIR");
+#endif
+    wstring localFileName = msra::strfun::utf16((tempDir != nullptr && *tempDir) ? tempDir : "/tmp") +
+                            msra::strfun::wstrprintf(L"/cntk.model.%d.%u", (int) g_mpi->CurrentNodeRank(), (unsigned int) std::random_device()());
+    FILE* f = fopenOrDie(localFileName, L"wb");
+    fwriteOrDie(contents.data(), 1, size, f);
+    fcloseOrDie(f);
+    contents = vector<char>();
+
+    ComputationNetworkPtr net;
+    try
+    {
+        net = ComputationNetwork::CreateFromFile<ElemType>(deviceId, localFileName);
+    }
+    catch (...)
+    {
+        _wunlink(localFileName.c_str());
+        throw;
+    }
+    unlinkOrDie(localFileName);
+    fprintf(stderr, "Loaded the model '%ls' as read by the main node.\n", fileName.c_str());
+    return net;
+}
+
+// Gives the other ranks the parameters of the main node, e.g. after each rank has initialized its own.
+template <class ElemType>
+void SGD<ElemType>::BroadcastParameters(const ComputationNetworkPtr& net)
+{
+    // by name, so in the same order on all ranks
+    for (const auto& nodeBase : net->GetNodesWithType(OperationNameOf(LearnableParameter)))
+    {
+        auto node = dynamic_pointer_cast<ComputationNode<ElemType>>(nodeBase);
+        if (node)
+            BroadcastMatrix(node->Value());
+    }
+    fprintf(stderr, "Broadcast the initial model from the main node.\n");
+}
+
+// Gives the other ranks the matrix of the main node. GPU matrices are handed to MPI directly if it is CUDA-aware
+// (see gradientTransport and modelTransport), otherwise they are staged through host memory.
+template <class ElemType>
+void SGD<ElemType>::BroadcastMatrix(Matrix<ElemType>& mat)
+{
+    size_t dims[2] = {mat.GetNumRows(), mat.GetNumCols()};
+    g_mpi->Bcast(dims, 2, g_mpi->MainNodeRank());
+    mat.Resize(dims[0], dims[1]);
+    BroadcastValues(mat, g_mpi->MainNodeRank());
+}
+
+// like BroadcastMatrix(), for a matrix of the same size on all ranks
+template <class ElemType>
+void SGD<ElemType>::BroadcastValues(Matrix<ElemType>& mat, size_t rootRank)
+{
+    bool isCudaAware = (m_gradientTransport == GradientTransport::CudaAwareMPI) || (m_modelTransport == GradientTransport::CudaAwareMPI);
+    if ((mat.GetDeviceId() >= 0) && isCudaAware)
+    {
+        std::unique_ptr<MatrixComputeStreamEvent> mainStreamSyncEvent(MatrixComputeStreamEvent::Create(mat.GetDeviceId()));
+        mainStreamSyncEvent->SynchronizeEvent();
+        g_mpi->Bcast(mat.BufferPointer(), mat.GetNumElements(), rootRank);
+    }
+    else if (mat.GetNumElements() > 0)
+    {
+        unique_ptr<ElemType[]> px(mat.CopyToArray());
+        g_mpi->Bcast(px.get(), mat.GetNumElements(), rootRank);
+        mat.SetValue(mat.GetNumRows(), mat.GetNumCols(), mat.GetDeviceId(), px.get());
+    }
+}
+
+// the order in which the aggregator gets the gradients: bucketed aggregation wants them in the order in which the backprop
+// completes them, i.e. reverse evaluation order
+template <class ElemType>
+std::list<ComputationNodeBasePtr> SGD<ElemType>::GetGradientOrder(const ComputationNetworkPtr& net, const ComputationNodeBasePtr& criterionNode,
+                                                                  const std::list<ComputationNodeBasePtr>& learnableNodes) const
+{
+    if (m_gradientBucketSizeInBytes == 0 && !m_shardOptimizerState)
+        return learnableNodes;
+
+    list<ComputationNodeBasePtr> gradientNodes;
+    set<ComputationNodeBasePtr> learnableNodeSet(learnableNodes.begin(), learnableNodes.end());
+    const auto& evalOrder = net->GetEvalOrder(criterionNode);
+    copy_if(evalOrder.rbegin(), evalOrder.rend(), back_inserter(gradientNodes), [&](const ComputationNodeBasePtr& n) { return learnableNodeSet.find(n) != learnableNodeSet.end(); });
+    if (gradientNodes.size() != learnableNodes.size())
+        LogicError("GetGradientOrder: not all learnable parameters are in the evaluation order of the criterion.");
+    return gradientNodes;
+}
+
+// Splits the parameters, in the order of their gradients, into one contiguous range of about the same number of elements per rank,
+// so that the buckets of the aggregation rarely have to be split at the owners.
+template <class ElemType>
+void SGD<ElemType>::AssignOptimizerStateOwners(const std::list<ComputationNodeBasePtr>& gradientNodes, const std::list<ComputationNodeBasePtr>& learnableNodes)
+{
+    size_t numElements = 0;
+    for (const auto& node : gradientNodes)
+        numElements += dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Value().GetNumElements();
+
+    map<ComputationNodeBasePtr, int> ownerOf;
+    size_t numRanks = g_mpi->NumNodesInUse();
+    size_t numPreceding = 0;
+    for (const auto& node : gradientNodes)
+    {
+        size_t n = dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Value().GetNumElements();
+        // the rank whose range holds the middle of the parameter
+        size_t owner = numElements > 0 ? (size_t) (((double) numPreceding + n / 2.0) * numRanks / numElements) : 0;
+        ownerOf[node] = (int) min(owner, numRanks - 1);
+        numPreceding += n;
+    }
+
+    m_optimizerStateOwners.clear();
+    size_t numOwned = 0;
+    for (const auto& node : learnableNodes)
+    {
+        m_optimizerStateOwners.push_back(ownerOf[node]);
+        if (ownerOf[node] == (int) g_mpi->CurrentNodeRank())
+            numOwned += dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Value().GetNumElements();
+    }
+    fprintf(stderr, "Sharded optimizer state: this rank updates %d of %d parameter elements.\n", (int) numOwned, (int) numElements);
+}
+
+template <class ElemType>
+bool SGD<ElemType>::IsOptimizerStateOwner(size_t learnableNodeIndex) const
+{
+    return m_optimizerStateOwners.empty() || (m_optimizerStateOwners[learnableNodeIndex] == (int) g_mpi->CurrentNodeRank());
+}
+
+template <class ElemType>
+void SGD<ElemType>::ReleaseUnownedOptimizerState(std::list<Matrix<ElemType>>& smoothedGradients)
+{
+    size_t k = 0;
+    for (auto& smoothedGradient : smoothedGradients)
+    {
+        if (!IsOptimizerStateOwner(k++))
+            smoothedGradient = Matrix<ElemType>(CPUDEVICE);
+    }
+}
+
+// Copies the smoothed gradients of the other ranks into host matrices of the main node, for writing a checkpoint.
+template <class ElemType>
+void SGD<ElemType>::GatherOptimizerState(std::list<Matrix<ElemType>>& smoothedGradients)
+{
+    size_t k = 0;
+    for (auto& smoothedGradient : smoothedGradients)
+    {
+        int owner = m_optimizerStateOwners[k++];
+        if (owner != (int) g_mpi->MainNodeRank())
+            TransferMatrix(smoothedGradient, owner, g_mpi->MainNodeRank());
+    }
+}
+
+// Gives the other ranks the parameters that their owners have updated.
+template <class ElemType>
+void SGD<ElemType>::BroadcastUpdatedParameters(const std::list<ComputationNodeBasePtr>& learnableNodes)
+{
+    size_t k = 0;
+    for (const auto& node : learnableNodes)
+    {
+        int owner = m_optimizerStateOwners[k++];
+        if (node->IsParameterUpdateRequired())
+            BroadcastValues(dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Value(), owner);
+    }
+}
+
+// Sends the matrix of rank srcRank to rank dstRank, through host memory; the other ranks do nothing.
+template <class ElemType>
+void SGD<ElemType>::TransferMatrix(Matrix<ElemType>& mat, size_t srcRank, size_t dstRank)
+{
+    size_t myRank = g_mpi->CurrentNodeRank();
+    if (myRank == srcRank)
+    {
+        size_t dims[2] = {mat.GetNumRows(), mat.GetNumCols()};
+        g_mpi->Send(dims, 2, dstRank);
+        if (mat.GetNumElements() > 0)
+        {
+            unique_ptr<ElemType[]> px(mat.CopyToArray());
+            g_mpi->Send(px.get(), mat.GetNumElements(), dstRank);
+        }
+    }
+    else if (myRank == dstRank)
     {
-#ifndef BLOCKWISE_MODEL_UPDATE_FILTERING
-        if (!m_pMASGDHelper)
+        size_t dims[2];
+        g_mpi->Recv(dims, 2, srcRank);
+        unique_ptr<ElemType[]> px(new ElemType[dims[0] * dims[1]]);
+        if (dims[0] * dims[1] > 0)
         {
-            m_pMASGDHelper = make_shared<BasicModelAveragingSGD<ElemType>>(g_mpi, traceLevel);
+            g_mpi->Recv(px.get(), dims[0] * dims[1], srcRank);
+            mat.SetValue(dims[0], dims[1], mat.GetDeviceId(), px.get());
+        }
+        else
+        {
+            mat.Resize(dims[0], dims[1]);
         }
-#else
-
-#endif 
     }
-    
 }
 // public:
 // UpdateWeightsS - static version of UpdateWeights()
@@ -1898,6 +3237,19 @@ template <class ElemType>
         sgdUpdateNoise.SetGaussianRandomValue(0, (ElemType) noiseStd);
     }
 
+    // lazy update of a sparse gradient: only the columns present, with their L2 term; the others catch up when next present
+    // (the config excludes noise and L1 with it)
+    if (sgd->m_lazySparseUpdate && gradientValues.GetMatrixType() == MatrixType::SPARSE)
+    {
+        const size_t step = max(sgd->m_numParameterUpdates, (size_t) 1);
+        const ElemType l2Weight = (ElemType)(L2RegWeight * actualMBSize);
+        if (adpType == GradientsUpdateType::None)
+            smoothedGradient.LazyNormalGrad(step, gradientValues, functionValues, (ElemType) learnRatePerSample, (ElemType) momentum, l2Weight);
+        else // as below, the other learners are delegated to AdaGrad for sparse gradients
+            smoothedGradient.LazyAdagrad(step, gradientValues, functionValues, (ElemType) learnRatePerSample, l2Weight, needAveMultiplier);
+        return;
+    }
+
     // L2 regularizer
     if (L2RegWeight > 0)
     {
@@ -1911,10 +3263,9 @@ template <class ElemType>
                                     (ElemType) learnRatePerSample, (ElemType) momentum, useNesterovMomentum);
     }
     else if (adpType == GradientsUpdateType::AdaGrad ||
-             (adpType == GradientsUpdateType::RmsProp && gradientValues.GetMatrixType() == MatrixType::SPARSE) ||
-             (adpType == GradientsUpdateType::FSAdaGrad && gradientValues.GetMatrixType() == MatrixType::SPARSE))
+             (adpType != GradientsUpdateType::None && gradientValues.GetMatrixType() == MatrixType::SPARSE))
     {
-        // rmsprop for sparse is not implemented yet, delegate it with adagrad
+        // rmsprop, fsadagrad, adam, lars, and lamb for sparse are not implemented yet, delegate them with adagrad
 
         double aveMultiplier = smoothedGradient.Adagrad(gradientValues, needAveMultiplier);
         Matrix<ElemType>::ScaleAndAdd((ElemType)(-learnRatePerSample / aveMultiplier), gradientValues, functionValues);
@@ -1930,6 +3281,35 @@ template <class ElemType>
                                                         (ElemType) sgd->m_rpi.dec, (ElemType) sgd->m_rpi.min, needAveMultiplier);
         Matrix<ElemType>::ScaleAndAdd((ElemType)(-learnRatePerSample / aveMultiplier), gradientValues, functionValues);
     }
+    else if (adpType == GradientsUpdateType::Adam || adpType == GradientsUpdateType::LARS || adpType == GradientsUpdateType::LAMB)
+    {
+        // The steps of these do not scale with the gradient, so the learning rate is taken per minibatch.
+        const double learnRatePerMB = learnRatePerSample * actualMBSize;
+        const size_t step = max(sgd->m_numParameterUpdates, (size_t) 1);
+        const AdamInfo& adam = sgd->m_adam;
+        if (adpType == GradientsUpdateType::Adam)
+        {
+            smoothedGradient.Adam(step, gradientValues, functionValues, (ElemType) learnRatePerMB, (ElemType) adam.beta1, (ElemType) adam.beta2, (ElemType) adam.epsilon);
+        }
+        else if (adpType == GradientsUpdateType::LAMB)
+        {
+            // the Adam direction, scaled to the norm of the weights
+            smoothedGradient.AdamDirection(step, gradientValues, (ElemType) adam.beta1, (ElemType) adam.beta2, (ElemType) adam.epsilon);
+            double weightNorm = functionValues.FrobeniusNorm();
+            double directionNorm = gradientValues.FrobeniusNorm();
+            double trustRatio = (weightNorm > 0 && directionNorm > 0) ? weightNorm / directionNorm : 1.0;
+            Matrix<ElemType>::ScaleAndAdd((ElemType)(-learnRatePerMB * trustRatio), gradientValues, functionValues);
+        }
+        else // LARS
+        {
+            // the gradient already includes the L2 term
+            double weightNorm = functionValues.FrobeniusNorm();
+            double gradientNorm = gradientValues.FrobeniusNorm();
+            double localLearnRate = (weightNorm > 0 && gradientNorm > 0) ? adam.trustCoefficient * weightNorm / gradientNorm : 1.0;
+            smoothedGradient.NormalGrad(gradientValues, functionValues,
+                                        (ElemType)(learnRatePerMB * localLearnRate), (ElemType) momentum, useNesterovMomentum);
+        }
+    }
 
     if (noiseStd > 0)
     {
@@ -1975,10 +3355,90 @@ void SGD<ElemType>::UpdateWeights(const ComputationNodeBasePtr& node,
     node->BumpEvalTimeStamp();
 }
 
+// The parameters with dense gradients on the device of the first learnable node are updated together by Matrix::FusedSGDUpdate(),
+// if the update type is momentum SGD or FSAdaGrad without noise, and gradients are clipped by truncation or by the global norm if at all.
+// All others, and all in other cases, go through UpdateWeights() one by one. The global norm is only computed on the device if all
+// parameters are fused, since the others need the scale factor on the host.
+template <class ElemType>
+void SGD<ElemType>::UpdateWeightsFused(const std::list<ComputationNodeBasePtr>& learnableNodes,
+                                       std::list<Matrix<ElemType>>& smoothedGradients,
+                                       const double learnRatePerSample,
+                                       const double momentumPerSample,
+                                       const size_t actualMBSize)
+{
+    const bool clippingEnabled = m_clippingThresholdPerSample != std::numeric_limits<double>::infinity();
+    GradientsUpdateType adpType = GradUpdateType();
+    bool canFuse = (adpType == GradientsUpdateType::None || adpType == GradientsUpdateType::FSAdaGrad) &&
+                   GradientUpdateNoiseStd() <= 0 &&
+                   (!clippingEnabled || m_gradientClippingWithTruncation || m_gradientClippingWithGlobalNorm);
+
+    std::vector<ComputationNodeBasePtr> otherNodes;
+    std::vector<Matrix<ElemType>*> otherSmoothedGradients;
+    std::vector<ComputationNodeBasePtr> fusedNodes;
+    std::vector<Matrix<ElemType>*> values;
+    std::vector<const Matrix<ElemType>*> gradients;
+    std::vector<Matrix<ElemType>*> fusedSmoothedGradients;
+    std::vector<double> learnRates;
+    auto smoothedGradientIter = smoothedGradients.begin();
+    for (auto nodeIter = learnableNodes.begin(); nodeIter != learnableNodes.end(); nodeIter++, smoothedGradientIter++)
+    {
+        ComputationNodeBasePtr node = *nodeIter;
+        if (!node->IsParameterUpdateRequired())
+            continue;
+
+        auto& value = dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Value();
+        auto& gradient = dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Gradient();
+        if (canFuse && value.GetMatrixType() == DENSE && gradient.GetMatrixType() == DENSE && smoothedGradientIter->GetMatrixType() == DENSE &&
+            (values.empty() || value.GetDeviceId() == values.front()->GetDeviceId()) &&
+            gradient.GetDeviceId() == value.GetDeviceId() && smoothedGradientIter->GetDeviceId() == value.GetDeviceId())
+        {
+            fusedNodes.push_back(node);
+            values.push_back(&value);
+            gradients.push_back(&gradient);
+            fusedSmoothedGradients.push_back(&*smoothedGradientIter);
+            learnRates.push_back(learnRatePerSample * node->GetLearningRateMultiplier());
+        }
+        else
+        {
+            otherNodes.push_back(node);
+            otherSmoothedGradients.push_back(&*smoothedGradientIter);
+        }
+    }
+
+    const bool clipByGlobalNorm = clippingEnabled && m_gradientClippingWithGlobalNorm;
+    if (clipByGlobalNorm && !otherNodes.empty())
+        ClipGradientsByGlobalNorm(learnableNodes, actualMBSize);
+    for (size_t i = 0; i < otherNodes.size(); i++)
+    {
+        UpdateWeights(otherNodes[i], *otherSmoothedGradients[i], learnRatePerSample, momentumPerSample, actualMBSize,
+                      m_L2RegWeight, m_L1RegWeight, m_needAveMultiplier, m_useNesterovMomentum);
+    }
+    if (fusedNodes.empty())
+        return;
+
+    const ElemType maxGradientPerMB = (ElemType) (m_clippingThresholdPerSample * actualMBSize);
+    FusedSGDBatch<ElemType> options;
+    options.m_isFSAdagrad = adpType == GradientsUpdateType::FSAdaGrad;
+    options.m_useNesterovMomentum = m_useNesterovMomentum;
+    options.m_momentum = (ElemType) MomentumPerMB(momentumPerSample, actualMBSize);
+    options.m_adaWeight = 0;
+    options.m_truncationThreshold = clippingEnabled && !m_gradientClippingWithGlobalNorm ? maxGradientPerMB : std::numeric_limits<ElemType>::infinity();
+    options.m_maxGradientNorm = clipByGlobalNorm && otherNodes.empty() ? maxGradientPerMB : std::numeric_limits<ElemType>::infinity();
+    options.m_gradientSquaredNorm = nullptr;
+    options.m_L2Weight = (ElemType) (m_L2RegWeight * actualMBSize);
+    options.m_numTensors = 0;
+    if (!m_gradientSquaredNorm)
+        m_gradientSquaredNorm = make_shared<Matrix<ElemType>>(values.front()->GetDeviceId());
+    Matrix<ElemType>::FusedSGDUpdate(options, actualMBSize, values, gradients, fusedSmoothedGradients, learnRates, m_L1RegWeight, m_gradientSquaredNorm.get());
+
+    for (const auto& node : fusedNodes)
+        node->BumpEvalTimeStamp();
+}
+
 template <class ElemType>
 void SGD<ElemType>::ClipGradient(Matrix<ElemType>& gradient, const size_t actualMBSize) const
 {
-    if (m_clippingThresholdPerSample != std::numeric_limits<double>::infinity())
+    if (m_clippingThresholdPerSample != std::numeric_limits<double>::infinity() && !m_gradientClippingWithGlobalNorm)
     {
         double maxGradientPerMB = m_clippingThresholdPerSample * actualMBSize;
         if (m_gradientClippingWithTruncation)
@@ -1996,6 +3456,89 @@ void SGD<ElemType>::ClipGradient(Matrix<ElemType>& gradient, const size_t actual
     }
 }
 
+template <class ElemType>
+void SGD<ElemType>::ClipGradientsByGlobalNorm(const std::list<ComputationNodeBasePtr>& learnableNodes, const size_t actualMBSize) const
+{
+    if (m_clippingThresholdPerSample == std::numeric_limits<double>::infinity())
+        return;
+
+    double sumOfSquares = 0;
+    for (const auto& node : learnableNodes)
+    {
+        if (!node->IsParameterUpdateRequired())
+            continue;
+        double gradientNorm = dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Gradient().FrobeniusNorm();
+        sumOfSquares += gradientNorm * gradientNorm;
+    }
+
+    double maxGradientPerMB = m_clippingThresholdPerSample * actualMBSize;
+    double globalNorm = sqrt(sumOfSquares);
+    if (globalNorm > maxGradientPerMB)
+    {
+        double normFactor = maxGradientPerMB / globalNorm;
+        for (const auto& node : learnableNodes)
+        {
+            if (node->IsParameterUpdateRequired())
+                dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Gradient() *= (ElemType) normFactor;
+        }
+    }
+}
+
+// The gradients are unscaled in place, and whether they are finite is determined with a single read-back per minibatch:
+// Each dense gradient adds the sum of g - g to a 1x1 flag on the device, which is 0 for finite elements and NaN for Inf and NaN.
+// (Sparse gradients cannot be viewed as tensors, so they are checked one by one.) An overflowed update is skipped anyway,
+// so it does not matter that its gradients have been unscaled already.
+template <class ElemType>
+bool SGD<ElemType>::UnscaleGradients(const std::list<ComputationNodeBasePtr>& learnableNodes)
+{
+    bool isFinite = true;
+    bool hasDenseGradients = false;
+    for (const auto& node : learnableNodes)
+    {
+        if (!node->IsParameterUpdateRequired())
+            continue;
+        Matrix<ElemType>& gradient = dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Gradient();
+        if (gradient.GetNumElements() == 0)
+            continue;
+        if (gradient.GetMatrixType() == MatrixType::SPARSE)
+            isFinite = isFinite && std::isfinite((double) gradient.SumOfAbsElements());
+        else
+        {
+            if (!m_gradientsNonFinite || m_gradientsNonFinite->GetDeviceId() != gradient.GetDeviceId()) // (parameters placed on other devices)
+            {
+                if (hasDenseGradients)
+                    isFinite = isFinite && std::isfinite((double) m_gradientsNonFinite->Get00Element());
+                m_gradientsNonFinite = make_shared<Matrix<ElemType>>(1, 1, gradient.GetDeviceId());
+                hasDenseGradients = false;
+            }
+            if (!hasDenseGradients)
+                m_gradientsNonFinite->SetValue(0);
+            hasDenseGradients = true;
+            TensorView<ElemType> elements(gradient, TensorShape(gradient.GetNumElements()));
+            TensorView<ElemType>(*m_gradientsNonFinite, TensorShape(1)).AddDifferenceOf(elements, elements);
+        }
+        Matrix<ElemType>::Scale((ElemType) (1.0 / m_lossScale), gradient);
+    }
+    if (hasDenseGradients)
+        isFinite = isFinite && std::isfinite((double) m_gradientsNonFinite->Get00Element());
+
+    if (!isFinite)
+    {
+        m_lossScale = max(m_lossScale / 2, 1.0);
+        m_numMBsSinceLossScaleChange = 0;
+        if (m_traceLevel > 0)
+            fprintf(stderr, "UnscaleGradients: The gradients overflowed, skipping this update. Loss scale lowered to %.0f.\n", m_lossScale);
+        return false;
+    }
+
+    if (++m_numMBsSinceLossScaleChange >= m_lossScaleGrowthInterval)
+    {
+        m_lossScale *= 2;
+        m_numMBsSinceLossScaleChange = 0;
+    }
+    return true;
+}
+
 template <class ElemType>
 void SGD<ElemType>::SaveCheckPointInfo(const size_t epoch, const size_t totalSamplesSeen,
                                        const double learnRatePerSample,
@@ -2007,43 +3550,304 @@ void SGD<ElemType>::SaveCheckPointInfo(const size_t epoch, const size_t totalSam
     // the parallel training nodes from colliding to write the same file
     if ((g_mpi == nullptr) || g_mpi->IsMainNode())
     {
-        wstring checkPointFileName = GetCheckPointFileNameForEpoch(int(epoch));
-        // Saving into temporary file and then renaming it to the checkPointFileName
-        // This is a standard trick to avoid havign corrupted checkpoints files if process dies during writing
-        wstring tempFileName = checkPointFileName + L".tmp";
+        WriteCheckPointFile(GetCheckPointFileNameForEpoch(int(epoch)), totalSamplesSeen, learnRatePerSample, smoothedGradients,
+                            prevCriterion, minibatchSize, m_numParameterUpdates, /*syncToDisk=*/false);
+    }
+}
+
+// write a checkpoint file from explicit values, so that it can be done by the background thread of SaveCheckpoint()
+template <class ElemType>
+void SGD<ElemType>::WriteCheckPointFile(const wstring& checkPointFileName, const size_t totalSamplesSeen,
+                                        const double learnRatePerSample,
+                                        const std::list<Matrix<ElemType>>& smoothedGradients,
+                                        const double prevCriterion,
+                                        const size_t minibatchSize,
+                                        const size_t numParameterUpdates,
+                                        bool syncToDisk,
+                                        const EpochProgress* epochProgress)
+{
+    // Saving into temporary file and then renaming it to the checkPointFileName
+    // This is a standard trick to avoid havign corrupted checkpoints files if process dies during writing
+    wstring tempFileName = checkPointFileName + L".tmp";
+
+    {
+        File fstream(tempFileName, FileOptions::fileOptionsBinary | FileOptions::fileOptionsWrite);
+        fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BVersion"); 
+        fstream << (size_t)CURRENT_CNTK_CHECKPOINT_VERSION; 
+        fstream.PutMarker(FileMarker::fileMarkerEndSection, L"EVersion");
+
+        fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BCKP");
+        fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BLearnRate");
+        fstream << totalSamplesSeen << learnRatePerSample << prevCriterion;
+        fstream.PutMarker(FileMarker::fileMarkerEndSection, L"ELearnRate");
+
+        fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BMinibatchSize");
+        fstream << minibatchSize;
+        fstream.PutMarker(FileMarker::fileMarkerEndSection, L"EMinibatchSize");
+
+        fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BParameterUpdates");
+        fstream << numParameterUpdates;
+        fstream.PutMarker(FileMarker::fileMarkerEndSection, L"EParameterUpdates");
+
+        // only in mid-epoch checkpoints
+        if (epochProgress)
+        {
+            fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BEpochProgress");
+            fstream << epochProgress->m_epoch << epochProgress->m_numMBsRun << epochProgress->m_epochSamples << epochProgress->m_epochCriterion;
+            fstream << epochProgress->m_epochEvalErrors.size();
+            for (const auto& evalError : epochProgress->m_epochEvalErrors)
+                fstream << evalError;
+            fstream << epochProgress->m_samplesSinceLastModelSync << epochProgress->m_lossScale << epochProgress->m_numMBsSinceLossScaleChange << epochProgress->m_modelSlot;
+            fstream.PutMarker(FileMarker::fileMarkerEndSection, L"EEpochProgress");
+        }
+
+        fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BGradient");
 
+        for (auto smoothedGradientIter = smoothedGradients.begin(); smoothedGradientIter != smoothedGradients.end(); smoothedGradientIter++)
         {
-            File fstream(tempFileName, FileOptions::fileOptionsBinary | FileOptions::fileOptionsWrite);
-            fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BVersion"); 
-            fstream << (size_t)CURRENT_CNTK_CHECKPOINT_VERSION; 
-            fstream.PutMarker(FileMarker::fileMarkerEndSection, L"EVersion");
+            const Matrix<ElemType>& smoothedGradient = *smoothedGradientIter;
+            fstream << smoothedGradient;
+        }
+
+        fstream.PutMarker(FileMarker::fileMarkerEndSection, L"EGradient");
+
+        fstream.PutMarker(FileMarker::fileMarkerEndSection, L"ECKP");
+
+        // Ensuring that data is written
+        if (syncToDisk)
+            fstream.Sync();
+        else
+            fstream.Flush();
+    }
 
-            fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BCKP");
-            fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BLearnRate");
-            fstream << totalSamplesSeen << learnRatePerSample << prevCriterion;
-            fstream.PutMarker(FileMarker::fileMarkerEndSection, L"ELearnRate");
+    renameOrDie(tempFileName, checkPointFileName);
+}
 
-            fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BMinibatchSize");
-            fstream << minibatchSize;
-            fstream.PutMarker(FileMarker::fileMarkerEndSection, L"EMinibatchSize");
+// In the background mode, the model and the learner state are copied into a host replica of the model, which a
+// background thread then writes and syncs to the disk, while the training continues. The replicas are created by
+// reloading the first checkpoint, which is written synchronously, one per pending checkpoint (m_maxPendingCheckpoints).
+// When all are pending, this waits for the oldest. A replica that no longer matches the network is recreated.
+template <class ElemType>
+void SGD<ElemType>::SaveCheckpoint(ComputationNetworkPtr net, const size_t epoch, const size_t totalSamplesSeen,
+                                   const double learnRatePerSample,
+                                   const std::list<Matrix<ElemType>>& smoothedGradients,
+                                   const double prevCriterion,
+                                   const size_t minibatchSize,
+                                   const size_t epochsSinceLastLearnRateAdjust)
+{
+    auto modelName = GetModelNameForEpoch(int(epoch));
+    bool inBackground = m_maxPendingCheckpoints > 0 && CanCheckpointInBackground();
 
-            fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BGradient");
+    shared_ptr<CheckpointReplica> replica;
+    if (inBackground && m_nextCheckpointReplica < m_checkpointReplicas.size())
+    {
+        replica = m_checkpointReplicas[m_nextCheckpointReplica];
+        if (replica->m_write.valid())
+            replica->m_write.get(); // (rethrows an error of the background write)
+        replica->m_write = std::shared_future<void>();
+        if (!UpdateCheckpointReplica(net, *replica, smoothedGradients))
+        {
+            fprintf(stderr, "SGD: The network has changed, recreating the host copies of the model for the background checkpoints.\n");
+            WaitForPendingCheckpoints();
+            m_checkpointReplicas.resize(m_nextCheckpointReplica = 0);
+            replica = nullptr;
+        }
+    }
 
-            for (auto smoothedGradientIter = smoothedGradients.begin(); smoothedGradientIter != smoothedGradients.end(); smoothedGradientIter++)
+    if (!replica)
+    {
+        // synchronously
+        WaitForPendingCheckpoints();
+        SaveCheckPointInfo(epoch, totalSamplesSeen, learnRatePerSample, smoothedGradients, prevCriterion, minibatchSize);
+        fprintf(stderr, "SGD: Saving checkpoint model '%ls'\n", modelName.c_str());
+        net->Save(modelName, GetCheckpointFileFormat(epoch, /*midEpoch=*/false));
+        DeletePreviousCheckPointFiles(epoch, epochsSinceLastLearnRateAdjust);
+
+        if (inBackground)
+        {
+            fprintf(stderr, "SGD: Creating %d host copies of the model for the background checkpoints\n", (int) m_maxPendingCheckpoints);
+            for (size_t k = 0; k < m_maxPendingCheckpoints; k++)
             {
-                const Matrix<ElemType>& smoothedGradient = *smoothedGradientIter;
-                fstream << smoothedGradient;
+                replica = make_shared<CheckpointReplica>();
+                replica->m_net = ComputationNetwork::CreateFromFile<ElemType>(CPUDEVICE, modelName);
+                replica->m_net->SetSaveCompiledPlan(m_saveCompiledPlan);
+                replica->m_net->SetSaveAlignedParameters(m_saveAlignedParameters);
+                for (size_t i = 0; i < smoothedGradients.size(); i++)
+                    replica->m_smoothedGradients.emplace_back(CPUDEVICE);
+                m_checkpointReplicas.push_back(replica);
             }
+            m_nextCheckpointReplica = 0;
+        }
+        return;
+    }
+
+    fprintf(stderr, "SGD: Saving checkpoint model '%ls' in the background\n", modelName.c_str());
+    auto checkPointFileName = GetCheckPointFileNameForEpoch(int(epoch));
+    auto numParameterUpdates = m_numParameterUpdates;
+    auto fileFormat = GetCheckpointFileFormat(epoch, /*midEpoch=*/false);
+    auto previousWrite = m_lastCheckpointWrite;
+    CheckpointReplica* replicap = replica.get(); // (not the shared_ptr, the future would keep itself alive)
+    replica->m_write = std::async(std::launch::async, [=]()
+    {
+        if (previousWrite.valid())
+            previousWrite.wait(); // an error of it is reported by its own future
+        WriteCheckPointFile(checkPointFileName, totalSamplesSeen, learnRatePerSample, replicap->m_smoothedGradients,
+                            prevCriterion, minibatchSize, numParameterUpdates, /*syncToDisk=*/true);
+        replicap->m_net->Save(modelName, fileFormat, /*syncToDisk=*/true);
+        DeletePreviousCheckPointFiles(epoch, epochsSinceLastLearnRateAdjust);
+    }).share();
+    m_lastCheckpointWrite = replica->m_write;
+    m_nextCheckpointReplica = (m_nextCheckpointReplica + 1) % m_maxPendingCheckpoints;
+}
 
-            fstream.PutMarker(FileMarker::fileMarkerEndSection, L"EGradient");
+// copy the parameters into the replica; returns false if the replica does not match the network
+// Besides the parameters, the values of precomputed nodes and the state of batch normalization are copied, which
+// is the state that changes in training. The copies are synchronous, once this returns the training may continue.
+template <class ElemType>
+bool SGD<ElemType>::UpdateCheckpointReplica(ComputationNetworkPtr net, CheckpointReplica& replica, const std::list<Matrix<ElemType>>& smoothedGradients)
+{
+    if (replica.m_smoothedGradients.size() != smoothedGradients.size() || !UpdateModelReplica(net, replica.m_net))
+        return false;
 
-            fstream.PutMarker(FileMarker::fileMarkerEndSection, L"ECKP");
+    auto smoothedGradientIter = smoothedGradients.begin();
+    for (auto& smoothedGradient : replica.m_smoothedGradients)
+        smoothedGradient.SetValueFromOtherDevice(*smoothedGradientIter++);
+    return true;
+}
 
-            // Ensuring that data is written
-            fstream.Flush();
+// copy the state of the model that changes in training into a replica on any device; returns false if it does not match
+template <class ElemType>
+bool SGD<ElemType>::UpdateModelReplica(ComputationNetworkPtr net, ComputationNetworkPtr replicaNet)
+{
+    if (replicaNet->GetTotalNumberOfNodes() != net->GetTotalNumberOfNodes())
+        return false;
+    for (const auto& node : replicaNet->GetAllNodes())
+    {
+        if (!net->NodeNameExists(node->NodeName()))
+            return false;
+        auto liveNode = net->GetNodeFromName(node->NodeName());
+        if (liveNode->OperationName() != node->OperationName() || liveNode->GetSampleLayout() != node->GetSampleLayout())
+            return false;
+
+        if (node->OperationName() == OperationNameOf(LearnableParameter) || node->RequiresPreCompute())
+            node->template As<ComputationNode<ElemType>>()->Value().SetValueFromOtherDevice(liveNode->template As<ComputationNode<ElemType>>()->Value());
+        else if (node->OperationName() == OperationNameOf(BatchNormalizationNode))
+        {
+            auto bnNode = node->template As<BatchNormalizationNode<ElemType>>();
+            auto liveBNNode = liveNode->template As<BatchNormalizationNode<ElemType>>();
+            bnNode->SetMBCount(liveBNNode->GetMBCount());
+            bnNode->SetEvalMode(liveBNNode->IsEvalMode());
+        }
+    }
+    return true;
+}
+
+// The validation replica is created once, by loading the model that the epoch started from (which has the structure
+// of the network) onto m_asyncValidationDeviceId. For each epoch, the state of the network is copied into it
+// synchronously, and then it is validated on a background thread, without MPI, while the next epoch trains.
+template <class ElemType>
+void SGD<ElemType>::StartAsyncValidation(ComputationNetworkPtr net, int epoch, IDataReader* validationSetDataReader,
+                                         const std::vector<std::wstring>& cvNodeNames, size_t mbSize)
+{
+    if (m_validationReplica && !UpdateModelReplica(net, m_validationReplica->m_net))
+    {
+        fprintf(stderr, "SGD: The network has changed, recreating the copy of the model for the validation in the background.\n");
+        m_validationReplica.reset();
+    }
+
+    if (!m_validationReplica)
+    {
+        auto modelName = GetModelNameForEpoch(epoch - 1);
+        fprintf(stderr, "SGD: Creating a copy of the model on device %d for the validation in the background, from '%ls'\n", m_asyncValidationDeviceId, modelName.c_str());
+        WaitForPendingCheckpoints();
+        m_validationReplica.reset(new ValidationReplica());
+        m_validationReplica->m_net = ComputationNetwork::CreateFromFile<ElemType>(m_asyncValidationDeviceId, modelName);
+        if (!UpdateModelReplica(net, m_validationReplica->m_net))
+            LogicError("StartAsyncValidation: The model '%ls' does not match the network that is trained.", modelName.c_str());
+    }
+
+    auto replicaNet = m_validationReplica->m_net;
+    m_validationReplica->m_epoch = epoch;
+    m_validationReplica->m_scores = std::async(std::launch::async, [=]()
+    {
+        // (progress is not shown, it would be mixed into the training progress)
+        SimpleEvaluator<ElemType> evaluator(replicaNet, /*parallelRun=*/false, /*numMBsToShowResult=*/SIZE_MAX);
+        return evaluator.Evaluate(validationSetDataReader, cvNodeNames, mbSize);
+    });
+}
+
+template <class ElemType>
+bool SGD<ElemType>::WaitForAsyncValidation(/*out*/ std::vector<double>& scores, /*out*/ int& epoch)
+{
+    if (!m_validationReplica || !m_validationReplica->m_scores.valid())
+        return false;
+    scores = m_validationReplica->m_scores.get(); // (rethrows an error of the validation)
+    epoch = m_validationReplica->m_epoch;
+    return true;
+}
+
+template <class ElemType>
+void SGD<ElemType>::DeletePreviousCheckPointFiles(const size_t epoch, const size_t epochsSinceLastLearnRateAdjust)
+{
+    // the epoch is complete
+    if (m_numMBsToCheckpoint > 0 || m_minutesToCheckpoint > 0)
+        DeleteMidEpochCheckpoint(epoch);
+
+    if (m_keepCheckPointFiles)
+        return;
+
+    // delete previous checkpoint file to save space
+    if (m_autoLearnRateSearchType == LearningRateSearchAlgorithm::AdjustAfterEpoch && m_loadBestModel)
+    {
+        if (epochsSinceLastLearnRateAdjust != 1)
+        {
+            _wunlink(GetCheckPointFileNameForEpoch(int(epoch) - 1).c_str());
+        }
+        if (epochsSinceLastLearnRateAdjust == m_learnRateAdjustInterval)
+        {
+            _wunlink(GetCheckPointFileNameForEpoch(int(epoch - m_learnRateAdjustInterval)).c_str());
         }
+    }
+    else
+    {
+        _wunlink(GetCheckPointFileNameForEpoch(int(epoch) - 1).c_str());
+    }
+}
+
+// The main node waits for its background writes before it reads the files itself. Other ranks read them only in
+// the learning-rate and minibatch-size searches, and for loading the best model; these need synchronous checkpoints.
+template <class ElemType>
+bool SGD<ElemType>::CanCheckpointInBackground() const
+{
+    bool othersReadCheckpoints = m_autoLearnRateSearchType != LearningRateSearchAlgorithm::None || m_autoAdjustMinibatch;
+    bool hasOtherRanks = (g_mpi != nullptr && g_mpi->NumNodesInUse() > 1) || m_elasticMembership;
+    return !(othersReadCheckpoints && hasOtherRanks);
+}
+
+// With halfPrecisionCheckpoints, the matrices of the checkpoint models are rounded to half precision, which halves their size;
+// a training that resumes from such a model continues with the rounded parameters. The learner state in the .ckp files stays
+// exact, since accumulated squares of small gradients would underflow. The models of every fullPrecisionCheckpointInterval
+// epochs, and the model of the last epoch, are kept exact.
+template <class ElemType>
+FileOptions SGD<ElemType>::GetCheckpointFileFormat(const size_t epoch, bool midEpoch) const
+{
+    bool fullPrecision = !m_halfPrecisionCheckpoints ||
+                         (!midEpoch && (epoch + 1 == m_maxEpochs || (m_fullPrecisionCheckpointInterval > 0 && (epoch + 1) % m_fullPrecisionCheckpointInterval == 0)));
+    return (FileOptions) (FileOptions::fileOptionsBinary | (fullPrecision ? 0 : FileOptions::fileOptionsHalfMatrices));
+}
 
-        renameOrDie(tempFileName, checkPointFileName);
+template <class ElemType>
+void SGD<ElemType>::WaitForPendingCheckpoints()
+{
+    m_lastCheckpointWrite = std::shared_future<void>();
+    for (auto& replica : m_checkpointReplicas)
+    {
+        if (replica->m_write.valid())
+        {
+            auto write = replica->m_write;
+            replica->m_write = std::shared_future<void>();
+            write.get(); // (rethrows an error of the background write)
+        }
     }
 }
 
@@ -2053,15 +3857,66 @@ bool SGD<ElemType>::LoadCheckPointInfo(const size_t epochNumber,
                                        /*out*/ double& learnRatePerSample,
                                        std::list<Matrix<ElemType>>& smoothedGradients,
                                        /*out*/ double& prevCriterion,
-                                       /*out*/ size_t& minibatchSize)
+                                       /*out*/ size_t& minibatchSize,
+                                       bool fromMainNode)
 {
-    wstring checkPointFileName = GetCheckPointFileNameForEpoch(int(epochNumber));
-    if (!fexists(checkPointFileName.c_str()))
+    // with the startup broadcast, the other ranks receive what the main node reads
+    bool isBroadcast = fromMainNode && UseStartupBroadcast();
+    int found = 0;
+    if (!isBroadcast || g_mpi->IsMainNode())
     {
-        fprintf(stderr, "Warning: checkpoint file is missing. learning parameters will be initialized from 0\n");
-        return false;
+        WaitForPendingCheckpoints();
+
+        wstring checkPointFileName = GetCheckPointFileNameForEpoch(int(epochNumber));
+        found = ReadCheckPointFile(checkPointFileName, epochNumber, totalSamplesSeen, learnRatePerSample, smoothedGradients, prevCriterion, minibatchSize) ? 1 : 0;
+        if (!found)
+            fprintf(stderr, "Warning: checkpoint file is missing. learning parameters will be initialized from 0\n");
+    }
+
+    if (isBroadcast)
+    {
+        g_mpi->Bcast(&found, 1, g_mpi->MainNodeRank());
+        if (!found)
+            return false;
+
+        size_t counts[3] = {totalSamplesSeen, minibatchSize, m_numParameterUpdates};
+        double values[2] = {learnRatePerSample, prevCriterion};
+        g_mpi->Bcast(counts, 3, g_mpi->MainNodeRank());
+        g_mpi->Bcast(values, 2, g_mpi->MainNodeRank());
+        totalSamplesSeen = counts[0];
+        minibatchSize = counts[1];
+        m_numParameterUpdates = counts[2];
+        learnRatePerSample = values[0];
+        prevCriterion = values[1];
+        size_t k = 0;
+        for (auto& smoothedGradient : smoothedGradients)
+        {
+            // a sharded smoothed gradient only goes to its owner
+            if (m_optimizerStateOwners.empty())
+                BroadcastMatrix(smoothedGradient);
+            else if (m_optimizerStateOwners[k] != (int) g_mpi->MainNodeRank())
+                TransferMatrix(smoothedGradient, g_mpi->MainNodeRank(), m_optimizerStateOwners[k]);
+            k++;
+        }
     }
 
+    ReleaseUnownedOptimizerState(smoothedGradients);
+    return found != 0;
+}
+
+// returns false if the file does not exist; a mid-epoch checkpoint is read with an epochProgress to fill in
+template <class ElemType>
+bool SGD<ElemType>::ReadCheckPointFile(const wstring& checkPointFileName, const size_t epochNumber,
+                                       /*out*/ size_t& totalSamplesSeen,
+                                       /*out*/ double& learnRatePerSample,
+                                       std::list<Matrix<ElemType>>& smoothedGradients,
+                                       /*out*/ double& prevCriterion,
+                                       /*out*/ size_t& minibatchSize,
+                                       /*out*/ EpochProgress* epochProgress)
+{
+    if (!fexists(checkPointFileName.c_str()))
+        return false;
+
     File fstream(checkPointFileName,
                  FileOptions::fileOptionsBinary | FileOptions::fileOptionsRead);
 
@@ -2090,6 +3945,36 @@ bool SGD<ElemType>::LoadCheckPointInfo(const size_t epochNumber,
         minibatchSize = m_mbSize[epochNumber];
     }
 
+    // the bias correction of Adam and LAMB restarts with older checkpoints
+    m_numParameterUpdates = 0;
+    if (ckpVersion >= CNTK_CHECKPOINT_VERSION_3)
+    {
+        fstream.GetMarker(FileMarker::fileMarkerBeginSection, L"BParameterUpdates");
+        fstream >> m_numParameterUpdates;
+        fstream.GetMarker(FileMarker::fileMarkerEndSection, L"EParameterUpdates");
+    }
+
+    if (fstream.TryGetMarker(FileMarker::fileMarkerBeginSection, L"BEpochProgress"))
+    {
+        EpochProgress progress;
+        size_t numEvalErrors;
+        fstream >> progress.m_epoch >> progress.m_numMBsRun >> progress.m_epochSamples >> progress.m_epochCriterion;
+        fstream >> numEvalErrors;
+        progress.m_epochEvalErrors.resize(numEvalErrors);
+        for (auto& evalError : progress.m_epochEvalErrors)
+            fstream >> evalError;
+        fstream >> progress.m_samplesSinceLastModelSync >> progress.m_lossScale >> progress.m_numMBsSinceLossScaleChange >> progress.m_modelSlot;
+        fstream.GetMarker(FileMarker::fileMarkerEndSection, L"EEpochProgress");
+        progress.m_learnRatePerSample = learnRatePerSample;
+        progress.m_minibatchSize = minibatchSize;
+        if (epochProgress)
+            *epochProgress = progress;
+    }
+    else if (epochProgress)
+    {
+        RuntimeError("'%ls' is not a mid-epoch checkpoint file.", checkPointFileName.c_str());
+    }
+
     fstream.GetMarker(FileMarker::fileMarkerBeginSection, L"BGradient");
 
     for (auto smoothedGradientIter = smoothedGradients.begin(); smoothedGradientIter != smoothedGradients.end(); smoothedGradientIter++)
@@ -2104,6 +3989,70 @@ bool SGD<ElemType>::LoadCheckPointInfo(const size_t epochNumber,
     return true;
 }
 
+// The model is written before the checkpoint file that refers to it. It goes to the other of the two model
+// files of the epoch, so that a crash while writing leaves the last complete pair of files.
+// The criterion of the previous epoch is not written, the restart keeps the one of the end-of-epoch checkpoint.
+template <class ElemType>
+void SGD<ElemType>::SaveMidEpochCheckpoint(ComputationNetworkPtr net, const size_t totalSamplesSeen,
+                                           const std::list<Matrix<ElemType>>& smoothedGradients, EpochProgress& epochProgress)
+{
+    epochProgress.m_modelSlot = 1 - epochProgress.m_modelSlot;
+    auto modelName = GetMidEpochModelName(epochProgress.m_epoch, epochProgress.m_modelSlot);
+    fprintf(stderr, "SGD: Saving mid-epoch checkpoint model '%ls' after minibatch %d of epoch %d\n",
+            modelName.c_str(), (int) epochProgress.m_numMBsRun, (int) epochProgress.m_epoch + 1);
+    auto fileFormat = GetCheckpointFileFormat(epochProgress.m_epoch, /*midEpoch=*/true);
+    net->Save(modelName, fileFormat, /*syncToDisk=*/true);
+    WriteCheckPointFile(GetMidEpochCheckPointFileName(epochProgress.m_epoch), totalSamplesSeen, epochProgress.m_learnRatePerSample, smoothedGradients,
+                        /*prevCriterion=*/0, epochProgress.m_minibatchSize, m_numParameterUpdates, /*syncToDisk=*/true, &epochProgress);
+}
+
+// returns false if there is no mid-epoch checkpoint of the epoch; otherwise TrainOneEpoch() resumes from it
+template <class ElemType>
+bool SGD<ElemType>::LoadMidEpochCheckpoint(ComputationNetworkPtr net, const size_t epoch, /*out*/ size_t& totalSamplesSeen,
+                                           std::list<Matrix<ElemType>>& smoothedGradients)
+{
+    WaitForPendingCheckpoints();
+
+    unique_ptr<EpochProgress> epochProgress(new EpochProgress());
+    double prevCriterion; // not written
+    wstring checkPointFileName = GetMidEpochCheckPointFileName(epoch);
+    if (!ReadCheckPointFile(checkPointFileName, epoch, totalSamplesSeen, epochProgress->m_learnRatePerSample, smoothedGradients, prevCriterion,
+                            epochProgress->m_minibatchSize, epochProgress.get()))
+        return false;
+    ReleaseUnownedOptimizerState(smoothedGradients);
+    if (epochProgress->m_epoch != epoch)
+        RuntimeError("The mid-epoch checkpoint file '%ls' is of epoch %d, not %d.", checkPointFileName.c_str(), (int) epochProgress->m_epoch + 1, (int) epoch + 1);
+
+    auto modelName = GetMidEpochModelName(epoch, epochProgress->m_modelSlot);
+    fprintf(stderr, "Resuming epoch %d after minibatch %d, from the mid-epoch checkpoint model '%ls'.\n",
+            (int) epoch + 1, (int) epochProgress->m_numMBsRun, modelName.c_str());
+    net->RereadPersistableParameters<ElemType>(modelName);
+    m_lossScale = epochProgress->m_lossScale;
+    m_numMBsSinceLossScaleChange = epochProgress->m_numMBsSinceLossScaleChange;
+    m_resumeEpochProgress = std::move(epochProgress);
+    return true;
+}
+
+template <class ElemType>
+void SGD<ElemType>::DeleteMidEpochCheckpoint(const size_t epoch)
+{
+    _wunlink(GetMidEpochCheckPointFileName(epoch).c_str());
+    _wunlink(GetMidEpochModelName(epoch, 0).c_str());
+    _wunlink(GetMidEpochModelName(epoch, 1).c_str());
+}
+
+template <class ElemType>
+wstring SGD<ElemType>::GetMidEpochCheckPointFileName(const size_t epoch)
+{
+    return GetModelNameForEpoch(int(epoch)) + L".mid.ckp";
+}
+
+template <class ElemType>
+wstring SGD<ElemType>::GetMidEpochModelName(const size_t epoch, const size_t modelSlot)
+{
+    return GetModelNameForEpoch(int(epoch)) + msra::strfun::wstrprintf(L".mid%d", (int) modelSlot);
+}
+
 template <class ElemType>
 wstring SGD<ElemType>::GetCheckPointFileNameForEpoch(const int epoch)
 {
@@ -2188,7 +4137,7 @@ bool SGD<ElemType>::GradientCheck(ComputationNetworkPtr net,
             fprintf(stderr, "\n###### d%ls######\n", node->NodeName().c_str());
 
             double eOrg = node->Value()(irow, icol);
-            node->Value().TransferToDeviceIfNotThere(net->GetDeviceId(), true);
+            node->Value().TransferToDeviceIfNotThere(node->GetDeviceId(), true);
 
             node->BumpEvalTimeStamp();
 
@@ -2205,13 +4154,13 @@ bool SGD<ElemType>::GradientCheck(ComputationNetworkPtr net,
             // TODO: why is this value not used?
             criterionNodes[npos]->Get00Element();
             double eGradErr = node->Gradient()(irow, icol);
-            node->Gradient().TransferToDeviceIfNotThere(net->GetDeviceId(), true);
+            node->Gradient().TransferToDeviceIfNotThere(node->GetDeviceId(), true);
 
             double ePos = eOrg + EPSILON;
             double eNeg = eOrg - EPSILON;
 
             node->Value()(irow, icol) = (ElemType) ePos;
-            node->Value().TransferToDeviceIfNotThere(net->GetDeviceId(), true);
+            node->Value().TransferToDeviceIfNotThere(node->GetDeviceId(), true);
 
             node->BumpEvalTimeStamp();
             net->ForwardProp(criterionNodes[npos]);
@@ -2220,7 +4169,7 @@ bool SGD<ElemType>::GradientCheck(ComputationNetworkPtr net,
             double mbEvalCriPos = criterionNodes[npos]->Get00Element(); // TODO: make Get00Element() a function of ComputationNodeBase
 
             node->Value()(irow, icol) = (ElemType) eNeg;
-            node->Value().TransferToDeviceIfNotThere(net->GetDeviceId(), true);
+            node->Value().TransferToDeviceIfNotThere(node->GetDeviceId(), true);
 
             node->BumpEvalTimeStamp();
             net->ForwardProp(criterionNodes[npos]);
@@ -2230,7 +4179,7 @@ bool SGD<ElemType>::GradientCheck(ComputationNetworkPtr net,
 
             // back to its original parameter value
             node->Value()(irow, icol) = (ElemType) eOrg;
-            node->Value().TransferToDeviceIfNotThere(net->GetDeviceId(), true);
+            node->Value().TransferToDeviceIfNotThere(node->GetDeviceId(), true);
 
             // check if they are consistent
             double eGradNum = ((mbEvalCriPos - mbEvalCriNeg) / (ePos - eNeg));
@@ -2276,9 +4225,12 @@ static GradientsUpdateType ParseGradUpdateType(const wstring& s)
     else if (EqualCI(s, L"adagrad"))                 return GradientsUpdateType::AdaGrad;
     else if (EqualCI(s, L"rmsProp"))                 return GradientsUpdateType::RmsProp;
     else if (EqualCI(s, L"fsAdagrad"))               return GradientsUpdateType::FSAdaGrad;
+    else if (EqualCI(s, L"adam"))                    return GradientsUpdateType::Adam;
+    else if (EqualCI(s, L"lars"))                    return GradientsUpdateType::LARS;
+    else if (EqualCI(s, L"lamb"))                    return GradientsUpdateType::LAMB;
     // legacy, deprecated
     else if (EqualCI(s, L"normal") || EqualCI(s, L"simple")) return GradientsUpdateType::None;
-    else InvalidArgument("ParseGradUpdateType: Invalid Gradient Updating Type. Valid values are (none | adagrad | rmsProp | fsAdagrad )");
+    else InvalidArgument("ParseGradUpdateType: Invalid Gradient Updating Type. Valid values are (none | adagrad | rmsProp | fsAdagrad | adam | lars | lamb)");
 }
 
 static ParallelizationMethod ParseParallelizationMethod(const wstring& s)
@@ -2286,7 +4238,32 @@ static ParallelizationMethod ParseParallelizationMethod(const wstring& s)
     if      (EqualCI(s, L"") || EqualCI(s, L"none")) return ParallelizationMethod::None;
     else if (EqualCI(s, L"DataParallelSGD"))         return ParallelizationMethod::DataParallelSGD;
     else if (EqualCI(s, L"ModelAveragingSGD"))       return ParallelizationMethod::ModelAveragingSGD;
-    else InvalidArgument("ParseParallelizationMethod: Invalid Parallelization Method. Valid values are (none | dataParallelSGD | modelAveragingSGD)");
+    else if (EqualCI(s, L"DataParallelASGD"))        return ParallelizationMethod::DataParallelASGD;
+    else InvalidArgument("ParseParallelizationMethod: Invalid Parallelization Method. Valid values are (none | dataParallelSGD | modelAveragingSGD | dataParallelASGD)");
+}
+
+static GradientTransport ParseGradientTransport(const wstring& s)
+{
+    if      (EqualCI(s, L"") || EqualCI(s, L"host")) return GradientTransport::Host;
+    else if (EqualCI(s, L"cudaAwareMPI"))            return GradientTransport::CudaAwareMPI;
+    else InvalidArgument("ParseGradientTransport: Invalid Gradient Transport. Valid values are (host | cudaAwareMPI)");
+}
+
+static GradientCompressionType ParseGradientCompression(const wstring& s)
+{
+    if      (EqualCI(s, L"") || EqualCI(s, L"none")) return GradientCompressionType::None;
+    else if (EqualCI(s, L"quantization"))            return GradientCompressionType::Quantization;
+    else if (EqualCI(s, L"topK"))                    return GradientCompressionType::TopK;
+    else if (EqualCI(s, L"float16"))                 return GradientCompressionType::Float16;
+    else InvalidArgument("ParseGradientCompression: Invalid Gradient Compression. Valid values are (none | quantization | topK | float16)");
+}
+
+static MemoryPlanSizing ParseMemoryPlanSizing(const wstring& s)
+{
+    if      (EqualCI(s, L"") || EqualCI(s, L"none")) return MemoryPlanSizing::None;
+    else if (EqualCI(s, L"subminibatches"))          return MemoryPlanSizing::Subminibatches;
+    else if (EqualCI(s, L"minibatch"))               return MemoryPlanSizing::Minibatch;
+    else InvalidArgument("ParseMemoryPlanSizing: Invalid memory plan sizing. Valid values are (none | subminibatches | minibatch)");
 }
 
 static LearningRateSearchAlgorithm ParseLearningRateSearchType(const wstring& s)
@@ -2333,6 +4310,7 @@ SGDParams::SGDParams(const ConfigRecordType& configSGD, size_t sizeofElemType)
 
     m_numPrevLearnRates = configAALR(L"numPrevLearnRates", (size_t) 5);
     m_numBestSearchEpoch = configAALR(L"numBestSearchEpoch", (size_t) 1);
+    m_searchInMemory = configAALR(L"searchInMemory", false);
     m_loadBestModel = configAALR(L"loadBestModel", true);
     m_useCVSetControlLRIfCVExists = configAALR(L"UseCVSetControlLRIfCVExists", true);
     m_useEvalCriterionControlLR = configAALR(L"UseEvalCriterionControlLR", false);
@@ -2344,6 +4322,13 @@ SGDParams::SGDParams(const ConfigRecordType& configSGD, size_t sizeofElemType)
     m_truncated = configSGD(L"truncated", false);
     m_maxSamplesInRAM = configSGD(L"maxSamplesInRAM", (size_t) SIZE_MAX);
     m_numSubminiBatches = configSGD(L"numSubminibatches", (size_t) 1);
+    m_accumulateSubminibatchesInPlace = configSGD(L"accumulateSubminibatchesInPlace", true);
+    m_memoryPlanSizing = ParseMemoryPlanSizing(configSGD(L"memoryPlanSizing", L"none"));
+    m_memoryPlanReserveMB = configSGD(L"memoryPlanReserveMB", (size_t) 512);
+    if (m_memoryPlanSizing != MemoryPlanSizing::None && m_numSubminiBatches > 1)
+        InvalidArgument("memoryPlanSizing cannot be combined with numSubminibatches!");
+    if (m_memoryPlanSizing == MemoryPlanSizing::Minibatch && m_autoAdjustMinibatch)
+        InvalidArgument("memoryPlanSizing=minibatch cannot be combined with autoAdjustMinibatch, use memoryPlanSizing=subminibatches!");
 
     // the number of samples in each epoch (0 means, use all the samples in each epoch).
     m_epochSize = configSGD(L"epochSize", (size_t) 0);
@@ -2366,14 +4351,54 @@ SGDParams::SGDParams(const ConfigRecordType& configSGD, size_t sizeofElemType)
     bool useNesterovMomentum = configSGD(L"useNAG", false);
 
     m_maxTempMemSizeInSamplesForCNN = configSGD(L"maxTempMemSizeInSamplesForCNN", (size_t) 0);
+    m_numComputeStreams = configSGD(L"numComputeStreams", (size_t) 1);
+    // gradient checkpointing: "auto", or the names of the nodes whose values are recomputed in backprop
+    m_recomputedNodes = configSGD(L"recomputeNodes", ConfigRecordType::Array(stringargvector()));
+    // host offload: the names of the nodes whose values are kept in host memory between forward prop and backprop,
+    // and whether the learner state of GPU parameters is kept there (see OptimizerStateOffload)
+    m_offloadedNodes = configSGD(L"offloadNodes", ConfigRecordType::Array(stringargvector()));
+    m_offloadOptimizerState = configSGD(L"offloadOptimizerState", false);
+    // replay the forward and backward passes from CUDA graphs for minibatches of the same shape
+    m_useComputeGraphs = configSGD(L"useComputeGraphs", false);
 
     m_traceLevel = configSGD(L"traceLevel", (int) 0);
     m_numMBsToShowResult = configSGD(L"numMBsToShowResult", (size_t) 10);
+    // with the training progress, the time spent in the reader and the counters of its pipeline stages
+    m_showReaderStatistics = configSGD(L"showReaderStatistics", true);
     m_numMBsToCUDAProfile = configSGD(L"numMBsToCUDAProfile", (size_t) 0);
+    // per-node time, allocations and estimated FLOPs, printed at the end of each epoch; optionally a Chrome trace
+    m_profileNodes = configSGD(L"profileNodes", false);
+    m_nodeProfileTraceFile = (const wstring&) configSGD(L"nodeProfileTraceFile", L"");
+    // GPU utilization, memory, PCIe throughput and clock throttling, sampled with NVML and printed per epoch
+    m_gpuTelemetry = configSGD(L"gpuTelemetry", false);
+    m_gpuTelemetryIntervalMs = configSGD(L"gpuTelemetryIntervalMs", (size_t) 1000);
+    m_gpuTelemetryFile = (const wstring&) configSGD(L"gpuTelemetryFile", L"");
+    // write the inferred node dimensions into the saved models, for a faster load for evaluation
+    m_saveCompiledPlan = configSGD(L"saveCompiledPlan", false);
+    // write the parameters of the saved models as aligned blocks, which evaluators can map into memory (see mapModelParameters)
+    m_saveAlignedParameters = configSGD(L"saveAlignedParameters", false);
+    // store the checkpoint models in half precision, except every fullPrecisionCheckpointInterval epochs (see GetCheckpointFileFormat())
+    m_halfPrecisionCheckpoints = configSGD(L"halfPrecisionCheckpoints", false);
+    m_fullPrecisionCheckpointInterval = configSGD(L"fullPrecisionCheckpointInterval", (size_t) 0);
+    // write the checkpoints on a background thread, from host copies of the model; the copies take host memory for this many models
+    m_maxPendingCheckpoints = configSGD(L"maxPendingCheckpoints", (size_t) 0);
+    m_numMBsToCheckpoint = configSGD(L"numMBsToCheckpoint", (size_t) 0);
+    m_minutesToCheckpoint = configSGD(L"minutesToCheckpoint", 0.0);
+    // validate on a copy of the model on another device while the next epoch trains; the learning rate control lags by one epoch
+    m_asyncValidation = configSGD(L"asyncValidation", false);
+    m_asyncValidationDeviceId = configSGD(L"asyncValidationDeviceId", (int) CPUDEVICE);
 
     m_gradientClippingWithTruncation = configSGD(L"gradientClippingWithTruncation", true);
+    // with fuseParameterUpdates, the global norm is computed and applied on the device, without waiting for it
+    m_gradientClippingWithGlobalNorm = configSGD(L"gradientClippingWithGlobalNorm", false);
     m_clippingThresholdPerSample = configSGD(L"clippingThresholdPerSample", numeric_limits<double>::infinity());
 
+    m_useLossScaling = configSGD(L"lossScaling", false);
+    m_initialLossScale = configSGD(L"initialLossScale", 65536.0);
+    m_lossScaleGrowthInterval = configSGD(L"lossScaleGrowthInterval", (size_t) 2000);
+    if (m_useLossScaling && (m_initialLossScale < 1 || m_lossScaleGrowthInterval == 0))
+        InvalidArgument("initialLossScale must be at least 1, and lossScaleGrowthInterval must be positive.");
+
     // sequence-training parameters
     m_hSmoothingWeight = configSGD(L"hSmoothingWeight", 0.95);
     m_frameDropThresh = configSGD(L"frameDropThresh", 1e-10);
@@ -2383,8 +4408,11 @@ SGDParams::SGDParams(const ConfigRecordType& configSGD, size_t sizeofElemType)
     m_seqGammarCalcLMF = configSGD(L"seqGammarLMF", 14.0);
     m_seqGammarCalcbMMIFactor = configSGD(L"seqGammarBMMIFactor", 0.0);
     m_seqGammarCalcWP = configSGD(L"seqGammarWordPen", 0.0);
+    m_seqLatticeCacheSizeMB = configSGD(L"seqLatticeCacheSizeMB", (size_t) 0);
+    m_seqLatticePruneBeam = configSGD(L"seqLatticePruneBeam", 0.0);
 
     m_dropoutRates = configSGD(L"dropoutRate", ConfigRecordType::Array(floatargvector(vector<float>{0.0f})));
+    m_dropoutCounterBasedRNG = configSGD(L"dropoutCounterBasedRNG", false);
 
     GradientsUpdateType gradUpdateType = ParseGradUpdateType(configSGD(L"gradUpdateType", L"None"));
     double gaussianNoiseInjecStd = configSGD(L"gaussianNoiseInjectStd", 0.0);
@@ -2398,10 +4426,31 @@ SGDParams::SGDParams(const ConfigRecordType& configSGD, size_t sizeofElemType)
     m_rpi.max = configSGD(L"rms_wgt_max", 10.0);
     m_rpi.gamma = configSGD(L"rms_gamma", 0.99);
 
+    // Adam, LARS, and LAMB parameters
+    m_adam.beta1 = configSGD(L"adamBeta1", 0.9);
+    m_adam.beta2 = configSGD(L"adamBeta2", 0.999);
+    m_adam.epsilon = configSGD(L"adamEpsilon", 1e-8);
+    m_adam.trustCoefficient = configSGD(L"larsTrustCoefficient", 0.001);
+
+    // one fused update of all dense parameters of momentum SGD and FSAdaGrad, instead of several operations per parameter
+    m_fuseParameterUpdates = configSGD(L"fuseParameterUpdates", false);
+    if (m_fuseParameterUpdates && m_offloadOptimizerState)
+        InvalidArgument("fuseParameterUpdates cannot be combined with offloadOptimizerState!");
+    // run the update of each parameter on a side stream as soon as its gradient is ready, the next minibatch only waits for it where it reads the parameter
+    m_pipelineParameterUpdates = configSGD(L"pipelineParameterUpdates", false);
+    // fine-tuning after ComputationNetwork::PruneParameters(): parameters that have weights of exactly 0 keep them at 0
+    m_maskPrunedWeights = configSGD(L"maskPrunedWeights", false);
+
     m_needAveMultiplier = configSGD(L"normWithAveMultiplier", true);
     m_L2RegWeight = configSGD(L"L2RegWeight", 0.0);
     m_L1RegWeight = configSGD(L"L1RegWeight", 0.0);
 
+    // updates of sparse gradients (e.g. of embeddings) proportional to the columns present, instead of the parameter size;
+    // the missed momentum and L2 decay of a column is applied when it is next present
+    m_lazySparseUpdate = configSGD(L"lazySparseUpdate", false);
+    if (m_lazySparseUpdate && (m_L1RegWeight > 0 || gaussianNoiseInjecStd > 0 || useNesterovMomentum))
+        InvalidArgument("lazySparseUpdate cannot be combined with L1RegWeight, gaussianNoiseInjectStd, or useNAG!");
+
     // for backward support. future setup should use gradUpdateType=AdaGrad, instead of
     // useAdagrad=true
     bool useAdagrad = configSGD(L"useAdagrad", false);
@@ -2424,6 +4473,10 @@ SGDParams::SGDParams(const ConfigRecordType& configSGD, size_t sizeofElemType)
     }
 
     m_useAllDataForPreComputedNode = configSGD(L"UseAllDataForPreComputedNode", true);
+    // with MPI, each rank precomputes over its share of the data; the pass may be limited to a subset, and cached
+    m_distributedPreCompute = configSGD(L"distributedPreCompute", true);
+    m_preComputeMaxSamples = configSGD(L"preComputeMaxSamples", (size_t) 0);
+    m_preComputeCacheFile = (const wstring&) configSGD(L"preComputeCacheFile", L"");
 
     // consistency checks
     for (size_t i = 0; i < m_mbSize.size(); i++)
@@ -2526,9 +4579,29 @@ SGDParams::SGDParams(const ConfigRecordType& configSGD, size_t sizeofElemType)
     m_numGradientBits = 32;
     m_zeroThresholdFor1Bit = true;
     m_bufferedAsyncGradientAggregation = false;
+    m_gradientBucketSizeInBytes = 0;
+    m_gradientTransport = GradientTransport::Host;
+    m_hierarchicalGradientAggregation = false;
+    m_gradientCompression = GradientCompressionType::None;
+    m_gradientCompressionTopKRatio = 0.01;
+    m_gradientCompressionMinElements = 0;
+    m_shardOptimizerState = false;
     m_enableDistributedMBReading = false;
     m_parallelizationStartEpochNum = 0;
     m_nFramesBetweenMASync = 40000; // default 40k frames
+    m_hierarchicalModelAggregation = false;
+    m_modelBucketSizeInBytes = 64 * 1024 * 1024;
+    m_modelTransport = GradientTransport::Host;
+    m_useBlockMomentum = false;
+    m_blockMomentum = -1.0;
+    m_blockLearningRate = 1.0;
+    m_useNesterovBlockMomentum = true;
+    m_resetSGDMomentum = true;
+    m_asyncModelAggregation = false;
+    m_maxStaleness = 4;
+    m_broadcastStartupState = true;
+    m_elasticMembership = false;
+    m_elasticSyncFrequencyInMBs = 0;
 
     if ((g_mpi != nullptr) && configSGD.Exists(L"ParallelTrain"))
     {
@@ -2537,6 +4610,7 @@ SGDParams::SGDParams(const ConfigRecordType& configSGD, size_t sizeofElemType)
         m_parallelizationStartEpochNum = configParallelTrain(L"parallelizationStartEpoch", (int) 1) - 1; // Epoch numbers internally are 0 based
         m_enableDistributedMBReading = configParallelTrain(L"distributedMBReading", false);
         m_syncStatsTrace = configParallelTrain(L"syncPerfStats", (int) 0);
+        m_broadcastStartupState = configParallelTrain(L"broadcastStartupState", true);
 
         if (configParallelTrain.Exists(L"DataParallelSGD"))
         {
@@ -2545,16 +4619,103 @@ SGDParams::SGDParams(const ConfigRecordType& configSGD, size_t sizeofElemType)
             m_numGradientBits = configDataParallelSGD(L"gradientBits", defaultGradientBits);
             m_zeroThresholdFor1Bit = configDataParallelSGD(L"useZeroThresholdFor1BitQuantization", true);
             m_bufferedAsyncGradientAggregation = configDataParallelSGD(L"useBufferedAsyncGradientAggregation", false);
+            m_gradientBucketSizeInBytes = configDataParallelSGD(L"gradientBucketSizeInBytes", (size_t) 0);
+            m_gradientTransport = ParseGradientTransport(configDataParallelSGD(L"gradientTransport", L"host"));
+            m_hierarchicalGradientAggregation = configDataParallelSGD(L"hierarchicalGradientAggregation", false);
+            m_shardOptimizerState = configDataParallelSGD(L"shardOptimizerState", false);
             if ((m_numGradientBits < 1) || (m_numGradientBits > (8 * sizeofElemType)))
             {
                 InvalidArgument("gradientBits must be in the range [1, 32] when using precision=float and in range [1, 64] when using precision=double!");
             }
+
+            // fewer gradientBits select the quantizing compressor by default
+            bool isQuantized = (m_numGradientBits != (8 * sizeofElemType));
+            m_gradientCompression = ParseGradientCompression(configDataParallelSGD(L"gradientCompression", wstring(isQuantized ? L"quantization" : L"none")));
+            m_gradientCompressionTopKRatio = configDataParallelSGD(L"gradientCompressionTopKRatio", 0.01);
+            m_gradientCompressionMinElements = configDataParallelSGD(L"gradientCompressionMinElements", (size_t) 0);
+#ifndef QUANTIZED_GRADIENT_AGGREGATION
+            if ((m_gradientCompression == GradientCompressionType::Quantization) && ((m_numGradientBits & (m_numGradientBits - 1)) != 0))
+            {
+                InvalidArgument("gradientBits must be a power of 2 for gradientCompression=quantization in CNTK binaries built without quantized gradient aggregation support!");
+            }
+#endif
+            if ((m_gradientCompressionTopKRatio <= 0) || (m_gradientCompressionTopKRatio > 1))
+            {
+                InvalidArgument("gradientCompressionTopKRatio must be in the range (0, 1]!");
+            }
+            if (m_shardOptimizerState)
+            {
+                if (m_bufferedAsyncGradientAggregation || m_hierarchicalGradientAggregation)
+                    InvalidArgument("shardOptimizerState cannot be combined with useBufferedAsyncGradientAggregation or hierarchicalGradientAggregation!");
+                if (m_useLossScaling || m_gradientClippingWithGlobalNorm || m_fuseParameterUpdates)
+                    InvalidArgument("shardOptimizerState cannot be combined with lossScaling, gradientClippingWithGlobalNorm or fuseParameterUpdates, which need all gradients on every rank!");
+                if (m_parallelizationStartEpochNum != 0)
+                    InvalidArgument("shardOptimizerState requires parallelizationStartEpoch=1!");
+#ifdef QUANTIZED_GRADIENT_AGGREGATION
+                InvalidArgument("shardOptimizerState is not supported with quantized gradient aggregation!");
+#endif
+            }
         }
 
         if (configParallelTrain.Exists(L"ModelAveragingSGD"))
         {
             const ConfigRecordType& configMASGD(configParallelTrain(L"ModelAveragingSGD", ConfigRecordType::Record()));
             m_nFramesBetweenMASync = configMASGD(L"syncFrequencyInFrames", (size_t) 40000);
+            m_hierarchicalModelAggregation = configMASGD(L"hierarchicalModelAggregation", false);
+            m_modelBucketSizeInBytes = configMASGD(L"modelBucketSizeInBytes", (size_t) (64 * 1024 * 1024));
+            m_modelTransport = ParseGradientTransport(configMASGD(L"modelTransport", L"host"));
+            m_useBlockMomentum = configMASGD(L"useBlockMomentum", false);
+            m_blockMomentum = configMASGD(L"blockMomentum", -1.0);
+            m_blockLearningRate = configMASGD(L"blockLearningRate", 1.0);
+            m_useNesterovBlockMomentum = configMASGD(L"useNesterovBlockMomentum", true);
+            m_resetSGDMomentum = configMASGD(L"resetSGDMomentum", true);
+            m_asyncModelAggregation = configMASGD(L"useAsyncModelAggregation", false);
+            if (m_useBlockMomentum && (m_blockMomentum >= 1.0))
+            {
+                InvalidArgument("blockMomentum must be less than 1!");
+            }
+        }
+
+        if (configParallelTrain.Exists(L"DataParallelASGD"))
+        {
+            const ConfigRecordType& configASGD(configParallelTrain(L"DataParallelASGD", ConfigRecordType::Record()));
+            m_nFramesBetweenMASync = configASGD(L"syncFrequencyInFrames", (size_t) 256);
+            m_maxStaleness = configASGD(L"maxStaleness", (size_t) 4);
+        }
+        else if (m_parallelizationMethod == ParallelizationMethod::DataParallelASGD)
+        {
+            m_nFramesBetweenMASync = 256;
+        }
+        if ((m_parallelizationMethod == ParallelizationMethod::DataParallelASGD) && (m_nFramesBetweenMASync == 0))
+        {
+            InvalidArgument("syncFrequencyInFrames must be positive for dataParallelASGD!");
+        }
+
+        m_elasticMembership = configParallelTrain(L"elasticMembership", false);
+        if (m_elasticMembership)
+        {
+            m_elasticPortFile = (const wstring&) configParallelTrain(L"elasticPortFile", L"");
+            m_elasticSyncFrequencyInMBs = configParallelTrain(L"elasticSyncFrequencyInMinibatches", (size_t) 0);
+            if (m_elasticPortFile.empty())
+            {
+                InvalidArgument("elasticPortFile must be specified for elasticMembership!");
+            }
+            if (m_parallelizationMethod == ParallelizationMethod::None)
+            {
+                InvalidArgument("elasticMembership requires a parallelizationMethod!");
+            }
+            if (m_shardOptimizerState)
+            {
+                InvalidArgument("elasticMembership cannot be combined with shardOptimizerState!");
+            }
+            if (m_bufferedAsyncGradientAggregation || m_asyncModelAggregation)
+            {
+                InvalidArgument("elasticMembership cannot be combined with useBufferedAsyncGradientAggregation or useAsyncModelAggregation!");
+            }
+            if (m_asyncValidation)
+            {
+                InvalidArgument("elasticMembership cannot be combined with asyncValidation!");
+            }
         }
     }
 }
@@ -16,14 +16,23 @@
 #include "Config.h"
 #include <chrono>
 #include <random>
+#include <future>
 #include "Profiler.h"
 #include "MASGD.h"
+#include "ParameterServerSGD.h"
+#include "GradientCompressor.h"
+#include "ElasticMembership.h"
+#include "ParameterUpdatePipeline.h"
+#include "OptimizerStateOffload.h"
+#include "TrainingBenchmark.h"
+#include "GPUWatcher.h"
 
 using namespace std; // ugh! TODO: get rid of this from .h files!!!
 
 #define CNTK_CHECKPOINT_VERSION_1 1     // 1 -> no version number 
 #define CNTK_CHECKPOINT_VERSION_2 2     
-#define CURRENT_CNTK_CHECKPOINT_VERSION CNTK_CHECKPOINT_VERSION_2
+#define CNTK_CHECKPOINT_VERSION_3 3     // 3 -> number of parameter updates (for Adam and LAMB)
+#define CURRENT_CNTK_CHECKPOINT_VERSION CNTK_CHECKPOINT_VERSION_3
 
 
 namespace Microsoft { namespace MSR { namespace CNTK {
@@ -46,7 +55,10 @@ enum class GradientsUpdateType : int
     None,
     AdaGrad,
     RmsProp,
-    FSAdaGrad
+    FSAdaGrad,
+    Adam,
+    LARS, // momentum SGD with a learning rate per parameter matrix, proportional to the norm of its weights over that of its gradient
+    LAMB  // Adam with the same per-matrix scaling of the update
 };
 
 // TODO: While currently combining these methods is not supported,
@@ -58,6 +70,22 @@ enum class ParallelizationMethod : int
     DataParallelSGD = 1,
     ModelAveragingSGD = (1 << 1),
     ModelParallelSGD = (1 << 2), // Currently unsupported
+    DataParallelASGD = (1 << 3), // asynchronous, with a parameter server
+};
+
+// Memory that data parallel SGD aggregates GPU gradients in
+enum class GradientTransport : int
+{
+    Host = 0,         // pinned host buffers
+    CudaAwareMPI = 1, // device buffers, handed to a CUDA-aware MPI
+};
+
+// What SGD derives from the memory plan of the network and the free GPU memory before training
+enum class MemoryPlanSizing : int
+{
+    None,
+    Subminibatches, // the largest sub-minibatch (maxSamplesInRAM) that fits; the minibatch sizes are as configured
+    Minibatch,      // in addition, the minibatch size is the largest that fits into one forward-backward pass
 };
 
 // configuration parameters associated with RMSProp learning algorithm
@@ -79,6 +107,23 @@ struct RMSPropInfo
     }
 };
 
+// configuration parameters of Adam, LARS and LAMB
+struct AdamInfo
+{
+    double beta1;
+    double beta2;
+    double epsilon;
+    double trustCoefficient; // LARS only
+
+    AdamInfo()
+    {
+        beta1 = 0.9;
+        beta2 = 0.999;
+        epsilon = 1e-8;
+        trustCoefficient = 0.001;
+    }
+};
+
 struct GradientUpdateInfo
 {
     GradientsUpdateType mType;
@@ -165,6 +210,12 @@ protected:
     // default is 1, which means no subminibatch is used
     // if m_maxTempMemSizeInSamples = SIZE_MAX (which means users do not specify the option) and m_numSubminiBatches > 1
     // we divide one minibatch to m_numSubminiBatches subMinibatches
+    bool m_accumulateSubminibatchesInPlace;
+    // if true, and the network has no stateful (recurrent) nodes or lattices, the backprop adds the gradients of the
+    // sub-minibatches in the parameters, instead of paging them and the node states in and out for each sub-minibatch;
+    // with bucketed gradient aggregation, the buckets are then all-reduced during the backprop of the last sub-minibatch
+    MemoryPlanSizing m_memoryPlanSizing;
+    size_t m_memoryPlanReserveMB; // GPU memory that the sizing leaves to what the plan does not know, e.g. the reader, convolution workspaces and fragmentation
 
     // the number of samples in each epoch (0 means, use all the samples in each epoch).
     size_t m_epochSize;
@@ -174,10 +225,20 @@ protected:
     size_t m_maxEpochs;
 
     bool m_gradientClippingWithTruncation;
+    bool m_gradientClippingWithGlobalNorm; // clip by the norm of all gradients together, instead of per parameter
     double m_clippingThresholdPerSample;
 
+    // dynamic loss scaling, for training with half-precision GEMMs
+    // The criterion gradient is multiplied by a loss scale, and the parameter gradients divided by it again
+    // before the update. On overflow, the update is skipped and the scale halved; it is doubled again after
+    // m_lossScaleGrowthInterval minibatches without overflow.
+    bool m_useLossScaling;
+    double m_initialLossScale;
+    size_t m_lossScaleGrowthInterval;
+
     intargvector m_numMiniBatch4LRSearch;
     size_t m_numBestSearchEpoch;
+    bool m_searchInMemory; // keep the minibatches and the start model of the LR and MB-size searches in memory, instead of rereading them for each trial
 
     LearningRateSearchAlgorithm m_autoLearnRateSearchType;
 
@@ -204,7 +265,13 @@ protected:
     size_t m_minibatchSizeTuningMax;
 
     floatargvector m_dropoutRates;
+    bool m_dropoutCounterBasedRNG; // regenerate the dropout masks in the kernels instead of storing them
     size_t m_maxTempMemSizeInSamplesForCNN;
+    size_t m_numComputeStreams;
+    std::vector<std::wstring> m_recomputedNodes;
+    std::vector<std::wstring> m_offloadedNodes;
+    bool m_offloadOptimizerState;
+    bool m_useComputeGraphs;
 
     int m_traceLevel;
 
@@ -214,9 +281,29 @@ protected:
 
     GradientUpdateInfo m_gradType;
     RMSPropInfo m_rpi;
+    AdamInfo m_adam;
+    bool m_fuseParameterUpdates; // update the dense parameters with a few multi-tensor passes, see UpdateWeightsFused()
+    bool m_pipelineParameterUpdates; // overlap the update of each parameter with the next forward prop, see ParameterUpdatePipeline
+    bool m_maskPrunedWeights;        // keep the weights that are 0 at the start of training at 0 (fine-tuning of pruned models)
+    bool m_lazySparseUpdate;         // momentum SGD and AdaGrad only touch the columns of sparse gradients, see Matrix::LazyNormalGrad()
 
     int m_numMBsToShowResult;
+    bool m_showReaderStatistics;
     int m_numMBsToCUDAProfile;
+    bool m_profileNodes;
+    bool m_saveCompiledPlan;
+    bool m_saveAlignedParameters;
+    bool m_halfPrecisionCheckpoints;          // if true, the models of the epochs store their dense matrices in half precision
+    size_t m_fullPrecisionCheckpointInterval; // ... except those of every this many epochs, if > 0; the final model is always in full precision
+    size_t m_maxPendingCheckpoints; // if > 0, the checkpoints are written on a background thread, from at most this many host copies of the model
+    size_t m_numMBsToCheckpoint;    // if > 0, a mid-epoch checkpoint is written every this many minibatches
+    double m_minutesToCheckpoint;   // if > 0, a mid-epoch checkpoint is written when this many minutes have passed since the last one
+    bool m_asyncValidation;           // validate each epoch in the background while the next one trains, see StartAsyncValidation()
+    int m_asyncValidationDeviceId;    // the device of the model copy that is validated, -1 for the CPU
+    std::wstring m_nodeProfileTraceFile;
+    bool m_gpuTelemetry;                // sample the GPU with NVML during training, see GPUWatcher
+    size_t m_gpuTelemetryIntervalMs;
+    std::wstring m_gpuTelemetryFile;    // if not empty, the per-epoch summaries are appended to it as JSON lines
 
     bool m_doGradientCheck;
     double m_gradientCheckSigDigit;
@@ -224,6 +311,10 @@ protected:
     bool m_doUnitTest;
 
     bool m_useAllDataForPreComputedNode;
+    bool m_distributedPreCompute;       // the MPI ranks split the data of the precomputation, and merge the statistics
+    size_t m_preComputeMaxSamples;      // if > 0, the precomputation reads at most this many samples
+    std::wstring m_preComputeCacheFile; // if not empty, the precomputed statistics are reused from this file, for the same reader configuration
+    std::wstring m_preComputeCacheKey;  // the reader configuration, see SetPreComputeCacheKey()
 
     // Parallel training
     ParallelizationMethod m_parallelizationMethod;
@@ -239,10 +330,40 @@ protected:
     // Data parallel SGD training parameters
     int m_numGradientBits;
     bool m_bufferedAsyncGradientAggregation;
+    size_t m_gradientBucketSizeInBytes; // 0: all-reduce each gradient separately, after the backprop
+    GradientTransport m_gradientTransport;
+    bool m_hierarchicalGradientAggregation; // reduce within each machine first
     bool m_zeroThresholdFor1Bit;
+    GradientCompressionType m_gradientCompression; // of the gradients exchanged by SimpleDistGradAggregator
+    double m_gradientCompressionTopKRatio;
+    size_t m_gradientCompressionMinElements; // smaller gradients are exchanged uncompressed
+    bool m_shardOptimizerState;              // see m_optimizerStateOwners
 
     // Parallel training related with MA
     size_t m_nFramesBetweenMASync;
+    bool m_hierarchicalModelAggregation; // reduce within each machine first
+    size_t m_modelBucketSizeInBytes;     // of the buffers the models are packed into, 0: one per device
+    GradientTransport m_modelTransport;
+
+    // Block momentum (BMUF) and async model aggregation, see BlockMomentumSGD
+    bool m_useBlockMomentum;
+    double m_blockMomentum; // < 0: 1 - 1 / #workers
+    double m_blockLearningRate;
+    bool m_useNesterovBlockMomentum;
+    bool m_resetSGDMomentum;
+    bool m_asyncModelAggregation;
+
+    // Asynchronous data parallel SGD with a parameter server, see ParameterServerSGD
+    size_t m_maxStaleness; // in syncs, every m_nFramesBetweenMASync samples
+
+    // With parallel training, the main node reads the model, the checkpoint and the precompute data, and broadcasts what it read.
+    // A model built from scratch is broadcast too, so that all ranks start out the same.
+    bool m_broadcastStartupState;
+
+    // Elastic membership of data-parallel training, see ElasticMembership
+    bool m_elasticMembership;
+    std::wstring m_elasticPortFile;
+    size_t m_elasticSyncFrequencyInMBs; // 0: nodes join and leave at epoch boundaries only
 
     bool m_needAveMultiplier;
     double m_L2RegWeight;
@@ -257,6 +378,8 @@ protected:
     double m_seqGammarCalcWP;
     double m_seqGammarCalcbMMIFactor;
     bool m_seqGammarCalcUsesMBR;
+    size_t m_seqLatticeCacheSizeMB; // GPU memory for keeping the lattices of sequence training across minibatches
+    double m_seqLatticePruneBeam;   // log-posterior beam for pruning the lattices after their first forward-backward; 0: no pruning
 };
 
 template <class ElemType>
@@ -287,9 +410,15 @@ public:
           m_trainCriterionNodeName((const wstring&) configSGD(L"trainCriterionNodeName", L"")),
           m_evalCriterionNodeName((const wstring&) configSGD(L"evalCriterionNodeName", L"")),
           m_prevChosenMinibatchSize(0),
+          m_memoryPlanMinibatchSize(0),
           m_lastFinishedEpochTrainLoss(0.0),
+          m_lossScale(m_initialLossScale),
+          m_numMBsSinceLossScaleChange(0),
+          m_numParameterUpdates(0),
           m_distGradAgg(nullptr),
-          m_gradHeader(nullptr)
+          m_gradHeader(nullptr),
+          m_nextCheckpointReplica(0),
+          m_benchmark(nullptr)
     {
         msra::files::make_intermediate_dirs(m_modelPath);
     }
@@ -309,6 +438,15 @@ public:
                IDataReader* trainSetDataReader,
                IDataReader* validationSetDataReader,
                const DEVICEID_TYPE deviceID, const bool makeMode = true);
+    // the reader configuration as text; the statistics of the precomputation are cached for it (preComputeCacheFile)
+    void SetPreComputeCacheKey(const std::wstring& readerConfig)
+    {
+        m_preComputeCacheKey = readerConfig;
+    }
+    // trains a new network until 'benchmark' has measured its minibatches, without validating or saving anything
+    void Benchmark(function<ComputationNetworkPtr(DEVICEID_TYPE)> createNetworkFn, DEVICEID_TYPE deviceId,
+                   IDataReader* trainSetDataReader,
+                   TrainingBenchmark& benchmark);
 
 protected:
 
@@ -330,6 +468,11 @@ protected:
                     std::vector<ComputationNodeBasePtr>& featureNodes,
                     std::vector<ComputationNodeBasePtr>& labelNodes,
                     StreamMinibatchInputs* inputMatrices);
+    void MergePreComputeStatistics(const std::list<ComputationNodeBasePtr>& nodes);
+    void BroadcastPreComputeStatistics(const std::list<ComputationNodeBasePtr>& nodes);
+    std::wstring GetPreComputeCacheKey(const std::list<ComputationNodeBasePtr>& nodes, size_t numSamples) const;
+    bool LoadPreComputeCache(const std::list<ComputationNodeBasePtr>& nodes, const std::wstring& key, bool onAllRanks);
+    void SavePreComputeCache(const std::list<ComputationNodeBasePtr>& nodes, const std::wstring& key) const;
 
     // return a reasonable initial learning rate based on the initial mbsize
     double SearchForBestLearnRate(ComputationNetworkPtr net,
@@ -365,6 +508,18 @@ protected:
                                          /*out*/ size_t& totalSamplesSeen,
                                          std::string prefixMsg = "");
 
+    // the model state at the start of a search (if m_searchInMemory), which TrainOneMiniEpochAndReloadModel() restores after each trial
+    struct SearchSnapshot
+    {
+        std::vector<std::pair<ComputationNodeBasePtr, shared_ptr<Matrix<ElemType>>>> m_parameters; // values of the LearnableParameter nodes
+        std::vector<std::pair<ComputationNodeBasePtr, size_t>> m_batchNormalizationCounts;
+        std::list<Matrix<ElemType>> m_smoothedGradients;
+        size_t m_totalSamplesSeen;
+        size_t m_numParameterUpdates;
+    };
+    void TakeSearchSnapshot(ComputationNetworkPtr net, const std::list<Matrix<ElemType>>& smoothedGradients, size_t totalSamplesSeen);
+    void RestoreSearchSnapshot(ComputationNetworkPtr net, std::list<Matrix<ElemType>>& smoothedGradients, /*out*/ size_t& totalSamplesSeen);
+
     size_t AdaptiveMinibatchSizing(ComputationNetworkPtr net,
                                    ComputationNetworkPtr refNet,
                                    const ComputationNodeBasePtr& refNode,
@@ -400,6 +555,19 @@ protected:
                                       std::list<Matrix<ElemType>>& smoothedGradients,
                                       const size_t minMinibatchSize, const size_t maxMinibatchSize);
 
+    void PlanMinibatchSizeFromMemory(ComputationNetworkPtr net, IDataReader* trainSetDataReader, const int epochNumber,
+                                     const std::vector<ComputationNodeBasePtr>& featureNodes,
+                                     const std::vector<ComputationNodeBasePtr>& labelNodes,
+                                     const std::vector<ComputationNodeBasePtr>& criterionNodes,
+                                     const std::vector<ComputationNodeBasePtr>& evaluationNodes,
+                                     StreamMinibatchInputs* inputMatrices);
+    void DryRunMinibatch(ComputationNetworkPtr net, IDataReader* trainSetDataReader, const int epochNumber, const size_t minibatchSize,
+                         const std::vector<ComputationNodeBasePtr>& featureNodes,
+                         const std::vector<ComputationNodeBasePtr>& labelNodes,
+                         const std::vector<ComputationNodeBasePtr>& criterionNodes,
+                         const std::vector<ComputationNodeBasePtr>& evaluationNodes,
+                         StreamMinibatchInputs* inputMatrices);
+
     // Attemps to compute the error signal for the whole utterance, which will
     // be fed to the neural network as features. Currently it is a workaround
     // for the two-forward-pass sequence and ctc training, which allows
@@ -428,10 +596,38 @@ protected:
                          /*out*/ double& epochCriterion,
                          /*out*/ std::vector<double>& epochEvalErrors,
                          /*out*/ size_t& totalSamplesSeen,
-                         std::string prefixMsg = "");
+                         std::string prefixMsg = "",
+                         bool canCheckpointMidEpoch = false);
 
     void InitDistGradAgg(int numEvalNodes, int traceLevel);
     void InitModelAggregationHandler(int traceLevel);
+    bool ChangeElasticMembership(const std::list<ComputationNodeBasePtr>& learnableNodes,
+                                 std::list<Matrix<ElemType>>& smoothedGradients,
+                                 std::vector<double>& trainingState,
+                                 int numEvalNodes);
+
+    // see m_broadcastStartupState
+    bool UseStartupBroadcast() const;
+    ComputationNetworkPtr LoadNetwork(DEVICEID_TYPE deviceId, const std::wstring& fileName);
+    void BroadcastParameters(const ComputationNetworkPtr& net);
+    void BroadcastMatrix(Matrix<ElemType>& mat);
+    void BroadcastValues(Matrix<ElemType>& mat, size_t rootRank);
+
+    // see m_optimizerStateOwners
+    std::list<ComputationNodeBasePtr> GetGradientOrder(const ComputationNetworkPtr& net, const ComputationNodeBasePtr& criterionNode,
+                                                       const std::list<ComputationNodeBasePtr>& learnableNodes) const;
+    void AssignOptimizerStateOwners(const std::list<ComputationNodeBasePtr>& gradientNodes, const std::list<ComputationNodeBasePtr>& learnableNodes);
+    bool IsOptimizerStateOwner(size_t learnableNodeIndex) const;
+    void ReleaseUnownedOptimizerState(std::list<Matrix<ElemType>>& smoothedGradients);
+    void GatherOptimizerState(std::list<Matrix<ElemType>>& smoothedGradients);
+    void BroadcastUpdatedParameters(const std::list<ComputationNodeBasePtr>& learnableNodes);
+    void TransferMatrix(Matrix<ElemType>& mat, size_t srcRank, size_t dstRank);
+
+    // With the sharded optimizer state, each data-parallel rank owns a contiguous range of the parameters, in the order of their
+    // gradients: their gradients are only summed onto it (see IDistGradAggregator::SetGradientOwners()), it alone updates them
+    // and keeps their smoothed gradients, and then broadcasts them. The smoothed gradients of the other parameters are
+    // empty host matrices, except on the main node while a checkpoint is written or read.
+    std::vector<int> m_optimizerStateOwners; // [index in the learnable nodes], empty if not sharded
 public:
     // UpdateWeightsS - static version of UpdateWeights()
     static void UpdateWeightsS(const SGD* sgd, Matrix<ElemType>& functionValues,
@@ -456,7 +652,19 @@ protected:
                        const bool needAveMultiplier,
                        const bool useNesterovMomentum) const;
 
+    // UpdateWeights() for all learnable nodes, with few fused passes for those whose update Matrix::FusedSGDUpdate() supports
+    void UpdateWeightsFused(const std::list<ComputationNodeBasePtr>& learnableNodes,
+                            std::list<Matrix<ElemType>>& smoothedGradients,
+                            const double learnRatePerSample,
+                            const double momentumPerSample,
+                            const size_t actualMBSize);
+
     void ClipGradient(Matrix<ElemType>& gradient, const size_t actualMBSize) const;
+    // scales all gradients by the same factor if their global norm exceeds the clipping threshold; waits for each norm
+    void ClipGradientsByGlobalNorm(const std::list<ComputationNodeBasePtr>& learnableNodes, const size_t actualMBSize) const;
+
+    // divide the gradients by the loss scale; returns false (and lowers the scale) if they overflowed; waits once for the check
+    bool UnscaleGradients(const std::list<ComputationNodeBasePtr>& learnableNodes);
 
     void SaveCheckPointInfo(const size_t epoch, const size_t totalSamplesSeen,
                             const double learnRatePerSample,
@@ -464,12 +672,73 @@ protected:
                             const double prevCriterion,
                             const size_t minibatchSize);
 
+    // the position in an epoch and its running statistics, kept by the mid-epoch checkpoints
+    struct EpochProgress
+    {
+        EpochProgress()
+            : m_epoch(0), m_numMBsRun(0), m_epochSamples(0), m_epochCriterion(0), m_samplesSinceLastModelSync(0),
+              m_lossScale(1), m_numMBsSinceLossScaleChange(0), m_modelSlot(0), m_learnRatePerSample(0), m_minibatchSize(0)
+        {
+        }
+        size_t m_epoch;
+        size_t m_numMBsRun; // a restart skips these minibatches of the epoch
+        size_t m_epochSamples;
+        double m_epochCriterion; // sums over the minibatches so far
+        std::vector<double> m_epochEvalErrors;
+        size_t m_samplesSinceLastModelSync;
+        double m_lossScale;
+        size_t m_numMBsSinceLossScaleChange;
+        size_t m_modelSlot; // the model is written alternately to two files, so the one of the last checkpoint survives a crash
+        // not written into this section, they are the learning rate and minibatch size of the checkpoint file
+        double m_learnRatePerSample;
+        size_t m_minibatchSize;
+    };
+
+    void WriteCheckPointFile(const wstring& checkPointFileName, const size_t totalSamplesSeen,
+                             const double learnRatePerSample,
+                             const std::list<Matrix<ElemType>>& smoothedGradients,
+                             const double prevCriterion,
+                             const size_t minibatchSize,
+                             const size_t numParameterUpdates,
+                             bool syncToDisk,
+                             const EpochProgress* epochProgress = nullptr);
+    bool ReadCheckPointFile(const wstring& checkPointFileName, const size_t epochNumber,
+                            /*out*/ size_t& totalSamplesSeen,
+                            /*out*/ double& learnRatePerSample,
+                            std::list<Matrix<ElemType>>& smoothedGradients,
+                            /*out*/ double& prevCriterion,
+                            /*out*/ size_t& minibatchSize,
+                            /*out*/ EpochProgress* epochProgress = nullptr);
+
+    // mid-epoch checkpoints, written by the main node; the files of an epoch are deleted with the checkpoint at its end
+    void SaveMidEpochCheckpoint(ComputationNetworkPtr net, const size_t totalSamplesSeen,
+                                const std::list<Matrix<ElemType>>& smoothedGradients, EpochProgress& epochProgress);
+    bool LoadMidEpochCheckpoint(ComputationNetworkPtr net, const size_t epoch, /*out*/ size_t& totalSamplesSeen,
+                                std::list<Matrix<ElemType>>& smoothedGradients);
+    void DeleteMidEpochCheckpoint(const size_t epoch);
+    wstring GetMidEpochCheckPointFileName(const size_t epoch);
+    wstring GetMidEpochModelName(const size_t epoch, const size_t modelSlot);
+
+    // save the model and the checkpoint info at the end of an epoch, in the background if m_maxPendingCheckpoints > 0
+    void SaveCheckpoint(ComputationNetworkPtr net, const size_t epoch, const size_t totalSamplesSeen,
+                        const double learnRatePerSample,
+                        const std::list<Matrix<ElemType>>& smoothedGradients,
+                        const double prevCriterion,
+                        const size_t minibatchSize,
+                        const size_t epochsSinceLastLearnRateAdjust);
+    void DeletePreviousCheckPointFiles(const size_t epoch, const size_t epochsSinceLastLearnRateAdjust);
+    bool CanCheckpointInBackground() const;
+    FileOptions GetCheckpointFileFormat(const size_t epoch, bool midEpoch) const;
+    // must be called before the model or checkpoint files are read, or the training ends
+    void WaitForPendingCheckpoints();
+
     bool LoadCheckPointInfo(const size_t epochNumber,
                             /*out*/ size_t& totalSamplesSeen,
                             /*out*/ double& learnRatePerSample,
                             std::list<Matrix<ElemType>>& smoothedGradients,
                             /*out*/ double& prevCriterion,
-                            /*out*/ size_t& minibatchSize);
+                            /*out*/ size_t& minibatchSize,
+                            bool fromMainNode = false);
 
     wstring GetCheckPointFileNameForEpoch(const int epoch);
     wstring GetModelNameForEpoch(const int epoch, bool bLastModel = false);
@@ -503,14 +772,63 @@ protected:
     wstring m_evalCriterionNodeName;
 
     size_t m_prevChosenMinibatchSize;
+    size_t m_memoryPlanMinibatchSize; // with MemoryPlanSizing::Minibatch, the minibatch size of all epochs; 0 otherwise
     double m_lastFinishedEpochTrainLoss;
 
+    double m_lossScale;                  // current loss scale (if m_useLossScaling)
+    size_t m_numMBsSinceLossScaleChange;
+
+    size_t m_numParameterUpdates; // the step count of the bias correction of Adam and LAMB, kept in the checkpoints
+
     IDistGradAggregator<ElemType>* m_distGradAgg;
     struct DistGradHeader* m_gradHeader;
 
     shared_ptr<IMASGD<ElemType>> m_pMASGDHelper;
+    shared_ptr<ElasticMembership> m_elastic;
+
+    shared_ptr<Matrix<ElemType>> m_gradientSquaredNorm; // for clipping by the global norm, computed on the device by UpdateWeightsFused()
+    shared_ptr<Matrix<ElemType>> m_gradientsNonFinite;  // for loss scaling, NaN if any gradient is, computed on the device by UnscaleGradients()
+
+    unique_ptr<SearchSnapshot> m_searchSnapshot; // during a search in memory, after its first trial
+
+    unique_ptr<EpochProgress> m_resumeEpochProgress; // of the mid-epoch checkpoint that the training restarts from, until its epoch has resumed
+
+    // a host copy of the model and learner state, which a background thread writes to the checkpoint files
+    struct CheckpointReplica
+    {
+        ComputationNetworkPtr m_net; // on the CPU, loaded from a checkpoint that was written synchronously
+        std::list<Matrix<ElemType>> m_smoothedGradients;
+        std::shared_future<void> m_write; // while pending, the replica must not be touched
+    };
+    bool UpdateCheckpointReplica(ComputationNetworkPtr net, CheckpointReplica& replica, const std::list<Matrix<ElemType>>& smoothedGradients);
+    static bool UpdateModelReplica(ComputationNetworkPtr net, ComputationNetworkPtr replicaNet);
+    std::vector<shared_ptr<CheckpointReplica>> m_checkpointReplicas; // used round robin, so the next one is the one written the longest ago
+    size_t m_nextCheckpointReplica;
+    std::shared_future<void> m_lastCheckpointWrite; // each write waits for the previous one, so the files are completed in order
+
+    // a copy of the model on m_asyncValidationDeviceId, which a background thread validates while the training continues
+    struct ValidationReplica
+    {
+        ComputationNetworkPtr m_net;
+        std::future<std::vector<double>> m_scores; // while pending, the replica must not be touched
+        int m_epoch;                               // whose model is validated
+    };
+    unique_ptr<ValidationReplica> m_validationReplica; // on the main node, with asyncValidation
+    void StartAsyncValidation(ComputationNetworkPtr net, int epoch, IDataReader* validationSetDataReader,
+                              const std::vector<std::wstring>& cvNodeNames, size_t mbSize);
+    // returns false if no validation is pending
+    bool WaitForAsyncValidation(/*out*/ std::vector<double>& scores, /*out*/ int& epoch);
+
+    TrainingBenchmark* m_benchmark; // during Benchmark()
+
+    unique_ptr<GPUWatcher> m_gpuWatcher; // while training with m_gpuTelemetry on a GPU
+    // prints the summary of the GPU samples since the last call, and appends it to m_gpuTelemetryFile
+    void TraceGpuTelemetry(int epochNumber, DEVICEID_TYPE deviceId);
 
 private:
     int SGDTrace(FILE* __restrict __stream, const char* __restrict __format, ...);
+
+    // Prints the share of the reader in the time of the last minibatches, and the counters of its pipeline.
+    void TraceReaderStatistics(const std::string& prefixMsg, double readerTime, double totalTime, IDataReader* reader);
 };
 } } }
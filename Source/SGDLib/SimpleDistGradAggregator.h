@@ -1,11 +1,19 @@
 #pragma once
 
 #include "IDistGradAggregator.h"
+#include "GradientAllReducer.h"
 #include "CUDAPageLockedMemAllocator.h"
 #include <future>
+#include <algorithm>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <chrono>
+#include <climits>
 #include "GPUDataTransferer.h"
 #include "TimerUtility.h"
 #include "MatrixQuantizerImpl.h"
+#include "TaskScheduler.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -15,13 +23,56 @@ class SimpleDistGradAggregator : public IDistGradAggregator<ElemType>
     UsingIDistGradAggregatorMembers;
 
 public:
-    SimpleDistGradAggregator(MPIWrapper* mpi, bool useAsyncAggregation, int syncStatsTrace)
-        : IDistGradAggregator<ElemType>(mpi), m_useAsyncAggregation(useAsyncAggregation), m_currentEpochNumber(-1), m_bufferedGradHeader(nullptr), m_syncStatsTrace(syncStatsTrace), m_iterationCount(0)
+    // With a bucketSizeInBytes > 0 (and without async aggregation), the gradients are fused into buckets of about that size,
+    // which are all-reduced as a whole, and the aggregation can be overlapped with the backprop (see BeginOverlappedAggregation()).
+    // The gradients are then expected in the order in which the backprop completes them.
+    // With useDeviceBuffers, GPU gradients are handed to MPI directly instead of being staged through pinned host buffers,
+    // which requires a CUDA-aware MPI. With hierarchical, the gradients are reduced within each machine first (see GradientAllReducer).
+    // Sparse block column gradients (of embeddings and other parameters multiplied with sparse input) are not all-reduced,
+    // only their non-zero columns are exchanged (see AggregateSparseGradient()).
+    // Gradients for which the compressor factory (see SetGradientCompressorFactory()) creates a compressor are exchanged compressed
+    // (see AggregateCompressedGradients()). Gradients with an owner (see SetGradientOwners()) are only summed onto their owner,
+    // except for the sparse and compressed ones.
+    SimpleDistGradAggregator(MPIWrapper* mpi, bool useAsyncAggregation, int syncStatsTrace, size_t bucketSizeInBytes = 0, bool useDeviceBuffers = false, bool hierarchical = false)
+        : IDistGradAggregator<ElemType>(mpi), m_useAsyncAggregation(useAsyncAggregation), m_currentEpochNumber(-1), m_bufferedGradHeader(nullptr), m_syncStatsTrace(syncStatsTrace), m_iterationCount(0),
+          m_useDeviceBuffers(useDeviceBuffers), m_allReducer(mpi, hierarchical), m_bucketSizeInBytes(bucketSizeInBytes), m_nextBucket(0), m_noMoreBuckets(false)
     {
+        // The buckets are contiguous host buffers
+        if ((m_bucketSizeInBytes > 0) && m_useDeviceBuffers)
+            fprintf(stderr, "WARNING: gradientBucketSizeInBytes is ignored when the gradients are aggregated in device memory.\n");
     }
 
     ~SimpleDistGradAggregator()
     {
+        // Let the communication thread of an unfinished aggregation run out, e.g. after an exception in the backprop
+        if (m_communication.valid())
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_bucketsLock);
+                m_noMoreBuckets = true;
+            }
+            m_bucketReady.notify_one();
+            try
+            {
+                m_communication.get();
+            }
+            catch (...)
+            {
+            }
+        }
+
+        // likewise an async aggregation (the future does not wait for it by itself)
+        if (m_pendingAsyncAggregation.valid())
+        {
+            try
+            {
+                m_pendingAsyncAggregation.get();
+            }
+            catch (...)
+            {
+            }
+        }
+
         for (size_t i = 0; i < m_recvHeaders.size(); ++i)
         {
             DistGradHeader::Destroy(m_recvHeaders[i]);
@@ -96,15 +147,19 @@ public:
                 // the gradient aggregation asynchronously on a separate stream
                 MatrixComputeStreamEvent* mainStreamSyncEvent = MatrixComputeStreamEvent::Create(deviceId);
 
-                m_pendingAsyncAggregation = std::async(std::launch::async, [=]
+                m_pendingAsyncAggregation = TaskScheduler::Instance().Submit(TaskClass::aggregation, [=]
                                                        {
-                                                           // We are starting on a new thread. Make sure the new thread is
+                                                           // We are starting on a worker thread. Make sure the thread is
                                                            // setup to use the right device
                                                            Matrix<ElemType>::SetDevice(deviceId);
 
                                                            // Synchronize the Quantization compute stream with the completion of
-                                                           // compute of the gradient matrices on the main compute stream
-                                                           mainStreamSyncEvent->SynchronizeDataTransferFetchStreamWithEvent<ElemType>();
+                                                           // compute of the gradient matrices on the main compute stream.
+                                                           // MPI reads device buffers outside of any stream, so then this thread waits for the computation itself.
+                                                           if (m_useDeviceBuffers)
+                                                               mainStreamSyncEvent->SynchronizeEvent();
+                                                           else
+                                                               mainStreamSyncEvent->SynchronizeDataTransferFetchStreamWithEvent<ElemType>();
                                                            delete mainStreamSyncEvent;
 
                                                            AggregateGradientsImpl(newGradients, newGradHeader, showSyncPerfStats);
@@ -115,6 +170,11 @@ public:
 
             return false;
         }
+        else if (UseBuckets())
+        {
+            AggregateBucketedGradients(gradients, headerCPU, showSyncPerfStats);
+            return (headerCPU->numSamples != 0);
+        }
         else
         {
             AggregateGradientsImpl(gradients, headerCPU, showSyncPerfStats);
@@ -122,6 +182,39 @@ public:
         }
     }
 
+    // Starts the aggregation of the buckets, which are then all-reduced as soon as all of their gradients are reported by GradientReady().
+    bool BeginOverlappedAggregation(const std::vector<Matrix<ElemType>*>& gradients, int epochNumber) override
+    {
+        // The first aggregation of an epoch is not overlapped, as it sets up the buffers
+        if (!UseBuckets() || (m_currentEpochNumber != epochNumber) || m_buckets.empty())
+            return false;
+
+        StartBucketedAggregation(gradients);
+        return true;
+    }
+
+    void SetGradientOwners(const std::vector<int>& owners) override
+    {
+        if (owners == m_gradientOwners)
+            return;
+        if (m_useAsyncAggregation || (m_currentEpochNumber != -1))
+            LogicError("SimpleDistGradAggregator: The owners of the gradients have to be set before the first aggregation, and without async aggregation.");
+        m_gradientOwners = owners;
+    }
+
+    void GradientReady(size_t gradientIndex) override
+    {
+        assert(m_communication.valid());
+        // sparse gradients are exchanged after the backprop
+        if (m_gradientToBucket[gradientIndex] == SIZE_MAX)
+            return;
+
+        auto& bucket = m_buckets[m_gradientToBucket[gradientIndex]];
+        assert(bucket.m_numPending > 0);
+        bucket.m_numPending--;
+        StartReadyBuckets();
+    }
+
 private:
     std::shared_ptr<ElemType> AllocateIntermediateBuffer(int deviceID, size_t numElements)
     {
@@ -148,16 +241,30 @@ private:
                 m_allocator.reset(new CUDAPageLockedMemAllocator(deviceId));
             }
 
+            if (m_compressorFactory)
+            {
+                for (size_t i = 0; i < gradients.size(); i++)
+                    m_compressors.push_back(IsSparseGradient(gradients[i]) ? nullptr : m_compressorFactory(gradients[i]->GetNumRows(), gradients[i]->GetNumCols()));
+            }
+
             for (size_t i = 0; i < gradients.size(); i++)
             {
-                // Make sure none of the gradient matrixes are sparse - we currently do not support aggregation of sparse gradient matrices
-                if (gradients[i]->GetMatrixType() != DENSE)
-                    RuntimeError("Gradient aggregation for sparse gradient matrices is currently unsupported!");
+                // Sparse gradients can only be exchanged in block column format, and they cannot be double buffered
+                if (IsSparseGradient(gradients[i]))
+                {
+                    if (gradients[i]->GetFormat() != matrixFormatSparseBlockCol)
+                        RuntimeError("Gradient aggregation for sparse gradient matrices is only supported in block column format!");
+                    if (m_useAsyncAggregation)
+                        RuntimeError("Async gradient aggregation for sparse gradient matrices is currently unsupported!");
+                }
 
                 if (deviceId != CPUDEVICE)
                 {
                     m_gpuDataTransferers.push_back(std::unique_ptr<GPUDataTransferer<ElemType>>(new GPUDataTransferer<ElemType>(deviceId, m_useAsyncAggregation)));
-                    m_intermediateCPUBuffers.push_back(AllocateIntermediateBuffer(deviceId, gradients[i]->GetNumElements()));
+                    // the buckets have their own staging buffers, device buffers are not staged at all, and sparse gradients are copied as a whole.
+                    // Compressed gradients are always compressed on the host.
+                    bool isStaged = IsCompressedGradient(i) || (!UseBuckets() && !m_useDeviceBuffers && !IsSparseGradient(gradients[i]));
+                    m_intermediateCPUBuffers.push_back(isStaged ? AllocateIntermediateBuffer(deviceId, gradients[i]->GetNumElements()) : nullptr);
                 }
 
                 if (m_useAsyncAggregation)
@@ -179,6 +286,9 @@ private:
                     m_recvHeaders.push_back(DistGradHeader::Create(numEvalNode));
                 }
             }
+
+            if (UseBuckets())
+                CreateBuckets(gradients);
         }
         else
         {
@@ -236,15 +346,30 @@ private:
             if (m_useAsyncAggregation)
             {
                 std::unique_ptr<MatrixComputeStreamEvent> mainStreamSyncEvent(MatrixComputeStreamEvent::Create(deviceId));
-                mainStreamSyncEvent->SynchronizeDataTransferFetchStreamWithEvent<ElemType>();
+                if (m_useDeviceBuffers)
+                    mainStreamSyncEvent->SynchronizeEvent();
+                else
+                    mainStreamSyncEvent->SynchronizeDataTransferFetchStreamWithEvent<ElemType>();
             }
         }
 
+        // Device buffers are read by MPI directly, once their computation is complete.
+        // The async aggregation synchronized with it before starting.
+        bool useDeviceBuffers = (deviceId >= 0) && m_useDeviceBuffers;
+        if (useDeviceBuffers && !m_useAsyncAggregation)
+        {
+            std::unique_ptr<MatrixComputeStreamEvent> mainStreamSyncEvent(MatrixComputeStreamEvent::Create(deviceId));
+            mainStreamSyncEvent->SynchronizeEvent();
+        }
+
         // Initiate transfer of the gradient matrices to the CPU if needed
-        if (deviceId >= 0)
+        if ((deviceId >= 0) && !useDeviceBuffers)
         {
             for (size_t i = 0; i < numGradMatrices; ++i)
             {
+                if (!IsAllReducedGradient(gradients, i))
+                    continue;
+
                 m_gpuDataTransferers[i]->CopyGPUToCPUAsync(gradients[i]->BufferPointer(), gradients[i]->GetNumElements(), m_intermediateCPUBuffers[i].get());
             }
         }
@@ -269,18 +394,20 @@ private:
         }
 
         // Perform MPI async allreduce on the gradient data
-        std::vector<MPI_Request> allReduceRequests(numGradMatrices);
+        std::vector<size_t> allReduceOperations(numGradMatrices);
         for (size_t i = 0; i < numGradMatrices; ++i)
         {
+            if (!IsAllReducedGradient(gradients, i))
+                continue;
+
             ElemType* reductionBuffer = gradients[i]->BufferPointer();
-            if (deviceId >= 0)
+            if ((deviceId >= 0) && !useDeviceBuffers)
             {
                 m_gpuDataTransferers[i]->WaitForCopyGPUToCPUAsync();
                 reductionBuffer = m_intermediateCPUBuffers[i].get();
             }
 
-            // On Windows this async MPI_Iallreduce call requires MS MPI v7 or higher to be installed
-            MPI_Iallreduce(MPI_IN_PLACE, reductionBuffer, gradients[i]->GetNumElements(), MPIWrapper::GetDataType(reductionBuffer), MPI_SUM, m_mpi->Communicator(), &allReduceRequests[i]) || MpiFail("MPI_Iallreduce");
+            allReduceOperations[i] = m_allReducer.Start(reductionBuffer, gradients[i]->GetNumElements(), GetGradientOwner(i));
         }
 
         // On the main node wait for the headers to arrive and aggregate
@@ -326,12 +453,20 @@ private:
         // Wait for the allreduce operations to finish and initiate transfer back to the GPU if needed
         for (size_t i = 0; i < numGradMatrices; ++i)
         {
-            MPI_Wait(&allReduceRequests[i], MPI_STATUSES_IGNORE) || MpiFail("MPI_Wait");
-            if (deviceId >= 0)
+            if (!IsAllReducedGradient(gradients, i))
+                continue;
+
+            m_allReducer.Wait(allReduceOperations[i]);
+            if ((deviceId >= 0) && !useDeviceBuffers && IsSummedHere(GetGradientOwner(i)))
             {
                 m_gpuDataTransferers[i]->CopyCPUToGPUAsync(m_intermediateCPUBuffers[i].get(), gradients[i]->GetNumElements(), gradients[i]->BufferPointer());
             }
         }
+        m_allReducer.WaitAll();
+
+        // The sparse and the compressed gradients are exchanged while the all-reduced ones are copied back
+        AggregateCompressedGradients(gradients);
+        AggregateSparseGradients(gradients);
 
         // Wait to receive aggregate header
         if (!m_mpi->IsMainNode())
@@ -340,11 +475,12 @@ private:
         }
 
         // Wait for all the transfers to finish
-        if (deviceId >= 0)
+        if ((deviceId >= 0) && !useDeviceBuffers)
         {
             for (size_t i = 0; i < numGradMatrices; ++i)
             {
-                m_gpuDataTransferers[i]->WaitForCopyCPUToGPUAsync();
+                if (IsAllReducedGradient(gradients, i) && IsSummedHere(GetGradientOwner(i)))
+                    m_gpuDataTransferers[i]->WaitForCopyCPUToGPUAsync();
             }
         }
 
@@ -366,6 +502,485 @@ private:
         }
     }
 
+    bool UseBuckets() const
+    {
+        return (m_bucketSizeInBytes > 0) && !m_useAsyncAggregation && !m_useDeviceBuffers;
+    }
+
+    // Groups consecutive gradients into buckets of at least m_bucketSizeInBytes (but a single gradient at most),
+    // each with a CPU staging buffer that holds all of its gradients. Sparse and compressed gradients are not in any bucket.
+    // The gradients of a bucket have the same owner.
+    void CreateBuckets(const std::vector<Matrix<ElemType>*>& gradients)
+    {
+        int deviceId = gradients[0]->GetDeviceId();
+        m_gradientToBucket.assign(gradients.size(), SIZE_MAX);
+        for (size_t i = 0; i < gradients.size(); i++)
+        {
+            if (!IsAllReducedGradient(gradients, i))
+                continue;
+
+            if (m_buckets.empty() || (m_buckets.back().m_numElements * sizeof(ElemType) >= m_bucketSizeInBytes) || (m_buckets.back().m_owner != GetGradientOwner(i)))
+            {
+                m_buckets.push_back(GradientBucket());
+                m_buckets.back().m_owner = GetGradientOwner(i);
+            }
+
+            auto& bucket = m_buckets.back();
+            bucket.m_gradients.push_back(i);
+            bucket.m_offsets.push_back(bucket.m_numElements);
+            bucket.m_numElements += gradients[i]->GetNumElements();
+            m_gradientToBucket[i] = m_buckets.size() - 1;
+        }
+
+        for (auto& bucket : m_buckets)
+        {
+            if (deviceId != CPUDEVICE)
+                bucket.m_buffer = AllocateIntermediateBuffer(deviceId, bucket.m_numElements);
+            else
+                bucket.m_buffer.reset(new ElemType[bucket.m_numElements], [](ElemType* p) { delete[] p; });
+        }
+
+        fprintf(stderr, "SimpleDistGradAggregator: aggregating %d gradients in %d buckets of at least %d bytes\n",
+                (int) gradients.size(), (int) m_buckets.size(), (int) m_bucketSizeInBytes);
+    }
+
+    // Starts the communication thread, which all-reduces the buckets as they are started.
+    // All MPI calls of the aggregation are made from that thread until FinishBucketedAggregation(), which is what MPI_THREAD_SERIALIZED allows.
+    void StartBucketedAggregation(const std::vector<Matrix<ElemType>*>& gradients)
+    {
+        assert(!m_communication.valid());
+        m_aggregatedGradients = gradients;
+        for (auto& bucket : m_buckets)
+            bucket.m_numPending = bucket.m_gradients.size();
+        m_nextBucket = 0;
+        m_readyBuckets.clear();
+        m_noMoreBuckets = false;
+
+        int deviceId = gradients[0]->GetDeviceId();
+        m_communication = TaskScheduler::Instance().Submit(TaskClass::aggregation, [this, deviceId]
+                                     {
+                                         Matrix<ElemType>::SetDevice(deviceId);
+                                         CommunicateBuckets();
+                                     });
+    }
+
+    // Starts the copy of the complete buckets into their staging buffers, and hands them to the communication thread.
+    // Buckets are started strictly in order, so that the collectives are issued in the same order on all nodes.
+    void StartReadyBuckets()
+    {
+        size_t firstStarted = m_nextBucket;
+        while ((m_nextBucket < m_buckets.size()) && (m_buckets[m_nextBucket].m_numPending == 0))
+        {
+            // the fetch stream may be a concurrent stream, so it has to wait for the computation of the gradients
+            int deviceId = m_aggregatedGradients[0]->GetDeviceId();
+            if ((m_nextBucket == firstStarted) && (deviceId != CPUDEVICE))
+            {
+                std::unique_ptr<MatrixComputeStreamEvent> mainStreamSyncEvent(MatrixComputeStreamEvent::Create(deviceId));
+                mainStreamSyncEvent->SynchronizeDataTransferFetchStreamWithEvent<ElemType>();
+            }
+
+            auto& bucket = m_buckets[m_nextBucket];
+            for (size_t j = 0; j < bucket.m_gradients.size(); j++)
+            {
+                size_t i = bucket.m_gradients[j];
+                Matrix<ElemType>* gradient = m_aggregatedGradients[i];
+                ElemType* staging = bucket.m_buffer.get() + bucket.m_offsets[j];
+                if (gradient->GetDeviceId() != CPUDEVICE)
+                    m_gpuDataTransferers[i]->CopyGPUToCPUAsync(gradient->BufferPointer(), gradient->GetNumElements(), staging);
+                else
+                    memcpy(staging, gradient->BufferPointer(), gradient->GetNumElements() * sizeof(ElemType));
+            }
+            m_nextBucket++;
+        }
+
+        if (m_nextBucket != firstStarted)
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_bucketsLock);
+                for (size_t b = firstStarted; b < m_nextBucket; b++)
+                    m_readyBuckets.push_back(b);
+            }
+            m_bucketReady.notify_one();
+        }
+    }
+
+    // Body of the communication thread.
+    void CommunicateBuckets()
+    {
+        bool pending = false;
+        for (;;)
+        {
+            size_t b;
+            {
+                std::unique_lock<std::mutex> lock(m_bucketsLock);
+                while (m_readyBuckets.empty() && !m_noMoreBuckets)
+                {
+                    if (!pending)
+                    {
+                        m_bucketReady.wait(lock);
+                    }
+                    else if (!m_bucketReady.wait_for(lock, std::chrono::milliseconds(1), [this] { return !m_readyBuckets.empty() || m_noMoreBuckets; }))
+                    {
+                        // Most MPI implementations only progress non-blocking collectives inside of MPI calls
+                        lock.unlock();
+                        pending = !m_allReducer.Test();
+                        lock.lock();
+                    }
+                }
+
+                if (m_readyBuckets.empty())
+                    break;
+
+                b = m_readyBuckets.front();
+                m_readyBuckets.pop_front();
+            }
+
+            const auto& bucket = m_buckets[b];
+            for (size_t i : bucket.m_gradients)
+            {
+                if (m_aggregatedGradients[i]->GetDeviceId() != CPUDEVICE)
+                    m_gpuDataTransferers[i]->WaitForCopyGPUToCPUAsync();
+            }
+
+            m_allReducer.Start(bucket.m_buffer.get(), bucket.m_numElements, bucket.m_owner);
+            pending = true;
+        }
+
+        m_allReducer.WaitAll();
+    }
+
+    // Starts the buckets that are not started yet, waits for the all-reduce of all buckets and copies the results back.
+    void FinishBucketedAggregation()
+    {
+        for (auto& bucket : m_buckets)
+            bucket.m_numPending = 0;
+        StartReadyBuckets();
+        {
+            std::lock_guard<std::mutex> lock(m_bucketsLock);
+            m_noMoreBuckets = true;
+        }
+        m_bucketReady.notify_one();
+        m_communication.get();
+
+        bool isOnGPU = (m_aggregatedGradients[0]->GetDeviceId() != CPUDEVICE);
+        for (const auto& bucket : m_buckets)
+        {
+            if (!IsSummedHere(bucket.m_owner))
+                continue;
+            for (size_t j = 0; j < bucket.m_gradients.size(); j++)
+            {
+                size_t i = bucket.m_gradients[j];
+                Matrix<ElemType>* gradient = m_aggregatedGradients[i];
+                ElemType* staging = bucket.m_buffer.get() + bucket.m_offsets[j];
+                if (isOnGPU)
+                    m_gpuDataTransferers[i]->CopyCPUToGPUAsync(staging, gradient->GetNumElements(), gradient->BufferPointer());
+                else
+                    memcpy(gradient->BufferPointer(), staging, gradient->GetNumElements() * sizeof(ElemType));
+            }
+        }
+
+        if (isOnGPU)
+        {
+            for (const auto& bucket : m_buckets)
+            {
+                if (!IsSummedHere(bucket.m_owner))
+                    continue;
+                for (size_t i : bucket.m_gradients)
+                    m_gpuDataTransferers[i]->WaitForCopyCPUToGPUAsync();
+            }
+        }
+    }
+
+    void AggregateBucketedGradients(const std::vector<Matrix<ElemType>*>& gradients, DistGradHeader* headerCPU, bool showSyncPerfStats)
+    {
+        Timer aggregationTimer;
+        int deviceId = gradients[0]->GetDeviceId();
+        if (showSyncPerfStats)
+        {
+            std::unique_ptr<MatrixComputeStreamEvent> mainStreamSyncEvent(MatrixComputeStreamEvent::Create(deviceId));
+            mainStreamSyncEvent->SynchronizeEvent();
+            aggregationTimer.Start();
+        }
+
+        bool overlapped = m_communication.valid();
+        if (!overlapped)
+        {
+            // If the current node did not process any samples, the gradients should be zero'd
+            if (headerCPU->numSamples == 0)
+            {
+                for (size_t i = 0; i < gradients.size(); ++i)
+                    gradients[i]->SetValue(0);
+            }
+
+            StartBucketedAggregation(gradients);
+        }
+        else if (gradients != m_aggregatedGradients)
+        {
+            LogicError("SimpleDistGradAggregator: the gradients differ from the ones the overlapped aggregation was started with.");
+        }
+
+        FinishBucketedAggregation();
+        AggregateCompressedGradients(gradients);
+        AggregateSparseGradients(gradients);
+        AggregateHeaders(headerCPU, gradients.size());
+
+        if (showSyncPerfStats)
+        {
+            aggregationTimer.Stop();
+            double epochTime = aggregationTimer.ElapsedSeconds();
+            fprintf(stderr, "Actual gradient aggregation time%s: %.6g\n", overlapped ? " after backprop" : "", epochTime);
+        }
+    }
+
+    static bool IsSparseGradient(const Matrix<ElemType>* gradient)
+    {
+        return gradient->GetMatrixType() == SPARSE;
+    }
+
+    bool IsCompressedGradient(size_t i) const
+    {
+        return !m_compressors.empty() && (m_compressors[i] != nullptr);
+    }
+
+    // Whether gradient 'i' is summed by the all-reducer, as opposed to being exchanged sparse or compressed
+    bool IsAllReducedGradient(const std::vector<Matrix<ElemType>*>& gradients, size_t i) const
+    {
+        return !IsSparseGradient(gradients[i]) && !IsCompressedGradient(i);
+    }
+
+    // the node that gradient i is summed onto, -1 for all nodes; only for the all-reduced gradients
+    int GetGradientOwner(size_t i) const
+    {
+        return m_gradientOwners.empty() ? -1 : m_gradientOwners[i];
+    }
+
+    // whether this node gets the sum of a gradient of the given owner
+    bool IsSummedHere(int owner)
+    {
+        return (owner < 0) || (owner == (int) MyRank());
+    }
+
+    // Sums the compressed gradients across all nodes. Compressed data cannot be all-reduced, so every node gathers
+    // the compressed gradients of all nodes (its own included), and adds up their decompression in the order of the nodes,
+    // which gives the same sums on all nodes.
+    void AggregateCompressedGradients(const std::vector<Matrix<ElemType>*>& gradients)
+    {
+        std::vector<size_t> compressed;
+        for (size_t i = 0; i < gradients.size(); i++)
+        {
+            if (IsCompressedGradient(i))
+                compressed.push_back(i);
+        }
+        if (compressed.empty())
+            return;
+
+        // The compression works on host copies of the gradients.
+        // The async aggregation synchronized the fetch stream with the computation of the gradients before starting.
+        int deviceId = gradients[0]->GetDeviceId();
+        if (deviceId != CPUDEVICE)
+        {
+            if (!m_useAsyncAggregation)
+            {
+                std::unique_ptr<MatrixComputeStreamEvent> mainStreamSyncEvent(MatrixComputeStreamEvent::Create(deviceId));
+                mainStreamSyncEvent->SynchronizeDataTransferFetchStreamWithEvent<ElemType>();
+            }
+
+            for (size_t i : compressed)
+                m_gpuDataTransferers[i]->CopyGPUToCPUAsync(gradients[i]->BufferPointer(), gradients[i]->GetNumElements(), m_intermediateCPUBuffers[i].get());
+        }
+
+        // Compress into one packet, in which every gradient starts at an 8 byte aligned offset
+        const size_t alignment = sizeof(uint64_t);
+        std::vector<uint64_t> localSizes(compressed.size());
+        m_compressedPacket.clear();
+        for (size_t k = 0; k < compressed.size(); k++)
+        {
+            size_t i = compressed[k];
+            ElemType* data = gradients[i]->BufferPointer();
+            if (deviceId != CPUDEVICE)
+            {
+                m_gpuDataTransferers[i]->WaitForCopyGPUToCPUAsync();
+                data = m_intermediateCPUBuffers[i].get();
+            }
+
+            m_compressors[i]->Compress(data, m_compressedGradient);
+            localSizes[k] = m_compressedGradient.size();
+            size_t offset = m_compressedPacket.size();
+            m_compressedPacket.resize(offset + (m_compressedGradient.size() + alignment - 1) / alignment * alignment, 0);
+            memcpy(m_compressedPacket.data() + offset, m_compressedGradient.data(), m_compressedGradient.size());
+        }
+
+        std::vector<uint64_t> sizes(compressed.size() * NumProc());
+        MPI_Allgather(localSizes.data(), (int) localSizes.size(), MPI_UINT64_T, sizes.data(), (int) localSizes.size(), MPI_UINT64_T, m_mpi->Communicator()) || MpiFail("MPI_Allgather");
+
+        // The packets are gathered in units of 8 bytes, which keeps the counts small enough for an int
+        std::vector<int> numWordsPerNode(NumProc());
+        std::vector<int> offsets(NumProc());
+        size_t numGatheredWords = 0;
+        for (size_t j = 0; j < NumProc(); j++)
+        {
+            size_t numWords = 0;
+            for (size_t k = 0; k < compressed.size(); k++)
+                numWords += (size_t) (sizes[j * compressed.size() + k] + alignment - 1) / alignment;
+            if (numGatheredWords + numWords > INT_MAX)
+                RuntimeError("SimpleDistGradAggregator: the compressed gradients are too large to be exchanged in one packet.");
+
+            numWordsPerNode[j] = (int) numWords;
+            offsets[j] = (int) numGatheredWords;
+            numGatheredWords += numWords;
+        }
+
+        MPI_Datatype wordType;
+        MPI_Type_contiguous((int) alignment, MPI_CHAR, &wordType) || MpiFail("MPI_Type_contiguous");
+        MPI_Type_commit(&wordType) || MpiFail("MPI_Type_commit");
+        m_gatheredPackets.resize(numGatheredWords * alignment);
+        MPI_Allgatherv(m_compressedPacket.data(), numWordsPerNode[MyRank()], wordType, m_gatheredPackets.data(), numWordsPerNode.data(), offsets.data(), wordType, m_mpi->Communicator()) || MpiFail("MPI_Allgatherv");
+        MPI_Type_free(&wordType) || MpiFail("MPI_Type_free");
+
+        for (size_t k = 0; k < compressed.size(); k++)
+        {
+            size_t i = compressed[k];
+            ElemType* data = (deviceId != CPUDEVICE) ? m_intermediateCPUBuffers[i].get() : gradients[i]->BufferPointer();
+            memset(data, 0, gradients[i]->GetNumElements() * sizeof(ElemType));
+        }
+
+        for (size_t j = 0; j < NumProc(); j++)
+        {
+            const char* packet = m_gatheredPackets.data() + (size_t) offsets[j] * alignment;
+            for (size_t k = 0; k < compressed.size(); k++)
+            {
+                size_t i = compressed[k];
+                size_t size = (size_t) sizes[j * compressed.size() + k];
+                ElemType* data = (deviceId != CPUDEVICE) ? m_intermediateCPUBuffers[i].get() : gradients[i]->BufferPointer();
+                m_compressors[i]->DecompressAndAdd(packet, size, data);
+                packet += (size + alignment - 1) / alignment * alignment;
+            }
+        }
+
+        if (deviceId != CPUDEVICE)
+        {
+            for (size_t i : compressed)
+                m_gpuDataTransferers[i]->CopyCPUToGPUAsync(m_intermediateCPUBuffers[i].get(), gradients[i]->GetNumElements(), gradients[i]->BufferPointer());
+            for (size_t i : compressed)
+                m_gpuDataTransferers[i]->WaitForCopyCPUToGPUAsync();
+        }
+    }
+
+    void AggregateSparseGradients(const std::vector<Matrix<ElemType>*>& gradients)
+    {
+        for (size_t i = 0; i < gradients.size(); i++)
+        {
+            if (IsSparseGradient(gradients[i]))
+                AggregateSparseGradient(*gradients[i]);
+        }
+    }
+
+    // Sums a sparse block column gradient across all nodes. Such gradients only have values in the columns of the
+    // input words of the minibatch, so instead of all-reducing the full matrix, every node gathers the ids and the values
+    // of the non-zero columns of all nodes, and adds up those of the same column. The result is a block column matrix again,
+    // which the sparse update of the parameter takes as it is.
+    void AggregateSparseGradient(Matrix<ElemType>& gradient)
+    {
+        size_t numRows = gradient.GetNumRows();
+        size_t numCols = gradient.GetNumCols();
+        gradient.GetMatrixFromBlockColFormat(m_sparseColIds, m_sparseValues);
+
+        int numLocalCols = (int) m_sparseColIds.size();
+        std::vector<int> numColsPerNode(NumProc());
+        MPI_Allgather(&numLocalCols, 1, MPI_INT, numColsPerNode.data(), 1, MPI_INT, m_mpi->Communicator()) || MpiFail("MPI_Allgather");
+
+        std::vector<int> offsets(NumProc());
+        int numGatheredCols = 0;
+        for (size_t j = 0; j < NumProc(); j++)
+        {
+            offsets[j] = numGatheredCols;
+            numGatheredCols += numColsPerNode[j];
+        }
+        if (numGatheredCols == 0)
+            return;
+
+        std::vector<int> localColIds(m_sparseColIds.begin(), m_sparseColIds.end());
+        std::vector<int> gatheredColIds(numGatheredCols);
+        MPI_Allgatherv(localColIds.data(), numLocalCols, MPI_INT, gatheredColIds.data(), numColsPerNode.data(), offsets.data(), MPI_INT, m_mpi->Communicator()) || MpiFail("MPI_Allgatherv");
+
+        // The values are gathered in units of columns, which keeps the counts small enough for an int
+        MPI_Datatype columnType;
+        MPI_Type_contiguous((int) numRows, MPIWrapper::GetDataType(m_sparseValues.data()), &columnType) || MpiFail("MPI_Type_contiguous");
+        MPI_Type_commit(&columnType) || MpiFail("MPI_Type_commit");
+        std::vector<ElemType> gatheredValues((size_t) numGatheredCols * numRows);
+        MPI_Allgatherv(m_sparseValues.data(), numLocalCols, columnType, gatheredValues.data(), numColsPerNode.data(), offsets.data(), columnType, m_mpi->Communicator()) || MpiFail("MPI_Allgatherv");
+        MPI_Type_free(&columnType) || MpiFail("MPI_Type_free");
+
+        // Sum up the columns of the same id, in the order of the ids
+        std::vector<size_t> order(numGatheredCols);
+        for (size_t k = 0; k < order.size(); k++)
+            order[k] = k;
+        std::stable_sort(order.begin(), order.end(), [&gatheredColIds](size_t a, size_t b) { return gatheredColIds[a] < gatheredColIds[b]; });
+
+        m_sparseColIds.clear();
+        m_sparseValues.clear();
+        for (size_t k : order)
+        {
+            const ElemType* column = gatheredValues.data() + k * numRows;
+            if (m_sparseColIds.empty() || (m_sparseColIds.back() != (size_t) gatheredColIds[k]))
+            {
+                m_sparseColIds.push_back(gatheredColIds[k]);
+                m_sparseValues.insert(m_sparseValues.end(), column, column + numRows);
+            }
+            else
+            {
+                ElemType* sum = m_sparseValues.data() + m_sparseValues.size() - numRows;
+                for (size_t r = 0; r < numRows; r++)
+                    sum[r] += column[r];
+            }
+        }
+
+        gradient.SetMatrixFromBlockColFormat(m_sparseColIds.data(), m_sparseValues.data(), m_sparseColIds.size(), numRows, numCols);
+    }
+
+    // Sums the headers of all nodes on the main node, and sends the result back to all nodes.
+    void AggregateHeaders(DistGradHeader* headerCPU, size_t numGradMatrices)
+    {
+        // We use the same tags as AggregateGradientsImpl()
+        int headerTag = (int) numGradMatrices;
+        int aggregateHeaderTag = (int) (numGradMatrices + 1 + numGradMatrices);
+        if (m_mpi->IsMainNode())
+        {
+            std::vector<MPI_Request> recvHeaderRequests(NumProc() - 1);
+            for (size_t j = 0; j < NumProc() - 1; ++j)
+            {
+                int source = (j >= MyRank()) ? (j + 1) : j;
+                MPI_Irecv(m_recvHeaders[j], m_recvHeaders[j]->Size(), MPI_CHAR, source, headerTag, m_mpi->Communicator(), &(recvHeaderRequests[j])) || MpiFail("MPI_Irecv");
+            }
+
+            for (size_t numNodesHeadersReceivedFrom = 0; numNodesHeadersReceivedFrom < (NumProc() - 1); numNodesHeadersReceivedFrom++)
+            {
+                int idx = MPI_UNDEFINED;
+                MPI_Waitany(recvHeaderRequests.size(), recvHeaderRequests.data(), &idx, MPI_STATUS_IGNORE) || MpiFail("MPI_Waitany");
+                if (idx == MPI_UNDEFINED)
+                    LogicError("SimpleDistGradAggregator: missing gradient header.");
+
+                headerCPU->Aggregate(m_recvHeaders[idx], true);
+            }
+
+            std::vector<MPI_Request> sendAggHeaderRequests(NumProc() - 1);
+            for (size_t j = 0; j < NumProc() - 1; ++j)
+            {
+                int dest = (j >= MyRank()) ? (j + 1) : j;
+                MPI_Isend(headerCPU, headerCPU->Size(), MPI_CHAR, dest, aggregateHeaderTag, m_mpi->Communicator(), &(sendAggHeaderRequests[j])) || MpiFail("MPI_Isend");
+            }
+            MPI_Waitall(sendAggHeaderRequests.size(), sendAggHeaderRequests.data(), MPI_STATUSES_IGNORE) || MpiFail("MPI_Waitall");
+        }
+        else
+        {
+            MPI_Request request;
+            MPI_Isend(headerCPU, headerCPU->Size(), MPI_CHAR, m_mpi->MainNodeRank(), headerTag, m_mpi->Communicator(), &request) || MpiFail("MPI_Isend");
+            MPI_Wait(&request, MPI_STATUSES_IGNORE) || MpiFail("MPI_Wait");
+            MPI_Irecv(headerCPU, headerCPU->Size(), MPI_CHAR, m_mpi->MainNodeRank(), aggregateHeaderTag, m_mpi->Communicator(), &request) || MpiFail("MPI_Irecv");
+            MPI_Wait(&request, MPI_STATUSES_IGNORE) || MpiFail("MPI_Wait");
+        }
+    }
+
 private:
     std::unique_ptr<CUDAPageLockedMemAllocator> m_allocator;
     std::vector<std::shared_ptr<ElemType>> m_intermediateCPUBuffers;
@@ -390,5 +1005,52 @@ private:
     size_t m_iterationCount;
 
     int m_currentEpochNumber;
+
+    // Hand GPU gradients to a CUDA-aware MPI instead of staging them in host memory
+    bool m_useDeviceBuffers;
+
+    GradientAllReducer m_allReducer;
+
+    // see SetGradientOwners(), empty if all gradients are summed onto all nodes
+    std::vector<int> m_gradientOwners;
+
+    // Non-zero columns of a sparse gradient, kept to reuse their memory
+    std::vector<size_t> m_sparseColIds;
+    std::vector<ElemType> m_sparseValues;
+
+    // Compressors of the gradients that are exchanged compressed, nullptr for the others (empty without a compressor factory)
+    std::vector<std::unique_ptr<IGradientCompressor<ElemType>>> m_compressors;
+    std::vector<char> m_compressedGradient;
+    std::vector<char> m_compressedPacket;
+    std::vector<char> m_gatheredPackets;
+
+    // Bucketed aggregation
+    struct GradientBucket
+    {
+        GradientBucket()
+            : m_numElements(0), m_numPending(0), m_owner(-1)
+        {
+        }
+
+        std::vector<size_t> m_gradients;    // indices of the gradients in the bucket
+        std::vector<size_t> m_offsets;      // offsets of the gradients in the staging buffer, in elements
+        size_t m_numElements;
+        std::shared_ptr<ElemType> m_buffer; // CPU staging buffer
+        size_t m_numPending;                // gradients of the current aggregation that are not complete yet
+        int m_owner;                        // see GetGradientOwner()
+    };
+
+    size_t m_bucketSizeInBytes;
+    std::vector<GradientBucket> m_buckets;
+    std::vector<size_t> m_gradientToBucket;
+
+    // State of the current bucketed aggregation
+    std::vector<Matrix<ElemType>*> m_aggregatedGradients;
+    size_t m_nextBucket; // first bucket that is not started yet
+    std::future<void> m_communication;
+    std::mutex m_bucketsLock;
+    std::condition_variable m_bucketReady;
+    std::deque<size_t> m_readyBuckets; // started buckets, for the communication thread
+    bool m_noMoreBuckets;
 };
 } } }
@@ -38,13 +38,13 @@ public:
           m_traceLevel(traceLevel),
           m_maxSamplesInRAM(maxSamplesInRAM), 
           m_numSubminiBatches(numSubminiBatches), 
-          m_parallelRun(parallelRun), 
-          m_distGradAgg(nullptr),
-          m_gradHeader(nullptr)
+          m_parallelRun(parallelRun)
     {
     }
 
     // returns evaluation node values per sample determined by evalNodeNames (which can include both training and eval criterion nodes)
+    // In a parallel run the data is split over all nodes (in the reader if it supports distributed reading, by decimation of
+    // the minibatches otherwise), and the results are summed up across the nodes at the end. Progress is shown for the local part.
     vector<double> Evaluate(IDataReader* dataReader, const vector<wstring>& evalNodeNames, const size_t mbSize, const size_t testSize = requestDataSize)
     {
         // determine nodes to evaluate
@@ -107,11 +107,13 @@ public:
         for (int i = 0; i < evalResults.size(); i++)
             evalResultsLastMBs.push_back((ElemType) 0);
 
-        //TODO: we should add support for distributed reading
-        dataReader->StartMinibatchLoop(mbSize, 0, testSize);
+        bool useDistributedMBReading = m_parallelRun && dataReader->SupportsDistributedMBRead();
+        if (useDistributedMBReading)
+            dataReader->StartDistributedMinibatchLoop(mbSize, 0, g_mpi->CurrentNodeRank(), g_mpi->NumNodesInUse(), testSize);
+        else
+            dataReader->StartMinibatchLoop(mbSize, 0, testSize);
         m_net->StartEvaluateMinibatchLoop(evalNodes);
 
-        std::vector<Matrix<ElemType>*> learnParamsGradients;
         DataReaderHelpers::SubminibatchDispatcher<ElemType> smbDispatcher;
         size_t numSubminibatchesNeeded = DataReaderHelpers::GetNumSubminibatchesNeeded<ElemType>(dataReader, m_maxSamplesInRAM, m_numSubminiBatches, mbSize);
 
@@ -123,7 +125,7 @@ public:
 
         const size_t numIterationsBeforePrintingProgress = 100;
         size_t numItersSinceLastPrintOfProgress = 0;
-        while (DataReaderHelpers::GetMinibatchIntoNetwork<ElemType>(*dataReader, m_net, nullptr, false, m_parallelRun, inputMatrices, actualMBSize))
+        while (DataReaderHelpers::GetMinibatchIntoNetwork<ElemType>(*dataReader, m_net, nullptr, useDistributedMBReading, m_parallelRun, inputMatrices, actualMBSize))
         {
             size_t actualNumSubminibatches = numSubminibatchesNeeded <= 1 ? 1 : smbDispatcher.GetMinibatchIntoCache(*dataReader, *m_net, inputMatrices, numSubminibatchesNeeded);
             for (size_t ismb = 0; ismb < actualNumSubminibatches; ismb++)
@@ -147,52 +149,17 @@ public:
                 smbDispatcher.DoneWithCurrentMinibatch();
 
             size_t numSamplesWithLabel = m_net->GetNumSamplesWithLabel(actualMBSize);
-            size_t aggregateNumSamplesWithLabel = numSamplesWithLabel;
-            if (m_parallelRun)
-            {
-                if (m_gradHeader == nullptr)
-                {
-                    m_gradHeader = DistGradHeader::Create(evalNodes.size());
-                    m_distGradAgg = make_shared<SimpleDistGradAggregator<ElemType>>(g_mpi, false, m_traceLevel);
-                }
-
-                m_gradHeader->numEvalNode = evalNodes.size();
-                m_gradHeader->numSamples = actualMBSize;
-                m_gradHeader->numSamplesWithLabel = numSamplesWithLabel;
-                m_gradHeader->criterion = 0.0;
-                for (size_t i = 0; i < evalNodes.size(); i++)
-                    m_gradHeader->evalErrors[i] = evalNodes[i]->Get00Element();
-
-                // TODO: We are reusing the aggregation logic inside SimpleDistGradAggregator, which has a heavy dependency
-                // on the gradient matrix. At some point we should refacotr the aggregator class to be able to only calculating
-                // eval results and then remove this hack.
-                if (learnParamsGradients.size() == 0)
-                {
-                    Matrix<ElemType>* matrix = new Matrix<ElemType>((DEVICEID_TYPE)m_net->GetDeviceId());
-                    learnParamsGradients.push_back(matrix);
-                }
-
-                // Using SimpleDistAggregator for eval results only. At some point we should rename the class to be just
-                // IDistAggregator and SimpleDistAggregator.
-                m_distGradAgg->AggregateGradients(learnParamsGradients, m_gradHeader, 0);
-                aggregateNumSamplesWithLabel = m_gradHeader->numSamplesWithLabel;
-                for (size_t i = 0; i < evalResults.size(); i++)
-                    evalResults[i] += m_gradHeader->evalErrors[i];
-            }
-            else
+            for (int i = 0; i < evalNodes.size(); i++)
             {
-                for (int i = 0; i < evalNodes.size(); i++)
-                {
-                    evalResults[i] += (double)evalNodes[i]->Get00Element(); // criterionNode should be a scalar
-                }
+                evalResults[i] += (double)evalNodes[i]->Get00Element(); // criterionNode should be a scalar
             }
 
-            totalEpochSamples += aggregateNumSamplesWithLabel;
+            totalEpochSamples += numSamplesWithLabel;
             numMBsRun++;
 
             if (m_traceLevel > 0)
             {
-                numSamplesLastMBs += aggregateNumSamplesWithLabel;
+                numSamplesLastMBs += numSamplesWithLabel;
 
                 if (numMBsRun % m_numMBsToShowResult == 0)
                 {
@@ -230,6 +197,18 @@ public:
             DisplayEvalStatistics(lastMBsRun + 1, numMBsRun, numSamplesLastMBs, evalNodes, evalResults, evalResultsLastMBs);
         }
 
+        // sum up the results of all nodes
+        // Each node reads its share of the same minibatches, so the number of minibatches stays the local one.
+        if (m_parallelRun)
+        {
+            vector<double> accumulators(evalResults);
+            accumulators.push_back((double) totalEpochSamples);
+            g_mpi->AllReduce(accumulators);
+            for (size_t i = 0; i < evalResults.size(); i++)
+                evalResults[i] = accumulators[i];
+            totalEpochSamples = (size_t) accumulators[evalResults.size()];
+        }
+
         // final statistics
         for (int i = 0; i < evalResultsLastMBs.size(); i++)
             evalResultsLastMBs[i] = 0; // clear this since statistics display will subtract the previous value
@@ -289,8 +268,6 @@ protected:
     size_t m_numSubminiBatches;
     bool m_parallelRun;
 
-    shared_ptr<IDistGradAggregator<ElemType>> m_distGradAgg;
-    struct DistGradHeader* m_gradHeader;
     int m_traceLevel;
     void operator=(const SimpleEvaluator&); // (not assignable)
 };
@@ -16,7 +16,10 @@
 #include <stdexcept>
 #include <fstream>
 #include <cstdio>
+#include <thread>
+#include <exception>
 #include "ProgressTracing.h"
+#include "OutputQueue.h"
 
 using namespace std;
 
@@ -151,10 +154,11 @@ public:
         // clean up
     }
 
-    // pass this to WriteOutput() (to file-path, below) to specify how the output should be formatted
+    // pass this to WriteOutput() (to file-path, below) to specify how the output should be formatted and written
     struct WriteFormattingOptions
     {
         // How to interpret the data:
+        bool isBinary;                 // true: write the values in binary, see WriteBinaryChunk(); the options below are ignored
         bool isCategoryLabel;          // true: find max value in column and output the index instead of the entire vector
         std::wstring labelMappingFile; // optional dictionary for pretty-printing category labels
         bool transpose;                // true: one line per sample, each sample (column vector) forms one line; false: one column per sample
@@ -171,9 +175,11 @@ public:
         std::string sampleSeparator;   // and this between rows
         // Optional printf precision parameter:
         std::string precisionFormat;        // printf precision, e.g. ".2" to get a "%.2f"
+        // Writing:
+        size_t writeQueueSize;         // number of minibatches of outputs that may wait for the writer thread
 
         WriteFormattingOptions() :
-            isCategoryLabel(false), transpose(true), sequenceEpilogue("\n"), elementSeparator(" "), sampleSeparator("\n")
+            isBinary(false), isCategoryLabel(false), transpose(true), sequenceEpilogue("\n"), elementSeparator(" "), sampleSeparator("\n"), writeQueueSize(4)
         { }
 
         // Process -- replace newlines and all %s by the given string
@@ -188,6 +194,9 @@ public:
     };
 
     // TODO: Remove code dup with above function by creating a fake Writer object and then calling the other function.
+    // Formatting and writing happen on a background thread, which takes the outputs of up to 'writeQueueSize' minibatches
+    // from a queue, so that the forward passes do not wait for the disk. With several MPI ranks, each rank evaluates its
+    // share of the input and writes it to its own files, with a ".rank<n>" suffix.
     void WriteOutput(IDataReader& dataReader, size_t mbSize, std::wstring outputPath, const std::vector<std::wstring>& outputNodeNames, const WriteFormattingOptions & formattingOptions, size_t numOutputSamples = requestDataSize)
     {
         std::vector<ComputationNodeBasePtr> outputNodes = DetermineOutputNodes(outputNodeNames);
@@ -203,185 +212,284 @@ public:
         if (formattingOptions.isCategoryLabel && !formattingOptions.labelMappingFile.empty())
             File::LoadLabelFile(formattingOptions.labelMappingFile, labelMapping);
 
+        const bool isDistributed = g_mpi != nullptr && g_mpi->NumNodesInUse() > 1;
+        if (isDistributed && outputPath == L"-")
+            InvalidArgument("write: Output to stdout ('-') is not possible with several MPI ranks.");
+
         // open output files
         File::MakeIntermediateDirs(outputPath);
-        std::map<ComputationNodeBasePtr, shared_ptr<File>> outputStreams; // TODO: why does unique_ptr not work here? Complains about non-existent default_delete()
+        std::vector<shared_ptr<File>> outputStreams; // TODO: why does unique_ptr not work here? Complains about non-existent default_delete()
         for (auto & onode : outputNodes)
         {
             std::wstring nodeOutputPath = outputPath;
             if (nodeOutputPath != L"-")
                 nodeOutputPath += L"." + onode->NodeName();
-            auto f = make_shared<File>(nodeOutputPath, fileOptionsWrite | fileOptionsText);
-            outputStreams[onode] = f;
+            if (isDistributed)
+                nodeOutputPath += msra::strfun::wstrprintf(L".rank%d", (int) g_mpi->CurrentNodeRank());
+            outputStreams.push_back(make_shared<File>(nodeOutputPath, fileOptionsWrite | (formattingOptions.isBinary ? fileOptionsBinary : fileOptionsText)));
         }
 
         // evaluate with minibatches
-        dataReader.StartMinibatchLoop(mbSize, 0, numOutputSamples);
+        // Readers that cannot read a subset of the data read all of it, and each rank keeps its share of the parallel sequences.
+        const bool useDistributedMBReading = isDistributed && dataReader.SupportsDistributedMBRead();
+        if (useDistributedMBReading)
+            dataReader.StartDistributedMinibatchLoop(mbSize, 0, g_mpi->CurrentNodeRank(), g_mpi->NumNodesInUse(), numOutputSamples);
+        else
+            dataReader.StartMinibatchLoop(mbSize, 0, numOutputSamples);
 
         m_net->StartEvaluateMinibatchLoop(outputNodes);
 
-        size_t totalEpochSamples = 0;
-        size_t numMBsRun = 0;
-        size_t tempArraySize = 0;
-        ElemType* tempArray = nullptr;
-
-        for (auto & onode : outputNodes)
+        OutputQueue<std::vector<OutputChunk>> queue(formattingOptions.writeQueueSize);
+        std::thread writerThread([&]()
         {
-            FILE * f = *outputStreams[onode];
-            fprintfOrDie(f, "%s", formattingOptions.prologue.c_str());
-        }
-
-        char formatChar = !formattingOptions.isCategoryLabel ? 'f' : !formattingOptions.labelMappingFile.empty() ? 's' : 'u';
-        std::string valueFormatString = "%" + formattingOptions.precisionFormat + formatChar; // format string used in fprintf() for formatting the values
+            try
+            {
+                WriteOutputChunks(queue, outputNodes, outputStreams, formattingOptions, labelMapping);
+            }
+            catch (...)
+            {
+                queue.Fail(std::current_exception());
+            }
+        });
 
+        size_t totalEpochSamples = 0;
+        size_t numMBsRun = 0;
         size_t actualMBSize;
         const size_t numIterationsBeforePrintingProgress = 100;
         size_t numItersSinceLastPrintOfProgress = 0;
-        while (DataReaderHelpers::GetMinibatchIntoNetwork<ElemType>(dataReader, m_net, nullptr, false, false, inputMatrices, actualMBSize))
+        try
         {
-            ComputationNetwork::BumpEvalTimeStamp(inputNodes);
-
-            for (auto & onode : outputNodes)
+            while (DataReaderHelpers::GetMinibatchIntoNetwork<ElemType>(dataReader, m_net, nullptr, useDistributedMBReading, isDistributed, inputMatrices, actualMBSize))
             {
-                // compute the node value
-                // Note: Intermediate values are memoized, so in case of multiple output nodes, we only compute what has not been computed already.
-                m_net->ForwardProp(onode);
-
-                // get it (into a flat CPU-side vector)
-                Matrix<ElemType>& outputValues = dynamic_pointer_cast<ComputationNode<ElemType>>(onode)->Value();
-                outputValues.CopyToArray(tempArray, tempArraySize);
-
-                // sequence separator
-                FILE * f = *outputStreams[onode];
-                const auto sequenceSeparator = formattingOptions.Processed(onode->NodeName(), formattingOptions.sequenceSeparator);
-                const auto sequencePrologue  = formattingOptions.Processed(onode->NodeName(), formattingOptions.sequencePrologue);
-                const auto sequenceEpilogue  = formattingOptions.Processed(onode->NodeName(), formattingOptions.sequenceEpilogue);
-                const auto elementSeparator  = formattingOptions.Processed(onode->NodeName(), formattingOptions.elementSeparator);
-                const auto sampleSeparator   = formattingOptions.Processed(onode->NodeName(), formattingOptions.sampleSeparator);
-
-                // process all sequences one by one
-                auto pMBLayout = onode->GetMBLayout();
-                if (!pMBLayout) // no MBLayout: We are printing aggregates (or LearnableParameters?)
+                ComputationNetwork::BumpEvalTimeStamp(inputNodes);
+
+                std::vector<OutputChunk> chunks(outputNodes.size());
+                for (size_t n = 0; n < outputNodes.size(); n++)
                 {
-                    pMBLayout = make_shared<MBLayout>();
-                    pMBLayout->InitAsFrameMode(1); // treat this as if we have one single sample
+                    auto& onode = outputNodes[n];
+                    // compute the node value
+                    // Note: Intermediate values are memoized, so in case of multiple output nodes, we only compute what has not been computed already.
+                    m_net->ForwardProp(onode);
+
+                    // get it (into a flat CPU-side vector), with its layout, for the writer thread
+                    const Matrix<ElemType>& outputValues = dynamic_pointer_cast<ComputationNode<ElemType>>(onode)->Value();
+                    auto& chunk = chunks[n];
+                    chunk.m_numRows = outputValues.GetNumRows();
+                    chunk.m_values.resize(outputValues.GetNumElements());
+                    if (!chunk.m_values.empty())
+                        outputValues.CopySection(outputValues.GetNumRows(), outputValues.GetNumCols(), chunk.m_values.data(), outputValues.GetNumRows());
+                    chunk.m_layout = make_shared<MBLayout>();
+                    if (onode->GetMBLayout())
+                        chunk.m_layout->CopyFrom(onode->GetMBLayout());
+                    else // no MBLayout: We are printing aggregates (or LearnableParameters?)
+                        chunk.m_layout->InitAsFrameMode(1); // treat this as if we have one single sample
+                    chunk.m_isFirstMinibatch = numMBsRun == 0;
                 }
-                const auto& sequences = pMBLayout->GetAllSequences();
-                size_t colStride = pMBLayout->GetNumParallelSequences() * outputValues.GetNumRows(); // how to get from one column to the next
-                size_t width     = pMBLayout->GetNumTimeSteps();
-                for (size_t s = 0; s < sequences.size(); s++)
-                {
-                    const auto& seqInfo = sequences[s];
-                    size_t tBegin = seqInfo.tBegin >= 0     ? seqInfo.tBegin : 0;
-                    size_t tEnd   = seqInfo.tEnd   <= width ? seqInfo.tEnd   : width;
+                if (!queue.Push(std::move(chunks)))
+                    break; // the writer failed
 
-                    // current sequence is a matrix with 'colStride' beginning at the following pointer
-                    ElemType* pCurValue = tempArray + s * outputValues.GetNumRows() + seqInfo.tBegin;
+                totalEpochSamples += actualMBSize;
 
-                    if ((numMBsRun > 0 || s > 0) && !sequenceSeparator.empty())
-                        fprintfOrDie(f, "%s", sequenceSeparator.c_str());
-                    fprintfOrDie(f, "%s", sequencePrologue.c_str());
+                fprintf(stderr, "Minibatch[%lu]: ActualMBSize = %lu\n", ++numMBsRun, actualMBSize);
 
-                    // output it according to our format specification
-                    size_t dim = outputValues.GetNumRows();
-                    size_t T   = tEnd - tBegin;
-                    if (formattingOptions.isCategoryLabel)
-                    {
-                        if (formatChar == 's') // verify label dimension
-                        {
-                            if (outputValues.GetNumRows() != labelMapping.size())
-                                InvalidArgument("write: Row dimension %d does not match number of entries %d in labelMappingFile '%ls'", (int)dim, (int)labelMapping.size(), formattingOptions.labelMappingFile.c_str());
-                        }
-                        // update the matrix in-place from one-hot (or max) to index
-                        // find the max in each column
-                        for (size_t j = 0; j < T; j++)
-                        {
-                            double maxPos = -1;
-                            double maxVal = 0;
-                            for (size_t i = 0; i < dim; i++)
-                            {
-                                double val = pCurValue[i + j * dim * colStride];
-                                if (maxPos < 0 || val >= maxVal)
-                                {
-                                    maxPos = (double)i;
-                                    maxVal = val;
-                                }
-                            }
-                            pCurValue[0 + j * colStride] = (ElemType)maxPos; // overwrite first element in-place
-                        }
-                        dim = 1; // ignore remaining dimensions
-                    }
-                    size_t iend    = formattingOptions.transpose ?      dim  : T;
-                    size_t jend    = formattingOptions.transpose ?         T : dim;
-                    size_t istride = formattingOptions.transpose ?         1 : colStride;
-                    size_t jstride = formattingOptions.transpose ? colStride : 1;
-                    for (size_t j = 0; j < jend; j++)
+                if (ProgressTracing::GetTracingFlag())
+                {
+                    numItersSinceLastPrintOfProgress++;
+                    if (numItersSinceLastPrintOfProgress >= numIterationsBeforePrintingProgress)
                     {
-                        if (j > 0)
-                            fprintfOrDie(f, "%s", sampleSeparator.c_str());
-                        for (size_t i = 0; i < iend; i++)
-                        {
-                            if (i > 0)
-                                fprintfOrDie(f, "%s", elementSeparator.c_str());
-                            if (formatChar == 'f') // print as real number
-                            {
-                                double dval = pCurValue[i * istride + j * jstride];
-                                fprintfOrDie(f, valueFormatString.c_str(), dval);
-                            }
-                            else if (formatChar == 'u') // print category as integer index
-                            {
-                                unsigned int uval = (unsigned int) pCurValue[i * istride + j * jstride];
-                                fprintfOrDie(f, valueFormatString.c_str(), uval);
-                            }
-                            else if (formatChar == 's') // print category as a label string
-                            {
-                                size_t uval = (size_t) pCurValue[i * istride + j * jstride];
-                                assert(uval < labelMapping.size());
-                                const char * sval = labelMapping[uval].c_str();
-                                fprintfOrDie(f, valueFormatString.c_str(), sval);
-                            }
-                        }
+                        // TODO: For now just print 0.0 instead of calculating actual progress
+                        printf("PROGRESS: %.2f%%\n", 0.0f);
+                        numItersSinceLastPrintOfProgress = 0;
                     }
-                    fprintfOrDie(f, "%s", sequenceEpilogue.c_str());
-                } // end loop over sequences
-            } // end loop over nodes
+                }
 
-            totalEpochSamples += actualMBSize;
+                // call DataEnd function in dataReader to do
+                // reader specific process if sentence ending is reached
+                dataReader.DataEnd();
+            } // end loop over minibatches
+        }
+        catch (...)
+        {
+            queue.Fail(std::current_exception());
+        }
+        queue.Close();
+        writerThread.join();
+        queue.RethrowIfFailed();
 
-            fprintf(stderr, "Minibatch[%lu]: ActualMBSize = %lu\n", ++numMBsRun, actualMBSize);
+        fprintf(stderr, "Written to %ls*\nTotal Samples Evaluated = %lu\n", outputPath.c_str(), totalEpochSamples);
 
-            if (ProgressTracing::GetTracingFlag())
+        // flush all files (where we can catch errors) so that we can then destruct the handle cleanly without error
+        for (auto & stream : outputStreams)
+            stream->Flush();
+    }
+
+private:
+    // the output of one node in one minibatch, copied to the CPU
+    struct OutputChunk
+    {
+        size_t m_numRows;
+        std::vector<ElemType> m_values;
+        MBLayoutPtr m_layout;
+        bool m_isFirstMinibatch;
+    };
+
+    // the writer thread: formats and writes the outputs until the queue is closed
+    static void WriteOutputChunks(OutputQueue<std::vector<OutputChunk>>& queue, const std::vector<ComputationNodeBasePtr>& outputNodes, const std::vector<shared_ptr<File>>& outputStreams,
+                                  const WriteFormattingOptions& formattingOptions, const std::vector<std::string>& labelMapping)
+    {
+        for (size_t n = 0; n < outputNodes.size(); n++)
+        {
+            if (!formattingOptions.isBinary)
+                fprintfOrDie(*outputStreams[n], "%s", formattingOptions.prologue.c_str());
+        }
+
+        bool isFirstChunk = true;
+        std::vector<OutputChunk> chunks;
+        while (queue.Pop(chunks))
+        {
+            for (size_t n = 0; n < outputNodes.size(); n++)
             {
-                numItersSinceLastPrintOfProgress++;
-                if (numItersSinceLastPrintOfProgress >= numIterationsBeforePrintingProgress)
-                {
-                    // TODO: For now just print 0.0 instead of calculating actual progress
-                    printf("PROGRESS: %.2f%%\n", 0.0f);
-                    numItersSinceLastPrintOfProgress = 0;
-                }
+                FILE* f = *outputStreams[n];
+                if (formattingOptions.isBinary)
+                    WriteBinaryChunk(f, chunks[n], isFirstChunk);
+                else
+                    WriteTextChunk(f, outputNodes[n]->NodeName(), chunks[n], formattingOptions, labelMapping);
             }
+            isFirstChunk = false;
+        }
 
-            // call DataEnd function in dataReader to do
-            // reader specific process if sentence ending is reached
-            dataReader.DataEnd();
-        } // end loop over minibatches
+        for (size_t n = 0; n < outputNodes.size(); n++)
+        {
+            if (!formattingOptions.isBinary)
+                fprintfOrDie(*outputStreams[n], "%s", formattingOptions.epilogue.c_str());
+        }
+    }
 
-        for (auto & onode : outputNodes)
+    // Binary output format, per node: a header of the 8 characters "CNTKOUT1", the element size as a uint32 (4 for float,
+    // 8 for double), a uint32 0, and the dimension as a uint64; then for each sequence the number of samples as a uint64,
+    // followed by its samples, each 'dimension' elements.
+    static void WriteBinaryChunk(FILE* f, const OutputChunk& chunk, bool isFirstChunk)
+    {
+        if (isFirstChunk)
         {
-            FILE * f = *outputStreams[onode];
-            fprintfOrDie(f, "%s", formattingOptions.epilogue.c_str());
+            fwriteOrDie("CNTKOUT1", 1, 8, f);
+            uint32_t header[2] = {(uint32_t) sizeof(ElemType), 0};
+            fwriteOrDie(header, sizeof(header), 1, f);
+            uint64_t dim = chunk.m_numRows;
+            fwriteOrDie(&dim, sizeof(dim), 1, f);
         }
 
-        delete[] tempArray;
+        const size_t dim = chunk.m_numRows;
+        const size_t numParallelSequences = chunk.m_layout->GetNumParallelSequences();
+        const size_t width = chunk.m_layout->GetNumTimeSteps();
+        for (const auto& seqInfo : chunk.m_layout->GetAllSequences())
+        {
+            if (seqInfo.seqId == GAP_SEQUENCE_ID)
+                continue;
+            size_t tBegin = seqInfo.tBegin >= 0 ? seqInfo.tBegin : 0;
+            size_t tEnd = seqInfo.tEnd <= width ? seqInfo.tEnd : width;
+            uint64_t numSamples = tEnd - tBegin;
+            fwriteOrDie(&numSamples, sizeof(numSamples), 1, f);
+            for (size_t t = tBegin; t < tEnd; t++) // the samples of a sequence are interleaved with the other parallel sequences
+                fwriteOrDie(chunk.m_values.data() + (t * numParallelSequences + seqInfo.s) * dim, sizeof(ElemType), dim, f);
+        }
+    }
 
-        fprintf(stderr, "Written to %ls*\nTotal Samples Evaluated = %lu\n", outputPath.c_str(), totalEpochSamples);
+    static void WriteTextChunk(FILE* f, const std::wstring& nodeName, OutputChunk& chunk, const WriteFormattingOptions& formattingOptions, const std::vector<std::string>& labelMapping)
+    {
+        char formatChar = !formattingOptions.isCategoryLabel ? 'f' : !formattingOptions.labelMappingFile.empty() ? 's' : 'u';
+        std::string valueFormatString = "%" + formattingOptions.precisionFormat + formatChar; // format string used in fprintf() for formatting the values
 
-        // flush all files (where we can catch errors) so that we can then destruct the handle cleanly without error
-        for (auto & iter : outputStreams)
-            iter.second->Flush();
+        // sequence separator
+        const auto sequenceSeparator = formattingOptions.Processed(nodeName, formattingOptions.sequenceSeparator);
+        const auto sequencePrologue  = formattingOptions.Processed(nodeName, formattingOptions.sequencePrologue);
+        const auto sequenceEpilogue  = formattingOptions.Processed(nodeName, formattingOptions.sequenceEpilogue);
+        const auto elementSeparator  = formattingOptions.Processed(nodeName, formattingOptions.elementSeparator);
+        const auto sampleSeparator   = formattingOptions.Processed(nodeName, formattingOptions.sampleSeparator);
+
+        // process all sequences one by one
+        ElemType* tempArray = chunk.m_values.data();
+        const auto& pMBLayout = chunk.m_layout;
+        const auto& sequences = pMBLayout->GetAllSequences();
+        size_t colStride = pMBLayout->GetNumParallelSequences() * chunk.m_numRows; // how to get from one column to the next
+        size_t width     = pMBLayout->GetNumTimeSteps();
+        for (size_t s = 0; s < sequences.size(); s++)
+        {
+            const auto& seqInfo = sequences[s];
+            size_t tBegin = seqInfo.tBegin >= 0     ? seqInfo.tBegin : 0;
+            size_t tEnd   = seqInfo.tEnd   <= width ? seqInfo.tEnd   : width;
+
+            // current sequence is a matrix with 'colStride' beginning at the following pointer
+            ElemType* pCurValue = tempArray + s * chunk.m_numRows + seqInfo.tBegin;
+
+            if ((!chunk.m_isFirstMinibatch || s > 0) && !sequenceSeparator.empty())
+                fprintfOrDie(f, "%s", sequenceSeparator.c_str());
+            fprintfOrDie(f, "%s", sequencePrologue.c_str());
+
+            // output it according to our format specification
+            size_t dim = chunk.m_numRows;
+            size_t T   = tEnd - tBegin;
+            if (formattingOptions.isCategoryLabel)
+            {
+                if (formatChar == 's') // verify label dimension
+                {
+                    if (chunk.m_numRows != labelMapping.size())
+                        InvalidArgument("write: Row dimension %d does not match number of entries %d in labelMappingFile '%ls'", (int)dim, (int)labelMapping.size(), formattingOptions.labelMappingFile.c_str());
+                }
+                // update the matrix in-place from one-hot (or max) to index
+                // find the max in each column
+                for (size_t j = 0; j < T; j++)
+                {
+                    double maxPos = -1;
+                    double maxVal = 0;
+                    for (size_t i = 0; i < dim; i++)
+                    {
+                        double val = pCurValue[i + j * dim * colStride];
+                        if (maxPos < 0 || val >= maxVal)
+                        {
+                            maxPos = (double)i;
+                            maxVal = val;
+                        }
+                    }
+                    pCurValue[0 + j * colStride] = (ElemType)maxPos; // overwrite first element in-place
+                }
+                dim = 1; // ignore remaining dimensions
+            }
+            size_t iend    = formattingOptions.transpose ?      dim  : T;
+            size_t jend    = formattingOptions.transpose ?         T : dim;
+            size_t istride = formattingOptions.transpose ?         1 : colStride;
+            size_t jstride = formattingOptions.transpose ? colStride : 1;
+            for (size_t j = 0; j < jend; j++)
+            {
+                if (j > 0)
+                    fprintfOrDie(f, "%s", sampleSeparator.c_str());
+                for (size_t i = 0; i < iend; i++)
+                {
+                    if (i > 0)
+                        fprintfOrDie(f, "%s", elementSeparator.c_str());
+                    if (formatChar == 'f') // print as real number
+                    {
+                        double dval = pCurValue[i * istride + j * jstride];
+                        fprintfOrDie(f, valueFormatString.c_str(), dval);
+                    }
+                    else if (formatChar == 'u') // print category as integer index
+                    {
+                        unsigned int uval = (unsigned int) pCurValue[i * istride + j * jstride];
+                        fprintfOrDie(f, valueFormatString.c_str(), uval);
+                    }
+                    else if (formatChar == 's') // print category as a label string
+                    {
+                        size_t uval = (size_t) pCurValue[i * istride + j * jstride];
+                        assert(uval < labelMapping.size());
+                        const char * sval = labelMapping[uval].c_str();
+                        fprintfOrDie(f, valueFormatString.c_str(), sval);
+                    }
+                }
+            }
+            fprintfOrDie(f, "%s", sequenceEpilogue.c_str());
+        } // end loop over sequences
     }
 
-private:
     ComputationNetworkPtr m_net;
     int m_verbosity;
     void operator=(const SimpleOutputWriter&); // (not assignable)
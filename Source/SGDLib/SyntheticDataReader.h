@@ -0,0 +1,159 @@
+// SyntheticDataReader.h -- a reader that replays a few recorded minibatches from host memory, to benchmark without I/O
+
+#pragma once
+
+#include "Basics.h"
+#include "DataReader.h"
+#include "Matrix.h"
+#include "Sequences.h"
+#include <memory>
+#include <string>
+#include <vector>
+#include <map>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// -----------------------------------------------------------------------
+// SyntheticDataReader -- wraps the training reader of the "benchmark" action
+//
+// The first 'numRecordedMBs' minibatches of a minibatch loop are read from the wrapped reader, and kept in host memory
+// with their MBLayouts. Then, and in every later loop with the same minibatch size and subset, they are replayed over
+// and over, until the loop has delivered 'maxMBsPerLoop' minibatches. A replayed minibatch is copied to the device of
+// the input matrices, so the host-to-device transfer of a real reader remains, but its I/O and decoding do not.
+// Unlike CachingDataReader, which replays exact passes, this ignores the epoch and its size.
+// Readers that deliver more than matrices and a layout (lattices for sequence training) are not supported.
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+class SyntheticDataReader : public IDataReader
+{
+public:
+    SyntheticDataReader(IDataReader* reader, size_t numRecordedMBs, size_t maxMBsPerLoop)
+        : m_reader(reader), m_numRecordedMBs(max(numRecordedMBs, (size_t) 1)), m_maxMBsPerLoop(maxMBsPerLoop), m_recording(nullptr), m_isRecording(false), m_numMBsInLoop(0)
+    {
+        m_seed = reader->m_seed;
+        mRequestedNumParallelSequences = reader->mRequestedNumParallelSequences;
+    }
+
+    virtual void Init(const ConfigParameters&) override { LogicError("SyntheticDataReader: Init() is not supported, it wraps an initialized reader."); }
+    virtual void Init(const ScriptableObjects::IConfigRecord&) override { LogicError("SyntheticDataReader: Init() is not supported, it wraps an initialized reader."); }
+    virtual void Destroy() override { } // the wrapped reader is owned by the caller
+
+    virtual void StartMinibatchLoop(size_t mbSize, size_t epoch, size_t requestedEpochSamples = requestDataSize) override
+    {
+        if (StartLoop(LoopKey(mbSize, 0, 1)))
+            m_reader->StartMinibatchLoop(mbSize, epoch, requestedEpochSamples);
+    }
+
+    virtual bool SupportsDistributedMBRead() const override { return m_reader->SupportsDistributedMBRead(); }
+
+    virtual void StartDistributedMinibatchLoop(size_t mbSize, size_t epoch, size_t subsetNum, size_t numSubsets, size_t requestedEpochSamples = requestDataSize) override
+    {
+        if (StartLoop(LoopKey(mbSize, subsetNum, numSubsets)))
+            m_reader->StartDistributedMinibatchLoop(mbSize, epoch, subsetNum, numSubsets, requestedEpochSamples);
+    }
+
+    virtual bool GetMinibatch(StreamMinibatchInputs& matrices) override
+    {
+        if (m_numMBsInLoop >= m_maxMBsPerLoop)
+            return false;
+
+        if (m_isRecording && m_recording->size() < m_numRecordedMBs && m_reader->GetMinibatch(matrices))
+        {
+            Minibatch minibatch;
+            for (const auto& input : matrices)
+            {
+                const auto& matrix = matrices.GetInputMatrix<ElemType>(input.first);
+                minibatch.m_inputs[input.first] = make_shared<Matrix<ElemType>>(matrix, CPUDEVICE); // deep copy
+            }
+            minibatch.m_layout = make_shared<MBLayout>();
+            m_reader->CopyMBLayoutTo(minibatch.m_layout);
+            m_recording->push_back(minibatch);
+            m_currentLayout = minibatch.m_layout;
+            m_numMBsInLoop++;
+            return true;
+        }
+        // the recording is complete, or the wrapped reader has no more data
+        m_isRecording = false;
+        if (m_recording->empty())
+            return false;
+
+        const auto& minibatch = (*m_recording)[m_numMBsInLoop % m_recording->size()];
+        for (const auto& input : minibatch.m_inputs)
+        {
+            auto& matrix = matrices.GetInputMatrix<ElemType>(input.first);
+            Matrix<ElemType> onDevice(*input.second); // the copy to the device moves its argument
+            onDevice.TransferToDeviceIfNotThere(matrix.GetDeviceId(), /*isBeingMoved=*/true);
+            matrix.SetValue(onDevice, onDevice.GetFormat());
+        }
+        m_currentLayout = minibatch.m_layout;
+        m_numMBsInLoop++;
+        return true;
+    }
+
+    virtual void CopyMBLayoutTo(MBLayoutPtr pMBLayout) override
+    {
+        if (!m_currentLayout)
+            LogicError("SyntheticDataReader: CopyMBLayoutTo() called before a minibatch was read.");
+        pMBLayout->CopyFrom(m_currentLayout);
+    }
+
+    virtual bool DataEnd() override { return m_numMBsInLoop >= m_maxMBsPerLoop; }
+
+    virtual size_t GetNumParallelSequences() override { return m_reader->GetNumParallelSequences(); }
+    virtual void SetNumParallelSequences(const size_t sz) override { m_reader->SetNumParallelSequences(sz); }
+
+    virtual const std::map<LabelIdType, LabelType>& GetLabelMapping(const std::wstring& sectionName) override { return m_reader->GetLabelMapping(sectionName); }
+    virtual void SetLabelMapping(const std::wstring& sectionName, const std::map<LabelIdType, LabelType>& labelMapping) override { m_reader->SetLabelMapping(sectionName, labelMapping); }
+    virtual bool CanReadFor(wstring nodeName) override { return m_reader->CanReadFor(nodeName); }
+
+    virtual bool GetMinibatch4SE(std::vector<shared_ptr<const msra::dbn::latticepair>>&, vector<size_t>&, vector<size_t>&, vector<size_t>&) override
+    {
+        LogicError("SyntheticDataReader: Sequence training cannot be benchmarked with synthetic data.");
+    }
+    virtual bool GetHmmData(msra::asr::simplesenonehmm* hmm) override { return m_reader->GetHmmData(hmm); }
+
+private:
+    struct LoopKey
+    {
+        LoopKey(size_t mbSize, size_t subsetNum, size_t numSubsets)
+            : m_mbSize(mbSize), m_subsetNum(subsetNum), m_numSubsets(numSubsets) { }
+        bool operator<(const LoopKey& other) const
+        {
+            if (m_mbSize != other.m_mbSize)
+                return m_mbSize < other.m_mbSize;
+            if (m_subsetNum != other.m_subsetNum)
+                return m_subsetNum < other.m_subsetNum;
+            return m_numSubsets < other.m_numSubsets;
+        }
+        size_t m_mbSize, m_subsetNum, m_numSubsets;
+    };
+
+    struct Minibatch
+    {
+        std::map<std::wstring, shared_ptr<Matrix<ElemType>>> m_inputs; // [node name], on the CPU
+        MBLayoutPtr m_layout;
+    };
+
+    // returns true if the loop must be read from the wrapped reader
+    bool StartLoop(const LoopKey& key)
+    {
+        m_currentLayout = nullptr;
+        m_numMBsInLoop = 0;
+        auto iter = m_recordings.find(key);
+        m_isRecording = (iter == m_recordings.end());
+        m_recording = &m_recordings[key];
+        return m_isRecording;
+    }
+
+    IDataReader* m_reader;
+    size_t m_numRecordedMBs;
+    size_t m_maxMBsPerLoop;
+    std::map<LoopKey, std::vector<Minibatch>> m_recordings;
+    std::vector<Minibatch>* m_recording; // of the current loop
+    bool m_isRecording;
+    size_t m_numMBsInLoop;               // delivered in the current loop
+    MBLayoutPtr m_currentLayout;         // of the last minibatch returned
+};
+
+} } }
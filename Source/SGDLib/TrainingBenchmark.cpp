@@ -0,0 +1,156 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#include "TrainingBenchmark.h"
+#include "CUDACachingMemAllocator.h"
+#include <stdio.h>
+#ifdef _WIN32
+#include <Windows.h>
+#include <Psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// the high-water mark of the memory of the process; 0 if unknown
+static size_t GetPeakHostMemoryBytes()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return counters.PeakWorkingSetSize;
+    return 0;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0)
+        return (size_t) usage.ru_maxrss * 1024; // (in kB)
+    return 0;
+#endif
+}
+
+static const char* PhaseName(TrainingBenchmark::Phase phase)
+{
+    switch (phase)
+    {
+    case TrainingBenchmark::Phase::Reader:       return "reader";
+    case TrainingBenchmark::Phase::HostToDevice: return "host to device";
+    case TrainingBenchmark::Phase::Forward:      return "forward";
+    case TrainingBenchmark::Phase::Backward:     return "backward";
+    case TrainingBenchmark::Phase::Aggregation:  return "aggregation";
+    case TrainingBenchmark::Phase::Update:       return "update";
+    }
+    return "?";
+}
+
+TrainingBenchmark::TrainingBenchmark(size_t numWarmupMBs, size_t numMeasuredMBs, bool synchronizePhases, bool isSyntheticData)
+    : m_numWarmupMBs(numWarmupMBs),
+      m_numMeasuredMBs(numMeasuredMBs),
+      m_synchronizePhases(synchronizePhases),
+      m_isSyntheticData(isSyntheticData),
+      m_deviceId(CPUDEVICE),
+      m_numMBs(0),
+      m_numSamples(0)
+{
+    if (numMeasuredMBs == 0)
+        InvalidArgument("TrainingBenchmark: At least one minibatch must be measured.");
+    for (size_t k = 0; k < s_numPhases; k++)
+        m_phaseSeconds[k] = 0;
+}
+
+void TrainingBenchmark::SetDevice(DEVICEID_TYPE deviceId)
+{
+    m_deviceId = deviceId;
+    m_deviceEvent.reset(deviceId >= 0 ? new ComputeEventTimer(deviceId) : nullptr);
+}
+
+void TrainingBenchmark::Synchronize()
+{
+    if (!m_deviceEvent)
+        return;
+    m_deviceEvent->Record(0);
+    m_deviceEvent->Synchronize(0);
+}
+
+void TrainingBenchmark::BeginMinibatch()
+{
+    // the measurement starts with the work of the warmup completed
+    if (m_numMBs == m_numWarmupMBs)
+        Synchronize();
+    m_lastMark = Clock::now();
+    if (m_numMBs == m_numWarmupMBs)
+        m_measureBegin = m_lastMark;
+}
+
+void TrainingBenchmark::EndPhase(Phase phase, bool waitForDevice)
+{
+    if (!IsMeasuring())
+        return;
+    if (m_synchronizePhases && waitForDevice)
+        Synchronize();
+    auto now = Clock::now();
+    // the replayed minibatches are already in host memory, what the reader does is the copy
+    if (phase == Phase::Reader && m_isSyntheticData)
+        phase = Phase::HostToDevice;
+    m_phaseSeconds[(size_t) phase] += SecondsBetween(m_lastMark, now);
+    m_lastMark = now;
+}
+
+void TrainingBenchmark::EndMinibatch(size_t numSamples)
+{
+    if (!IsMeasuring())
+    {
+        m_numMBs++;
+        return;
+    }
+    // with synchronized phases, the work issued after the last one is completed here, and counts as 'other'
+    m_numSamples += numSamples;
+    m_numMBs++;
+    if (IsDone() || m_synchronizePhases)
+        Synchronize();
+    if (IsDone())
+        m_measureEnd = Clock::now();
+}
+
+void TrainingBenchmark::PrintReport() const
+{
+    if (!IsDone())
+    {
+        fprintf(stderr, "\nBenchmark: The training ended after %d of %d minibatches, nothing was measured.\n",
+                (int) m_numMBs, (int) (m_numWarmupMBs + m_numMeasuredMBs));
+        return;
+    }
+
+    const double totalSeconds = SecondsBetween(m_measureBegin, m_measureEnd);
+    fprintf(stderr, "\nBenchmark: %d minibatches after %d warmup minibatches, %s, %s.\n",
+            (int) m_numMeasuredMBs, (int) m_numWarmupMBs,
+            m_synchronizePhases ? "device synchronized after each phase" : "phases not synchronized (host time only)",
+            m_isSyntheticData ? "synthetic data replayed from host memory" : "data from the reader");
+    fprintf(stderr, "Benchmark: %d samples in %.3f seconds: %.1f samples per second, %.3f ms per minibatch\n",
+            (int) m_numSamples, totalSeconds, totalSeconds > 0 ? m_numSamples / totalSeconds : 0.0, totalSeconds * 1000 / m_numMeasuredMBs);
+
+    double attributedSeconds = 0;
+    for (size_t k = 0; k < s_numPhases; k++)
+    {
+        fprintf(stderr, "Benchmark:     %-16s %10.3f ms per minibatch  %5.1f%%\n",
+                PhaseName((Phase) k), m_phaseSeconds[k] * 1000 / m_numMeasuredMBs, totalSeconds > 0 ? 100 * m_phaseSeconds[k] / totalSeconds : 0.0);
+        attributedSeconds += m_phaseSeconds[k];
+    }
+    // logging, criteria, and the time between epochs
+    const double otherSeconds = max(totalSeconds - attributedSeconds, 0.0);
+    fprintf(stderr, "Benchmark:     %-16s %10.3f ms per minibatch  %5.1f%%\n",
+            "other", otherSeconds * 1000 / m_numMeasuredMBs, totalSeconds > 0 ? 100 * otherSeconds / totalSeconds : 0.0);
+
+    fprintf(stderr, "Benchmark: peak host memory %.1f MB", GetPeakHostMemoryBytes() / 1e6);
+    if (m_deviceId >= 0 && CUDACachingMemAllocator::IsEnabled())
+    {
+        const auto stats = CUDACachingMemAllocator::ForDevice(m_deviceId).GetStatistics();
+        fprintf(stderr, ", peak GPU %d memory %.1f MB in use, %.1f MB reserved", (int) m_deviceId, stats.m_peakBytesInUse / 1e6, stats.m_peakBytesReserved / 1e6);
+    }
+    else if (m_deviceId >= 0)
+        fprintf(stderr, ", peak GPU memory unknown (the caching allocator is disabled)");
+    fprintf(stderr, "\n");
+}
+
+} } }
@@ -0,0 +1,76 @@
+// TrainingBenchmark.h -- measures the steady-state training throughput, and where the time of a minibatch goes
+
+#pragma once
+
+#include "Basics.h"
+#include "ComputeEventTimer.h"
+#include <chrono>
+#include <memory>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// -----------------------------------------------------------------------
+// TrainingBenchmark -- the measurements of the "benchmark" action, taken by SGD::TrainOneEpoch()
+//
+// The first 'numWarmupMBs' minibatches are not measured (memory allocation, convolution autotuning, the reader filling
+// its caches); the next 'numMeasuredMBs' are, then the training stops. The device is synchronized where the measurement
+// starts and ends, so the throughput is that of completed work. The time of a minibatch is split into phases at the
+// points where SGD moves from one to the next. With 'synchronizePhases' the device is synchronized at each of them,
+// which attributes the GPU time to the phase that issued the work, at the price of the overlap between phases.
+// Without, a phase only gets the host time of issuing its work, and the throughput is that of a normal training.
+// -----------------------------------------------------------------------
+
+class TrainingBenchmark
+{
+public:
+    enum class Phase
+    {
+        Reader,       // the reader delivering the minibatch, on the host
+        HostToDevice, // the part of the copy to the device that is still running when the reader returns
+        Forward,
+        Backward,     // including updates and aggregation that are overlapped with it
+        Aggregation,  // of the gradients or models by the workers
+        Update,
+    };
+    static const size_t s_numPhases = 6;
+
+    TrainingBenchmark(size_t numWarmupMBs, size_t numMeasuredMBs, bool synchronizePhases, bool isSyntheticData);
+
+    // the device the network is on, before the first minibatch
+    void SetDevice(DEVICEID_TYPE deviceId);
+
+    void BeginMinibatch();
+    // the time since the previous phase ended (or the minibatch began) belongs to 'phase'
+    // With 'synchronizePhases', the device is synchronized first, unless 'waitForDevice' is false.
+    void EndPhase(Phase phase, bool waitForDevice = true);
+    // 'numSamples' are those of all workers
+    void EndMinibatch(size_t numSamples);
+
+    bool IsMeasuring() const { return m_numMBs >= m_numWarmupMBs && !IsDone(); }
+    bool IsDone() const { return m_numMBs >= m_numWarmupMBs + m_numMeasuredMBs; }
+
+    void PrintReport() const;
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    void Synchronize();
+    static double SecondsBetween(Clock::time_point from, Clock::time_point to) { return std::chrono::duration<double>(to - from).count(); }
+
+    size_t m_numWarmupMBs;
+    size_t m_numMeasuredMBs;
+    bool m_synchronizePhases;
+    bool m_isSyntheticData;
+
+    DEVICEID_TYPE m_deviceId;
+    std::unique_ptr<ComputeEventTimer> m_deviceEvent; // event 0 to synchronize on; null on the CPU
+
+    size_t m_numMBs;     // completed, including the warmup
+    size_t m_numSamples; // of the measured minibatches
+    double m_phaseSeconds[s_numPhases];
+    Clock::time_point m_lastMark;     // the end of the previous phase
+    Clock::time_point m_measureBegin; // of the first measured minibatch
+    Clock::time_point m_measureEnd;   // of the last one
+};
+
+} } }
@@ -19,6 +19,8 @@ struct SeqGammarCalParam
     double wp;
     double bMMIfactor;
     bool sMBRmode;
+    size_t latticeCacheSizeMB; // GPU memory for keeping lattices across minibatches; 0 disables the cache
+    double latticePruneBeam;   // log-posterior beam for pruning each lattice after its first forward-backward (GPU only); 0 disables pruning
     SeqGammarCalParam()
     {
         amf = 14.0;
@@ -26,6 +28,8 @@ struct SeqGammarCalParam
         wp = 0.0;
         bMMIfactor = 0.0;
         sMBRmode = false;
+        latticeCacheSizeMB = 0;
+        latticePruneBeam = 0;
     }
 };
 
@@ -44,6 +48,8 @@ public:
         amf = 7.0f;
         boostmmifactor = 0.0f;
         seqsMBRmode = false;
+        latticecachesizemb = 0;
+        latticeprunebeam = 0;
     }
     ~GammaCalculation()
     {
@@ -64,7 +70,10 @@ public:
             parallellattice.setdevice(DeviceId);
 
             if (parallellattice.enabled())                             // send hmm set to GPU if GPU computation enabled
+            {
                 parallellattice.entercomputation(m_hset, mbrclassdef); // cache senone2classmap if mpemode
+                parallellattice.setlatticecachesize(latticecachesizemb << 20);
+            }
             initialmark = true;
         }
     }
@@ -79,6 +88,10 @@ public:
         wp = (float) gammarParam.wp;
         seqsMBRmode = gammarParam.sMBRmode;
         boostmmifactor = (float) gammarParam.bMMIfactor;
+        latticecachesizemb = gammarParam.latticeCacheSizeMB;
+        latticeprunebeam = gammarParam.latticePruneBeam;
+        if (initialmark && parallellattice.enabled())
+            parallellattice.setlatticecachesize(latticecachesizemb << 20);
     }
 
     // ========================================
@@ -95,6 +108,13 @@ public:
                        std::vector<size_t>& extrauttmap,
                        bool doreferencealign)
     {
+        if (m_deviceid != CPUDEVICE)
+        {
+            calgammaformbbatch(functionValues, lattices, loglikelihood, labels, gammafromlattice, uids, boundaries,
+                               samplesInRecurrentStep, pMBLayout, extrauttmap, doreferencealign);
+            return;
+        }
+
         // check total frame number to be added ?
         // int deviceid = loglikelihood.GetDeviceId();
         size_t boundaryframenum;
@@ -248,6 +268,184 @@ public:
     }
 
 private:
+    // calgammaformb() on the GPU: the lattices of the minibatch go through one batched forward-backward
+    // (see lattice::forwardbackwardbatch()); the logLLs and gammas are gathered into, resp. scattered from, one
+    // contiguous matrix of all utterances, and read to the host once
+    void calgammaformbbatch(Microsoft::MSR::CNTK::Matrix<ElemType>& functionValues,
+                            std::vector<shared_ptr<const msra::dbn::latticepair>>& lattices,
+                            const Microsoft::MSR::CNTK::Matrix<ElemType>& loglikelihood,
+                            Microsoft::MSR::CNTK::Matrix<ElemType>& labels,
+                            Microsoft::MSR::CNTK::Matrix<ElemType>& gammafromlattice,
+                            std::vector<size_t>& uids, std::vector<size_t>& boundaries,
+                            size_t samplesInRecurrentStep,
+                            std::shared_ptr<Microsoft::MSR::CNTK::MBLayout> pMBLayout,
+                            std::vector<size_t>& extrauttmap,
+                            bool doreferencealign)
+    {
+        size_t numrows = loglikelihood.GetNumRows();
+        size_t numcols = loglikelihood.GetNumCols();
+        if (numcols > pred.cols())
+        {
+            pred.resize(numrows, numcols);
+            dengammas.resize(numrows, numcols);
+        }
+
+        if (doreferencealign)
+            labels.SetValue((ElemType)(0.0f));
+
+        size_t T = numcols / samplesInRecurrentStep; // number of time steps in minibatch
+        if (samplesInRecurrentStep > 1)
+        {
+            assert(extrauttmap.size() == lattices.size());
+            assert(T == pMBLayout->GetNumTimeSteps());
+        }
+
+        // locate the utterances: parallel sequence and first time step of each
+        std::vector<size_t> validframes(samplesInRecurrentStep, 0); // [s] cursor pointing to next utterance begin within a single parallel sequence [s]
+        std::vector<size_t> uttmapi(lattices.size(), 0);
+        std::vector<size_t> uttbegin(lattices.size(), 0);
+        std::vector<const msra::lattices::lattice*> latticeptrs(lattices.size());
+        bool prunenew = false; // some lattice has not been pruned yet
+        size_t totalframes = 0;
+        for (size_t i = 0; i < lattices.size(); i++)
+        {
+            const size_t numframes = lattices[i]->getnumframes();
+            if (samplesInRecurrentStep > 1)
+            {
+                const size_t mapi = extrauttmap[i];
+                size_t mapframenum = SIZE_MAX; // duration of utterance [i] as determined from MBLayout
+                for (size_t t = validframes[mapi]; t < T; t++)
+                {
+                    if (pMBLayout->IsEnd(mapi, t))
+                    {
+                        mapframenum = t - validframes[mapi] + 1;
+                        break;
+                    }
+                }
+                if (numframes != mapframenum)
+                    LogicError("gammacalculation: IsEnd() not working, numframes (%d) vs. mapframenum (%d)", (int) numframes, (int) mapframenum);
+                uttmapi[i] = mapi;
+                uttbegin[i] = validframes[mapi];
+                validframes[mapi] += numframes;
+            }
+            latticeptrs[i] = &lattices[i]->second;
+            if (latticeprunebeam > 0)
+            {
+                auto pruned = prunedlattices.find(lattices[i]->getkey());
+                if (pruned == prunedlattices.end())
+                    prunenew = true;
+                else if (pruned->second)
+                    latticeptrs[i] = pruned->second.get();
+            }
+            totalframes += numframes;
+        }
+
+        // gather the logLLs of all utterances, and copy them to the host once
+        Microsoft::MSR::CNTK::Matrix<ElemType> batchmatrix(m_deviceid);
+        if (samplesInRecurrentStep == 1)
+            batchmatrix = loglikelihood.ColumnSlice(0, totalframes);
+        else
+        {
+            batchmatrix.Resize(numrows, totalframes);
+            size_t ts = 0;
+            for (size_t i = 0; i < lattices.size(); i++)
+            {
+                const size_t numframes = lattices[i]->getnumframes();
+                Microsoft::MSR::CNTK::Matrix<ElemType> loglikelihoodForCurrentParallelUtterance = loglikelihood.ColumnSlice(uttmapi[i] + (uttbegin[i] * samplesInRecurrentStep), ((numframes - 1) * samplesInRecurrentStep) + 1);
+                Microsoft::MSR::CNTK::Matrix<ElemType> batchstripe = batchmatrix.ColumnSlice(ts, numframes);
+                batchstripe.CopyColumnsStrided(loglikelihoodForCurrentParallelUtterance, numframes, samplesInRecurrentStep, 1);
+                ts += numframes;
+            }
+        }
+        msra::dbn::matrixstripe predstripe(pred, 0, totalframes);
+        CopyFromCNTKMatrixToSSEMatrix(batchmatrix, totalframes, predstripe);
+        parallellattice.setloglls(batchmatrix);
+
+        array_ref<size_t> uidsstripe(uids.data(), totalframes);
+        const_array_ref<size_t> boundariesstripe(doreferencealign ? boundaries.data() : nullptr, doreferencealign ? totalframes : 0);
+        std::vector<std::vector<unsigned short>> keepedges;
+        std::vector<double> denavlogps = msra::lattices::lattice::forwardbackwardbatch(parallellattice, latticeptrs,
+                                                                                       (const msra::math::ssematrixbase&) predstripe, (const msra::asr::simplesenonehmm&) m_hset,
+                                                                                       lmf, wp, amf, boostmmifactor, seqsMBRmode, uidsstripe, boundariesstripe,
+                                                                                       latticeprunebeam, prunenew ? &keepedges : nullptr);
+        if (prunenew)
+            prunelattices(latticeptrs, keepedges);
+
+        // the objective, with the numerator from the (possibly reference-aligned) uids
+        ElemType objectValue = 0.0;
+        size_t ts = 0;
+        for (size_t i = 0; i < lattices.size(); i++)
+        {
+            const size_t numframes = lattices[i]->getnumframes();
+            double numavlogp = 0;
+            for (size_t t = ts; t < ts + numframes; t++)
+                numavlogp += predstripe(uids[t], t) / amf;
+            numavlogp /= numframes;
+            objectValue += (ElemType)((numavlogp - denavlogps[i]) * numframes);
+            fprintf(stderr, "dengamma value %f\n", denavlogps[i]);
+            ts += numframes;
+        }
+
+        // scatter the gammas of all utterances
+        if (samplesInRecurrentStep == 1)
+        {
+            batchmatrix = gammafromlattice.ColumnSlice(0, totalframes);
+            parallellattice.getgamma(batchmatrix);
+        }
+        else
+        {
+            parallellattice.getgamma(batchmatrix);
+            size_t ts = 0;
+            for (size_t i = 0; i < lattices.size(); i++)
+            {
+                const size_t numframes = lattices[i]->getnumframes();
+                Microsoft::MSR::CNTK::Matrix<ElemType> gammaFromLatticeForCurrentParallelUtterance = gammafromlattice.ColumnSlice(uttmapi[i] + (uttbegin[i] * samplesInRecurrentStep), ((numframes - 1) * samplesInRecurrentStep) + 1);
+                gammaFromLatticeForCurrentParallelUtterance.CopyColumnsStrided(batchmatrix.ColumnSlice(ts, numframes), numframes, 1, samplesInRecurrentStep);
+                ts += numframes;
+            }
+        }
+
+        if (doreferencealign)
+        {
+            size_t ts = 0;
+            for (size_t i = 0; i < lattices.size(); i++)
+            {
+                const size_t numframes = lattices[i]->getnumframes();
+                for (size_t nframe = 0; nframe < numframes; nframe++)
+                {
+                    size_t uid = uids[ts + nframe];
+                    if (samplesInRecurrentStep > 1)
+                        labels(uid, (nframe + uttbegin[i]) * samplesInRecurrentStep + uttmapi[i]) = 1.0;
+                    else
+                        labels(uid, ts + nframe) = 1.0;
+                }
+                ts += numframes;
+            }
+        }
+        functionValues.SetValue(objectValue);
+    }
+
+    // Keep a pruned copy of each lattice seen for the first time, which is used instead in all later minibatches and epochs.
+    // The lattices are pruned once, with the posteriors of the model at that time. If nothing is pruned, or no path would
+    // be left, the original lattice is kept.
+    void prunelattices(const std::vector<const msra::lattices::lattice*>& latticeptrs, const std::vector<std::vector<unsigned short>>& keepedges)
+    {
+        size_t numlattices = 0, numedges = 0, numprunededges = 0;
+        for (size_t i = 0; i < latticeptrs.size(); i++)
+        {
+            const auto& L = *latticeptrs[i];
+            if (!prunedlattices.emplace(L.getkey(), nullptr).second)
+                continue;
+            auto pruned = L.prune(keepedges[i]);
+            numlattices++;
+            numedges += L.getnumedges();
+            numprunededges += pruned ? pruned->getnumedges() : L.getnumedges();
+            if (pruned && pruned->getnumedges() < L.getnumedges())
+                prunedlattices[L.getkey()] = pruned;
+        }
+        fprintf(stderr, "prunelattices: %d lattices pruned from %d to %d edges (beam %.2f)\n", (int) numlattices, (int) numedges, (int) numprunededges, latticeprunebeam);
+    }
+
     // Helper methods for copying between ssematrix objects and CNTK matrices
     void CopyFromCNTKMatrixToSSEMatrix(const Microsoft::MSR::CNTK::Matrix<ElemType>& src, size_t numCols, msra::math::ssematrixbase& dest)
     {
@@ -373,6 +571,9 @@ protected:
     vector<size_t> boundary;
     float boostmmifactor;
     bool seqsMBRmode;
+    size_t latticecachesizemb;
+    double latticeprunebeam;
+    std::unordered_map<std::wstring, std::shared_ptr<const msra::lattices::lattice>> prunedlattices; // [key] pruned lattice; nullptr: use the original
 
 private:
     std::unique_ptr<Microsoft::MSR::CNTK::CUDAPageLockedMemAllocator> m_cudaAllocator;
@@ -22,6 +22,16 @@ void latticefunctionsops::edgealignment(const vectorref<lrhmmdef>& hmms, const v
 {
 }
 
+void latticefunctionsops::packlattice(const vectorref<msra::lattices::edgeinfowithscores>& edges, const vectorref<msra::lattices::nodeinfo>& nodes,
+                                      const vectorref<msra::lattices::aligninfo>& aligns, const vectorref<unsigned int>& alignoffsets,
+                                      const vectorref<size_t>& backptroffsets, const size_t edgeoffset, const size_t nodeoffset,
+                                      const size_t alignoffset, const size_t frameoffset, const unsigned int alignbase, const size_t backptrbase,
+                                      vectorref<msra::lattices::edgeinfowithscores>& packededges, vectorref<msra::lattices::nodeinfo>& packednodes,
+                                      vectorref<msra::lattices::aligninfo>& packedaligns, vectorref<unsigned int>& packedalignoffsets,
+                                      vectorref<size_t>& packedbackptroffsets) const
+{
+}
+
 void latticefunctionsops::forwardbackwardlattice(const size_t* batchsizeforward, const size_t* batchsizebackward,
                                                  const size_t numlaunchforward, const size_t numlaunchbackward,
                                                  const size_t spalignunitid, const size_t silalignunitid,
@@ -38,6 +48,24 @@ void latticefunctionsops::forwardbackwardlattice(const size_t* batchsizeforward,
 {
 }
 
+void latticefunctionsops::forwardbackwardlatticebatch(const size_t* batchsizeforward, const size_t* batchsizebackward,
+                                                      const size_t numlaunchforward, const size_t numlaunchbackward,
+                                                      const vectorref<unsigned int>& forwardorder, const vectorref<unsigned int>& backwardorder,
+                                                      const vectorref<unsigned int>& edgelattices, const vectorref<unsigned int>& latticenodeoffsets,
+                                                      const size_t spalignunitid, const size_t silalignunitid,
+                                                      const vectorref<float>& edgeacscores, const vectorref<msra::lattices::edgeinfowithscores>& edges,
+                                                      const vectorref<msra::lattices::nodeinfo>& nodes,
+                                                      const vectorref<msra::lattices::aligninfo>& aligns, const vectorref<unsigned short>& aligments,
+                                                      const vectorref<unsigned int>& aligmentoffsets,
+                                                      vectorref<double>& logpps, vectorref<double>& logalphas, vectorref<double>& logbetas,
+                                                      const float lmf, const float wp, const float amf, const float boostingfactor, const bool returnEframescorrect,
+                                                      const vectorref<unsigned short>& uids, const vectorref<unsigned short>& senone2classmap,
+                                                      vectorref<double>& logaccalphas, vectorref<double>& logaccbetas,
+                                                      vectorref<double>& logframescorrectedge, vectorref<double>& logEframescorrect,
+                                                      vectorref<double>& latticetotals) const
+{
+}
+
 void latticefunctionsops::sMBRerrorsignal(const vectorref<unsigned short>& alignstateids, const vectorref<unsigned int>& alignoffsets,
                                           const vectorref<msra::lattices::edgeinfowithscores>& edges, const vectorref<msra::lattices::nodeinfo>& nodes,
                                           const vectorref<double>& logpps, const float amf, const vectorref<double>& logEframescorrect, const double logEframescorrecttotal,
@@ -45,6 +73,14 @@ void latticefunctionsops::sMBRerrorsignal(const vectorref<unsigned short>& align
 {
 }
 
+void latticefunctionsops::sMBRerrorsignalbatch(const vectorref<unsigned short>& alignstateids, const vectorref<unsigned int>& alignoffsets,
+                                               const vectorref<msra::lattices::edgeinfowithscores>& edges, const vectorref<msra::lattices::nodeinfo>& nodes,
+                                               const vectorref<unsigned int>& edgelattices, const vectorref<double>& logpps, const float amf,
+                                               const vectorref<double>& logEframescorrect, const vectorref<double>& latticetotals,
+                                               matrixref<float>& errorsignal, matrixref<float>& errorsignalneg) const
+{
+}
+
 void latticefunctionsops::mmierrorsignal(const vectorref<unsigned short>& alignstateids, const vectorref<unsigned int>& alignoffsets,
                                          const vectorref<msra::lattices::edgeinfowithscores>& edges, const vectorref<msra::lattices::nodeinfo>& nodes,
                                          const vectorref<double>& logpps, matrixref<float>& errorsignal) const
@@ -57,6 +93,10 @@ void latticefunctionsops::stateposteriors(const vectorref<unsigned short>& align
 {
 }
 
+void latticefunctionsops::pruneedges(const vectorref<double>& logpps, const double logppthreshold, vectorref<unsigned short>& keepedges) const
+{
+}
+
 latticefunctions* newlatticefunctions(size_t deviceid)
 {
     return nullptr;
@@ -788,6 +788,115 @@ double lattice::bestpathlattice(const std::vector<float> &edgeacscores, std::vec
     return totalfwscore;
 }
 
+// ---------------------------------------------------------------------------
+// aligntoreference() -- replace uids by a state alignment within the phone boundaries of the reference
+//
+// bounds[t] is the phone id + 1 at the first frame of each reference phone, and 0 otherwise.
+// ---------------------------------------------------------------------------
+void lattice::aligntoreference(const msra::asr::simplesenonehmm &hset, const msra::math::ssematrixbase &logLLs,
+                               array_ref<size_t> &uids, const_array_ref<size_t> bounds)
+{
+    size_t framenum = bounds.size();
+
+    msra::math::ssematrixbase *refabcs;
+    size_t ts, te, t;
+    ts = te = 0;
+
+    vector<aligninfo> refinfo(1);
+    vector<unsigned short> refalign(framenum);
+
+    array_ref<aligninfo> refunits(refinfo.data(), 1);
+    array_ref<unsigned short> refedgealignmentsj(refalign.data(), framenum);
+
+    while (te < framenum)
+    {
+        // found one phone's boundary (ts, te)
+        t = ts + 1;
+        while (t < framenum && bounds[t] == 0)
+            t++;
+        te = t;
+
+        // make one phone unit
+        size_t phoneid = bounds[ts] - 1;
+        refunits[0].unit = phoneid;
+        refunits[0].frames = te - ts;
+
+        size_t edgestates = hset.gethmm(phoneid).getnumstates();
+        littlematrixheap refmatrixheap(1); // for abcs
+        refabcs = &refmatrixheap.newmatrix(edgestates, te - ts + 2);
+        const auto edgeLLs = msra::math::ssematrixstriperef<msra::math::ssematrixbase>(const_cast<msra::math::ssematrixbase &>(logLLs), ts, te - ts);
+        // do alignment
+        alignedge((const_array_ref<aligninfo>) refunits, hset, edgeLLs, *refabcs, 0, true, refedgealignmentsj);
+
+        for (t = ts; t < te; t++)
+        {
+            uids[t] = (size_t) refedgealignmentsj[t - ts];
+        }
+        ts = te;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// prune() -- copy of the lattice with only the flagged edges that are still on a complete path
+//
+// keepedges[j] != 0 for the edges to keep, e.g. from the posteriors of forwardbackwardbatch(). An edge whose start
+// node cannot be reached from the start, or whose end node cannot reach the end, over flagged edges is dropped as
+// well. Nodes and alignments are renumbered; the order of the edges (by end, then start node) is kept.
+// Returns nullptr if no complete path is left.
+// ---------------------------------------------------------------------------
+std::shared_ptr<lattice> lattice::prune(const std::vector<unsigned short> &keepedges) const
+{
+    if (keepedges.size() != edges.size())
+        LogicError("prune: %d edge flags for %d edges", (int) keepedges.size(), (int) edges.size());
+    if (nodes.empty())
+        return nullptr;
+
+    // edges are sorted by end node, and end > start, so one pass each way finds the reachable nodes
+    vector<bool> fromstart(nodes.size(), false), toend(nodes.size(), false);
+    fromstart[0] = true;
+    foreach_index (j, edges)
+        if (keepedges[j] && fromstart[edges[j].S])
+            fromstart[edges[j].E] = true;
+    toend[nodes.size() - 1] = true;
+    for (size_t j = edges.size(); j-- > 0;)
+        if (keepedges[j] && toend[edges[j].E])
+            toend[edges[j].S] = true;
+    if (!fromstart[nodes.size() - 1])
+        return nullptr;
+
+    vector<size_t> nodemap(nodes.size(), SIZE_MAX);
+    size_t numnodes = 0;
+    foreach_index (i, nodes)
+        if (fromstart[i] && toend[i])
+            nodemap[i] = numnodes++;
+
+    auto L = std::make_shared<lattice>();
+    L->verbosity = verbosity;
+    L->key = key;
+    L->info = info;
+    L->nodes.reserve(numnodes);
+    foreach_index (i, nodes)
+        if (nodemap[i] != SIZE_MAX)
+            L->nodes.push_back(nodes[i]);
+    foreach_index (j, edges)
+    {
+        const auto &e = edges[j];
+        if (!keepedges[j] || nodemap[e.S] == SIZE_MAX || nodemap[e.E] == SIZE_MAX)
+            continue;
+        const auto units = getaligninfo(j);
+        edgeinfowithscores pe = e;
+        pe.S = nodemap[e.S];
+        pe.E = nodemap[e.E];
+        pe.firstalign = L->align.size();
+        L->edges.push_back(pe);
+        foreach_index (k, units)
+            L->align.push_back(units[k]);
+    }
+    L->info.numnodes = L->nodes.size();
+    L->info.numedges = L->edges.size();
+    return L;
+}
+
 // ---------------------------------------------------------------------------
 // forwardbackwardalign() -- compute the statelevel gammas or viterbi alignments
 // the first phase of lattice::forwardbackward
@@ -899,46 +1008,7 @@ void lattice::forwardbackwardalign(parallelstate &parallelstate,
 
     // zhaorui align to reference mlf
     if (bounds.size() > 0)
-    {
-        size_t framenum = bounds.size();
-
-        msra::math::ssematrixbase *refabcs;
-        size_t ts, te, t;
-        ts = te = 0;
-
-        vector<aligninfo> refinfo(1);
-        vector<unsigned short> refalign(framenum);
-
-        array_ref<aligninfo> refunits(refinfo.data(), 1);
-        array_ref<unsigned short> refedgealignmentsj(refalign.data(), framenum);
-
-        while (te < framenum)
-        {
-            // found one phone's boundary (ts, te)
-            t = ts + 1;
-            while (t < framenum && bounds[t] == 0)
-                t++;
-            te = t;
-
-            // make one phone unit
-            size_t phoneid = bounds[ts] - 1;
-            refunits[0].unit = phoneid;
-            refunits[0].frames = te - ts;
-
-            size_t edgestates = hset.gethmm(phoneid).getnumstates();
-            littlematrixheap refmatrixheap(1); // for abcs
-            refabcs = &refmatrixheap.newmatrix(edgestates, te - ts + 2);
-            const auto edgeLLs = msra::math::ssematrixstriperef<msra::math::ssematrixbase>(const_cast<msra::math::ssematrixbase &>(logLLs), ts, te - ts);
-            // do alignment
-            alignedge((const_array_ref<aligninfo>) refunits, hset, edgeLLs, *refabcs, 0, true, refedgealignmentsj);
-
-            for (t = ts; t < te; t++)
-            {
-                uids[t] = (size_t) refedgealignmentsj[t - ts];
-            }
-            ts = te;
-        }
-    }
+        aligntoreference(hset, logLLs, uids, bounds);
 
     // Phase 4: alignment or forwardbackward on CPU for non parallel mode or verification
 
@@ -13,6 +13,9 @@
 #include "latticefunctionskernels.h" // for emulation
 #include "cudalatticeops.h"
 #include <numeric> // for debug
+#include <list>
+#include <unordered_map>
+#include <memory>
 #include "cudalib.h"
 
 #define TWO_CHANNEL // [v-hansu]
@@ -104,7 +107,7 @@ void forwardlatticej(const size_t batchsize, const size_t startindex, const std:
     const size_t j = msra::lattices::latticefunctionskernels::shuffle(threadIdx.x, blockDim.x, threadIdx.y, blockDim.y, blockIdx.x, gridDim.x, shufflemode);
     if (j < batchsize) // note: will cause issues if we ever use __synctreads() in forwardlatticej
     {
-        msra::lattices::latticefunctionskernels::forwardlatticej(j + startindex, edgeacscores, spalignunitid, silalignunitid, edges, nodes, aligns, alignments, alignmentoffsets,
+        msra::lattices::latticefunctionskernels::forwardlatticej(j + startindex, edgeacscores, spalignunitid, silalignunitid, edges, nodes, 0, nodes.size() - 1, aligns, alignments, alignmentoffsets,
                                                                  logalphas, lmf, wp, amf, boostingfactor, uids, senone2classmap, returnEframescorrect, logframescorrectedge, logaccalphas);
     }
 }
@@ -124,7 +127,7 @@ void backwardlatticej(const size_t batchsize, const size_t startindex, const std
     if (j < batchsize) // note: will cause issues if we ever use __synctreads() in backwardlatticej
     {
         msra::lattices::latticefunctionskernels::backwardlatticej(j + startindex, edgeacscores, spalignunitid, silalignunitid,
-                                                                  edges, nodes, aligns, totalfwscore, logpps, logalphas,
+                                                                  edges, nodes, 0, nodes.size() - 1, aligns, totalfwscore, logpps, logalphas,
                                                                   logbetas, lmf, wp, amf, boostingfactor, returnEframescorrect, logframescorrectedge,
                                                                   logaccalphas, Eframescorrectbuf, logaccbetas);
     }
@@ -397,7 +400,16 @@ struct parallelstateimpl
           errorsignalgpustorage(new Microsoft::MSR::CNTK::Matrix<float>((int) deviceid)),
           errorsignalneggpustorage(new Microsoft::MSR::CNTK::Matrix<float>((int) deviceid)),
           backptrstoragegpu(msra::cuda::newushortvector(deviceid)),
-          backptroffsetsgpu(msra::cuda::newsizetvector(deviceid))
+          backptroffsetsgpu(msra::cuda::newsizetvector(deviceid)),
+          // lattices of a minibatch packed into one
+          forwardordergpu(msra::cuda::newuintvector(deviceid)),
+          backwardordergpu(msra::cuda::newuintvector(deviceid)),
+          edgelatticesgpu(msra::cuda::newuintvector(deviceid)),
+          latticenodeoffsetsgpu(msra::cuda::newuintvector(deviceid)),
+          latticetotalsgpu(msra::cuda::newdoublevector(deviceid)),
+          keepedgesgpu(msra::cuda::newushortvector(deviceid)),
+          latticecachebudget(0),
+          latticecachebytes(0)
     {
     }
 
@@ -542,6 +554,110 @@ struct parallelstateimpl
     std::unique_ptr<Microsoft::MSR::CNTK::Matrix<float>> errorsignalgpu;
     std::unique_ptr<Microsoft::MSR::CNTK::Matrix<float>> errorsignalneggpu;
 
+    // packed lattices: edges in the order of the batched launches, lattice of each edge,
+    // first node of each lattice (+ total), and 4 totals per lattice (see forwardbackwardlatticebatch in cudalatticeops.cu.h)
+    std::unique_ptr<msra::cuda::uintvector> forwardordergpu;
+    std::unique_ptr<msra::cuda::uintvector> backwardordergpu;
+    std::unique_ptr<msra::cuda::uintvector> edgelatticesgpu;
+    std::unique_ptr<msra::cuda::uintvector> latticenodeoffsetsgpu;
+    std::unique_ptr<doublevector> latticetotalsgpu;
+    std::unique_ptr<ushortvector> keepedgesgpu; // [j] edge j is within the pruning beam
+
+    // lattices that stay on the device across minibatches (and epochs), keyed by utterance
+    // A lattice is cached with its packing offsets and launch batches, which only depend on the lattice and the
+    // model topology. Beyond the budget, the least recently used lattices are evicted; the ones of the group being
+    // computed stay allocated until the group is done, as the caller holds them.
+    struct cachedlattice
+    {
+        std::unique_ptr<edgeinfowithscoresvector> edges;
+        std::unique_ptr<nodeinfovector> nodes;
+        std::unique_ptr<aligninfovector> align;
+        std::unique_ptr<msra::cuda::uintvector> alignoffsets; // as edgealignments::getalignoffsets()
+        std::unique_ptr<sizetvector> backptroffsets;          // as backpointers::getbackptroffsets()
+        size_t numalignframes;
+        size_t backptrstoragesize;
+        std::vector<size_t> batchsizeforward; // see computelaunchbatchsizes()
+        std::vector<size_t> batchsizebackward;
+        size_t bytes;                         // device memory
+        std::list<std::wstring>::iterator lru;
+    };
+    size_t latticecachebudget; // bytes; 0 disables the cache
+    size_t latticecachebytes;
+    std::unordered_map<std::wstring, std::shared_ptr<cachedlattice>> latticecache;
+    std::list<std::wstring> latticecachelru; // most recently used first
+
+    void setlatticecachebudget(const size_t bytes)
+    {
+        latticecachebudget = bytes;
+        evictcachedlattices(0);
+    }
+
+    // returns null if the utterance is not cached
+    std::shared_ptr<cachedlattice> findcachedlattice(const std::wstring& key, const size_t numedges, const size_t numnodes)
+    {
+        auto iter = latticecache.find(key);
+        if (iter == latticecache.end())
+            return nullptr;
+        auto cached = iter->second;
+        if (cached->edges->size() != numedges || cached->nodes->size() != numnodes) // another lattice with the same key
+        {
+            removecachedlattice(key);
+            return nullptr;
+        }
+        latticecachelru.splice(latticecachelru.begin(), latticecachelru, cached->lru);
+        return cached;
+    }
+
+    // transfers a lattice, and caches it unless it alone exceeds the budget
+    template <class edgestype, class nodestype, class aligntype>
+    std::shared_ptr<cachedlattice> newcachedlattice(const std::wstring& key, const edgestype& edges, const nodestype& nodes, const aligntype& align,
+                                                    const std::vector<unsigned int>& alignoffsets, const std::vector<size_t>& backptroffsets,
+                                                    const std::vector<size_t>& batchsizeforward, const std::vector<size_t>& batchsizebackward)
+    {
+        auto cached = std::make_shared<cachedlattice>();
+        cached->edges.reset(msra::cuda::newedgeinfovector(deviceid));
+        cached->nodes.reset(msra::cuda::newnodeinfovector(deviceid));
+        cached->align.reset(msra::cuda::newaligninfovector(deviceid));
+        cached->alignoffsets.reset(msra::cuda::newuintvector(deviceid));
+        cached->backptroffsets.reset(msra::cuda::newsizetvector(deviceid));
+        cached->edges->assign(edges, false);
+        cached->nodes->assign(nodes, false);
+        cached->align->assign(align, false);
+        cached->alignoffsets->assign(alignoffsets, false);
+        cached->backptroffsets->assign(backptroffsets, false);
+        cached->numalignframes = alignoffsets.back();
+        cached->backptrstoragesize = backptroffsets.back();
+        cached->batchsizeforward = batchsizeforward;
+        cached->batchsizebackward = batchsizebackward;
+        cached->bytes = edges.size() * sizeof(msra::lattices::edgeinfowithscores) + nodes.size() * sizeof(msra::lattices::nodeinfo) +
+                        align.size() * sizeof(msra::lattices::aligninfo) + alignoffsets.size() * sizeof(unsigned int) + backptroffsets.size() * sizeof(size_t);
+
+        if (cached->bytes <= latticecachebudget)
+        {
+            evictcachedlattices(cached->bytes);
+            latticecachelru.push_front(key);
+            cached->lru = latticecachelru.begin();
+            latticecache[key] = cached;
+            latticecachebytes += cached->bytes;
+        }
+        return cached;
+    }
+
+    void removecachedlattice(const std::wstring& key)
+    {
+        auto iter = latticecache.find(key);
+        latticecachebytes -= iter->second->bytes;
+        latticecachelru.erase(iter->second->lru);
+        latticecache.erase(iter);
+    }
+
+    // evicts the least recently used lattices until 'bytes' more fit into the budget
+    void evictcachedlattices(const size_t bytes)
+    {
+        while (!latticecachelru.empty() && latticecachebytes + bytes > latticecachebudget)
+            removecachedlattice(latticecachelru.back());
+    }
+
     // cache current lattice
     // This is a weird mix of const/non-const and private lattice data... :(
     template <class edgestype, class nodestype, class aligntype, class edgealignments, class backpointers>
@@ -571,6 +687,41 @@ struct parallelstateimpl
         /*cudalogLLs->allocate (logLLs.rows(), logLLs.cols());
             cudalogLLs->assign(0, logLLs.rows(), 0, logLLs.cols(), &logLLs(0,0), logLLs.getcolstride(), true);  // doing this last with 'true' so we can measure time better; maybe remove later*/
     }
+    // cache the packed lattices of a minibatch; like setutterancedata(), with the offsets of all lattices concatenated
+    // The lattice arrays are either transferred from the host copies (setbatchlattices()), or only allocated
+    // (allocatebatchlattices()) for packing the cached lattices into them on the device.
+    template <class packedlattices>
+    void setbatchlattices(const packedlattices& packed)
+    {
+        edgesgpu->assign(packed.edges, false);
+        nodesgpu->assign(packed.nodes, false);
+        aligngpu->assign(packed.align, false);
+        alignoffsetsgpu->assign(packed.alignoffsets, false);
+        backptroffsetsgpu->assign(packed.backptroffsets, false);
+    }
+    template <class packedlattices>
+    void allocatebatchlattices(const packedlattices& packed)
+    {
+        edgesgpu->allocate(packed.numedges);
+        nodesgpu->allocate(packed.numnodes);
+        aligngpu->allocate(packed.numaligns);
+        alignoffsetsgpu->allocate(packed.numedges + 1);
+        backptroffsetsgpu->allocate(packed.numedges + 1);
+    }
+    template <class packedlattices>
+    void setbatchdata(const packedlattices& packed)
+    {
+        backptrstoragegpu->allocate(packed.backptrstoragesize);
+        alignresult->allocate(packed.numalignframes);
+        edgeacscoresgpu->allocate(packed.numedges);
+
+        forwardordergpu->assign(packed.forwardorder, false);
+        backwardordergpu->assign(packed.backwardorder, false);
+        edgelatticesgpu->assign(packed.edgelattices, false);
+        latticenodeoffsetsgpu->assign(packed.latticenodeoffsets, false);
+        latticetotalsgpu->allocate(4 * (packed.latticenodeoffsets.size() - 1));
+    }
+
     // template<class ElemType>
     void setloglls(const Microsoft::MSR::CNTK::Matrix<float>& loglls)
     {
@@ -592,47 +743,56 @@ struct parallelstateimpl
     void allocfwbwvectors(const edgestype& edges, const nodestype& nodes, const std::vector<unsigned short>& uids,
                           const bool allocateframescorrect, const bool copyuids, const bool allocateaccvectors)
     {
-        logppsgpu->allocate(edges.size());
+        allocfwbwvectors(edges.size(), nodes.size(), uids, allocateframescorrect, copyuids, allocateaccvectors);
+    }
+    void allocfwbwvectors(const size_t numedges, const size_t numnodes, const std::vector<unsigned short>& uids,
+                          const bool allocateframescorrect, const bool copyuids, const bool allocateaccvectors)
+    {
+        logppsgpu->allocate(numedges);
 #ifndef TWO_CHANNEL
         const size_t alphabetanoderatio = 1;
 #else
         const size_t alphabetanoderatio = 2;
 #endif
-        logalphasgpu->allocate(alphabetanoderatio * nodes.size());
-        logbetasgpu->allocate(alphabetanoderatio * nodes.size());
+        logalphasgpu->allocate(alphabetanoderatio * numnodes);
+        logbetasgpu->allocate(alphabetanoderatio * numnodes);
 
         if (allocateframescorrect)
-            logframescorrectedgegpu->allocate(edges.size());
+            logframescorrectedgegpu->allocate(numedges);
 
         if (copyuids)
             uidsgpu->assign(uids, true);
 
         if (allocateaccvectors)
         {
-            logaccalphasgpu->allocate(alphabetanoderatio * nodes.size());
-            logaccbetasgpu->allocate(alphabetanoderatio * nodes.size());
+            logaccalphasgpu->allocate(alphabetanoderatio * numnodes);
+            logaccbetasgpu->allocate(alphabetanoderatio * numnodes);
 
-            Eframescorrectbufgpu->allocate(edges.size());
-            logEframescorrectgpu->allocate(edges.size());
+            Eframescorrectbufgpu->allocate(numedges);
+            logEframescorrectgpu->allocate(numedges);
         }
     }
 
     // check if gpumatrixstorage supports size of cpumatrix, if not allocate. set gpumatrix to part of gpumatrixstorage
     void cacheerrorsignal(const msra::math::ssematrixbase& errorsignal, const bool cacheerrsignalneg)
     {
-        if (errorsignalgpustorage->GetNumRows() != 0 && errorsignalgpustorage->GetNumRows() != errorsignal.rows())
+        cacheerrorsignal(errorsignal.rows(), errorsignal.cols(), cacheerrsignalneg);
+    }
+    void cacheerrorsignal(const size_t rows, const size_t cols, const bool cacheerrsignalneg)
+    {
+        if (errorsignalgpustorage->GetNumRows() != 0 && errorsignalgpustorage->GetNumRows() != rows)
             throw ::logic_error("gpumatrixstorage->rows() shall be fixed once allocated");
-        if (errorsignalgpustorage->GetNumCols() < errorsignal.cols())
-            errorsignalgpustorage->Resize(errorsignal.rows(), errorsignal.cols());
-        *errorsignalgpu = errorsignalgpustorage->ColumnSlice(0, errorsignal.cols());
+        if (errorsignalgpustorage->GetNumCols() < cols)
+            errorsignalgpustorage->Resize(rows, cols);
+        *errorsignalgpu = errorsignalgpustorage->ColumnSlice(0, cols);
 
         if (cacheerrsignalneg)
         {
-            if (errorsignalneggpustorage->GetNumRows() != 0 && errorsignalneggpustorage->GetNumRows() != errorsignal.rows())
+            if (errorsignalneggpustorage->GetNumRows() != 0 && errorsignalneggpustorage->GetNumRows() != rows)
                 throw ::logic_error("gpumatrixstorage->rows() shall be fixed once allocated");
-            if (errorsignalneggpustorage->GetNumCols() < errorsignal.cols())
-                errorsignalneggpustorage->Resize(errorsignal.rows(), errorsignal.cols());
-            *errorsignalneggpu = errorsignalneggpustorage->ColumnSlice(0, errorsignal.cols());
+            if (errorsignalneggpustorage->GetNumCols() < cols)
+                errorsignalneggpustorage->Resize(rows, cols);
+            *errorsignalneggpu = errorsignalneggpustorage->ColumnSlice(0, cols);
         }
     }
 
@@ -669,6 +829,11 @@ size_t lattice::parallelstate::getdevice()
     return pimpl->getdevice();
 }
 
+void lattice::parallelstate::setlatticecachesize(size_t bytes)
+{
+    pimpl->setlatticecachebudget(bytes);
+}
+
 void lattice::parallelstate::release(bool pcpumode)
 {
     if (!pcpumode)
@@ -774,16 +939,13 @@ void lattice::parallelforwardbackwardalign(parallelstate& parallelstate,
     }
 }
 
-// parallelforwardbackwardlattice() -- compute the latticelevel logpps using forwardbackward
-double lattice::parallelforwardbackwardlattice(parallelstate& parallelstate, const std::vector<float>& edgeacscores,
-                                               const edgealignments& thisedgealignments, const float lmf, const float wp,
-                                               const float amf, const float boostingfactor, std::vector<double>& logpps,
-                                               std::vector<double>& logalphas, std::vector<double>& logbetas, const bool returnEframescorrect,
-                                               const_array_ref<size_t>& uids, std::vector<double>& logEframescorrect,
-                                               std::vector<double>& Eframescorrectbuf, double& logEframescorrecttotal) const
-{                                     // ^^ TODO: remove this
-    vector<size_t> batchsizeforward;  // record the batch size that exclude the data dependency for forward
-    vector<size_t> batchsizebackward; // record the batch size that exclude the data dependency for backward
+// computelaunchbatchsizes() -- split the edges of a lattice into batches without data dependency, one kernel launch each
+// The forward batches go from the first edge on, the backward batches from the last edge back.
+static void computelaunchbatchsizes(const std::vector<msra::lattices::edgeinfowithscores>& edges,
+                                    std::vector<size_t>& batchsizeforward, std::vector<size_t>& batchsizebackward)
+{
+    batchsizeforward.clear();
+    batchsizebackward.clear();
 
     size_t endindexforward = edges[0].E;
     size_t countbatchforward = 0;
@@ -816,6 +978,19 @@ double lattice::parallelforwardbackwardlattice(parallelstate& parallelstate, con
     }
     batchsizeforward.push_back(countbatchforward);
     batchsizebackward.push_back(countbatchbackward);
+}
+
+// parallelforwardbackwardlattice() -- compute the latticelevel logpps using forwardbackward
+double lattice::parallelforwardbackwardlattice(parallelstate& parallelstate, const std::vector<float>& edgeacscores,
+                                               const edgealignments& thisedgealignments, const float lmf, const float wp,
+                                               const float amf, const float boostingfactor, std::vector<double>& logpps,
+                                               std::vector<double>& logalphas, std::vector<double>& logbetas, const bool returnEframescorrect,
+                                               const_array_ref<size_t>& uids, std::vector<double>& logEframescorrect,
+                                               std::vector<double>& Eframescorrectbuf, double& logEframescorrecttotal) const
+{                                     // ^^ TODO: remove this
+    vector<size_t> batchsizeforward;  // record the batch size that exclude the data dependency for forward
+    vector<size_t> batchsizebackward; // record the batch size that exclude the data dependency for backward
+    computelaunchbatchsizes(edges, batchsizeforward, batchsizebackward);
 
     std::vector<unsigned short> uidsuint(uids.size()); // actually we shall not do this, but as it will not take much time, let us just leave it here now.
     foreach_index (i, uidsuint)
@@ -943,5 +1118,376 @@ void lattice::parallelmmierrorsignal(parallelstate& parallelstate, const edgeali
         emulatemmierrorsignal(thisedgealignments.getalignmentsbuffer(), thisedgealignments.getalignoffsets(), edges, nodes, logpps, errorsignal);
     }
 }
+
+// ------------------------------------------------------------------------
+// forwardbackwardbatch() -- the GPU steps of forwardbackward() for all lattices of a minibatch
+//
+// The lattices are packed into one lattice of disjoint graphs, so that each step is one round of kernel launches for
+// the whole minibatch instead of one per utterance: node, alignment and frame indices are offset by those of the
+// lattices before it, and the edges of the i-th data-independent batch of every lattice go into the same launch.
+// Consecutive lattices are packed as long as the indices fit into the bit fields of nodeinfo and edgeinfo; a larger
+// minibatch takes several such groups. A lattice without any path gets zero gammas (its value is still LOGZERO).
+// ------------------------------------------------------------------------
+
+struct packedlattices
+{
+    // where a lattice goes in the packed lattice
+    struct latticeoffsets
+    {
+        size_t edgeoffset;
+        size_t nodeoffset;
+        size_t alignoffset;
+        size_t frameoffset;
+        unsigned int alignbase; // first alignment frame
+        size_t backptrbase;     // first backpointer entry
+    };
+
+    // host copies, only when the lattices are packed on the host
+    std::vector<msra::lattices::edgeinfowithscores> edges;
+    std::vector<msra::lattices::nodeinfo> nodes;
+    std::vector<msra::lattices::aligninfo> align;
+    std::vector<unsigned int> alignoffsets;      // [j] into the alignments; one extra element for the total
+    std::vector<size_t> backptroffsets;          // [j] into the backpointer storage; one extra element for the total
+
+    std::vector<latticeoffsets> offsets;         // [l]
+    std::vector<unsigned int> edgelattices;      // [j] lattice of edge j
+    std::vector<unsigned int> latticenodeoffsets; // [l] first node of lattice l; one extra element for the total
+    std::vector<unsigned int> forwardorder;      // edges of forward launch i at [sum batchsizeforward[<i]]
+    std::vector<unsigned int> backwardorder;     // likewise for the backward launches
+    std::vector<size_t> batchsizeforward;
+    std::vector<size_t> batchsizebackward;
+    std::vector<std::vector<size_t>> latticebatchsizeforward; // [l] launch batches of lattice l
+    std::vector<std::vector<size_t>> latticebatchsizebackward;
+    std::vector<unsigned short> uids;
+    size_t numedges;
+    size_t numnodes;
+    size_t numaligns;
+    size_t numframes;
+    size_t numalignframes;
+    size_t backptrstoragesize;
+
+    void clear()
+    {
+        edges.clear();
+        nodes.clear();
+        align.clear();
+        alignoffsets.assign(1, 0);
+        backptroffsets.assign(1, 0);
+        offsets.clear();
+        edgelattices.clear();
+        latticenodeoffsets.assign(1, 0);
+        forwardorder.clear();
+        backwardorder.clear();
+        batchsizeforward.clear();
+        batchsizebackward.clear();
+        latticebatchsizeforward.clear();
+        latticebatchsizebackward.clear();
+        uids.clear();
+        numedges = numnodes = numaligns = numframes = numalignframes = backptrstoragesize = 0;
+    }
+};
+
+// size limits of a packed lattice, from the bit fields of edgeinfo::S/E (19 bits), edgeinfo::firstalign (24 bits) and nodeinfo::t (16 bits)
+static const size_t maxpackednodes = (size_t) 1 << 19;
+static const size_t maxpackedaligns = (size_t) 1 << 24;
+static const size_t maxpackedframes = (size_t) 1 << 16;
+
+std::vector<double> lattice::forwardbackwardbatch(parallelstate& parallelstate, const std::vector<const lattice*>& lattices,
+                                                  const msra::math::ssematrixbase& logLLs, const msra::asr::simplesenonehmm& hset,
+                                                  const float lmf, const float wp, const float amf, const float boostingfactor, const bool sMBRmode,
+                                                  array_ref<size_t> uids, const_array_ref<size_t> bounds,
+                                                  const double prunebeam, std::vector<std::vector<unsigned short>>* keepedges)
+{
+#if !defined(PARALLEL_SIL) || defined(CPU_VERIFICATION)
+    LogicError("forwardbackwardbatch: requires PARALLEL_SIL and no CPU_VERIFICATION");
+#endif
+    if (!parallelstate.enabled() || parallelstate->emulation)
+        LogicError("forwardbackwardbatch: only supported on a GPU without emulation");
+    parallelstate->validatehset(hset); // ensure the models have been correctly cached on the GPU already
+
+    size_t totalframes = 0;
+    for (const auto& L : lattices)
+        totalframes += L->info.numframes;
+    if (totalframes != logLLs.cols())
+        LogicError("forwardbackwardbatch: #frames mismatch between lattices (%d) and LLs (%d)", (int) totalframes, (int) logLLs.cols());
+    if (totalframes != uids.size())
+        LogicError("forwardbackwardbatch: #frames mismatch between lattices (%d) and uids (%d)", (int) totalframes, (int) uids.size());
+    if (bounds.size() > 0 && totalframes != bounds.size())
+        LogicError("forwardbackwardbatch: #frames mismatch between lattices (%d) and bounds (%d)", (int) totalframes, (int) bounds.size());
+
+    // the reference alignment only depends on the LLs, so it is done upfront on the host copy
+    if (bounds.size() > 0)
+    {
+        size_t ts = 0;
+        for (const auto& L : lattices)
+        {
+            const size_t numframes = L->info.numframes;
+            const auto latticeLLs = msra::math::ssematrixstriperef<msra::math::ssematrixbase>(const_cast<msra::math::ssematrixbase&>(logLLs), ts, numframes);
+            array_ref<size_t> latticeuids(&uids[ts], numframes);
+            aligntoreference(hset, latticeLLs, latticeuids, const_array_ref<size_t>(&bounds[ts], numframes));
+            ts += numframes;
+        }
+    }
+
+    // the error signal of all frames; each group writes its columns
+    parallelstate->cacheerrorsignal(logLLs.rows(), totalframes, sMBRmode);
+
+    const bool returnEframescorrect = sMBRmode;
+    const bool allocateframescorrect = (returnEframescorrect || boostingfactor != 0.0f);
+    const bool copyuids = true; // the packed uids are copied whenever they are used
+    const bool allocateaccvectors = returnEframescorrect;
+    const bool usecache = parallelstate->latticecachebudget > 0;
+    std::unique_ptr<latticefunctions> latticefunctions(msra::cuda::newlatticefunctions(parallelstate.getdevice()));
+
+    std::vector<double> results(lattices.size(), LOGZERO);
+    if (keepedges)
+        keepedges->resize(lattices.size());
+    packedlattices packed;
+    std::vector<double> latticetotals;
+    std::vector<unsigned short> groupkeepedges;
+    std::vector<size_t> batchsizeforward, batchsizebackward;
+    size_t groupbegin = 0;  // first lattice of the group
+    size_t groupframes = 0; // first frame of the group
+    while (groupbegin < lattices.size())
+    {
+        // determine the group: as many lattices as fit the bit fields, at least one
+        size_t groupend = groupbegin;
+        size_t numnodes = 0, numaligns = 0, numframes = 0;
+        while (groupend < lattices.size())
+        {
+            const lattice& L = *lattices[groupend];
+            if (groupend > groupbegin && (numnodes + L.nodes.size() > maxpackednodes || numaligns + L.align.size() > maxpackedaligns || numframes + L.info.numframes > maxpackedframes))
+                break;
+            numnodes += L.nodes.size();
+            numaligns += L.align.size();
+            numframes += L.info.numframes;
+            groupend++;
+        }
+
+        // pack the group
+        // With the lattice cache, the lattices stay on the device across minibatches and are packed there; otherwise
+        // they are packed on the host and transferred.
+        packed.clear();
+        std::vector<std::shared_ptr<parallelstateimpl::cachedlattice>> cachedlattices; // [lattice in group] with the cache
+        for (size_t i = groupbegin; i < groupend; i++)
+        {
+            const lattice& L = *lattices[i];
+            const size_t latticeindex = i - groupbegin;
+            packedlattices::latticeoffsets offsets;
+            offsets.edgeoffset = packed.numedges;
+            offsets.nodeoffset = packed.numnodes;
+            offsets.alignoffset = packed.numaligns;
+            offsets.frameoffset = packed.numframes;
+            offsets.alignbase = (unsigned int) packed.numalignframes;
+            offsets.backptrbase = packed.backptrstoragesize;
+            packed.offsets.push_back(offsets);
+
+            if (usecache)
+            {
+                auto cached = parallelstate->findcachedlattice(L.getkey(), L.edges.size(), L.nodes.size());
+                if (!cached)
+                {
+                    const edgealignments latticealignments(L);
+                    const backpointers latticebackpointers(L, hset);
+                    computelaunchbatchsizes(L.edges, batchsizeforward, batchsizebackward);
+                    cached = parallelstate->newcachedlattice(L.getkey(), L.edges, L.nodes, L.align, latticealignments.getalignoffsets(),
+                                                             latticebackpointers.getbackptroffsets(), batchsizeforward, batchsizebackward);
+                }
+                packed.numalignframes += cached->numalignframes;
+                packed.backptrstoragesize += cached->backptrstoragesize;
+                packed.latticebatchsizeforward.push_back(cached->batchsizeforward);
+                packed.latticebatchsizebackward.push_back(cached->batchsizebackward);
+                cachedlattices.push_back(cached);
+            }
+            else
+            {
+                foreach_index (j, L.edges)
+                {
+                    edgeinfowithscores e = L.edges[j];
+                    e.S = e.S + offsets.nodeoffset;
+                    e.E = e.E + offsets.nodeoffset;
+                    e.firstalign = e.firstalign + offsets.alignoffset;
+                    packed.edges.push_back(e);
+                }
+                foreach_index (n, L.nodes)
+                    packed.nodes.push_back(nodeinfo(L.nodes[n].t + offsets.frameoffset));
+                packed.align.insert(packed.align.end(), L.align.begin(), L.align.end());
+
+                const edgealignments latticealignments(L);
+                const backpointers latticebackpointers(L, hset);
+                packed.alignoffsets.pop_back();
+                packed.backptroffsets.pop_back();
+                for (auto offset : latticealignments.getalignoffsets())
+                    packed.alignoffsets.push_back(offsets.alignbase + offset);
+                for (auto offset : latticebackpointers.getbackptroffsets())
+                    packed.backptroffsets.push_back(offsets.backptrbase + offset);
+                packed.numalignframes = packed.alignoffsets.back();
+                packed.backptrstoragesize = packed.backptroffsets.back();
+
+                computelaunchbatchsizes(L.edges, batchsizeforward, batchsizebackward);
+                packed.latticebatchsizeforward.push_back(batchsizeforward);
+                packed.latticebatchsizebackward.push_back(batchsizebackward);
+            }
+
+            packed.numedges += L.edges.size();
+            packed.numnodes += L.nodes.size();
+            packed.numaligns += L.align.size();
+            packed.edgelattices.insert(packed.edgelattices.end(), L.edges.size(), (unsigned int) latticeindex);
+            packed.latticenodeoffsets.push_back((unsigned int) packed.numnodes);
+            for (size_t t = 0; t < L.info.numframes; t++)
+                packed.uids.push_back((unsigned short) uids[groupframes + offsets.frameoffset + t]);
+            packed.numframes += L.info.numframes;
+
+            // merge the launches: launch k of the batch runs launch k of every lattice
+            const auto& latticeforward = packed.latticebatchsizeforward.back();
+            const auto& latticebackward = packed.latticebatchsizebackward.back();
+            if (packed.batchsizeforward.size() < latticeforward.size())
+                packed.batchsizeforward.resize(latticeforward.size(), 0);
+            if (packed.batchsizebackward.size() < latticebackward.size())
+                packed.batchsizebackward.resize(latticebackward.size(), 0);
+            for (size_t k = 0; k < latticeforward.size(); k++)
+                packed.batchsizeforward[k] += latticeforward[k];
+            for (size_t k = 0; k < latticebackward.size(); k++)
+                packed.batchsizebackward[k] += latticebackward[k];
+        }
+
+        // list the edges by launch; within a launch, by lattice and edge index
+        packed.forwardorder.resize(packed.numedges);
+        packed.backwardorder.resize(packed.numedges);
+        std::vector<size_t> forwardcursor(packed.batchsizeforward.size() + 1, 0), backwardcursor(packed.batchsizebackward.size() + 1, 0);
+        for (size_t k = 0; k < packed.batchsizeforward.size(); k++)
+            forwardcursor[k + 1] = forwardcursor[k] + packed.batchsizeforward[k];
+        for (size_t k = 0; k < packed.batchsizebackward.size(); k++)
+            backwardcursor[k + 1] = backwardcursor[k] + packed.batchsizebackward[k];
+        for (size_t l = 0; l < packed.offsets.size(); l++)
+        {
+            const size_t edgeoffset = packed.offsets[l].edgeoffset;
+            const auto& latticeforward = packed.latticebatchsizeforward[l];
+            const auto& latticebackward = packed.latticebatchsizebackward[l];
+            size_t j = 0;
+            for (size_t k = 0; k < latticeforward.size(); k++)
+                for (size_t n = 0; n < latticeforward[k]; n++)
+                    packed.forwardorder[forwardcursor[k]++] = (unsigned int) (edgeoffset + j++);
+            j = lattices[groupbegin + l]->edges.size();
+            for (size_t k = 0; k < latticebackward.size(); k++)
+            {
+                j -= latticebackward[k];
+                for (size_t n = 0; n < latticebackward[k]; n++)
+                    packed.backwardorder[backwardcursor[k]++] = (unsigned int) (edgeoffset + j + n);
+            }
+        }
+
+        if (usecache)
+        {
+            parallelstate->allocatebatchlattices(packed);
+            foreach_index (l, cachedlattices)
+            {
+                const auto& cached = *cachedlattices[l];
+                const auto& offsets = packed.offsets[l];
+                latticefunctions->packlattice(*cached.edges.get(), *cached.nodes.get(), *cached.align.get(),
+                                              *cached.alignoffsets.get(), *cached.backptroffsets.get(),
+                                              offsets.edgeoffset, offsets.nodeoffset, offsets.alignoffset, offsets.frameoffset,
+                                              offsets.alignbase, offsets.backptrbase,
+                                              *parallelstate->edgesgpu.get(), *parallelstate->nodesgpu.get(), *parallelstate->aligngpu.get(),
+                                              *parallelstate->alignoffsetsgpu.get(), *parallelstate->backptroffsetsgpu.get());
+            }
+        }
+        else
+            parallelstate->setbatchlattices(packed);
+        parallelstate->setbatchdata(packed);
+
+        // edge alignment, on the columns of the group
+        Microsoft::MSR::CNTK::Matrix<float> grouplogLLs = parallelstate->cudalogLLs->ColumnSlice(groupframes, packed.numframes);
+        latticefunctions->edgealignment(*parallelstate->hmmsgpu.get(), *parallelstate->lr3transPgpu.get(),
+                                        parallelstate->spalignunitid, parallelstate->silalignunitid,
+                                        grouplogLLs, *parallelstate->nodesgpu.get(),
+                                        *parallelstate->edgesgpu.get(), *parallelstate->aligngpu.get(),
+                                        *parallelstate->alignoffsetsgpu.get(),
+                                        *parallelstate->backptrstoragegpu.get(), *parallelstate->backptroffsetsgpu.get(),
+                                        *parallelstate->alignresult.get(), *parallelstate->edgeacscoresgpu.get());
+
+        // lattice-level forward backward
+        if (lattices[groupbegin]->verbosity >= 2)
+            fprintf(stderr, "forwardbackwardbatch: %d lattices, %d launches for forward, %d launches for backward\n",
+                    (int) (groupend - groupbegin), (int) packed.batchsizeforward.size(), (int) packed.batchsizebackward.size());
+        parallelstate->allocfwbwvectors(packed.numedges, packed.numnodes, packed.uids, allocateframescorrect, copyuids, allocateaccvectors);
+        latticefunctions->forwardbackwardlatticebatch(&packed.batchsizeforward[0], &packed.batchsizebackward[0],
+                                                      packed.batchsizeforward.size(), packed.batchsizebackward.size(),
+                                                      *parallelstate->forwardordergpu.get(), *parallelstate->backwardordergpu.get(),
+                                                      *parallelstate->edgelatticesgpu.get(), *parallelstate->latticenodeoffsetsgpu.get(),
+                                                      parallelstate->spalignunitid, parallelstate->silalignunitid,
+                                                      *parallelstate->edgeacscoresgpu.get(), *parallelstate->edgesgpu.get(),
+                                                      *parallelstate->nodesgpu.get(), *parallelstate->aligngpu.get(),
+                                                      *parallelstate->alignresult.get(), *parallelstate->alignoffsetsgpu.get(),
+                                                      *parallelstate->logppsgpu.get(), *parallelstate->logalphasgpu.get(),
+                                                      *parallelstate->logbetasgpu.get(), lmf, wp, amf, boostingfactor,
+                                                      returnEframescorrect, *parallelstate->uidsgpu.get(), *parallelstate->senone2classmapgpu.get(),
+                                                      *parallelstate->logaccalphasgpu.get(), *parallelstate->logaccbetasgpu.get(),
+                                                      *parallelstate->logframescorrectedgegpu.get(), *parallelstate->logEframescorrectgpu.get(),
+                                                      *parallelstate->latticetotalsgpu.get());
+
+        // state-level error signal, on the columns of the group
+        Microsoft::MSR::CNTK::Matrix<float> grouperrorsignal = parallelstate->errorsignalgpu->ColumnSlice(groupframes, packed.numframes);
+        if (!sMBRmode)
+        {
+            latticefunctions->mmierrorsignal(*parallelstate->alignresult.get(), *parallelstate->alignoffsetsgpu.get(), *parallelstate->edgesgpu.get(),
+                                             *parallelstate->nodesgpu.get(), *parallelstate->logppsgpu.get(), grouperrorsignal);
+        }
+        else
+        {
+            Microsoft::MSR::CNTK::Matrix<float> grouperrorsignalneg = parallelstate->errorsignalneggpu->ColumnSlice(groupframes, packed.numframes);
+            latticefunctions->sMBRerrorsignalbatch(*parallelstate->alignresult.get(), *parallelstate->alignoffsetsgpu.get(), *parallelstate->edgesgpu.get(),
+                                                   *parallelstate->nodesgpu.get(), *parallelstate->edgelatticesgpu.get(), *parallelstate->logppsgpu.get(), amf,
+                                                   *parallelstate->logEframescorrectgpu.get(), *parallelstate->latticetotalsgpu.get(),
+                                                   grouperrorsignal, grouperrorsignalneg);
+        }
+
+        // posterior pruning: the edges are flagged on the device, and only the flags are read back
+        if (keepedges)
+        {
+            parallelstate->keepedgesgpu->allocate(packed.numedges);
+            latticefunctions->pruneedges(*parallelstate->logppsgpu.get(), -prunebeam, *parallelstate->keepedgesgpu.get());
+            parallelstate->keepedgesgpu->fetch(groupkeepedges, true);
+            for (size_t i = groupbegin; i < groupend; i++)
+            {
+                const auto begin = groupkeepedges.begin() + packed.offsets[i - groupbegin].edgeoffset;
+                (*keepedges)[i].assign(begin, begin + lattices[i]->edges.size());
+            }
+        }
+
+        // one read-back of the totals for the whole group
+        parallelstate->latticetotalsgpu->fetch(latticetotals, true);
+        for (size_t i = groupbegin; i < groupend; i++)
+        {
+            const lattice& L = *lattices[i];
+            const double* totals = &latticetotals[4 * (i - groupbegin)];
+            const double totalfwscore = totals[0];
+            const double totalbwscore = totals[1];
+            if (fabs(totalfwscore - totalbwscore) / L.nodes.size() > 1e-4)
+                fprintf(stderr, "forwardbackward: WARNING: lattice fw and bw scores %.10f vs. %.10f (%d nodes/%d edges)\n", (float) totalfwscore, (float) totalbwscore, (int) L.nodes.size(), (int) L.edges.size());
+            if (returnEframescorrect && fabs(totals[2] - totals[3]) / L.nodes.size() > 1e-4)
+                fprintf(stderr, "forwardbackward: WARNING: lattice fw and bw acc %.10f vs. %.10f (%d nodes/%d edges)\n", (float) totals[2], (float) totals[3], (int) L.nodes.size(), (int) L.edges.size());
+
+            if (totalfwscore < LOGZERO / 2)
+            {
+                fprintf(stderr, "forwardbackward: WARNING: no path found in lattice (%d nodes/%d edges)\n", (int) L.nodes.size(), (int) L.edges.size());
+                results[i] = LOGZERO; // failed; its gammas are zero
+            }
+            else if (!sMBRmode)
+                results[i] = totalfwscore / L.info.numframes; // av. posterior
+            else
+                results[i] = exp(totals[3]) / L.info.numframes; // av. expected frame-correct count
+        }
+
+        groupframes += packed.numframes;
+        groupbegin = groupend;
+    }
+    if (sMBRmode)
+    {
+        static bool dummyvariable = (fprintf(stderr, "note: new version with kappa adjustment, kappa = %.2f\n", 1 / amf), true); // we only print once
+        dummyvariable;
+    }
+    return results;
+}
 };
 };
@@ -70,6 +70,19 @@
 # Baseline files are optional. They only evaluate if test defines one or more pattern-drivern test cases.
 # If no test cases are defined, then TestDriver uses exit code of the run-test script as the only criteria
 # of successful copmpletion of the test.
+#
+# ---- Performance baselines ----
+# With --perf, TestDriver also collects from the output of the test:
+#   samplesPerSecond - median of 'SamplesPerSecond = ...' of the minibatch progress lines
+#   epochTime        - sum of 'EpochTime=...' of the finished epochs
+#   peakGpuMemoryMB  - maximum of 'PeakMemoryUsedMB = ...' (only printed by tests that set gpuTelemetry=true in SGD)
+# They are written to perf.txt in the run directory and compared against
+#   perf-baseline.<os>.<flavor>.<device>.txt
+# There is no fallback to other names as for the baseline files, since speed only compares on the same configuration.
+# A test fails if samplesPerSecond is lower, or epochTime or peakGpuMemoryMB higher than its baseline by more than
+# --perf-tolerance (10% by default). Metrics missing from the output or the baseline are not checked.
+# With --update-baseline and --perf, the performance baselines are written as well; they should come from the
+# machine the comparisons run on.
 
 # ----- Tagging system ------
 # Unit tests can be optionally tagged with 1 or many tags
@@ -301,6 +314,23 @@ class Test:
       if not testCaseRunResult.succeeded:
         result.succeeded = False
 
+    if args.perf:
+      perfMetrics = PerfMetrics.fromOutput(allLines)
+      perfMetrics.write(os.path.join(runDir, "perf.txt"))
+      perfBaselineFile = self.perfBaselineFile(flavor, device)
+      if args.update_baseline:
+        if result.succeeded:
+          if args.verbose:
+            print ("Updating performance baseline file " + perfBaselineFile)
+          perfMetrics.write(perfBaselineFile)
+      elif os.path.isfile(perfBaselineFile):
+        perfRunResult = perfMetrics.compare(PerfMetrics.read(perfBaselineFile), args.perf_tolerance)
+        if not perfRunResult.succeeded:
+          result.succeeded = False
+        result.testCaseRunResults.append(perfRunResult)
+      elif args.verbose:
+        print ("No performance baseline " + perfBaselineFile)
+
     if (self.testCases)>0 and args.update_baseline and result.succeeded:
       # When running in --update-baseline mode 
       # verifying that new output is succesfully matching every pattern in the testcases.yml
@@ -338,6 +368,11 @@ class Test:
             return fullPath
     return None
 
+  # Location of the performance baseline file: perf-baseline.$os.$flavor.$device.txt
+  def perfBaselineFile(self, flavor, device):
+    candidateName = "perf-baseline.{0}.{1}.{2}.txt".format("windows" if windows else "linux", flavor.lower(), device.lower())
+    return os.path.join(self.testDir, candidateName)
+
   # Checks whether the test matches the specified tag,
   # returns matched tag name on succes, or None if there is no match(boolean, string) tuple
   def matchesTag(self, tag, flavor, device, os, build_sku):
@@ -508,6 +543,74 @@ class TestPattern:
         return False;
     return True
 
+# Speed and memory of a test run, see 'Performance baselines' above
+class PerfMetrics:
+  # name => (regular expression of the output lines, whether higher values are better)
+  patterns = {
+    "samplesPerSecond": (re.compile(r"SamplesPerSecond = ([0-9.eE+-]+)"), True),
+    "epochTime": (re.compile(r"Finished Epoch\[.*EpochTime=([0-9.eE+-]+)"), False),
+    "peakGpuMemoryMB": (re.compile(r"PeakMemoryUsedMB = ([0-9.eE+-]+)"), False)
+  }
+
+  def __init__(self):
+    self.values = {} # name => value
+
+  @staticmethod
+  def fromOutput(lines):
+    # parallel tests print the logs of all the workers; the metrics are those of the first
+    if any(line.startswith("MPI Rank ") for line in lines):
+      lines = [line for line in lines if line.startswith("MPI Rank 0: ")]
+    found = dict((name, []) for name in PerfMetrics.patterns.keys())
+    for line in lines:
+      for name, (pattern, _) in PerfMetrics.patterns.items():
+        match = pattern.search(line)
+        if match:
+          try:
+            found[name].append(float(match.group(1)))
+          except ValueError:
+            pass
+    metrics = PerfMetrics()
+    if found["samplesPerSecond"]:
+      # the median is less sensitive to the first minibatches and to a busy machine than the mean
+      metrics.values["samplesPerSecond"] = sorted(found["samplesPerSecond"])[len(found["samplesPerSecond"]) // 2]
+    if found["epochTime"]:
+      metrics.values["epochTime"] = sum(found["epochTime"])
+    if found["peakGpuMemoryMB"]:
+      metrics.values["peakGpuMemoryMB"] = max(found["peakGpuMemoryMB"])
+    return metrics
+
+  # one 'name = value' per line
+  @staticmethod
+  def read(path):
+    metrics = PerfMetrics()
+    with open(path, "r") as f:
+      for line in f:
+        nameValue = line.split("=", 1)
+        if len(nameValue) == 2 and nameValue[0].strip() in PerfMetrics.patterns:
+          metrics.values[nameValue[0].strip()] = float(nameValue[1])
+    return metrics
+
+  def write(self, path):
+    with open(path, "w") as f:
+      for name in sorted(self.values.keys()):
+        f.write("{0} = {1:.6g}\n".format(name, self.values[name]))
+
+  # returns a TestCaseRunResult that fails if a metric is worse than its baseline by more than 'tolerance' (e.g. 0.1 for 10%)
+  def compare(self, baseline, tolerance):
+    result = TestCaseRunResult("Performance", True, "")
+    for name in sorted(self.values.keys()):
+      if not name in baseline.values or baseline.values[name] <= 0:
+        continue
+      actual, expected = self.values[name], baseline.values[name]
+      higherIsBetter = PerfMetrics.patterns[name][1]
+      regressed = actual < expected * (1 - tolerance) if higherIsBetter else actual > expected * (1 + tolerance)
+      if regressed:
+        result.succeeded = False
+      result.diagnostics += "{0}: {1:.6g} vs. {2:.6g} baseline ({3:+.1f}%){4}\n".format(
+        name, actual, expected, (actual / expected - 1) * 100, " REGRESSION" if regressed else "")
+    result.diagnostics = result.diagnostics.rstrip("\n")
+    return result
+
 class TestRunResult:
   def __init__(self):
     self.succeeded = False;
@@ -661,6 +764,8 @@ runSubparser.add_argument("-r", "--run-dir", default=defaultRunDir, help="direct
 runSubparser.add_argument("--update-baseline", action='store_true', help="update baseline file(s) instead of matching them")
 runSubparser.add_argument("-v", "--verbose", action='store_true', help="verbose output - dump all output of test script")
 runSubparser.add_argument("-n", "--dry-run", action='store_true', help="do not run the tests, only print test names and configurations to be run along with full command lines")
+runSubparser.add_argument("--perf", action='store_true', help="collect samples/sec, epoch time and peak GPU memory and compare them against perf-baseline.<os>.<flavor>.<device>.txt (or write them with --update-baseline)")
+runSubparser.add_argument("--perf-tolerance", type=float, default=0.1, help="fraction by which a performance metric may be worse than its baseline, default: 0.1")
 
 runSubparser.set_defaults(func=runCommand)
 
@@ -0,0 +1,218 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// MathBenchmark.h -- timing of Math kernels with warmup and repeats, JSON results, and a comparison against a baseline
+//
+#pragma once
+
+#include "Basics.h"
+#include "ComputeEventTimer.h"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <memory>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+struct BenchmarkResult
+{
+    std::string name;
+    DEVICEID_TYPE deviceId;
+    size_t iterations; // per sample
+    size_t samples;
+    double medianMs;   // per iteration
+    double minMs;
+    double gflops;     // from the median; 0 if the benchmark did not give its flops
+    double gbps;
+
+    // names are only unique per device
+    std::string Key() const { return name + "@" + std::to_string((int) deviceId); }
+};
+
+// -----------------------------------------------------------------------
+// MathBenchmark -- runs benchmarks and collects their results
+//
+// Run() calls the benchmark 'warmup' times, then determines how many iterations make a sample of at least
+// 'minSampleMs', and times 'samples' such samples. The device is synchronized before and after each sample, so
+// that the time of a GPU kernel is that of its execution, not of its launch. The reported time is the median over
+// the samples, which is less sensitive to a busy machine than the mean.
+// -----------------------------------------------------------------------
+
+class MathBenchmark
+{
+public:
+    MathBenchmark(size_t warmup = 3, size_t samples = 10, double minSampleMs = 20)
+        : m_warmup(warmup), m_samples(max(samples, (size_t) 1)), m_minSampleMs(minSampleMs)
+    {
+    }
+
+    // only benchmarks whose name contains 'filter' are run
+    void SetFilter(const std::string& filter) { m_filter = filter; }
+
+    // 'flops' and 'bytes' are those of one call of 'f', for GFLOP/s and GB/s; pass 0 where it does not apply
+    void Run(const std::string& name, DEVICEID_TYPE deviceId, double flops, double bytes, const std::function<void()>& f)
+    {
+        if (!m_filter.empty() && name.find(m_filter) == std::string::npos)
+            return;
+
+        for (size_t i = 0; i < m_warmup; i++)
+            f();
+        Synchronize(deviceId);
+
+        // double the iterations until a sample is long enough to be timed reliably
+        size_t iterations = 1;
+        for (;;)
+        {
+            const double ms = TimeSample(deviceId, iterations, f);
+            if (ms >= m_minSampleMs || iterations >= 1024 * 1024)
+                break;
+            iterations *= 2;
+        }
+
+        std::vector<double> times;
+        for (size_t s = 0; s < m_samples; s++)
+            times.push_back(TimeSample(deviceId, iterations, f) / iterations);
+        std::sort(times.begin(), times.end());
+
+        BenchmarkResult result;
+        result.name = name;
+        result.deviceId = deviceId;
+        result.iterations = iterations;
+        result.samples = times.size();
+        result.medianMs = times[times.size() / 2];
+        result.minMs = times.front();
+        result.gflops = result.medianMs > 0 ? flops / (result.medianMs * 1e6) : 0;
+        result.gbps = result.medianMs > 0 ? bytes / (result.medianMs * 1e6) : 0;
+        m_results.push_back(result);
+
+        fprintf(stderr, "%-48s device %2d: %10.4f ms (min %10.4f)  %9.2f GFLOP/s  %9.2f GB/s\n",
+                name.c_str(), (int) deviceId, result.medianMs, result.minMs, result.gflops, result.gbps);
+    }
+
+    const std::vector<BenchmarkResult>& GetResults() const { return m_results; }
+
+    // writes the results one benchmark per line, which is also the layout ReadBaseline() expects
+    void WriteJson(const std::wstring& path) const
+    {
+        std::ofstream out(msra::strfun::utf8(path).c_str());
+        if (!out)
+            RuntimeError("MathBenchmark: Cannot write '%ls'.", path.c_str());
+        out << "{\n  \"benchmarks\": [\n";
+        char line[1024];
+        for (size_t i = 0; i < m_results.size(); i++)
+        {
+            const auto& r = m_results[i];
+            sprintf_s(line, sizeof(line), "    { \"name\": \"%s\", \"device\": %d, \"iterations\": %d, \"samples\": %d, \"medianMs\": %.6f, \"minMs\": %.6f, \"gflops\": %.3f, \"gbps\": %.3f }%s\n",
+                      r.name.c_str(), (int) r.deviceId, (int) r.iterations, (int) r.samples, r.medianMs, r.minMs, r.gflops, r.gbps, i + 1 < m_results.size() ? "," : "");
+            out << line;
+        }
+        out << "  ]\n}\n";
+        if (!out)
+            RuntimeError("MathBenchmark: Failed to write '%ls'.", path.c_str());
+    }
+
+    // reads the median times of a file written by WriteJson(), by BenchmarkResult::Key()
+    static std::map<std::string, double> ReadBaseline(const std::wstring& path)
+    {
+        std::ifstream in(msra::strfun::utf8(path).c_str());
+        if (!in)
+            RuntimeError("MathBenchmark: Cannot read the baseline '%ls'.", path.c_str());
+        std::map<std::string, double> baseline;
+        std::string line;
+        while (std::getline(in, line))
+        {
+            std::string name;
+            double deviceId, medianMs;
+            if (!ParseStringField(line, "name", name))
+                continue;
+            if (!ParseNumberField(line, "device", deviceId) || !ParseNumberField(line, "medianMs", medianMs))
+                RuntimeError("MathBenchmark: The baseline entry for '%s' in '%ls' has no device or time.", name.c_str(), path.c_str());
+            baseline[name + "@" + std::to_string((int) deviceId)] = medianMs;
+        }
+        return baseline;
+    }
+
+    // prints each result against its baseline, and returns the number of benchmarks that are more than 'tolerance'
+    // (e.g. 0.1 for 10%) slower; benchmarks without a baseline are listed but do not count
+    size_t CompareToBaseline(const std::map<std::string, double>& baseline, double tolerance) const
+    {
+        size_t numRegressions = 0;
+        for (const auto& r : m_results)
+        {
+            auto iter = baseline.find(r.Key());
+            if (iter == baseline.end())
+            {
+                fprintf(stderr, "%-48s device %2d: no baseline\n", r.name.c_str(), (int) r.deviceId);
+                continue;
+            }
+            const double ratio = iter->second > 0 ? r.medianMs / iter->second : 1;
+            const bool isRegression = ratio > 1 + tolerance;
+            if (isRegression)
+                numRegressions++;
+            fprintf(stderr, "%-48s device %2d: %10.4f ms vs. %10.4f ms baseline (%+6.1f%%)%s\n",
+                    r.name.c_str(), (int) r.deviceId, r.medianMs, iter->second, (ratio - 1) * 100, isRegression ? "  REGRESSION" : "");
+        }
+        return numRegressions;
+    }
+
+private:
+    // milliseconds of 'iterations' calls of 'f', including the device completing them
+    double TimeSample(DEVICEID_TYPE deviceId, size_t iterations, const std::function<void()>& f)
+    {
+        const auto start = std::chrono::high_resolution_clock::now();
+        for (size_t i = 0; i < iterations; i++)
+            f();
+        Synchronize(deviceId);
+        return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    }
+
+    // waits for the work issued on the current stream of a GPU
+    void Synchronize(DEVICEID_TYPE deviceId)
+    {
+        if (deviceId < 0)
+            return;
+        auto& timer = m_deviceTimers[deviceId];
+        if (!timer)
+            timer.reset(new ComputeEventTimer(deviceId));
+        timer->Record(0);
+        timer->Synchronize(0);
+    }
+
+    // "key": "value" and "key": number, as written by WriteJson()
+    static bool ParseStringField(const std::string& line, const char* key, std::string& value)
+    {
+        const std::string pattern = std::string("\"") + key + "\": \"";
+        const size_t begin = line.find(pattern);
+        if (begin == std::string::npos)
+            return false;
+        const size_t end = line.find('"', begin + pattern.size());
+        if (end == std::string::npos)
+            return false;
+        value = line.substr(begin + pattern.size(), end - begin - pattern.size());
+        return true;
+    }
+
+    static bool ParseNumberField(const std::string& line, const char* key, double& value)
+    {
+        const std::string pattern = std::string("\"") + key + "\": ";
+        const size_t begin = line.find(pattern);
+        if (begin == std::string::npos)
+            return false;
+        return sscanf(line.c_str() + begin + pattern.size(), "%lf", &value) == 1;
+    }
+
+    size_t m_warmup;
+    size_t m_samples;
+    double m_minSampleMs;
+    std::string m_filter;
+    std::vector<BenchmarkResult> m_results;
+    std::map<DEVICEID_TYPE, std::unique_ptr<ComputeEventTimer>> m_deviceTimers;
+};
+
+} } } }
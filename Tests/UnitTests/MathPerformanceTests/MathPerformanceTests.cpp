@@ -3,6 +3,7 @@
 // Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
 //
 // MathPerformanceTests.cpp : Defines the entry point for the console application.
+// Benchmarks of the Math kernels; see Usage() for running them against a baseline.
 //
 #include "stdafx.h"
 #define NOMINMAX
@@ -13,7 +14,16 @@
 #include "Matrix.h"
 #include "CPUMatrix.h"
 #include "Sequences.h"
+#include "TensorView.h"
+#include "ConvolutionEngine.h"
+#include "MatrixQuantizerImpl.h"
+#include "QuantizedMatrix.h"
+#include "Int8QuantizedMatrix.h"
+#include "GPUDataTransferer.h"
+#include "CUDAPageLockedMemAllocator.h"
+#include "MathBenchmark.h"
 using namespace Microsoft::MSR::CNTK;
+using namespace Microsoft::MSR::CNTK::Test;
 using namespace std;
 
 template <class ElemType>
@@ -73,6 +83,9 @@ void rnnForwardPropSRP(Matrix<ElemType>& functionValues, size_t mNbr, Matrix<Ele
     }
 }
 
+template <class ElemType>
+void oldRNNForwardPropSRP(const size_t timeIdxInSeq, const int delay, const bool reset, const ElemType default_activity, Matrix<ElemType>& functionValues, const Matrix<ElemType>& pastActivity, const Matrix<ElemType>& inputFunctionValues, const size_t indexInBatch, const size_t mNbr);
+
 template <class ElemType>
 void oldRnnForwardPropSRP(Matrix<ElemType>& functionValues, size_t mNbr, Matrix<ElemType>& pastActivity, Matrix<ElemType>& inputFunctionValues)
 {
@@ -124,341 +137,473 @@ void oldRNNForwardPropSRP(const size_t timeIdxInSeq, const int delay, const bool
     }
 }
 
-/**
-The new way of resetting RNN state. 
-*/
+// -----------------------------------------------------------------------
+// benchmarks
+// Each one registers its variants with MathBenchmark::Run(), giving the flops and bytes of one call, so that the
+// results can be compared against the peak of the device. Names are "<kernel>/<variant>/<type>", e.g.
+// "gemm/2048x2048x2048/float", and must stay stable, as they are the keys of the baselines.
+// -----------------------------------------------------------------------
+
 template <class ElemType>
-void TestRnnForwardPropSRP(size_t nRow = 100, size_t nCol = 1000, size_t mNbr = 10, DEVICEID_TYPE deviceID = 0)
+static std::string TypeName()
 {
-    Matrix<ElemType> functionValues(deviceID);
-    Matrix<ElemType> colBegin(deviceID);
-    Matrix<ElemType> pastActivity(deviceID);
-    Matrix<ElemType> inputFunctionValues(deviceID);
-    Matrix<ElemType> needToCompute(deviceID);
-
-    functionValues.Resize(nRow, nCol);
-    colBegin.Resize(mNbr, 1);
-    pastActivity.Resize(nRow, nCol);
-    inputFunctionValues.Resize(nRow, nCol);
-    needToCompute.Resize(1, nCol / mNbr);
-    needToCompute.SetValue(0);
-    needToCompute.ColumnSlice(0, 1).SetValue(1);
-    auto t_start = clock();
-    rnnForwardPropSRP<ElemType>(functionValues, mNbr, pastActivity, inputFunctionValues, colBegin, needToCompute);
-    auto t_end = clock();
-    std::cout << "testRnnForwardPropSRP: " << 1.0 * (t_end - t_start) / CLOCKS_PER_SEC << " seconds" << endl;
+    return sizeof(ElemType) == sizeof(float) ? "float" : "double";
 }
 
-/**
-The old way of resetting RNN state, which used if statement. Also only supports up to two sentences within a minibatch
-*/
 template <class ElemType>
-void TestOldRnnForwardPropSRP(size_t nRow = 100, size_t nCol = 1000, size_t mNbr = 10, DEVICEID_TYPE deviceID = 0)
+static std::string Name(const std::string& kernel, const std::string& variant)
 {
-    Matrix<ElemType> functionValues(deviceID);
-    Matrix<ElemType> colBegin(deviceID);
-    Matrix<ElemType> pastActivity(deviceID);
-    Matrix<ElemType> inputFunctionValues(deviceID);
-
-    functionValues.Resize(nRow, nCol);
-    colBegin.Resize(mNbr, 1);
-    pastActivity.Resize(nRow, nCol);
-    inputFunctionValues.Resize(nRow, nCol);
-    auto t_start = clock();
-    oldRnnForwardPropSRP<ElemType>(functionValues, mNbr, pastActivity, inputFunctionValues);
-    auto t_end = clock();
-    std::cout << "TestOldRnnForwardPropSRP: " << 1.0 * (t_end - t_start) / CLOCKS_PER_SEC << " seconds" << endl;
+    return kernel + "/" + variant + "/" + TypeName<ElemType>();
 }
 
-template <class ElemType>
-void randomInitializeCPUMatrix(CPUMatrix<ElemType>& M, float min = -10, float max = 10)
+static std::string DimsName(size_t m, size_t k, size_t n)
 {
-    foreach_coord (i, j, M)
-    {
-        M(i, j) = (1.0 * rand() / RAND_MAX) * max + min;
-    }
+    return std::to_string(m) + "x" + std::to_string(k) + "x" + std::to_string(n);
 }
 
 template <class ElemType>
-void randomInitializeMatrix(Matrix<ElemType>& M, float min = -10, float max = 10)
+static void BenchmarkGemm(MathBenchmark& bench, DEVICEID_TYPE deviceId)
 {
-    foreach_coord (i, j, M)
+    struct Shape
     {
-        M(i, j) = (1.0 * rand() / RAND_MAX) * max + min;
+        size_t m, k, n;
+        bool transposeA;
+    };
+    // square, and those of fully-connected layers: W * X forward, and W' * G for the back propagation
+    const Shape shapes[] = {
+        {512, 512, 512, false},
+        {2048, 2048, 2048, false},
+        {2048, 2048, 256, false},
+        {2048, 2048, 256, true},
+        {9000, 2048, 256, false},
+        {2048, 512, 32, false},
+    };
+    for (const auto& shape : shapes)
+    {
+        Matrix<ElemType> a = shape.transposeA ? Matrix<ElemType>::RandomUniform(shape.k, shape.m, deviceId, -1, 1, 1)
+                                              : Matrix<ElemType>::RandomUniform(shape.m, shape.k, deviceId, -1, 1, 1);
+        Matrix<ElemType> b = Matrix<ElemType>::RandomUniform(shape.k, shape.n, deviceId, -1, 1, 2);
+        Matrix<ElemType> c(shape.m, shape.n, deviceId);
+        const double flops = 2.0 * shape.m * shape.k * shape.n;
+        const double bytes = sizeof(ElemType) * ((double) shape.m * shape.k + (double) shape.k * shape.n + (double) shape.m * shape.n);
+        bench.Run(Name<ElemType>(shape.transposeA ? "gemm-transposeA" : "gemm", DimsName(shape.m, shape.k, shape.n)), deviceId, flops, bytes, [&]()
+                  {
+                      Matrix<ElemType>::MultiplyAndWeightedAdd(1, a, shape.transposeA, b, false, 0, c);
+                  });
     }
 }
 
 template <class ElemType>
-void MultiplyAndWeightedAddTest(int n, int k, int m)
+static void BenchmarkElementwise(MathBenchmark& bench, DEVICEID_TYPE deviceId)
 {
-    cout << "Testing CPUMatrix" << endl;
-    cout << "A(" << n << "x" << k << ") and B(" << k << "," << m << ")" << endl;
-    CPUMatrix<ElemType> A(n, k);
-    randomInitializeCPUMatrix<ElemType>(A);
-    CPUMatrix<ElemType> B(k, m);
-    randomInitializeCPUMatrix<ElemType>(B);
-    CPUMatrix<ElemType> C(n, m);
-    auto t_start = clock();
-    CPUMatrix<ElemType>::MultiplyAndWeightedAdd(0.324, A, false, B, false, 0.632, C);
-    auto t_end = clock();
-    std::cout << "CPU Matrix in: " << 1.0 * (t_end - t_start) / CLOCKS_PER_SEC << " seconds" << endl;
-    std::cout << n << " " << k << " " << m << endl;
-
-    cout << "Testing Matrix" << endl;
-    Matrix<ElemType> AG((size_t) n, (size_t) k);
-    randomInitializeMatrix<ElemType>(AG);
-    Matrix<ElemType> BG((size_t) k, (size_t) m);
-    randomInitializeMatrix<ElemType>(BG);
-    Matrix<ElemType> CG((size_t) n, (size_t) m);
-    auto t_startG = clock();
-    Matrix<ElemType>::MultiplyAndWeightedAdd(0.324, AG, false, BG, false, 0.632, CG);
-    auto t_endG = clock();
-    std::cout << "Matrix in: " << 1.0 * (t_endG - t_startG) / CLOCKS_PER_SEC << " seconds" << endl;
+    const size_t rows = 2048, cols = 2048;
+    const double n = (double) rows * cols;
+    Matrix<ElemType> a = Matrix<ElemType>::RandomUniform(rows, cols, deviceId, -1, 1, 1);
+    Matrix<ElemType> b = Matrix<ElemType>::RandomUniform(rows, cols, deviceId, -1, 1, 2);
+    Matrix<ElemType> c(rows, cols, deviceId);
+    TensorView<ElemType> ta(a), tb(b), tc(c);
+
+    bench.Run(Name<ElemType>("elementwise", "sum"), deviceId, n, 3 * n * sizeof(ElemType), [&]()
+              {
+                  tc.AssignSumOf(ta, tb);
+              });
+    bench.Run(Name<ElemType>("elementwise", "product"), deviceId, n, 3 * n * sizeof(ElemType), [&]()
+              {
+                  c.AssignElementProductOf(a, b);
+              });
+    // transcendental functions have no meaningful flop count
+    bench.Run(Name<ElemType>("elementwise", "sigmoid"), deviceId, 0, 2 * n * sizeof(ElemType), [&]()
+              {
+                  c.AssignSigmoidOf(a);
+              });
+    bench.Run(Name<ElemType>("elementwise", "tanh"), deviceId, 0, 2 * n * sizeof(ElemType), [&]()
+              {
+                  tc.AssignTanhOf(ta);
+              });
 }
 
 template <class ElemType>
-void AddMultiplyAndInplaceSigmoidTest(int n, int k, int m)
+static void BenchmarkReductions(MathBenchmark& bench, DEVICEID_TYPE deviceId)
 {
-    cout << "Testing CPUMatrix" << endl;
-    cout << "A(" << n << "x" << k << ") and B(" << k << "," << m << ")" << endl;
-    CPUMatrix<ElemType> A(n, k);
-    randomInitializeCPUMatrix<ElemType>(A);
-    CPUMatrix<ElemType> B(k, m);
-    randomInitializeCPUMatrix<ElemType>(B);
-    CPUMatrix<ElemType> D(n, m);
-    randomInitializeCPUMatrix<ElemType>(D);
-    CPUMatrix<ElemType> C(n, m);
-    auto t_start = clock();
-    C = A * B + D;
-    // C.InplaceSigmoid();
-    auto t_end = clock();
-    std::cout << "CPU Matrix in: " << 1.0 * (t_end - t_start) / CLOCKS_PER_SEC << " seconds" << endl;
-    std::cout << n << " " << k << " " << m << endl;
-
-    cout << "Testing Matrix" << endl;
-    Matrix<ElemType> AG((size_t) n, (size_t) k);
-    randomInitializeMatrix<ElemType>(AG);
-    Matrix<ElemType> BG((size_t) k, (size_t) m);
-    randomInitializeMatrix<ElemType>(BG);
-    Matrix<ElemType> DG((size_t) n, (size_t) m);
-    randomInitializeMatrix<ElemType>(DG);
-    Matrix<ElemType> CG((size_t) n, (size_t) m);
-    auto t_startG = clock();
-    CG = AG * BG + DG;
-    // CG.InplaceSigmoid();
-    auto t_endG = clock();
-    std::cout << "Matrix in: " << 1.0 * (t_endG - t_startG) / CLOCKS_PER_SEC << " seconds" << endl;
+    const size_t rows = 2048, cols = 2048;
+    const double n = (double) rows * cols;
+    Matrix<ElemType> a = Matrix<ElemType>::RandomUniform(rows, cols, deviceId, -1, 1, 1);
+    Matrix<ElemType> rowSums(rows, 1, deviceId);
+    Matrix<ElemType> colSums(1, cols, deviceId);
+    TensorView<ElemType> ta(a, TensorShape(rows, cols));
+    TensorView<ElemType> tRowSums(rowSums, TensorShape(rows, 1));
+    TensorView<ElemType> tColSums(colSums, TensorShape(1, cols));
+
+    // a copy into a tensor with dimensions of 1 sums over them
+    bench.Run(Name<ElemType>("reduce", "over-columns"), deviceId, n, n * sizeof(ElemType), [&]()
+              {
+                  tRowSums.AssignCopyOf(ta);
+              });
+    bench.Run(Name<ElemType>("reduce", "over-rows"), deviceId, n, n * sizeof(ElemType), [&]()
+              {
+                  tColSums.AssignCopyOf(ta);
+              });
 }
 
 template <class ElemType>
-void ColumnSliceMultAndAddTest(int n, int k, int m, DEVICEID_TYPE deviceID)
+static void BenchmarkSparse(MathBenchmark& bench, DEVICEID_TYPE deviceId)
 {
-    cout << "Testing Matrix" << endl;
-
-    Matrix<ElemType> AG((size_t) n, (size_t) k, deviceID);
-    AG.SetUniformRandomValue(-1, 1);
-
-    Matrix<ElemType> BG((size_t) k, (size_t) m, deviceID);
-    BG.SetUniformRandomValue(-1, 1);
-
-    Matrix<ElemType> CG((size_t) n, (size_t) m, deviceID);
-    Matrix<ElemType> DG((size_t) n, (size_t) m, deviceID);
-
-    auto t_startG = clock();
-    Matrix<ElemType>::MultiplyAndAdd(AG, false, BG, false, CG);
-    auto t_endG = clock();
-    std::cout << "MultiplyAndAdd Directly: " << 1.0 * (t_endG - t_startG) / CLOCKS_PER_SEC << " seconds" << endl;
-
-    t_startG = clock();
-    for (int i = 0; i < m; i++)
+    // W * X for an input layer, with X [k x n] a sparse minibatch of nnzPerCol values per column
+    const size_t m = 512, k = 100000, n = 256;
+    for (size_t nnzPerCol : {1, 32})
     {
-        Matrix<ElemType> col_BG = BG.ColumnSlice(i, 1);
-        Matrix<ElemType> col_CG = CG.ColumnSlice(i, 1);
-        Matrix<ElemType>::MultiplyAndAdd(AG, false, col_BG, false, col_CG);
-    }
-    t_endG = clock();
-    std::cout << "MultiplyAndAdd With ColumnSlice: " << 1.0 * (t_endG - t_startG) / CLOCKS_PER_SEC << " seconds" << endl;
-
-    t_startG = clock();
-    for (int i = 0; i < m; i++)
-    {
-        Matrix<ElemType> col_BG = BG.ColumnSlice(i, 1);
-        Matrix<ElemType> col_CG = CG.ColumnSlice(i, 1);
-        Matrix<ElemType>::MultiplyAndAdd(AG, false, col_BG, false, col_CG);
-    }
-    t_endG = clock();
-    std::cout << "MultiplyAndAdd With ColumnSlice&: " << 1.0 * (t_endG - t_startG) / CLOCKS_PER_SEC << " seconds" << endl;
-
-    Matrix<ElemType> col_BG1(0), col_CG1(0);
-    t_startG = clock();
-    for (int i = 0; i < m; i++)
-    {
-        col_BG1.AssignColumnSlice(BG, i, 1);
-        col_CG1.AssignColumnSlice(CG, i, 1);
-        Matrix<ElemType>::MultiplyAndAdd(AG, false, col_BG1, false, col_CG1);
-    }
-    t_endG = clock();
-    std::cout << "MultiplyAndAdd With AssignColumnSlice: " << 1.0 * (t_endG - t_startG) / CLOCKS_PER_SEC << " seconds" << endl;
-
-    t_startG = clock();
-    for (int i = 0; i < m; i++)
-    {
-        Matrix<ElemType> col_CG = CG.ColumnSlice(i, 1);
-        Matrix<ElemType> col_DG = DG.ColumnSlice(i, 1);
-        col_DG.AssignSigmoidOf(col_CG);
+        std::vector<CPUSPARSE_INDEX_TYPE> colOffsets(n + 1);
+        std::vector<CPUSPARSE_INDEX_TYPE> rowIndices;
+        std::vector<ElemType> values;
+        for (size_t j = 0; j < n; j++)
+        {
+            colOffsets[j] = (CPUSPARSE_INDEX_TYPE) rowIndices.size();
+            for (size_t i = 0; i < nnzPerCol; i++)
+            {
+                rowIndices.push_back((CPUSPARSE_INDEX_TYPE) ((j * 7919 + i * (k / nnzPerCol)) % k)); // distinct within a column
+                values.push_back((ElemType) 1);
+            }
+            std::sort(rowIndices.begin() + colOffsets[j], rowIndices.end());
+        }
+        colOffsets[n] = (CPUSPARSE_INDEX_TYPE) rowIndices.size();
+
+        Matrix<ElemType> w = Matrix<ElemType>::RandomUniform(m, k, deviceId, -1, 1, 1);
+        Matrix<ElemType> x(k, n, deviceId, MatrixType::SPARSE, matrixFormatSparseCSC);
+        x.SetMatrixFromCSCFormat(colOffsets.data(), rowIndices.data(), values.data(), values.size(), k, n);
+        Matrix<ElemType> c(m, n, deviceId);
+        const double nz = (double) values.size();
+        bench.Run(Name<ElemType>("sparse-dense-x-sparse", DimsName(m, k, n) + "-nnz" + std::to_string(nnzPerCol)), deviceId, 2.0 * m * nz,
+                  sizeof(ElemType) * (m * nz + (double) m * n) + (sizeof(ElemType) + sizeof(CPUSPARSE_INDEX_TYPE)) * nz, [&]()
+                  {
+                      Matrix<ElemType>::MultiplyAndWeightedAdd(1, w, false, x, false, 0, c);
+                  });
     }
-    t_endG = clock();
-    std::cout << "AssignSigmoidOf With ColumnSlice: " << 1.0 * (t_endG - t_startG) / CLOCKS_PER_SEC << " seconds" << endl;
+}
 
-    t_startG = clock();
-    for (int i = 0; i < m; i++)
-    {
-        col_BG1.AssignColumnSlice(BG, i, 1);
-        col_CG1.AssignColumnSlice(CG, i, 1);
-        col_BG1.AssignSigmoidOf(col_CG1);
-    }
-    t_endG = clock();
-    std::cout << "AssignSigmoidOf With AssignColumnSlice: " << 1.0 * (t_endG - t_startG) / CLOCKS_PER_SEC << " seconds" << endl;
+static size_t GetNumOut(size_t in, size_t kernel, size_t stride)
+{
+    return (in - kernel) / stride + 1;
 }
 
 template <class ElemType>
-void SquareMultiplyAndAdd10TimesAvgTest(int n, int count)
+static void BenchmarkConvolution(MathBenchmark& bench, DEVICEID_TYPE deviceId)
 {
-    cout << "Testing CPUMatrix" << endl;
-    cout << "A(" << n << "x" << n << ") and B(" << n << "," << n << ")" << endl;
+    typedef ConvolutionEngineFactory<ElemType> ConvFact;
 
-    double cpu_avg = 0;
-    for (int i = 0; i < count; ++i)
+    struct Engine
     {
-        CPUMatrix<ElemType> A(n, n);
-        randomInitializeCPUMatrix<ElemType>(A);
-        CPUMatrix<ElemType> B(n, n);
-        randomInitializeCPUMatrix<ElemType>(B);
-        CPUMatrix<ElemType> C(n, n);
-        auto t_start = clock();
-        CPUMatrix<ElemType>::MultiplyAndWeightedAdd(0.324, A, false, B, false, 0.632, C);
-        auto t_end = clock();
-        double val = 1.0 * (t_end - t_start) / CLOCKS_PER_SEC;
-        if (i == 0)
+        const char* name;
+        typename ConvFact::EngineType type;
+        ImageLayoutKind layout;
+    };
+    std::vector<Engine> engines = {{"legacy", ConvFact::EngineType::Legacy, ImageLayoutKind::HWC}};
+    if (deviceId >= 0)
+    {
+        try
         {
-            cpu_avg = val;
+            ConvFact::Create(deviceId, ConvFact::EngineType::CuDnn, ImageLayoutKind::CHW);
+            engines.push_back({"cudnn", ConvFact::EngineType::CuDnn, ImageLayoutKind::CHW});
         }
-        else
+        catch (const std::runtime_error&)
         {
-            cpu_avg = cpu_avg * (i - 1) / i + val / i;
+            fprintf(stderr, "BenchmarkConvolution: cuDNN is not available on device %d.\n", (int) deviceId);
         }
     }
 
-    cout << "Testing Matrix" << endl;
-    double m_avg = 0;
-    for (int i = 0; i < count; ++i)
+    const size_t n = 32;
+    for (const auto& engine : engines)
     {
-        Matrix<ElemType> AG((size_t) n, (size_t) n);
-        randomInitializeMatrix<ElemType>(AG);
-        Matrix<ElemType> BG((size_t) n, (size_t) n);
-        randomInitializeMatrix<ElemType>(BG);
-        Matrix<ElemType> CG((size_t) n, (size_t) n);
-        auto t_startG = clock();
-        Matrix<ElemType>::MultiplyAndWeightedAdd(0.324, AG, false, BG, false, 0.632, CG);
-        auto t_endG = clock();
-        double val = 1.0 * (t_endG - t_startG) / CLOCKS_PER_SEC;
-        if (i == 0)
+        auto fact = ConvFact::Create(deviceId, engine.type, engine.layout);
+
+        // a 3x3 convolution in the middle of an image network
         {
-            m_avg = val;
+            const size_t inW = 28, inH = 28, cmapIn = 64, kW = 3, kH = 3, cmapOut = 64;
+            const size_t outW = GetNumOut(inW, kW, 1), outH = GetNumOut(inH, kH, 1);
+            auto eng = fact->CreateConvEngine(deviceId, engine.layout, 0, BatchNormImpl::Cntk);
+            auto inT = fact->CreateTensor(inW, inH, cmapIn, n);
+            auto filtT = fact->CreateFilter(kW, kH, cmapIn, cmapOut);
+            auto outT = fact->CreateTensor(outW, outH, cmapOut, n);
+            auto convT = fact->CreateConvDescriptor(*inT, *filtT, 1, 1, false);
+
+            Matrix<ElemType> in = Matrix<ElemType>::RandomUniform(inW * inH * cmapIn, n, deviceId, -1, 1, 1);
+            Matrix<ElemType> filt = Matrix<ElemType>::RandomUniform(cmapOut, kW * kH * cmapIn, deviceId, -1, 1, 2);
+            Matrix<ElemType> out(outW * outH * cmapOut, n, deviceId);
+            Matrix<ElemType> workspace(deviceId);
+            const double flops = 2.0 * outW * outH * cmapOut * kW * kH * cmapIn * n;
+            const double bytes = sizeof(ElemType) * ((double) in.GetNumElements() + filt.GetNumElements() + out.GetNumElements());
+            bench.Run(Name<ElemType>(std::string("conv-") + engine.name, "28x28x64-3x3x64-n32"), deviceId, flops, bytes, [&]()
+                      {
+                          eng->Forward(*inT, in, *filtT, filt, *convT, *outT, out, workspace);
+                      });
         }
-        else
+
+        // 3x3 max pooling with stride 2
         {
-            m_avg = m_avg * (i - 1) / i + val / i;
+            const size_t inW = 56, inH = 56, cmap = 64, w = 3, h = 3, stride = 2;
+            const size_t outW = GetNumOut(inW, w, stride), outH = GetNumOut(inH, h, stride);
+            auto eng = fact->CreatePoolEngine(deviceId, engine.layout);
+            auto inT = fact->CreateTensor(inW, inH, cmap, n);
+            auto outT = fact->CreateTensor(outW, outH, cmap, n);
+            auto poolT = fact->CreatePoolDescriptor(PoolingDescriptor::PoolKind::Max, w, h, stride, stride, 0, 0);
+
+            Matrix<ElemType> in = Matrix<ElemType>::RandomUniform(inW * inH * cmap, n, deviceId, -1, 1, 1);
+            Matrix<ElemType> out(outW * outH * cmap, n, deviceId);
+            bench.Run(Name<ElemType>(std::string("pool-") + engine.name, "max-56x56x64-3x3s2-n32"), deviceId, 0,
+                      sizeof(ElemType) * ((double) in.GetNumElements() + out.GetNumElements()), [&]()
+                      {
+                          eng->Forward(*inT, in, *poolT, *outT, out);
+                      });
         }
     }
-
-    cout << "Based on " << count << " runs:" << endl;
-    cout << "Average time for CPUMatrix is: " << cpu_avg << " seconds" << endl;
-    cout << "Average time for Matrix is: " << m_avg << " seconds" << endl;
-    cout << "CPUMatrix/Matrix ratio is: " << cpu_avg / m_avg << " seconds" << endl;
 }
 
 template <class ElemType>
-void MandSTest(int count, int devId)
+static void BenchmarkQuantizers(MathBenchmark& bench, DEVICEID_TYPE deviceId)
 {
-    ElemType* arr = new ElemType[count];
-    for (int i = 0; i < count; ++i)
-        arr[i] = (1.0 * rand()) / RAND_MAX + 1;
-
-    ElemType* data1 = new ElemType[1024 * 4096];
-    for (int i = 0; i < 1024 * 4096; ++i)
-        data1[i] = (1.0 * rand()) / RAND_MAX + 1;
-
-    ElemType* data2 = new ElemType[1024 * 4096];
-    for (int i = 0; i < 1024 * 4096; ++i)
-        data2[i] = (1.0 * rand()) / RAND_MAX + 1;
-
-    ElemType* data3 = new ElemType[1024];
-    for (int i = 0; i < 1024; ++i)
-        data3[i] = (1.0 * rand()) / RAND_MAX + 1;
-
-    cout << "Testing Matrix" << endl;
-    Matrix<ElemType> A(1024, 4096, data1, true, devId);
-    Matrix<ElemType> B(4096, 1024, data2, true, devId);
-    Matrix<ElemType> V(1024, 1, data3, true, devId);
-    Matrix<ElemType> C(1024, 1024, devId);
-
-    auto t_startG = clock();
-    for (int i = 0; i < count; ++i)
+    // 1-bit SGD: quantizing a gradient with its residual, into the CPU buffer it is exchanged from, and back
+    const size_t rows = 2048, cols = 2048;
+    const double n = (double) rows * cols;
+    std::unique_ptr<MemAllocator> allocator(deviceId == CPUDEVICE ? nullptr : new CUDAPageLockedMemAllocator(deviceId));
+    std::unique_ptr<MatrixQuantizerImpl<ElemType>> quantizer(MatrixQuantizerImpl<ElemType>::Create(deviceId, false /*useAsync*/));
+    Matrix<ElemType> gradient = Matrix<ElemType>::RandomUniform(rows, cols, deviceId, -1, 1, 1);
+    Matrix<ElemType> residual(rows, cols, deviceId);
+    residual.SetValue(0);
+    Matrix<ElemType> unquantized(rows, cols, deviceId);
+    for (size_t numBits : {1, 2})
     {
-        // Matrix<ElemType>::MultiplyAndWeightedAdd(arr[i],A,false,B,false,3.2*arr[i],C);
-        C += (A * arr[i]) * (B * (arr[i] * 2.3));
+        QuantizedMatrix<ElemType> quantized(rows, cols, numBits, CPUDEVICE, allocator.get());
+        const double quantizedBytes = (double) QuantizedColumn<ElemType>::QuantizedColumnSize(numBits, rows) * cols;
+        bench.Run(Name<ElemType>("quantize", std::to_string(numBits) + "bit-" + DimsName(rows, cols, 1)), deviceId, 0, 3 * n * sizeof(ElemType) + quantizedBytes, [&]()
+                  {
+                      quantizer->QuantizeAsync(gradient, residual, quantized, residual, false);
+                      quantizer->WaitQuantizeAsyncDone();
+                  });
+        bench.Run(Name<ElemType>("unquantize", std::to_string(numBits) + "bit-" + DimsName(rows, cols, 1)), deviceId, 0, n * sizeof(ElemType) + quantizedBytes, [&]()
+                  {
+                      quantizer->UnquantizeAsync(quantized, unquantized, false);
+                      quantizer->WaitUnquantizeAsyncDone();
+                  });
     }
-    auto t_endG = clock();
-    double valM = 1.0 * (t_endG - t_startG) / (CLOCKS_PER_SEC * count);
-    cout << "Matrix C+=alpha*A*beta*B in: " << valM << " seconds" << endl;
-
-    cout << "Testing CPUMatrix" << endl;
-    CPUMatrix<ElemType> AC(1024, 4096, data1, true);
-    CPUMatrix<ElemType> BC(4096, 1024, data2, true);
-    CPUMatrix<ElemType> VC(1024, 1, data3, true);
-    CPUMatrix<ElemType> CC(1024, 1024);
-
-    auto t_startC = clock();
-    for (int i = 0; i < count; ++i)
+
+    // int8 inference, against the gemm of the same shape
+    if (deviceId == CPUDEVICE)
     {
-        CPUMatrix<ElemType>::MultiplyAndWeightedAdd(arr[i], AC, false, BC, false, 3.2 * arr[i], CC);
-        // CC+=(arr[i]*AC)*((arr[i]*2.3)*BC);
+        const size_t m = 2048, k = 2048, batch = 32;
+        Matrix<ElemType> w = Matrix<ElemType>::RandomUniform(m, k, deviceId, -1, 1, 1);
+        Matrix<ElemType> x = Matrix<ElemType>::RandomUniform(k, batch, deviceId, -1, 1, 2);
+        Matrix<ElemType> y(m, batch, deviceId);
+        Int8QuantizedMatrix<ElemType> wq(w);
+        bench.Run(Name<ElemType>("int8-multiply", DimsName(m, k, batch)), deviceId, 2.0 * m * k * batch, (double) wq.GetSizeInBytes() + sizeof(ElemType) * ((double) k * batch + (double) m * batch), [&]()
+                  {
+                      wq.Multiply(x, y);
+                  });
     }
-    auto t_endC = clock();
-    double valMC = 1.0 * (t_endC - t_startC) / (CLOCKS_PER_SEC * count);
-    cout << "CPUMatrix C+=alpha*A*beta*B in: " << valMC << " seconds" << endl;
-
-    delete[] arr;
-    delete[] data1;
-    delete[] data2;
-    delete[] data3;
 }
 
-int wmain()
+template <class ElemType>
+static void BenchmarkTransfers(MathBenchmark& bench, DEVICEID_TYPE deviceId)
 {
-    ColumnSliceMultAndAddTest<float>(2048, 2048, 256, 0);
+    if (deviceId < 0)
+        return;
+
+    // a minibatch of 64 MB, from and into page-locked memory, as readers and the 1-bit SGD use it
+    const size_t numElements = 64 * 1024 * 1024 / sizeof(ElemType);
+    const double bytes = (double) numElements * sizeof(ElemType);
+    Matrix<ElemType> gpuMatrix(numElements, 1, deviceId);
+    ElemType* cpuBuffer = (ElemType*) CUDAPageLockedMemAllocator::Malloc(numElements * sizeof(ElemType), deviceId);
+    memset(cpuBuffer, 0, numElements * sizeof(ElemType));
+    {
+        GPUDataTransferer<ElemType> transferer(deviceId, true /*useConcurrentStreams*/);
+        bench.Run(Name<ElemType>("transfer", "cpu-to-gpu-64MB"), deviceId, 0, bytes, [&]()
+                  {
+                      transferer.CopyCPUToGPUAsync(cpuBuffer, numElements, gpuMatrix.BufferPointer());
+                      transferer.WaitForCopyCPUToGPUAsync();
+                  });
+        bench.Run(Name<ElemType>("transfer", "gpu-to-cpu-64MB"), deviceId, 0, bytes, [&]()
+                  {
+                      transferer.CopyGPUToCPUAsync(gpuMatrix.BufferPointer(), numElements, cpuBuffer);
+                      transferer.WaitForCopyGPUToCPUAsync();
+                  });
+    }
+    CUDAPageLockedMemAllocator::Free(cpuBuffer, deviceId);
+}
 
-    TestRnnForwardPropSRP<float>();
+// multiplications on column slices, against one multiplication of the whole matrix
+template <class ElemType>
+static void BenchmarkColumnSlices(MathBenchmark& bench, DEVICEID_TYPE deviceId)
+{
+    const size_t n = 2048, k = 2048, m = 256;
+    Matrix<ElemType> a = Matrix<ElemType>::RandomUniform(n, k, deviceId, -1, 1, 1);
+    Matrix<ElemType> b = Matrix<ElemType>::RandomUniform(k, m, deviceId, -1, 1, 2);
+    Matrix<ElemType> c(n, m, deviceId);
+    Matrix<ElemType> d(n, m, deviceId);
+    c.SetValue(0);
+    const double flops = 2.0 * n * k * m;
+
+    bench.Run(Name<ElemType>("columnslice", "multiply-whole"), deviceId, flops, 0, [&]()
+              {
+                  Matrix<ElemType>::MultiplyAndAdd(a, false, b, false, c);
+              });
+    bench.Run(Name<ElemType>("columnslice", "multiply-per-column"), deviceId, flops, 0, [&]()
+              {
+                  for (size_t i = 0; i < m; i++)
+                  {
+                      Matrix<ElemType> colB = b.ColumnSlice(i, 1);
+                      Matrix<ElemType> colC = c.ColumnSlice(i, 1);
+                      Matrix<ElemType>::MultiplyAndAdd(a, false, colB, false, colC);
+                  }
+              });
+    Matrix<ElemType> colB(deviceId), colC(deviceId);
+    bench.Run(Name<ElemType>("columnslice", "multiply-per-assigned-column"), deviceId, flops, 0, [&]()
+              {
+                  for (size_t i = 0; i < m; i++)
+                  {
+                      colB.AssignColumnSlice(b, i, 1);
+                      colC.AssignColumnSlice(c, i, 1);
+                      Matrix<ElemType>::MultiplyAndAdd(a, false, colB, false, colC);
+                  }
+              });
+    bench.Run(Name<ElemType>("columnslice", "sigmoid-per-column"), deviceId, 0, 2.0 * n * m * sizeof(ElemType), [&]()
+              {
+                  for (size_t i = 0; i < m; i++)
+                  {
+                      Matrix<ElemType> colC = c.ColumnSlice(i, 1);
+                      Matrix<ElemType> colD = d.ColumnSlice(i, 1);
+                      colD.AssignSigmoidOf(colC);
+                  }
+              });
+}
 
-    TestOldRnnForwardPropSRP<float>();
+// the new way of resetting the RNN state at sentence begins, against the old one of one column at a time
+template <class ElemType>
+static void BenchmarkRnnReset(MathBenchmark& bench, DEVICEID_TYPE deviceId)
+{
+    const size_t nRow = 100, nCol = 1000, mNbr = 10;
+    Matrix<ElemType> functionValues(nRow, nCol, deviceId);
+    Matrix<ElemType> colBegin(mNbr, 1, deviceId);
+    Matrix<ElemType> pastActivity(nRow, nCol, deviceId);
+    Matrix<ElemType> inputFunctionValues(nRow, nCol, deviceId);
+    Matrix<ElemType> needToCompute(1, nCol / mNbr, deviceId);
+    colBegin.SetValue(0);
+    pastActivity.SetValue(0);
+    inputFunctionValues.SetValue(0);
+    needToCompute.SetValue(0);
+    needToCompute.ColumnSlice(0, 1).SetValue(1);
 
-    // MandSTest<float>(100, 2);
+    bench.Run(Name<ElemType>("rnn-reset", "new"), deviceId, 0, 0, [&]()
+              {
+                  rnnForwardPropSRP<ElemType>(functionValues, mNbr, pastActivity, inputFunctionValues, colBegin, needToCompute);
+              });
+    bench.Run(Name<ElemType>("rnn-reset", "old"), deviceId, 0, 0, [&]()
+              {
+                  oldRnnForwardPropSRP<ElemType>(functionValues, mNbr, pastActivity, inputFunctionValues);
+              });
+}
 
-    /*cout<<endl<<"********************Matrix SquareMultiplyAndWeightedAdd10TimesAvg TEST********************"<<endl;
-    SquareMultiplyAndAdd10TimesAvgTest<float>(4096,10);
+template <class ElemType>
+static void RunBenchmarks(MathBenchmark& bench, DEVICEID_TYPE deviceId)
+{
+    BenchmarkGemm<ElemType>(bench, deviceId);
+    BenchmarkElementwise<ElemType>(bench, deviceId);
+    BenchmarkReductions<ElemType>(bench, deviceId);
+    BenchmarkSparse<ElemType>(bench, deviceId);
+    BenchmarkConvolution<ElemType>(bench, deviceId);
+    BenchmarkQuantizers<ElemType>(bench, deviceId);
+    BenchmarkTransfers<ElemType>(bench, deviceId);
+    BenchmarkColumnSlices<ElemType>(bench, deviceId);
+    BenchmarkRnnReset<ElemType>(bench, deviceId);
+}
 
-    cout<<endl<<"********************Matrix AddMultiplyAndInplaceSigmoid TEST********************"<<endl;    
-    AddMultiplyAndInplaceSigmoidTest<float>(11,10,12);    
-    AddMultiplyAndInplaceSigmoidTest<float>(110,100,120);    
-    AddMultiplyAndInplaceSigmoidTest<float>(1100,1000,1200);    
-    AddMultiplyAndInplaceSigmoidTest<float>(11000,10000,1200);
+static void Usage()
+{
+    fprintf(stderr,
+            "MathPerformanceTests [-device <id>]... [-type float|double] [-filter <substring>] [-warmup <n>] [-samples <n>]\n"
+            "                     [-out <results.json>] [-baseline <baseline.json>] [-tolerance <fraction>]\n"
+            "  -device     -1 for the CPU, or a GPU id; may be given several times (default: the CPU, and GPU 0 unless CPUONLY)\n"
+            "  -filter     only run the benchmarks whose name contains it, e.g. gemm/ or /double\n"
+            "  -out        write the results as JSON; the file of a reference run serves as a baseline\n"
+            "  -baseline   compare against a file written by -out; the exit code is 1 if a benchmark is slower than that\n"
+            "  -tolerance  the fraction by which a benchmark may be slower than its baseline (default: 0.1)\n");
+}
 
-    cout<<endl<<"********************Matrix MultiplyAndWeightedAdd TEST********************"<<endl;    
-    MultiplyAndWeightedAddTest<float>(11,10,12);    
-    MultiplyAndWeightedAddTest<float>(110,100,120);    
-    MultiplyAndWeightedAddTest<float>(1100,1000,1200);    
-    MultiplyAndWeightedAddTest<float>(11000,10000,12000);*/
+int wmain(int argc, wchar_t* argv[])
+{
+    try
+    {
+        std::vector<DEVICEID_TYPE> deviceIds;
+        std::wstring type = L"float", filter, outPath, baselinePath;
+        size_t warmup = 3, samples = 10;
+        double tolerance = 0.1;
+        for (int i = 1; i < argc; i++)
+        {
+            const std::wstring arg = argv[i];
+            if (i + 1 >= argc)
+            {
+                Usage();
+                return 2;
+            }
+            const std::wstring value = argv[++i];
+            if (arg == L"-device")
+                deviceIds.push_back((DEVICEID_TYPE) std::stoi(value));
+            else if (arg == L"-type")
+                type = value;
+            else if (arg == L"-filter")
+                filter = value;
+            else if (arg == L"-warmup")
+                warmup = std::stoul(value);
+            else if (arg == L"-samples")
+                samples = std::stoul(value);
+            else if (arg == L"-out")
+                outPath = value;
+            else if (arg == L"-baseline")
+                baselinePath = value;
+            else if (arg == L"-tolerance")
+                tolerance = std::stod(value);
+            else
+            {
+                Usage();
+                return 2;
+            }
+        }
+        if (deviceIds.empty())
+        {
+            deviceIds.push_back(CPUDEVICE);
+#ifndef CPUONLY
+            deviceIds.push_back(0);
+#endif
+        }
+        if (type != L"float" && type != L"double")
+            InvalidArgument("MathPerformanceTests: -type must be float or double, not '%ls'.", type.c_str());
 
-    return 0;
+        // read the baseline first, so that a wrong path does not fail only after all the benchmarks ran
+        std::map<std::string, double> baseline;
+        if (!baselinePath.empty())
+            baseline = MathBenchmark::ReadBaseline(baselinePath);
+
+        MathBenchmark bench(warmup, samples);
+        bench.SetFilter(msra::strfun::utf8(filter));
+        for (auto deviceId : deviceIds)
+        {
+            if (type == L"float")
+                RunBenchmarks<float>(bench, deviceId);
+            else
+                RunBenchmarks<double>(bench, deviceId);
+        }
+
+        if (!outPath.empty())
+            bench.WriteJson(outPath);
+        if (!baselinePath.empty())
+        {
+            const size_t numRegressions = bench.CompareToBaseline(baseline, tolerance);
+            fprintf(stderr, "%d of %d benchmarks are more than %.0f%% slower than their baseline.\n",
+                    (int) numRegressions, (int) bench.GetResults().size(), tolerance * 100);
+            return numRegressions > 0 ? 1 : 0;
+        }
+        return 0;
+    }
+    catch (const std::exception& e)
+    {
+        fprintf(stderr, "MathPerformanceTests: %s\n", e.what());
+        return 2;
+    }
 }
@@ -4,6 +4,9 @@
 //
 #include "stdafx.h"
 #include "../../../Source/Math/CPUMatrix.h"
+#include "../../../Source/Math/HostCachingMemAllocator.h"
+#include "../../../Source/Math/CPUThreadBudget.h"
+#include <omp.h>
 
 using namespace Microsoft::MSR::CNTK;
 
@@ -61,6 +64,59 @@ BOOST_FIXTURE_TEST_CASE(CPUMatrixConstructorFormatRowMajor, RandomSeedFixture)
     BOOST_CHECK_EQUAL(m(1, 2), 12);
 }
 
+BOOST_FIXTURE_TEST_CASE(CPUMatrixSetValueExternalBuffer, RandomSeedFixture)
+{
+    std::array<float, 6> array1 = {1, 2, 3, 4, 5, 6};
+    std::array<float, 6> array2 = {7, 8, 9, 10, 11, 12};
+    SMatrix m(2, 2);
+    m.SetValue(2, 3, array1.data(), matrixFlagDontOwnBuffer);
+    BOOST_CHECK_EQUAL(m(1, 2), 6);
+    // rebinding must neither free nor copy into the previous buffer
+    m.SetValue(2, 3, array2.data(), matrixFlagDontOwnBuffer);
+    BOOST_CHECK_EQUAL(m(1, 2), 12);
+    BOOST_CHECK_EQUAL(array1[5], 6);
+    m(0, 0) = 0;
+    BOOST_CHECK_EQUAL(array2[0], 0);
+}
+
+BOOST_FIXTURE_TEST_CASE(CPUMatrixResizeReusesCachedMemory, RandomSeedFixture)
+{
+    // the arrays come from HostCachingMemAllocator: aligned, and recycled across resizes
+    DMatrix m(30, 20);
+    BOOST_CHECK_EQUAL((size_t) m.BufferPointer() % HostCachingMemAllocator::Alignment, 0);
+    const double* data = m.BufferPointer();
+
+    m.Resize(10, 20, false /*growOnly*/);
+    m.Resize(30, 20, false /*growOnly*/);
+    BOOST_CHECK_EQUAL(m.BufferPointer(), data);
+    BOOST_CHECK_EQUAL((size_t) m.BufferPointer() % HostCachingMemAllocator::Alignment, 0);
+
+    // reused memory is zero-initialized like fresh memory
+    foreach_coord (i, j, m)
+        BOOST_CHECK_EQUAL(m(i, j), 0);
+}
+
+BOOST_FIXTURE_TEST_CASE(CPUMatrixThreadBudget, RandomSeedFixture)
+{
+    const int numThreads = omp_get_max_threads();
+    CPUThreadBudget budget(1, std::vector<int>{0});
+    {
+        CPUThreadBudget::Scope scope(budget);
+        BOOST_CHECK_EQUAL(omp_get_max_threads(), 1);
+
+        // results do not depend on the number of threads
+        DMatrix a(3, 4), b(4, 2), c(3, 2);
+        a.SetValue(1);
+        b.SetValue(2);
+        DMatrix::Multiply(a, b, c);
+        foreach_coord (i, j, c)
+            BOOST_CHECK_EQUAL(c(i, j), 8);
+    }
+    BOOST_CHECK_EQUAL(omp_get_max_threads(), numThreads);
+
+    BOOST_CHECK_THROW(CPUThreadBudget(1, std::vector<int>{-1}), std::invalid_argument);
+}
+
 BOOST_FIXTURE_TEST_CASE(CPUMatrixAddAndSub, RandomSeedFixture)
 {
     DMatrix m0(2, 3);
@@ -314,6 +370,10 @@ BOOST_FIXTURE_TEST_CASE(CPUMatrixElementOperations, RandomSeedFixture)
     m2(1, 2) = 0.9526;
     BOOST_CHECK(m3.IsEqualTo(m2, c_epsilonFloatE4));
 
+    m3.SetValue(m0);
+    m3.InplaceSoftmax(true);
+    BOOST_CHECK(m3.IsEqualTo(m2, c_epsilonFloatE4));
+
     m3.SetValue(m0);
     m3.InplaceLogSoftmax(false);
     m3.InplaceExp();
@@ -568,6 +628,22 @@ BOOST_FIXTURE_TEST_CASE(CPUMatrixTranspose, RandomSeedFixture)
     BOOST_CHECK(m2.IsEqualTo(m0, c_epsilonFloatE4));
 }
 
+BOOST_FIXTURE_TEST_CASE(CPUMatrixColumnSliceObjectRecycling, RandomSeedFixture)
+{
+    DMatrix m0(3, 4);
+    m0.SetUniformRandomValue(-1, 1, IncrementCounter());
+
+    // the object of a deleted slice is reused for the next one (see MatrixObjectRecycler)
+    DMatrix* slice = new DMatrix(m0.ColumnSlice(1, 2));
+    void* object = slice;
+    delete slice;
+    slice = new DMatrix(m0.ColumnSlice(2, 2));
+    BOOST_CHECK_EQUAL((void*) slice, object);
+    BOOST_CHECK_EQUAL(slice->GetNumCols(), 2);
+    BOOST_CHECK_EQUAL((*slice)(2, 1), m0(2, 3));
+    delete slice;
+}
+
 BOOST_FIXTURE_TEST_CASE(CPUMatrixColumnSlice, RandomSeedFixture)
 {
     DMatrix m0(2, 3);
@@ -898,6 +974,732 @@ BOOST_FIXTURE_TEST_CASE(CPUMatrixSeedingDouble, RandomSeedFixture)
     BOOST_CHECK(m1.IsEqualTo(m2));
 }
 
+BOOST_FIXTURE_TEST_CASE(CPUMatrixElementWiseProgram, RandomSeedFixture)
+{
+    const size_t rows = 3, cols = 4;
+    SMatrix a = SMatrix::RandomUniform(rows, cols, -1.0f, 1.0f, IncrementCounter());
+    SMatrix b = SMatrix::RandomUniform(rows, cols, -1.0f, 1.0f, IncrementCounter());
+    SMatrix c = SMatrix::RandomUniform(rows, cols, -1.0f, 1.0f, IncrementCounter());
+    SMatrix result(rows, cols);
+
+    // result = Sigmoid(a + b) .* c
+    ElementWiseProgram program;
+    program.Clear();
+    program.m_numInputs = 3;
+    const int sumArgs[] = { 0, 1 };
+    const int sum = program.Append(opSum, 2, sumArgs);
+    const int sigmoid = program.Append(opSigmoid, 1, &sum);
+    const int productArgs[] = { sigmoid, 2 };
+    program.Append(opElementwiseProduct, 2, productArgs);
+
+    const SmallVector<ptrdiff_t> strides{ 1 };
+    result.TensorOp(0, a, b, c, a, 1, program, std::array<size_t, 5>{ 0, 0, 0, 0, 0 },
+                    SmallVector<size_t>{ rows * cols }, std::array<SmallVector<ptrdiff_t>, 5>{ strides, strides, strides, strides, strides });
+
+    foreach_coord (i, j, result)
+    {
+        const float expected = 1.0f / (1.0f + exp(-(a(i, j) + b(i, j)))) * c(i, j);
+        BOOST_CHECK_CLOSE(result(i, j), expected, 0.001f);
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(CPUMatrixGMMLogLikelihood, RandomSeedFixture)
+{
+    const size_t numComponents = 3, featureDim = 4, numSamples = 5;
+    DMatrix logPrior = DMatrix::RandomUniform(numComponents, 1, -1.0, 1.0, IncrementCounter());
+    DMatrix mean = DMatrix::RandomUniform(numComponents * featureDim, 1, -1.0, 1.0, IncrementCounter());
+    DMatrix logStddev = DMatrix::RandomUniform(numComponents, 1, -0.5, 0.5, IncrementCounter());
+    DMatrix feature = DMatrix::RandomUniform(featureDim, numSamples, -1.0, 1.0, IncrementCounter());
+    DMatrix gradient = DMatrix::RandomUniform(1, numSamples, -1.0, 1.0, IncrementCounter());
+    logPrior.InplaceLogSoftmax(true);
+
+    DMatrix result, posterior, normedDeviation, normedDeviationVectors;
+    result.AssignGMMLogLikelihoodOf(logPrior, mean, logStddev, feature, posterior, normedDeviation, normedDeviationVectors);
+
+    auto logLikelihood = [&](const DMatrix& x, size_t t)
+    {
+        double likelihood = 0;
+        for (size_t c = 0; c < numComponents; c++)
+        {
+            const double stddev = exp(logStddev(c, 0));
+            double density = exp(logPrior(c, 0));
+            for (size_t i = 0; i < featureDim; i++)
+            {
+                const double d = x(i, t) - mean(c * featureDim + i, 0);
+                density *= exp(-d * d / (2 * stddev * stddev)) / (sqrt(2 * pi) * stddev);
+            }
+            likelihood += density;
+        }
+        return log(likelihood);
+    };
+    for (size_t t = 0; t < numSamples; t++)
+        BOOST_CHECK_CLOSE(result(0, t), logLikelihood(feature, t), 1e-8);
+
+    // feature gradient against central differences
+    DMatrix featureGradient(featureDim, numSamples);
+    featureGradient.SetValue(0);
+    featureGradient.AddGMMLogLikelihoodGradient(3, gradient, logPrior, posterior, normedDeviation, normedDeviationVectors);
+    const double h = 1e-6;
+    foreach_coord (i, t, feature)
+    {
+        DMatrix shifted = feature;
+        shifted(i, t) += h;
+        const double plus = logLikelihood(shifted, t);
+        shifted(i, t) -= 2 * h;
+        const double minus = logLikelihood(shifted, t);
+        BOOST_CHECK_SMALL(featureGradient(i, t) - gradient(0, t) * (plus - minus) / (2 * h), 1e-6);
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(CPUMatrixCrossEntropyWithSoftmax, RandomSeedFixture)
+{
+    const size_t numClasses = 7, numCols = 6;
+    DMatrix logits = DMatrix::RandomUniform(numClasses, numCols, -5.0, 5.0, IncrementCounter());
+    logits(2, 1) = 1000; // must not overflow
+    DMatrix labels(numClasses, numCols);
+    labels.SetValue(0);
+    for (size_t t = 0; t < numCols - 1; t++) // the last column is a gap
+        labels((t * 3) % numClasses, t) = 1;
+    logits(0, numCols - 1) = std::numeric_limits<double>::quiet_NaN();
+
+    DMatrix criterion, logSumExp;
+    criterion.AssignCrossEntropyWithSoftmaxOf(labels, logits, logSumExp);
+
+    DMatrix logSoftmax(numClasses, numCols - 1);
+    logSoftmax.AssignLogSoftmaxOf(logits.ColumnSlice(0, numCols - 1), true);
+    double expected = 0;
+    foreach_coord (i, t, logSoftmax)
+        expected -= labels(i, t) * logSoftmax(i, t);
+    BOOST_CHECK_CLOSE(criterion(0, 0), expected, 1e-10);
+
+    DMatrix gradient(1, 1);
+    gradient(0, 0) = 0.5;
+    DMatrix logitsGradient(numClasses, numCols);
+    logitsGradient.SetValue(1);
+    logitsGradient.AddCrossEntropyWithSoftmaxGradient(1, gradient, labels, logits, logSumExp);
+    foreach_coord (i, t, logSoftmax)
+        BOOST_CHECK_CLOSE(logitsGradient(i, t), 1 + 0.5 * (exp(logSoftmax(i, t)) - labels(i, t)), 1e-10);
+}
+
+BOOST_FIXTURE_TEST_CASE(CPUMatrixSoftmax, RandomSeedFixture)
+{
+    // columns shorter and longer than the vector kernels' blocks, in float (vectorized) and double
+    for (size_t numRows : {1, 5, 1003})
+    {
+        DMatrix d = DMatrix::RandomUniform(numRows, 4, -30.0, 30.0, IncrementCounter());
+        d(0, 1) = 1000; // must not overflow
+        SMatrix s(numRows, 4);
+        foreach_coord (i, j, d)
+            s(i, j) = (float) d(i, j);
+
+        DMatrix expected(numRows, 4);
+        foreach_column (j, d)
+        {
+            double maxV = d(0, j);
+            foreach_row (i, d)
+                maxV = std::max(maxV, d(i, j));
+            double sum = 0;
+            foreach_row (i, d)
+                sum += exp(d(i, j) - maxV);
+            foreach_row (i, d)
+                expected(i, j) = d(i, j) - maxV - log(sum);
+        }
+
+        DMatrix dLogSoftmax, dSoftmax;
+        dLogSoftmax.AssignLogSoftmaxOf(d, true);
+        dSoftmax.AssignSoftmaxOf(d, true);
+        SMatrix sLogSoftmax, sSoftmax;
+        sLogSoftmax.AssignLogSoftmaxOf(s, true);
+        sSoftmax.AssignSoftmaxOf(s, true);
+        s.InplaceSoftmax(true);
+        foreach_coord (i, j, expected)
+        {
+            BOOST_CHECK_SMALL(dLogSoftmax(i, j) - expected(i, j), 1e-10);
+            BOOST_CHECK_SMALL(dSoftmax(i, j) - exp(expected(i, j)), 1e-12);
+            BOOST_CHECK_SMALL(sLogSoftmax(i, j) - expected(i, j), 1e-4);
+            BOOST_CHECK_SMALL(sSoftmax(i, j) - exp(expected(i, j)), 1e-6);
+            BOOST_CHECK_EQUAL(s(i, j), sSoftmax(i, j));
+        }
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(CPUMatrixClassBasedCrossEntropyWithSoftmax, RandomSeedFixture)
+{
+    // 7 words in 3 classes [0, 3), [3, 5), [5, 7); 5 frames, of which column 3 is a gap
+    const size_t dim = 3, numWords = 7, numClasses = 3, numCols = 5;
+    double labelData[] = {4, 1, 3, 5, /**/ 0, 0, 0, 3, /**/ 6, 2, 5, 7, /**/ 0, 0, 0, 0, /**/ 2, 0, 0, 3};
+    DMatrix labels(4, numCols, labelData, matrixFlagNormal);
+    double bucketData[] = {0, 3, 0, 2, /**/ 3, 5, 2, 3, /**/ 5, 7, 3, 4};
+    DMatrix buckets(4, 3, bucketData, matrixFlagNormal);
+    double frameData[] = {1, 4, 0, 2};
+    DMatrix frames(1, 4, frameData, matrixFlagNormal);
+    DMatrix input = DMatrix::RandomUniform(dim, numCols, -1.0, 1.0, IncrementCounter());
+    DMatrix weight = DMatrix::RandomUniform(dim, numWords, -1.0, 1.0, IncrementCounter());
+    DMatrix classLogits = DMatrix::RandomUniform(numClasses, numCols, -1.0, 1.0, IncrementCounter());
+
+    DMatrix classLogSoftmax, softmax, criterion;
+    auto evaluate = [&]() -> double
+    {
+        classLogSoftmax.AssignLogSoftmaxOf(classLogits, true);
+        criterion.AssignClassBasedCrossEntropyWithSoftmaxOf(labels, input, weight, classLogSoftmax, buckets, frames, 3, softmax);
+        return criterion(0, 0);
+    };
+
+    // reference criterion and word posteriors
+    evaluate();
+    double expected = 0;
+    for (size_t n = 0; n < frames.GetNumCols(); n++)
+    {
+        const size_t t = (size_t) frames(0, n), wordBegin = (size_t) labels(2, t), wordEnd = (size_t) labels(3, t);
+        std::vector<double> logits;
+        double sum = 0;
+        for (size_t w = wordBegin; w < wordEnd; w++)
+        {
+            logits.push_back(0);
+            for (size_t d = 0; d < dim; d++)
+                logits.back() += weight(d, w) * input(d, t);
+            sum += exp(logits.back());
+        }
+        for (size_t k = 0; k < logits.size(); k++)
+            BOOST_CHECK_CLOSE(softmax(k, t), exp(logits[k]) / sum, 1e-10);
+        expected -= logits[(size_t) labels(0, t) - wordBegin] - log(sum) + classLogSoftmax((size_t) labels(1, t), t);
+    }
+    BOOST_CHECK_CLOSE(criterion(0, 0), expected, 1e-10);
+
+    // the gradients of all inputs, against finite differences
+    DMatrix gradient(1, 1);
+    gradient(0, 0) = 0.5;
+    DMatrix* inputs[] = {&input, &weight, &classLogits};
+    for (size_t inputIndex = 1; inputIndex <= 3; inputIndex++)
+    {
+        DMatrix& x = *inputs[inputIndex - 1];
+        DMatrix inputGradient(x.GetNumRows(), x.GetNumCols());
+        inputGradient.SetValue(0);
+        evaluate();
+        inputGradient.AddClassBasedCrossEntropyWithSoftmaxGradient(inputIndex, gradient, labels, input, weight, classLogSoftmax, buckets, frames, softmax);
+        foreach_coord (i, j, x)
+        {
+            const double value = x(i, j), epsilon = 1e-5;
+            x(i, j) = value + epsilon;
+            const double plus = evaluate();
+            x(i, j) = value - epsilon;
+            const double minus = evaluate();
+            x(i, j) = value;
+            const double numeric = (j == 3 && inputIndex != 2) ? 0 : 0.5 * (plus - minus) / (2 * epsilon);
+            BOOST_CHECK_SMALL(inputGradient(i, j) - numeric, 1e-7);
+        }
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(CPUMatrixNoiseContrastiveEstimation, RandomSeedFixture)
+{
+    // alias table of 4 words with probabilities (0.1, 0.2, 0.3, 0.4): buckets 0 and 1 are topped up by words 3 and 2
+    double aliasProbData[] = {0.4, 0.8, 1, 1};
+    double aliasData[] = {3, 2, 2, 3};
+    DMatrix aliasProbs(1, 4, aliasProbData, matrixFlagNormal);
+    DMatrix aliases(1, 4, aliasData, matrixFlagNormal);
+    double uniformData[] = {0.05, 0.3, /**/ 0.05, 0.5, /**/ 0.3, 0.7, /**/ 0.3, 0.9, /**/ 0.6, 0.99, /**/ 0.999, 0.5};
+    DMatrix uniforms(2, 6, uniformData, matrixFlagNormal);
+    DMatrix noiseSamples;
+    noiseSamples.AssignAliasSamplesOf(uniforms, aliasProbs, aliases);
+    const double expectedSamples[] = {0, 3, 1, 2, 2, 3};
+    for (size_t i = 0; i < 6; i++)
+        BOOST_CHECK_EQUAL(noiseSamples(0, i), expectedSamples[i]);
+
+    // 3 noise words shared by 4 frames
+    const size_t dim = 3, numWords = 5, numNoise = 3, numCols = 4;
+    double labelData[] = {1, 4, 0, 4};
+    DMatrix labelIds(1, numCols, labelData, matrixFlagNormal);
+    double noiseData[] = {2, 4, 2};
+    DMatrix noiseIds(1, numNoise, noiseData, matrixFlagNormal);
+    DMatrix hidden = DMatrix::RandomUniform(dim, numCols, -1.0, 1.0, IncrementCounter());
+    DMatrix weights = DMatrix::RandomUniform(dim, numWords, -1.0, 1.0, IncrementCounter());
+    DMatrix bias = DMatrix::RandomUniform(1, numWords, -1.0, 1.0, IncrementCounter());
+    DMatrix logNoiseCounts = DMatrix::RandomUniform(1, numWords, -2.0, 0.0, IncrementCounter());
+
+    DMatrix losses, scoreGradients;
+    auto evaluate = [&]() -> double
+    {
+        losses.AssignNCELossOf(labelIds, noiseIds, hidden, weights, bias, logNoiseCounts, scoreGradients);
+        return losses.SumOfElements();
+    };
+
+    // reference loss and score gradients
+    evaluate();
+    for (size_t t = 0; t < numCols; t++)
+    {
+        double expected = 0;
+        for (size_t j = 0; j <= numNoise; j++)
+        {
+            const size_t w = (size_t)(j == 0 ? labelIds(0, t) : noiseIds(0, j - 1));
+            double s = bias(0, w) - logNoiseCounts(0, w);
+            for (size_t d = 0; d < dim; d++)
+                s += hidden(d, t) * weights(d, w);
+            const double sigmoid = 1 / (1 + exp(-s));
+            expected -= j == 0 ? log(sigmoid) : log(1 - sigmoid);
+            BOOST_CHECK_CLOSE(scoreGradients(j, t), j == 0 ? sigmoid - 1 : sigmoid, 1e-10);
+        }
+        BOOST_CHECK_CLOSE(losses(0, t), expected, 1e-10);
+    }
+
+    // the gathered gradient w.r.t. the hidden input, against finite differences
+    DMatrix hiddenGradient(dim, numCols);
+    hiddenGradient.SetValue(1);
+    evaluate();
+    hiddenGradient.AddNCEHiddenGradientOf(scoreGradients, labelIds, noiseIds, weights);
+    foreach_coord (i, j, hidden)
+    {
+        const double value = hidden(i, j), epsilon = 1e-5;
+        hidden(i, j) = value + epsilon;
+        const double plus = evaluate();
+        hidden(i, j) = value - epsilon;
+        const double minus = evaluate();
+        hidden(i, j) = value;
+        BOOST_CHECK_SMALL(hiddenGradient(i, j) - 1 - (plus - minus) / (2 * epsilon), 1e-7);
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(CPUMatrixNumOfTopKErrors, RandomSeedFixture)
+{
+    // one-hot labels and random predictions, against the argmax and top-k indices; column 5 is an all-zero gap
+    const size_t numRows = 10, numCols = 40;
+    DMatrix predictions = DMatrix::RandomUniform(numRows, numCols, -1.0, 1.0, IncrementCounter());
+    DMatrix labels(numRows, numCols);
+    labels.SetValue(0);
+    for (size_t j = 0; j < numCols; j++)
+        labels((j * 7) % numRows, j) = 1;
+    for (size_t i = 0; i < numRows; i++)
+        labels(i, 5) = predictions(i, 5) = 0;
+
+    DMatrix labelIndexes, predictionIndexes, maxValues, expected, errors;
+    labels.VectorMax(labelIndexes, maxValues, true);
+    for (int topK : {1, 3})
+    {
+        predictions.VectorMax(predictionIndexes, maxValues, true, topK);
+        predictionIndexes(0, 5) = labelIndexes(0, 5); // (the index of the maximum of a column of ties is not specified with topK > 1)
+        expected.AssignNumOfDiff(labelIndexes, predictionIndexes, topK > 1);
+        errors.AssignNumOfTopKErrorsOf(labels, predictions, topK);
+        BOOST_CHECK_EQUAL(errors(0, 0), expected(0, 0));
+        BOOST_CHECK(errors(0, 0) > 0);
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(CPUMatrixViterbiPath, RandomSeedFixture)
+{
+    // two parallel sequences of 4 and 3 frames, decoded at once and compared to an exhaustive search
+    const size_t numLabels = 3, numParallelSequences = 2, numTimeSteps = 4;
+    DMatrix posScores = DMatrix::RandomUniform(numLabels, numTimeSteps * numParallelSequences, -1.0, 1.0, IncrementCounter());
+    DMatrix pairScores = DMatrix::RandomUniform(numLabels, numLabels, -1.0, 1.0, IncrementCounter());
+    double sequenceInfo[] = {0, 0, 4, 1, 1, 4}; // (s, tBegin, tEnd)
+    DMatrix sequences(3, 2, sequenceInfo, matrixFlagNormal);
+    const int startLabel = 1;
+
+    DMatrix path, alpha, backtrace;
+    path.AssignViterbiPathOf(posScores, pairScores, sequences, numParallelSequences, startLabel, -1, alpha, backtrace);
+
+    for (size_t n = 0; n < 2; n++)
+    {
+        const size_t s = (size_t) sequences(0, n), tBegin = (size_t) sequences(1, n), tEnd = (size_t) sequences(2, n);
+        const size_t numFrames = tEnd - tBegin;
+        double bestScore = -1e30;
+        std::vector<size_t> bestLabels;
+        for (size_t code = 0; code < (size_t) pow(numLabels, numFrames - 1); code++)
+        {
+            std::vector<size_t> labels(1, startLabel);
+            for (size_t c = code, t = 1; t < numFrames; t++, c /= numLabels)
+                labels.push_back(c % numLabels);
+            double score = posScores(startLabel, tBegin * numParallelSequences + s);
+            for (size_t t = 1; t < numFrames; t++)
+                score += pairScores(labels[t], labels[t - 1]) + posScores(labels[t], (tBegin + t) * numParallelSequences + s);
+            if (score > bestScore)
+            {
+                bestScore = score;
+                bestLabels = labels;
+            }
+        }
+        for (size_t t = 0; t < numFrames; t++)
+            for (size_t k = 0; k < numLabels; k++)
+                BOOST_CHECK_EQUAL(path(k, (tBegin + t) * numParallelSequences + s), k == bestLabels[t] ? 1 : 0);
+    }
+    // the gap before the second sequence
+    for (size_t k = 0; k < numLabels; k++)
+        BOOST_CHECK_EQUAL(path(k, 1), 0);
+}
+
+BOOST_FIXTURE_TEST_CASE(CPUMatrixMultiplyAndAddBiasActivation, RandomSeedFixture)
+{
+    // enough rows and columns for several column blocks; compared to GEMM, bias and activation done one after the other
+    const size_t m = 300, k = 20, n = 250;
+    DMatrix w = DMatrix::RandomUniform(m, k, -1.0, 1.0, IncrementCounter());
+    DMatrix wt = w.Transpose();
+    DMatrix x = DMatrix::RandomUniform(k, n, -1.0, 1.0, IncrementCounter());
+    DMatrix bias = DMatrix::RandomUniform(m, 1, -1.0, 1.0, IncrementCounter());
+    DMatrix outputGradient = DMatrix::RandomUniform(m, n, -1.0, 1.0, IncrementCounter());
+    DMatrix oldProductGradient = DMatrix::RandomUniform(m, n, -1.0, 1.0, IncrementCounter());
+    DMatrix oldBiasGradient = DMatrix::RandomUniform(m, 1, -1.0, 1.0, IncrementCounter());
+
+    for (auto activation : {ElementWiseOperator::opLinearRectifier, ElementWiseOperator::opSigmoid, ElementWiseOperator::opTanh})
+    {
+        DMatrix expected, expectedProductGradient(m, n), expectedBiasGradient(m, 1);
+        DMatrix::MultiplyAndWeightedAdd(1, w, false, x, false, 0, expected);
+        foreach_coord (i, j, expected)
+        {
+            double z = expected(i, j) + bias(i, 0);
+            double y = activation == ElementWiseOperator::opLinearRectifier ? std::max(z, 0.0) : activation == ElementWiseOperator::opSigmoid ? 1 / (1 + exp(-z)) : tanh(z);
+            double dy = activation == ElementWiseOperator::opLinearRectifier ? (y > 0 ? 1 : 0) : activation == ElementWiseOperator::opSigmoid ? y * (1 - y) : 1 - y * y;
+            expected(i, j) = y;
+            expectedProductGradient(i, j) = 0.5 * oldProductGradient(i, j) + outputGradient(i, j) * dy;
+        }
+        expectedBiasGradient.SetValue(oldBiasGradient);
+        foreach_coord (i, j, expected)
+            expectedBiasGradient(i, 0) += expectedProductGradient(i, j) - 0.5 * oldProductGradient(i, j);
+
+        DMatrix output, outputOfTransposed;
+        DMatrix::MultiplyAndAddBiasActivation(w, false, x, bias, activation, output);
+        DMatrix::MultiplyAndAddBiasActivation(wt, true, x, bias, activation, outputOfTransposed);
+        BOOST_CHECK(output.IsEqualTo(expected, 1e-10));
+        BOOST_CHECK(outputOfTransposed.IsEqualTo(expected, 1e-10));
+
+        DMatrix inPlace;
+        DMatrix::MultiplyAndWeightedAdd(1, w, false, x, false, 0, inPlace);
+        inPlace.AddBiasActivation(bias, activation);
+        BOOST_CHECK(inPlace.IsEqualTo(expected, 1e-10));
+
+        DMatrix productGradient(oldProductGradient), biasGradient(oldBiasGradient);
+        DMatrix::BackpropBiasActivation(outputGradient, output, activation, 0.5, productGradient, 1, biasGradient);
+        BOOST_CHECK(productGradient.IsEqualTo(expectedProductGradient, 1e-10));
+        BOOST_CHECK(biasGradient.IsEqualTo(expectedBiasGradient, 1e-10));
+
+        // and with both gradients assigned
+        DMatrix assignedProductGradient, assignedBiasGradient;
+        DMatrix::BackpropBiasActivation(outputGradient, output, activation, 0, assignedProductGradient, 0, assignedBiasGradient);
+        expectedProductGradient.AddWithScaleOf(-0.5, oldProductGradient);
+        expectedBiasGradient -= oldBiasGradient;
+        BOOST_CHECK(assignedProductGradient.IsEqualTo(expectedProductGradient, 1e-10));
+        BOOST_CHECK(assignedBiasGradient.IsEqualTo(expectedBiasGradient, 1e-10));
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(CPUMatrixSmallMultiplyAndWeightedAdd, RandomSeedFixture)
+{
+    // shapes below the threshold of the small-GEMM kernel, with row and column counts that leave remainders of each block size
+    const size_t shapes[][3] = {{1, 1, 1}, {7, 5, 3}, {33, 17, 9}, {64, 64, 16}, {100, 30, 50}};
+    for (const auto& shape : shapes)
+    {
+        const size_t m = shape[0], k = shape[1], n = shape[2], numBatches = 3;
+        SMatrix a = SMatrix::RandomUniform(m, k * numBatches, -1.0f, 1.0f, IncrementCounter());
+        SMatrix b = SMatrix::RandomUniform(k, n * numBatches, -1.0f, 1.0f, IncrementCounter());
+        SMatrix a0 = a.ColumnSlice(0, k), b0 = b.ColumnSlice(0, n);
+        SMatrix b0t = b0.Transpose();
+        SMatrix c0 = SMatrix::RandomUniform(m, n * numBatches, -1.0f, 1.0f, IncrementCounter());
+
+        for (float beta : {0.0f, 0.5f})
+        {
+            // expected, computed in double
+            SMatrix expected(m, n * numBatches);
+            for (size_t batch = 0; batch < numBatches; batch++)
+            {
+                for (size_t j = 0; j < n; j++)
+                {
+                    for (size_t i = 0; i < m; i++)
+                    {
+                        double sum = 0;
+                        for (size_t p = 0; p < k; p++)
+                            sum += (double) a(i, batch * k + p) * b(p, batch * n + j);
+                        expected(i, batch * n + j) = (float) (2 * sum + beta * c0(i, batch * n + j));
+                    }
+                }
+            }
+
+            // (ColumnSlice() returns views; the products write to copies)
+            SMatrix c(m, n), ct(m, n);
+            c.SetValue(c0.ColumnSlice(0, n));
+            ct.SetValue(c0.ColumnSlice(0, n));
+            SMatrix::MultiplyAndWeightedAdd(2, a0, false, b0, false, beta, c);
+            SMatrix::MultiplyAndWeightedAdd(2, a0, false, b0t, true, beta, ct);
+            SMatrix expected0 = expected.ColumnSlice(0, n);
+            BOOST_CHECK(c.IsEqualTo(expected0, 1e-4f));
+            BOOST_CHECK(ct.IsEqualTo(expected0, 1e-4f));
+
+            SMatrix batched(c0);
+            SMatrix::BatchedMultiplyAndWeightedAdd(2, a, false, b, false, beta, batched, numBatches);
+            BOOST_CHECK(batched.IsEqualTo(expected, 1e-4f));
+        }
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(CPUMatrixAssignCTCPosteriors, RandomSeedFixture)
+{
+    // 2 parallel sequences of 6 frames, 4 labels with the blank 0; the last sequence has too few frames for its repeated label
+    const size_t numLabels = 4, numParallelSequences = 2, numTimeSteps = 6, maxStates = 7;
+    const std::vector<std::vector<size_t>> tokens = {{1, 1}, {2, 3, 1}, {3, 3}};
+    const size_t sequenceInfo[][3] = {{0, 0, 5}, {1, 0, 3}, {1, 3, 2}}; // parallel sequence, first frame, number of frames
+
+    DMatrix logProbs = DMatrix::RandomUniform(numLabels, numParallelSequences * numTimeSteps, -2.0, 2.0, IncrementCounter());
+    foreach_column (j, logProbs)
+    {
+        double sum = 0;
+        foreach_row (i, logProbs)
+            sum += exp(logProbs(i, j));
+        foreach_row (i, logProbs)
+            logProbs(i, j) -= log(sum);
+    }
+    DMatrix stateLabels(maxStates, tokens.size()), sequences(4, tokens.size());
+    stateLabels.SetValue(0);
+    for (size_t n = 0; n < tokens.size(); n++)
+    {
+        for (size_t l = 0; l < tokens[n].size(); l++)
+            stateLabels(2 * l + 1, n) = (double) tokens[n][l];
+        for (size_t i = 0; i < 3; i++)
+            sequences(i, n) = (double) sequenceInfo[n][i];
+        sequences(3, n) = (double) (2 * tokens[n].size() + 1);
+    }
+
+    DMatrix posteriors, alpha, beta, logLikelihoods;
+    posteriors.AssignCTCPosteriors(logProbs, stateLabels, sequences, numParallelSequences, alpha, beta, logLikelihoods);
+    BOOST_CHECK_EQUAL(posteriors.GetNumRows(), numLabels);
+    BOOST_CHECK_EQUAL(posteriors.GetNumCols(), numParallelSequences * numTimeSteps);
+
+    // expected, by enumerating all label paths of each sequence and collapsing them
+    DMatrix expected(numLabels, numParallelSequences * numTimeSteps);
+    expected.SetValue(0);
+    for (size_t n = 0; n < tokens.size(); n++)
+    {
+        const size_t s = sequenceInfo[n][0], tBegin = sequenceInfo[n][1], numFrames = sequenceInfo[n][2];
+        size_t numPaths = 1;
+        for (size_t t = 0; t < numFrames; t++)
+            numPaths *= numLabels;
+        double total = 0;
+        DMatrix pathPosteriors(numLabels, numFrames);
+        pathPosteriors.SetValue(0);
+        for (size_t path = 0; path < numPaths; path++)
+        {
+            std::vector<size_t> frameLabels, collapsed;
+            double logP = 0;
+            for (size_t t = 0, rest = path; t < numFrames; t++, rest /= numLabels)
+            {
+                frameLabels.push_back(rest % numLabels);
+                logP += logProbs(frameLabels.back(), (tBegin + t) * numParallelSequences + s);
+                if (frameLabels.back() != 0 && (t == 0 || frameLabels[t - 1] != frameLabels.back()))
+                    collapsed.push_back(frameLabels.back());
+            }
+            if (collapsed != tokens[n])
+                continue;
+            total += exp(logP);
+            for (size_t t = 0; t < numFrames; t++)
+                pathPosteriors(frameLabels[t], t) += exp(logP);
+        }
+        BOOST_CHECK_CLOSE(logLikelihoods(0, n), total > 0 ? log(total) : 0, 1e-8);
+        for (size_t t = 0; t < numFrames; t++)
+        {
+            const size_t j = (tBegin + t) * numParallelSequences + s;
+            for (size_t k = 0; k < numLabels; k++)
+                expected(k, j) = total > 0 ? pathPosteriors(k, t) / total : exp(logProbs(k, j)); // no paths: the softmax, i.e. no gradient
+        }
+    }
+    BOOST_CHECK(posteriors.IsEqualTo(expected, 1e-10));
+    BOOST_CHECK_EQUAL(logLikelihoods(0, 2), 0);
+}
+
+BOOST_FIXTURE_TEST_CASE(CPUMatrixGatherScatterColumns, RandomSeedFixture)
+{
+    SMatrix a = SMatrix::RandomUniform(5, 4, -1.0f, 1.0f, IncrementCounter());
+    SMatrix idx(1, 6);
+    const float indices[] = {2, -1, 0, 3, -1, 1};
+    for (size_t j = 0; j < 6; j++)
+        idx(0, j) = indices[j];
+
+    SMatrix gathered;
+    gathered.DoGatherColumnsOf(0, idx, a, 2);
+    BOOST_CHECK_EQUAL(gathered.GetNumRows(), 5);
+    BOOST_CHECK_EQUAL(gathered.GetNumCols(), 6);
+    for (size_t j = 0; j < 6; j++)
+    {
+        for (size_t i = 0; i < 5; i++)
+            BOOST_CHECK_EQUAL(gathered(i, j), indices[j] < 0 ? 0 : 2 * a(i, (size_t) indices[j]));
+    }
+
+    // scattering the gathered columns back restores a (times 2), on top of beta * the target
+    SMatrix scattered(5, 4);
+    scattered.SetValue(1);
+    scattered.DoScatterColumnsOf(0.5f, idx, gathered, 0.5f);
+    for (size_t j = 0; j < 4; j++)
+    {
+        for (size_t i = 0; i < 5; i++)
+            BOOST_CHECK_CLOSE(scattered(i, j), 0.5f + a(i, j), 1e-4f);
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(CPUMatrixAssignMaskedSoftmaxOf, RandomSeedFixture)
+{
+    const size_t m = 7, n = 5;
+    const float scale = 0.5f;
+    SMatrix a = SMatrix::RandomUniform(m, n, -3.0f, 3.0f, IncrementCounter());
+    SMatrix numValidRows(1, n);
+    const float numValid[] = {7, 3, 0, 1, 9}; // (more than the rows counts as all)
+    for (size_t j = 0; j < n; j++)
+        numValidRows(0, j) = numValid[j];
+
+    SMatrix softmax;
+    softmax.AssignMaskedSoftmaxOf(a, scale, numValidRows);
+    for (size_t j = 0; j < n; j++)
+    {
+        const size_t valid = std::min(m, (size_t) numValid[j]);
+        double sum = 0;
+        for (size_t i = 0; i < valid; i++)
+            sum += exp(scale * a(i, j));
+        for (size_t i = 0; i < m; i++)
+        {
+            if (i < valid)
+                BOOST_CHECK_CLOSE(softmax(i, j), (float) (exp(scale * a(i, j)) / sum), 1e-3f);
+            else
+                BOOST_CHECK_EQUAL(softmax(i, j), 0);
+        }
+    }
+}
+
+// grouped convolution equals the ungrouped one with a filter that is zero across groups, and its gradients are the adjoints
+BOOST_FIXTURE_TEST_CASE(CPUMatrixGroupedConvolution, RandomSeedFixture)
+{
+    const size_t inW = 5, inH = 6, kW = 3, kH = 3, numSamples = 3;
+    const size_t configs[][4] = {{3, 3, 1, 1}, {3, 6, 2, 2}, {4, 6, 1, 2}}; // inputChannels, outputChannels, stride, groups
+    for (const auto& config : configs)
+    {
+        const size_t C = config[0], K = config[1], stride = config[2], groups = config[3];
+        const size_t outW = (inW - 1) / stride + 1, outH = (inH - 1) / stride + 1; // with zero padding
+        const size_t kernelSize = kW * kH, channelsPerGroup = C / groups;
+        DMatrix in = DMatrix::RandomUniform(inW * inH * C, numSamples, -1, 1, IncrementCounter());
+        DMatrix filter = DMatrix::RandomUniform(K, kernelSize * channelsPerGroup, -1, 1, IncrementCounter());
+        DMatrix fullFilter(K, kernelSize * C);
+        fullFilter.SetValue(0);
+        for (size_t k = 0; k < K; k++)
+        {
+            const size_t g = k / (K / groups);
+            for (size_t ci = 0; ci < channelsPerGroup; ci++)
+                for (size_t pos = 0; pos < kernelSize; pos++)
+                    fullFilter(k, (g * channelsPerGroup + ci) * kernelSize + pos) = filter(k, ci * kernelSize + pos);
+        }
+
+        DMatrix out, expected;
+        out.AssignGroupedConvolutionResult(in, filter, inW, inH, C, outW, outH, K, kW, kH, stride, stride, true, groups);
+        expected.AssignConvolutionResult(in, fullFilter, inW, inH, C, outW, outH, K, kW, kH, stride, stride, true);
+        BOOST_CHECK(out.IsEqualTo(expected, 1e-10));
+
+        // <conv(in), outGrad> == <in, inGrad> == <filter, filterGrad>
+        DMatrix outGrad = DMatrix::RandomUniform(outW * outH * K, numSamples, -1, 1, IncrementCounter());
+        DMatrix inGrad(in.GetNumRows(), numSamples), filterGrad(K, filter.GetNumCols());
+        inGrad.SetValue(0);
+        filterGrad.SetValue(0);
+        inGrad.AddGroupedConvolutionGradientOfInput(outGrad, filter, inW, inH, C, outW, outH, K, kW, kH, stride, stride, true, groups);
+        filterGrad.AddGroupedConvolutionGradientOfFilter(outGrad, in, inW, inH, C, outW, outH, K, kW, kH, stride, stride, true, groups);
+        double product = 0, inProduct = 0, filterProduct = 0;
+        for (size_t i = 0; i < out.GetNumElements(); i++)
+            product += out.BufferPointer()[i] * outGrad.BufferPointer()[i];
+        for (size_t i = 0; i < in.GetNumElements(); i++)
+            inProduct += in.BufferPointer()[i] * inGrad.BufferPointer()[i];
+        for (size_t i = 0; i < filter.GetNumElements(); i++)
+            filterProduct += filter.BufferPointer()[i] * filterGrad.BufferPointer()[i];
+        BOOST_CHECK_CLOSE(inProduct, product, 1e-8);
+        BOOST_CHECK_CLOSE(filterProduct, product, 1e-8);
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(CPUMatrixCosDistanceWithShiftNeg, RandomSeedFixture)
+{
+    const size_t dim = 7, n = 5, shift = 2, negNumber = 3;
+    DMatrix a = DMatrix::RandomUniform(dim, n, -1, 1, IncrementCounter());
+    DMatrix b = DMatrix::RandomUniform(dim, n, -1, 1, IncrementCounter());
+
+    DMatrix value, invNormA, invNormB;
+    value.AssignCosDistanceWithShiftNegOf(a, b, shift, negNumber, invNormA, invNormB);
+
+    // the unfused formulation
+    DMatrix normA, normB, invNorms, dots, expected;
+    normA.AssignVectorNorm2Of(a, true);
+    normB.AssignVectorNorm2Of(b, true);
+    invNorms.AssignElementProductOfWithShiftNeg(normA.AssignElementInverseOf(normA), normB.AssignElementInverseOf(normB), shift, negNumber);
+    DMatrix::InnerProductWithShiftNeg(a, b, dots, true, shift, negNumber);
+    expected.AssignElementProductOf(invNorms, dots);
+    BOOST_CHECK(value.IsEqualTo(expected, 1e-10));
+    BOOST_CHECK(invNormA.IsEqualTo(normA, 1e-10));
+    BOOST_CHECK(invNormB.IsEqualTo(normB, 1e-10));
+
+    // gradients of <value, gradient> against central differences
+    DMatrix gradient = DMatrix::RandomUniform(negNumber + 1, n, -1, 1, IncrementCounter());
+    for (int rightInput = 0; rightInput < 2; rightInput++)
+    {
+        DMatrix inputGradient(dim, n);
+        inputGradient.SetValue(0);
+        inputGradient.AddCosDistanceWithShiftNegGradientOf(gradient, value, a, b, invNormA, invNormB, shift, rightInput != 0);
+
+        DMatrix& x = rightInput ? b : a;
+        const double epsilon = 1e-6;
+        for (size_t i = 0; i < x.GetNumElements(); i++)
+        {
+            double objective[2];
+            const double xi = x.BufferPointer()[i];
+            for (int side = 0; side < 2; side++)
+            {
+                x.BufferPointer()[i] = xi + (side ? epsilon : -epsilon);
+                DMatrix perturbed, unusedA, unusedB;
+                perturbed.AssignCosDistanceWithShiftNegOf(a, b, shift, negNumber, unusedA, unusedB);
+                objective[side] = 0;
+                for (size_t k = 0; k < perturbed.GetNumElements(); k++)
+                    objective[side] += perturbed.BufferPointer()[k] * gradient.BufferPointer()[k];
+            }
+            x.BufferPointer()[i] = xi;
+            BOOST_CHECK_SMALL((objective[1] - objective[0]) / (2 * epsilon) - inputGradient.BufferPointer()[i], 1e-6);
+        }
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(CPUMatrixAssignAugmentedImagesOf, RandomSeedFixture)
+{
+    const size_t sw = 4, sh = 4, c = 2, w = 2, h = 2;
+    const size_t stagingSize = sw * sh * c;
+    DMatrix staged = DMatrix::RandomUniform(stagingSize + 5, 2, -1, 1, IncrementCounter());
+    // column 0: the whole staging image halved; column 1: the center 2 x 2 pixels flipped
+    const double crops[2][5] = {{0, 0, 4, 4, 0}, {1, 1, 2, 2, 1}};
+    for (size_t j = 0; j < 2; j++)
+        for (size_t k = 0; k < 5; k++)
+            staged(stagingSize + k, j) = crops[j][k];
+    auto pixel = [&](size_t j, size_t x, size_t y, size_t k)
+    {
+        return staged((y * sw + x) * c + k, j);
+    };
+
+    DMatrix noMean;
+    DMatrix result;
+    result.AssignAugmentedImagesOf(staged, noMean, sw, sh, c, w, h, false);
+    BOOST_CHECK_EQUAL(w * h * c, result.GetNumRows());
+    BOOST_CHECK_EQUAL(2, result.GetNumCols());
+    for (size_t y = 0; y < h; y++)
+    {
+        for (size_t x = 0; x < w; x++)
+        {
+            for (size_t k = 0; k < c; k++)
+            {
+                double average = (pixel(0, 2 * x, 2 * y, k) + pixel(0, 2 * x + 1, 2 * y, k) + pixel(0, 2 * x, 2 * y + 1, k) + pixel(0, 2 * x + 1, 2 * y + 1, k)) / 4;
+                BOOST_CHECK_SMALL(average - result((y * w + x) * c + k, 0), 1e-12);
+                BOOST_CHECK_SMALL(pixel(1, 2 - x, 1 + y, k) - result((y * w + x) * c + k, 1), 1e-12);
+            }
+        }
+    }
+
+    // the mean is subtracted at the output position, then the result is transposed
+    DMatrix mean = DMatrix::RandomUniform(w * h * c, 1, -1, 1, IncrementCounter());
+    DMatrix transposed;
+    transposed.AssignAugmentedImagesOf(staged, mean, sw, sh, c, w, h, true);
+    for (size_t j = 0; j < 2; j++)
+        for (size_t y = 0; y < h; y++)
+            for (size_t x = 0; x < w; x++)
+                for (size_t k = 0; k < c; k++)
+                {
+                    size_t hwc = (y * w + x) * c + k;
+                    BOOST_CHECK_SMALL(result(hwc, j) - mean(hwc, 0) - transposed((k * h + y) * w + x, j), 1e-12);
+                }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 }
 } } }
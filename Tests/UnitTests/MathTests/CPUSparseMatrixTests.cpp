@@ -59,6 +59,90 @@ BOOST_FIXTURE_TEST_CASE(CPUSparseMatrixCopyColumnSliceToDense, RandomSeedFixture
     BOOST_CHECK(dm1.IsEqualTo(dm2, c_epsilonFloatE4));
 }
 
+BOOST_FIXTURE_TEST_CASE(CPUSparseMatrixBlockColFormat, RandomSeedFixture)
+{
+    const size_t m = 10;
+    const size_t n = 50;
+    const std::vector<size_t> colIds = { 42, 3, 17 };
+    std::vector<double> values(m * colIds.size());
+    for (size_t i = 0; i < values.size(); i++)
+    {
+        values[i] = (double) (i + 1);
+    }
+
+    SparseMatrix sm0(MatrixFormat::matrixFormatSparseBlockCol);
+    sm0.SetMatrixFromBlockColFormat(colIds.data(), values.data(), colIds.size(), m, n);
+
+    DenseMatrix dm0(m, n);
+    dm0.SetValue(0);
+    SparseMatrix::ScaleAndAdd(1, sm0, dm0);
+    foreach_coord (row, col, dm0)
+    {
+        double expected = 0;
+        for (size_t j = 0; j < colIds.size(); j++)
+        {
+            if (colIds[j] == col)
+                expected = values[j * m + row];
+        }
+        BOOST_CHECK_EQUAL(expected, dm0(row, col));
+    }
+
+    std::vector<size_t> colIds1;
+    std::vector<double> values1;
+    sm0.GetMatrixFromBlockColFormat(colIds1, values1);
+    BOOST_CHECK(colIds == colIds1);
+    BOOST_CHECK(values == values1);
+}
+
+BOOST_FIXTURE_TEST_CASE(CPUSparseMatrixMultiplyAndWeightedAddParallel, RandomSeedFixture)
+{
+    // large enough to be split across threads; the first columns hold most of the nonzeros
+    const size_t k = 2000;
+    const size_t n = 300;
+    const size_t h = 100;
+    DenseMatrix dm0(k, n);
+    dm0.SetUniformRandomValue(-1, 1, IncrementCounter());
+    SparseMatrix sm0(MatrixFormat::matrixFormatSparseCSC, k, n, 0);
+    foreach_coord (row, col, dm0)
+    {
+        if ((row * 7 + col * 13) % (col < 10 ? 2 : 40) != 0)
+            dm0(row, col) = 0;
+        else
+            sm0.SetValue(row, col, dm0(row, col));
+    }
+
+    DenseMatrix w(h, k);
+    w.SetUniformRandomValue(-1, 1, IncrementCounter());
+    DenseMatrix x(h, n);
+    x.SetUniformRandomValue(-1, 1, IncrementCounter());
+
+    DenseMatrix c1(h, n), r1(h, n);
+    c1.SetValue(1);
+    r1.SetValue(1);
+    SparseMatrix::MultiplyAndWeightedAdd(0.5, w, false, sm0, false, 2, c1);
+    DenseMatrix::MultiplyAndWeightedAdd(0.5, w, false, dm0, false, 2, r1);
+    BOOST_CHECK(c1.IsEqualTo(r1, c_epsilonFloatE4));
+
+    DenseMatrix c2(h, k), r2(h, k);
+    c2.SetValue(1);
+    r2.SetValue(1);
+    SparseMatrix::MultiplyAndWeightedAdd(0.5, x, false, sm0, true, 1, c2);
+    DenseMatrix::MultiplyAndWeightedAdd(0.5, x, false, dm0, true, 1, r2);
+    BOOST_CHECK(c2.IsEqualTo(r2, c_epsilonFloatE4));
+
+    DenseMatrix wt(k, h);
+    wt.SetUniformRandomValue(-1, 1, IncrementCounter());
+    DenseMatrix c3(h, n), r3(h, n);
+    SparseMatrix::MultiplyAndWeightedAdd(0.5, wt, true, sm0, false, 0, c3);
+    DenseMatrix::MultiplyAndWeightedAdd(0.5, wt, true, dm0, false, 0, r3);
+    BOOST_CHECK(c3.IsEqualTo(r3, c_epsilonFloatE4));
+
+    DenseMatrix c4(k, n);
+    c4.SetValue(0);
+    SparseMatrix::ScaleAndAdd(1, sm0, c4);
+    BOOST_CHECK(c4.IsEqualTo(dm0, c_epsilonFloatE4));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 }
 } } }
@@ -0,0 +1,201 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#include "stdafx.h"
+#include <cmath>
+#include <limits>
+#include <random>
+#include <vector>
+#include "../../../Source/Math/CPUVectorKernels.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+// an odd length, so that all kernels run into their tail handling
+static std::vector<float> CreateInput(float range, size_t n = 1003)
+{
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> dist(-range, range);
+    std::vector<float> x(n);
+    for (auto& v : x)
+        v = dist(rng);
+    return x;
+}
+
+static std::vector<CPUInstructionSet> GetSupportedInstructionSets()
+{
+    std::vector<CPUInstructionSet> instructionSets;
+    for (int i = 0; i <= (int) CPUVectorKernels::GetSupportedInstructionSet(); i++)
+        instructionSets.push_back((CPUInstructionSet) i);
+    return instructionSets;
+}
+
+// relative tolerance in percent, as used by BOOST_CHECK_CLOSE
+static const float c_tolerance = 2e-4f;
+
+BOOST_AUTO_TEST_SUITE(CPUVectorKernelsSuite)
+
+BOOST_AUTO_TEST_CASE(CPUVectorKernelsElementwise)
+{
+    auto x = CreateInput(30);
+    x[0] = 0;
+    x[1] = 1e-8f;
+    x[2] = -0.6f; // near the switch between the two tanh approximations
+    x[3] = 0.63f;
+
+    for (auto instructionSet : GetSupportedInstructionSets())
+    {
+        const auto& kernels = CPUVectorKernels::Get(instructionSet);
+        std::vector<float> out(x.size());
+
+        kernels.Exp(x.data(), out.data(), x.size());
+        for (size_t i = 0; i < x.size(); i++)
+            BOOST_CHECK_CLOSE(out[i], std::exp(x[i]), c_tolerance);
+
+        kernels.Tanh(x.data(), out.data(), x.size());
+        for (size_t i = 0; i < x.size(); i++)
+            BOOST_CHECK_CLOSE(out[i], std::tanh(x[i]), c_tolerance);
+
+        kernels.Sigmoid(x.data(), out.data(), x.size());
+        for (size_t i = 0; i < x.size(); i++)
+            BOOST_CHECK_CLOSE(out[i], (float) (1 / (1 + std::exp(-(double) x[i]))), c_tolerance);
+
+        std::vector<float> c(x.size(), 1.0f);
+        kernels.AddElementProduct(x.data(), x.data(), c.data(), x.size());
+        for (size_t i = 0; i < x.size(); i++)
+            BOOST_CHECK_CLOSE(c[i], 1 + x[i] * x[i], c_tolerance);
+
+        std::fill(c.begin(), c.end(), 1.0f);
+        kernels.AddScaled(x.data(), 0.5f, c.data(), x.size());
+        for (size_t i = 0; i < x.size(); i++)
+            BOOST_CHECK_CLOSE(c[i], 1 + 0.5f * x[i], c_tolerance);
+
+        // in place
+        out = x;
+        kernels.Exp(out.data(), out.data(), out.size());
+        for (size_t i = 0; i < x.size(); i++)
+            BOOST_CHECK_CLOSE(out[i], std::exp(x[i]), c_tolerance);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(CPUVectorKernelsLog)
+{
+    auto x = CreateInput(100);
+    for (size_t i = 0; i < x.size(); i++)
+        x[i] = std::abs(x[i]) * (i % 3 == 0 ? 1e-30f : 1.0f);
+    x[0] = 0;
+    x[1] = 1e-38f;
+    x[2] = -1;
+
+    for (auto instructionSet : GetSupportedInstructionSets())
+    {
+        std::vector<float> out(x.size());
+        CPUVectorKernels::Get(instructionSet).Log(x.data(), out.data(), x.size(), 1e-37f, -85.1f);
+        for (size_t i = 0; i < x.size(); i++)
+        {
+            if (x[i] < 1e-37f)
+                BOOST_CHECK_EQUAL(out[i], -85.1f);
+            else
+                BOOST_CHECK_CLOSE(out[i], std::log(x[i]), c_tolerance);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(CPUVectorKernelsSpecialValues)
+{
+    const float inf = std::numeric_limits<float>::infinity();
+    std::vector<float> x = {std::numeric_limits<float>::quiet_NaN(), inf, -inf, 100, -100};
+
+    for (auto instructionSet : GetSupportedInstructionSets())
+    {
+        const auto& kernels = CPUVectorKernels::Get(instructionSet);
+        std::vector<float> out(x.size());
+
+        kernels.Exp(x.data(), out.data(), x.size());
+        BOOST_CHECK(std::isnan(out[0]));
+        BOOST_CHECK_EQUAL(out[1], inf);
+        BOOST_CHECK_EQUAL(out[2], 0);
+        BOOST_CHECK_EQUAL(out[3], inf);
+        BOOST_CHECK_EQUAL(out[4], 0);
+
+        kernels.Tanh(x.data(), out.data(), x.size());
+        BOOST_CHECK(std::isnan(out[0]));
+        BOOST_CHECK_EQUAL(out[1], 1);
+        BOOST_CHECK_EQUAL(out[2], -1);
+
+        kernels.Sigmoid(x.data(), out.data(), x.size());
+        BOOST_CHECK(std::isnan(out[0]));
+        BOOST_CHECK_EQUAL(out[1], 1);
+        BOOST_CHECK_EQUAL(out[2], 0);
+
+        kernels.Log(x.data(), out.data(), 2, 1e-37f, -85.1f);
+        BOOST_CHECK(std::isnan(out[0]));
+        BOOST_CHECK_EQUAL(out[1], inf);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(CPUVectorKernelsReductions)
+{
+    // lengths below, at, and above the vector widths
+    for (size_t n : {1, 3, 4, 8, 16, 17, 64, 65, 1003})
+    {
+        auto x = CreateInput(30, n);
+        float expectedMax = x[0];
+        for (auto v : x)
+            expectedMax = std::max(expectedMax, v);
+        double expectedSum = 0;
+        for (auto v : x)
+            expectedSum += std::exp((double) v - expectedMax);
+
+        for (auto instructionSet : GetSupportedInstructionSets())
+        {
+            const auto& kernels = CPUVectorKernels::Get(instructionSet);
+            const float maxV = kernels.Max(x.data(), n);
+            BOOST_CHECK_EQUAL(maxV, expectedMax);
+
+            std::vector<float> out(n);
+            const float sum = kernels.ShiftAndSumExp(x.data(), maxV, out.data(), n);
+            BOOST_CHECK_CLOSE(sum, (float) expectedSum, c_tolerance);
+            for (size_t i = 0; i < n; i++)
+                BOOST_CHECK_EQUAL(out[i], x[i] - maxV);
+
+            BOOST_CHECK_CLOSE(kernels.ShiftExpAndSum(x.data(), maxV, out.data(), n), (float) expectedSum, c_tolerance);
+            for (size_t i = 0; i < n; i++)
+                BOOST_CHECK_CLOSE(out[i], (float) std::exp((double) x[i] - expectedMax), c_tolerance);
+
+            float onlineMax;
+            const float onlineSum = kernels.MaxAndSumExp(x.data(), n, onlineMax);
+            BOOST_CHECK_EQUAL(onlineMax, expectedMax);
+            BOOST_CHECK_CLOSE(onlineSum, (float) expectedSum, c_tolerance);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(CPUVectorKernelsDotInt8)
+{
+    std::mt19937 rng(1);
+    std::uniform_int_distribution<int> dist(-127, 127);
+    for (size_t n : {1, 15, 16, 17, 64, 1003, 4096})
+    {
+        std::vector<int8_t> a(n), b(n);
+        int32_t expected = 0;
+        for (size_t i = 0; i < n; i++)
+        {
+            a[i] = (int8_t) dist(rng);
+            b[i] = (int8_t) dist(rng);
+            expected += (int32_t) a[i] * b[i];
+        }
+        // the extremes, where 16-bit intermediate sums would overflow
+        std::vector<int8_t> c(n, 127), d(n, -127);
+
+        for (auto instructionSet : GetSupportedInstructionSets())
+        {
+            const auto& kernels = CPUVectorKernels::Get(instructionSet);
+            BOOST_CHECK_EQUAL(kernels.DotInt8(a.data(), b.data(), n), expected);
+            BOOST_CHECK_EQUAL(kernels.DotInt8(c.data(), d.data(), n), -127 * 127 * (int32_t) n);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+} } } }
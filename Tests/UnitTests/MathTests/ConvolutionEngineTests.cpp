@@ -1041,6 +1041,102 @@ BOOST_AUTO_TEST_CASE(BatchNormalizationBackward)
     }
 }
 
+// Training forward and backward with a fused ReLU on the CPU engine, against cuDNN with the same flag.
+BOOST_AUTO_TEST_CASE(BatchNormalizationReluTrainCpu)
+{
+    if (!IsCuDnnSupported())
+        return;
+
+    std::mt19937 rng(0);
+    std::normal_distribution<float> nd;
+
+    int deviceId = -1;
+    int cudnnDeviceId = 0;
+    auto fact = ConvFact::Create(cudnnDeviceId, ConvFact::EngineType::CuDnn, ImageLayoutKind::CHW);
+    auto engCudnn = fact->CreateConvEngine(cudnnDeviceId, ImageLayoutKind::CHW, 0, BatchNormImpl::CuDnn);
+    auto testFact = ConvFact::Create(deviceId, ConvFact::EngineType::Auto, ImageLayoutKind::CHW);
+    auto engCntk = testFact->CreateConvEngine(deviceId, ImageLayoutKind::CHW, 0, BatchNormImpl::Cntk);
+    for (auto& cfg : GenerateBNTestConfigs(*fact))
+    {
+        auto& t = *std::move(std::get<0>(cfg));
+        bool spatial = std::get<1>(cfg);
+        double expAvg = std::get<2>(cfg);
+        double eps = 1e-5; // CUDNN_BN_MIN_EPSILON
+
+        size_t crow = t.w() * t.h() * t.c();
+        size_t ccol = t.n();
+
+        // the same values on the CPU and on the GPU
+        auto initPair = [&](size_t r, size_t c, SingleMatrix& cpu, SingleMatrix& gpu)
+        {
+            vec buf(r * c);
+            std::generate(begin(buf), end(buf), [&] { return nd(rng); });
+            cpu.SetValue(r, c, deviceId, buf.data());
+            gpu.SetValue(r, c, cudnnDeviceId, buf.data());
+        };
+
+        Tensor4DPtr scaleBiasT = spatial ? fact->CreateTensor(1, 1, t.c(), 1) : fact->CreateTensor(t.w(), t.h(), t.c(), 1);
+        size_t crowScaleBias = scaleBiasT->w() * scaleBiasT->h() * scaleBiasT->c();
+
+        SingleMatrix x(deviceId), xExp(cudnnDeviceId);
+        initPair(crow, ccol, x, xExp);
+        SingleMatrix dy(deviceId), dyExp(cudnnDeviceId);
+        initPair(crow, ccol, dy, dyExp);
+        SingleMatrix scale(deviceId), scaleExp(cudnnDeviceId);
+        initPair(crowScaleBias, 1, scale, scaleExp);
+        SingleMatrix bias(deviceId), biasExp(cudnnDeviceId);
+        initPair(crowScaleBias, 1, bias, biasExp);
+        SingleMatrix runMean(deviceId), runMeanExp(cudnnDeviceId);
+        initPair(crowScaleBias, 1, runMean, runMeanExp);
+        SingleMatrix runInvStdDev(deviceId), runInvStdDevExp(cudnnDeviceId);
+        initPair(crowScaleBias, 1, runInvStdDev, runInvStdDevExp);
+        SingleMatrix dx(deviceId), dxExp(cudnnDeviceId);
+        initPair(crow, ccol, dx, dxExp);
+
+        SingleMatrix out(crow, ccol, deviceId), outExp(crow, ccol, cudnnDeviceId);
+        SingleMatrix saveMean(crowScaleBias, 1, deviceId), saveMeanExp(crowScaleBias, 1, cudnnDeviceId);
+        SingleMatrix saveInvStdDev(crowScaleBias, 1, deviceId), saveInvStdDevExp(crowScaleBias, 1, cudnnDeviceId);
+        SingleMatrix dScale(crowScaleBias, 1, deviceId), dScaleExp(crowScaleBias, 1, cudnnDeviceId);
+        SingleMatrix dBias(crowScaleBias, 1, deviceId), dBiasExp(crowScaleBias, 1, cudnnDeviceId);
+
+        engCntk->NormalizeBatch(t, x, *scaleBiasT, scale, bias, spatial, expAvg, runMean, runInvStdDev, out, eps, saveMean, saveInvStdDev, /*relu=*/true);
+        engCudnn->NormalizeBatch(t, xExp, *scaleBiasT, scaleExp, biasExp, spatial, expAvg, runMeanExp, runInvStdDevExp, outExp, eps, saveMeanExp, saveInvStdDevExp, /*relu=*/true);
+
+        engCntk->BackwardNormalizeBatch(t, x, dy, dx, *scaleBiasT, scale, spatial, saveMean, saveInvStdDev, dScale, dBias, &out);
+        engCudnn->BackwardNormalizeBatch(t, xExp, dyExp, dxExp, *scaleBiasT, scaleExp, spatial, saveMeanExp, saveInvStdDevExp, dScaleExp, dBiasExp, &outExp);
+
+        std::stringstream tmsg;
+        tmsg << "tensor: (w = " << t.w() << ", h = " << t.h() << ", c = " << t.c() << ", n = " << t.n()
+             << ", spatial = " << (spatial ? "true" : "false")
+             << ", expAvg = " << expAvg << ")";
+        std::string msg = " are not equal, " + tmsg.str();
+
+        float relErr = Err<float>::Rel;
+        float absErr = Err<float>::Abs;
+        std::string emsg;
+
+        auto checkEqual = [&](const SingleMatrix& actual, const SingleMatrix& expected, const char* name, float rel, float abs)
+        {
+            SingleMatrix expectedOnCpu(expected.GetNumRows(), expected.GetNumCols(), expected.CopyToArray(), deviceId, matrixFlagNormal);
+            BOOST_REQUIRE_MESSAGE(CheckEqual(actual, expectedOnCpu, emsg, rel, abs), name << msg << ". " << emsg);
+        };
+        checkEqual(out, outExp, "out", relErr, absErr * 20);
+        size_t numNegative = 0;
+        foreach_coord (i, j, out)
+        {
+            numNegative += out(i, j) < 0 ? 1 : 0;
+        }
+        BOOST_REQUIRE_MESSAGE(numNegative == 0, "out has negative values, " << tmsg.str());
+        checkEqual(runMean, runMeanExp, "runMean", relErr, absErr);
+        checkEqual(runInvStdDev, runInvStdDevExp, "runInvStdDev", relErr, absErr);
+        checkEqual(saveMean, saveMeanExp, "saveMean", relErr, absErr);
+        checkEqual(saveInvStdDev, saveInvStdDevExp, "saveInvStdDev", relErr, absErr);
+        checkEqual(dx, dxExp, "dx", relErr * 16, absErr * 8);
+        checkEqual(dScale, dScaleExp, "dScale", relErr * 32, absErr * 8);
+        checkEqual(dBias, dBiasExp, "dBias", relErr * 32, absErr * 8);
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 }
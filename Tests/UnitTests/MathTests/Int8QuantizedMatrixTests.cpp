@@ -0,0 +1,104 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#include "stdafx.h"
+#include <algorithm>
+#include <math.h>
+#include "../../../Source/Math/Matrix.h"
+#include "../../../Source/Math/Int8QuantizedMatrix.h"
+#include "../../../Source/ComputationNetworkLib/ComputationNetwork.h"
+#include "../../../Source/ComputationNetworkLib/ComputationNetworkBuilder.h"
+
+using namespace Microsoft::MSR::CNTK;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+BOOST_AUTO_TEST_SUITE(Int8QuantizedMatrixSuite)
+
+BOOST_FIXTURE_TEST_CASE(Int8QuantizedMatrixMultiply, RandomSeedFixture)
+{
+    const size_t numRows = 37, numCols = 203, numSamples = 11;
+    SingleMatrix weights = SingleMatrix::RandomGaussian(numRows, numCols, CPUDEVICE, 0, 1, IncrementCounter());
+    for (size_t k = 0; k < numCols; k++)
+        weights(0, k) = 0; // an all-zero row
+    weights(1, 5) = 1000;  // a row with one large outlier, which must not affect the precision of the other rows
+    SingleMatrix input = SingleMatrix::RandomGaussian(numCols, numSamples, CPUDEVICE, 0, 1, IncrementCounter());
+
+    SingleMatrix expected(numRows, numSamples, CPUDEVICE);
+    SingleMatrix::MultiplyAndWeightedAdd(1, weights, false, input, false, 0, expected);
+
+    Int8QuantizedMatrix<float> quantized(weights);
+    BOOST_CHECK_EQUAL(quantized.GetNumRows(), numRows);
+    BOOST_CHECK_EQUAL(quantized.GetNumCols(), numCols);
+    SingleMatrix actual(numRows, numSamples, CPUDEVICE);
+    quantized.Multiply(input, actual);
+
+    // Each row of W and each column of the input are rounded to multiples of their scales s = max |W(i, :)| / 127
+    // and t = max |x| / 127, so |(W x)(i) - Q(W) Q(x)(i)| <= sum_k (|W(i, k)| t + s |x(k)| + s t / 2) / 2.
+    for (size_t j = 0; j < numSamples; j++)
+    {
+        float maxInput = 0;
+        for (size_t k = 0; k < numCols; k++)
+            maxInput = std::max(maxInput, fabs(input(k, j)));
+        const float t = maxInput / 127;
+
+        for (size_t i = 0; i < numRows; i++)
+        {
+            float maxWeight = 0;
+            for (size_t k = 0; k < numCols; k++)
+                maxWeight = std::max(maxWeight, fabs(weights(i, k)));
+            const float s = maxWeight / 127;
+
+            float tolerance = 0;
+            float magnitude = 0;
+            for (size_t k = 0; k < numCols; k++)
+            {
+                tolerance += (fabs(weights(i, k)) * t + s * fabs(input(k, j)) + s * t / 2) / 2;
+                magnitude += fabs(weights(i, k) * input(k, j));
+            }
+            // plus the rounding of the float products
+            tolerance += c_epsilonFloatE4 * magnitude;
+
+            BOOST_CHECK_SMALL(actual(i, j) - expected(i, j), tolerance);
+        }
+        BOOST_CHECK_EQUAL(actual(0, j), 0);
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(Int8QuantizeNetworkWeights, RandomSeedFixture)
+{
+    const size_t inputDim = 20, outputDim = 10;
+    auto net = make_shared<ComputationNetwork>(CPUDEVICE);
+    ComputationNetworkBuilder<float> builder(*net);
+
+    auto features = builder.CreateInputNode(L"features", inputDim);
+    auto weights = builder.CreateLearnableParameter(L"W", outputDim, inputDim);
+    net->InitLearnableParameters(weights, true, IncrementCounter(), 1.0f);
+    auto times = builder.Times(weights, features, 1, L"dense");
+
+    // the same with sparse input, for which the int8 product is not used
+    auto sparseFeatures = builder.CreateSparseInputNode(L"sparseFeatures", inputDim);
+    auto sparseWeights = builder.CreateLearnableParameter(L"V", outputDim, inputDim);
+    net->InitLearnableParameters(sparseWeights, true, IncrementCounter(), 1.0f);
+    auto sparseTimes = builder.Times(sparseWeights, sparseFeatures, 1, L"sparse");
+
+    net->FeatureNodes().push_back(features);
+    net->FeatureNodes().push_back(sparseFeatures);
+    net->OutputNodes().push_back(times);
+    net->OutputNodes().push_back(sparseTimes);
+    net->CompileNetwork();
+
+    BOOST_CHECK_EQUAL(net->QuantizeWeightsToInt8<float>(), 1);
+
+    // the float weights of the quantized node are freed, since it was their only consumer
+    BOOST_CHECK_EQUAL(weights->Value().GetNumElements(), 0);
+
+    // the node with sparse input falls back to its float weights
+    BOOST_CHECK_EQUAL(sparseWeights->Value().GetNumElements(), outputDim * inputDim);
+    BOOST_CHECK(dynamic_pointer_cast<IInt8QuantizableNode>(sparseTimes)->QuantizeWeightsToInt8() == nullptr);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+}
+} } }
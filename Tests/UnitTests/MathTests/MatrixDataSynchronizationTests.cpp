@@ -107,6 +107,26 @@ BOOST_FIXTURE_TEST_CASE(MatrixDataSynchronization_GravitatingTowardsPreferredDev
     BOOST_CHECK_EQUAL(CurrentDataLocation::GPU, matrixC.GetCurrentMatrixLocation());
 }
 
+// Requires GPU
+BOOST_FIXTURE_TEST_CASE(MatrixDataSynchronization_SetValueFromOtherDeviceMovesNeitherMatrix, RandomSeedFixture)
+{
+    const SingleMatrix matrixA = SingleMatrix::RandomGaussian(64, 23, CPUDEVICE, 0, 2, IncrementCounter());
+    SingleMatrix matrixB(c_deviceIdZero);
+    SingleMatrix matrixC(CPUDEVICE);
+
+    matrixB.SetValueFromOtherDevice(matrixA);
+    BOOST_CHECK_EQUAL(CurrentDataLocation::CPU, matrixA.GetCurrentMatrixLocation());
+    BOOST_CHECK_EQUAL(CurrentDataLocation::GPU, matrixB.GetCurrentMatrixLocation());
+
+    matrixC.SetValueFromOtherDevice(matrixB);
+    BOOST_CHECK_EQUAL(CurrentDataLocation::GPU, matrixB.GetCurrentMatrixLocation());
+    BOOST_CHECK_EQUAL(CurrentDataLocation::CPU, matrixC.GetCurrentMatrixLocation());
+
+    BOOST_CHECK_EQUAL(64, matrixC.GetNumRows());
+    BOOST_CHECK_EQUAL(23, matrixC.GetNumCols());
+    BOOST_CHECK(matrixC.IsEqualTo(matrixA));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 }
 } } }
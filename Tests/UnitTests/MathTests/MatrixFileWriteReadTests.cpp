@@ -37,6 +37,112 @@ BOOST_FIXTURE_TEST_CASE(CPUMatrixFileWriteRead, RandomSeedFixture)
     BOOST_CHECK(matrixCpuCopy.IsEqualTo(matrixCpuRead, c_epsilonFloatE5));
 }
 
+BOOST_FIXTURE_TEST_CASE(CPUMatrixFileWriteReadAlignedBlocks, RandomSeedFixture)
+{
+    CPUMatrix<float> matrixCpu = CPUMatrix<float>::RandomUniform(43, 10, -26.3f, 30.2f, IncrementCounter());
+    CPUMatrix<float> matrixCpu2 = CPUMatrix<float>::RandomUniform(7, 3, -26.3f, 30.2f, IncrementCounter());
+
+    std::wstring fileNameCpu(L"MCPUAligned.bin");
+    {
+        File fileCpu(fileNameCpu, fileOptionsBinary | fileOptionsWrite | fileOptionsAlignedBlocks);
+        fileCpu << matrixCpu << matrixCpu2;
+    }
+
+    // read into memory
+    {
+        File fileCpu(fileNameCpu, fileOptionsBinary | fileOptionsRead);
+        CPUMatrix<float> matrixCpuRead, matrixCpu2Read;
+        fileCpu >> matrixCpuRead >> matrixCpu2Read;
+        BOOST_CHECK(matrixCpu.IsEqualTo(matrixCpuRead, c_epsilonFloatE5));
+        BOOST_CHECK(matrixCpu2.IsEqualTo(matrixCpu2Read, c_epsilonFloatE5));
+    }
+
+    // mapped; writing to a mapped matrix must not change the file
+    CPUMatrix<float> matrixCpuMapped, matrixCpu2Mapped;
+    {
+        File fileCpu(fileNameCpu, fileOptionsBinary | fileOptionsRead | fileOptionsMapBlocks);
+        fileCpu >> matrixCpuMapped >> matrixCpu2Mapped;
+    }
+    BOOST_CHECK(matrixCpu.IsEqualTo(matrixCpuMapped, c_epsilonFloatE5));
+    BOOST_CHECK(matrixCpu2.IsEqualTo(matrixCpu2Mapped, c_epsilonFloatE5));
+    BOOST_CHECK_EQUAL((size_t) matrixCpuMapped.BufferPointer() % 4096, 0); // page-aligned
+    matrixCpuMapped.SetValue(0);
+    {
+        File fileCpu(fileNameCpu, fileOptionsBinary | fileOptionsRead);
+        CPUMatrix<float> matrixCpuRead;
+        fileCpu >> matrixCpuRead;
+        BOOST_CHECK(matrixCpu.IsEqualTo(matrixCpuRead, c_epsilonFloatE5));
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(CPUMatrixFileWriteReadParallelBlocks, RandomSeedFixture)
+{
+    std::vector<CPUMatrix<float>> matrices;
+    for (size_t i = 0; i < 20; i++)
+        matrices.push_back(CPUMatrix<float>::RandomUniform(13 * (i + 1), 7, -26.3f, 30.2f, IncrementCounter()));
+
+    // written by several threads, the file must be the same as one written block by block
+    std::wstring fileNameParallel(L"MCPUParallel.bin"), fileNameSequential(L"MCPUSequential.bin");
+    {
+        File fileCpu(fileNameParallel, fileOptionsBinary | fileOptionsWrite | fileOptionsAlignedBlocks | fileOptionsParallelBlocks);
+        for (const auto& matrix : matrices)
+            fileCpu << matrix;
+        fileCpu << (size_t) 42;
+        fileCpu.Flush();
+    }
+    {
+        File fileCpu(fileNameSequential, fileOptionsBinary | fileOptionsWrite | fileOptionsAlignedBlocks);
+        for (const auto& matrix : matrices)
+            fileCpu << matrix;
+        fileCpu << (size_t) 42;
+    }
+    {
+        File fileParallel(fileNameParallel, fileOptionsBinary | fileOptionsRead);
+        File fileSequential(fileNameSequential, fileOptionsBinary | fileOptionsRead);
+        BOOST_REQUIRE_EQUAL(fileParallel.Size(), fileSequential.Size());
+        std::vector<char> parallel(fileParallel.Size()), sequential(fileSequential.Size());
+        fileParallel.GetArray(parallel.data(), parallel.size());
+        fileSequential.GetArray(sequential.data(), sequential.size());
+        BOOST_CHECK(parallel == sequential);
+    }
+
+    // read by several threads; the matrices have their dimensions right away, and their values after FinishAlignedBlocks()
+    {
+        File fileCpu(fileNameParallel, fileOptionsBinary | fileOptionsRead | fileOptionsParallelBlocks);
+        std::vector<CPUMatrix<float>> matricesRead(matrices.size());
+        for (size_t i = 0; i < matrices.size(); i++)
+        {
+            fileCpu >> matricesRead[i];
+            BOOST_CHECK_EQUAL(matricesRead[i].GetNumRows(), matrices[i].GetNumRows());
+        }
+        size_t end;
+        fileCpu >> end;
+        BOOST_CHECK_EQUAL(end, 42);
+        fileCpu.FinishAlignedBlocks();
+        for (size_t i = 0; i < matrices.size(); i++)
+            BOOST_CHECK(matrices[i].IsEqualTo(matricesRead[i], c_epsilonFloatE5));
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(CPUMatrixFileWriteReadHalf, RandomSeedFixture)
+{
+    CPUMatrix<float> matrixCpu = CPUMatrix<float>::RandomUniform(43, 10, -26.3f, 30.2f, IncrementCounter());
+
+    std::wstring fileNameCpu(L"MCPUHalf.bin");
+    {
+        File fileCpu(fileNameCpu, fileOptionsBinary | fileOptionsWrite | fileOptionsHalfMatrices);
+        fileCpu << matrixCpu;
+    }
+
+    // rounded to 11 significant bits
+    File fileCpu(fileNameCpu, fileOptionsBinary | fileOptionsRead);
+    BOOST_CHECK_LT(fileCpu.Size(), 43 * 10 * sizeof(float));
+    CPUMatrix<float> matrixCpuRead;
+    fileCpu >> matrixCpuRead;
+    BOOST_CHECK(matrixCpu.IsEqualTo(matrixCpuRead, 0.02f));
+    BOOST_CHECK_EQUAL(matrixCpuRead(3, 4), HalfToFloat(FloatToHalf(matrixCpu(3, 4))));
+}
+
 BOOST_FIXTURE_TEST_CASE(MatrixFileWriteRead, RandomSeedFixture)
 {
     // Test Matrix in Dense mode
@@ -6,6 +6,7 @@
 //
 #include "stdafx.h"
 #include "../../../Source/Math/Matrix.h"
+#include "../../../Source/Math/SparseStagingBuffer.h"
 
 using namespace Microsoft::MSR::CNTK;
 
@@ -67,6 +68,40 @@ BOOST_FIXTURE_TEST_CASE(MatrixSparseTimesDense, RandomSeedFixture)
     BOOST_CHECK(mD.IsEqualTo(mC, c_epsilonFloatE4));
 }
 
+// the CSC format is multiplied from the left without a conversion to CSR
+static void TestSparseCSCTimesDense(RandomSeedFixture& fixture, DEVICEID_TYPE deviceId, size_t dim1, size_t dim2, size_t dim3)
+{
+    Matrix<float> mAdense(deviceId);
+    mAdense.AssignTruncateBottomOf(Matrix<float>::RandomUniform(dim1, dim2, deviceId, -3.0f, 0.1f, fixture.IncrementCounter()), 0);
+
+    Matrix<float> mAsparse(mAdense);
+    mAsparse.SwitchToMatrixType(MatrixType::SPARSE, matrixFormatSparseCSC, true);
+
+    for (bool transposeA : {false, true})
+    {
+        Matrix<float> mB = Matrix<float>::RandomGaussian(transposeA ? dim1 : dim2, dim3, deviceId, 1.0f, 4.0f, fixture.IncrementCounter());
+        Matrix<float> mC = Matrix<float>::RandomGaussian(transposeA ? dim2 : dim1, dim3, deviceId, 1.0f, 2.0f, fixture.IncrementCounter());
+        Matrix<float> mD(mC);
+
+        float alpha = 0.3f;
+        float beta = 2.0f;
+        Matrix<float>::MultiplyAndWeightedAdd(alpha, mAdense, transposeA, mB, false, beta, mC);
+        Matrix<float>::MultiplyAndWeightedAdd(alpha, mAsparse, transposeA, mB, false, beta, mD);
+
+        BOOST_CHECK(mD.IsEqualTo(mC, c_epsilonFloatE4));
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(MatrixSparseCSCTimesDense, RandomSeedFixture)
+{
+    TestSparseCSCTimesDense(*this, c_deviceIdZero, dim1, dim2, dim3);
+}
+
+BOOST_FIXTURE_TEST_CASE(CPUMatrixSparseCSCTimesDense, RandomSeedFixture)
+{
+    TestSparseCSCTimesDense(*this, CPUDEVICE, 5, 7, 3);
+}
+
 BOOST_FIXTURE_TEST_CASE(MatrixDenseTimesSparse, RandomSeedFixture)
 {
     Matrix<float> mAdense(c_deviceIdZero);
@@ -275,6 +310,43 @@ BOOST_FIXTURE_TEST_CASE(MatrixSparseElementWisePower, RandomSeedFixture)
     BOOST_CHECK(1);
 }
 
+BOOST_FIXTURE_TEST_CASE(MatrixSparseStagingBufferTransfer, RandomSeedFixture)
+{
+    // columns of a CSC matrix, including empty ones; more columns than a thread block, for the scan of the column counts
+    const size_t numRows = 1000, numCols = 1500;
+    std::vector<CPUSPARSE_INDEX_TYPE> colOffsets(1, 0), rowIndices;
+    std::vector<float> values;
+    for (size_t j = 0; j < numCols; j++)
+    {
+        for (size_t i = j % 7; i < numRows; i += 97 + j % 13)
+        {
+            rowIndices.push_back((CPUSPARSE_INDEX_TYPE) i);
+            values.push_back((float) (i + 1) / (float) (j + 1));
+        }
+        colOffsets.push_back((CPUSPARSE_INDEX_TYPE) rowIndices.size());
+    }
+
+    Matrix<float> expected(numRows, numCols, CPUDEVICE, MatrixType::SPARSE, matrixFormatSparseCSC);
+    expected.SetMatrixFromCSCFormat(colOffsets.data(), rowIndices.data(), values.data(), values.size(), numRows, numCols);
+    expected.SwitchToMatrixType(MatrixType::DENSE, matrixFormatDense, true);
+
+    // twice into the same buffer, to check that it is reused
+    SparseStagingBuffer<float> staging(c_deviceIdZero);
+    Matrix<float> features(c_deviceIdZero);
+    for (size_t pass = 0; pass < 2; pass++)
+    {
+        staging.Clear();
+        for (size_t j = 0; j < numCols; j++)
+            staging.AppendColumn(values.data() + colOffsets[j], rowIndices.data() + colOffsets[j], colOffsets[j + 1] - colOffsets[j]);
+        staging.TransferTo(features, numRows);
+    }
+
+    BOOST_CHECK_EQUAL(values.size(), features.NzCount());
+    features.SwitchToMatrixType(MatrixType::DENSE, matrixFormatDense, true);
+    expected.TransferToDeviceIfNotThere(c_deviceIdZero, true);
+    BOOST_CHECK(features.IsEqualTo(expected, c_epsilonFloatE5));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 }
 } } }
@@ -6,6 +6,9 @@
 #include "../../../Source/Math/Matrix.h"
 #include "../../../Source/Math/CPUMatrix.h"
 #include "../../../Source/Math/Helpers.h"
+#include "../../../Source/Math/DeviceScalarFuture.h"
+#include "../../../Source/Math/BlockSparseMatrix.h"
+#include "../../../Source/Math/PackedWeightMatrix.h"
 
 #define IDX2C(i, j, ld) (((j) * (ld)) + (i)) // 0 based indexing
 
@@ -1101,6 +1104,437 @@ BOOST_FIXTURE_TEST_CASE(MatrixAssignNumOfDiff, RandomSeedFixture)
         BOOST_CHECK_EQUAL(expectedDiff, actual.Get00Element());
     }
 }
+BOOST_FIXTURE_TEST_CASE(MatrixDeviceScalarResults, RandomSeedFixture)
+{
+    // the stream-ordered variants must agree with the ones that return host values
+    for (auto deviceId : {CPUDEVICE, c_deviceIdZero})
+    {
+        SingleMatrix a = SingleMatrix::RandomUniform(43, 17, deviceId, -3, 2, IncrementCounter());
+        SingleMatrix aCopy(a, deviceId);
+        SingleMatrix b(a, deviceId);
+        SingleMatrix bColumn = b.ColumnSlice(7, 1);
+        bColumn.SetValue(1000);
+
+        SingleMatrix normInf(deviceId), norm1(deviceId), aEqualsA(deviceId), aEqualsB(deviceId);
+        normInf.AssignMatrixNormInfOf(a);
+        norm1.AssignMatrixNorm1Of(a);
+        aEqualsA.AssignIsEqualTo(a, aCopy);
+        aEqualsB.AssignIsEqualTo(a, b);
+
+        DeviceScalarFuture<float> normInfValue(deviceId), norm1Value(deviceId), aEqualsAValue(deviceId), aEqualsBValue(deviceId);
+        normInfValue.Start(normInf);
+        norm1Value.Start(norm1);
+        aEqualsAValue.Start(aEqualsA);
+        aEqualsBValue.Start(aEqualsB);
+
+        BOOST_CHECK_CLOSE(a.MatrixNormInf(), normInfValue.Get(), 1e-4);
+        BOOST_CHECK_CLOSE(a.MatrixNorm1(), norm1Value.Get(), 1e-3);
+        BOOST_CHECK_EQUAL(1.0f, aEqualsAValue.Get());
+        BOOST_CHECK_EQUAL(0.0f, aEqualsBValue.Get());
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(MatrixAdam, RandomSeedFixture)
+{
+    const float learnRate = 0.01f, beta1 = 0.9f, beta2 = 0.999f, epsilon = 1e-8f;
+    const size_t rows = 4, cols = 3;
+    for (auto deviceId : {CPUDEVICE, c_deviceIdZero})
+    {
+        SingleMatrix values = SingleMatrix::RandomUniform(rows, cols, deviceId, -1, 1, IncrementCounter());
+        SingleMatrix smoothedGradient(deviceId);
+        std::unique_ptr<float[]> expected(values.CopyToArray());
+        std::vector<double> mom(rows * cols, 0), sqr(rows * cols, 0);
+
+        for (size_t step = 1; step <= 2; step++)
+        {
+            SingleMatrix gradients = SingleMatrix::RandomUniform(rows, cols, deviceId, -1, 1, IncrementCounter());
+            std::unique_ptr<float[]> g(gradients.CopyToArray());
+            for (size_t i = 0; i < rows * cols; i++)
+            {
+                mom[i] = beta1 * mom[i] + (1 - beta1) * g[i];
+                sqr[i] = beta2 * sqr[i] + (1 - beta2) * g[i] * g[i];
+                double momHat = mom[i] / (1 - pow(beta1, step));
+                double sqrHat = sqr[i] / (1 - pow(beta2, step));
+                expected[i] -= (float) (learnRate * momHat / (sqrt(sqrHat) + epsilon));
+            }
+            smoothedGradient.Adam(step, gradients, values, learnRate, beta1, beta2, epsilon);
+        }
+
+        BOOST_CHECK_EQUAL(2 * cols, smoothedGradient.GetNumCols());
+        SingleMatrix expectedValues(rows, cols, expected.get(), deviceId, matrixFlagNormal);
+        BOOST_CHECK(values.IsEqualTo(expectedValues, c_epsilonFloatE5));
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(MatrixLazySparseUpdate, RandomSeedFixture)
+{
+    // embedding gradients of a few words per step; the last step has all of them, so the lazy updates must then equal
+    // updates of all columns in every step, in which the L2 term is the only gradient of the absent columns
+    const size_t dim = 3, vocab = 6;
+    const std::vector<std::vector<size_t>> wordsOfSteps = {{1, 3}, {3}, {0, 3}, {0, 1, 2, 3, 4, 5}};
+    const float learnRate = 0.1f, momentum = 0.9f, l2Weight = 0.05f;
+    for (auto deviceId : {CPUDEVICE, c_deviceIdZero})
+    {
+        for (bool isAdagrad : {false, true})
+        {
+            SingleMatrix values = SingleMatrix::RandomUniform(dim, vocab, deviceId, -1, 1, IncrementCounter());
+            std::unique_ptr<float[]> initialValues(values.CopyToArray());
+            std::vector<double> expected(initialValues.get(), initialValues.get() + dim * vocab), smoothed(dim * vocab, 0);
+            SingleMatrix smoothedGradient(deviceId);
+
+            for (size_t step = 1; step <= wordsOfSteps.size(); step++)
+            {
+                const auto& words = wordsOfSteps[step - 1];
+                std::vector<float> oneHot(vocab * words.size(), 0);
+                for (size_t t = 0; t < words.size(); t++)
+                    oneHot[t * vocab + words[t]] = 1;
+                SingleMatrix input(vocab, words.size(), oneHot.data(), deviceId, matrixFlagNormal);
+                SingleMatrix outputGradient = SingleMatrix::RandomUniform(dim, words.size(), deviceId, -1, 1, IncrementCounter());
+                SingleMatrix denseGradient(deviceId);
+                SingleMatrix::Multiply(outputGradient, false, input, true, denseGradient);
+                std::unique_ptr<float[]> g(denseGradient.CopyToArray());
+
+                // as in LookupTableNode::BackpropTo()
+                input.SwitchToMatrixType(MatrixType::SPARSE, matrixFormatSparseCSC, true);
+                SingleMatrix gradient(dim, vocab, deviceId);
+                gradient.SetValue(0);
+                gradient.SwitchToMatrixType(MatrixType::SPARSE, matrixFormatSparseBlockCol, false);
+                SingleMatrix::MultiplyAndAdd(outputGradient, false, input, true, gradient);
+
+                for (size_t i = 0; i < dim * vocab; i++)
+                {
+                    double gi = g[i] + l2Weight * expected[i];
+                    if (isAdagrad)
+                    {
+                        smoothed[i] += gi * gi;
+                        expected[i] -= learnRate * gi / sqrt(smoothed[i] + 1e-16);
+                    }
+                    else
+                    {
+                        smoothed[i] = momentum * smoothed[i] + (1 - momentum) * gi;
+                        expected[i] -= learnRate * smoothed[i];
+                    }
+                }
+                if (isAdagrad)
+                    smoothedGradient.LazyAdagrad(step, gradient, values, learnRate, l2Weight, /*needAveMultiplier=*/false);
+                else
+                    smoothedGradient.LazyNormalGrad(step, gradient, values, learnRate, momentum, l2Weight);
+            }
+
+            BOOST_CHECK_EQUAL(dim + 1, smoothedGradient.GetNumRows());
+            std::vector<float> expectedValuesArray(expected.begin(), expected.end()), expectedSmoothedArray(smoothed.begin(), smoothed.end());
+            SingleMatrix expectedValues(dim, vocab, expectedValuesArray.data(), deviceId, matrixFlagNormal);
+            SingleMatrix expectedSmoothed(dim, vocab, expectedSmoothedArray.data(), deviceId, matrixFlagNormal);
+            SingleMatrix smoothedPart(deviceId);
+            smoothedPart.AssignRowSliceValuesOf(smoothedGradient, 0, dim);
+            BOOST_CHECK(values.IsEqualTo(expectedValues, c_epsilonFloatE4));
+            BOOST_CHECK(smoothedPart.IsEqualTo(expectedSmoothed, c_epsilonFloatE4));
+        }
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(MatrixFusedSGDUpdate, RandomSeedFixture)
+{
+    // momentum SGD with clipping, L2 and L1, fused vs. one parameter at a time as in SGD::UpdateWeightsS()
+    const size_t dims[][2] = {{7, 3}, {100, 50}, {1, 1}, {64, 129}};
+    const double learnRates[] = {0.01, 0.02, 0.005, 0.01};
+    const float momentum = 0.9f, threshold = 0.5f, L2Weight = 0.001f;
+    const double L1Weight = 0.0001;
+    const size_t mbSize = 1;
+
+    for (auto deviceId : {CPUDEVICE, c_deviceIdZero})
+    {
+        auto copy = [deviceId](const SingleMatrix& m)
+        {
+            SingleMatrix c(deviceId);
+            c.SetValue(m);
+            return c;
+        };
+        for (bool useNesterovMomentum : {false, true})
+        {
+            std::vector<SingleMatrix> values, gradients, smoothedGradients;
+            std::vector<SingleMatrix> expectedValues, expectedSmoothedGradients;
+            for (const auto& d : dims)
+            {
+                values.push_back(SingleMatrix::RandomUniform(d[0], d[1], deviceId, -1, 1, IncrementCounter()));
+                gradients.push_back(SingleMatrix::RandomUniform(d[0], d[1], deviceId, -1, 1, IncrementCounter()));
+                smoothedGradients.push_back(SingleMatrix::RandomUniform(d[0], d[1], deviceId, -0.1f, 0.1f, IncrementCounter()));
+                expectedValues.push_back(copy(values.back()));
+                expectedSmoothedGradients.push_back(copy(smoothedGradients.back()));
+            }
+
+            for (size_t i = 0; i < values.size(); i++)
+            {
+                SingleMatrix gradient = copy(gradients[i]);
+                gradient.InplaceTruncate(threshold);
+                SingleMatrix::ScaleAndAdd(L2Weight, expectedValues[i], gradient);
+                expectedSmoothedGradients[i].NormalGrad(gradient, expectedValues[i], (float) learnRates[i], momentum, useNesterovMomentum);
+                expectedValues[i].InplaceSoftThreshold((float) (learnRates[i] * L1Weight));
+            }
+
+            FusedSGDBatch<float> options;
+            options.m_isFSAdagrad = false;
+            options.m_useNesterovMomentum = useNesterovMomentum;
+            options.m_momentum = momentum;
+            options.m_adaWeight = 0;
+            options.m_truncationThreshold = threshold;
+            options.m_maxGradientNorm = std::numeric_limits<float>::infinity();
+            options.m_gradientSquaredNorm = nullptr;
+            options.m_L2Weight = L2Weight;
+            options.m_numTensors = 0;
+            std::vector<SingleMatrix*> valuePointers, smoothedGradientPointers;
+            std::vector<const SingleMatrix*> gradientPointers;
+            for (size_t i = 0; i < values.size(); i++)
+            {
+                valuePointers.push_back(&values[i]);
+                gradientPointers.push_back(&gradients[i]);
+                smoothedGradientPointers.push_back(&smoothedGradients[i]);
+            }
+            SingleMatrix::FusedSGDUpdate(options, mbSize, valuePointers, gradientPointers, smoothedGradientPointers,
+                                         std::vector<double>(std::begin(learnRates), std::end(learnRates)), L1Weight);
+
+            for (size_t i = 0; i < values.size(); i++)
+            {
+                BOOST_CHECK(values[i].IsEqualTo(expectedValues[i], c_epsilonFloatE5));
+                BOOST_CHECK(smoothedGradients[i].IsEqualTo(expectedSmoothedGradients[i], c_epsilonFloatE5));
+            }
+        }
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(MatrixFusedSGDUpdateGlobalNormClipping, RandomSeedFixture)
+{
+    const float learnRate = 0.1f, maxNorm = 1.0f;
+    for (auto deviceId : {CPUDEVICE, c_deviceIdZero})
+    {
+        std::vector<SingleMatrix> values, gradients, smoothedGradients;
+        for (size_t cols : {3, 2000})
+        {
+            values.push_back(SingleMatrix::RandomUniform(5, cols, deviceId, -1, 1, IncrementCounter()));
+            gradients.push_back(SingleMatrix::RandomUniform(5, cols, deviceId, -1, 1, IncrementCounter()));
+            smoothedGradients.push_back(SingleMatrix::Zeros(5, cols, deviceId));
+        }
+
+        double sumOfSquares = 0;
+        for (const auto& gradient : gradients)
+            sumOfSquares += (double) gradient.FrobeniusNorm() * gradient.FrobeniusNorm();
+        const float scale = (float) (maxNorm / sqrt(sumOfSquares));
+        BOOST_REQUIRE(scale < 1);
+
+        std::vector<SingleMatrix> expectedValues;
+        for (size_t i = 0; i < values.size(); i++)
+        {
+            expectedValues.push_back(SingleMatrix(deviceId));
+            expectedValues.back().SetValue(values[i]);
+            SingleMatrix::ScaleAndAdd(-learnRate * scale, gradients[i], expectedValues.back());
+        }
+
+        FusedSGDBatch<float> options;
+        options.m_isFSAdagrad = false;
+        options.m_useNesterovMomentum = false;
+        options.m_momentum = 0;
+        options.m_adaWeight = 0;
+        options.m_truncationThreshold = std::numeric_limits<float>::infinity();
+        options.m_maxGradientNorm = maxNorm;
+        options.m_gradientSquaredNorm = nullptr;
+        options.m_L2Weight = 0;
+        options.m_numTensors = 0;
+        SingleMatrix squaredNorm(deviceId);
+        SingleMatrix::FusedSGDUpdate(options, 1, {&values[0], &values[1]}, {&gradients[0], &gradients[1]}, {&smoothedGradients[0], &smoothedGradients[1]},
+                                     {learnRate, learnRate}, 0, &squaredNorm);
+
+        BOOST_CHECK_CLOSE(sumOfSquares, squaredNorm.Get00Element(), 0.01);
+        for (size_t i = 0; i < values.size(); i++)
+            BOOST_CHECK(values[i].IsEqualTo(expectedValues[i], c_epsilonFloatE5));
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(MatrixSampledSoftmax, RandomSeedFixture)
+{
+    for (auto deviceId : {CPUDEVICE, c_deviceIdZero})
+    {
+        // samples from the inverse of the cumulative distribution
+        float cdf[] = {0.1f, 0.3f, 0.6f, 1.0f};
+        float uniform[] = {0.05f, 0.1f, 0.35f, 0.99f, 0.6f};
+        SingleMatrix cdfMatrix(1, 4, cdf, deviceId, matrixFlagNormal);
+        SingleMatrix samples(1, 5, uniform, deviceId, matrixFlagNormal);
+        samples.InplaceSampleFromCDF(cdfMatrix);
+        std::unique_ptr<float[]> sampleIds(samples.CopyToArray());
+        const float expectedSampleIds[] = {0, 1, 2, 3, 3};
+        for (size_t i = 0; i < 5; i++)
+            BOOST_CHECK_EQUAL(expectedSampleIds[i], sampleIds[i]);
+
+        // one-hot columns gather the columns of a product
+        float ids[] = {2, 0, 3};
+        float weights[] = {1, 2, 3, 4, 5, 6, 7, 8}; // [2 x 4]
+        SingleMatrix idMatrix(1, 3, ids, deviceId, matrixFlagNormal);
+        SingleMatrix weightMatrix(2, 4, weights, deviceId, matrixFlagNormal);
+        SingleMatrix oneHot(deviceId);
+        oneHot.AssignOneHotColumnsOf(idMatrix, 4);
+        BOOST_CHECK(oneHot.GetMatrixType() == MatrixType::SPARSE);
+        SingleMatrix gathered(deviceId);
+        gathered.AssignProductOf(weightMatrix, false, oneHot, false);
+        float expectedGathered[] = {5, 6, 1, 2, 7, 8};
+        SingleMatrix expectedGatheredMatrix(2, 3, expectedGathered, deviceId, matrixFlagNormal);
+        BOOST_CHECK(gathered.IsEqualTo(expectedGatheredMatrix, c_epsilonFloatE5));
+
+        // corrected logits of 2 samples for 2 frames; sample 1 hits the label of frame 0
+        float trueLogits[] = {1, 2};
+        float sampledLogits[] = {0.5f, -0.5f, 1.5f, 3};
+        float candidateBiases[] = {0.1f, 0.2f, 0.3f, 0.4f};
+        float candidateIds[] = {3, 1, 1, 2};
+        SingleMatrix logits(deviceId);
+        logits.AssignSampledSoftmaxLogits(SingleMatrix(1, 2, trueLogits, deviceId, matrixFlagNormal), SingleMatrix(2, 2, sampledLogits, deviceId, matrixFlagNormal),
+                                          SingleMatrix(1, 4, candidateBiases, deviceId, matrixFlagNormal), SingleMatrix(1, 4, candidateIds, deviceId, matrixFlagNormal));
+        BOOST_CHECK_EQUAL(3, logits.GetNumRows());
+        BOOST_CHECK_EQUAL(2, logits.GetNumCols());
+        std::unique_ptr<float[]> result(logits.CopyToArray());
+        const float expectedLogits[] = {1.3f, 0.6f, 0, 2.4f, 1.6f, 3.2f};
+        for (size_t i = 0; i < 6; i++)
+        {
+            if (i == 2)
+                BOOST_CHECK(result[i] < -1e29f);
+            else
+                BOOST_CHECK_CLOSE(expectedLogits[i], result[i], 1e-4);
+        }
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(MatrixBatchedMultiplyAndWeightedAdd, RandomSeedFixture)
+{
+    const size_t numBatches = 3;
+    for (auto deviceId : {CPUDEVICE, c_deviceIdZero})
+    {
+        // a[i]' * b[i] for 3 batches of [4 x 2]' * [4 x 5], and the same with one GEMM per batch
+        SingleMatrix a = SingleMatrix::RandomUniform(4, 2 * numBatches, deviceId, -1, 1, IncrementCounter());
+        SingleMatrix b = SingleMatrix::RandomUniform(4, 5 * numBatches, deviceId, -1, 1, IncrementCounter());
+        SingleMatrix c = SingleMatrix::RandomUniform(2, 5 * numBatches, deviceId, -1, 1, IncrementCounter());
+        SingleMatrix expected(c, deviceId); // deep copy
+        SingleMatrix::BatchedMultiplyAndWeightedAdd(0.5f, a, true, b, false, 2.0f, c, numBatches);
+        for (size_t i = 0; i < numBatches; i++)
+        {
+            auto expectedBatch = expected.ColumnSlice(i * 5, 5);
+            SingleMatrix::MultiplyAndWeightedAdd(0.5f, a.ColumnSlice(i * 2, 2), true, b.ColumnSlice(i * 5, 5), false, 2.0f, expectedBatch);
+        }
+        BOOST_CHECK(c.IsEqualTo(expected, c_epsilonFloatE4));
+
+        // beta = 0 sizes the result
+        SingleMatrix d(deviceId);
+        SingleMatrix::BatchedMultiplyAndWeightedAdd(1.0f, b, true, b, false, 0.0f, d, numBatches);
+        BOOST_CHECK_EQUAL(5, d.GetNumRows());
+        BOOST_CHECK_EQUAL(5 * numBatches, d.GetNumCols());
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(MatrixAssignConvolutionResult, RandomSeedFixture)
+{
+    // against the unrolled input times the filter: 3x3 with stride 1 (Winograd) with and without padding, 5x3 with stride 2 x 1 (direct)
+    struct Geometry
+    {
+        size_t kernelWidth, kernelHeight, horizontalSubsample, verticalSubsample;
+        bool zeroPadding;
+    };
+    const size_t inputWidth = 9, inputHeight = 7, inputChannels = 3, outputChannels = 4, numSamples = 3;
+    for (const auto& g : {Geometry{3, 3, 1, 1, true}, Geometry{3, 3, 1, 1, false}, Geometry{5, 3, 2, 1, true}})
+    {
+        size_t outputWidth = g.zeroPadding ? (inputWidth + g.horizontalSubsample - 1) / g.horizontalSubsample : (inputWidth - g.kernelWidth) / g.horizontalSubsample + 1;
+        size_t outputHeight = g.zeroPadding ? (inputHeight + g.verticalSubsample - 1) / g.verticalSubsample : (inputHeight - g.kernelHeight) / g.verticalSubsample + 1;
+
+        SingleMatrix input = SingleMatrix::RandomUniform(inputWidth * inputHeight * inputChannels, numSamples, CPUDEVICE, -1, 1, IncrementCounter());
+        SingleMatrix filter = SingleMatrix::RandomUniform(outputChannels, g.kernelWidth * g.kernelHeight * inputChannels, CPUDEVICE, -1, 1, IncrementCounter());
+
+        SingleMatrix packed(CPUDEVICE);
+        packed.AssignPackedConvolutionInput(input, inputWidth, inputHeight, inputChannels, outputWidth, outputHeight, outputChannels,
+                                            g.kernelWidth, g.kernelHeight, g.horizontalSubsample, g.verticalSubsample, g.zeroPadding);
+        SingleMatrix expected(CPUDEVICE);
+        SingleMatrix::Multiply(filter, false, packed, false, expected);
+        expected.Reshape(outputChannels * outputWidth * outputHeight, numSamples);
+
+        SingleMatrix result(CPUDEVICE);
+        result.AssignConvolutionResult(input, filter, inputWidth, inputHeight, inputChannels, outputWidth, outputHeight, outputChannels,
+                                       g.kernelWidth, g.kernelHeight, g.horizontalSubsample, g.verticalSubsample, g.zeroPadding);
+        BOOST_CHECK_EQUAL(expected.GetNumRows(), result.GetNumRows());
+        BOOST_CHECK_EQUAL(expected.GetNumCols(), result.GetNumCols());
+        BOOST_CHECK(result.IsEqualTo(expected, c_epsilonFloatE4));
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(MatrixMaxPoolingGradientAtArgmax, RandomSeedFixture)
+{
+    // overlapping 3x2 windows with stride 2x1; random inputs have no ties, so both gradients must agree
+    const size_t channels = 19, inputWidth = 9, inputHeight = 8, windowWidth = 3, windowHeight = 2, horizontalSubsample = 2, verticalSubsample = 1, numSamples = 3;
+    const size_t outputWidth = (inputWidth - windowWidth) / horizontalSubsample + 1;
+    const size_t outputHeight = (inputHeight - windowHeight) / verticalSubsample + 1;
+    const size_t inputSizePerSample = inputWidth * inputHeight * channels;
+    const size_t outputSizePerSample = outputWidth * outputHeight * channels;
+
+    SingleMatrix input = SingleMatrix::RandomUniform(inputSizePerSample, numSamples, CPUDEVICE, -1, 1, IncrementCounter());
+    SingleMatrix outputGradient = SingleMatrix::RandomUniform(outputSizePerSample, numSamples, CPUDEVICE, -1, 1, IncrementCounter());
+
+    std::vector<int> argmax;
+    SingleMatrix output(CPUDEVICE);
+    output.AssignMaxPoolingResult(input, channels, inputWidth, inputHeight, inputSizePerSample, outputWidth, outputHeight, outputSizePerSample,
+                                  windowWidth, windowHeight, horizontalSubsample, verticalSubsample, &argmax);
+    BOOST_CHECK_EQUAL(outputSizePerSample * numSamples, argmax.size());
+
+    SingleMatrix expected = SingleMatrix::Zeros(inputSizePerSample, numSamples, CPUDEVICE);
+    expected.AddMaxPoolingGradient(outputGradient, input, output, channels, inputWidth, inputHeight, inputSizePerSample, outputWidth, outputHeight, outputSizePerSample,
+                                   windowWidth, windowHeight, horizontalSubsample, verticalSubsample);
+    SingleMatrix gradient = SingleMatrix::Zeros(inputSizePerSample, numSamples, CPUDEVICE);
+    gradient.AddMaxPoolingGradientAtArgmax(outputGradient, argmax, channels, inputSizePerSample, outputSizePerSample);
+    BOOST_CHECK(gradient.IsEqualTo(expected, c_epsilonFloatE5));
+}
+
+BOOST_FIXTURE_TEST_CASE(MatrixBlockSparseMultiply, RandomSeedFixture)
+{
+    // a [10 x 13] matrix with every other block of [4 x 3] set to 0 (the last block row and column are partial), and the dense product
+    const size_t numRows = 10, numCols = 13, numSamples = 5;
+    SingleMatrix weights = SingleMatrix::RandomUniform(numRows, numCols, CPUDEVICE, -1, 1, IncrementCounter());
+    for (size_t i = 0; i < numRows; i++)
+        for (size_t k = 0; k < numCols; k++)
+            if ((i / 4 + k / 3) % 2 == 0)
+                weights(i, k) = 0;
+    SingleMatrix input = SingleMatrix::RandomUniform(numCols, numSamples, CPUDEVICE, -1, 1, IncrementCounter());
+    SingleMatrix expected(CPUDEVICE);
+    SingleMatrix::Multiply(weights, false, input, false, expected);
+
+    for (size_t blockRows : {1, 4})
+    {
+        const size_t blockCols = blockRows == 1 ? 1 : 3;
+        BlockSparseMatrix<float> sparseWeights(weights, blockRows, blockCols);
+        if (blockRows == 4)
+            BOOST_CHECK_EQUAL(7, sparseWeights.GetNumBlocks()); // 7 of the 3 x 5 blocks
+        BOOST_CHECK(sparseWeights.GetSparsity() > 0.4);
+
+        SingleMatrix result(numRows, numSamples, CPUDEVICE);
+        sparseWeights.Multiply(input, result);
+        BOOST_CHECK(result.IsEqualTo(expected, c_epsilonFloatE5));
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(MatrixPackedWeightMultiply, RandomSeedFixture)
+{
+    // row counts below, at and above a multiple of the panel height, and enough samples for several column tiles
+    for (size_t numRows : {5, 32, 37})
+    {
+        const size_t numCols = 23, numSamples = 150;
+        SingleMatrix weights = SingleMatrix::RandomUniform(numRows, numCols, CPUDEVICE, -1, 1, IncrementCounter());
+        SingleMatrix input = SingleMatrix::RandomUniform(numCols, numSamples, CPUDEVICE, -1, 1, IncrementCounter());
+        SingleMatrix expected(CPUDEVICE);
+        SingleMatrix::Multiply(weights, false, input, false, expected);
+
+        PackedWeightMatrix<float> packedWeights(weights);
+        SingleMatrix result(numRows, numSamples, CPUDEVICE);
+        packedWeights.Multiply(input, result);
+        BOOST_CHECK(result.IsEqualTo(expected, c_epsilonFloatE4));
+
+        // a single sample, as in evaluation
+        SingleMatrix result1(numRows, 1, CPUDEVICE);
+        packedWeights.Multiply(input.ColumnSlice(0, 1), result1);
+        BOOST_CHECK(result1.IsEqualTo(expected.ColumnSlice(0, 1), c_epsilonFloatE4));
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 }
 } } }
@@ -0,0 +1,130 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#include "stdafx.h"
+#include <cmath>
+#include <limits>
+#include <vector>
+#include "../../../Source/Math/Matrix.h"
+#include "../../../Source/Math/RNNEngine.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+// two parallel sequences of 3 and 2 frames; the last frame of the second one is a gap
+static RNNMinibatchLayout CreateLayoutWithGap()
+{
+    RNNMinibatchLayout layout;
+    layout.m_numParallelSequences = 2;
+    layout.m_numTimeSteps = 3;
+    layout.m_sequences.push_back(RNNMinibatchLayout::Sequence{0, 0, 3});
+    layout.m_sequences.push_back(RNNMinibatchLayout::Sequence{1, 0, 2});
+    return layout;
+}
+static const size_t GapColumn = 2 * 2 + 1;
+
+// loss = sum(out .* outWeights), evaluated in inference mode
+static double Loss(RNNEngine<double>& engine, const DoubleMatrix& in, const DoubleMatrix& weights, const DoubleMatrix& outWeights, const RNNMinibatchLayout& layout)
+{
+    DoubleMatrix out(outWeights.GetNumRows(), outWeights.GetNumCols(), CPUDEVICE);
+    engine.Forward(in, weights, out, layout, false);
+    return DoubleMatrix::InnerProductOfMatrices(out, outWeights);
+}
+
+BOOST_AUTO_TEST_SUITE(RNNSuite)
+
+BOOST_AUTO_TEST_CASE(RNNTanhForward)
+{
+    // one layer, hidden and input dimension 1: h_t = tanh(0.5 x_t + 0.25 h_t-1 + 0.1 + 0.2)
+    RNNAttributes attributes(RNNCellKind::RNNTanh, 1, 1, false);
+    auto engine = RNNEngine<float>::Create(CPUDEVICE, attributes, RNNEngineKind::Cntk);
+    BOOST_REQUIRE_EQUAL(attributes.GetNumParameters(1), 4);
+
+    RNNMinibatchLayout layout;
+    layout.m_numParallelSequences = 1;
+    layout.m_numTimeSteps = 2;
+    layout.m_sequences.push_back(RNNMinibatchLayout::Sequence{0, 0, 2});
+
+    std::vector<float> x = {1.0f, -2.0f};
+    std::vector<float> w = {0.5f, 0.25f, 0.1f, 0.2f};
+    SingleMatrix in(1, 2, x.data(), CPUDEVICE, matrixFlagNormal);
+    SingleMatrix weights(4, 1, w.data(), CPUDEVICE, matrixFlagNormal);
+    SingleMatrix out(1, 2, CPUDEVICE);
+    engine->Forward(in, weights, out, layout, false);
+
+    const float h0 = tanh(0.5f * x[0] + 0.3f);
+    const float h1 = tanh(0.5f * x[1] + 0.25f * h0 + 0.3f);
+    BOOST_CHECK_CLOSE(out(0, 0), h0, 1e-4f);
+    BOOST_CHECK_CLOSE(out(0, 1), h1, 1e-4f);
+}
+
+BOOST_AUTO_TEST_CASE(RNNGradientCheck)
+{
+    const size_t inputDim = 3;
+    const size_t hiddenSize = 2;
+    const double epsilon = 1e-5;
+    const double tolerance = 1e-5;
+
+    for (RNNCellKind kind : {RNNCellKind::LSTM, RNNCellKind::GRU, RNNCellKind::RNNTanh})
+    {
+        RNNAttributes attributes(kind, hiddenSize, 2, true);
+        auto engine = RNNEngine<double>::Create(CPUDEVICE, attributes, RNNEngineKind::Cntk);
+        const RNNMinibatchLayout layout = CreateLayoutWithGap();
+        const size_t numCols = layout.GetNumCols();
+        const size_t numParameters = attributes.GetNumParameters(inputDim);
+
+        DoubleMatrix in(inputDim, numCols, CPUDEVICE);
+        in.SetUniformRandomValue(-1, 1, 1);
+        for (size_t i = 0; i < inputDim; i++)
+            in(i, GapColumn) = std::numeric_limits<double>::quiet_NaN(); // must not leak into anything
+        DoubleMatrix weights(numParameters, 1, CPUDEVICE);
+        weights.SetUniformRandomValue(-0.5, 0.5, 2);
+        DoubleMatrix outWeights(attributes.GetOutputDim(), numCols, CPUDEVICE);
+        outWeights.SetUniformRandomValue(-1, 1, 3);
+
+        // analytic gradients
+        DoubleMatrix out(attributes.GetOutputDim(), numCols, CPUDEVICE);
+        engine->Forward(in, weights, out, layout, true);
+        for (size_t i = 0; i < out.GetNumRows(); i++)
+            BOOST_CHECK_EQUAL(out(i, GapColumn), 0);
+        DoubleMatrix inGrad(inputDim, numCols, CPUDEVICE);
+        inGrad.SetValue(0);
+        DoubleMatrix weightsGrad(numParameters, 1, CPUDEVICE);
+        weightsGrad.SetValue(0);
+        engine->BackwardData(out, outWeights, weights, inGrad);
+        engine->BackwardWeights(in, out, weightsGrad);
+
+        // numeric gradients
+        for (size_t k = 0; k < numParameters; k++)
+        {
+            const double w = weights(k, 0);
+            weights(k, 0) = w + epsilon;
+            const double lossPlus = Loss(*engine, in, weights, outWeights, layout);
+            weights(k, 0) = w - epsilon;
+            const double lossMinus = Loss(*engine, in, weights, outWeights, layout);
+            weights(k, 0) = w;
+            BOOST_CHECK_SMALL((lossPlus - lossMinus) / (2 * epsilon) - weightsGrad(k, 0), tolerance);
+        }
+        for (size_t j = 0; j < numCols; j++)
+        {
+            for (size_t i = 0; i < inputDim; i++)
+            {
+                if (j == GapColumn)
+                {
+                    BOOST_CHECK_EQUAL(inGrad(i, j), 0);
+                    continue;
+                }
+                const double x = in(i, j);
+                in(i, j) = x + epsilon;
+                const double lossPlus = Loss(*engine, in, weights, outWeights, layout);
+                in(i, j) = x - epsilon;
+                const double lossMinus = Loss(*engine, in, weights, outWeights, layout);
+                in(i, j) = x;
+                BOOST_CHECK_SMALL((lossPlus - lossMinus) / (2 * epsilon) - inGrad(i, j), tolerance);
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+} } } }
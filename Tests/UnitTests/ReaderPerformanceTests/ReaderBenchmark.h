@@ -0,0 +1,239 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// ReaderBenchmark.h -- throughput and latency of a reader over whole epochs, JSON results, and a comparison against a baseline
+//
+#pragma once
+
+#include "Basics.h"
+#include "DataReader.h"
+#include "Sequences.h"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+struct ReaderBenchmarkResult
+{
+    std::string name; // e.g. "speech/prefetchThreads=4/warm"
+    size_t epochs;
+    size_t minibatches;
+    size_t samples;        // without gaps
+    size_t sequences;      // that begin in the minibatches
+    size_t bytes;          // of the minibatches, as delivered to the inputs
+    size_t bytesRead;      // from files, if the reader is instrumented (ReaderStatistics), else 0
+    double seconds;        // wall-clock time of the GetMinibatch() calls
+    double samplesPerSecond;
+    double sequencesPerSecond;
+    double mbPerSecond;     // of 'bytes'
+    double readMBPerSecond; // of 'bytesRead'
+    double p50Ms, p90Ms, p99Ms, maxMs; // latency of a GetMinibatch() call
+};
+
+// -----------------------------------------------------------------------
+// ReaderBenchmark -- times the minibatches of a reader and collects the results
+//
+// RunEpoch() reads one epoch as the training loop does, StartMinibatchLoop() and GetMinibatch() until it returns
+// false, and records the latency of each GetMinibatch() call. Epochs with the same name are accumulated into one
+// result by Finish(). Nothing is done with the data, so the times are those of a reader that is never waited for;
+// with prefetching they show how far ahead of the training the reader can run.
+// -----------------------------------------------------------------------
+
+class ReaderBenchmark
+{
+public:
+    // only the first 'maxMinibatches' of an epoch are read if not 0
+    ReaderBenchmark(size_t maxMinibatches = 0)
+        : m_maxMinibatches(maxMinibatches)
+    {
+        Reset();
+    }
+
+    template <class ElemType>
+    void RunEpoch(IDataReader& reader, StreamMinibatchInputs& inputs, size_t mbSize, size_t epoch, size_t epochSize)
+    {
+        // statistics of a previous epoch or of creating the reader do not count
+        ReaderStatistics statistics;
+        const bool isInstrumented = reader.TakeStatistics(statistics);
+        statistics = ReaderStatistics();
+
+        auto layout = make_shared<MBLayout>();
+        reader.StartMinibatchLoop(mbSize, epoch, epochSize);
+        for (size_t n = 0; m_maxMinibatches == 0 || n < m_maxMinibatches; n++)
+        {
+            const auto start = std::chrono::high_resolution_clock::now();
+            const bool hasData = reader.GetMinibatch(inputs);
+            const double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+            if (!hasData)
+                break;
+
+            m_latencies.push_back(ms);
+            m_current.minibatches++;
+            m_current.seconds += ms / 1000;
+            for (const auto& input : inputs)
+                m_current.bytes += GetBytes<ElemType>(*dynamic_pointer_cast<Matrix<ElemType>>(input.second));
+
+            reader.CopyMBLayoutTo(layout);
+            m_current.samples += layout->GetActualNumSamples();
+            for (const auto& sequence : layout->GetAllSequences())
+            {
+                if (sequence.seqId != GAP_SEQUENCE_ID && sequence.tBegin >= 0)
+                    m_current.sequences++;
+            }
+        }
+        m_current.epochs++;
+
+        if (isInstrumented && reader.TakeStatistics(statistics))
+            m_current.bytesRead += statistics.m_bytesRead;
+    }
+
+    // completes the result of the epochs run since the last call
+    void Finish(const std::string& name)
+    {
+        auto& r = m_current;
+        r.name = name;
+        r.samplesPerSecond = r.seconds > 0 ? r.samples / r.seconds : 0;
+        r.sequencesPerSecond = r.seconds > 0 ? r.sequences / r.seconds : 0;
+        r.mbPerSecond = r.seconds > 0 ? r.bytes / (r.seconds * 1024 * 1024) : 0;
+        r.readMBPerSecond = r.seconds > 0 ? r.bytesRead / (r.seconds * 1024 * 1024) : 0;
+        std::sort(m_latencies.begin(), m_latencies.end());
+        r.p50Ms = Percentile(0.5);
+        r.p90Ms = Percentile(0.9);
+        r.p99Ms = Percentile(0.99);
+        r.maxMs = m_latencies.empty() ? 0 : m_latencies.back();
+        m_results.push_back(r);
+
+        fprintf(stderr, "%-48s %6d mbs %10.1f samples/s %9.1f seqs/s %8.1f MB/s %8.1f MB/s read  latency p50 %8.3f p90 %8.3f p99 %8.3f max %8.3f ms\n",
+                name.c_str(), (int) r.minibatches, r.samplesPerSecond, r.sequencesPerSecond, r.mbPerSecond, r.readMBPerSecond, r.p50Ms, r.p90Ms, r.p99Ms, r.maxMs);
+        Reset();
+    }
+
+    const std::vector<ReaderBenchmarkResult>& GetResults() const { return m_results; }
+
+    // writes the results one benchmark per line, which is also the layout ReadBaseline() expects
+    void WriteJson(const std::wstring& path) const
+    {
+        std::ofstream out(msra::strfun::utf8(path).c_str());
+        if (!out)
+            RuntimeError("ReaderBenchmark: Cannot write '%ls'.", path.c_str());
+        out << "{\n  \"benchmarks\": [\n";
+        char line[2048];
+        for (size_t i = 0; i < m_results.size(); i++)
+        {
+            const auto& r = m_results[i];
+            sprintf_s(line, sizeof(line), "    { \"name\": \"%s\", \"epochs\": %d, \"minibatches\": %d, \"samples\": %llu, \"sequences\": %llu, \"bytes\": %llu, \"bytesRead\": %llu, "
+                                          "\"seconds\": %.6f, \"samplesPerSecond\": %.3f, \"sequencesPerSecond\": %.3f, \"mbPerSecond\": %.3f, \"readMBPerSecond\": %.3f, "
+                                          "\"p50Ms\": %.6f, \"p90Ms\": %.6f, \"p99Ms\": %.6f, \"maxMs\": %.6f }%s\n",
+                      r.name.c_str(), (int) r.epochs, (int) r.minibatches, (unsigned long long) r.samples, (unsigned long long) r.sequences,
+                      (unsigned long long) r.bytes, (unsigned long long) r.bytesRead, r.seconds, r.samplesPerSecond, r.sequencesPerSecond,
+                      r.mbPerSecond, r.readMBPerSecond, r.p50Ms, r.p90Ms, r.p99Ms, r.maxMs, i + 1 < m_results.size() ? "," : "");
+            out << line;
+        }
+        out << "  ]\n}\n";
+        if (!out)
+            RuntimeError("ReaderBenchmark: Failed to write '%ls'.", path.c_str());
+    }
+
+    // reads the samples per second of a file written by WriteJson(), by name
+    static std::map<std::string, double> ReadBaseline(const std::wstring& path)
+    {
+        std::ifstream in(msra::strfun::utf8(path).c_str());
+        if (!in)
+            RuntimeError("ReaderBenchmark: Cannot read the baseline '%ls'.", path.c_str());
+        std::map<std::string, double> baseline;
+        std::string line;
+        while (std::getline(in, line))
+        {
+            std::string name;
+            double samplesPerSecond;
+            if (!ParseStringField(line, "name", name))
+                continue;
+            if (!ParseNumberField(line, "samplesPerSecond", samplesPerSecond))
+                RuntimeError("ReaderBenchmark: The baseline entry for '%s' in '%ls' has no throughput.", name.c_str(), path.c_str());
+            baseline[name] = samplesPerSecond;
+        }
+        return baseline;
+    }
+
+    // prints each result against its baseline, and returns the number of benchmarks whose throughput is more than
+    // 'tolerance' (e.g. 0.1 for 10%) lower; benchmarks without a baseline are listed but do not count
+    size_t CompareToBaseline(const std::map<std::string, double>& baseline, double tolerance) const
+    {
+        size_t numRegressions = 0;
+        for (const auto& r : m_results)
+        {
+            auto iter = baseline.find(r.name);
+            if (iter == baseline.end())
+            {
+                fprintf(stderr, "%-48s no baseline\n", r.name.c_str());
+                continue;
+            }
+            const double ratio = iter->second > 0 ? r.samplesPerSecond / iter->second : 1;
+            const bool isRegression = ratio < 1 - tolerance;
+            if (isRegression)
+                numRegressions++;
+            fprintf(stderr, "%-48s %10.1f samples/s vs. %10.1f samples/s baseline (%+6.1f%%)%s\n",
+                    r.name.c_str(), r.samplesPerSecond, iter->second, (ratio - 1) * 100, isRegression ? "  REGRESSION" : "");
+        }
+        return numRegressions;
+    }
+
+private:
+    template <class ElemType>
+    static size_t GetBytes(const Matrix<ElemType>& m)
+    {
+        if (m.GetMatrixType() == MatrixType::SPARSE)
+            return m.NzCount() * (sizeof(ElemType) + sizeof(int)); // values and their row indices
+        return m.GetNumElements() * sizeof(ElemType);
+    }
+
+    double Percentile(double p) const
+    {
+        if (m_latencies.empty())
+            return 0;
+        return m_latencies[min((size_t) (p * m_latencies.size()), m_latencies.size() - 1)];
+    }
+
+    void Reset()
+    {
+        m_current = ReaderBenchmarkResult();
+        m_latencies.clear();
+    }
+
+    // "key": "value" and "key": number, as written by WriteJson()
+    static bool ParseStringField(const std::string& line, const char* key, std::string& value)
+    {
+        const std::string pattern = std::string("\"") + key + "\": \"";
+        const size_t begin = line.find(pattern);
+        if (begin == std::string::npos)
+            return false;
+        const size_t end = line.find('"', begin + pattern.size());
+        if (end == std::string::npos)
+            return false;
+        value = line.substr(begin + pattern.size(), end - begin - pattern.size());
+        return true;
+    }
+
+    static bool ParseNumberField(const std::string& line, const char* key, double& value)
+    {
+        const std::string pattern = std::string("\"") + key + "\": ";
+        const size_t begin = line.find(pattern);
+        if (begin == std::string::npos)
+            return false;
+        return sscanf(line.c_str() + begin + pattern.size(), "%lf", &value) == 1;
+    }
+
+    size_t m_maxMinibatches;
+    ReaderBenchmarkResult m_current;
+    std::vector<double> m_latencies; // of the epochs of m_current
+    std::vector<ReaderBenchmarkResult> m_results;
+};
+
+} } } }
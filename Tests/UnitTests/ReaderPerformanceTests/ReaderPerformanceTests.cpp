@@ -0,0 +1,221 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// ReaderPerformanceTests.cpp : Defines the entry point for the console application.
+// Throughput of a reader configured as for training, without a network; see Usage() for sweeps and baselines.
+//
+#include "stdafx.h"
+#include <vector>
+#include "Config.h"
+#include "DataReader.h"
+#include "Matrix.h"
+#include "ReaderBenchmark.h"
+using namespace Microsoft::MSR::CNTK;
+using namespace Microsoft::MSR::CNTK::Test;
+using namespace std;
+
+struct BenchmarkOptions
+{
+    std::wstring configFile;
+    std::wstring section; // that holds the reader section, e.g. the training command
+    std::wstring readerSection = L"reader";
+    std::vector<std::wstring> streams;
+    std::vector<std::wstring> overrides; // "key=value" on the command line of the config, as for cntk
+    DEVICEID_TYPE deviceId = CPUDEVICE;
+    size_t mbSize = 256;
+    size_t epochSize = requestDataSize;
+    size_t maxMinibatches = 0;
+    size_t repeats = 3;
+    bool cold = true, warm = true;
+};
+
+// the reader section with the 'overrides' of the command line and 'key=value', if not empty, set in it
+static ConfigParameters GetReaderConfig(const BenchmarkOptions& options, const std::wstring& key, const std::wstring& value)
+{
+    std::vector<std::wstring> args;
+    args.push_back(L"ReaderPerformanceTests");
+    args.push_back(L"configFile=" + options.configFile);
+    args.insert(args.end(), options.overrides.begin(), options.overrides.end());
+    std::vector<wchar_t*> argv;
+    for (auto& arg : args)
+        argv.push_back(&arg[0]);
+
+    ConfigParameters config;
+    const std::string rawConfigString = ConfigParameters::ParseCommandLine((int) argv.size(), argv.data(), config);
+    config.ResolveVariables(rawConfigString);
+    const ConfigParameters sectionConfig = config(options.section);
+    ConfigParameters readerConfig = sectionConfig(options.readerSection);
+    if (!key.empty())
+        readerConfig.Insert(key, msra::strfun::utf8(value));
+    return readerConfig;
+}
+
+// Cold: each repeat creates the reader and reads its first epoch, so no chunk has been loaded or randomized yet.
+// The OS file cache is not dropped; use directIO in the reader section (or a cold machine) to measure the storage too.
+// Warm: one reader reads an epoch that is not timed, then the timed epochs 1..repeats.
+template <class ElemType>
+void RunBenchmarks(ReaderBenchmark& bench, const BenchmarkOptions& options, const std::wstring& key, const std::wstring& value)
+{
+    const ConfigParameters readerConfig = GetReaderConfig(options, key, value);
+    StreamMinibatchInputs inputs;
+    for (const auto& stream : options.streams)
+        inputs.AddInput(stream, make_shared<Matrix<ElemType>>(options.deviceId));
+
+    std::string name = msra::strfun::utf8(options.section);
+    if (!key.empty())
+        name += "/" + msra::strfun::utf8(key) + "=" + msra::strfun::utf8(value);
+
+    if (options.cold)
+    {
+        for (size_t r = 0; r < options.repeats; r++)
+        {
+            DataReader reader(readerConfig);
+            bench.RunEpoch<ElemType>(reader, inputs, options.mbSize, 0, options.epochSize);
+        }
+        bench.Finish(name + "/cold");
+    }
+    if (options.warm)
+    {
+        DataReader reader(readerConfig);
+        bench.RunEpoch<ElemType>(reader, inputs, options.mbSize, 0, options.epochSize);
+        for (size_t epoch = 1; epoch <= options.repeats; epoch++)
+            bench.RunEpoch<ElemType>(reader, inputs, options.mbSize, epoch, options.epochSize);
+        bench.Finish(name + "/warm");
+    }
+}
+
+static void Usage()
+{
+    fprintf(stderr,
+            "ReaderPerformanceTests -config <file> -section <name> [-reader <name>] [-streams <name,...>] [-device <id>] [-type float|double]\n"
+            "                       [-mbSize <n>] [-epochSize <n>] [-maxMinibatches <n>] [-repeats <n>] [-mode cold|warm|both]\n"
+            "                       [-sweep <key>=<value,...>] [-out <results.json>] [-baseline <baseline.json>] [-tolerance <fraction>] [<key>=<value>]...\n"
+            "  -config          a cntk config file; its <section> holds the reader section (default: reader), as for training\n"
+            "  -streams         the inputs the reader fills, e.g. features,labels (default)\n"
+            "  -device          the device of the minibatches, -1 for the CPU (default)\n"
+            "  -epochSize       samples per epoch (default: the whole corpus); -maxMinibatches limits the minibatches per epoch instead\n"
+            "  -repeats         cold: readers created, warm: epochs timed after the first (default: 3)\n"
+            "  -sweep           runs the benchmarks for each value of a key of the reader section, e.g. prefetchThreads=1,2,4,8\n"
+            "                   or randomize=none,auto\n"
+            "  -out             write the results as JSON; the file of a reference run serves as a baseline\n"
+            "  -baseline        compare against a file written by -out; the exit code is 1 if a benchmark reads fewer samples\n"
+            "                   per second than that\n"
+            "  -tolerance       the fraction by which the throughput may be lower than its baseline (default: 0.1)\n"
+            "  <key>=<value>    overrides of the config file, as on the cntk command line\n");
+}
+
+int wmain(int argc, wchar_t* argv[])
+{
+    try
+    {
+        BenchmarkOptions options;
+        std::wstring type = L"float", mode = L"both", sweep, outPath, baselinePath;
+        double tolerance = 0.1;
+        for (int i = 1; i < argc; i++)
+        {
+            const std::wstring arg = argv[i];
+            if (arg.empty() || arg[0] != L'-')
+            {
+                options.overrides.push_back(arg);
+                continue;
+            }
+            if (i + 1 >= argc)
+            {
+                Usage();
+                return 2;
+            }
+            const std::wstring value = argv[++i];
+            if (arg == L"-config")
+                options.configFile = value;
+            else if (arg == L"-section")
+                options.section = value;
+            else if (arg == L"-reader")
+                options.readerSection = value;
+            else if (arg == L"-streams")
+                options.streams = msra::strfun::split(value, L",");
+            else if (arg == L"-device")
+                options.deviceId = (DEVICEID_TYPE) std::stoi(value);
+            else if (arg == L"-type")
+                type = value;
+            else if (arg == L"-mbSize")
+                options.mbSize = std::stoul(value);
+            else if (arg == L"-epochSize")
+                options.epochSize = std::stoul(value);
+            else if (arg == L"-maxMinibatches")
+                options.maxMinibatches = std::stoul(value);
+            else if (arg == L"-repeats")
+                options.repeats = std::stoul(value);
+            else if (arg == L"-mode")
+                mode = value;
+            else if (arg == L"-sweep")
+                sweep = value;
+            else if (arg == L"-out")
+                outPath = value;
+            else if (arg == L"-baseline")
+                baselinePath = value;
+            else if (arg == L"-tolerance")
+                tolerance = std::stod(value);
+            else
+            {
+                Usage();
+                return 2;
+            }
+        }
+        if (options.configFile.empty() || options.section.empty())
+        {
+            Usage();
+            return 2;
+        }
+        if (options.streams.empty())
+            options.streams = {L"features", L"labels"};
+        if (type != L"float" && type != L"double")
+            InvalidArgument("ReaderPerformanceTests: -type must be float or double, not '%ls'.", type.c_str());
+        if (mode != L"cold" && mode != L"warm" && mode != L"both")
+            InvalidArgument("ReaderPerformanceTests: -mode must be cold, warm or both, not '%ls'.", mode.c_str());
+        options.cold = mode != L"warm";
+        options.warm = mode != L"cold";
+        options.repeats = max(options.repeats, (size_t) 1);
+
+        std::wstring sweepKey;
+        std::vector<std::wstring> sweepValues(1); // no sweep: the config as it is
+        if (!sweep.empty())
+        {
+            const size_t equals = sweep.find(L'=');
+            if (equals == 0 || equals == std::wstring::npos || equals + 1 == sweep.size())
+                InvalidArgument("ReaderPerformanceTests: -sweep must be <key>=<value,...>, not '%ls'.", sweep.c_str());
+            sweepKey = sweep.substr(0, equals);
+            sweepValues = msra::strfun::split(sweep.substr(equals + 1), L",");
+        }
+
+        // read the baseline first, so that a wrong path does not fail only after all the benchmarks ran
+        std::map<std::string, double> baseline;
+        if (!baselinePath.empty())
+            baseline = ReaderBenchmark::ReadBaseline(baselinePath);
+
+        ReaderBenchmark bench(options.maxMinibatches);
+        for (const auto& value : sweepValues)
+        {
+            if (type == L"float")
+                RunBenchmarks<float>(bench, options, sweepKey, value);
+            else
+                RunBenchmarks<double>(bench, options, sweepKey, value);
+        }
+
+        if (!outPath.empty())
+            bench.WriteJson(outPath);
+        if (!baselinePath.empty())
+        {
+            const size_t numRegressions = bench.CompareToBaseline(baseline, tolerance);
+            fprintf(stderr, "%d of %d benchmarks read more than %.0f%% fewer samples per second than their baseline.\n",
+                    (int) numRegressions, (int) bench.GetResults().size(), tolerance * 100);
+            return numRegressions > 0 ? 1 : 0;
+        }
+        return 0;
+    }
+    catch (const std::exception& e)
+    {
+        fprintf(stderr, "ReaderPerformanceTests: %s\n", e.what());
+        return 2;
+    }
+}
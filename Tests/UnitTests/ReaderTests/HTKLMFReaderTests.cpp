@@ -17,6 +17,76 @@ struct AN4ReaderFixture : ReaderFixture
               "This test uses external data that is not part of the CNTK repository. Environment variable CNTK_EXTERNAL_TESTDATA_SOURCE_DIRECTORY must be set to point to the external test data location. \n Refer to the 'Setting up CNTK on Windows' documentation.)")
     {
     }
+
+    // Reads a full sweep with two feature streams of the same data, the second one from a script file with the utterances
+    // in reverse order, and checks that both streams return the same frames. The chunks of the second stream have other
+    // boundaries, so chunks of the bundler share the chunks of the second stream, and they are loaded on several threads.
+    // lazyLoading : whether the second stream is loaded lazily by the bundler
+    void HelperRunTwoFeatureStreamsTest(bool lazyLoading)
+    {
+        // The reversed script file is written next to the outputs of the other tests.
+        const string reversedScpFile = testDataPath() + "/Control/ExperimentalHTKMLFReaderTwoFeatureStreams_reversed.scp";
+        {
+            ifstream scpFile("glob_0000.scp");
+            vector<string> lines;
+            string line;
+            while (getline(scpFile, line))
+            {
+                if (!line.empty())
+                {
+                    lines.push_back(line);
+                }
+            }
+            BOOST_REQUIRE(lines.size() > 1);
+
+            ofstream reversedFile(reversedScpFile, ios::out);
+            for (auto i = lines.rbegin(); i != lines.rend(); ++i)
+            {
+                reversedFile << *i << "\n";
+            }
+        }
+
+        const string configFileName = testDataPath() + "/Config/ExperimentalHtkmlfReaderTwoFeatureStreams_Config.cntk";
+        std::wstring configFileCommand(L"configFile=" + std::wstring(configFileName.begin(), configFileName.end()));
+        std::wstring scpFileCommand(L"ReversedScpFile=" + std::wstring(reversedScpFile.begin(), reversedScpFile.end()));
+        std::wstring lazyLoadingCommand(lazyLoading ? L"LazyLoading=true" : L"LazyLoading=false");
+        std::wstring programName(L"CNTK");
+
+        wchar_t* arg[4]{&programName[0], &configFileCommand[0], &scpFileCommand[0], &lazyLoadingCommand[0]};
+        ConfigParameters config;
+        const std::string rawConfigString = ConfigParameters::ParseCommandLine(4, arg, config);
+
+        config.ResolveVariables(rawConfigString);
+        const ConfigParameters simpleDemoConfig = config("Simple_Test");
+        const ConfigParameters readerConfig = simpleDemoConfig("reader");
+
+        DataReader dataReader(readerConfig);
+
+        StreamMinibatchInputs map;
+        auto features1 = make_shared<Matrix<float>>(0);
+        auto features2 = make_shared<Matrix<float>>(0);
+        auto labels = make_shared<Matrix<float>>(0);
+        map.insert(make_pair(L"features1", features1));
+        map.insert(make_pair(L"features2", features2));
+        map.insert(make_pair(L"labels", labels));
+
+        size_t numberOfFrames = 0;
+        dataReader.StartMinibatchLoop(250, 0);
+        while (dataReader.GetMinibatch(map))
+        {
+            BOOST_REQUIRE_EQUAL(features1->GetNumRows(), features2->GetNumRows());
+            BOOST_REQUIRE_EQUAL(features1->GetNumCols(), features2->GetNumCols());
+
+            size_t numItems = features1->GetNumRows() * features1->GetNumCols();
+            std::unique_ptr<float[]> items1{features1->CopyToArray()};
+            std::unique_ptr<float[]> items2{features2->CopyToArray()};
+            BOOST_REQUIRE(std::equal(items1.get(), items1.get() + numItems, items2.get()));
+
+            numberOfFrames += features1->GetNumCols();
+        }
+
+        BOOST_CHECK(numberOfFrames > 0);
+    }
 };
 
 // Use SpeechReaderFixture for most tests
@@ -448,6 +518,16 @@ BOOST_AUTO_TEST_CASE(ExperimentalHTKMLFReaderSimpleDataLoop21_1)
         2);
 };
 
+BOOST_AUTO_TEST_CASE(ExperimentalHTKMLFReaderTwoFeatureStreams)
+{
+    HelperRunTwoFeatureStreamsTest(false);
+};
+
+BOOST_AUTO_TEST_CASE(ExperimentalHTKMLFReaderTwoFeatureStreamsLazy)
+{
+    HelperRunTwoFeatureStreamsTest(true);
+};
+
 BOOST_AUTO_TEST_SUITE_END()
 
 }
@@ -4,10 +4,23 @@
 //
 
 #include "stdafx.h"
+#include <atomic>
+#include <chrono>
+#include <numeric>
+#include <thread>
 
 #include "BlockRandomizer.h"
+#include "Bundler.h"
 #include "NoRandomizer.h"
 #include "DataDeserializer.h"
+#include "MemoryMappedFile.h"
+#include "ByteSource.h"
+#include "ChunkedBinaryWriter.h"
+#include "ChunkedBinaryDeserializer.h"
+#include "ChunkedBinaryStreamDeserializer.h"
+#include "ShuffleBufferRandomizer.h"
+#include "SequencePacker.h"
+#include "HeapMemoryProvider.h"
 
 using namespace Microsoft::MSR::CNTK;
 
@@ -206,6 +219,44 @@ BOOST_AUTO_TEST_CASE(BlockRandomizerOneEpochSmallWindow)
                                   actual.begin(), actual.end());
 }
 
+BOOST_AUTO_TEST_CASE(BlockRandomizerOneEpochWithPrefetch)
+{
+    std::vector<float> data { 0.0, 1.0, 2.0, 3.0, 4.0, 5.0, 6.0, 7.0, 8.0, 9.0 };
+    auto mockDeserializer = std::make_shared<MockDeserializer>(5, 2, data);
+
+    auto randomizer = std::make_shared<BlockRandomizer>(0, 10, mockDeserializer);
+
+    ConfigParameters config;
+    config.Parse("prefetchThreads=3\nprefetchChunks=2\nprefetchBytes=12");
+    randomizer->Initialize(nullptr, config);
+
+    EpochConfiguration epochConfiguration;
+    epochConfiguration.m_numberOfWorkers = 1;
+    epochConfiguration.m_workerRank = 0;
+    epochConfiguration.m_minibatchSizeInSamples = 0;
+    epochConfiguration.m_totalEpochSizeInSamples = 10;
+    epochConfiguration.m_epochIndex = 0;
+    randomizer->StartEpoch(epochConfiguration);
+
+    // prefetching must not change the order, same as BlockRandomizerOneEpochSmallWindow
+    std::vector<float> expected { 9.0, 8.0, 3.0, 6.0, 2.0, 1.0, 4.0, 7.0, 5.0, 0.0 };
+    std::vector<float> actual;
+    for (int i = 0; i < 11; i++)
+    {
+        Sequences sequences = randomizer->GetNextSequences(1);
+        BOOST_CHECK_EQUAL(sequences.m_data.size(), 1 - (i / 10));
+        if (i < 10)
+        {
+            auto data = reinterpret_cast<DenseSequenceData&>(*sequences.m_data[0][0]);
+            BOOST_CHECK_EQUAL(data.m_numberOfSamples, 1);
+            actual.push_back(*((float*)data.m_data));
+        }
+        BOOST_CHECK_EQUAL(sequences.m_endOfEpoch, (9 <= i));
+    }
+    BOOST_CHECK_EQUAL_COLLECTIONS(expected.begin(), expected.end(),
+                                  actual.begin(), actual.end());
+}
+
 BOOST_AUTO_TEST_CASE(BlockRandomizerOneEpochLegacyRandomization)
 {
     std::vector<float> data { 0.0, 1.0, 2.0, 3.0, 4.0, 5.0, 6.0, 7.0, 8.0, 9.0 };
@@ -244,6 +295,47 @@ BOOST_AUTO_TEST_CASE(BlockRandomizerOneEpochLegacyRandomization)
                                   actual.begin(), actual.end());
 }
 
+BOOST_AUTO_TEST_CASE(BlockRandomizerLocalChunks)
+{
+    std::vector<float> data { 0.0, 1.0, 2.0, 3.0, 4.0, 5.0, 6.0, 7.0 };
+    auto mockDeserializer = std::make_shared<MockDeserializer>(4, 2, data);
+
+    const size_t numberOfWorkers = 2;
+    std::vector<float> actual;
+    for (size_t rank = 0; rank < numberOfWorkers; rank++)
+    {
+        auto randomizer = std::make_shared<BlockRandomizer>(0,
+                                                            SIZE_MAX,
+                                                            mockDeserializer,
+                                                            BlockRandomizer::DistributionMode::local_chunks);
+
+        EpochConfiguration epochConfiguration;
+        epochConfiguration.m_numberOfWorkers = numberOfWorkers;
+        epochConfiguration.m_workerRank = rank;
+        epochConfiguration.m_minibatchSizeInSamples = 0;
+        epochConfiguration.m_totalEpochSizeInSamples = data.size();
+        epochConfiguration.m_epochIndex = 0;
+        randomizer->StartEpoch(epochConfiguration);
+
+        // Every worker gets half of each minibatch, only from its own chunks (rank == chunk id % 2).
+        for (int i = 0; i < 4; i++)
+        {
+            Sequences sequences = randomizer->GetNextSequences(2);
+            BOOST_CHECK_EQUAL(sequences.m_endOfEpoch, (3 <= i));
+            BOOST_REQUIRE_EQUAL(sequences.m_data.size(), 1);
+            BOOST_REQUIRE_EQUAL(sequences.m_data[0].size(), 1);
+            auto value = *((float*)reinterpret_cast<DenseSequenceData&>(*sequences.m_data[0][0]).m_data);
+            BOOST_CHECK_EQUAL(((size_t)value / 2) % numberOfWorkers, rank);
+            actual.push_back(value);
+        }
+    }
+
+    // Together, the workers have seen the whole corpus once.
+    std::sort(actual.begin(), actual.end());
+    BOOST_CHECK_EQUAL_COLLECTIONS(data.begin(), data.end(),
+                                  actual.begin(), actual.end());
+}
+
 BOOST_AUTO_TEST_CASE(NoRandomizerOneEpoch)
 {
     std::vector<float> data { 0.0, 1.0, 2.0, 3.0, 4.0, 5.0, 6.0, 7.0, 8.0, 9.0 };
@@ -279,6 +371,676 @@ BOOST_AUTO_TEST_CASE(NoRandomizerOneEpoch)
                                   actual.begin(), actual.end());
 }
 
+// Mock deserializer with a named stream and lookup by key, which tracks the chunks it has handed out.
+class TrackingMockDeserializer : public MockDeserializer
+{
+public:
+    TrackingMockDeserializer(size_t numChunks, size_t numSequencesPerChunk, std::vector<float>& data, const std::wstring& name)
+        : MockDeserializer(numChunks, numSequencesPerChunk, data), m_numChunks(numChunks)
+    {
+        auto stream = std::make_shared<StreamDescription>(*MockDeserializer::GetStreamDescriptions().front());
+        stream->m_name = name;
+        m_streams.push_back(stream);
+    }
+
+    std::vector<StreamDescriptionPtr> GetStreamDescriptions() const override
+    {
+        return m_streams;
+    }
+
+    ChunkPtr GetChunk(size_t chunkId) override
+    {
+        auto chunk = MockDeserializer::GetChunk(chunkId);
+        m_chunks.push_back(chunk);
+        return chunk;
+    }
+
+    const SequenceDescription* GetSequenceDescriptionByKey(const KeyType& key) override
+    {
+        return GetSequenceDescriptions()[key.minor];
+    }
+
+    size_t GetTotalNumberOfChunks() override
+    {
+        return m_numChunks;
+    }
+
+    size_t GetNumberOfLoadedChunks() const
+    {
+        return m_chunks.size();
+    }
+
+    size_t GetNumberOfLiveChunks() const
+    {
+        return std::count_if(m_chunks.begin(), m_chunks.end(), [](const std::weak_ptr<Chunk>& c) { return !c.expired(); });
+    }
+
+private:
+    size_t m_numChunks;
+    std::vector<StreamDescriptionPtr> m_streams;
+    std::vector<std::weak_ptr<Chunk>> m_chunks;
+};
+
+BOOST_AUTO_TEST_CASE(BundlerLazyLoading)
+{
+    std::vector<float> features { 0.0, 1.0, 2.0, 3.0 };
+    std::vector<float> lattices { 10.0, 11.0, 12.0, 13.0 };
+    auto driver = std::make_shared<TrackingMockDeserializer>(2, 2, features, L"features");
+    auto lazy = std::make_shared<TrackingMockDeserializer>(2, 2, lattices, L"lattice");
+
+    ConfigParameters config;
+    config.Parse("lattice=[lazyLoading=true]");
+    Bundler bundler(config, driver, { driver, lazy });
+
+    // Only the driver is asked for chunks when the bundled chunk is created.
+    auto chunk = bundler.GetChunk(1);
+    BOOST_CHECK_GT(driver->GetNumberOfLoadedChunks(), 0);
+    BOOST_CHECK_EQUAL(lazy->GetNumberOfLoadedChunks(), 0);
+
+    {
+        auto first = chunk->GetSequence(2);
+        auto second = chunk->GetSequence(3);
+        BOOST_REQUIRE_EQUAL(first.size(), 2);
+        BOOST_CHECK_EQUAL(*(float*)first[0]->m_data, 2.0f);
+        BOOST_CHECK_EQUAL(*(float*)first[1]->m_data, 12.0f);
+        BOOST_CHECK_EQUAL(*(float*)second[1]->m_data, 13.0f);
+
+        // Both sequences share the lazily loaded chunk.
+        BOOST_CHECK_EQUAL(lazy->GetNumberOfLoadedChunks(), 1);
+        BOOST_CHECK_EQUAL(lazy->GetNumberOfLiveChunks(), 1);
+    }
+
+    // The lazy chunk is released with its sequences, the bundled chunk keeps the one of the driver.
+    BOOST_CHECK_EQUAL(lazy->GetNumberOfLiveChunks(), 0);
+    BOOST_CHECK_GT(driver->GetNumberOfLiveChunks(), 0);
+
+    auto again = chunk->GetSequence(2);
+    BOOST_CHECK_EQUAL(*(float*)again[1]->m_data, 12.0f);
+    BOOST_CHECK_EQUAL(lazy->GetNumberOfLoadedChunks(), 2);
+}
+
+// Mock deserializer whose chunks take a while to load, which counts the loads of each chunk.
+class SlowMockDeserializer : public MockDeserializer
+{
+public:
+    SlowMockDeserializer(size_t numChunks, size_t numSequencesPerChunk, std::vector<float>& data, const std::wstring& name)
+        : MockDeserializer(numChunks, numSequencesPerChunk, data), m_numLoads(numChunks)
+    {
+        auto stream = std::make_shared<StreamDescription>(*MockDeserializer::GetStreamDescriptions().front());
+        stream->m_name = name;
+        m_streams.push_back(stream);
+        for (auto& numLoads : m_numLoads)
+            numLoads = 0;
+    }
+
+    std::vector<StreamDescriptionPtr> GetStreamDescriptions() const override
+    {
+        return m_streams;
+    }
+
+    ChunkPtr GetChunk(size_t chunkId) override
+    {
+        m_numLoads[chunkId]++;
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        return MockDeserializer::GetChunk(chunkId);
+    }
+
+    const SequenceDescription* GetSequenceDescriptionByKey(const KeyType& key) override
+    {
+        return GetSequenceDescriptions()[key.minor];
+    }
+
+    size_t GetTotalNumberOfChunks() override
+    {
+        return m_numLoads.size();
+    }
+
+    size_t GetNumberOfLoads(size_t chunkId) const
+    {
+        return m_numLoads[chunkId];
+    }
+
+private:
+    std::vector<StreamDescriptionPtr> m_streams;
+    std::vector<std::atomic<size_t>> m_numLoads;
+};
+
+BOOST_AUTO_TEST_CASE(BundlerLazyLoadingConcurrent)
+{
+    const size_t numSequences = 8;
+    std::vector<float> features(numSequences), lattices(numSequences);
+    std::iota(features.begin(), features.end(), 0.0f);
+    std::iota(lattices.begin(), lattices.end(), 10.0f);
+    auto driver = std::make_shared<TrackingMockDeserializer>(1, numSequences, features, L"features");
+    auto lazy = std::make_shared<SlowMockDeserializer>(1, numSequences, lattices, L"lattice");
+
+    ConfigParameters config;
+    config.Parse("lattice=[lazyLoading=true]");
+    Bundler bundler(config, driver, { driver, lazy });
+    auto chunk = bundler.GetChunk(0);
+
+    // The sequences of a minibatch are retrieved in parallel; those that share the lazy chunk must wait for a single load.
+    std::vector<std::vector<SequenceDataPtr>> sequences(numSequences);
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < numSequences; i++)
+        threads.push_back(std::thread([&, i]() { sequences[i] = chunk->GetSequence(i); }));
+    for (auto& thread : threads)
+        thread.join();
+
+    BOOST_CHECK_EQUAL(lazy->GetNumberOfLoads(0), 1);
+    for (size_t i = 0; i < numSequences; i++)
+    {
+        BOOST_REQUIRE_EQUAL(sequences[i].size(), 2);
+        BOOST_CHECK_EQUAL(*(float*)sequences[i][1]->m_data, lattices[i]);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(BlockRandomizerChunkCache)
+{
+    std::vector<float> data { 0.0, 1.0, 2.0, 3.0, 4.0, 5.0, 6.0, 7.0, 8.0, 9.0 };
+
+    // Reads three sweeps with a window of three chunks, returns the values and the number of chunks loaded.
+    auto readSweeps = [&data](const std::string& configString, size_t& loadedChunks)
+    {
+        auto deserializer = std::make_shared<TrackingMockDeserializer>(5, 2, data, L"input");
+        auto randomizer = std::make_shared<BlockRandomizer>(0, 6, deserializer);
+
+        ConfigParameters config;
+        config.Parse(configString);
+        randomizer->Initialize(nullptr, config);
+
+        std::vector<float> values;
+        for (size_t epoch = 0; epoch < 3; epoch++)
+        {
+            EpochConfiguration epochConfiguration;
+            epochConfiguration.m_numberOfWorkers = 1;
+            epochConfiguration.m_workerRank = 0;
+            epochConfiguration.m_minibatchSizeInSamples = 0;
+            epochConfiguration.m_totalEpochSizeInSamples = data.size();
+            epochConfiguration.m_epochIndex = epoch;
+            randomizer->StartEpoch(epochConfiguration);
+            for (size_t i = 0; i < data.size(); i++)
+            {
+                Sequences sequences = randomizer->GetNextSequences(1);
+                values.push_back(*((float*)reinterpret_cast<DenseSequenceData&>(*sequences.m_data[0][0]).m_data));
+            }
+        }
+
+        loadedChunks = deserializer->GetNumberOfLoadedChunks();
+        return values;
+    };
+
+    // A sample is estimated at 4 bytes, a chunk at 8.
+    size_t uncachedLoads, cachedLoads, partiallyCachedLoads;
+    auto uncached = readSweeps("prefetchThreads=0", uncachedLoads);
+    auto cached = readSweeps("prefetchThreads=0\nchunkCacheBytes=40", cachedLoads);
+    auto partiallyCached = readSweeps("prefetchThreads=0\nchunkCacheBytes=16", partiallyCachedLoads);
+
+    // The cache does not change the order, and with room for all chunks each chunk is loaded once.
+    BOOST_CHECK_EQUAL_COLLECTIONS(uncached.begin(), uncached.end(), cached.begin(), cached.end());
+    BOOST_CHECK_EQUAL_COLLECTIONS(uncached.begin(), uncached.end(), partiallyCached.begin(), partiallyCached.end());
+    BOOST_CHECK_EQUAL(cachedLoads, 5);
+    BOOST_CHECK_LT(partiallyCachedLoads, uncachedLoads);
+    BOOST_CHECK_GT(partiallyCachedLoads, cachedLoads);
+}
+
+// Returns sequences of the given lengths in order; sample t of sequence i has the value 100 * i + t.
+class MockSequenceTransformer : public Transformer
+{
+    std::vector<std::vector<float>> m_data;
+    std::vector<StreamDescriptionPtr> m_streams;
+    TensorShapePtr m_sampleLayout;
+    size_t m_position;
+
+public:
+    MockSequenceTransformer(const std::vector<size_t>& lengths)
+        : m_sampleLayout(std::make_shared<TensorShape>(1)), m_position(0)
+    {
+        for (size_t i = 0; i < lengths.size(); i++)
+        {
+            m_data.push_back(std::vector<float>());
+            for (size_t t = 0; t < lengths[i]; t++)
+            {
+                m_data.back().push_back((float)(100 * i + t));
+            }
+        }
+        m_streams.push_back(std::make_shared<StreamDescription>(StreamDescription{
+            L"input",
+            0,
+            StorageType::dense,
+            ElementType::tfloat,
+            m_sampleLayout
+        }));
+    }
+
+    void Initialize(TransformerPtr, const ConfigParameters&) override
+    {
+    }
+
+    std::vector<StreamDescriptionPtr> GetStreamDescriptions() const override
+    {
+        return m_streams;
+    }
+
+    void StartEpoch(const EpochConfiguration&) override
+    {
+        m_position = 0;
+    }
+
+    Sequences GetNextSequences(size_t sampleCount) override
+    {
+        Sequences result;
+        result.m_data.resize(1);
+        size_t samples = 0;
+        while (m_position < m_data.size() && (samples == 0 || samples + m_data[m_position].size() <= sampleCount))
+        {
+            auto data = std::make_shared<DenseSequenceData>();
+            data->m_data = m_data[m_position].data();
+            data->m_numberOfSamples = m_data[m_position].size();
+            data->m_sampleLayout = m_sampleLayout;
+            result.m_data[0].push_back(data);
+            samples += m_data[m_position].size();
+            m_position++;
+        }
+        if (result.m_data[0].empty())
+        {
+            result.m_data.clear();
+        }
+        result.m_endOfEpoch = m_position == m_data.size();
+        return result;
+    }
+};
+
+// Checks that the minibatch holds the samples of the sequences as laid out by its MBLayout, with zero gaps.
+// Returns the ids (value / 100) of the sequences found.
+static std::vector<size_t> CheckSequenceMinibatch(const Minibatch& minibatch)
+{
+    BOOST_REQUIRE_EQUAL(minibatch.m_data.size(), 1);
+    const auto& stream = minibatch.m_data[0];
+    const auto& layout = stream->m_layout;
+    const float* data = reinterpret_cast<const float*>(stream->m_data);
+    BOOST_CHECK_EQUAL(stream->m_dataSize, layout->GetNumCols() * sizeof(float));
+
+    std::vector<size_t> ids;
+    std::vector<bool> covered(layout->GetNumCols(), false);
+    for (const auto& sequence : layout->GetAllSequences())
+    {
+        for (size_t t = sequence.tBegin; t < sequence.tEnd; t++)
+        {
+            covered[t * layout->GetNumParallelSequences() + sequence.s] = true;
+        }
+        if (sequence.seqId == GAP_SEQUENCE_ID)
+        {
+            continue;
+        }
+        const size_t id = (size_t)data[sequence.tBegin * layout->GetNumParallelSequences() + sequence.s] / 100;
+        for (size_t t = sequence.tBegin; t < sequence.tEnd; t++)
+        {
+            BOOST_CHECK_EQUAL(data[t * layout->GetNumParallelSequences() + sequence.s], (float)(100 * id + t - sequence.tBegin));
+        }
+        ids.push_back(id);
+    }
+    for (size_t j = 0; j < covered.size(); j++)
+    {
+        BOOST_CHECK(covered[j]);
+    }
+    for (const auto& sequence : layout->GetAllSequences())
+    {
+        if (sequence.seqId == GAP_SEQUENCE_ID)
+        {
+            for (size_t t = sequence.tBegin; t < sequence.tEnd; t++)
+            {
+                BOOST_CHECK_EQUAL(data[t * layout->GetNumParallelSequences() + sequence.s], 0.0f);
+            }
+        }
+    }
+    return ids;
+}
+
+BOOST_AUTO_TEST_CASE(SequencePackerLayout)
+{
+    // The sequences fit into 3 parallel sequences of 4 time steps: {4}, {3, 1}, {2, 1}.
+    auto transformer = std::make_shared<MockSequenceTransformer>(std::vector<size_t>{ 2, 4, 1, 3, 1 });
+    SequencePacker packer(std::make_shared<HeapMemoryProvider>(), transformer, 100, transformer->GetStreamDescriptions());
+
+    Minibatch minibatch = packer.ReadMinibatch();
+    BOOST_CHECK(minibatch.m_endOfEpoch);
+    BOOST_CHECK_EQUAL(minibatch.m_data[0]->m_layout->GetNumParallelSequences(), 3);
+    BOOST_CHECK_EQUAL(minibatch.m_data[0]->m_layout->GetNumTimeSteps(), 4);
+
+    auto ids = CheckSequenceMinibatch(minibatch);
+    std::sort(ids.begin(), ids.end());
+    std::vector<size_t> expected { 0, 1, 2, 3, 4 };
+    BOOST_CHECK_EQUAL_COLLECTIONS(expected.begin(), expected.end(), ids.begin(), ids.end());
+}
+
+BOOST_AUTO_TEST_CASE(SequencePackerTimeStepSlack)
+{
+    // Without slack, 4 parallel sequences of 10 time steps: {10}, {6, 4}, {6}, {5}.
+    // With 10% slack, 3 parallel sequences of 11 time steps have fewer columns: {10}, {6, 5}, {6, 4}.
+    const std::vector<size_t> lengths { 10, 6, 6, 5, 4 };
+    for (double slack : { 0.0, 0.1 })
+    {
+        auto transformer = std::make_shared<MockSequenceTransformer>(lengths);
+        SequencePacker packer(std::make_shared<HeapMemoryProvider>(), transformer, 100, transformer->GetStreamDescriptions(), 0, 0, slack);
+
+        Minibatch minibatch = packer.ReadMinibatch();
+        BOOST_CHECK_EQUAL(minibatch.m_data[0]->m_layout->GetNumParallelSequences(), slack > 0 ? 3 : 4);
+        BOOST_CHECK_EQUAL(minibatch.m_data[0]->m_layout->GetNumTimeSteps(), slack > 0 ? 11 : 10);
+
+        auto ids = CheckSequenceMinibatch(minibatch);
+        std::sort(ids.begin(), ids.end());
+        std::vector<size_t> expected { 0, 1, 2, 3, 4 };
+        BOOST_CHECK_EQUAL_COLLECTIONS(expected.begin(), expected.end(), ids.begin(), ids.end());
+    }
+}
+
+BOOST_AUTO_TEST_CASE(SequencePackerLengthBucketing)
+{
+    std::mt19937 rng(3);
+    std::uniform_int_distribution<size_t> length(1, 50);
+    std::vector<size_t> lengths(400);
+    for (auto& l : lengths)
+    {
+        l = length(rng);
+    }
+
+    // Returns the number of columns of all minibatches of an epoch, after checking that every sequence is returned once.
+    auto runEpoch = [&lengths](size_t bucketingWindow)
+    {
+        auto transformer = std::make_shared<MockSequenceTransformer>(lengths);
+        SequencePacker packer(std::make_shared<HeapMemoryProvider>(), transformer, 200, transformer->GetStreamDescriptions(), bucketingWindow);
+        std::vector<size_t> ids;
+        size_t columns = 0;
+        for (;;)
+        {
+            Minibatch minibatch = packer.ReadMinibatch();
+            if (!minibatch.m_data.empty())
+            {
+                auto minibatchIds = CheckSequenceMinibatch(minibatch);
+                ids.insert(ids.end(), minibatchIds.begin(), minibatchIds.end());
+                columns += minibatch.m_data[0]->m_layout->GetNumCols();
+            }
+            if (minibatch.m_endOfEpoch)
+            {
+                break;
+            }
+        }
+
+        std::sort(ids.begin(), ids.end());
+        BOOST_REQUIRE_EQUAL(ids.size(), lengths.size());
+        for (size_t i = 0; i < ids.size(); i++)
+        {
+            BOOST_CHECK_EQUAL(ids[i], i);
+        }
+        return columns;
+    };
+
+    size_t columnsWithoutBuckets = runEpoch(0);
+    size_t columnsWithBuckets = runEpoch(10);
+    BOOST_CHECK_LT(columnsWithBuckets, columnsWithoutBuckets);
+}
+
+BOOST_AUTO_TEST_CASE(MemoryMappedFileContents)
+{
+    const std::wstring path = L"MemoryMappedFileContents.bin";
+    std::vector<float> data { 0.0, 1.0, 2.0, 3.0, 4.0, 5.0, 6.0, 7.0, 8.0, 9.0 };
+    {
+        FILE* f = _wfopen(path.c_str(), L"wb");
+        BOOST_REQUIRE(f != nullptr);
+        fwrite(data.data(), sizeof(float), data.size(), f);
+        fclose(f);
+    }
+
+    {
+        MemoryMappedFile file(path);
+        BOOST_REQUIRE_EQUAL(file.GetSize(), data.size() * sizeof(float));
+        const float* mapped = reinterpret_cast<const float*>(file.GetData());
+        BOOST_CHECK_EQUAL_COLLECTIONS(data.begin(), data.end(),
+                                      mapped, mapped + data.size());
+    }
+
+    _wunlink(path.c_str());
+    BOOST_CHECK_THROW(MemoryMappedFile file(path), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(FileByteSourceBlockReads)
+{
+    const std::wstring path = L"FileByteSourceBlockReads.bin";
+    // Large enough for several concurrently read blocks.
+    std::vector<uint32_t> data(3 * 1024 * 1024 + 17);
+    std::iota(data.begin(), data.end(), 0);
+    {
+        FILE* f = _wfopen(path.c_str(), L"wb");
+        BOOST_REQUIRE(f != nullptr);
+        fwrite(data.data(), sizeof(uint32_t), data.size(), f);
+        fclose(f);
+    }
+
+    for (bool direct : { false, true })
+    {
+        FileByteSource source(path, direct);
+        // A range at an unaligned offset, up to the end of the file.
+        std::vector<uint32_t> buffer(data.size() - 5);
+        source.Read(5 * sizeof(uint32_t), buffer.size() * sizeof(uint32_t), (char*)buffer.data());
+        BOOST_CHECK(std::equal(buffer.begin(), buffer.end(), data.begin() + 5));
+
+        // Reading past the end of the file fails.
+        buffer.resize(data.size());
+        BOOST_CHECK_THROW(source.Read(5 * sizeof(uint32_t), buffer.size() * sizeof(uint32_t), (char*)buffer.data()), std::runtime_error);
+    }
+
+    _wunlink(path.c_str());
+}
+
+BOOST_AUTO_TEST_CASE(ByteSourceLocalCache)
+{
+    const std::wstring path = L"ByteSourceLocalCache.bin";
+    std::vector<char> data(16);
+    std::iota(data.begin(), data.end(), (char)0);
+    {
+        FILE* f = _wfopen(path.c_str(), L"wb");
+        BOOST_REQUIRE(f != nullptr);
+        fwrite(data.data(), 1, data.size(), f);
+        fclose(f);
+    }
+
+    // Only the first range fits into the cache.
+    CachingByteSource source(std::make_shared<FileByteSource>(path), L".", 8);
+    std::vector<char> buffer(8);
+    source.Read(4, 8, buffer.data());
+    BOOST_CHECK_EQUAL_COLLECTIONS(buffer.begin(), buffer.end(), data.begin() + 4, data.begin() + 12);
+    source.Read(8, 8, buffer.data());
+    BOOST_CHECK_EQUAL_COLLECTIONS(buffer.begin(), buffer.end(), data.begin() + 8, data.end());
+
+    // Without the original file the cached range can still be read, the other one not.
+    _wunlink(path.c_str());
+    std::fill(buffer.begin(), buffer.end(), (char)-1);
+    source.Read(4, 8, buffer.data());
+    BOOST_CHECK_EQUAL_COLLECTIONS(buffer.begin(), buffer.end(), data.begin() + 4, data.begin() + 12);
+    BOOST_CHECK_THROW(source.Read(8, 8, buffer.data()), std::runtime_error);
+
+    _wunlink(source.GetCachePath(4, 8).c_str());
+}
+
+BOOST_AUTO_TEST_CASE(ChunkedBinaryRoundtrip)
+{
+    const std::wstring path = L"ChunkedBinaryRoundtrip.bin";
+    const size_t numberOfSequences = 10;
+
+    auto dense = std::make_shared<StreamDescription>();
+    dense->m_id = 0;
+    dense->m_name = L"features";
+    dense->m_storageType = StorageType::dense;
+    dense->m_elementType = ElementType::tfloat;
+    dense->m_sampleLayout = std::make_shared<TensorShape>(3);
+
+    auto sparse = std::make_shared<StreamDescription>();
+    sparse->m_id = 1;
+    sparse->m_name = L"labels";
+    sparse->m_storageType = StorageType::sparse_csc;
+    sparse->m_elementType = ElementType::tfloat;
+    sparse->m_sampleLayout = std::make_shared<TensorShape>(5);
+
+    // Sequence i has i % 3 + 1 samples; the small chunk size gives several chunks.
+    {
+        ChunkedBinaryWriter writer(path, { dense, sparse }, 64);
+        for (size_t i = 0; i < numberOfSequences; ++i)
+        {
+            size_t length = i % 3 + 1;
+            std::vector<float> denseValues(length * 3);
+            std::iota(denseValues.begin(), denseValues.end(), (float)(i * 10));
+            auto denseSequence = std::make_shared<DenseSequenceData>();
+            denseSequence->m_numberOfSamples = length;
+            denseSequence->m_sampleLayout = dense->m_sampleLayout;
+            denseSequence->m_data = denseValues.data();
+
+            std::vector<float> sparseValues(length, (float)i);
+            auto sparseSequence = std::make_shared<SparseSequenceData>();
+            for (size_t t = 0; t < length; ++t)
+            {
+                sparseSequence->m_indices.push_back(std::vector<size_t>{ (i + t) % 5 });
+            }
+            sparseSequence->m_data = sparseValues.data();
+
+            writer.AddSequence({ denseSequence, sparseSequence });
+        }
+        writer.Close();
+        BOOST_CHECK_GT(writer.GetNumberOfChunks(), 1);
+    }
+
+    {
+        // Read back with conversion to double.
+        ChunkedBinaryDeserializer deserializer(path, ElementType::tdouble);
+        auto streams = deserializer.GetStreamDescriptions();
+        BOOST_REQUIRE_EQUAL(streams.size(), 2);
+        BOOST_CHECK(streams[0]->m_name == L"features");
+        BOOST_CHECK(streams[1]->m_name == L"labels");
+        BOOST_CHECK(streams[0]->m_storageType == StorageType::dense);
+        BOOST_CHECK(streams[1]->m_storageType == StorageType::sparse_csc);
+        BOOST_CHECK(streams[1]->m_elementType == ElementType::tdouble);
+        BOOST_CHECK_EQUAL(streams[1]->m_sampleLayout->GetNumElements(), 5);
+
+        const auto& sequences = deserializer.GetSequenceDescriptions();
+        BOOST_REQUIRE_EQUAL(sequences.size(), numberOfSequences);
+        ChunkPtr chunk;
+        size_t chunkId = SIZE_MAX;
+        for (size_t i = 0; i < numberOfSequences; ++i)
+        {
+            size_t length = i % 3 + 1;
+            BOOST_CHECK_EQUAL(sequences[i]->m_numberOfSamples, length);
+            if (sequences[i]->m_chunkId != chunkId)
+            {
+                chunkId = sequences[i]->m_chunkId;
+                chunk = deserializer.GetChunk(chunkId);
+            }
+
+            auto data = chunk->GetSequence(i);
+            BOOST_REQUIRE_EQUAL(data.size(), 2);
+
+            auto& denseSequence = static_cast<DenseSequenceData&>(*data[0]);
+            BOOST_REQUIRE_EQUAL(denseSequence.m_numberOfSamples, length);
+            std::vector<double> expected(length * 3);
+            std::iota(expected.begin(), expected.end(), (double)(i * 10));
+            const double* denseValues = static_cast<const double*>(denseSequence.m_data);
+            BOOST_CHECK_EQUAL_COLLECTIONS(expected.begin(), expected.end(), denseValues, denseValues + expected.size());
+
+            auto& sparseSequence = static_cast<SparseSequenceData&>(*data[1]);
+            BOOST_REQUIRE_EQUAL(sparseSequence.m_indices.size(), length);
+            const double* sparseValues = static_cast<const double*>(sparseSequence.m_data);
+            for (size_t t = 0; t < length; ++t)
+            {
+                BOOST_REQUIRE_EQUAL(sparseSequence.m_indices[t].size(), 1);
+                BOOST_CHECK_EQUAL(sparseSequence.m_indices[t][0], (i + t) % 5);
+                BOOST_CHECK_EQUAL(sparseValues[t], (double)i);
+            }
+        }
+    }
+
+    // A file that was not closed is rejected.
+    {
+        ChunkedBinaryWriter writer(path, { dense }, 64);
+    }
+    BOOST_CHECK_THROW(ChunkedBinaryDeserializer deserializer(path, ElementType::tfloat), std::runtime_error);
+    _wunlink(path.c_str());
+}
+
+BOOST_AUTO_TEST_CASE(ChunkedBinaryStreamShuffleBuffer)
+{
+    const std::wstring path = L"ChunkedBinaryStream.bin";
+    const size_t numberOfSequences = 20;
+
+    auto dense = std::make_shared<StreamDescription>();
+    dense->m_id = 0;
+    dense->m_name = L"features";
+    dense->m_storageType = StorageType::dense;
+    dense->m_elementType = ElementType::tfloat;
+    dense->m_sampleLayout = std::make_shared<TensorShape>(1);
+
+    {
+        FILE* f = fopenOrDie(path, L"wb");
+        ChunkedBinaryStreamWriter writer(f, { dense });
+        for (size_t i = 0; i < numberOfSequences; ++i)
+        {
+            float value = (float)i;
+            auto sequence = std::make_shared<DenseSequenceData>();
+            sequence->m_numberOfSamples = 1;
+            sequence->m_sampleLayout = dense->m_sampleLayout;
+            sequence->m_data = &value;
+            writer.AddSequence({ sequence });
+        }
+        writer.Close();
+        fclose(f);
+    }
+
+    auto deserializer = std::make_shared<ChunkedBinaryStreamDeserializer>(path, ElementType::tfloat);
+    const size_t bufferSize = 4;
+    ShuffleBufferRandomizer randomizer(deserializer, bufferSize);
+
+    // The first epoch has a size, the second one takes the rest of the stream.
+    std::vector<float> values;
+    for (size_t epoch = 0; epoch < 2; ++epoch)
+    {
+        EpochConfiguration config;
+        config.m_numberOfWorkers = 1;
+        config.m_workerRank = 0;
+        config.m_minibatchSizeInSamples = 3;
+        config.m_totalEpochSizeInSamples = epoch == 0 ? 8 : requestDataSize;
+        config.m_epochIndex = epoch;
+        randomizer.StartEpoch(config);
+
+        size_t epochSamples = 0;
+        bool endOfEpoch = false;
+        while (!endOfEpoch)
+        {
+            auto sequences = randomizer.GetNextSequences(3);
+            endOfEpoch = sequences.m_endOfEpoch;
+            if (sequences.m_data.empty())
+            {
+                continue;
+            }
+
+            BOOST_REQUIRE_EQUAL(sequences.m_data.size(), 1);
+            for (const auto& sequence : sequences.m_data[0])
+            {
+                float value = *static_cast<const float*>(sequence->m_data);
+                // A sequence can only be taken while it is in the buffer.
+                BOOST_CHECK_LT(value, (float)(values.size() + bufferSize));
+                values.push_back(value);
+                epochSamples++;
+            }
+        }
+        BOOST_CHECK_EQUAL(epochSamples, epoch == 0 ? 8 : numberOfSequences - 8);
+    }
+
+    std::vector<float> expected(numberOfSequences);
+    std::iota(expected.begin(), expected.end(), 0.0f);
+    BOOST_CHECK(values != expected);
+    std::sort(values.begin(), values.end());
+    BOOST_CHECK_EQUAL_COLLECTIONS(expected.begin(), expected.end(), values.begin(), values.end());
+    _wunlink(path.c_str());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 } } } }